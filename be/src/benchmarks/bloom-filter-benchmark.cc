@@ -27,13 +27,14 @@
 using namespace std;
 using namespace impala;
 
-// Tests Bloom filter performance on four tasks:
+// Tests Bloom filter performance on five tasks:
 //
 // 1. Construct/destruct pairs
 // 2. Inserts
 // 3. Lookups when the item is present
 // 4. Lookups when the item is absent (this is theoretically faster than when the item is
 //    present in some Bloom filter variants)
+// 5. Lookups of batches of items with FindBatch()
 //
 // As in bloom-filter.h, ndv refers to the number of unique items inserted into a filter
 // and fpp is the probability of false positives.
@@ -224,6 +225,31 @@ void Absent(int batch_size, void* data) {
   }
 }
 
+// Same as above, but looks up FIND_BATCH_SIZE items with each call to FindBatch().
+const int FIND_BATCH_SIZE = 1024;
+
+void PresentBatch(int batch_size, void* data) {
+  TestData* d = reinterpret_cast<TestData*>(data);
+  uint8_t found[FIND_BATCH_SIZE];
+  for (int i = 0; i < batch_size; i += FIND_BATCH_SIZE) {
+    int offset = i & d->vec_mask & ~(FIND_BATCH_SIZE - 1);
+    int n = min<int>(FIND_BATCH_SIZE, d->vec_mask + 1 - offset);
+    d->bf.FindBatch(&d->present[offset], n, found);
+    for (int j = 0; j < n; ++j) d->result += found[j];
+  }
+}
+
+void AbsentBatch(int batch_size, void* data) {
+  TestData* d = reinterpret_cast<TestData*>(data);
+  uint8_t found[FIND_BATCH_SIZE];
+  for (int i = 0; i < batch_size; i += FIND_BATCH_SIZE) {
+    int offset = i & d->vec_mask & ~(FIND_BATCH_SIZE - 1);
+    int n = min<int>(FIND_BATCH_SIZE, d->vec_mask + 1 - offset);
+    d->bf.FindBatch(&d->absent[offset], n, found);
+    for (int j = 0; j < n; ++j) d->result += found[j];
+  }
+}
+
 }  // namespace find
 
 void RunBenchmarks() {
@@ -270,6 +296,22 @@ void RunBenchmarks() {
     }
     cout << suite.Measure() << endl;
   }
+
+  {
+    Benchmark suite("find batch");
+    for (int ndv = 10000; ndv <= 100 * 1000 * 1000; ndv *= 100) {
+      for (double fpp = 0.1; fpp >= 0.001; fpp /= 10) {
+        find::TestData* d = new find::TestData(BloomFilter::MinLogSpace(ndv, fpp), ndv);
+
+        snprintf(name, sizeof(name), "present ndv %7dk fpp %6.1f%%", ndv/1000, fpp*100);
+        suite.AddBenchmark(name, find::PresentBatch, d);
+
+        snprintf(name, sizeof(name), "absent  ndv %7dk fpp %6.1f%%", ndv/1000, fpp*100);
+        suite.AddBenchmark(name, find::AbsentBatch, d);
+      }
+    }
+    cout << suite.Measure() << endl;
+  }
 }
 
 int main(int argc, char **argv) {
@@ -0,0 +1,518 @@
+// Copyright 2016 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <boost/scoped_ptr.hpp>
+#include <gflags/gflags.h>
+
+#include "codegen/llvm-codegen.h"
+#include "common/init.h"
+#include "common/object-pool.h"
+#include "exec/exchange-node.h"
+#include "exec/partitioned-aggregation-node.h"
+#include "exec/partitioned-hash-join-node.h"
+#include "exec/sort-node.h"
+#include "exec/topn-node.h"
+#include "experiments/data-provider.h"
+#include "gen-cpp/Exprs_types.h"
+#include "gen-cpp/PlanNodes_types.h"
+#include "gutil/strings/split.h"
+#include "gutil/strings/substitute.h"
+#include "runtime/data-stream-mgr.h"
+#include "runtime/descriptors.h"
+#include "runtime/mem-pool.h"
+#include "runtime/mem-tracker.h"
+#include "runtime/row-batch.h"
+#include "runtime/string-value.h"
+#include "runtime/test-env.h"
+#include "runtime/tuple-row.h"
+#include "testutil/desc-tbl-builder.h"
+#include "util/benchmark.h"
+#include "util/cpu-info.h"
+#include "util/stopwatch.h"
+#include "util/test-info.h"
+#include "util/thread.h"
+
+#include "common/names.h"
+
+using std::numeric_limits;
+using std::right;
+using strings::Substitute;
+
+// End-to-end benchmark of the query operators. Each operator runs in-process on top of
+// a leaf node that returns pre-generated tuples, so that no scan, HDFS or network is
+// involved and the measured time is spent in the operator itself. The operators are:
+//   - Aggregation: PartitionedAggregationNode grouping by the key (no aggregate
+//     functions, since those are resolved by the frontend's catalog of builtins).
+//   - HashJoin: PartitionedHashJoinNode inner join on the key. The build side has every
+//     key once, so each probe row returns exactly one row.
+//   - Sort: SortNode ordering by the key.
+//   - TopN: TopNNode ordering by the key with a limit of --top_n_limit.
+//   - Exchange: ExchangeNode receiving serialized batches from a sender thread through
+//     the DataStreamMgr, as from a remote sender.
+//   - LocalExchange: same, but the batches are handed over without serialization, as
+//     from a sender in the same process.
+// Every input row has a key and a BIGINT payload. The keys are either BIGINTs or
+// STRINGs of 16 characters and are drawn uniformly from --cardinalities distinct values.
+//
+// For each operator, key type and cardinality the benchmark reports the input rows
+// processed per second and the CPU cycles spent per input row by the fastest of
+// --num_iterations runs. The time covers Open() and GetNext() of the operator, but not
+// Prepare() and codegen. The input rows of a join are the probe and the build rows.
+//
+// Example: exec-node-benchmark --num_rows=10000000 --cardinalities=100,10000000
+
+DEFINE_int32(num_rows, 1024 * 1024, "Number of input rows of each operator.");
+DEFINE_string(cardinalities, "1000,1000000", "Comma-separated list of the numbers of "
+    "distinct keys in the input.");
+DEFINE_int32(num_iterations, 3, "Number of runs of each benchmark. The fastest run is "
+    "reported.");
+DEFINE_int32(top_n_limit, 100, "Limit of the TopN benchmarks.");
+DEFINE_bool(enable_codegen, true, "If false, the operators run without codegen.");
+
+namespace impala {
+
+class ExecNodeBenchmark {
+ public:
+  ExecNodeBenchmark()
+    : test_env_(new TestEnv()),
+      data_pool_(&tracker_),
+      profile_(&obj_pool_, "ExecNodeBenchmark"),
+      desc_tbl_(NULL),
+      next_query_id_(0) {
+    query_options_.__set_disable_codegen(!FLAGS_enable_codegen);
+  }
+
+  ~ExecNodeBenchmark() {
+    data_pool_.FreeAll();
+  }
+
+  // Runs all benchmarks and prints their results to stdout.
+  Status RunAll() {
+    vector<int64_t> cardinalities;
+    for (const string& cardinality:
+         strings::Split(FLAGS_cardinalities, ",", strings::SkipEmpty())) {
+      cardinalities.push_back(atol(cardinality.c_str()));
+      if (cardinalities.back() <= 0) {
+        return Status(Substitute("Invalid cardinality: $0", cardinality));
+      }
+    }
+    cout << setw(16) << left << "Operator" << setw(8) << "Key" << right
+         << setw(14) << "Cardinality" << setw(16) << "Rows/sec"
+         << setw(14) << "Cycles/row" << endl;
+    cout << string(68, '-') << endl;
+    for (PrimitiveType key_type: {TYPE_BIGINT, TYPE_STRING}) {
+      InitDescriptorTbl(key_type);
+      for (int64_t cardinality: cardinalities) {
+        Input input;
+        GenerateTuples(*desc_tbl_->GetTupleDescriptor(INPUT_TUPLE), FLAGS_num_rows,
+            cardinality, false, &input.tuples);
+        GenerateTuples(*desc_tbl_->GetTupleDescriptor(BUILD_TUPLE), cardinality,
+            cardinality, true, &input.build_tuples);
+        for (int op = 0; op < NUM_OPERATORS; ++op) {
+          RETURN_IF_ERROR(Measure(static_cast<Operator>(op), key_type, cardinality,
+              input));
+        }
+        data_pool_.FreeAll();
+      }
+    }
+    return Status::OK();
+  }
+
+ private:
+  enum Operator {
+    AGGREGATION,
+    HASH_JOIN,
+    SORT,
+    TOP_N,
+    EXCHANGE,
+    LOCAL_EXCHANGE,
+    NUM_OPERATORS
+  };
+
+  // Tuples of the descriptor table. Every tuple has a key slot and all but the
+  // aggregation tuple a BIGINT payload slot after it. DescriptorTblBuilder numbers the
+  // slots in order after the tuples.
+  enum TupleIds {
+    INPUT_TUPLE,
+    BUILD_TUPLE,
+    AGG_TUPLE,
+    SORT_TUPLE,
+    NUM_TUPLES
+  };
+  static const SlotId INPUT_KEY_SLOT = NUM_TUPLES;
+  static const SlotId INPUT_PAYLOAD_SLOT = NUM_TUPLES + 1;
+  static const SlotId BUILD_KEY_SLOT = NUM_TUPLES + 2;
+  static const SlotId SORT_KEY_SLOT = NUM_TUPLES + 5;
+
+  static const int ROOT_NODE_ID = 0;
+  static const int BLOCK_SIZE = 8 * 1024 * 1024;
+  static const int STRING_KEY_LEN = 16;
+  static const int GENERATOR_BATCH_SIZE = 1024;
+
+  // The pre-generated input of an operator.
+  struct Input {
+    // Rows of INPUT_TUPLE, the probe side of joins and the input of all other operators.
+    vector<Tuple*> tuples;
+
+    // Rows of BUILD_TUPLE, the build side of joins.
+    vector<Tuple*> build_tuples;
+  };
+
+  // Leaf node that returns the rows of a set of tuples that it does not own.
+  class InputNode : public ExecNode {
+   public:
+    InputNode(ObjectPool* pool, const TPlanNode& tnode, const DescriptorTbl& descs,
+        const vector<Tuple*>* tuples)
+      : ExecNode(pool, tnode, descs), tuples_(tuples), next_tuple_idx_(0) {}
+
+    virtual Status GetNext(RuntimeState* state, RowBatch* row_batch, bool* eos) {
+      int num_rows = min<int64_t>(row_batch->capacity() - row_batch->num_rows(),
+          tuples_->size() - next_tuple_idx_);
+      int row_idx = row_batch->AddRows(num_rows);
+      for (int i = 0; i < num_rows; ++i) {
+        row_batch->GetRow(row_idx + i)->SetTuple(0, (*tuples_)[next_tuple_idx_++]);
+      }
+      row_batch->CommitRows(num_rows);
+      num_rows_returned_ += num_rows;
+      COUNTER_SET(rows_returned_counter_, num_rows_returned_);
+      *eos = next_tuple_idx_ == tuples_->size();
+      return Status::OK();
+    }
+
+   private:
+    const vector<Tuple*>* tuples_;
+    int64_t next_tuple_idx_;
+  };
+
+  ObjectPool obj_pool_;
+  scoped_ptr<TestEnv> test_env_;
+  TQueryOptions query_options_;
+
+  // Backs the generated tuples and string keys.
+  MemTracker tracker_;
+  MemPool data_pool_;
+  RuntimeProfile profile_;
+
+  // Descriptors of the tuples for the current key type.
+  DescriptorTbl* desc_tbl_;
+
+  int64_t next_query_id_;
+
+  static const char* OperatorName(Operator op) {
+    switch (op) {
+      case AGGREGATION: return "Aggregation";
+      case HASH_JOIN: return "HashJoin";
+      case SORT: return "Sort";
+      case TOP_N: return "TopN";
+      case EXCHANGE: return "Exchange";
+      case LOCAL_EXCHANGE: return "LocalExchange";
+      default: DCHECK(false);
+    }
+    return "";
+  }
+
+  void InitDescriptorTbl(PrimitiveType key_type) {
+    DescriptorTblBuilder builder(&obj_pool_);
+    builder.DeclareTuple() << key_type << TYPE_BIGINT;
+    builder.DeclareTuple() << key_type << TYPE_BIGINT;
+    builder.DeclareTuple() << key_type;
+    builder.DeclareTuple() << key_type << TYPE_BIGINT;
+    desc_tbl_ = builder.Build();
+  }
+
+  // Appends 'num_rows' tuples of 'tuple_desc' to 'tuples'. The keys are drawn uniformly
+  // from [0, cardinality), or are sequential if 'sequential_keys' is true. String keys
+  // are the zero-padded decimal numbers. The payloads are sequential.
+  void GenerateTuples(const TupleDescriptor& tuple_desc, int64_t num_rows,
+      int64_t cardinality, bool sequential_keys, vector<Tuple*>* tuples) {
+    const SlotDescriptor* key_slot = tuple_desc.slots()[0];
+    const SlotDescriptor* payload_slot = tuple_desc.slots()[1];
+    DataProvider provider(&data_pool_, &profile_);
+    vector<DataProvider::ColDesc> cols;
+    cols.push_back(DataProvider::ColDesc::Create<int64_t>(0, cardinality,
+        sequential_keys ? DataProvider::SEQUENTIAL : DataProvider::UNIFORM_RANDOM));
+    cols.push_back(DataProvider::ColDesc::Create<int64_t>(0,
+        numeric_limits<int64_t>::max(), DataProvider::SEQUENTIAL));
+    provider.Reset(num_rows, GENERATOR_BATCH_SIZE, cols);
+
+    tuples->reserve(num_rows);
+    int rows;
+    int64_t* data;
+    while ((data = reinterpret_cast<int64_t*>(provider.NextBatch(&rows))) != NULL) {
+      for (int i = 0; i < rows; ++i) {
+        Tuple* tuple = Tuple::Create(tuple_desc.byte_size(), &data_pool_);
+        int64_t key = data[2 * i];
+        void* key_slot_ptr = tuple->GetSlot(key_slot->tuple_offset());
+        if (key_slot->type().type == TYPE_STRING) {
+          char* ptr = reinterpret_cast<char*>(data_pool_.Allocate(STRING_KEY_LEN));
+          stringstream ss;
+          ss << setw(STRING_KEY_LEN) << setfill('0') << key;
+          memcpy(ptr, ss.str().c_str(), STRING_KEY_LEN);
+          *reinterpret_cast<StringValue*>(key_slot_ptr) =
+              StringValue(ptr, STRING_KEY_LEN);
+        } else {
+          *reinterpret_cast<int64_t*>(key_slot_ptr) = key;
+        }
+        *reinterpret_cast<int64_t*>(tuple->GetSlot(payload_slot->tuple_offset())) =
+            data[2 * i + 1];
+        tuples->push_back(tuple);
+      }
+    }
+  }
+
+  static TExpr MakeSlotRef(SlotId slot_id, const ColumnType& type) {
+    TExprNode node;
+    node.__set_node_type(TExprNodeType::SLOT_REF);
+    node.__set_type(type.ToThrift());
+    node.__set_num_children(0);
+    TSlotRef slot_ref;
+    slot_ref.__set_slot_id(slot_id);
+    node.__set_slot_ref(slot_ref);
+    TExpr expr;
+    expr.nodes.push_back(node);
+    return expr;
+  }
+
+  static TPlanNode MakePlanNode(int node_id, TPlanNodeType::type node_type,
+      const vector<TTupleId>& row_tuples) {
+    TPlanNode tnode;
+    tnode.__set_node_id(node_id);
+    tnode.__set_node_type(node_type);
+    tnode.__set_limit(-1);
+    tnode.__set_row_tuples(row_tuples);
+    tnode.__set_nullable_tuples(vector<bool>(row_tuples.size(), false));
+    return tnode;
+  }
+
+  // Creates and initializes an input node as child of 'parent' that returns 'tuples'.
+  Status AddInputNode(RuntimeState* state, int node_id, TTupleId tuple_id,
+      const vector<Tuple*>* tuples, ExecNode* parent) {
+    // The node type only names the profile of the node.
+    TPlanNode tnode = MakePlanNode(node_id, TPlanNodeType::EMPTY_SET_NODE,
+        vector<TTupleId>(1, tuple_id));
+    ObjectPool* pool = state->obj_pool();
+    ExecNode* node = pool->Add(new InputNode(pool, tnode, *desc_tbl_, tuples));
+    RETURN_IF_ERROR(node->Init(tnode, state));
+    parent->children_.push_back(node);
+    return Status::OK();
+  }
+
+  // Creates and initializes the plan that runs 'op' on 'input' in 'root'.
+  Status CreatePlan(Operator op, const ColumnType& key_type, const Input& input,
+      RuntimeState* state, ExecNode** root) {
+    ObjectPool* pool = state->obj_pool();
+    TPlanNode tnode;
+    switch (op) {
+      case AGGREGATION: {
+        tnode = MakePlanNode(ROOT_NODE_ID, TPlanNodeType::AGGREGATION_NODE,
+            vector<TTupleId>(1, AGG_TUPLE));
+        TAggregationNode agg_node;
+        agg_node.__set_grouping_exprs(
+            vector<TExpr>(1, MakeSlotRef(INPUT_KEY_SLOT, key_type)));
+        agg_node.__set_aggregate_functions(vector<TExpr>());
+        agg_node.__set_intermediate_tuple_id(AGG_TUPLE);
+        agg_node.__set_output_tuple_id(AGG_TUPLE);
+        agg_node.__set_need_finalize(true);
+        agg_node.__set_use_streaming_preaggregation(false);
+        agg_node.__set_estimated_input_cardinality(input.tuples.size());
+        tnode.__set_agg_node(agg_node);
+        *root = pool->Add(new PartitionedAggregationNode(pool, tnode, *desc_tbl_));
+        break;
+      }
+      case HASH_JOIN: {
+        vector<TTupleId> row_tuples;
+        row_tuples.push_back(INPUT_TUPLE);
+        row_tuples.push_back(BUILD_TUPLE);
+        tnode = MakePlanNode(ROOT_NODE_ID, TPlanNodeType::HASH_JOIN_NODE, row_tuples);
+        TEqJoinCondition eq_join_conjunct;
+        eq_join_conjunct.__set_left(MakeSlotRef(INPUT_KEY_SLOT, key_type));
+        eq_join_conjunct.__set_right(MakeSlotRef(BUILD_KEY_SLOT, key_type));
+        eq_join_conjunct.__set_is_not_distinct_from(false);
+        THashJoinNode hash_join_node;
+        hash_join_node.__set_join_op(TJoinOp::INNER_JOIN);
+        hash_join_node.__set_eq_join_conjuncts(
+            vector<TEqJoinCondition>(1, eq_join_conjunct));
+        tnode.__set_hash_join_node(hash_join_node);
+        *root = pool->Add(new PartitionedHashJoinNode(pool, tnode, *desc_tbl_));
+        break;
+      }
+      case SORT:
+      case TOP_N: {
+        tnode = MakePlanNode(ROOT_NODE_ID, TPlanNodeType::SORT_NODE,
+            vector<TTupleId>(1, SORT_TUPLE));
+        TSortInfo sort_info;
+        sort_info.__set_ordering_exprs(
+            vector<TExpr>(1, MakeSlotRef(SORT_KEY_SLOT, key_type)));
+        sort_info.__set_is_asc_order(vector<bool>(1, true));
+        sort_info.__set_nulls_first(vector<bool>(1, false));
+        vector<TExpr> sort_tuple_slot_exprs;
+        sort_tuple_slot_exprs.push_back(MakeSlotRef(INPUT_KEY_SLOT, key_type));
+        sort_tuple_slot_exprs.push_back(MakeSlotRef(INPUT_PAYLOAD_SLOT, TYPE_BIGINT));
+        sort_info.__set_sort_tuple_slot_exprs(sort_tuple_slot_exprs);
+        TSortNode sort_node;
+        sort_node.__set_sort_info(sort_info);
+        sort_node.__set_use_top_n(op == TOP_N);
+        tnode.__set_sort_node(sort_node);
+        if (op == TOP_N) {
+          tnode.__set_limit(FLAGS_top_n_limit);
+          *root = pool->Add(new TopNNode(pool, tnode, *desc_tbl_));
+        } else {
+          *root = pool->Add(new SortNode(pool, tnode, *desc_tbl_));
+        }
+        break;
+      }
+      case EXCHANGE:
+      case LOCAL_EXCHANGE: {
+        tnode = MakePlanNode(ROOT_NODE_ID, TPlanNodeType::EXCHANGE_NODE,
+            vector<TTupleId>(1, INPUT_TUPLE));
+        TExchangeNode exchange_node;
+        exchange_node.__set_input_row_tuples(vector<TTupleId>(1, INPUT_TUPLE));
+        tnode.__set_exchange_node(exchange_node);
+        ExchangeNode* exchange_node_ptr =
+            pool->Add(new ExchangeNode(pool, tnode, *desc_tbl_));
+        exchange_node_ptr->set_num_senders(1);
+        *root = exchange_node_ptr;
+        break;
+      }
+      default:
+        DCHECK(false);
+    }
+    RETURN_IF_ERROR((*root)->Init(tnode, state));
+    if (op == EXCHANGE || op == LOCAL_EXCHANGE) return Status::OK();
+    RETURN_IF_ERROR(AddInputNode(state, ROOT_NODE_ID + 1, INPUT_TUPLE, &input.tuples,
+        *root));
+    if (op != HASH_JOIN) return Status::OK();
+    return AddInputNode(state, ROOT_NODE_ID + 2, BUILD_TUPLE, &input.build_tuples,
+        *root);
+  }
+
+  // Sends 'tuples' to the exchange node of 'state' in batches, like a single
+  // DataStreamSender would. The batches are serialized unless 'local' is true.
+  void SendBatches(RuntimeState* state, const vector<Tuple*>* tuples, bool local,
+      Status* status) {
+    const TUniqueId& instance_id = state->fragment_instance_id();
+    RowDescriptor row_desc(*desc_tbl_, vector<TTupleId>(1, INPUT_TUPLE),
+        vector<bool>(1, false));
+    MemTracker tracker;
+    RowBatch batch(row_desc, state->batch_size(), &tracker);
+    TRowBatch thrift_batch;
+    for (int64_t i = 0; i < tuples->size() && status->ok();) {
+      int num_rows = min<int64_t>(batch.capacity(), tuples->size() - i);
+      int row_idx = batch.AddRows(num_rows);
+      for (int j = 0; j < num_rows; ++j) {
+        batch.GetRow(row_idx + j)->SetTuple(0, (*tuples)[i++]);
+      }
+      batch.CommitRows(num_rows);
+      if (local) {
+        *status = state->stream_mgr()->AddData(instance_id, ROOT_NODE_ID, &batch, 0);
+      } else {
+        *status = batch.Serialize(&thrift_batch);
+        if (status->ok()) {
+          *status = state->stream_mgr()->AddData(instance_id, ROOT_NODE_ID,
+              thrift_batch, 0);
+        }
+      }
+      batch.Reset();
+    }
+    Status close_status = state->stream_mgr()->CloseSender(instance_id, ROOT_NODE_ID, 0);
+    if (status->ok()) *status = close_status;
+  }
+
+  // Runs 'op' on 'input' once. Returns the time spent in Open() and GetNext() of the
+  // operator in 'elapsed_ns'.
+  Status RunOnce(Operator op, const ColumnType& key_type, const Input& input,
+      int64_t* elapsed_ns) {
+    RuntimeState* state;
+    RETURN_IF_ERROR(test_env_->CreateQueryState(next_query_id_++, -1, BLOCK_SIZE,
+        query_options_, &state));
+    state->set_desc_tbl(desc_tbl_);
+    ExecNode* root = NULL;
+    Status status = CreatePlan(op, key_type, input, state, &root);
+    if (status.ok()) status = root->Prepare(state);
+    if (status.ok() && state->codegen_created()) {
+      LlvmCodeGen* codegen;
+      status = state->GetCodegen(&codegen, /* initialize */ false);
+      if (status.ok()) status = codegen->FinalizeModule();
+    }
+
+    scoped_ptr<Thread> sender;
+    Status sender_status;
+    if (status.ok()) {
+      MonotonicStopWatch timer;
+      timer.Start();
+      if (op == EXCHANGE || op == LOCAL_EXCHANGE) {
+        sender.reset(new Thread("exec-node-benchmark", "sender",
+            &ExecNodeBenchmark::SendBatches, this, state, &input.tuples,
+            op == LOCAL_EXCHANGE, &sender_status));
+      }
+      status = root->Open(state);
+      RowBatch batch(root->row_desc(), state->batch_size(),
+          state->instance_mem_tracker());
+      bool eos = false;
+      while (status.ok() && !eos) {
+        status = root->GetNext(state, &batch, &eos);
+        batch.Reset();
+      }
+      timer.Stop();
+      *elapsed_ns = timer.ElapsedTime();
+    }
+    // Closing the exchange node closes its receiver, which unblocks the sender if the
+    // node failed.
+    if (root != NULL) root->Close(state);
+    if (sender != NULL) sender->Join();
+    test_env_->TearDownQueryStates();
+    RETURN_IF_ERROR(status);
+    return sender_status;
+  }
+
+  // Runs 'op' --num_iterations times and prints the result of the fastest run.
+  Status Measure(Operator op, PrimitiveType key_type, int64_t cardinality,
+      const Input& input) {
+    int64_t min_elapsed_ns = numeric_limits<int64_t>::max();
+    for (int i = 0; i < FLAGS_num_iterations; ++i) {
+      int64_t elapsed_ns;
+      RETURN_IF_ERROR(RunOnce(op, key_type, input, &elapsed_ns));
+      min_elapsed_ns = min(min_elapsed_ns, elapsed_ns);
+    }
+    int64_t input_rows = input.tuples.size();
+    if (op == HASH_JOIN) input_rows += input.build_tuples.size();
+    double elapsed_ms = max<double>(min_elapsed_ns, 1) / 1000000;
+    double rows_per_sec = input_rows * 1000 / elapsed_ms;
+    double cycles_per_row = elapsed_ms * CpuInfo::cycles_per_ms() / input_rows;
+    cout << setw(16) << left << OperatorName(op)
+         << setw(8) << (key_type == TYPE_STRING ? "STRING" : "BIGINT") << right
+         << setw(14) << cardinality << setw(16) << fixed << setprecision(0)
+         << rows_per_sec << setw(14) << setprecision(1) << cycles_per_row << endl;
+    return Status::OK();
+  }
+};
+
+}
+
+int main(int argc, char** argv) {
+  impala::InitCommonRuntime(argc, argv, false, impala::TestInfo::BE_TEST);
+  impala::LlvmCodeGen::InitializeLlvm();
+  cout << impala::Benchmark::GetMachineInfo() << endl;
+  impala::ExecNodeBenchmark benchmark;
+  impala::Status status = benchmark.RunAll();
+  if (!status.ok()) {
+    cerr << status.GetDetail() << endl;
+    return 1;
+  }
+  return 0;
+}
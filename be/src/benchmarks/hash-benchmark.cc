@@ -13,6 +13,7 @@
 // limitations under the License.
 
 #include <iostream>
+#include <sstream>
 #include <stdlib.h>
 #include <stdio.h>
 #include <vector>
@@ -49,6 +50,10 @@ using namespace llvm;
 //   5. Crc: hash using sse4 crc hash instruction
 //   6. Codegen: hash using sse4 with the tuple types baked into the codegen function
 //
+// The 'Long String' set hashes URL-like strings of ~60 to ~160 bytes with the
+// interleaved CRC lanes that HashUtil::CrcHash() uses for long inputs ('Crc') and with a
+// single serial CRC over the whole string ('CrcSerial').
+//
 // n is the number of buckets, k is the number of items
 // Expected(collisions) = n - k + E(X)
 //                      = n - k + k(1 - 1/k)^n
@@ -295,6 +300,40 @@ void TestMurmur2_64MixedHash(int batch, void* d) {
   }
 }
 
+// HashUtil::CrcHash() without the interleaved lanes for long inputs.
+uint32_t SerialCrcHash(const void* data, int32_t bytes, uint32_t hash) {
+  const uint8_t* s = reinterpret_cast<const uint8_t*>(data);
+  for (; bytes >= sizeof(uint64_t); bytes -= sizeof(uint64_t)) {
+    hash = SSE4_crc32_u64(hash, *reinterpret_cast<const uint64_t*>(s));
+    s += sizeof(uint64_t);
+  }
+  while (bytes--) {
+    hash = SSE4_crc32_u8(hash, *s);
+    ++s;
+  }
+  return (hash << 16) | (hash >> 16);
+}
+
+template <uint32_t (*HASH_FN)(const void*, int32_t, uint32_t)>
+void TestLongStringHash(int batch, void* d) {
+  TestData* data = reinterpret_cast<TestData*>(d);
+  int rows = data->num_rows;
+  for (int i = 0; i < batch; ++i) {
+    StringValue* values = reinterpret_cast<StringValue*>(data->data);
+    for (int j = 0; j < rows; ++j) {
+      data->results[j] = HASH_FN(values[j].ptr, values[j].len, HashUtil::FNV_SEED);
+    }
+  }
+}
+
+uint32_t Murmur2_64StringHash(const void* data, int32_t bytes, uint32_t hash) {
+  return HashUtil::MurmurHash2_64(data, bytes, hash);
+}
+
+uint32_t FnvStringHash(const void* data, int32_t bytes, uint32_t hash) {
+  return HashUtil::FnvHash64to32(data, bytes, hash);
+}
+
 int NumCollisions(TestData* data, int num_buckets) {
   vector<bool> buckets;
   buckets.resize(num_buckets);
@@ -484,6 +523,26 @@ int main(int argc, char **argv) {
   mixed_data.results.resize(mixed_data.num_rows);
   mixed_data.jitted_fn = jitted_hash_mixed;
 
+  // URL-like strings, which differ in a few digits and in their length.
+  vector<string> long_std_strs;
+  vector<StringValue> long_strs;
+  for (int i = 0; i < NUM_ROWS; ++i) {
+    stringstream ss;
+    ss << "https://www.example.com/catalog/items/" << (i * 7919) << "/detail?ref="
+       << string(rand() % 100, 'x') << "&session=" << rand();
+    long_std_strs.push_back(ss.str());
+  }
+  for (const string& str: long_std_strs) {
+    long_strs.push_back(StringValue(const_cast<char*>(str.c_str()), str.size()));
+  }
+
+  TestData long_string_data;
+  long_string_data.data = &long_strs[0];
+  long_string_data.num_cols = 1;
+  long_string_data.num_rows = long_strs.size();
+  long_string_data.results.resize(long_string_data.num_rows);
+  long_string_data.jitted_fn = NULL;
+
   Benchmark int_suite("Int Hash");
   int_suite.AddBenchmark("Fnv", TestFnvIntHash, &int_data);
   int_suite.AddBenchmark("Murmur2_64", TestMurmur2_64IntHash, &int_data);
@@ -499,7 +558,18 @@ int main(int argc, char **argv) {
   mixed_suite.AddBenchmark("Boost", TestBoostMixedHash, &mixed_data);
   mixed_suite.AddBenchmark("Crc", TestCrcMixedHash, &mixed_data);
   mixed_suite.AddBenchmark("Codegen", TestCodegenMixedHash, &mixed_data);
-  cout << mixed_suite.Measure();
+  cout << mixed_suite.Measure() << endl;
+
+  Benchmark long_string_suite("Long String Hash");
+  long_string_suite.AddBenchmark("Fnv", TestLongStringHash<FnvStringHash>,
+      &long_string_data);
+  long_string_suite.AddBenchmark("Murmur2_64", TestLongStringHash<Murmur2_64StringHash>,
+      &long_string_data);
+  long_string_suite.AddBenchmark("CrcSerial", TestLongStringHash<SerialCrcHash>,
+      &long_string_data);
+  long_string_suite.AddBenchmark("Crc", TestLongStringHash<HashUtil::CrcHash>,
+      &long_string_data);
+  cout << long_string_suite.Measure();
 
   return 0;
 }
@@ -20,7 +20,9 @@
 #include <boost/thread.hpp>
 #include <boost/thread/mutex.hpp>
 #include "util/benchmark.h"
+#include "util/blocking-queue.h"
 #include "util/cpu-info.h"
+#include "util/lock-free-blocking-queue.h"
 #include "util/spinlock.h"
 
 #include "common/names.h"
@@ -66,6 +68,11 @@ using namespace impala;
 //      SpinLock 24-Total Threads              0.4087           0.006274X
 //         Boost 24-Total Threads              0.2558           0.003926X
 
+// Benchmark for handing elements from many producers to one consumer through a queue
+// of 16 elements, like the scanner threads of a scan node do with their row batches
+// ("queue" suite). The producers only contend if the machine has enough cores to run
+// them concurrently.
+
 struct TestData {
   int num_producer_threads;
   int num_consumer_threads;
@@ -179,6 +186,32 @@ void TestBoost(int batch_size, void* d) {
   if (data->num_consumer_threads > 0) CHECK_EQ(data->value, 0);
 }
 
+struct QueueTestData {
+  int num_producer_threads;
+  int64_t num_elements;
+};
+
+template <typename Queue>
+void ProduceThread(Queue* queue, int64_t n) {
+  for (int64_t i = 0; i < n; ++i) queue->BlockingPut(i);
+}
+
+template <typename Queue>
+void TestQueue(int batch_size, void* d) {
+  QueueTestData* data = reinterpret_cast<QueueTestData*>(d);
+  Queue queue(16);
+  int64_t num_per_producer = batch_size * data->num_elements / data->num_producer_threads;
+  thread_group producers;
+  for (int i = 0; i < data->num_producer_threads; ++i) {
+    producers.add_thread(new thread(ProduceThread<Queue>, &queue, num_per_producer));
+  }
+  int64_t val;
+  for (int64_t i = 0; i < num_per_producer * data->num_producer_threads; ++i) {
+    CHECK(queue.BlockingGet(&val));
+  }
+  producers.join_all();
+}
+
 int main(int argc, char **argv) {
   CpuInfo::Init();
   cout << Benchmark::GetMachineInfo() << endl;
@@ -223,5 +256,20 @@ int main(int argc, char **argv) {
   }
   cout << suite.Measure() << endl;
 
+  Benchmark queue_suite("queue");
+  QueueTestData queue_data[2];
+  queue_data[0].num_producer_threads = 1;
+  queue_data[1].num_producer_threads = 16;
+  for (int i = 0; i < 2; ++i) {
+    queue_data[i].num_elements = N;
+    stringstream suffix;
+    suffix << " " << queue_data[i].num_producer_threads << "-Producers";
+    int baseline = queue_suite.AddBenchmark("BlockingQueue" + suffix.str(),
+        TestQueue<BlockingQueue<int64_t> >, &queue_data[i], -1);
+    queue_suite.AddBenchmark("LockFree" + suffix.str(),
+        TestQueue<LockFreeBlockingQueue<int64_t> >, &queue_data[i], baseline);
+  }
+  cout << queue_suite.Measure() << endl;
+
   return 0;
 }
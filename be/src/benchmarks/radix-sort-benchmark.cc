@@ -0,0 +1,97 @@
+// Copyright 2016 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+#include "util/benchmark.h"
+#include "util/cpu-info.h"
+#include "util/radix-sort.h"
+
+#include "common/names.h"
+
+using namespace impala;
+
+// Compares sorting the permutation of 64K normalized keys, like the in-memory sort of
+// the Sorter does, with a comparison sort and with RadixSort. The keys have 'key_len'
+// bytes of which the last 'random_bytes' are random, e.g. a nullable INT key has 5
+// bytes of which 4 are random.
+//
+// Sorting 1M fully random keys, radix sort was about 7x faster than std::sort for 5-byte
+// keys, 3x for 9-byte keys and only 1.2x for 16-byte keys.
+
+struct TestData {
+  TestData(int key_len, int random_bytes, int num_keys)
+    : key_len(key_len), keys(key_len * num_keys, 0), order(num_keys), tmp(num_keys) {
+    for (int i = 0; i < num_keys; ++i) {
+      for (int b = key_len - random_bytes; b < key_len; ++b) {
+        keys[i * key_len + b] = rand() % 256;
+      }
+    }
+  }
+
+  bool Less(uint32_t lhs, uint32_t rhs) const {
+    return memcmp(&keys[lhs * key_len], &keys[rhs * key_len], key_len) < 0;
+  }
+
+  int key_len;
+  vector<uint8_t> keys;
+  vector<uint32_t> order;
+  vector<uint32_t> tmp;
+};
+
+struct KeyLess {
+  KeyLess(const TestData* data) : data(data) { }
+  bool operator()(uint32_t lhs, uint32_t rhs) const { return data->Less(lhs, rhs); }
+  const TestData* data;
+};
+
+void TestComparisonSort(int batch_size, void* d) {
+  TestData* data = reinterpret_cast<TestData*>(d);
+  for (int i = 0; i < batch_size; ++i) {
+    for (int j = 0; j < data->order.size(); ++j) data->order[j] = j;
+    sort(data->order.begin(), data->order.end(), KeyLess(data));
+  }
+}
+
+void TestRadixSort(int batch_size, void* d) {
+  TestData* data = reinterpret_cast<TestData*>(d);
+  for (int i = 0; i < batch_size; ++i) {
+    RadixSort::SortKeys(&data->keys[0], data->key_len, data->order.size(),
+        &data->order[0], &data->tmp[0]);
+  }
+}
+
+int main(int argc, char **argv) {
+  CpuInfo::Init();
+  cout << endl << Benchmark::GetMachineInfo() << endl;
+
+  const int NUM_KEYS = 64 * 1024;
+  int key_lens[] = { 5, 9, 16 };
+  int random_bytes[] = { 4, 8, 16 };
+  char name[120];
+  for (int i = 0; i < 3; ++i) {
+    TestData* data = new TestData(key_lens[i], random_bytes[i], NUM_KEYS);
+    snprintf(name, sizeof(name), "key_len=%d", key_lens[i]);
+    Benchmark suite(name);
+    suite.AddBenchmark("comparison sort", TestComparisonSort, data);
+    suite.AddBenchmark("radix sort", TestRadixSort, data);
+    cout << suite.Measure() << endl;
+  }
+  return 0;
+}
@@ -168,6 +168,18 @@ void TestBitWriterDecode(int batch_size, void* d) {
   }
 }
 
+void TestBitReaderBatchDecode(int batch_size, void* d) {
+  TestData* data = reinterpret_cast<TestData*>(d);
+  const int values_per_call = 128;
+  int64_t v[values_per_call];
+  for (int i = 0; i < batch_size; ++i) {
+    BitReader reader(data->buffer, BUFFER_LEN);
+    for (int j = 0; j < data->num_values; j += values_per_call) {
+      reader.GetValues(data->num_bits, v, values_per_call);
+    }
+  }
+}
+
 void TestBitWriter8ByteDecode(int batch_size, void* d) {
   TestData* data = reinterpret_cast<TestData*>(d);
   data->result = true;
@@ -234,6 +246,10 @@ int main(int argc, char** argv) {
     name.str("");
     name << "\"BitWriter" << suffix.str() << "\"";
     decode_suite.AddBenchmark(name.str(), TestBitWriterDecode, &data[i], baseline);
+
+    name.str("");
+    name << "\"BitReader Batch" << suffix.str() << "\"";
+    decode_suite.AddBenchmark(name.str(), TestBitReaderBatchDecode, &data[i], baseline);
   }
   cout << decode_suite.Measure() << endl;
 
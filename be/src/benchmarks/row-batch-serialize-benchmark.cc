@@ -51,6 +51,9 @@
 //                      ser_dups               19.55              1.015X
 //                 ser_dups_full                32.4              1.682X
 //
+// The "codecs" suites compare serializing and deserializing the same batch with each
+// codec that --row_batch_compression_codec accepts.
+//
 // deserialize:          Function     Rate (iters/ms)          Comparison
 // ----------------------------------------------------------------------
 //        deser_no_dups_baseline               64.94                  1X
@@ -269,13 +272,14 @@ class RowBatchSerializeBenchmark {
   struct SerializeArgs {
     RowBatch* batch;
     bool full_dedup;
+    THdfsCompression::type compression_type;
   };
 
   static void TestSerialize(int batch_size, void* data) {
     SerializeArgs* args = reinterpret_cast<SerializeArgs*>(data);
     for (int iter = 0; iter < batch_size; ++iter) {
       TRowBatch trow_batch;
-      args->batch->Serialize(&trow_batch, args->full_dedup);
+      args->batch->Serialize(&trow_batch, args->full_dedup, args->compression_type);
     }
   }
 
@@ -345,16 +349,19 @@ class RowBatchSerializeBenchmark {
     Benchmark ser_suite("serialize");
     baseline = ser_suite.AddBenchmark("ser_no_dups_baseline", TestSerializeBaseline,
         no_dup_batch, -1);
-    struct SerializeArgs no_dup_ser_args = { no_dup_batch, false };
-    struct SerializeArgs no_dup_ser_full_args = { no_dup_batch, true };
+    struct SerializeArgs no_dup_ser_args = { no_dup_batch, false, THdfsCompression::LZ4 };
+    struct SerializeArgs no_dup_ser_full_args =
+        { no_dup_batch, true, THdfsCompression::LZ4 };
     ser_suite.AddBenchmark("ser_no_dups", TestSerialize, &no_dup_ser_args, baseline);
     ser_suite.AddBenchmark("ser_no_dups_full",
         TestSerialize, &no_dup_ser_full_args, baseline);
 
     baseline = ser_suite.AddBenchmark("ser_adjacent_dups_baseline",
         TestSerializeBaseline, adjacent_dup_batch, -1);
-    struct SerializeArgs adjacent_dup_ser_args = { adjacent_dup_batch, false };
-    struct SerializeArgs adjacent_dup_ser_full_args = { adjacent_dup_batch, true };
+    struct SerializeArgs adjacent_dup_ser_args =
+        { adjacent_dup_batch, false, THdfsCompression::LZ4 };
+    struct SerializeArgs adjacent_dup_ser_full_args =
+        { adjacent_dup_batch, true, THdfsCompression::LZ4 };
     ser_suite.AddBenchmark("ser_adjacent_dups",
         TestSerialize, &adjacent_dup_ser_args, baseline);
     ser_suite.AddBenchmark("ser_adjacent_dups_full",
@@ -362,8 +369,8 @@ class RowBatchSerializeBenchmark {
 
     baseline = ser_suite.AddBenchmark("ser_dups_baseline",
         TestSerializeBaseline, dup_batch, -1);
-    struct SerializeArgs dup_ser_args = { dup_batch, false };
-    struct SerializeArgs dup_ser_full_args = { dup_batch, true };
+    struct SerializeArgs dup_ser_args = { dup_batch, false, THdfsCompression::LZ4 };
+    struct SerializeArgs dup_ser_full_args = { dup_batch, true, THdfsCompression::LZ4 };
     ser_suite.AddBenchmark("ser_dups", TestSerialize, &dup_ser_args, baseline);
     ser_suite.AddBenchmark("ser_dups_full", TestSerialize, &dup_ser_full_args, baseline);
 
@@ -389,6 +396,38 @@ class RowBatchSerializeBenchmark {
     deser_suite.AddBenchmark("deser_dups", TestDeserialize, &dup_deser_args, baseline);
 
     cout << deser_suite.Measure() << endl;
+
+    // The adjacent duplicates batch is the one whose tuple data compresses.
+    const THdfsCompression::type codecs[] =
+        { THdfsCompression::NONE, THdfsCompression::LZ4, THdfsCompression::SNAPPY };
+    const char* codec_names[] = { "none", "lz4", "snappy" };
+    const int num_codecs = sizeof(codecs) / sizeof(codecs[0]);
+    SerializeArgs codec_ser_args[num_codecs];
+    TRowBatch codec_tbatches[num_codecs];
+    DeserializeArgs codec_deser_args[num_codecs];
+    Benchmark codec_ser_suite("serialize codecs");
+    Benchmark codec_deser_suite("deserialize codecs");
+    int ser_baseline = -1;
+    int deser_baseline = -1;
+    for (int i = 0; i < num_codecs; ++i) {
+      string name = codec_names[i];
+      SerializeArgs ser_args = { adjacent_dup_batch, false, codecs[i] };
+      codec_ser_args[i] = ser_args;
+      int idx = codec_ser_suite.AddBenchmark("ser_" + name, TestSerialize,
+          &codec_ser_args[i], ser_baseline);
+      if (ser_baseline == -1) ser_baseline = idx;
+
+      adjacent_dup_batch->Serialize(&codec_tbatches[i], false, codecs[i]);
+      cout << name << " serialized size: " << codec_tbatches[i].tuple_data.size()
+           << " of " << codec_tbatches[i].uncompressed_size << " bytes" << endl;
+      DeserializeArgs deser_args = { &codec_tbatches[i], &row_desc, &tracker };
+      codec_deser_args[i] = deser_args;
+      idx = codec_deser_suite.AddBenchmark("deser_" + name, TestDeserialize,
+          &codec_deser_args[i], deser_baseline);
+      if (deser_baseline == -1) deser_baseline = idx;
+    }
+    cout << codec_ser_suite.Measure() << endl;
+    cout << codec_deser_suite.Measure() << endl;
   }
 };
 
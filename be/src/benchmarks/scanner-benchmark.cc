@@ -0,0 +1,678 @@
+// Copyright 2016 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdlib.h>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <boost/algorithm/string.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <gflags/gflags.h>
+
+#include "codegen/llvm-codegen.h"
+#include "common/init.h"
+#include "common/object-pool.h"
+#include "exec/delimited-text-parser.inline.h"
+#include "exec/hdfs-avro-scanner.h"
+#include "exec/parquet-common.h"
+#include "exec/read-write-util.h"
+#include "exec/text-converter.h"
+#include "gutil/bits.h"
+#include "gutil/strings/split.h"
+#include "gutil/strings/substitute.h"
+#include "runtime/descriptors.h"
+#include "runtime/mem-pool.h"
+#include "runtime/mem-tracker.h"
+#include "runtime/string-value.h"
+#include "runtime/tuple.h"
+#include "testutil/desc-tbl-builder.h"
+#include "util/benchmark.h"
+#include "util/codec.h"
+#include "util/cpu-info.h"
+#include "util/dict-encoding.h"
+#include "util/rle-encoding.h"
+#include "util/stopwatch.h"
+#include "util/test-info.h"
+
+#include "common/names.h"
+
+using boost::algorithm::to_lower_copy;
+using std::numeric_limits;
+using std::right;
+using strings::Substitute;
+
+// Benchmark of the decoding work that the Parquet, text and Avro scanners do per row.
+// The benchmark generates files of each format in memory and decodes them into tuples
+// with the same functions the scanners use, without a scan node, DiskIoMgr or HDFS:
+//   - Text: DelimitedTextParser finds the fields and TextConverter writes the slots,
+//     either interpreted or with the codegen'd WriteSlot() functions.
+//   - Parquet: pages with RLE encoded repetition and definition levels and PLAIN or
+//     PLAIN_DICTIONARY encoded values, optionally compressed. Nested columns are
+//     simulated with --nesting_depth levels of collections of --collection_size items.
+//   - Avro: blocks of records with a nullable union per field, optionally compressed,
+//     decoded with HdfsAvroScanner's ReadAvro*() functions.
+// Each file has --num_rows rows of NUM_COLS columns of the same type, each with
+// --cardinality distinct values and --null_percent NULLs.
+//
+// The benchmark reports the rows decoded per second and the bytes of the (compressed)
+// file decoded per second by the fastest of --num_iterations runs. Only text supports
+// codegen per column here: the Avro scanner codegens whole records and the Parquet
+// scanner does not codegen its decoding.
+//
+// Example: scanner-benchmark --num_rows=10000000 --codecs=none,snappy,gzip
+
+DEFINE_int32(num_rows, 1000000, "Number of rows of each generated file.");
+DEFINE_int32(cardinality, 1000, "Number of distinct values of each column.");
+DEFINE_int32(null_percent, 10, "Percentage of NULL values of each column.");
+DEFINE_string(codecs, "none,snappy", "Comma-separated list of the codecs of the Parquet "
+    "pages and Avro blocks. Valid values are 'none', 'snappy', 'gzip' and 'lz4'.");
+DEFINE_int32(nesting_depth, 0, "Number of levels of collections that the Parquet "
+    "columns are nested in.");
+DEFINE_int32(collection_size, 10, "Number of items of each collection of nested "
+    "Parquet columns.");
+DEFINE_int32(num_iterations, 3, "Number of runs of each benchmark. The fastest run is "
+    "reported.");
+
+namespace impala {
+
+class ScannerBenchmark {
+ public:
+  ScannerBenchmark() : pool_(&tracker_), tuple_desc_(NULL) {}
+
+  ~ScannerBenchmark() {
+    pool_.FreeAll();
+  }
+
+  // Runs all benchmarks and prints their results to stdout.
+  Status RunAll() {
+    vector<pair<string, THdfsCompression::type> > codecs;
+    RETURN_IF_ERROR(ParseCodecs(&codecs));
+    cout << setw(10) << left << "Format" << setw(9) << "Type" << setw(13) << "Variant"
+         << setw(8) << "Codec" << right << setw(14) << "Rows/sec"
+         << setw(12) << "MB/sec" << endl;
+    cout << string(66, '-') << endl;
+    for (PrimitiveType type: {TYPE_INT, TYPE_BIGINT, TYPE_DOUBLE, TYPE_STRING}) {
+      type_ = type;
+      Init();
+      RETURN_IF_ERROR(MeasureText(false));
+      RETURN_IF_ERROR(MeasureText(true));
+      for (const pair<string, THdfsCompression::type>& codec: codecs) {
+        RETURN_IF_ERROR(MeasureParquet(false, codec.first, codec.second));
+        RETURN_IF_ERROR(MeasureParquet(true, codec.first, codec.second));
+        RETURN_IF_ERROR(MeasureAvro(codec.first, codec.second));
+      }
+      pool_.FreeAll();
+    }
+    return Status::OK();
+  }
+
+ private:
+  static const int NUM_COLS = 4;
+
+  // Number of rows that the text parser returns at a time, like the text scanner.
+  static const int TEXT_BATCH_SIZE = 1024;
+
+  // Number of values of a Parquet page and of rows of an Avro block.
+  static const int PAGE_SIZE = 8192;
+
+  // Dictionaries of Parquet columns can have at most this many entries.
+  static const int MAX_DICT_ENTRIES = 1 << 16;
+
+  static const char* NULL_TEXT;
+
+  // A Parquet data page or an Avro block.
+  struct Page {
+    int num_values;
+    int uncompressed_len;
+
+    // Compressed, unless the codec is NONE.
+    vector<uint8_t> data;
+  };
+
+  // A Parquet column chunk.
+  struct ParquetColumn {
+    // The plain encoded dictionary page. Empty if the values are plain encoded.
+    vector<uint8_t> dict;
+    vector<Page> pages;
+  };
+
+  ObjectPool obj_pool_;
+  MemTracker tracker_;
+
+  // Backs the string values and the tuples.
+  MemPool pool_;
+
+  // The type of all columns of the current files.
+  PrimitiveType type_;
+  TupleDescriptor* tuple_desc_;
+
+  // The distinct values of the columns, typed and as text.
+  vector<int64_t> int_values_;
+  vector<double> double_values_;
+  vector<StringValue> string_values_;
+  vector<string> text_values_;
+
+  // The index into the distinct values of each row of each column, or -1 for NULL.
+  vector<int> value_idxs_[NUM_COLS];
+
+  // Storage for the tuples of a page or a batch of rows, which the benchmarks reuse.
+  uint8_t* tuple_mem_;
+
+  static Status ParseCodecs(vector<pair<string, THdfsCompression::type> >* codecs) {
+    for (const string& name: strings::Split(FLAGS_codecs, ",", strings::SkipEmpty())) {
+      string codec = to_lower_copy(name);
+      if (codec == "none") {
+        codecs->push_back(make_pair(codec, THdfsCompression::NONE));
+      } else if (codec == "snappy") {
+        codecs->push_back(make_pair(codec, THdfsCompression::SNAPPY));
+      } else if (codec == "gzip") {
+        codecs->push_back(make_pair(codec, THdfsCompression::GZIP));
+      } else if (codec == "lz4") {
+        codecs->push_back(make_pair(codec, THdfsCompression::LZ4));
+      } else {
+        return Status(Substitute("Invalid codec: '$0'", name));
+      }
+    }
+    return Status::OK();
+  }
+
+  // Generates the distinct values of type_ and the values of the columns.
+  void Init() {
+    DescriptorTblBuilder builder(&obj_pool_);
+    TupleDescBuilder& tuple_builder = builder.DeclareTuple();
+    for (int i = 0; i < NUM_COLS; ++i) tuple_builder << type_;
+    tuple_desc_ = builder.Build()->GetTupleDescriptor(0);
+    tuple_mem_ = pool_.Allocate(PAGE_SIZE * tuple_desc_->byte_size());
+
+    srand(0);
+    int_values_.clear();
+    double_values_.clear();
+    string_values_.clear();
+    text_values_.clear();
+    for (int i = 0; i < FLAGS_cardinality; ++i) {
+      stringstream text;
+      switch (type_) {
+        case TYPE_INT:
+          int_values_.push_back(rand() - RAND_MAX / 2);
+          text << int_values_.back();
+          break;
+        case TYPE_BIGINT:
+          int_values_.push_back((static_cast<int64_t>(rand()) << 32) ^ rand());
+          text << int_values_.back();
+          break;
+        case TYPE_DOUBLE:
+          double_values_.push_back(static_cast<double>(rand()) / (rand() + 1));
+          text << setprecision(numeric_limits<double>::digits10) << double_values_.back();
+          break;
+        case TYPE_STRING: {
+          int len = 4 + rand() % 28;
+          char* ptr = reinterpret_cast<char*>(pool_.Allocate(len));
+          for (int j = 0; j < len; ++j) ptr[j] = 'a' + rand() % 26;
+          string_values_.push_back(StringValue(ptr, len));
+          text << string(ptr, len);
+          break;
+        }
+        default:
+          DCHECK(false);
+      }
+      text_values_.push_back(text.str());
+    }
+    for (int i = 0; i < NUM_COLS; ++i) {
+      value_idxs_[i].resize(FLAGS_num_rows);
+      for (int j = 0; j < FLAGS_num_rows; ++j) {
+        value_idxs_[i][j] =
+            rand() % 100 < FLAGS_null_percent ? -1 : rand() % FLAGS_cardinality;
+      }
+    }
+  }
+
+  Tuple* GetTuple(int idx) {
+    return reinterpret_cast<Tuple*>(tuple_mem_ + idx * tuple_desc_->byte_size());
+  }
+
+  void ResetTuples() {
+    memset(tuple_mem_, 0, PAGE_SIZE * tuple_desc_->byte_size());
+  }
+
+  void GetValue(int idx, int32_t* value) const { *value = int_values_[idx]; }
+  void GetValue(int idx, int64_t* value) const { *value = int_values_[idx]; }
+  void GetValue(int idx, double* value) const { *value = double_values_[idx]; }
+  void GetValue(int idx, StringValue* value) const { *value = string_values_[idx]; }
+
+  void PrintResult(const string& format, const string& variant, const string& codec,
+      int64_t num_bytes, int64_t min_elapsed_ns) {
+    double elapsed_sec = max<double>(min_elapsed_ns, 1) / 1000000000;
+    cout << setw(10) << left << format << setw(9) << TypeToString(type_)
+         << setw(13) << variant << setw(8) << codec << right << fixed << setprecision(0)
+         << setw(14) << FLAGS_num_rows / elapsed_sec << setprecision(1)
+         << setw(12) << num_bytes / elapsed_sec / (1024 * 1024) << endl;
+  }
+
+  // Compresses 'input' into 'page' with 'compressor', or copies it if 'compressor' is
+  // NULL.
+  static Status CompressPage(Codec* compressor, const vector<uint8_t>& input,
+      Page* page) {
+    page->uncompressed_len = input.size();
+    if (compressor == NULL) {
+      page->data = input;
+      return Status::OK();
+    }
+    int64_t len = compressor->MaxOutputLen(input.size(), input.data());
+    page->data.resize(len);
+    uint8_t* output = page->data.data();
+    RETURN_IF_ERROR(
+        compressor->ProcessBlock(true, input.size(), input.data(), &len, &output));
+    page->data.resize(len);
+    return Status::OK();
+  }
+
+  // Returns the uncompressed data of 'page' in 'data'.
+  static Status DecompressPage(Codec* decompressor, const Page& page,
+      vector<uint8_t>* buffer, uint8_t** data) {
+    if (decompressor == NULL) {
+      *data = const_cast<uint8_t*>(page.data.data());
+      return Status::OK();
+    }
+    if (buffer->size() < page.uncompressed_len) buffer->resize(page.uncompressed_len);
+    *data = buffer->data();
+    int64_t len = page.uncompressed_len;
+    return decompressor->ProcessBlock(true, page.data.size(), page.data.data(), &len,
+        data);
+  }
+
+  Status MeasureText(bool codegen) {
+    stringstream text;
+    for (int i = 0; i < FLAGS_num_rows; ++i) {
+      for (int j = 0; j < NUM_COLS; ++j) {
+        if (j > 0) text << '|';
+        int idx = value_idxs_[j][i];
+        text << (idx == -1 ? NULL_TEXT : text_values_[idx]);
+      }
+      text << '\n';
+    }
+    string buffer = text.str();
+
+    typedef bool (*WriteSlotFn)(Tuple* tuple, const char* data, int len);
+    WriteSlotFn write_slot_fns[NUM_COLS];
+    // Every module can only be finalized once.
+    boost::scoped_ptr<LlvmCodeGen> llvm_codegen;
+    if (codegen) {
+      RETURN_IF_ERROR(LlvmCodeGen::CreateImpalaCodegen(
+          &obj_pool_, "scanner-benchmark", &llvm_codegen));
+      for (int i = 0; i < NUM_COLS; ++i) {
+        llvm::Function* fn = TextConverter::CodegenWriteSlot(llvm_codegen.get(),
+            tuple_desc_, tuple_desc_->slots()[i], NULL_TEXT, strlen(NULL_TEXT), true);
+        if (fn == NULL) return Status("Could not codegen WriteSlot()");
+        llvm_codegen->AddFunctionToJit(fn, reinterpret_cast<void**>(&write_slot_fns[i]));
+      }
+      RETURN_IF_ERROR(llvm_codegen->FinalizeModule());
+    }
+
+    bool is_materialized_col[NUM_COLS];
+    for (int i = 0; i < NUM_COLS; ++i) is_materialized_col[i] = true;
+    TextConverter converter('\0', NULL_TEXT);
+    vector<FieldLocation> field_locations(TEXT_BATCH_SIZE * NUM_COLS);
+    vector<char*> row_end_locations(TEXT_BATCH_SIZE);
+    int64_t min_elapsed_ns = numeric_limits<int64_t>::max();
+    for (int iter = 0; iter < FLAGS_num_iterations; ++iter) {
+      MonotonicStopWatch timer;
+      timer.Start();
+      DelimitedTextParser parser(NUM_COLS, 0, is_materialized_col, '\n', '|');
+      char* ptr = const_cast<char*>(buffer.data());
+      char* end = ptr + buffer.size();
+      while (ptr != end) {
+        int num_tuples;
+        int num_fields;
+        char* col_start = ptr;
+        RETURN_IF_ERROR(parser.ParseFieldLocations(TEXT_BATCH_SIZE, end - ptr, &ptr,
+            row_end_locations.data(), field_locations.data(), &num_tuples, &num_fields,
+            &col_start));
+        DCHECK_EQ(num_fields, num_tuples * NUM_COLS);
+        ResetTuples();
+        for (int i = 0; i < num_fields; ++i) {
+          Tuple* tuple = GetTuple(i / NUM_COLS);
+          const FieldLocation& field = field_locations[i];
+          int col = i % NUM_COLS;
+          bool success = codegen ?
+              write_slot_fns[col](tuple, field.start, field.len) :
+              converter.WriteSlot(tuple_desc_->slots()[col], tuple, field.start,
+                  field.len, false, false, &pool_);
+          if (UNLIKELY(!success)) return Status("Could not parse text value");
+        }
+      }
+      timer.Stop();
+      min_elapsed_ns = min<int64_t>(min_elapsed_ns, timer.ElapsedTime());
+    }
+    PrintResult("Text", codegen ? "codegen" : "interpreted", "none", buffer.size(),
+        min_elapsed_ns);
+    return Status::OK();
+  }
+
+  // Appends 4 bytes of length and the RLE encoded 'levels' to 'output'.
+  static void EncodeLevels(const vector<int>& levels, int bit_width,
+      vector<uint8_t>* output) {
+    int len = RleEncoder::MaxBufferSize(bit_width, levels.size());
+    int offset = output->size();
+    output->resize(offset + sizeof(int32_t) + len);
+    RleEncoder encoder(output->data() + offset + sizeof(int32_t), len, bit_width);
+    for (int level: levels) encoder.Put(level);
+    int32_t encoded_len = encoder.Flush();
+    memcpy(output->data() + offset, &encoded_len, sizeof(int32_t));
+    output->resize(offset + sizeof(int32_t) + encoded_len);
+  }
+
+  // Reads 4 bytes of length from 'data' and initializes 'decoder' with the RLE encoded
+  // levels after it. Advances 'data' past the levels.
+  static void InitLevelDecoder(int bit_width, uint8_t** data, RleDecoder* decoder) {
+    int32_t len;
+    memcpy(&len, *data, sizeof(int32_t));
+    *data += sizeof(int32_t);
+    decoder->Reset(*data, len, bit_width);
+    *data += len;
+  }
+
+  int max_rep_level() const { return FLAGS_nesting_depth; }
+  int max_def_level() const { return FLAGS_nesting_depth + 1; }
+
+  // Encodes column 'col' into 'column'. Every value is an item of the innermost
+  // collection if the column is nested.
+  template <typename T>
+  Status EncodeParquetColumn(int col, bool dict_encoding, Codec* compressor,
+      ParquetColumn* column) {
+    int fixed_len_size = ParquetPlainEncoder::ByteSize(ColumnType(type_));
+    DictEncoder<T> dict_encoder(&pool_, fixed_len_size);
+    int rep_bit_width = Bits::Log2Ceiling64(max_rep_level() + 1);
+    int def_bit_width = Bits::Log2Ceiling64(max_def_level() + 1);
+    const vector<int>& value_idxs = value_idxs_[col];
+    for (int start = 0; start < value_idxs.size(); start += PAGE_SIZE) {
+      int num_values = min<int>(PAGE_SIZE, value_idxs.size() - start);
+      vector<int> rep_levels;
+      vector<int> def_levels;
+      vector<uint8_t> values;
+      for (int i = start; i < start + num_values; ++i) {
+        if (max_rep_level() > 0) {
+          rep_levels.push_back(i % FLAGS_collection_size == 0 ? 0 : max_rep_level());
+        }
+        if (value_idxs[i] == -1) {
+          def_levels.push_back(max_def_level() - 1);
+          continue;
+        }
+        def_levels.push_back(max_def_level());
+        T value;
+        GetValue(value_idxs[i], &value);
+        if (dict_encoding) {
+          if (dict_encoder.Put(value) < 0) return Status("Dictionary is full");
+        } else {
+          int offset = values.size();
+          values.resize(offset + ParquetPlainEncoder::ByteSize(value));
+          ParquetPlainEncoder::Encode(values.data() + offset, fixed_len_size, value);
+        }
+      }
+      if (dict_encoding) {
+        values.resize(dict_encoder.EstimatedDataEncodedSize());
+        int len = dict_encoder.WriteData(values.data(), values.size());
+        DCHECK_GE(len, 0);
+        values.resize(len);
+        dict_encoder.ClearIndices();
+      }
+      vector<uint8_t> page_data;
+      if (max_rep_level() > 0) EncodeLevels(rep_levels, rep_bit_width, &page_data);
+      EncodeLevels(def_levels, def_bit_width, &page_data);
+      page_data.insert(page_data.end(), values.begin(), values.end());
+      column->pages.push_back(Page());
+      column->pages.back().num_values = num_values;
+      RETURN_IF_ERROR(CompressPage(compressor, page_data, &column->pages.back()));
+    }
+    if (dict_encoding) {
+      column->dict.resize(dict_encoder.dict_encoded_size());
+      dict_encoder.WriteDict(column->dict.data());
+    }
+    return Status::OK();
+  }
+
+  // Decodes the values of 'column' into the slot 'col' of the tuples, one page at a
+  // time.
+  template <typename T>
+  Status DecodeParquetColumn(int col, const ParquetColumn& column, Codec* decompressor,
+      vector<uint8_t>* buffer) {
+    const SlotDescriptor* slot_desc = tuple_desc_->slots()[col];
+    int fixed_len_size = ParquetPlainEncoder::ByteSize(slot_desc->type());
+    int rep_bit_width = Bits::Log2Ceiling64(max_rep_level() + 1);
+    int def_bit_width = Bits::Log2Ceiling64(max_def_level() + 1);
+    bool dict_encoding = !column.dict.empty();
+    DictDecoder<T> dict_decoder;
+    if (dict_encoding && !dict_decoder.Reset(const_cast<uint8_t*>(column.dict.data()),
+        column.dict.size(), fixed_len_size)) {
+      return Status("Corrupt dictionary");
+    }
+    for (const Page& page: column.pages) {
+      uint8_t* data;
+      RETURN_IF_ERROR(DecompressPage(decompressor, page, buffer, &data));
+      uint8_t* data_end = data + page.uncompressed_len;
+      RleDecoder rep_levels;
+      RleDecoder def_levels;
+      if (max_rep_level() > 0) InitLevelDecoder(rep_bit_width, &data, &rep_levels);
+      InitLevelDecoder(def_bit_width, &data, &def_levels);
+      if (dict_encoding) dict_decoder.SetData(data, data_end - data);
+      for (int i = 0; i < page.num_values; ++i) {
+        uint8_t rep_level;
+        uint8_t def_level;
+        if (max_rep_level() > 0 && UNLIKELY(!rep_levels.Get(&rep_level))) {
+          return Status("Corrupt repetition levels");
+        }
+        if (UNLIKELY(!def_levels.Get(&def_level))) {
+          return Status("Corrupt definition levels");
+        }
+        Tuple* tuple = GetTuple(i);
+        if (def_level < max_def_level()) {
+          tuple->SetNull(slot_desc->null_indicator_offset());
+          continue;
+        }
+        T* slot = reinterpret_cast<T*>(tuple->GetSlot(slot_desc->tuple_offset()));
+        if (dict_encoding) {
+          if (UNLIKELY(!dict_decoder.GetValue(slot))) return Status("Corrupt value");
+        } else {
+          int len = ParquetPlainEncoder::Decode(data, data_end, fixed_len_size, slot);
+          if (UNLIKELY(len < 0)) return Status("Corrupt value");
+          data += len;
+        }
+      }
+    }
+    return Status::OK();
+  }
+
+  template <typename T>
+  Status MeasureParquetType(bool dict_encoding, const string& codec_name,
+      THdfsCompression::type codec) {
+    boost::scoped_ptr<Codec> compressor;
+    boost::scoped_ptr<Codec> decompressor;
+    RETURN_IF_ERROR(Codec::CreateCompressor(&pool_, false, codec, &compressor));
+    RETURN_IF_ERROR(Codec::CreateDecompressor(&pool_, false, codec, &decompressor));
+    ParquetColumn columns[NUM_COLS];
+    int64_t num_bytes = 0;
+    for (int i = 0; i < NUM_COLS; ++i) {
+      RETURN_IF_ERROR(
+          EncodeParquetColumn<T>(i, dict_encoding, compressor.get(), &columns[i]));
+      num_bytes += columns[i].dict.size();
+      for (const Page& page: columns[i].pages) num_bytes += page.data.size();
+    }
+
+    vector<uint8_t> buffer;
+    int64_t min_elapsed_ns = numeric_limits<int64_t>::max();
+    for (int iter = 0; iter < FLAGS_num_iterations; ++iter) {
+      MonotonicStopWatch timer;
+      timer.Start();
+      ResetTuples();
+      for (int i = 0; i < NUM_COLS; ++i) {
+        RETURN_IF_ERROR(
+            DecodeParquetColumn<T>(i, columns[i], decompressor.get(), &buffer));
+      }
+      timer.Stop();
+      min_elapsed_ns = min<int64_t>(min_elapsed_ns, timer.ElapsedTime());
+    }
+    if (decompressor != NULL) decompressor->Close();
+    if (compressor != NULL) compressor->Close();
+    PrintResult("Parquet", dict_encoding ? "dictionary" : "plain", codec_name, num_bytes,
+        min_elapsed_ns);
+    return Status::OK();
+  }
+
+  Status MeasureParquet(bool dict_encoding, const string& codec_name,
+      THdfsCompression::type codec) {
+    if (dict_encoding && FLAGS_cardinality > MAX_DICT_ENTRIES) return Status::OK();
+    switch (type_) {
+      case TYPE_INT:
+        return MeasureParquetType<int32_t>(dict_encoding, codec_name, codec);
+      case TYPE_BIGINT:
+        return MeasureParquetType<int64_t>(dict_encoding, codec_name, codec);
+      case TYPE_DOUBLE:
+        return MeasureParquetType<double>(dict_encoding, codec_name, codec);
+      case TYPE_STRING:
+        return MeasureParquetType<StringValue>(dict_encoding, codec_name, codec);
+      default:
+        DCHECK(false);
+        return Status::OK();
+    }
+  }
+
+  // Appends the Avro encoding of value 'idx' of the distinct values to 'output'.
+  void EncodeAvroValue(int idx, vector<uint8_t>* output) {
+    int offset = output->size();
+    // Large enough for any zig-zag encoded long.
+    output->resize(offset + 10);
+    uint8_t* ptr = output->data() + offset;
+    switch (type_) {
+      case TYPE_INT:
+        output->resize(offset + ReadWriteUtil::PutZInt(int_values_[idx], ptr));
+        break;
+      case TYPE_BIGINT:
+        output->resize(offset + ReadWriteUtil::PutZLong(int_values_[idx], ptr));
+        break;
+      case TYPE_DOUBLE:
+        memcpy(ptr, &double_values_[idx], sizeof(double));
+        output->resize(offset + sizeof(double));
+        break;
+      case TYPE_STRING: {
+        const StringValue& value = string_values_[idx];
+        output->resize(offset + ReadWriteUtil::PutZLong(value.len, ptr));
+        output->insert(output->end(), value.ptr, value.ptr + value.len);
+        break;
+      }
+      default:
+        DCHECK(false);
+    }
+  }
+
+  Status MeasureAvro(const string& codec_name, THdfsCompression::type codec) {
+    boost::scoped_ptr<Codec> compressor;
+    boost::scoped_ptr<Codec> decompressor;
+    RETURN_IF_ERROR(Codec::CreateCompressor(&pool_, false, codec, &compressor));
+    RETURN_IF_ERROR(Codec::CreateDecompressor(&pool_, false, codec, &decompressor));
+    // Every field is a union of null and the value, in this order.
+    const int null_union_position = 0;
+    vector<Page> blocks;
+    int64_t num_bytes = 0;
+    for (int start = 0; start < FLAGS_num_rows; start += PAGE_SIZE) {
+      int num_rows = min(PAGE_SIZE, FLAGS_num_rows - start);
+      vector<uint8_t> block_data;
+      for (int i = start; i < start + num_rows; ++i) {
+        for (int j = 0; j < NUM_COLS; ++j) {
+          int idx = value_idxs_[j][i];
+          block_data.push_back(idx == -1 ? 0 : 2);
+          if (idx != -1) EncodeAvroValue(idx, &block_data);
+        }
+      }
+      blocks.push_back(Page());
+      blocks.back().num_values = num_rows;
+      RETURN_IF_ERROR(CompressPage(compressor.get(), block_data, &blocks.back()));
+      num_bytes += blocks.back().data.size();
+    }
+
+    HdfsAvroScanner scanner;
+    vector<uint8_t> buffer;
+    int64_t min_elapsed_ns = numeric_limits<int64_t>::max();
+    for (int iter = 0; iter < FLAGS_num_iterations; ++iter) {
+      MonotonicStopWatch timer;
+      timer.Start();
+      for (const Page& block: blocks) {
+        uint8_t* data;
+        RETURN_IF_ERROR(DecompressPage(decompressor.get(), block, &buffer, &data));
+        uint8_t* data_end = data + block.uncompressed_len;
+        ResetTuples();
+        for (int i = 0; i < block.num_values; ++i) {
+          Tuple* tuple = GetTuple(i);
+          for (int j = 0; j < NUM_COLS; ++j) {
+            const SlotDescriptor* slot_desc = tuple_desc_->slots()[j];
+            bool is_null;
+            if (UNLIKELY(!scanner.ReadUnionType(null_union_position, &data, data_end,
+                &is_null))) {
+              return scanner.parse_status_;
+            }
+            if (is_null) {
+              tuple->SetNull(slot_desc->null_indicator_offset());
+              continue;
+            }
+            void* slot = tuple->GetSlot(slot_desc->tuple_offset());
+            bool success = false;
+            switch (type_) {
+              case TYPE_INT:
+                success = scanner.ReadAvroInt32(type_, &data, data_end, true, slot,
+                    &pool_);
+                break;
+              case TYPE_BIGINT:
+                success = scanner.ReadAvroInt64(type_, &data, data_end, true, slot,
+                    &pool_);
+                break;
+              case TYPE_DOUBLE:
+                success = scanner.ReadAvroDouble(type_, &data, data_end, true, slot,
+                    &pool_);
+                break;
+              case TYPE_STRING:
+                success = scanner.ReadAvroString(type_, &data, data_end, true, slot,
+                    &pool_);
+                break;
+              default:
+                DCHECK(false);
+            }
+            if (UNLIKELY(!success)) return scanner.parse_status_;
+          }
+        }
+      }
+      timer.Stop();
+      min_elapsed_ns = min<int64_t>(min_elapsed_ns, timer.ElapsedTime());
+    }
+    if (decompressor != NULL) decompressor->Close();
+    if (compressor != NULL) compressor->Close();
+    PrintResult("Avro", "-", codec_name, num_bytes, min_elapsed_ns);
+    return Status::OK();
+  }
+};
+
+const char* ScannerBenchmark::NULL_TEXT = "\\N";
+
+}
+
+int main(int argc, char** argv) {
+  impala::InitCommonRuntime(argc, argv, false, impala::TestInfo::BE_TEST);
+  impala::LlvmCodeGen::InitializeLlvm();
+  cout << impala::Benchmark::GetMachineInfo() << endl;
+  impala::ScannerBenchmark benchmark;
+  impala::Status status = benchmark.RunAll();
+  if (!status.ok()) {
+    cerr << status.GetDetail() << endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,401 @@
+// Copyright 2016 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdlib.h>
+#include <iomanip>
+#include <iostream>
+#include <boost/algorithm/string.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/thread.hpp>
+#include <gflags/gflags.h>
+#include <gutil/strings/substitute.h>
+
+#include "common/init.h"
+#include "common/object-pool.h"
+#include "runtime/buffered-block-mgr.h"
+#include "runtime/buffered-tuple-stream.inline.h"
+#include "runtime/descriptors.h"
+#include "runtime/mem-tracker.h"
+#include "runtime/row-batch.h"
+#include "runtime/runtime-state.h"
+#include "runtime/test-env.h"
+#include "runtime/tmp-file-mgr.h"
+#include "runtime/tuple-row.h"
+#include "testutil/desc-tbl-builder.h"
+#include "util/benchmark.h"
+#include "util/cpu-info.h"
+#include "util/hdr-histogram.h"
+#include "util/pretty-printer.h"
+#include "util/runtime-profile-counters.h"
+#include "util/stopwatch.h"
+#include "util/test-info.h"
+#include "util/time.h"
+
+#include "common/names.h"
+
+using boost::filesystem::directory_iterator;
+using boost::filesystem::remove_all;
+using std::right;
+using strings::Substitute;
+
+// Benchmark and stress tool for the spilling path. It runs --num_queries queries, each
+// with its own BufferedBlockMgr limited to --buffers_per_query buffers, and
+// --clients_per_query client threads per query, which all spill to the scratch
+// directories given by --scratch_dirs. There are two workloads:
+//   - blocks: every client writes --blocks_per_client blocks, unpinning each one after
+//     writing it, and then pins, validates and unpins all of them --num_passes times
+//     in random order, prefetching the next block if --prefetch is set.
+//   - streams: every client adds --blocks_per_client blocks worth of rows to an
+//     unpinned BufferedTupleStream and then reads and validates them --num_passes
+//     times.
+// Since each client works on more blocks than its query has buffers, nearly every
+// Pin() reads from disk. --disk_spill_compression and --disk_spill_encryption apply.
+//
+// For each workload the tool reports the number of MB written to and read from the
+// scratch files per second, the distribution of the latency of Pin() (or of
+// BufferedTupleStream::GetNext() for the streams) and the high-water mark of the
+// memory of all block managers.
+//
+// If --fault_injection_interval_ms is set, the scratch files are deleted every that
+// many ms, so that writes and reads fail. Clients stop at their first error and the
+// tool checks that the block managers shut down cleanly and reports the number of
+// failed clients. The data that clients read back is validated in either mode.
+//
+// Example:
+//   spill-benchmark --scratch_dirs=/data/1,/data/2 --num_queries=8 --block_size=8388608
+
+DEFINE_int32(num_queries, 4, "Number of concurrent queries.");
+DEFINE_int32(clients_per_query, 2, "Number of client threads of each query.");
+DEFINE_int32(buffers_per_query, 16, "Number of buffers of the block manager of each "
+    "query. Must be at least --clients_per_query.");
+DEFINE_int32(block_size, 8 * 1024 * 1024, "Size of the blocks in bytes.");
+DEFINE_int32(blocks_per_client, 32, "Number of blocks that each client writes.");
+DEFINE_int32(num_passes, 2, "Number of times that each client reads back its data.");
+DEFINE_string(workloads, "blocks,streams", "Comma-separated list of the workloads to "
+    "run. Valid values are 'blocks' and 'streams'.");
+DEFINE_bool(prefetch, true, "If true, the blocks workload prefetches the next block "
+    "before it pins a block.");
+DEFINE_int32(fault_injection_interval_ms, 0, "If greater than 0, the scratch files are "
+    "deleted every this many ms to inject write and read errors.");
+
+DECLARE_string(scratch_dirs);
+
+namespace impala {
+
+class SpillBenchmark {
+ public:
+  SpillBenchmark() : client_tracker_(-1), done_(false) {}
+
+  Status Init() {
+    if (FLAGS_buffers_per_query < FLAGS_clients_per_query) {
+      return Status("--buffers_per_query must be at least --clients_per_query");
+    }
+    if (FLAGS_blocks_per_client <= FLAGS_buffers_per_query / FLAGS_clients_per_query) {
+      cerr << "Warning: the blocks of a client fit in its share of the buffers, so few "
+           << "blocks are spilled." << endl;
+    }
+    // Like the rows of an aggregation or join: a tuple of four BIGINTs.
+    DescriptorTblBuilder builder(&obj_pool_);
+    builder.DeclareTuple() << TYPE_BIGINT << TYPE_BIGINT << TYPE_BIGINT << TYPE_BIGINT;
+    vector<bool> nullable_tuples(1, false);
+    vector<TTupleId> tuple_ids(1, static_cast<TTupleId>(0));
+    row_desc_ = obj_pool_.Add(
+        new RowDescriptor(*builder.Build(), tuple_ids, nullable_tuples));
+    return Status::OK();
+  }
+
+  // Runs 'workload' and prints its results. Returns an error if a client failed and
+  // no faults were injected.
+  Status Run(const string& workload) {
+    if (workload != "blocks" && workload != "streams") {
+      return Status(Substitute("Invalid workload: '$0'", workload));
+    }
+    TestEnv test_env;
+    vector<RuntimeState*> states;
+    RETURN_IF_ERROR(test_env.CreateQueryStates(0, FLAGS_num_queries,
+        FLAGS_buffers_per_query, FLAGS_block_size, &states));
+    vector<string> scratch_dirs;
+    TmpFileMgr* tmp_file_mgr = test_env.tmp_file_mgr();
+    for (int i = 0; i < tmp_file_mgr->num_active_tmp_devices(); ++i) {
+      scratch_dirs.push_back(tmp_file_mgr->GetTmpDirPath(i));
+    }
+
+    // Latencies of up to 100s, in ns.
+    HdrHistogram latencies(100L * 1000L * 1000L * 1000L, 3);
+    int num_clients = FLAGS_num_queries * FLAGS_clients_per_query;
+    vector<Status> statuses(num_clients);
+    MonotonicStopWatch timer;
+    timer.Start();
+    done_ = false;
+    thread_group fault_injector;
+    if (FLAGS_fault_injection_interval_ms > 0) {
+      fault_injector.add_thread(
+          new thread(&SpillBenchmark::InjectFaults, this, scratch_dirs));
+    }
+    thread_group clients;
+    for (int i = 0; i < num_clients; ++i) {
+      RuntimeState* state = states[i / FLAGS_clients_per_query];
+      if (workload == "blocks") {
+        clients.add_thread(new thread(&SpillBenchmark::RunBlocksClient, this, state, i,
+            &latencies, &statuses[i]));
+      } else {
+        clients.add_thread(new thread(&SpillBenchmark::RunStreamClient, this, state, i,
+            &latencies, &statuses[i]));
+      }
+    }
+    clients.join_all();
+    timer.Stop();
+    done_ = true;
+    fault_injector.join_all();
+
+    int num_failed = 0;
+    for (const Status& status: statuses) {
+      if (status.ok()) continue;
+      if (FLAGS_fault_injection_interval_ms <= 0) return status;
+      ++num_failed;
+    }
+    int64_t bytes_written = 0;
+    int64_t bytes_read = 0;
+    for (RuntimeState* state: states) {
+      bytes_written += GetBlockMgrCounter(state, "BytesWritten");
+      bytes_read += GetBlockMgrCounter(state, "BytesRead");
+    }
+    int64_t peak_mem = test_env.block_mgr_parent_tracker()->peak_consumption();
+    test_env.TearDownQueryStates();
+    if (test_env.block_mgr_parent_tracker()->consumption() != 0) {
+      return Status(Substitute("The block managers leaked $0 bytes",
+          test_env.block_mgr_parent_tracker()->consumption()));
+    }
+    PrintResults(workload, timer.ElapsedTime(), bytes_written, bytes_read, peak_mem,
+        latencies, num_failed);
+    return Status::OK();
+  }
+
+ private:
+  // Number of rows of the batches read from the streams.
+  static const int BATCH_SIZE = 1024;
+
+  // Only every this many 8-byte words of a block are validated.
+  static const int VALIDATION_STRIDE = 509;
+
+  ObjectPool obj_pool_;
+  MemTracker client_tracker_;
+  RowDescriptor* row_desc_;
+
+  // Set when all clients are done, to stop the fault injection.
+  volatile bool done_;
+
+  // Returns the value of the counter 'name' of the block manager of 'state'.
+  static int64_t GetBlockMgrCounter(RuntimeState* state, const string& name) {
+    vector<RuntimeProfile*> children;
+    state->runtime_profile()->GetChildren(&children);
+    for (RuntimeProfile* child: children) {
+      if (child->name() != "BlockMgr") continue;
+      RuntimeProfile::Counter* counter = child->GetCounter(name);
+      return counter == NULL ? 0 : counter->value();
+    }
+    return 0;
+  }
+
+  // The value of word 'idx' of block 'block_idx' of client 'client_idx'.
+  static int64_t BlockWord(int client_idx, int block_idx, int64_t idx) {
+    return (static_cast<int64_t>(client_idx) << 48) ^
+        (static_cast<int64_t>(block_idx) << 32) ^ idx;
+  }
+
+  // Deletes the scratch files in 'scratch_dirs' every --fault_injection_interval_ms
+  // until done_ is set.
+  void InjectFaults(const vector<string>& scratch_dirs) {
+    while (!done_) {
+      SleepForMs(FLAGS_fault_injection_interval_ms);
+      for (const string& dir: scratch_dirs) {
+        try {
+          for (directory_iterator it(dir); it != directory_iterator(); ++it) {
+            remove_all(it->path());
+          }
+        } catch (const boost::filesystem::filesystem_error& e) {
+          cerr << "Could not delete scratch files: " << e.what() << endl;
+        }
+      }
+    }
+  }
+
+  void RunBlocksClient(RuntimeState* state, int client_idx, HdrHistogram* latencies,
+      Status* status) {
+    BufferedBlockMgr* block_mgr = state->block_mgr();
+    BufferedBlockMgr::Client* client;
+    *status = block_mgr->RegisterClient(Substitute("Client $0", client_idx), 1, false,
+        &client_tracker_, state, &client);
+    if (!status->ok()) return;
+    vector<BufferedBlockMgr::Block*> blocks;
+    *status = RunBlocks(block_mgr, client, client_idx, latencies, &blocks);
+    for (BufferedBlockMgr::Block* block: blocks) block->Delete();
+  }
+
+  Status RunBlocks(BufferedBlockMgr* block_mgr, BufferedBlockMgr::Client* client,
+      int client_idx, HdrHistogram* latencies, vector<BufferedBlockMgr::Block*>* blocks) {
+    int64_t num_words = block_mgr->max_block_size() / sizeof(int64_t);
+    for (int i = 0; i < FLAGS_blocks_per_client; ++i) {
+      BufferedBlockMgr::Block* block;
+      RETURN_IF_ERROR(block_mgr->GetNewBlock(client, NULL, &block));
+      if (block == NULL) return Status("Could not get a new block");
+      blocks->push_back(block);
+      int64_t* data = block->Allocate<int64_t>(num_words * sizeof(int64_t));
+      for (int64_t j = 0; j < num_words; ++j) data[j] = BlockWord(client_idx, i, j);
+      RETURN_IF_ERROR(block->Unpin());
+    }
+
+    vector<int> order(blocks->size());
+    for (int i = 0; i < order.size(); ++i) order[i] = i;
+    for (int pass = 0; pass < FLAGS_num_passes; ++pass) {
+      random_shuffle(order.begin(), order.end());
+      for (int i = 0; i < order.size(); ++i) {
+        BufferedBlockMgr::Block* block = (*blocks)[order[i]];
+        if (FLAGS_prefetch && i + 1 < order.size()) (*blocks)[order[i + 1]]->Prefetch();
+        bool pinned;
+        int64_t start = MonotonicNanos();
+        RETURN_IF_ERROR(block->Pin(&pinned));
+        latencies->Increment(MonotonicNanos() - start);
+        if (!pinned) return Status("Could not pin a block");
+        const int64_t* data = reinterpret_cast<int64_t*>(block->buffer());
+        for (int64_t j = 0; j < num_words; j += VALIDATION_STRIDE) {
+          if (data[j] != BlockWord(client_idx, order[i], j)) {
+            return Status(Substitute("Client $0 read corrupt data from block $1",
+                client_idx, order[i]));
+          }
+        }
+        RETURN_IF_ERROR(block->Unpin());
+      }
+    }
+    return Status::OK();
+  }
+
+  void RunStreamClient(RuntimeState* state, int client_idx, HdrHistogram* latencies,
+      Status* status) {
+    BufferedBlockMgr::Client* client;
+    *status = state->block_mgr()->RegisterClient(Substitute("Client $0", client_idx), 1,
+        false, &client_tracker_, state, &client);
+    if (!status->ok()) return;
+    BufferedTupleStream stream(state, *row_desc_, state->block_mgr(), client, false,
+        false);
+    *status = RunStream(&stream, latencies);
+    stream.Close();
+  }
+
+  Status RunStream(BufferedTupleStream* stream, HdrHistogram* latencies) {
+    RETURN_IF_ERROR(stream->Init(-1, NULL, false));
+    TupleDescriptor* tuple_desc = row_desc_->tuple_descriptors()[0];
+    const SlotDescriptor* first_slot = tuple_desc->slots()[0];
+    RowBatch write_batch(*row_desc_, 1, &client_tracker_);
+    TupleRow* row = write_batch.GetRow(0);
+    Tuple* tuple = Tuple::Create(tuple_desc->byte_size(), write_batch.tuple_data_pool());
+    row->SetTuple(0, tuple);
+    int64_t num_rows =
+        static_cast<int64_t>(FLAGS_blocks_per_client) * FLAGS_block_size /
+        tuple_desc->byte_size();
+    for (int64_t i = 0; i < num_rows; ++i) {
+      for (const SlotDescriptor* slot_desc: tuple_desc->slots()) {
+        *reinterpret_cast<int64_t*>(tuple->GetSlot(slot_desc->tuple_offset())) = i;
+      }
+      Status status;
+      if (!stream->AddRow(row, &status)) {
+        RETURN_IF_ERROR(status);
+        return Status("Could not add a row to the stream");
+      }
+    }
+
+    RowBatch read_batch(*row_desc_, BATCH_SIZE, &client_tracker_);
+    for (int pass = 0; pass < FLAGS_num_passes; ++pass) {
+      bool got_buffer;
+      RETURN_IF_ERROR(
+          stream->PrepareForRead(pass == FLAGS_num_passes - 1, &got_buffer));
+      if (!got_buffer) return Status("Could not pin the stream for reading");
+      int64_t rows_read = 0;
+      bool eos = false;
+      while (!eos) {
+        int64_t start = MonotonicNanos();
+        RETURN_IF_ERROR(stream->GetNext(&read_batch, &eos));
+        latencies->Increment(MonotonicNanos() - start);
+        for (int i = 0; i < read_batch.num_rows(); ++i, ++rows_read) {
+          Tuple* read_tuple = read_batch.GetRow(i)->GetTuple(0);
+          if (*reinterpret_cast<int64_t*>(
+              read_tuple->GetSlot(first_slot->tuple_offset())) != rows_read) {
+            return Status(Substitute("Read corrupt row $0", rows_read));
+          }
+        }
+        read_batch.Reset();
+      }
+      if (rows_read != num_rows) {
+        return Status(Substitute("Read $0 rows instead of $1", rows_read, num_rows));
+      }
+    }
+    return Status::OK();
+  }
+
+  static void PrintResults(const string& workload, int64_t elapsed_ns,
+      int64_t bytes_written, int64_t bytes_read, int64_t peak_mem,
+      const HdrHistogram& latencies, int num_failed) {
+    double elapsed_sec = max<double>(elapsed_ns, 1) / 1000000000;
+    const double mb = 1024 * 1024;
+    cout << "Workload: " << workload << endl
+         << "  Elapsed:             "
+         << PrettyPrinter::Print(elapsed_ns, TUnit::TIME_NS) << endl
+         << fixed << setprecision(1)
+         << "  Write throughput:    " << bytes_written / mb / elapsed_sec << " MB/s ("
+         << PrettyPrinter::Print(bytes_written, TUnit::BYTES) << ")" << endl
+         << "  Read throughput:     " << bytes_read / mb / elapsed_sec << " MB/s ("
+         << PrettyPrinter::Print(bytes_read, TUnit::BYTES) << ")" << endl
+         << "  Peak memory:         " << PrettyPrinter::Print(peak_mem, TUnit::BYTES)
+         << endl
+         << "  " << (workload == "blocks" ? "Pin() latency:      " :
+             "GetNext() latency:  ")
+         << " count=" << latencies.TotalCount();
+    if (latencies.TotalCount() > 0) {
+      cout << " p50=" << PrettyPrinter::Print(latencies.ValueAtPercentile(50),
+               TUnit::TIME_NS)
+           << " p90=" << PrettyPrinter::Print(latencies.ValueAtPercentile(90),
+               TUnit::TIME_NS)
+           << " p99=" << PrettyPrinter::Print(latencies.ValueAtPercentile(99),
+               TUnit::TIME_NS)
+           << " p99.9=" << PrettyPrinter::Print(latencies.ValueAtPercentile(99.9),
+               TUnit::TIME_NS)
+           << " max=" << PrettyPrinter::Print(latencies.MaxValue(), TUnit::TIME_NS);
+    }
+    cout << endl;
+    if (FLAGS_fault_injection_interval_ms > 0) {
+      cout << "  Failed clients:      " << num_failed << endl;
+    }
+  }
+};
+
+}
+
+int main(int argc, char** argv) {
+  impala::InitCommonRuntime(argc, argv, false, impala::TestInfo::BE_TEST);
+  cout << impala::Benchmark::GetMachineInfo() << endl;
+  impala::SpillBenchmark benchmark;
+  impala::Status status = benchmark.Init();
+  vector<string> workloads;
+  boost::split(workloads, FLAGS_workloads, boost::is_any_of(","));
+  for (int i = 0; status.ok() && i < workloads.size(); ++i) {
+    if (workloads[i].empty()) continue;
+    status = benchmark.Run(workloads[i]);
+  }
+  if (!status.ok()) {
+    cerr << status.GetDetail() << endl;
+    return 1;
+  }
+  return 0;
+}
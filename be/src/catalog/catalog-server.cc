@@ -39,6 +39,7 @@ DECLARE_int32(state_store_subscriber_port);
 DECLARE_int32(state_store_port);
 DECLARE_string(hostname);
 DECLARE_bool(compact_catalog_topic);
+DECLARE_bool(compress_catalog_topic);
 
 string CatalogServer::IMPALA_CATALOG_TOPIC = "catalog-update";
 
@@ -229,13 +230,24 @@ void CatalogServer::UpdateCatalogTopicCallback(
     LOG_EVERY_N(INFO, 300) << "Catalog Version: " << catalog_objects_max_version_
                            << " Last Catalog Version: " << last_sent_catalog_version_;
 
-    for (const TTopicItem& catalog_object: pending_topic_updates_) {
+    if (!pending_topic_updates_.empty()) {
       if (subscriber_topic_updates->size() == 0) {
         subscriber_topic_updates->push_back(TTopicDelta());
         subscriber_topic_updates->back().topic_name = IMPALA_CATALOG_TOPIC;
       }
       TTopicDelta& update = subscriber_topic_updates->back();
-      update.topic_entries.push_back(catalog_object);
+      // The serialized values of large tables can be hundreds of MB, so hand the items
+      // over instead of copying them. pending_topic_updates_ is rebuilt for the next
+      // update anyway.
+      if (update.topic_entries.empty()) {
+        update.topic_entries.swap(pending_topic_updates_);
+      } else {
+        for (TTopicItem& catalog_object: pending_topic_updates_) {
+          update.topic_entries.push_back(TTopicItem());
+          swap(update.topic_entries.back(), catalog_object);
+        }
+        pending_topic_updates_.clear();
+      }
     }
 
     // Update the new catalog version and the set of known catalog objects.
@@ -317,6 +329,9 @@ void CatalogServer::BuildTopicUpdates(const vector<TCatalogObject>& catalog_obje
     TTopicItem& item = pending_topic_updates_.back();
     item.key = entry_key;
     Status status = thrift_serializer_.Serialize(&catalog_object, &item.value);
+    if (status.ok() && FLAGS_compress_catalog_topic) {
+      status = CompressCatalogObject(&item.value);
+    }
     if (!status.ok()) {
       LOG(ERROR) << "Error serializing topic value: " << status.GetDetail();
       pending_topic_updates_.pop_back();
@@ -18,6 +18,7 @@
 
 #include "catalog/catalog-util.h"
 #include "common/status.h"
+#include "util/codec.h"
 #include "util/debug-util.h"
 
 #include "common/names.h"
@@ -184,5 +185,40 @@ string TCatalogObjectToEntryKey(const TCatalogObject& catalog_object) {
   return entry_key.str();
 }
 
+Status CompressCatalogObject(string* catalog_object) {
+  scoped_ptr<Codec> compressor;
+  RETURN_IF_ERROR(Codec::CreateCompressor(NULL, false, THdfsCompression::SNAPPY,
+      &compressor));
+  string output(compressor->MaxOutputLen(catalog_object->size()), '\0');
+  int64_t compressed_len = output.size();
+  uint8_t* output_buffer = reinterpret_cast<uint8_t*>(&output[0]);
+  Status status = compressor->ProcessBlock(true, catalog_object->size(),
+      reinterpret_cast<const uint8_t*>(catalog_object->data()), &compressed_len,
+      &output_buffer);
+  compressor->Close();
+  RETURN_IF_ERROR(status);
+  output.resize(compressed_len);
+  catalog_object->swap(output);
+  return Status::OK();
+}
+
+Status DecompressCatalogObject(const string& compressed_object, string* output) {
+  scoped_ptr<Codec> decompressor;
+  RETURN_IF_ERROR(Codec::CreateDecompressor(NULL, false, THdfsCompression::SNAPPY,
+      &decompressor));
+  const uint8_t* input = reinterpret_cast<const uint8_t*>(compressed_object.data());
+  int64_t decompressed_len =
+      decompressor->MaxOutputLen(compressed_object.size(), input);
+  if (decompressed_len < 0) {
+    decompressor->Close();
+    return Status("Invalid compressed catalog object");
+  }
+  output->resize(decompressed_len);
+  uint8_t* output_buffer = reinterpret_cast<uint8_t*>(&(*output)[0]);
+  Status status = decompressor->ProcessBlock(true, compressed_object.size(), input,
+      &decompressed_len, &output_buffer);
+  decompressor->Close();
+  return status;
+}
 
 }
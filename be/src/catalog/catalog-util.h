@@ -48,6 +48,14 @@ Status TCatalogObjectFromObjectName(const TCatalogObjectType::type& object_type,
 /// Returns an empty string if there were any problem building the key.
 std::string TCatalogObjectToEntryKey(const TCatalogObject& catalog_object);
 
+/// Compresses the serialized catalog object in 'catalog_object' in place, for
+/// publishing it in the IMPALA_CATALOG_TOPIC if --compress_catalog_topic is set.
+Status CompressCatalogObject(std::string* catalog_object);
+
+/// Decompresses a catalog object compressed by CompressCatalogObject() into 'output'.
+Status DecompressCatalogObject(const std::string& compressed_object,
+    std::string* output);
+
 }
 
 #endif
@@ -48,6 +48,8 @@ ir_functions = [
       "PartitionedAggregationNode22ProcessBatchNoGrouping"],
   ["PART_AGG_NODE_PROCESS_BATCH_STREAMING",
       "PartitionedAggregationNode21ProcessBatchStreaming"],
+  ["PART_AGG_NODE_UPDATE_SLOT_INTERPRETED",
+      "PartitionedAggregationNode21UpdateSlotInterpreted"],
   ["AVG_UPDATE_BIGINT", "9AvgUpdateIN10impala_udf9BigIntVal"],
   ["AVG_UPDATE_DOUBLE", "9AvgUpdateIN10impala_udf9DoubleVal"],
   ["AVG_UPDATE_TIMESTAMP", "TimestampAvgUpdate"],
@@ -31,6 +31,8 @@
 using namespace llvm;
 using std::unique_ptr;
 
+DECLARE_int64(codegen_cache_capacity);
+
 namespace impala {
 
 class LlvmCodeGenTest : public testing:: Test {
@@ -83,6 +85,10 @@ class LlvmCodeGenTest : public testing:: Test {
     return codegen->FinalizeModule();
   }
 
+  static int64_t CacheHits(LlvmCodeGen* codegen) {
+    return codegen->cache_hit_counter_->value();
+  }
+
 };
 
 // Simple test to just make and destroy llvmcodegen objects.  LLVM
@@ -368,6 +374,54 @@ TEST_F(LlvmCodeGenTest, MemcpyTest) {
   EXPECT_EQ(memcmp(src, dst, 4), 0);
 }
 
+// Generates a function that copies 4 bytes from its second to its first argument and
+// returns it after compiling it with optimizations enabled.
+static void* CompileMemcpyFn(LlvmCodeGen* codegen) {
+  codegen->EnableOptimizations(true);
+  LlvmCodeGen::FnPrototype prototype(codegen, "MemcpyFn", codegen->void_type());
+  prototype.AddArgument(LlvmCodeGen::NamedVariable("dest", codegen->ptr_type()));
+  prototype.AddArgument(LlvmCodeGen::NamedVariable("src", codegen->ptr_type()));
+  LlvmCodeGen::LlvmBuilder builder(codegen->context());
+  Value* args[2];
+  Function* fn = prototype.GeneratePrototype(&builder, &args[0]);
+  codegen->CodegenMemcpy(&builder, args[0], args[1], 4);
+  builder.CreateRetVoid();
+  fn = codegen->FinalizeFunction(fn);
+  EXPECT_TRUE(fn != NULL);
+
+  void* jitted_fn = NULL;
+  codegen->AddFunctionToJit(fn, &jitted_fn);
+  Status status = codegen->FinalizeModule();
+  EXPECT_OK(status);
+  return jitted_fn;
+}
+
+// Test that the compiled code of identical modules is shared through the codegen cache
+// and outlives the codegen object that compiled it.
+TEST_F(LlvmCodeGenTest, ModuleCache) {
+  FLAGS_codegen_cache_capacity = 64L * 1024L * 1024L;
+  ObjectPool pool;
+  scoped_ptr<LlvmCodeGen> codegen1;
+  scoped_ptr<LlvmCodeGen> codegen2;
+  ASSERT_OK(LlvmCodeGen::CreateImpalaCodegen(&pool, "test1", &codegen1));
+  ASSERT_OK(LlvmCodeGen::CreateImpalaCodegen(&pool, "test2", &codegen2));
+
+  void* jitted_fn1 = CompileMemcpyFn(codegen1.get());
+  ASSERT_TRUE(jitted_fn1 != NULL);
+  EXPECT_EQ(CacheHits(codegen1.get()), 0);
+  codegen1.reset();
+
+  void* jitted_fn2 = CompileMemcpyFn(codegen2.get());
+  EXPECT_EQ(CacheHits(codegen2.get()), 1);
+  EXPECT_EQ(jitted_fn1, jitted_fn2);
+
+  char src[] = "abcd";
+  char dst[] = "aaaa";
+  typedef void (*MemcpyFn)(char*, char*);
+  reinterpret_cast<MemcpyFn>(jitted_fn2)(dst, src);
+  EXPECT_EQ(memcmp(src, dst, 4), 0);
+}
+
 // Test codegen for hash
 TEST_F(LlvmCodeGenTest, HashTest) {
   ObjectPool pool;
@@ -375,6 +429,10 @@ TEST_F(LlvmCodeGenTest, HashTest) {
   // Values to compute hash on
   const char* data1 = "test string";
   const char* data2 = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+  // Long inputs are hashed in blocks of several CRC lanes. This one has no tail.
+  const char* data3 =
+      "https://www.example.com/catalog/items/0123456789/detail?ref=home&page=42";
+  ASSERT_EQ(strlen(data3) % HashUtil::CRC_INTERLEAVED_BLOCK_BYTES, 0);
 
   bool restore_sse_support = false;
 
@@ -389,12 +447,17 @@ TEST_F(LlvmCodeGenTest, HashTest) {
     Value* llvm_data2 = codegen->CastPtrToLlvmPtr(codegen->ptr_type(),
         const_cast<char*>(data2));
     Value* llvm_len1 = codegen->GetIntConstant(TYPE_INT, strlen(data1));
+    Value* llvm_data3 = codegen->CastPtrToLlvmPtr(codegen->ptr_type(),
+        const_cast<char*>(data3));
     Value* llvm_len2 = codegen->GetIntConstant(TYPE_INT, strlen(data2));
+    Value* llvm_len3 = codegen->GetIntConstant(TYPE_INT, strlen(data3));
 
     uint32_t expected_hash = 0;
     expected_hash = HashUtil::Hash(data1, strlen(data1), expected_hash);
     expected_hash = HashUtil::Hash(data2, strlen(data2), expected_hash);
     expected_hash = HashUtil::Hash(data1, strlen(data1), expected_hash);
+    expected_hash = HashUtil::Hash(data3, strlen(data3), expected_hash);
+    expected_hash = HashUtil::Hash(data3, strlen(data3), expected_hash);
 
     // Create a codegen'd function that hashes all the types and returns the results.
     // The tuple/values to hash are baked into the codegen for simplicity.
@@ -406,10 +469,12 @@ TEST_F(LlvmCodeGenTest, HashTest) {
     Function* fn_fixed = prototype.GeneratePrototype(&builder, NULL);
     Function* data1_hash_fn = codegen->GetHashFunction(strlen(data1));
     Function* data2_hash_fn = codegen->GetHashFunction(strlen(data2));
+    Function* data3_hash_fn = codegen->GetHashFunction(strlen(data3));
     Function* generic_hash_fn = codegen->GetHashFunction();
 
     ASSERT_TRUE(data1_hash_fn != NULL);
     ASSERT_TRUE(data2_hash_fn != NULL);
+    ASSERT_TRUE(data3_hash_fn != NULL);
     ASSERT_TRUE(generic_hash_fn != NULL);
 
     Value* seed = codegen->GetIntConstant(TYPE_INT, 0);
@@ -419,6 +484,10 @@ TEST_F(LlvmCodeGenTest, HashTest) {
         ArrayRef<Value*>({llvm_data2, llvm_len2, seed}));
     seed = builder.CreateCall(generic_hash_fn,
         ArrayRef<Value*>({llvm_data1, llvm_len1, seed}));
+    seed = builder.CreateCall(data3_hash_fn,
+        ArrayRef<Value*>({llvm_data3, llvm_len3, seed}));
+    seed = builder.CreateCall(generic_hash_fn,
+        ArrayRef<Value*>({llvm_data3, llvm_len3, seed}));
     builder.CreateRet(seed);
 
     fn_fixed = codegen->FinalizeFunction(fn_fixed);
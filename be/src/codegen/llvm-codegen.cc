@@ -59,7 +59,10 @@
 #include "runtime/string-value.h"
 #include "runtime/timestamp-value.h"
 #include "util/cpu-info.h"
+#include "util/hash-util.h"
 #include "util/hdfs-util.h"
+#include "util/impalad-metrics.h"
+#include "util/lru-cache.inline.h"
 #include "util/path-builder.h"
 #include "util/runtime-profile-counters.h"
 #include "util/test-info.h"
@@ -86,6 +89,9 @@ DEFINE_string(opt_module_dir, "",
     "if set, saves optimized generated IR modules to the specified directory.");
 DEFINE_string(asm_module_dir, "",
     "if set, saves disassembly for generated IR modules to the specified directory.");
+DEFINE_int64(codegen_cache_capacity, 0, "(Advanced) Maximum number of bytes of "
+    "compiled codegen modules that are cached across fragment instances. Setting this "
+    "to 0 disables the cache.");
 DECLARE_string(local_library_dir);
 
 namespace impala {
@@ -137,7 +143,8 @@ LlvmCodeGen::LlvmCodeGen(ObjectPool* pool, const string& id) :
   is_corrupt_(false),
   is_compiled_(false),
   context_(new llvm::LLVMContext()),
-  module_(NULL) {
+  module_(NULL),
+  memory_manager_(NULL) {
 
   DCHECK(llvm_initialized_) << "Must call LlvmCodeGen::InitializeLlvm first.";
 
@@ -149,6 +156,7 @@ LlvmCodeGen::LlvmCodeGen(ObjectPool* pool, const string& id) :
   compile_timer_ = ADD_TIMER(&profile_, "CompileTime");
   num_functions_ = ADD_COUNTER(&profile_, "NumFunctions", TUnit::UNIT);
   num_instructions_ = ADD_COUNTER(&profile_, "NumInstructions", TUnit::UNIT);
+  cache_hit_counter_ = ADD_COUNTER(&profile_, "ModuleCacheHit", TUnit::UNIT);
 
   loaded_functions_.resize(IRFunction::FN_END);
 }
@@ -341,15 +349,17 @@ Status LlvmCodeGen::Init(unique_ptr<Module> module) {
   EngineBuilder builder(std::move(module));
   builder.setEngineKind(EngineKind::JIT);
   builder.setOptLevel(opt_level);
-  builder.setMCJITMemoryManager(
-      unique_ptr<ImpalaMCJITMemoryManager>(new ImpalaMCJITMemoryManager()));
+  unique_ptr<ImpalaMCJITMemoryManager> memory_manager(new ImpalaMCJITMemoryManager());
+  memory_manager_ = memory_manager.get();
+  builder.setMCJITMemoryManager(std::move(memory_manager));
   builder.setMCPU(cpu_name_);
   builder.setMAttrs(cpu_attrs_);
   builder.setErrorStr(&error_string_);
 
   execution_engine_.reset(builder.create());
-  if (execution_engine_ == NULL) {
+  if (execution_engine_.get() == NULL) {
     module_ = NULL; // module_ was owned by builder.
+    memory_manager_ = NULL;
     stringstream ss;
     ss << "Could not create ExecutionEngine: " << error_string_;
     return Status(ss.str());
@@ -726,7 +736,33 @@ Status LlvmCodeGen::FinalizeModule() {
   // if the codegen object is created but no functions are successfully codegen'd.
   if (fns_to_jit_compile_.empty()) return Status::OK();
 
-  if (optimizations_enabled_ && !FLAGS_disable_optimization_passes) OptimizeModule();
+  bool optimize = optimizations_enabled_ && !FLAGS_disable_optimization_passes;
+  if (optimize) PruneModule();
+
+  // Only pruned modules are cached: the key of an unpruned module would contain all of
+  // the cross-compiled IR. The JIT listeners must outlive the execution engine, so
+  // modules with listeners are not shared either.
+  CodegenCache* cache =
+      optimize && symbol_emitter_ == NULL ? codegen_cache() : NULL;
+  string cache_key;
+  if (cache != NULL) {
+    cache_key = GetCacheKey();
+    if (cache->Get(cache_key, &compiled_module_)) {
+      if (ImpaladMetrics::CODEGEN_CACHE_HIT_COUNT != NULL) {
+        ImpaladMetrics::CODEGEN_CACHE_HIT_COUNT->Increment(1L);
+      }
+      COUNTER_SET(cache_hit_counter_, 1L);
+      for (int i = 0; i < fns_to_jit_compile_.size(); ++i) {
+        map<string, void*>::const_iterator it = compiled_module_->jitted_fns.find(
+            fns_to_jit_compile_[i].first->getName().str());
+        DCHECK(it != compiled_module_->jitted_fns.end());
+        *fns_to_jit_compile_[i].second = it->second;
+      }
+      return Status::OK();
+    }
+  }
+
+  if (optimize) OptimizeModule();
 
   if (FLAGS_opt_module_dir.size() != 0) {
     string path = FLAGS_opt_module_dir + "/" + id_ + "_opt.ll";
@@ -746,42 +782,59 @@ Status LlvmCodeGen::FinalizeModule() {
   }
 
   // Get pointers to all codegen'd functions.
+  boost::shared_ptr<CompiledModule> compiled_module;
+  if (cache != NULL) compiled_module.reset(new CompiledModule());
   for (int i = 0; i < fns_to_jit_compile_.size(); ++i) {
     Function* function = fns_to_jit_compile_[i].first;
     void* jitted_function = execution_engine_->getPointerToFunction(function);
     DCHECK(jitted_function != NULL) << "Failed to jit " << function->getName().data();
     *fns_to_jit_compile_[i].second = jitted_function;
+    if (compiled_module != NULL) {
+      compiled_module->jitted_fns[function->getName().str()] = jitted_function;
+    }
+  }
+
+  if (cache != NULL) {
+    compiled_module->context = context_;
+    compiled_module->execution_engine = execution_engine_;
+    compiled_module_ = compiled_module;
+    // The pruned module stays in memory with the compiled code. Its IR is estimated to
+    // take about as much memory as the key.
+    int64_t charge = 2 * cache_key.size() + memory_manager_->bytes_allocated();
+    cache->Put(cache_key, compiled_module_, charge);
+    if (ImpaladMetrics::CODEGEN_CACHE_MISS_COUNT != NULL) {
+      ImpaladMetrics::CODEGEN_CACHE_MISS_COUNT->Increment(1L);
+      ImpaladMetrics::CODEGEN_CACHE_TOTAL_BYTES->set_value(cache->total_charge());
+    }
   }
   return Status::OK();
 }
 
-void LlvmCodeGen::OptimizeModule() {
-  SCOPED_TIMER(optimization_timer_);
+LlvmCodeGen::CodegenCache* LlvmCodeGen::codegen_cache() {
+  if (FLAGS_codegen_cache_capacity <= 0) return NULL;
+  static CodegenCache cache(FLAGS_codegen_cache_capacity);
+  return &cache;
+}
 
-  // This pass manager will construct optimizations passes that are "typical" for
-  // c/c++ programs.  We're relying on llvm to pick the best passes for us.
-  // TODO: we can likely muck with this to get better compile speeds or write
-  // our own passes.  Our subexpression elimination optimization can be rolled into
-  // a pass.
-  PassManagerBuilder pass_builder;
-  // 2 maps to -O2
-  // TODO: should we switch to 3? (3 may not produce different IR than 2 while taking
-  // longer, but we should check)
-  pass_builder.OptLevel = 2;
-  // Don't optimize for code size (this corresponds to -O2/-O3)
-  pass_builder.SizeLevel = 0;
-  pass_builder.Inliner = createFunctionInliningPass();
+string LlvmCodeGen::GetCacheKey() const {
+  stringstream key;
+  for (const map<string, void*>::value_type& mapping: global_mappings_) {
+    key << "mapping " << mapping.first << "=" << mapping.second << "\n";
+  }
+  key << GetIR(true);
+  return key.str();
+}
 
-  // The TargetIRAnalysis pass is required to provide information about the target
-  // machine to optimisation passes, e.g. the cost model.
+void LlvmCodeGen::PruneModule() {
+  SCOPED_TIMER(optimization_timer_);
   TargetIRAnalysis target_analysis =
       execution_engine_->getTargetMachine()->getTargetIRAnalysis();
 
-  // Before running any other optimization passes, run the internalize pass, giving it
-  // the names of all functions registered by AddFunctionToJit(), followed by the
-  // global dead code elimination pass. This causes all functions not registered to be
-  // JIT'd to be marked as internal, and any internal functions that are not used are
-  // deleted by DCE pass. This greatly decreases compile time by removing unused code.
+  // Run the internalize pass, giving it the names of all functions registered by
+  // AddFunctionToJit(), followed by the global dead code elimination pass. This causes
+  // all functions not registered to be JIT'd to be marked as internal, and any internal
+  // functions that are not used are deleted by DCE pass. This greatly decreases compile
+  // time by removing unused code.
   vector<const char*> exported_fn_names;
   for (int i = 0; i < fns_to_jit_compile_.size(); ++i) {
     exported_fn_names.push_back(fns_to_jit_compile_[i].first->getName().data());
@@ -798,6 +851,29 @@ void LlvmCodeGen::OptimizeModule() {
   counter.visit(*module_);
   COUNTER_SET(num_functions_, counter.GetCount(InstructionCounter::TOTAL_FUNCTIONS));
   COUNTER_SET(num_instructions_, counter.GetCount(InstructionCounter::TOTAL_INSTS));
+}
+
+void LlvmCodeGen::OptimizeModule() {
+  SCOPED_TIMER(optimization_timer_);
+
+  // This pass manager will construct optimizations passes that are "typical" for
+  // c/c++ programs.  We're relying on llvm to pick the best passes for us.
+  // TODO: we can likely muck with this to get better compile speeds or write
+  // our own passes.  Our subexpression elimination optimization can be rolled into
+  // a pass.
+  PassManagerBuilder pass_builder;
+  // 2 maps to -O2
+  // TODO: should we switch to 3? (3 may not produce different IR than 2 while taking
+  // longer, but we should check)
+  pass_builder.OptLevel = 2;
+  // Don't optimize for code size (this corresponds to -O2/-O3)
+  pass_builder.SizeLevel = 0;
+  pass_builder.Inliner = createFunctionInliningPass();
+
+  // The TargetIRAnalysis pass is required to provide information about the target
+  // machine to optimisation passes, e.g. the cost model.
+  TargetIRAnalysis target_analysis =
+      execution_engine_->getTargetMachine()->getTargetIRAnalysis();
 
   // Create and run function pass manager
   unique_ptr<legacy::FunctionPassManager> fn_pass_manager(
@@ -811,7 +887,7 @@ void LlvmCodeGen::OptimizeModule() {
   fn_pass_manager->doFinalization();
 
   // Create and run module pass manager
-  module_pass_manager.reset(new legacy::PassManager());
+  unique_ptr<legacy::PassManager> module_pass_manager(new legacy::PassManager());
   module_pass_manager->add(createTargetTransformInfoWrapperPass(target_analysis));
   pass_builder.populateModulePassManager(*module_pass_manager);
   module_pass_manager->run(*module_);
@@ -860,6 +936,12 @@ void LlvmCodeGen::AddFunctionToJit(Function* fn, void** fn_ptr) {
   AddFunctionToJitInternal(fn, fn_ptr);
 }
 
+void LlvmCodeGen::AddGlobalMapping(Function* fn, void* addr) {
+  DCHECK(!is_compiled_);
+  global_mappings_[fn->getName().str()] = addr;
+  execution_engine_->addGlobalMapping(fn, addr);
+}
+
 void LlvmCodeGen::AddFunctionToJitInternal(Function* fn, void** fn_ptr) {
   DCHECK(!is_compiled_);
   fns_to_jit_compile_.push_back(make_pair(fn, fn_ptr));
@@ -1089,6 +1171,20 @@ void LlvmCodeGen::ClearHashFns() {
 //   %12 = call i32 @llvm.x86.sse42.crc32.32.8(i32 %9, i8 %11)
 //   ret i32 %12
 // }
+static Function* GetLenOptimizedHashFn(
+    LlvmCodeGen* codegen, IRFunction::Type f, int len) {
+  Function* fn = codegen->GetFunction(f, false);
+  DCHECK(fn != NULL);
+  if (len != -1) {
+    // Clone this function since we're going to modify it by replacing the
+    // length with num_bytes.
+    fn = codegen->CloneFunction(fn);
+    Value* len_arg = codegen->GetArgument(fn, 1);
+    len_arg->replaceAllUsesWith(codegen->GetIntConstant(TYPE_INT, len));
+  }
+  return codegen->FinalizeFunction(fn);
+}
+
 Function* LlvmCodeGen::GetHashFunction(int num_bytes) {
   if (CpuInfo::IsSupported(CpuInfo::SSE4_2)) {
     if (num_bytes == -1) {
@@ -1097,6 +1193,12 @@ Function* LlvmCodeGen::GetHashFunction(int num_bytes) {
       return GetFunction(IRFunction::HASH_CRC, false);
     }
 
+    if (num_bytes > HashUtil::CRC_INTERLEAVED_MIN_BYTES) {
+      // HashUtil::CrcHash() interleaves several CRC lanes for inputs of this size. Bake
+      // the length into the cross-compiled function rather than replicating that here.
+      return GetLenOptimizedHashFn(this, IRFunction::HASH_CRC, num_bytes);
+    }
+
     map<int, Function*>::iterator cached_fn = hash_fns_.find(num_bytes);
     if (cached_fn != hash_fns_.end()) {
       return cached_fn->second;
@@ -1182,20 +1284,6 @@ Function* LlvmCodeGen::GetHashFunction(int num_bytes) {
   }
 }
 
-static Function* GetLenOptimizedHashFn(
-    LlvmCodeGen* codegen, IRFunction::Type f, int len) {
-  Function* fn = codegen->GetFunction(f, false);
-  DCHECK(fn != NULL);
-  if (len != -1) {
-    // Clone this function since we're going to modify it by replacing the
-    // length with num_bytes.
-    fn = codegen->CloneFunction(fn);
-    Value* len_arg = codegen->GetArgument(fn, 1);
-    len_arg->replaceAllUsesWith(codegen->GetIntConstant(TYPE_INT, len));
-  }
-  return codegen->FinalizeFunction(fn);
-}
-
 Function* LlvmCodeGen::GetFnvHashFunction(int len) {
   return GetLenOptimizedHashFn(this, IRFunction::HASH_FNV, len);
 }
@@ -23,6 +23,7 @@
 #include <string>
 #include <vector>
 #include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
 
 #include <boost/unordered_set.hpp>
 
@@ -37,6 +38,7 @@
 #include "exprs/expr.h"
 #include "impala-ir/impala-ir-functions.h"
 #include "runtime/types.h"
+#include "util/lru-cache.h"
 #include "util/runtime-profile.h"
 
 /// Forward declare all llvm classes to avoid namespace pollution.
@@ -70,6 +72,7 @@ namespace impala {
 
 class CodegenAnyVal;
 class CodegenSymbolEmitter;
+class ImpalaMCJITMemoryManager;
 class SubExprElimination;
 
 /// LLVM code generator.  This is the top level object to generate jitted code.
@@ -102,6 +105,15 @@ class SubExprElimination;
 /// TODO: we should be able to do this once per process and let llvm compile
 /// functions from across modules.
 //
+/// Compiled modules can be shared across fragment instances through a process-wide
+/// cache (see --codegen_cache_capacity). FinalizeModule() prunes the module of unused
+/// functions and looks up the IR of the pruned module. On a hit, the registered function
+/// pointers are set to the code compiled for an identical module and the optimization
+/// and compilation are skipped. Since the code is keyed by the full IR, pointers to
+/// per-instance state that is embedded in the IR as constants make a module specific to
+/// its fragment instance.
+/// TODO: pass such pointers as arguments so that modules of the same plan can be shared.
+//
 /// LLVM has a nontrivial memory management scheme and objects will take
 /// ownership of others.  The document is pretty good about being explicit with this
 /// but it is not very intuitive.
@@ -247,7 +259,8 @@ class LlvmCodeGen {
 
   /// Optimize and compile the module. This should be called after all functions to JIT
   /// have been added to the module via AddFunctionToJit(). If optimizations_enabled_ is
-  /// false, the module will not be optimized before compilation.
+  /// false, the module will not be optimized before compilation. The compiled code is
+  /// taken from the codegen cache if an identical module was compiled before.
   Status FinalizeModule();
 
   /// Replaces all instructions in 'caller' that call 'target_name' with a call
@@ -293,6 +306,11 @@ class LlvmCodeGen {
   /// call non-compliant code from native code.
   void AddFunctionToJit(llvm::Function* fn, void** fn_ptr);
 
+  /// Maps the declaration 'fn' to the native code at 'addr'. Must be used instead of
+  /// calling addGlobalMapping() on the execution engine directly, so that the mapping is
+  /// part of the key of the module in the codegen cache.
+  void AddGlobalMapping(llvm::Function* fn, void* addr);
+
   /// This will generate a printf call instruction to output 'message' at the builder's
   /// insert point. If 'v1' is non-NULL, it will also be passed to the printf call. Only
   /// for debugging.
@@ -463,9 +481,35 @@ class LlvmCodeGen {
   // Used for testing.
   void ResetVerification() { is_corrupt_ = false; }
 
-  /// Optimizes the module. This includes pruning the module of any unused functions.
+  /// Removes all functions from the module that are not registered with
+  /// AddFunctionToJit() or called by them.
+  void PruneModule();
+
+  /// Optimizes the module. The module must have been pruned with PruneModule().
   void OptimizeModule();
 
+  /// The code of a compiled module, which is shared through the codegen cache. The
+  /// execution engine owns the machine code and must be destroyed before the context.
+  struct CompiledModule {
+    boost::shared_ptr<llvm::LLVMContext> context;
+    boost::shared_ptr<llvm::ExecutionEngine> execution_engine;
+
+    /// Maps the names of the functions registered with AddFunctionToJit() to their
+    /// compiled code.
+    std::map<std::string, void*> jitted_fns;
+  };
+
+  /// Process-wide cache of compiled modules. Modules are keyed by their pruned IR and
+  /// the global mappings, and charged an estimate of their memory footprint. Only
+  /// optimized modules are cached.
+  typedef LruCache<std::string, boost::shared_ptr<const CompiledModule> > CodegenCache;
+
+  /// Returns the codegen cache or NULL if it is disabled.
+  static CodegenCache* codegen_cache();
+
+  /// Returns the key of the pruned module in the codegen cache.
+  std::string GetCacheKey() const;
+
   /// Clears generated hash fns.  This is only used for testing.
   void ClearHashFns();
 
@@ -516,6 +560,9 @@ class LlvmCodeGen {
   RuntimeProfile::Counter* num_functions_;
   RuntimeProfile::Counter* num_instructions_;
 
+  /// Set to 1 if the compiled code was found in the codegen cache.
+  RuntimeProfile::Counter* cache_hit_counter_;
+
   /// whether or not optimizations are enabled
   bool optimizations_enabled_;
 
@@ -533,15 +580,28 @@ class LlvmCodeGen {
   std::string error_string_;
 
   /// Top level llvm object.  Objects from different contexts do not share anything.
-  /// We can have multiple instances of the LlvmCodeGen object in different threads
-  std::unique_ptr<llvm::LLVMContext> context_;
+  /// We can have multiple instances of the LlvmCodeGen object in different threads.
+  /// Shared with the codegen cache once the module is compiled.
+  boost::shared_ptr<llvm::LLVMContext> context_;
 
   /// Top level codegen object.  Contains everything to jit one 'unit' of code.
   /// module_ is set by Init(). module_ is owned by execution_engine_.
   llvm::Module* module_;
 
-  /// Execution/Jitting engine.
-  std::unique_ptr<llvm::ExecutionEngine> execution_engine_;
+  /// Execution/Jitting engine. Shared with the codegen cache once the module is
+  /// compiled.
+  boost::shared_ptr<llvm::ExecutionEngine> execution_engine_;
+
+  /// The memory manager of execution_engine_, which owns it.
+  ImpalaMCJITMemoryManager* memory_manager_;
+
+  /// The compiled module whose code the registered function pointers point to, if it was
+  /// found in or added to the codegen cache. Keeps the code alive while this object
+  /// exists, even if the module is evicted from the cache.
+  boost::shared_ptr<const CompiledModule> compiled_module_;
+
+  /// Addresses of the native functions mapped with AddGlobalMapping(), by name.
+  std::map<std::string, void*> global_mappings_;
 
   /// Keeps track of the external functions that have been included in this module
   /// e.g libc functions or non-jitted impala functions.
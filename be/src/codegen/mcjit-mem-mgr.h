@@ -27,12 +27,34 @@ namespace impala {
 /// doesn't handle those for us: see LLVM issue 18062.
 /// TODO: get rid of this by purging the cross-compiled IR of references to __dso_handle,
 /// which come from global variables with destructors.
+/// Also counts the bytes of the sections that are allocated for the compiled code.
 class ImpalaMCJITMemoryManager : public llvm::SectionMemoryManager {
  public:
+  ImpalaMCJITMemoryManager() : bytes_allocated_(0) {}
+
   virtual uint64_t getSymbolAddress(const std::string& name) override {
     if (name == "__dso_handle") return reinterpret_cast<uint64_t>(&__dso_handle);
     return SectionMemoryManager::getSymbolAddress(name);
   }
+
+  virtual uint8_t* allocateCodeSection(uintptr_t size, unsigned alignment,
+      unsigned section_id, llvm::StringRef section_name) override {
+    bytes_allocated_ += size;
+    return SectionMemoryManager::allocateCodeSection(
+        size, alignment, section_id, section_name);
+  }
+
+  virtual uint8_t* allocateDataSection(uintptr_t size, unsigned alignment,
+      unsigned section_id, llvm::StringRef section_name, bool is_read_only) override {
+    bytes_allocated_ += size;
+    return SectionMemoryManager::allocateDataSection(
+        size, alignment, section_id, section_name, is_read_only);
+  }
+
+  int64_t bytes_allocated() const { return bytes_allocated_; }
+
+ private:
+  int64_t bytes_allocated_;
 };
 
 }
@@ -56,12 +56,23 @@ DEFINE_bool(abort_on_config_error, true, "Abort Impala startup if there are impr
 
 DEFINE_bool(disable_mem_pools, false, "Set to true to disable memory pooling. "
     "This can be used to help diagnose memory corruption issues.");
+DEFINE_int64(mem_pool_mmap_chunk_size, 0, "(Advanced) If > 0, memory pool chunks of at "
+    "least this many bytes are mapped directly from the operating system, using huge "
+    "pages where available, and unmapped as soon as they are freed. This keeps large, "
+    "short-lived chunks from fragmenting the heap of the memory allocator. If 0, all "
+    "chunks are allocated with malloc.");
 
 DEFINE_bool(compact_catalog_topic, false, "If true, catalog updates sent via the "
     "statestore are compacted before transmission. This saves network bandwidth at the"
     " cost of a small quantity of CPU time. Enable this option in cluster with large"
     " catalogs. It must be enabled on both the catalog service, and all Impala demons.");
 
+DEFINE_bool(compress_catalog_topic, false, "If true, catalog objects sent via the "
+    "statestore are compressed with Snappy. This reduces the size of the catalog topic, "
+    "in particular of the full topic updates sent to newly started Impala daemons, at "
+    "the cost of some CPU time. It must be enabled on both the catalog service, and all "
+    "Impala demons.");
+
 DEFINE_string(redaction_rules_file, "", "Absolute path to sensitive data redaction "
     "rules. The rules will be applied to all log messages and query text shown in the "
     "Web UI and audit records. Query results will not be affected. Refer to the "
@@ -173,6 +173,8 @@ Status AggregationNode::Prepare(RuntimeState* state) {
 
 Status AggregationNode::Open(RuntimeState* state) {
   SCOPED_TIMER(runtime_profile_->total_time_counter());
+  SCOPED_PERF_EVENT_MEASUREMENT(perf_event_counters_);
+  SCOPED_CPU_SAMPLE_NODE(id_);
   RETURN_IF_ERROR(ExecNode::Open(state));
 
   RETURN_IF_ERROR(Expr::Open(probe_expr_ctxs_, state));
@@ -185,7 +187,7 @@ Status AggregationNode::Open(RuntimeState* state) {
 
   RETURN_IF_ERROR(children_[0]->Open(state));
 
-  RowBatch batch(children_[0]->row_desc(), state->batch_size(), mem_tracker());
+  RowBatch batch(children_[0]->row_desc(), ChildBatchCapacity(state, 0), mem_tracker());
   int64_t num_input_rows = 0;
   while (true) {
     bool eos;
@@ -229,6 +231,8 @@ Status AggregationNode::Open(RuntimeState* state) {
 
 Status AggregationNode::GetNext(RuntimeState* state, RowBatch* row_batch, bool* eos) {
   SCOPED_TIMER(runtime_profile_->total_time_counter());
+  SCOPED_PERF_EVENT_MEASUREMENT(perf_event_counters_);
+  SCOPED_CPU_SAMPLE_NODE(id_);
   RETURN_IF_ERROR(ExecDebugAction(TExecNodePhase::GETNEXT, state));
   RETURN_IF_CANCELLED(state);
   RETURN_IF_ERROR(QueryMaintenance(state));
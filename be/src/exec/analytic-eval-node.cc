@@ -17,6 +17,7 @@
 #include <gutil/strings/substitute.h>
 
 #include "exprs/agg-fn-evaluator.h"
+#include "runtime/raw-value.h"
 #include "runtime/buffered-tuple-stream.inline.h"
 #include "runtime/descriptors.h"
 #include "runtime/row-batch.h"
@@ -43,12 +44,14 @@ AnalyticEvalNode::AnalyticEvalNode(ObjectPool* pool, const TPlanNode& tnode,
     buffered_tuple_desc_(NULL),
     partition_by_eq_expr_ctx_(NULL),
     order_by_eq_expr_ctx_(NULL),
+    range_start_offset_expr_ctx_(NULL),
     rows_start_offset_(0),
     rows_end_offset_(0),
     has_first_val_null_offset_(false),
     first_val_null_offset_(0),
     client_(NULL),
     child_tuple_cmp_row_(NULL),
+    range_offset_cmp_row_(NULL),
     last_result_idx_(-1),
     prev_pool_last_result_idx_(-1),
     prev_pool_last_window_idx_(-1),
@@ -67,8 +70,10 @@ AnalyticEvalNode::AnalyticEvalNode(ObjectPool* pool, const TPlanNode& tnode,
     fn_scope_ = AnalyticEvalNode::PARTITION;
   } else if (tnode.analytic_node.window.type == TAnalyticWindowType::RANGE) {
     fn_scope_ = AnalyticEvalNode::RANGE;
-    DCHECK(!window_.__isset.window_start)
-      << "RANGE windows must have UNBOUNDED PRECEDING";
+    DCHECK(!window_.__isset.window_start ||
+        (window_.window_start.type == TAnalyticWindowBoundaryType::PRECEDING &&
+         window_.window_start.__isset.range_offset_predicate))
+      << "RANGE window start bound must be UNBOUNDED PRECEDING or an offset PRECEDING";
     DCHECK(!window_.__isset.window_end ||
         window_.window_end.type == TAnalyticWindowBoundaryType::CURRENT_ROW)
       << "RANGE window end bound must be CURRENT ROW or UNBOUNDED FOLLOWING";
@@ -132,6 +137,11 @@ Status AnalyticEvalNode::Init(const TPlanNode& tnode, RuntimeState* state) {
     RETURN_IF_ERROR(Expr::CreateExprTree(pool_, analytic_node.order_by_eq,
           &order_by_eq_expr_ctx_));
   }
+  if (fn_scope_ == RANGE && window_.__isset.window_start) {
+    DCHECK(analytic_node.__isset.buffered_tuple_id);
+    RETURN_IF_ERROR(Expr::CreateExprTree(pool_,
+          window_.window_start.range_offset_predicate, &range_start_offset_expr_ctx_));
+  }
   return Status::OK();
 }
 
@@ -154,8 +164,16 @@ Status AnalyticEvalNode::Prepare(RuntimeState* state) {
     fn_ctxs_.push_back(ctx);
     state->obj_pool()->Add(ctx);
   }
+  if (fn_scope_ != PARTITION && window_.__isset.window_start) {
+    for (int i = 0; i < evaluators_.size(); ++i) {
+      if (!UsesSlidingMinMax(evaluators_[i])) continue;
+      sliding_min_max_.push_back(SlidingMinMax());
+      sliding_min_max_.back().evaluator_idx = i;
+    }
+  }
 
-  if (partition_by_eq_expr_ctx_ != NULL || order_by_eq_expr_ctx_ != NULL) {
+  if (partition_by_eq_expr_ctx_ != NULL || order_by_eq_expr_ctx_ != NULL ||
+      range_start_offset_expr_ctx_ != NULL) {
     DCHECK(buffered_tuple_desc_ != NULL);
     vector<TTupleId> tuple_ids;
     tuple_ids.push_back(child(0)->row_desc().tuple_descriptors()[0]->id());
@@ -171,6 +189,11 @@ Status AnalyticEvalNode::Prepare(RuntimeState* state) {
           order_by_eq_expr_ctx_->Prepare(state, cmp_row_desc, expr_mem_tracker()));
       AddExprCtxToFree(order_by_eq_expr_ctx_);
     }
+    if (range_start_offset_expr_ctx_ != NULL) {
+      RETURN_IF_ERROR(range_start_offset_expr_ctx_->Prepare(state, cmp_row_desc,
+          expr_mem_tracker()));
+      AddExprCtxToFree(range_start_offset_expr_ctx_);
+    }
   }
 
   RETURN_IF_ERROR(state->block_mgr()->RegisterClient(
@@ -181,6 +204,8 @@ Status AnalyticEvalNode::Prepare(RuntimeState* state) {
 
 Status AnalyticEvalNode::Open(RuntimeState* state) {
   SCOPED_TIMER(runtime_profile_->total_time_counter());
+  SCOPED_PERF_EVENT_MEASUREMENT(perf_event_counters_);
+  SCOPED_CPU_SAMPLE_NODE(id_);
   RETURN_IF_ERROR(ExecNode::Open(state));
   RETURN_IF_CANCELLED(state);
   RETURN_IF_ERROR(QueryMaintenance(state));
@@ -223,6 +248,9 @@ Status AnalyticEvalNode::Open(RuntimeState* state) {
   if (order_by_eq_expr_ctx_ != NULL) {
     RETURN_IF_ERROR(order_by_eq_expr_ctx_->Open(state));
   }
+  if (range_start_offset_expr_ctx_ != NULL) {
+    RETURN_IF_ERROR(range_start_offset_expr_ctx_->Open(state));
+  }
 
   if (buffered_tuple_desc_ != NULL) {
     // The backing mem_pool_ is freed in Reset(), so we need to allocate
@@ -230,6 +258,10 @@ Status AnalyticEvalNode::Open(RuntimeState* state) {
     child_tuple_cmp_row_ = reinterpret_cast<TupleRow*>(
         mem_pool_->Allocate(sizeof(Tuple*) * 2));
   }
+  if (range_start_offset_expr_ctx_ != NULL) {
+    range_offset_cmp_row_ = reinterpret_cast<TupleRow*>(
+        mem_pool_->Allocate(sizeof(Tuple*) * 2));
+  }
 
   // An intermediate tuple is only allocated once and is reused.
   curr_tuple_ = Tuple::Create(intermediate_tuple_desc_->byte_size(), mem_pool_.get());
@@ -243,9 +275,9 @@ Status AnalyticEvalNode::Open(RuntimeState* state) {
 
   // Initialize state for the first partition.
   RETURN_IF_ERROR(InitNextPartition(state, 0));
-  prev_child_batch_.reset(new RowBatch(child(0)->row_desc(), state->batch_size(),
+  prev_child_batch_.reset(new RowBatch(child(0)->row_desc(), ChildBatchCapacity(state, 0),
       mem_tracker()));
-  curr_child_batch_.reset(new RowBatch(child(0)->row_desc(), state->batch_size(),
+  curr_child_batch_.reset(new RowBatch(child(0)->row_desc(), ChildBatchCapacity(state, 0),
       mem_tracker()));
   return Status::OK();
 }
@@ -258,8 +290,8 @@ string DebugWindowBoundString(const TAnalyticWindowBoundary& b) {
   if (b.__isset.rows_offset_value) {
     ss << b.rows_offset_value;
   } else {
-    // TODO: Return debug string when range offsets are supported
-    DCHECK(false) << "Range offsets not yet implemented";
+    DCHECK(b.__isset.range_offset_predicate);
+    ss << "RANGE_OFFSET";
   }
   if (b.type == TAnalyticWindowBoundaryType::PRECEDING) {
     ss << " PRECEDING";
@@ -351,6 +383,7 @@ inline Status AnalyticEvalNode::AddRow(int64_t stream_idx, TupleRow* row) {
           *child(0)->row_desc().tuple_descriptors()[0],
           curr_tuple_pool_.get());
       window_tuples_.push_back(pair<int64_t, Tuple*>(stream_idx, tuple));
+      if (!sliding_min_max_.empty()) AddToSlidingMinMax(stream_idx, tuple);
     }
   }
 
@@ -397,10 +430,27 @@ inline void AnalyticEvalNode::TryAddResultTupleForPrevRow(bool next_partition,
   if (fn_scope_ == ROWS) return;
   if (next_partition || (fn_scope_ == RANGE && window_.__isset.window_end &&
       !PrevRowCompare(order_by_eq_expr_ctx_))) {
+    TryRemoveRowsBeforeRangeStart(prev_input_row_);
     AddResultTuple(stream_idx - 1);
   }
 }
 
+inline void AnalyticEvalNode::TryRemoveRowsBeforeRangeStart(TupleRow* row) {
+  if (range_start_offset_expr_ctx_ == NULL) return;
+  // The input is sorted on the order by exprs, so the start bound never moves back and
+  // the tuples before it are always at the front of window_tuples_.
+  range_offset_cmp_row_->SetTuple(1, row->GetTuple(0));
+  while (!window_tuples_.empty()) {
+    range_offset_cmp_row_->SetTuple(0, window_tuples_.front().second);
+    BooleanVal before_start =
+        range_start_offset_expr_ctx_->GetBooleanVal(range_offset_cmp_row_);
+    if (before_start.is_null || !before_start.val) break;
+    VLOG_ROW << id() << " Remove window_row_idx=" << window_tuples_.front().first
+             << " before range start";
+    RemoveFirstWindowTuple();
+  }
+}
+
 inline void AnalyticEvalNode::TryAddResultTupleForCurrRow(int64_t stream_idx,
     TupleRow* row) {
   VLOG_ROW << id() << " TryAddResultTupleForCurrRow idx=" << stream_idx;
@@ -424,18 +474,79 @@ inline void AnalyticEvalNode::TryRemoveRowsBeforeWindow(int64_t stream_idx) {
   DCHECK(!window_tuples_.empty()) << DebugStateString(true);
   DCHECK_EQ(remove_idx + max<int64_t>(rows_start_offset_, 0),
       window_tuples_.front().first) << DebugStateString(true);
+  RemoveFirstWindowTuple();
+}
+
+bool AnalyticEvalNode::UsesSlidingMinMax(const AggFnEvaluator* evaluator) {
+  if (evaluator->SupportsRemove()) return false;
+  if (evaluator->agg_op() != AggFnEvaluator::MIN &&
+      evaluator->agg_op() != AggFnEvaluator::MAX) {
+    return false;
+  }
+  if (evaluator->input_expr_ctxs().size() != 1) return false;
+  const Expr* input_expr = evaluator->input_expr_ctxs()[0]->root();
+  // Re-initializing the evaluator would not free the copy of a string result.
+  return input_expr->is_slotref() && !input_expr->type().IsVarLenStringType();
+}
+
+void AnalyticEvalNode::RemoveFirstWindowTuple() {
+  DCHECK(!window_tuples_.empty());
+  int64_t remove_idx = window_tuples_.front().first;
   TupleRow* remove_row = reinterpret_cast<TupleRow*>(&window_tuples_.front().second);
-  AggFnEvaluator::Remove(evaluators_, fn_ctxs_, remove_row, curr_tuple_);
+  if (sliding_min_max_.empty()) {
+    AggFnEvaluator::Remove(evaluators_, fn_ctxs_, remove_row, curr_tuple_);
+  } else {
+    for (int i = 0; i < evaluators_.size(); ++i) {
+      if (UsesSlidingMinMax(evaluators_[i])) continue;
+      evaluators_[i]->Remove(fn_ctxs_[i], remove_row, curr_tuple_);
+    }
+    for (SlidingMinMax& window: sliding_min_max_) {
+      if (!window.tuples.empty() && window.tuples.front().first == remove_idx) {
+        window.tuples.pop_front();
+      }
+      // Recompute the result from the best remaining tuple.
+      AggFnEvaluator* evaluator = evaluators_[window.evaluator_idx];
+      impala_udf::FunctionContext* fn_ctx = fn_ctxs_[window.evaluator_idx];
+      evaluator->Init(fn_ctx, curr_tuple_);
+      if (window.tuples.empty()) continue;
+      TupleRow* best_row = reinterpret_cast<TupleRow*>(&window.tuples.front().second);
+      evaluator->Add(fn_ctx, best_row, curr_tuple_);
+    }
+  }
   window_tuples_.pop_front();
 }
 
+void AnalyticEvalNode::AddToSlidingMinMax(int64_t stream_idx, Tuple* tuple) {
+  TupleRow* row = reinterpret_cast<TupleRow*>(&tuple);
+  for (SlidingMinMax& window: sliding_min_max_) {
+    AggFnEvaluator* evaluator = evaluators_[window.evaluator_idx];
+    ExprContext* input_ctx = evaluator->input_expr_ctxs()[0];
+    // The input is a slot, so the value points into 'tuple'.
+    void* value = input_ctx->GetValue(row);
+    // MIN() and MAX() ignore NULLs.
+    if (value == NULL) continue;
+    const ColumnType& type = input_ctx->root()->type();
+    bool is_min = evaluator->agg_op() == AggFnEvaluator::MIN;
+    while (!window.tuples.empty()) {
+      TupleRow* back_row = reinterpret_cast<TupleRow*>(&window.tuples.back().second);
+      int result = RawValue::Compare(input_ctx->GetValue(back_row), value, type);
+      if (is_min ? result < 0 : result > 0) break;
+      window.tuples.pop_back();
+    }
+    window.tuples.push_back(make_pair(stream_idx, tuple));
+  }
+}
+
 inline void AnalyticEvalNode::TryAddRemainingResults(int64_t partition_idx,
     int64_t prev_partition_idx) {
   DCHECK_LT(prev_partition_idx, partition_idx);
   // For PARTITION, RANGE, or ROWS with UNBOUNDED PRECEDING: add a result tuple for the
   // remaining rows in the partition that do not have an associated result tuple yet.
   if (fn_scope_ != ROWS || !window_.__isset.window_end) {
-    if (last_result_idx_ < partition_idx - 1) AddResultTuple(partition_idx - 1);
+    if (last_result_idx_ < partition_idx - 1) {
+      if (fn_scope_ == RANGE) TryRemoveRowsBeforeRangeStart(prev_input_row_);
+      AddResultTuple(partition_idx - 1);
+    }
     return;
   }
 
@@ -460,9 +571,7 @@ inline void AnalyticEvalNode::TryAddRemainingResults(int64_t partition_idx,
       // and add the result tuple at the next index.
       VLOG_ROW << id() << " Remove window_row_idx=" << window_tuples_.front().first
                << " for result row at idx=" << next_result_idx;
-      TupleRow* remove_row = reinterpret_cast<TupleRow*>(&window_tuples_.front().second);
-      AggFnEvaluator::Remove(evaluators_, fn_ctxs_, remove_row, curr_tuple_);
-      window_tuples_.pop_front();
+      RemoveFirstWindowTuple();
     }
     AddResultTuple(last_result_idx_ + 1);
   }
@@ -520,6 +629,7 @@ inline Status AnalyticEvalNode::InitNextPartition(RuntimeState* state,
     TryAddRemainingResults(stream_idx, prev_partition_stream_idx);
   }
   window_tuples_.clear();
+  for (SlidingMinMax& window: sliding_min_max_) window.tuples.clear();
 
   VLOG_ROW << id() << " Reset curr_tuple";
   // Call finalize to release resources; result is not needed but the dst tuple must be
@@ -733,6 +843,8 @@ inline int64_t AnalyticEvalNode::NumOutputRowsReady() const {
 
 Status AnalyticEvalNode::GetNext(RuntimeState* state, RowBatch* row_batch, bool* eos) {
   SCOPED_TIMER(runtime_profile_->total_time_counter());
+  SCOPED_PERF_EVENT_MEASUREMENT(perf_event_counters_);
+  SCOPED_CPU_SAMPLE_NODE(id_);
   RETURN_IF_ERROR(ExecDebugAction(TExecNodePhase::GETNEXT, state));
   RETURN_IF_CANCELLED(state);
   RETURN_IF_ERROR(QueryMaintenance(state));
@@ -789,6 +901,7 @@ Status AnalyticEvalNode::GetNext(RuntimeState* state, RowBatch* row_batch, bool*
 Status AnalyticEvalNode::Reset(RuntimeState* state) {
   result_tuples_.clear();
   window_tuples_.clear();
+  for (SlidingMinMax& window: sliding_min_max_) window.tuples.clear();
   last_result_idx_ = -1;
   curr_partition_idx_ = -1;
   prev_pool_last_result_idx_ = -1;
@@ -811,6 +924,7 @@ Status AnalyticEvalNode::Reset(RuntimeState* state) {
   DCHECK(input_stream_ == NULL); // input_stream_ should have been attached to last batch.
   curr_tuple_ = NULL;
   child_tuple_cmp_row_ = NULL;
+  range_offset_cmp_row_ = NULL;
   dummy_result_tuple_ = NULL;
   prev_input_row_ = NULL;
   prev_child_batch_.reset();
@@ -844,6 +958,7 @@ void AnalyticEvalNode::Close(RuntimeState* state) {
 
   if (partition_by_eq_expr_ctx_ != NULL) partition_by_eq_expr_ctx_->Close(state);
   if (order_by_eq_expr_ctx_ != NULL) order_by_eq_expr_ctx_->Close(state);
+  if (range_start_offset_expr_ctx_ != NULL) range_start_offset_expr_ctx_->Close(state);
   if (prev_child_batch_.get() != NULL) prev_child_batch_.reset();
   if (curr_child_batch_.get() != NULL) curr_child_batch_.reset();
   if (curr_tuple_pool_.get() != NULL) curr_tuple_pool_->FreeAll();
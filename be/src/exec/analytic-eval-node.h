@@ -15,6 +15,8 @@
 #ifndef IMPALA_EXEC_ANALYTIC_EVAL_NODE_H
 #define IMPALA_EXEC_ANALYTIC_EVAL_NODE_H
 
+#include <deque>
+
 #include "exec/exec-node.h"
 #include "exprs/expr.h"
 #include "exprs/expr-context.h"
@@ -47,6 +49,17 @@ class AggFnEvaluator;
 /// an entire partition) so result_tuples_ stores a pair of the stream index (the last
 /// row in the stream it applies to) and the tuple.
 ///
+/// RANGE windows may have an offset PRECEDING start bound (with a CURRENT ROW end bound),
+/// e.g. "RANGE BETWEEN 10 PRECEDING AND CURRENT ROW" over a numeric or timestamp order
+/// by expr. The planner supplies a predicate that checks if a buffered window tuple is
+/// before the start bound of a row; the window tuples are removed from the front of
+/// window_tuples_ as the order by values of the rows advance.
+/// TODO: offset FOLLOWING end bounds for RANGE windows.
+/// TODO: evaluate partitions in parallel. All evaluators_ share one curr_tuple_ and one
+/// set of fn_ctxs_, and result_tuples_ and window_tuples_ are indexes into the single
+/// input_stream_, so a worker per partition needs cloned function and expr contexts and
+/// its own stream, and output must be merged back in partition order.
+///
 /// Input rows are consumed in a streaming fashion until enough input has been consumed
 /// in order to produce enough output rows. In some cases, this may mean that only a
 /// single input batch is needed to produce the results for an output batch, e.g.
@@ -105,10 +118,32 @@ class AnalyticEvalNode : public ExecNode {
     /// rows are buffered in window_tuples_ because they must later be removed from the
     /// window (by calling AggFnEvaluator::Remove() with the expired tuple to remove it
     /// from the current row). When either the start or end boundaries are offset from the
-    /// current row, there is special casing around partition boundaries.
+    /// current row, there is special casing around partition boundaries. MIN() and MAX()
+    /// cannot remove values, and instead keep the candidates for their result in a
+    /// monotonic queue of window tuples (see SlidingMinMax).
     ROWS
   };
 
+  /// The window tuples that may still become the result of a MIN() or MAX() evaluator
+  /// without a Remove() function, in the order in which they were added to the window.
+  /// A tuple is dropped from the back of 'tuples' when a tuple with a better or equal
+  /// value is added, since it is removed from the window first. The values in 'tuples'
+  /// are therefore strictly increasing for MAX() (decreasing for MIN()) from back to
+  /// front, and the front is the result for the current window. Each tuple is added and
+  /// dropped once, for an amortized O(1) cost per input row.
+  struct SlidingMinMax {
+    /// Index into evaluators_.
+    int evaluator_idx;
+
+    /// Indices into input_stream_ and window tuples, a subset of window_tuples_.
+    std::deque<std::pair<int64_t, Tuple*> > tuples;
+  };
+
+  /// Returns true if 'evaluator' is evaluated with a SlidingMinMax over ROWS windows
+  /// with a start bound. This requires the input to be a slot of a fixed-length type, so
+  /// that the values of all window tuples can be referenced at the same time.
+  static bool UsesSlidingMinMax(const AggFnEvaluator* evaluator);
+
   /// Evaluates analytic functions over curr_child_batch_. Each input row is passed
   /// to the evaluators and added to input_stream_ where they are stored until a tuple
   /// containing the results of the analytic functions for that row is ready to be
@@ -151,6 +186,18 @@ class AnalyticEvalNode : public ExecNode {
   /// ProcessChildBatch().
   void TryRemoveRowsBeforeWindow(int64_t stream_idx);
 
+  /// Removes the window tuples that are before the start bound of the RANGE window of
+  /// 'row', the last row of a group of rows with the same order by values. Only used if
+  /// the start bound is an offset, see range_start_offset_expr_ctx_.
+  void TryRemoveRowsBeforeRangeStart(TupleRow* row);
+
+  /// Removes the front of window_tuples_ from curr_tuple_. Evaluators that use a
+  /// SlidingMinMax are re-initialized with the front of their queue instead.
+  void RemoveFirstWindowTuple();
+
+  /// Adds 'tuple', the window tuple of the row at 'stream_idx', to sliding_min_max_.
+  void AddToSlidingMinMax(int64_t stream_idx, Tuple* tuple);
+
   /// Initializes state at the start of a new partition. stream_idx is the index of the
   /// current input row from input_stream_.
   Status InitNextPartition(RuntimeState* state, int64_t stream_idx);
@@ -204,6 +251,12 @@ class AnalyticEvalNode : public ExecNode {
   /// order by exprs.
   ExprContext* order_by_eq_expr_ctx_;
 
+  /// Expr context for the range_offset_predicate of the start bound of a RANGE window,
+  /// NULL if the start bound is not an offset. Evaluated over range_offset_cmp_row_, it
+  /// returns true if the window tuple is before the start bound of the window of the
+  /// buffered tuple's row. A NULL result keeps the window tuple.
+  ExprContext* range_start_offset_expr_ctx_;
+
   /// The scope over which analytic functions are evaluated.
   /// TODO: Consider adding additional state to capture whether different kinds of window
   /// bounds need to be maintained, e.g. (fn_scope_ == ROWS && window_.__isset.end_bound).
@@ -222,6 +275,11 @@ class AnalyticEvalNode : public ExecNode {
   /// determine which slots need to be reset.
   std::vector<bool> is_lead_fn_;
 
+  /// One entry for each evaluator for which UsesSlidingMinMax() is true, if the window
+  /// has a start bound. Set in Prepare(), the queues are cleared with
+  /// window_tuples_.
+  std::vector<SlidingMinMax> sliding_min_max_;
+
   /// If true, evaluating FIRST_VALUE requires special null handling when initializing new
   /// partitions determined by the offset. Set in Open() by inspecting the agg fns.
   bool has_first_val_null_offset_;
@@ -256,6 +314,11 @@ class AnalyticEvalNode : public ExecNode {
   /// buffered_tuple_desc_ is not NULL, allocated from mem_pool_.
   TupleRow* child_tuple_cmp_row_;
 
+  /// TupleRow* composed of a window tuple and the buffered tuple, used by
+  /// range_start_offset_expr_ctx_. Set in Open() if range_start_offset_expr_ctx_ is not
+  /// NULL, allocated from mem_pool_.
+  TupleRow* range_offset_cmp_row_;
+
   /// Queue of tuples which are ready to be set in output rows, with the index into
   /// the input_stream_ stream of the last TupleRow that gets the Tuple, i.e. this is a
   /// sparse structure. For example, if result_tuples_ contains tuples with indexes x1 and
@@ -126,7 +126,7 @@ Status BlockingJoinNode::Prepare(RuntimeState* state) {
   }
 
   probe_batch_.reset(
-      new RowBatch(child(0)->row_desc(), state->batch_size(), mem_tracker()));
+      new RowBatch(child(0)->row_desc(), ChildBatchCapacity(state, 0), mem_tracker()));
   return Status::OK();
 }
 
@@ -142,6 +142,9 @@ void BlockingJoinNode::BuildSideThread(RuntimeState* state, Promise<Status>* sta
   Status s;
   {
     SCOPED_TIMER(state->total_cpu_timer());
+    SCOPED_PERF_EVENT_MEASUREMENT(perf_event_counters_);
+    ScopedCpuSampleQuery sample_query(state->query_id());
+    SCOPED_CPU_SAMPLE_NODE(id_);
     s = ConstructBuildSide(state);
   }
   // IMPALA-1863: If the build-side thread failed, then we need to close the right
@@ -159,6 +162,8 @@ void BlockingJoinNode::BuildSideThread(RuntimeState* state, Promise<Status>* sta
 
 Status BlockingJoinNode::Open(RuntimeState* state) {
   SCOPED_TIMER(runtime_profile_->total_time_counter());
+  SCOPED_PERF_EVENT_MEASUREMENT(perf_event_counters_);
+  SCOPED_CPU_SAMPLE_NODE(id_);
   RETURN_IF_ERROR(ExecNode::Open(state));
   RETURN_IF_CANCELLED(state);
   RETURN_IF_ERROR(QueryMaintenance(state));
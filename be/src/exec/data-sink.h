@@ -52,6 +52,11 @@ class DataSink {
   /// eos should be true when the last batch is passed to Send()
   virtual Status Send(RuntimeState* state, RowBatch* batch, bool eos) = 0;
 
+  /// Returns true if the consumers of the sink need no more rows, e.g. because they
+  /// reached their limit. The fragment then stops producing rows and calls
+  /// FlushFinal() right away.
+  virtual bool IsDone() { return false; }
+
   /// Flushes any remaining buffered state.
   /// Further Send() calls are illegal after FlushFinal(). This is to be called only
   /// before calling Close().
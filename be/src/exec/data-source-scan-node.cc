@@ -89,6 +89,8 @@ Status DataSourceScanNode::Prepare(RuntimeState* state) {
 
 Status DataSourceScanNode::Open(RuntimeState* state) {
   SCOPED_TIMER(runtime_profile_->total_time_counter());
+  SCOPED_PERF_EVENT_MEASUREMENT(perf_event_counters_);
+  SCOPED_CPU_SAMPLE_NODE(id_);
   RETURN_IF_ERROR(ExecNode::Open(state));
   RETURN_IF_CANCELLED(state);
 
@@ -172,6 +174,7 @@ inline Status SetDecimalVal(const ColumnType& type, char* bytes, int len,
           ParquetPlainEncoder::Decode(buffer, buffer + len, len, val) < 0)) {
         return Status(ERROR_INVALID_DECIMAL);
       }
+      break;
     }
     case 8: {
       Decimal8Value* val = reinterpret_cast<Decimal8Value*>(slot);
@@ -194,101 +197,149 @@ inline Status SetDecimalVal(const ColumnType& type, char* bytes, int len,
   return Status::OK();
 }
 
-Status DataSourceScanNode::MaterializeNextRow(MemPool* tuple_pool, Tuple* tuple) {
+// Copies the values of a fixed-width column from 'vals', starting at 'val_idx', into the
+// slots at 'slot_offset' of the 'num_rows' tuples at 'tuple_mem' whose rows are not NULL.
+template <typename T, typename V>
+static void CopyColumnValues(const vector<V>& vals, int val_idx,
+    const vector<bool>& is_null, int first_row, int num_rows, int tuple_size,
+    int slot_offset, uint8_t* tuple_mem) {
+  uint8_t* slot = tuple_mem + slot_offset;
+  for (int i = 0; i < num_rows; ++i, slot += tuple_size) {
+    if (is_null[first_row + i]) continue;
+    *reinterpret_cast<T*>(slot) = vals[val_idx++];
+  }
+}
+
+Status DataSourceScanNode::MaterializeRows(MemPool* tuple_pool, int num_rows,
+    uint8_t* tuple_mem) {
   const vector<TColumnData>& cols = input_batch_->rows.cols;
-  tuple->Init(tuple_desc_->byte_size());
+  const int tuple_size = tuple_desc_->byte_size();
+  memset(tuple_mem, 0, num_rows * tuple_size);
 
   for (int i = 0; i < tuple_desc_->slots().size(); ++i) {
     const SlotDescriptor* slot_desc = tuple_desc_->slots()[i];
-    void* slot = tuple->GetSlot(slot_desc->tuple_offset());
+    const int slot_offset = slot_desc->tuple_offset();
     const TColumnData& col = cols[i];
 
-    if (col.is_null[next_row_idx_]) {
-      tuple->SetNull(slot_desc->null_indicator_offset());
-      continue;
+    // Set the NULL indicators and count the values of this column in the rows.
+    int num_vals = 0;
+    for (int j = 0; j < num_rows; ++j) {
+      if (col.is_null[next_row_idx_ + j]) {
+        reinterpret_cast<Tuple*>(tuple_mem + j * tuple_size)->SetNull(
+            slot_desc->null_indicator_offset());
+      } else {
+        ++num_vals;
+      }
     }
+    if (num_vals == 0) continue;
+    // Get and advance the index into the values array (e.g. int_vals) for this col.
+    int val_idx = cols_next_val_idx_[i];
+    size_t end_val_idx = val_idx + num_vals;
+    cols_next_val_idx_[i] += num_vals;
 
-    // Get and increment the index into the values array (e.g. int_vals) for this col.
-    int val_idx = cols_next_val_idx_[i]++;
     switch (slot_desc->type().type) {
       case TYPE_STRING: {
-          if (val_idx >= col.string_vals.size()) {
-            return Status(Substitute(ERROR_INVALID_COL_DATA, "STRING"));
-          }
-          const string& val = col.string_vals[val_idx];
-          size_t val_size = val.size();
-          char* buffer = reinterpret_cast<char*>(tuple_pool->TryAllocate(val_size));
-          if (UNLIKELY(buffer == NULL)) {
-            string details = Substitute(ERROR_MEM_LIMIT_EXCEEDED, "MaterializeNextRow",
-                val_size, "string slot");
-            return tuple_pool->mem_tracker()->MemLimitExceeded(NULL, details, val_size);
-          }
-          memcpy(buffer, val.data(), val_size);
+        if (end_val_idx > col.string_vals.size()) {
+          return Status(Substitute(ERROR_INVALID_COL_DATA, "STRING"));
+        }
+        // Allocate the string data of all rows at once.
+        int64_t total_size = 0;
+        for (int j = val_idx; j < end_val_idx; ++j) {
+          total_size += col.string_vals[j].size();
+        }
+        char* buffer = reinterpret_cast<char*>(tuple_pool->TryAllocate(total_size));
+        if (UNLIKELY(buffer == NULL && total_size > 0)) {
+          string details = Substitute(ERROR_MEM_LIMIT_EXCEEDED, "MaterializeRows",
+              total_size, "string slots");
+          return tuple_pool->mem_tracker()->MemLimitExceeded(NULL, details, total_size);
+        }
+        uint8_t* slot = tuple_mem + slot_offset;
+        for (int j = 0; j < num_rows; ++j, slot += tuple_size) {
+          if (col.is_null[next_row_idx_ + j]) continue;
+          const string& val = col.string_vals[val_idx++];
+          memcpy(buffer, val.data(), val.size());
           reinterpret_cast<StringValue*>(slot)->ptr = buffer;
-          reinterpret_cast<StringValue*>(slot)->len = val_size;
-          break;
+          reinterpret_cast<StringValue*>(slot)->len = val.size();
+          buffer += val.size();
         }
+        break;
+      }
       case TYPE_TINYINT:
-        if (val_idx >= col.byte_vals.size()) {
+        if (end_val_idx > col.byte_vals.size()) {
           return Status(Substitute(ERROR_INVALID_COL_DATA, "TINYINT"));
         }
-        *reinterpret_cast<int8_t*>(slot) = col.byte_vals[val_idx];
+        CopyColumnValues<int8_t>(col.byte_vals, val_idx, col.is_null, next_row_idx_,
+            num_rows, tuple_size, slot_offset, tuple_mem);
         break;
       case TYPE_SMALLINT:
-        if (val_idx >= col.short_vals.size()) {
+        if (end_val_idx > col.short_vals.size()) {
           return Status(Substitute(ERROR_INVALID_COL_DATA, "SMALLINT"));
         }
-        *reinterpret_cast<int16_t*>(slot) = col.short_vals[val_idx];
+        CopyColumnValues<int16_t>(col.short_vals, val_idx, col.is_null, next_row_idx_,
+            num_rows, tuple_size, slot_offset, tuple_mem);
         break;
       case TYPE_INT:
-        if (val_idx >= col.int_vals.size()) {
+        if (end_val_idx > col.int_vals.size()) {
           return Status(Substitute(ERROR_INVALID_COL_DATA, "INT"));
         }
-        *reinterpret_cast<int32_t*>(slot) = col.int_vals[val_idx];
+        CopyColumnValues<int32_t>(col.int_vals, val_idx, col.is_null, next_row_idx_,
+            num_rows, tuple_size, slot_offset, tuple_mem);
         break;
       case TYPE_BIGINT:
-        if (val_idx >= col.long_vals.size()) {
+        if (end_val_idx > col.long_vals.size()) {
           return Status(Substitute(ERROR_INVALID_COL_DATA, "BIGINT"));
         }
-        *reinterpret_cast<int64_t*>(slot) = col.long_vals[val_idx];
+        CopyColumnValues<int64_t>(col.long_vals, val_idx, col.is_null, next_row_idx_,
+            num_rows, tuple_size, slot_offset, tuple_mem);
         break;
       case TYPE_DOUBLE:
-        if (val_idx >= col.double_vals.size()) {
+        if (end_val_idx > col.double_vals.size()) {
           return Status(Substitute(ERROR_INVALID_COL_DATA, "DOUBLE"));
         }
-        *reinterpret_cast<double*>(slot) = col.double_vals[val_idx];
+        CopyColumnValues<double>(col.double_vals, val_idx, col.is_null, next_row_idx_,
+            num_rows, tuple_size, slot_offset, tuple_mem);
         break;
       case TYPE_FLOAT:
-        if (val_idx >= col.double_vals.size()) {
+        if (end_val_idx > col.double_vals.size()) {
           return Status(Substitute(ERROR_INVALID_COL_DATA, "FLOAT"));
         }
-        *reinterpret_cast<float*>(slot) = col.double_vals[val_idx];
+        CopyColumnValues<float>(col.double_vals, val_idx, col.is_null, next_row_idx_,
+            num_rows, tuple_size, slot_offset, tuple_mem);
         break;
       case TYPE_BOOLEAN:
-        if (val_idx >= col.bool_vals.size()) {
+        if (end_val_idx > col.bool_vals.size()) {
           return Status(Substitute(ERROR_INVALID_COL_DATA, "BOOLEAN"));
         }
-        *reinterpret_cast<int8_t*>(slot) = col.bool_vals[val_idx];
+        CopyColumnValues<int8_t>(col.bool_vals, val_idx, col.is_null, next_row_idx_,
+            num_rows, tuple_size, slot_offset, tuple_mem);
         break;
       case TYPE_TIMESTAMP: {
-        if (val_idx >= col.binary_vals.size()) {
+        if (end_val_idx > col.binary_vals.size()) {
           return Status(Substitute(ERROR_INVALID_COL_DATA, "TIMESTAMP"));
         }
-        const string& val = col.binary_vals[val_idx];
-        if (val.size() != TIMESTAMP_SIZE) return Status(ERROR_INVALID_TIMESTAMP);
-        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(val.data());
-        *reinterpret_cast<TimestampValue*>(slot) = TimestampValue(
-            ReadWriteUtil::GetInt<uint64_t>(bytes),
-            ReadWriteUtil::GetInt<uint32_t>(bytes + sizeof(int64_t)));
+        uint8_t* slot = tuple_mem + slot_offset;
+        for (int j = 0; j < num_rows; ++j, slot += tuple_size) {
+          if (col.is_null[next_row_idx_ + j]) continue;
+          const string& val = col.binary_vals[val_idx++];
+          if (val.size() != TIMESTAMP_SIZE) return Status(ERROR_INVALID_TIMESTAMP);
+          const uint8_t* bytes = reinterpret_cast<const uint8_t*>(val.data());
+          *reinterpret_cast<TimestampValue*>(slot) = TimestampValue(
+              ReadWriteUtil::GetInt<uint64_t>(bytes),
+              ReadWriteUtil::GetInt<uint32_t>(bytes + sizeof(int64_t)));
+        }
         break;
       }
       case TYPE_DECIMAL: {
-        if (val_idx >= col.binary_vals.size()) {
+        if (end_val_idx > col.binary_vals.size()) {
           return Status(Substitute(ERROR_INVALID_COL_DATA, "DECIMAL"));
         }
-        const string& val = col.binary_vals[val_idx];
-        RETURN_IF_ERROR(SetDecimalVal(slot_desc->type(), const_cast<char*>(val.data()),
-            val.size(), slot));
+        uint8_t* slot = tuple_mem + slot_offset;
+        for (int j = 0; j < num_rows; ++j, slot += tuple_size) {
+          if (col.is_null[next_row_idx_ + j]) continue;
+          const string& val = col.binary_vals[val_idx++];
+          RETURN_IF_ERROR(SetDecimalVal(slot_desc->type(),
+              const_cast<char*>(val.data()), val.size(), slot));
+        }
         break;
       }
       default:
@@ -303,6 +354,8 @@ Status DataSourceScanNode::GetNext(RuntimeState* state, RowBatch* row_batch, boo
   RETURN_IF_CANCELLED(state);
   RETURN_IF_ERROR(QueryMaintenance(state));
   SCOPED_TIMER(runtime_profile_->total_time_counter());
+  SCOPED_PERF_EVENT_MEASUREMENT(perf_event_counters_);
+  SCOPED_CPU_SAMPLE_NODE(id_);
   if (ReachedLimit()) {
     *eos = true;
     return Status::OK();
@@ -315,7 +368,7 @@ Status DataSourceScanNode::GetNext(RuntimeState* state, RowBatch* row_batch, boo
   uint8_t* tuple_buffer;
   RETURN_IF_ERROR(
       row_batch->ResizeAndAllocateTupleBuffer(state, &tuple_buffer_size, &tuple_buffer));
-  Tuple* tuple = reinterpret_cast<Tuple*>(tuple_buffer);
+  const int tuple_size = tuple_desc_->byte_size();
   ExprContext** ctxs = &conjunct_ctxs_[0];
   int num_ctxs = conjunct_ctxs_.size();
 
@@ -324,18 +377,33 @@ Status DataSourceScanNode::GetNext(RuntimeState* state, RowBatch* row_batch, boo
       SCOPED_TIMER(materialize_tuple_timer());
       // copy rows until we hit the limit/capacity or until we exhaust input_batch_
       while (!ReachedLimit() && !row_batch->AtCapacity() && InputBatchHasNext()) {
-        RETURN_IF_ERROR(MaterializeNextRow(tuple_pool, tuple));
-        int row_idx = row_batch->AddRow();
-        TupleRow* tuple_row = row_batch->GetRow(row_idx);
-        tuple_row->SetTuple(tuple_idx_, tuple);
-
-        if (ExecNode::EvalConjuncts(ctxs, num_ctxs, tuple_row)) {
-          row_batch->CommitLastRow();
-          tuple = reinterpret_cast<Tuple*>(
-              reinterpret_cast<uint8_t*>(tuple) + tuple_desc_->byte_size());
-          ++num_rows_returned_;
+        // Materialize as many rows as fit into the row batch column by column, then
+        // evaluate the conjuncts row by row. The tuples of rows that pass are moved
+        // down so that the next rows are materialized after the last committed tuple.
+        int num_rows = min<int64_t>(row_batch->capacity() - row_batch->num_rows(),
+            num_rows_ - next_row_idx_);
+        if (limit_ != -1 && num_ctxs == 0) {
+          num_rows = min<int64_t>(num_rows, limit_ - num_rows_returned_);
+        }
+        RETURN_IF_ERROR(MaterializeRows(tuple_pool, num_rows, tuple_buffer));
+        uint8_t* tuple_mem = tuple_buffer;
+        for (int i = 0; i < num_rows && !ReachedLimit(); ++i) {
+          Tuple* tuple = reinterpret_cast<Tuple*>(tuple_mem + i * tuple_size);
+          int row_idx = row_batch->AddRow();
+          TupleRow* tuple_row = row_batch->GetRow(row_idx);
+          tuple_row->SetTuple(tuple_idx_, tuple);
+
+          if (ExecNode::EvalConjuncts(ctxs, num_ctxs, tuple_row)) {
+            if (reinterpret_cast<uint8_t*>(tuple) != tuple_buffer) {
+              memcpy(tuple_buffer, tuple, tuple_size);
+              tuple_row->SetTuple(tuple_idx_, reinterpret_cast<Tuple*>(tuple_buffer));
+            }
+            row_batch->CommitLastRow();
+            tuple_buffer += tuple_size;
+            ++num_rows_returned_;
+          }
+          ++next_row_idx_;
         }
-        ++next_row_idx_;
       }
       COUNTER_SET(rows_returned_counter_, num_rows_returned_);
 
@@ -93,8 +93,11 @@ class DataSourceScanNode : public ScanNode {
   /// the next row batch.
   std::vector<int> cols_next_val_idx_;
 
-  /// Materializes the next row (next_row_idx_) into tuple.
-  Status MaterializeNextRow(MemPool* mem_pool, Tuple* tuple);
+  /// Materializes the 'num_rows' rows starting at next_row_idx_ into the consecutive
+  /// tuples at 'tuple_mem', one column at a time. Advances cols_next_val_idx_ past the
+  /// values of these rows but leaves next_row_idx_ unchanged. String data is allocated
+  /// from 'mem_pool'.
+  Status MaterializeRows(MemPool* mem_pool, int num_rows, uint8_t* tuple_mem);
 
   /// Gets the next batch from the data source, stored in input_batch_.
   Status GetNextInputBatch();
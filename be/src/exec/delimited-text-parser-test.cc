@@ -16,6 +16,7 @@
 #include <gtest/gtest.h>
 
 #include "exec/delimited-text-parser.inline.h"
+#include "testutil/gtest-util.h"
 #include "util/cpu-info.h"
 
 #include "common/names.h"
@@ -178,6 +179,60 @@ TEST(DelimitedTextParser, SpecialDelimiters) {
   Validate(&tuple_delim_parser, data, 2, TUPLE_DELIM, 3, 3);
 }
 
+// Parses 'data' in batches of at most 'max_tuples' tuples and appends the number of
+// tuples and the offsets and lengths of the fields of each batch to 'result'.
+static void ParseAll(DelimitedTextParser* parser, int num_cols, string* data,
+    int max_tuples, vector<int64_t>* result) {
+  parser->ParserReset();
+  char* data_ptr = &(*data)[0];
+  int64_t remaining_len = data->size();
+  vector<char*> row_end_locs(max_tuples);
+  // Each delimiter ends at most one field, and each tuple is padded to 'num_cols'.
+  vector<FieldLocation> field_locations(data->size() + (max_tuples + 1) * num_cols);
+  while (remaining_len > 0) {
+    char* batch_start = data_ptr;
+    int num_tuples = 0;
+    int num_fields = 0;
+    char* next_column_start;
+    ASSERT_OK(parser->ParseFieldLocations(max_tuples, remaining_len, &data_ptr,
+        &row_end_locs[0], &field_locations[0], &num_tuples, &num_fields,
+        &next_column_start));
+    remaining_len -= data_ptr - batch_start;
+    result->push_back(num_tuples);
+    for (int i = 0; i < num_fields; ++i) {
+      result->push_back(field_locations[i].start - &(*data)[0]);
+      result->push_back(field_locations[i].len);
+    }
+    if (num_tuples < max_tuples) break;
+  }
+}
+
+// The AVX2 parser must produce the same fields as the SSE parser, including for
+// delimiters and runs of escape characters that cross the 64 byte blocks.
+TEST(DelimitedTextParser, Avx2MatchesSse) {
+  const int NUM_COLS = 4;
+  bool is_materialized_col[NUM_COLS] = {true, false, true, true};
+  const char chars[] = "aaaaaaa,,|\n\r@@";
+  srand(0);
+  for (char escape_char: {'\0', '@'}) {
+    DelimitedTextParser parser(NUM_COLS, 0, is_materialized_col, '\n', ',', '|',
+        escape_char);
+    for (int i = 0; i < 100; ++i) {
+      string data(rand() % 1000, 'x');
+      for (char& c: data) c = chars[rand() % (sizeof(chars) - 1)];
+      int max_tuples = 1 + rand() % 10;
+      vector<int64_t> sse_result;
+      {
+        CpuInfo::TempDisable disable_avx2(CpuInfo::AVX2);
+        ParseAll(&parser, NUM_COLS, &data, max_tuples, &sse_result);
+      }
+      vector<int64_t> result;
+      ParseAll(&parser, NUM_COLS, &data, max_tuples, &result);
+      EXPECT_EQ(sse_result, result) << data;
+    }
+  }
+}
+
 // TODO: expand test for other delimited text parser functions/cases.
 // Not all of them work without creating a HdfsScanNode but we can expand
 // these tests quite a bit more.
@@ -14,6 +14,8 @@
 
 #include "exec/delimited-text-parser.inline.h"
 
+#include <immintrin.h>
+
 #include "exec/hdfs-scanner.h"
 #include "util/cpu-info.h"
 
@@ -114,6 +116,17 @@ Status DelimitedTextParser::ParseFieldLocations(int max_tuples, int64_t remainin
     last_row_delim_offset_ = -1;
   }
 
+  if (CpuInfo::IsSupported(CpuInfo::AVX2)) {
+    if (process_escapes_) {
+      ParseAvx2<true>(max_tuples, &remaining_len, byte_buffer_ptr, row_end_locations,
+          field_locations, num_tuples, num_fields, next_column_start);
+    } else {
+      ParseAvx2<false>(max_tuples, &remaining_len, byte_buffer_ptr, row_end_locations,
+          field_locations, num_tuples, num_fields, next_column_start);
+    }
+    if (*num_tuples == max_tuples) return Status::OK();
+  }
+
   if (CpuInfo::IsSupported(CpuInfo::SSE4_2)) {
     if (process_escapes_) {
       ParseSse<true>(max_tuples, &remaining_len, byte_buffer_ptr, row_end_locations,
@@ -193,6 +206,127 @@ Status DelimitedTextParser::ParseFieldLocations(int max_tuples, int64_t remainin
   return Status::OK();
 }
 
+/// Returns the bits of the characters of a 64-byte block that follow an unescaped escape
+/// character, given the bits of all escape characters in 'escape_mask'. '*carry' is true
+/// if the first character of the block is escaped, and is set to whether the first
+/// character of the next block is. A run of escape characters escapes the character
+/// after it if the run has odd length, which is found by adding the starts of the runs
+/// to the runs: the carries out of the runs land on the characters after them.
+static inline uint64_t FindEscapedChars(uint64_t escape_mask, bool* carry) {
+  const uint64_t EVEN_BITS = 0x5555555555555555ULL;
+  uint64_t first_is_escaped = *carry;
+  // An escaped escape character does not escape the character after it.
+  escape_mask &= ~first_is_escaped;
+  uint64_t follows_escape = escape_mask << 1 | first_is_escaped;
+  uint64_t odd_run_starts = escape_mask & ~EVEN_BITS & ~follows_escape;
+  uint64_t even_run_ends = odd_run_starts + escape_mask;
+  *carry = even_run_ends < escape_mask;
+  uint64_t invert_mask = even_run_ends << 1;
+  return (EVEN_BITS ^ invert_mask) & follows_escape;
+}
+
+template <bool process_escapes>
+void DelimitedTextParser::ParseAvx2(int max_tuples, int64_t* remaining_len,
+    char** byte_buffer_ptr, char** row_end_locations, FieldLocation* field_locations,
+    int* num_tuples, int* num_fields, char** next_column_start) {
+  DCHECK(CpuInfo::IsSupported(CpuInfo::AVX2));
+  const int BLOCK_SIZE = 64;
+  // The characters that ParseSse() searches for.
+  char search_chars[SSEUtil::CHARS_PER_128_BIT_REGISTER];
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(search_chars), xmm_delim_search_);
+  DCHECK_LE(num_delims_, 4);
+  __m256i delim_search[4];
+  for (int i = 0; i < num_delims_; ++i) {
+    delim_search[i] = _mm256_set1_epi8(search_chars[i]);
+  }
+  const __m256i escape_search = _mm256_set1_epi8(escape_char_);
+
+  while (LIKELY(*remaining_len >= BLOCK_SIZE)) {
+    const __m256i* block = reinterpret_cast<const __m256i*>(*byte_buffer_ptr);
+    __m256i lo = _mm256_loadu_si256(block);
+    __m256i hi = _mm256_loadu_si256(block + 1);
+    __m256i lo_delims = _mm256_cmpeq_epi8(lo, delim_search[0]);
+    __m256i hi_delims = _mm256_cmpeq_epi8(hi, delim_search[0]);
+    for (int i = 1; i < num_delims_; ++i) {
+      lo_delims = _mm256_or_si256(lo_delims, _mm256_cmpeq_epi8(lo, delim_search[i]));
+      hi_delims = _mm256_or_si256(hi_delims, _mm256_cmpeq_epi8(hi, delim_search[i]));
+    }
+    uint64_t delim_mask = static_cast<uint32_t>(_mm256_movemask_epi8(lo_delims)) |
+        static_cast<uint64_t>(_mm256_movemask_epi8(hi_delims)) << 32;
+
+    uint64_t escape_mask = 0;
+    if (process_escapes) {
+      DCHECK(escape_char_ != '\0');
+      escape_mask = static_cast<uint32_t>(
+          _mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, escape_search))) |
+          static_cast<uint64_t>(
+              _mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, escape_search))) << 32;
+      delim_mask &= ~FindEscapedChars(escape_mask, &last_char_is_escape_);
+    }
+
+    char* last_char = *byte_buffer_ptr + BLOCK_SIZE - 1;
+    bool last_char_is_unescaped_delim = delim_mask >> (BLOCK_SIZE - 1);
+    unfinished_tuple_ = !(last_char_is_unescaped_delim &&
+        (*last_char == tuple_delim_ || (tuple_delim_ == '\n' && *last_char == '\r')));
+
+    // Process the delimiters from lsb to msb. Escape characters before a delimiter
+    // belong to the column it ends.
+    while (delim_mask != 0) {
+      int n = __builtin_ctzll(delim_mask);
+      // Clear the current bit.
+      delim_mask &= delim_mask - 1;
+      if (process_escapes) {
+        uint64_t column_bits = (2ULL << n) - 1;
+        current_column_has_escape_ |= (escape_mask & column_bits) != 0;
+        escape_mask &= ~column_bits;
+      }
+
+      char* delim_ptr = *byte_buffer_ptr + n;
+
+      if (*delim_ptr == field_delim_ || *delim_ptr == collection_item_delim_) {
+        AddColumn<process_escapes>(delim_ptr - *next_column_start,
+            next_column_start, num_fields, field_locations);
+        continue;
+      }
+
+      if (*delim_ptr == tuple_delim_ || (tuple_delim_ == '\n' && *delim_ptr == '\r')) {
+        if (UNLIKELY(
+                last_row_delim_offset_ == *remaining_len - n && *delim_ptr == '\n')) {
+          // If the row ended in \r\n then move the next start past the \n
+          ++*next_column_start;
+          last_row_delim_offset_ = -1;
+          continue;
+        }
+        AddColumn<process_escapes>(delim_ptr - *next_column_start,
+            next_column_start, num_fields, field_locations);
+        FillColumns<false>(0, NULL, num_fields, field_locations);
+        column_idx_ = num_partition_keys_;
+        row_end_locations[*num_tuples] = delim_ptr;
+        ++(*num_tuples);
+        // Remember where we saw the last \r.
+        last_row_delim_offset_ = *delim_ptr == '\r' ? *remaining_len - n - 1 : -1;
+        if (UNLIKELY(*num_tuples == max_tuples)) {
+          (*byte_buffer_ptr) += (n + 1);
+          if (process_escapes) last_char_is_escape_ = false;
+          *remaining_len -= (n + 1);
+          // If the last character we processed was \r then set the offset to 0
+          // so that we will use it at the beginning of the next batch.
+          if (last_row_delim_offset_ == *remaining_len) last_row_delim_offset_ = 0;
+          _mm256_zeroupper();
+          return;
+        }
+      }
+    }
+
+    // Escape characters after the last delimiter belong to the next column.
+    if (process_escapes) current_column_has_escape_ |= escape_mask != 0;
+
+    *remaining_len -= BLOCK_SIZE;
+    *byte_buffer_ptr += BLOCK_SIZE;
+  }
+  _mm256_zeroupper();
+}
+
 // Find the first instance of the tuple delimiter.  This will
 // find the start of the first full tuple in buffer by looking for the end of
 // the previous tuple.
@@ -150,6 +150,16 @@ class DelimitedTextParser {
       FieldLocation* field_locations,
       int* num_tuples, int* num_fields, char** next_column_start);
 
+  /// Same as ParseSse(), but uses AVX2 instructions to build the delimiter and escape
+  /// masks of 64 bytes at a time. Stops at the last block of less than 64 bytes, which
+  /// is left to ParseSse() and the scalar loop.
+  template <bool process_escapes>
+  void ParseAvx2(int max_tuples, int64_t* remaining_len,
+      char** byte_buffer_ptr, char** row_end_locations_,
+      FieldLocation* field_locations,
+      int* num_tuples, int* num_fields, char** next_column_start)
+      __attribute__((__target__("avx2")));
+
   /// SSE(xmm) register containing the tuple search character(s).
   __m128i xmm_tuple_search_;
 
@@ -80,19 +80,30 @@ Status ExchangeNode::Prepare(RuntimeState* state) {
     RETURN_IF_ERROR(sort_exec_exprs_.Prepare(
         state, row_descriptor_, row_descriptor_, expr_mem_tracker()));
     AddExprCtxsToFree(sort_exec_exprs_);
+    less_than_.reset(
+        new TupleRowComparator(sort_exec_exprs_, is_asc_order_, nulls_first_));
+
+    bool codegen_enabled = false;
+    Status codegen_status;
+    if (state->codegen_enabled()) {
+      codegen_status = less_than_->Codegen(state);
+      codegen_enabled = codegen_status.ok();
+    }
+    AddCodegenExecOption(codegen_enabled, codegen_status);
   }
   return Status::OK();
 }
 
 Status ExchangeNode::Open(RuntimeState* state) {
   SCOPED_TIMER(runtime_profile_->total_time_counter());
+  SCOPED_PERF_EVENT_MEASUREMENT(perf_event_counters_);
+  SCOPED_CPU_SAMPLE_NODE(id_);
   RETURN_IF_ERROR(ExecNode::Open(state));
   if (is_merging_) {
     RETURN_IF_ERROR(sort_exec_exprs_.Open(state));
-    TupleRowComparator less_than(sort_exec_exprs_, is_asc_order_, nulls_first_);
-    // CreateMerger() will populate its merging heap with batches from the stream_recvr_,
-    // so it is not necessary to call FillInputRowBatch().
-    RETURN_IF_ERROR(stream_recvr_->CreateMerger(less_than));
+    // CreateMerger() will populate its tournament tree with batches from the
+    // stream_recvr_, so it is not necessary to call FillInputRowBatch().
+    RETURN_IF_ERROR(stream_recvr_->CreateMerger(*less_than_));
   } else {
     RETURN_IF_ERROR(FillInputRowBatch(state));
   }
@@ -129,6 +140,8 @@ Status ExchangeNode::FillInputRowBatch(RuntimeState* state) {
 Status ExchangeNode::GetNext(RuntimeState* state, RowBatch* output_batch, bool* eos) {
   RETURN_IF_ERROR(ExecDebugAction(TExecNodePhase::GETNEXT, state));
   SCOPED_TIMER(runtime_profile_->total_time_counter());
+  SCOPED_PERF_EVENT_MEASUREMENT(perf_event_counters_);
+  SCOPED_CPU_SAMPLE_NODE(id_);
   if (ReachedLimit()) {
     stream_recvr_->TransferAllResources(output_batch);
     *eos = true;
@@ -164,6 +177,8 @@ Status ExchangeNode::GetNext(RuntimeState* state, RowBatch* output_batch, bool*
 
       if (ReachedLimit()) {
         stream_recvr_->TransferAllResources(output_batch);
+        // Let the senders know right away that no more rows are needed.
+        stream_recvr_->Deregister();
         *eos = true;
         return Status::OK();
       }
@@ -202,7 +217,8 @@ Status ExchangeNode::GetNextMerging(RuntimeState* state, RowBatch* output_batch,
   }
 
   num_rows_returned_ += output_batch->num_rows();
-  if (ReachedLimit()) {
+  bool reached_limit = ReachedLimit();
+  if (reached_limit) {
     output_batch->set_num_rows(output_batch->num_rows() - (num_rows_returned_ - limit_));
     *eos = true;
   }
@@ -210,6 +226,7 @@ Status ExchangeNode::GetNextMerging(RuntimeState* state, RowBatch* output_batch,
   // On eos, transfer all remaining resources from the input batches maintained
   // by the merger to the output batch.
   if (*eos) stream_recvr_->TransferAllResources(output_batch);
+  if (reached_limit) stream_recvr_->Deregister();
 
   COUNTER_SET(rows_returned_counter_, num_rows_returned_);
   return Status::OK();
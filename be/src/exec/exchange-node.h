@@ -17,8 +17,11 @@
 #define IMPALA_EXEC_EXCHANGE_NODE_H
 
 #include <boost/scoped_ptr.hpp>
+#include <boost/scoped_ptr.hpp>
+
 #include "exec/exec-node.h"
 #include "exec/sort-exec-exprs.h"
+#include "util/tuple-row-compare.h"
 
 namespace impala {
 
@@ -33,7 +36,10 @@ class DataStreamRecvr;
 /// If is_merging_ is true, the exchange node creates a DataStreamRecvr with the
 /// is_merging_ flag and retrieves retrieves rows from the receiver via calls to
 /// DataStreamRecvr::GetNext(). It also prepares, opens and closes the ordering exprs in
-/// its SortExecExprs member that are used to compare rows.
+/// its SortExecExprs member that are used to compare rows. The comparison is codegen'd
+/// in Prepare() if codegen is enabled.
+/// TODO: when the merging exchange is not the root of the coordinator fragment, merge
+/// disjoint subsets of the senders in parallel before the final merge.
 /// If is_merging_ is false, the exchange node directly retrieves batches from the row
 /// batch queue of the DataStreamRecvr via calls to DataStreamRecvr::GetBatch().
 class ExchangeNode : public ExecNode {
@@ -96,6 +102,10 @@ class ExchangeNode : public ExecNode {
   std::vector<bool> is_asc_order_;
   std::vector<bool> nulls_first_;
 
+  /// Row comparator passed to the merger. Created in Prepare() so that Compare() can be
+  /// codegen'd before the module is compiled. Only set if is_merging_ is true.
+  boost::scoped_ptr<TupleRowComparator> less_than_;
+
   /// Offset specifying number of rows to skip.
   int64_t offset_;
 
@@ -59,6 +59,11 @@ using namespace llvm;
 // TODO: remove when we remove hash-join-node.cc and aggregation-node.cc
 DEFINE_bool(enable_partitioned_hash_join, true, "Enable partitioned hash join");
 DEFINE_bool(enable_partitioned_aggregation, true, "Enable partitioned hash agg");
+DEFINE_bool(exec_node_perf_counters, false, "(Advanced) If true, the threads that run "
+    "an exec node count its CPU cycles, instructions, last-level cache misses, branch "
+    "misses and dTLB misses with hardware performance counters and add them to the "
+    "node's runtime profile, along with the instructions per cycle and the misses per "
+    "row. Requires access to perf events, see kernel.perf_event_paranoid.");
 
 namespace impala {
 
@@ -69,7 +74,7 @@ int ExecNode::GetNodeIdFromProfile(RuntimeProfile* p) {
 }
 
 ExecNode::RowBatchQueue::RowBatchQueue(int max_batches) :
-    BlockingQueue<RowBatch*>(max_batches) {
+    LockFreeBlockingQueue<RowBatch*>(max_batches) {
 }
 
 ExecNode::RowBatchQueue::~RowBatchQueue() {
@@ -124,6 +129,7 @@ ExecNode::ExecNode(ObjectPool* pool, const TPlanNode& tnode, const DescriptorTbl
     num_rows_returned_(0),
     rows_returned_counter_(NULL),
     rows_returned_rate_(NULL),
+    perf_event_counters_(NULL),
     containing_subplan_(NULL),
     is_closed_(false) {
   InitRuntimeProfile(PrintPlanNodeType(tnode.node_type));
@@ -152,6 +158,10 @@ Status ExecNode::Prepare(RuntimeState* state) {
       ROW_THROUGHPUT_COUNTER, TUnit::UNIT_PER_SECOND,
       bind<int64_t>(&RuntimeProfile::UnitsPerSecond, rows_returned_counter_,
         runtime_profile()->total_time_counter()));
+  if (FLAGS_exec_node_perf_counters) {
+    perf_event_counters_ =
+        pool_->Add(new PerfEventCounters(runtime_profile(), rows_returned_counter_));
+  }
 
   RETURN_IF_ERROR(Expr::Prepare(conjunct_ctxs_, state, row_desc(), expr_mem_tracker()));
   AddExprCtxsToFree(conjunct_ctxs_);
@@ -445,6 +455,18 @@ bool ExecNode::EvalConjuncts(ExprContext* const* ctxs, int num_ctxs, TupleRow* r
   return true;
 }
 
+int ExecNode::EvalConjunctsBatch(ExprContext* const* ctxs, int num_ctxs,
+    RowBatch* batch, int* sel, int num_sel) {
+  for (int i = 0; i < num_ctxs && num_sel > 0; ++i) {
+    num_sel = ctxs[i]->FilterBatch(batch, sel, num_sel);
+  }
+  return num_sel;
+}
+
+int ExecNode::ChildBatchCapacity(RuntimeState* state, int child_idx) {
+  return RowBatch::AdaptiveCapacity(child(child_idx)->row_desc(), state->batch_size());
+}
+
 Status ExecNode::QueryMaintenance(RuntimeState* state) {
   FreeLocalAllocations();
   return state->CheckQueryState();
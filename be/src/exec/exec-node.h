@@ -22,8 +22,10 @@
 #include "common/status.h"
 #include "exprs/expr-context.h"
 #include "runtime/descriptors.h"  // for RowDescriptor
+#include "util/cpu-sampler.h"
+#include "util/lock-free-blocking-queue.h"
+#include "util/perf-event-counters.h"
 #include "util/runtime-profile.h"
-#include "util/blocking-queue.h"
 #include "gen-cpp/PlanNodes_types.h"
 
 namespace impala {
@@ -140,6 +142,13 @@ class ExecNode {
   /// out how to deal with declaring a templated std:vector type in IR
   static bool EvalConjuncts(ExprContext* const* ctxs, int num_ctxs, TupleRow* row);
 
+  /// Batch version of EvalConjuncts(). Evaluates the conjuncts over the 'num_sel' rows of
+  /// 'batch' whose indices are in 'sel', in ascending order, with ExprContext::
+  /// FilterBatch(). Removes the rows that don't pass all conjuncts from 'sel' and returns
+  /// the number of remaining rows.
+  static int EvalConjunctsBatch(ExprContext* const* ctxs, int num_ctxs, RowBatch* batch,
+      int* sel, int num_sel);
+
   /// Codegen EvalConjuncts(). Returns a non-OK status if the function couldn't be
   /// codegen'd. The codegen'd version uses inlined, codegen'd GetBooleanVal() functions.
   static Status CodegenEvalConjuncts(
@@ -184,6 +193,7 @@ class ExecNode {
 
  protected:
   friend class DataSink;
+  friend class ExecNodeBenchmark;
 
   /// Extends blocking queue for row batches. Row batches have a property that
   /// they must be processed in the order they were produced, even in cancellation
@@ -192,7 +202,7 @@ class ExecNode {
   /// Row batches that are added after Shutdown() are queued in another queue, which can
   /// be cleaned up during Close().
   /// All functions are thread safe.
-  class RowBatchQueue : public BlockingQueue<RowBatch*> {
+  class RowBatchQueue : public LockFreeBlockingQueue<RowBatch*> {
    public:
     /// max_batches is the maximum number of row batches that can be queued.
     /// When the queue is full, producers will block.
@@ -249,6 +259,11 @@ class ExecNode {
   RuntimeProfile::Counter* rows_returned_counter_;
   RuntimeProfile::Counter* rows_returned_rate_;
 
+  /// Hardware counters of the threads that run this node, NULL unless
+  /// --exec_node_perf_counters is set. Nodes measure their Open() and GetNext() calls,
+  /// and any threads they start, with SCOPED_PERF_EVENT_MEASUREMENT.
+  PerfEventCounters* perf_event_counters_;
+
   /// Account for peak memory used by this node
   boost::scoped_ptr<MemTracker> mem_tracker_;
 
@@ -271,6 +286,10 @@ class ExecNode {
   /// Valid to call in or after Prepare().
   bool IsInSubplan() const { return containing_subplan_ != NULL; }
 
+  /// Returns the capacity of the row batches that this node passes to GetNext() of the
+  /// child at 'child_idx'. See RowBatch::AdaptiveCapacity().
+  int ChildBatchCapacity(RuntimeState* state, int child_idx);
+
   /// Create a single exec node derived from thrift node; place exec node in 'pool'.
   static Status CreateNode(ObjectPool* pool, const TPlanNode& tnode,
       const DescriptorTbl& descs, ExecNode** node, RuntimeState* state);
@@ -14,6 +14,9 @@
 
 #include "exec/filter-context.h"
 
+#include "runtime/runtime-filter.inline.h"
+#include "util/bloom-filter.h"
+#include "util/min-max-filter.h"
 #include "util/runtime-profile-counters.h"
 
 using namespace impala;
@@ -63,3 +66,27 @@ Status FilterContext::CloneFrom(const FilterContext& from, RuntimeState* state)
   stats = from.stats;
   return from.expr->Clone(state, &expr);
 }
+
+void FilterContext::EvalBatch(Tuple** tuples, int num_rows, uint32_t* hashes,
+    uint8_t* found, uint8_t* passes) const {
+  // Once the filter arrived, its Bloom and min/max filters do not change anymore.
+  if (!filter->HasBloomFilter()) {
+    memset(passes, 1, num_rows);
+    return;
+  }
+  const BloomFilter* bloom_filter = filter->bloom_filter();
+  const MinMaxFilter* min_max_filter = filter->min_max_filter();
+  const ColumnType& type = expr->root()->type();
+  for (int i = 0; i < num_rows; ++i) {
+    // The value may be overwritten by the next call to GetValue().
+    void* value = expr->GetValue(reinterpret_cast<TupleRow*>(&tuples[i]));
+    passes[i] = min_max_filter == NULL || min_max_filter->Eval(value);
+    if (bloom_filter != NULL) {
+      hashes[i] =
+          RawValue::GetHashValue(value, type, RuntimeFilterBank::DefaultHashSeed());
+    }
+  }
+  if (bloom_filter == NULL) return;
+  bloom_filter->FindBatch(hashes, num_rows, found);
+  for (int i = 0; i < num_rows; ++i) passes[i] &= found[i];
+}
@@ -25,7 +25,9 @@
 namespace impala {
 
 class BloomFilter;
+class MinMaxFilter;
 class RuntimeFilter;
+class Tuple;
 
 /// Container struct for per-filter statistics, with statistics for each granularity of
 /// set of rows to which a Runtimefilter might be applied. Common groupings are "Rows",
@@ -87,12 +89,24 @@ struct FilterContext {
   /// Working copy of local bloom filter
   BloomFilter* local_bloom_filter;
 
+  /// Working copy of local min/max filter, NULL if none is built for this filter.
+  MinMaxFilter* local_min_max_filter;
+
   /// Clones this FilterContext for use in a multi-threaded context (i.e. by scanner
   /// threads).
   Status CloneFrom(const FilterContext& from, RuntimeState* state);
 
+  /// Evaluates the filter against the value of 'expr' for 'num_rows' rows consisting of
+  /// the single tuple tuples[i], with the same result as RuntimeFilter::Eval(). Sets
+  /// passes[i] to 1 if the row passes and to 0 otherwise. Looks up the Bloom filter with
+  /// BloomFilter::FindBatch(). 'hashes' and 'found' are scratch space for 'num_rows'
+  /// entries.
+  void EvalBatch(Tuple** tuples, int num_rows, uint32_t* hashes, uint8_t* found,
+      uint8_t* passes) const;
+
   FilterContext()
-      : expr(NULL), filter(NULL), local_bloom_filter(NULL) { }
+      : expr(NULL), filter(NULL), local_bloom_filter(NULL),
+        local_min_max_filter(NULL) { }
 };
 
 }
@@ -198,7 +198,7 @@ Status HashJoinNode::ConstructBuildSide(RuntimeState* state) {
   // The hash join node needs to keep in memory all build tuples, including the tuple
   // row ptrs.  The row ptrs are copied into the hash table's internal structure so they
   // don't need to be stored in the build_pool_.
-  RowBatch build_batch(child(1)->row_desc(), state->batch_size(), mem_tracker());
+  RowBatch build_batch(child(1)->row_desc(), ChildBatchCapacity(state, 1), mem_tracker());
   {
     SCOPED_STOP_WATCH(&built_probe_overlap_stop_watch_);
     RETURN_IF_ERROR(child(1)->Open(state));
@@ -260,6 +260,8 @@ Status HashJoinNode::InitGetNext(TupleRow* first_probe_row) {
 
 Status HashJoinNode::GetNext(RuntimeState* state, RowBatch* out_batch, bool* eos) {
   SCOPED_TIMER(runtime_profile_->total_time_counter());
+  SCOPED_PERF_EVENT_MEASUREMENT(perf_event_counters_);
+  SCOPED_CPU_SAMPLE_NODE(id_);
   RETURN_IF_ERROR(ExecDebugAction(TExecNodePhase::GETNEXT, state));
   RETURN_IF_CANCELLED(state);
   RETURN_IF_ERROR(QueryMaintenance(state));
@@ -286,7 +288,7 @@ Status HashJoinNode::GetNext(RuntimeState* state, RowBatch* out_batch, bool* eos
 
   // Explicitly manage the timer counter to avoid measuring time in the child
   // GetNext call.
-  ScopedTimer<MonotonicStopWatch> probe_timer(probe_timer_);
+  ScopedTimer<TscStopWatch> probe_timer(probe_timer_);
 
   while (!eos_) {
     // create output rows as long as:
@@ -423,7 +425,7 @@ Status HashJoinNode::LeftJoinGetNext(RuntimeState* state,
     RowBatch* out_batch, bool* eos) {
   *eos = eos_;
 
-  ScopedTimer<MonotonicStopWatch> probe_timer(probe_timer_);
+  ScopedTimer<TscStopWatch> probe_timer(probe_timer_);
   while (!eos_) {
     // Compute max rows that should be added to out_batch
     int64_t max_added_rows = out_batch->capacity() - out_batch->num_rows();
@@ -56,8 +56,20 @@ class HashTableTest : public testing::Test {
   vector<ExprContext*> build_expr_ctxs_;
   vector<ExprContext*> probe_expr_ctxs_;
 
+  /// If true, the hash tables are created with tag probing.
+  bool tag_probing_;
+
+  /// If false, the hash tables are created without support for duplicate keys.
+  bool stores_duplicates_;
+
+  /// If > 0, the hash tables are created storing the build tuples inline.
+  int inline_tuple_size_;
+
   virtual void SetUp() {
     test_env_.reset(new TestEnv());
+    tag_probing_ = false;
+    stores_duplicates_ = true;
+    inline_tuple_size_ = 0;
 
     RowDescriptor desc;
     Status status;
@@ -190,8 +202,9 @@ class HashTableTest : public testing::Test {
     // Initial_num_buckets must be a power of two.
     EXPECT_EQ(initial_num_buckets, BitUtil::RoundUpToPowerOfTwo(initial_num_buckets));
     int64_t max_num_buckets = 1L << 31;
-    table->reset(new HashTable(quadratic, runtime_state_, client, true, 1, NULL,
-          max_num_buckets, initial_num_buckets));
+    table->reset(new HashTable(quadratic, tag_probing_, runtime_state_, client,
+          stores_duplicates_, 1, NULL, max_num_buckets, initial_num_buckets,
+          inline_tuple_size_));
     return (*table)->Init();
   }
 
@@ -253,6 +266,88 @@ class HashTableTest : public testing::Test {
     ht_ctx->Close();
   }
 
+  // Inserts each of the build rows [0->5) three times into a hash table that does not
+  // store duplicates. Each key must occupy one bucket without any duplicate nodes and
+  // be found with a single matching row.
+  void NoDuplicatesTest(bool quadratic) {
+    stores_duplicates_ = false;
+    TupleRow* build_rows[15];
+    for (int i = 0; i < 15; ++i) build_rows[i] = CreateTupleRow(i % 5);
+
+    scoped_ptr<HashTable> hash_table;
+    ASSERT_TRUE(CreateHashTable(quadratic, 64, &hash_table));
+    EXPECT_FALSE(hash_table->stores_duplicates());
+    scoped_ptr<HashTableCtx> ht_ctx;
+    Status status = HashTableCtx::Create(runtime_state_, build_expr_ctxs_,
+        probe_expr_ctxs_, false /* !stores_nulls_ */,
+        vector<bool>(build_expr_ctxs_.size(), false), 1, 0, 1, &tracker_, &ht_ctx);
+    EXPECT_OK(status);
+    for (int i = 0; i < 15; ++i) {
+      if (!ht_ctx->EvalAndHashBuild(build_rows[i])) continue;
+      BufferedTupleStream::RowIdx dummy_row_idx;
+      bool inserted = hash_table->Insert(ht_ctx.get(), dummy_row_idx, build_rows[i]);
+      EXPECT_TRUE(inserted);
+    }
+    EXPECT_EQ(hash_table->size(), 5);
+    EXPECT_EQ(hash_table->num_buckets() - hash_table->EmptyBuckets(), 5);
+    EXPECT_EQ(hash_table->num_duplicate_nodes_, 0);
+
+    // The last inserted row of each key is stored.
+    ProbeTestData probe_rows[10];
+    for (int i = 0; i < 10; ++i) {
+      probe_rows[i].probe_row = CreateTupleRow(i);
+      if (i < 5) probe_rows[i].expected_build_rows.push_back(build_rows[10 + i]);
+    }
+    ProbeTest(hash_table.get(), ht_ctx.get(), probe_rows, 10, false);
+
+    hash_table->Close();
+    ht_ctx->Close();
+  }
+
+  // Inserts the build rows [0->50) twice into a hash table that stores the tuples inline
+  // and resizes it. Every key must be found twice, with rows that point into the hash
+  // table rather than at the inserted tuples.
+  void InlineTuplesTest(bool quadratic) {
+    inline_tuple_size_ = sizeof(char) + sizeof(int32_t);
+    TupleRow* build_rows[100];
+    for (int i = 0; i < 100; ++i) build_rows[i] = CreateTupleRow(i % 50);
+
+    scoped_ptr<HashTable> hash_table;
+    ASSERT_TRUE(CreateHashTable(quadratic, 128, &hash_table));
+    EXPECT_EQ(hash_table->inline_tuple_size(), inline_tuple_size_);
+    scoped_ptr<HashTableCtx> ht_ctx;
+    Status status = HashTableCtx::Create(runtime_state_, build_expr_ctxs_,
+        probe_expr_ctxs_, false /* !stores_nulls_ */,
+        vector<bool>(build_expr_ctxs_.size(), false), 1, 0, 1, &tracker_, &ht_ctx);
+    EXPECT_OK(status);
+    for (int i = 0; i < 100; ++i) {
+      if (!ht_ctx->EvalAndHashBuild(build_rows[i])) continue;
+      BufferedTupleStream::RowIdx dummy_row_idx;
+      bool inserted = hash_table->Insert(ht_ctx.get(), dummy_row_idx, build_rows[i]);
+      EXPECT_TRUE(inserted);
+    }
+    ResizeTable(hash_table.get(), 256, ht_ctx.get());
+    EXPECT_EQ(hash_table->size(), 100);
+
+    for (int i = 0; i < 60; ++i) {
+      TupleRow* probe_row = CreateTupleRow(i);
+      if (ht_ctx->EvalAndHashProbe(probe_row)) continue;
+      HashTable::Iterator iter = hash_table->FindProbeRow(ht_ctx.get());
+      int num_matches = 0;
+      for (; !iter.AtEnd(); iter.Next()) {
+        TupleRow* row = iter.GetRow();
+        EXPECT_NE(row->GetTuple(0), build_rows[i % 50]->GetTuple(0));
+        EXPECT_NE(row->GetTuple(0), build_rows[i % 50 + 50]->GetTuple(0));
+        ValidateMatch(probe_row, row);
+        ++num_matches;
+      }
+      EXPECT_EQ(num_matches, i < 50 ? 2 : 0);
+    }
+
+    hash_table->Close();
+    ht_ctx->Close();
+  }
+
   // This test inserts the build rows [0->5) to hash table. It validates that they
   // are all there using a full table scan. It also validates that Find() is correct
   // testing for probe rows that are both there and not.
@@ -542,10 +637,28 @@ TEST_F(HashTableTest, QuadraticSetupTest) {
   SetupTest(true, 4294967296, true); // 2^32
 }
 
+TEST_F(HashTableTest, TagSetupTest) {
+  tag_probing_ = true;
+  SetupTest(false, 1, false);
+  SetupTest(false, 1024, false);
+  SetupTest(false, 65536, false);
+  SetupTest(false, 4294967296, true); // 2^32
+}
+
 TEST_F(HashTableTest, NullBuildRowTest) {
   NullBuildRowTest();
 }
 
+TEST_F(HashTableTest, NoDuplicatesTest) {
+  NoDuplicatesTest(false);
+  NoDuplicatesTest(true);
+}
+
+TEST_F(HashTableTest, InlineTuplesTest) {
+  InlineTuplesTest(false);
+  InlineTuplesTest(true);
+}
+
 TEST_F(HashTableTest, LinearBasicTest) {
   BasicTest(false, 1);
   BasicTest(false, 1024);
@@ -558,6 +671,13 @@ TEST_F(HashTableTest, QuadraticBasicTest) {
   BasicTest(true, 65536);
 }
 
+TEST_F(HashTableTest, TagBasicTest) {
+  tag_probing_ = true;
+  BasicTest(false, 1);
+  BasicTest(false, 1024);
+  BasicTest(false, 65536);
+}
+
 // This test makes sure we can scan ranges of buckets.
 TEST_F(HashTableTest, LinearScanTest) {
   ScanTest(false, 1, 10, 5);
@@ -571,6 +691,13 @@ TEST_F(HashTableTest, QuadraticScanTest) {
   ScanTest(true, 1024, 1000, 500);
 }
 
+TEST_F(HashTableTest, TagScanTest) {
+  tag_probing_ = true;
+  ScanTest(false, 1, 10, 5);
+  ScanTest(false, 1024, 1000, 5);
+  ScanTest(false, 1024, 1000, 500);
+}
+
 TEST_F(HashTableTest, LinearGrowTableTest) {
   GrowTableTest(false);
 }
@@ -579,6 +706,11 @@ TEST_F(HashTableTest, QuadraticGrowTableTest) {
   GrowTableTest(true);
 }
 
+TEST_F(HashTableTest, TagGrowTableTest) {
+  tag_probing_ = true;
+  GrowTableTest(false);
+}
+
 TEST_F(HashTableTest, LinearInsertFullTest) {
   InsertFullTest(false, 1);
   InsertFullTest(false, 4);
@@ -595,6 +727,15 @@ TEST_F(HashTableTest, QuadraticInsertFullTest) {
   InsertFullTest(true, 65536);
 }
 
+TEST_F(HashTableTest, TagInsertFullTest) {
+  tag_probing_ = true;
+  InsertFullTest(false, 1);
+  InsertFullTest(false, 4);
+  InsertFullTest(false, 64);
+  InsertFullTest(false, 1024);
+  InsertFullTest(false, 65536);
+}
+
 // Test that hashing empty string updates hash value.
 TEST_F(HashTableTest, HashEmpty) {
   EXPECT_TRUE(test_env_->CreateQueryState(0, 100, 8 * 1024 * 1024,
@@ -16,6 +16,7 @@
 
 #include <functional>
 #include <numeric>
+#include <sys/mman.h>
 #include <gutil/strings/substitute.h>
 
 #include "codegen/codegen-anyval.h"
@@ -29,7 +30,9 @@
 #include "runtime/runtime-state.h"
 #include "runtime/string-value.inline.h"
 #include "util/debug-util.h"
+#include "util/error-util.h"
 #include "util/impalad-metrics.h"
+#include "util/memory-metrics.h"
 
 #include "common/names.h"
 
@@ -38,6 +41,15 @@ using namespace llvm;
 using namespace strings;
 
 DEFINE_bool(enable_quadratic_probing, true, "Enable quadratic probing hash table");
+DEFINE_bool(enable_hash_table_tag_probing, false, "Enable probing the hash table over "
+    "groups of one-byte bucket tags with SSE2 instead of over the buckets. Takes "
+    "precedence over --enable_quadratic_probing.");
+DEFINE_bool(hash_table_huge_pages, true, "If true, hash table bucket arrays of at least "
+    "2MB are mapped with mmap() and backed by transparent huge pages, which reduces TLB "
+    "misses when probing large hash tables.");
+
+// Bucket arrays of at least this size are backed by huge pages.
+static const int64_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
 
 const char* HashTableCtx::LLVM_CLASS_NAME = "class.impala::HashTableCtx";
 
@@ -343,26 +355,34 @@ const double HashTable::MAX_FILL_FACTOR = 0.75f;
 HashTable* HashTable::Create(RuntimeState* state,
     BufferedBlockMgr::Client* client, bool stores_duplicates, int num_build_tuples,
     BufferedTupleStream* tuple_stream, int64_t max_num_buckets,
-    int64_t initial_num_buckets) {
-  return new HashTable(FLAGS_enable_quadratic_probing, state, client, stores_duplicates,
-      num_build_tuples, tuple_stream, max_num_buckets, initial_num_buckets);
+    int64_t initial_num_buckets, int inline_tuple_size) {
+  return new HashTable(FLAGS_enable_quadratic_probing,
+      FLAGS_enable_hash_table_tag_probing, state, client, stores_duplicates,
+      num_build_tuples, tuple_stream, max_num_buckets, initial_num_buckets,
+      inline_tuple_size);
 }
 
-HashTable::HashTable(bool quadratic_probing, RuntimeState* state,
+HashTable::HashTable(bool quadratic_probing, bool tag_probing, RuntimeState* state,
     BufferedBlockMgr::Client* client, bool stores_duplicates, int num_build_tuples,
-    BufferedTupleStream* stream, int64_t max_num_buckets, int64_t num_buckets)
+    BufferedTupleStream* stream, int64_t max_num_buckets, int64_t num_buckets,
+    int inline_tuple_size)
   : state_(state),
     block_mgr_client_(client),
     tuple_stream_(stream),
     stores_tuples_(num_build_tuples == 1),
     stores_duplicates_(stores_duplicates),
     quadratic_probing_(quadratic_probing),
+    tag_probing_(tag_probing),
+    inline_tuple_size_(inline_tuple_size),
     total_data_page_size_(0),
     next_node_(NULL),
     node_remaining_current_page_(0),
     num_duplicate_nodes_(0),
     max_num_buckets_(max_num_buckets),
     buckets_(NULL),
+    tags_(NULL),
+    buckets_mmapped_(false),
+    tags_mmapped_(false),
     num_buckets_(num_buckets),
     num_filled_buckets_(0),
     num_buckets_with_duplicates_(0),
@@ -373,20 +393,59 @@ HashTable::HashTable(bool quadratic_probing, RuntimeState* state,
   DCHECK_EQ((num_buckets & (num_buckets-1)), 0) << "num_buckets must be a power of 2";
   DCHECK_GT(num_buckets, 0) << "num_buckets must be larger than 0";
   DCHECK(stores_tuples_ || stream != NULL);
+  DCHECK(inline_tuple_size == 0 || stores_tuples_);
+  DCHECK_LE(inline_tuple_size, MAX_INLINE_TUPLE_SIZE);
+  DCHECK_EQ(sizeof(HtData), MAX_INLINE_TUPLE_SIZE);
   DCHECK(client != NULL);
 }
 
 bool HashTable::Init() {
-  int64_t buckets_byte_size = num_buckets_ * sizeof(Bucket);
-  if (!state_->block_mgr()->ConsumeMemory(block_mgr_client_, buckets_byte_size)) {
+  if (!state_->block_mgr()->ConsumeMemory(block_mgr_client_,
+      BucketsByteSize(num_buckets_))) {
     num_buckets_ = 0;
     return false;
   }
-  buckets_ = reinterpret_cast<Bucket*>(malloc(buckets_byte_size));
-  memset(buckets_, 0, buckets_byte_size);
+  buckets_ = reinterpret_cast<Bucket*>(
+      AllocateBucketArray(num_buckets_ * sizeof(Bucket), &buckets_mmapped_));
+  if (tag_probing_) {
+    tags_ = AllocateBucketArray(TagsByteSize(num_buckets_), &tags_mmapped_);
+  }
   return true;
 }
 
+uint8_t* HashTable::AllocateBucketArray(int64_t size, bool* mmapped) {
+  *mmapped = false;
+  if (FLAGS_hash_table_huge_pages && size >= HUGE_PAGE_SIZE) {
+    void* buf =
+        mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (LIKELY(buf != MAP_FAILED)) {
+#ifdef MADV_HUGEPAGE
+      // Failure only means that the array is backed by regular pages.
+      madvise(buf, size, MADV_HUGEPAGE);
+#endif
+      *mmapped = true;
+      TcmallocMetric::MMAPPED_BYTES.Add(size);
+      // Anonymous mappings are already zeroed.
+      return reinterpret_cast<uint8_t*>(buf);
+    }
+    // Fall back to malloc, which may still find the memory in its free lists.
+  }
+  uint8_t* buf = reinterpret_cast<uint8_t*>(malloc(size));
+  DCHECK(buf != NULL);
+  memset(buf, 0, size);
+  return buf;
+}
+
+void HashTable::FreeBucketArray(void* data, int64_t size, bool mmapped) {
+  if (!mmapped) {
+    free(data);
+    return;
+  }
+  int ret = munmap(data, size);
+  DCHECK_EQ(ret, 0) << "munmap() failed: " << GetStrErrMsg();
+  TcmallocMetric::MMAPPED_BYTES.Add(-size);
+}
+
 void HashTable::Close() {
   // Print statistics only for the large or heavily used hash tables.
   // TODO: Tweak these numbers/conditions, or print them always?
@@ -401,8 +460,14 @@ void HashTable::Close() {
     ImpaladMetrics::HASH_TABLE_TOTAL_BYTES->Increment(-total_data_page_size_);
   }
   data_pages_.clear();
-  if (buckets_ != NULL) free(buckets_);
-  state_->block_mgr()->ReleaseMemory(block_mgr_client_, num_buckets_ * sizeof(Bucket));
+  if (buckets_ != NULL) {
+    FreeBucketArray(buckets_, num_buckets_ * sizeof(Bucket), buckets_mmapped_);
+  }
+  if (tags_ != NULL) FreeBucketArray(tags_, TagsByteSize(num_buckets_), tags_mmapped_);
+  // Nothing was consumed if Init() failed, in which case 'num_buckets_' is 0.
+  if (num_buckets_ > 0) {
+    state_->block_mgr()->ReleaseMemory(block_mgr_client_, BucketsByteSize(num_buckets_));
+  }
 }
 
 bool HashTable::CheckAndResize(uint64_t buckets_to_fill, const HashTableCtx* ht_ctx) {
@@ -431,12 +496,19 @@ bool HashTable::ResizeBuckets(int64_t num_buckets, const HashTableCtx* ht_ctx) {
   // Note that while we copying over the contents of the old hash table, we need to have
   // allocated both the old and the new hash table. Once we finish, we return the memory
   // of the old hash table.
-  int64_t old_size = num_buckets_ * sizeof(Bucket);
-  int64_t new_size = num_buckets * sizeof(Bucket);
-  if (!state_->block_mgr()->ConsumeMemory(block_mgr_client_, new_size)) return false;
-  Bucket* new_buckets = reinterpret_cast<Bucket*>(malloc(new_size));
-  DCHECK(new_buckets != NULL);
-  memset(new_buckets, 0, new_size);
+  int64_t old_size = BucketsByteSize(num_buckets_);
+  if (!state_->block_mgr()->ConsumeMemory(block_mgr_client_,
+      BucketsByteSize(num_buckets))) {
+    return false;
+  }
+  bool new_buckets_mmapped;
+  Bucket* new_buckets = reinterpret_cast<Bucket*>(
+      AllocateBucketArray(num_buckets * sizeof(Bucket), &new_buckets_mmapped));
+  uint8_t* new_tags = NULL;
+  bool new_tags_mmapped = false;
+  if (tag_probing_) {
+    new_tags = AllocateBucketArray(TagsByteSize(num_buckets), &new_tags_mmapped);
+  }
 
   // Walk the old table and copy all the filled buckets to the new (resized) table.
   // We do not have to do anything with the duplicate nodes. This operation is expected
@@ -445,18 +517,25 @@ bool HashTable::ResizeBuckets(int64_t num_buckets, const HashTableCtx* ht_ctx) {
        NextFilledBucket(&iter.bucket_idx_, &iter.node_)) {
     Bucket* bucket_to_copy = &buckets_[iter.bucket_idx_];
     bool found = false;
-    int64_t bucket_idx =
-        Probe<true>(new_buckets, num_buckets, NULL, bucket_to_copy->hash, &found);
+    int64_t bucket_idx = Probe<true>(new_buckets, new_tags, num_buckets, NULL,
+        bucket_to_copy->hash, &found);
     DCHECK(!found);
     DCHECK_NE(bucket_idx, Iterator::BUCKET_NOT_FOUND) << " Probe failed even though "
         " there are free buckets. " << num_buckets << " " << num_filled_buckets_;
     Bucket* dst_bucket = &new_buckets[bucket_idx];
     *dst_bucket = *bucket_to_copy;
+    if (tag_probing_) {
+      SetTag(new_tags, num_buckets, bucket_idx, HashToTag(bucket_to_copy->hash));
+    }
   }
 
-  num_buckets_ = num_buckets;
-  free(buckets_);
+  FreeBucketArray(buckets_, num_buckets_ * sizeof(Bucket), buckets_mmapped_);
   buckets_ = new_buckets;
+  buckets_mmapped_ = new_buckets_mmapped;
+  if (tags_ != NULL) FreeBucketArray(tags_, TagsByteSize(num_buckets_), tags_mmapped_);
+  tags_ = new_tags;
+  tags_mmapped_ = new_tags_mmapped;
+  num_buckets_ = num_buckets;
   state_->block_mgr()->ReleaseMemory(block_mgr_client_, old_size);
   return true;
 }
@@ -482,7 +561,9 @@ bool HashTable::GrowNodeArray() {
 
 void HashTable::DebugStringTuple(stringstream& ss, HtData& htdata,
     const RowDescriptor* desc) {
-  if (stores_tuples_) {
+  if (inline_tuple_size_ > 0) {
+    ss << "(inline)";
+  } else if (stores_tuples_) {
     ss << "(" << htdata.tuple << ")";
   } else {
     ss << "(" << htdata.idx.block() << ", " << htdata.idx.idx()
@@ -1046,6 +1127,7 @@ Status HashTableCtx::CodegenEquals(RuntimeState* state, bool force_null_equality
       return Status("HashTableCtx::CodegenEquals(): CHAR NYI");
     }
   }
+  if (HasPackedKeys(force_null_equality)) return CodegenPackedEquals(state, fn);
 
   LlvmCodeGen* codegen;
   RETURN_IF_ERROR(state->GetCodegen(&codegen));
@@ -1156,6 +1238,138 @@ Status HashTableCtx::CodegenEquals(RuntimeState* state, bool force_null_equality
   return Status::OK();
 }
 
+bool HashTableCtx::HasPackedKeys(bool force_null_equality) const {
+  const int expr_values_bytes_per_row = expr_values_cache_.expr_values_bytes_per_row();
+  if (expr_values_cache_.var_result_offset() != -1) return false;
+  if (expr_values_bytes_per_row == 0) return false;
+  if (expr_values_bytes_per_row > MAX_PACKED_KEY_BYTES) return false;
+  for (int i = 0; i < build_expr_ctxs_.size(); ++i) {
+    switch (build_expr_ctxs_[i]->root()->type().type) {
+      case TYPE_BOOLEAN:
+      case TYPE_TINYINT:
+      case TYPE_SMALLINT:
+      case TYPE_INT:
+      case TYPE_BIGINT:
+        break;
+      default:
+        return false;
+    }
+    if (stores_nulls_ && !force_null_equality && !finds_nulls_[i]) return false;
+  }
+  return true;
+}
+
+// Codegen for HashTableCtx::Equals() with packed keys. For a group by with
+// (int, smallint), the IR looks like:
+//
+// define i1 @PackedEquals(%"class.impala::HashTableCtx"* %this_ptr,
+//                         %"class.impala::TupleRow"* %row) {
+// entry:
+//   %0 = load i8*, i8** inttoptr (i64 230325056 to i8**)
+//   %1 = load i8*, i8** inttoptr (i64 230325064 to i8**)
+//   %result = call i64 @GetSlotRef(...)
+//   %is_null = trunc i64 %result to i1
+//   %2 = ashr i64 %result, 32
+//   %val = trunc i64 %2 to i32
+//   %val1 = select i1 %is_null, i32 -2128831035, i32 %val
+//   %3 = zext i32 %val1 to i64
+//   %packed = or i64 0, %3
+//   %null_byte = load i8, i8* %1
+//   %row_is_null = icmp ne i8 %null_byte, 0
+//   %null_eq = icmp eq i1 %is_null, %row_is_null
+//   %nulls_equal = and i1 true, %null_eq
+//   ... same for the smallint at offset 4, shifted left by 32 bits ...
+//   %cached = bitcast i8* %0 to i64*
+//   %cached_values = load i64, i64* %cached, align 1
+//   %values_equal = icmp eq i64 %packed2, %cached_values
+//   %equal = and i1 %values_equal, %nulls_equal2
+//   ret i1 %equal
+// }
+Status HashTableCtx::CodegenPackedEquals(RuntimeState* state, Function** fn) {
+  LlvmCodeGen* codegen;
+  RETURN_IF_ERROR(state->GetCodegen(&codegen));
+  Type* tuple_row_type = codegen->GetType(TupleRow::LLVM_CLASS_NAME);
+  DCHECK(tuple_row_type != NULL);
+  PointerType* tuple_row_ptr_type = PointerType::get(tuple_row_type, 0);
+
+  Type* this_type = codegen->GetType(HashTableCtx::LLVM_CLASS_NAME);
+  DCHECK(this_type != NULL);
+  PointerType* this_ptr_type = PointerType::get(this_type, 0);
+  PointerType* buffer_ptr_type = PointerType::get(codegen->ptr_type(), 0);
+  LlvmCodeGen::FnPrototype prototype(codegen, "PackedEquals",
+      codegen->GetType(TYPE_BOOLEAN));
+  prototype.AddArgument(LlvmCodeGen::NamedVariable("this_ptr", this_ptr_type));
+  prototype.AddArgument(LlvmCodeGen::NamedVariable("row", tuple_row_ptr_type));
+
+  LLVMContext& context = codegen->context();
+  LlvmCodeGen::LlvmBuilder builder(context);
+  Value* args[2];
+  *fn = prototype.GeneratePrototype(&builder, args);
+  Value* row = args[1];
+
+  Value* cur_expr_values_ptr = codegen->CastPtrToLlvmPtr(buffer_ptr_type,
+      &expr_values_cache_.cur_expr_values_);
+  Value* cur_expr_values = builder.CreateLoad(cur_expr_values_ptr);
+  Value* cur_expr_values_null_ptr = codegen->CastPtrToLlvmPtr(buffer_ptr_type,
+      &expr_values_cache_.cur_expr_values_null_);
+  Value* cur_expr_values_null = builder.CreateLoad(cur_expr_values_null_ptr);
+
+  // The padding between the values in 'cur_expr_values_' is always zero.
+  IntegerType* packed_type = IntegerType::get(context,
+      expr_values_cache_.expr_values_bytes_per_row() * 8);
+  Value* packed = ConstantInt::get(packed_type, 0);
+  Value* nulls_equal = codegen->true_value();
+  for (int i = 0; i < build_expr_ctxs_.size(); ++i) {
+    Function* expr_fn;
+    Status status = build_expr_ctxs_[i]->root()->GetCodegendComputeFn(state, &expr_fn);
+    if (!status.ok()) {
+      (*fn)->eraseFromParent(); // deletes function
+      *fn = NULL;
+      return Status(Substitute("Problem with HashTableCtx::CodegenPackedEquals: $0",
+          status.GetDetail()));
+    }
+    const ColumnType& type = build_expr_ctxs_[i]->root()->type();
+    Value* ctx_arg = codegen->CastPtrToLlvmPtr(
+        codegen->GetPtrType(ExprContext::LLVM_CLASS_NAME), build_expr_ctxs_[i]);
+    Value* expr_fn_args[] = { ctx_arg, row };
+    CodegenAnyVal result = CodegenAnyVal::CreateCallWrapped(codegen, &builder, type,
+        expr_fn, expr_fn_args, "result");
+    Value* is_null = result.GetIsNull();
+
+    // NULLs are stored as the FNV seed in 'cur_expr_values_', see EvalRow().
+    // Booleans are stored as one byte.
+    const int slot_size = type.GetSlotSize();
+    Value* val = builder.CreateZExt(result.GetVal(), IntegerType::get(context,
+        slot_size * 8), "val");
+    val = builder.CreateSelect(is_null,
+        codegen->GetIntConstant(slot_size, HashUtil::FNV_SEED), val);
+    val = builder.CreateZExt(val, packed_type);
+    int offset = expr_values_cache_.expr_values_offsets(i);
+    if (offset > 0) val = builder.CreateShl(val, offset * 8);
+    packed = builder.CreateOr(packed, val, "packed");
+
+    Value* null_byte_loc = builder.CreateGEP(NULL, cur_expr_values_null,
+        codegen->GetIntConstant(TYPE_INT, i), "null_byte_loc");
+    Value* row_is_null = builder.CreateICmpNE(builder.CreateLoad(null_byte_loc),
+        codegen->GetIntConstant(TYPE_TINYINT, 0), "row_is_null");
+    nulls_equal = builder.CreateAnd(nulls_equal,
+        builder.CreateICmpEQ(is_null, row_is_null), "nulls_equal");
+  }
+  Value* cached = builder.CreateBitCast(cur_expr_values,
+      PointerType::get(packed_type, 0), "cached");
+  // Rows in 'cur_expr_values_' are not aligned to the size of the packed integer.
+  Value* cached_values = builder.CreateAlignedLoad(cached, 1, "cached_values");
+  Value* values_equal = builder.CreateICmpEQ(packed, cached_values, "values_equal");
+  builder.CreateRet(builder.CreateAnd(values_equal, nulls_equal, "equal"));
+
+  *fn = codegen->FinalizeFunction(*fn);
+  if (*fn == NULL) {
+    return Status("Codegen'd HashTableCtx::PackedEquals() function failed "
+        "verification, see log");
+  }
+  return Status::OK();
+}
+
 Status HashTableCtx::ReplaceHashTableConstants(RuntimeState* state,
     bool stores_duplicates, int num_build_tuples, Function* fn,
     HashTableReplacedConstants* replacement_counts) {
@@ -1172,5 +1386,7 @@ Status HashTableCtx::ReplaceHashTableConstants(RuntimeState* state,
       fn, stores_duplicates, "stores_duplicates");
   replacement_counts->quadratic_probing = codegen->ReplaceCallSitesWithBoolConst(
       fn, FLAGS_enable_quadratic_probing, "quadratic_probing");
+  replacement_counts->tag_probing = codegen->ReplaceCallSitesWithBoolConst(
+      fn, FLAGS_enable_hash_table_tag_probing, "tag_probing");
   return Status::OK();
 }
@@ -182,6 +182,9 @@ class HashTableCtx {
   Status CodegenEquals(RuntimeState* state, bool force_null_equality,
       llvm::Function** fn);
 
+  /// The maximum size of the fixed-width keys that CodegenEquals() compares packed.
+  static const int MAX_PACKED_KEY_BYTES = 16;
+
   /// Codegen for hashing the expr values in 'cur_expr_values_'. Function prototype
   /// matches HashCurrentRow identically. Unlike HashCurrentRow(), the returned function
   /// only uses a single hash function, rather than switching based on level_.
@@ -196,6 +199,7 @@ class HashTableCtx {
     int stores_tuples;
     int stores_duplicates;
     int quadratic_probing;
+    int tag_probing;
   };
 
   /// Replace hash table parameters with constants in 'fn'. Updates 'replacement_counts'
@@ -432,6 +436,18 @@ class HashTableCtx {
   /// Cross-compiled function to access member variables used in CodegenHashCurrentRow().
   uint32_t GetHashSeed() const;
 
+  /// Returns true if the keys are integers or booleans that together occupy at most
+  /// MAX_PACKED_KEY_BYTES in 'cur_expr_values_' and CodegenEquals() can compare them as
+  /// a single packed integer. Comparing NULLs this way treats them as equal, so this
+  /// requires that either 'force_null_equality' is true, all of 'finds_nulls_' are true
+  /// or no NULLs are stored.
+  bool HasPackedKeys(bool force_null_equality) const;
+
+  /// Codegen for Equals() if HasPackedKeys() is true. The generated function packs the
+  /// values of the build exprs into an integer laid out like 'cur_expr_values_' and
+  /// compares it and the NULL indicators without any branches.
+  Status CodegenPackedEquals(RuntimeState* state, llvm::Function** fn);
+
   /// Functions to be replaced by codegen to specialize the hash table.
   bool IR_NO_INLINE stores_nulls() const { return stores_nulls_; }
   bool IR_NO_INLINE finds_some_nulls() const { return finds_some_nulls_; }
@@ -473,12 +489,23 @@ class HashTableCtx {
 /// linked list of duplicate nodes that point to the actual data. Note that the duplicate
 /// nodes do not contain the hash value, because all the linked nodes have the same hash
 /// value, the one in the bucket. The data is either a tuple stream index or a Tuple*.
+/// Tables with an inline tuple size store a copy of their small single build tuple in
+/// the place of the Tuple*, so that a probe hit does not touch the tuple stream.
 /// This array of buckets is sparse, we are shooting for up to 3/4 fill factor (75%). The
 /// data allocated by the hash table comes from the BufferedBlockMgr.
+//
+/// With tag probing (--enable_hash_table_tag_probing), the table also keeps a parallel
+/// array with a one-byte tag for each bucket: 0 if the bucket is empty, otherwise 7 bits
+/// of the hash that are not used for the bucket index. Probing is linear, but each step
+/// compares the tags of TAG_GROUP_SIZE consecutive buckets with a single SSE2 compare,
+/// so the buckets themselves are only read for likely matches. The tags of the first
+/// TAG_GROUP_SIZE - 1 buckets are cloned past the end of the array, so a group can
+/// start at any bucket without wrapping around.
 class HashTable {
  private:
 
-  /// Either the row in the tuple stream or a pointer to the single tuple of this row.
+  /// Either the row in the tuple stream, a pointer to the single tuple of this row, or
+  /// the bytes of that tuple if the table stores tuples inline.
   union HtData {
     BufferedTupleStream::RowIdx idx;
     Tuple* tuple;
@@ -540,9 +567,17 @@ class HashTable {
   ///    -1, if it unlimited.
   ///  - initial_num_buckets: number of buckets that the hash table should be initialized
   ///    with.
+  ///  - inline_tuple_size: if > 0, the byte size of the single build tuple, which is
+  ///    copied into the buckets instead of being referenced. The tuple must be at most
+  ///    MAX_INLINE_TUPLE_SIZE bytes, not NULL, and without var-len data. Rows returned
+  ///    by the table then point into the buckets, so they must not outlive Close() or
+  ///    a resize.
   static HashTable* Create(RuntimeState* state, BufferedBlockMgr::Client* client,
       bool stores_duplicates, int num_build_tuples, BufferedTupleStream* tuple_stream,
-      int64_t max_num_buckets, int64_t initial_num_buckets);
+      int64_t max_num_buckets, int64_t initial_num_buckets, int inline_tuple_size = 0);
+
+  /// The largest build tuple that can be stored inline, which is the size of a Tuple*.
+  static const int MAX_INLINE_TUPLE_SIZE = 8;
 
   /// Allocates the initial bucket structure. Returns false if OOM.
   bool Init();
@@ -558,7 +593,8 @@ class HashTable {
   /// hash table and the caller must guarantee it stays in memory. This will not grow the
   /// hash table. In the case that there is a need to insert a duplicate node, instead of
   /// filling a new bucket, and there is not enough memory to insert a duplicate node,
-  /// the insert fails and this function returns false.
+  /// the insert fails and this function returns false. If the table does not store
+  /// duplicates, a row whose key is already in the table replaces the stored row.
   /// Used during the build phase of hash joins.
   bool IR_ALWAYS_INLINE Insert(HashTableCtx* ht_ctx,
       const BufferedTupleStream::RowIdx& idx, TupleRow* row);
@@ -567,6 +603,12 @@ class HashTable {
   template<const bool READ>
   void IR_ALWAYS_INLINE PrefetchBucket(uint32_t hash);
 
+  /// Prefetch the data that probing compares against for the bucket which 'hash' maps
+  /// to: its first duplicate node or the tuple of its row. Does nothing if the bucket is
+  /// empty or the row is stored in the tuple stream. The bucket itself should have been
+  /// prefetched with PrefetchBucket() well before calling this, as it is read here.
+  void IR_ALWAYS_INLINE PrefetchBucketData(uint32_t hash);
+
   /// Returns an iterator to the bucket that matches the probe expression results that
   /// are cached at the current position of the ExprValuesCache in 'ht_ctx'. Assumes that
   /// the ExprValuesCache was filled using EvalAndHashProbe(). Returns HashTable::End()
@@ -611,7 +653,8 @@ class HashTable {
     return num_buckets * sizeof(Bucket);
   }
 
-  /// Return the size of a hash table bucket in bytes.
+  /// Return the size of a hash table bucket in bytes. Does not include the tag of the
+  /// bucket if tag probing is enabled.
   static int64_t BucketSize() { return sizeof(Bucket); }
 
   /// Returns the memory occupied by the hash table, takes into account the number of
@@ -629,7 +672,9 @@ class HashTable {
   bool CheckAndResize(uint64_t buckets_to_fill, const HashTableCtx* ht_ctx);
 
   /// Returns the number of bytes allocated to the hash table from the block manager.
-  int64_t ByteSize() const { return num_buckets_ * sizeof(Bucket) + total_data_page_size_; }
+  int64_t ByteSize() const {
+    return BucketsByteSize(num_buckets_) + total_data_page_size_;
+  }
 
   /// Returns an iterator at the beginning of the hash table.  Advancing this iterator
   /// will traverse all elements.
@@ -751,9 +796,12 @@ class HashTable {
   /// of calling this constructor directly.
   ///  - quadratic_probing: set to true when the probing algorithm is quadratic, as
   ///    opposed to linear.
-  HashTable(bool quadratic_probing, RuntimeState* state, BufferedBlockMgr::Client* client,
-      bool stores_duplicates, int num_build_tuples, BufferedTupleStream* tuple_stream,
-      int64_t max_num_buckets, int64_t initial_num_buckets);
+  ///  - tag_probing: set to true to probe linearly over groups of bucket tags. Takes
+  ///    precedence over 'quadratic_probing'.
+  HashTable(bool quadratic_probing, bool tag_probing, RuntimeState* state,
+      BufferedBlockMgr::Client* client, bool stores_duplicates, int num_build_tuples,
+      BufferedTupleStream* tuple_stream, int64_t max_num_buckets,
+      int64_t initial_num_buckets, int inline_tuple_size = 0);
 
   /// Performs the probing operation according to the probing algorithm (linear or
   /// quadratic. Returns one of the following:
@@ -776,12 +824,37 @@ class HashTable {
   ///
   /// 'hash' is the hash computed by EvalAndHashBuild() or EvalAndHashProbe().
   /// 'found' indicates that a bucket that contains an equal row is found.
+  /// 'tags' are the tags of 'buckets' if tag probing is enabled.
   ///
   /// There are wrappers of this function that perform the Find and Insert logic.
   template <bool FORCE_NULL_EQUALITY>
-  int64_t IR_ALWAYS_INLINE Probe(Bucket* buckets, int64_t num_buckets,
+  int64_t IR_ALWAYS_INLINE Probe(Bucket* buckets, uint8_t* tags, int64_t num_buckets,
+      HashTableCtx* ht_ctx, uint32_t hash, bool* found);
+
+  /// Implementation of Probe() for tag probing. Returns the same bucket as linear
+  /// probing would.
+  template <bool FORCE_NULL_EQUALITY>
+  int64_t IR_ALWAYS_INLINE ProbeTags(Bucket* buckets, uint8_t* tags, int64_t num_buckets,
       HashTableCtx* ht_ctx, uint32_t hash, bool* found);
 
+  /// Returns the tag of a filled bucket with 'hash'.
+  static uint8_t HashToTag(uint32_t hash) { return 0x80 | (hash >> 25); }
+
+  /// Sets the tag of the bucket with index 'bucket_idx' in 'tags', including its clones.
+  static void IR_ALWAYS_INLINE SetTag(uint8_t* tags, int64_t num_buckets,
+      int64_t bucket_idx, uint8_t tag);
+
+  /// Returns the size of the tag array of a table with 'num_buckets' buckets.
+  static int64_t TagsByteSize(int64_t num_buckets) {
+    return num_buckets + TAG_GROUP_SIZE - 1;
+  }
+
+  /// Returns the memory used by the buckets of a table with 'num_buckets' buckets,
+  /// including their tags if tag probing is enabled.
+  int64_t BucketsByteSize(int64_t num_buckets) const {
+    return num_buckets * sizeof(Bucket) + (tag_probing_ ? TagsByteSize(num_buckets) : 0);
+  }
+
   /// Performs the insert logic. Returns the HtData* of the bucket or duplicate node
   /// where the data should be inserted. Returns NULL if the insert was not successful.
   HtData* IR_ALWAYS_INLINE InsertInternal(HashTableCtx* ht_ctx);
@@ -795,6 +868,13 @@ class HashTable {
   /// Resize the hash table to 'num_buckets'. Returns false on OOM.
   bool ResizeBuckets(int64_t num_buckets, const HashTableCtx* ht_ctx);
 
+  /// Allocates a zeroed array of 'size' bytes for the buckets or tags. Arrays of at least
+  /// 2MB are mmap'd and backed by huge pages with --hash_table_huge_pages, in which case
+  /// 'mmapped' is set. The memory is accounted for by the caller through the block mgr.
+  /// FreeBucketArray() frees the array.
+  static uint8_t* AllocateBucketArray(int64_t size, bool* mmapped);
+  static void FreeBucketArray(void* data, int64_t size, bool mmapped);
+
   /// Appends the DuplicateNode pointed by next_node_ to 'bucket' and moves the next_node_
   /// pointer to the next DuplicateNode in the page, updating the remaining node counter.
   DuplicateNode* IR_ALWAYS_INLINE AppendNextNode(Bucket* bucket);
@@ -828,11 +908,18 @@ class HashTable {
   bool IR_NO_INLINE stores_tuples() const { return stores_tuples_; }
   bool IR_NO_INLINE stores_duplicates() const { return stores_duplicates_; }
   bool IR_NO_INLINE quadratic_probing() const { return quadratic_probing_; }
+  bool IR_NO_INLINE tag_probing() const { return tag_probing_; }
+
+  int inline_tuple_size() const { return inline_tuple_size_; }
 
   /// Load factor that will trigger growing the hash table on insert.  This is
   /// defined as the number of non-empty buckets / total_buckets
   static const double MAX_FILL_FACTOR;
 
+  /// Number of bucket tags compared at once by tag probing, i.e. the number of bytes in
+  /// an SSE2 register.
+  static const int TAG_GROUP_SIZE = 16;
+
   RuntimeState* state_;
 
   /// Client to allocate data pages with.
@@ -853,6 +940,13 @@ class HashTable {
   /// Quadratic probing enabled (as opposed to linear).
   const bool quadratic_probing_;
 
+  /// Tag probing enabled. If true, 'quadratic_probing_' is ignored.
+  const bool tag_probing_;
+
+  /// Byte size of the single build tuple if it is stored in the buckets and duplicate
+  /// nodes instead of being referenced, 0 otherwise.
+  const int inline_tuple_size_;
+
   /// Data pages for all nodes. These are always pinned.
   std::vector<BufferedBlockMgr::Block*> data_pages_;
 
@@ -874,6 +968,14 @@ class HashTable {
   /// control memory footprint.
   Bucket* buckets_;
 
+  /// Array of the tags of all buckets if tag probing is enabled, NULL otherwise. Has
+  /// TagsByteSize(num_buckets_) entries. Owned by this node.
+  uint8_t* tags_;
+
+  /// True if buckets_ or tags_ were mapped with mmap() rather than malloc'd.
+  bool buckets_mmapped_;
+  bool tags_mmapped_;
+
   /// Total number of buckets (filled and empty).
   int64_t num_buckets_;
 
@@ -18,6 +18,8 @@
 
 #include "exec/hash-table.h"
 
+#include <emmintrin.h>
+
 #include "exprs/expr.h"
 #include "exprs/expr-context.h"
 
@@ -45,10 +47,14 @@ inline void HashTableCtx::ExprValuesCache::NextRow() {
 }
 
 template <bool FORCE_NULL_EQUALITY>
-inline int64_t HashTable::Probe(Bucket* buckets, int64_t num_buckets,
+inline int64_t HashTable::Probe(Bucket* buckets, uint8_t* tags, int64_t num_buckets,
     HashTableCtx* ht_ctx, uint32_t hash, bool* found) {
   DCHECK(buckets != NULL);
   DCHECK_GT(num_buckets, 0);
+  if (tag_probing()) {
+    return ProbeTags<FORCE_NULL_EQUALITY>(buckets, tags, num_buckets, ht_ctx, hash,
+        found);
+  }
   *found = false;
   int64_t bucket_idx = hash & (num_buckets - 1);
 
@@ -86,13 +92,72 @@ inline int64_t HashTable::Probe(Bucket* buckets, int64_t num_buckets,
   return Iterator::BUCKET_NOT_FOUND;
 }
 
+template <bool FORCE_NULL_EQUALITY>
+inline int64_t HashTable::ProbeTags(Bucket* buckets, uint8_t* tags, int64_t num_buckets,
+    HashTableCtx* ht_ctx, uint32_t hash, bool* found) {
+  DCHECK(tags != NULL);
+  *found = false;
+  const __m128i tag = _mm_set1_epi8(HashToTag(hash));
+  const __m128i empty_tag = _mm_setzero_si128();
+  int64_t bucket_idx = hash & (num_buckets - 1);
+  for (int64_t step = 0; step < num_buckets; step += TAG_GROUP_SIZE) {
+    // The tags of the group are contiguous thanks to the clones past the end.
+    __m128i group = _mm_loadu_si128(reinterpret_cast<const __m128i*>(tags + bucket_idx));
+    uint32_t matches = _mm_movemask_epi8(_mm_cmpeq_epi8(group, tag));
+    uint32_t empties = _mm_movemask_epi8(_mm_cmpeq_epi8(group, empty_tag));
+    // Linear probing stops at the first empty bucket.
+    int first_empty = empties == 0 ? TAG_GROUP_SIZE : __builtin_ctz(empties);
+    matches &= (1U << first_empty) - 1;
+    while (matches != 0) {
+      int offset = __builtin_ctz(matches);
+      int64_t idx = (bucket_idx + offset) & (num_buckets - 1);
+      Bucket* bucket = &buckets[idx];
+      DCHECK(bucket->filled);
+      if (hash == bucket->hash) {
+        if (ht_ctx != NULL &&
+            ht_ctx->Equals<FORCE_NULL_EQUALITY>(GetRow(bucket, ht_ctx->scratch_row_))) {
+          *found = true;
+          travel_length_ += step + offset;
+          return idx;
+        }
+        // Row equality failed, or not performed. This is a hash collision. Continue
+        // searching.
+        ++num_hash_collisions_;
+      }
+      matches &= matches - 1;
+    }
+    if (empties != 0) {
+      travel_length_ += step + first_empty;
+      int64_t idx = (bucket_idx + first_empty) & (num_buckets - 1);
+      DCHECK(!buckets[idx].filled);
+      return idx;
+    }
+    bucket_idx = (bucket_idx + TAG_GROUP_SIZE) & (num_buckets - 1);
+  }
+  DCHECK_EQ(num_filled_buckets_, num_buckets) << "Probing of a non-full table "
+      << "failed: " << hash;
+  return Iterator::BUCKET_NOT_FOUND;
+}
+
+inline void HashTable::SetTag(uint8_t* tags, int64_t num_buckets, int64_t bucket_idx,
+    uint8_t tag) {
+  DCHECK_GE(bucket_idx, 0);
+  DCHECK_LT(bucket_idx, num_buckets);
+  // Tables with fewer buckets than TAG_GROUP_SIZE have several clones of a tag.
+  for (int64_t i = bucket_idx; i < TagsByteSize(num_buckets); i += num_buckets) {
+    tags[i] = tag;
+  }
+}
+
 inline HashTable::HtData* HashTable::InsertInternal(HashTableCtx* ht_ctx) {
   ++num_probes_;
   bool found = false;
   uint32_t hash = ht_ctx->expr_values_cache()->ExprValuesHash();
-  int64_t bucket_idx = Probe<true>(buckets_, num_buckets_, ht_ctx, hash, &found);
+  int64_t bucket_idx = Probe<true>(buckets_, tags_, num_buckets_, ht_ctx, hash, &found);
   DCHECK_NE(bucket_idx, Iterator::BUCKET_NOT_FOUND);
   if (found) {
+    // Without duplicates, the new row replaces the row that has the same key.
+    if (!stores_duplicates()) return &buckets_[bucket_idx].bucketData.htdata;
     // We need to insert a duplicate node, note that this may fail to allocate memory.
     DuplicateNode* new_node = InsertDuplicateNode(bucket_idx);
     if (UNLIKELY(new_node == NULL)) return NULL;
@@ -108,7 +173,10 @@ inline bool HashTable::Insert(HashTableCtx* ht_ctx,
   HtData* htdata = InsertInternal(ht_ctx);
   // If successful insert, update the contents of the newly inserted entry with 'idx'.
   if (LIKELY(htdata != NULL)) {
-    if (stores_tuples()) {
+    if (inline_tuple_size() > 0) {
+      DCHECK(row->GetTuple(0) != NULL);
+      memcpy(htdata, row->GetTuple(0), inline_tuple_size());
+    } else if (stores_tuples()) {
       htdata->tuple = row->GetTuple(0);
     } else {
       htdata->idx = idx;
@@ -127,13 +195,24 @@ inline void HashTable::PrefetchBucket(uint32_t hash) {
   // On x86, they map to instructions prefetchnta and prefetch{2-0} respectively.
   // TODO: Reconsider the locality level with smaller prefetch batch size.
   __builtin_prefetch(&buckets_[bucket_idx], READ ? 0 : 1, 1);
+  if (tag_probing()) __builtin_prefetch(&tags_[bucket_idx], READ ? 0 : 1, 1);
+}
+
+inline void HashTable::PrefetchBucketData(uint32_t hash) {
+  Bucket* bucket = &buckets_[hash & (num_buckets_ - 1)];
+  if (!bucket->filled) return;
+  if (stores_duplicates() && bucket->hasDuplicates) {
+    __builtin_prefetch(bucket->bucketData.duplicates, 0, 1);
+  } else if (stores_tuples() && inline_tuple_size() == 0) {
+    __builtin_prefetch(bucket->bucketData.htdata.tuple, 0, 1);
+  }
 }
 
 inline HashTable::Iterator HashTable::FindProbeRow(HashTableCtx* ht_ctx) {
   ++num_probes_;
   bool found = false;
   uint32_t hash = ht_ctx->expr_values_cache()->ExprValuesHash();
-  int64_t bucket_idx = Probe<false>(buckets_, num_buckets_, ht_ctx, hash, &found);
+  int64_t bucket_idx = Probe<false>(buckets_, tags_, num_buckets_, ht_ctx, hash, &found);
   if (found) {
     return Iterator(this, ht_ctx->scratch_row(), bucket_idx,
         stores_duplicates() ? buckets_[bucket_idx].bucketData.duplicates : NULL);
@@ -146,7 +225,7 @@ inline HashTable::Iterator HashTable::FindBuildRowBucket(
     HashTableCtx* ht_ctx, bool* found) {
   ++num_probes_;
   uint32_t hash = ht_ctx->expr_values_cache()->ExprValuesHash();
-  int64_t bucket_idx = Probe<true>(buckets_, num_buckets_, ht_ctx, hash, found);
+  int64_t bucket_idx = Probe<true>(buckets_, tags_, num_buckets_, ht_ctx, hash, found);
   DuplicateNode* duplicates = NULL;
   if (stores_duplicates() && LIKELY(bucket_idx != Iterator::BUCKET_NOT_FOUND)) {
     duplicates = buckets_[bucket_idx].bucketData.duplicates;
@@ -199,6 +278,7 @@ inline void HashTable::PrepareBucketForInsert(int64_t bucket_idx, uint32_t hash)
   bucket->matched = false;
   bucket->hasDuplicates = false;
   bucket->hash = hash;
+  if (tag_probing()) SetTag(tags_, num_buckets_, bucket_idx, HashToTag(hash));
 }
 
 inline HashTable::DuplicateNode* HashTable::AppendNextNode(Bucket* bucket) {
@@ -238,7 +318,10 @@ inline HashTable::DuplicateNode* HashTable::InsertDuplicateNode(int64_t bucket_i
 }
 
 inline TupleRow* IR_ALWAYS_INLINE HashTable::GetRow(HtData& htdata, TupleRow* row) const {
-  if (stores_tuples()) {
+  if (inline_tuple_size() > 0) {
+    row->SetTuple(0, reinterpret_cast<Tuple*>(&htdata));
+    return row;
+  } else if (stores_tuples()) {
     return reinterpret_cast<TupleRow*>(&htdata.tuple);
   } else {
     // TODO: GetTupleRow() has interpreted code that iterates over the row's descriptor.
@@ -274,6 +357,7 @@ inline TupleRow* IR_ALWAYS_INLINE HashTable::Iterator::GetRow() const {
 inline Tuple* IR_ALWAYS_INLINE HashTable::Iterator::GetTuple() const {
   DCHECK(!AtEnd());
   DCHECK(table_->stores_tuples());
+  DCHECK_EQ(table_->inline_tuple_size(), 0);
   Bucket* bucket = &table_->buckets_[bucket_idx_];
   // TODO: To avoid the hasDuplicates check, store the HtData* in the Iterator.
   if (UNLIKELY(table_->stores_duplicates() && bucket->hasDuplicates)) {
@@ -287,6 +371,7 @@ inline Tuple* IR_ALWAYS_INLINE HashTable::Iterator::GetTuple() const {
 inline void HashTable::Iterator::SetTuple(Tuple* tuple, uint32_t hash) {
   DCHECK(!AtEnd());
   DCHECK(table_->stores_tuples());
+  DCHECK_EQ(table_->inline_tuple_size(), 0);
   table_->PrepareBucketForInsert(bucket_idx_, hash);
   table_->buckets_[bucket_idx_].bucketData.htdata.tuple = tuple;
 }
@@ -383,7 +468,7 @@ inline void HashTableCtx::set_level(int level) {
 }
 
 inline int64_t HashTable::CurrentMemSize() const {
-  return num_buckets_ * sizeof(Bucket) + num_duplicate_nodes_ * sizeof(DuplicateNode);
+  return BucketsByteSize(num_buckets_) + num_duplicate_nodes_ * sizeof(DuplicateNode);
 }
 
 inline int64_t HashTable::NumInsertsBeforeResize() const {
@@ -17,6 +17,7 @@
 
 #include <cstring>
 #include <algorithm>
+#include <gflags/gflags.h>
 
 #include "util/bit-util.h"
 #include "util/jni-util.h"
@@ -32,6 +33,14 @@
 using namespace impala;
 using namespace strings;
 
+DEFINE_int64(hbase_scan_target_rpc_bytes, 2 * 1024 * 1024, "(Advanced) Unless the "
+    "hbase_caching query option is set, the number of rows fetched per HBase scanner "
+    "RPC is picked at the start of each scan range so that a batch holds about this "
+    "many bytes, based on the rows read so far. If <= 0, the number of rows is fixed.");
+DEFINE_int32(hbase_max_gets_per_batch, 1024, "(Advanced) Maximum number of HBase scan "
+    "ranges covering a single row key that are fetched together with one multi-get. "
+    "If <= 0, every scan range is read with its own scanner.");
+
 jclass HBaseTableScanner::scan_cl_ = NULL;
 jclass HBaseTableScanner::resultscanner_cl_ = NULL;
 jclass HBaseTableScanner::result_cl_ = NULL;
@@ -42,6 +51,8 @@ jclass HBaseTableScanner::filter_list_op_cl_ = NULL;
 jclass HBaseTableScanner::single_column_value_filter_cl_ = NULL;
 jclass HBaseTableScanner::compare_op_cl_ = NULL;
 jclass HBaseTableScanner::scanner_timeout_ex_cl_ = NULL;
+jclass HBaseTableScanner::get_cl_ = NULL;
+jclass HBaseTableScanner::list_cl_ = NULL;
 jmethodID HBaseTableScanner::scan_ctor_ = NULL;
 jmethodID HBaseTableScanner::scan_set_max_versions_id_ = NULL;
 jmethodID HBaseTableScanner::scan_set_caching_id_ = NULL;
@@ -69,6 +80,13 @@ jmethodID HBaseTableScanner::cell_get_value_length_id_ = NULL;
 jmethodID HBaseTableScanner::filter_list_ctor_ = NULL;
 jmethodID HBaseTableScanner::filter_list_add_filter_id_ = NULL;
 jmethodID HBaseTableScanner::single_column_value_filter_ctor_ = NULL;
+jmethodID HBaseTableScanner::get_ctor_ = NULL;
+jmethodID HBaseTableScanner::get_set_max_versions_id_ = NULL;
+jmethodID HBaseTableScanner::get_set_cache_blocks_id_ = NULL;
+jmethodID HBaseTableScanner::get_add_column_id_ = NULL;
+jmethodID HBaseTableScanner::get_set_filter_id_ = NULL;
+jmethodID HBaseTableScanner::list_ctor_ = NULL;
+jmethodID HBaseTableScanner::list_add_id_ = NULL;
 jobject HBaseTableScanner::empty_row_ = NULL;
 jobject HBaseTableScanner::must_pass_all_op_ = NULL;
 jobjectArray HBaseTableScanner::compare_ops_ = NULL;
@@ -95,6 +113,10 @@ HBaseTableScanner::HBaseTableScanner(
     htable_(NULL),
     scan_(NULL),
     resultscanner_(NULL),
+    filter_list_(NULL),
+    get_results_(NULL),
+    num_get_results_(0),
+    get_result_idx_(0),
     cells_(NULL),
     cell_index_(0),
     num_requested_cells_(0),
@@ -102,15 +124,23 @@ HBaseTableScanner::HBaseTableScanner(
     num_cells_(0),
     all_cells_present_(false),
     value_pool_(new MemPool(scan_node_->mem_tracker())),
+    rows_read_(0),
+    row_bytes_read_(0),
     scan_setup_timer_(ADD_TIMER(scan_node_->runtime_profile(),
-      "HBaseTableScanner.ScanSetup")) {
+      "HBaseTableScanner.ScanSetup")),
+    num_get_batches_counter_(ADD_COUNTER(scan_node_->runtime_profile(),
+      "HBaseTableScanner.NumGetBatches", TUnit::UNIT)) {
   const TQueryOptions& query_option = state->query_options();
   if (query_option.__isset.hbase_caching && query_option.hbase_caching > 0) {
     rows_cached_ = query_option.hbase_caching;
+    autotune_caching_ = false;
+    max_rows_cached_ = rows_cached_;
   } else {
     int max_caching = scan_node_->suggested_max_caching();
     rows_cached_ = (max_caching > 0 && max_caching < DEFAULT_ROWS_CACHED) ?
         max_caching : DEFAULT_ROWS_CACHED;
+    autotune_caching_ = FLAGS_hbase_scan_target_rpc_bytes > 0;
+    max_rows_cached_ = max_caching > 0 ? max_caching : MAX_ROWS_CACHED;
   }
   cache_blocks_ = query_option.__isset.hbase_cache_blocks &&
       query_option.hbase_cache_blocks;
@@ -154,6 +184,9 @@ Status HBaseTableScanner::Init() {
       JniUtil::GetGlobalClassRef(env,
           "org/apache/hadoop/hbase/client/ScannerTimeoutException",
           &scanner_timeout_ex_cl_));
+  RETURN_IF_ERROR(
+      JniUtil::GetGlobalClassRef(env, "org/apache/hadoop/hbase/client/Get", &get_cl_));
+  RETURN_IF_ERROR(JniUtil::GetGlobalClassRef(env, "java/util/ArrayList", &list_cl_));
 
   // Distinguish HBase versions by checking for the existence of the Cell class.
   // HBase 0.95.2: Use Cell class and corresponding methods.
@@ -194,6 +227,28 @@ Status HBaseTableScanner::Init() {
       "([B)Lorg/apache/hadoop/hbase/client/Scan;");
   RETURN_ERROR_IF_EXC(env);
 
+  // Get method ids.
+  get_ctor_ = env->GetMethodID(get_cl_, "<init>", "([B)V");
+  RETURN_ERROR_IF_EXC(env);
+  get_set_max_versions_id_ = env->GetMethodID(get_cl_, "setMaxVersions",
+      "(I)Lorg/apache/hadoop/hbase/client/Get;");
+  RETURN_ERROR_IF_EXC(env);
+  get_set_cache_blocks_id_ = env->GetMethodID(get_cl_, "setCacheBlocks",
+      "(Z)Lorg/apache/hadoop/hbase/client/Get;");
+  RETURN_ERROR_IF_EXC(env);
+  get_add_column_id_ = env->GetMethodID(get_cl_, "addColumn",
+      "([B[B)Lorg/apache/hadoop/hbase/client/Get;");
+  RETURN_ERROR_IF_EXC(env);
+  get_set_filter_id_ = env->GetMethodID(get_cl_, "setFilter",
+      "(Lorg/apache/hadoop/hbase/filter/Filter;)Lorg/apache/hadoop/hbase/client/Get;");
+  RETURN_ERROR_IF_EXC(env);
+
+  // ArrayList method ids.
+  list_ctor_ = env->GetMethodID(list_cl_, "<init>", "(I)V");
+  RETURN_ERROR_IF_EXC(env);
+  list_add_id_ = env->GetMethodID(list_cl_, "add", "(Ljava/lang/Object;)Z");
+  RETURN_ERROR_IF_EXC(env);
+
   // ResultScanner method ids.
   resultscanner_next_id_ = env->GetMethodID(resultscanner_cl_, "next",
       "()Lorg/apache/hadoop/hbase/client/Result;");
@@ -340,6 +395,7 @@ Status HBaseTableScanner::ScanSetup(JNIEnv* env, const TupleDescriptor* tuple_de
     // scan_.addColumn(family_bytes, qualifier_bytes);
     env->CallObjectMethod(scan_, scan_add_column_id_, family_bytes, qualifier_bytes);
     RETURN_ERROR_IF_EXC(env);
+    columns_.push_back(make_pair(family, qualifier));
   }
 
   // circumvent hbase bug: make sure to select all cols that have filters,
@@ -367,6 +423,7 @@ Status HBaseTableScanner::ScanSetup(JNIEnv* env, const TupleDescriptor* tuple_de
     // scan_.addColumn(family_bytes, qualifier_bytes);
     env->CallObjectMethod(scan_, scan_add_column_id_, family_bytes, qualifier_bytes);
     RETURN_ERROR_IF_EXC(env);
+    columns_.push_back(make_pair(it->family, it->qualifier));
     ++num_addl_requested_cols_;
   }
 
@@ -402,6 +459,8 @@ Status HBaseTableScanner::ScanSetup(JNIEnv* env, const TupleDescriptor* tuple_de
     // scan.setFilter(filter_list);
     env->CallObjectMethod(scan_, scan_set_filter_id_, filter_list);
     RETURN_ERROR_IF_EXC(env);
+    // Keep the filters for the Gets of point lookups.
+    RETURN_IF_ERROR(JniUtil::LocalToGlobalRef(env, filter_list, &filter_list_));
   }
 
   return Status::OK();
@@ -462,6 +521,7 @@ Status HBaseTableScanner::InitScanRange(JNIEnv* env, jbyteArray start_bytes,
     RETURN_IF_ERROR(JniUtil::FreeGlobalRef(env, resultscanner_));
     resultscanner_ = NULL;
   }
+  RETURN_IF_ERROR(UpdateCaching(env));
   // resultscanner_ = htable_.getScanner(scan_);
   jobject local_resultscanner;
   RETURN_IF_ERROR(htable_->GetResultScanner(scan_, &local_resultscanner));
@@ -469,6 +529,99 @@ Status HBaseTableScanner::InitScanRange(JNIEnv* env, jbyteArray start_bytes,
   return Status::OK();
 }
 
+Status HBaseTableScanner::UpdateCaching(JNIEnv* env) {
+  if (!autotune_caching_ || rows_read_ == 0) return Status::OK();
+  int64_t avg_row_bytes = max<int64_t>(row_bytes_read_ / rows_read_, 1);
+  int rows_cached = max<int64_t>(1,
+      min<int64_t>(FLAGS_hbase_scan_target_rpc_bytes / avg_row_bytes, max_rows_cached_));
+  if (rows_cached == rows_cached_) return Status::OK();
+  VLOG_FILE << "Changing HBase scanner caching from " << rows_cached_ << " to "
+            << rows_cached << " rows (average row size " << avg_row_bytes << " bytes)";
+  rows_cached_ = rows_cached;
+  // scan_.setCaching(rows_cached_);
+  env->CallObjectMethod(scan_, scan_set_caching_id_, rows_cached_);
+  RETURN_ERROR_IF_EXC(env);
+  return Status::OK();
+}
+
+bool HBaseTableScanner::IsPointLookup(const ScanRange& scan_range) {
+  const string& start_key = scan_range.start_key();
+  const string& stop_key = scan_range.stop_key();
+  return !start_key.empty() && stop_key.size() == start_key.size() + 1 &&
+      stop_key[start_key.size()] == '\0' &&
+      stop_key.compare(0, start_key.size(), start_key) == 0;
+}
+
+Status HBaseTableScanner::InitCurrentScanRange(JNIEnv* env) {
+  const ScanRange& scan_range = (*scan_range_vector_)[current_scan_range_idx_];
+  if (FLAGS_hbase_max_gets_per_batch <= 0 || !IsPointLookup(scan_range)) {
+    return InitScanRange(env, scan_range);
+  }
+  int end_idx = current_scan_range_idx_ + 1;
+  while (end_idx < scan_range_vector_->size() &&
+      end_idx - current_scan_range_idx_ < FLAGS_hbase_max_gets_per_batch &&
+      IsPointLookup((*scan_range_vector_)[end_idx])) {
+    ++end_idx;
+  }
+  return FetchPointLookups(env, end_idx);
+}
+
+Status HBaseTableScanner::FetchPointLookups(JNIEnv* env, int end_idx) {
+  DCHECK(get_results_ == NULL);
+  JniLocalFrame jni_frame;
+  RETURN_IF_ERROR(jni_frame.push(env));
+  int num_gets = end_idx - current_scan_range_idx_;
+  // gets = new ArrayList<Get>(num_gets);
+  jobject gets = env->NewObject(list_cl_, list_ctor_, num_gets);
+  RETURN_ERROR_IF_EXC(env);
+  for (int i = current_scan_range_idx_; i < end_idx; ++i) {
+    DCHECK(IsPointLookup((*scan_range_vector_)[i]));
+    JniLocalFrame get_frame;
+    RETURN_IF_ERROR(get_frame.push(env));
+    jbyteArray row_bytes;
+    RETURN_IF_ERROR(CreateByteArray(env, (*scan_range_vector_)[i].start_key(),
+        &row_bytes));
+    // get = new Get(row_bytes);
+    jobject get = env->NewObject(get_cl_, get_ctor_, row_bytes);
+    RETURN_ERROR_IF_EXC(env);
+    // get.setMaxVersions(1);
+    env->CallObjectMethod(get, get_set_max_versions_id_, 1);
+    RETURN_ERROR_IF_EXC(env);
+    // get.setCacheBlocks(cache_blocks_);
+    env->CallObjectMethod(get, get_set_cache_blocks_id_, cache_blocks_);
+    RETURN_ERROR_IF_EXC(env);
+    for (int j = 0; j < columns_.size(); ++j) {
+      JniLocalFrame column_frame;
+      RETURN_IF_ERROR(column_frame.push(env));
+      jbyteArray family_bytes;
+      RETURN_IF_ERROR(CreateByteArray(env, columns_[j].first, &family_bytes));
+      jbyteArray qualifier_bytes;
+      RETURN_IF_ERROR(CreateByteArray(env, columns_[j].second, &qualifier_bytes));
+      // get.addColumn(family_bytes, qualifier_bytes);
+      env->CallObjectMethod(get, get_add_column_id_, family_bytes, qualifier_bytes);
+      RETURN_ERROR_IF_EXC(env);
+    }
+    if (filter_list_ != NULL) {
+      // get.setFilter(filter_list_);
+      env->CallObjectMethod(get, get_set_filter_id_, filter_list_);
+      RETURN_ERROR_IF_EXC(env);
+    }
+    // gets.add(get);
+    env->CallBooleanMethod(gets, list_add_id_, get);
+    RETURN_ERROR_IF_EXC(env);
+  }
+
+  // get_results_ = htable_.get(gets);
+  jobjectArray local_results;
+  RETURN_IF_ERROR(htable_->Get(gets, &local_results));
+  RETURN_IF_ERROR(JniUtil::LocalToGlobalRef(env, local_results, &get_results_));
+  num_get_results_ = env->GetArrayLength(get_results_);
+  get_result_idx_ = 0;
+  current_scan_range_idx_ = end_idx - 1;
+  COUNTER_ADD(num_get_batches_counter_, 1);
+  return Status::OK();
+}
+
 Status HBaseTableScanner::StartScan(JNIEnv* env, const TupleDescriptor* tuple_desc,
     const ScanRangeVector& scan_range_vector, const vector<THBaseFilter>& filters) {
   DCHECK(scan_range_vector.size() > 0);
@@ -483,7 +636,7 @@ Status HBaseTableScanner::StartScan(JNIEnv* env, const TupleDescriptor* tuple_de
   // resultscanner_ is NULL and gets created in InitScanRange, so we don't
   // need to check if it timed out.
   DCHECK(resultscanner_ == NULL);
-  return InitScanRange(env, (*scan_range_vector_)[current_scan_range_idx_]);
+  return InitCurrentScanRange(env);
 }
 
 Status HBaseTableScanner::CreateByteArray(JNIEnv* env, const string& s,
@@ -508,25 +661,38 @@ Status HBaseTableScanner::Next(JNIEnv* env, bool* has_next) {
   {
     SCOPED_TIMER(scan_node_->read_timer());
     while (true) {
-      DCHECK(resultscanner_ != NULL);
-      // result_ = resultscanner_.next();
-      result = env->CallObjectMethod(resultscanner_, resultscanner_next_id_);
-      // Normally we would check for a JNI exception via RETURN_ERROR_IF_EXC, but we
-      // need to also check for scanner timeouts and handle them specially, which is
-      // done by HandleResultScannerTimeout(). If a timeout occurred, then it will
-      // re-create the ResultScanner so we can try again.
-      bool timeout;
-      RETURN_IF_ERROR(HandleResultScannerTimeout(env, &timeout));
-      if (timeout) {
+      if (get_results_ != NULL) {
+        // The current scan ranges are point lookups that were fetched in one batch.
+        if (get_result_idx_ < num_get_results_) {
+          result = env->GetObjectArrayElement(get_results_, get_result_idx_++);
+          RETURN_ERROR_IF_EXC(env);
+        } else {
+          RETURN_IF_ERROR(JniUtil::FreeGlobalRef(env, get_results_));
+          get_results_ = NULL;
+          result = NULL;
+        }
+      } else if (resultscanner_ != NULL) {
+        // result_ = resultscanner_.next();
         result = env->CallObjectMethod(resultscanner_, resultscanner_next_id_);
-        // There shouldn't be a timeout now, so we will just return any errors.
-        RETURN_ERROR_IF_EXC(env);
+        // Normally we would check for a JNI exception via RETURN_ERROR_IF_EXC, but we
+        // need to also check for scanner timeouts and handle them specially, which is
+        // done by HandleResultScannerTimeout(). If a timeout occurred, then it will
+        // re-create the ResultScanner so we can try again.
+        bool timeout;
+        RETURN_IF_ERROR(HandleResultScannerTimeout(env, &timeout));
+        if (timeout) {
+          result = env->CallObjectMethod(resultscanner_, resultscanner_next_id_);
+          // There shouldn't be a timeout now, so we will just return any errors.
+          RETURN_ERROR_IF_EXC(env);
+        }
+      } else {
+        // The last scan ranges were point lookups which are all returned.
+        result = NULL;
       }
       // jump to the next region when finished with the current region.
       if (result == NULL && current_scan_range_idx_ + 1 < scan_range_vector_->size()) {
         ++current_scan_range_idx_;
-        RETURN_IF_ERROR(InitScanRange(env,
-            (*scan_range_vector_)[current_scan_range_idx_]));
+        RETURN_IF_ERROR(InitCurrentScanRange(env));
         continue;
       }
 
@@ -566,6 +732,7 @@ Status HBaseTableScanner::Next(JNIEnv* env, bool* has_next) {
     all_cells_present_ = false;
   }
   cell_index_ = 0;
+  ++rows_read_;
 
   value_pool_->Clear();
   *has_next = true;
@@ -592,6 +759,7 @@ inline Status HBaseTableScanner::GetRowKey(JNIEnv* env, jobject cell,
   }
   env->GetByteArrayRegion(jdata, offset, *length, reinterpret_cast<jbyte*>(*data));
   COUNTER_ADD(scan_node_->bytes_read_counter(), *length);
+  row_bytes_read_ += *length;
   return Status::OK();
 }
 
@@ -643,6 +811,7 @@ inline Status HBaseTableScanner::GetValue(JNIEnv* env, jobject cell,
   }
   env->GetByteArrayRegion(jdata, offset, *length, reinterpret_cast<jbyte*>(*data));
   COUNTER_ADD(scan_node_->bytes_read_counter(), *length);
+  row_bytes_read_ += *length;
   return Status::OK();
 }
 
@@ -765,6 +934,8 @@ void HBaseTableScanner::Close(JNIEnv* env) {
     resultscanner_ = NULL;
   }
   if (scan_ != NULL) JniUtil::FreeGlobalRef(env, scan_);
+  if (filter_list_ != NULL) JniUtil::FreeGlobalRef(env, filter_list_);
+  if (get_results_ != NULL) JniUtil::FreeGlobalRef(env, get_results_);
   if (cells_ != NULL) JniUtil::FreeGlobalRef(env, cells_);
 
   // Close the HTable so that the connections are not kept around.
@@ -50,7 +50,16 @@ class HBaseScanNode;
 /// high value will put more memory pressure on the HBase region server and having a small
 /// value will cause extra round trips to the HBase region server. This value can
 /// be overridden by the query option hbase_caching. FE will also suggest a max value such
-/// that it won't put too much memory pressure on the region server.
+/// that it won't put too much memory pressure on the region server. Unless the query
+/// option is set, the value is also adjusted before each scan range is opened so that
+/// a batch holds about --hbase_scan_target_rpc_bytes, based on the average size of the
+/// rows read so far.
+//
+/// Scan ranges that cover a single row key (i.e. [key, key + '\0')), as produced for
+/// row key equality predicates, are not read with a ResultScanner. Consecutive ranges
+/// of this kind are fetched with one multi-get (Table.get(List<Get>)) that applies the
+/// same columns and filters as the scan, which saves opening and closing a scanner on
+/// the region server for every key.
 //
 /// HBase version compatibility: Starting from HBase 0.95.2 result rows are represented by
 /// Cells instead of KeyValues (prior HBase versions). To mitigate this API
@@ -142,6 +151,10 @@ class HBaseTableScanner {
  private:
   static const int DEFAULT_ROWS_CACHED = 1024;
 
+  /// Upper bound for the number of cached rows picked from the observed row size if the
+  /// FE did not suggest a max value.
+  static const int MAX_ROWS_CACHED = 16 * 1024;
+
   /// The enclosing HBaseScanNode.
   HBaseScanNode* scan_node_;
   RuntimeState* state_;
@@ -159,6 +172,8 @@ class HBaseTableScanner {
   static jclass compare_op_cl_;
   /// Exception thrown when a ResultScanner times out
   static jclass scanner_timeout_ex_cl_;
+  static jclass get_cl_;
+  static jclass list_cl_;
 
   static jmethodID scan_ctor_;
   static jmethodID scan_set_max_versions_id_;
@@ -187,6 +202,13 @@ class HBaseTableScanner {
   static jmethodID filter_list_ctor_;
   static jmethodID filter_list_add_filter_id_;
   static jmethodID single_column_value_filter_ctor_;
+  static jmethodID get_ctor_;
+  static jmethodID get_set_max_versions_id_;
+  static jmethodID get_set_cache_blocks_id_;
+  static jmethodID get_add_column_id_;
+  static jmethodID get_set_filter_id_;
+  static jmethodID list_ctor_;
+  static jmethodID list_add_id_;
 
   static jobject empty_row_;
   static jobject must_pass_all_op_;
@@ -206,6 +228,18 @@ class HBaseTableScanner {
   /// because they cannot be automatically garbage collected by the JVM.
   jobject scan_;           // Java type Scan
   jobject resultscanner_;  // Java type ResultScanner
+  jobject filter_list_;    // Java type FilterList, NULL if there are no filters
+
+  /// Families/qualifiers added to scan_, which are also added to the Gets of point
+  /// lookups. Set in ScanSetup().
+  std::vector<std::pair<std::string, std::string> > columns_;
+
+  /// Results of the current batch of point lookups, Java type Result[]. NULL if the
+  /// current scan range is read with resultscanner_. get_result_idx_ is the index of
+  /// the next result to return.
+  jobjectArray get_results_;
+  int num_get_results_;
+  int get_result_idx_;
 
   /// Helper members for retrieving results from a scan. Updated in Next() and
   /// used by GetRowKey() and GetValue(). Result of resultscanner_.next().raw()
@@ -238,11 +272,24 @@ class HBaseTableScanner {
   /// Set in the HBase call Scan.setCaching();
   int rows_cached_;
 
+  /// True if rows_cached_ is adjusted to the observed row size. False if the
+  /// hbase_caching query option is set.
+  bool autotune_caching_;
+
+  /// Upper bound for rows_cached_ when it is adjusted to the observed row size.
+  int max_rows_cached_;
+
+  /// Number of rows returned by Next() and the bytes of their row keys and values
+  /// that were read. Used to estimate the row size for adjusting rows_cached_.
+  int64_t rows_read_;
+  int64_t row_bytes_read_;
+
   /// True if the scanner should set Scan.setCacheBlocks to true.
   bool cache_blocks_;
 
   /// HBase specific counters
   RuntimeProfile::Counter* scan_setup_timer_;
+  RuntimeProfile::Counter* num_get_batches_counter_;
 
   /// Checks for and handles a ScannerTimeoutException which is thrown if the
   /// ResultScanner times out. If a timeout occurs, the ResultScanner is re-created
@@ -264,6 +311,23 @@ class HBaseTableScanner {
   Status ScanSetup(JNIEnv* env, const TupleDescriptor* tuple_desc,
                    const std::vector<THBaseFilter>& filters);
 
+  /// Starts reading the scan range at current_scan_range_idx_. If it is a point lookup
+  /// and batching is enabled, it and the point lookups directly following it are
+  /// fetched with one multi-get, and current_scan_range_idx_ is moved to the last of
+  /// them. Otherwise, a ResultScanner is opened for the range.
+  Status InitCurrentScanRange(JNIEnv* env);
+
+  /// Fetches the scan ranges [current_scan_range_idx_, end_idx), which must all be
+  /// point lookups, into get_results_.
+  Status FetchPointLookups(JNIEnv* env, int end_idx);
+
+  /// Returns true if 'scan_range' covers exactly one row key.
+  static bool IsPointLookup(const ScanRange& scan_range);
+
+  /// Sets rows_cached_ on scan_ from the average size of the rows read so far, if
+  /// autotune_caching_ is true.
+  Status UpdateCaching(JNIEnv* env);
+
   /// Initialize the scan to the given range
   Status InitScanRange(JNIEnv* env, const ScanRange& scan_range);
   /// Initialize the scan range to the scan range specified by the start and end byte
@@ -95,8 +95,9 @@ Status HBaseTableSink::Send(RuntimeState* state, RowBatch* batch, bool eos) {
 }
 
 Status HBaseTableSink::FlushFinal(RuntimeState* state) {
-  // No buffered state to flush.
-  return Status::OK();
+  SCOPED_TIMER(runtime_profile_->total_time_counter());
+  // Wait for the rows that HBase still buffers so that their errors fail the insert.
+  return hbase_table_writer_->Flush();
 }
 
 void HBaseTableSink::Close(RuntimeState* state) {
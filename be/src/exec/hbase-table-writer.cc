@@ -15,6 +15,7 @@
 #include "exec/hbase-table-writer.h"
 
 #include <boost/scoped_array.hpp>
+#include <limits>
 #include <sstream>
 
 #include "common/logging.h"
@@ -30,6 +31,11 @@
 
 #include "common/names.h"
 
+DEFINE_int64(hbase_write_buffer_size, 8 * 1024 * 1024, "(Advanced) The size, in bytes, "
+    "of the client-side write buffer of HBase table sinks. The rows are sent to HBase "
+    "in the background whenever the buffer is full, and the sink waits for them when it "
+    "is done. If <= 0, each row batch is sent synchronously.");
+
 namespace impala {
 
 jclass HBaseTableWriter::put_cl_ = NULL;
@@ -41,6 +47,10 @@ jmethodID HBaseTableWriter::list_add_id_ = NULL;
 
 jmethodID HBaseTableWriter::put_add_id_ = NULL;
 
+jclass HBaseTableWriter::key_value_cl_ = NULL;
+jmethodID HBaseTableWriter::key_value_ctor_ = NULL;
+jobject HBaseTableWriter::key_value_type_put_ = NULL;
+
 HBaseTableWriter::HBaseTableWriter(HBaseTableDescriptor* table_desc,
                                    const vector<ExprContext*>& output_expr_ctxs,
                                    RuntimeProfile* profile)
@@ -54,6 +64,9 @@ HBaseTableWriter::HBaseTableWriter(HBaseTableDescriptor* table_desc,
 Status HBaseTableWriter::Init(RuntimeState* state) {
   RETURN_IF_ERROR(state->htable_factory()->GetTable(table_desc_->name(),
       &table_));
+  if (FLAGS_hbase_write_buffer_size > 0) {
+    RETURN_IF_ERROR(table_->InitBufferedMutator(FLAGS_hbase_write_buffer_size));
+  }
   encoding_timer_ = ADD_TIMER(runtime_profile_, "EncodingTimer");
   htable_put_timer_ = ADD_TIMER(runtime_profile_, "HTablePutTimer");
 
@@ -96,10 +109,25 @@ Status HBaseTableWriter::InitJNI() {
       JniUtil::GetGlobalClassRef(
           env, "org/apache/hadoop/hbase/client/Put", &put_cl_));
   RETURN_ERROR_IF_EXC(env);
-  put_ctor_ = env->GetMethodID(put_cl_, "<init>", "([B)V");
+  put_ctor_ = env->GetMethodID(put_cl_, "<init>", "([BII)V");
   RETURN_ERROR_IF_EXC(env);
   put_add_id_ = env->GetMethodID(put_cl_, "add",
-    "([B[B[B)Lorg/apache/hadoop/hbase/client/Put;");
+    "(Lorg/apache/hadoop/hbase/Cell;)Lorg/apache/hadoop/hbase/client/Put;");
+  RETURN_ERROR_IF_EXC(env);
+  RETURN_IF_ERROR(JniUtil::GetGlobalClassRef(
+      env, "org/apache/hadoop/hbase/KeyValue", &key_value_cl_));
+  key_value_ctor_ = env->GetMethodID(key_value_cl_, "<init>",
+      "([BII[BII[BIIJLorg/apache/hadoop/hbase/KeyValue$Type;[BII)V");
+  RETURN_ERROR_IF_EXC(env);
+  jclass key_value_type_cl = env->FindClass("org/apache/hadoop/hbase/KeyValue$Type");
+  RETURN_ERROR_IF_EXC(env);
+  jfieldID type_put_id = env->GetStaticFieldID(key_value_type_cl, "Put",
+      "Lorg/apache/hadoop/hbase/KeyValue$Type;");
+  RETURN_ERROR_IF_EXC(env);
+  jobject type_put = env->GetStaticObjectField(key_value_type_cl, type_put_id);
+  RETURN_ERROR_IF_EXC(env);
+  RETURN_IF_ERROR(JniUtil::LocalToGlobalRef(env, type_put, &key_value_type_put_));
+  env->DeleteLocalRef(key_value_type_cl);
   RETURN_ERROR_IF_EXC(env);
   RETURN_IF_ERROR(
       JniUtil::GetGlobalClassRef(env, "java/util/ArrayList", &list_cl_));
@@ -117,73 +145,23 @@ Status HBaseTableWriter::AppendRowBatch(RowBatch* batch) {
 
   int limit = batch->num_rows();
   if (limit == 0) return Status::OK();
-  int num_cols = table_desc_->num_cols();
-  DCHECK_GE(num_cols, 2);
+  DCHECK_GE(table_desc_->num_cols(), 2);
 
   // Create the array list.
   RETURN_IF_ERROR(CreatePutList(env, limit));
 
-  // For every TupleRow in the row batch create a put, assign the row key,
-  // and add all of the values generated from the expressions.
-  string string_value; // text encoded value
-  char binary_value[8]; // binary encoded value; at most 8 bytes
-  const void* data; // pointer to the column value in bytes
-  int data_len; // length of the column value in bytes
+  // Encode the row keys and values of all rows first, so that they are copied into the
+  // JVM with a single byte array. The Puts and their cells reference slices of it.
   {
     SCOPED_TIMER(encoding_timer_);
-    for (int idx_batch = 0; idx_batch < limit; idx_batch++) {
-      TupleRow* current_row = batch->GetRow(idx_batch);
-      jobject put = NULL;
-
-      if (output_expr_ctxs_[0]->GetValue(current_row) == NULL) {
-        // HBase row key must not be null.
-        return Status("Cannot insert into HBase with a null row key.");
-      }
-
-      for (int j = 0; j < num_cols; j++) {
-        const HBaseTableDescriptor::HBaseColumnDescriptor& col = table_desc_->cols()[j];
-        void* value = output_expr_ctxs_[j]->GetValue(current_row);
-
-        if (value != NULL) {
-          if (!col.binary_encoded) {
-            // Text encoded
-            string_value.clear();
-            output_expr_ctxs_[j]->PrintValue(value, &string_value);
-            data = string_value.data();
-            data_len = string_value.length();
-          } else {
-            // Binary encoded
-            // Only bool, tinyint, smallint, int, bigint, float and double can be binary
-            // encoded. Convert the value to big-endian.
-            data = binary_value;
-            data_len = output_exprs_byte_sizes_[j];
-            DCHECK(data_len == 1 || data_len == 2 || data_len == 4 || data_len == 8)
-              << data_len;
-            BitUtil::ByteSwap(binary_value, value, data_len);
-          }
-
-          if (j == 0) {
-            DCHECK(put == NULL);
-            RETURN_IF_ERROR(CreatePut(env, data, data_len, &put));
-          } else {
-            DCHECK(put != NULL) << "Put shouldn't be NULL for non-key cols.";
-            jbyteArray val_array;
-            RETURN_IF_ERROR(CreateByteArray(env, data, data_len, &val_array));
-            env->CallObjectMethod(put, put_add_id_, cf_arrays_[j-1], qual_arrays_[j-1],
-                val_array);
-            RETURN_ERROR_IF_EXC(env);
-
-            // Clean up the local references.
-            env->DeleteLocalRef(val_array);
-            RETURN_ERROR_IF_EXC(env);
-          }
-        }
-      }
-
-      DCHECK(put != NULL);
-      env->DeleteLocalRef(put);
-      RETURN_ERROR_IF_EXC(env);
-    }
+    RETURN_IF_ERROR(EncodeRowBatch(batch));
+    jbyteArray cells_array;
+    RETURN_IF_ERROR(CreateByteArray(env, cell_buffer_.data(), cell_buffer_.size(),
+        &cells_array));
+    Status status = CreatePuts(env, limit, cells_array);
+    env->DeleteLocalRef(cells_array);
+    RETURN_ERROR_IF_EXC(env);
+    RETURN_IF_ERROR(status);
   }
 
   // Send the array list to HTable.
@@ -197,6 +175,94 @@ Status HBaseTableWriter::AppendRowBatch(RowBatch* batch) {
   return Status::OK();
 }
 
+Status HBaseTableWriter::Flush() {
+  SCOPED_TIMER(htable_put_timer_);
+  return table_->Flush();
+}
+
+Status HBaseTableWriter::EncodeRowBatch(RowBatch* batch) {
+  int num_cols = table_desc_->num_cols();
+  cell_buffer_.clear();
+  cells_.clear();
+  string string_value; // text encoded value
+  char binary_value[8]; // binary encoded value; at most 8 bytes
+  const void* data; // pointer to the column value in bytes
+  int data_len; // length of the column value in bytes
+  for (int idx_batch = 0; idx_batch < batch->num_rows(); idx_batch++) {
+    TupleRow* current_row = batch->GetRow(idx_batch);
+
+    if (output_expr_ctxs_[0]->GetValue(current_row) == NULL) {
+      // HBase row key must not be null.
+      return Status("Cannot insert into HBase with a null row key.");
+    }
+
+    for (int j = 0; j < num_cols; j++) {
+      const HBaseTableDescriptor::HBaseColumnDescriptor& col = table_desc_->cols()[j];
+      void* value = output_expr_ctxs_[j]->GetValue(current_row);
+
+      if (value == NULL) {
+        cells_.push_back(make_pair(0, -1));
+        continue;
+      }
+      if (!col.binary_encoded) {
+        // Text encoded
+        string_value.clear();
+        output_expr_ctxs_[j]->PrintValue(value, &string_value);
+        data = string_value.data();
+        data_len = string_value.length();
+      } else {
+        // Binary encoded
+        // Only bool, tinyint, smallint, int, bigint, float and double can be binary
+        // encoded. Convert the value to big-endian.
+        data = binary_value;
+        data_len = output_exprs_byte_sizes_[j];
+        DCHECK(data_len == 1 || data_len == 2 || data_len == 4 || data_len == 8)
+          << data_len;
+        BitUtil::ByteSwap(binary_value, value, data_len);
+      }
+      cells_.push_back(make_pair(static_cast<int>(cell_buffer_.size()), data_len));
+      const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+      cell_buffer_.insert(cell_buffer_.end(), bytes, bytes + data_len);
+    }
+  }
+  return Status::OK();
+}
+
+Status HBaseTableWriter::CreatePuts(JNIEnv* env, int num_rows, jbyteArray cells_array) {
+  int num_cols = table_desc_->num_cols();
+  for (int row = 0; row < num_rows; ++row) {
+    const pair<int, int>* row_cells = &cells_[row * num_cols];
+    const pair<int, int>& row_key = row_cells[0];
+    DCHECK_GE(row_key.second, 0);
+    jobject put;
+    RETURN_IF_ERROR(CreatePut(env, cells_array, row_key.first, row_key.second, &put));
+
+    for (int j = 1; j < num_cols; ++j) {
+      if (row_cells[j].second < 0) continue;
+      const HBaseTableDescriptor::HBaseColumnDescriptor& col = table_desc_->cols()[j];
+      // The timestamp is filled in by the region server, like for Put#add(byte[],
+      // byte[], byte[]).
+      jobject cell = env->NewObject(key_value_cl_, key_value_ctor_,
+          cells_array, row_key.first, row_key.second,
+          cf_arrays_[j-1], 0, static_cast<jint>(col.family.size()),
+          qual_arrays_[j-1], 0, static_cast<jint>(col.qualifier.size()),
+          static_cast<jlong>(std::numeric_limits<int64_t>::max()), key_value_type_put_,
+          cells_array, row_cells[j].first, row_cells[j].second);
+      RETURN_ERROR_IF_EXC(env);
+      env->CallObjectMethod(put, put_add_id_, cell);
+      RETURN_ERROR_IF_EXC(env);
+
+      // Clean up the local references.
+      env->DeleteLocalRef(cell);
+      RETURN_ERROR_IF_EXC(env);
+    }
+
+    env->DeleteLocalRef(put);
+    RETURN_ERROR_IF_EXC(env);
+  }
+  return Status::OK();
+}
+
 Status HBaseTableWriter::CleanUpJni() {
   JNIEnv* env = getJNIEnv();
   if (env == NULL) return Status("Error getting JNIEnv.");
@@ -226,22 +292,15 @@ Status HBaseTableWriter::CreatePutList(JNIEnv* env, int num_puts) {
   return Status::OK();
 }
 
-Status HBaseTableWriter::CreatePut(JNIEnv* env, const void* rk, int rk_len,
-                                   jobject* put) {
-  // Create the row key byte array.
-  jbyteArray rk_array;
-  RETURN_IF_ERROR(CreateByteArray(env, rk, rk_len, &rk_array));
-
-  (*put) = env->NewObject(put_cl_, put_ctor_, rk_array);
+Status HBaseTableWriter::CreatePut(JNIEnv* env, jbyteArray cells_array, int rk_offset,
+    int rk_len, jobject* put) {
+  (*put) = env->NewObject(put_cl_, put_ctor_, cells_array, rk_offset, rk_len);
   RETURN_ERROR_IF_EXC(env);
 
   // Add the put to the list.
   env->CallObjectMethod(put_list_, list_add_id_, *put);
   RETURN_ERROR_IF_EXC(env);
 
-  env->DeleteLocalRef(rk_array);
-  RETURN_ERROR_IF_EXC(env);
-
   return Status::OK();
 }
 
@@ -39,6 +39,11 @@ class RowBatch;
 ///    writer = new HBaseTableWriter(state, table_desc_, output_exprs_);
 ///    writer.Init(state);
 ///    writer.AppendRowBatch(batch);
+///    writer.Flush();
+/// The row keys and values of a batch are encoded into one buffer that is copied into
+/// the JVM as a single byte array, and the Puts and their KeyValues are created from
+/// slices of it. With --hbase_write_buffer_size > 0, the Puts are buffered and sent by
+/// an HBase BufferedMutator in the background.
 class HBaseTableWriter {
  public:
   HBaseTableWriter(HBaseTableDescriptor* table_desc,
@@ -46,6 +51,9 @@ class HBaseTableWriter {
                    RuntimeProfile* profile);
   Status AppendRowBatch(RowBatch* batch);
 
+  /// Waits until all appended rows are sent to HBase.
+  Status Flush();
+
   /// Calls to Close release the HBaseTable.
   void Close(RuntimeState* state);
 
@@ -57,9 +65,19 @@ class HBaseTableWriter {
   static Status InitJNI();
 
  private:
+  /// Evaluates the output exprs for all rows of 'batch' and appends the encoded row keys
+  /// and values to cell_buffer_, with their positions in cells_.
+  Status EncodeRowBatch(RowBatch* batch);
+
   /// Methods used to create JNI objects.
-  /// Create a Put using the supplied row key
-  Status CreatePut(JNIEnv* env, const void* rk, int rk_len, jobject* put);
+  /// Creates the Puts for the first 'num_rows' rows of cells_ and adds them to
+  /// put_list_. 'cells_array' holds the contents of cell_buffer_.
+  Status CreatePuts(JNIEnv* env, int num_rows, jbyteArray cells_array);
+
+  /// Create a Put using the row key in the supplied slice of 'cells_array', and add it
+  /// to put_list_.
+  Status CreatePut(JNIEnv* env, jbyteArray cells_array, int rk_offset, int rk_len,
+      jobject* put);
 
   /// Create a byte array containing the string's chars.
   Status CreateByteArray(JNIEnv* env, const std::string& s,
@@ -95,15 +113,32 @@ class HBaseTableWriter {
   /// jni ArrayList<Put>
   jobject put_list_;
 
+  /// The encoded row keys and values of the current batch.
+  std::vector<uint8_t> cell_buffer_;
+
+  /// Offset in cell_buffer_ and length of the value of each column of each row of the
+  /// current batch, in row-major order. The length is -1 for NULL values.
+  std::vector<std::pair<int, int> > cells_;
+
   /// org.apache.hadoop.hbase.client.Put
   static jclass put_cl_;
 
-  /// new Put(byte[])
+  /// new Put(byte[], int, int)
   static jmethodID put_ctor_;
 
-  /// Put#add(byte[], byte[], byte[])
+  /// Put#add(Cell)
   static jmethodID put_add_id_;
 
+  /// org.apache.hadoop.hbase.KeyValue
+  static jclass key_value_cl_;
+
+  /// new KeyValue(byte[], int, int, byte[], int, int, byte[], int, int, long,
+  /// KeyValue.Type, byte[], int, int)
+  static jmethodID key_value_ctor_;
+
+  /// KeyValue.Type.Put
+  static jobject key_value_type_put_;
+
   /// java.util.ArrayList
   static jclass list_cl_;
 
@@ -165,10 +165,10 @@ Status HdfsAvroScanner::ParseMetadata() {
         RETURN_IF_ERROR(ResolveSchemas(scan_node_->avro_schema(), file_schema));
 
         // We currently codegen a function only for the table schema. If this file's
-        // schema is different from the table schema, don't use the codegen'd function and
-        // use the interpreted path instead.
-        avro_header_->use_codegend_decode_avro_data = avro_schema_equal(
-            scan_node_->avro_schema().schema, file_schema->schema);
+        // schema is not decoded like the table schema, don't use the codegen'd function
+        // and use the interpreted path instead.
+        avro_header_->use_codegend_decode_avro_data = CodegenSchemaMatches(
+            SchemaPath(), scan_node_->avro_schema(), *file_schema);
 
       } else if (key == AVRO_CODEC_KEY) {
         string avro_codec(reinterpret_cast<char*>(value), value_len);
@@ -277,6 +277,31 @@ Status HdfsAvroScanner::ResolveSchemas(const AvroSchemaElement& table_root,
   return Status::OK();
 }
 
+bool HdfsAvroScanner::CodegenSchemaMatches(const SchemaPath& path,
+    const AvroSchemaElement& table_record, const AvroSchemaElement& file_record) {
+  DCHECK_EQ(table_record.schema->type, AVRO_RECORD);
+  if (file_record.schema->type != AVRO_RECORD) return false;
+  if (table_record.children.size() != file_record.children.size()) return false;
+  for (int i = 0; i < table_record.children.size(); ++i) {
+    const AvroSchemaElement& table_field = table_record.children[i];
+    const AvroSchemaElement& file_field = file_record.children[i];
+    if (table_field.schema->type != file_field.schema->type) return false;
+    if (table_field.null_union_position != file_field.null_union_position) return false;
+    // Same as the path computed by CodegenReadRecord().
+    SchemaPath field_path = path;
+    field_path.push_back(path.empty() ? i + scan_node_->num_partition_keys() : i);
+    if (table_field.schema->type == AVRO_RECORD) {
+      if (!CodegenSchemaMatches(field_path, table_field, file_field)) return false;
+      continue;
+    }
+    int slot_idx = scan_node_->GetMaterializedSlotIdx(field_path);
+    const SlotDescriptor* slot_desc = slot_idx == HdfsScanNode::SKIP_COLUMN ?
+        NULL : scan_node_->materialized_slots()[slot_idx];
+    if (file_field.slot_desc != slot_desc) return false;
+  }
+  return true;
+}
+
 Status HdfsAvroScanner::WriteDefaultValue(
     SlotDescriptor* slot_desc, avro_datum_t default_value, const char* field_name) {
   if (avro_header_->template_tuple == NULL) {
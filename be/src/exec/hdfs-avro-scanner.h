@@ -108,6 +108,7 @@ class HdfsAvroScanner : public BaseSequenceScanner {
 
  private:
   friend class HdfsAvroScannerTest;
+  friend class ScannerBenchmark;
 
   struct AvroFileHeader : public BaseSequenceScanner::FileHeader {
     /// The root of the file schema tree (i.e. the top-level record schema of the file)
@@ -120,7 +121,8 @@ class HdfsAvroScanner : public BaseSequenceScanner {
     Tuple* template_tuple;
 
     /// True if this file can use the codegen'd version of DecodeAvroData() (i.e. its
-    /// schema matches the table schema), false otherwise.
+    /// schema is decoded like the table schema, see CodegenSchemaMatches()), false
+    /// otherwise.
     bool use_codegend_decode_avro_data;
   };
 
@@ -151,6 +153,14 @@ class HdfsAvroScanner : public BaseSequenceScanner {
   Status ResolveSchemas(const AvroSchemaElement& table_root,
                         AvroSchemaElement* file_root);
 
+  /// Returns true if the codegen'd MaterializeTuple(), which follows the table schema,
+  /// can decode data written with the resolved file schema: 'file_record' must have the
+  /// same field types and nullability as 'table_record' in the same order, and each
+  /// field must populate the same slot as the table field at its position. Names,
+  /// docs and defaults may differ. 'path' is the path of 'table_record'.
+  bool CodegenSchemaMatches(const SchemaPath& path,
+      const AvroSchemaElement& table_record, const AvroSchemaElement& file_record);
+
   // Returns Status::OK iff table_schema (the reader schema) can be resolved against
   // file_schema (the writer schema). field_name is used for error messages.
   Status VerifyTypesMatch(const AvroSchemaElement& table_schema,
@@ -14,19 +14,27 @@
 
 #include "exec/hdfs-parquet-scanner.h"
 
+#include <cmath>
 #include <limits> // for std::numeric_limits
+#include <map>
 #include <queue>
+#include <set>
 
 #include <boost/algorithm/string.hpp>
 #include <gflags/gflags.h>
 #include <gutil/strings/substitute.h>
 
+#include "common/atomic.h"
 #include "common/object-pool.h"
 #include "common/logging.h"
 #include "exec/hdfs-scan-node.h"
+#include "exec/parquet-bloom-filter.h"
 #include "exec/scanner-context.inline.h"
+#include "exec/topn-filter.h"
 #include "exec/read-write-util.h"
 #include "exprs/expr.h"
+#include "exprs/expr-context.h"
+#include "exprs/slot-ref.h"
 #include "gutil/bits.h"
 #include "runtime/collection-value-builder.h"
 #include "runtime/descriptors.h"
@@ -39,12 +47,17 @@
 #include "runtime/string-value.h"
 #include "util/bitmap.h"
 #include "util/bit-util.h"
+#include "util/bloom-filter.h"
+#include "util/counting-barrier.h"
 #include "util/decompress.h"
 #include "util/debug-util.h"
 #include "util/error-util.h"
+#include "util/hash-util.h"
 #include "util/dict-encoding.h"
+#include "util/impalad-metrics.h"
 #include "util/rle-encoding.h"
 #include "util/runtime-profile-counters.h"
+#include "util/thread-pool.h"
 #include "rpc/thrift-util.h"
 
 #include "common/names.h"
@@ -63,6 +76,42 @@ DEFINE_bool(convert_legacy_hive_parquet_utc_timestamps, false,
 DEFINE_double(parquet_min_filter_reject_ratio, 0.1, "(Advanced) If the percentage of "
     "rows rejected by a runtime filter drops below this value, the filter is disabled.");
 
+DEFINE_double(parquet_row_sample_percent, 100, "(Advanced) If less than 100, the "
+    "Parquet scanner keeps each row of a row group with this probability. The sample is "
+    "repeatable for the same --hdfs_scan_sample_seed.");
+DECLARE_int64(hdfs_scan_sample_seed);
+DEFINE_bool(parquet_skip_row_groups_using_stats, true, "(Advanced) When true, row groups "
+    "whose column min/max statistics show that no row can pass a conjunct are skipped "
+    "without reading any of their column data.");
+
+DEFINE_bool(parquet_skip_pages_using_stats, true, "(Advanced) When true, data pages "
+    "whose min/max statistics show that no row can pass a conjunct are skipped without "
+    "decompressing or decoding them.");
+
+DEFINE_bool(parquet_bloom_filtering, true, "(Advanced) When true, row groups are skipped "
+    "if the bloom filters that the writer stored for their column chunks show that no "
+    "row can pass an equality or IN conjunct or a runtime filter.");
+
+DEFINE_bool(parquet_dictionary_filtering, true, "(Advanced) When true, conjuncts that "
+    "only reference a single dictionary encoded column are evaluated once per dictionary "
+    "entry. Row groups without any passing entry are skipped and rows with non-passing "
+    "entries are rejected without evaluating the conjuncts.");
+
+DEFINE_bool(parquet_late_materialization, true, "(Advanced) When true, the columns "
+    "referenced by conjuncts are materialized first and the other columns are only "
+    "materialized for the rows that pass these conjuncts.");
+
+DEFINE_int64(parquet_footer_cache_capacity, 64L * 1024L * 1024L, "(Advanced) Maximum "
+    "number of bytes of deserialized Parquet file metadata that are cached across "
+    "queries. Setting this to 0 disables the cache.");
+
+DEFINE_int64(parquet_min_column_read_size, 1024L * 1024L, "(Advanced) The column "
+    "chunks of a row group are read concurrently, so each of them is read with an equal "
+    "share of the IoMgr read size, but with at least this many bytes per read. "
+    "Setting this to 0 reads every column chunk with the full read size.");
+
+DECLARE_int32(num_column_decode_threads);
+
 const int64_t HdfsParquetScanner::FOOTER_SIZE = 100 * 1024;
 const int16_t HdfsParquetScanner::ROW_GROUP_END = numeric_limits<int16_t>::min();
 const int16_t HdfsParquetScanner::INVALID_LEVEL = -1;
@@ -108,8 +157,15 @@ Status HdfsParquetScanner::IssueInitialRanges(HdfsScanNode* scan_node,
       return Status(Substitute("Parquet file $0 has an invalid file length: $1",
           files[i]->filename, files[i]->file_length));
     }
-    // Compute the offset of the file footer.
+    // Compute the offset of the file footer. If the file metadata is cached, we only
+    // need the metadata length and the magic number at the end of the file.
     int64_t footer_size = min(FOOTER_SIZE, files[i]->file_length);
+    FooterCache* cache = footer_cache();
+    boost::shared_ptr<const FileMetadataEntry> cached_entry;
+    if (cache != NULL && cache->Get(FooterCacheKey(files[i]->filename, files[i]->mtime,
+        files[i]->file_length), &cached_entry)) {
+      footer_size = sizeof(int32_t) + sizeof(PARQUET_VERSION_NUMBER);
+    }
     int64_t footer_start = files[i]->file_length - footer_size;
 
     // Try to find the split with the footer.
@@ -157,6 +213,27 @@ Status HdfsParquetScanner::IssueInitialRanges(HdfsScanNode* scan_node,
   return Status::OK();
 }
 
+HdfsParquetScanner::FooterCache* HdfsParquetScanner::footer_cache() {
+  if (FLAGS_parquet_footer_cache_capacity <= 0) return NULL;
+  static FooterCache cache(FLAGS_parquet_footer_cache_capacity);
+  return &cache;
+}
+
+int64_t HdfsParquetScanner::EstimateFootprint(const FileMetadataEntry& entry,
+    int serialized_size) {
+  // The serialized size accounts for the strings and variable-length lists. Add the
+  // in-memory size of the Thrift structs that dominate wide files.
+  const parquet::FileMetaData& file_metadata = entry.file_metadata;
+  int64_t footprint = sizeof(FileMetadataEntry) + serialized_size;
+  footprint += file_metadata.schema.size() *
+      (sizeof(parquet::SchemaElement) + sizeof(SchemaNode));
+  for (int i = 0; i < file_metadata.row_groups.size(); ++i) {
+    footprint += sizeof(parquet::RowGroup) +
+        file_metadata.row_groups[i].columns.size() * sizeof(parquet::ColumnChunk);
+  }
+  return footprint;
+}
+
 DiskIoMgr::ScanRange* HdfsParquetScanner::FindFooterSplit(HdfsFileDesc* file) {
   DCHECK(file != NULL);
   for (int i = 0; i < file->splits.size(); ++i) {
@@ -185,13 +262,34 @@ struct ScratchTupleBatch {
   // ResizeAndAllocateTupleBuffer().
   RowBatch batch;
 
+  // One entry per tuple, set to a non-zero value if the tuple is known to not pass the
+  // conjuncts, either because its value was rejected by a dictionary filter, because
+  // it failed the conjuncts evaluated during late materialization or because it was
+  // rejected by a runtime filter. Only valid if 'has_rejected_tuples' is true.
+  vector<uint8_t> rejected_tuples;
+  bool has_rejected_tuples;
+
+  // Scratch space of EvalRuntimeFilters(), with one entry per tuple.
+  vector<int> filter_tuple_idxs;
+  vector<Tuple*> filter_tuples;
+  vector<uint32_t> filter_hashes;
+  vector<uint8_t> filter_found;
+  vector<uint8_t> filter_passes;
+
   ScratchTupleBatch(
       const RowDescriptor& row_desc, int batch_size, MemTracker* mem_tracker)
     : tuple_mem(NULL),
       tuple_idx(0),
       num_tuples(0),
       tuple_byte_size(row_desc.GetRowSize()),
-      batch(row_desc, batch_size, mem_tracker) {
+      batch(row_desc, batch_size, mem_tracker),
+      rejected_tuples(batch_size),
+      has_rejected_tuples(false),
+      filter_tuple_idxs(batch_size),
+      filter_tuples(batch_size),
+      filter_hashes(batch_size),
+      filter_found(batch_size),
+      filter_passes(batch_size) {
     DCHECK_EQ(row_desc.tuple_descriptors().size(), 1);
   }
 
@@ -222,9 +320,15 @@ HdfsParquetScanner::HdfsParquetScanner(HdfsScanNode* scan_node, RuntimeState* st
     : HdfsScanner(scan_node, state),
       scratch_batch_(new ScratchTupleBatch(
           scan_node->row_desc(), state_->batch_size(), scan_node->mem_tracker())),
+      file_metadata_(NULL),
       metadata_range_(NULL),
       dictionary_pool_(new MemPool(scan_node->mem_tracker())),
-      assemble_rows_timer_(scan_node_->materialize_tuple_timer()) {
+      assemble_rows_timer_(scan_node_->materialize_tuple_timer()),
+      dict_filter_tuple_(NULL),
+      num_filter_readers_(0),
+      has_page_filters_(false),
+      row_sample_threshold_(0),
+      sample_rng_state_(0) {
   assemble_rows_timer_.Stop();
 }
 
@@ -265,9 +369,6 @@ class HdfsParquetScanner::LevelDecoder : public RleDecoder {
       MemPool* cache_pool, int cache_size, int max_level, int num_buffered_values,
       uint8_t** data, int* data_size);
 
-  /// Returns the next level or INVALID_LEVEL if there was an error.
-  inline int16_t ReadLevel();
-
   /// Decodes and caches the next batch of levels. Resets members associated with the
   /// cache. Returns a non-ok status if there was a problem decoding a level, or if a
   /// level was encountered with a value greater than max_level_.
@@ -287,6 +388,15 @@ class HdfsParquetScanner::LevelDecoder : public RleDecoder {
   inline int CacheRemaining() const { return num_cached_levels_ - cached_level_idx_; }
   inline int CacheCurrIdx() const { return cached_level_idx_; }
 
+  /// Returns the number of consecutive cached levels, starting at the current one and
+  /// up to 'max_levels', that are equal to 'level'.
+  inline int CacheRunLength(uint8_t level, int max_levels) const {
+    int end = min(num_cached_levels_, cached_level_idx_ + max_levels);
+    int idx = cached_level_idx_;
+    while (idx < end && cached_levels_[idx] == level) ++idx;
+    return idx - cached_level_idx_;
+  }
+
  private:
   /// Initializes members associated with the level cache. Allocates memory for
   /// the cache from pool, if necessary.
@@ -297,6 +407,10 @@ class HdfsParquetScanner::LevelDecoder : public RleDecoder {
   /// an error decoding a level or if there was a level value greater than max_level_.
   bool FillCache(int batch_size, int* num_cached_levels);
 
+  /// Returns false if any of the 'num_levels' cached levels starting at 'start_idx' is
+  /// greater than max_level_.
+  bool ValidateLevels(int start_idx, int num_levels) const;
+
   /// Buffer for a batch of levels. The memory is allocated and owned by a pool in
   /// passed in Init().
   uint8_t* cached_levels_;
@@ -553,7 +667,15 @@ class HdfsParquetScanner::BaseScalarColumnReader :
       num_values_read_(0),
       metadata_(NULL),
       stream_(NULL),
-      decompressed_data_pool_(new MemPool(parent->scan_node_->mem_tracker())) {
+      decompressed_data_pool_(new MemPool(parent->scan_node_->mem_tracker())),
+      has_dict_filter_(false),
+      skip_rejected_tuples_(false),
+      rejected_tuples_(NULL),
+      dict_filter_(0),
+      dict_filter_rejects_nulls_(false),
+      parse_status_(&parent->parse_status_),
+      decoding_in_parallel_(false),
+      skipping_page_(false) {
     DCHECK_GE(node_.col_idx, 0) << node_.DebugString();
 
   }
@@ -575,6 +697,8 @@ class HdfsParquetScanner::BaseScalarColumnReader :
     // See ColumnReader constructor.
     rep_level_ = max_rep_level() == 0 ? 0 : -1;
     pos_current_value_ = -1;
+    has_dict_filter_ = false;
+    skipping_page_ = false;
 
     if (metadata_->codec != parquet::CompressionCodec::UNCOMPRESSED) {
       RETURN_IF_ERROR(Codec::CreateDecompressor(
@@ -587,6 +711,7 @@ class HdfsParquetScanner::BaseScalarColumnReader :
   /// Called once when the scanner is complete for final cleanup.
   void Close() {
     if (decompressor_.get() != NULL) decompressor_->Close();
+    if (parallel_decode_pool_.get() != NULL) parallel_decode_pool_->FreeAll();
   }
 
   int64_t total_len() const { return metadata_->total_compressed_size; }
@@ -601,6 +726,106 @@ class HdfsParquetScanner::BaseScalarColumnReader :
   /// next data page if necessary.
   virtual bool NextLevels() { return NextLevels<true>(); }
 
+  /// Reads the dictionary page of the current column chunk if the chunk starts with one,
+  /// without reading any data pages. Must be called after Reset() and before any values
+  /// are read. Does nothing if there is no dictionary page.
+  Status InitDictionary();
+
+  /// Returns the dictionary decoder of the current column chunk, or NULL if the column
+  /// chunk has no dictionary or it has not been read yet.
+  virtual DictDecoderBase* GetDictionaryDecoder() = 0;
+
+  /// Sets the dictionary filter for the current column chunk. 'passing_entries' has one
+  /// bit per dictionary entry that is set if rows with that value may pass the conjuncts.
+  /// 'rejects_nulls' is true if rows with a NULL value cannot pass the conjuncts. While
+  /// materializing top-level tuples, the reader sets the entry in 'rejected_tuples' of
+  /// every tuple whose value is rejected by the filter. 'rejected_tuples' is indexed by
+  /// the position of the tuple relative to the 'tuple_mem' passed to
+  /// ReadNonRepeatedValueBatch() and must have room for a full batch. The filter is
+  /// cleared in Reset().
+  void SetDictFilter(const Bitmap& passing_entries, bool rejects_nulls,
+      uint8_t* rejected_tuples) {
+    DCHECK(GetDictionaryDecoder() != NULL);
+    DCHECK_EQ(passing_entries.num_bits(), GetDictionaryDecoder()->num_entries());
+    DCHECK(!skip_rejected_tuples_);
+    dict_filter_ = passing_entries;
+    dict_filter_rejects_nulls_ = rejects_nulls;
+    rejected_tuples_ = rejected_tuples;
+    has_dict_filter_ = true;
+  }
+
+  /// Makes the reader skip over the values of the top-level tuples whose entry in
+  /// 'rejected_tuples' is set instead of materializing them. 'rejected_tuples' is indexed
+  /// like in SetDictFilter(). Used for late materialization, where the entries are set
+  /// before this reader materializes its values. Stays in effect for all row groups.
+  void SetSkipRejectedTuples(uint8_t* rejected_tuples) {
+    DCHECK(!has_dict_filter_);
+    DCHECK(page_filter_conjuncts_.empty());
+    rejected_tuples_ = rejected_tuples;
+    skip_rejected_tuples_ = true;
+  }
+
+  /// Sets the conjuncts that are evaluated against the statistics of each data page.
+  /// Pages whose values cannot pass all 'conjuncts' are skipped without decompressing
+  /// or decoding them. Instead of materializing the values of a skipped page, the reader
+  /// sets the entries of their tuples in 'rejected_tuples', which is indexed like in
+  /// SetDictFilter(). Stays in effect for all row groups.
+  void SetPageFilter(const std::vector<const StatsConjunct*>& conjuncts,
+      uint8_t* rejected_tuples) {
+    DCHECK(!skip_rejected_tuples_);
+    DCHECK_EQ(max_rep_level(), 0);
+    DCHECK(!conjuncts.empty());
+    page_filter_conjuncts_ = conjuncts;
+    rejected_tuples_ = rejected_tuples;
+  }
+
+  bool has_page_filter() const { return !page_filter_conjuncts_.empty(); }
+
+  /// Returns true if this reader can decode its top-level values on a thread other than
+  /// the scanner thread with BeginParallelDecoding().
+  virtual bool SupportsParallelDecoding() const { return false; }
+
+  /// Prepares the reader to decode a batch of at most 'max_values' top-level values
+  /// concurrently with other readers of the same scanner (see
+  /// HdfsParquetScanner::DecodeColumnsInParallel()). Until EndParallelDecoding() is
+  /// called, the reader reports errors into its own status, hands its data page buffers
+  /// to parallel_decode_pool() instead of the scratch batch pool and records NULL values
+  /// in 'staged_nulls_' instead of setting the null indicators of the tuples, since those
+  /// may be shared with other slots. The values must be read with
+  /// ReadNonRepeatedValueBatch() from parallel_decode_pool().
+  void BeginParallelDecoding(int max_values) {
+    DCHECK(SupportsParallelDecoding());
+    DCHECK(!has_dict_filter_);
+    DCHECK_EQ(max_rep_level(), 0);
+    if (parallel_decode_pool_.get() == NULL) {
+      parallel_decode_pool_.reset(new MemPool(parent_->scan_node_->mem_tracker()));
+    }
+    parallel_decode_status_ = Status::OK();
+    parse_status_ = &parallel_decode_status_;
+    staged_nulls_.assign(max_values, 0);
+    decoding_in_parallel_ = true;
+  }
+
+  /// Ends parallel decoding on the scanner thread. Sets the null indicators of the
+  /// first 'num_values' tuples in 'tuple_mem' that got a NULL value and transfers the
+  /// memory of parallel_decode_pool() to the scratch batch. Returns the status of the
+  /// decoding.
+  Status EndParallelDecoding(int tuple_size, uint8_t* tuple_mem, int num_values) {
+    DCHECK(decoding_in_parallel_);
+    DCHECK_LE(num_values, staged_nulls_.size());
+    for (int i = 0; i < num_values; ++i) {
+      if (!staged_nulls_[i]) continue;
+      reinterpret_cast<Tuple*>(tuple_mem + i * tuple_size)->SetNull(
+          null_indicator_offset_);
+    }
+    parent_->scratch_batch_->mem_pool()->AcquireData(parallel_decode_pool_.get(), false);
+    decoding_in_parallel_ = false;
+    parse_status_ = &parent_->parse_status_;
+    return parallel_decode_status_;
+  }
+
+  MemPool* parallel_decode_pool() const { return parallel_decode_pool_.get(); }
+
   // TODO: Some encodings might benefit a lot from a SkipValues(int num_rows) if
   // we know this row can be skipped. This could be very useful with stats and big
   // sections can be skipped. Implement that when we can benefit from it.
@@ -646,10 +871,71 @@ class HdfsParquetScanner::BaseScalarColumnReader :
   /// Header for current data page.
   parquet::PageHeader current_page_header_;
 
+  /// True if a dictionary filter was set for the current column chunk with
+  /// SetDictFilter().
+  bool has_dict_filter_;
+
+  /// True if values of rejected tuples are skipped, see SetSkipRejectedTuples().
+  bool skip_rejected_tuples_;
+
+  /// Rejected flags of the scratch tuples, see SetDictFilter() and
+  /// SetSkipRejectedTuples().
+  uint8_t* rejected_tuples_;
+
+  /// Bitmap with the dictionary entries that pass the dictionary filter. Only valid if
+  /// 'has_dict_filter_' is true.
+  Bitmap dict_filter_;
+
+  /// True if NULL values do not pass the dictionary filter.
+  bool dict_filter_rejects_nulls_;
+
+  /// Conjuncts that are evaluated against the statistics of each data page, see
+  /// SetPageFilter().
+  std::vector<const StatsConjunct*> page_filter_conjuncts_;
+
+  /// True if the current data page was skipped because of 'page_filter_conjuncts_'. Its
+  /// values are neither decompressed nor decoded.
+  bool skipping_page_;
+
+  /// Status that decoding errors are reported in. Points to the parent's parse_status_,
+  /// or to 'parallel_decode_status_' while decoding in parallel.
+  Status* parse_status_;
+
+  /// True between BeginParallelDecoding() and EndParallelDecoding().
+  bool decoding_in_parallel_;
+
+  /// The members below are only used while 'decoding_in_parallel_' is true.
+  Status parallel_decode_status_;
+
+  /// Pool for the values and data page buffers. Created by the first call to
+  /// BeginParallelDecoding().
+  boost::scoped_ptr<MemPool> parallel_decode_pool_;
+
+  /// One entry per top-level value of the batch, set if the value is NULL.
+  std::vector<uint8_t> staged_nulls_;
+
   /// Read the next data page. If a dictionary page is encountered, that will be read and
   /// this function will continue reading the next data page.
   Status ReadDataPage();
 
+  /// Deserializes the next page header from the stream into current_page_header_. If
+  /// 'peek' is true, the stream is not advanced past the header. Sets 'eos' to true if
+  /// the stream ended before the next header, in which case an error is logged since the
+  /// column chunk contained fewer values than stated in its metadata.
+  Status ReadPageHeader(bool peek, bool* eos);
+
+  /// Reads the dictionary page described by current_page_header_ and initializes the
+  /// dictionary decoder.
+  Status ReadDictionaryPage();
+
+  /// Returns false if the statistics in 'header' show that none of the values of the
+  /// data page can pass 'page_filter_conjuncts_', true otherwise.
+  bool PageMayPass(const parquet::DataPageHeader& header) const;
+
+  /// Allocates 'size' bytes for the dictionary from the parent's dictionary_pool_, which
+  /// is shared by all readers. Returns NULL if the allocation failed.
+  uint8_t* TryAllocateDictionary(int64_t size);
+
   /// Try to move the the next page and buffer more values. Return false and sets rep_level_,
   /// def_level_ and pos_current_value_ to -1 if no more pages or an error encountered.
   bool NextPage();
@@ -734,6 +1020,8 @@ class HdfsParquetScanner::ScalarColumnReader :
 
   virtual bool NeedsSeedingForBatchedReading() const { return false; }
 
+  virtual bool SupportsParallelDecoding() const { return true; }
+
   virtual bool ReadValueBatch(MemPool* pool, int max_values, int tuple_size,
       uint8_t* tuple_mem, int* num_values) {
     return ReadValueBatch<true>(pool, max_values, tuple_size, tuple_mem, num_values);
@@ -788,22 +1076,33 @@ class HdfsParquetScanner::ScalarColumnReader :
       // Read next page if necessary.
       if (num_buffered_values_ == 0) {
         if (!NextPage()) {
-          continue_execution = parent_->parse_status_.ok();
+          continue_execution = parse_status_->ok();
           continue;
         }
       }
 
+      if (skipping_page_) {
+        // None of the values of the page can pass the page filter, so reject their
+        // tuples without reading the values.
+        DCHECK(!IN_COLLECTION);
+        int vals_to_skip = min(num_buffered_values_, max_values - val_count);
+        memset(rejected_tuples_ + val_count, 1, vals_to_skip);
+        val_count += vals_to_skip;
+        num_buffered_values_ -= vals_to_skip;
+        continue;
+      }
+
       // Fill def/rep level caches if they are empty.
       int level_batch_size = min(parent_->state_->batch_size(), num_buffered_values_);
       if (!def_levels_.CacheHasNext()) {
-        parent_->parse_status_.MergeStatus(def_levels_.CacheNextBatch(level_batch_size));
+        parse_status_->MergeStatus(def_levels_.CacheNextBatch(level_batch_size));
       }
       // We only need the repetition levels for populating the position slot since we
       // are only populating top-level tuples.
       if (IN_COLLECTION && pos_slot_desc_ != NULL && !rep_levels_.CacheHasNext()) {
-        parent_->parse_status_.MergeStatus(rep_levels_.CacheNextBatch(level_batch_size));
+        parse_status_->MergeStatus(rep_levels_.CacheNextBatch(level_batch_size));
       }
-      if (UNLIKELY(!parent_->parse_status_.ok())) return false;
+      if (UNLIKELY(!parse_status_->ok())) return false;
 
       // This special case is most efficiently handled here directly.
       if (!MATERIALIZED && !IN_COLLECTION) {
@@ -819,12 +1118,34 @@ class HdfsParquetScanner::ScalarColumnReader :
       uint8_t* next_tuple = tuple_mem + val_count * tuple_size;
       int remaining_val_capacity = max_values - val_count;
       int ret_val_count = 0;
+      uint8_t* rejected =
+          IN_COLLECTION || rejected_tuples_ == NULL ? NULL : rejected_tuples_ + val_count;
+      uint8_t* staged_nulls =
+          IN_COLLECTION || !decoding_in_parallel_ ? NULL : &staged_nulls_[val_count];
       if (page_encoding_ == parquet::Encoding::PLAIN_DICTIONARY) {
-        continue_execution = MaterializeValueBatch<IN_COLLECTION, true>(
-            pool, remaining_val_capacity, tuple_size, next_tuple, &ret_val_count);
+        if (!IN_COLLECTION && has_dict_filter_) {
+          continue_execution = MaterializeValueBatch<IN_COLLECTION, true, true, false>(
+              pool, remaining_val_capacity, tuple_size, next_tuple, rejected,
+              staged_nulls, &ret_val_count);
+        } else if (!IN_COLLECTION && skip_rejected_tuples_) {
+          continue_execution = MaterializeValueBatch<IN_COLLECTION, true, false, true>(
+              pool, remaining_val_capacity, tuple_size, next_tuple, rejected,
+              staged_nulls, &ret_val_count);
+        } else {
+          continue_execution = MaterializeValueBatch<IN_COLLECTION, true, false, false>(
+              pool, remaining_val_capacity, tuple_size, next_tuple, NULL,
+              staged_nulls, &ret_val_count);
+        }
       } else {
-        continue_execution = MaterializeValueBatch<IN_COLLECTION, false>(
-            pool, remaining_val_capacity, tuple_size, next_tuple, &ret_val_count);
+        if (!IN_COLLECTION && skip_rejected_tuples_) {
+          continue_execution = MaterializeValueBatch<IN_COLLECTION, false, false, true>(
+              pool, remaining_val_capacity, tuple_size, next_tuple, rejected,
+              staged_nulls, &ret_val_count);
+        } else {
+          continue_execution = MaterializeValueBatch<IN_COLLECTION, false, false, false>(
+              pool, remaining_val_capacity, tuple_size, next_tuple, NULL,
+              staged_nulls, &ret_val_count);
+        }
       }
       val_count += ret_val_count;
       num_buffered_values_ -= (def_levels_.CacheCurrIdx() - cache_start_idx);
@@ -838,10 +1159,18 @@ class HdfsParquetScanner::ScalarColumnReader :
   /// level caches have been populated.
   /// For efficiency, the simple special case of !MATERIALIZED && !IN_COLLECTION is not
   /// handled in this function.
-  template<bool IN_COLLECTION, bool IS_DICT_ENCODED>
+  /// If DICT_FILTER is true, the dictionary filter is applied and the entries of
+  /// 'rejected' are set for the tuples whose values are rejected by it. If
+  /// SKIP_REJECTED is true, the values of the tuples whose entries in 'rejected' are set
+  /// are skipped without being materialized. If 'staged_nulls' is non-NULL, the entries
+  /// of the tuples with NULL values are set instead of their null indicators.
+  template<bool IN_COLLECTION, bool IS_DICT_ENCODED, bool DICT_FILTER,
+      bool SKIP_REJECTED>
   bool MaterializeValueBatch(MemPool* pool, int max_values, int tuple_size,
-      uint8_t* tuple_mem, int* num_values) {
+      uint8_t* tuple_mem, uint8_t* rejected, uint8_t* staged_nulls, int* num_values) {
     DCHECK(MATERIALIZED || IN_COLLECTION);
+    if (DICT_FILTER) DCHECK(IS_DICT_ENCODED && !IN_COLLECTION && rejected != NULL);
+    if (SKIP_REJECTED) DCHECK(!DICT_FILTER && !IN_COLLECTION && rejected != NULL);
     DCHECK_GT(num_buffered_values_, 0);
     DCHECK(def_levels_.CacheHasNext());
     if (IN_COLLECTION && pos_slot_desc_ != NULL) DCHECK(rep_levels_.CacheHasNext());
@@ -849,6 +1178,24 @@ class HdfsParquetScanner::ScalarColumnReader :
     uint8_t* curr_tuple = tuple_mem;
     int val_count = 0;
     while (def_levels_.CacheHasNext()) {
+      if (MATERIALIZED && IS_DICT_ENCODED && !IN_COLLECTION && !DICT_FILTER &&
+          !SKIP_REJECTED && !NeedsConversion()) {
+        // Decode a run of non-NULL values straight into the slots of their tuples.
+        int run_length =
+            def_levels_.CacheRunLength(max_def_level(), max_values - val_count);
+        if (run_length > 1) {
+          if (UNLIKELY(!dict_decoder_.GetValues(
+              run_length, tuple_size, curr_tuple + tuple_offset_))) {
+            SetDictDecodeError();
+            return false;
+          }
+          def_levels_.CacheSkipLevels(run_length);
+          curr_tuple += run_length * tuple_size;
+          val_count += run_length;
+          if (val_count == max_values) break;
+          continue;
+        }
+      }
       Tuple* tuple = reinterpret_cast<Tuple*>(curr_tuple);
       int def_level = def_levels_.CacheGetNext();
 
@@ -869,12 +1216,24 @@ class HdfsParquetScanner::ScalarColumnReader :
       }
 
       if (MATERIALIZED) {
-        if (def_level >= max_def_level()) {
-          bool continue_execution =
+        if (SKIP_REJECTED && rejected[val_count]) {
+          // The tuple will not be returned, only advance past its value.
+          if (def_level >= max_def_level() &&
+              UNLIKELY(!SkipSlot<IS_DICT_ENCODED>())) {
+            return false;
+          }
+        } else if (def_level >= max_def_level()) {
+          bool continue_execution = DICT_FILTER ?
+              ReadDictFilteredSlot(tuple->GetSlot(tuple_offset_), &rejected[val_count]) :
               ReadSlot<IS_DICT_ENCODED>(tuple->GetSlot(tuple_offset_), pool);
           if (UNLIKELY(!continue_execution)) return false;
         } else {
-          tuple->SetNull(null_indicator_offset_);
+          if (staged_nulls != NULL) {
+            staged_nulls[val_count] = 1;
+          } else {
+            tuple->SetNull(null_indicator_offset_);
+          }
+          if (DICT_FILTER) rejected[val_count] |= dict_filter_rejects_nulls_;
         }
       }
 
@@ -901,6 +1260,10 @@ class HdfsParquetScanner::ScalarColumnReader :
     return dict_decoder_init_;
   }
 
+  virtual DictDecoderBase* GetDictionaryDecoder() {
+    return dict_decoder_init_ ? &dict_decoder_ : NULL;
+  }
+
   virtual void ClearDictionaryDecoder() {
     dict_decoder_init_ = false;
   }
@@ -961,6 +1324,45 @@ class HdfsParquetScanner::ScalarColumnReader :
     return true;
   }
 
+  /// Advances past the next value without writing it into a slot or converting it.
+  /// Returns false if the value could not be decoded.
+  template<bool IS_DICT_ENCODED>
+  inline bool SkipSlot() {
+    if (IS_DICT_ENCODED) {
+      DCHECK_EQ(page_encoding_, parquet::Encoding::PLAIN_DICTIONARY);
+      if (UNLIKELY(!dict_decoder_.SkipValue())) {
+        SetDictDecodeError();
+        return false;
+      }
+    } else {
+      DCHECK_EQ(page_encoding_, parquet::Encoding::PLAIN);
+      T val;
+      int encoded_len =
+          ParquetPlainEncoder::Decode<T>(data_, data_end_, fixed_len_size_, &val);
+      if (UNLIKELY(encoded_len < 0)) {
+        SetPlainDecodeError();
+        return false;
+      }
+      data_ += encoded_len;
+    }
+    return true;
+  }
+
+  /// Same as ReadSlot<true>() but also marks the tuple as rejected in '*reject' if the
+  /// dictionary index of the value does not pass the dictionary filter. Dictionary
+  /// filters are only set for columns that do not need conversion.
+  inline bool ReadDictFilteredSlot(void* slot, uint8_t* reject) {
+    DCHECK(!NeedsConversion());
+    DCHECK_EQ(page_encoding_, parquet::Encoding::PLAIN_DICTIONARY);
+    int index;
+    if (UNLIKELY(!dict_decoder_.GetValue(reinterpret_cast<T*>(slot), &index))) {
+      SetDictDecodeError();
+      return false;
+    }
+    *reject |= !dict_filter_.Get<false>(index);
+    return true;
+  }
+
   /// Most column readers never require conversion, so we can avoid branches by
   /// returning constant false. Column readers for types that require conversion
   /// must specialize this function.
@@ -978,11 +1380,11 @@ class HdfsParquetScanner::ScalarColumnReader :
   /// Pull out slow-path Status construction code from ReadRepetitionLevel()/
   /// ReadDefinitionLevel() for performance.
   void __attribute__((noinline)) SetDictDecodeError() {
-    parent_->parse_status_ = Status(TErrorCode::PARQUET_DICT_DECODE_FAILURE, filename(),
+    *parse_status_ = Status(TErrorCode::PARQUET_DICT_DECODE_FAILURE, filename(),
         slot_desc_->type().DebugString(), stream_->file_offset());
   }
   void __attribute__((noinline)) SetPlainDecodeError() {
-    parent_->parse_status_ = Status(TErrorCode::PARQUET_CORRUPT_PLAIN_VALUE, filename(),
+    *parse_status_ = Status(TErrorCode::PARQUET_CORRUPT_PLAIN_VALUE, filename(),
         slot_desc_->type().DebugString(), stream_->file_offset());
   }
 
@@ -1011,6 +1413,13 @@ bool HdfsParquetScanner::ScalarColumnReader<StringValue, true>::ConvertSlot(
   DCHECK(slot_desc() != NULL);
   DCHECK(slot_desc()->type().type == TYPE_CHAR);
   int len = slot_desc()->type().len;
+  if (slot_desc()->type().IsVarLenStringType() && src->len >= len) {
+    // The value needs no padding, so reference its prefix in the data page or the
+    // dictionary, which are attached to the row batch like unconverted strings are,
+    // instead of copying it.
+    *dst = StringValue(src->ptr, len);
+    return true;
+  }
   StringValue sv;
   sv.len = len;
   if (slot_desc()->type().IsVarLenStringType()) {
@@ -1018,7 +1427,7 @@ bool HdfsParquetScanner::ScalarColumnReader<StringValue, true>::ConvertSlot(
     if (UNLIKELY(sv.ptr == NULL)) {
       string details = Substitute(PARQUET_MEM_LIMIT_EXCEEDED, "ConvertSlot",
           len, "StringValue");
-      parent_->parse_status_ =
+      *parse_status_ =
           pool->mem_tracker()->MemLimitExceeded(parent_->state_, details, len);
       return false;
     }
@@ -1080,6 +1489,8 @@ class HdfsParquetScanner::BoolColumnReader :
     return false;
   }
 
+  virtual DictDecoderBase* GetDictionaryDecoder() { return NULL; }
+
   virtual void ClearDictionaryDecoder() { }
 
   virtual Status InitDataPage(uint8_t* data, int size) {
@@ -1118,7 +1529,7 @@ class HdfsParquetScanner::BoolColumnReader :
   template <bool IN_COLLECTION>
   inline bool ReadSlot(void* slot, MemPool* pool)  {
     if (!bool_values_.GetValue(1, reinterpret_cast<bool*>(slot))) {
-      parent_->parse_status_ = Status("Invalid bool column.");
+      *parse_status_ = Status("Invalid bool column.");
       return false;
     }
     return NextLevels<IN_COLLECTION>();
@@ -1129,13 +1540,37 @@ class HdfsParquetScanner::BoolColumnReader :
 
 }
 
+bool HdfsParquetScanner::SamplesRows() {
+  return FLAGS_parquet_row_sample_percent > 0 && FLAGS_parquet_row_sample_percent < 100;
+}
+
 Status HdfsParquetScanner::Prepare(ScannerContext* context) {
   RETURN_IF_ERROR(HdfsScanner::Prepare(context));
+  // The scan node decides whether rows are sampled and counts the rejected ones.
+  if (scan_node_->rows_rejected_by_sampling_counter() != NULL) {
+    // Compare against the upper 32 bits of the generator, which are the best ones.
+    row_sample_threshold_ = static_cast<uint64_t>(
+        FLAGS_parquet_row_sample_percent / 100 * (1LL << 32));
+  }
   metadata_range_ = stream_->scan_range();
   num_cols_counter_ =
       ADD_COUNTER(scan_node_->runtime_profile(), "NumColumns", TUnit::UNIT);
   num_row_groups_counter_ =
       ADD_COUNTER(scan_node_->runtime_profile(), "NumRowGroups", TUnit::UNIT);
+  num_row_groups_skipped_counter_ =
+      ADD_COUNTER(scan_node_->runtime_profile(), "RowGroupsSkipped", TUnit::UNIT);
+  num_dict_filtered_row_groups_counter_ = ADD_COUNTER(
+      scan_node_->runtime_profile(), "NumDictFilteredRowGroups", TUnit::UNIT);
+  num_stats_filtered_pages_counter_ = ADD_COUNTER(
+      scan_node_->runtime_profile(), "NumStatsFilteredPages", TUnit::UNIT);
+  num_bloom_filtered_row_groups_counter_ = ADD_COUNTER(
+      scan_node_->runtime_profile(), "NumBloomFilteredRowGroups", TUnit::UNIT);
+  num_min_max_filtered_row_groups_counter_ = ADD_COUNTER(
+      scan_node_->runtime_profile(), "NumMinMaxFilteredRowGroups", TUnit::UNIT);
+  num_topn_filtered_row_groups_counter_ = ADD_COUNTER(
+      scan_node_->runtime_profile(), "NumTopNFilteredRowGroups", TUnit::UNIT);
+  num_topn_filtered_rows_counter_ = ADD_COUNTER(
+      scan_node_->runtime_profile(), "NumTopNFilteredRows", TUnit::UNIT);
 
   scan_node_->IncNumScannersCodegenDisabled();
 
@@ -1324,13 +1759,212 @@ static bool RequiresSkippedDictionaryHeaderCheck(
   return v.VersionEq(1,1,0) || (v.VersionEq(1,2,0) && v.is_impala_internal);
 }
 
+Status HdfsParquetScanner::BaseScalarColumnReader::ReadPageHeader(bool peek,
+    bool* eos) {
+  *eos = false;
+  uint8_t* buffer;
+  int64_t buffer_size;
+  RETURN_IF_ERROR(stream_->GetBuffer(true, &buffer, &buffer_size));
+  if (buffer_size == 0) {
+    // The data pages contain fewer values than stated in the column metadata.
+    DCHECK(stream_->eosr());
+    DCHECK_LT(num_values_read_, metadata_->num_values);
+    // TODO for 2.3: node_.element->name isn't necessarily useful
+    ErrorMsg msg(TErrorCode::PARQUET_COLUMN_METADATA_INVALID,
+        metadata_->num_values, num_values_read_, node_.element->name, filename());
+    RETURN_IF_ERROR(parent_->LogOrReturnError(msg));
+    *eos = true;
+    return Status::OK();
+  }
+
+  // We don't know the actual header size until the thrift object is deserialized.  Loop
+  // until we successfully deserialize the header or exceed the maximum header size.
+  uint32_t header_size;
+  Status status;
+  while (true) {
+    header_size = buffer_size;
+    status = DeserializeThriftMsg(
+        buffer, &header_size, true, &current_page_header_);
+    if (status.ok()) break;
+
+    if (buffer_size >= FLAGS_max_page_header_size) {
+      stringstream ss;
+      ss << "ParquetScanner: could not read data page because page header exceeded "
+         << "maximum size of "
+         << PrettyPrinter::Print(FLAGS_max_page_header_size, TUnit::BYTES);
+      status.AddDetail(ss.str());
+      return status;
+    }
+
+    // Didn't read entire header, increase buffer size and try again
+    Status status;
+    int64_t new_buffer_size = max<int64_t>(buffer_size * 2, 1024);
+    bool success = stream_->GetBytes(
+        new_buffer_size, &buffer, &new_buffer_size, &status, /* peek */ true);
+    if (!success) {
+      DCHECK(!status.ok());
+      return status;
+    }
+    DCHECK(status.ok());
+
+    if (buffer_size == new_buffer_size) {
+      DCHECK_NE(new_buffer_size, 0);
+      return Status(TErrorCode::PARQUET_HEADER_EOF, filename());
+    }
+    DCHECK_GT(new_buffer_size, buffer_size);
+    buffer_size = new_buffer_size;
+  }
+
+  // Successfully deserialized current_page_header_
+  if (!peek && !stream_->SkipBytes(header_size, &status)) return status;
+  return Status::OK();
+}
+
+Status HdfsParquetScanner::BaseScalarColumnReader::ReadDictionaryPage() {
+  DCHECK_EQ(current_page_header_.type, parquet::PageType::DICTIONARY_PAGE);
+  Status status;
+  int data_size = current_page_header_.compressed_page_size;
+  int uncompressed_size = current_page_header_.uncompressed_page_size;
+
+  if (slot_desc_ == NULL) {
+    // Skip processing the dictionary page if we don't need to decode any values. In
+    // addition to being unnecessary, we are likely unable to successfully decode the
+    // dictionary values because we don't necessarily create the right type of scalar
+    // reader if there's no slot to read into (see CreateReader()).
+    if (!stream_->ReadBytes(data_size, &data_, &status)) return status;
+    return Status::OK();
+  }
+
+  if (HasDictionaryDecoder()) {
+    return Status("Column chunk should not contain two dictionary pages.");
+  }
+  if (node_.element->type == parquet::Type::BOOLEAN) {
+    return Status("Unexpected dictionary page. Dictionary page is not"
+        " supported for booleans.");
+  }
+  const parquet::DictionaryPageHeader* dict_header = NULL;
+  if (current_page_header_.__isset.dictionary_page_header) {
+    dict_header = &current_page_header_.dictionary_page_header;
+  } else {
+    if (!RequiresSkippedDictionaryHeaderCheck(parent_->file_version_)) {
+      return Status("Dictionary page does not have dictionary header set.");
+    }
+  }
+  if (dict_header != NULL &&
+      dict_header->encoding != parquet::Encoding::PLAIN &&
+      dict_header->encoding != parquet::Encoding::PLAIN_DICTIONARY) {
+    return Status("Only PLAIN and PLAIN_DICTIONARY encodings are supported "
+        "for dictionary pages.");
+  }
+
+  if (!stream_->ReadBytes(data_size, &data_, &status)) return status;
+  data_end_ = data_ + data_size;
+
+  uint8_t* dict_values = NULL;
+  if (decompressor_.get() != NULL) {
+    dict_values = TryAllocateDictionary(uncompressed_size);
+    if (UNLIKELY(dict_values == NULL)) {
+      string details = Substitute(PARQUET_MEM_LIMIT_EXCEEDED, "ReadDictionaryPage",
+          uncompressed_size, "dictionary");
+      return parent_->dictionary_pool_->mem_tracker()->MemLimitExceeded(
+          parent_->state_, details, uncompressed_size);
+    }
+    RETURN_IF_ERROR(decompressor_->ProcessBlock32(true, data_size, data_,
+        &uncompressed_size, &dict_values));
+    VLOG_FILE << "Decompressed " << data_size << " to " << uncompressed_size;
+    if (current_page_header_.uncompressed_page_size != uncompressed_size) {
+      return Status(Substitute("Error decompressing dictionary page in file '$0'. "
+          "Expected $1 uncompressed bytes but got $2", filename(),
+          current_page_header_.uncompressed_page_size, uncompressed_size));
+    }
+    data_size = uncompressed_size;
+  } else {
+    if (current_page_header_.uncompressed_page_size != data_size) {
+      return Status(Substitute("Error reading dictionary page in file '$0'. "
+          "Expected $1 bytes but got $2", filename(),
+          current_page_header_.uncompressed_page_size, data_size));
+    }
+    // Copy dictionary from io buffer (which will be recycled as we read
+    // more data) to a new buffer
+    dict_values = TryAllocateDictionary(data_size);
+    if (UNLIKELY(dict_values == NULL)) {
+      string details = Substitute(PARQUET_MEM_LIMIT_EXCEEDED, "ReadDictionaryPage",
+          data_size, "dictionary");
+      return parent_->dictionary_pool_->mem_tracker()->MemLimitExceeded(
+          parent_->state_, details, data_size);
+    }
+    memcpy(dict_values, data_, data_size);
+  }
+
+  DictDecoderBase* dict_decoder;
+  RETURN_IF_ERROR(CreateDictionaryDecoder(dict_values, data_size, &dict_decoder));
+  if (dict_header != NULL &&
+      dict_header->num_values != dict_decoder->num_entries()) {
+    return Status(TErrorCode::PARQUET_CORRUPT_DICTIONARY, filename(),
+        slot_desc_->type().DebugString(),
+        Substitute("Expected $0 entries but data contained $1 entries",
+        dict_header->num_values, dict_decoder->num_entries()));
+  }
+  return Status::OK();
+}
+
+bool HdfsParquetScanner::BaseScalarColumnReader::PageMayPass(
+    const parquet::DataPageHeader& header) const {
+  if (!header.__isset.statistics) return true;
+  const parquet::Statistics& stats = header.statistics;
+  // Comparisons never pass for NULL values.
+  if (stats.__isset.null_count && stats.null_count == header.num_values) return false;
+  for (const StatsConjunct* stats_conjunct: page_filter_conjuncts_) {
+    const ColumnType& type = stats_conjunct->slot_desc->type();
+    int64_t min_slot;
+    int64_t max_slot;
+    bool has_min = ParquetColumnStats::ReadFromThrift(
+        stats, type, ParquetColumnStats::MIN, &min_slot);
+    bool has_max = ParquetColumnStats::ReadFromThrift(
+        stats, type, ParquetColumnStats::MAX, &max_slot);
+    if (!ParquetColumnStats::MayPass(stats_conjunct->op, stats_conjunct->value, type,
+        has_min ? &min_slot : NULL, has_max ? &max_slot : NULL)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+uint8_t* HdfsParquetScanner::BaseScalarColumnReader::TryAllocateDictionary(
+    int64_t size) {
+  boost::unique_lock<boost::mutex> l(parent_->column_decode_lock_, boost::defer_lock);
+  if (decoding_in_parallel_) l.lock();
+  return parent_->dictionary_pool_->TryAllocate(size);
+}
+
+Status HdfsParquetScanner::BaseScalarColumnReader::InitDictionary() {
+  DCHECK_EQ(num_values_read_, 0);
+  DCHECK_EQ(num_buffered_values_, 0);
+  if (slot_desc_ == NULL || HasDictionaryDecoder()) return Status::OK();
+  if (!metadata_->__isset.dictionary_page_offset || metadata_->num_values == 0) {
+    return Status::OK();
+  }
+  // Peek at the first page header. If it is not a dictionary page, the stream is left
+  // untouched so that ReadDataPage() can read the page.
+  bool eos;
+  RETURN_IF_ERROR(ReadPageHeader(true, &eos));
+  if (eos || current_page_header_.type != parquet::PageType::DICTIONARY_PAGE) {
+    return Status::OK();
+  }
+  RETURN_IF_ERROR(ReadPageHeader(false, &eos));
+  DCHECK(!eos);
+  return ReadDictionaryPage();
+}
+
 Status HdfsParquetScanner::BaseScalarColumnReader::ReadDataPage() {
   Status status;
-  uint8_t* buffer;
 
   // We're about to move to the next data page.  The previous data page is
   // now complete, pass along the memory allocated for it.
-  parent_->scratch_batch_->mem_pool()->AcquireData(decompressed_data_pool_.get(), false);
+  MemPool* output_pool = decoding_in_parallel_ ?
+      parallel_decode_pool_.get() : parent_->scratch_batch_->mem_pool();
+  output_pool->AcquireData(decompressed_data_pool_.get(), false);
+  skipping_page_ = false;
 
   // Read the next data page, skipping page types we don't care about.
   // We break out of this loop on the non-error case (a data page was found or we read all
@@ -1348,142 +1982,15 @@ Status HdfsParquetScanner::BaseScalarColumnReader::ReadDataPage() {
       return Status::OK();
     }
 
-    int64_t buffer_size;
-    RETURN_IF_ERROR(stream_->GetBuffer(true, &buffer, &buffer_size));
-    if (buffer_size == 0) {
-      // The data pages contain fewer values than stated in the column metadata.
-      DCHECK(stream_->eosr());
-      DCHECK_LT(num_values_read_, metadata_->num_values);
-      // TODO for 2.3: node_.element->name isn't necessarily useful
-      ErrorMsg msg(TErrorCode::PARQUET_COLUMN_METADATA_INVALID,
-          metadata_->num_values, num_values_read_, node_.element->name, filename());
-      RETURN_IF_ERROR(parent_->LogOrReturnError(msg));
-      return Status::OK();
-    }
-
-    // We don't know the actual header size until the thrift object is deserialized.  Loop
-    // until we successfully deserialize the header or exceed the maximum header size.
-    uint32_t header_size;
-    while (true) {
-      header_size = buffer_size;
-      status = DeserializeThriftMsg(
-          buffer, &header_size, true, &current_page_header_);
-      if (status.ok()) break;
-
-      if (buffer_size >= FLAGS_max_page_header_size) {
-        stringstream ss;
-        ss << "ParquetScanner: could not read data page because page header exceeded "
-           << "maximum size of "
-           << PrettyPrinter::Print(FLAGS_max_page_header_size, TUnit::BYTES);
-        status.AddDetail(ss.str());
-        return status;
-      }
-
-      // Didn't read entire header, increase buffer size and try again
-      Status status;
-      int64_t new_buffer_size = max<int64_t>(buffer_size * 2, 1024);
-      bool success = stream_->GetBytes(
-          new_buffer_size, &buffer, &new_buffer_size, &status, /* peek */ true);
-      if (!success) {
-        DCHECK(!status.ok());
-        return status;
-      }
-      DCHECK(status.ok());
-
-      if (buffer_size == new_buffer_size) {
-        DCHECK_NE(new_buffer_size, 0);
-        return Status(TErrorCode::PARQUET_HEADER_EOF, filename());
-      }
-      DCHECK_GT(new_buffer_size, buffer_size);
-      buffer_size = new_buffer_size;
-    }
-
-    // Successfully deserialized current_page_header_
-    if (!stream_->SkipBytes(header_size, &status)) return status;
+    bool eos;
+    RETURN_IF_ERROR(ReadPageHeader(false, &eos));
+    if (eos) return Status::OK();
 
     int data_size = current_page_header_.compressed_page_size;
     int uncompressed_size = current_page_header_.uncompressed_page_size;
 
     if (current_page_header_.type == parquet::PageType::DICTIONARY_PAGE) {
-      if (slot_desc_ == NULL) {
-        // Skip processing the dictionary page if we don't need to decode any values. In
-        // addition to being unnecessary, we are likely unable to successfully decode the
-        // dictionary values because we don't necessarily create the right type of scalar
-        // reader if there's no slot to read into (see CreateReader()).
-        if (!stream_->ReadBytes(data_size, &data_, &status)) return status;
-        continue;
-      }
-
-      if (HasDictionaryDecoder()) {
-        return Status("Column chunk should not contain two dictionary pages.");
-      }
-      if (node_.element->type == parquet::Type::BOOLEAN) {
-        return Status("Unexpected dictionary page. Dictionary page is not"
-            " supported for booleans.");
-      }
-      const parquet::DictionaryPageHeader* dict_header = NULL;
-      if (current_page_header_.__isset.dictionary_page_header) {
-        dict_header = &current_page_header_.dictionary_page_header;
-      } else {
-        if (!RequiresSkippedDictionaryHeaderCheck(parent_->file_version_)) {
-          return Status("Dictionary page does not have dictionary header set.");
-        }
-      }
-      if (dict_header != NULL &&
-          dict_header->encoding != parquet::Encoding::PLAIN &&
-          dict_header->encoding != parquet::Encoding::PLAIN_DICTIONARY) {
-        return Status("Only PLAIN and PLAIN_DICTIONARY encodings are supported "
-            "for dictionary pages.");
-      }
-
-      if (!stream_->ReadBytes(data_size, &data_, &status)) return status;
-      data_end_ = data_ + data_size;
-
-      uint8_t* dict_values = NULL;
-      if (decompressor_.get() != NULL) {
-        dict_values = parent_->dictionary_pool_->TryAllocate(uncompressed_size);
-        if (UNLIKELY(dict_values == NULL)) {
-          string details = Substitute(PARQUET_MEM_LIMIT_EXCEEDED, "ReadDataPage",
-              uncompressed_size, "dictionary");
-          return parent_->dictionary_pool_->mem_tracker()->MemLimitExceeded(
-              parent_->state_, details, uncompressed_size);
-        }
-        RETURN_IF_ERROR(decompressor_->ProcessBlock32(true, data_size, data_,
-            &uncompressed_size, &dict_values));
-        VLOG_FILE << "Decompressed " << data_size << " to " << uncompressed_size;
-        if (current_page_header_.uncompressed_page_size != uncompressed_size) {
-          return Status(Substitute("Error decompressing dictionary page in file '$0'. "
-              "Expected $1 uncompressed bytes but got $2", filename(),
-              current_page_header_.uncompressed_page_size, uncompressed_size));
-        }
-        data_size = uncompressed_size;
-      } else {
-        if (current_page_header_.uncompressed_page_size != data_size) {
-          return Status(Substitute("Error reading dictionary page in file '$0'. "
-              "Expected $1 bytes but got $2", filename(),
-              current_page_header_.uncompressed_page_size, data_size));
-        }
-        // Copy dictionary from io buffer (which will be recycled as we read
-        // more data) to a new buffer
-        dict_values = parent_->dictionary_pool_->TryAllocate(data_size);
-        if (UNLIKELY(dict_values == NULL)) {
-          string details = Substitute(PARQUET_MEM_LIMIT_EXCEEDED, "ReadDataPage",
-              data_size, "dictionary");
-          return parent_->dictionary_pool_->mem_tracker()->MemLimitExceeded(
-              parent_->state_, details, data_size);
-        }
-        memcpy(dict_values, data_, data_size);
-      }
-
-      DictDecoderBase* dict_decoder;
-      RETURN_IF_ERROR(CreateDictionaryDecoder(dict_values, data_size, &dict_decoder));
-      if (dict_header != NULL &&
-          dict_header->num_values != dict_decoder->num_entries()) {
-        return Status(TErrorCode::PARQUET_CORRUPT_DICTIONARY, filename(),
-            slot_desc_->type().DebugString(),
-            Substitute("Expected $0 entries but data contained $1 entries",
-            dict_header->num_values, dict_decoder->num_entries()));
-      }
+      RETURN_IF_ERROR(ReadDictionaryPage());
       // Done with dictionary page, read next page
       continue;
     }
@@ -1494,9 +2001,21 @@ Status HdfsParquetScanner::BaseScalarColumnReader::ReadDataPage() {
       continue;
     }
 
+    // Skip the page without reading it if no value can pass the page filter. Only the
+    // statistics of the types supported by ParquetColumnStats are used, which excludes
+    // the corrupt statistics of IMPALA-2208 and PARQUET-251.
+    if (!page_filter_conjuncts_.empty() &&
+        current_page_header_.data_page_header.num_values > 0 &&
+        !PageMayPass(current_page_header_.data_page_header)) {
+      if (!stream_->SkipBytes(data_size, &status)) return status;
+      num_buffered_values_ = current_page_header_.data_page_header.num_values;
+      num_values_read_ += num_buffered_values_;
+      skipping_page_ = true;
+      COUNTER_ADD(parent_->num_stats_filtered_pages_counter_, 1);
+      return Status::OK();
+    }
+
     // Read Data Page
-    // TODO: when we start using page statistics, we will need to ignore certain corrupt
-    // statistics. See IMPALA-2208 and PARQUET-251.
     if (!stream_->ReadBytes(data_size, &data_, &status)) return status;
     data_end_ = data_ + data_size;
     num_buffered_values_ = current_page_header_.data_page_header.num_values;
@@ -1534,6 +2053,11 @@ Status HdfsParquetScanner::BaseScalarColumnReader::ReadDataPage() {
       }
     }
 
+    // The level caches are allocated from a pool shared by all readers.
+    boost::unique_lock<boost::mutex> level_cache_lock(parent_->column_decode_lock_,
+        boost::defer_lock);
+    if (decoding_in_parallel_) level_cache_lock.lock();
+
     // Initialize the repetition level data
     RETURN_IF_ERROR(rep_levels_.Init(filename(),
         current_page_header_.data_page_header.repetition_level_encoding,
@@ -1546,6 +2070,7 @@ Status HdfsParquetScanner::BaseScalarColumnReader::ReadDataPage() {
         current_page_header_.data_page_header.definition_level_encoding,
         parent_->level_cache_pool_.get(), parent_->state_->batch_size(),
         max_def_level(), num_buffered_values_, &data_, &data_size));
+    if (decoding_in_parallel_) level_cache_lock.unlock();
 
     // Data can be empty if the column contains all NULLs
     if (data_size != 0) RETURN_IF_ERROR(InitDataPage(data_, data_size));
@@ -1616,18 +2141,6 @@ Status HdfsParquetScanner::LevelDecoder::InitCache(MemPool* pool, int cache_size
   return Status::OK();
 }
 
-inline int16_t HdfsParquetScanner::LevelDecoder::ReadLevel() {
-  bool valid;
-  uint8_t level;
-  if (encoding_ == parquet::Encoding::RLE) {
-    valid = Get(&level);
-  } else {
-    DCHECK_EQ(encoding_, parquet::Encoding::BIT_PACKED);
-    valid = bit_reader_.GetValue(1, &level);
-  }
-  return LIKELY(valid) ? level : INVALID_LEVEL;
-}
-
 Status HdfsParquetScanner::LevelDecoder::CacheNextBatch(int batch_size) {
   DCHECK_LE(batch_size, cache_size_);
   cached_level_idx_ = 0;
@@ -1658,14 +2171,15 @@ bool HdfsParquetScanner::LevelDecoder::FillCache(int batch_size,
       repeat_count_ -= num_repeats_to_set;
 
       // Add remaining literal values, if any.
-      uint32_t num_literals_to_set =
-          min<uint32_t>(literal_count_, batch_size - num_values);
-      int num_values_end = min<uint32_t>(num_values + literal_count_, batch_size);
-      for (; num_values < num_values_end; ++num_values) {
-        bool valid = bit_reader_.GetValue(bit_width_, &cached_levels_[num_values]);
-        if (UNLIKELY(!valid || cached_levels_[num_values] > max_level_)) return false;
+      int num_literals_to_set = min<uint32_t>(literal_count_, batch_size - num_values);
+      if (num_literals_to_set > 0) {
+        int num_literals = bit_reader_.GetValues(
+            bit_width_, cached_levels_ + num_values, num_literals_to_set);
+        if (UNLIKELY(num_literals != num_literals_to_set)) return false;
+        if (UNLIKELY(!ValidateLevels(num_values, num_literals))) return false;
+        num_values += num_literals;
+        literal_count_ -= num_literals;
       }
-      literal_count_ -= num_literals_to_set;
 
       if (num_values == batch_size) break;
       if (UNLIKELY(!NextCounts<int16_t>())) return false;
@@ -1673,48 +2187,73 @@ bool HdfsParquetScanner::LevelDecoder::FillCache(int batch_size,
     }
   } else {
     DCHECK_EQ(encoding_, parquet::Encoding::BIT_PACKED);
-    for (; num_values < batch_size; ++num_values) {
-      bool valid = bit_reader_.GetValue(1, &cached_levels_[num_values]);
-      if (UNLIKELY(!valid || cached_levels_[num_values] > max_level_)) return false;
-    }
+    num_values = bit_reader_.GetValues(1, cached_levels_, batch_size);
+    if (UNLIKELY(num_values != batch_size)) return false;
+    if (UNLIKELY(!ValidateLevels(0, num_values))) return false;
   }
   *num_cached_levels = num_values;
   return true;
 }
 
+inline bool HdfsParquetScanner::LevelDecoder::ValidateLevels(int start_idx,
+    int num_levels) const {
+  // Accumulate with '|' instead of returning early so the loop has no branches.
+  bool invalid = false;
+  for (int i = start_idx; i < start_idx + num_levels; ++i) {
+    invalid |= cached_levels_[i] > max_level_;
+  }
+  return !invalid;
+}
+
 template <bool ADVANCE_REP_LEVEL>
 bool HdfsParquetScanner::BaseScalarColumnReader::NextLevels() {
   if (!ADVANCE_REP_LEVEL) DCHECK_EQ(max_rep_level(), 0) << slot_desc()->DebugString();
 
   if (UNLIKELY(num_buffered_values_ == 0)) {
-    if (!NextPage()) return parent_->parse_status_.ok();
+    if (!NextPage()) return parse_status_->ok();
   }
+  // Levels are decoded a batch at a time into the level caches, which are filled
+  // together so that they stay in step. The batch ends with the page.
+  int level_batch_size = min(parent_->state_->batch_size(), num_buffered_values_);
   --num_buffered_values_;
 
   // Definition level is not present if column and any containing structs are required.
-  def_level_ = max_def_level() == 0 ? 0 : def_levels_.ReadLevel();
+  if (max_def_level() == 0) {
+    def_level_ = 0;
+  } else {
+    if (UNLIKELY(!def_levels_.CacheHasNext())) {
+      parse_status_->MergeStatus(def_levels_.CacheNextBatch(level_batch_size));
+      if (UNLIKELY(!parse_status_->ok())) return false;
+    }
+    def_level_ = def_levels_.CacheGetNext();
+  }
 
   if (ADVANCE_REP_LEVEL && max_rep_level() > 0) {
     // Repetition level is only present if this column is nested in any collection type.
-    rep_level_ = rep_levels_.ReadLevel();
+    if (UNLIKELY(!rep_levels_.CacheHasNext())) {
+      parse_status_->MergeStatus(rep_levels_.CacheNextBatch(level_batch_size));
+      if (UNLIKELY(!parse_status_->ok())) return false;
+    }
+    rep_level_ = rep_levels_.CacheGetNext();
     // Reset position counter if we are at the start of a new parent collection.
     if (rep_level_ <= max_rep_level() - 1) pos_current_value_ = 0;
   }
 
-  return parent_->parse_status_.ok();
+  return parse_status_->ok();
 }
 
 bool HdfsParquetScanner::BaseScalarColumnReader::NextPage() {
-  parent_->assemble_rows_timer_.Stop();
-  parent_->parse_status_ = ReadDataPage();
-  if (UNLIKELY(!parent_->parse_status_.ok())) return false;
+  // The timer belongs to the scanner thread.
+  if (!decoding_in_parallel_) parent_->assemble_rows_timer_.Stop();
+  *parse_status_ = ReadDataPage();
+  if (UNLIKELY(!parse_status_->ok())) return false;
   if (num_buffered_values_ == 0) {
     rep_level_ = ROW_GROUP_END;
     def_level_ = INVALID_LEVEL;
     pos_current_value_ = INVALID_POS;
     return false;
   }
-  parent_->assemble_rows_timer_.Start();
+  if (!decoding_in_parallel_) parent_->assemble_rows_timer_.Start();
   return true;
 }
 
@@ -1889,10 +2428,19 @@ Status HdfsParquetScanner::ProcessSplit() {
   // its own stream.
   stream_ = NULL;
 
+  if (FLAGS_parquet_skip_row_groups_using_stats || FLAGS_parquet_skip_pages_using_stats) {
+    InitStatsConjuncts();
+  }
+  if (FLAGS_parquet_skip_row_groups_using_stats) InitMinMaxFilterProbes();
+  InitLateMaterialization();
+  InitPageFilters();
+  if (FLAGS_parquet_bloom_filtering) InitBloomFilterProbes();
+  if (FLAGS_parquet_dictionary_filtering) InitDictFilterConjuncts();
+
   // Iterate through each row group in the file and process any row groups that fall
   // within this split.
-  for (int i = 0; i < file_metadata_.row_groups.size(); ++i) {
-    const parquet::RowGroup& row_group = file_metadata_.row_groups[i];
+  for (int i = 0; i < file_metadata_->row_groups.size(); ++i) {
+    const parquet::RowGroup& row_group = file_metadata_->row_groups[i];
     if (row_group.num_rows == 0) continue;
 
     const DiskIoMgr::ScanRange* split_range =
@@ -1906,6 +2454,30 @@ Status HdfsParquetScanner::ProcessSplit() {
         row_group_mid_pos < split_offset + split_length)) continue;
     COUNTER_ADD(num_row_groups_counter_, 1);
 
+    // Skip the row group before issuing any column ranges if its statistics show that no
+    // row can pass the conjuncts.
+    if (FLAGS_parquet_skip_row_groups_using_stats &&
+        !RowGroupPassesStatsConjuncts(row_group)) {
+      COUNTER_ADD(num_row_groups_skipped_counter_, 1);
+      continue;
+    }
+    if (!min_max_filter_probes_.empty() && !RowGroupPassesMinMaxFilters(row_group)) {
+      COUNTER_ADD(num_min_max_filtered_row_groups_counter_, 1);
+      continue;
+    }
+    if (!topn_filter_probes_.empty() && !RowGroupPassesTopNFilters(row_group)) {
+      COUNTER_ADD(num_topn_filtered_row_groups_counter_, 1);
+      continue;
+    }
+    if (!bloom_filter_probes_.empty()) {
+      bool skip_row_group = false;
+      RETURN_IF_ERROR(EvalBloomFilters(row_group, &skip_row_group));
+      if (skip_row_group) {
+        COUNTER_ADD(num_bloom_filtered_row_groups_counter_, 1);
+        continue;
+      }
+    }
+
     // Attach any resources and clear the streams before starting a new row group. These
     // streams could either be just the footer stream or streams for the previous row
     // group.
@@ -1915,6 +2487,13 @@ Status HdfsParquetScanner::ProcessSplit() {
 
     RETURN_IF_ERROR(InitColumns(i, column_readers_));
 
+    bool skip_row_group = false;
+    RETURN_IF_ERROR(EvalDictFilters(row_group, &skip_row_group));
+    if (skip_row_group) {
+      COUNTER_ADD(num_dict_filtered_row_groups_counter_, 1);
+      continue;
+    }
+
     assemble_rows_timer_.Start();
 
     // Prepare column readers for first read
@@ -1965,16 +2544,570 @@ Status HdfsParquetScanner::ProcessSplit() {
   return Status::OK();
 }
 
+/// Evaluates the constant expr 'expr' and writes the result into 'slot' in the slot
+/// representation of expr->type(). Returns false if the result is NULL or the type is
+/// not supported.
+static bool EvalStatsConstant(Expr* expr, ExprContext* ctx, void* slot) {
+  switch (expr->type().type) {
+    case TYPE_TINYINT: {
+      TinyIntVal v = expr->GetTinyIntVal(ctx, NULL);
+      if (v.is_null) return false;
+      *reinterpret_cast<int8_t*>(slot) = v.val;
+      return true;
+    }
+    case TYPE_SMALLINT: {
+      SmallIntVal v = expr->GetSmallIntVal(ctx, NULL);
+      if (v.is_null) return false;
+      *reinterpret_cast<int16_t*>(slot) = v.val;
+      return true;
+    }
+    case TYPE_INT: {
+      IntVal v = expr->GetIntVal(ctx, NULL);
+      if (v.is_null) return false;
+      *reinterpret_cast<int32_t*>(slot) = v.val;
+      return true;
+    }
+    case TYPE_BIGINT: {
+      BigIntVal v = expr->GetBigIntVal(ctx, NULL);
+      if (v.is_null) return false;
+      *reinterpret_cast<int64_t*>(slot) = v.val;
+      return true;
+    }
+    case TYPE_FLOAT: {
+      FloatVal v = expr->GetFloatVal(ctx, NULL);
+      if (v.is_null || std::isnan(v.val)) return false;
+      *reinterpret_cast<float*>(slot) = v.val;
+      return true;
+    }
+    case TYPE_DOUBLE: {
+      DoubleVal v = expr->GetDoubleVal(ctx, NULL);
+      if (v.is_null || std::isnan(v.val)) return false;
+      *reinterpret_cast<double*>(slot) = v.val;
+      return true;
+    }
+    default:
+      return false;
+  }
+}
+
+void HdfsParquetScanner::InitStatsConjuncts() {
+  stats_conjuncts_.clear();
+  for (ExprContext* ctx: *scanner_conjunct_ctxs_) {
+    Expr* root = ctx->root();
+    ParquetColumnStats::PredicateOp op;
+    if (root->GetNumChildren() != 2) continue;
+    if (!ParquetColumnStats::ParsePredicateOp(root->fn().name.function_name, &op)) {
+      continue;
+    }
+    Expr* slot_expr = root->GetChild(0);
+    Expr* const_expr = root->GetChild(1);
+    if (!slot_expr->is_slotref()) {
+      std::swap(slot_expr, const_expr);
+      op = ParquetColumnStats::MirrorPredicateOp(op);
+    }
+    if (!slot_expr->is_slotref() || !const_expr->IsConstant()) continue;
+
+    int col_idx;
+    const SlotDescriptor* slot_desc =
+        ResolveScalarSlot(static_cast<SlotRef*>(slot_expr)->slot_id(), &col_idx);
+    if (slot_desc == NULL) continue;
+    if (!ParquetColumnStats::IsSupportedType(slot_desc->type())) continue;
+    if (const_expr->type() != slot_desc->type()) continue;
+
+    StatsConjunct stats_conjunct;
+    stats_conjunct.slot_desc = slot_desc;
+    stats_conjunct.col_idx = col_idx;
+    stats_conjunct.op = op;
+    if (!EvalStatsConstant(const_expr, ctx, stats_conjunct.value)) continue;
+    stats_conjuncts_.push_back(stats_conjunct);
+  }
+}
+
+const SlotDescriptor* HdfsParquetScanner::ResolveScalarSlot(SlotId slot_id,
+    int* col_idx) {
+  const SlotDescriptor* slot_desc = NULL;
+  for (const SlotDescriptor* sd: scan_node_->tuple_desc()->slots()) {
+    if (sd->id() == slot_id) {
+      slot_desc = sd;
+      break;
+    }
+  }
+  if (slot_desc == NULL || slot_desc->type().IsComplexType()) return NULL;
+  // Partition key slots are not stored in the file.
+  if (slot_desc->col_path().empty() ||
+      slot_desc->col_path()[0] < scan_node_->num_partition_keys()) {
+    return NULL;
+  }
+
+  SchemaNode* node = NULL;
+  bool pos_field;
+  bool missing_field;
+  // The column readers were already created successfully for the same paths, so
+  // resolution errors are not expected here. Be defensive and ignore the slot.
+  Status status = ResolvePath(slot_desc->col_path(), &node, &pos_field, &missing_field);
+  if (!status.ok() || missing_field || pos_field) return NULL;
+  if (node->col_idx < 0 || node->max_rep_level > 0) return NULL;
+  *col_idx = node->col_idx;
+  return slot_desc;
+}
+
+bool HdfsParquetScanner::RowGroupPassesStatsConjuncts(
+    const parquet::RowGroup& row_group) const {
+  for (const StatsConjunct& stats_conjunct: stats_conjuncts_) {
+    if (stats_conjunct.col_idx >= row_group.columns.size()) continue;
+    const parquet::ColumnChunk& col_chunk = row_group.columns[stats_conjunct.col_idx];
+    const ColumnType& type = stats_conjunct.slot_desc->type();
+
+    // Comparisons never pass for NULL values, so a column chunk that only contains
+    // NULLs does not produce any rows.
+    if (col_chunk.meta_data.__isset.statistics &&
+        col_chunk.meta_data.statistics.__isset.null_count &&
+        col_chunk.meta_data.statistics.null_count == row_group.num_rows) {
+      return false;
+    }
+
+    int64_t min_slot;
+    int64_t max_slot;
+    bool has_min = ParquetColumnStats::ReadFromThrift(
+        col_chunk, type, ParquetColumnStats::MIN, &min_slot);
+    bool has_max = ParquetColumnStats::ReadFromThrift(
+        col_chunk, type, ParquetColumnStats::MAX, &max_slot);
+    if (!ParquetColumnStats::MayPass(stats_conjunct.op, stats_conjunct.value, type,
+        has_min ? &min_slot : NULL, has_max ? &max_slot : NULL)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void HdfsParquetScanner::InitMinMaxFilterProbes() {
+  min_max_filter_probes_.clear();
+  for (const FilterContext* filter_ctx: filter_ctxs_) {
+    Expr* target_expr = filter_ctx->expr->root();
+    if (!target_expr->is_slotref()) continue;
+    MinMaxFilterProbe probe;
+    probe.slot_desc =
+        ResolveScalarSlot(static_cast<SlotRef*>(target_expr)->slot_id(), &probe.col_idx);
+    if (probe.slot_desc == NULL) continue;
+    if (!ParquetColumnStats::IsSupportedType(probe.slot_desc->type())) continue;
+    if (!MinMaxFilter::IsSupportedType(probe.slot_desc->type())) continue;
+    probe.filter = filter_ctx->filter;
+    min_max_filter_probes_.push_back(probe);
+  }
+
+  topn_filter_probes_.clear();
+  for (const HdfsScanNode::TopNFilterTarget& target: scan_node_->topn_filters()) {
+    TopNFilterProbe probe;
+    probe.slot_desc = ResolveScalarSlot(target.slot_desc->id(), &probe.col_idx);
+    if (probe.slot_desc == NULL) continue;
+    if (!ParquetColumnStats::IsSupportedType(probe.slot_desc->type())) continue;
+    probe.filter = target.filter;
+    topn_filter_probes_.push_back(probe);
+  }
+}
+
+bool HdfsParquetScanner::ColumnChunkMayPass(const MinMaxFilter& filter,
+    const ColumnType& type, const parquet::ColumnChunk& col_chunk) {
+  DCHECK(filter.type() == type);
+  const parquet::ColumnMetaData& meta_data = col_chunk.meta_data;
+  if (filter.has_null()) {
+    // NULLs are not reflected in the min/max statistics. NULLs pass unless the null
+    // count shows that there are none.
+    if (!meta_data.__isset.statistics || !meta_data.statistics.__isset.null_count ||
+        meta_data.statistics.null_count > 0) {
+      return true;
+    }
+  }
+  if (!filter.has_values()) return false;
+
+  int64_t min_slot;
+  int64_t max_slot;
+  bool has_min = ParquetColumnStats::ReadFromThrift(
+      col_chunk, type, ParquetColumnStats::MIN, &min_slot);
+  bool has_max = ParquetColumnStats::ReadFromThrift(
+      col_chunk, type, ParquetColumnStats::MAX, &max_slot);
+  int64_t filter_min;
+  int64_t filter_max;
+  filter.GetMin(&filter_min);
+  filter.GetMax(&filter_max);
+  // The ranges overlap iff the chunk has a value >= filter_min and one <= filter_max.
+  return ParquetColumnStats::MayPass(ParquetColumnStats::GE, &filter_min, type,
+          has_min ? &min_slot : NULL, has_max ? &max_slot : NULL) &&
+      ParquetColumnStats::MayPass(ParquetColumnStats::LE, &filter_max, type,
+          has_min ? &min_slot : NULL, has_max ? &max_slot : NULL);
+}
+
+bool HdfsParquetScanner::RowGroupPassesMinMaxFilters(
+    const parquet::RowGroup& row_group) const {
+  for (const MinMaxFilterProbe& probe: min_max_filter_probes_) {
+    const MinMaxFilter* min_max_filter = probe.filter->min_max_filter();
+    if (min_max_filter == NULL) continue;
+    const ColumnType& type = probe.slot_desc->type();
+    if (min_max_filter->type() != type) continue;
+    // The build side had no values, so no row can pass.
+    if (!min_max_filter->has_null() && !min_max_filter->has_values()) return false;
+    if (probe.col_idx >= row_group.columns.size()) continue;
+    if (!ColumnChunkMayPass(*min_max_filter, type, row_group.columns[probe.col_idx])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool HdfsParquetScanner::RowGroupPassesTopNFilters(
+    const parquet::RowGroup& row_group) const {
+  for (const TopNFilterProbe& probe: topn_filter_probes_) {
+    if (probe.col_idx >= row_group.columns.size()) continue;
+    const ColumnType& type = probe.slot_desc->type();
+    MinMaxFilter bound(type);
+    if (!probe.filter->GetBound(&bound)) continue;
+    if (!ColumnChunkMayPass(bound, type, row_group.columns[probe.col_idx])) return false;
+  }
+  return true;
+}
+
+void HdfsParquetScanner::InitBloomFilterProbes() {
+  bloom_filter_probes_.clear();
+  for (ExprContext* ctx: *scanner_conjunct_ctxs_) {
+    Expr* root = ctx->root();
+    const string& fn_name = root->fn().name.function_name;
+    bool is_eq = fn_name == "eq" && root->GetNumChildren() == 2;
+    bool is_in = fn_name == "in_iterate" || fn_name == "in_set_lookup";
+    if (!is_eq && !is_in) continue;
+    Expr* slot_expr = root->GetChild(0);
+    vector<Expr*> const_exprs;
+    for (int i = 1; i < root->GetNumChildren(); ++i) {
+      const_exprs.push_back(root->GetChild(i));
+    }
+    if (is_eq && !slot_expr->is_slotref()) std::swap(slot_expr, const_exprs[0]);
+    if (!slot_expr->is_slotref()) continue;
+
+    BloomFilterProbe probe;
+    const SlotDescriptor* slot_desc =
+        ResolveScalarSlot(static_cast<SlotRef*>(slot_expr)->slot_id(), &probe.col_idx);
+    if (slot_desc == NULL) continue;
+    if (!ParquetBloomFilter::IsSupportedType(slot_desc->type())) continue;
+    probe.runtime_filter = NULL;
+    bool all_constant = true;
+    for (Expr* const_expr: const_exprs) {
+      if (!const_expr->IsConstant() || const_expr->type() != slot_desc->type()) {
+        all_constant = false;
+        break;
+      }
+      // NULL constants never compare equal, so they do not need to be probed.
+      int64_t value;
+      if (!EvalStatsConstant(const_expr, ctx, &value)) continue;
+      probe.hashes.push_back(ParquetBloomFilter::Hash(&value, slot_desc->type()));
+    }
+    if (all_constant) bloom_filter_probes_.push_back(probe);
+  }
+
+  for (const FilterContext* filter_ctx: filter_ctxs_) {
+    Expr* target_expr = filter_ctx->expr->root();
+    if (!target_expr->is_slotref()) continue;
+    BloomFilterProbe probe;
+    const SlotDescriptor* slot_desc =
+        ResolveScalarSlot(static_cast<SlotRef*>(target_expr)->slot_id(), &probe.col_idx);
+    if (slot_desc == NULL) continue;
+    if (!ParquetBloomFilter::IsSupportedType(slot_desc->type())) continue;
+    probe.runtime_filter = filter_ctx->filter;
+    bloom_filter_probes_.push_back(probe);
+  }
+
+  // Sort the probes so that EvalBloomFilters() reads the filter of each column once.
+  std::stable_sort(bloom_filter_probes_.begin(), bloom_filter_probes_.end(),
+      [](const BloomFilterProbe& a, const BloomFilterProbe& b) {
+        return a.col_idx < b.col_idx;
+      });
+}
+
+Status HdfsParquetScanner::EvalBloomFilters(const parquet::RowGroup& row_group,
+    bool* skip_row_group) {
+  *skip_row_group = false;
+  const HdfsFileDesc* file_desc = scan_node_->GetFileDesc(filename());
+  DCHECK(file_desc != NULL);
+  scoped_ptr<BloomFilter> bloom_filter;
+  int bloom_filter_col_idx = -1;
+  for (const BloomFilterProbe& probe: bloom_filter_probes_) {
+    const BloomFilter* runtime_bloom_filter = NULL;
+    if (probe.runtime_filter != NULL) {
+      // The runtime filter did not arrive yet or passes all values.
+      if (!probe.runtime_filter->HasBloomFilter()) continue;
+      runtime_bloom_filter = probe.runtime_filter->bloom_filter();
+      if (runtime_bloom_filter == NULL) continue;
+    }
+    if (probe.col_idx >= row_group.columns.size()) continue;
+
+    if (probe.col_idx != bloom_filter_col_idx) {
+      bloom_filter_col_idx = probe.col_idx;
+      bloom_filter.reset();
+      int64_t offset;
+      int log_heap_space;
+      if (!ParquetBloomFilter::DecodeLocation(row_group.columns[probe.col_idx].meta_data,
+          &offset, &log_heap_space)) {
+        continue;
+      }
+      TBloomFilter thrift_filter;
+      thrift_filter.log_heap_space = log_heap_space;
+      thrift_filter.always_true = false;
+      thrift_filter.directory.resize(1LL << log_heap_space);
+      if (offset + thrift_filter.directory.size() > file_desc->file_length) {
+        return Status(Substitute("File $0 has an invalid bloom filter location in column "
+            "$1: offset $2, size $3 bytes. File size: $4 bytes.", filename(),
+            probe.col_idx, offset, thrift_filter.directory.size(),
+            file_desc->file_length));
+      }
+      RETURN_IF_ERROR(ReadFileBytes(offset, thrift_filter.directory.size(),
+          reinterpret_cast<uint8_t*>(&thrift_filter.directory[0])));
+      bloom_filter.reset(new BloomFilter(thrift_filter));
+    }
+    if (bloom_filter.get() == NULL) continue;
+
+    bool may_pass;
+    if (runtime_bloom_filter != NULL) {
+      may_pass = bloom_filter->MayIntersect(*runtime_bloom_filter);
+    } else {
+      may_pass = false;
+      for (uint32_t hash: probe.hashes) {
+        if (bloom_filter->Find(hash)) {
+          may_pass = true;
+          break;
+        }
+      }
+    }
+    if (!may_pass) {
+      *skip_row_group = true;
+      return Status::OK();
+    }
+  }
+  return Status::OK();
+}
+
+/// Returns true if 'expr' always returns the same value for the same input row, i.e. it
+/// does not call rand() or any user-defined function.
+static bool IsDeterministicExpr(Expr* expr) {
+  if (expr->fn().binary_type != TFunctionBinaryType::BUILTIN) return false;
+  if (expr->fn().name.function_name == "rand") return false;
+  for (int i = 0; i < expr->GetNumChildren(); ++i) {
+    if (!IsDeterministicExpr(expr->GetChild(i))) return false;
+  }
+  return true;
+}
+
+/// Returns true if the encodings in 'metadata' show that all data pages of the column
+/// chunk are dictionary encoded. Only the definition and repetition levels may use other
+/// encodings.
+static bool IsDictionaryEncoded(const parquet::ColumnMetaData& metadata) {
+  if (!metadata.__isset.dictionary_page_offset) return false;
+  bool has_dict_encoding = false;
+  for (parquet::Encoding::type encoding: metadata.encodings) {
+    if (encoding == parquet::Encoding::PLAIN_DICTIONARY) {
+      has_dict_encoding = true;
+    } else if (encoding != parquet::Encoding::RLE &&
+        encoding != parquet::Encoding::BIT_PACKED) {
+      return false;
+    }
+  }
+  return has_dict_encoding;
+}
+
+void HdfsParquetScanner::InitLateMaterialization() {
+  num_filter_readers_ = 0;
+  filter_conjunct_ctxs_.clear();
+  remaining_conjunct_ctxs_ = *scanner_conjunct_ctxs_;
+  if (!FLAGS_parquet_late_materialization || scanner_conjunct_ctxs_->empty()) return;
+
+  // Top-level readers by the id of the slot they materialize.
+  map<SlotId, ColumnReader*> slot_readers;
+  for (ColumnReader* col_reader: column_readers_) {
+    if (col_reader->slot_desc() == NULL) continue;
+    slot_readers[col_reader->slot_desc()->id()] = col_reader;
+  }
+
+  // A conjunct can be evaluated early if all of its slots are materialized by top-level
+  // scalar readers. Slots without a reader are partition keys or missing columns, which
+  // are set in the template tuple.
+  set<ColumnReader*> filter_readers;
+  vector<ExprContext*> filter_ctxs;
+  vector<ExprContext*> remaining_ctxs;
+  for (ExprContext* ctx: *scanner_conjunct_ctxs_) {
+    vector<SlotId> slot_ids;
+    ctx->root()->GetSlotIds(&slot_ids);
+    set<ColumnReader*> conjunct_readers;
+    bool is_filter_conjunct = true;
+    for (SlotId slot_id: slot_ids) {
+      map<SlotId, ColumnReader*>::iterator it = slot_readers.find(slot_id);
+      if (it == slot_readers.end()) continue;
+      if (it->second->IsCollectionReader() || it->second->max_rep_level() > 0) {
+        is_filter_conjunct = false;
+        break;
+      }
+      conjunct_readers.insert(it->second);
+    }
+    if (is_filter_conjunct) {
+      filter_ctxs.push_back(ctx);
+      filter_readers.insert(conjunct_readers.begin(), conjunct_readers.end());
+    } else {
+      remaining_ctxs.push_back(ctx);
+    }
+  }
+  // Late materialization only pays off if some columns are not needed by the filter
+  // conjuncts.
+  if (filter_readers.empty() || filter_readers.size() == column_readers_.size()) return;
+
+  // Move the filter readers to the front, keeping the relative order of the readers.
+  vector<ColumnReader*> ordered_readers;
+  for (ColumnReader* col_reader: column_readers_) {
+    if (filter_readers.count(col_reader) > 0) ordered_readers.push_back(col_reader);
+  }
+  num_filter_readers_ = ordered_readers.size();
+  for (ColumnReader* col_reader: column_readers_) {
+    if (filter_readers.count(col_reader) > 0) continue;
+    ordered_readers.push_back(col_reader);
+    if (col_reader->IsCollectionReader()) continue;
+    static_cast<BaseScalarColumnReader*>(col_reader)->SetSkipRejectedTuples(
+        &scratch_batch_->rejected_tuples[0]);
+  }
+  column_readers_.swap(ordered_readers);
+  filter_conjunct_ctxs_.swap(filter_ctxs);
+  remaining_conjunct_ctxs_.swap(remaining_ctxs);
+}
+
+void HdfsParquetScanner::InitPageFilters() {
+  has_page_filters_ = false;
+  if (!FLAGS_parquet_skip_pages_using_stats) return;
+  for (ColumnReader* col_reader: column_readers_) {
+    if (col_reader->IsCollectionReader() || col_reader->max_rep_level() > 0) continue;
+    BaseScalarColumnReader* reader = static_cast<BaseScalarColumnReader*>(col_reader);
+    // Readers that skip rejected tuples may run after other readers have read the
+    // rejected tuples, so they must not reject any.
+    if (reader->skip_rejected_tuples_ || reader->slot_desc() == NULL) continue;
+    vector<const StatsConjunct*> conjuncts;
+    for (const StatsConjunct& stats_conjunct: stats_conjuncts_) {
+      if (stats_conjunct.slot_desc == reader->slot_desc()) {
+        conjuncts.push_back(&stats_conjunct);
+      }
+    }
+    if (conjuncts.empty()) continue;
+    reader->SetPageFilter(conjuncts, &scratch_batch_->rejected_tuples[0]);
+    has_page_filters_ = true;
+  }
+}
+
+void HdfsParquetScanner::EvalFilterConjuncts() {
+  DCHECK(scratch_batch_->has_rejected_tuples);
+  ExprContext* const* ctxs = &filter_conjunct_ctxs_[0];
+  int num_ctxs = filter_conjunct_ctxs_.size();
+  uint8_t* rejected = &scratch_batch_->rejected_tuples[0];
+  for (int i = 0; i < scratch_batch_->num_tuples; ++i) {
+    if (rejected[i]) continue;
+    Tuple* tuple = scratch_batch_->GetTuple(i);
+    rejected[i] = !ExecNode::EvalConjuncts(
+        ctxs, num_ctxs, reinterpret_cast<TupleRow*>(&tuple));
+  }
+}
+
+void HdfsParquetScanner::InitDictFilterConjuncts() {
+  dict_filter_conjuncts_.clear();
+  for (ColumnReader* col_reader: column_readers_) {
+    if (col_reader->IsCollectionReader() || col_reader->max_rep_level() > 0) continue;
+    const SlotDescriptor* slot_desc = col_reader->slot_desc();
+    if (slot_desc == NULL) continue;
+    // Bools are never dictionary encoded. CHAR and TIMESTAMP values may need to be
+    // converted after decoding, so their dictionary entries differ from the slot values.
+    // TODO: convert the dictionary entries of these types as well.
+    PrimitiveType type = slot_desc->type().type;
+    if (type == TYPE_BOOLEAN || type == TYPE_CHAR || type == TYPE_TIMESTAMP) continue;
+
+    DictFilterConjuncts dict_filter;
+    dict_filter.reader = static_cast<BaseScalarColumnReader*>(col_reader);
+    for (ExprContext* ctx: *scanner_conjunct_ctxs_) {
+      vector<SlotId> slot_ids;
+      if (ctx->root()->GetSlotIds(&slot_ids) == 0) continue;
+      bool single_slot = true;
+      for (SlotId slot_id: slot_ids) single_slot &= slot_id == slot_desc->id();
+      if (!single_slot || !IsDeterministicExpr(ctx->root())) continue;
+      dict_filter.conjunct_ctxs.push_back(ctx);
+    }
+    if (!dict_filter.conjunct_ctxs.empty()) dict_filter_conjuncts_.push_back(dict_filter);
+  }
+}
+
+Status HdfsParquetScanner::EvalDictFilters(const parquet::RowGroup& row_group,
+    bool* skip_row_group) {
+  *skip_row_group = false;
+  scratch_batch_->has_rejected_tuples = num_filter_readers_ > 0 || has_page_filters_;
+  if (dict_filter_conjuncts_.empty()) return Status::OK();
+
+  if (dict_filter_tuple_ == NULL) {
+    int tuple_size = scan_node_->tuple_desc()->byte_size();
+    uint8_t* buffer = dictionary_pool_->TryAllocate(tuple_size);
+    if (UNLIKELY(buffer == NULL)) {
+      string details = Substitute(PARQUET_MEM_LIMIT_EXCEEDED, "EvalDictFilters",
+          tuple_size, "dictionary filter tuple");
+      return dictionary_pool_->mem_tracker()->MemLimitExceeded(
+          state_, details, tuple_size);
+    }
+    dict_filter_tuple_ = reinterpret_cast<Tuple*>(buffer);
+  }
+  Tuple* tuple = dict_filter_tuple_;
+  TupleRow* row = reinterpret_cast<TupleRow*>(&tuple);
+
+  for (DictFilterConjuncts& dict_filter: dict_filter_conjuncts_) {
+    BaseScalarColumnReader* reader = dict_filter.reader;
+    RETURN_IF_ERROR(reader->InitDictionary());
+    DictDecoderBase* dict_decoder = reader->GetDictionaryDecoder();
+    if (dict_decoder == NULL || dict_decoder->num_entries() == 0) continue;
+
+    const SlotDescriptor* slot_desc = reader->slot_desc();
+    ExprContext* const* ctxs = &dict_filter.conjunct_ctxs[0];
+    int num_ctxs = dict_filter.conjunct_ctxs.size();
+    InitTuple(template_tuple_, tuple);
+
+    int num_entries = dict_decoder->num_entries();
+    Bitmap passing_entries(num_entries);
+    bool any_entry_passes = false;
+    tuple->SetNotNull(slot_desc->null_indicator_offset());
+    void* slot = tuple->GetSlot(slot_desc->tuple_offset());
+    for (int i = 0; i < num_entries; ++i) {
+      dict_decoder->GetEntry(i, slot);
+      bool passes = ExecNode::EvalConjuncts(ctxs, num_ctxs, row);
+      passing_entries.Set<false>(i, passes);
+      any_entry_passes |= passes;
+    }
+    ExprContext::FreeLocalAllocations(dict_filter.conjunct_ctxs);
+
+    // Only columns that can contain NULLs need to check whether a NULL passes.
+    bool null_passes = false;
+    if (reader->max_def_level() > 0) {
+      tuple->SetNull(slot_desc->null_indicator_offset());
+      null_passes = ExecNode::EvalConjuncts(ctxs, num_ctxs, row);
+      ExprContext::FreeLocalAllocations(dict_filter.conjunct_ctxs);
+    }
+
+    const parquet::ColumnChunk& col_chunk = row_group.columns[reader->col_idx()];
+    if (!any_entry_passes && !null_passes && IsDictionaryEncoded(col_chunk.meta_data)) {
+      *skip_row_group = true;
+      return Status::OK();
+    }
+    reader->SetDictFilter(passing_entries, !null_passes,
+        &scratch_batch_->rejected_tuples[0]);
+    scratch_batch_->has_rejected_tuples = true;
+  }
+  return Status::OK();
+}
+
 int HdfsParquetScanner::TransferScratchTuples() {
   // This function must not be called when the output batch is already full. As long as
   // we always call CommitRows() after TransferScratchTuples(), the output batch can
   // never be empty.
   DCHECK_LT(batch_->num_rows(), batch_->capacity());
 
-  const bool has_filters = !filter_ctxs_.empty();
-  const bool has_conjuncts = !scanner_conjunct_ctxs_->empty();
-  ExprContext* const* conjunct_ctxs = &(*scanner_conjunct_ctxs_)[0];
-  const int num_conjuncts = scanner_conjunct_ctxs_->size();
+  const bool has_conjuncts = !remaining_conjunct_ctxs_.empty();
+  const uint8_t* rejected_tuples = scratch_batch_->has_rejected_tuples ?
+      &scratch_batch_->rejected_tuples[scratch_batch_->tuple_idx] : NULL;
+  ExprContext* const* conjunct_ctxs = &remaining_conjunct_ctxs_[0];
+  const int num_conjuncts = remaining_conjunct_ctxs_.size();
 
   // Start/end/current iterators over the output rows.
   DCHECK_EQ(scan_node_->tuple_idx(), 0);
@@ -1994,7 +3127,7 @@ int HdfsParquetScanner::TransferScratchTuples() {
     // We are materializing a collection with empty tuples. Add a NULL tuple to the
     // output batch per remaining scratch tuple and return. No need to evaluate
     // filters/conjuncts or transfer memory ownership.
-    DCHECK(!has_filters);
+    DCHECK(filter_ctxs_.empty());
     DCHECK(!has_conjuncts);
     DCHECK_EQ(scratch_batch_->mem_pool()->total_allocated_bytes(), 0);
     int num_tuples = min(batch_->capacity() - batch_->num_rows(),
@@ -2010,11 +3143,11 @@ int HdfsParquetScanner::TransferScratchTuples() {
   while (scratch_tuple != scratch_tuple_end) {
     *output_row = reinterpret_cast<Tuple*>(scratch_tuple);
     scratch_tuple += tuple_size;
-    // Evaluate runtime filters and conjuncts. Short-circuit the evaluation if
-    // the filters/conjuncts are empty to avoid function calls.
-    if (has_filters && !EvalRuntimeFilters(reinterpret_cast<TupleRow*>(output_row))) {
-      continue;
-    }
+    // Tuples rejected by a dictionary filter, by the filter conjuncts of late
+    // materialization or by a runtime filter cannot pass the conjuncts.
+    if (rejected_tuples != NULL && *rejected_tuples++) continue;
+    // Evaluate conjuncts. Short-circuit the evaluation if the conjuncts are empty to
+    // avoid function calls.
     if (has_conjuncts && !ExecNode::EvalConjuncts(
         conjunct_ctxs, num_conjuncts, reinterpret_cast<TupleRow*>(output_row))) {
       continue;
@@ -2035,19 +3168,36 @@ int HdfsParquetScanner::TransferScratchTuples() {
   return output_row - output_row_start;
 }
 
-bool HdfsParquetScanner::EvalRuntimeFilters(TupleRow* row) {
+void HdfsParquetScanner::EvalRuntimeFilters() {
+  DCHECK_EQ(scratch_batch_->tuple_idx, 0);
+  const int num_tuples = scratch_batch_->num_tuples;
+  if (!scratch_batch_->has_rejected_tuples) {
+    memset(&scratch_batch_->rejected_tuples[0], 0, num_tuples);
+    scratch_batch_->has_rejected_tuples = true;
+  }
+  uint8_t* rejected = &scratch_batch_->rejected_tuples[0];
+  int* tuple_idxs = &scratch_batch_->filter_tuple_idxs[0];
+  Tuple** tuples = &scratch_batch_->filter_tuples[0];
+  uint8_t* passes = &scratch_batch_->filter_passes[0];
+
   int num_filters = filter_ctxs_.size();
   for (int i = 0; i < num_filters; ++i) {
     LocalFilterStats* stats = &filter_stats_[i];
     if (!stats->enabled) continue;
     const RuntimeFilter* filter = filter_ctxs_[i]->filter;
+    // Each filter is only applied to the tuples that passed the previous ones.
+    int num_candidates = 0;
+    for (int j = 0; j < num_tuples; ++j) {
+      tuple_idxs[num_candidates] = j;
+      num_candidates += !rejected[j];
+    }
+    if (num_candidates == 0) return;
+
     // Check filter effectiveness every ROWS_PER_FILTER_SELECTIVITY_CHECK rows.
-    // TODO: The stats updates and the filter effectiveness check are executed very
-    // frequently. Consider hoisting it out of of this loop, and doing an equivalent
-    // check less frequently, e.g., after producing an output batch.
-    ++stats->total_possible;
-    if (UNLIKELY(
-        !(stats->total_possible & (ROWS_PER_FILTER_SELECTIVITY_CHECK - 1)))) {
+    int64_t prev_total_possible = stats->total_possible;
+    stats->total_possible += num_candidates;
+    if (UNLIKELY(prev_total_possible / ROWS_PER_FILTER_SELECTIVITY_CHECK !=
+        stats->total_possible / ROWS_PER_FILTER_SELECTIVITY_CHECK)) {
       double reject_ratio = stats->rejected / static_cast<double>(stats->considered);
       if (filter->AlwaysTrue() ||
           reject_ratio < FLAGS_parquet_min_filter_reject_ratio) {
@@ -2055,14 +3205,68 @@ bool HdfsParquetScanner::EvalRuntimeFilters(TupleRow* row) {
         continue;
       }
     }
-    ++stats->considered;
-    void* e = filter_ctxs_[i]->expr->GetValue(row);
-    if (!filter->Eval<void>(e, filter_ctxs_[i]->expr->root()->type())) {
-      ++stats->rejected;
-      return false;
+    stats->considered += num_candidates;
+
+    for (int j = 0; j < num_candidates; ++j) {
+      tuples[j] = scratch_batch_->GetTuple(tuple_idxs[j]);
+    }
+    filter_ctxs_[i]->EvalBatch(tuples, num_candidates,
+        &scratch_batch_->filter_hashes[0], &scratch_batch_->filter_found[0], passes);
+    for (int j = 0; j < num_candidates; ++j) {
+      rejected[tuple_idxs[j]] = !passes[j];
+      stats->rejected += !passes[j];
     }
   }
-  return true;
+}
+
+void HdfsParquetScanner::SampleScratchTuples() {
+  DCHECK_EQ(scratch_batch_->tuple_idx, 0);
+  DCHECK_GT(row_sample_threshold_, 0);
+  const int num_tuples = scratch_batch_->num_tuples;
+  if (!scratch_batch_->has_rejected_tuples) {
+    memset(&scratch_batch_->rejected_tuples[0], 0, num_tuples);
+    scratch_batch_->has_rejected_tuples = true;
+  }
+  uint8_t* rejected = &scratch_batch_->rejected_tuples[0];
+  uint64_t state = sample_rng_state_;
+  int64_t num_rejected = 0;
+  for (int i = 0; i < num_tuples; ++i) {
+    // xorshift64*, advanced for every tuple so the sample does not depend on filters.
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    bool sampled = ((state * 2685821657736338717ULL) >> 32) < row_sample_threshold_;
+    num_rejected += !sampled && !rejected[i];
+    rejected[i] |= !sampled;
+  }
+  sample_rng_state_ = state;
+  COUNTER_ADD(scan_node_->rows_rejected_by_sampling_counter(), num_rejected);
+}
+
+void HdfsParquetScanner::EvalTopNFilters() {
+  DCHECK_EQ(scratch_batch_->tuple_idx, 0);
+  const int num_tuples = scratch_batch_->num_tuples;
+  for (const HdfsScanNode::TopNFilterTarget& target: scan_node_->topn_filters()) {
+    MinMaxFilter bound(target.slot_desc->type());
+    if (!target.filter->GetBound(&bound)) continue;
+    if (!scratch_batch_->has_rejected_tuples) {
+      memset(&scratch_batch_->rejected_tuples[0], 0, num_tuples);
+      scratch_batch_->has_rejected_tuples = true;
+    }
+    uint8_t* rejected = &scratch_batch_->rejected_tuples[0];
+    const NullIndicatorOffset& null_offset = target.slot_desc->null_indicator_offset();
+    const int tuple_offset = target.slot_desc->tuple_offset();
+    int64_t num_rejected = 0;
+    for (int i = 0; i < num_tuples; ++i) {
+      if (rejected[i]) continue;
+      Tuple* tuple = scratch_batch_->GetTuple(i);
+      bool passes = bound.Eval(
+          tuple->IsNull(null_offset) ? NULL : tuple->GetSlot(tuple_offset));
+      rejected[i] = !passes;
+      num_rejected += !passes;
+    }
+    COUNTER_ADD(num_topn_filtered_rows_counter_, num_rejected);
+  }
 }
 
 /// High-level steps of this function:
@@ -2082,7 +3286,25 @@ bool HdfsParquetScanner::AssembleRows(
   DCHECK(!column_readers.empty());
   DCHECK(scratch_batch_ != NULL);
 
+  // The readers that decode each scratch batch in parallel. Only worth it for at least
+  // two readers.
+  vector<BaseScalarColumnReader*> parallel_readers;
+  if (scan_node_->column_decode_pool() != NULL) {
+    for (int c = num_filter_readers_; c < column_readers.size(); ++c) {
+      if (!CanDecodeInParallel(column_readers[c])) continue;
+      parallel_readers.push_back(static_cast<BaseScalarColumnReader*>(column_readers[c]));
+    }
+    if (parallel_readers.size() < 2) parallel_readers.clear();
+  }
+
   int64_t rows_read = 0;
+  if (row_sample_threshold_ > 0) {
+    uint64_t seed = HashUtil::MurmurHash2_64(filename(), strlen(filename()),
+        FLAGS_hdfs_scan_sample_seed);
+    seed = HashUtil::MurmurHash2_64(&row_group_idx, sizeof(row_group_idx), seed);
+    // xorshift must not start from 0.
+    sample_rng_state_ = seed | 1;
+  }
   bool continue_execution = !scan_node_->ReachedLimit() && !context_->cancelled();
   while (!column_readers[0]->RowGroupAtEnd()) {
     if (UNLIKELY(!continue_execution)) break;
@@ -2106,12 +3328,24 @@ bool HdfsParquetScanner::AssembleRows(
     for (int i = 0; i < scratch_capacity; ++i) {
       InitTuple(template_tuple_, scratch_batch_->GetTuple(i));
     }
+    if (scratch_batch_->has_rejected_tuples) {
+      memset(&scratch_batch_->rejected_tuples[0], 0, scratch_capacity);
+    }
 
     // Materialize the top-level slots into the scratch batch column-by-column.
     int last_num_tuples = -1;
     int num_col_readers = column_readers.size();
     for (int c = 0; c < num_col_readers; ++c) {
+      // With late materialization, the filter readers come first. Evaluate the filter
+      // conjuncts before the other readers so they can skip the rejected tuples.
+      if (c == num_filter_readers_ && c > 0) EvalFilterConjuncts();
       ColumnReader* col_reader = column_readers[c];
+      // The parallel readers are decoded together after all other readers, so that the
+      // dictionary filters of the other readers have set their rejected tuples.
+      if (!parallel_readers.empty() && c >= num_filter_readers_ &&
+          CanDecodeInParallel(col_reader)) {
+        continue;
+      }
       if (col_reader->max_rep_level() > 0) {
         continue_execution = col_reader->ReadValueBatch(
             scratch_batch_->mem_pool(), scratch_capacity, tuple_byte_size_,
@@ -2123,9 +3357,16 @@ bool HdfsParquetScanner::AssembleRows(
       }
       if (UNLIKELY(!continue_execution)) return false;
       // Check that all column readers populated the same number of values.
-      if (c != 0) DCHECK_EQ(last_num_tuples, scratch_batch_->num_tuples);
+      if (last_num_tuples != -1) DCHECK_EQ(last_num_tuples, scratch_batch_->num_tuples);
       last_num_tuples = scratch_batch_->num_tuples;
     }
+    if (!parallel_readers.empty()) {
+      if (UNLIKELY(!DecodeColumnsInParallel(parallel_readers))) return false;
+      if (last_num_tuples != -1) DCHECK_EQ(last_num_tuples, scratch_batch_->num_tuples);
+    }
+    if (row_sample_threshold_ > 0) SampleScratchTuples();
+    if (!filter_ctxs_.empty()) EvalRuntimeFilters();
+    if (!scan_node_->topn_filters().empty()) EvalTopNFilters();
 
     // Keep transferring scratch tuples to output batches until the scratch batch
     // is empty. CommitRows() creates new output batches as necessary.
@@ -2149,6 +3390,95 @@ bool HdfsParquetScanner::AssembleRows(
   return continue_execution;
 }
 
+struct HdfsParquetScanner::ParallelDecodeState {
+  ParallelDecodeState(const vector<BaseScalarColumnReader*>& readers, int max_values,
+      int tuple_size, uint8_t* tuple_mem)
+    : readers(readers),
+      max_values(max_values),
+      tuple_size(tuple_size),
+      tuple_mem(tuple_mem),
+      num_values(readers.size(), 0),
+      continue_execution(readers.size(), true),
+      next_reader(0),
+      readers_done(readers.size()) {
+  }
+
+  const vector<BaseScalarColumnReader*> readers;
+  const int max_values;
+  const int tuple_size;
+  uint8_t* const tuple_mem;
+
+  /// The results of ReadNonRepeatedValueBatch() of each reader. Each entry is only
+  /// written by the thread that claimed the reader.
+  vector<int> num_values;
+  vector<uint8_t> continue_execution;
+
+  /// Index of the next reader that has not been claimed by a thread.
+  AtomicInt32 next_reader;
+
+  /// Notified once for every reader after it decoded its values.
+  CountingBarrier readers_done;
+};
+
+bool HdfsParquetScanner::CanDecodeInParallel(ColumnReader* col_reader) {
+  if (col_reader->IsCollectionReader() || col_reader->max_rep_level() > 0) return false;
+  BaseScalarColumnReader* scalar_reader =
+      static_cast<BaseScalarColumnReader*>(col_reader);
+  // The dictionary and page filters write the rejected tuples that other readers may
+  // read.
+  return scalar_reader->SupportsParallelDecoding() && !scalar_reader->has_dict_filter_ &&
+      !scalar_reader->has_page_filter();
+}
+
+bool HdfsParquetScanner::DecodeColumnsInParallel(
+    const vector<BaseScalarColumnReader*>& readers) {
+  DCHECK_GE(readers.size(), 2);
+  CallableThreadPool* decode_pool = scan_node_->column_decode_pool();
+  DCHECK(decode_pool != NULL);
+  int scratch_capacity = scratch_batch_->capacity();
+  for (BaseScalarColumnReader* reader: readers) {
+    reader->BeginParallelDecoding(scratch_capacity);
+  }
+  // The state is shared with the tasks, which may only run after this function
+  // returned if the scanner thread claimed all readers before them.
+  boost::shared_ptr<ParallelDecodeState> state(new ParallelDecodeState(readers,
+      scratch_capacity, tuple_byte_size_, scratch_batch_->tuple_mem));
+  int num_tasks = min<int>(readers.size() - 1, FLAGS_num_column_decode_threads);
+  for (int i = 0; i < num_tasks; ++i) {
+    if (!decode_pool->Offer(bind(&HdfsParquetScanner::DecodeColumns, state))) break;
+  }
+  // Decode on this thread as well, so it only waits for the readers that are being
+  // decoded by other threads.
+  DecodeColumns(state);
+  state->readers_done.Wait();
+
+  bool continue_execution = true;
+  int num_tuples = state->num_values[0];
+  for (int i = 0; i < readers.size(); ++i) {
+    parse_status_.MergeStatus(readers[i]->EndParallelDecoding(
+        tuple_byte_size_, scratch_batch_->tuple_mem, state->num_values[i]));
+    continue_execution &= state->continue_execution[i];
+    // Check that all column readers populated the same number of values.
+    if (continue_execution) DCHECK_EQ(num_tuples, state->num_values[i]);
+  }
+  scratch_batch_->num_tuples = num_tuples;
+  return continue_execution && parse_status_.ok();
+}
+
+void HdfsParquetScanner::DecodeColumns(
+    const boost::shared_ptr<ParallelDecodeState>& state) {
+  int num_readers = state->readers.size();
+  while (true) {
+    int idx = state->next_reader.Add(1) - 1;
+    if (idx >= num_readers) return;
+    BaseScalarColumnReader* reader = state->readers[idx];
+    state->continue_execution[idx] = reader->ReadNonRepeatedValueBatch(
+        reader->parallel_decode_pool(), state->max_values, state->tuple_size,
+        state->tuple_mem, &state->num_values[idx]);
+    state->readers_done.Notify();
+  }
+}
+
 bool HdfsParquetScanner::AssembleCollection(
     const vector<ColumnReader*>& column_readers, int new_collection_rep_level,
     CollectionValueBuilder* coll_value_builder) {
@@ -2303,6 +3633,74 @@ Status HdfsParquetScanner::ProcessFooter(bool* eosr) {
   uint8_t* metadata_size_ptr = magic_number_ptr - sizeof(int32_t);
   uint32_t metadata_size = *reinterpret_cast<uint32_t*>(metadata_size_ptr);
   uint8_t* metadata_ptr = metadata_size_ptr - metadata_size;
+
+  const HdfsFileDesc* file_desc = scan_node_->GetFileDesc(filename());
+  DCHECK(file_desc != NULL);
+  FooterCache* cache = footer_cache();
+  FooterCacheKey cache_key(filename(), file_desc->mtime, file_desc->file_length);
+  if (cache != NULL && cache->Get(cache_key, &file_metadata_entry_)) {
+    ImpaladMetrics::PARQUET_FOOTER_CACHE_HIT_COUNT->Increment(1L);
+    file_metadata_ = &file_metadata_entry_->file_metadata;
+    RETURN_IF_ERROR(ValidateFileMetadata());
+  } else {
+    boost::shared_ptr<FileMetadataEntry> entry(new FileMetadataEntry());
+    RETURN_IF_ERROR(ReadFileMetadata(metadata_ptr, metadata_size,
+        remaining_bytes_buffered, &entry->file_metadata));
+    file_metadata_entry_ = entry;
+    file_metadata_ = &entry->file_metadata;
+    RETURN_IF_ERROR(ValidateFileMetadata());
+    // Parse file schema
+    RETURN_IF_ERROR(CreateSchemaTree(entry->file_metadata.schema, &entry->schema));
+    if (cache != NULL) {
+      ImpaladMetrics::PARQUET_FOOTER_CACHE_MISS_COUNT->Increment(1L);
+      cache->Put(
+          cache_key, file_metadata_entry_, EstimateFootprint(*entry, metadata_size));
+      ImpaladMetrics::PARQUET_FOOTER_CACHE_TOTAL_BYTES->set_value(cache->total_charge());
+    }
+  }
+  // The schema tree is copied so that schema resolution can hand out non-const nodes.
+  // The copy still points into the shared file metadata.
+  schema_ = file_metadata_entry_->schema;
+
+  if (scan_node_->IsZeroSlotTableScan()) {
+    // There are no materialized slots, e.g. count(*) over the table.  We can serve
+    // this query from just the file metadata.  We don't need to read the column data.
+    int64_t num_tuples = file_metadata_->num_rows;
+    COUNTER_ADD(scan_node_->rows_read_counter(), num_tuples);
+
+    while (num_tuples > 0) {
+      MemPool* pool;
+      Tuple* tuple;
+      TupleRow* current_row;
+      int max_tuples = GetMemory(&pool, &tuple, &current_row);
+      max_tuples = min<int64_t>(max_tuples, num_tuples);
+      num_tuples -= max_tuples;
+
+      int num_to_commit = WriteEmptyTuples(context_, current_row, max_tuples);
+      RETURN_IF_ERROR(CommitRows(num_to_commit));
+    }
+
+    *eosr = true;
+    return Status::OK();
+  } else if (file_metadata_->num_rows == 0) {
+    // Empty file
+    *eosr = true;
+    return Status::OK();
+  }
+
+  if (file_metadata_->row_groups.empty()) {
+    return Status(
+        Substitute("Invalid file. This file: $0 has no row groups", filename()));
+  }
+  if (schema_.children.empty()) {
+    return Status(Substitute("Invalid file: '$0' has no columns.", filename()));
+  }
+  return Status::OK();
+}
+
+Status HdfsParquetScanner::ReadFileMetadata(uint8_t* metadata_ptr,
+    uint32_t metadata_size, int remaining_bytes_buffered,
+    parquet::FileMetaData* file_metadata) {
   // If the metadata was too big, we need to stitch it before deserializing it.
   // In that case, we stitch the data in this buffer.
   vector<uint8_t> metadata_buffer;
@@ -2318,7 +3716,6 @@ Status HdfsParquetScanner::ProcessFooter(bool* eosr) {
     // file_length - 4-byte metadata size - footer-size - metadata size
     int64_t metadata_start = file_desc->file_length -
       sizeof(int32_t) - sizeof(PARQUET_VERSION_NUMBER) - metadata_size;
-    int64_t metadata_bytes_to_read = metadata_size;
     if (metadata_start < 0) {
       return Status(Substitute("File $0 is invalid. Invalid metadata size in file "
           "footer: $1 bytes. File size: $2 bytes.", filename(), metadata_size,
@@ -2331,75 +3728,43 @@ Status HdfsParquetScanner::ProcessFooter(bool* eosr) {
     // now.
     metadata_buffer.resize(metadata_size);
     metadata_ptr = &metadata_buffer[0];
-    int64_t copy_offset = 0;
-    DiskIoMgr* io_mgr = scan_node_->runtime_state()->io_mgr();
-
-    while (metadata_bytes_to_read > 0) {
-      int64_t to_read = ::min<int64_t>(io_mgr->max_read_buffer_size(),
-          metadata_bytes_to_read);
-      DiskIoMgr::ScanRange* range = scan_node_->AllocateScanRange(
-          metadata_range_->fs(), filename(), to_read, metadata_start + copy_offset, -1,
-          metadata_range_->disk_id(), metadata_range_->try_cache(),
-          metadata_range_->expected_local(), file_desc->mtime);
-
-      DiskIoMgr::BufferDescriptor* io_buffer = NULL;
-      RETURN_IF_ERROR(io_mgr->Read(scan_node_->reader_context(), range, &io_buffer));
-      memcpy(metadata_ptr + copy_offset, io_buffer->buffer(), io_buffer->len());
-      io_buffer->Return();
-
-      metadata_bytes_to_read -= to_read;
-      copy_offset += to_read;
-    }
-    DCHECK_EQ(metadata_bytes_to_read, 0);
+    RETURN_IF_ERROR(ReadFileBytes(metadata_start, metadata_size, metadata_ptr));
   }
 
   // Deserialize file header
   // TODO: this takes ~7ms for a 1000-column table, figure out how to reduce this.
   Status status =
-      DeserializeThriftMsg(metadata_ptr, &metadata_size, true, &file_metadata_);
+      DeserializeThriftMsg(metadata_ptr, &metadata_size, true, file_metadata);
   if (!status.ok()) {
     return Status(Substitute("File $0 has invalid file metadata at file offset $1. "
         "Error = $2.", filename(),
         metadata_size + sizeof(PARQUET_VERSION_NUMBER) + sizeof(uint32_t),
         status.GetDetail()));
   }
+  return Status::OK();
+}
 
-  RETURN_IF_ERROR(ValidateFileMetadata());
-  // Parse file schema
-  RETURN_IF_ERROR(CreateSchemaTree(file_metadata_.schema, &schema_));
-
-  if (scan_node_->IsZeroSlotTableScan()) {
-    // There are no materialized slots, e.g. count(*) over the table.  We can serve
-    // this query from just the file metadata.  We don't need to read the column data.
-    int64_t num_tuples = file_metadata_.num_rows;
-    COUNTER_ADD(scan_node_->rows_read_counter(), num_tuples);
-
-    while (num_tuples > 0) {
-      MemPool* pool;
-      Tuple* tuple;
-      TupleRow* current_row;
-      int max_tuples = GetMemory(&pool, &tuple, &current_row);
-      max_tuples = min<int64_t>(max_tuples, num_tuples);
-      num_tuples -= max_tuples;
-
-      int num_to_commit = WriteEmptyTuples(context_, current_row, max_tuples);
-      RETURN_IF_ERROR(CommitRows(num_to_commit));
-    }
-
-    *eosr = true;
-    return Status::OK();
-  } else if (file_metadata_.num_rows == 0) {
-    // Empty file
-    *eosr = true;
-    return Status::OK();
-  }
-
-  if (file_metadata_.row_groups.empty()) {
-    return Status(
-        Substitute("Invalid file. This file: $0 has no row groups", filename()));
-  }
-  if (schema_.children.empty()) {
-    return Status(Substitute("Invalid file: '$0' has no columns.", filename()));
+Status HdfsParquetScanner::ReadFileBytes(int64_t offset, int64_t len, uint8_t* buffer) {
+  const HdfsFileDesc* file_desc = scan_node_->GetFileDesc(filename());
+  DCHECK(file_desc != NULL);
+  DCHECK(metadata_range_ != NULL);
+  int64_t copy_offset = 0;
+  DiskIoMgr* io_mgr = scan_node_->runtime_state()->io_mgr();
+
+  while (len > 0) {
+    int64_t to_read = ::min<int64_t>(io_mgr->max_read_buffer_size(), len);
+    DiskIoMgr::ScanRange* range = scan_node_->AllocateScanRange(
+        metadata_range_->fs(), filename(), to_read, offset + copy_offset, -1,
+        metadata_range_->disk_id(), metadata_range_->try_cache(),
+        metadata_range_->expected_local(), file_desc->mtime);
+
+    DiskIoMgr::BufferDescriptor* io_buffer = NULL;
+    RETURN_IF_ERROR(io_mgr->Read(scan_node_->reader_context(), range, &io_buffer));
+    memcpy(buffer + copy_offset, io_buffer->buffer(), io_buffer->len());
+    io_buffer->Return();
+
+    len -= to_read;
+    copy_offset += to_read;
   }
   return Status::OK();
 }
@@ -2822,7 +4187,7 @@ Status HdfsParquetScanner::InitColumns(
     int row_group_idx, const vector<ColumnReader*>& column_readers) {
   const HdfsFileDesc* file_desc = scan_node_->GetFileDesc(filename());
   DCHECK(file_desc != NULL);
-  parquet::RowGroup& row_group = file_metadata_.row_groups[row_group_idx];
+  const parquet::RowGroup& row_group = file_metadata_->row_groups[row_group_idx];
 
   // All the scan ranges (one for each column).
   vector<DiskIoMgr::ScanRange*> col_ranges;
@@ -2920,6 +4285,17 @@ Status HdfsParquetScanner::InitColumns(
   }
   DCHECK_EQ(col_ranges.size(), num_scalar_readers);
 
+  // Split the read size between the column chunks so that wide scans don't buffer a
+  // full-sized read for every column. Remote ranges ignore the hint.
+  if (FLAGS_parquet_min_column_read_size > 0 && !col_ranges.empty()) {
+    int64_t read_size = max(FLAGS_parquet_min_column_read_size,
+        scan_node_->runtime_state()->io_mgr()->max_read_buffer_size() /
+        static_cast<int64_t>(col_ranges.size()));
+    for (DiskIoMgr::ScanRange* col_range: col_ranges) {
+      col_range->set_preferred_read_size(read_size);
+    }
+  }
+
   // Issue all the column chunks to the io mgr and have them scheduled immediately.
   // This means these ranges aren't returned via DiskIoMgr::GetNextRange and
   // instead are scheduled to be read immediately.
@@ -3028,16 +4404,16 @@ bool HdfsParquetScanner::FileVersion::VersionEq(int major, int minor, int patch)
 }
 
 Status HdfsParquetScanner::ValidateFileMetadata() {
-  if (file_metadata_.version > PARQUET_CURRENT_VERSION) {
+  if (file_metadata_->version > PARQUET_CURRENT_VERSION) {
     stringstream ss;
     ss << "File: " << filename() << " is of an unsupported version. "
-       << "file version: " << file_metadata_.version;
+       << "file version: " << file_metadata_->version;
     return Status(ss.str());
   }
 
   // Parse out the created by application version string
-  if (file_metadata_.__isset.created_by) {
-    file_version_ = FileVersion(file_metadata_.created_by);
+  if (file_metadata_->__isset.created_by) {
+    file_version_ = FileVersion(file_metadata_->created_by);
   }
   return Status::OK();
 }
@@ -3058,11 +4434,11 @@ Status HdfsParquetScanner::ValidateColumn(
     const BaseScalarColumnReader& col_reader, int row_group_idx) {
   int col_idx = col_reader.col_idx();
   const parquet::SchemaElement& schema_element = col_reader.schema_element();
-  parquet::ColumnChunk& file_data =
-      file_metadata_.row_groups[row_group_idx].columns[col_idx];
+  const parquet::ColumnChunk& file_data =
+      file_metadata_->row_groups[row_group_idx].columns[col_idx];
 
   // Check the encodings are supported.
-  vector<parquet::Encoding::type>& encodings = file_data.meta_data.encodings;
+  const vector<parquet::Encoding::type>& encodings = file_data.meta_data.encodings;
   for (int i = 0; i < encodings.size(); ++i) {
     if (!IsEncodingSupported(encodings[i])) {
       stringstream ss;
@@ -3180,7 +4556,7 @@ Status HdfsParquetScanner::ValidateEndOfRowGroup(
     // These column readers materialize table-level values (vs. collection values). Test
     // if the expected number of rows from the file metadata matches the actual number of
     // rows read from the file.
-    int64_t expected_rows_in_group = file_metadata_.row_groups[row_group_idx].num_rows;
+    int64_t expected_rows_in_group = file_metadata_->row_groups[row_group_idx].num_rows;
     if (rows_read != expected_rows_in_group) {
       return Status(TErrorCode::PARQUET_GROUP_ROW_COUNT_ERROR, filename(), row_group_idx,
           expected_rows_in_group, rows_read);
@@ -16,15 +16,24 @@
 #ifndef IMPALA_EXEC_HDFS_PARQUET_SCANNER_H
 #define IMPALA_EXEC_HDFS_PARQUET_SCANNER_H
 
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
 #include "exec/hdfs-scanner.h"
+#include "exec/parquet-column-stats.h"
 #include "exec/parquet-common.h"
+#include "util/lru-cache.h"
 #include "util/runtime-profile-counters.h"
 
 namespace impala {
 
+class BloomFilter;
 class CollectionValueBuilder;
 struct HdfsFileDesc;
+class MinMaxFilter;
+class RuntimeFilter;
 struct ScratchTupleBatch;
+class TopNFilter;
 
 /// This scanner parses Parquet files located in HDFS, and writes the content as tuples in
 /// the Impala in-memory representation of data, e.g.  (tuples, rows, row batches).
@@ -294,13 +303,78 @@ struct ScratchTupleBatch;
 /// TODO: Populating CollectionValues in a column-wise fashion seems different enough
 /// and less critical for most of our users today to defer this task until later.
 ///
+/// ---- Row group statistics ----
+/// Before issuing the column ranges of a row group, ProcessSplit() evaluates conjuncts of
+/// the form '<slot> <op> <constant>' against the min/max statistics stored in the
+/// ColumnMetaData of the row group (see InitStatsConjuncts()). Row groups that cannot
+/// contain any passing rows are skipped without reading their column data.
+///
+/// ---- Page statistics ----
+/// The same conjuncts are evaluated against the min/max statistics in the header of each
+/// data page of the column they reference (see InitPageFilters()). Pages that cannot
+/// contain any passing rows are skipped without decompressing or decoding them, and
+/// their rows are marked as rejected in the scratch batch. With late materialization the
+/// other columns then only skip over the values of these rows. HdfsParquetTableWriter
+/// writes the page statistics for the types supported by ParquetColumnStats.
+///
+/// ---- Bloom filters ----
+/// If the writer stored a bloom filter for a column chunk (see ParquetBloomFilter),
+/// ProcessSplit() reads it before issuing the column ranges of the row group. The row
+/// group is skipped if the filter contains none of the constants of an equality or IN
+/// predicate on the column, or if it is disjoint from an arrived runtime filter on the
+/// column (see EvalBloomFilters()).
+///
+/// ---- Dictionary filtering ----
+/// Conjuncts that only reference a single top-level scalar slot are evaluated once per
+/// entry of the dictionary of the slot's column chunk, after the dictionary page has been
+/// read (see EvalDictFilters()). The result is a bitmap of passing dictionary entries.
+/// If the column chunk is entirely dictionary encoded and no entry (or NULL) passes, the
+/// row group is skipped. Otherwise the column reader checks the dictionary index of every
+/// value it materializes and flags the scratch tuples whose values cannot pass, so that
+/// TransferScratchTuples() drops them without evaluating any conjuncts. Surviving tuples
+/// are still evaluated against all conjuncts, so pages that are not dictionary encoded
+/// are handled correctly.
+///
+/// ---- Late materialization ----
+/// If some conjuncts only reference slots of top-level columns (or partition keys), the
+/// columns referenced by these 'filter conjuncts' are materialized first and the filter
+/// conjuncts are evaluated against the scratch tuples (see InitLateMaterialization()).
+/// The remaining scalar columns then skip over the values of the rejected tuples instead
+/// of materializing them. This saves most of the decoding work for wide projections with
+/// selective predicates. The remaining conjuncts and the runtime filters are evaluated in
+/// TransferScratchTuples().
+///
+/// ---- Footer cache ----
+/// The deserialized FileMetaData of a file and the schema tree built from it are kept in
+/// a process-wide, byte-bounded LRU cache keyed by the file's path, modification time and
+/// length (see ProcessFooter()). If the footer of a file is cached, IssueInitialRanges()
+/// only reads the fixed-size end of the file instead of FOOTER_SIZE bytes and the Thrift
+/// deserialization is skipped. Cached entries are immutable and shared by all scanners
+/// of the file.
+///
+/// ---- Parallel column decoding ----
+/// If the scan node has a column decode pool (see --num_column_decode_threads), the
+/// top-level scalar column readers that come after the filter readers decode each
+/// scratch batch concurrently (see DecodeColumnsInParallel()). Each reader writes a
+/// disjoint set of slots of the scratch tuples and stages the state that it would
+/// otherwise share with other readers, i.e. its errors, the memory it hands to the
+/// scratch batch and the null indicators. The scanner thread stitches the staged state
+/// into the scratch batch once all readers are done. This lets a single split of a wide
+/// table use more than one core.
+///
 /// ---- Runtime filters ----
 /// HdfsParquetScanner is able to apply runtime filters that arrive before or during
 /// scanning. Filters are applied at both the row group (see AssembleRows()) and row (see
 /// ReadRow()) scope. If all filter predicates do not pass, the row or row group will be
 /// excluded from output. Only partition-column filters are applied at AssembleRows(). The
 /// FilterContexts for these filters are cloned from the parent scan node and attached to
-/// the ScannerContext.
+/// the ScannerContext. Filters that arrived with a min/max filter are also checked
+/// against the column chunk statistics before the column ranges of a row group are
+/// issued (see RowGroupPassesMinMaxFilters()).
+///
+/// The TopNFilters of a parent TopNNode (see HdfsScanNode::AddTopNFilter()) are applied
+/// in the same way: their current bound is checked against the column chunk statistics
+/// of each row group and against the tuples of each scratch batch.
 class HdfsParquetScanner : public HdfsScanner {
  public:
   HdfsParquetScanner(HdfsScanNode* scan_node, RuntimeState* state);
@@ -315,6 +389,10 @@ class HdfsParquetScanner : public HdfsScanner {
   static Status IssueInitialRanges(HdfsScanNode* scan_node,
                                    const std::vector<HdfsFileDesc*>& files);
 
+  /// Returns true if --parquet_row_sample_percent makes the scanners keep only a
+  /// Bernoulli sample of the rows of each row group.
+  static bool SamplesRows();
+
   struct FileVersion {
     /// Application that wrote the file. e.g. "IMPALA"
     std::string application;
@@ -380,6 +458,42 @@ class HdfsParquetScanner : public HdfsScanner {
     }
   };
 
+  /// Deserialized file metadata of a file together with the schema tree built from it.
+  /// Shared between scanners through the footer cache and never modified once created.
+  struct FileMetadataEntry {
+    parquet::FileMetaData file_metadata;
+
+    /// The root schema node. The schema elements of the nodes point into
+    /// 'file_metadata.schema'.
+    SchemaNode schema;
+  };
+
+  /// Identifies a version of a file in the footer cache.
+  struct FooterCacheKey {
+    std::string filename;
+    int64_t mtime;
+    int64_t file_length;
+
+    FooterCacheKey(const std::string& filename, int64_t mtime, int64_t file_length)
+      : filename(filename), mtime(mtime), file_length(file_length) { }
+
+    bool operator<(const FooterCacheKey& other) const {
+      if (mtime != other.mtime) return mtime < other.mtime;
+      if (file_length != other.file_length) return file_length < other.file_length;
+      return filename < other.filename;
+    }
+  };
+
+  typedef LruCache<FooterCacheKey, boost::shared_ptr<const FileMetadataEntry> >
+      FooterCache;
+
+  /// Returns the process-wide footer cache, or NULL if it is disabled.
+  static FooterCache* footer_cache();
+
+  /// Returns an estimate of the number of bytes used by 'entry', which was deserialized
+  /// from 'serialized_size' bytes. Used as the charge of the entry in the footer cache.
+  static int64_t EstimateFootprint(const FileMetadataEntry& entry, int serialized_size);
+
   /// Size of the file footer.  This is a guess.  If this value is too little, we will
   /// need to issue another read.
   static const int64_t FOOTER_SIZE;
@@ -449,8 +563,12 @@ class HdfsParquetScanner : public HdfsScanner {
   /// top-level tuples. See AssembleRows().
   boost::scoped_ptr<ScratchTupleBatch> scratch_batch_;
 
-  /// File metadata thrift object
-  parquet::FileMetaData file_metadata_;
+  /// File metadata and schema tree of this file, either deserialized by this scanner or
+  /// shared with other scanners through the footer cache. Set in ProcessFooter().
+  boost::shared_ptr<const FileMetadataEntry> file_metadata_entry_;
+
+  /// File metadata thrift object. Points into 'file_metadata_entry_'.
+  const parquet::FileMetaData* file_metadata_;
 
   /// Version of the application that wrote this file.
   FileVersion file_version_;
@@ -466,7 +584,7 @@ class HdfsParquetScanner : public HdfsScanner {
   boost::scoped_ptr<MemPool> dictionary_pool_;
 
   /// Timer for materializing rows.  This ignores time getting the next buffer.
-  ScopedTimer<MonotonicStopWatch> assemble_rows_timer_;
+  ScopedTimer<TscStopWatch> assemble_rows_timer_;
 
   /// Number of columns that need to be read.
   RuntimeProfile::Counter* num_cols_counter_;
@@ -474,6 +592,137 @@ class HdfsParquetScanner : public HdfsScanner {
   /// Number of row groups that need to be read.
   RuntimeProfile::Counter* num_row_groups_counter_;
 
+  /// Number of row groups that were skipped because the column statistics showed that
+  /// no row could pass the stats conjuncts.
+  RuntimeProfile::Counter* num_row_groups_skipped_counter_;
+
+  /// A conjunct of the form '<slot> <op> <constant>' on a top-level, non-repeated scalar
+  /// slot, which can be evaluated against the min/max statistics of a column chunk.
+  struct StatsConjunct {
+    /// The slot referenced by the conjunct.
+    const SlotDescriptor* slot_desc;
+
+    /// Index into parquet::RowGroup::columns of the column chunk for 'slot_desc'.
+    int col_idx;
+
+    /// Comparison operator, normalized so that the slot is the left operand.
+    ParquetColumnStats::PredicateOp op;
+
+    /// The constant operand, stored in the slot representation of slot_desc->type().
+    /// Only fixed-width types supported by ParquetColumnStats are used, which all fit
+    /// into 8 bytes.
+    uint8_t value[8];
+  };
+
+  /// Conjuncts that can be evaluated against column statistics to skip row groups.
+  /// Populated per file in InitStatsConjuncts().
+  std::vector<StatsConjunct> stats_conjuncts_;
+
+  /// Number of row groups that were skipped because no dictionary entry of a column
+  /// passed the conjuncts on that column.
+  RuntimeProfile::Counter* num_dict_filtered_row_groups_counter_;
+
+  /// The conjuncts that only reference the slot materialized by 'reader' and that can be
+  /// evaluated against the entries of the reader's dictionary.
+  struct DictFilterConjuncts {
+    BaseScalarColumnReader* reader;
+    std::vector<ExprContext*> conjunct_ctxs;
+  };
+
+  /// Populated per file in InitDictFilterConjuncts().
+  std::vector<DictFilterConjuncts> dict_filter_conjuncts_;
+
+  /// Number of data pages that were skipped because their statistics showed that no row
+  /// can pass the conjuncts.
+  RuntimeProfile::Counter* num_stats_filtered_pages_counter_;
+
+  /// True if any column reader of the current file has a page filter, see
+  /// InitPageFilters().
+  bool has_page_filters_;
+
+  /// Rows of a row group are kept by the row sample if the next value of
+  /// 'sample_rng_state_' is below this. 0 if rows are not sampled.
+  uint64_t row_sample_threshold_;
+
+  /// State of the xorshift generator of the row sample. Seeded per row group in
+  /// AssembleRows() from the file name, the row group and --hdfs_scan_sample_seed, so
+  /// that scanning a row group again yields the same sample.
+  uint64_t sample_rng_state_;
+
+  /// A probe of the bloom filter of a column chunk for a conjunct or a runtime filter.
+  struct BloomFilterProbe {
+    /// Index into parquet::RowGroup::columns of the probed column chunk.
+    int col_idx;
+
+    /// Hashes of the constants of an equality or IN conjunct. Rows can only pass if the
+    /// bloom filter contains at least one of them.
+    std::vector<uint32_t> hashes;
+
+    /// Runtime filter on the column, or NULL. Rows can only pass if the bloom filter
+    /// may intersect with it. The probe is ignored until the runtime filter arrives.
+    const RuntimeFilter* runtime_filter;
+  };
+
+  /// Populated per file in InitBloomFilterProbes(), sorted by 'col_idx'.
+  std::vector<BloomFilterProbe> bloom_filter_probes_;
+
+  /// Number of row groups that were skipped because of their bloom filters.
+  RuntimeProfile::Counter* num_bloom_filtered_row_groups_counter_;
+
+  /// A runtime filter on a top-level, non-repeated scalar column. Once the filter has
+  /// arrived with a min/max filter, its range is checked against the column chunk
+  /// statistics.
+  struct MinMaxFilterProbe {
+    const RuntimeFilter* filter;
+
+    /// The slot the filter is applied to.
+    const SlotDescriptor* slot_desc;
+
+    /// Index into parquet::RowGroup::columns of the column chunk for 'slot_desc'.
+    int col_idx;
+  };
+
+  /// Populated per file in InitMinMaxFilterProbes().
+  std::vector<MinMaxFilterProbe> min_max_filter_probes_;
+
+  /// Number of row groups that were skipped because their statistics did not overlap
+  /// with the range of a min/max runtime filter.
+  RuntimeProfile::Counter* num_min_max_filtered_row_groups_counter_;
+
+  /// A TopNFilter on a top-level, non-repeated scalar column whose bound is checked
+  /// against the column chunk statistics.
+  struct TopNFilterProbe {
+    const TopNFilter* filter;
+    const SlotDescriptor* slot_desc;
+
+    /// Index into parquet::RowGroup::columns of the column chunk for 'slot_desc'.
+    int col_idx;
+  };
+
+  /// Populated per file in InitMinMaxFilterProbes().
+  std::vector<TopNFilterProbe> topn_filter_probes_;
+
+  /// Number of row groups and rows that were skipped because of the TopNFilters.
+  RuntimeProfile::Counter* num_topn_filtered_row_groups_counter_;
+  RuntimeProfile::Counter* num_topn_filtered_rows_counter_;
+
+  /// Tuple that dictionary entries are written into to evaluate the dictionary filter
+  /// conjuncts. Allocated from 'dictionary_pool_'.
+  Tuple* dict_filter_tuple_;
+
+  /// Number of readers at the beginning of 'column_readers_' that materialize the slots
+  /// referenced by 'filter_conjunct_ctxs_'. 0 if late materialization is not used for
+  /// the current file.
+  int num_filter_readers_;
+
+  /// Conjuncts that are evaluated once the first 'num_filter_readers_' column readers
+  /// have materialized a scratch batch. Empty if late materialization is not used.
+  std::vector<ExprContext*> filter_conjunct_ctxs_;
+
+  /// Conjuncts that are evaluated in TransferScratchTuples(), i.e. all conjuncts that
+  /// are not in 'filter_conjunct_ctxs_'.
+  std::vector<ExprContext*> remaining_conjunct_ctxs_;
+
   const char* filename() const { return metadata_range_->file(); }
 
   /// Reads data using 'column_readers' to materialize top-level tuples.
@@ -496,6 +745,30 @@ class HdfsParquetScanner : public HdfsScanner {
   bool AssembleRows(const std::vector<ColumnReader*>& column_readers,
       int row_group_idx, bool* filters_pass);
 
+  /// State of one call to DecodeColumnsInParallel() that is shared with the decoding
+  /// threads. Defined in the .cc file.
+  struct ParallelDecodeState;
+
+  /// Protects the scanner state that column readers share while they decode in
+  /// parallel, i.e. 'dictionary_pool_' and 'level_cache_pool_'.
+  boost::mutex column_decode_lock_;
+
+  /// Returns true if 'col_reader' can decode the current row group in parallel with
+  /// other readers.
+  static bool CanDecodeInParallel(ColumnReader* col_reader);
+
+  /// Materializes the next batch of top-level values of 'readers' into the tuples of
+  /// 'scratch_batch_', decoding the readers concurrently on the threads of the scan
+  /// node's column decode pool and on the calling thread. Sets the number of tuples of
+  /// the scratch batch. All readers must satisfy CanDecodeInParallel(). Returns false
+  /// if execution should be aborted, like AssembleRows(). Errors are merged into
+  /// parse_status_.
+  bool DecodeColumnsInParallel(const std::vector<BaseScalarColumnReader*>& readers);
+
+  /// Claims and decodes the readers of 'state' until none are left. Runs on the
+  /// decoding threads and on the scanner thread.
+  static void DecodeColumns(const boost::shared_ptr<ParallelDecodeState>& state);
+
   /// Evaluates runtime filters and conjuncts (if any) against the tuples in
   /// 'scratch_batch_', and adds the surviving tuples to the output batch.
   /// Transfers the ownership of tuple memory to the output batch when the
@@ -503,10 +776,91 @@ class HdfsParquetScanner : public HdfsScanner {
   /// Returns the number of rows that should be committed to the output batch.
   int TransferScratchTuples();
 
-  /// Evaluates runtime filters (if any) against the given row. Returns true if
-  /// they passed, false otherwise. Maintains the runtime filter stats, determines
-  /// whether the filters are effective, and disables them if they are not.
-  bool EvalRuntimeFilters(TupleRow* row);
+  /// Populates 'stats_conjuncts_' with the scanner conjuncts that can be evaluated
+  /// against the column statistics of 'file_metadata_'. Must be called after the schema
+  /// of the file has been resolved.
+  void InitStatsConjuncts();
+
+  /// Returns false if the min/max statistics of 'row_group' prove that no row of the
+  /// row group can pass 'stats_conjuncts_', true otherwise.
+  bool RowGroupPassesStatsConjuncts(const parquet::RowGroup& row_group) const;
+
+  /// Returns the descriptor of the slot 'slot_id' of the scan tuple if it materializes a
+  /// non-repeated scalar column of the file, and sets *col_idx to the index of the column
+  /// chunk in the row groups. Returns NULL otherwise.
+  const SlotDescriptor* ResolveScalarSlot(SlotId slot_id, int* col_idx);
+
+  /// Populates 'min_max_filter_probes_' and 'topn_filter_probes_' with the runtime
+  /// filters and TopNFilters on columns whose statistics can be read by
+  /// ParquetColumnStats. Must be called after the schema of the file has been resolved.
+  void InitMinMaxFilterProbes();
+
+  /// Returns false if the min/max statistics of 'row_group' prove that none of its values
+  /// is in the range of an arrived min/max runtime filter, true otherwise.
+  bool RowGroupPassesMinMaxFilters(const parquet::RowGroup& row_group) const;
+
+  /// Returns false if the min/max statistics of 'row_group' prove that none of its rows
+  /// passes the current bound of a TopNFilter, true otherwise.
+  bool RowGroupPassesTopNFilters(const parquet::RowGroup& row_group) const;
+
+  /// Returns false if the statistics of 'col_chunk' prove that none of its values of
+  /// 'type' passes 'filter', true otherwise.
+  static bool ColumnChunkMayPass(const MinMaxFilter& filter, const ColumnType& type,
+      const parquet::ColumnChunk& col_chunk);
+
+  /// Populates 'bloom_filter_probes_' with the equality and IN conjuncts and the runtime
+  /// filters that can be probed against the bloom filters of the column chunks. Must be
+  /// called after the schema of the file has been resolved.
+  void InitBloomFilterProbes();
+
+  /// Reads the bloom filters of the column chunks of 'row_group' that are referenced by
+  /// 'bloom_filter_probes_'. Sets *skip_row_group to true if the probes show that no row
+  /// of the row group can pass.
+  Status EvalBloomFilters(const parquet::RowGroup& row_group, bool* skip_row_group);
+
+  /// Splits the scanner conjuncts into 'filter_conjunct_ctxs_' and
+  /// 'remaining_conjunct_ctxs_' and moves the readers for the slots referenced by the
+  /// filter conjuncts to the front of 'column_readers_'. Configures the other scalar
+  /// readers to skip the values of rejected tuples. Must be called after the column
+  /// readers have been created.
+  void InitLateMaterialization();
+
+  /// Sets a page filter on each top-level scalar reader that materializes a slot of
+  /// 'stats_conjuncts_' and does not skip rejected tuples, see
+  /// BaseScalarColumnReader::SetPageFilter(). Sets 'has_page_filters_'. Must be called
+  /// after InitLateMaterialization().
+  void InitPageFilters();
+
+  /// Evaluates 'filter_conjunct_ctxs_' against the tuples of 'scratch_batch_' that have
+  /// not been rejected yet and marks the failing tuples as rejected.
+  void EvalFilterConjuncts();
+
+  /// Populates 'dict_filter_conjuncts_' for the top-level scalar column readers in
+  /// 'column_readers_'. Must be called after the column readers have been created.
+  void InitDictFilterConjuncts();
+
+  /// Reads the dictionary pages of the column chunks of 'row_group' that have dictionary
+  /// filter conjuncts, evaluates the conjuncts against the dictionary entries and sets
+  /// the resulting dictionary filters on the column readers. Sets 'skip_row_group' to
+  /// true if the dictionary of an entirely dictionary encoded column chunk proves that no
+  /// row of the row group can pass the conjuncts. Must be called after InitColumns().
+  Status EvalDictFilters(const parquet::RowGroup& row_group, bool* skip_row_group);
+
+  /// Evaluates the runtime filters against the tuples of the scratch batch that were
+  /// not rejected yet, one filter at a time with RuntimeFilter::EvalBatch(), and marks
+  /// the tuples that do not pass in the rejected tuples of the scratch batch. Maintains
+  /// the runtime filter stats, determines whether the filters are effective, and
+  /// disables them if they are not. Must be called after the scratch batch was
+  /// populated and before its tuples are transferred.
+  void EvalRuntimeFilters();
+
+  /// Marks the tuples of the scratch batch that do not pass the current bound of a
+  /// TopNFilter as rejected. Must be called at the same point as EvalRuntimeFilters().
+  void EvalTopNFilters();
+
+  /// Marks the tuples of the scratch batch that are not in the row sample as rejected.
+  /// Must be called before EvalRuntimeFilters().
+  void SampleScratchTuples();
 
   /// Reads data using 'column_readers' to materialize the tuples of a CollectionValue
   /// allocated from 'coll_value_builder'.
@@ -542,10 +896,23 @@ class HdfsParquetScanner : public HdfsScanner {
   Status ValidateColumnOffsets(const parquet::RowGroup& row_group);
 
   /// Process the file footer and parse file_metadata_.  This should be called with the
-  /// last FOOTER_SIZE bytes in context_.
+  /// last FOOTER_SIZE bytes in context_, or fewer if the footer is in the footer cache.
+  /// Reads the remaining bytes of the footer if the footer turns out to be larger than
+  /// the bytes in context_ and it is not cached.
   /// *eosr is a return value.  If true, the scan range is complete (e.g. select count(*))
   Status ProcessFooter(bool* eosr);
 
+  /// Deserializes the 'metadata_size' bytes of file metadata that end at the metadata
+  /// length in the footer into 'file_metadata'. 'metadata_ptr' points to the start of the
+  /// metadata if it is within the 'remaining_bytes_buffered' bytes of the footer before
+  /// the metadata length. Otherwise the metadata is read from the file.
+  Status ReadFileMetadata(uint8_t* metadata_ptr, uint32_t metadata_size,
+      int remaining_bytes_buffered, parquet::FileMetaData* file_metadata);
+
+  /// Reads the 'len' bytes at 'offset' of the file into 'buffer' with synchronous reads
+  /// from the IoMgr, using the same disk and caching options as 'metadata_range_'.
+  Status ReadFileBytes(int64_t offset, int64_t len, uint8_t* buffer);
+
   /// Populates 'column_readers' for the slots in 'tuple_desc', including creating child
   /// readers for any collections. Schema resolution is handled in this function as
   /// well. Fills in the appropriate template tuple slot with NULL for any materialized
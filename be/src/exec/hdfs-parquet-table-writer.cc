@@ -15,6 +15,8 @@
 #include "exec/hdfs-parquet-table-writer.h"
 
 #include "common/version.h"
+#include "exec/parquet-bloom-filter.h"
+#include "exec/parquet-column-stats.h"
 #include "exprs/expr.h"
 #include "exprs/expr-context.h"
 #include "runtime/decimal-value.h"
@@ -25,15 +27,20 @@
 #include "runtime/string-value.inline.h"
 #include "util/bit-stream-utils.h"
 #include "util/bit-util.h"
+#include "util/bloom-filter.h"
 #include "util/buffer-builder.h"
 #include "util/compress.h"
 #include "util/debug-util.h"
 #include "util/dict-encoding.h"
 #include "util/hdfs-util.h"
+#include "util/promise.h"
 #include "util/rle-encoding.h"
+#include "util/thread-pool.h"
 #include "rpc/thrift-util.h"
 
 #include <sstream>
+#include <boost/algorithm/string.hpp>
+#include <boost/bind.hpp>
 
 #include "gen-cpp/ImpalaService_types.h"
 
@@ -42,6 +49,21 @@ using namespace impala;
 using namespace parquet;
 using namespace apache::thrift;
 
+DEFINE_double(parquet_min_dictionary_compression_ratio, 1.0, "(Advanced) The Parquet "
+    "writer falls back from dictionary to PLAIN encoding for the rest of a column chunk "
+    "once the PLAIN encoded size of the values written so far divided by the size of "
+    "their dictionary encoding (including the dictionary) drops below this ratio. A "
+    "value <= 0 only falls back when the dictionary is full.");
+DEFINE_string(parquet_bloom_filter_columns, "", "(Advanced) Comma-separated list of "
+    "column names for which the Parquet writer stores a bloom filter of the values of "
+    "each column chunk. Scans use them to skip row groups for equality and IN "
+    "predicates and for runtime filters. Only integer columns are supported.");
+DEFINE_int32(parquet_bloom_filter_max_bytes, 1024 * 1024, "(Advanced) Maximum size of a "
+    "Parquet bloom filter. Filters are shrunk to the size needed for the number of "
+    "distinct values of the column chunk.");
+DEFINE_double(parquet_bloom_filter_fpp, 0.05, "(Advanced) Target false positive "
+    "probability of Parquet bloom filters.");
+
 // Managing file sizes: We need to estimate how big the files being buffered
 // are in order to split them correctly in HDFS. Having a file that is too big
 // will cause remote reads (parquet files are non-splittable).
@@ -89,6 +111,9 @@ class HdfsParquetTableWriter::BaseColumnWriter {
       page_size_(DEFAULT_DATA_PAGE_SIZE), current_page_(NULL), num_values_(0),
       total_compressed_byte_size_(0),
       total_uncompressed_byte_size_(0),
+      has_plain_encoded_values_(false),
+      pending_page_idx_(-1),
+      pending_compressed_len_(0),
       dict_encoder_base_(NULL),
       def_levels_(NULL),
       values_buffer_len_(DEFAULT_DATA_PAGE_SIZE) {
@@ -124,16 +149,20 @@ class HdfsParquetTableWriter::BaseColumnWriter {
   // Any data for previous row groups must be reset (e.g. dictionaries).
   // Subclasses must call this if they override this function.
   virtual void Reset() {
+    DCHECK(pending_compression_.get() == NULL);
     num_data_pages_ = 0;
     current_page_ = NULL;
     num_values_ = 0;
     total_compressed_byte_size_ = 0;
     current_encoding_ = Encoding::PLAIN;
+    has_plain_encoded_values_ = false;
   }
 
   // Close this writer. This is only called after Flush() and no more rows will
   // be added.
   void Close() {
+    // The compressor may still be in use by a compression thread.
+    WaitForPendingCompression();
     if (compressor_.get() != NULL) compressor_->Close();
     if (dict_encoder_base_ != NULL) dict_encoder_base_->ClearIndices();
   }
@@ -142,6 +171,7 @@ class HdfsParquetTableWriter::BaseColumnWriter {
   uint64_t num_values() const { return num_values_; }
   uint64_t total_compressed_size() const { return total_compressed_byte_size_; }
   uint64_t total_uncompressed_size() const { return total_uncompressed_byte_size_; }
+  bool has_plain_encoded_values() const { return has_plain_encoded_values_; }
   parquet::CompressionCodec::type codec() const {
     return IMPALA_TO_PARQUET_CODEC[codec_];
   }
@@ -160,9 +190,46 @@ class HdfsParquetTableWriter::BaseColumnWriter {
   // Encodes out all data for the current page and updates the metadata.
   virtual void FinalizeCurrentPage();
 
+  // Sets the min/max statistics of the values of the current page in 'header' and
+  // resets them for the next page. Does nothing if the writer does not track statistics
+  // for its type.
+  virtual void EncodePageStats(DataPageHeader* header) { }
+
+  // Sets the min/max statistics and null count of all values of the current row group
+  // in 'meta_data'. Does nothing if the writer does not track statistics for its type.
+  virtual void EncodeRowGroupStats(ColumnMetaData* meta_data) { }
+
+  // Builds a bloom filter of the values of each column chunk. Ignored for types that
+  // ParquetBloomFilter does not support. Must be called before the first Reset().
+  virtual void EnableBloomFilter() { }
+
+  // Writes the bloom filter of the current row group at *file_pos, records its location
+  // in 'meta_data' and advances *file_pos. Must be called after Flush(). Does nothing if
+  // no bloom filter is built.
+  virtual Status FlushBloomFilter(int64_t* file_pos, ColumnMetaData* meta_data) {
+    return Status::OK();
+  }
+
   // Update current_page_ to a new page, reusing pages allocated if possible.
   void NewPage();
 
+  // Hands off the compression of the finalized 'current_page_', whose uncompressed data
+  // is in 'async_uncompressed_buffer_', to the sink's compression thread pool. The page
+  // is compressed on the calling thread if the pool does not accept it.
+  void StartPageCompression(int64_t max_compressed_size);
+
+  // Compresses the pending page into 'async_compressed_buffer_'. Called from a
+  // compression thread.
+  void CompressPendingPage();
+
+  // Waits for the pending page compression, if any, and completes the metadata of the
+  // page. Returns the error of any failed page compression of this column.
+  Status WaitForPendingCompression();
+
+  // Serializes the header of the finalized 'page' and adds its final sizes to the
+  // totals and the file size estimate.
+  void UpdateFinalizedPageSizes(DataPage* page);
+
   // Writes out the dictionary encoded data buffered in dict_encoder_.
   void WriteDictDataPage();
 
@@ -213,6 +280,25 @@ class HdfsParquetTableWriter::BaseColumnWriter {
   int64_t total_uncompressed_byte_size_;
   Encoding::type current_encoding_;
 
+  // True if any data page with non-NULL values in the current row group was written
+  // with PLAIN encoding. Readers rely on the absence of PLAIN in the column metadata
+  // to detect column chunks that are entirely dictionary encoded.
+  bool has_plain_encoded_values_;
+
+  // Pages are compressed by the sink's compression thread pool if one is available, so
+  // that encoding the next page overlaps with compressing the previous one. At most one
+  // page per column is compressed at a time, since 'compressor_' is not thread-safe and
+  // the buffers below are reused for the next page. 'pending_compression_' is set while
+  // the page with index 'pending_page_idx_' is compressed and is set by the compression
+  // thread when it finishes. 'pending_compressed_len_' and 'compression_status_' are
+  // only read after that.
+  boost::scoped_ptr<Promise<bool> > pending_compression_;
+  int pending_page_idx_;
+  int pending_compressed_len_;
+  Status compression_status_;
+  vector<uint8_t> async_uncompressed_buffer_;
+  vector<uint8_t> async_compressed_buffer_;
+
   // Created and set by the base class.
   DictEncoderBase* dict_encoder_base_;
 
@@ -235,7 +321,13 @@ class HdfsParquetTableWriter::ColumnWriter :
  public:
   ColumnWriter(HdfsParquetTableWriter* parent, ExprContext* ctx,
       const THdfsCompression::type& codec) : BaseColumnWriter(parent, ctx, codec),
-      num_values_since_dict_size_check_(0) {
+      num_values_since_dict_size_check_(0),
+      dict_plain_encoded_size_(0),
+      dict_data_encoded_size_(0),
+      has_stats_(ParquetColumnStats::IsSupportedType(ctx->root()->type())),
+      row_group_null_count_(0),
+      bloom_filter_log_space_(0),
+      num_plain_encoded_values_(0) {
     DCHECK_NE(ctx->root()->type().type, TYPE_BOOLEAN);
     encoded_value_size_ = ParquetPlainEncoder::ByteSize(ctx->root()->type());
   }
@@ -248,6 +340,45 @@ class HdfsParquetTableWriter::ColumnWriter :
     dict_encoder_.reset(
         new DictEncoder<T>(parent_->per_file_mem_pool_.get(), encoded_value_size_));
     dict_encoder_base_ = dict_encoder_.get();
+    dict_plain_encoded_size_ = 0;
+    dict_data_encoded_size_ = 0;
+    page_stats_.Reset();
+    row_group_stats_.Reset();
+    row_group_null_count_ = 0;
+    if (bloom_filter_log_space_ > 0) {
+      bloom_filter_.reset(new BloomFilter(bloom_filter_log_space_));
+    }
+    num_plain_encoded_values_ = 0;
+  }
+
+  virtual void EnableBloomFilter() {
+    if (!ParquetBloomFilter::IsSupportedType(type())) return;
+    // The filter is built with the maximum size and folded to the size needed for the
+    // NDV of the column chunk when it is written.
+    bloom_filter_log_space_ = ParquetBloomFilter::MIN_LOG_HEAP_SPACE;
+    while (bloom_filter_log_space_ < ParquetBloomFilter::MAX_LOG_HEAP_SPACE &&
+        (1LL << (bloom_filter_log_space_ + 1)) <= FLAGS_parquet_bloom_filter_max_bytes) {
+      ++bloom_filter_log_space_;
+    }
+  }
+
+  virtual Status FlushBloomFilter(int64_t* file_pos, ColumnMetaData* meta_data) {
+    if (bloom_filter_.get() == NULL) return Status::OK();
+    // The dictionary holds all distinct values unless the writer fell back to PLAIN.
+    // Each PLAIN encoded value is counted as distinct, which can only overestimate.
+    int64_t ndv = dict_encoder_->num_entries() + num_plain_encoded_values_;
+    int log_space = min(bloom_filter_log_space_, max<int>(
+        ParquetBloomFilter::MIN_LOG_HEAP_SPACE,
+        BloomFilter::MinLogSpace(ndv, FLAGS_parquet_bloom_filter_fpp)));
+    TBloomFilter thrift_filter;
+    bloom_filter_->FoldToThrift(log_space, &thrift_filter);
+    RETURN_IF_ERROR(parent_->Write(thrift_filter.directory.data(),
+        thrift_filter.directory.size()));
+    meta_data->__isset.key_value_metadata = true;
+    meta_data->key_value_metadata.push_back(
+        ParquetBloomFilter::EncodeLocation(*file_pos, thrift_filter.log_heap_space));
+    *file_pos += thrift_filter.directory.size();
+    return Status::OK();
   }
 
  protected:
@@ -259,7 +390,8 @@ class HdfsParquetTableWriter::ColumnWriter :
         if (dict_encoder_->EstimatedDataEncodedSize() >= page_size_) return false;
       }
       ++num_values_since_dict_size_check_;
-      *bytes_needed = dict_encoder_->Put(*CastValue(value));
+      T* v = CastValue(value);
+      *bytes_needed = dict_encoder_->Put(*v);
       // If the dictionary contains the maximum number of values, switch to plain
       // encoding.  The current dictionary encoded page is written out.
       if (UNLIKELY(*bytes_needed < 0)) {
@@ -268,6 +400,8 @@ class HdfsParquetTableWriter::ColumnWriter :
         return false;
       }
       parent_->file_size_estimate_ += *bytes_needed;
+      dict_plain_encoded_size_ += encoded_value_size_ < 0 ?
+          ParquetPlainEncoder::ByteSize<T>(*v) : encoded_value_size_;
     } else if (current_encoding_ == Encoding::PLAIN) {
       T* v = CastValue(value);
       *bytes_needed = encoded_value_size_ < 0 ?
@@ -280,13 +414,56 @@ class HdfsParquetTableWriter::ColumnWriter :
           ParquetPlainEncoder::Encode(dst_ptr, encoded_value_size_, *v);
       DCHECK_EQ(*bytes_needed, written_len);
       current_page_->header.uncompressed_page_size += written_len;
+      ++num_plain_encoded_values_;
     } else {
       // TODO: support other encodings here
       DCHECK(false);
     }
+    if (has_stats_) page_stats_.Update(*CastValue(value));
+    if (bloom_filter_.get() != NULL) {
+      bloom_filter_->Insert(ParquetBloomFilter::Hash(value, type()));
+    }
     return true;
   }
 
+  virtual void FinalizeCurrentPage() {
+    DCHECK(current_page_ != NULL);
+    if (current_page_->finalized) return;
+    bool dict_encoded_page = current_encoding_ == Encoding::PLAIN_DICTIONARY &&
+        current_page_->num_non_null > 0;
+    BaseColumnWriter::FinalizeCurrentPage();
+    if (!dict_encoded_page) return;
+    dict_data_encoded_size_ +=
+        current_page_->header.uncompressed_page_size - current_page_->num_def_bytes;
+    // Stop adding values to the dictionary if it does not pay off compared to PLAIN.
+    // The pages written so far stay dictionary encoded and still need the dictionary.
+    if (FLAGS_parquet_min_dictionary_compression_ratio > 0 &&
+        dict_plain_encoded_size_ < FLAGS_parquet_min_dictionary_compression_ratio *
+        (dict_encoder_->dict_encoded_size() + dict_data_encoded_size_)) {
+      current_encoding_ = Encoding::PLAIN;
+    }
+  }
+
+  virtual void EncodePageStats(DataPageHeader* header) {
+    if (!has_stats_) return;
+    Statistics stats;
+    page_stats_.EncodeToThrift(&stats);
+    int64_t null_count = header->num_values - current_page_->num_non_null;
+    stats.__set_null_count(null_count);
+    header->__set_statistics(stats);
+    row_group_stats_.Merge(page_stats_);
+    row_group_null_count_ += null_count;
+    page_stats_.Reset();
+  }
+
+  virtual void EncodeRowGroupStats(ColumnMetaData* meta_data) {
+    if (!has_stats_) return;
+    Statistics stats;
+    row_group_stats_.EncodeToThrift(&stats);
+    stats.__set_null_count(row_group_null_count_);
+    meta_data->__set_statistics(stats);
+  }
+
  private:
   // The period, in # of rows, to check the estimated dictionary page size against
   // the data page size. We want to start a new data page when the estimated size
@@ -309,6 +486,34 @@ class HdfsParquetTableWriter::ColumnWriter :
   // Temporary string value to hold CHAR(N)
   StringValue temp_;
 
+  // PLAIN encoded size of the values that were dictionary encoded in the current row
+  // group, and the size of the dictionary encoded data pages that hold them. Used to
+  // decide when to fall back to PLAIN encoding.
+  int64_t dict_plain_encoded_size_;
+  int64_t dict_data_encoded_size_;
+
+  // True if the min/max of the values of each page and column chunk are written to the
+  // page header and column metadata. Only the types supported by ParquetColumnStats are
+  // tracked.
+  bool has_stats_;
+
+  // Min/max of the values of the current page.
+  ColumnStats<T> page_stats_;
+
+  // Min/max and number of NULLs of the finalized pages of the current row group.
+  ColumnStats<T> row_group_stats_;
+  int64_t row_group_null_count_;
+
+  // Log2 of the size in bytes that the bloom filter of each column chunk is built with.
+  // 0 if no bloom filters are built for this column.
+  int bloom_filter_log_space_;
+
+  // Bloom filter of the values of the current row group. Recreated in Reset().
+  scoped_ptr<BloomFilter> bloom_filter_;
+
+  // Number of values of the current row group that were PLAIN encoded.
+  int64_t num_plain_encoded_values_;
+
   // Converts a slot pointer to a raw value suitable for encoding
   inline T* CastValue(void* value) {
     return reinterpret_cast<T*>(value);
@@ -435,6 +640,7 @@ Status HdfsParquetTableWriter::BaseColumnWriter::Flush(int64_t* file_pos,
   }
 
   FinalizeCurrentPage();
+  RETURN_IF_ERROR(WaitForPendingCompression());
 
   *first_dictionary_page = -1;
   // First write the dictionary page before any of the data pages.
@@ -525,9 +731,13 @@ void HdfsParquetTableWriter::BaseColumnWriter::FinalizeCurrentPage() {
   if (current_page_->num_non_null == 0) current_encoding_ = Encoding::PLAIN;
 
   if (current_encoding_ == Encoding::PLAIN_DICTIONARY) WriteDictDataPage();
+  if (current_encoding_ == Encoding::PLAIN && current_page_->num_non_null > 0) {
+    has_plain_encoded_values_ = true;
+  }
 
   PageHeader& header = current_page_->header;
   header.data_page_header.encoding = current_encoding_;
+  EncodePageStats(&header.data_page_header);
 
   // Compute size of definition bits
   def_levels_->Flush();
@@ -535,8 +745,15 @@ void HdfsParquetTableWriter::BaseColumnWriter::FinalizeCurrentPage() {
   header.uncompressed_page_size += current_page_->num_def_bytes;
 
   // At this point we know all the data for the data page.  Combine them into one buffer.
+  CallableThreadPool* compression_pool = parent_->parent_->compression_pool();
+  bool compress_async = compressor_.get() != NULL && compression_pool != NULL;
   uint8_t* uncompressed_data = NULL;
-  if (compressor_.get() == NULL) {
+  if (compress_async) {
+    // The buffers are reused, so wait until the previous page of this column is done.
+    WaitForPendingCompression();
+    async_uncompressed_buffer_.resize(header.uncompressed_page_size);
+    uncompressed_data = &async_uncompressed_buffer_[0];
+  } else if (compressor_.get() == NULL) {
     uncompressed_data =
         parent_->per_file_mem_pool_->Allocate(header.uncompressed_page_size);
   } else {
@@ -560,6 +777,10 @@ void HdfsParquetTableWriter::BaseColumnWriter::FinalizeCurrentPage() {
   if (compressor_.get() == NULL) {
     current_page_->data = reinterpret_cast<uint8_t*>(uncompressed_data);
     header.compressed_page_size = header.uncompressed_page_size;
+  } else if (compress_async) {
+    StartPageCompression(compressor_->MaxOutputLen(header.uncompressed_page_size));
+    def_levels_->Clear();
+    return;
   } else {
     SCOPED_TIMER(parent_->parent_->compress_timer());
     int64_t max_compressed_size =
@@ -577,17 +798,64 @@ void HdfsParquetTableWriter::BaseColumnWriter::FinalizeCurrentPage() {
         max_compressed_size - header.compressed_page_size);
   }
 
+  UpdateFinalizedPageSizes(current_page_);
+  def_levels_->Clear();
+}
+
+void HdfsParquetTableWriter::BaseColumnWriter::UpdateFinalizedPageSizes(DataPage* page) {
   // Add the size of the data page header
   uint8_t* header_buffer;
   uint32_t header_len = 0;
-  parent_->thrift_serializer_->Serialize(
-      &current_page_->header, &header_len, &header_buffer);
+  parent_->thrift_serializer_->Serialize(&page->header, &header_len, &header_buffer);
 
+  page->finalized = true;
+  total_compressed_byte_size_ += header_len + page->header.compressed_page_size;
+  total_uncompressed_byte_size_ += header_len + page->header.uncompressed_page_size;
+  parent_->file_size_estimate_ += header_len + page->header.compressed_page_size;
+}
+
+void HdfsParquetTableWriter::BaseColumnWriter::StartPageCompression(
+    int64_t max_compressed_size) {
+  DCHECK(pending_compression_.get() == NULL);
+  DCHECK_GT(max_compressed_size, 0);
+  async_compressed_buffer_.resize(max_compressed_size);
+  pending_page_idx_ = current_page_ - &pages_[0];
+  pending_compression_.reset(new Promise<bool>());
   current_page_->finalized = true;
-  total_compressed_byte_size_ += header_len + header.compressed_page_size;
-  total_uncompressed_byte_size_ += header_len + header.uncompressed_page_size;
-  parent_->file_size_estimate_ += header_len + header.compressed_page_size;
-  def_levels_->Clear();
+  // Until the compressed size is known, the file size estimate conservatively includes
+  // the uncompressed page.
+  parent_->file_size_estimate_ += current_page_->header.uncompressed_page_size;
+  CallableThreadPool* compression_pool = parent_->parent_->compression_pool();
+  if (!compression_pool->Offer(
+      bind<void>(mem_fn(&BaseColumnWriter::CompressPendingPage), this))) {
+    CompressPendingPage();
+  }
+}
+
+void HdfsParquetTableWriter::BaseColumnWriter::CompressPendingPage() {
+  DCHECK(pending_compression_.get() != NULL);
+  {
+    SCOPED_TIMER(parent_->parent_->compress_timer());
+    uint8_t* compressed_data = &async_compressed_buffer_[0];
+    pending_compressed_len_ = async_compressed_buffer_.size();
+    Status status = compressor_->ProcessBlock32(true, async_uncompressed_buffer_.size(),
+        &async_uncompressed_buffer_[0], &pending_compressed_len_, &compressed_data);
+    if (!status.ok() && compression_status_.ok()) compression_status_ = status;
+  }
+  pending_compression_->Set(true);
+}
+
+Status HdfsParquetTableWriter::BaseColumnWriter::WaitForPendingCompression() {
+  if (pending_compression_.get() == NULL) return compression_status_;
+  pending_compression_->Get();
+  pending_compression_.reset();
+  DataPage* page = &pages_[pending_page_idx_];
+  parent_->file_size_estimate_ -= page->header.uncompressed_page_size;
+  page->header.compressed_page_size = pending_compressed_len_;
+  page->data = parent_->per_file_mem_pool_->Allocate(pending_compressed_len_);
+  memcpy(page->data, &async_compressed_buffer_[0], pending_compressed_len_);
+  UpdateFinalizedPageSizes(page);
+  return compression_status_;
 }
 
 void HdfsParquetTableWriter::BaseColumnWriter::NewPage() {
@@ -595,6 +863,7 @@ void HdfsParquetTableWriter::BaseColumnWriter::NewPage() {
     // Reuse an existing page
     current_page_ = &pages_[num_data_pages_++];
     current_page_->header.data_page_header.num_values = 0;
+    current_page_->header.data_page_header.__isset.statistics = false;
     current_page_->header.compressed_page_size = 0;
     current_page_->header.uncompressed_page_size = 0;
   } else {
@@ -619,6 +888,7 @@ HdfsParquetTableWriter::HdfsParquetTableWriter(HdfsTableSink* parent, RuntimeSta
       thrift_serializer_(new ThriftSerializer(true)),
       current_row_group_(NULL),
       row_count_(0),
+      row_group_start_size_estimate_(0),
       file_size_limit_(0),
       reusable_col_mem_pool_(new MemPool(parent_->mem_tracker())),
       per_file_mem_pool_(new MemPool(parent_->mem_tracker())),
@@ -654,7 +924,18 @@ Status HdfsParquetTableWriter::Init() {
 
   VLOG_FILE << "Using compression codec: " << codec;
 
-  columns_.resize(table_desc_->num_cols() - table_desc_->num_clustering_cols());
+  vector<string> bloom_filter_cols;
+  if (!FLAGS_parquet_bloom_filter_columns.empty()) {
+    boost::split(bloom_filter_cols, FLAGS_parquet_bloom_filter_columns,
+        boost::is_any_of(","));
+    for (string& col_name: bloom_filter_cols) {
+      boost::trim(col_name);
+      boost::to_lower(col_name);
+    }
+  }
+
+  int num_clustering_cols = table_desc_->num_clustering_cols();
+  columns_.resize(table_desc_->num_cols() - num_clustering_cols);
   // Initialize each column structure.
   for (int i = 0; i < columns_.size(); ++i) {
     BaseColumnWriter* writer = NULL;
@@ -720,6 +1001,11 @@ Status HdfsParquetTableWriter::Init() {
         DCHECK(false);
     }
     columns_[i] = state_->obj_pool()->Add(writer);
+    const string& col_name = table_desc_->col_descs()[i + num_clustering_cols].name();
+    if (find(bloom_filter_cols.begin(), bloom_filter_cols.end(), col_name) !=
+        bloom_filter_cols.end()) {
+      columns_[i]->EnableBloomFilter();
+    }
     columns_[i]->Reset();
   }
   RETURN_IF_ERROR(CreateSchema());
@@ -765,6 +1051,7 @@ Status HdfsParquetTableWriter::AddRowGroup() {
   if (current_row_group_ != NULL) RETURN_IF_ERROR(FlushCurrentRowGroup());
   file_metadata_.row_groups.push_back(RowGroup());
   current_row_group_ = &file_metadata_.row_groups[file_metadata_.row_groups.size() - 1];
+  row_group_start_size_estimate_ = file_size_estimate_;
 
   // Initialize new row group metadata.
   int num_clustering_cols = table_desc_->num_clustering_cols();
@@ -772,13 +1059,9 @@ Status HdfsParquetTableWriter::AddRowGroup() {
   for (int i = 0; i < columns_.size(); ++i) {
     ColumnMetaData metadata;
     metadata.type = IMPALA_TO_PARQUET_TYPES[columns_[i]->expr_ctx_->root()->type().type];
-    // Add all encodings that were used in this file.  Currently we use PLAIN and
-    // PLAIN_DICTIONARY for data values and RLE for the definition levels.
+    // RLE is used for the definition levels. The encodings of the data values are
+    // added in FlushCurrentRowGroup() once it is known which encodings were used.
     metadata.encodings.push_back(Encoding::RLE);
-    // Columns are initially dictionary encoded
-    // TODO: we might not have PLAIN encoding in this case
-    metadata.encodings.push_back(Encoding::PLAIN_DICTIONARY);
-    metadata.encodings.push_back(Encoding::PLAIN);
     metadata.path_in_schema.push_back(
         table_desc_->col_descs()[i + num_clustering_cols].name());
     metadata.codec = columns_[i]->codec();
@@ -852,8 +1135,8 @@ Status HdfsParquetTableWriter::InitNewFile() {
   file_size_estimate_ = 0;
 
   file_metadata_.row_groups.clear();
-  RETURN_IF_ERROR(AddRowGroup());
   RETURN_IF_ERROR(WriteFileHeader());
+  RETURN_IF_ERROR(AddRowGroup());
 
   return Status::OK();
 }
@@ -869,6 +1152,9 @@ Status HdfsParquetTableWriter::AppendRowBatch(RowBatch* batch,
     limit = row_group_indices.size();
   }
 
+  // FlushBufferedRows() leaves the file without a current row group.
+  if (current_row_group_ == NULL && row_idx_ < limit) RETURN_IF_ERROR(AddRowGroup());
+
   bool all_rows = row_group_indices.empty();
   for (; row_idx_ < limit;) {
     TupleRow* current_row = all_rows ?
@@ -906,6 +1192,16 @@ Status HdfsParquetTableWriter::Finalize() {
   return Status::OK();
 }
 
+int64_t HdfsParquetTableWriter::buffered_bytes() const {
+  if (current_row_group_ == NULL) return 0;
+  return file_size_estimate_ - row_group_start_size_estimate_;
+}
+
+Status HdfsParquetTableWriter::FlushBufferedRows() {
+  SCOPED_TIMER(parent_->hdfs_write_timer());
+  return FlushCurrentRowGroup();
+}
+
 void HdfsParquetTableWriter::Close() {
   // Release all accumulated memory
   for (int i = 0; i < columns_.size(); ++i) {
@@ -933,6 +1229,8 @@ Status HdfsParquetTableWriter::FlushCurrentRowGroup() {
     // Flush this column.  This updates the final metadata sizes for this column.
     RETURN_IF_ERROR(columns_[i]->Flush(&file_pos_, &data_page_offset, &dict_page_offset));
     DCHECK_GT(data_page_offset, 0);
+    RETURN_IF_ERROR(columns_[i]->FlushBloomFilter(
+        &file_pos_, &current_row_group_->columns[i].meta_data));
 
     current_row_group_->columns[i].meta_data.data_page_offset = data_page_offset;
     if (dict_page_offset >= 0) {
@@ -940,7 +1238,18 @@ Status HdfsParquetTableWriter::FlushCurrentRowGroup() {
           dict_page_offset);
     }
 
+    // Add the encodings that were used for the data values of this column. Columns are
+    // initially dictionary encoded and fall back to PLAIN if the dictionary gets too
+    // big. Pages that only contain NULLs are always PLAIN encoded but hold no values.
+    vector<Encoding::type>& encodings =
+        current_row_group_->columns[i].meta_data.encodings;
+    if (dict_page_offset >= 0) encodings.push_back(Encoding::PLAIN_DICTIONARY);
+    if (columns_[i]->has_plain_encoded_values() || dict_page_offset < 0) {
+      encodings.push_back(Encoding::PLAIN);
+    }
+
     current_row_group_->columns[i].meta_data.num_values = columns_[i]->num_values();
+    columns_[i]->EncodeRowGroupStats(&current_row_group_->columns[i].meta_data);
     current_row_group_->columns[i].meta_data.total_uncompressed_size =
         columns_[i]->total_uncompressed_size();
     current_row_group_->columns[i].meta_data.total_compressed_size =
@@ -969,6 +1278,9 @@ Status HdfsParquetTableWriter::FlushCurrentRowGroup() {
     columns_[i]->Reset();
   }
 
+  // The pages and dictionaries of the row group have been written out. The dictionary
+  // encoders that Reset() created for the next row group have not allocated yet.
+  per_file_mem_pool_->FreeAll();
   current_row_group_ = NULL;
   return Status::OK();
 }
@@ -40,7 +40,6 @@ class TupleRow;
 /// TODO: (parts of the format that are not implemented)
 /// - group var encoding
 /// - compression
-/// - multiple row groups per file
 /// TODO: we need a mechanism to pass the equivalent of serde params to this class
 /// from the FE.  This includes:
 /// - compression & codec
@@ -73,6 +72,13 @@ class HdfsParquetTableWriter : public HdfsTableWriter {
 
   virtual void Close();
 
+  /// Returns the size estimate of the current row group, or 0 if it has no rows yet.
+  virtual int64_t buffered_bytes() const;
+
+  /// Writes out the current row group. The next appended row starts a new row group in
+  /// the same file, so the file still grows to its size limit.
+  virtual Status FlushBufferedRows();
+
   /// Returns the target HDFS block size to use.
   virtual uint64_t default_block_size() const;
 
@@ -145,6 +151,9 @@ class HdfsParquetTableWriter : public HdfsTableWriter {
   /// Number of rows in current file
   int64_t row_count_;
 
+  /// file_size_estimate_ when the current row group was started.
+  int64_t row_group_start_size_estimate_;
+
   /// Current estimate of the total size of the file.  The file size estimate includes
   /// the running size of the (uncompressed) dictionary, the size of all finalized
   /// (compressed) data pages and their page headers.
@@ -164,8 +173,8 @@ class HdfsParquetTableWriter : public HdfsTableWriter {
   /// writer (i.e. reused across files).
   boost::scoped_ptr<MemPool> reusable_col_mem_pool_;
 
-  /// Memory for column/block buffers that is allocated per file.  We need to
-  /// reset this pool after flushing a file.
+  /// Memory for column/block buffers that is allocated per row group. It is freed after
+  /// flushing a row group.
   boost::scoped_ptr<MemPool> per_file_mem_pool_;
 
   /// Current position in the batch being written.  This must be persistent across
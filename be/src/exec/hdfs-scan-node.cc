@@ -21,6 +21,7 @@
 #include "exec/hdfs-avro-scanner.h"
 #include "exec/hdfs-parquet-scanner.h"
 
+#include <algorithm>
 #include <sstream>
 #include <avro/errors.h>
 #include <avro/schema.h>
@@ -35,6 +36,7 @@
 #include "common/object-pool.h"
 #include "exprs/expr-context.h"
 #include "runtime/descriptors.h"
+#include "runtime/exec-env.h"
 #include "runtime/hdfs-fs-cache.h"
 #include "runtime/runtime-filter.inline.h"
 #include "runtime/runtime-state.h"
@@ -49,10 +51,13 @@
 #include "util/debug-util.h"
 #include "util/disk-info.h"
 #include "util/error-util.h"
+#include "util/hash-util.h"
 #include "util/hdfs-util.h"
 #include "util/impalad-metrics.h"
 #include "util/periodic-counter-updater.h"
 #include "util/runtime-profile-counters.h"
+#include "util/thread-pool.h"
+#include "util/time.h"
 
 #include "gen-cpp/PlanNodes_types.h"
 
@@ -64,6 +69,31 @@ DEFINE_bool(suppress_unknown_disk_id_warnings, false,
     " provide volume/disk information.");
 DEFINE_int32(runtime_filter_wait_time_ms, 1000, "(Advanced) the maximum time, in ms, "
     "that a scan node will wait for expected runtime filters to arrive.");
+DEFINE_int32(num_column_decode_threads, 0, "(Advanced) Maximum number of tasks that a "
+    "scanner hands to the process-wide query task pool to decode the columns of a row "
+    "group in parallel. Currently only used by the Parquet scanner. If 0, the scanner "
+    "threads decode all columns.");
+DEFINE_bool(hdfs_zero_copy_local_reads, false, "(Advanced) If true, HDFS scans read "
+    "local replicas through the zero-copy read path of cached blocks, which memory-maps "
+    "the block file of a short-circuit read instead of copying it into I/O buffers. "
+    "Checksums of the data read this way are not verified.");
+DEFINE_bool(hdfs_scan_largest_first, true, "(Advanced) If true, HDFS scans issue their "
+    "files and scan ranges in decreasing order of estimated processing cost, i.e. size "
+    "times a factor for the codec and file format, so that large and slow-to-decode "
+    "files don't start last and extend the scan.");
+DEFINE_double(hdfs_scan_sample_percent, 100, "(Advanced) If less than 100, HDFS scan "
+    "nodes only read about this percentage of their scan ranges. Which ranges are read "
+    "only depends on the file, the range offset and --hdfs_scan_sample_seed, so a query "
+    "reads the same sample every time.");
+DEFINE_bool(hdfs_scan_sample_files, false, "(Advanced) If true, "
+    "--hdfs_scan_sample_percent samples whole files instead of scan ranges.");
+DEFINE_int64(hdfs_scan_sample_seed, 0, "(Advanced) Seed of the scan range sample of "
+    "--hdfs_scan_sample_percent and the row sample of --parquet_row_sample_percent.");
+DEFINE_bool(park_idle_scanner_threads, true, "(Advanced) If true, a scanner thread "
+    "other than the last one that finishes a scan range while the queue of materialized "
+    "row batches is full gives back its thread token, since more scanner threads cannot "
+    "increase the throughput of the scan. The scan node restarts scanner threads once "
+    "the queue runs empty.");
 DECLARE_string(cgroup_hierarchy_path);
 DECLARE_bool(enable_rm);
 
@@ -104,9 +134,11 @@ HdfsScanNode::HdfsScanNode(ObjectPool* pool, const TPlanNode& tnode,
       tuple_desc_(NULL),
       hdfs_table_(NULL),
       unknown_disk_id_warned_(false),
+      rows_rejected_by_sampling_counter_(NULL),
       initial_ranges_issued_(false),
       ranges_issued_barrier_(1),
       scanner_thread_bytes_required_(0),
+      column_decode_pool_(NULL),
       max_compressed_text_file_length_(NULL),
       disks_accessed_bitmap_(TUnit::UNIT, 0),
       bytes_read_local_(NULL),
@@ -114,6 +146,11 @@ HdfsScanNode::HdfsScanNode(ObjectPool* pool, const TPlanNode& tnode,
       bytes_read_dn_cache_(NULL),
       num_remote_ranges_(NULL),
       unexpected_remote_bytes_(NULL),
+      data_cache_hit_count_(NULL),
+      data_cache_miss_count_(NULL),
+      data_cache_hit_bytes_(NULL),
+      num_slow_remote_reads_(NULL),
+      num_scanner_threads_parked_counter_(NULL),
       done_(false),
       all_ranges_started_(false),
       counters_running_(false),
@@ -225,6 +262,8 @@ bool HdfsScanNode::WaitForRuntimeFilters(int32_t time_ms) {
 
 Status HdfsScanNode::GetNext(RuntimeState* state, RowBatch* row_batch, bool* eos) {
   SCOPED_TIMER(runtime_profile_->total_time_counter());
+  SCOPED_PERF_EVENT_MEASUREMENT(perf_event_counters_);
+  SCOPED_CPU_SAMPLE_NODE(id_);
 
   if (!initial_ranges_issued_) {
     // We do this in GetNext() to maximise the amount of work we can do while waiting for
@@ -248,6 +287,7 @@ Status HdfsScanNode::GetNext(RuntimeState* state, RowBatch* row_batch, bool* eos
           matching_files->push_back(file);
         }
       }
+      if (FLAGS_hdfs_scan_largest_first) SortFilesByCost(v.first, matching_files);
     }
 
     // Issue initial ranges for all file types.
@@ -307,7 +347,15 @@ Status HdfsScanNode::GetNextInternal(
       SetDone();
     }
     DCHECK_EQ(materialized_batch->num_io_buffers(), 0);
-    delete materialized_batch;
+    row_batch_pool_->ReturnBatch(materialized_batch);
+
+    // The consumer caught up with the scanner threads, so restart the ones that were
+    // parked while it could not keep up.
+    int num_parked = num_parked_scanner_threads_.Load();
+    if (num_parked > 0 && materialized_row_batches_->GetSize() == 0 &&
+        num_parked_scanner_threads_.CompareAndSwap(num_parked, 0)) {
+      ThreadTokenAvailableCb(runtime_state_->resource_pool());
+    }
     return Status::OK();
   }
   // The RowBatchQueue was shutdown either because all scan ranges are complete or a
@@ -445,6 +493,8 @@ Status HdfsScanNode::Prepare(RuntimeState* state) {
   SCOPED_TIMER(runtime_profile_->total_time_counter());
   runtime_state_ = state;
   RETURN_IF_ERROR(ScanNode::Prepare(state));
+  row_batch_pool_.reset(
+      new RowBatchPool(row_desc(), mem_tracker(), MAX_RECYCLED_ROW_BATCHES));
 
   tuple_desc_ = state->desc_tbl().GetTupleDescriptor(tuple_id_);
   DCHECK(tuple_desc_ != NULL);
@@ -518,6 +568,18 @@ Status HdfsScanNode::Prepare(RuntimeState* state) {
     is_materialized_col_[i] = GetMaterializedSlotIdx(vector<int>(1, i)) != SKIP_COLUMN;
   }
 
+  if (FLAGS_hdfs_scan_sample_percent <= 0 || FLAGS_hdfs_scan_sample_percent > 100) {
+    return Status(Substitute("Invalid --hdfs_scan_sample_percent: $0. Must be greater "
+        "than 0 and at most 100.", FLAGS_hdfs_scan_sample_percent));
+  }
+  bool sample_ranges = FLAGS_hdfs_scan_sample_percent < 100;
+  RuntimeProfile::Counter* ranges_skipped_counter = sample_ranges ?
+      ADD_COUNTER(runtime_profile(), "ScanRangesSkippedBySampling", TUnit::UNIT) : NULL;
+  if (HdfsParquetScanner::SamplesRows()) {
+    rows_rejected_by_sampling_counter_ =
+        ADD_COUNTER(runtime_profile(), "RowsRejectedBySampling", TUnit::UNIT);
+  }
+
   HdfsFsCache::HdfsFsMap fs_cache;
   // Convert the TScanRangeParams into per-file DiskIO::ScanRange objects and populate
   // partition_ids_, file_descs_, and per_type_files_.
@@ -548,6 +610,11 @@ Status HdfsScanNode::Prepare(RuntimeState* state) {
     filesystem::path file_path(partition_desc->location());
     file_path.append(split.file_name, filesystem::path::codecvt());
     const string& native_file_path = file_path.native();
+    if (sample_ranges && !IsRangeSampled(native_file_path,
+        FLAGS_hdfs_scan_sample_files ? 0 : split.offset)) {
+      COUNTER_ADD(ranges_skipped_counter, 1);
+      continue;
+    }
 
     HdfsFileDesc* file_desc = NULL;
     FileDescMap::iterator file_desc_it = file_descs_.find(native_file_path);
@@ -582,6 +649,12 @@ Status HdfsScanNode::Prepare(RuntimeState* state) {
     if (runtime_state_->query_options().disable_cached_reads) {
       DCHECK(!try_cache) << "Params should not have had this set.";
     }
+    // Local replicas can be read without copies through the same zero-copy path as
+    // cached blocks. Ranges that can't be mapped fall back to normal reads.
+    if (FLAGS_hdfs_zero_copy_local_reads && expected_local &&
+        IsHdfsPath(file_desc->filename.c_str())) {
+      try_cache = true;
+    }
     file_desc->splits.push_back(
         AllocateScanRange(file_desc->fs, file_desc->filename.c_str(), split.length,
             split.offset, split.partition_id, (*scan_range_params_)[i].volume_id,
@@ -683,11 +756,29 @@ Status HdfsScanNode::Prepare(RuntimeState* state) {
   return Status::OK();
 }
 
+void HdfsScanNode::AddTopNFilter(const SlotDescriptor* slot_desc,
+    const TopNFilter* filter) {
+  DCHECK(tuple_desc_ != NULL);
+  DCHECK_EQ(slot_desc->parent(), tuple_desc_);
+  TopNFilterTarget target;
+  target.slot_desc = slot_desc;
+  target.filter = filter;
+  topn_filters_.push_back(target);
+}
+
 // This function initiates the connection to hdfs and starts up the initial scanner
 // threads. The scanner subclasses are passed the initial splits. Scanners are expected to
 // queue up a non-zero number of those splits to the io mgr (via the ScanNode). Scan
 // ranges are not issued until the first GetNext() call; scanner threads will block on
 // ranges_issued_barrier_ until ranges are issued.
+bool HdfsScanNode::IsRangeSampled(const string& file_name, int64_t offset) {
+  // The sample must not depend on the host or fragment instance a range is assigned to.
+  uint64_t hash = HashUtil::MurmurHash2_64(file_name.data(), file_name.size(),
+      FLAGS_hdfs_scan_sample_seed);
+  hash = HashUtil::MurmurHash2_64(&offset, sizeof(offset), hash);
+  return hash % 1000000 < FLAGS_hdfs_scan_sample_percent * 10000;
+}
+
 Status HdfsScanNode::Open(RuntimeState* state) {
   RETURN_IF_ERROR(ExecNode::Open(state));
 
@@ -701,6 +792,10 @@ Status HdfsScanNode::Open(RuntimeState* state) {
 
   for (auto& filter_ctx: filter_ctxs_) RETURN_IF_ERROR(filter_ctx.expr->Open(state));
 
+  if (FLAGS_num_column_decode_threads > 0) {
+    column_decode_pool_ = state->exec_env()->query_task_pool();
+  }
+
   // We need at least one scanner thread to make progress. We need to make this
   // reservation before any ranges are issued.
   runtime_state_->resource_pool()->ReserveOptionalTokens(1);
@@ -734,9 +829,16 @@ Status HdfsScanNode::Open(RuntimeState* state) {
 
   RETURN_IF_ERROR(runtime_state_->io_mgr()->RegisterContext(
       &reader_context_, mem_tracker()));
+  const string& request_pool = state->fragment_ctx().request_pool;
+  if (!request_pool.empty()) {
+    runtime_state_->io_mgr()->set_request_pool(reader_context_, request_pool);
+  }
+  runtime_state_->io_mgr()->set_numa_node(reader_context_,
+      runtime_state_->resource_pool()->numa_node());
 
   // Initialize HdfsScanNode specific counters
-  read_timer_ = ADD_TIMER(runtime_profile(), TOTAL_HDFS_READ_TIMER);
+  // Updated by the disk threads of the IoMgr.
+  read_timer_ = ADD_SHARDED_TIMER(runtime_profile(), TOTAL_HDFS_READ_TIMER);
   per_read_thread_throughput_counter_ = runtime_profile()->AddDerivedCounter(
       PER_READ_THREAD_THROUGHPUT_COUNTER, TUnit::BYTES_PER_SECOND,
       bind<int64_t>(&RuntimeProfile::UnitsPerSecond, bytes_read_counter_, read_timer_));
@@ -750,6 +852,8 @@ Status HdfsScanNode::Open(RuntimeState* state) {
   }
   num_scanner_threads_started_counter_ =
       ADD_COUNTER(runtime_profile(), NUM_SCANNER_THREADS_STARTED, TUnit::UNIT);
+  num_scanner_threads_parked_counter_ =
+      ADD_COUNTER(runtime_profile(), "NumScannerThreadsParked", TUnit::UNIT);
 
   runtime_state_->io_mgr()->set_bytes_read_counter(reader_context_, bytes_read_counter());
   runtime_state_->io_mgr()->set_read_timer(reader_context_, read_timer());
@@ -773,6 +877,14 @@ Status HdfsScanNode::Open(RuntimeState* state) {
       TUnit::UNIT);
   unexpected_remote_bytes_ = ADD_COUNTER(runtime_profile(), "BytesReadRemoteUnexpected",
       TUnit::BYTES);
+  data_cache_hit_count_ = ADD_COUNTER(runtime_profile(), "DataCacheHitCount",
+      TUnit::UNIT);
+  data_cache_miss_count_ = ADD_COUNTER(runtime_profile(), "DataCacheMissCount",
+      TUnit::UNIT);
+  data_cache_hit_bytes_ = ADD_COUNTER(runtime_profile(), "DataCacheHitBytes",
+      TUnit::BYTES);
+  num_slow_remote_reads_ = ADD_COUNTER(runtime_profile(), "SlowRemoteReads",
+      TUnit::UNIT);
 
   max_compressed_text_file_length_ = runtime_profile()->AddHighWaterMarkCounter(
       "MaxCompressedTextFileLength", TUnit::BYTES);
@@ -822,6 +934,7 @@ void HdfsScanNode::Close(RuntimeState* state) {
 
   num_owned_io_buffers_.Add(-materialized_row_batches_->Cleanup());
   DCHECK_EQ(num_owned_io_buffers_.Load(), 0) << "ScanNode has leaked io buffers";
+  if (row_batch_pool_.get() != NULL) row_batch_pool_->Clear();
 
   if (reader_context_ != NULL) {
     // There may still be io buffers used by parent nodes so we can't unregister the
@@ -866,10 +979,83 @@ void HdfsScanNode::Close(RuntimeState* state) {
   ScanNode::Close(state);
 }
 
+int HdfsScanNode::CompressionCostFactor(THdfsCompression::type compression) {
+  switch (compression) {
+    case THdfsCompression::NONE:
+      return 2;
+    case THdfsCompression::GZIP:
+    case THdfsCompression::DEFLATE:
+    case THdfsCompression::DEFAULT:
+      return 8;
+    case THdfsCompression::BZIP2:
+      return 16;
+    default:
+      // Snappy, LZO and LZ4 decompress quickly.
+      return 4;
+  }
+}
+
+int64_t HdfsScanNode::EstimatedProcessingCost(THdfsFileFormat::type format,
+    THdfsCompression::type compression, int64_t bytes) {
+  int64_t factor = CompressionCostFactor(compression);
+  // Avro is decoded one field at a time.
+  if (format == THdfsFileFormat::AVRO) factor += factor / 2;
+  return bytes * factor;
+}
+
+void HdfsScanNode::SortFilesByCost(THdfsFileFormat::type format,
+    vector<HdfsFileDesc*>* files) {
+  vector<pair<int64_t, HdfsFileDesc*> > costs;
+  costs.reserve(files->size());
+  for (HdfsFileDesc* file: *files) {
+    // Compressed text files are read as a whole by the scanner of their first split.
+    bool whole_file = format == THdfsFileFormat::TEXT &&
+        file->file_compression != THdfsCompression::NONE &&
+        file->file_compression != THdfsCompression::LZO;
+    int64_t bytes = whole_file ? file->file_length : 0;
+    if (!whole_file) {
+      for (const DiskIoMgr::ScanRange* split: file->splits) bytes += split->len();
+    }
+    costs.push_back(make_pair(
+        EstimatedProcessingCost(format, file->file_compression, bytes), file));
+  }
+  stable_sort(costs.begin(), costs.end(),
+      [](const pair<int64_t, HdfsFileDesc*>& a, const pair<int64_t, HdfsFileDesc*>& b) {
+        return a.first > b.first;
+      });
+  for (int i = 0; i < costs.size(); ++i) (*files)[i] = costs[i].second;
+}
+
 Status HdfsScanNode::AddDiskIoRanges(const vector<DiskIoMgr::ScanRange*>& ranges,
     int num_files_queued) {
-  RETURN_IF_ERROR(
-      runtime_state_->io_mgr()->AddScanRanges(reader_context_, ranges));
+  if (FLAGS_hdfs_scan_largest_first && ranges.size() > 1) {
+    // The io mgr starts the ranges of each disk in the order they are added. The ranges
+    // of one call are of the same file format, so only their codecs are weighed.
+    vector<pair<int64_t, DiskIoMgr::ScanRange*> > costs;
+    costs.reserve(ranges.size());
+    for (DiskIoMgr::ScanRange* range: ranges) {
+      FileDescMap::const_iterator it = file_descs_.find(range->file());
+      THdfsCompression::type compression = it == file_descs_.end() ?
+          THdfsCompression::NONE : it->second->file_compression;
+      costs.push_back(
+          make_pair(range->len() * CompressionCostFactor(compression), range));
+    }
+    stable_sort(costs.begin(), costs.end(),
+        [](const pair<int64_t, DiskIoMgr::ScanRange*>& a,
+            const pair<int64_t, DiskIoMgr::ScanRange*>& b) {
+          return a.first > b.first;
+        });
+    vector<DiskIoMgr::ScanRange*> sorted_ranges;
+    sorted_ranges.reserve(costs.size());
+    for (const pair<int64_t, DiskIoMgr::ScanRange*>& cost: costs) {
+      sorted_ranges.push_back(cost.second);
+    }
+    RETURN_IF_ERROR(
+        runtime_state_->io_mgr()->AddScanRanges(reader_context_, sorted_ranges));
+  } else {
+    RETURN_IF_ERROR(
+        runtime_state_->io_mgr()->AddScanRanges(reader_context_, ranges));
+  }
   num_unqueued_files_.Add(-num_files_queued);
   DCHECK_GE(num_unqueued_files_.Load(), 0);
   ThreadTokenAvailableCb(runtime_state_->resource_pool());
@@ -1013,8 +1199,14 @@ void HdfsScanNode::ThreadTokenAvailableCb(ThreadResourceMgr::ResourcePool* pool)
 }
 
 void HdfsScanNode::ScannerThread() {
+  // Scanner threads may be started by threads of other fragments or by the disk
+  // threads, so they do not inherit the fragment's NUMA node.
+  runtime_state_->resource_pool()->BindCurrentThreadToNumaNode();
   SCOPED_THREAD_COUNTER_MEASUREMENT(scanner_thread_counters());
   SCOPED_TIMER(runtime_state_->total_cpu_timer());
+  SCOPED_PERF_EVENT_MEASUREMENT(perf_event_counters_);
+  ScopedCpuSampleQuery sample_query(runtime_state_->query_id());
+  SCOPED_CPU_SAMPLE_NODE(id_);
 
   // Make thread-local copy of filter contexts to prune scan ranges, and to pass to the
   // scanner for finer-grained filtering.
@@ -1033,8 +1225,16 @@ void HdfsScanNode::ScannerThread() {
       // this thread.
       unique_lock<mutex> l(lock_);
       if (active_scanner_thread_counter_.value() > 1) {
+        // Park this thread if the consumer is the bottleneck: the other scanner threads
+        // can fill the queue without it.
+        bool park = FLAGS_park_idle_scanner_threads &&
+            materialized_row_batches_->GetSize() >= max_materialized_row_batches_;
         if (runtime_state_->resource_pool()->optional_exceeded() ||
-            !EnoughMemoryForScannerThread(false)) {
+            !EnoughMemoryForScannerThread(false) || park) {
+          if (park) {
+            num_parked_scanner_threads_.Add(1);
+            COUNTER_ADD(num_scanner_threads_parked_counter_, 1);
+          }
           // We can't break here. We need to update the counter with the lock held or else
           // all threads might see active_scanner_thread_counter_.value > 1
           COUNTER_ADD(&active_scanner_thread_counter_, -1);
@@ -1076,8 +1276,13 @@ void HdfsScanNode::ScannerThread() {
 
     if (status.ok() && scan_range != NULL) {
       // Got a scan range. Process the range end to end (in this thread).
+      int64_t cpu_start_ns = ThreadCpuNanos();
+      int64_t wall_start_ns = MonotonicNanos();
       status = ProcessSplit(filter_status.ok() ? filter_ctxs : vector<FilterContext>(),
           scan_range);
+      // Let the thread mgr know how CPU-bound this scan is.
+      runtime_state_->resource_pool()->ReportThreadTime(
+          ThreadCpuNanos() - cpu_start_ns, MonotonicNanos() - wall_start_ns);
     }
 
     if (!status.ok()) {
@@ -1334,6 +1539,14 @@ void HdfsScanNode::StopAndFinalizeCounters() {
         runtime_state_->io_mgr()->num_remote_ranges(reader_context_)));
     unexpected_remote_bytes_->Set(
         runtime_state_->io_mgr()->unexpected_remote_bytes(reader_context_));
+    data_cache_hit_count_->Set(
+        runtime_state_->io_mgr()->data_cache_hit_count(reader_context_));
+    data_cache_miss_count_->Set(
+        runtime_state_->io_mgr()->data_cache_miss_count(reader_context_));
+    data_cache_hit_bytes_->Set(
+        runtime_state_->io_mgr()->data_cache_hit_bytes(reader_context_));
+    num_slow_remote_reads_->Set(
+        runtime_state_->io_mgr()->num_slow_remote_reads(reader_context_));
 
     if (unexpected_remote_bytes_->value() >= UNEXPECTED_REMOTE_BYTES_WARN_THRESHOLD) {
       runtime_state_->LogError(ErrorMsg(TErrorCode::GENERAL, Substitute(
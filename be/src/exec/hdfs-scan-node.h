@@ -31,6 +31,7 @@
 #include "exec/scanner-context.h"
 #include "runtime/descriptors.h"
 #include "runtime/disk-io-mgr.h"
+#include "runtime/row-batch-pool.h"
 #include "util/avro-util.h"
 #include "util/counting-barrier.h"
 #include "util/progress-updater.h"
@@ -41,11 +42,13 @@
 
 namespace impala {
 
+class CallableThreadPool;
 class DescriptorTbl;
 class HdfsScanner;
 class RowBatch;
 class RuntimeFilter;
 class Status;
+class TopNFilter;
 class Tuple;
 class TPlanNode;
 class TScanRange;
@@ -164,6 +167,14 @@ class HdfsScanNode : public ScanNode {
 
   DiskIoRequestContext* reader_context() { return reader_context_; }
 
+  /// Returns the pool of empty batches that scanners take their row batches from.
+  RowBatchPool* row_batch_pool() { return row_batch_pool_.get(); }
+
+  /// Returns the pool that scanners can use to decode the columns of a row group in
+  /// parallel, or NULL if parallel column decoding is disabled. The pool is shared by
+  /// all queries.
+  CallableThreadPool* column_decode_pool() { return column_decode_pool_; }
+
   typedef std::map<TupleId, std::vector<ExprContext*> > ConjunctsMap;
   const ConjunctsMap& conjuncts_map() const { return conjuncts_map_; }
 
@@ -310,6 +321,25 @@ class HdfsScanNode : public ScanNode {
 
   const std::vector<FilterContext> filter_ctxs() const { return filter_ctxs_; }
 
+  /// A TopNFilter of the parent TopNNode on a slot of tuple_desc().
+  struct TopNFilterTarget {
+    const SlotDescriptor* slot_desc;
+    const TopNFilter* filter;
+  };
+
+  /// Registers 'filter' to be applied to the values of 'slot_desc' by the scanners that
+  /// support it. Rows that do not pass the current bound of the filter cannot affect the
+  /// result of the parent. Must be called after Prepare() and before Open().
+  void AddTopNFilter(const SlotDescriptor* slot_desc, const TopNFilter* filter);
+
+  const std::vector<TopNFilterTarget>& topn_filters() const { return topn_filters_; }
+
+  /// Counts the rows that scanners drop with --parquet_row_sample_percent. NULL if rows
+  /// are not sampled.
+  RuntimeProfile::Counter* rows_rejected_by_sampling_counter() const {
+    return rows_rejected_by_sampling_counter_;
+  }
+
  private:
   friend class ScannerContext;
 
@@ -344,6 +374,9 @@ class HdfsScanNode : public ScanNode {
   /// per scan node since it can be noisy.
   bool unknown_disk_id_warned_;
 
+  /// See rows_rejected_by_sampling_counter().
+  RuntimeProfile::Counter* rows_rejected_by_sampling_counter_;
+
   /// Partitions scanned by this scan node.
   boost::unordered_set<int64_t> partition_ids_;
 
@@ -375,6 +408,11 @@ class HdfsScanNode : public ScanNode {
   /// Number of files that have not been issued from the scanners.
   AtomicInt32 num_unqueued_files_;
 
+  /// Number of scanner threads that exited because materialized_row_batches_ was full
+  /// (see --park_idle_scanner_threads) since scanner threads were last restarted by
+  /// GetNextInternal().
+  AtomicInt32 num_parked_scanner_threads_;
+
   /// Map of HdfsScanner objects to file types.  Only one scanner object will be
   /// created for each file type.  Objects stored in runtime_state's pool.
   typedef std::map<THdfsFileFormat::type, HdfsScanner*> ScannerMap;
@@ -393,6 +431,9 @@ class HdfsScanNode : public ScanNode {
   /// the per-scanner ScannerContext..
   std::vector<FilterContext> filter_ctxs_;
 
+  /// Filters registered with AddTopNFilter().
+  std::vector<TopNFilterTarget> topn_filters_;
+
   /// is_materialized_col_[i] = <true i-th column should be materialized, false otherwise>
   /// for 0 <= i < total # columns in table
   //
@@ -418,6 +459,12 @@ class HdfsScanNode : public ScanNode {
   /// Thread group for all scanner worker threads
   ThreadGroup scanner_threads_;
 
+  /// The process-wide query task pool, which decodes column chunks on behalf of the
+  /// scanner threads. Set in Open() if --num_column_decode_threads is > 0. The scanners
+  /// wait for all the columns they hand out, so the tasks that are still queued once
+  /// they are done have nothing left to decode.
+  CallableThreadPool* column_decode_pool_;
+
   /// Outgoing row batches queue. Row batches are produced asynchronously by the scanner
   /// threads and consumed by the main thread.
   boost::scoped_ptr<RowBatchQueue> materialized_row_batches_;
@@ -425,6 +472,14 @@ class HdfsScanNode : public ScanNode {
   /// Maximum size of materialized_row_batches_.
   int max_materialized_row_batches_;
 
+  /// The batches of materialized_row_batches_ are returned here once GetNext() took
+  /// their rows, and the scanners take their new batches from here. Created in
+  /// Prepare().
+  boost::scoped_ptr<RowBatchPool> row_batch_pool_;
+
+  /// Maximum number of empty batches in row_batch_pool_.
+  static const int MAX_RECYCLED_ROW_BATCHES = 16;
+
   /// This is the number of io buffers that are owned by the scan node and the scanners.
   /// This is used just to help debug leaked io buffers to determine if the leak is
   /// happening in the scanners vs other parts of the execution.
@@ -457,6 +512,23 @@ class HdfsScanNode : public ScanNode {
   /// Total number of bytes read remotely that were expected to be local
   RuntimeProfile::Counter* unexpected_remote_bytes_;
 
+  /// Number of remote reads that were served from the data cache
+  RuntimeProfile::Counter* data_cache_hit_count_;
+
+  /// Number of remote reads that missed the data cache
+  RuntimeProfile::Counter* data_cache_miss_count_;
+
+  /// Total number of bytes read from the data cache
+  RuntimeProfile::Counter* data_cache_hit_bytes_;
+
+  /// Number of remote HDFS reads that exceeded the hedged read threshold, i.e. that
+  /// were hedged to another replica. Always 0 unless hedged reads are enabled.
+  RuntimeProfile::Counter* num_slow_remote_reads_;
+
+  /// Number of scanner threads that gave back their thread token because the consumer
+  /// of materialized_row_batches_ could not keep up.
+  RuntimeProfile::Counter* num_scanner_threads_parked_counter_;
+
   /// Lock protects access between scanner thread and main query thread (the one calling
   /// GetNext()) for all fields below.  If this lock and any other locks needs to be taken
   /// together, this lock must be taken first.
@@ -547,6 +619,24 @@ class HdfsScanNode : public ScanNode {
   /// This must be called on Close() to unregister counters.
   void StopAndFinalizeCounters();
 
+  /// Returns true if the scan range at 'offset' of 'file_name' is in the sample of
+  /// --hdfs_scan_sample_percent. The decision is a hash of both and the seed.
+  static bool IsRangeSampled(const std::string& file_name, int64_t offset);
+
+  /// Returns the relative cost of decompressing a byte of 'compression'.
+  static int CompressionCostFactor(THdfsCompression::type compression);
+
+  /// Returns the estimated cost of processing 'bytes' of a file of 'format' that is
+  /// compressed with 'compression': the bytes times a factor for the decompression and
+  /// the decoding cost. Used with --hdfs_scan_largest_first.
+  static int64_t EstimatedProcessingCost(THdfsFileFormat::type format,
+      THdfsCompression::type compression, int64_t bytes);
+
+  /// Sorts 'files' of 'format' by decreasing EstimatedProcessingCost() of the bytes that
+  /// this scan node reads from them, keeping the order of files of equal cost.
+  static void SortFilesByCost(THdfsFileFormat::type format,
+      std::vector<HdfsFileDesc*>* files);
+
   /// Recursively initializes all NULL collection slots to an empty CollectionValue in
   /// addition to maintaining the null bit. Hack to allow UnnestNode to project out
   /// collection slots. Assumes that the null bit has already been un/set.
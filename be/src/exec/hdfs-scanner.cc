@@ -153,8 +153,8 @@ Status HdfsScanner::InitializeWriteTuplesFn(HdfsPartitionDescriptor* partition,
 }
 
 Status HdfsScanner::StartNewRowBatch() {
-  batch_ = new RowBatch(scan_node_->row_desc(), state_->batch_size(),
-      scan_node_->mem_tracker());
+  batch_ = scan_node_->row_batch_pool()->GetBatch(
+      RowBatch::AdaptiveCapacity(scan_node_->row_desc(), state_->batch_size()));
   int64_t tuple_buffer_size;
   RETURN_IF_ERROR(
       batch_->ResizeAndAllocateTupleBuffer(state_, &tuple_buffer_size, &tuple_mem_));
@@ -22,15 +22,20 @@
 #include "util/hdfs-util.h"
 #include "exprs/expr.h"
 #include "exprs/expr-context.h"
+#include "runtime/exec-env.h"
 #include "runtime/hdfs-fs-cache.h"
 #include "runtime/raw-value.inline.h"
 #include "runtime/row-batch.h"
 #include "runtime/runtime-state.h"
 #include "runtime/string-value.inline.h"
 #include "util/impalad-metrics.h"
+#include "util/promise.h"
+#include "util/thread-pool.h"
 #include "runtime/mem-tracker.h"
 #include "util/url-coding.h"
 
+#include <algorithm>
+#include <functional>
 #include <vector>
 #include <sstream>
 #include <gutil/strings/substitute.h>
@@ -47,6 +52,32 @@ using boost::posix_time::microsec_clock;
 using boost::posix_time::ptime;
 using namespace strings;
 
+DEFINE_int32(num_parquet_compression_threads, 0, "(Advanced) If > 0, Parquet data "
+    "pages are compressed by the process-wide query task pool (see "
+    "--num_query_task_threads), so that encoding and compression of pages overlap. If 0, "
+    "pages are compressed by the sink thread.");
+DEFINE_int32(max_hdfs_sink_open_partitions, 0, "(Advanced) The maximum number of "
+    "partitions that a table sink has an open file for. Before another one is opened, "
+    "the least recently written file is finished, and the rows that arrive for that "
+    "partition later go to a new file. Only avoids small files if the inserted rows are "
+    "clustered by the partition keys. If <= 0, the number is not bounded.");
+DEFINE_int64(hdfs_sink_writers_mem_budget_mb, 0, "(Advanced) The memory budget, in MB, "
+    "that the table writers of a table sink share for rows they buffer before writing "
+    "them, e.g. the current row group of Parquet writers. Whenever it is exceeded, the "
+    "writers holding the most data write it out, and Parquet files get another row group "
+    "instead of being finished early. If 0, the budget is half of the query memory "
+    "limit, or unbounded without a limit. If < 0, the budget is unbounded.");
+DEFINE_int32(hdfs_sink_write_buffer_kb, 0, "(Advanced) If > 0, the table writers copy "
+    "their output into buffers of this size, in KB, which the process-wide query task "
+    "pool writes to HDFS, so that encoding continues while the previous buffer is "
+    "written. Each writer holds at most two buffers and waits for the pending write "
+    "before it hands off the next one. If 0, the sink thread writes to HDFS directly.");
+DEFINE_int32(hdfs_sink_num_parallel_writers, 1, "(Advanced) The number of writers that "
+    "a table sink uses for inserts without dynamic partition keys. If > 1, each row "
+    "batch is split among the writers, which encode their rows in parallel on the "
+    "process-wide query task pool (see --num_query_task_threads) and each write their "
+    "own files.");
+
 namespace impala {
 
 const static string& ROOT_PARTITION_KEY =
@@ -62,7 +93,11 @@ HdfsTableSink::HdfsTableSink(const RowDescriptor& row_desc,
            ? tsink.table_sink.hdfs_table_sink.skip_header_line_count : 0),
        select_list_texprs_(select_list_texprs),
        partition_key_texprs_(tsink.table_sink.hdfs_table_sink.partition_key_exprs),
-       overwrite_(tsink.table_sink.hdfs_table_sink.overwrite) {
+       overwrite_(tsink.table_sink.hdfs_table_sink.overwrite),
+       writers_mem_budget_(-1),
+       compression_pool_(NULL),
+       write_pool_(NULL),
+       write_buffer_size_(0) {
   DCHECK(tsink.__isset.table_sink);
 }
 
@@ -149,9 +184,27 @@ Status HdfsTableSink::Prepare(RuntimeState* state) {
       ADD_COUNTER(profile(), "RowsInserted", TUnit::UNIT);
   bytes_written_counter_ =
       ADD_COUNTER(profile(), "BytesWritten", TUnit::BYTES);
+  partition_writers_evicted_counter_ =
+      ADD_COUNTER(profile(), "PartitionWritersEvicted", TUnit::UNIT);
+  mem_budget_flushes_counter_ = ADD_COUNTER(profile(), "MemBudgetFlushes", TUnit::UNIT);
   encode_timer_ = ADD_TIMER(profile(), "EncodeTimer");
   hdfs_write_timer_ = ADD_TIMER(profile(), "HdfsWriteTimer");
   compress_timer_ = ADD_TIMER(profile(), "CompressTimer");
+  async_write_timer_ = ADD_TIMER(profile(), "HdfsAsyncWriteTimer");
+  write_stall_timer_ = ADD_TIMER(profile(), "HdfsWriteStallTimer");
+  if (FLAGS_num_parquet_compression_threads > 0) {
+    compression_pool_ = state->exec_env()->query_task_pool();
+  }
+  if (FLAGS_hdfs_sink_write_buffer_kb > 0) {
+    write_pool_ = state->exec_env()->query_task_pool();
+    write_buffer_size_ = FLAGS_hdfs_sink_write_buffer_kb * 1024L;
+  }
+  if (FLAGS_hdfs_sink_writers_mem_budget_mb > 0) {
+    writers_mem_budget_ = FLAGS_hdfs_sink_writers_mem_budget_mb * 1024L * 1024L;
+  } else if (FLAGS_hdfs_sink_writers_mem_budget_mb == 0 &&
+      state->query_mem_tracker() != NULL && state->query_mem_tracker()->has_limit()) {
+    writers_mem_budget_ = state->query_mem_tracker()->limit() / 2;
+  }
 
   return Status::OK();
 }
@@ -425,31 +478,41 @@ Status HdfsTableSink::InitOutputPartition(RuntimeState* state,
   // It is incorrect to initialize a writer if there are no rows to feed it. The writer
   // could incorrectly create an empty file or empty partition.
   if (empty_partition) return Status::OK();
+  return InitPartitionWriter(state, output_partition);
+}
 
+Status HdfsTableSink::InitPartitionWriter(RuntimeState* state,
+    OutputPartition* output_partition) {
+  DCHECK(output_partition->writer.get() == NULL);
+  const HdfsPartitionDescriptor& partition_descriptor =
+      *output_partition->partition_descriptor;
+  const vector<ExprContext*>& output_expr_ctxs =
+      output_partition->output_expr_ctxs.empty() ?
+      output_expr_ctxs_ : output_partition->output_expr_ctxs;
   switch (partition_descriptor.file_format()) {
     case THdfsFileFormat::TEXT:
       output_partition->writer.reset(
           new HdfsTextTableWriter(
               this, state, output_partition, &partition_descriptor, table_desc_,
-              output_expr_ctxs_));
+              output_expr_ctxs));
       break;
     case THdfsFileFormat::PARQUET:
       output_partition->writer.reset(
           new HdfsParquetTableWriter(
               this, state, output_partition, &partition_descriptor, table_desc_,
-              output_expr_ctxs_));
+              output_expr_ctxs));
       break;
     case THdfsFileFormat::SEQUENCE_FILE:
       output_partition->writer.reset(
           new HdfsSequenceTableWriter(
               this, state, output_partition, &partition_descriptor, table_desc_,
-              output_expr_ctxs_));
+              output_expr_ctxs));
       break;
     case THdfsFileFormat::AVRO:
       output_partition->writer.reset(
           new HdfsAvroTableWriter(
               this, state, output_partition, &partition_descriptor, table_desc_,
-              output_expr_ctxs_));
+              output_expr_ctxs));
       break;
     default:
       stringstream error_msg;
@@ -466,10 +529,81 @@ Status HdfsTableSink::InitOutputPartition(RuntimeState* state,
       return Status(error_msg.str());
   }
   RETURN_IF_ERROR(output_partition->writer->Init());
-  COUNTER_ADD(partitions_created_counter_, 1);
+  // The writer of a partition is created again after it was evicted. Parallel writers
+  // don't create another partition.
+  if (output_partition->num_files == 0 && output_partition->output_expr_ctxs.empty()) {
+    COUNTER_ADD(partitions_created_counter_, 1);
+  }
   return CreateNewTmpFile(state, output_partition);
 }
 
+bool HdfsTableSink::OpenPartitionsBounded() const {
+  return FLAGS_max_hdfs_sink_open_partitions > 0 &&
+      !dynamic_partition_key_expr_ctxs_.empty();
+}
+
+Status HdfsTableSink::PrepareToWritePartition(RuntimeState* state,
+    OutputPartition* partition) {
+  DCHECK(OpenPartitionsBounded());
+  if (partition->writer.get() != NULL) {
+    open_partitions_.splice(
+        open_partitions_.end(), open_partitions_, partition->open_partitions_pos);
+    return Status::OK();
+  }
+  while (open_partitions_.size() >=
+      static_cast<size_t>(FLAGS_max_hdfs_sink_open_partitions)) {
+    RETURN_IF_ERROR(EvictPartitionWriter(state, open_partitions_.front()));
+  }
+  RETURN_IF_ERROR(InitPartitionWriter(state, partition));
+  partition->open_partitions_pos =
+      open_partitions_.insert(open_partitions_.end(), partition);
+  return Status::OK();
+}
+
+Status HdfsTableSink::EvictPartitionWriter(RuntimeState* state,
+    OutputPartition* partition) {
+  DCHECK(partition->writer.get() != NULL);
+  open_partitions_.erase(partition->open_partitions_pos);
+  Status status = FinalizePartitionFile(state, partition);
+  // The write pool must be done with the writer if finalizing the file failed.
+  partition->writer->WaitForPendingWrite();
+  partition->writer->Close();
+  partition->writer.reset();
+  COUNTER_ADD(partition_writers_evicted_counter_, 1);
+  return status;
+}
+
+Status HdfsTableSink::EnforceWritersMemBudget() {
+  if (writers_mem_budget_ < 0) return Status::OK();
+  int64_t total_buffered_bytes = 0;
+  vector<std::pair<int64_t, HdfsTableWriter*> > buffering_writers;
+  vector<OutputPartition*> partitions(parallel_partitions_);
+  for (PartitionMap::value_type& partition: partition_keys_to_output_partitions_) {
+    partitions.push_back(partition.second.first);
+  }
+  for (OutputPartition* partition: partitions) {
+    HdfsTableWriter* writer = partition->writer.get();
+    if (writer == NULL) continue;
+    int64_t buffered_bytes = writer->buffered_bytes();
+    if (buffered_bytes == 0) continue;
+    total_buffered_bytes += buffered_bytes;
+    buffering_writers.push_back(std::make_pair(buffered_bytes, writer));
+  }
+  if (total_buffered_bytes <= writers_mem_budget_) return Status::OK();
+
+  // Flush the writers with the most buffered data first, which gets back under the budget
+  // with the fewest and largest row groups.
+  sort(buffering_writers.begin(), buffering_writers.end(),
+      std::greater<std::pair<int64_t, HdfsTableWriter*> >());
+  for (const std::pair<int64_t, HdfsTableWriter*>& writer: buffering_writers) {
+    if (total_buffered_bytes <= writers_mem_budget_) break;
+    RETURN_IF_ERROR(writer.second->FlushBufferedRows());
+    total_buffered_bytes -= writer.first;
+    COUNTER_ADD(mem_budget_flushes_counter_, 1);
+  }
+  return Status::OK();
+}
+
 void HdfsTableSink::GetHashTblKey(const vector<ExprContext*>& ctxs, string* key) {
   stringstream hash_table_key;
   for (int i = 0; i < ctxs.size(); ++i) {
@@ -495,13 +629,18 @@ inline Status HdfsTableSink::GetOutputPartition(RuntimeState* state,
     }
 
     OutputPartition* partition = state->obj_pool()->Add(new OutputPartition());
+    // If the number of open writers is bounded, the writer is only opened once rows are
+    // written to the partition.
     Status status = InitOutputPartition(state, *partition_descriptor, partition,
-        no_more_rows);
+        no_more_rows || OpenPartitionsBounded());
     if (!status.ok()) {
       // We failed to create the output partition successfully. Clean it up now
       // as it is not added to partition_keys_to_output_partitions_ so won't be
       // cleaned up in Close().
-      if (partition->writer.get() != NULL) partition->writer->Close();
+      if (partition->writer.get() != NULL) {
+        partition->writer->WaitForPendingWrite();
+        partition->writer->Close();
+      }
       return status;
     }
 
@@ -535,6 +674,9 @@ Status HdfsTableSink::Send(RuntimeState* state, RowBatch* batch, bool eos) {
   SCOPED_TIMER(runtime_profile_->total_time_counter());
   ExprContext::FreeLocalAllocations(output_expr_ctxs_);
   ExprContext::FreeLocalAllocations(partition_key_expr_ctxs_);
+  for (OutputPartition* partition: parallel_partitions_) {
+    ExprContext::FreeLocalAllocations(partition->output_expr_ctxs);
+  }
   RETURN_IF_ERROR(state->CheckQueryState());
   bool empty_input_batch = batch->num_rows() == 0;
   // We don't do any work for an empty batch aside from end of stream finalization.
@@ -550,19 +692,12 @@ Status HdfsTableSink::Send(RuntimeState* state, RowBatch* batch, bool eos) {
     RETURN_IF_ERROR(GetOutputPartition(state, ROOT_PARTITION_KEY, &partition_pair,
         empty_input_batch));
     if (!empty_input_batch) {
-      // Pass the row batch to the writer. If new_file is returned true then the current
-      // file is finalized and a new file is opened.
-      // The writer tracks where it is in the batch when it returns with new_file set.
-      OutputPartition* output_partition = partition_pair->first;
-      bool new_file;
-      do {
-        RETURN_IF_ERROR(output_partition->writer->AppendRowBatch(
-            batch, partition_pair->second, &new_file));
-        if (new_file) {
-          RETURN_IF_ERROR(FinalizePartitionFile(state, output_partition));
-          RETURN_IF_ERROR(CreateNewTmpFile(state, output_partition));
-        }
-      } while (new_file);
+      if (FLAGS_hdfs_sink_num_parallel_writers > 1) {
+        RETURN_IF_ERROR(SendToParallelWriters(state, batch, partition_pair->first));
+      } else {
+        RETURN_IF_ERROR(AppendToPartition(
+            state, partition_pair->first, batch, partition_pair->second));
+      }
     }
   } else {
     for (int i = 0; i < batch->num_rows(); ++i) {
@@ -578,21 +713,19 @@ Status HdfsTableSink::Send(RuntimeState* state, RowBatch* batch, bool eos) {
          partition != partition_keys_to_output_partitions_.end(); ++partition) {
       OutputPartition* output_partition = partition->second.first;
       if (partition->second.second.empty()) continue;
+      if (OpenPartitionsBounded()) {
+        RETURN_IF_ERROR(PrepareToWritePartition(state, output_partition));
+      }
 
-      bool new_file;
-      do {
-        RETURN_IF_ERROR(output_partition->writer->AppendRowBatch(
-            batch, partition->second.second, &new_file));
-        if (new_file) {
-          RETURN_IF_ERROR(FinalizePartitionFile(state, output_partition));
-          RETURN_IF_ERROR(CreateNewTmpFile(state, output_partition));
-        }
-      } while (new_file);
+      RETURN_IF_ERROR(
+          AppendToPartition(state, output_partition, batch, partition->second.second));
       partition->second.second.clear();
     }
   }
-
-  if (eos) {
+  if (!eos) {
+    // Finalizing the files at eos writes out all buffered rows anyway.
+    RETURN_IF_ERROR(EnforceWritersMemBudget());
+  } else {
     // Close Hdfs files, and update stats in runtime state.
     for (PartitionMap::iterator cur_partition =
             partition_keys_to_output_partitions_.begin();
@@ -600,10 +733,101 @@ Status HdfsTableSink::Send(RuntimeState* state, RowBatch* batch, bool eos) {
         ++cur_partition) {
       RETURN_IF_ERROR(FinalizePartitionFile(state, cur_partition->second.first));
     }
+    for (OutputPartition* partition: parallel_partitions_) {
+      RETURN_IF_ERROR(FinalizePartitionFile(state, partition));
+    }
   }
   return Status::OK();
 }
 
+Status HdfsTableSink::AppendToPartition(RuntimeState* state, OutputPartition* partition,
+    RowBatch* batch, const vector<int32_t>& rows) {
+  // Pass the row batch to the writer. If new_file is returned true then the current
+  // file is finalized and a new file is opened.
+  // The writer tracks where it is in the batch when it returns with new_file set.
+  bool new_file;
+  do {
+    RETURN_IF_ERROR(partition->writer->AppendRowBatch(batch, rows, &new_file));
+    if (new_file) {
+      lock_guard<mutex> l(new_file_lock_);
+      RETURN_IF_ERROR(FinalizePartitionFile(state, partition));
+      RETURN_IF_ERROR(CreateNewTmpFile(state, partition));
+    }
+  } while (new_file);
+  return Status::OK();
+}
+
+Status HdfsTableSink::SendToParallelWriters(RuntimeState* state, RowBatch* batch,
+    OutputPartition* root_partition) {
+  DCHECK(dynamic_partition_key_expr_ctxs_.empty());
+  DCHECK_GT(batch->num_rows(), 0);
+  if (parallel_partitions_.empty()) {
+    RETURN_IF_ERROR(InitParallelPartitions(state, root_partition));
+  }
+  int num_writers = parallel_partitions_.size() + 1;
+  parallel_rows_.resize(num_writers);
+  parallel_statuses_.resize(num_writers);
+  // Contiguous ranges keep the rows of a file in the order of the batch.
+  int rows_per_writer = (batch->num_rows() + num_writers - 1) / num_writers;
+  for (int i = 0; i < num_writers; ++i) {
+    parallel_rows_[i].clear();
+    int end = min(batch->num_rows(), (i + 1) * rows_per_writer);
+    for (int row = i * rows_per_writer; row < end; ++row) {
+      parallel_rows_[i].push_back(row);
+    }
+  }
+
+  // An empty range means all rows to AppendRowBatch(), so writers without rows are
+  // skipped.
+  vector<Promise<bool> > done(num_writers);
+  vector<bool> started(num_writers, false);
+  CallableThreadPool* pool = state->exec_env()->query_task_pool();
+  for (int i = 1; i < num_writers; ++i) {
+    if (parallel_rows_[i].empty()) continue;
+    OutputPartition* partition = parallel_partitions_[i - 1];
+    if (partition->writer.get() == NULL) {
+      // Opened once the writer gets rows so that small inserts don't write empty files.
+      RETURN_IF_ERROR(InitPartitionWriter(state, partition));
+      if (!ShouldSkipStaging(state, partition)) {
+        (*state->hdfs_files_to_move())[partition->tmp_hdfs_dir_name] = "";
+      }
+    }
+    started[i] = true;
+    if (!pool->Offer(bind<void>(mem_fn(&HdfsTableSink::AppendToParallelWriter), this,
+        state, batch, i, &done[i]))) {
+      AppendToParallelWriter(state, batch, i, &done[i]);
+    }
+  }
+  Status status = AppendToPartition(state, root_partition, batch, parallel_rows_[0]);
+  for (int i = 1; i < num_writers; ++i) {
+    if (!started[i]) continue;
+    done[i].Get();
+    if (status.ok()) status = parallel_statuses_[i];
+  }
+  return status;
+}
+
+Status HdfsTableSink::InitParallelPartitions(RuntimeState* state,
+    OutputPartition* root_partition) {
+  DCHECK(parallel_partitions_.empty());
+  for (int i = 1; i < FLAGS_hdfs_sink_num_parallel_writers; ++i) {
+    OutputPartition* partition = state->obj_pool()->Add(new OutputPartition());
+    RETURN_IF_ERROR(InitOutputPartition(
+        state, *root_partition->partition_descriptor, partition, true));
+    parallel_partitions_.push_back(partition);
+    RETURN_IF_ERROR(Expr::CloneIfNotExists(
+        output_expr_ctxs_, state, &partition->output_expr_ctxs));
+  }
+  return Status::OK();
+}
+
+void HdfsTableSink::AppendToParallelWriter(RuntimeState* state, RowBatch* batch,
+    int idx, Promise<bool>* done) {
+  parallel_statuses_[idx] = AppendToPartition(
+      state, parallel_partitions_[idx - 1], batch, parallel_rows_[idx]);
+  done->Set(true);
+}
+
 Status HdfsTableSink::FinalizePartitionFile(RuntimeState* state,
                                             OutputPartition* partition) {
   if (partition->tmp_hdfs_file == NULL && !overwrite_) return Status::OK();
@@ -612,6 +836,7 @@ Status HdfsTableSink::FinalizePartitionFile(RuntimeState* state,
   // OutputPartition writer could be NULL if there is no row to output.
   if (partition->writer.get() != NULL) {
     RETURN_IF_ERROR(partition->writer->Finalize());
+    RETURN_IF_ERROR(partition->writer->FlushWrites());
 
     // Track total number of appended rows per partition in runtime
     // state. partition->num_rows counts number of rows appended is per-file.
@@ -631,6 +856,9 @@ Status HdfsTableSink::FinalizePartitionFile(RuntimeState* state,
 
 void HdfsTableSink::ClosePartitionFile(RuntimeState* state, OutputPartition* partition) {
   if (partition->tmp_hdfs_file == NULL) return;
+  // A failed write was already reported by FlushWrites() or the writer, so its status
+  // is not needed, but the file must not be closed while it is written to.
+  if (partition->writer.get() != NULL) partition->writer->WaitForPendingWrite();
   int hdfs_ret = hdfsCloseFile(partition->hdfs_connection, partition->tmp_hdfs_file);
   VLOG_FILE << "hdfsCloseFile() file=" << partition->current_file_name;
   if (hdfs_ret != 0) {
@@ -661,7 +889,14 @@ void HdfsTableSink::Close(RuntimeState* state) {
     }
     ClosePartitionFile(state, cur_partition->second.first);
   }
+  for (OutputPartition* partition: parallel_partitions_) {
+    if (partition->writer.get() != NULL) partition->writer->Close();
+    ClosePartitionFile(state, partition);
+    Expr::Close(partition->output_expr_ctxs, state);
+  }
   partition_keys_to_output_partitions_.clear();
+  open_partitions_.clear();
+  parallel_partitions_.clear();
 
   // Close literal partition key exprs
   for (const HdfsTableDescriptor::PartitionIdToDescriptorMap::value_type& id_to_desc:
@@ -17,8 +17,10 @@
 #define IMPALA_EXEC_HDFS_TABLE_SINK_H
 
 #include <hdfs.h>
+#include <list>
 #include <boost/unordered_map.hpp>
 #include <boost/scoped_ptr.hpp>
+#include <boost/thread/mutex.hpp>
 
 /// needed for scoped_ptr to work on ObjectPool
 #include "common/object-pool.h"
@@ -28,12 +30,14 @@
 
 namespace impala {
 
+class CallableThreadPool;
 class Expr;
 class TupleDescriptor;
 class TupleRow;
 class RuntimeState;
 class HdfsTableWriter;
 class MemTracker;
+template <typename T> class Promise;
 
 /// Records the temporary and final Hdfs file name, the opened temporary Hdfs file, and
 /// the number of appended rows of an output partition.
@@ -89,6 +93,14 @@ struct OutputPartition {
   /// The block size decided on for this file.
   int64_t block_size;
 
+  /// Position in HdfsTableSink::open_partitions_ if the number of open writers is bounded
+  /// and 'writer' is set.
+  std::list<OutputPartition*>::iterator open_partitions_pos;
+
+  /// Clones of the sink's output exprs for a writer that runs in parallel with the
+  /// writer of the same partition. Empty if 'writer' evaluates the sink's output exprs.
+  std::vector<ExprContext*> output_expr_ctxs;
+
   OutputPartition();
 };
 
@@ -110,6 +122,17 @@ struct OutputPartition {
 /// partition_key_exprs from tsink.
 /// A map of opened Hdfs files (corresponding to partitions) is maintained.
 /// Each row may belong to different partition than the one before it.
+/// Each open partition holds a table writer, which for Parquet buffers a whole row group
+/// in memory. --max_hdfs_sink_open_partitions bounds the number of partitions with an
+/// open writer: before another one is opened, the file of the partition that was least
+/// recently written to is finalized and its writer is destroyed. Rows that arrive for
+/// that partition later go to a new file. This keeps memory bounded for inserts into
+/// many partitions, and writes large files if the input is clustered by the partition
+/// keys, e.g. because it is sorted by them.
+/// Inserts without dynamic partition keys can use several writers for the single
+/// partition (see --hdfs_sink_num_parallel_writers). Each row batch is split into ranges
+/// of rows that the writers append to their own files in parallel, on the query task
+/// pool.
 //
 /// Failure behavior:
 /// In Exec() all data is written to Hdfs files in a temporary directory.
@@ -158,6 +181,17 @@ class HdfsTableSink : public DataSink {
   RuntimeProfile::Counter* encode_timer() { return encode_timer_; }
   RuntimeProfile::Counter* hdfs_write_timer() { return hdfs_write_timer_; }
   RuntimeProfile::Counter* compress_timer() { return compress_timer_; }
+  RuntimeProfile::Counter* async_write_timer() { return async_write_timer_; }
+  RuntimeProfile::Counter* write_stall_timer() { return write_stall_timer_; }
+
+  /// Thread pool that the Parquet writers of this sink hand off page compression to.
+  /// NULL if pages are compressed by the sink thread.
+  CallableThreadPool* compression_pool() { return compression_pool_; }
+
+  /// Thread pool that the writers of this sink hand off their buffered output to, and
+  /// the size of the buffers in bytes. NULL and 0 if the sink thread writes to HDFS.
+  CallableThreadPool* write_pool() { return write_pool_; }
+  int64_t write_buffer_size() const { return write_buffer_size_; }
 
   std::string DebugString() const;
 
@@ -168,6 +202,49 @@ class HdfsTableSink : public DataSink {
                              const HdfsPartitionDescriptor& partition_descriptor,
                              OutputPartition* output_partition, bool empty_partition);
 
+  /// Creates the table writer of an initialised output partition and opens a new
+  /// temporary file for it.
+  Status InitPartitionWriter(RuntimeState* state, OutputPartition* output_partition);
+
+  /// Returns true if the number of partitions with an open writer is bounded.
+  bool OpenPartitionsBounded() const;
+
+  /// Appends 'rows' of 'batch' to the writer of 'partition', and moves to a new file
+  /// whenever the current one is full. Thread-safe for different partitions.
+  Status AppendToPartition(RuntimeState* state, OutputPartition* partition,
+      RowBatch* batch, const std::vector<int32_t>& rows);
+
+  /// Appends 'batch', which has rows, to 'root_partition' and the other writers of the
+  /// partition of an insert without dynamic partition keys. The rows are split into
+  /// contiguous ranges, which all but the first writer append on the query task pool.
+  /// Returns once all writers are done with the batch.
+  Status SendToParallelWriters(RuntimeState* state, RowBatch* batch,
+      OutputPartition* root_partition);
+
+  /// Creates parallel_partitions_, the additional writers for the same partition as
+  /// 'root_partition', each with its own clones of the output exprs and its own files.
+  /// Their table writers are created once they get rows.
+  Status InitParallelPartitions(RuntimeState* state, OutputPartition* root_partition);
+
+  /// Appends the rows parallel_rows_[idx] of 'batch' to parallel_partitions_[idx - 1],
+  /// records the result in parallel_statuses_[idx] and sets 'done'. Run by the query
+  /// task pool.
+  void AppendToParallelWriter(RuntimeState* state, RowBatch* batch, int idx,
+      Promise<bool>* done);
+
+  /// Prepares 'partition' to receive rows if the number of open writers is bounded:
+  /// opens its writer, after evicting the least recently written partitions if there are
+  /// too many open ones, or marks it as the most recently written partition.
+  Status PrepareToWritePartition(RuntimeState* state, OutputPartition* partition);
+
+  /// Finalizes the current file of 'partition' and destroys its writer.
+  Status EvictPartitionWriter(RuntimeState* state, OutputPartition* partition);
+
+  /// Makes the open writers write out their buffered rows, in decreasing order of their
+  /// size, until they buffer at most writers_mem_budget_ bytes in total. Called after
+  /// each row batch.
+  Status EnforceWritersMemBudget();
+
   /// Add a temporary file to an output partition.  Files are created in a
   /// temporary directory and then moved to the real partition directory by the
   /// coordinator in a finalization step. The temporary file's current location
@@ -285,12 +362,39 @@ class HdfsTableSink : public DataSink {
 
   boost::scoped_ptr<MemTracker> mem_tracker_;
 
+  /// Maximum number of bytes that all writers buffer together before the largest ones
+  /// write out their rows, from --hdfs_sink_writers_mem_budget_mb. -1 if unbounded.
+  int64_t writers_mem_budget_;
+
+  /// The partitions with an open writer, ordered from the least to the most recently
+  /// written one. Only maintained if OpenPartitionsBounded().
+  std::list<OutputPartition*> open_partitions_;
+
+  /// The writers of an insert without dynamic partition keys besides the one of the root
+  /// partition. Created for the first batch with rows if
+  /// --hdfs_sink_num_parallel_writers > 1. Owned by the runtime state's object pool.
+  std::vector<OutputPartition*> parallel_partitions_;
+
+  /// The rows of the current batch and the result for each parallel writer, starting
+  /// with the one of the root partition. Only used in SendToParallelWriters().
+  std::vector<std::vector<int32_t> > parallel_rows_;
+  std::vector<Status> parallel_statuses_;
+
+  /// Protects the insert stats and file lists of the runtime state while the parallel
+  /// writers move to new files.
+  boost::mutex new_file_lock_;
+
   /// Allocated from runtime state's pool.
   RuntimeProfile* runtime_profile_;
   RuntimeProfile::Counter* partitions_created_counter_;
   RuntimeProfile::Counter* files_created_counter_;
   RuntimeProfile::Counter* rows_inserted_counter_;
   RuntimeProfile::Counter* bytes_written_counter_;
+  /// Number of times the writer of a partition was destroyed to open another one.
+  RuntimeProfile::Counter* partition_writers_evicted_counter_;
+  /// Number of times a writer wrote out its buffered rows to stay within
+  /// writers_mem_budget_.
+  RuntimeProfile::Counter* mem_budget_flushes_counter_;
 
   /// Time spent converting tuple to on disk format.
   RuntimeProfile::Counter* encode_timer_;
@@ -298,6 +402,22 @@ class HdfsTableSink : public DataSink {
   RuntimeProfile::Counter* hdfs_write_timer_;
   /// Time spent compressing data
   RuntimeProfile::Counter* compress_timer_;
+  /// Time the write pool spent writing buffered output to hdfs
+  RuntimeProfile::Counter* async_write_timer_;
+  /// Time the sink thread waited for a buffer to be written before it could hand off
+  /// the next one
+  RuntimeProfile::Counter* write_stall_timer_;
+
+  /// The process-wide query task pool. Set in Prepare() if
+  /// --num_parquet_compression_threads > 0. The writers wait for their pending pages
+  /// when they are closed.
+  CallableThreadPool* compression_pool_;
+
+  /// The process-wide query task pool. Set in Prepare() if --hdfs_sink_write_buffer_kb
+  /// > 0, together with write_buffer_size_. The writers wait for their pending write
+  /// before their file is closed.
+  CallableThreadPool* write_pool_;
+  int64_t write_buffer_size_;
 };
 
 }
@@ -14,8 +14,11 @@
 
 #include "exec/hdfs-table-writer.h"
 
+#include <boost/bind.hpp>
+
 #include "common/names.h"
 #include "runtime/mem-tracker.h"
+#include "util/thread-pool.h"
 
 namespace impala {
 
@@ -36,6 +39,62 @@ HdfsTableWriter::HdfsTableWriter(HdfsTableSink* parent,
 
 Status HdfsTableWriter::Write(const uint8_t* data, int32_t len) {
   DCHECK_GE(len, 0);
+  if (parent_->write_pool() == NULL) {
+    RETURN_IF_ERROR(WriteToHdfs(data, len));
+  } else {
+    write_buffer_.insert(write_buffer_.end(), data, data + len);
+    if (write_buffer_.size() >= parent_->write_buffer_size()) {
+      RETURN_IF_ERROR(StartBufferedWrite());
+    }
+  }
+  COUNTER_ADD(parent_->bytes_written_counter(), len);
+  stats_.bytes_written += len;
+  return Status::OK();
+}
+
+Status HdfsTableWriter::FlushWrites() {
+  if (!write_buffer_.empty()) RETURN_IF_ERROR(StartBufferedWrite());
+  RETURN_IF_ERROR(WaitForPendingWrite());
+  // The next file starts without the errors of this one.
+  write_status_ = Status::OK();
+  return Status::OK();
+}
+
+Status HdfsTableWriter::WaitForPendingWrite() {
+  if (pending_write_.get() == NULL) return write_status_;
+  {
+    SCOPED_TIMER(parent_->write_stall_timer());
+    pending_write_->Get();
+  }
+  pending_write_.reset();
+  return write_status_;
+}
+
+Status HdfsTableWriter::StartBufferedWrite() {
+  // The buffer that is written is reused, so wait until its write is done.
+  RETURN_IF_ERROR(WaitForPendingWrite());
+  pending_write_buffer_.swap(write_buffer_);
+  write_buffer_.clear();
+  pending_write_.reset(new Promise<bool>());
+  if (!parent_->write_pool()->Offer(
+      bind<void>(mem_fn(&HdfsTableWriter::WritePendingBuffer), this))) {
+    WritePendingBuffer();
+  }
+  return Status::OK();
+}
+
+void HdfsTableWriter::WritePendingBuffer() {
+  DCHECK(pending_write_.get() != NULL);
+  DCHECK(!pending_write_buffer_.empty());
+  {
+    SCOPED_TIMER(parent_->async_write_timer());
+    Status status = WriteToHdfs(&pending_write_buffer_[0], pending_write_buffer_.size());
+    if (!status.ok() && write_status_.ok()) write_status_ = status;
+  }
+  pending_write_->Set(true);
+}
+
+Status HdfsTableWriter::WriteToHdfs(const uint8_t* data, int32_t len) {
   int ret = hdfsWrite(output_->hdfs_connection, output_->tmp_hdfs_file, data, len);
   if (ret == -1) {
     string error_msg = GetHdfsErrorMsg("");
@@ -45,8 +104,6 @@ Status HdfsTableWriter::Write(const uint8_t* data, int32_t len) {
         << " " << error_msg;
     return Status(msg.str());
   }
-  COUNTER_ADD(parent_->bytes_written_counter(), len);
-  stats_.bytes_written += len;
   return Status::OK();
 }
 }
@@ -23,6 +23,7 @@
 #include "runtime/descriptors.h"
 #include "exec/hdfs-table-sink.h"
 #include "util/hdfs-util.h"
+#include "util/promise.h"
 
 namespace impala {
 
@@ -44,7 +45,7 @@ class HdfsTableWriter {
                   const HdfsTableDescriptor* table_desc,
                   const std::vector<ExprContext*>& output_expr_ctxs);
 
-  virtual ~HdfsTableWriter() { }
+  virtual ~HdfsTableWriter() { DCHECK(pending_write_.get() == NULL); }
 
   /// The sequence of calls to this object are:
   /// 1. Init()
@@ -82,6 +83,24 @@ class HdfsTableWriter {
   /// Called once when this writer should cleanup any resources.
   virtual void Close() = 0;
 
+  /// Returns the estimated number of bytes of appended rows that the writer holds in
+  /// memory because they are not written to the current file yet.
+  virtual int64_t buffered_bytes() const { return 0; }
+
+  /// Writes out the buffered rows without finishing the current file, so that their
+  /// memory is released. Called by the table sink to keep the writers within their
+  /// shared memory budget.
+  virtual Status FlushBufferedRows() { return Status::OK(); }
+
+  /// Writes out the output that Write() buffered for the sink's write pool and waits
+  /// until it is written to the current file. Called after Finalize(), before the file
+  /// is closed.
+  Status FlushWrites();
+
+  /// Waits until the buffer handed off to the write pool, if any, is written. Returns
+  /// the first error of an asynchronous write to the current file.
+  Status WaitForPendingWrite();
+
   /// Returns the stats for this writer.
   TInsertStats& stats() { return stats_; };
 
@@ -97,7 +116,8 @@ class HdfsTableWriter {
   /// to minimize the overhead of Write()
   static const int HDFS_FLUSH_WRITE_SIZE = 50 * 1024;
 
-  /// Write to the current hdfs file.
+  /// Write to the current hdfs file. If the sink has a write pool, 'data' is copied into
+  /// write_buffer_, which is handed off to the pool once it is full.
   Status Write(const char* data, int32_t len) {
     return Write(reinterpret_cast<const uint8_t*>(data), len);
   }
@@ -126,6 +146,28 @@ class HdfsTableWriter {
   /// Subclass should populate any file format specific stats.
   TInsertStats stats_;
 
+ private:
+  /// Calls hdfsWrite() for the current file.
+  Status WriteToHdfs(const uint8_t* data, int32_t len);
+
+  /// Waits for the pending write, then hands off write_buffer_ to the write pool. The
+  /// buffers are swapped so that Write() keeps filling one while the other is written.
+  Status StartBufferedWrite();
+
+  /// Writes pending_write_buffer_ to the current file and sets pending_write_. Called
+  /// by the write pool, or by the sink thread if the pool is shut down.
+  void WritePendingBuffer();
+
+  /// Output that Write() buffered for the write pool.
+  std::vector<uint8_t> write_buffer_;
+
+  /// 'pending_write_' is set while pending_write_buffer_ is written by the write pool,
+  /// and is set by the pool thread when it finishes. 'write_status_' is only read after
+  /// that.
+  boost::scoped_ptr<Promise<bool> > pending_write_;
+  std::vector<uint8_t> pending_write_buffer_;
+  Status write_status_;
+
 };
 }
 #endif
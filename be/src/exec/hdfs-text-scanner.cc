@@ -47,6 +47,10 @@ const string HdfsTextScanner::LZO_INDEX_SUFFIX = ".index";
 // progress.
 const int64_t COMPRESSED_DATA_FIXED_READ_SIZE = 1 * 1024 * 1024;
 
+// The read size is doubled up to this size while streaming decompression does not make
+// progress, since decompressors of block formats need a whole block.
+const int64_t MAX_COMPRESSED_DATA_READ_SIZE = 64 * 1024 * 1024;
+
 HdfsTextScanner::HdfsTextScanner(HdfsScanNode* scan_node, RuntimeState* state)
     : HdfsScanner(scan_node, state),
       byte_buffer_ptr_(NULL),
@@ -445,9 +449,9 @@ Status HdfsTextScanner::FillByteBuffer(bool* eosr, int num_bytes) {
 
 Status HdfsTextScanner::DecompressBufferStream(int64_t bytes_to_read,
     uint8_t** decompressed_buffer, int64_t* decompressed_len, bool *eosr) {
-  // Some decompressors, such as Bzip2 API (version 0.9 and later) and Gzip can
-  // decompress buffers that are read from stream_, so we don't need to read the
-  // whole file in once. A compressed buffer is passed to ProcessBlockStreaming
+  // Some decompressors, such as Bzip2 API (version 0.9 and later), Gzip and Snappy
+  // block can decompress buffers that are read from stream_, so we don't need to read
+  // the whole file in once. A compressed buffer is passed to ProcessBlockStreaming
   // but it may not consume all of the input.
   uint8_t* compressed_buffer_ptr = NULL;
   int64_t compressed_buffer_size = 0;
@@ -517,11 +521,18 @@ Status HdfsTextScanner::FillByteBufferCompressedStream(bool* eosr) {
     // make progress if the compressed buffer returned by GetBytes() is too small.
     // (Note that this did not even occur in simple experiments where the input buffer
     // is always 1 byte, but we need to handle this case to be defensive.) In this
-    // case, try again with a reasonably large fixed size buffer. If we still did not
-    // make progress, then return an error.
+    // case, try again with a reasonably large fixed size buffer. Snappy block
+    // compressed data needs a whole block, which may span several buffers, so the
+    // buffer is enlarged until a block fits. If we still did not make progress, then
+    // return an error.
     LOG(INFO) << status.GetDetail();
-    status = DecompressBufferStream(COMPRESSED_DATA_FIXED_READ_SIZE,
-        &decompressed_buffer, &decompressed_len, eosr);
+    int64_t bytes_to_read = COMPRESSED_DATA_FIXED_READ_SIZE;
+    do {
+      status = DecompressBufferStream(bytes_to_read, &decompressed_buffer,
+          &decompressed_len, eosr);
+      bytes_to_read *= 2;
+    } while (status.code() == TErrorCode::COMPRESSED_FILE_DECOMPRESSOR_NO_PROGRESS &&
+        bytes_to_read <= MAX_COMPRESSED_DATA_READ_SIZE);
   }
   RETURN_IF_ERROR(status);
   byte_buffer_ptr_ = reinterpret_cast<char*>(decompressed_buffer);
@@ -746,9 +757,11 @@ int HdfsTextScanner::WriteFields(MemPool* pool, TupleRow* tuple_row,
   if (slot_idx_ != 0) {
     DCHECK(tuple_ != NULL);
     int num_partial_fields = scan_node_->materialized_slots().size() - slot_idx_;
-    // Corner case where there will be no materialized tuples but at least one col
-    // worth of string data.  In this case, make a deep copy and reuse the byte buffer.
-    bool copy_strings = num_partial_fields > num_fields;
+    // If the tuple is completed and added to the row batch below, its strings can
+    // point into the byte buffer like those of the other tuples of this batch.
+    // Otherwise the tuple is still partial after this call and the byte buffer may be
+    // gone when it is completed, so make a deep copy.
+    bool copy_strings = num_partial_fields > num_fields || num_tuples == 0;
     num_partial_fields = min(num_partial_fields, num_fields);
     WritePartialTuple(fields, num_partial_fields, copy_strings);
 
@@ -823,10 +836,9 @@ int HdfsTextScanner::WriteFields(MemPool* pool, TupleRow* tuple_row,
   if (num_fields != 0) {
     DCHECK(tuple_ != NULL);
     InitTuple(template_tuple_, partial_tuple_);
-    // If there have been no materialized tuples at this point, copy string data
-    // out of byte_buffer and reuse the byte_buffer.  The copied data can be at
-    // most one tuple's worth.
-    WritePartialTuple(fields, num_fields, num_tuples_materialized == 0);
+    // The tuple is completed from a later byte buffer, so copy string data out of
+    // this one. The copied data can be at most one tuple's worth.
+    WritePartialTuple(fields, num_fields, true);
     partial_tuple_empty_ = false;
   }
   DCHECK_LE(slot_idx_, scan_node_->materialized_slots().size());
@@ -864,7 +876,7 @@ int HdfsTextScanner::WritePartialTuple(FieldLocation* fields,
 
     const SlotDescriptor* desc = scan_node_->materialized_slots()[slot_idx_];
     if (!text_converter_->WriteSlot(desc, partial_tuple_,
-        fields[i].start, len, true, need_escape, data_buffer_pool_.get())) {
+        fields[i].start, len, copy_strings, need_escape, data_buffer_pool_.get())) {
       ReportColumnParseError(desc, fields[i].start, len);
       error_in_row_ = true;
     }
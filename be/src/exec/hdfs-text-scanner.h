@@ -115,6 +115,7 @@ class HdfsTextScanner : public HdfsScanner {
 
   /// Fills the next byte buffer from the compressed data in stream_ by reading the entire
   /// file, decompressing it, and setting the byte_buffer_ptr_ to the decompressed buffer.
+  /// Only used for codecs that do not support streaming.
   Status FillByteBufferCompressedFile(bool* eosr);
 
   /// Fills the next byte buffer from the compressed data in stream_. Unlike
@@ -157,7 +158,8 @@ class HdfsTextScanner : public HdfsScanner {
 
   /// Utility function to write out 'num_fields' to 'tuple_'.  This is used to parse
   /// partial tuples.  Returns bytes processed.  If copy_strings is true, strings
-  /// from fields will be copied into the boundary pool.
+  /// from fields will be copied into data_buffer_pool_. Otherwise they point into the
+  /// byte buffer, which must outlive the tuple.
   int WritePartialTuple(FieldLocation*, int num_fields, bool copy_strings);
 
   /// Appends the current file and line to the RuntimeState's error log.
@@ -26,6 +26,7 @@ using namespace impala;
 
 extern string EncodeNdv(const string& ndv, bool* is_encoded);
 extern string DecodeNdv(const string& ndv, bool is_encoded);
+extern void MergeNdv(const string& ndv, bool is_encoded, string* intermediate_ndv);
 
 static const int HLL_LEN = pow(2, AggregateFunctions::HLL_PRECISION);
 
@@ -69,6 +70,31 @@ TEST(RleTest, TestEncode) {
   ASSERT_EQ(DecodeNdv(encoded, is_encoded), test);
 }
 
+// Merging an encoded NDV must give the same buckets as merging its decoded form.
+TEST(RleTest, TestMerge) {
+  string sparse(HLL_LEN, 0);
+  for (int i = 0; i < HLL_LEN; i += 100) sparse[i] = 3;
+  string dense;
+  for (int i = 0; i < HLL_LEN; ++i) dense += static_cast<char>(i % 5);
+
+  string expected(HLL_LEN, 0);
+  for (int i = 0; i < HLL_LEN; ++i) expected[i] = max(sparse[i], dense[i]);
+
+  for (const string& ndv: {sparse, dense}) {
+    bool is_encoded;
+    const string& encoded = EncodeNdv(ndv, &is_encoded);
+    string merged(HLL_LEN, 0);
+    MergeNdv(encoded, is_encoded, &merged);
+    ASSERT_EQ(ndv, merged);
+  }
+
+  bool sparse_encoded;
+  const string& encoded_sparse = EncodeNdv(sparse, &sparse_encoded);
+  ASSERT_TRUE(sparse_encoded);
+  string merged = dense;
+  MergeNdv(encoded_sparse, sparse_encoded, &merged);
+  ASSERT_EQ(expected, merged);
+}
 
 int main(int argc, char** argv) {
   //InitCommonRuntime(argc, argv, true);
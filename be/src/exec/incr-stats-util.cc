@@ -109,6 +109,35 @@ string DecodeNdv(const string& ndv, bool is_encoded) {
   return decoded_ndv;
 }
 
+// Merges the intermediate NDV state 'ndv', which is RLE-compressed if 'is_encoded', into
+// the HLL buckets 'intermediate_ndv'. Runs of equal buckets are merged directly, without
+// first decoding 'ndv' into a temporary string.
+void MergeNdv(const string& ndv, bool is_encoded, string* intermediate_ndv) {
+  DCHECK_EQ(intermediate_ndv->size(), AggregateFunctions::HLL_LEN);
+  char* buckets = &(*intermediate_ndv)[0];
+  if (!is_encoded) {
+    DCHECK_EQ(ndv.size(), AggregateFunctions::HLL_LEN);
+    for (int i = 0; i < ndv.size(); ++i) buckets[i] = ::max(buckets[i], ndv[i]);
+    return;
+  }
+  DCHECK_EQ(ndv.size() % 2, 0);
+  int idx = 0;
+  for (int i = 0; i < ndv.size(); i += 2) {
+    int run_length = static_cast<uint8_t>(ndv[i]) + 1;
+    char value = ndv[i + 1];
+    DCHECK_LE(idx + run_length, AggregateFunctions::HLL_LEN);
+    // Empty partitions have all-zero runs, which never change the buckets.
+    if (value == 0) {
+      idx += run_length;
+      continue;
+    }
+    for (int j = 0; j < run_length; ++j, ++idx) {
+      buckets[idx] = ::max(buckets[idx], value);
+    }
+  }
+  DCHECK_EQ(idx, AggregateFunctions::HLL_LEN);
+}
+
 // A container for statistics for a single column that are aggregated partition by
 // partition during the incremental computation of column stats. The aggregations are
 // updated during Update(), and the final statistics are computed by Finalize().
@@ -144,13 +173,25 @@ struct PerColumnStats {
   void Update(const string& ndv, int64_t num_new_rows, double new_avg_width,
       int32_t max_new_width, int64_t num_new_nulls) {
     DCHECK_EQ(intermediate_ndv.size(), ndv.size()) << "Incompatible intermediate NDVs";
+    MergeNdv(ndv, false, &intermediate_ndv);
+    UpdateCounts(num_new_rows, new_avg_width, max_new_width, num_new_nulls);
+  }
+
+  // Updates all aggregate statistics with the saved measurements of a partition. The
+  // intermediate NDV is merged in its stored, possibly RLE-compressed, form.
+  void Update(const TIntermediateColumnStats& int_stats) {
+    MergeNdv(int_stats.intermediate_ndv, int_stats.is_ndv_encoded, &intermediate_ndv);
+    UpdateCounts(int_stats.num_rows, int_stats.avg_width, int_stats.max_width,
+        int_stats.num_nulls);
+  }
+
+  // Updates the aggregate statistics other than the intermediate NDV.
+  void UpdateCounts(int64_t num_new_rows, double new_avg_width, int32_t max_new_width,
+      int64_t num_new_nulls) {
     DCHECK_GE(num_new_rows, 0);
     DCHECK_GE(max_new_width, 0);
     DCHECK_GE(new_avg_width, 0);
     DCHECK_GE(num_new_nulls, -1);
-    for (int j = 0; j < ndv.size(); ++j) {
-      intermediate_ndv[j] = ::max(intermediate_ndv[j], ndv[j]);
-    }
     if (num_new_nulls >= 0) num_nulls += num_new_nulls;
     max_width = ::max(max_width, max_new_width);
     avg_width += (new_avg_width * num_new_rows);
@@ -237,8 +278,9 @@ void FinalizePartitionedColumnStats(const TTableSchema& col_stats_schema,
         int_stats.__set_avg_width(avg_width);
         int_stats.__set_num_rows(num_rows);
 
-        part_stat->intermediate_col_stats[col_stats_schema.columns[i].columnName] =
-            int_stats;
+        // Swap rather than copy the encoded NDV into the partition's entry.
+        swap(part_stat->intermediate_col_stats[col_stats_schema.columns[i].columnName],
+            int_stats);
       }
     }
   }
@@ -285,10 +327,7 @@ void FinalizePartitionedColumnStats(const TTableSchema& col_stats_schema,
         continue;
       }
 
-      const TIntermediateColumnStats& int_stats = it->second;
-      stats[i].Update(DecodeNdv(int_stats.intermediate_ndv, int_stats.is_ndv_encoded),
-          int_stats.num_rows, int_stats.avg_width, int_stats.max_width,
-          int_stats.num_nulls);
+      stats[i].Update(it->second);
     }
   }
 
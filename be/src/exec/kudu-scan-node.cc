@@ -27,6 +27,7 @@
 #include "gutil/gscoped_ptr.h"
 #include "gutil/strings/substitute.h"
 #include "gutil/stl_util.h"
+#include "runtime/exec-env.h"
 #include "runtime/mem-pool.h"
 #include "runtime/runtime-state.h"
 #include "runtime/row-batch.h"
@@ -37,6 +38,7 @@
 #include "util/jni-util.h"
 #include "util/periodic-counter-updater.h"
 #include "util/runtime-profile-counters.h"
+#include "util/time.h"
 
 #include "common/names.h"
 
@@ -45,7 +47,12 @@ DEFINE_int32(kudu_max_row_batches, 0, "The maximum size of the row batch queue,
 DEFINE_int32(kudu_scanner_keep_alive_period_us, 15 * 1000L * 1000L,
     "The period at which Kudu Scanners should send keep-alive requests to the tablet "
     "server to ensure that scanners do not time out.");
+DEFINE_string(kudu_read_mode, "READ_LATEST", "The read mode of Kudu scans. "
+    "READ_LATEST reads the latest committed data of each tablet. READ_AT_SNAPSHOT reads "
+    "all tablets of a scan at the same timestamp, taken when the scan is opened, which "
+    "may wait for in-flight writes to those tablets to commit.");
 
+using boost::algorithm::iequals;
 using boost::algorithm::to_lower_copy;
 using kudu::client::KuduClient;
 using kudu::client::KuduColumnSchema;
@@ -73,6 +80,8 @@ KuduScanNode::KuduScanNode(ObjectPool* pool, const TPlanNode& tnode,
       next_scan_range_idx_(0),
       num_active_scanners_(0),
       done_(false),
+      read_mode_(kudu::client::KuduScanner::READ_LATEST),
+      snapshot_micros_(0),
       pushable_conjuncts_(tnode.kudu_scan_node.kudu_conjuncts),
       thread_avail_cb_id_(-1) {
   DCHECK(KuduIsAvailable());
@@ -114,6 +123,11 @@ Status KuduScanNode::Prepare(RuntimeState* state) {
         10 * (DiskInfo::num_disks() + DiskIoMgr::REMOTE_NUM_DISKS);
   }
   materialized_row_batches_.reset(new RowBatchQueue(max_materialized_row_batches_));
+
+  if (!state->cgroup().empty()) {
+    scanner_threads_.SetCgroupsMgr(state->exec_env()->cgroups_mgr());
+    scanner_threads_.SetCgroup(state->cgroup());
+  }
   return Status::OK();
 }
 
@@ -122,10 +136,22 @@ Status KuduScanNode::Open(RuntimeState* state) {
   RETURN_IF_CANCELLED(state);
   RETURN_IF_ERROR(QueryMaintenance(state));
   SCOPED_TIMER(runtime_profile_->total_time_counter());
+  SCOPED_PERF_EVENT_MEASUREMENT(perf_event_counters_);
+  SCOPED_CPU_SAMPLE_NODE(id_);
 
   const KuduTableDescriptor* table_desc =
       static_cast<const KuduTableDescriptor*>(tuple_desc_->table_desc());
 
+  if (iequals(FLAGS_kudu_read_mode, "READ_AT_SNAPSHOT")) {
+    read_mode_ = kudu::client::KuduScanner::READ_AT_SNAPSHOT;
+    // All scanners of this node read at the same snapshot so that the rows of different
+    // tablets are consistent with each other.
+    snapshot_micros_ = UnixMillis() * 1000L;
+  } else if (!iequals(FLAGS_kudu_read_mode, "READ_LATEST")) {
+    return Status(Substitute("Invalid Kudu read mode: '$0'. Valid values are "
+        "READ_LATEST and READ_AT_SNAPSHOT.", FLAGS_kudu_read_mode));
+  }
+
   kudu::client::KuduClientBuilder b;
   for (const string& address: table_desc->kudu_master_addresses()) {
     b.add_master_server_addr(address);
@@ -161,6 +187,8 @@ Status KuduScanNode::GetNext(RuntimeState* state, RowBatch* row_batch, bool* eos
   RETURN_IF_CANCELLED(state);
   RETURN_IF_ERROR(QueryMaintenance(state));
   SCOPED_TIMER(runtime_profile_->total_time_counter());
+  SCOPED_PERF_EVENT_MEASUREMENT(perf_event_counters_);
+  SCOPED_CPU_SAMPLE_NODE(id_);
   SCOPED_TIMER(materialize_tuple_timer());
 
   if (ReachedLimit() || key_ranges_.empty()) {
@@ -409,6 +437,7 @@ void KuduScanNode::ThreadTokenAvailableCb(
 }
 
 void KuduScanNode::ScannerThread(const string& name, const TKuduKeyRange* key_range) {
+  runtime_state_->resource_pool()->BindCurrentThreadToNumaNode();
   SCOPED_THREAD_COUNTER_MEASUREMENT(scanner_thread_counters());
   SCOPED_TIMER(runtime_state_->total_cpu_timer());
 
@@ -424,8 +453,9 @@ void KuduScanNode::ScannerThread(const string& name, const TKuduKeyRange* key_ra
     bool eos = false;
     while (!eos) {
       // Keep looping through all the rows.
-      gscoped_ptr<RowBatch> row_batch(new RowBatch(
-          row_desc(), runtime_state_->batch_size(), mem_tracker()));
+      gscoped_ptr<RowBatch> row_batch(new RowBatch(row_desc(),
+          RowBatch::AdaptiveCapacity(row_desc(), runtime_state_->batch_size()),
+          mem_tracker()));
       status = scanner.GetNext(row_batch.get(), &eos);
       if (!status.ok()) goto done;
       while (true) {
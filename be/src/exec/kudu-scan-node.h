@@ -117,6 +117,11 @@ class KuduScanNode : public ScanNode {
   /// Protected by lock_
   volatile bool done_;
 
+  /// The read mode of all scanners, set from --kudu_read_mode in Open(). For
+  /// READ_AT_SNAPSHOT, 'snapshot_micros_' is the timestamp that all scanners read at.
+  kudu::client::KuduScanner::ReadMode read_mode_;
+  uint64_t snapshot_micros_;
+
   /// Maximum size of materialized_row_batches_.
   int max_materialized_row_batches_;
 
@@ -176,6 +181,9 @@ class KuduScanNode : public ScanNode {
 
   const TupleDescriptor* tuple_desc() const { return tuple_desc_; }
 
+  kudu::client::KuduScanner::ReadMode read_mode() const { return read_mode_; }
+  uint64_t snapshot_micros() const { return snapshot_micros_; }
+
   // Returns a cloned copy of the scan node's conjuncts. Requires that the expressions
   // have been open previously.
   Status GetConjunctCtxs(vector<ExprContext*>* ctxs);
@@ -51,6 +51,9 @@ DEFINE_int32(kudu_scanner_keep_alive_period_sec, 15,
 
 DEFINE_int32(kudu_scanner_timeout_sec, 60,
              "The timeout used for Kudu Scan requests.");
+DEFINE_int32(kudu_scanner_batch_size_bytes, 0, "The maximum number of bytes of row data "
+    "that a Kudu tablet server returns per scan round trip. Larger batches need fewer "
+    "round trips for large tablets. If <= 0, the Kudu client's default is used.");
 
 namespace impala {
 
@@ -182,6 +185,19 @@ Status KuduScanner::OpenNextRange(const TKuduKeyRange& key_range)  {
       FLAGS_kudu_scanner_timeout_sec * 1000),
       "Could not set scanner timeout");
 
+  if (FLAGS_kudu_scanner_batch_size_bytes > 0) {
+    KUDU_RETURN_IF_ERROR(
+        scanner_->SetBatchSizeBytes(FLAGS_kudu_scanner_batch_size_bytes),
+        "Could not set scanner batch size");
+  }
+
+  KUDU_RETURN_IF_ERROR(scanner_->SetReadMode(scan_node_->read_mode()),
+      "Could not set scanner read mode");
+  if (scan_node_->read_mode() == kudu::client::KuduScanner::READ_AT_SNAPSHOT) {
+    KUDU_RETURN_IF_ERROR(scanner_->SetSnapshotMicros(scan_node_->snapshot_micros()),
+        "Could not set scanner snapshot timestamp");
+  }
+
   {
     SCOPED_TIMER(scan_node_->kudu_read_timer());
     KUDU_RETURN_IF_ERROR(scanner_->Open(), "Unable to open scanner");
@@ -35,6 +35,8 @@
 #include "util/cpu-info.h"
 #include "util/test-info.h"
 
+DECLARE_bool(kudu_sink_async_flush);
+
 using apache::thrift::ThriftDebugString;
 
 namespace impala {
@@ -229,6 +231,7 @@ class KuduTableSinkTest : public testing::Test {
     row_batches.push_back(CreateRowBatch(kNumRowsPerBatch, kNumRowsPerBatch, factor, val,
                                          skip_val));
     ASSERT_OK(sink.Send(&runtime_state_,row_batches.back(), true));
+    ASSERT_OK(sink.FlushFinal(&runtime_state_));
     STLDeleteElements(&row_batches);
     sink.Close(&runtime_state_);
     Verify(num_columns, 2 * kNumRowsPerBatch, factor, val, skip_val);
@@ -274,6 +277,12 @@ TEST_F(KuduTableSinkTest, TestInsertAllCols) {
   InsertAndVerify(3);
 }
 
+TEST_F(KuduTableSinkTest, TestInsertSynchronousFlush) {
+  FLAGS_kudu_sink_async_flush = false;
+  InsertAndVerify(3);
+  FLAGS_kudu_sink_async_flush = true;
+}
+
 TEST_F(KuduTableSinkTest, UpdateTwoCols) {
   InsertAndVerify(2);
   UpdateAndVerify(2);
@@ -30,6 +30,11 @@
 
 DEFINE_int32(kudu_session_timeout_seconds, 60, "Timeout set on the Kudu session. "
     "How long to wait before considering a write failed.");
+DEFINE_bool(kudu_sink_async_flush, true, "If true, the Kudu sink flushes the rows of a "
+    "row batch in the background while it converts the rows of the next batch.");
+DEFINE_int32(kudu_mutation_buffer_size, 0, "The size in bytes of the buffer that a Kudu "
+    "session holds the rows of an unflushed row batch in. If <= 0, the Kudu client's "
+    "default is used. Must be large enough for the rows of a row batch.");
 
 using kudu::client::KuduColumnSchema;
 using kudu::client::KuduSchema;
@@ -55,6 +60,7 @@ KuduTableSink::KuduTableSink(const RowDescriptor& row_desc,
       select_list_texprs_(select_list_texprs),
       sink_action_(tsink.table_sink.action),
       kudu_table_sink_(tsink.table_sink.kudu_table_sink),
+      num_flush_rows_(0),
       kudu_flush_counter_(NULL),
       kudu_flush_timer_(NULL),
       kudu_error_counter_(NULL),
@@ -130,6 +136,10 @@ Status KuduTableSink::Open(RuntimeState* state) {
   session_->SetTimeoutMillis(FLAGS_kudu_session_timeout_seconds * 1000);
   KUDU_RETURN_IF_ERROR(session_->SetFlushMode(
       kudu::client::KuduSession::MANUAL_FLUSH), "Unable to set flush mode");
+  if (FLAGS_kudu_mutation_buffer_size > 0) {
+    KUDU_RETURN_IF_ERROR(session_->SetMutationBufferSpace(
+        FLAGS_kudu_mutation_buffer_size), "Unable to set mutation buffer size");
+  }
   return Status::OK();
 }
 
@@ -226,6 +236,12 @@ Status KuduTableSink::Send(RuntimeState* state, RowBatch* batch, bool eos) {
     ++rows_added;
   }
   COUNTER_ADD(rows_written_, rows_added);
+  if (FLAGS_kudu_sink_async_flush) {
+    // The rows of this batch were converted while the previous flush was in flight.
+    RETURN_IF_ERROR(WaitForAsyncFlush(state));
+    StartAsyncFlush(rows_added);
+    return Status::OK();
+  }
   int64_t error_count = 0;
   RETURN_IF_ERROR(Flush(&error_count));
   (*state->per_partition_status())[ROOT_PARTITION_KEY].num_appended_rows +=
@@ -233,6 +249,30 @@ Status KuduTableSink::Send(RuntimeState* state, RowBatch* batch, bool eos) {
   return Status::OK();
 }
 
+void KuduTableSink::StartAsyncFlush(int num_rows) {
+  DCHECK(flush_cb_ == NULL);
+  flush_cb_.reset(new FlushCallback());
+  num_flush_rows_ = num_rows;
+  COUNTER_ADD(kudu_flush_counter_, 1);
+  session_->FlushAsync(flush_cb_.get());
+}
+
+Status KuduTableSink::WaitForAsyncFlush(RuntimeState* state) {
+  if (flush_cb_ == NULL) return Status::OK();
+  kudu::Status s;
+  {
+    SCOPED_TIMER(kudu_flush_timer_);
+    s = flush_cb_->Wait();
+  }
+  flush_cb_.reset();
+  int64_t error_count = 0;
+  Status status = CheckFlushErrors(s, &error_count);
+  (*state->per_partition_status())[ROOT_PARTITION_KEY].num_appended_rows +=
+      num_flush_rows_ - error_count;
+  num_flush_rows_ = 0;
+  return status;
+}
+
 Status KuduTableSink::Flush(int64_t* error_count) {
   // TODO right now we always flush an entire row batch, if these are small we'll
   // be inefficient. Consider decoupling impala's batch size from kudu's
@@ -242,6 +282,10 @@ Status KuduTableSink::Flush(int64_t* error_count) {
     COUNTER_ADD(kudu_flush_counter_, 1);
     s = session_->Flush();
   }
+  return CheckFlushErrors(s, error_count);
+}
+
+Status KuduTableSink::CheckFlushErrors(const kudu::Status& s, int64_t* error_count) {
   if (LIKELY(s.ok())) return Status::OK();
 
   stringstream error_msg_buffer;
@@ -285,13 +329,20 @@ Status KuduTableSink::Flush(int64_t* error_count) {
 }
 
 Status KuduTableSink::FlushFinal(RuntimeState* state) {
-  // No buffered state to flush.
-  return Status::OK();
+  // All rows were applied and flushed by Send(), only the last flush may be in flight.
+  SCOPED_TIMER(runtime_profile_->total_time_counter());
+  return WaitForAsyncFlush(state);
 }
 
 void KuduTableSink::Close(RuntimeState* state) {
   if (closed_) return;
   SCOPED_TIMER(runtime_profile_->total_time_counter());
+  // The Kudu client calls back into 'flush_cb_', so it must not be destroyed while the
+  // flush is in flight. Its errors were not asked for, e.g. because the query failed.
+  if (flush_cb_ != NULL) {
+    flush_cb_->Wait();
+    flush_cb_.reset();
+  }
   Expr::Close(output_expr_ctxs_, state);
   closed_ = true;
 }
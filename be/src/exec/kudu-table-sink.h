@@ -24,20 +24,21 @@
 #include "exec/data-sink.h"
 #include "exprs/expr-context.h"
 #include "exprs/expr.h"
+#include "util/promise.h"
 
 namespace impala {
 
 /// Sink that takes RowBatches and writes them into Kudu.
-/// Currently the data is sent to Kudu on Send(), i.e. the data is batched on the
-/// KuduSession until all the rows in a RowBatch are applied and then the session
-/// is flushed.
+/// The data is sent to Kudu on Send(), i.e. the data is batched on the KuduSession
+/// until all the rows in a RowBatch are applied and then the session is flushed.
+/// By default (--kudu_sink_async_flush) the flush is asynchronous: Send() returns while
+/// Kudu writes the batch, so that the rows of the next batch are converted while the
+/// previous ones are written. At most one flush is in flight; its errors are reported
+/// by the next Send() or by FlushFinal().
 ///
 /// Kudu doesn't have transactions (yet!) so some rows may fail to write while
 /// others are successful. This sink will return an error if any of the rows fails
 /// to be written.
-///
-/// TODO Once Kudu actually implements AUTOFLUSH_BACKGROUND flush mode we should
-/// change the flushing behavior as it will likely make writes more efficient.
 class KuduTableSink : public DataSink {
  public:
   KuduTableSink(const RowDescriptor& row_desc,
@@ -54,10 +55,10 @@ class KuduTableSink : public DataSink {
   /// The KuduSession is flushed on each row batch.
   virtual Status Send(RuntimeState* state, RowBatch* batch, bool eos);
 
-  /// Does nothing. We currently flush on each Send() call.
+  /// Waits for the flush that is in flight, if any, and returns its errors.
   virtual Status FlushFinal(RuntimeState* state);
 
-  /// Closes the KuduSession and the expressions.
+  /// Waits for the flush that is in flight, if any, and closes the expressions.
   virtual void Close(RuntimeState* state);
 
   virtual RuntimeProfile* profile() { return runtime_profile_; }
@@ -76,6 +77,35 @@ class KuduTableSink : public DataSink {
   /// status even if 'error_count' is > 0, as some errors might be ignored.
   Status Flush(int64_t* error_count);
 
+  /// Handles the result 's' of a flush of the Kudu session. Same as Flush() otherwise.
+  Status CheckFlushErrors(const kudu::Status& s, int64_t* error_count);
+
+  /// Starts an asynchronous flush of the operations applied to the Kudu session. No
+  /// other flush may be in flight.
+  void StartAsyncFlush(int num_rows);
+
+  /// Waits for the asynchronous flush that is in flight, if any, handles its errors and
+  /// counts its rows as appended in 'state'.
+  Status WaitForAsyncFlush(RuntimeState* state);
+
+  /// Receives the result of an asynchronous flush from Kudu.
+  class FlushCallback : public kudu::client::KuduStatusCallback {
+   public:
+    virtual void Run(const kudu::Status& s) { status_.Set(s); }
+
+    /// Blocks until the flush finished and returns its result.
+    const kudu::Status& Wait() { return status_.Get(); }
+
+   private:
+    Promise<kudu::Status> status_;
+  };
+
+  /// The callback of the asynchronous flush in flight, NULL if there is none.
+  boost::scoped_ptr<FlushCallback> flush_cb_;
+
+  /// The number of rows that the flush in flight writes.
+  int num_flush_rows_;
+
   /// Used to get the KuduTableDescriptor from the RuntimeState
   TableId table_id_;
 
@@ -38,7 +38,11 @@ NestedLoopJoinNode::NestedLoopJoinNode(ObjectPool* pool, const TPlanNode& tnode,
         tnode, descs),
     build_batches_(NULL),
     current_build_row_idx_(0),
-    process_unmatched_build_rows_(false) {
+    process_unmatched_build_rows_(false),
+    probe_tile_start_(0),
+    probe_tile_end_(-1),
+    probe_tile_idx_(0),
+    build_tile_idx_(0) {
 }
 
 NestedLoopJoinNode::~NestedLoopJoinNode() {
@@ -73,7 +77,7 @@ Status NestedLoopJoinNode::Prepare(RuntimeState* state) {
   RETURN_IF_ERROR(Expr::Prepare(
       join_conjunct_ctxs_, state, full_row_desc, expr_mem_tracker()));
   build_batch_cache_.reset(new RowBatchCache(
-      child(1)->row_desc(), state->batch_size(), mem_tracker()));
+      child(1)->row_desc(), ChildBatchCapacity(state, 1), mem_tracker()));
 
   // For some join modes we need to record the build rows with matches in a bitmap.
   if (join_op_ == TJoinOp::RIGHT_ANTI_JOIN || join_op_ == TJoinOp::RIGHT_SEMI_JOIN ||
@@ -103,6 +107,7 @@ Status NestedLoopJoinNode::Reset(RuntimeState* state) {
   current_probe_row_ = NULL;
   probe_batch_pos_ = 0;
   process_unmatched_build_rows_ = false;
+  probe_tile_end_ = -1;
   build_batch_cache_->Reset();
   return BlockingJoinNode::Reset(state);
 }
@@ -224,6 +229,7 @@ Status NestedLoopJoinNode::InitGetNext(TupleRow* first_left_row) {
   build_row_iterator_ = build_batches_->Iterator();
   current_build_row_idx_ = 0;
   matched_probe_ = false;
+  probe_tile_end_ = -1;
   return Status::OK();
 }
 
@@ -231,6 +237,8 @@ Status NestedLoopJoinNode::GetNext(RuntimeState* state, RowBatch* output_batch,
     bool* eos) {
   DCHECK(!output_batch->AtCapacity());
   SCOPED_TIMER(runtime_profile_->total_time_counter());
+  SCOPED_PERF_EVENT_MEASUREMENT(perf_event_counters_);
+  SCOPED_CPU_SAMPLE_NODE(id_);
   RETURN_IF_ERROR(ExecDebugAction(TExecNodePhase::GETNEXT, state));
   RETURN_IF_CANCELLED(state);
   RETURN_IF_ERROR(QueryMaintenance(state));
@@ -294,7 +302,7 @@ Status NestedLoopJoinNode::GetNextInnerJoin(RuntimeState* state,
     DCHECK(HasValidProbeRow());
     bool return_output_batch;
     RETURN_IF_ERROR(
-        FindBuildMatches(state, output_batch, &return_output_batch));
+        FindBuildMatchesTiled(state, output_batch, &return_output_batch));
     if (return_output_batch) return Status::OK();
     RETURN_IF_ERROR(NextProbeRow(state, output_batch));
     if (output_batch->AtCapacity()) break;
@@ -656,6 +664,72 @@ Status NestedLoopJoinNode::FindBuildMatches(
   return Status::OK();
 }
 
+Status NestedLoopJoinNode::FindBuildMatchesTiled(
+    RuntimeState* state, RowBatch* output_batch, bool* return_output_batch) {
+  DCHECK(join_op_ == TJoinOp::INNER_JOIN || join_op_ == TJoinOp::CROSS_JOIN);
+  DCHECK(matching_build_rows_ == NULL);
+  DCHECK(HasValidProbeRow());
+  *return_output_batch = false;
+  ExprContext* const* join_conjunct_ctxs = &join_conjunct_ctxs_[0];
+  size_t num_join_ctxs = join_conjunct_ctxs_.size();
+  ExprContext* const* conjunct_ctxs = &conjunct_ctxs_[0];
+  size_t num_ctxs = conjunct_ctxs_.size();
+
+  if (probe_tile_end_ == -1) {
+    probe_tile_start_ = probe_batch_pos_ - 1;
+    probe_tile_end_ = probe_batch_->num_rows();
+    probe_tile_idx_ = probe_tile_start_;
+    build_tile_idx_ = 0;
+    build_tile_batch_ = build_batches_->BatchesBegin();
+  }
+
+  const int N = BitUtil::RoundUpToPowerOfTwo(state->batch_size());
+  int num_pairs = 0;
+  for (; build_tile_batch_ != build_batches_->BatchesEnd();
+       ++build_tile_batch_, probe_tile_idx_ = probe_tile_start_) {
+    RowBatch* build_batch = *build_tile_batch_;
+    const int num_build_rows = build_batch->num_rows();
+    for (; probe_tile_idx_ < probe_tile_end_; ++probe_tile_idx_, build_tile_idx_ = 0) {
+      TupleRow* probe_row = probe_batch_->GetRow(probe_tile_idx_);
+      while (build_tile_idx_ < num_build_rows) {
+        TupleRow* output_row = output_batch->GetRow(output_batch->AddRow());
+        CreateOutputRow(output_row, probe_row, build_batch->GetRow(build_tile_idx_));
+        ++build_tile_idx_;
+
+        // This loop can go on for a long time if the conjuncts are very selective. Do
+        // expensive query maintenance after every N iterations.
+        if ((++num_pairs & (N - 1)) == 0) {
+          if (ReachedLimit()) {
+            eos_ = true;
+            *return_output_batch = true;
+            COUNTER_ADD(rows_returned_counter_, output_batch->num_rows());
+            return Status::OK();
+          }
+          RETURN_IF_CANCELLED(state);
+          RETURN_IF_ERROR(QueryMaintenance(state));
+        }
+        if (!EvalConjuncts(join_conjunct_ctxs, num_join_ctxs, output_row)) continue;
+        if (!EvalConjuncts(conjunct_ctxs, num_ctxs, output_row)) continue;
+        VLOG_ROW << "match row: " << PrintRow(output_row, row_desc());
+        output_batch->CommitLastRow();
+        ++num_rows_returned_;
+        if (output_batch->AtCapacity()) {
+          *return_output_batch = true;
+          COUNTER_ADD(rows_returned_counter_, output_batch->num_rows());
+          return Status::OK();
+        }
+      }
+    }
+  }
+
+  // The whole tile was joined. Continue with the first probe row after it.
+  probe_batch_pos_ = probe_tile_end_;
+  current_probe_row_ = probe_batch_->GetRow(probe_tile_end_ - 1);
+  probe_tile_end_ = -1;
+  COUNTER_ADD(rows_returned_counter_, output_batch->num_rows());
+  return Status::OK();
+}
+
 Status NestedLoopJoinNode::NextProbeRow(RuntimeState* state, RowBatch* output_batch) {
   current_probe_row_ = NULL;
   matched_probe_ = false;
@@ -678,6 +752,7 @@ Status NestedLoopJoinNode::NextProbeRow(RuntimeState* state, RowBatch* output_ba
   // We have a valid probe row; reset the build row iterator.
   build_row_iterator_ = build_batches_->Iterator();
   current_build_row_idx_ = 0;
+  probe_tile_end_ = -1;
   VLOG_ROW << "left row: " << GetLeftChildRowString(current_probe_row_);
   return Status::OK();
 }
@@ -42,6 +42,12 @@ class RowBatchCache;
 /// this node. If the batches reference tuple data they do not own, the copying mode is
 /// used and all data is deep copied into memory owned by this node.
 ///
+/// Inner and cross joins are evaluated block-wise: the remaining rows of the current
+/// probe batch form a tile that is joined with one build batch at a time, so that each
+/// build batch is read from the caches for the whole tile instead of once per probe row.
+/// The other join modes need to know when all build rows were seen for a probe row and
+/// iterate the build rows of one probe row at a time.
+///
 /// TODO: Add support for null-aware left-anti join.
 class NestedLoopJoinNode : public BlockingJoinNode {
  public:
@@ -94,6 +100,17 @@ class NestedLoopJoinNode : public BlockingJoinNode {
   /// RIGHT OUTER JOIN, RIGHT ANTI JOIN and FULL OUTER JOIN modes.
   bool process_unmatched_build_rows_;
 
+  /// State of FindBuildMatchesTiled(). The tile covers the rows
+  /// [probe_tile_start_, probe_tile_end_) of probe_batch_. probe_tile_end_ is -1 if
+  /// no tile was started for the current probe row. build_tile_batch_ is the build
+  /// batch that is joined with the tile, and the next pair to evaluate is the probe row
+  /// at probe_tile_idx_ with the build row at build_tile_idx_ in build_tile_batch_.
+  int probe_tile_start_;
+  int probe_tile_end_;
+  int probe_tile_idx_;
+  int build_tile_idx_;
+  RowBatchList::BatchIterator build_tile_batch_;
+
   /// END: Members that must be Reset()
   /////////////////////////////////////////
 
@@ -117,6 +134,13 @@ class NestedLoopJoinNode : public BlockingJoinNode {
   Status FindBuildMatches(RuntimeState* state, RowBatch* output_batch,
       bool* return_output_batch);
 
+  /// Same as FindBuildMatches() for inner and cross joins, but joins all build rows with
+  /// the tile of the current and the remaining rows in probe_batch_, one build batch at
+  /// a time. When the tile is done, the last row of the tile becomes the current probe
+  /// row. Match bits for the probe or build rows are not maintained.
+  Status FindBuildMatchesTiled(RuntimeState* state, RowBatch* output_batch,
+      bool* return_output_batch);
+
   /// Retrieves the next probe row from the left child. This function does
   /// not guarantee that a valid probe row is produced as it may exit if
   /// the output_batch is at capacity. If a valid probe row is retrieved, the
@@ -0,0 +1,78 @@
+// Copyright 2016 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+#include "exec/parquet-bloom-filter.h"
+#include "util/cpu-info.h"
+
+#include "common/names.h"
+
+namespace impala {
+
+TEST(ParquetBloomFilterTest, Location) {
+  parquet::ColumnMetaData meta_data;
+  int64_t offset;
+  int log_space;
+  EXPECT_FALSE(ParquetBloomFilter::DecodeLocation(meta_data, &offset, &log_space));
+
+  meta_data.__set_key_value_metadata(
+      vector<parquet::KeyValue>(1, ParquetBloomFilter::EncodeLocation(12345, 16)));
+  ASSERT_TRUE(ParquetBloomFilter::DecodeLocation(meta_data, &offset, &log_space));
+  EXPECT_EQ(offset, 12345);
+  EXPECT_EQ(log_space, 16);
+
+  // Filters built with another hash function and malformed locations are ignored.
+  parquet::KeyValue& kv = meta_data.key_value_metadata[0];
+  string value = kv.value;
+  kv.value = value.substr(0, value.rfind(':')) + ":unknown";
+  EXPECT_FALSE(ParquetBloomFilter::DecodeLocation(meta_data, &offset, &log_space));
+  kv.value = "12345:16";
+  EXPECT_FALSE(ParquetBloomFilter::DecodeLocation(meta_data, &offset, &log_space));
+  kv.value = value;
+  kv.value.replace(0, 5, "-1234");
+  EXPECT_FALSE(ParquetBloomFilter::DecodeLocation(meta_data, &offset, &log_space));
+  kv.value = value;
+  kv.value.replace(6, 2, "40");
+  EXPECT_FALSE(ParquetBloomFilter::DecodeLocation(meta_data, &offset, &log_space));
+
+  // Other keys are skipped.
+  kv.value = value;
+  parquet::KeyValue other;
+  other.key = "other";
+  other.__set_value("1:2:3");
+  meta_data.key_value_metadata.insert(meta_data.key_value_metadata.begin(), other);
+  ASSERT_TRUE(ParquetBloomFilter::DecodeLocation(meta_data, &offset, &log_space));
+  EXPECT_EQ(offset, 12345);
+}
+
+TEST(ParquetBloomFilterTest, Hash) {
+  EXPECT_TRUE(ParquetBloomFilter::IsSupportedType(TYPE_BIGINT));
+  EXPECT_FALSE(ParquetBloomFilter::IsSupportedType(TYPE_DOUBLE));
+  EXPECT_FALSE(ParquetBloomFilter::IsSupportedType(TYPE_STRING));
+
+  int64_t v1 = 42;
+  int64_t v2 = 42;
+  int64_t v3 = 43;
+  ColumnType type(TYPE_BIGINT);
+  EXPECT_EQ(ParquetBloomFilter::Hash(&v1, type), ParquetBloomFilter::Hash(&v2, type));
+  EXPECT_NE(ParquetBloomFilter::Hash(&v1, type), ParquetBloomFilter::Hash(&v3, type));
+}
+
+}
+
+int main(int argc, char **argv) {
+  impala::CpuInfo::Init();
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,85 @@
+// Copyright 2016 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "exec/parquet-bloom-filter.h"
+
+#include <boost/algorithm/string.hpp>
+#include <gutil/strings/substitute.h>
+
+#include "runtime/raw-value.inline.h"
+#include "runtime/runtime-filter-bank.h"
+#include "util/cpu-info.h"
+#include "util/string-parser.h"
+
+#include "common/names.h"
+
+using boost::algorithm::is_any_of;
+using boost::algorithm::split;
+using namespace impala;
+using namespace strings;
+
+const char* const ParquetBloomFilter::KEY_VALUE_METADATA_KEY = "impala.bloom_filter";
+
+bool ParquetBloomFilter::IsSupportedType(const ColumnType& col_type) {
+  switch (col_type.type) {
+    case TYPE_TINYINT:
+    case TYPE_SMALLINT:
+    case TYPE_INT:
+    case TYPE_BIGINT:
+      return true;
+    default:
+      return false;
+  }
+}
+
+uint32_t ParquetBloomFilter::Hash(const void* value, const ColumnType& col_type) {
+  DCHECK(value != NULL);
+  return RawValue::GetHashValue(value, col_type, RuntimeFilterBank::DefaultHashSeed());
+}
+
+const char* ParquetBloomFilter::HashFunctionName() {
+  return CpuInfo::IsSupported(CpuInfo::SSE4_2) ? "crc32" : "murmur2";
+}
+
+parquet::KeyValue ParquetBloomFilter::EncodeLocation(int64_t file_offset,
+    int log_heap_space) {
+  DCHECK_GE(log_heap_space, MIN_LOG_HEAP_SPACE);
+  DCHECK_LE(log_heap_space, MAX_LOG_HEAP_SPACE);
+  parquet::KeyValue kv;
+  kv.key = KEY_VALUE_METADATA_KEY;
+  kv.__set_value(Substitute("$0:$1:$2", file_offset, log_heap_space,
+      HashFunctionName()));
+  return kv;
+}
+
+bool ParquetBloomFilter::DecodeLocation(const parquet::ColumnMetaData& meta_data,
+    int64_t* file_offset, int* log_heap_space) {
+  if (!meta_data.__isset.key_value_metadata) return false;
+  for (const parquet::KeyValue& kv: meta_data.key_value_metadata) {
+    if (kv.key != KEY_VALUE_METADATA_KEY || !kv.__isset.value) continue;
+    vector<string> parts;
+    split(parts, kv.value, is_any_of(":"));
+    if (parts.size() != 3 || parts[2] != HashFunctionName()) return false;
+    StringParser::ParseResult offset_result;
+    StringParser::ParseResult log_space_result;
+    *file_offset = StringParser::StringToInt<int64_t>(
+        parts[0].data(), parts[0].size(), &offset_result);
+    *log_heap_space = StringParser::StringToInt<int>(
+        parts[1].data(), parts[1].size(), &log_space_result);
+    return offset_result == StringParser::PARSE_SUCCESS &&
+        log_space_result == StringParser::PARSE_SUCCESS && *file_offset >= 0 &&
+        *log_heap_space >= MIN_LOG_HEAP_SPACE && *log_heap_space <= MAX_LOG_HEAP_SPACE;
+  }
+  return false;
+}
@@ -0,0 +1,71 @@
+// Copyright 2016 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef IMPALA_EXEC_PARQUET_BLOOM_FILTER_H
+#define IMPALA_EXEC_PARQUET_BLOOM_FILTER_H
+
+#include <string>
+
+#include "exec/parquet-common.h"
+#include "runtime/types.h"
+
+namespace impala {
+
+/// Helpers for the bloom filters that the Parquet writer optionally stores for the values
+/// of a column chunk. parquet.thrift has no field for them, so the filter is written
+/// into the file after the data pages of the column chunk, in the directory layout of
+/// BloomFilter, and its location is recorded in parquet::ColumnMetaData under
+/// KEY_VALUE_METADATA_KEY as "<file offset>:<log2 of size in bytes>:<hash function>".
+/// The filter bytes are not part of the column chunk's total_compressed_size, so other
+/// readers never see them.
+///
+/// Values are hashed like RuntimeFilter::Eval() hashes them, which allows comparing the
+/// filter against runtime filters. That hash depends on the CPU (CRC32 with SSE4.2 and
+/// Murmur2 otherwise), so its name is recorded and filters that were built with a
+/// different hash function are ignored.
+class ParquetBloomFilter {
+ public:
+  static const char* const KEY_VALUE_METADATA_KEY;
+
+  /// The smallest and largest filters that readers accept.
+  static const int MIN_LOG_HEAP_SPACE = 6;
+  static const int MAX_LOG_HEAP_SPACE = 24;
+
+  /// Returns true if bloom filters are written and probed for columns of 'col_type'.
+  /// Only integer types are supported: floating point values that compare equal may
+  /// hash differently (e.g. 0.0 and -0.0).
+  static bool IsSupportedType(const ColumnType& col_type);
+
+  /// Returns the hash of 'value', which is a slot value of 'col_type', that is inserted
+  /// into and looked up in the filters.
+  static uint32_t Hash(const void* value, const ColumnType& col_type);
+
+  /// Returns the metadata entry for a filter with (1 << log_heap_space) bytes at
+  /// 'file_offset' that was built on this machine.
+  static parquet::KeyValue EncodeLocation(int64_t file_offset, int log_heap_space);
+
+  /// Finds the location of the filter of the column chunk described by 'meta_data'.
+  /// Returns false if there is no filter, its location cannot be parsed, or it was built
+  /// with a hash function other than the one of this machine.
+  static bool DecodeLocation(const parquet::ColumnMetaData& meta_data,
+      int64_t* file_offset, int* log_heap_space);
+
+ private:
+  /// Returns the name of the hash function that Hash() uses on this machine.
+  static const char* HashFunctionName();
+};
+
+}
+
+#endif
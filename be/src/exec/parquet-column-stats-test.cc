@@ -0,0 +1,198 @@
+// Copyright 2016 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <limits>
+#include <gtest/gtest.h>
+#include "exec/parquet-column-stats.h"
+
+#include "common/names.h"
+
+namespace impala {
+
+/// Returns a column chunk with plain encoded 'min' and 'max' statistics.
+template <typename P>
+parquet::ColumnChunk MakeColumnChunk(P min, P max) {
+  parquet::ColumnChunk col_chunk;
+  col_chunk.meta_data.__isset.statistics = true;
+  col_chunk.meta_data.statistics.__set_min(
+      string(reinterpret_cast<const char*>(&min), sizeof(min)));
+  col_chunk.meta_data.statistics.__set_max(
+      string(reinterpret_cast<const char*>(&max), sizeof(max)));
+  return col_chunk;
+}
+
+TEST(ParquetColumnStatsTest, ReadFromThrift) {
+  parquet::ColumnChunk col_chunk = MakeColumnChunk<int64_t>(-10, 1000);
+  int64_t v;
+  ASSERT_TRUE(ParquetColumnStats::ReadFromThrift(
+      col_chunk, TYPE_BIGINT, ParquetColumnStats::MIN, &v));
+  EXPECT_EQ(v, -10);
+  ASSERT_TRUE(ParquetColumnStats::ReadFromThrift(
+      col_chunk, TYPE_BIGINT, ParquetColumnStats::MAX, &v));
+  EXPECT_EQ(v, 1000);
+
+  // A value of the wrong width must not be decoded.
+  int32_t i;
+  EXPECT_FALSE(ParquetColumnStats::ReadFromThrift(
+      col_chunk, TYPE_INT, ParquetColumnStats::MIN, &i));
+
+  // Narrow integers are stored as INT32 and must fit into the slot type.
+  col_chunk = MakeColumnChunk<int32_t>(-5, 300);
+  int16_t s;
+  ASSERT_TRUE(ParquetColumnStats::ReadFromThrift(
+      col_chunk, TYPE_SMALLINT, ParquetColumnStats::MAX, &s));
+  EXPECT_EQ(s, 300);
+  int8_t t;
+  ASSERT_TRUE(ParquetColumnStats::ReadFromThrift(
+      col_chunk, TYPE_TINYINT, ParquetColumnStats::MIN, &t));
+  EXPECT_EQ(t, -5);
+  EXPECT_FALSE(ParquetColumnStats::ReadFromThrift(
+      col_chunk, TYPE_TINYINT, ParquetColumnStats::MAX, &t));
+
+  // NaN does not order and must be ignored.
+  col_chunk = MakeColumnChunk<double>(numeric_limits<double>::quiet_NaN(), 1.5);
+  double d;
+  EXPECT_FALSE(ParquetColumnStats::ReadFromThrift(
+      col_chunk, TYPE_DOUBLE, ParquetColumnStats::MIN, &d));
+  ASSERT_TRUE(ParquetColumnStats::ReadFromThrift(
+      col_chunk, TYPE_DOUBLE, ParquetColumnStats::MAX, &d));
+  EXPECT_EQ(d, 1.5);
+
+  // Missing statistics and unsupported types.
+  parquet::ColumnChunk empty_chunk;
+  EXPECT_FALSE(ParquetColumnStats::ReadFromThrift(
+      empty_chunk, TYPE_INT, ParquetColumnStats::MIN, &i));
+  EXPECT_FALSE(ParquetColumnStats::IsSupportedType(TYPE_STRING));
+  EXPECT_FALSE(ParquetColumnStats::IsSupportedType(TYPE_TIMESTAMP));
+}
+
+TEST(ParquetColumnStatsTest, MayPass) {
+  ColumnType type(TYPE_INT);
+  int32_t min = 10;
+  int32_t max = 20;
+  int32_t below = 5;
+  int32_t inside = 15;
+  int32_t above = 25;
+
+  EXPECT_FALSE(ParquetColumnStats::MayPass(ParquetColumnStats::EQ, &below, type,
+      &min, &max));
+  EXPECT_TRUE(ParquetColumnStats::MayPass(ParquetColumnStats::EQ, &inside, type,
+      &min, &max));
+  EXPECT_FALSE(ParquetColumnStats::MayPass(ParquetColumnStats::EQ, &above, type,
+      &min, &max));
+
+  EXPECT_FALSE(ParquetColumnStats::MayPass(ParquetColumnStats::LT, &min, type,
+      &min, &max));
+  EXPECT_TRUE(ParquetColumnStats::MayPass(ParquetColumnStats::LE, &min, type,
+      &min, &max));
+  EXPECT_FALSE(ParquetColumnStats::MayPass(ParquetColumnStats::GT, &max, type,
+      &min, &max));
+  EXPECT_TRUE(ParquetColumnStats::MayPass(ParquetColumnStats::GE, &max, type,
+      &min, &max));
+
+  // Without statistics nothing can be skipped.
+  EXPECT_TRUE(ParquetColumnStats::MayPass(ParquetColumnStats::LT, &below, type,
+      NULL, NULL));
+  EXPECT_TRUE(ParquetColumnStats::MayPass(ParquetColumnStats::GT, &above, type,
+      NULL, NULL));
+
+  EXPECT_EQ(ParquetColumnStats::MirrorPredicateOp(ParquetColumnStats::LT),
+      ParquetColumnStats::GT);
+  EXPECT_EQ(ParquetColumnStats::MirrorPredicateOp(ParquetColumnStats::EQ),
+      ParquetColumnStats::EQ);
+  ParquetColumnStats::PredicateOp op;
+  EXPECT_TRUE(ParquetColumnStats::ParsePredicateOp("ge", &op));
+  EXPECT_EQ(op, ParquetColumnStats::GE);
+  EXPECT_FALSE(ParquetColumnStats::ParsePredicateOp("ne", &op));
+}
+
+TEST(ParquetColumnStatsTest, ColumnStats) {
+  ColumnStats<int32_t> int_stats;
+  parquet::Statistics stats;
+  // Nothing is encoded without values.
+  int_stats.EncodeToThrift(&stats);
+  EXPECT_FALSE(stats.__isset.min);
+  EXPECT_FALSE(stats.__isset.max);
+
+  int_stats.Update(7);
+  int_stats.Update(-3);
+  int_stats.Update(12);
+  int_stats.EncodeToThrift(&stats);
+  int32_t i;
+  ASSERT_TRUE(ParquetColumnStats::ReadFromThrift(
+      stats, TYPE_INT, ParquetColumnStats::MIN, &i));
+  EXPECT_EQ(i, -3);
+  ASSERT_TRUE(ParquetColumnStats::ReadFromThrift(
+      stats, TYPE_INT, ParquetColumnStats::MAX, &i));
+  EXPECT_EQ(i, 12);
+
+  // Narrow integers are encoded as INT32.
+  ColumnStats<int8_t> tinyint_stats;
+  tinyint_stats.Update(-100);
+  tinyint_stats.Update(100);
+  parquet::Statistics tinyint_thrift;
+  tinyint_stats.EncodeToThrift(&tinyint_thrift);
+  EXPECT_EQ(tinyint_thrift.min.size(), sizeof(int32_t));
+  int8_t t;
+  ASSERT_TRUE(ParquetColumnStats::ReadFromThrift(
+      tinyint_thrift, TYPE_TINYINT, ParquetColumnStats::MIN, &t));
+  EXPECT_EQ(t, -100);
+
+  // NaN values are ignored.
+  ColumnStats<double> double_stats;
+  double_stats.Update(numeric_limits<double>::quiet_NaN());
+  double_stats.Update(2.5);
+  double_stats.Update(numeric_limits<double>::quiet_NaN());
+  double_stats.Update(-1.0);
+  parquet::Statistics double_thrift;
+  double_stats.EncodeToThrift(&double_thrift);
+  double d;
+  ASSERT_TRUE(ParquetColumnStats::ReadFromThrift(
+      double_thrift, TYPE_DOUBLE, ParquetColumnStats::MIN, &d));
+  EXPECT_EQ(d, -1.0);
+  ASSERT_TRUE(ParquetColumnStats::ReadFromThrift(
+      double_thrift, TYPE_DOUBLE, ParquetColumnStats::MAX, &d));
+  EXPECT_EQ(d, 2.5);
+
+  // Merging combines the ranges and ignores empty stats.
+  ColumnStats<int32_t> merged;
+  merged.Merge(ColumnStats<int32_t>());
+  merged.Merge(int_stats);
+  ColumnStats<int32_t> other_stats;
+  other_stats.Update(100);
+  merged.Merge(other_stats);
+  parquet::Statistics merged_thrift;
+  merged.EncodeToThrift(&merged_thrift);
+  ASSERT_TRUE(ParquetColumnStats::ReadFromThrift(
+      merged_thrift, TYPE_INT, ParquetColumnStats::MIN, &i));
+  EXPECT_EQ(i, -3);
+  ASSERT_TRUE(ParquetColumnStats::ReadFromThrift(
+      merged_thrift, TYPE_INT, ParquetColumnStats::MAX, &i));
+  EXPECT_EQ(i, 100);
+
+  // Reset() forgets all values.
+  int_stats.Reset();
+  int_stats.Update(42);
+  int_stats.EncodeToThrift(&stats);
+  ASSERT_TRUE(ParquetColumnStats::ReadFromThrift(
+      stats, TYPE_INT, ParquetColumnStats::MIN, &i));
+  EXPECT_EQ(i, 42);
+}
+
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,147 @@
+// Copyright 2016 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "exec/parquet-column-stats.h"
+
+#include <cmath>
+#include <limits>
+
+#include "runtime/raw-value.h"
+
+#include "common/names.h"
+
+using namespace impala;
+
+bool ParquetColumnStats::IsSupportedType(const ColumnType& col_type) {
+  switch (col_type.type) {
+    case TYPE_TINYINT:
+    case TYPE_SMALLINT:
+    case TYPE_INT:
+    case TYPE_BIGINT:
+    case TYPE_FLOAT:
+    case TYPE_DOUBLE:
+      return true;
+    default:
+      // TODO: Parquet-mr wrote incorrect statistics for BYTE_ARRAY columns before
+      // PARQUET-251, and INT96 timestamps have no defined sort order, so we do not trust
+      // statistics for strings, timestamps and decimals.
+      return false;
+  }
+}
+
+bool ParquetColumnStats::ReadFromThrift(const parquet::ColumnChunk& col_chunk,
+    const ColumnType& col_type, StatsField stats_field, void* slot) {
+  if (!col_chunk.meta_data.__isset.statistics) return false;
+  return ReadFromThrift(col_chunk.meta_data.statistics, col_type, stats_field, slot);
+}
+
+bool ParquetColumnStats::ReadFromThrift(const parquet::Statistics& stats,
+    const ColumnType& col_type, StatsField stats_field, void* slot) {
+  const string* value = NULL;
+  if (stats_field == MIN) {
+    if (!stats.__isset.min) return false;
+    value = &stats.min;
+  } else {
+    DCHECK_EQ(stats_field, MAX);
+    if (!stats.__isset.max) return false;
+    value = &stats.max;
+  }
+
+  switch (col_type.type) {
+    case TYPE_TINYINT:
+      return DecodeNarrowInt<int8_t>(*value, slot);
+    case TYPE_SMALLINT:
+      return DecodeNarrowInt<int16_t>(*value, slot);
+    case TYPE_INT:
+      return DecodePlainValue<int32_t>(*value, slot);
+    case TYPE_BIGINT:
+      return DecodePlainValue<int64_t>(*value, slot);
+    case TYPE_FLOAT:
+      // Ignore NaN values, they do not order with respect to other values.
+      return DecodePlainValue<float>(*value, slot) &&
+          !std::isnan(*reinterpret_cast<float*>(slot));
+    case TYPE_DOUBLE:
+      return DecodePlainValue<double>(*value, slot) &&
+          !std::isnan(*reinterpret_cast<double*>(slot));
+    default:
+      DCHECK(!IsSupportedType(col_type)) << col_type.DebugString();
+      return false;
+  }
+}
+
+template <typename T>
+bool ParquetColumnStats::DecodePlainValue(const string& value, void* slot) {
+  uint8_t* buffer = reinterpret_cast<uint8_t*>(const_cast<char*>(value.data()));
+  int encoded_size = ParquetPlainEncoder::Decode(
+      buffer, buffer + value.size(), 0, reinterpret_cast<T*>(slot));
+  return encoded_size == static_cast<int>(value.size());
+}
+
+template <typename T>
+bool ParquetColumnStats::DecodeNarrowInt(const string& value, void* slot) {
+  int32_t wide_value;
+  if (!DecodePlainValue<int32_t>(value, &wide_value)) return false;
+  if (wide_value < numeric_limits<T>::min() || wide_value > numeric_limits<T>::max()) {
+    return false;
+  }
+  *reinterpret_cast<T*>(slot) = static_cast<T>(wide_value);
+  return true;
+}
+
+bool ParquetColumnStats::ParsePredicateOp(const string& fn_name, PredicateOp* op) {
+  if (fn_name == "eq") {
+    *op = EQ;
+  } else if (fn_name == "lt") {
+    *op = LT;
+  } else if (fn_name == "le") {
+    *op = LE;
+  } else if (fn_name == "gt") {
+    *op = GT;
+  } else if (fn_name == "ge") {
+    *op = GE;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+ParquetColumnStats::PredicateOp ParquetColumnStats::MirrorPredicateOp(PredicateOp op) {
+  switch (op) {
+    case LT: return GT;
+    case LE: return GE;
+    case GT: return LT;
+    case GE: return LE;
+    default: return op;
+  }
+}
+
+bool ParquetColumnStats::MayPass(PredicateOp op, const void* value,
+    const ColumnType& col_type, const void* min, const void* max) {
+  switch (op) {
+    case EQ:
+      if (min != NULL && RawValue::Compare(value, min, col_type) < 0) return false;
+      if (max != NULL && RawValue::Compare(value, max, col_type) > 0) return false;
+      return true;
+    case LT:
+      return min == NULL || RawValue::Compare(min, value, col_type) < 0;
+    case LE:
+      return min == NULL || RawValue::Compare(min, value, col_type) <= 0;
+    case GT:
+      return max == NULL || RawValue::Compare(max, value, col_type) > 0;
+    case GE:
+      return max == NULL || RawValue::Compare(max, value, col_type) >= 0;
+  }
+  DCHECK(false);
+  return true;
+}
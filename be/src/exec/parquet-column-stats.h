@@ -0,0 +1,146 @@
+// Copyright 2016 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef IMPALA_EXEC_PARQUET_COLUMN_STATS_H
+#define IMPALA_EXEC_PARQUET_COLUMN_STATS_H
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+#include "exec/parquet-common.h"
+#include "runtime/types.h"
+
+namespace impala {
+
+/// Helpers for the min/max statistics that Parquet stores for each column chunk in
+/// parquet::ColumnMetaData::statistics and for each data page in
+/// parquet::DataPageHeader::statistics. The min and max values are stored using the
+/// plain encoding of the column's physical type.
+class ParquetColumnStats {
+ public:
+  /// Selects which of the statistics values to read.
+  enum StatsField { MIN, MAX };
+
+  /// Decodes the min or max value, as selected by 'stats_field', from the statistics of
+  /// 'col_chunk' into 'slot'. 'slot' must point to enough memory to hold a slot value of
+  /// 'col_type'. Returns false if the value is not present in the statistics, cannot be
+  /// decoded, or reading statistics is not supported for 'col_type'. In this case the
+  /// contents of 'slot' are undefined and the caller must not draw any conclusions from
+  /// the statistics.
+  static bool ReadFromThrift(const parquet::ColumnChunk& col_chunk,
+      const ColumnType& col_type, StatsField stats_field, void* slot);
+
+  /// Same as above for the statistics of a data page or column chunk.
+  static bool ReadFromThrift(const parquet::Statistics& stats,
+      const ColumnType& col_type, StatsField stats_field, void* slot);
+
+  /// Returns true if ReadFromThrift() can decode statistics for columns of 'col_type'.
+  static bool IsSupportedType(const ColumnType& col_type);
+
+  /// Comparison operators of predicates that can be evaluated against min/max
+  /// statistics.
+  enum PredicateOp { EQ, LT, LE, GT, GE };
+
+  /// Parses the function name of a builtin binary predicate (e.g. "lt") into 'op'.
+  /// Returns false if 'fn_name' is not a supported comparison.
+  static bool ParsePredicateOp(const std::string& fn_name, PredicateOp* op);
+
+  /// Returns the operator that results from swapping the operands of 'op', e.g.
+  /// 'c < x' becomes 'x > c'.
+  static PredicateOp MirrorPredicateOp(PredicateOp op);
+
+  /// Returns false if the statistics prove that no value 'v' of a column chunk satisfies
+  /// 'v <op> value', true otherwise. 'min' and 'max' point to the decoded statistics of
+  /// the chunk and may be NULL if they are unknown. All values are in the slot
+  /// representation of 'col_type'.
+  static bool MayPass(PredicateOp op, const void* value, const ColumnType& col_type,
+      const void* min, const void* max);
+
+ private:
+  /// Decodes a plain encoded value of type T from 'value' into 'slot'. Returns false if
+  /// 'value' does not hold exactly one encoded value.
+  template <typename T>
+  static bool DecodePlainValue(const std::string& value, void* slot);
+
+  /// Decodes an INT32 encoded value from 'value' into the narrower integer type T.
+  /// Returns false if the value does not fit into T, since the scanner would truncate
+  /// those values and the statistics would no longer reflect the materialized data.
+  template <typename T>
+  static bool DecodeNarrowInt(const std::string& value, void* slot);
+};
+
+/// Tracks the min and max of the values that are written to a data page or column chunk
+/// and encodes them into parquet::Statistics in the format that
+/// ParquetColumnStats::ReadFromThrift() decodes. Must only be used for the types that
+/// ParquetColumnStats::IsSupportedType() accepts. NaN values are ignored since they do
+/// not order with respect to other values and never pass a comparison.
+template <typename T>
+class ColumnStats {
+ public:
+  ColumnStats() : has_values_(false) { }
+
+  void Update(const T& v) {
+    if (IsNaN(v)) return;
+    if (!has_values_) {
+      min_ = v;
+      max_ = v;
+      has_values_ = true;
+      return;
+    }
+    min_ = std::min(min_, v);
+    max_ = std::max(max_, v);
+  }
+
+  /// Adds the min and max values tracked by 'other', e.g. to accumulate the statistics
+  /// of a column chunk from the statistics of its pages.
+  void Merge(const ColumnStats<T>& other) {
+    if (!other.has_values_) return;
+    Update(other.min_);
+    Update(other.max_);
+  }
+
+  void Reset() { has_values_ = false; }
+
+  /// Sets the min and max values of 'out' if any value was tracked. 'out' is left
+  /// unchanged otherwise.
+  void EncodeToThrift(parquet::Statistics* out) const {
+    if (!has_values_) return;
+    out->__set_min(EncodePlainValue(min_));
+    out->__set_max(EncodePlainValue(max_));
+  }
+
+ private:
+  static bool IsNaN(const T& v) { return false; }
+
+  static std::string EncodePlainValue(const T& v) {
+    std::string result(ParquetPlainEncoder::ByteSize(v), '\0');
+    ParquetPlainEncoder::Encode(reinterpret_cast<uint8_t*>(&result[0]), -1, v);
+    return result;
+  }
+
+  bool has_values_;
+  T min_;
+  T max_;
+};
+
+template <>
+inline bool ColumnStats<float>::IsNaN(const float& v) { return std::isnan(v); }
+
+template <>
+inline bool ColumnStats<double>::IsNaN(const double& v) { return std::isnan(v); }
+
+}
+
+#endif
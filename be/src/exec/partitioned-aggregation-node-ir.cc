@@ -23,6 +23,15 @@
 
 using namespace impala;
 
+void PartitionedAggregationNode::UpdateSlotInterpreted(AggFnEvaluator* evaluator,
+    FunctionContext* agg_fn_ctx, Tuple* tuple, TupleRow* row, bool is_merge) {
+  if (is_merge) {
+    evaluator->Merge(agg_fn_ctx, row->GetTuple(0), tuple);
+  } else {
+    evaluator->Add(agg_fn_ctx, row, tuple);
+  }
+}
+
 Status PartitionedAggregationNode::ProcessBatchNoGrouping(RowBatch* batch) {
   Tuple* output_tuple = singleton_output_tuple_;
   FOREACH_ROW(batch, 0, batch_iter) {
@@ -77,7 +86,7 @@ void IR_ALWAYS_INLINE PartitionedAggregationNode::EvalAndHashPrefetchGroup(
     }
     // Hoist lookups out of non-null branch to speed up non-null case.
     const uint32_t hash = expr_vals_cache->ExprValuesHash();
-    const uint32_t partition_idx = hash >> (32 - NUM_PARTITIONING_BITS);
+    const uint32_t partition_idx = hash >> (32 - num_partitioning_bits_);
     HashTable* hash_tbl = GetHashTable(partition_idx);
     if (is_null) {
       expr_vals_cache->SetRowNull();
@@ -96,7 +105,7 @@ Status PartitionedAggregationNode::ProcessRow(TupleRow* __restrict__ row,
   HashTableCtx::ExprValuesCache* expr_vals_cache = ht_ctx->expr_values_cache();
   // Hoist lookups out of non-null branch to speed up non-null case.
   const uint32_t hash = expr_vals_cache->ExprValuesHash();
-  const uint32_t partition_idx = hash >> (32 - NUM_PARTITIONING_BITS);
+  const uint32_t partition_idx = hash >> (32 - num_partitioning_bits_);
   if (expr_vals_cache->IsRowNull()) return Status::OK();
   // To process this row, we first see if it can be aggregated or inserted into this
   // partition's hash table. If we need to insert it and that fails, due to OOM, we
@@ -186,7 +195,7 @@ Status PartitionedAggregationNode::ProcessBatchStreaming(bool needs_serialize,
       // Hoist lookups out of non-null branch to speed up non-null case.
       TupleRow* in_row = in_batch_iter.Get();
       const uint32_t hash = expr_vals_cache->ExprValuesHash();
-      const uint32_t partition_idx = hash >> (32 - NUM_PARTITIONING_BITS);
+      const uint32_t partition_idx = hash >> (32 - num_partitioning_bits_);
       if (!expr_vals_cache->IsRowNull() &&
           !TryAddToHashTable(ht_ctx, hash_partitions_[partition_idx],
             GetHashTable(partition_idx), in_row, hash, &remaining_capacity[partition_idx],
@@ -219,6 +228,44 @@ Status PartitionedAggregationNode::ProcessBatchStreaming(bool needs_serialize,
   return Status::OK();
 }
 
+Status PartitionedAggregationNode::PassThroughBatchStreaming(bool needs_serialize,
+    RowBatch* in_batch, RowBatch* out_batch, HashTableCtx* __restrict__ ht_ctx) {
+  DCHECK(is_streaming_preagg_);
+  DCHECK_EQ(out_batch->num_rows(), 0);
+  DCHECK_LE(in_batch->num_rows(), out_batch->capacity());
+
+  RowBatch::Iterator out_batch_iterator(out_batch, out_batch->num_rows());
+  HashTableCtx::ExprValuesCache* expr_vals_cache = ht_ctx->expr_values_cache();
+  const int num_rows = in_batch->num_rows();
+  const int cache_size = expr_vals_cache->capacity();
+  for (int group_start = 0; group_start < num_rows; group_start += cache_size) {
+    // The grouping values are copied from the cache into the intermediate tuples.
+    EvalAndHashPrefetchGroup<false>(in_batch, group_start, TPrefetchMode::NONE, ht_ctx);
+
+    FOREACH_ROW_LIMIT(in_batch, group_start, cache_size, in_batch_iter) {
+      Tuple* intermediate_tuple = ConstructIntermediateTuple(agg_fn_ctxs_,
+          out_batch->tuple_data_pool(), &process_batch_status_);
+      if (UNLIKELY(intermediate_tuple == NULL)) {
+        DCHECK(!process_batch_status_.ok());
+        return process_batch_status_;
+      }
+      UpdateTuple(&agg_fn_ctxs_[0], intermediate_tuple, in_batch_iter.Get(), false);
+      out_batch_iterator.Get()->SetTuple(0, intermediate_tuple);
+      out_batch_iterator.Next();
+      out_batch->CommitLastRow();
+      expr_vals_cache->NextRow();
+    }
+    DCHECK(expr_vals_cache->AtEnd());
+  }
+  if (needs_serialize) {
+    FOREACH_ROW(out_batch, 0, out_batch_iter) {
+      AggFnEvaluator::Serialize(aggregate_evaluators_, agg_fn_ctxs_,
+          out_batch_iter.Get()->GetTuple(0));
+    }
+  }
+  return Status::OK();
+}
+
 bool PartitionedAggregationNode::TryAddToHashTable(
     HashTableCtx* __restrict__ ht_ctx, Partition* __restrict__ partition,
     HashTable* __restrict__ hash_tbl, TupleRow* __restrict__ in_row,
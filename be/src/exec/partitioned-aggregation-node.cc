@@ -31,6 +31,7 @@
 #include "exprs/slot-ref.h"
 #include "runtime/buffered-tuple-stream.inline.h"
 #include "runtime/descriptors.h"
+#include "runtime/exec-env.h"
 #include "runtime/mem-pool.h"
 #include "runtime/mem-tracker.h"
 #include "runtime/raw-value.h"
@@ -42,12 +43,26 @@
 #include "udf/udf-internal.h"
 #include "util/debug-util.h"
 #include "util/runtime-profile-counters.h"
+#include "util/time.h"
 
 #include "gen-cpp/Exprs_types.h"
 #include "gen-cpp/PlanNodes_types.h"
 
 #include "common/names.h"
 
+DEFINE_double(streaming_preagg_min_reduction, 1.1, "(Advanced) Once the hash tables of "
+    "a streaming pre-aggregation stopped growing, the minimum reduction (input rows "
+    "divided by passed-through rows and new groups) to keep looking up input rows in "
+    "them. Below it, rows are passed through without lookups. Values of 1 or less "
+    "disable this.");
+DEFINE_int64(streaming_preagg_passthrough_rows, 1024L * 1024L, "(Advanced) The number "
+    "of input rows that a streaming pre-aggregation passes through without lookups "
+    "before measuring its reduction again.");
+DEFINE_int64(streaming_preagg_memory_pressure_ms, 1000, "(Advanced) A streaming "
+    "pre-aggregation does not grow its hash tables for this many milliseconds after "
+    "the process memory limit was reached, and passes through rows that do not fit "
+    "instead. 0 disables this.");
+
 using namespace impala;
 using namespace llvm;
 using namespace strings;
@@ -98,6 +113,10 @@ static const StreamingHtMinReductionEntry STREAMING_HT_MIN_REDUCTION[] = {
 static const int STREAMING_HT_MIN_REDUCTION_SIZE =
     sizeof(STREAMING_HT_MIN_REDUCTION) / sizeof(STREAMING_HT_MIN_REDUCTION[0]);
 
+/// The number of input rows over which a streaming preaggregation measures its
+/// reduction once its hash tables stopped growing.
+static const int64_t STREAMING_PREAGG_SAMPLE_ROWS = 64 * 1024;
+
 PartitionedAggregationNode::PartitionedAggregationNode(
     ObjectPool* pool, const TPlanNode& tnode, const DescriptorTbl& descs)
   : ExecNode(pool, tnode, descs),
@@ -127,12 +146,18 @@ PartitionedAggregationNode::PartitionedAggregationNode(
     num_passthrough_rows_(NULL),
     preagg_estimated_reduction_(NULL),
     preagg_streaming_ht_min_reduction_(NULL),
+    num_passthrough_switches_(NULL),
+    num_unprobed_passthrough_rows_(NULL),
     estimated_input_cardinality_(tnode.agg_node.estimated_input_cardinality),
     singleton_output_tuple_(NULL),
     singleton_output_tuple_returned_(true),
     partition_eos_(false),
+    streaming_sample_input_rows_(0),
+    streaming_sample_output_rows_(0),
+    streaming_passthrough_rows_left_(0),
     child_eos_(false),
-    partition_pool_(new ObjectPool()) {
+    partition_pool_(new ObjectPool()),
+    num_partitioning_bits_(NUM_PARTITIONING_BITS) {
   DCHECK_EQ(PARTITION_FANOUT, 1 << NUM_PARTITIONING_BITS);
   if (is_streaming_preagg_) {
     DCHECK(conjunct_ctxs_.empty()) << "Preaggs have no conjuncts";
@@ -188,6 +213,10 @@ Status PartitionedAggregationNode::Prepare(RuntimeState* state) {
         runtime_profile(), "ReductionFactorEstimate", TUnit::DOUBLE_VALUE);
     preagg_streaming_ht_min_reduction_ = ADD_COUNTER(
         runtime_profile(), "ReductionFactorThresholdToExpand", TUnit::DOUBLE_VALUE);
+    num_passthrough_switches_ =
+        ADD_COUNTER(runtime_profile(), "PassThroughSwitches", TUnit::UNIT);
+    num_unprobed_passthrough_rows_ =
+        ADD_COUNTER(runtime_profile(), "RowsPassedThroughWithoutLookup", TUnit::UNIT);
   } else {
     build_timer_ = ADD_TIMER(runtime_profile(), "BuildTime");
     num_row_repartitioned_ =
@@ -286,6 +315,8 @@ Status PartitionedAggregationNode::Prepare(RuntimeState* state) {
 
 Status PartitionedAggregationNode::Open(RuntimeState* state) {
   SCOPED_TIMER(runtime_profile_->total_time_counter());
+  SCOPED_PERF_EVENT_MEASUREMENT(perf_event_counters_);
+  SCOPED_CPU_SAMPLE_NODE(id_);
   RETURN_IF_ERROR(ExecNode::Open(state));
 
   RETURN_IF_ERROR(Expr::Open(grouping_expr_ctxs_, state));
@@ -301,7 +332,7 @@ Status PartitionedAggregationNode::Open(RuntimeState* state) {
   // Streaming preaggregations do all processing in GetNext().
   if (is_streaming_preagg_) return Status::OK();
 
-  RowBatch batch(child(0)->row_desc(), state->batch_size(), mem_tracker());
+  RowBatch batch(child(0)->row_desc(), ChildBatchCapacity(state, 0), mem_tracker());
   // Read all the rows from the child and process them.
   bool eos = false;
   do {
@@ -407,6 +438,8 @@ Status PartitionedAggregationNode::CopyStringData(const SlotDescriptor* slot_des
 Status PartitionedAggregationNode::GetNextInternal(RuntimeState* state,
     RowBatch* row_batch, bool* eos) {
   SCOPED_TIMER(runtime_profile_->total_time_counter());
+  SCOPED_PERF_EVENT_MEASUREMENT(perf_event_counters_);
+  SCOPED_CPU_SAMPLE_NODE(id_);
   RETURN_IF_ERROR(ExecDebugAction(TExecNodePhase::GETNEXT, state));
   RETURN_IF_CANCELLED(state);
   RETURN_IF_ERROR(QueryMaintenance(state));
@@ -517,7 +550,7 @@ Status PartitionedAggregationNode::GetRowsStreaming(RuntimeState* state,
   DCHECK(is_streaming_preagg_);
 
   if (child_batch_ == NULL) {
-    child_batch_.reset(new RowBatch(child(0)->row_desc(), state->batch_size(),
+    child_batch_.reset(new RowBatch(child(0)->row_desc(), ChildBatchCapacity(state, 0),
         mem_tracker()));
   }
 
@@ -530,6 +563,16 @@ Status PartitionedAggregationNode::GetRowsStreaming(RuntimeState* state,
 
     SCOPED_TIMER(streaming_timer_);
 
+    if (streaming_passthrough_rows_left_ > 0) {
+      RETURN_IF_ERROR(PassThroughBatchStreaming(needs_serialize_, child_batch_.get(),
+          out_batch, ht_ctx_.get()));
+      streaming_passthrough_rows_left_ -= child_batch_->num_rows();
+      COUNTER_ADD(num_unprobed_passthrough_rows_, child_batch_->num_rows());
+      child_batch_->Reset();
+      continue;
+    }
+
+    int64_t ht_rows = 0;
     int remaining_capacity[PARTITION_FANOUT];
     bool ht_needs_expansion = false;
     for (int i = 0; i < PARTITION_FANOUT; ++i) {
@@ -537,6 +580,7 @@ Status PartitionedAggregationNode::GetRowsStreaming(RuntimeState* state,
       DCHECK(hash_tbl != NULL);
       remaining_capacity[i] = hash_tbl->NumInsertsBeforeResize();
       ht_needs_expansion |= remaining_capacity[i] < child_batch_->num_rows();
+      ht_rows += hash_tbl->size();
     }
 
     // Stop expanding hash tables if we're not reducing the input sufficiently. As our
@@ -564,6 +608,9 @@ Status PartitionedAggregationNode::GetRowsStreaming(RuntimeState* state,
       RETURN_IF_ERROR(ProcessBatchStreaming(needs_serialize_, prefetch_mode,
           child_batch_.get(), out_batch, ht_ctx_.get(), remaining_capacity ));
     }
+    int64_t new_groups = -ht_rows;
+    for (int i = 0; i < PARTITION_FANOUT; ++i) new_groups += GetHashTable(i)->size();
+    UpdateStreamingReduction(child_batch_->num_rows(), new_groups, out_batch->num_rows());
 
     child_batch_->Reset(); // All rows from child_batch_ were processed.
   } while (out_batch->num_rows() == 0 && !child_eos_);
@@ -591,6 +638,16 @@ bool PartitionedAggregationNode::ShouldExpandPreaggHashTables() const {
   // Need some rows in tables to have valid statistics.
   if (ht_rows == 0) return true;
 
+  // Leave the memory to operators that cannot pass through rows while the process is
+  // under memory pressure.
+  if (FLAGS_streaming_preagg_memory_pressure_ms > 0 && state_->exec_env() != NULL) {
+    int64_t last_gc_ms = state_->exec_env()->process_mem_tracker()->last_gc_ms();
+    if (last_gc_ms > 0 &&
+        MonotonicMillis() - last_gc_ms < FLAGS_streaming_preagg_memory_pressure_ms) {
+      return false;
+    }
+  }
+
   // Find the appropriate reduction factor in our table for the current hash table sizes.
   int cache_level = 0;
   while (cache_level + 1 < STREAMING_HT_MIN_REDUCTION_SIZE &&
@@ -627,6 +684,33 @@ bool PartitionedAggregationNode::ShouldExpandPreaggHashTables() const {
   return estimated_reduction > min_reduction;
 }
 
+void PartitionedAggregationNode::UpdateStreamingReduction(int64_t input_rows,
+    int64_t new_groups, int64_t passthrough_rows) {
+  DCHECK_EQ(streaming_passthrough_rows_left_, 0);
+  // Rows are only passed through if some hash table is full. While all of them can
+  // still grow, inserting rows is not wasted and no sample is taken.
+  if (passthrough_rows == 0 || FLAGS_streaming_preagg_min_reduction <= 1) {
+    streaming_sample_input_rows_ = 0;
+    streaming_sample_output_rows_ = 0;
+    return;
+  }
+  streaming_sample_input_rows_ += input_rows;
+  streaming_sample_output_rows_ += new_groups + passthrough_rows;
+  if (streaming_sample_input_rows_ < STREAMING_PREAGG_SAMPLE_ROWS) return;
+
+  double reduction = static_cast<double>(streaming_sample_input_rows_) /
+      streaming_sample_output_rows_;
+  streaming_sample_input_rows_ = 0;
+  streaming_sample_output_rows_ = 0;
+  if (reduction >= FLAGS_streaming_preagg_min_reduction) return;
+  streaming_passthrough_rows_left_ =
+      max<int64_t>(FLAGS_streaming_preagg_passthrough_rows, 1);
+  COUNTER_ADD(num_passthrough_switches_, 1);
+  runtime_profile()->AddInfoString("LastPassThroughSwitch", Substitute(
+      "after $0 input rows, reduction $1 was below $2", children_[0]->rows_returned(),
+      reduction, FLAGS_streaming_preagg_min_reduction));
+}
+
 void PartitionedAggregationNode::CleanupHashTbl(
     const vector<FunctionContext*>& agg_fn_ctxs, HashTable::Iterator it) {
   if (!needs_finalize_ && !needs_serialize_) return;
@@ -1123,15 +1207,20 @@ void PartitionedAggregationNode::DebugString(int indentation_level,
   *out << ")";
 }
 
-Status PartitionedAggregationNode::CreateHashPartitions(int level) {
+Status PartitionedAggregationNode::CreateHashPartitions(int level,
+    int num_partitioning_bits) {
   if (is_streaming_preagg_) DCHECK_EQ(level, 0);
   if (UNLIKELY(level >= MAX_PARTITION_DEPTH)) {
     return Status(TErrorCode::PARTITIONED_AGG_MAX_PARTITION_DEPTH, id_, MAX_PARTITION_DEPTH);
   }
+  DCHECK_GE(num_partitioning_bits, MIN_PARTITIONING_BITS);
+  DCHECK_LE(num_partitioning_bits, NUM_PARTITIONING_BITS);
   ht_ctx_->set_level(level);
+  num_partitioning_bits_ = num_partitioning_bits;
 
   DCHECK(hash_partitions_.empty());
-  for (int i = 0; i < PARTITION_FANOUT; ++i) {
+  const int num_partitions = 1 << num_partitioning_bits_;
+  for (int i = 0; i < num_partitions; ++i) {
     Partition* new_partition = new Partition(this, level);
     DCHECK(new_partition != NULL);
     hash_partitions_.push_back(partition_pool_->Add(new_partition));
@@ -1144,7 +1233,7 @@ Status PartitionedAggregationNode::CreateHashPartitions(int level) {
 
   // Now that all the streams are reserved (meaning we have enough memory to execute
   // the algorithm), allocate the hash tables. These can fail and we can still continue.
-  for (int i = 0; i < PARTITION_FANOUT; ++i) {
+  for (int i = 0; i < num_partitions; ++i) {
     if (UNLIKELY(!hash_partitions_[i]->InitHashTable())) {
       // We don't spill on preaggregations. If we have so little memory that we can't
       // allocate small hash tables, the mem limit is just too low.
@@ -1170,7 +1259,7 @@ Status PartitionedAggregationNode::CreateHashPartitions(int level) {
 Status PartitionedAggregationNode::CheckAndResizeHashPartitions(int num_rows,
     const HashTableCtx* ht_ctx) {
   DCHECK(!is_streaming_preagg_);
-  for (int i = 0; i < PARTITION_FANOUT; ++i) {
+  for (int i = 0; i < hash_partitions_.size(); ++i) {
     Partition* partition = hash_partitions_[i];
     while (!partition->is_spilled()) {
       {
@@ -1183,6 +1272,19 @@ Status PartitionedAggregationNode::CheckAndResizeHashPartitions(int num_rows,
   return Status::OK();
 }
 
+int PartitionedAggregationNode::ComputeRepartitionBits(int64_t partition_bytes) const {
+  BufferedBlockMgr* block_mgr = state_->block_mgr();
+  int64_t available_mem = min(mem_tracker()->SpareCapacity(),
+      block_mgr->available_buffers(block_mgr_client_) * block_mgr->max_block_size());
+  for (int bits = MIN_PARTITIONING_BITS; bits < NUM_PARTITIONING_BITS; ++bits) {
+    // Each partition has an aggregated and an unaggregated row stream.
+    int64_t fanout = 1 << bits;
+    int64_t partition_mem = available_mem - 2 * fanout * block_mgr->max_block_size();
+    if (partition_bytes / fanout < partition_mem) return bits;
+  }
+  return NUM_PARTITIONING_BITS;
+}
+
 int64_t PartitionedAggregationNode::LargestSpilledPartition() const {
   int64_t max_rows = 0;
   for (int i = 0; i < hash_partitions_.size(); ++i) {
@@ -1221,11 +1323,15 @@ Status PartitionedAggregationNode::NextPartition() {
       partition = spilled_partitions_.front();
       DCHECK(partition->is_spilled());
 
-      // Create the new hash partitions to repartition into.
+      // Create the new hash partitions to repartition into, as few as are expected to
+      // fit in memory.
       // TODO: we don't need to repartition here. We are now working on 1 / FANOUT
       // of the input so it's reasonably likely it can fit. We should look at this
       // partitions size and just do the aggregation if it fits in memory.
-      RETURN_IF_ERROR(CreateHashPartitions(partition->level + 1));
+      int64_t partition_bytes = partition->aggregated_row_stream->byte_size() +
+          partition->unaggregated_row_stream->byte_size();
+      RETURN_IF_ERROR(CreateHashPartitions(partition->level + 1,
+          ComputeRepartitionBits(partition_bytes)));
       COUNTER_ADD(num_repartitions_, 1);
 
       // Rows in this partition could have been spilled into two streams, depending
@@ -1678,40 +1784,34 @@ Status PartitionedAggregationNode::CodegenUpdateSlot(
 //                          %"class.impala::TupleRow"* %row)
 //   ret void
 // }
+bool PartitionedAggregationNode::CanCodegenUpdateSlot(AggFnEvaluator* evaluator,
+    const SlotDescriptor* slot_desc) {
+  // Don't codegen things that aren't builtins (for now)
+  if (!evaluator->is_builtin()) return false;
+  AggFnEvaluator::AggregationOp op = evaluator->agg_op();
+  if (op == AggFnEvaluator::OTHER || evaluator->input_expr_ctxs().size() != 1) {
+    return false;
+  }
+  if (evaluator->input_expr_ctxs()[0]->root()->type().type == TYPE_TIMESTAMP &&
+      op != AggFnEvaluator::AVG) {
+    return false;
+  }
+  PrimitiveType type = slot_desc->type().type;
+  // Char and timestamp intermediates aren't supported
+  if (type == TYPE_TIMESTAMP || type == TYPE_CHAR) return false;
+  // Only AVG and NDV support string intermediates
+  if ((type == TYPE_STRING || type == TYPE_VARCHAR) &&
+      !(op == AggFnEvaluator::AVG || op == AggFnEvaluator::NDV)) {
+    return false;
+  }
+  return true;
+}
+
 Status PartitionedAggregationNode::CodegenUpdateTuple(Function** fn) {
   LlvmCodeGen* codegen;
   RETURN_IF_ERROR(state_->GetCodegen(&codegen));
   SCOPED_TIMER(codegen->codegen_timer());
 
-  int j = grouping_expr_ctxs_.size();
-  for (int i = 0; i < aggregate_evaluators_.size(); ++i, ++j) {
-    SlotDescriptor* slot_desc = intermediate_tuple_desc_->slots()[j];
-    AggFnEvaluator* evaluator = aggregate_evaluators_[i];
-
-    // Don't codegen things that aren't builtins (for now)
-    if (!evaluator->is_builtin()) {
-      return Status("PartitionedAggregationNode::CodegenUpdateTuple(): UDA codegen NYI");
-    }
-
-    bool supported = true;
-    AggFnEvaluator::AggregationOp op = evaluator->agg_op();
-    PrimitiveType type = slot_desc->type().type;
-    // Char and timestamp intermediates aren't supported
-    if (type == TYPE_TIMESTAMP || type == TYPE_CHAR) supported = false;
-    // Only AVG and NDV support string intermediates
-    if ((type == TYPE_STRING || type == TYPE_VARCHAR) &&
-        !(op == AggFnEvaluator::AVG || op == AggFnEvaluator::NDV)) {
-      supported = false;
-    }
-    if (!supported) {
-      stringstream ss;
-      ss << "Could not codegen PartitionedAggregationNode::UpdateTuple because "
-         << "intermediate type " << slot_desc->type() << " is not yet supported for "
-         << "aggregate function \"" << evaluator->fn_name() << "()\"";
-      return Status(ss.str());
-    }
-  }
-
   if (intermediate_tuple_desc_->GetLlvmStruct(codegen) == NULL) {
     return Status("PartitionedAggregationNode::CodegenUpdateTuple(): failed to generate "
         "intermediate tuple desc");
@@ -1742,16 +1842,21 @@ Status PartitionedAggregationNode::CodegenUpdateTuple(Function** fn) {
   *fn = prototype.GeneratePrototype(&builder, &args[0]);
 
   Value* agg_fn_ctxs_arg = args[1];
+  // UpdateSlotInterpreted() takes the Tuple* argument before the cast below.
+  Value* original_tuple_arg = args[2];
   Value* tuple_arg = args[2];
   Value* row_arg = args[3];
+  Value* is_merge_arg = args[4];
 
   // Cast the parameter types to the internal llvm runtime types.
   // TODO: get rid of this by using right type in function signature
   tuple_arg = builder.CreateBitCast(tuple_arg, tuple_ptr, "tuple");
 
   // Loop over each expr and generate the IR for that slot.  If the expr is not
-  // count(*), generate a helper IR function to update the slot and call that.
-  j = grouping_expr_ctxs_.size();
+  // count(*), generate a helper IR function to update the slot and call that. Aggregate
+  // functions that the helper does not support call UpdateSlotInterpreted() instead.
+  Function* update_slot_interpreted_fn = NULL;
+  int j = grouping_expr_ctxs_.size();
   for (int i = 0; i < aggregate_evaluators_.size(); ++i, ++j) {
     SlotDescriptor* slot_desc = intermediate_tuple_desc_->slots()[j];
     AggFnEvaluator* evaluator = aggregate_evaluators_[i];
@@ -1764,6 +1869,20 @@ Status PartitionedAggregationNode::CodegenUpdateTuple(Function** fn) {
       Value* slot_loaded = builder.CreateLoad(slot_ptr, "count_star_val");
       Value* count_inc = builder.CreateAdd(slot_loaded, const_one, "count_star_inc");
       builder.CreateStore(count_inc, slot_ptr);
+    } else if (!CanCodegenUpdateSlot(evaluator, slot_desc)) {
+      VLOG_QUERY << "Aggregate function \"" << evaluator->fn_name() << "()\" with "
+                 << "intermediate type " << slot_desc->type() << " is not codegen'd";
+      if (update_slot_interpreted_fn == NULL) {
+        update_slot_interpreted_fn = codegen->GetFunction(
+            IRFunction::PART_AGG_NODE_UPDATE_SLOT_INTERPRETED, false);
+        DCHECK(update_slot_interpreted_fn != NULL);
+      }
+      Value* evaluator_arg = codegen->CastPtrToLlvmPtr(
+          update_slot_interpreted_fn->arg_begin()->getType(), evaluator);
+      Value* fn_ctx_ptr = builder.CreateConstGEP1_32(agg_fn_ctxs_arg, i);
+      Value* fn_ctx = builder.CreateLoad(fn_ctx_ptr, "fn_ctx");
+      builder.CreateCall(update_slot_interpreted_fn, ArrayRef<Value*>(
+          {evaluator_arg, fn_ctx, original_tuple_arg, row_arg, is_merge_arg}));
     } else {
       Function* update_slot_fn;
       RETURN_IF_ERROR(CodegenUpdateSlot(evaluator, slot_desc, &update_slot_fn));
@@ -1842,6 +1961,7 @@ Status PartitionedAggregationNode::CodegenProcessBatch() {
     DCHECK_GE(replaced_constants.stores_duplicates, 1);
     DCHECK_GE(replaced_constants.stores_tuples, 1);
     DCHECK_GE(replaced_constants.quadratic_probing, 1);
+    DCHECK_GE(replaced_constants.tag_probing, 1);
   }
 
   replaced = codegen->ReplaceCallSites(process_batch_fn, update_tuple_fn, "UpdateTuple");
@@ -1920,6 +2040,7 @@ Status PartitionedAggregationNode::CodegenProcessBatchStreaming() {
   DCHECK_GE(replaced_constants.stores_duplicates, 1);
   DCHECK_GE(replaced_constants.stores_tuples, 1);
   DCHECK_GE(replaced_constants.quadratic_probing, 1);
+  DCHECK_GE(replaced_constants.tag_probing, 1);
 
   DCHECK(process_batch_streaming_fn != NULL);
   process_batch_streaming_fn = codegen->FinalizeFunction(process_batch_streaming_fn);
@@ -86,6 +86,12 @@ class SlotDescriptor;
 /// resources to expand its hash table. The planner decides whether a given
 /// pre-aggregation should use the streaming preaggregation algorithm or the same
 /// blocking aggregation algorithm as used in merge aggregations.
+/// Once the hash tables of a streaming pre-aggregation stopped growing, the node keeps
+/// measuring the reduction (input rows divided by passed-through rows and new groups)
+/// over samples of STREAMING_PREAGG_SAMPLE_ROWS input rows. If the reduction of a
+/// sample is below --streaming_preagg_min_reduction, looking rows up in the hash tables
+/// costs more than it saves, so the next --streaming_preagg_passthrough_rows input rows
+/// are passed through without any lookups, after which the reduction is sampled again.
 /// TODO: make this less of a heuristic by factoring in the cost of the exchange vs the
 /// cost of the pre-aggregation.
 ///
@@ -116,6 +122,18 @@ class SlotDescriptor;
 /// There are so many contexts in use that a plain "ctx" variable should never be used.
 /// Likewise, it's easy to mixup the agg fn ctxs, there should be a way to simplify this.
 /// TODO: support an Init() method with an initial value in the UDAF interface.
+/// TODO: merge the partitions of a final aggregation on several threads. The hash
+/// partitions are independent, but they share 'ht_ctx_', the expr contexts, the output
+/// and intermediate tuple pools and the block mgr client, which all assume a single
+/// thread. Each thread would need its own clones of these.
+/// TODO: evaluate GROUPING SETS, ROLLUP and CUBE in a single pass over the input. The
+/// plan would need to describe the grouping sets and a grouping id slot, which
+/// TAggregationNode does not have. Each set would then need its own 'ht_ctx_' and
+/// 'hash_partitions_', with the row of a set's missing grouping exprs set to NULL.
+/// TODO: evaluate several COUNT(DISTINCT) over different columns in a single pass.
+/// Like grouping sets, this needs plan support: TAggregationNode would need to list
+/// the distinct exprs of each aggregate, and each of them would then dedup its values
+/// in its own 'ht_ctx_' and 'hash_partitions_' before the counts are merged.
 class PartitionedAggregationNode : public ExecNode {
  public:
   PartitionedAggregationNode(ObjectPool* pool,
@@ -139,7 +157,8 @@ class PartitionedAggregationNode : public ExecNode {
  private:
   struct Partition;
 
-  /// Number of initial partitions to create. Must be a power of 2.
+  /// Number of initial partitions to create, which is also the largest number of
+  /// partitions that a spilled partition is repartitioned into. Must be a power of 2.
   static const int PARTITION_FANOUT = 16;
 
   /// Needs to be the log(PARTITION_FANOUT).
@@ -148,6 +167,10 @@ class PartitionedAggregationNode : public ExecNode {
   /// the partition so this might be okay.
   static const int NUM_PARTITIONING_BITS = 4;
 
+  /// The log of the smallest number of partitions that a spilled partition is
+  /// repartitioned into, see ComputeRepartitionBits().
+  static const int MIN_PARTITIONING_BITS = 1;
+
   /// Maximum number of times we will repartition. The maximum build table we can process
   /// (if we have enough scratch disk space) in case there is no skew is:
   ///  MEM_LIMIT * (PARTITION_FANOUT ^ MAX_PARTITION_DEPTH).
@@ -288,6 +311,11 @@ class PartitionedAggregationNode : public ExecNode {
   /// Expose the minimum reduction factor to continue growing the hash tables.
   RuntimeProfile::Counter* preagg_streaming_ht_min_reduction_;
 
+  /// The number of times the streaming preaggregation switched to passing all rows
+  /// through, and the number of rows passed through without a hash table lookup.
+  RuntimeProfile::Counter* num_passthrough_switches_;
+  RuntimeProfile::Counter* num_unprobed_passthrough_rows_;
+
   /// The estimated number of input rows from the planner.
   int64_t estimated_input_cardinality_;
 
@@ -307,6 +335,15 @@ class PartitionedAggregationNode : public ExecNode {
   /// If true, no more rows to output from partitions.
   bool partition_eos_;
 
+  /// Input rows of the current reduction sample of the streaming preaggregation and the
+  /// rows that they were not reduced to, i.e. the new groups and passed-through rows.
+  int64_t streaming_sample_input_rows_;
+  int64_t streaming_sample_output_rows_;
+
+  /// The number of input rows that are still passed through without looking them up in
+  /// the hash tables. Zero if the input rows are looked up.
+  int64_t streaming_passthrough_rows_left_;
+
   /// True if no more rows to process from child.
   bool child_eos_;
 
@@ -319,7 +356,12 @@ class PartitionedAggregationNode : public ExecNode {
   /// Current partitions we are partitioning into.
   std::vector<Partition*> hash_partitions_;
 
-  /// Cache for hash tables in 'hash_partitions_'.
+  /// Number of bits of the hash values that select a partition in hash_partitions_,
+  /// i.e. the log of its size. Set by CreateHashPartitions().
+  int num_partitioning_bits_;
+
+  /// Cache for hash tables in 'hash_partitions_'. Only the first
+  /// 1 << num_partitioning_bits_ entries are used.
   HashTable* hash_tbls_[PARTITION_FANOUT];
 
   /// All partitions that have been spilled and need further processing.
@@ -469,6 +511,14 @@ class PartitionedAggregationNode : public ExecNode {
   void UpdateTuple(impala_udf::FunctionContext** agg_fn_ctxs, Tuple* tuple, TupleRow* row,
                    bool is_merge = false);
 
+  /// Updates the slot of 'evaluator' in 'tuple' with 'row' like UpdateTuple() does for
+  /// all evaluators. Called from the codegen'd UpdateTuple() for the aggregate functions
+  /// that CodegenUpdateSlot() does not support, e.g. UDAs, so that the other aggregate
+  /// functions and the rest of ProcessBatch() are still codegen'd.
+  static void UpdateSlotInterpreted(AggFnEvaluator* evaluator,
+      impala_udf::FunctionContext* agg_fn_ctx, Tuple* tuple, TupleRow* row,
+      bool is_merge);
+
   /// Called on the intermediate tuple of each group after all input rows have been
   /// consumed and aggregated. Computes the final aggregate values to be returned in
   /// GetNext() using the agg fn evaluators' Serialize() or Finalize().
@@ -555,6 +605,13 @@ class PartitionedAggregationNode : public ExecNode {
   /// the preagg should pass through any rows it can't fit in its tables.
   bool ShouldExpandPreaggHashTables() const;
 
+  /// Adds a batch of 'input_rows' rows, which created 'new_groups' groups and of which
+  /// 'passthrough_rows' were passed through, to the reduction sample of the streaming
+  /// preaggregation. Starts passing through all rows if the sample is complete and the
+  /// reduction is too low.
+  void UpdateStreamingReduction(int64_t input_rows, int64_t new_groups,
+      int64_t passthrough_rows);
+
   /// Streaming processing of in_batch from child. Rows from child are either aggregated
   /// into the hash table or added to 'out_batch' in the intermediate tuple format.
   /// 'in_batch' is processed entirely, and 'out_batch' must have enough capacity to
@@ -584,9 +641,24 @@ class PartitionedAggregationNode : public ExecNode {
       Partition* partition, HashTable* hash_tbl, TupleRow* in_row, uint32_t hash,
       int* remaining_capacity, Status* status);
 
-  /// Initializes hash_partitions_. 'level' is the level for the partitions to create.
-  /// Also sets ht_ctx_'s level to 'level'.
-  Status CreateHashPartitions(int level);
+  /// Converts all rows of 'in_batch' into the intermediate tuple format and adds them to
+  /// 'out_batch' without looking them up in the hash tables. The arguments are the same
+  /// as for ProcessBatchStreaming().
+  Status PassThroughBatchStreaming(bool needs_serialize, RowBatch* in_batch,
+      RowBatch* out_batch, HashTableCtx* ht_ctx);
+
+  /// Initializes hash_partitions_ with 1 << 'num_partitioning_bits' partitions. 'level'
+  /// is the level for the partitions to create. Also sets ht_ctx_'s level to 'level'.
+  Status CreateHashPartitions(int level,
+      int num_partitioning_bits = NUM_PARTITIONING_BITS);
+
+  /// Returns the number of partitioning bits to repartition a spilled partition whose
+  /// streams take 'partition_bytes': the smallest fan-out that is expected to make each
+  /// new partition fit in the memory available to this node, after the write buffers
+  /// of the new partitions. Lower fan-outs leave more memory to the hash tables, so more
+  /// of the new partitions stay in memory. Returns NUM_PARTITIONING_BITS if no fan-out
+  /// is expected to be sufficient.
+  int ComputeRepartitionBits(int64_t partition_bytes) const;
 
   /// Ensure that hash tables for all in-memory partitions are large enough to fit
   /// 'num_rows' additional hash table entries. If there is not enough memory to
@@ -622,6 +694,11 @@ class PartitionedAggregationNode : public ExecNode {
   void CleanupHashTbl(const std::vector<impala_udf::FunctionContext*>& agg_fn_ctxs,
       HashTable::Iterator it);
 
+  /// Returns true if CodegenUpdateSlot() supports 'evaluator', whose intermediate
+  /// value is in 'slot_desc'.
+  static bool CanCodegenUpdateSlot(AggFnEvaluator* evaluator,
+      const SlotDescriptor* slot_desc);
+
   /// Codegen UpdateSlot(). Returns non-OK status if codegen is unsuccessful.
   /// Assumes is_merge = false;
   Status CodegenUpdateSlot(AggFnEvaluator* evaluator, SlotDescriptor* slot_desc,
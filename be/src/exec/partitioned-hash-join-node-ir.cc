@@ -263,7 +263,7 @@ bool IR_ALWAYS_INLINE PartitionedHashJoinNode::NextProbeRow(
     // The hash of the expressions results for the current probe row.
     uint32_t hash = expr_vals_cache->ExprValuesHash();
     // Hoist the followings out of the else statement below to speed up non-null case.
-    const uint32_t partition_idx = hash >> (32 - NUM_PARTITIONING_BITS);
+    const uint32_t partition_idx = hash >> (32 - num_partitioning_bits_);
     HashTable* hash_tbl = hash_tbls_[partition_idx];
 
     // Fetch the hash and expr values' nullness for this row.
@@ -342,7 +342,7 @@ void IR_ALWAYS_INLINE PartitionedHashJoinNode::EvalAndHashProbePrefetchGroup(
     if (ht_ctx->EvalAndHashProbe(row)) {
       if (prefetch_mode != TPrefetchMode::NONE) {
         uint32_t hash = expr_vals_cache->ExprValuesHash();
-        const uint32_t partition_idx = hash >> (32 - NUM_PARTITIONING_BITS);
+        const uint32_t partition_idx = hash >> (32 - num_partitioning_bits_);
         HashTable* hash_tbl = hash_tbls_[partition_idx];
         if (LIKELY(hash_tbl != NULL)) hash_tbl->PrefetchBucket<true>(hash);
       }
@@ -352,6 +352,22 @@ void IR_ALWAYS_INLINE PartitionedHashJoinNode::EvalAndHashProbePrefetchGroup(
     expr_vals_cache->NextRow();
   }
   expr_vals_cache->ResetForRead();
+
+  // By now the buckets of the first rows of the group are likely in the cache. Prefetch
+  // the build rows they point to as well, so that the row comparisons in FindProbeRow()
+  // do not stall on a second cache miss.
+  if (prefetch_mode != TPrefetchMode::NONE) {
+    while (!expr_vals_cache->AtEnd()) {
+      if (!expr_vals_cache->IsRowNull()) {
+        uint32_t hash = expr_vals_cache->ExprValuesHash();
+        const uint32_t partition_idx = hash >> (32 - num_partitioning_bits_);
+        HashTable* hash_tbl = hash_tbls_[partition_idx];
+        if (LIKELY(hash_tbl != NULL)) hash_tbl->PrefetchBucketData(hash);
+      }
+      expr_vals_cache->NextRow();
+    }
+    expr_vals_cache->ResetForRead();
+  }
 }
 
 // CreateOutputRow, EvalOtherJoinConjuncts, and EvalConjuncts are replaced by codegen.
@@ -451,15 +467,18 @@ Status PartitionedHashJoinNode::ProcessBuildBatch(RowBatch* build_batch,
           << "Runtime filters should not be built during repartitioning.";
       for (const FilterContext& ctx: filters_) {
         // TODO: codegen expr evaluation and hashing
-        if (ctx.local_bloom_filter == NULL) continue;
+        if (ctx.local_bloom_filter == NULL && ctx.local_min_max_filter == NULL) continue;
         void* e = ctx.expr->GetValue(build_row);
-        uint32_t filter_hash = RawValue::GetHashValue(e, ctx.expr->root()->type(),
-            RuntimeFilterBank::DefaultHashSeed());
-        ctx.local_bloom_filter->Insert(filter_hash);
+        if (ctx.local_bloom_filter != NULL) {
+          uint32_t filter_hash = RawValue::GetHashValue(e, ctx.expr->root()->type(),
+              RuntimeFilterBank::DefaultHashSeed());
+          ctx.local_bloom_filter->Insert(filter_hash);
+        }
+        if (ctx.local_min_max_filter != NULL) ctx.local_min_max_filter->Insert(e);
       }
     }
     const uint32_t hash = expr_vals_cache->ExprValuesHash();
-    const uint32_t partition_idx = hash >> (32 - NUM_PARTITIONING_BITS);
+    const uint32_t partition_idx = hash >> (32 - num_partitioning_bits_);
     Partition* partition = hash_partitions_[partition_idx];
     const bool result = AppendRow(partition->build_rows(), build_row, &build_status_);
     if (UNLIKELY(!result)) return build_status_;
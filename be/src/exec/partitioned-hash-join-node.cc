@@ -40,6 +40,17 @@
 #include "common/names.h"
 
 DEFINE_bool(enable_phj_probe_side_filtering, true, "Deprecated.");
+DEFINE_bool(enable_radix_hash_join, false, "(Advanced) If true, hash joins whose "
+    "in-memory build side is larger than --radix_hash_join_min_build_bytes first "
+    "partition the probe side and then build and probe the hash table of one partition "
+    "at a time, which makes probing more cache-friendly.");
+DEFINE_int64(radix_hash_join_min_build_bytes, 32L * 1024L * 1024L, "(Advanced) The "
+    "minimum size of the in-memory build side of a hash join, including the estimated "
+    "size of its hash tables, for --enable_radix_hash_join to take effect.");
+DEFINE_bool(hash_join_inline_build_tuples, true, "(Advanced) If true, the hash tables of "
+    "left semi and anti joins whose build rows are a single non-nullable tuple of at "
+    "most 8 bytes store the tuples in their buckets, so that a probe hit touches a "
+    "single cache line.");
 
 const string PREPARE_FOR_READ_FAILED_ERROR_MSG = "Failed to acquire initial read buffer "
     "for stream in hash join node $0. Reducing query concurrency or increasing the "
@@ -58,11 +69,13 @@ PartitionedHashJoinNode::PartitionedHashJoinNode(
     partition_build_timer_(NULL),
     null_aware_eval_timer_(NULL),
     state_(PARTITIONING_BUILD),
+    num_partitioning_bits_(NUM_PARTITIONING_BITS),
     partition_pool_(new ObjectPool()),
     input_partition_(NULL),
     null_aware_partition_(NULL),
     non_empty_build_(false),
     null_probe_rows_(NULL),
+    num_matched_null_probe_(0),
     null_probe_output_idx_(-1),
     process_build_batch_fn_(NULL),
     process_build_batch_fn_level0_(NULL),
@@ -189,6 +202,10 @@ Status PartitionedHashJoinNode::Prepare(RuntimeState* state) {
       ADD_COUNTER(runtime_profile(), "NumRepartitions", TUnit::UNIT);
   num_spilled_partitions_ =
       ADD_COUNTER(runtime_profile(), "SpilledPartitions", TUnit::UNIT);
+  num_deferred_partitions_ =
+      ADD_COUNTER(runtime_profile(), "DeferredPartitions", TUnit::UNIT);
+  num_skewed_partitions_ =
+      ADD_COUNTER(runtime_profile(), "SkewedPartitions", TUnit::UNIT);
   largest_partition_percent_ = runtime_profile()->AddHighWaterMarkCounter(
       "LargestPartitionPercent", TUnit::UNIT);
   num_hash_collisions_ =
@@ -263,9 +280,11 @@ Status PartitionedHashJoinNode::Reset(RuntimeState* state) {
     non_empty_build_ = false;
     null_probe_output_idx_ = -1;
     matched_null_probe_.clear();
+    num_matched_null_probe_ = 0;
     nulls_build_batch_.reset();
   }
   state_ = PARTITIONING_BUILD;
+  num_partitioning_bits_ = NUM_PARTITIONING_BITS;
   ht_ctx_->set_level(0);
   ClosePartitions();
   memset(hash_tbls_, 0, sizeof(HashTable*) * PARTITION_FANOUT);
@@ -328,6 +347,8 @@ PartitionedHashJoinNode::Partition::Partition(RuntimeState* state,
   : parent_(parent),
     is_closed_(false),
     is_spilled_(false),
+    is_deferred_(false),
+    is_skewed_(false),
     level_(level) {
   build_rows_ = new BufferedTupleStream(state, parent_->child(1)->row_desc(),
       state->block_mgr(), parent_->block_mgr_client_,
@@ -380,10 +401,11 @@ void PartitionedHashJoinNode::Partition::Close(RowBatch* batch) {
 
 Status PartitionedHashJoinNode::Partition::Spill(bool unpin_all_build) {
   DCHECK(!is_closed_);
-  // Spilling should occur before we start processing probe rows.
-  DCHECK(parent_->state_ != PROCESSING_PROBE &&
-         parent_->state_ != PROBING_SPILLED_PARTITION) << parent_->state_;
-  DCHECK((is_spilled_ && parent_->state_ == REPARTITIONING) ||
+  // Spilling should occur before we start processing probe rows, unless the partition
+  // is deferred and its probe rows are in its probe stream.
+  DCHECK(is_deferred_ || (parent_->state_ != PROCESSING_PROBE &&
+         parent_->state_ != PROBING_SPILLED_PARTITION)) << parent_->state_;
+  DCHECK((is_spilled_ && (parent_->state_ == REPARTITIONING || is_deferred_)) ||
          probe_rows_->num_rows() == 0);
   // Close the hash table as soon as possible to release memory.
   if (hash_tbl() != NULL) {
@@ -398,6 +420,8 @@ Status PartitionedHashJoinNode::Partition::Spill(bool unpin_all_build) {
   // Unpin the stream as soon as possible to increase the chances that the
   // SwitchToIoBuffers() call below will succeed.
   RETURN_IF_ERROR(build_rows_->UnpinStream(unpin_all_build));
+  // Only the probe stream of a deferred partition is pinned.
+  if (is_deferred_) RETURN_IF_ERROR(probe_rows_->UnpinStream(false));
 
   if (got_buffer && probe_rows_->using_small_buffers()) {
     RETURN_IF_ERROR(probe_rows_->SwitchToIoBuffers(&got_buffer));
@@ -411,7 +435,7 @@ Status PartitionedHashJoinNode::Partition::Spill(bool unpin_all_build) {
     VLOG_FILE << GetStackTrace();
   }
 
-  if (!is_spilled_) {
+  if (!is_spilled_ || is_deferred_) {
     COUNTER_ADD(parent_->num_spilled_partitions_, 1);
     if (parent_->num_spilled_partitions_->value() == 1) {
       parent_->AddRuntimeExecOption("Spilled");
@@ -419,6 +443,20 @@ Status PartitionedHashJoinNode::Partition::Spill(bool unpin_all_build) {
   }
 
   is_spilled_ = true;
+  is_deferred_ = false;
+  return Status::OK();
+}
+
+Status PartitionedHashJoinNode::Partition::Defer(bool* deferred) {
+  DCHECK(!is_closed_);
+  DCHECK(!is_spilled_);
+  DCHECK(hash_tbl_.get() == NULL);
+  DCHECK_EQ(probe_rows_->num_rows(), 0);
+  RETURN_IF_ERROR(probe_rows_->PinStream(false, deferred));
+  if (!*deferred) return Status::OK();
+  is_spilled_ = true;
+  is_deferred_ = true;
+  COUNTER_ADD(parent_->num_deferred_partitions_, 1);
   return Status::OK();
 }
 
@@ -457,9 +495,10 @@ Status PartitionedHashJoinNode::Partition::BuildHashTable(RuntimeState* state,
   int64_t estimated_num_buckets = build_rows()->RowConsumesMemory() ?
       HashTable::EstimateNumBuckets(build_rows()->num_rows()) : state->batch_size() * 2;
   hash_tbl_.reset(HashTable::Create(state, parent_->block_mgr_client_,
-      true /* store_duplicates */,
+      parent_->HashTableStoresDuplicates(),
       parent_->child(1)->row_desc().tuple_descriptors().size(), build_rows(),
-      1 << (32 - NUM_PARTITIONING_BITS), estimated_num_buckets));
+      1 << (32 - NUM_PARTITIONING_BITS), estimated_num_buckets,
+      parent_->InlineBuildTupleSize()));
   if (!hash_tbl_->Init()) goto not_built;
 
   do {
@@ -494,6 +533,7 @@ Status PartitionedHashJoinNode::Partition::BuildHashTable(RuntimeState* state,
   DCHECK(*built);
   DCHECK(hash_tbl_.get() != NULL);
   is_spilled_ = false;
+  is_deferred_ = false;
   COUNTER_ADD(parent_->num_hash_buckets_, hash_tbl_->num_buckets());
   return Status::OK();
 
@@ -512,7 +552,10 @@ bool PartitionedHashJoinNode::AllocateRuntimeFilters(RuntimeState* state) {
   DCHECK(ht_ctx_.get() != NULL);
   for (int i = 0; i < filters_.size(); ++i) {
     filters_[i].local_bloom_filter =
-        state->filter_bank()->AllocateScratchBloomFilter(filters_[i].filter->id());
+        state->filter_bank()->AllocateScratchBloomFilter(filters_[i].filter->id(), true);
+    filters_[i].local_min_max_filter =
+        state->filter_bank()->AllocateScratchMinMaxFilter(filters_[i].filter->id(),
+            filters_[i].expr->root()->type());
   }
   return true;
 }
@@ -520,20 +563,21 @@ bool PartitionedHashJoinNode::AllocateRuntimeFilters(RuntimeState* state) {
 void PartitionedHashJoinNode::PublishRuntimeFilters(RuntimeState* state,
     int64_t total_build_rows) {
   int32_t num_enabled_filters = 0;
-  // Use total_build_rows to estimate FP-rate of each Bloom filter, and publish
+  // Estimate the FP-rate of each Bloom filter from the bits set in it, and publish
   // 'always-true' filters if it's too high. Doing so saves CPU at the coordinator,
   // serialisation time, and reduces the cost of applying the filter at the scan - most
-  // significantly for per-row filters. However, the number of build rows could be a very
-  // poor estimate of the NDV - particularly if the filter expression is a function of
-  // several columns.
-  // TODO: Better heuristic.
+  // significantly for per-row filters. The filter bank also shrinks filters to the
+  // observed NDV where it can.
   for (const FilterContext& ctx: filters_) {
-    // TODO: Consider checking actual number of bits set in filter to compute FP rate.
     // TODO: Consider checking this every few batches or so.
-    bool fp_rate_too_high =
-        state->filter_bank()->FpRateTooHigh(ctx.filter->filter_size(), total_build_rows);
+    bool fp_rate_too_high = ctx.local_bloom_filter == NULL ||
+        !state->filter_bank()->FinalizeScratchBloomFilter(ctx.filter->id(),
+            ctx.local_bloom_filter, total_build_rows);
+    // The min/max filter is published even if the Bloom filter is disabled, as its
+    // selectivity does not depend on the number of build rows.
     state->filter_bank()->UpdateFilterFromLocal(ctx.filter->id(),
-        fp_rate_too_high ? BloomFilter::ALWAYS_TRUE_FILTER : ctx.local_bloom_filter);
+        fp_rate_too_high ? BloomFilter::ALWAYS_TRUE_FILTER : ctx.local_bloom_filter,
+        ctx.local_min_max_filter);
 
     num_enabled_filters += !fp_rate_too_high;
   }
@@ -581,12 +625,27 @@ Status PartitionedHashJoinNode::SpillPartition(Partition** spilled_partition) {
   int partition_idx = -1;
   *spilled_partition = NULL;
 
+  // While repartitioning, a skewed partition would most likely be spilled again by the
+  // next repartitioning, so spill the other partitions first and try to build its hash
+  // table at this level.
+  int64_t skewed_rows = -1;
+  if (state_ == REPARTITIONING && hash_partitions_.size() > SKEW_FACTOR) {
+    int64_t total_rows = 0;
+    for (Partition* partition: hash_partitions_) {
+      if (!partition->is_closed()) total_rows += partition->build_rows()->num_rows();
+    }
+    skewed_rows = total_rows * SKEW_FACTOR / hash_partitions_.size();
+  }
+  int64_t max_skewed_mem = 0;
+  int skewed_idx = -1;
+
   // Iterate over the partitions and pick the largest partition to spill.
   for (int i = 0; i < hash_partitions_.size(); ++i) {
     Partition* candidate = hash_partitions_[i];
     if (candidate->is_closed()) continue;
-    if (candidate->is_spilled()) continue;
+    if (candidate->is_spilled() && !candidate->is_deferred()) continue;
     int64_t mem = candidate->build_rows()->bytes_in_mem(false);
+    if (candidate->is_deferred()) mem += candidate->probe_rows()->bytes_in_mem(false);
     // TODO: What should we do here if probe_rows()->num_rows() > 0 ? We should be able
     // to spill INNER JOINS, but not many of the other joins.
     if (candidate->hash_tbl() != NULL) {
@@ -595,11 +654,25 @@ Status PartitionedHashJoinNode::SpillPartition(Partition** spilled_partition) {
       if (UNLIKELY(candidate->hash_tbl()->HasMatches())) continue;
       mem += candidate->hash_tbl()->ByteSize();
     }
+    if (skewed_rows >= 0 && candidate->hash_tbl() == NULL &&
+        candidate->build_rows()->num_rows() > skewed_rows) {
+      if (!candidate->is_skewed_) {
+        candidate->is_skewed_ = true;
+        COUNTER_ADD(num_skewed_partitions_, 1);
+      }
+      if (mem > max_skewed_mem) {
+        max_skewed_mem = mem;
+        skewed_idx = i;
+      }
+      continue;
+    }
     if (mem > max_freed_mem) {
       max_freed_mem = mem;
       partition_idx = i;
     }
   }
+  // Spill a skewed partition only if it is the only one that frees memory.
+  if (partition_idx == -1) partition_idx = skewed_idx;
 
   if (partition_idx == -1) {
     // Could not find a partition to spill. This means the mem limit was just too low.
@@ -640,11 +713,25 @@ Status PartitionedHashJoinNode::ConstructBuildSide(RuntimeState* state) {
   return Status::OK();
 }
 
+int PartitionedHashJoinNode::ComputeRepartitionBits(int64_t build_bytes) const {
+  BufferedBlockMgr* block_mgr = runtime_state_->block_mgr();
+  int64_t available_mem = min(mem_tracker()->SpareCapacity(),
+      block_mgr->available_buffers(block_mgr_client_) * block_mgr->max_block_size());
+  for (int bits = MIN_PARTITIONING_BITS; bits < NUM_PARTITIONING_BITS; ++bits) {
+    int64_t fanout = 1 << bits;
+    int64_t partition_mem = available_mem - 2 * fanout * block_mgr->max_block_size();
+    if (build_bytes / fanout < partition_mem) return bits;
+  }
+  return NUM_PARTITIONING_BITS;
+}
+
 Status PartitionedHashJoinNode::ProcessBuildInput(RuntimeState* state, int level) {
   if (UNLIKELY(level >= MAX_PARTITION_DEPTH)) {
     return Status(TErrorCode::PARTITIONED_HASH_JOIN_MAX_PARTITION_DEPTH, id_,
         MAX_PARTITION_DEPTH);
   }
+  num_partitioning_bits_ = input_partition_ == NULL ? NUM_PARTITIONING_BITS :
+      ComputeRepartitionBits(input_partition_->EstimatedInMemSize());
 
   DCHECK(hash_partitions_.empty());
   if (input_partition_ != NULL) {
@@ -660,7 +747,8 @@ Status PartitionedHashJoinNode::ProcessBuildInput(RuntimeState* state, int level
     }
   }
 
-  for (int i = 0; i < PARTITION_FANOUT; ++i) {
+  const int num_partitions = 1 << num_partitioning_bits_;
+  for (int i = 0; i < num_partitions; ++i) {
     Partition* new_partition = new Partition(state, this, level);
     DCHECK(new_partition != NULL);
     hash_partitions_.push_back(partition_pool_->Add(new_partition));
@@ -674,10 +762,10 @@ Status PartitionedHashJoinNode::ProcessBuildInput(RuntimeState* state, int level
     // optimization.
     RETURN_IF_ERROR(new_partition->probe_rows()->Init(id(), runtime_profile(), false));
   }
-  COUNTER_ADD(partitions_created_, PARTITION_FANOUT);
+  COUNTER_ADD(partitions_created_, num_partitions);
   COUNTER_SET(max_partition_level_, level);
 
-  RowBatch build_batch(child(1)->row_desc(), state->batch_size(), mem_tracker());
+  RowBatch build_batch(child(1)->row_desc(), ChildBatchCapacity(state, 1), mem_tracker());
   bool eos = false;
   int64_t total_build_rows = 0;
   while (!eos) {
@@ -826,6 +914,16 @@ Status PartitionedHashJoinNode::PrepareNextPartition(RuntimeState* state) {
   spilled_partitions_.pop_front();
   DCHECK(input_partition_->is_spilled());
 
+  // The build rows of a deferred partition are still pinned, so try to build its hash
+  // table right away. If that fails, it is handled like any other spilled partition.
+  bool built = false;
+  bool was_deferred = input_partition_->is_deferred();
+  if (was_deferred) {
+    ht_ctx_->set_level(input_partition_->level_);
+    RETURN_IF_ERROR(input_partition_->BuildHashTable(state, &built));
+    if (!built) RETURN_IF_ERROR(input_partition_->Spill(true));
+  }
+
   // Reserve one buffer to read the probe side.
   bool got_read_buffer;
   RETURN_IF_ERROR(input_partition_->probe_rows()->PrepareForRead(true, &got_read_buffer));
@@ -836,18 +934,20 @@ Status PartitionedHashJoinNode::PrepareNextPartition(RuntimeState* state) {
   }
   ht_ctx_->set_level(input_partition_->level_);
 
-  int64_t mem_limit = mem_tracker()->SpareCapacity();
-  // Try to build a hash table on top the spilled build rows.
-  bool built = false;
-  int64_t estimated_memory = input_partition_->EstimatedInMemSize();
-  if (estimated_memory < mem_limit) {
-    ht_ctx_->set_level(input_partition_->level_);
-    RETURN_IF_ERROR(input_partition_->BuildHashTable(state, &built));
-  } else {
-    LOG(INFO) << "In hash join id=" << id_ << " the estimated needed memory ("
-        << estimated_memory << ") for partition " << input_partition_ << " with "
-        << input_partition_->build_rows()->num_rows() << " build rows is larger "
-        << " than the mem_limit (" << mem_limit << ").";
+  // Try to build a hash table on top the spilled build rows, unless this was already
+  // attempted for a deferred partition above.
+  if (!was_deferred) {
+    int64_t mem_limit = mem_tracker()->SpareCapacity();
+    int64_t estimated_memory = input_partition_->EstimatedInMemSize();
+    if (estimated_memory < mem_limit) {
+      ht_ctx_->set_level(input_partition_->level_);
+      RETURN_IF_ERROR(input_partition_->BuildHashTable(state, &built));
+    } else {
+      LOG(INFO) << "In hash join id=" << id_ << " the estimated needed memory ("
+          << estimated_memory << ") for partition " << input_partition_ << " with "
+          << input_partition_->build_rows()->num_rows() << " build rows is larger "
+          << " than the mem_limit (" << mem_limit << ").";
+    }
   }
 
   if (!built) {
@@ -937,10 +1037,12 @@ int PartitionedHashJoinNode::ProcessProbeBatch(
 Status PartitionedHashJoinNode::GetNext(RuntimeState* state, RowBatch* out_batch,
     bool* eos) {
   SCOPED_TIMER(runtime_profile_->total_time_counter());
+  SCOPED_PERF_EVENT_MEASUREMENT(perf_event_counters_);
+  SCOPED_CPU_SAMPLE_NODE(id_);
   RETURN_IF_ERROR(ExecDebugAction(TExecNodePhase::GETNEXT, state));
   DCHECK(!out_batch->AtCapacity());
 
-  if (ReachedLimit()) {
+  if (ReachedLimit() || NullAwareJoinIsEmpty()) {
     *eos = true;
     return Status::OK();
   } else {
@@ -1288,7 +1390,8 @@ Status PartitionedHashJoinNode::OutputNullAwareProbeRows(RuntimeState* state,
 //
 // TODO: implement the knapsack solution.
 Status PartitionedHashJoinNode::BuildHashTables(RuntimeState* state) {
-  DCHECK_EQ(hash_partitions_.size(), PARTITION_FANOUT);
+  DCHECK_EQ(hash_partitions_.size(), 1 << num_partitioning_bits_);
+  const bool defer_hash_tables = ShouldDeferHashTables();
 
   // First loop over the partitions and build hash tables for the partitions that did
   // not already spill.
@@ -1300,8 +1403,13 @@ Status PartitionedHashJoinNode::BuildHashTables(RuntimeState* state) {
     }
 
     if (!partition->is_spilled()) {
-      bool built = false;
       DCHECK(partition->build_rows()->is_pinned());
+      if (defer_hash_tables) {
+        bool deferred;
+        RETURN_IF_ERROR(partition->Defer(&deferred));
+        if (deferred) continue;
+      }
+      bool built = false;
       RETURN_IF_ERROR(partition->BuildHashTable(state, &built));
       // If we did not have enough memory to build this hash table, we need to spill this
       // partition (clean up the hash table, unpin build).
@@ -1312,9 +1420,11 @@ Status PartitionedHashJoinNode::BuildHashTables(RuntimeState* state) {
   // Collect all the spilled partitions that don't have an IO buffer. We need to reserve
   // an IO buffer for those partitions. Reserving an IO buffer can cause more partitions
   // to spill so this process is recursive.
+  // Deferred partitions keep their small buffers until they fill up. The IO buffer they
+  // need then is obtained by AppendRowStreamFull().
   list<Partition*> spilled_partitions;
   for (Partition* partition: hash_partitions_) {
-    if (partition->is_closed()) continue;
+    if (partition->is_closed() || partition->is_deferred()) continue;
     if (partition->is_spilled() && partition->probe_rows()->using_small_buffers()) {
       spilled_partitions.push_back(partition);
     }
@@ -1344,6 +1454,7 @@ Status PartitionedHashJoinNode::BuildHashTables(RuntimeState* state) {
   // 2. in_mem. The build side is pinned and has a hash table built.
   // 3. spilled. The build side is fully unpinned and the probe side has an io
   //    sized buffer.
+  // 4. deferred. Both the build and the probe side are pinned.
   for (Partition* partition: hash_partitions_) {
     if (partition->hash_tbl() != NULL) partition->probe_rows()->Close();
   }
@@ -1360,17 +1471,57 @@ Status PartitionedHashJoinNode::BuildHashTables(RuntimeState* state) {
   // Investigate if this is worthwhile.
 
   // Initialize the hash_tbl_ caching array.
-  for (int i = 0; i < PARTITION_FANOUT; ++i) {
+  for (int i = 0; i < hash_partitions_.size(); ++i) {
     hash_tbls_[i] = hash_partitions_[i]->hash_tbl();
   }
   return Status::OK();
 }
 
+bool PartitionedHashJoinNode::ShouldDeferHashTables() const {
+  if (!FLAGS_enable_radix_hash_join) return false;
+  // Only the partitions of the children's input are deferred. The NULL-aware anti join
+  // needs to evaluate its NULL probe rows against all in-memory partitions.
+  if (input_partition_ != NULL || join_op_ == TJoinOp::NULL_AWARE_LEFT_ANTI_JOIN) {
+    return false;
+  }
+  int64_t in_mem_size = 0;
+  for (const Partition* partition: hash_partitions_) {
+    if (partition->is_closed() || partition->is_spilled()) continue;
+    in_mem_size += partition->EstimatedInMemSize();
+  }
+  return in_mem_size >= FLAGS_radix_hash_join_min_build_bytes;
+}
+
+bool PartitionedHashJoinNode::NullAwareJoinIsEmpty() const {
+  return join_op_ == TJoinOp::NULL_AWARE_LEFT_ANTI_JOIN &&
+      other_join_conjunct_ctxs_.empty() && null_aware_partition_ != NULL &&
+      null_aware_partition_->build_rows()->num_rows() > 0;
+}
+
+int PartitionedHashJoinNode::InlineBuildTupleSize() const {
+  if (!FLAGS_hash_join_inline_build_tuples) return 0;
+  if (join_op_ != TJoinOp::LEFT_SEMI_JOIN && join_op_ != TJoinOp::LEFT_ANTI_JOIN) {
+    return 0;
+  }
+  const RowDescriptor& build_desc = child(1)->row_desc();
+  if (build_desc.tuple_descriptors().size() != 1 || build_desc.TupleIsNullable(0)) {
+    return 0;
+  }
+  const TupleDescriptor* build_tuple_desc = build_desc.tuple_descriptors()[0];
+  if (build_tuple_desc->HasVarlenSlots() || build_tuple_desc->byte_size() == 0 ||
+      build_tuple_desc->byte_size() > HashTable::MAX_INLINE_TUPLE_SIZE) {
+    return 0;
+  }
+  return build_tuple_desc->byte_size();
+}
+
 Status PartitionedHashJoinNode::EvaluateNullProbe(BufferedTupleStream* build) {
   if (null_probe_rows_ == NULL || null_probe_rows_->num_rows() == 0) {
     return Status::OK();
   }
   DCHECK_EQ(null_probe_rows_->num_rows(), matched_null_probe_.size());
+  // No build row can change the result, so don't pin 'build' in memory.
+  if (num_matched_null_probe_ == matched_null_probe_.size()) return Status::OK();
 
   // Bring both the build and probe side into memory and do a pairwise evaluation.
   bool got_rows;
@@ -1395,6 +1546,7 @@ Status PartitionedHashJoinNode::EvaluateNullProbe(BufferedTupleStream* build) {
       if (ExecNode::EvalConjuncts(
             join_conjunct_ctxs, num_join_conjuncts, semi_join_staging_row_)) {
         matched_null_probe_[i] = true;
+        ++num_matched_null_probe_;
         break;
       }
     }
@@ -1414,10 +1566,15 @@ Status PartitionedHashJoinNode::CleanUpHashPartitions(RowBatch* batch) {
   // add them to the list of partitions that need to output any unmatched build rows.
   // This partition will be closed by the function that actually outputs unmatched build
   // rows.
+  vector<Partition*> deferred_partitions;
   for (int i = 0; i < hash_partitions_.size(); ++i) {
     Partition* partition = hash_partitions_[i];
     if (partition->is_closed()) continue;
-    if (partition->is_spilled()) {
+    if (partition->is_deferred()) {
+      // Keep the streams pinned, the hash table will be built from them next.
+      DCHECK(partition->hash_tbl() == NULL) << NodeDebugString();
+      deferred_partitions.push_back(partition);
+    } else if (partition->is_spilled()) {
       DCHECK(partition->hash_tbl() == NULL) << NodeDebugString();
       // Unpin the build and probe stream to free up more memory. We need to free all
       // memory so we can recurse the algorithm and create new hash partitions from
@@ -1450,6 +1607,12 @@ Status PartitionedHashJoinNode::CleanUpHashPartitions(RowBatch* batch) {
     }
   }
 
+  // Process the deferred partitions before the spilled ones, so that their memory is
+  // released before any spilled partition is read back.
+  for (Partition* partition: deferred_partitions) {
+    spilled_partitions_.push_front(partition);
+  }
+
   // Just finished evaluating the null probe rows with all the non-spilled build
   // partitions. Unpin this now to free this memory for repartitioning.
   if (null_probe_rows_ != NULL) RETURN_IF_ERROR(null_probe_rows_->UnpinStream());
@@ -1501,7 +1664,7 @@ string PartitionedHashJoinNode::NodeDebugString() const {
       continue;
     }
     if (partition->is_spilled()) {
-      ss << " Spilled" << endl;
+      ss << (partition->is_deferred() ? " Deferred" : " Spilled") << endl;
     }
     DCHECK(partition->build_rows() != NULL);
     DCHECK(partition->probe_rows() != NULL);
@@ -1667,7 +1830,7 @@ Status PartitionedHashJoinNode::CodegenProcessBuildBatch(RuntimeState* state,
 
   // Replace some hash table parameters with constants.
   HashTableCtx::HashTableReplacedConstants replaced_constants;
-  const bool stores_duplicates = true;
+  const bool stores_duplicates = HashTableStoresDuplicates();
   const int num_build_tuples = child(1)->row_desc().tuple_descriptors().size();
   RETURN_IF_ERROR(ht_ctx_->ReplaceHashTableConstants(state, stores_duplicates,
       num_build_tuples, process_build_batch_fn, &replaced_constants));
@@ -1676,6 +1839,7 @@ Status PartitionedHashJoinNode::CodegenProcessBuildBatch(RuntimeState* state,
   DCHECK_EQ(replaced_constants.stores_duplicates, 0);
   DCHECK_EQ(replaced_constants.stores_tuples, 0);
   DCHECK_EQ(replaced_constants.quadratic_probing, 0);
+  DCHECK_EQ(replaced_constants.tag_probing, 0);
 
   Function* process_build_batch_fn_level0 =
       codegen->CloneFunction(process_build_batch_fn);
@@ -1855,7 +2019,7 @@ Status PartitionedHashJoinNode::CodegenProcessProbeBatch(
 
   // Replace hash-table parameters with constants.
   HashTableCtx::HashTableReplacedConstants replaced_constants;
-  const bool stores_duplicates = true;
+  const bool stores_duplicates = HashTableStoresDuplicates();
   const int num_build_tuples = child(1)->row_desc().tuple_descriptors().size();
   RETURN_IF_ERROR(ht_ctx_->ReplaceHashTableConstants(state, stores_duplicates,
       num_build_tuples, process_probe_batch_fn, &replaced_constants));
@@ -1864,6 +2028,7 @@ Status PartitionedHashJoinNode::CodegenProcessProbeBatch(
   DCHECK_GE(replaced_constants.stores_duplicates, 1);
   DCHECK_GE(replaced_constants.stores_tuples, 1);
   DCHECK_GE(replaced_constants.quadratic_probing, 1);
+  DCHECK_GE(replaced_constants.tag_probing, 1);
 
   Function* process_probe_batch_fn_level0 =
       codegen->CloneFunction(process_probe_batch_fn);
@@ -1926,7 +2091,7 @@ Status PartitionedHashJoinNode::CodegenInsertBatch(RuntimeState* state,
 
   // Replace hash-table parameters with constants.
   HashTableCtx::HashTableReplacedConstants replaced_constants;
-  const bool stores_duplicates = true;
+  const bool stores_duplicates = HashTableStoresDuplicates();
   const int num_build_tuples = child(1)->row_desc().tuple_descriptors().size();
   RETURN_IF_ERROR(ht_ctx_->ReplaceHashTableConstants(state, stores_duplicates,
       num_build_tuples, insert_batch_fn, &replaced_constants));
@@ -1935,6 +2100,7 @@ Status PartitionedHashJoinNode::CodegenInsertBatch(RuntimeState* state,
   DCHECK_GE(replaced_constants.stores_duplicates, 1);
   DCHECK_GE(replaced_constants.stores_tuples, 1);
   DCHECK_GE(replaced_constants.quadratic_probing, 1);
+  DCHECK_GE(replaced_constants.tag_probing, 1);
 
   Function* insert_batch_fn_level0 = codegen->CloneFunction(insert_batch_fn);
 
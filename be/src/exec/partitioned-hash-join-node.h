@@ -94,6 +94,17 @@ class PartitionedHashJoinNode : public BlockingJoinNode {
   ///      memory. Neither the build nor probe side need to be partitioned and we just
   ///      perform the join.
   ///
+  /// Radix mode:
+  /// If FLAGS_enable_radix_hash_join is set and the level 0 partitions that fit in
+  /// memory are larger than FLAGS_radix_hash_join_min_build_bytes, their hash tables
+  /// are not built in step 1. Instead, these partitions are 'deferred': like a spilled
+  /// partition, their probe rows are written to the partition's probe stream in step 2,
+  /// but both streams stay pinned in memory. Afterwards, the hash tables of the deferred
+  /// partitions are built and probed one at a time in step 3, so that the hash table
+  /// that is probed is PARTITION_FANOUT times smaller and accesses to it are more likely
+  /// to hit the CPU caches. Deferred partitions are spilled like any other in-memory
+  /// partition if memory runs out.
+  ///
   /// States:
   /// The transition goes from PARTITIONING_BUILD -> PROCESSING_PROBE ->
   ///    PROBING_SPILLED_PARTITION/REPARTITIONING.
@@ -118,24 +129,42 @@ class PartitionedHashJoinNode : public BlockingJoinNode {
     REPARTITIONING,
   };
 
-  /// Number of initial partitions to create. Must be a power of two.
+  /// Number of initial partitions to create, which is also the largest number of
+  /// partitions that a spilled partition is repartitioned into. Must be a power of two.
   /// TODO: this is set to a lower than actual value for testing.
   static const int PARTITION_FANOUT = 16;
 
   /// Needs to be the log(PARTITION_FANOUT)
   static const int NUM_PARTITIONING_BITS = 4;
 
+  /// The log of the smallest number of partitions that a spilled partition is
+  /// repartitioned into, see ComputeRepartitionBits().
+  static const int MIN_PARTITIONING_BITS = 1;
+
+  /// While repartitioning, a partition that holds more than this many times its
+  /// expected share of the build rows is considered skewed, i.e. dominated by a few
+  /// heavy-hitter keys that further repartitioning cannot split.
+  static const int SKEW_FACTOR = 4;
+
   /// Maximum number of times we will repartition. The maximum build table we
   /// can process is:
   /// MEM_LIMIT * (PARTITION_FANOUT ^ MAX_PARTITION_DEPTH). With a (low) 1GB
   /// limit and 64 fanout, we can support 256TB build tables in the case where
   /// there is no skew.
   /// In the case where there is skew, repartitioning is unlikely to help (assuming a
-  /// reasonable hash function).
+  /// reasonable hash function), so skewed partitions are kept in memory while
+  /// repartitioning if possible, see SKEW_FACTOR.
   /// Note that we need to have at least as many SEED_PRIMES in HashTableCtx.
-  /// TODO: we can revisit and try harder to explicitly detect skew.
   static const int MAX_PARTITION_DEPTH = 16;
 
+  /// Returns the number of partitioning bits to repartition a spilled partition whose
+  /// build side takes an estimated 'build_bytes' in memory: the smallest fan-out that
+  /// is expected to make each new partition fit in the memory available to this node,
+  /// after the two write buffers of each new partition. Lower fan-outs leave more
+  /// memory to the partitions, so more of them can stay in memory. Returns
+  /// NUM_PARTITIONING_BITS if no fan-out is expected to be sufficient.
+  int ComputeRepartitionBits(int64_t build_bytes) const;
+
   /// Append the row to stream. In the common case, the row is just in memory and the
   /// append succeeds. If the append fails, we fallback to the slower path of
   /// AppendRowStreamFull().
@@ -150,7 +179,9 @@ class PartitionedHashJoinNode : public BlockingJoinNode {
   bool AppendRowStreamFull(BufferedTupleStream* stream, TupleRow* row, Status* status);
 
   /// Called when we need to free up memory by spilling a partition.
-  /// This function walks hash_partitions_ and picks one to spill.
+  /// This function walks hash_partitions_ and picks one to spill, usually the largest.
+  /// While repartitioning, partitions that are skewed (see SKEW_FACTOR) whose hash
+  /// tables were not built yet are only picked if no other partition can be spilled.
   /// *spilled_partition is the partition that was spilled.
   /// Returns non-ok status if we couldn't spill a partition.
   Status SpillPartition(Partition** spilled_partition);
@@ -173,6 +204,24 @@ class PartitionedHashJoinNode : public BlockingJoinNode {
   /// structures.
   Status BuildHashTables(RuntimeState* state);
 
+  /// Returns true if the hash tables of the in-memory partitions in hash_partitions_
+  /// should be deferred, see "Radix mode" above.
+  bool ShouldDeferHashTables() const;
+
+  /// Returns true if the hash tables need to store all build rows with duplicate keys.
+  /// Left semi and anti joins without other join conjuncts only need to know if a
+  /// matching build row exists, so their hash tables only store the distinct keys and
+  /// have no duplicate chains to walk or allocate.
+  bool HashTableStoresDuplicates() const {
+    return !((join_op_ == TJoinOp::LEFT_SEMI_JOIN || join_op_ == TJoinOp::LEFT_ANTI_JOIN)
+        && other_join_conjunct_ctxs_.empty());
+  }
+
+  /// Returns the byte size of the build tuple if the hash tables can store it inline
+  /// (see HashTable::Create()), 0 otherwise. Only left semi and anti joins qualify,
+  /// since their output rows never reference the build rows in the hash table.
+  int InlineBuildTupleSize() const;
+
   /// Probes the hash table for rows matching the current probe row and appends
   /// all the matching build rows (with probe row) to output batch. Returns true
   /// if probing is done for the current probe row and should continue to next row.
@@ -254,8 +303,9 @@ class PartitionedHashJoinNode : public BlockingJoinNode {
   /// values are stored in the expression values cache in 'ht_ctx'. The number of rows
   /// processed depends on the capacity available in 'ht_ctx->expr_values_cache_'.
   /// 'prefetch_mode' specifies the prefetching mode in use. If it's not PREFETCH_NONE,
-  /// hash table buckets will be prefetched based on the hash values computed. Note
-  /// that 'prefetch_mode' will be substituted with constants during codegen time.
+  /// hash table buckets will be prefetched based on the hash values computed, followed
+  /// by a second pass over the group that prefetches the build rows in those buckets.
+  /// Note that 'prefetch_mode' will be substituted with constants during codegen time.
   void EvalAndHashProbePrefetchGroup(TPrefetchMode::type prefetch_mode,
       HashTableCtx* ctx);
 
@@ -299,7 +349,8 @@ class PartitionedHashJoinNode : public BlockingJoinNode {
 
   /// Evaluates all other_join_conjuncts against null_probe_rows_ with all the
   /// rows in build. This updates matched_null_probe_, short-circuiting if one of the
-  /// conjuncts pass (i.e. there is a match).
+  /// conjuncts pass (i.e. there is a match). Returns without reading 'build' once all
+  /// the NULL probe rows have matched.
   /// This is used for NAAJ, when there are NULL probe rows.
   Status EvaluateNullProbe(BufferedTupleStream* build);
 
@@ -311,6 +362,11 @@ class PartitionedHashJoinNode : public BlockingJoinNode {
   /// false. Used for NAAJ.
   Status OutputNullAwareNullProbe(RuntimeState* state, RowBatch* out_batch);
 
+  /// Returns true if this is a NAAJ without other join conjuncts whose build side has a
+  /// row with a NULL key. 'x NOT IN (..., NULL)' is never true, so the join returns no
+  /// rows and the probe side does not need to be read.
+  bool NullAwareJoinIsEmpty() const;
+
   /// Call at the end of consuming the probe rows. Walks hash_partitions_ and
   ///  - If this partition had a hash table, close it. This partition is fully processed
   ///    on both the build and probe sides. The streams are transferred to batch.
@@ -349,14 +405,14 @@ class PartitionedHashJoinNode : public BlockingJoinNode {
   /// Prepares for probing the next batch.
   void ResetForProbe();
 
-  /// For each filter in filters_, allocate a bloom_filter from the fragment-local
-  /// RuntimeFilterBank and store it in runtime_filters_ to populate during the build
-  /// phase. Returns false if filter construction is disabled.
+  /// For each filter in filters_, allocate a bloom_filter and, if supported, a min/max
+  /// filter from the fragment-local RuntimeFilterBank and store them in filters_ to
+  /// populate during the build phase. Returns false if filter construction is disabled.
   bool AllocateRuntimeFilters(RuntimeState* state);
 
-  /// Publish the runtime filters to the fragment-local
-  /// RuntimeFilterBank. 'total_build_rows' is used to determine whether the computed
-  /// filters have an unacceptably high false-positive rate.
+  /// Publish the runtime filters to the fragment-local RuntimeFilterBank, after fitting
+  /// their size to the NDV observed on the build side. Filters with an unacceptably high
+  /// false-positive rate are disabled. 'total_build_rows' is an upper bound of the NDV.
   void PublishRuntimeFilters(RuntimeState* state, int64_t total_build_rows);
 
   /// Codegen function to create output row. Assumes that the probe row is non-NULL.
@@ -453,6 +509,13 @@ class PartitionedHashJoinNode : public BlockingJoinNode {
   /// Number of partitions that have been spilled.
   RuntimeProfile::Counter* num_spilled_partitions_;
 
+  /// Number of partitions whose hash tables were deferred in radix mode.
+  RuntimeProfile::Counter* num_deferred_partitions_;
+
+  /// Number of partitions that were found to be skewed while repartitioning. Other
+  /// partitions are spilled before them, so that their hash tables can be built.
+  RuntimeProfile::Counter* num_skewed_partitions_;
+
   /// The largest fraction (of build side) after repartitioning. This is expected to be
   /// 1 / PARTITION_FANOUT. A value much larger indicates skew.
   RuntimeProfile::HighWaterMarkCounter* largest_partition_percent_;
@@ -469,6 +532,11 @@ class PartitionedHashJoinNode : public BlockingJoinNode {
   /// State of the partitioned hash join algorithm. Used just for debugging.
   HashJoinState state_;
 
+  /// Number of bits of the hash values that select a partition in hash_partitions_,
+  /// i.e. the log of its size. NUM_PARTITIONING_BITS for the partitions of the
+  /// children's input and chosen with ComputeRepartitionBits() when repartitioning.
+  int num_partitioning_bits_;
+
   /// Object pool that holds the Partition objects in hash_partitions_.
   boost::scoped_ptr<ObjectPool> partition_pool_;
 
@@ -529,6 +597,9 @@ class PartitionedHashJoinNode : public BlockingJoinNode {
   /// TODO: remove this. We need to be able to put these bits inside the tuple itself.
   std::vector<bool> matched_null_probe_;
 
+  /// Number of true entries in matched_null_probe_.
+  int64_t num_matched_null_probe_;
+
   /// The current index into null_probe_rows_/matched_null_probe_ that we are
   /// outputting.
   int64_t null_probe_output_idx_;
@@ -547,6 +618,7 @@ class PartitionedHashJoinNode : public BlockingJoinNode {
 
     bool ALWAYS_INLINE is_closed() const { return is_closed_; }
     bool ALWAYS_INLINE is_spilled() const { return is_spilled_; }
+    bool ALWAYS_INLINE is_deferred() const { return is_deferred_; }
 
     /// Must be called once per partition to release any resources. This should be called
     /// as soon as possible to release memory.
@@ -569,6 +641,13 @@ class PartitionedHashJoinNode : public BlockingJoinNode {
     /// it is unpinned with one buffer remaining.
     Status Spill(bool unpin_all_build);
 
+    /// Defers building the hash table of this in-memory partition until the probe side
+    /// was consumed, see "Radix mode" above. Pins the probe stream and marks the
+    /// partition as spilled, so that its probe rows are appended to the probe stream.
+    /// Sets *deferred to false if the probe stream could not be pinned, in which case
+    /// the caller should build the hash table now.
+    Status Defer(bool* deferred);
+
    private:
     friend class PartitionedHashJoinNode;
 
@@ -591,6 +670,14 @@ class PartitionedHashJoinNode : public BlockingJoinNode {
     /// True if this partition is spilled.
     bool is_spilled_;
 
+    /// True if this partition is deferred. A deferred partition is also spilled, but
+    /// its build and probe streams are pinned.
+    bool is_deferred_;
+
+    /// True if this partition was found to be skewed while it was being built by a
+    /// repartitioning, see SpillPartition().
+    bool is_skewed_;
+
     /// How many times rows in this partition have been repartitioned. Partitions created
     /// from the node's children's input is level 0, 1 after the first repartitionining,
     /// etc.
@@ -67,6 +67,23 @@ ZResultType ReadWriteUtil::ReadZInteger(uint8_t** buf, uint8_t* buf_end) {
     return ReadZIntegerSlow<MAX_LEN, ZResultType>(buf, buf_end);
   }
   // Once we get here, we don't need to worry about going off end of buffer.
+  uint64_t x = *reinterpret_cast<uint64_t*>(*buf);
+  uint64_t stop_bits = ~x & 0x8080808080808080ULL;
+  if (LIKELY(stop_bits != 0)) {
+    // The integer fits in the first eight bytes. The lowest clear continuation bit ends
+    // it. Mask off the following bytes and the continuation bits, then pack the 7-bit
+    // groups together, doubling their width at each step.
+    int num_bytes = (__builtin_ctzll(stop_bits) >> 3) + 1;
+    if (UNLIKELY(num_bytes > MAX_LEN)) return ZResultType::error();
+    if (num_bytes < 8) x &= (1ULL << (num_bytes * 8)) - 1;
+    x &= 0x7f7f7f7f7f7f7f7fULL;
+    x = (x & 0x007f007f007f007fULL) | ((x & 0x7f007f007f007f00ULL) >> 1);
+    x = (x & 0x00003fff00003fffULL) | ((x & 0x3fff00003fff0000ULL) >> 2);
+    x = (x & 0x000000000fffffffULL) | ((x & 0x0fffffff00000000ULL) >> 4);
+    *buf += num_bytes;
+    return ZResultType((x >> 1) ^ -(x & 1));
+  }
+
   int num_bytes = FindZIntegerLength(*buf);
   if (UNLIKELY(num_bytes > MAX_LEN)) return ZResultType::error();
 
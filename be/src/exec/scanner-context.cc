@@ -84,7 +84,7 @@ void ScannerContext::Stream::ReleaseCompletedResources(RowBatch* batch, bool don
   if (done) {
     // Mark any pending resources as completed
     if (io_buffer_ != NULL) {
-      ++parent_->num_completed_io_buffers_;
+      parent_->num_completed_io_buffers_.Add(1);
       completed_io_buffers_.push_back(io_buffer_);
     }
     // Set variables to NULL to make sure streams are not used again
@@ -107,7 +107,7 @@ void ScannerContext::Stream::ReleaseCompletedResources(RowBatch* batch, bool don
       parent_->scan_node_->num_owned_io_buffers_.Add(-1);
     }
   }
-  parent_->num_completed_io_buffers_ -= completed_io_buffers_.size();
+  parent_->num_completed_io_buffers_.Add(-static_cast<int>(completed_io_buffers_.size()));
   completed_io_buffers_.clear();
 
   if (contains_tuple_data_) {
@@ -135,7 +135,7 @@ Status ScannerContext::Stream::GetNextBuffer(int64_t read_past_size) {
   bool eosr = false;
   if (io_buffer_ != NULL) {
     eosr = io_buffer_->eosr();
-    ++parent_->num_completed_io_buffers_;
+    parent_->num_completed_io_buffers_.Add(1);
     completed_io_buffers_.push_back(io_buffer_);
     io_buffer_ = NULL;
   }
@@ -297,6 +297,39 @@ Status ScannerContext::Stream::GetBytesInternal(int64_t requested_len,
   return Status::OK();
 }
 
+Status ScannerContext::Stream::SkipBytesInternal(int64_t length) {
+  DCHECK_GT(length, *output_buffer_bytes_left_);
+  int64_t bytes_left = length;
+  // The bytes in the boundary buffer come before the rest of the io buffer.
+  if (boundary_buffer_bytes_left_ > 0) {
+    total_bytes_returned_ += boundary_buffer_bytes_left_;
+    bytes_left -= boundary_buffer_bytes_left_;
+    boundary_buffer_bytes_left_ = 0;
+  }
+  output_buffer_pos_ = &io_buffer_pos_;
+  output_buffer_bytes_left_ = &io_buffer_bytes_left_;
+
+  while (bytes_left > io_buffer_bytes_left_) {
+    total_bytes_returned_ += io_buffer_bytes_left_;
+    bytes_left -= io_buffer_bytes_left_;
+    io_buffer_pos_ += io_buffer_bytes_left_;
+    io_buffer_bytes_left_ = 0;
+
+    RETURN_IF_ERROR(GetNextBuffer());
+    if (UNLIKELY(parent_->cancelled())) return Status::CANCELLED;
+
+    if (io_buffer_bytes_left_ == 0) {
+      // No more bytes (i.e. EOF)
+      return ReportIncompleteRead(length, length - bytes_left);
+    }
+  }
+
+  total_bytes_returned_ += bytes_left;
+  io_buffer_pos_ += bytes_left;
+  io_buffer_bytes_left_ -= bytes_left;
+  return Status::OK();
+}
+
 bool ScannerContext::cancelled() const {
   return scan_node_->done_;
 }
@@ -19,6 +19,7 @@
 #include <boost/cstdint.hpp>
 #include <boost/scoped_ptr.hpp>
 
+#include "common/atomic.h"
 #include "common/compiler-util.h"
 #include "common/status.h"
 #include "exec/filter-context.h"
@@ -144,7 +145,8 @@ class ScannerContext {
     /// Read a zigzag encoded long
     bool ReadZLong(int64_t* val, Status*);
 
-    /// Skip over the next length bytes in the specified HDFS file.
+    /// Skip over the next length bytes in the specified HDFS file. Unlike GetBytes(), the
+    /// skipped bytes are never copied, even if they straddle io buffers.
     bool SkipBytes(int64_t length, Status*);
 
     /// Read length bytes into the supplied buffer.  The returned buffer is owned
@@ -220,6 +222,10 @@ class ScannerContext {
     Status GetBytesInternal(int64_t requested_len, uint8_t** buffer, bool peek,
                             int64_t* out_len);
 
+    /// SkipBytes helper to handle the slow path, when 'length' is more than the bytes
+    /// left in the output buffer. Moves past whole io buffers without copying them.
+    Status SkipBytesInternal(int64_t length);
+
     /// Gets (and blocks) for the next io buffer. After fetching all buffers in the scan
     /// range, performs synchronous reads past the scan range until EOF.
     //
@@ -279,7 +285,7 @@ class ScannerContext {
   /// If true, the ScanNode has been cancelled and the scanner thread should finish up
   bool cancelled() const;
 
-  int num_completed_io_buffers() const { return num_completed_io_buffers_; }
+  int num_completed_io_buffers() const { return num_completed_io_buffers_.Load(); }
   HdfsPartitionDescriptor* partition_descriptor() { return partition_desc_; }
   const std::vector<FilterContext>& filter_ctxs() const { return filter_ctxs_; }
 
@@ -295,7 +301,9 @@ class ScannerContext {
   std::vector<Stream*> streams_;
 
   /// Always equal to the sum of completed_io_buffers_.size() across all streams.
-  int num_completed_io_buffers_;
+  /// Atomic because the streams of a columnar scanner may be read by different threads,
+  /// e.g. when the Parquet scanner decodes columns in parallel.
+  AtomicInt32 num_completed_io_buffers_;
 
   /// Filter contexts for all filters applicable to this scan. Memory attached to the
   /// context is owned by the scan node.
@@ -28,6 +28,7 @@ SelectNode::SelectNode(
     ObjectPool* pool, const TPlanNode& tnode, const DescriptorTbl& descs)
     : ExecNode(pool, tnode, descs),
       child_row_batch_(NULL),
+      num_selected_rows_(0),
       child_row_idx_(0),
       child_eos_(false) {
 }
@@ -40,18 +41,23 @@ Status SelectNode::Prepare(RuntimeState* state) {
 
 Status SelectNode::Open(RuntimeState* state) {
   SCOPED_TIMER(runtime_profile_->total_time_counter());
+  SCOPED_PERF_EVENT_MEASUREMENT(perf_event_counters_);
+  SCOPED_CPU_SAMPLE_NODE(id_);
   RETURN_IF_ERROR(ExecNode::Open(state));
   RETURN_IF_ERROR(child(0)->Open(state));
   child_row_batch_.reset(
-      new RowBatch(child(0)->row_desc(), state->batch_size(), mem_tracker()));
+      new RowBatch(child(0)->row_desc(), ChildBatchCapacity(state, 0), mem_tracker()));
+  selected_rows_.resize(state->batch_size());
   return Status::OK();
 }
 
 Status SelectNode::GetNext(RuntimeState* state, RowBatch* row_batch, bool* eos) {
   SCOPED_TIMER(runtime_profile_->total_time_counter());
+  SCOPED_PERF_EVENT_MEASUREMENT(perf_event_counters_);
+  SCOPED_CPU_SAMPLE_NODE(id_);
   RETURN_IF_ERROR(ExecDebugAction(TExecNodePhase::GETNEXT, state));
 
-  if (ReachedLimit() || (child_row_idx_ == child_row_batch_->num_rows() && child_eos_)) {
+  if (ReachedLimit() || (child_row_idx_ == num_selected_rows_ && child_eos_)) {
     // we're already done or we exhausted the last child batch and there won't be any
     // new ones
     *eos = true;
@@ -64,18 +70,23 @@ Status SelectNode::GetNext(RuntimeState* state, RowBatch* row_batch, bool* eos)
   while (true) {
     RETURN_IF_CANCELLED(state);
     RETURN_IF_ERROR(QueryMaintenance(state));
-    if (child_row_idx_ == child_row_batch_->num_rows()) {
+    if (child_row_idx_ == num_selected_rows_) {
       child_row_idx_ = 0;
+      num_selected_rows_ = 0;
       // fetch next batch
       child_row_batch_->TransferResourceOwnership(row_batch);
       child_row_batch_->Reset();
       if (row_batch->AtCapacity()) return Status::OK();
       RETURN_IF_ERROR(child(0)->GetNext(state, child_row_batch_.get(), &child_eos_));
+      FilterChildBatch();
+      if (row_batch->num_rows() == 0 && PassSelectedRows(row_batch)) {
+        *eos = ReachedLimit() || child_eos_;
+        return Status::OK();
+      }
     }
 
     if (CopyRows(row_batch)) {
-      *eos = ReachedLimit()
-          || (child_row_idx_ == child_row_batch_->num_rows() && child_eos_);
+      *eos = ReachedLimit() || (child_row_idx_ == num_selected_rows_ && child_eos_);
       if (*eos) child_row_batch_->TransferResourceOwnership(row_batch);
       return Status::OK();
     }
@@ -89,31 +100,50 @@ Status SelectNode::GetNext(RuntimeState* state, RowBatch* row_batch, bool* eos)
   return Status::OK();
 }
 
-bool SelectNode::CopyRows(RowBatch* output_batch) {
-  ExprContext** conjunct_ctxs = &conjunct_ctxs_[0];
-  int num_conjunct_ctxs = conjunct_ctxs_.size();
+void SelectNode::FilterChildBatch() {
+  int num_rows = child_row_batch_->num_rows();
+  DCHECK_LE(num_rows, selected_rows_.size());
+  for (int i = 0; i < num_rows; ++i) selected_rows_[i] = i;
+  num_selected_rows_ = EvalConjunctsBatch(conjunct_ctxs_.data(), conjunct_ctxs_.size(),
+      child_row_batch_.get(), selected_rows_.data(), num_rows);
+}
 
-  while (child_row_idx_ < child_row_batch_->num_rows()) {
+bool SelectNode::PassSelectedRows(RowBatch* output_batch) {
+  DCHECK_EQ(child_row_idx_, 0);
+  if (num_selected_rows_ == 0) return false;
+  int num_rows = num_selected_rows_;
+  if (limit_ != -1) num_rows = min<int64_t>(num_rows, limit_ - num_rows_returned_);
+  if (!output_batch->AcquireSelectedRows(
+          child_row_batch_.get(), selected_rows_.data(), num_rows)) {
+    return false;
+  }
+  child_row_idx_ = num_selected_rows_;
+  num_rows_returned_ += num_rows;
+  COUNTER_SET(rows_returned_counter_, num_rows_returned_);
+  return true;
+}
+
+bool SelectNode::CopyRows(RowBatch* output_batch) {
+  while (child_row_idx_ < num_selected_rows_) {
     // Add a new row to output_batch
     int dst_row_idx = output_batch->AddRow();
     TupleRow* dst_row = output_batch->GetRow(dst_row_idx);
-    TupleRow* src_row = child_row_batch_->GetRow(child_row_idx_);
+    TupleRow* src_row = child_row_batch_->GetRow(selected_rows_[child_row_idx_]);
     // Make sure to increment row idx before returning.
     ++child_row_idx_;
 
-    if (EvalConjuncts(conjunct_ctxs, num_conjunct_ctxs, src_row)) {
-      output_batch->CopyRow(src_row, dst_row);
-      output_batch->CommitLastRow();
-      ++num_rows_returned_;
-      COUNTER_SET(rows_returned_counter_, num_rows_returned_);
-      if (ReachedLimit() || output_batch->AtCapacity()) return true;
-    }
+    output_batch->CopyRow(src_row, dst_row);
+    output_batch->CommitLastRow();
+    ++num_rows_returned_;
+    COUNTER_SET(rows_returned_counter_, num_rows_returned_);
+    if (ReachedLimit() || output_batch->AtCapacity()) return true;
   }
   return output_batch->AtCapacity();
 }
 
 Status SelectNode::Reset(RuntimeState* state) {
   child_row_batch_->Reset();
+  num_selected_rows_ = 0;
   child_row_idx_ = 0;
   child_eos_ = false;
   return ExecNode::Reset(state);
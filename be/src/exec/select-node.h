@@ -46,7 +46,12 @@ class SelectNode : public ExecNode {
   /// current row batch of child
   boost::scoped_ptr<RowBatch> child_row_batch_;
 
-  /// index of current row in child_row_batch_
+  /// Indices of the rows of child_row_batch_ that passed the conjuncts. The conjuncts
+  /// are evaluated over the whole batch when it is fetched.
+  std::vector<int> selected_rows_;
+  int num_selected_rows_;
+
+  /// index into selected_rows_ of the next row to copy
   int child_row_idx_;
 
   /// true if last GetNext() call on child signalled eos
@@ -55,6 +60,15 @@ class SelectNode : public ExecNode {
   /// END: Members that must be Reset()
   /////////////////////////////////////////
 
+  /// Evaluates the conjuncts over child_row_batch_ and sets selected_rows_.
+  void FilterChildBatch();
+
+  /// Hands the selected rows of child_row_batch_, up to limit_, to the empty
+  /// 'output_batch' together with the resources of child_row_batch_, without copying
+  /// the rows. Returns false if 'output_batch' can't take them, e.g. because it already
+  /// holds resources, in which case CopyRows() must be used.
+  bool PassSelectedRows(RowBatch* output_batch);
+
   /// Copy rows from child_row_batch_ for which conjuncts_ evaluate to true to
   /// output_batch, up to limit_.
   /// Return true if limit was hit or output_batch should be returned, otherwise false.
@@ -66,6 +66,8 @@ Status SortNode::Prepare(RuntimeState* state) {
 
 Status SortNode::Open(RuntimeState* state) {
   SCOPED_TIMER(runtime_profile_->total_time_counter());
+  SCOPED_PERF_EVENT_MEASUREMENT(perf_event_counters_);
+  SCOPED_CPU_SAMPLE_NODE(id_);
   RETURN_IF_ERROR(ExecNode::Open(state));
   RETURN_IF_ERROR(sort_exec_exprs_.Open(state));
   RETURN_IF_CANCELLED(state);
@@ -84,6 +86,8 @@ Status SortNode::Open(RuntimeState* state) {
 
 Status SortNode::GetNext(RuntimeState* state, RowBatch* row_batch, bool* eos) {
   SCOPED_TIMER(runtime_profile_->total_time_counter());
+  SCOPED_PERF_EVENT_MEASUREMENT(perf_event_counters_);
+  SCOPED_CPU_SAMPLE_NODE(id_);
   RETURN_IF_ERROR(ExecDebugAction(TExecNodePhase::GETNEXT, state));
   RETURN_IF_CANCELLED(state);
   RETURN_IF_ERROR(QueryMaintenance(state));
@@ -150,7 +154,7 @@ void SortNode::DebugString(int indentation_level, stringstream* out) const {
 }
 
 Status SortNode::SortInput(RuntimeState* state) {
-  RowBatch batch(child(0)->row_desc(), state->batch_size(), mem_tracker());
+  RowBatch batch(child(0)->row_desc(), ChildBatchCapacity(state, 0), mem_tracker());
   bool eos;
   do {
     batch.Reset();
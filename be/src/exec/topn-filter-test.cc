@@ -0,0 +1,90 @@
+// Copyright 2016 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "exec/topn-filter.h"
+
+#include <limits>
+
+#include <gtest/gtest.h>
+
+#include "common/names.h"
+
+namespace impala {
+
+TEST(TopNFilterTest, AscNullsLast) {
+  TopNFilter filter(ColumnType(TYPE_INT), true, false);
+  MinMaxFilter bound(ColumnType(TYPE_INT));
+  EXPECT_FALSE(filter.GetBound(&bound));
+  // Any value may tie with a NULL last key.
+  filter.Update(NULL);
+  EXPECT_FALSE(filter.GetBound(&bound));
+
+  int32_t key = 5;
+  filter.Update(&key);
+  ASSERT_TRUE(filter.GetBound(&bound));
+  int32_t val = 5;
+  EXPECT_TRUE(bound.Eval(&val));
+  val = numeric_limits<int32_t>::min();
+  EXPECT_TRUE(bound.Eval(&val));
+  val = 6;
+  EXPECT_FALSE(bound.Eval(&val));
+  EXPECT_FALSE(bound.Eval(NULL));
+
+  // The bound tightens.
+  key = -3;
+  filter.Update(&key);
+  MinMaxFilter tighter_bound(ColumnType(TYPE_INT));
+  ASSERT_TRUE(filter.GetBound(&tighter_bound));
+  val = 0;
+  EXPECT_FALSE(tighter_bound.Eval(&val));
+  val = -3;
+  EXPECT_TRUE(tighter_bound.Eval(&val));
+}
+
+TEST(TopNFilterTest, DescNullsFirst) {
+  TopNFilter filter(ColumnType(TYPE_BIGINT), false, true);
+  int64_t key = 100;
+  filter.Update(&key);
+  MinMaxFilter bound(ColumnType(TYPE_BIGINT));
+  ASSERT_TRUE(filter.GetBound(&bound));
+  int64_t val = numeric_limits<int64_t>::max();
+  EXPECT_TRUE(bound.Eval(&val));
+  val = 100;
+  EXPECT_TRUE(bound.Eval(&val));
+  val = 99;
+  EXPECT_FALSE(bound.Eval(&val));
+  EXPECT_TRUE(bound.Eval(NULL));
+
+  // Only NULLs may enter a heap whose last key is a NULL that sorts first.
+  filter.Update(NULL);
+  MinMaxFilter null_bound(ColumnType(TYPE_BIGINT));
+  ASSERT_TRUE(filter.GetBound(&null_bound));
+  EXPECT_TRUE(null_bound.Eval(NULL));
+  EXPECT_FALSE(null_bound.Eval(&val));
+}
+
+TEST(TopNFilterTest, SupportedTypes) {
+  EXPECT_TRUE(TopNFilter::IsSupportedType(ColumnType(TYPE_TINYINT)));
+  EXPECT_TRUE(TopNFilter::IsSupportedType(ColumnType(TYPE_BIGINT)));
+  EXPECT_FALSE(TopNFilter::IsSupportedType(ColumnType(TYPE_DOUBLE)));
+  EXPECT_FALSE(TopNFilter::IsSupportedType(ColumnType(TYPE_TIMESTAMP)));
+  EXPECT_FALSE(TopNFilter::IsSupportedType(ColumnType(TYPE_STRING)));
+}
+
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
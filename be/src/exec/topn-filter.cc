@@ -0,0 +1,101 @@
+// Copyright 2016 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "exec/topn-filter.h"
+
+#include <cstring>
+#include <limits>
+#include <boost/thread/locks.hpp>
+
+#include "common/names.h"
+
+using namespace impala;
+
+TopNFilter::TopNFilter(const ColumnType& type, bool is_asc, bool nulls_first)
+  : type_(type),
+    is_asc_(is_asc),
+    nulls_first_(nulls_first),
+    has_bound_(false),
+    has_key_(false),
+    key_slot_(0) {
+  DCHECK(IsSupportedType(type_)) << type_;
+}
+
+bool TopNFilter::IsSupportedType(const ColumnType& type) {
+  switch (type.type) {
+    case TYPE_TINYINT:
+    case TYPE_SMALLINT:
+    case TYPE_INT:
+    case TYPE_BIGINT:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Writes the smallest or the largest value of the integer 'type' into 'slot'.
+static void WriteLimit(const ColumnType& type, bool largest, void* slot) {
+  switch (type.type) {
+    case TYPE_TINYINT:
+      *reinterpret_cast<int8_t*>(slot) = largest ?
+          numeric_limits<int8_t>::max() : numeric_limits<int8_t>::min();
+      break;
+    case TYPE_SMALLINT:
+      *reinterpret_cast<int16_t*>(slot) = largest ?
+          numeric_limits<int16_t>::max() : numeric_limits<int16_t>::min();
+      break;
+    case TYPE_INT:
+      *reinterpret_cast<int32_t*>(slot) = largest ?
+          numeric_limits<int32_t>::max() : numeric_limits<int32_t>::min();
+      break;
+    case TYPE_BIGINT:
+      *reinterpret_cast<int64_t*>(slot) = largest ?
+          numeric_limits<int64_t>::max() : numeric_limits<int64_t>::min();
+      break;
+    default:
+      DCHECK(false) << "Unsupported type: " << type;
+  }
+}
+
+void TopNFilter::Update(const void* val) {
+  // If the last key is NULL and NULLs sort last, every value may still enter the heap.
+  if (val == NULL && !nulls_first_) return;
+  lock_guard<SpinLock> l(lock_);
+  has_bound_ = true;
+  has_key_ = val != NULL;
+  if (has_key_) memcpy(&key_slot_, val, type_.GetByteSize());
+}
+
+bool TopNFilter::GetBound(MinMaxFilter* bound) const {
+  DCHECK(bound->type() == type_);
+  DCHECK(!bound->has_values() && !bound->has_null());
+  int64_t key_slot;
+  bool has_key;
+  {
+    lock_guard<SpinLock> l(lock_);
+    if (!has_bound_) return false;
+    key_slot = key_slot_;
+    has_key = has_key_;
+  }
+  // NULLs that sort first tie with or precede any last key.
+  if (nulls_first_) bound->Insert(NULL);
+  if (has_key) {
+    // Keys that sort before the last key or are equal to it may still enter the heap.
+    int64_t limit_slot;
+    WriteLimit(type_, !is_asc_, &limit_slot);
+    bound->Insert(&key_slot);
+    bound->Insert(&limit_slot);
+  }
+  return true;
+}
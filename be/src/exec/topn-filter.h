@@ -0,0 +1,75 @@
+// Copyright 2016 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef IMPALA_EXEC_TOPN_FILTER_H
+#define IMPALA_EXEC_TOPN_FILTER_H
+
+#include "runtime/types.h"
+#include "util/min-max-filter.h"
+#include "util/spinlock.h"
+
+namespace impala {
+
+/// A dynamic filter on the first ordering key of a TopNNode. Once the heap of the TopN
+/// holds 'limit + offset' tuples, a row whose first key sorts strictly after the key of
+/// the last tuple in the heap can never enter the heap. The TopN publishes that key with
+/// Update() as the heap fills, and the scan below it uses GetBound() to drop such rows
+/// and to skip row groups whose statistics show that they only contain such rows.
+///
+/// The bound is returned as a MinMaxFilter of the values that may still enter the heap,
+/// so that it can be evaluated like a min/max runtime filter. Only integer types
+/// are supported (see IsSupportedType()): NaNs compare equal to every value in the
+/// TopN, so they could not be dropped for floating point keys.
+///
+/// This class is thread-safe.
+class TopNFilter {
+ public:
+  /// 'type' must be supported. 'is_asc' and 'nulls_first' describe the order of the key.
+  TopNFilter(const ColumnType& type, bool is_asc, bool nulls_first);
+
+  /// Returns true if a filter can be built for keys of 'type'.
+  static bool IsSupportedType(const ColumnType& type);
+
+  /// Tightens the bound to 'val', the first ordering key of the last tuple in a full
+  /// heap, in the slot representation of the key type. NULL represents a NULL key.
+  /// Successive keys must never sort after the previous one, which holds for the last
+  /// tuple of a heap that only replaces it with smaller tuples.
+  void Update(const void* val);
+
+  /// Returns true if a bound was published, and copies the values that may still enter
+  /// the heap into 'bound'. 'bound' must be an empty filter of the key type.
+  bool GetBound(MinMaxFilter* bound) const;
+
+  const ColumnType& type() const { return type_; }
+
+ private:
+  const ColumnType type_;
+  const bool is_asc_;
+  const bool nulls_first_;
+
+  /// Protects the members below.
+  mutable SpinLock lock_;
+
+  /// True once Update() was called with a key that excludes some values.
+  bool has_bound_;
+
+  /// True if the last key is not NULL. It is then stored in 'key_slot_', in the slot
+  /// representation of 'type_'.
+  bool has_key_;
+  int64_t key_slot_;
+};
+
+}
+
+#endif
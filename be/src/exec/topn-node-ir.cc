@@ -14,6 +14,8 @@
 
 #include "exec/topn-node.h"
 
+#include "runtime/raw-value.h"
+
 using namespace impala;
 
 void TopNNode::InsertBatch(RowBatch* batch) {
@@ -34,6 +36,12 @@ void TopNNode::InsertTupleRow(TupleRow* input_row) {
   } else {
     DCHECK(!priority_queue_->empty());
     Tuple* top_tuple = priority_queue_->top();
+    // Most rows of a large input sort after the top, and comparing the first key avoids
+    // materializing them.
+    if (first_key_src_expr_ctx_ != NULL && FirstKeyIsAfter(input_row, top_tuple)) {
+      ++num_rows_skipped_by_first_key_;
+      return;
+    }
     tmp_tuple_->MaterializeExprs<false, true>(input_row, *materialized_tuple_desc_,
         sort_exec_exprs_.sort_tuple_slot_expr_ctxs(), NULL);
     if (tuple_row_less_than_->Less(tmp_tuple_, top_tuple)) {
@@ -47,3 +55,17 @@ void TopNNode::InsertTupleRow(TupleRow* input_row) {
 
   if (insert_tuple != NULL) priority_queue_->push(insert_tuple);
 }
+
+bool TopNNode::FirstKeyIsAfter(TupleRow* input_row, Tuple* top_tuple) {
+  void* input_value = first_key_src_expr_ctx_->GetValue(input_row);
+  TupleRow* top_row = reinterpret_cast<TupleRow*>(&top_tuple);
+  void* top_value = sort_exec_exprs_.lhs_ordering_expr_ctxs()[0]->GetValue(top_row);
+  if (input_value == NULL || top_value == NULL) {
+    if (input_value == top_value) return false;
+    // The sort order of NULLs is independent of asc/desc.
+    return (input_value == NULL) != nulls_first_[0];
+  }
+  int result = RawValue::Compare(input_value, top_value,
+      first_key_src_expr_ctx_->root()->type());
+  return is_asc_order_[0] ? result > 0 : result < 0;
+}
@@ -15,9 +15,13 @@
 #include "exec/topn-node.h"
 
 #include <sstream>
+#include <gutil/strings/substitute.h>
 
 #include "codegen/llvm-codegen.h"
+#include "exec/hdfs-scan-node.h"
+#include "exec/topn-filter.h"
 #include "exprs/expr.h"
+#include "exprs/slot-ref.h"
 #include "runtime/descriptors.h"
 #include "runtime/mem-pool.h"
 #include "runtime/row-batch.h"
@@ -35,6 +39,13 @@
 using std::priority_queue;
 using namespace impala;
 using namespace llvm;
+using namespace strings;
+
+const int64_t TopNNode::TUPLE_POOL_COMPACTION_MIN_BYTES;
+
+DEFINE_bool(enable_topn_filters, true, "(Advanced) If true, a TopN over an HDFS scan "
+    "publishes its current bound on the first ordering key to the scan, which then drops "
+    "rows and Parquet row groups that cannot be in the result.");
 
 TopNNode::TopNNode(ObjectPool* pool, const TPlanNode& tnode, const DescriptorTbl& descs)
   : ExecNode(pool, tnode, descs),
@@ -44,6 +55,10 @@ TopNNode::TopNNode(ObjectPool* pool, const TPlanNode& tnode, const DescriptorTbl
     tmp_tuple_(NULL),
     tuple_pool_(NULL),
     codegend_insert_batch_fn_(NULL),
+    num_rows_skipped_by_first_key_(0),
+    first_key_src_expr_ctx_(NULL),
+    compacted_pool_bytes_(0),
+    topn_filter_(NULL),
     num_rows_skipped_(0),
     priority_queue_(NULL) {
 }
@@ -116,11 +131,65 @@ Status TopNNode::Prepare(RuntimeState* state) {
       ComparatorWrapper<TupleRowComparator> >(*tuple_row_less_than_));
   materialized_tuple_desc_ = row_descriptor_.tuple_descriptors()[0];
   insert_batch_timer_ = ADD_TIMER(runtime_profile(), "InsertBatchTime");
+  rows_skipped_by_first_key_counter_ =
+      ADD_COUNTER(runtime_profile(), "RowsSkippedByFirstKey", TUnit::UNIT);
+  num_pool_compactions_counter_ =
+      ADD_COUNTER(runtime_profile(), "TuplePoolCompactions", TUnit::UNIT);
+  InitFirstKeySrcExpr();
+  InitTopNFilter(state);
   return Status::OK();
 }
 
+void TopNNode::InitFirstKeySrcExpr() {
+  // The ordering exprs reference the materialized tuple. Find the expr that materializes
+  // the first key from the input row.
+  Expr* key_expr = sort_exec_exprs_.lhs_ordering_expr_ctxs()[0]->root();
+  if (!key_expr->is_slotref()) return;
+  SlotId key_slot_id = static_cast<SlotRef*>(key_expr)->slot_id();
+  const vector<SlotDescriptor*>& slots = materialized_tuple_desc_->slots();
+  const vector<ExprContext*>& slot_expr_ctxs =
+      sort_exec_exprs_.sort_tuple_slot_expr_ctxs();
+  DCHECK_EQ(slots.size(), slot_expr_ctxs.size());
+  for (int i = 0; i < slots.size(); ++i) {
+    if (slots[i]->id() == key_slot_id) first_key_src_expr_ctx_ = slot_expr_ctxs[i];
+  }
+}
+
+void TopNNode::InitTopNFilter(RuntimeState* state) {
+  if (!FLAGS_enable_topn_filters || IsInSubplan() || limit_ + offset_ <= 0) return;
+  if (child(0)->type() != TPlanNodeType::HDFS_SCAN_NODE) return;
+  HdfsScanNode* scan_node = static_cast<HdfsScanNode*>(child(0));
+  // Dropping rows would change which rows a limit on the scan returns.
+  if (scan_node->limit() != -1) return;
+
+  // The first key must be a column of the scan.
+  if (first_key_src_expr_ctx_ == NULL) return;
+  Expr* src_expr = first_key_src_expr_ctx_->root();
+  if (!src_expr->is_slotref()) return;
+  const SlotDescriptor* scan_slot =
+      state->desc_tbl().GetSlotDescriptor(static_cast<SlotRef*>(src_expr)->slot_id());
+  if (scan_slot == NULL || scan_slot->parent() != scan_node->tuple_desc()) return;
+  if (!TopNFilter::IsSupportedType(scan_slot->type())) return;
+
+  topn_filter_ = pool_->Add(
+      new TopNFilter(scan_slot->type(), is_asc_order_[0], nulls_first_[0]));
+  scan_node->AddTopNFilter(scan_slot, topn_filter_);
+  runtime_profile()->AddInfoString("TopN filter", Substitute("published to node $0",
+      scan_node->id()));
+}
+
+void TopNNode::UpdateTopNFilter() {
+  DCHECK(topn_filter_ != NULL);
+  if (priority_queue_->size() < limit_ + offset_) return;
+  Tuple* top_tuple = priority_queue_->top();
+  TupleRow* top_row = reinterpret_cast<TupleRow*>(&top_tuple);
+  topn_filter_->Update(sort_exec_exprs_.lhs_ordering_expr_ctxs()[0]->GetValue(top_row));
+}
+
 Status TopNNode::Open(RuntimeState* state) {
   SCOPED_TIMER(runtime_profile_->total_time_counter());
+  SCOPED_PERF_EVENT_MEASUREMENT(perf_event_counters_);
+  SCOPED_CPU_SAMPLE_NODE(id_);
   RETURN_IF_ERROR(ExecNode::Open(state));
   RETURN_IF_CANCELLED(state);
   RETURN_IF_ERROR(QueryMaintenance(state));
@@ -134,7 +203,7 @@ Status TopNNode::Open(RuntimeState* state) {
 
   // Limit of 0, no need to fetch anything from children.
   if (limit_ != 0) {
-    RowBatch batch(child(0)->row_desc(), state->batch_size(), mem_tracker());
+    RowBatch batch(child(0)->row_desc(), ChildBatchCapacity(state, 0), mem_tracker());
     bool eos;
     do {
       batch.Reset();
@@ -147,6 +216,12 @@ Status TopNNode::Open(RuntimeState* state) {
           InsertBatch(&batch);
         }
       }
+      COUNTER_SET(rows_skipped_by_first_key_counter_, num_rows_skipped_by_first_key_);
+      if (topn_filter_ != NULL) UpdateTopNFilter();
+      if (tuple_pool_->total_allocated_bytes() >
+          max(2 * compacted_pool_bytes_, TUPLE_POOL_COMPACTION_MIN_BYTES)) {
+        CompactTuplePool();
+      }
       RETURN_IF_CANCELLED(state);
       RETURN_IF_ERROR(QueryMaintenance(state));
     } while (!eos);
@@ -162,6 +237,8 @@ Status TopNNode::Open(RuntimeState* state) {
 
 Status TopNNode::GetNext(RuntimeState* state, RowBatch* row_batch, bool* eos) {
   SCOPED_TIMER(runtime_profile_->total_time_counter());
+  SCOPED_PERF_EVENT_MEASUREMENT(perf_event_counters_);
+  SCOPED_CPU_SAMPLE_NODE(id_);
   RETURN_IF_ERROR(ExecDebugAction(TExecNodePhase::GETNEXT, state));
   RETURN_IF_CANCELLED(state);
   RETURN_IF_ERROR(QueryMaintenance(state));
@@ -206,6 +283,29 @@ void TopNNode::Close(RuntimeState* state) {
   ExecNode::Close(state);
 }
 
+void TopNNode::CompactTuplePool() {
+  // Replacing the top tuple copies the var-len data of the new tuple into 'tuple_pool_'
+  // without freeing the old data. Copy the live tuples into a new pool, and move its
+  // chunks back into 'tuple_pool_', whose address is baked into the codegen'd
+  // InsertBatch().
+  MemPool compacted_pool(mem_tracker());
+  vector<Tuple*> tuples;
+  tuples.reserve(priority_queue_->size());
+  while (!priority_queue_->empty()) {
+    tuples.push_back(
+        priority_queue_->top()->DeepCopy(*materialized_tuple_desc_, &compacted_pool));
+    priority_queue_->pop();
+  }
+  Tuple* tmp_tuple = reinterpret_cast<Tuple*>(
+      compacted_pool.Allocate(materialized_tuple_desc_->byte_size()));
+  tuple_pool_->FreeAll();
+  tuple_pool_->AcquireData(&compacted_pool, false);
+  tmp_tuple_ = tmp_tuple;
+  for (int i = 0; i < tuples.size(); ++i) priority_queue_->push(tuples[i]);
+  compacted_pool_bytes_ = tuple_pool_->total_allocated_bytes();
+  COUNTER_ADD(num_pool_compactions_counter_, 1);
+}
+
 // Reverse the order of the tuples in the priority queue
 void TopNNode::PrepareForOutput() {
   sorted_top_n_.resize(priority_queue_->size());
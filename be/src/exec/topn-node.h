@@ -29,13 +29,27 @@ namespace impala {
 
 class MemPool;
 class RuntimeState;
+class TopNFilter;
 class Tuple;
 
 /// Node for in-memory TopN (ORDER BY ... LIMIT)
 /// This handles the case where the result fits in memory.
 /// This node will materialize its input rows into a new tuple using the expressions
 /// in sort_tuple_slot_exprs_ in its sort_exec_exprs_ member.
-/// TopN is implemented by storing rows in a priority queue.
+/// TopN is implemented by storing rows in a priority queue. Once the queue is full, input
+/// rows whose first ordering key sorts after the one of the top of the queue are skipped
+/// before they are materialized, and the memory of replaced tuples is reclaimed by
+/// periodically compacting tuple_pool_.
+///
+/// If the child is an HdfsScanNode and the first ordering expr is an integer column of
+/// the scanned tuple, the node publishes the first ordering key of the last tuple of
+/// the full priority queue to the scan as a TopNFilter after each input batch. The
+/// scan can then drop rows and row groups that could not enter the queue anyway.
+///
+/// TODO: a partitioned variant for ROW_NUMBER() OVER (PARTITION BY .. ORDER BY ..) <= k
+/// that keeps one bounded queue per partition key in a HashTable and spills partitions
+/// to BufferedTupleStreams, instead of fully sorting the input for AnalyticEvalNode.
+/// This needs a new plan node type and the planner rewrite that produces it.
 class TopNNode : public ExecNode {
  public:
   TopNNode(ObjectPool* pool, const TPlanNode& tnode, const DescriptorTbl& descs);
@@ -64,9 +78,29 @@ class TopNNode : public ExecNode {
   /// copy of tuple_row, which it stores in tuple_pool_.
   void IR_ALWAYS_INLINE InsertTupleRow(TupleRow* tuple_row);
 
+  /// Returns true if the first ordering key of 'input_row' sorts strictly after the one
+  /// of 'top_tuple', i.e. 'input_row' can be skipped without materializing it. Requires
+  /// 'first_key_src_expr_ctx_'.
+  bool IR_ALWAYS_INLINE FirstKeyIsAfter(TupleRow* input_row, Tuple* top_tuple);
+
+  /// Sets 'first_key_src_expr_ctx_'. Called in Prepare().
+  void InitFirstKeySrcExpr();
+
+  /// Copies the tuples of 'priority_queue_' into fresh memory of 'tuple_pool_' and frees
+  /// the rest of its memory, i.e. the var-len data of replaced tuples.
+  void CompactTuplePool();
+
   /// Flatten and reverse the priority queue.
   void PrepareForOutput();
 
+  /// Creates 'topn_filter_' and registers it with the child if the child is a scan that
+  /// can apply it to the first ordering key. Called in Prepare().
+  void InitTopNFilter(RuntimeState* state);
+
+  /// Publishes the first ordering key of the top of 'priority_queue_' to 'topn_filter_'
+  /// if the queue is full.
+  void UpdateTopNFilter();
+
   /// Number of rows to skip.
   int64_t offset_;
 
@@ -102,6 +136,29 @@ class TopNNode : public ExecNode {
   /// Timer for time spent in InsertBatch() function (or codegen'd version)
   RuntimeProfile::Counter* insert_batch_timer_;
 
+  /// Number of input rows that were skipped by FirstKeyIsAfter() once the queue was full.
+  RuntimeProfile::Counter* rows_skipped_by_first_key_counter_;
+  int64_t num_rows_skipped_by_first_key_;
+
+  /// Number of CompactTuplePool() calls.
+  RuntimeProfile::Counter* num_pool_compactions_counter_;
+
+  /// The expr of sort_exec_exprs_.sort_tuple_slot_expr_ctxs() that materializes the first
+  /// ordering key from the input row, or NULL if the first ordering expr is not a slot of
+  /// the materialized tuple.
+  ExprContext* first_key_src_expr_ctx_;
+
+  /// Don't compact 'tuple_pool_' before it reaches this size.
+  static const int64_t TUPLE_POOL_COMPACTION_MIN_BYTES = 8 * 1024 * 1024;
+
+  /// The size of 'tuple_pool_' after the last compaction. The pool is compacted again
+  /// once it has grown to twice this size.
+  int64_t compacted_pool_bytes_;
+
+  /// Filter on the first ordering key that is applied by the child scan, or NULL if the
+  /// child cannot apply it. Owned by 'pool_'.
+  TopNFilter* topn_filter_;
+
   /////////////////////////////////////////
   /// BEGIN: Members that must be Reset()
 
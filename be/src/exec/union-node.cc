@@ -15,6 +15,7 @@
 #include "exec/union-node.h"
 #include "exprs/expr.h"
 #include "exprs/expr-context.h"
+#include "exprs/slot-ref.h"
 #include "runtime/row-batch.h"
 #include "runtime/runtime-state.h"
 #include "runtime/raw-value.h"
@@ -78,12 +79,37 @@ Status UnionNode::Prepare(RuntimeState* state) {
         result_expr_ctx_lists_[i], state, child(i)->row_desc(), expr_mem_tracker()));
     AddExprCtxsToFree(result_expr_ctx_lists_[i]);
     DCHECK_EQ(result_expr_ctx_lists_[i].size(), tuple_desc_->slots().size());
+    passthrough_children_.push_back(IsChildPassThrough(i));
   }
   return Status::OK();
 }
 
+bool UnionNode::IsChildPassThrough(int child_idx) const {
+  const RowDescriptor& child_row_desc = child(child_idx)->row_desc();
+  if (child_row_desc.tuple_descriptors().size() != 1) return false;
+  if (child_row_desc.TupleIsNullable(0)) return false;
+  const TupleDescriptor* child_tuple_desc = child_row_desc.tuple_descriptors()[0];
+  if (child_tuple_desc->byte_size() != tuple_desc_->byte_size()) return false;
+  const vector<ExprContext*>& ctxs = result_expr_ctx_lists_[child_idx];
+  for (int i = 0; i < ctxs.size(); ++i) {
+    if (!ctxs[i]->root()->is_slotref()) return false;
+    const SlotRef* slot_ref = static_cast<const SlotRef*>(ctxs[i]->root());
+    const SlotDescriptor* slot_desc = tuple_desc_->slots()[i];
+    if (slot_ref->type() != slot_desc->type()) return false;
+    if (slot_ref->slot_offset() != slot_desc->tuple_offset()) return false;
+    const NullIndicatorOffset& null_offset = slot_ref->null_indicator_offset();
+    if (null_offset.byte_offset != slot_desc->null_indicator_offset().byte_offset ||
+        null_offset.bit_mask != slot_desc->null_indicator_offset().bit_mask) {
+      return false;
+    }
+  }
+  return true;
+}
+
 Status UnionNode::Open(RuntimeState* state) {
   SCOPED_TIMER(runtime_profile_->total_time_counter());
+  SCOPED_PERF_EVENT_MEASUREMENT(perf_event_counters_);
+  SCOPED_CPU_SAMPLE_NODE(id_);
   RETURN_IF_ERROR(ExecNode::Open(state));
   // Open const expr lists.
   for (int i = 0; i < const_result_expr_ctx_lists_.size(); ++i) {
@@ -104,7 +130,8 @@ Status UnionNode::Open(RuntimeState* state) {
 Status UnionNode::OpenCurrentChild(RuntimeState* state) {
   DCHECK_LT(child_idx_, children_.size());
   child_row_batch_.reset(new RowBatch(
-      child(child_idx_)->row_desc(), state->batch_size(), mem_tracker()));
+      child(child_idx_)->row_desc(), ChildBatchCapacity(state, child_idx_),
+      mem_tracker()));
   // Open child and fetch the first row batch.
   RETURN_IF_ERROR(child(child_idx_)->Open(state));
   RETURN_IF_ERROR(child(child_idx_)->GetNext(state, child_row_batch_.get(),
@@ -115,30 +142,54 @@ Status UnionNode::OpenCurrentChild(RuntimeState* state) {
 
 Status UnionNode::GetNext(RuntimeState* state, RowBatch* row_batch, bool* eos) {
   SCOPED_TIMER(runtime_profile_->total_time_counter());
+  SCOPED_PERF_EVENT_MEASUREMENT(perf_event_counters_);
+  SCOPED_CPU_SAMPLE_NODE(id_);
   RETURN_IF_ERROR(ExecDebugAction(TExecNodePhase::GETNEXT, state));
   RETURN_IF_CANCELLED(state);
   RETURN_IF_ERROR(QueryMaintenance(state));
-  // Create new tuple buffer for row_batch.
-  int64_t tuple_buffer_size;
-  uint8_t* tuple_buffer;
-  RETURN_IF_ERROR(
-      row_batch->ResizeAndAllocateTupleBuffer(state, &tuple_buffer_size, &tuple_buffer));
-  Tuple* tuple = reinterpret_cast<Tuple*>(tuple_buffer);
-  tuple->Init(tuple_buffer_size);
+  // The tuple buffer of row_batch is only allocated once rows are materialized. A batch
+  // holds either forwarded or materialized rows, so that the buffer can be sized for
+  // the whole batch.
+  Tuple* tuple = NULL;
 
   // Fetch from children, evaluate corresponding exprs and materialize.
   while (child_idx_ < children_.size()) {
     // Row batch was either never set or we're moving on to a different child.
     if (child_row_batch_.get() == NULL) RETURN_IF_ERROR(OpenCurrentChild(state));
+    bool passthrough = passthrough_children_[child_idx_];
 
     // Start (or continue) consuming row batches from current child.
     while (true) {
       RETURN_IF_CANCELLED(state);
       RETURN_IF_ERROR(QueryMaintenance(state));
 
-      // Continue materializing exprs on child_row_batch_ into row batch.
-      RETURN_IF_ERROR(EvalAndMaterializeExprs(result_expr_ctx_lists_[child_idx_], false,
-          &tuple, row_batch));
+      int num_child_rows = child_row_batch_->num_rows() - child_row_idx_;
+      bool forward = passthrough && num_child_rows <= row_batch->capacity();
+      if (num_child_rows > 0 && row_batch->num_rows() > 0 &&
+          (forward || tuple == NULL)) {
+        // Forwarded rows need an empty batch and materialized rows a tuple buffer that
+        // is allocated in an empty batch. Return the rows collected so far first.
+        *eos = false;
+        return Status::OK();
+      }
+      if (forward) {
+        ForwardChildRows(row_batch);
+      } else {
+        // Continue materializing exprs on child_row_batch_ into row batch.
+        if (tuple == NULL && num_child_rows > 0) {
+          RETURN_IF_ERROR(AllocateTupleBuffer(state, row_batch, &tuple));
+        }
+        RETURN_IF_ERROR(EvalAndMaterializeExprs(result_expr_ctx_lists_[child_idx_],
+            false, &tuple, row_batch));
+      }
+      if (passthrough && child_row_idx_ >= child_row_batch_->num_rows()) {
+        // Forwarded rows may reference memory of this child batch or of earlier ones
+        // from the same child, so the memory is handed on with the rows.
+        child_row_batch_->TransferResourceOwnership(row_batch);
+        child_row_idx_ = 0;
+      } else if (passthrough && ReachedLimit()) {
+        child_row_batch_->TransferResourceOwnership(row_batch);
+      }
       if (row_batch->AtCapacity() || ReachedLimit()) {
         *eos = ReachedLimit();
         return Status::OK();
@@ -169,6 +220,13 @@ Status UnionNode::GetNext(RuntimeState* state, RowBatch* row_batch, bool* eos) {
   while (const_result_expr_idx_ < const_result_expr_ctx_lists_.size()) {
     // Only evaluate the const expr lists by the first fragment instance.
     if (state->fragment_ctx().fragment_instance_idx == 0) {
+      if (tuple == NULL) {
+        if (row_batch->num_rows() > 0) {
+          *eos = false;
+          return Status::OK();
+        }
+        RETURN_IF_ERROR(AllocateTupleBuffer(state, row_batch, &tuple));
+      }
       // Materialize expr results into row_batch.
       RETURN_IF_ERROR(EvalAndMaterializeExprs(
           const_result_expr_ctx_lists_[const_result_expr_idx_], true, &tuple,
@@ -204,6 +262,39 @@ void UnionNode::Close(RuntimeState* state) {
   ExecNode::Close(state);
 }
 
+Status UnionNode::AllocateTupleBuffer(RuntimeState* state, RowBatch* row_batch,
+    Tuple** tuple) {
+  DCHECK_EQ(row_batch->num_rows(), 0);
+  int64_t tuple_buffer_size;
+  uint8_t* tuple_buffer;
+  RETURN_IF_ERROR(
+      row_batch->ResizeAndAllocateTupleBuffer(state, &tuple_buffer_size, &tuple_buffer));
+  *tuple = reinterpret_cast<Tuple*>(tuple_buffer);
+  (*tuple)->Init(tuple_buffer_size);
+  return Status::OK();
+}
+
+void UnionNode::ForwardChildRows(RowBatch* row_batch) {
+  DCHECK_LE(child_row_batch_->num_rows() - child_row_idx_,
+      row_batch->capacity() - row_batch->num_rows());
+  ExprContext* const* conjunct_ctxs = &conjunct_ctxs_[0];
+  int num_conjunct_ctxs = conjunct_ctxs_.size();
+  for (; child_row_idx_ < child_row_batch_->num_rows(); ++child_row_idx_) {
+    if (ReachedLimit()) break;
+    TupleRow* child_row = child_row_batch_->GetRow(child_row_idx_);
+    int row_idx = row_batch->AddRow();
+    TupleRow* row = row_batch->GetRow(row_idx);
+    row->SetTuple(0, child_row->GetTuple(0));
+    if (EvalConjuncts(conjunct_ctxs, num_conjunct_ctxs, row)) {
+      row_batch->CommitLastRow();
+      ++num_rows_returned_;
+    }
+  }
+  // The rows left after the limit are never returned.
+  child_row_idx_ = child_row_batch_->num_rows();
+  COUNTER_SET(rows_returned_counter_, num_rows_returned_);
+}
+
 Status UnionNode::EvalAndMaterializeExprs(const vector<ExprContext*>& ctxs,
     bool const_exprs, Tuple** tuple, RowBatch* row_batch) {
   // Make sure there are rows left in the batch.
@@ -32,6 +32,11 @@ class TupleRow;
 /// evaluated expressions into row batches. The UnionNode pulls row batches from its
 /// children sequentially, i.e., it exhausts one child completely before moving
 /// on to the next one.
+/// A child is passed through if its result exprs are SlotRefs that read each slot of
+/// the union tuple from the same offset of a child tuple with the same layout, e.g. in
+/// a UNION ALL of identical tables. Its rows are then forwarded by pointing the output
+/// rows at the child tuples, and the resources of its batches are transferred to the
+/// output batches instead of copying the rows.
 class UnionNode : public ExecNode {
  public:
   UnionNode(ObjectPool* pool, const TPlanNode& tnode, const DescriptorTbl& descs);
@@ -56,6 +61,10 @@ class UnionNode : public ExecNode {
   /// Exprs materialized by this node. The i-th result expr list refers to the i-th child.
   std::vector<std::vector<ExprContext*> > result_expr_ctx_lists_;
 
+  /// True for the children whose tuples are forwarded instead of materialized. Set in
+  /// Prepare().
+  std::vector<bool> passthrough_children_;
+
   /////////////////////////////////////////
   /// BEGIN: Members that must be Reset()
 
@@ -82,6 +91,21 @@ class UnionNode : public ExecNode {
   /// and sets child_row_idx_ to 0. May set child_eos_.
   Status OpenCurrentChild(RuntimeState* state);
 
+  /// Returns true if the tuples of the child at 'child_idx' can be used as tuples of
+  /// this node, i.e. its single non-nullable tuple has the layout of tuple_desc_ and its
+  /// result exprs are SlotRefs to the slots at the same offsets. The result exprs must
+  /// be prepared.
+  bool IsChildPassThrough(int child_idx) const;
+
+  /// Adds the rows of child_row_batch_ starting from child_row_idx_ that pass the
+  /// conjuncts to 'row_batch' with the child tuples as their tuples, until the limit is
+  /// reached. 'row_batch' must have room for all rows left in child_row_batch_.
+  void ForwardChildRows(RowBatch* row_batch);
+
+  /// Allocates the tuple buffer of 'row_batch' that the rows materialized in it are
+  /// written to and sets '*tuple' to its first tuple.
+  Status AllocateTupleBuffer(RuntimeState* state, RowBatch* row_batch, Tuple** tuple);
+
   /// Evaluates exprs on all rows in child_row_batch_ starting from child_row_idx_,
   /// and materializes their results into *tuple.
   /// Adds *tuple into row_batch, and increments *tuple.
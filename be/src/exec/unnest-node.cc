@@ -87,6 +87,8 @@ Status UnnestNode::Prepare(RuntimeState* state) {
 
 Status UnnestNode::Open(RuntimeState* state) {
   SCOPED_TIMER(runtime_profile_->total_time_counter());
+  SCOPED_PERF_EVENT_MEASUREMENT(perf_event_counters_);
+  SCOPED_CPU_SAMPLE_NODE(id_);
   RETURN_IF_ERROR(ExecNode::Open(state));
   RETURN_IF_ERROR(coll_expr_ctx_->Open(state));
 
@@ -105,24 +107,23 @@ Status UnnestNode::Open(RuntimeState* state) {
     DCHECK_EQ(coll_value_->num_tuples, 0);
   }
 
+  // The counters are only updated in Close(), since Open() is called for every input
+  // row of the containing subplan.
   ++num_collections_;
-  COUNTER_SET(num_collections_counter_, num_collections_);
   total_collection_size_ += coll_value_->num_tuples;
-  COUNTER_SET(avg_collection_size_counter_,
-      static_cast<double>(total_collection_size_) / num_collections_);
   if (max_collection_size_ == -1 || coll_value_->num_tuples > max_collection_size_) {
     max_collection_size_ = coll_value_->num_tuples;
-    COUNTER_SET(max_collection_size_counter_, max_collection_size_);
   }
   if (min_collection_size_ == -1 || coll_value_->num_tuples < min_collection_size_) {
     min_collection_size_ = coll_value_->num_tuples;
-    COUNTER_SET(min_collection_size_counter_, min_collection_size_);
   }
   return Status::OK();
 }
 
 Status UnnestNode::GetNext(RuntimeState* state, RowBatch* row_batch, bool* eos) {
   SCOPED_TIMER(runtime_profile_->total_time_counter());
+  SCOPED_PERF_EVENT_MEASUREMENT(perf_event_counters_);
+  SCOPED_CPU_SAMPLE_NODE(id_);
   // Avoid expensive query maintenance overhead for small collections.
   if (item_idx_ > 0) {
     RETURN_IF_CANCELLED(state);
@@ -169,6 +170,13 @@ void UnnestNode::Close(RuntimeState* state) {
   if (is_closed()) return;
   DCHECK(coll_expr_ctx_ != NULL);
   coll_expr_ctx_->Close(state);
+  if (num_collections_ > 0) {
+    COUNTER_SET(num_collections_counter_, num_collections_);
+    COUNTER_SET(avg_collection_size_counter_,
+        static_cast<double>(total_collection_size_) / num_collections_);
+    COUNTER_SET(max_collection_size_counter_, max_collection_size_);
+    COUNTER_SET(min_collection_size_counter_, min_collection_size_);
+  }
   ExecNode::Close(state);
 }
 
@@ -100,6 +100,23 @@ TEST(ZigzagTest, Basic) {
   }
 }
 
+// Values followed by more data are decoded without bounds checks on every byte.
+TEST(ZigzagTest, PaddedBuffer) {
+  uint8_t buf[ReadWriteUtil::MAX_ZLONG_LEN * 2];
+  int32_t value = 0xa2a2a2a2;
+  for (int i = 0; i < 1000; ++i) {
+    value = HashUtil::Hash(&value, sizeof(value), i);
+    // Cover every encoded length, with set continuation bits after the value.
+    int64_t v = ((static_cast<int64_t>(value) << 32) | value) >> (i % 64);
+    memset(buf, 0xff, sizeof(buf));
+    int len = ReadWriteUtil::PutZLong(v, buf);
+    TestZLong(buf, sizeof(buf), v, len);
+    memset(buf, 0xff, sizeof(buf));
+    len = ReadWriteUtil::PutZInt(static_cast<int32_t>(v), buf);
+    TestZInt(buf, sizeof(buf), static_cast<int32_t>(v), len);
+  }
+}
+
 TEST(ZigzagTest, Errors) {
   uint8_t buf[100];
   memset(buf, 0x80, sizeof(buf));
@@ -14,6 +14,7 @@
 
 #include "exprs/aggregate-functions.h"
 
+#include <emmintrin.h>
 #include <math.h>
 #include <algorithm>
 #include <map>
@@ -480,16 +481,23 @@ IR_ALWAYS_INLINE void AggregateFunctions::SumDecimalAddOrSubtract(FunctionContex
     const DecimalVal& src, DecimalVal* dst, bool subtract) {
   if (src.is_null) return;
   if (dst->is_null) InitZero<DecimalVal>(ctx, dst);
-  int precision = Expr::GetConstantInt(*ctx, Expr::ARG_TYPE_PRECISION, 0);
   // Since the src and dst are guaranteed to be the same scale, we can just
-  // do a simple add.
+  // do a simple add. The sum is kept in 128 bits, so summing 4 or 8 byte values can't
+  // overflow. Switch on the byte size rather than the precision: a precision of 19 is
+  // already stored in 16 bytes.
   int m = subtract ? -1 : 1;
-  if (precision <= 9) {
-    dst->val16 += m * src.val4;
-  } else if (precision <= 19) {
-    dst->val16 += m * src.val8;
-  } else {
-    dst->val16 += m * src.val16;
+  switch (Expr::GetConstantInt(*ctx, Expr::ARG_TYPE_SIZE, 0)) {
+    case 4:
+      dst->val16 += m * src.val4;
+      break;
+    case 8:
+      dst->val16 += m * src.val8;
+      break;
+    case 16:
+      dst->val16 += m * src.val16;
+      break;
+    default:
+      DCHECK(false) << "Invalid byte size";
   }
 }
 
@@ -1159,8 +1167,13 @@ void AggregateFunctions::HllMerge(FunctionContext* ctx, const StringVal& src,
   DCHECK(!src.is_null);
   DCHECK_EQ(dst->len, HLL_LEN);
   DCHECK_EQ(src.len, HLL_LEN);
-  for (int i = 0; i < src.len; ++i) {
-    dst->ptr[i] = ::max(dst->ptr[i], src.ptr[i]);
+  // Take the byte-wise max of 16 registers at a time. SSE2 is always available on
+  // x86-64, so this does not need a fallback for older CPUs.
+  DCHECK_EQ(HLL_LEN % sizeof(__m128i), 0);
+  for (int i = 0; i < src.len; i += sizeof(__m128i)) {
+    __m128i* dst_regs = reinterpret_cast<__m128i*>(dst->ptr + i);
+    __m128i src_regs = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src.ptr + i));
+    _mm_storeu_si128(dst_regs, _mm_max_epu8(_mm_loadu_si128(dst_regs), src_regs));
   }
 }
 
@@ -1185,7 +1198,8 @@ uint64_t AggregateFunctions::HllFinalEstimate(const uint8_t* buckets,
   int num_zero_registers = 0;
   // TODO: Consider improving this loop (e.g. replacing 'if' with arithmetic op).
   for (int i = 0; i < num_buckets; ++i) {
-    harmonic_mean += powf(2.0f, -buckets[i]);
+    // Same as powf(2.0f, -buckets[i]) but only adjusts the exponent.
+    harmonic_mean += ldexpf(1.0f, -buckets[i]);
     if (buckets[i] == 0) ++num_zero_registers;
   }
   harmonic_mean = 1.0f / harmonic_mean;
@@ -1305,6 +1319,200 @@ DoubleVal AggregateFunctions::KnuthStddevPopFinalize(FunctionContext* ctx,
   return sqrt(ComputeKnuthVariance(*state, true));
 }
 
+// The compression parameter of the t-digest, which bounds the number of centroids.
+static const int TDIGEST_COMPRESSION = 100;
+
+// Number of values that are collected by TDigestUpdate() before they are merged into
+// the centroids.
+static const int TDIGEST_BUFFER_SIZE = 256;
+
+// The k1 scale function bounds the number of centroids by TDIGEST_COMPRESSION + 1, the
+// extra space absorbs rounding errors.
+static const int TDIGEST_MAX_CENTROIDS = 2 * TDIGEST_COMPRESSION;
+
+struct TDigestCentroid {
+  double mean;
+  double weight;
+
+  bool operator<(const TDigestCentroid& other) const { return mean < other.mean; }
+};
+
+// Intermediate state of APPX_PERCENTILE(). The centroids are sorted by their means.
+struct TDigestState {
+  // The quantile to compute, or -1 if no value was added yet.
+  double quantile;
+  double min;
+  double max;
+  int32_t num_centroids;
+  int32_t num_buffered;
+  TDigestCentroid centroids[TDIGEST_MAX_CENTROIDS];
+  double buffered[TDIGEST_BUFFER_SIZE];
+};
+
+// The k1 scale function of the t-digest paper. Adjacent values can be merged into a
+// centroid as long as the centroid spans at most 1 on this scale, which keeps the
+// centroids near q = 0 and q = 1 small.
+static inline double TDigestScale(double q) {
+  return TDIGEST_COMPRESSION / (2 * M_PI) * asin(2 * q - 1);
+}
+
+// Merges the buffered values of 'state' and, if not NULL, the centroids and buffered
+// values of 'other' into the centroids of 'state'.
+static void TDigestCompress(TDigestState* state, const TDigestState* other) {
+  TDigestCentroid input[2 * (TDIGEST_MAX_CENTROIDS + TDIGEST_BUFFER_SIZE)];
+  int num_input = 0;
+  const TDigestState* sources[] = { state, other };
+  for (int i = 0; i < 2; ++i) {
+    const TDigestState* source = sources[i];
+    if (source == NULL) continue;
+    memcpy(&input[num_input], source->centroids,
+        source->num_centroids * sizeof(TDigestCentroid));
+    num_input += source->num_centroids;
+    for (int j = 0; j < source->num_buffered; ++j) {
+      input[num_input].mean = source->buffered[j];
+      input[num_input].weight = 1;
+      ++num_input;
+    }
+  }
+  if (other != NULL && other->num_centroids + other->num_buffered > 0) {
+    if (state->num_centroids + state->num_buffered == 0) {
+      state->min = other->min;
+      state->max = other->max;
+    } else {
+      state->min = ::min(state->min, other->min);
+      state->max = ::max(state->max, other->max);
+    }
+  }
+  state->num_buffered = 0;
+  state->num_centroids = 0;
+  if (num_input == 0) return;
+
+  sort(input, input + num_input);
+  double total_weight = 0;
+  for (int i = 0; i < num_input; ++i) total_weight += input[i].weight;
+
+  TDigestCentroid* result = state->centroids;
+  result[0] = input[0];
+  int num_result = 1;
+  // Weight of the centroids before the last one in 'result'.
+  double weight_so_far = 0;
+  double k_left = TDigestScale(0);
+  for (int i = 1; i < num_input; ++i) {
+    TDigestCentroid* last = &result[num_result - 1];
+    double merged_weight = last->weight + input[i].weight;
+    double k_right = TDigestScale(::min((weight_so_far + merged_weight) / total_weight,
+        1.0));
+    if (k_right - k_left <= 1) {
+      last->mean += (input[i].mean - last->mean) * input[i].weight / merged_weight;
+      last->weight = merged_weight;
+    } else {
+      weight_so_far += last->weight;
+      k_left = TDigestScale(::min(weight_so_far / total_weight, 1.0));
+      DCHECK_LT(num_result, TDIGEST_MAX_CENTROIDS);
+      result[num_result++] = input[i];
+    }
+  }
+  state->num_centroids = num_result;
+}
+
+// Returns the estimate of 'state->quantile'. The weight of each centroid is assumed to
+// be centered on its mean, the estimate is interpolated between the centers of the
+// adjacent centroids, or between the outermost centers and the min or max value.
+static double TDigestQuantile(const TDigestState& state) {
+  DCHECK_EQ(state.num_buffered, 0);
+  DCHECK_GT(state.num_centroids, 0);
+  double total_weight = 0;
+  for (int i = 0; i < state.num_centroids; ++i) {
+    total_weight += state.centroids[i].weight;
+  }
+  double target = state.quantile * total_weight;
+  double prev_pos = 0;
+  double prev_value = state.min;
+  double pos = 0;
+  for (int i = 0; i < state.num_centroids; ++i) {
+    const TDigestCentroid& c = state.centroids[i];
+    double center = pos + c.weight / 2;
+    if (target < center) {
+      return prev_value + (c.mean - prev_value) * (target - prev_pos) / (center - prev_pos);
+    }
+    prev_pos = center;
+    prev_value = c.mean;
+    pos += c.weight;
+  }
+  if (total_weight <= prev_pos) return state.max;
+  return prev_value +
+      (state.max - prev_value) * (target - prev_pos) / (total_weight - prev_pos);
+}
+
+void AggregateFunctions::TDigestInit(FunctionContext* ctx, StringVal* dst) {
+  AllocBuffer(ctx, dst, sizeof(TDigestState));
+  if (UNLIKELY(dst->is_null)) return;
+  TDigestState* state = reinterpret_cast<TDigestState*>(dst->ptr);
+  state->quantile = -1;
+}
+
+template <typename T>
+void AggregateFunctions::TDigestUpdate(FunctionContext* ctx, const T& src,
+    const DoubleVal& quantile, StringVal* dst) {
+  if (src.is_null) return;
+  DCHECK(!dst->is_null);
+  DCHECK_EQ(dst->len, sizeof(TDigestState));
+  TDigestState* state = reinterpret_cast<TDigestState*>(dst->ptr);
+  if (UNLIKELY(state->quantile < 0)) {
+    if (quantile.is_null || !(quantile.val >= 0 && quantile.val <= 1)) {
+      ctx->SetError("APPX_PERCENTILE() requires a quantile between 0 and 1.");
+      return;
+    }
+    state->quantile = quantile.val;
+  }
+  double val = static_cast<double>(src.val);
+  if (UNLIKELY(std::isnan(val))) return;
+  if (state->num_centroids + state->num_buffered == 0) {
+    state->min = val;
+    state->max = val;
+  } else {
+    state->min = ::min(state->min, val);
+    state->max = ::max(state->max, val);
+  }
+  state->buffered[state->num_buffered++] = val;
+  if (state->num_buffered == TDIGEST_BUFFER_SIZE) TDigestCompress(state, NULL);
+}
+
+void AggregateFunctions::TDigestMerge(FunctionContext* ctx, const StringVal& src,
+    StringVal* dst) {
+  DCHECK(!dst->is_null);
+  DCHECK(!src.is_null);
+  DCHECK_EQ(dst->len, sizeof(TDigestState));
+  DCHECK_EQ(src.len, sizeof(TDigestState));
+  const TDigestState* src_state = reinterpret_cast<const TDigestState*>(src.ptr);
+  TDigestState* dst_state = reinterpret_cast<TDigestState*>(dst->ptr);
+  if (dst_state->quantile < 0) dst_state->quantile = src_state->quantile;
+  TDigestCompress(dst_state, src_state);
+}
+
+const StringVal AggregateFunctions::TDigestSerialize(FunctionContext* ctx,
+    const StringVal& src) {
+  if (UNLIKELY(src.is_null)) return src;
+  StringVal result = StringVal::CopyFrom(ctx, src.ptr, src.len);
+  ctx->Free(src.ptr);
+  if (UNLIKELY(result.is_null)) return result;
+  // Merging is cheaper if the buffered values are already part of the centroids.
+  TDigestCompress(reinterpret_cast<TDigestState*>(result.ptr), NULL);
+  return result;
+}
+
+DoubleVal AggregateFunctions::AppxPercentileFinalize(FunctionContext* ctx,
+    const StringVal& src) {
+  if (UNLIKELY(src.is_null)) return DoubleVal::null();
+  DCHECK_EQ(src.len, sizeof(TDigestState));
+  TDigestState* state = reinterpret_cast<TDigestState*>(src.ptr);
+  TDigestCompress(state, NULL);
+  DoubleVal result = state->num_centroids == 0 ?
+      DoubleVal::null() : DoubleVal(TDigestQuantile(*state));
+  ctx->Free(src.ptr);
+  return result;
+}
+
 struct RankState {
   int64_t rank;
   int64_t count;
@@ -1753,6 +1961,19 @@ template void AggregateFunctions::KnuthVarUpdate(
 template void AggregateFunctions::KnuthVarUpdate(
     FunctionContext*, const DoubleVal&, StringVal*);
 
+template void AggregateFunctions::TDigestUpdate(
+    FunctionContext*, const TinyIntVal&, const DoubleVal&, StringVal*);
+template void AggregateFunctions::TDigestUpdate(
+    FunctionContext*, const SmallIntVal&, const DoubleVal&, StringVal*);
+template void AggregateFunctions::TDigestUpdate(
+    FunctionContext*, const IntVal&, const DoubleVal&, StringVal*);
+template void AggregateFunctions::TDigestUpdate(
+    FunctionContext*, const BigIntVal&, const DoubleVal&, StringVal*);
+template void AggregateFunctions::TDigestUpdate(
+    FunctionContext*, const FloatVal&, const DoubleVal&, StringVal*);
+template void AggregateFunctions::TDigestUpdate(
+    FunctionContext*, const DoubleVal&, const DoubleVal&, StringVal*);
+
 template void AggregateFunctions::LastValUpdate<BooleanVal>(
     FunctionContext*, const BooleanVal& src, BooleanVal* dst);
 template void AggregateFunctions::LastValUpdate<TinyIntVal>(
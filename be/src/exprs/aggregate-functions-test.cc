@@ -162,6 +162,49 @@ TEST(HistogramTest, TestString) {
   EXPECT_TRUE(test.Execute(input, StringVal(&expected[0]))) << test.GetErrorMsg();
 }
 
+// Accepts results that differ from the expected quantile of 0..99999 by less than 0.5%.
+bool CheckAppxPercentile(const DoubleVal& actual, const DoubleVal& expected) {
+  return !actual.is_null && fabs(actual.val - expected.val) < 500;
+}
+
+TEST(AppxPercentileTest, TestInt) {
+  UdaTestHarness2<DoubleVal, StringVal, IntVal, DoubleVal> test(
+      AggregateFunctions::TDigestInit,
+      AggregateFunctions::TDigestUpdate<IntVal>,
+      AggregateFunctions::TDigestMerge,
+      AggregateFunctions::TDigestSerialize,
+      AggregateFunctions::AppxPercentileFinalize);
+
+  // Small inputs are not compressed and the result is exact.
+  vector<IntVal> input;
+  for (int i = 1; i <= 5; ++i) input.push_back(IntVal(i));
+  EXPECT_TRUE(test.Execute(input, vector<DoubleVal>(5, DoubleVal(0.5)), DoubleVal(3)))
+      << test.GetErrorMsg();
+  EXPECT_TRUE(test.Execute(input, vector<DoubleVal>(5, DoubleVal(0)), DoubleVal(1)))
+      << test.GetErrorMsg();
+  EXPECT_TRUE(test.Execute(input, vector<DoubleVal>(5, DoubleVal(1)), DoubleVal(5)))
+      << test.GetErrorMsg();
+
+  // All values are NULL.
+  vector<IntVal> null_input(5, IntVal::null());
+  EXPECT_TRUE(test.Execute(null_input, vector<DoubleVal>(5, DoubleVal(0.5)),
+      DoubleVal::null())) << test.GetErrorMsg();
+
+  const int INPUT_SIZE = 100000;
+  input.clear();
+  for (int i = 0; i < INPUT_SIZE; ++i) input.push_back(IntVal((i * 7919) % INPUT_SIZE));
+  test.SetResultComparator(CheckAppxPercentile);
+  double quantiles[] = { 0.01, 0.25, 0.5, 0.9, 0.999 };
+  for (double q: quantiles) {
+    EXPECT_TRUE(test.Execute(input, vector<DoubleVal>(INPUT_SIZE, DoubleVal(q)),
+        DoubleVal(q * (INPUT_SIZE - 1)))) << "q=" << q << ": " << test.GetErrorMsg();
+  }
+
+  // The quantile must be in [0, 1].
+  EXPECT_FALSE(test.Execute(input, vector<DoubleVal>(INPUT_SIZE, DoubleVal(1.5)),
+      DoubleVal::null()));
+}
+
 int main(int argc, char** argv) {
   ::testing::InitGoogleTest(&argc, argv);
   InitCommonRuntime(argc, argv, false, TestInfo::BE_TEST);
@@ -202,6 +202,22 @@ class AggregateFunctions {
   /// Calculates the biased STDDEV, uses KnuthVar Init-Update-Merge functions
   static DoubleVal KnuthStddevPopFinalize(FunctionContext* context, const StringVal& val);
 
+  /// APPX_PERCENTILE(col, q) returns an approximation of the q-th quantile of the
+  /// values of 'col', computed with a merging t-digest. The digest keeps at most about
+  /// 100 centroids whose sizes shrink towards the tails of the
+  /// distribution, so extreme quantiles are more accurate than the median. Unlike
+  /// APPX_MEDIAN(), its intermediate state is a fixed-size buffer that is merged
+  /// without loss of accuracy across the pre-aggregation and the merge aggregation.
+  /// See: Dunning, Ertl - Computing Extremely Accurate Quantiles Using t-Digests (2019)
+  /// 'q' must be a constant in [0, 1].
+  static void TDigestInit(FunctionContext*, StringVal* slot);
+  template <typename T>
+  static void TDigestUpdate(FunctionContext*, const T& src, const DoubleVal& quantile,
+      StringVal* dst);
+  static void TDigestMerge(FunctionContext*, const StringVal& src, StringVal* dst);
+  static const StringVal TDigestSerialize(FunctionContext*, const StringVal& src);
+  static DoubleVal AppxPercentileFinalize(FunctionContext*, const StringVal& src);
+
 
   /// ----------------------------- Analytic Functions ---------------------------------
   /// Analytic functions implement the UDA interface (except Merge(), Serialize()) and are
@@ -0,0 +1,75 @@
+// Copyright 2016 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include "exprs/compiled-regex.h"
+
+#include "common/names.h"
+
+namespace impala {
+
+static string RequiredLiteral(const string& pattern) {
+  re2::RE2::Options options;
+  return CompiledRegex::GetRequiredLiteral(pattern, options);
+}
+
+TEST(CompiledRegexTest, RequiredLiteral) {
+  EXPECT_EQ(RequiredLiteral("abc"), "abc");
+  EXPECT_EQ(RequiredLiteral(".*abc.*"), "abc");
+  EXPECT_EQ(RequiredLiteral("^GET /[a-z]+\\.html 404$"), ".html 404");
+  // Repeated characters may be missing, except for '+'.
+  EXPECT_EQ(RequiredLiteral("abcd*e"), "abc");
+  EXPECT_EQ(RequiredLiteral("abcd?e"), "abc");
+  EXPECT_EQ(RequiredLiteral("abcd{0,2}e"), "abc");
+  EXPECT_EQ(RequiredLiteral("abc+d"), "abc");
+  EXPECT_EQ(RequiredLiteral("abc*?d"), "ab");
+  // Multi-byte UTF-8 characters are repeated as a whole.
+  EXPECT_EQ(RequiredLiteral("ab\xc3\xa9*"), "ab");
+  // Groups, classes and escape sequences end the literal.
+  EXPECT_EQ(RequiredLiteral("ab(cde)f"), "ab");
+  EXPECT_EQ(RequiredLiteral("[]ab]cd"), "cd");
+  EXPECT_EQ(RequiredLiteral("[[:alpha:]]bc"), "bc");
+  EXPECT_EQ(RequiredLiteral("a\\d+bc"), "bc");
+  EXPECT_EQ(RequiredLiteral("\\x41bc"), "bc");
+  EXPECT_EQ(RequiredLiteral("a\\.b"), "a.b");
+  // Alternations, flags and case-insensitive regexes are not handled.
+  EXPECT_EQ(RequiredLiteral("abc|def"), "");
+  EXPECT_EQ(RequiredLiteral("(ab|cd)efg"), "");
+  EXPECT_EQ(RequiredLiteral("(?i)abc"), "");
+  re2::RE2::Options options;
+  options.set_case_sensitive(false);
+  EXPECT_EQ(CompiledRegex::GetRequiredLiteral("abc", options), "");
+}
+
+TEST(CompiledRegexTest, MayMatch) {
+  re2::RE2::Options options;
+  shared_ptr<const CompiledRegex> regex = CompiledRegex::Create("a+bcd[0-9]", options);
+  ASSERT_TRUE(regex->re().ok());
+  EXPECT_TRUE(regex->MayMatch("xxabcd5", 7));
+  EXPECT_TRUE(regex->MayMatch("xxabcdx", 7));
+  EXPECT_FALSE(regex->MayMatch("xxabc", 5));
+  // The same pattern and options share the compiled regex.
+  EXPECT_EQ(CompiledRegex::Create("a+bcd[0-9]", options).get(), regex.get());
+  options.set_longest_match(true);
+  EXPECT_NE(CompiledRegex::Create("a+bcd[0-9]", options).get(), regex.get());
+  EXPECT_FALSE(CompiledRegex::Create("a(b", options)->re().ok());
+}
+
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,220 @@
+// Copyright 2016 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "exprs/compiled-regex.h"
+
+#include <ctype.h>
+#include <sstream>
+#include <gflags/gflags.h>
+
+#include "util/lru-cache.inline.h"
+
+#include "common/names.h"
+
+DEFINE_int64(regex_cache_capacity, 16L * 1024L * 1024L, "(Advanced) Approximate "
+    "number of bytes of compiled regular expressions that are cached and shared by all "
+    "queries. A value <= 0 disables the cache.");
+
+using namespace impala;
+
+// Rough number of bytes per instruction of a compiled RE2 program. The DFA states that
+// RE2 builds while matching are bounded by RE2::Options::max_mem and not charged.
+static const int64_t BYTES_PER_PROGRAM_INST = 16;
+
+CompiledRegex::CompiledRegex(const string& pattern, const re2::RE2::Options& options)
+  : re_(pattern, options),
+    literal_(GetRequiredLiteral(pattern, options)),
+    literal_sv_(literal_),
+    literal_search_(&literal_sv_) {
+}
+
+shared_ptr<const CompiledRegex> CompiledRegex::Create(const string& pattern,
+    const re2::RE2::Options& options) {
+  RegexCache* cache = regex_cache();
+  string key;
+  shared_ptr<const CompiledRegex> regex;
+  if (cache != NULL) {
+    key = GetCacheKey(pattern, options);
+    if (cache->Get(key, &regex)) return regex;
+  }
+  regex.reset(new CompiledRegex(pattern, options));
+  if (cache != NULL && regex->re().ok()) {
+    int64_t charge = 2 * key.size() + regex->literal_.size() +
+        regex->re().ProgramSize() * BYTES_PER_PROGRAM_INST;
+    cache->Put(key, regex, charge);
+  }
+  return regex;
+}
+
+CompiledRegex::RegexCache* CompiledRegex::regex_cache() {
+  if (FLAGS_regex_cache_capacity <= 0) return NULL;
+  static RegexCache cache(FLAGS_regex_cache_capacity);
+  return &cache;
+}
+
+string CompiledRegex::GetCacheKey(const string& pattern,
+    const re2::RE2::Options& options) {
+  stringstream key;
+  key << options.encoding() << options.posix_syntax() << options.longest_match()
+      << options.literal() << options.never_nl() << options.dot_nl()
+      << options.case_sensitive() << options.perl_classes() << options.word_boundary()
+      << options.one_line() << " " << options.max_mem() << " " << pattern;
+  return key.str();
+}
+
+// Removes the last character from 'run'. Continuation bytes of a UTF-8 character are
+// removed together with their lead byte.
+static void RemoveLastChar(string* run) {
+  while (!run->empty() && ((*run)[run->size() - 1] & 0xC0) == 0x80) {
+    run->resize(run->size() - 1);
+  }
+  if (!run->empty()) run->resize(run->size() - 1);
+}
+
+// Ends the run of literal characters 'run' and keeps it in 'best' if it is longer.
+static void EndRun(string* run, string* best) {
+  if (run->size() > best->size()) *best = *run;
+  run->clear();
+}
+
+// Returns the index of the character after the repetition '{n}', '{n,}' or '{n,m}'
+// that starts at 'i', or -1 if there is none and the '{' is a literal.
+static int SkipRepetition(const string& pattern, int i) {
+  DCHECK_EQ(pattern[i], '{');
+  int j = i + 1;
+  if (j == pattern.size() || !isdigit(pattern[j])) return -1;
+  while (j < pattern.size() && isdigit(pattern[j])) ++j;
+  if (j < pattern.size() && pattern[j] == ',') {
+    ++j;
+    while (j < pattern.size() && isdigit(pattern[j])) ++j;
+  }
+  if (j == pattern.size() || pattern[j] != '}') return -1;
+  return j + 1;
+}
+
+string CompiledRegex::GetRequiredLiteral(const string& pattern,
+    const re2::RE2::Options& options) {
+  if (options.literal()) return options.case_sensitive() ? pattern : "";
+  if (!options.case_sensitive()) return "";
+
+  // The literal characters outside of groups and character classes that follow each
+  // other form a run, and every run is part of every match as long as the pattern has
+  // no alternation.
+  string best;
+  string run;
+  int depth = 0;
+  int i = 0;
+  int n = pattern.size();
+  while (i < n) {
+    char c = pattern[i];
+    if (c == '|') return "";
+    if (c == '[') {
+      // Skip the character class, which may contain ']' as its first character and
+      // POSIX classes like '[:alpha:]'.
+      int j = i + 1;
+      if (j < n && pattern[j] == '^') ++j;
+      if (j < n && pattern[j] == ']') ++j;
+      while (j < n && pattern[j] != ']') {
+        if (pattern[j] == '\\') {
+          ++j;
+        } else if (pattern[j] == '[' && j + 1 < n && pattern[j + 1] == ':') {
+          size_t end = pattern.find(":]", j + 2);
+          if (end == string::npos) return "";
+          j = end + 1;
+        }
+        ++j;
+      }
+      if (j >= n) return "";
+      i = j + 1;
+      EndRun(&run, &best);
+      continue;
+    }
+    if (c == '(') {
+      // Flags like '(?i)' change the meaning of the rest of the pattern.
+      if (i + 1 < n && pattern[i + 1] == '?' &&
+          (i + 2 >= n || (pattern[i + 2] != ':' && pattern[i + 2] != 'P'))) {
+        return "";
+      }
+      ++depth;
+      ++i;
+      EndRun(&run, &best);
+      continue;
+    }
+    if (c == ')') {
+      --depth;
+      ++i;
+      EndRun(&run, &best);
+      continue;
+    }
+    if (depth > 0) {
+      i += c == '\\' ? 2 : 1;
+      continue;
+    }
+    if (c == '*' || c == '?' || c == '+' || c == '{') {
+      int next = i + 1;
+      if (c == '{') {
+        next = SkipRepetition(pattern, i);
+        if (next == -1) {
+          // A literal '{'. Don't bother adding it to the run.
+          EndRun(&run, &best);
+          ++i;
+          continue;
+        }
+      }
+      // The repeated character is still required after '+', but the run ends there.
+      if (c != '+') RemoveLastChar(&run);
+      EndRun(&run, &best);
+      // Skip the non-greedy modifier.
+      if (next < n && pattern[next] == '?') ++next;
+      i = next;
+      continue;
+    }
+    if (c == '.' || c == '^' || c == '$') {
+      EndRun(&run, &best);
+      ++i;
+      continue;
+    }
+    if (c == '\\') {
+      if (i + 1 == n) return "";
+      char escaped = pattern[i + 1];
+      if (!isalnum(escaped)) {
+        // An escaped punctuation character is a literal.
+        run.push_back(escaped);
+        i += 2;
+        continue;
+      }
+      // Escape sequences like '\d', '\b', '\x41' or '\p{Greek}' are not parsed further,
+      // but the whole sequence has to be skipped.
+      if (escaped == 'Q') return "";
+      EndRun(&run, &best);
+      i += 2;
+      if (escaped == 'x' || escaped == 'p' || escaped == 'P') {
+        if (i < n && pattern[i] == '{') {
+          size_t end = pattern.find('}', i);
+          if (end == string::npos) return "";
+          i = end + 1;
+        } else {
+          i += escaped == 'x' ? 2 : 1;
+        }
+      } else if (isdigit(escaped)) {
+        while (i < n && isdigit(pattern[i])) ++i;
+      }
+      continue;
+    }
+    run.push_back(c);
+    ++i;
+  }
+  EndRun(&run, &best);
+  return best;
+}
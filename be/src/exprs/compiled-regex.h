@@ -0,0 +1,84 @@
+// Copyright 2016 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef IMPALA_EXPRS_COMPILED_REGEX_H
+#define IMPALA_EXPRS_COMPILED_REGEX_H
+
+#include <string>
+#include <boost/shared_ptr.hpp>
+#include <re2/re2.h>
+
+#include "gutil/macros.h"
+#include "runtime/string-search.h"
+#include "runtime/string-value.h"
+#include "util/lru-cache.h"
+
+namespace impala {
+
+/// A compiled RE2 regular expression together with a literal string that every match
+/// of the regex contains. Searching for the literal is much cheaper than running the
+/// regex, so MayMatch() is used to skip the regex for strings that can't match.
+///
+/// Compiled regexes are immutable and RE2 can be used by several threads at the same
+/// time, so they are shared by all fragment instances through a process-wide cache.
+class CompiledRegex {
+ public:
+  /// Returns the compiled regex for 'pattern' and 'options', from the cache if it is
+  /// enabled (see --regex_cache_capacity). The caller must check re().ok(). Regexes that
+  /// failed to compile are not cached.
+  static boost::shared_ptr<const CompiledRegex> Create(const std::string& pattern,
+      const re2::RE2::Options& options);
+
+  const re2::RE2& re() const { return re_; }
+
+  /// Returns false if the string 'ptr' of length 'len' can't contain a match of the
+  /// regex.
+  bool MayMatch(const char* ptr, int len) const {
+    if (literal_.empty()) return true;
+    StringValue str(const_cast<char*>(ptr), len);
+    return literal_search_.Search(&str) != -1;
+  }
+
+  /// Returns the longest literal string that every match of 'pattern' contains, or an
+  /// empty string if none was found. The pattern is only parsed as far as needed to
+  /// prove that the literal is required, so complicated patterns (e.g. with alternations
+  /// or flags) return an empty string.
+  static std::string GetRequiredLiteral(const std::string& pattern,
+      const re2::RE2::Options& options);
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(CompiledRegex);
+
+  typedef LruCache<std::string, boost::shared_ptr<const CompiledRegex> > RegexCache;
+
+  CompiledRegex(const std::string& pattern, const re2::RE2::Options& options);
+
+  /// Returns the process-wide cache, or NULL if it is disabled.
+  static RegexCache* regex_cache();
+
+  /// Returns the cache key for 'pattern' and all options that affect matching.
+  static std::string GetCacheKey(const std::string& pattern,
+      const re2::RE2::Options& options);
+
+  const re2::RE2 re_;
+
+  /// The literal returned by GetRequiredLiteral() and a searcher for it.
+  const std::string literal_;
+  const StringValue literal_sv_;
+  const StringSearch literal_search_;
+};
+
+}
+
+#endif
@@ -12,6 +12,7 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
 #include <sstream>
 
 #include "exprs/compound-predicates.h"
@@ -37,6 +38,16 @@ BooleanVal AndPredicate::GetBooleanVal(ExprContext* context, const TupleRow* row
   return BooleanVal(true);
 }
 
+int AndPredicate::FilterBatch(ExprContext* context, RowBatch* batch, int* sel,
+    int num_sel) {
+  DCHECK_EQ(children_.size(), 2);
+  // Like the short-circuit above, the right child is only evaluated for the rows that
+  // passed the left child.
+  num_sel = children_[0]->FilterBatch(context, batch, sel, num_sel);
+  if (num_sel == 0) return 0;
+  return children_[1]->FilterBatch(context, batch, sel, num_sel);
+}
+
 string AndPredicate::DebugString() const {
   stringstream out;
   out << "AndPredicate(" << Expr::DebugString() << ")";
@@ -56,6 +67,32 @@ BooleanVal OrPredicate::GetBooleanVal(ExprContext* context, const TupleRow* row)
   return BooleanVal(false);
 }
 
+int OrPredicate::FilterBatch(ExprContext* context, RowBatch* batch, int* sel,
+    int num_sel) {
+  DCHECK_EQ(children_.size(), 2);
+  if (num_sel == 0) return 0;
+  vector<int> left_sel(sel, sel + num_sel);
+  int num_left = children_[0]->FilterBatch(context, batch, &left_sel[0], num_sel);
+  if (num_left == num_sel) return num_sel;
+
+  // Both lists are in ascending order, so the rows that didn't pass the left child can
+  // be collected in one pass. Only those are evaluated by the right child.
+  vector<int> right_sel;
+  right_sel.reserve(num_sel - num_left);
+  for (int i = 0, j = 0; i < num_sel; ++i) {
+    if (j < num_left && left_sel[j] == sel[i]) {
+      ++j;
+    } else {
+      right_sel.push_back(sel[i]);
+    }
+  }
+  int num_right =
+      children_[1]->FilterBatch(context, batch, &right_sel[0], right_sel.size());
+  merge(left_sel.begin(), left_sel.begin() + num_left, right_sel.begin(),
+      right_sel.begin() + num_right, sel);
+  return num_left + num_right;
+}
+
 string OrPredicate::DebugString() const {
   stringstream out;
   out << "OrPredicate(" << Expr::DebugString() << ")";
@@ -39,6 +39,9 @@ class AndPredicate: public CompoundPredicate {
  public:
   virtual impala_udf::BooleanVal GetBooleanVal(ExprContext* context, const TupleRow*);
 
+  /// Filters the selected rows by the left and then by the right child.
+  virtual int FilterBatch(ExprContext* context, RowBatch* batch, int* sel, int num_sel);
+
   virtual Status GetCodegendComputeFn(RuntimeState* state, llvm::Function** fn) {
     return CompoundPredicate::CodegenComputeFn(true, state, fn);
   }
@@ -58,6 +61,10 @@ class OrPredicate: public CompoundPredicate {
  public:
   virtual impala_udf::BooleanVal GetBooleanVal(ExprContext* context, const TupleRow*);
 
+  /// Filters the selected rows by the left child and the rows that didn't pass it by
+  /// the right child, then merges both.
+  virtual int FilterBatch(ExprContext* context, RowBatch* batch, int* sel, int num_sel);
+
   virtual Status GetCodegendComputeFn(RuntimeState* state, llvm::Function** fn) {
     return CompoundPredicate::CodegenComputeFn(false, state, fn);
   }
@@ -342,6 +342,9 @@ void ExprContext::PrintValue(const TupleRow* row, stringstream* stream) {
 BooleanVal ExprContext::GetBooleanVal(TupleRow* row) {
   return root_->GetBooleanVal(this, row);
 }
+int ExprContext::FilterBatch(RowBatch* batch, int* sel, int num_sel) {
+  return root_->FilterBatch(this, batch, sel, num_sel);
+}
 TinyIntVal ExprContext::GetTinyIntVal(TupleRow* row) {
   return root_->GetTinyIntVal(this, row);
 }
@@ -30,6 +30,7 @@ class Expr;
 class MemPool;
 class MemTracker;
 class RuntimeState;
+class RowBatch;
 class RowDescriptor;
 class TColumnValue;
 class TupleRow;
@@ -123,6 +124,9 @@ class ExprContext {
   TimestampVal GetTimestampVal(TupleRow* row);
   DecimalVal GetDecimalVal(TupleRow* row);
 
+  /// Calls FilterBatch() on root_. See Expr::FilterBatch().
+  int FilterBatch(RowBatch* batch, int* sel, int num_sel);
+
   /// Returns true if any of the expression contexts in the array has local allocations.
   /// The last two are helper functions.
   static bool HasLocalAllocations(const std::vector<ExprContext*>& ctxs);
@@ -1597,6 +1597,15 @@ TEST_F(ExprTest, LikePredicate) {
   TestValue("'prefix1234' LIKE 'prefix%'", TYPE_BOOLEAN, true);
   TestValue("'1234suffix' LIKE '%suffix'", TYPE_BOOLEAN, true);
   TestValue("'1234substr5678' LIKE '%substr%'", TYPE_BOOLEAN, true);
+  // Multiple constant substrings must be found in order and without overlapping.
+  TestValue("'abcde' LIKE '%ab%de%'", TYPE_BOOLEAN, true);
+  TestValue("'abcde' LIKE '%%b%%d%%'", TYPE_BOOLEAN, true);
+  TestValue("'abcde' LIKE '%de%ab%'", TYPE_BOOLEAN, false);
+  TestValue("'abcde' LIKE '%abc%cde%'", TYPE_BOOLEAN, false);
+  TestValue("'abcabc' LIKE '%abc%abc%'", TYPE_BOOLEAN, true);
+  TestValue("'GET /index.html HTTP/1.1 404' LIKE '%GET%html%404%'", TYPE_BOOLEAN, true);
+  TestValue("'GET /index.html HTTP/1.1 200' LIKE '%GET%html%404%'", TYPE_BOOLEAN,
+      false);
   TestValue("'a%a' LIKE 'a\\%a'", TYPE_BOOLEAN, true);
   TestValue("'a123a' LIKE 'a\\%a'", TYPE_BOOLEAN, false);
   TestValue("'a_a' LIKE 'a\\_a'", TYPE_BOOLEAN, true);
@@ -1889,6 +1898,10 @@ TEST_F(ExprTest, StringFunctions) {
   TestStringValue("lower('HELLO')", "hello");
   TestStringValue("lower('Hello')", "hello");
   TestStringValue("lower('hello!')", "hello!");
+  // Longer than 16 bytes so that the SSE loop runs, with a change only in the tail.
+  TestStringValue("lower('all lower case, then UPPER')", "all lower case, then upper");
+  TestStringValue("lower('MIXED Case @[`{ STRING OF BYTES')",
+      "mixed case @[`{ string of bytes");
   TestStringValue("lcase('HELLO')", "hello");
   TestIsNull("lower(NULL)", TYPE_STRING);
   TestIsNull("lcase(NULL)", TYPE_STRING);
@@ -1897,6 +1910,9 @@ TEST_F(ExprTest, StringFunctions) {
   TestStringValue("upper('HELLO')", "HELLO");
   TestStringValue("upper('Hello')", "HELLO");
   TestStringValue("upper('hello!')", "HELLO!");
+  TestStringValue("upper('ALL UPPER CASE, THEN lower')", "ALL UPPER CASE, THEN LOWER");
+  TestStringValue("upper('mixed Case @[`{ string of bytes')",
+      "MIXED CASE @[`{ STRING OF BYTES");
   // Regression test for fully builtin qualified function name (IMPALA-1951)
   TestStringValue("_impala_builtins.upper('hello!')", "HELLO!");
   TestStringValue("_impala_builtins.DECODE('hello!', 'hello!', 'HELLO!')", "HELLO!");
@@ -1967,6 +1983,8 @@ TEST_F(ExprTest, StringFunctions) {
   TestStringValue("trim('abcdefg   ')", "abcdefg");
   TestStringValue("trim('   abcdefg')", "abcdefg");
   TestStringValue("trim('abc  defg')", "abc  defg");
+  TestStringValue("trim('                  abc  defg                    ')", "abc  defg");
+  TestStringValue("trim('                                   ')", "");
   TestIsNull("trim(NULL)", TYPE_STRING);
   TestStringValue("ltrim('')", "");
   TestStringValue("ltrim('      ')", "");
@@ -1974,6 +1992,7 @@ TEST_F(ExprTest, StringFunctions) {
   TestStringValue("ltrim('abcdefg   ')", "abcdefg   ");
   TestStringValue("ltrim('   abcdefg')", "abcdefg");
   TestStringValue("ltrim('abc  defg')", "abc  defg");
+  TestStringValue("ltrim('                      abcdefg   ')", "abcdefg   ");
   TestIsNull("ltrim(NULL)", TYPE_STRING);
   TestStringValue("rtrim('')", "");
   TestStringValue("rtrim('      ')", "");
@@ -1981,6 +2000,8 @@ TEST_F(ExprTest, StringFunctions) {
   TestStringValue("rtrim('abcdefg   ')", "abcdefg");
   TestStringValue("rtrim('   abcdefg')", "   abcdefg");
   TestStringValue("rtrim('abc  defg')", "abc  defg");
+  TestStringValue("rtrim('   abcdefg                       ')", "   abcdefg");
+  TestStringValue("rtrim('abcdefghijklmnopq                ')", "abcdefghijklmnopq");
   TestIsNull("rtrim(NULL)", TYPE_STRING);
 
   TestStringValue("btrim('     abcdefg   ')", "abcdefg");
@@ -2064,6 +2085,12 @@ TEST_F(ExprTest, StringFunctions) {
   TestValue("instr('abc', 'abc')", TYPE_INT, 1);
   TestValue("instr('xyzabc', 'abc')", TYPE_INT, 4);
   TestValue("instr('xyzabcxyz', 'bcx')", TYPE_INT, 5);
+  // Long enough to be searched 16 characters at a time.
+  TestValue("instr('aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaab', 'aab')", TYPE_INT, 34);
+  TestValue("instr('abcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyz', 'xyza')",
+      TYPE_INT, 24);
+  TestValue("instr('abcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyz', 'xyzb')",
+      TYPE_INT, 0);
   TestIsNull("instr(NULL, 'bcx')", TYPE_INT);
   TestIsNull("instr('xyzabcxyz', NULL)", TYPE_INT);
   TestIsNull("instr(NULL, NULL)", TYPE_INT);
@@ -2175,6 +2202,9 @@ TEST_F(ExprTest, StringFunctions) {
   TestStringValue("cast(cast(123456 as CHAR(3)) as VARCHAR(3))", "123");
   TestStringValue("cast(cast(123456 as CHAR(3)) as VARCHAR(65355))", "123");
   TestIsNull("cast(NULL as CHAR(3))", ColumnType::CreateCharType(3));
+  TestValue("char_length(cast('HELLO' as CHAR(7)))", TYPE_INT, 5);
+  TestValue("char_length(cast('HELLO  WORLD' as CHAR(70)))", TYPE_INT, 12);
+  TestValue("char_length(cast('' as CHAR(40)))", TYPE_INT, 0);
 
   TestCharValue("cast('HELLO' as CHAR(255))",
       "HELLO                                                                        "
@@ -58,6 +58,7 @@
 #include "runtime/lib-cache.h"
 #include "runtime/runtime-state.h"
 #include "runtime/raw-value.h"
+#include "runtime/row-batch.h"
 #include "runtime/tuple.h"
 #include "runtime/tuple-row.h"
 #include "udf/udf.h"
@@ -677,6 +678,17 @@ Status Expr::GetCodegendComputeFnWrapper(RuntimeState* state, Function** fn) {
   return Status::OK();
 }
 
+int Expr::FilterBatch(ExprContext* context, RowBatch* batch, int* sel, int num_sel) {
+  DCHECK_EQ(type_.type, TYPE_BOOLEAN);
+  int num_selected = 0;
+  for (int i = 0; i < num_sel; ++i) {
+    BooleanVal val = GetBooleanVal(context, batch->GetRow(sel[i]));
+    sel[num_selected] = sel[i];
+    num_selected += !val.is_null && val.val;
+  }
+  return num_selected;
+}
+
 // At least one of these should always be subclassed.
 BooleanVal Expr::GetBooleanVal(ExprContext* context, const TupleRow* row) {
   DCHECK(false) << DebugString();
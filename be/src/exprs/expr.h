@@ -113,6 +113,7 @@ class LibCacheEntry;
 class LlvmCodeGen;
 class MemTracker;
 class ObjectPool;
+class RowBatch;
 class RowDescriptor;
 class RuntimeState;
 class TColumnValue;
@@ -142,6 +143,14 @@ class Expr {
   virtual TimestampVal GetTimestampVal(ExprContext* context, const TupleRow*);
   virtual DecimalVal GetDecimalVal(ExprContext* context, const TupleRow*);
 
+  /// Batch-at-a-time evaluation of a BOOLEAN expr. 'sel' holds the indices of the
+  /// 'num_sel' rows of 'batch' to evaluate, in ascending order. Removes the rows for
+  /// which this expr is not true (i.e. false or NULL) from 'sel', keeping the order of
+  /// the remaining rows, and returns their number. The default implementation calls
+  /// GetBooleanVal() for every selected row. Subclasses override it for predicates that
+  /// can be evaluated over the whole batch without a virtual call per row.
+  virtual int FilterBatch(ExprContext* context, RowBatch* batch, int* sel, int num_sel);
+
   /// Get the number of digits after the decimal that should be displayed for this value.
   /// Returns -1 if no scale has been specified (currently the scale is only set for
   /// doubles set by RoundUpTo). GetValue() must have already been called.
@@ -155,6 +164,10 @@ class Expr {
   const ColumnType& type() const { return type_; }
   bool is_slotref() const { return is_slotref_; }
 
+  /// Returns the function description of this expr. Only set for exprs created from a
+  /// function call, e.g. builtin operators and UDFs.
+  const TFunction& fn() const { return fn_; }
+
   const std::vector<Expr*>& children() const { return children_; }
 
   /// Returns an error status if the function context associated with the
@@ -12,6 +12,8 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
+#include <cmath>
 #include <sstream>
 
 #include "exprs/in-predicate.h"
@@ -54,6 +56,12 @@ template<> Decimal16Value GetVal(
   }
 }
 
+// NaNs are never equal to a value, and would break the ordering of the sorted values.
+template<typename SetType>
+inline bool IsNaN(const SetType& x) { return false; }
+template<> inline bool IsNaN(const float& x) { return std::isnan(x); }
+template<> inline bool IsNaN(const double& x) { return std::isnan(x); }
+
 template<typename T, typename SetType>
 void InPredicate::SetLookupPrepare(
     FunctionContext* ctx, FunctionContext::FunctionStateScope scope) {
@@ -68,9 +76,13 @@ void InPredicate::SetLookupPrepare(
     if (arg->is_null) {
       state->contains_null = true;
     } else {
-      state->val_set.insert(GetVal<T, SetType>(state->type, *arg));
+      SetType val = GetVal<T, SetType>(state->type, *arg);
+      if (!IsNaN(val)) state->sorted_vals.push_back(val);
     }
   }
+  vector<SetType>& vals = state->sorted_vals;
+  sort(vals.begin(), vals.end());
+  vals.erase(unique(vals.begin(), vals.end()), vals.end());
   ctx->SetFunctionState(scope, state);
 }
 
@@ -107,7 +119,21 @@ BooleanVal InPredicate::SetLookup(
     SetLookupState<SetType>* state, const T& v) {
   DCHECK(state != NULL);
   SetType val = GetVal<T, SetType>(state->type, v);
-  bool found = state->val_set.find(val) != state->val_set.end();
+  const vector<SetType>& vals = state->sorted_vals;
+  bool found = false;
+  if (!vals.empty()) {
+    // Find the first value that is not less than 'val'. The halving loop only depends
+    // on the number of values, and the comparison is compiled to a conditional move.
+    const SetType* base = &vals[0];
+    int n = vals.size();
+    while (n > 1) {
+      int half = n / 2;
+      base = base[half] < val ? base + half : base;
+      n -= half;
+    }
+    base += *base < val;
+    found = base != &vals[0] + vals.size() && *base == val;
+  }
   if (found) return BooleanVal(true);
   if (state->contains_null) return BooleanVal::null();
   return BooleanVal(false);
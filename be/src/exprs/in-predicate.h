@@ -17,6 +17,7 @@
 #define IMPALA_EXPRS_IN_PREDICATE_H_
 
 #include <string>
+#include <vector>
 #include "exprs/predicate.h"
 #include "udf/udf.h"
 
@@ -27,8 +28,9 @@ namespace impala {
 /// There are two strategies for evaluating the IN predicate:
 //
 /// 1) SET_LOOKUP: This strategy is for when all the values in the IN list are constant. In
-///    the prepare function, we create a set of the constant values from the IN list, and
-///    use this set to lookup a given 'val'.
+///    the prepare function, we sort and deduplicate the constant values from the IN list
+///    into an array, and use a branch-free binary search of the array to lookup a given
+///    'val'.
 //
 /// 2) ITERATE: This is the fallback strategy for when their are non-constant IN list
 ///    values, or very few values in the IN list. We simply iterate through every
@@ -38,7 +40,9 @@ namespace impala {
 /// InIterate() or InSetLookup()). If it chooses SET_LOOKUP, it also sets the appropriate
 /// SetLookupPrepare and SetLookupClose functions.
 //
-/// TODO: the set lookup logic is not yet implemented for TimestampVals or DecimalVals
+/// The functions are cross-compiled, so the lookup is inlined into codegen'd callers.
+/// TODO: for integer IN lists, a perfect hash built in the prepare function could
+/// replace the O(log n) search.
 class InPredicate : public Predicate {
  public:
   /// Functions for every type
@@ -277,10 +281,11 @@ class InPredicate : public Predicate {
     /// If true, there is at least one NULL constant in the IN list.
     bool contains_null;
 
-    /// The set of all non-NULL constant values in the IN list.
-    /// Note: boost::unordered_set and std::binary_search performed worse based on the
-    /// in-predicate-benchmark
-    std::set<SetType> val_set;
+    /// All distinct non-NULL constant values in the IN list, in ascending order. The
+    /// search has no data-dependent branches, so it doesn't suffer from the branch
+    /// mispredictions that made std::binary_search slower than std::set in the
+    /// in-predicate-benchmark. The array is also denser than the nodes of a std::set.
+    std::vector<SetType> sorted_vals;
 
     /// The type of the arguments
     const FunctionContext::TypeDesc* type;
@@ -301,7 +306,7 @@ class InPredicate : public Predicate {
   static void SetLookupClose(
       FunctionContext* ctx, FunctionContext::FunctionStateScope scope);
 
-  /// Looks up v in state->val_set.
+  /// Looks up v in state->sorted_vals.
   template<typename T, typename SetType>
   static BooleanVal SetLookup(SetLookupState<SetType>* state, const T& v);
 
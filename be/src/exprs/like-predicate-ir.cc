@@ -80,9 +80,14 @@ void LikePredicate::LikePrepareInternal(FunctionContext* context,
     re2::RE2 equals_re("([^%_]*)");
     string pattern_str(pattern.ptr, pattern.len);
     string search_string;
+    vector<string> search_strings;
     if (case_sensitive && RE2::FullMatch(pattern_str, substring_re, &search_string)) {
       state->SetSearchString(search_string);
       state->function_ = ConstantSubstringFn;
+    } else if (case_sensitive &&
+        ParseSubstringsPattern(pattern_str, state->escape_char_, &search_strings)) {
+      state->SetSearchStrings(search_strings);
+      state->function_ = ConstantSubstringsFn;
     } else if (case_sensitive &&
         RE2::FullMatch(pattern_str, starts_with_re, &search_string)) {
       state->SetSearchString(search_string);
@@ -103,8 +108,8 @@ void LikePredicate::LikePrepareInternal(FunctionContext* context,
       opts.set_never_nl(false);
       opts.set_dot_nl(true);
       opts.set_case_sensitive(case_sensitive);
-      state->regex_.reset(new RE2(re_pattern, opts));
-      if (!state->regex_->ok()) {
+      state->regex_ = CompiledRegex::Create(re_pattern, opts);
+      if (!state->regex_->re().ok()) {
         context->SetError(
             strings::Substitute("Invalid regex: $0", pattern_val.ptr).c_str());
       }
@@ -173,8 +178,8 @@ void LikePredicate::RegexPrepareInternal(FunctionContext* context,
     } else {
       RE2::Options opts;
       opts.set_case_sensitive(case_sensitive);
-      state->regex_.reset(new RE2(pattern_str, opts));
-      if (!state->regex_->ok()) {
+      state->regex_ = CompiledRegex::Create(pattern_str, opts);
+      if (!state->regex_->re().ok()) {
         stringstream error;
         error << "Invalid regex expression" << pattern->ptr;
         context->SetError(error.str().c_str());
@@ -218,8 +223,8 @@ void LikePredicate::RegexpLikePrepare(FunctionContext* context,
       return;
     }
     string pattern_str(reinterpret_cast<const char*>(pattern->ptr), pattern->len);
-    state->regex_.reset(new RE2(pattern_str, opts));
-    if (!state->regex_->ok()) {
+    state->regex_ = CompiledRegex::Create(pattern_str, opts);
+    if (!state->regex_->re().ok()) {
       error << "Invalid regex expression" << pattern->ptr;
       context->SetError(error.str().c_str());
     }
@@ -242,10 +247,12 @@ BooleanVal LikePredicate::RegexpLike(FunctionContext* context, const StringVal&
       return BooleanVal(false);
     }
     string re_pattern(reinterpret_cast<const char*>(pattern.ptr), pattern.len);
-    re2::RE2 re(re_pattern, opts);
-    if (re.ok()) {
-      return RE2::PartialMatch(re2::StringPiece(
-          reinterpret_cast<const char*>(val.ptr), val.len), re);
+    // Rows often repeat patterns, which the cache then only compiles once.
+    shared_ptr<const CompiledRegex> re = CompiledRegex::Create(re_pattern, opts);
+    if (re->re().ok()) {
+      const char* ptr = reinterpret_cast<const char*>(val.ptr);
+      if (!re->MayMatch(ptr, val.len)) return BooleanVal(false);
+      return RE2::PartialMatch(re2::StringPiece(ptr, val.len), re->re());
     } else {
       context->SetError(
           strings::Substitute("Invalid regex: $0", pattern.ptr).c_str());
@@ -284,6 +291,41 @@ BooleanVal LikePredicate::ConstantSubstringFn(FunctionContext* context,
   return BooleanVal(state->substring_pattern_.Search(&pattern_value) != -1);
 }
 
+bool LikePredicate::ParseSubstringsPattern(const string& pattern, char escape_char,
+    vector<string>* search_strings) {
+  if (pattern.size() < 2 || pattern[0] != '%' || pattern[pattern.size() - 1] != '%') {
+    return false;
+  }
+  // Escaped characters and '_' need the regex path.
+  if (pattern.find('_') != string::npos) return false;
+  if (pattern.find(escape_char) != string::npos) return false;
+  search_strings->clear();
+  int start = 0;
+  while (start < pattern.size()) {
+    size_t end = pattern.find('%', start);
+    if (end == string::npos) end = pattern.size();
+    if (end > start) search_strings->push_back(pattern.substr(start, end - start));
+    start = end + 1;
+  }
+  return search_strings->size() >= 2;
+}
+
+BooleanVal LikePredicate::ConstantSubstringsFn(FunctionContext* context,
+    const StringVal& val, const StringVal& pattern) {
+  if (val.is_null) return BooleanVal::null();
+  LikePredicateState* state = reinterpret_cast<LikePredicateState*>(
+      context->GetFunctionState(FunctionContext::THREAD_LOCAL));
+  StringValue remaining = StringValue::FromStringVal(val);
+  for (const StringSearch& search: state->substring_patterns_) {
+    int offset = search.Search(&remaining);
+    if (offset == -1) return BooleanVal(false);
+    int consumed = offset + search.pattern_len();
+    remaining.ptr += consumed;
+    remaining.len -= consumed;
+  }
+  return BooleanVal(true);
+}
+
 BooleanVal LikePredicate::ConstantStartsWithFn(FunctionContext* context,
     const StringVal& val, const StringVal& pattern) {
   if (val.is_null) return BooleanVal::null();
@@ -327,8 +369,9 @@ BooleanVal LikePredicate::ConstantRegexFnPartial(FunctionContext* context,
   if (val.is_null) return BooleanVal::null();
   LikePredicateState* state = reinterpret_cast<LikePredicateState*>(
       context->GetFunctionState(FunctionContext::THREAD_LOCAL));
-  re2::StringPiece operand_sp(reinterpret_cast<const char*>(val.ptr), val.len);
-  return RE2::PartialMatch(operand_sp, *state->regex_);
+  const char* ptr = reinterpret_cast<const char*>(val.ptr);
+  if (!state->regex_->MayMatch(ptr, val.len)) return BooleanVal(false);
+  return RE2::PartialMatch(re2::StringPiece(ptr, val.len), state->regex_->re());
 }
 
 BooleanVal LikePredicate::ConstantRegexFn(FunctionContext* context,
@@ -336,8 +379,9 @@ BooleanVal LikePredicate::ConstantRegexFn(FunctionContext* context,
   if (val.is_null) return BooleanVal::null();
   LikePredicateState* state = reinterpret_cast<LikePredicateState*>(
       context->GetFunctionState(FunctionContext::THREAD_LOCAL));
-  re2::StringPiece operand_sp(reinterpret_cast<const char*>(val.ptr), val.len);
-  return RE2::FullMatch(operand_sp, *state->regex_);
+  const char* ptr = reinterpret_cast<const char*>(val.ptr);
+  if (!state->regex_->MayMatch(ptr, val.len)) return BooleanVal(false);
+  return RE2::FullMatch(re2::StringPiece(ptr, val.len), state->regex_->re());
 }
 
 BooleanVal LikePredicate::RegexMatch(FunctionContext* context,
@@ -347,12 +391,13 @@ BooleanVal LikePredicate::RegexMatch(FunctionContext* context,
   if (context->IsArgConstant(1)) {
     LikePredicateState* state = reinterpret_cast<LikePredicateState*>(
         context->GetFunctionState(FunctionContext::THREAD_LOCAL));
+    const char* ptr = reinterpret_cast<const char*>(operand_value.ptr);
+    if (!state->regex_->MayMatch(ptr, operand_value.len)) return BooleanVal(false);
+    re2::StringPiece operand_sp(ptr, operand_value.len);
     if (is_like_pattern) {
-      return RE2::FullMatch(re2::StringPiece(reinterpret_cast<const char*>(
-          operand_value.ptr), operand_value.len), *state->regex_.get());
+      return RE2::FullMatch(operand_sp, state->regex_->re());
     } else {
-      return RE2::PartialMatch(re2::StringPiece(reinterpret_cast<const char*>(
-          operand_value.ptr), operand_value.len), *state->regex_.get());
+      return RE2::PartialMatch(operand_sp, state->regex_->re());
     }
   } else {
     string re_pattern;
@@ -365,14 +410,15 @@ BooleanVal LikePredicate::RegexMatch(FunctionContext* context,
       re_pattern =
         string(reinterpret_cast<const char*>(pattern_value.ptr), pattern_value.len);
     }
-    re2::RE2 re(re_pattern, opts);
-    if (re.ok()) {
+    shared_ptr<const CompiledRegex> re = CompiledRegex::Create(re_pattern, opts);
+    if (re->re().ok()) {
+      const char* ptr = reinterpret_cast<const char*>(operand_value.ptr);
+      if (!re->MayMatch(ptr, operand_value.len)) return BooleanVal(false);
+      re2::StringPiece operand_sp(ptr, operand_value.len);
       if (is_like_pattern) {
-        return RE2::FullMatch(re2::StringPiece(
-            reinterpret_cast<const char*>(operand_value.ptr), operand_value.len), re);
+        return RE2::FullMatch(operand_sp, re->re());
       } else {
-        return RE2::PartialMatch(re2::StringPiece(
-            reinterpret_cast<const char*>(operand_value.ptr), operand_value.len), re);
+        return RE2::PartialMatch(operand_sp, re->re());
       }
     } else {
       context->SetError(
@@ -16,10 +16,12 @@
 #ifndef IMPALA_EXPRS_LIKE_PREDICATE_H_
 #define IMPALA_EXPRS_LIKE_PREDICATE_H_
 
-#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
 #include <re2/re2.h>
 #include <string>
+#include <vector>
 
+#include "exprs/compiled-regex.h"
 #include "exprs/predicate.h"
 #include "gen-cpp/Exprs_types.h"
 #include "runtime/string-search.h"
@@ -71,8 +73,16 @@ class LikePredicate: public Predicate {
     /// in the value.
     StringSearch substring_pattern_;
 
-    /// Used for RLIKE and REGEXP predicates if the pattern is a constant argument.
-    boost::scoped_ptr<re2::RE2> regex_;
+    /// Used for LIKE predicates if the pattern is a constant argument of the form
+    /// '%s1%s2%...%' with two or more constant strings. The strings must be found in
+    /// order and without overlapping.
+    std::vector<std::string> search_strings_;
+    std::vector<StringValue> search_string_svs_;
+    std::vector<StringSearch> substring_patterns_;
+
+    /// Used for RLIKE and REGEXP predicates if the pattern is a constant argument. Shared
+    /// with other fragment instances that use the same pattern.
+    boost::shared_ptr<const CompiledRegex> regex_;
 
     LikePredicateState() : escape_char_('\\') {
     }
@@ -82,6 +92,19 @@ class LikePredicate: public Predicate {
       search_string_sv_ = StringValue(search_string_);
       substring_pattern_ = StringSearch(&search_string_sv_);
     }
+
+    void SetSearchStrings(const std::vector<std::string>& search_strings) {
+      search_strings_ = search_strings;
+      // The StringSearches point to the StringValues, so these must not be resized.
+      search_string_svs_.clear();
+      for (const std::string& s: search_strings_) {
+        search_string_svs_.push_back(StringValue(s));
+      }
+      substring_patterns_.clear();
+      for (const StringValue& sv: search_string_svs_) {
+        substring_patterns_.push_back(StringSearch(&sv));
+      }
+    }
   };
 
   friend class OpcodeRegistry;
@@ -135,6 +158,17 @@ class LikePredicate: public Predicate {
   static impala_udf::BooleanVal ConstantSubstringFn(impala_udf::FunctionContext* context,
       const impala_udf::StringVal& val, const impala_udf::StringVal& pattern);
 
+  /// Handling of like predicates of the form '%s1%s2%...%', which search for each
+  /// substring after the previous one
+  static impala_udf::BooleanVal ConstantSubstringsFn(
+      impala_udf::FunctionContext* context, const impala_udf::StringVal& val,
+      const impala_udf::StringVal& pattern);
+
+  /// Returns true if the LIKE pattern 'pattern' has the form '%s1%s2%...%' with at least
+  /// two non-empty constant strings, and returns the strings in 'search_strings'.
+  static bool ParseSubstringsPattern(const std::string& pattern, char escape_char,
+      std::vector<std::string>* search_strings);
+
   /// Handling of like predicates that can be implemented using strncmp
   static impala_udf::BooleanVal ConstantStartsWithFn(impala_udf::FunctionContext* context,
       const impala_udf::StringVal& val, const impala_udf::StringVal& pattern);
@@ -14,6 +14,7 @@
 
 #include "exprs/scalar-fn-call.h"
 
+#include <functional>
 #include <vector>
 #include <gutil/strings/substitute.h>
 #include <llvm/IR/Attributes.h>
@@ -23,11 +24,15 @@
 #include "codegen/llvm-codegen.h"
 #include "exprs/anyval-util.h"
 #include "exprs/expr-context.h"
+#include "exprs/slot-ref.h"
 #include "runtime/hdfs-fs-cache.h"
 #include "runtime/lib-cache.h"
+#include "runtime/row-batch.h"
 #include "runtime/runtime-state.h"
+#include "runtime/tuple-row.h"
 #include "runtime/types.h"
 #include "udf/udf-internal.h"
+#include "util/bit-util.h"
 #include "util/debug-util.h"
 #include "util/dynamic-util.h"
 #include "util/symbols-util.h"
@@ -40,6 +45,8 @@ using namespace strings;
 
 ScalarFnCall::ScalarFnCall(const TExprNode& node)
   : Expr(node),
+    batch_predicate_(BATCH_NONE),
+    batch_slot_child_idx_(-1),
     vararg_start_idx_(node.__isset.vararg_start_idx ?
         node.vararg_start_idx : -1),
     scalar_fn_wrapper_(NULL),
@@ -52,6 +59,7 @@ ScalarFnCall::ScalarFnCall(const TExprNode& node)
 Status ScalarFnCall::Prepare(RuntimeState* state, const RowDescriptor& desc,
     ExprContext* context) {
   RETURN_IF_ERROR(Expr::Prepare(state, desc, context));
+  InitBatchPredicate();
 
   if (fn_.scalar_fn.symbol.empty()) {
     // This path is intended to only be used during development to test FE
@@ -465,7 +473,7 @@ Status ScalarFnCall::GetUdf(RuntimeState* state, llvm::Function** udf) {
     // Associate the dynamically loaded function pointer with the Function* we
     // defined. This tells LLVM where the compiled function definition is located in
     // memory.
-    codegen->execution_engine()->addGlobalMapping(*udf, fn_ptr);
+    codegen->AddGlobalMapping(*udf, fn_ptr);
   } else if (fn_.binary_type == TFunctionBinaryType::BUILTIN) {
     // In this path, we're running a builtin with the UDF interface. The IR is
     // in the llvm module.
@@ -767,6 +775,229 @@ DecimalVal ScalarFnCall::GetDecimalVal(ExprContext* context, const TupleRow* row
   return fn(context, row);
 }
 
+void ScalarFnCall::InitBatchPredicate() {
+  batch_predicate_ = BATCH_NONE;
+  batch_slot_child_idx_ = -1;
+  if (fn_.binary_type != TFunctionBinaryType::BUILTIN) return;
+  if (type_.type != TYPE_BOOLEAN) return;
+
+  if (children_.size() == 1 && children_[0]->is_slotref()) {
+    // IsNullPredicate::IsNull<T>() and IsNotNull<T>(), see is-null-predicate.h.
+    const string& symbol = fn_.scalar_fn.symbol;
+    if (symbol.find("IsNullPredicate6IsNull") != string::npos) {
+      batch_predicate_ = BATCH_IS_NULL;
+    } else if (symbol.find("IsNullPredicate9IsNotNull") != string::npos) {
+      batch_predicate_ = BATCH_IS_NOT_NULL;
+    }
+    if (batch_predicate_ != BATCH_NONE) batch_slot_child_idx_ = 0;
+    return;
+  }
+
+  if (children_.size() != 2) return;
+  if (children_[0]->type() != children_[1]->type()) return;
+  switch (children_[0]->type().type) {
+    case TYPE_TINYINT:
+    case TYPE_SMALLINT:
+    case TYPE_INT:
+    case TYPE_BIGINT:
+    case TYPE_FLOAT:
+    case TYPE_DOUBLE:
+      break;
+    default:
+      return;
+  }
+  bool mirror;
+  if (children_[0]->is_slotref() && children_[1]->IsConstant()) {
+    mirror = false;
+  } else if (children_[1]->is_slotref() && children_[0]->IsConstant()) {
+    mirror = true;
+  } else {
+    return;
+  }
+  const string& fn_name = fn_.name.function_name;
+  if (fn_name == "eq") {
+    batch_predicate_ = BATCH_EQ;
+  } else if (fn_name == "ne") {
+    batch_predicate_ = BATCH_NE;
+  } else if (fn_name == "lt") {
+    batch_predicate_ = mirror ? BATCH_GT : BATCH_LT;
+  } else if (fn_name == "le") {
+    batch_predicate_ = mirror ? BATCH_GE : BATCH_LE;
+  } else if (fn_name == "gt") {
+    batch_predicate_ = mirror ? BATCH_LT : BATCH_GT;
+  } else if (fn_name == "ge") {
+    batch_predicate_ = mirror ? BATCH_LE : BATCH_GE;
+  } else {
+    return;
+  }
+  batch_slot_child_idx_ = mirror ? 1 : 0;
+}
+
+int ScalarFnCall::FilterBatch(ExprContext* context, RowBatch* batch, int* sel,
+    int num_sel) {
+  switch (batch_predicate_) {
+    case BATCH_NONE: {
+      UdfBatchEvaluate batch_fn =
+          context->fn_context(fn_context_index_)->impl()->batch_fn();
+      if (batch_fn != NULL && vararg_start_idx_ == -1) {
+        return FilterUdfBatch(context, batch_fn, batch, sel, num_sel);
+      }
+      return Expr::FilterBatch(context, batch, sel, num_sel);
+    }
+    case BATCH_IS_NULL:
+    case BATCH_IS_NOT_NULL: {
+      const SlotRef* slot_ref = static_cast<const SlotRef*>(children_[0]);
+      int tuple_idx = slot_ref->tuple_idx();
+      const NullIndicatorOffset& null_indicator = slot_ref->null_indicator_offset();
+      bool keep_null = batch_predicate_ == BATCH_IS_NULL;
+      int num_selected = 0;
+      for (int i = 0; i < num_sel; ++i) {
+        Tuple* tuple = batch->GetRow(sel[i])->GetTuple(tuple_idx);
+        bool is_null = tuple == NULL || tuple->IsNull(null_indicator);
+        sel[num_selected] = sel[i];
+        num_selected += is_null == keep_null;
+      }
+      return num_selected;
+    }
+    default:
+      break;
+  }
+
+  switch (children_[batch_slot_child_idx_]->type().type) {
+    case TYPE_TINYINT:
+      return FilterSlotCmpBatch<int8_t>(context, batch, sel, num_sel);
+    case TYPE_SMALLINT:
+      return FilterSlotCmpBatch<int16_t>(context, batch, sel, num_sel);
+    case TYPE_INT:
+      return FilterSlotCmpBatch<int32_t>(context, batch, sel, num_sel);
+    case TYPE_BIGINT:
+      return FilterSlotCmpBatch<int64_t>(context, batch, sel, num_sel);
+    case TYPE_FLOAT:
+      return FilterSlotCmpBatch<float>(context, batch, sel, num_sel);
+    case TYPE_DOUBLE:
+      return FilterSlotCmpBatch<double>(context, batch, sel, num_sel);
+    default:
+      DCHECK(false) << DebugString();
+      return Expr::FilterBatch(context, batch, sel, num_sel);
+  }
+}
+
+// Evaluates the constant 'expr' into 'value'. Returns false if it is NULL.
+static inline bool GetConstValue(ExprContext* context, Expr* expr, int8_t* value) {
+  TinyIntVal val = expr->GetTinyIntVal(context, NULL);
+  *value = val.val;
+  return !val.is_null;
+}
+
+static inline bool GetConstValue(ExprContext* context, Expr* expr, int16_t* value) {
+  SmallIntVal val = expr->GetSmallIntVal(context, NULL);
+  *value = val.val;
+  return !val.is_null;
+}
+
+static inline bool GetConstValue(ExprContext* context, Expr* expr, int32_t* value) {
+  IntVal val = expr->GetIntVal(context, NULL);
+  *value = val.val;
+  return !val.is_null;
+}
+
+static inline bool GetConstValue(ExprContext* context, Expr* expr, int64_t* value) {
+  BigIntVal val = expr->GetBigIntVal(context, NULL);
+  *value = val.val;
+  return !val.is_null;
+}
+
+static inline bool GetConstValue(ExprContext* context, Expr* expr, float* value) {
+  FloatVal val = expr->GetFloatVal(context, NULL);
+  *value = val.val;
+  return !val.is_null;
+}
+
+static inline bool GetConstValue(ExprContext* context, Expr* expr, double* value) {
+  DoubleVal val = expr->GetDoubleVal(context, NULL);
+  *value = val.val;
+  return !val.is_null;
+}
+
+template <typename T>
+int ScalarFnCall::FilterSlotCmpBatch(ExprContext* context, RowBatch* batch, int* sel,
+    int num_sel) {
+  // The constant operand is evaluated once for the batch. Comparisons with NULL are
+  // never true.
+  T value;
+  if (!GetConstValue(context, children_[1 - batch_slot_child_idx_], &value)) return 0;
+  switch (batch_predicate_) {
+    case BATCH_EQ:
+      return FilterSlotCmpBatch<T, std::equal_to<T> >(batch, value, sel, num_sel);
+    case BATCH_NE:
+      return FilterSlotCmpBatch<T, std::not_equal_to<T> >(batch, value, sel, num_sel);
+    case BATCH_LT:
+      return FilterSlotCmpBatch<T, std::less<T> >(batch, value, sel, num_sel);
+    case BATCH_LE:
+      return FilterSlotCmpBatch<T, std::less_equal<T> >(batch, value, sel, num_sel);
+    case BATCH_GT:
+      return FilterSlotCmpBatch<T, std::greater<T> >(batch, value, sel, num_sel);
+    case BATCH_GE:
+      return FilterSlotCmpBatch<T, std::greater_equal<T> >(batch, value, sel, num_sel);
+    default:
+      DCHECK(false) << DebugString();
+      return 0;
+  }
+}
+
+template <typename T, typename Cmp>
+int ScalarFnCall::FilterSlotCmpBatch(RowBatch* batch, T value, int* sel, int num_sel) {
+  const SlotRef* slot_ref = static_cast<const SlotRef*>(children_[batch_slot_child_idx_]);
+  int tuple_idx = slot_ref->tuple_idx();
+  int slot_offset = slot_ref->slot_offset();
+  const NullIndicatorOffset& null_indicator = slot_ref->null_indicator_offset();
+  Cmp cmp;
+  int num_selected = 0;
+  for (int i = 0; i < num_sel; ++i) {
+    Tuple* tuple = batch->GetRow(sel[i])->GetTuple(tuple_idx);
+    sel[num_selected] = sel[i];
+    num_selected += tuple != NULL && !tuple->IsNull(null_indicator) &&
+        cmp(*reinterpret_cast<T*>(tuple->GetSlot(slot_offset)), value);
+  }
+  return num_selected;
+}
+
+int ScalarFnCall::FilterUdfBatch(ExprContext* context, UdfBatchEvaluate batch_fn,
+    RowBatch* batch, int* sel, int num_sel) {
+  DCHECK_EQ(type_.type, TYPE_BOOLEAN);
+  FunctionContext* fn_ctx = context->fn_context(fn_context_index_);
+  // The argument arrays are laid out one after another, each aligned like DecimalVal.
+  vector<int64_t> arg_offsets(children_.size());
+  int64_t buffer_size = 0;
+  for (int i = 0; i < children_.size(); ++i) {
+    arg_offsets[i] = buffer_size;
+    buffer_size += BitUtil::RoundUp(
+        num_sel * AnyValUtil::AnyValSize(children_[i]->type()), 16);
+  }
+  vector<uint8_t> buffer(buffer_size);
+  vector<const AnyVal*> args(children_.size());
+  for (int i = 0; i < children_.size(); ++i) {
+    const ColumnType& arg_type = children_[i]->type();
+    int val_size = AnyValUtil::AnyValSize(arg_type);
+    uint8_t* arg_vals = buffer.data() + arg_offsets[i];
+    args[i] = reinterpret_cast<const AnyVal*>(arg_vals);
+    for (int j = 0; j < num_sel; ++j) {
+      void* src_slot = context->GetValue(children_[i], batch->GetRow(sel[j]));
+      AnyValUtil::SetAnyVal(src_slot, arg_type,
+          reinterpret_cast<AnyVal*>(arg_vals + j * val_size));
+    }
+  }
+
+  vector<BooleanVal> results(num_sel);
+  batch_fn(fn_ctx, num_sel, args.data(), results.data());
+  int num_selected = 0;
+  for (int i = 0; i < num_sel; ++i) {
+    sel[num_selected] = sel[i];
+    num_selected += !results[i].is_null && results[i].val;
+  }
+  return num_selected;
+}
+
 string ScalarFnCall::DebugString() const {
   stringstream out;
   out << "ScalarFnCall(udf_type=" << fn_.binary_type
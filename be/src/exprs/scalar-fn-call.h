@@ -74,7 +74,49 @@ class ScalarFnCall: public Expr {
   virtual TimestampVal GetTimestampVal(ExprContext* context, const TupleRow*);
   virtual DecimalVal GetDecimalVal(ExprContext* context, const TupleRow*);
 
+  /// Evaluates comparisons of a numeric slot with a constant and IS [NOT] NULL checks of
+  /// a slot in a loop over the batch, and calls the batch function of UDFs that
+  /// registered one (see UdfBatchEvaluate) once for the batch. Other functions use the
+  /// default implementation.
+  virtual int FilterBatch(ExprContext* context, RowBatch* batch, int* sel, int num_sel);
+
  private:
+  /// The predicates that FilterBatch() evaluates without calling the function.
+  enum BatchPredicate {
+    BATCH_NONE,
+    BATCH_EQ,
+    BATCH_NE,
+    BATCH_LT,
+    BATCH_LE,
+    BATCH_GT,
+    BATCH_GE,
+    BATCH_IS_NULL,
+    BATCH_IS_NOT_NULL
+  };
+
+  /// The predicate this function implements, set by InitBatchPredicate() in Prepare().
+  /// Comparisons are stored as '<slot> <op> <constant>', i.e. mirrored if the slot is
+  /// the right child.
+  BatchPredicate batch_predicate_;
+
+  /// Index of the SlotRef child of a batch predicate.
+  int batch_slot_child_idx_;
+
+  /// Sets batch_predicate_ and batch_slot_child_idx_.
+  void InitBatchPredicate();
+
+  /// FilterBatch() for comparisons of a slot of type T. The comparison is instantiated
+  /// for each operator, so that the loop over the rows doesn't branch on it.
+  template <typename T>
+  int FilterSlotCmpBatch(ExprContext* context, RowBatch* batch, int* sel, int num_sel);
+  template <typename T, typename Cmp>
+  int FilterSlotCmpBatch(RowBatch* batch, T value, int* sel, int num_sel);
+
+  /// FilterBatch() for UDFs with a batch function 'batch_fn'. Evaluates the children for
+  /// all selected rows and passes them to one call of 'batch_fn'.
+  int FilterUdfBatch(ExprContext* context, UdfBatchEvaluate batch_fn, RowBatch* batch,
+      int* sel, int num_sel);
+
   /// If this function has var args, children()[vararg_start_idx_] is the first vararg
   /// argument.
   /// If this function does not have varargs, it is set to -1.
@@ -21,10 +21,12 @@
 #include <bitset>
 
 #include "exprs/anyval-util.h"
+#include "exprs/compiled-regex.h"
 #include "exprs/expr.h"
 #include "runtime/string-value.inline.h"
 #include "runtime/tuple-row.h"
 #include "sasl/saslutil.h"
+#include "util/sse-util.h"
 #include "util/url-parser.h"
 
 #include "common/names.h"
@@ -35,6 +37,95 @@ using std::bitset;
 // NOTE: be careful not to use string::append.  It is not performant.
 namespace impala {
 
+// Returns the index of the first byte of 'ptr[0, len)' in the ASCII range ['lo', 'hi'],
+// or 'len' if there is none. Bytes >= 0x80 are never in the range. Checks 16 bytes at
+// a time with SSE2.
+static inline int FindFirstInRange(const uint8_t* ptr, int len, char lo, char hi) {
+  const __m128i lo_minus_one = _mm_set1_epi8(lo - 1);
+  const __m128i hi_plus_one = _mm_set1_epi8(hi + 1);
+  int i = 0;
+  for (; i + SSEUtil::CHARS_PER_128_BIT_REGISTER <= len;
+       i += SSEUtil::CHARS_PER_128_BIT_REGISTER) {
+    __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr + i));
+    // Signed compares, so bytes >= 0x80 are negative and fail the first test.
+    int mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpgt_epi8(chars, lo_minus_one),
+        _mm_cmplt_epi8(chars, hi_plus_one)));
+    if (mask != 0) return i + __builtin_ctz(mask);
+  }
+  for (; i < len; ++i) {
+    if (ptr[i] >= lo && ptr[i] <= hi) return i;
+  }
+  return len;
+}
+
+// Writes 'src[0, len)' to 'dst' with the bytes in the ASCII range ['lo', 'hi'] flipped
+// between upper and lower case, which is what ::tolower() and ::toupper() do in the
+// C locale.
+static inline void FlipCaseInRange(const uint8_t* src, int len, char lo, char hi,
+    uint8_t* dst) {
+  const __m128i lo_minus_one = _mm_set1_epi8(lo - 1);
+  const __m128i hi_plus_one = _mm_set1_epi8(hi + 1);
+  const __m128i case_bit = _mm_set1_epi8(0x20);
+  int i = 0;
+  for (; i + SSEUtil::CHARS_PER_128_BIT_REGISTER <= len;
+       i += SSEUtil::CHARS_PER_128_BIT_REGISTER) {
+    __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    __m128i in_range = _mm_and_si128(_mm_cmpgt_epi8(chars, lo_minus_one),
+        _mm_cmplt_epi8(chars, hi_plus_one));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i),
+        _mm_xor_si128(chars, _mm_and_si128(in_range, case_bit)));
+  }
+  for (; i < len; ++i) {
+    dst[i] = (src[i] >= lo && src[i] <= hi) ? src[i] ^ 0x20 : src[i];
+  }
+}
+
+// Returns lower(str) if 'to_lower' and upper(str) otherwise. Returns 'str' itself when
+// no byte changes, so only strings that need case mapping are copied.
+static inline StringVal MapCase(FunctionContext* context, const StringVal& str,
+    bool to_lower) {
+  if (str.is_null) return StringVal::null();
+  char lo = to_lower ? 'A' : 'a';
+  char hi = to_lower ? 'Z' : 'z';
+  int first = FindFirstInRange(str.ptr, str.len, lo, hi);
+  if (first == str.len) return str;
+  StringVal result(context, str.len);
+  if (UNLIKELY(result.is_null)) return StringVal::null();
+  memcpy(result.ptr, str.ptr, first);
+  FlipCaseInRange(str.ptr + first, str.len - first, lo, hi, result.ptr + first);
+  return result;
+}
+
+// Returns the number of leading spaces of 'ptr[0, len)'.
+static inline int CountLeadingSpaces(const uint8_t* ptr, int len) {
+  const __m128i spaces = _mm_set1_epi8(' ');
+  int i = 0;
+  for (; i + SSEUtil::CHARS_PER_128_BIT_REGISTER <= len;
+       i += SSEUtil::CHARS_PER_128_BIT_REGISTER) {
+    __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr + i));
+    int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chars, spaces)) ^ 0xFFFF;
+    if (mask != 0) return i + __builtin_ctz(mask);
+  }
+  while (i < len && ptr[i] == ' ') ++i;
+  return i;
+}
+
+// Returns the number of trailing spaces of 'ptr[0, len)'.
+static inline int CountTrailingSpaces(const uint8_t* ptr, int len) {
+  const __m128i spaces = _mm_set1_epi8(' ');
+  int end = len;
+  for (; end >= SSEUtil::CHARS_PER_128_BIT_REGISTER;
+       end -= SSEUtil::CHARS_PER_128_BIT_REGISTER) {
+    __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(
+        ptr + end - SSEUtil::CHARS_PER_128_BIT_REGISTER));
+    int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chars, spaces)) ^ 0xFFFF;
+    // The highest set bit is the last non-space byte of the block.
+    if (mask != 0) return len - end + __builtin_clz(mask) - 16;
+  }
+  while (end > 0 && ptr[end - 1] == ' ') --end;
+  return len - end;
+}
+
 // This behaves identically to the mysql implementation, namely:
 //  - 1-indexed positions
 //  - supported negative positions (count from the end of the string)
@@ -156,27 +247,15 @@ IntVal StringFunctions::CharLength(FunctionContext* context, const StringVal& st
   if (str.is_null) return IntVal::null();
   const FunctionContext::TypeDesc* t = context->GetArgType(0);
   DCHECK_EQ(t->type, FunctionContext::TYPE_FIXED_BUFFER);
-  return StringValue::UnpaddedCharLength(reinterpret_cast<char*>(str.ptr), t->len);
+  return IntVal(t->len - CountTrailingSpaces(str.ptr, t->len));
 }
 
 StringVal StringFunctions::Lower(FunctionContext* context, const StringVal& str) {
-  if (str.is_null) return StringVal::null();
-  StringVal result(context, str.len);
-  if (UNLIKELY(result.is_null)) return StringVal::null();
-  for (int i = 0; i < str.len; ++i) {
-    result.ptr[i] = ::tolower(str.ptr[i]);
-  }
-  return result;
+  return MapCase(context, str, true);
 }
 
 StringVal StringFunctions::Upper(FunctionContext* context, const StringVal& str) {
-  if (str.is_null) return StringVal::null();
-  StringVal result(context, str.len);
-  if (UNLIKELY(result.is_null)) return StringVal::null();
-  for (int i = 0; i < str.len; ++i) {
-    result.ptr[i] = ::toupper(str.ptr[i]);
-  }
-  return result;
+  return MapCase(context, str, false);
 }
 
 // Returns a string identical to the input, but with the first character
@@ -239,39 +318,20 @@ StringVal StringFunctions::Translate(FunctionContext* context, const StringVal&
 
 StringVal StringFunctions::Trim(FunctionContext* context, const StringVal& str) {
   if (str.is_null) return StringVal::null();
-  // Find new starting position.
-  int32_t begin = 0;
-  while (begin < str.len && str.ptr[begin] == ' ') {
-    ++begin;
-  }
-  // Find new ending position.
-  int32_t end = str.len - 1;
-  while (end > begin && str.ptr[end] == ' ') {
-    --end;
-  }
-  return StringVal(str.ptr + begin, end - begin + 1);
+  int32_t begin = CountLeadingSpaces(str.ptr, str.len);
+  int32_t len = str.len - begin;
+  return StringVal(str.ptr + begin, len - CountTrailingSpaces(str.ptr + begin, len));
 }
 
 StringVal StringFunctions::Ltrim(FunctionContext* context, const StringVal& str) {
   if (str.is_null) return StringVal::null();
-  // Find new starting position.
-  int32_t begin = 0;
-  while (begin < str.len && str.ptr[begin] == ' ') {
-    ++begin;
-  }
+  int32_t begin = CountLeadingSpaces(str.ptr, str.len);
   return StringVal(str.ptr + begin, str.len - begin);
 }
 
 StringVal StringFunctions::Rtrim(FunctionContext* context, const StringVal& str) {
   if (str.is_null) return StringVal::null();
-  if (str.len == 0) return str;
-  // Find new ending position.
-  int32_t end = str.len - 1;
-  while (end > 0 && str.ptr[end] == ' ') {
-    --end;
-  }
-  DCHECK_GE(end, 0);
-  return StringVal(str.ptr, (str.ptr[end] == ' ') ? end : end + 1);
+  return StringVal(str.ptr, str.len - CountTrailingSpaces(str.ptr, str.len));
 }
 
 IntVal StringFunctions::Ascii(FunctionContext* context, const StringVal& str) {
@@ -316,11 +376,11 @@ IntVal StringFunctions::LocatePos(FunctionContext* context, const StringVal& sub
   }
 }
 
-// The caller owns the returned regex. Returns NULL if the pattern could not be compiled.
-re2::RE2* CompileRegex(const StringVal& pattern, string* error_str,
-    const StringVal& match_parameter) {
+// Returns NULL if the pattern could not be compiled. The regex may be shared with other
+// fragment instances through the regex cache.
+static shared_ptr<const CompiledRegex> CompileRegex(const StringVal& pattern,
+    string* error_str, const StringVal& match_parameter) {
   DCHECK(error_str != NULL);
-  re2::StringPiece pattern_sp(reinterpret_cast<char*>(pattern.ptr), pattern.len);
   re2::RE2::Options options;
   // Disable error logging in case e.g. every row causes an error
   options.set_log_errors(false);
@@ -328,20 +388,29 @@ re2::RE2* CompileRegex(const StringVal& pattern, string* error_str,
   options.set_longest_match(true);
   if (!match_parameter.is_null &&
       !StringFunctions::SetRE2Options(match_parameter, error_str, &options)) {
-    return NULL;
+    return shared_ptr<const CompiledRegex>();
   }
-  re2::RE2* re = new re2::RE2(pattern_sp, options);
-  if (!re->ok()) {
+  shared_ptr<const CompiledRegex> re =
+      CompiledRegex::Create(AnyValUtil::ToString(pattern), options);
+  if (!re->re().ok()) {
     stringstream ss;
     ss << "Could not compile regexp pattern: " << AnyValUtil::ToString(pattern) << endl
-       << "Error: " << re->error();
+       << "Error: " << re->re().error();
     *error_str = ss.str();
-    delete re;
-    return NULL;
+    return shared_ptr<const CompiledRegex>();
   }
   return re;
 }
 
+// Returns the regex that the prepare function compiled for the constant pattern, or NULL
+// if the pattern is not constant.
+static const CompiledRegex* GetConstantRegex(FunctionContext* context) {
+  shared_ptr<const CompiledRegex>* re =
+      reinterpret_cast<shared_ptr<const CompiledRegex>*>(
+          context->GetFunctionState(FunctionContext::FRAGMENT_LOCAL));
+  return re == NULL ? NULL : re->get();
+}
+
 // This function sets options in the RE2 library before pattern matching.
 bool StringFunctions::SetRE2Options(const StringVal& match_parameter,
     string* error_str, re2::RE2::Options* opts) {
@@ -381,19 +450,20 @@ void StringFunctions::RegexpPrepare(
   if (pattern->is_null) return;
 
   string error_str;
-  re2::RE2* re = CompileRegex(*pattern, &error_str, StringVal::null());
+  shared_ptr<const CompiledRegex> re =
+      CompileRegex(*pattern, &error_str, StringVal::null());
   if (re == NULL) {
     context->SetError(error_str.c_str());
     return;
   }
-  context->SetFunctionState(scope, re);
+  context->SetFunctionState(scope, new shared_ptr<const CompiledRegex>(re));
 }
 
 void StringFunctions::RegexpClose(
     FunctionContext* context, FunctionContext::FunctionStateScope scope) {
   if (scope != FunctionContext::FRAGMENT_LOCAL) return;
-  re2::RE2* re = reinterpret_cast<re2::RE2*>(context->GetFunctionState(scope));
-  delete re;
+  delete reinterpret_cast<shared_ptr<const CompiledRegex>*>(
+      context->GetFunctionState(scope));
 }
 
 StringVal StringFunctions::RegexpExtract(FunctionContext* context, const StringVal& str,
@@ -401,28 +471,28 @@ StringVal StringFunctions::RegexpExtract(FunctionContext* context, const StringV
   if (str.is_null || pattern.is_null || index.is_null) return StringVal::null();
   if (index.val < 0) return StringVal();
 
-  re2::RE2* re = reinterpret_cast<re2::RE2*>(
-      context->GetFunctionState(FunctionContext::FRAGMENT_LOCAL));
-  scoped_ptr<re2::RE2> scoped_re; // destroys re if we have to locally compile it
+  const CompiledRegex* re = GetConstantRegex(context);
+  shared_ptr<const CompiledRegex> local_re; // holds re if we have to locally compile it
   if (re == NULL) {
     DCHECK(!context->IsArgConstant(1));
     string error_str;
-    re = CompileRegex(pattern, &error_str, StringVal::null());
-    if (re == NULL) {
+    local_re = CompileRegex(pattern, &error_str, StringVal::null());
+    if (local_re == NULL) {
       context->AddWarning(error_str.c_str());
       return StringVal::null();
     }
-    scoped_re.reset(re);
+    re = local_re.get();
   }
 
   re2::StringPiece str_sp(reinterpret_cast<char*>(str.ptr), str.len);
-  int max_matches = 1 + re->NumberOfCapturingGroups();
+  int max_matches = 1 + re->re().NumberOfCapturingGroups();
   if (index.val >= max_matches) return StringVal();
+  if (!re->MayMatch(str_sp.data(), str.len)) return StringVal();
   // Use a vector because clang complains about non-POD varlen arrays
   // TODO: fix this
   vector<re2::StringPiece> matches(max_matches);
-  bool success =
-      re->Match(str_sp, 0, str.len, re2::RE2::UNANCHORED, &matches[0], max_matches);
+  bool success = re->re().Match(
+      str_sp, 0, str.len, re2::RE2::UNANCHORED, &matches[0], max_matches);
   if (!success) return StringVal();
   // matches[0] is the whole string, matches[1] the first group, etc.
   const re2::StringPiece& match = matches[index.val];
@@ -433,24 +503,25 @@ StringVal StringFunctions::RegexpReplace(FunctionContext* context, const StringV
     const StringVal& pattern, const StringVal& replace) {
   if (str.is_null || pattern.is_null || replace.is_null) return StringVal::null();
 
-  re2::RE2* re = reinterpret_cast<re2::RE2*>(
-      context->GetFunctionState(FunctionContext::FRAGMENT_LOCAL));
-  scoped_ptr<re2::RE2> scoped_re; // destroys re if state->re is NULL
+  const CompiledRegex* re = GetConstantRegex(context);
+  shared_ptr<const CompiledRegex> local_re; // holds re if we have to locally compile it
   if (re == NULL) {
     DCHECK(!context->IsArgConstant(1));
     string error_str;
-    re = CompileRegex(pattern, &error_str, StringVal::null());
-    if (re == NULL) {
+    local_re = CompileRegex(pattern, &error_str, StringVal::null());
+    if (local_re == NULL) {
       context->AddWarning(error_str.c_str());
       return StringVal::null();
     }
-    scoped_re.reset(re);
+    re = local_re.get();
   }
+  // Nothing is replaced if the regex can't match.
+  if (!re->MayMatch(reinterpret_cast<char*>(str.ptr), str.len)) return str;
 
   re2::StringPiece replace_str =
       re2::StringPiece(reinterpret_cast<char*>(replace.ptr), replace.len);
   string result_str = AnyValUtil::ToString(str);
-  re2::RE2::GlobalReplace(&result_str, *re, replace_str);
+  re2::RE2::GlobalReplace(&result_str, re->re(), replace_str);
   return AnyValUtil::FromString(context, result_str);
 }
 
@@ -471,13 +542,13 @@ void StringFunctions::RegexpMatchCountPrepare(FunctionContext* context,
     match_parameter = reinterpret_cast<StringVal*>(context->GetConstantArg(3));
   }
   string error_str;
-  re2::RE2* re = CompileRegex(*pattern, &error_str, match_parameter == NULL ?
-      StringVal::null() : *match_parameter);
+  shared_ptr<const CompiledRegex> re = CompileRegex(*pattern, &error_str,
+      match_parameter == NULL ? StringVal::null() : *match_parameter);
   if (re == NULL) {
     context->SetError(error_str.c_str());
     return;
   }
-  context->SetFunctionState(scope, re);
+  context->SetFunctionState(scope, new shared_ptr<const CompiledRegex>(re));
 }
 
 IntVal StringFunctions::RegexpMatchCount2Args(FunctionContext* context,
@@ -502,28 +573,28 @@ IntVal StringFunctions::RegexpMatchCount4Args(FunctionContext* context,
     return IntVal::null();
   }
 
-  re2::RE2* re = reinterpret_cast<re2::RE2*>(
-      context->GetFunctionState(FunctionContext::FRAGMENT_LOCAL));
-  // Destroys re if we have to locally compile it.
-  scoped_ptr<re2::RE2> scoped_re;
+  const CompiledRegex* re = GetConstantRegex(context);
+  // Holds re if we have to locally compile it.
+  shared_ptr<const CompiledRegex> local_re;
   if (re == NULL) {
     DCHECK(!context->IsArgConstant(1) || (context->GetNumArgs() == 4 &&
         !context->IsArgConstant(3)));
     string error_str;
-    re = CompileRegex(pattern, &error_str, match_parameter);
-    if (re == NULL) {
+    local_re = CompileRegex(pattern, &error_str, match_parameter);
+    if (local_re == NULL) {
       context->SetError(error_str.c_str());
       return IntVal::null();
     }
-    scoped_re.reset(re);
+    re = local_re.get();
   }
 
   DCHECK_GE(str.len, offset);
   re2::StringPiece str_sp(reinterpret_cast<char*>(str.ptr), str.len);
+  if (!re->MayMatch(str_sp.data() + offset, str.len - offset)) return IntVal(0);
   int count = 0;
   re2::StringPiece match;
   while (offset <= str.len &&
-      re->Match(str_sp, offset, str.len, re2::RE2::UNANCHORED, &match, 1)) {
+      re->re().Match(str_sp, offset, str.len, re2::RE2::UNANCHORED, &match, 1)) {
     // Empty string is a valid match for pattern with '*'. Start matching at the next
     // character until we reach the end of the string.
     count++;
@@ -790,6 +790,18 @@ IntVal TimestampFunctions::DateDiff(FunctionContext* context,
   return IntVal((ts_value1.date() - ts_value2.date()).days());
 }
 
+void TimestampFunctions::UtcConversionPrepare(FunctionContext* context,
+    FunctionContext::FunctionStateScope scope) {
+  if (scope != FunctionContext::THREAD_LOCAL) return;
+  context->SetFunctionState(scope, new TimezoneOffsetCache());
+}
+
+void TimestampFunctions::UtcConversionClose(FunctionContext* context,
+    FunctionContext::FunctionStateScope scope) {
+  if (scope != FunctionContext::THREAD_LOCAL) return;
+  delete reinterpret_cast<TimezoneOffsetCache*>(context->GetFunctionState(scope));
+}
+
 // This function uses inline asm functions, which we believe to be from the boost library.
 // Inline asm is not currently supported by JIT, so this function should always be run in
 // the interpreted mode. This is handled in ScalarFnCall::GetUdf().
@@ -800,6 +812,15 @@ TimestampVal TimestampFunctions::FromUtc(FunctionContext* context,
   if (!ts_value.HasDateOrTime()) return TimestampVal::null();
 
   const StringValue& tz_string_value = StringValue::FromStringVal(tz_string_val);
+  TimezoneOffsetCache* offset_cache = reinterpret_cast<TimezoneOffsetCache*>(
+      context->GetFunctionState(FunctionContext::THREAD_LOCAL));
+  TimestampValue return_value;
+  TimestampVal return_val;
+  if (offset_cache != NULL &&
+      offset_cache->Lookup(tz_string_value, ts_value, &return_value)) {
+    return_value.ToTimestampVal(&return_val);
+    return return_val;
+  }
   time_zone_ptr timezone = TimezoneDatabase::FindTimezone(
       string(tz_string_value.ptr, tz_string_value.len), ts_value);
   if (timezone == NULL) {
@@ -813,8 +834,10 @@ TimestampVal TimestampFunctions::FromUtc(FunctionContext* context,
   ptime temp;
   ts_value.ToPtime(&temp);
   local_date_time lt(temp, timezone);
-  TimestampValue return_value = lt.local_time();
-  TimestampVal return_val;
+  return_value = lt.local_time();
+  if (offset_cache != NULL) {
+    offset_cache->Update(tz_string_value, timezone, true, ts_value, return_value);
+  }
   return_value.ToTimestampVal(&return_val);
   return return_val;
 }
@@ -829,6 +852,15 @@ TimestampVal TimestampFunctions::ToUtc(FunctionContext* context,
   if (!ts_value.HasDateOrTime()) return TimestampVal::null();
 
   const StringValue& tz_string_value = StringValue::FromStringVal(tz_string_val);
+  TimezoneOffsetCache* offset_cache = reinterpret_cast<TimezoneOffsetCache*>(
+      context->GetFunctionState(FunctionContext::THREAD_LOCAL));
+  TimestampValue return_value;
+  TimestampVal return_val;
+  if (offset_cache != NULL &&
+      offset_cache->Lookup(tz_string_value, ts_value, &return_value)) {
+    return_value.ToTimestampVal(&return_val);
+    return return_val;
+  }
   time_zone_ptr timezone = TimezoneDatabase::FindTimezone(
       string(tz_string_value.ptr, tz_string_value.len), ts_value);
   // This should raise some sort of error or at least null. Hive Just ignores it.
@@ -841,8 +873,10 @@ TimestampVal TimestampFunctions::ToUtc(FunctionContext* context,
 
   local_date_time lt(ts_value.date(), ts_value.time(),
       timezone, local_date_time::NOT_DATE_TIME_ON_ERROR);
-  TimestampValue return_value(lt.utc_time());
-  TimestampVal return_val;
+  return_value = lt.utc_time();
+  if (offset_cache != NULL) {
+    offset_cache->Update(tz_string_value, timezone, false, ts_value, return_value);
+  }
   return_value.ToTimestampVal(&return_val);
   return return_val;
 }
@@ -884,6 +918,66 @@ time_zone_ptr TimezoneDatabase::FindTimezone(const string& tz, const TimestampVa
   return time_zone_ptr();
 }
 
+bool TimezoneOffsetCache::Lookup(const StringValue& tz_name, const TimestampValue& ts,
+    TimestampValue* result) const {
+  if (tz_name_.empty() || tz_name.len != tz_name_.size()) return false;
+  if (memcmp(tz_name.ptr, tz_name_.data(), tz_name.len) != 0) return false;
+  if (!ts.HasDateAndTime()) return false;
+  ptime t;
+  ts.ToPtime(&t);
+  if (t < begin_ || t >= end_) return false;
+  *result = TimestampValue(t + offset_);
+  return true;
+}
+
+void TimezoneOffsetCache::Update(const StringValue& tz_name, const time_zone_ptr& tz,
+    bool to_local, const TimestampValue& ts, const TimestampValue& result) {
+  tz_name_.clear();
+  if (tz_name.len == 0 || !ts.HasDateAndTime() || !result.HasDateAndTime()) return;
+  ptime t;
+  ptime converted;
+  ts.ToPtime(&t);
+  result.ToPtime(&converted);
+
+  // The instants around which the offset may change, in the time of 't'. FindTimezone()
+  // returns a different zone for Moscow before April 2011.
+  ptime transitions[7];
+  int num_transitions = 0;
+  transitions[num_transitions++] = ptime(Date(2011, boost::gregorian::Apr, 1));
+  if (tz->has_dst()) {
+    int year = t.date().year();
+    int max_year = Date(boost::gregorian::max_date_time).year();
+    for (int y = max<int>(year - 1, MIN_YEAR); y <= min(year + 1, max_year); ++y) {
+      ptime dst_start = tz->dst_local_start_time(y);
+      ptime dst_end = tz->dst_local_end_time(y);
+      if (to_local) {
+        dst_start -= tz->base_utc_offset();
+        dst_end -= tz->base_utc_offset() + tz->dst_offset();
+      }
+      transitions[num_transitions++] = dst_start;
+      transitions[num_transitions++] = dst_end;
+    }
+  }
+
+  // The instants above are only exact up to the offsets of the zone, so timestamps within
+  // a day of them are not cached.
+  boost::posix_time::time_duration margin = boost::posix_time::hours(24);
+  ptime begin(boost::posix_time::min_date_time);
+  ptime end(boost::posix_time::max_date_time);
+  for (int i = 0; i < num_transitions; ++i) {
+    if (transitions[i] <= t) {
+      begin = max(begin, transitions[i] + margin);
+    } else {
+      end = min(end, transitions[i] - margin);
+    }
+  }
+  if (t < begin || t >= end) return;
+  tz_name_.assign(tz_name.ptr, tz_name.len);
+  begin_ = begin;
+  end_ = end;
+  offset_ = converted - t;
+}
+
 // Explicit template instantiation is required for proper linking. These functions
 // are only indirectly called via a function pointer provided by the opcode registry
 // which does not trigger implicit template instantiation.
@@ -82,6 +82,14 @@ class TimestampFunctions {
   static StringVal FromUnix(FunctionContext* context, const TIME& unix_time,
       const StringVal& fmt);
 
+  /// Allocate and free the TimezoneOffsetCache used by FromUtc() and ToUtc(). Both
+  /// functions also work without it, at the cost of walking the rules of the timezone
+  /// for every row.
+  static void UtcConversionPrepare(FunctionContext* context,
+      FunctionContext::FunctionStateScope scope);
+  static void UtcConversionClose(FunctionContext* context,
+      FunctionContext::FunctionStateScope scope);
+
   /// Convert a timestamp to or from a particular timezone based time.
   static TimestampVal FromUtc(FunctionContext* context,
     const TimestampVal& ts_val, const StringVal& tz_string_val);
@@ -194,6 +202,33 @@ class TimestampFunctions {
   static const char* SUNDAY;
 };
 
+/// Caches the offset by which FromUtc() or ToUtc() shift timestamps in a timezone, for an
+/// interval of input timestamps in which the offset does not change. The intervals are
+/// bounded by the daylight saving time transitions of the zone, so conversions of
+/// the rows of a table mostly hit the cache and are an interval check and an add.
+class TimezoneOffsetCache {
+ public:
+  /// Returns true if 'ts' converted in the timezone named 'tz_name' is cached, and sets
+  /// 'result' to it.
+  bool Lookup(const StringValue& tz_name, const TimestampValue& ts,
+      TimestampValue* result) const;
+
+  /// Caches the interval around 'ts', which was converted to 'result' in timezone 'tz'
+  /// named 'tz_name'. 'to_local' is true if 'ts' is in UTC and false if 'ts' is in
+  /// the local time of 'tz'. Clears the cache if 'ts' is close to a transition.
+  void Update(const StringValue& tz_name, const boost::local_time::time_zone_ptr& tz,
+      bool to_local, const TimestampValue& ts, const TimestampValue& result);
+
+ private:
+  /// Name of the timezone of the cached interval. Empty if nothing is cached.
+  std::string tz_name_;
+
+  /// Timestamps in [begin_, end_) are converted by adding 'offset_'.
+  boost::posix_time::ptime begin_;
+  boost::posix_time::ptime end_;
+  boost::posix_time::time_duration offset_;
+};
+
 /// Functions to load and access the timestamp database.
 class TimezoneDatabase {
  public:
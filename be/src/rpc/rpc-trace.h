@@ -27,6 +27,7 @@
 
 namespace impala {
 
+class HistogramMetric;
 class Webserver;
 class MetricGroup;
 
@@ -55,6 +56,7 @@ class RpcEventHandler : public apache::thrift::TProcessorEventHandler {
   ///   {
   ///     "name": "BeeswaxService.get_state",
   ///     "summary": " count: 1, last: 0, min: 0, max: 0, mean: 0, stddev: 0",
+  ///     "latency": "Count: 1, 25th %-ile: 52.000us, ...",
   ///     "in_flight": 0
   ///     },
   ///   {
@@ -66,7 +68,7 @@ class RpcEventHandler : public apache::thrift::TProcessorEventHandler {
   /// }
   void ToJson(rapidjson::Value* server, rapidjson::Document* document);
 
-  /// Resets the statistics for a single method
+  /// Resets the statistics for a single method. The latency histograms are not reset.
   void Reset(const std::string& method_name);
 
   /// Resets the statistics for all methods
@@ -83,6 +85,9 @@ class RpcEventHandler : public apache::thrift::TProcessorEventHandler {
     /// Summary statistics for the time taken to respond to this method
     StatsMetric<double>* time_stats;
 
+    /// Histogram of the time taken to respond to this method, for its percentiles.
+    HistogramMetric* latency_histogram;
+
     /// Number of invocations in flight
     AtomicInt32 num_in_flight;
   };
@@ -92,8 +97,8 @@ class RpcEventHandler : public apache::thrift::TProcessorEventHandler {
 
   /// Created per-Rpc invocation
   struct InvocationContext {
-    /// Monotonic milliseconds (typically boot time) when the call started.
-    const int64_t start_time_ms;
+    /// Monotonic nanoseconds (typically boot time) when the call started.
+    const int64_t start_time_ns;
 
     /// Per-connection information, owned by ThriftServer. The lifetime of this struct is
     /// tied to the lifetime of the connection, which is guaranteed to be longer than the
@@ -105,7 +110,7 @@ class RpcEventHandler : public apache::thrift::TProcessorEventHandler {
 
     InvocationContext(int64_t start_time, const ThriftServer::ConnectionContext* cnxn_ctx,
         MethodDescriptor* descriptor)
-        : start_time_ms(start_time), cnxn_ctx(cnxn_ctx), method_descriptor(descriptor) { }
+        : start_time_ns(start_time), cnxn_ctx(cnxn_ctx), method_descriptor(descriptor) { }
   };
 
   /// Protects method_map_ and rpc_counter_
@@ -14,6 +14,7 @@
 
 #include "rpc/thrift-client.h"
 
+#include <poll.h>
 #include <boost/assign.hpp>
 #include <boost/lexical_cast.hpp>
 #include <ostream>
@@ -86,6 +87,16 @@ void ThriftClientImpl::Close() {
   }
 }
 
+bool ThriftClientImpl::IsIdleConnectionOpen() {
+  if (transport_.get() == NULL || !transport_->isOpen()) return false;
+  // An idle connection has nothing to read until the server closes it.
+  struct pollfd fd;
+  fd.fd = socket_->getSocketFD();
+  fd.events = POLLIN;
+  fd.revents = 0;
+  return poll(&fd, 1, 0) == 0;
+}
+
 Status ThriftClientImpl::CreateSocket() {
   if (!ssl_) {
     socket_.reset(new TSocket(address_.hostname, address_.port));
@@ -58,6 +58,12 @@ class ThriftClientImpl {
   /// Close the connection with the remote server. May be called repeatedly.
   void Close();
 
+  /// Returns true if the connection is open and the server has not closed it, e.g.
+  /// because it was restarted. Does not block. Must only be called while no rpc is in
+  /// progress, since any data the server sent is taken as a sign of a broken
+  /// connection.
+  bool IsIdleConnectionOpen();
+
   /// Set receive timeout on the underlying TSocket.
   void setRecvTimeout(int32_t ms) { socket_->setRecvTimeout(ms); }
 
@@ -61,6 +61,7 @@ const static int WRITE_WAIT_MILLIS = 500;
 const static int WRITE_CHECK_INTERVAL_MILLIS = 10;
 
 DECLARE_bool(disk_spill_encryption);
+DECLARE_bool(disk_spill_compression);
 
 namespace impala {
 
@@ -685,6 +686,72 @@ TEST_F(BufferedBlockMgrTest, Pin) {
   TearDownMgrs();
 }
 
+// Test that the block managers free their buffers under process memory pressure and
+// that the spilled blocks can be pinned again.
+TEST_F(BufferedBlockMgrTest, ReleaseMemoryUnderPressure) {
+  int max_num_blocks = 5;
+  const int block_size = 1024;
+  BufferedBlockMgr* block_mgr;
+  BufferedBlockMgr::Client* client;
+  block_mgr = CreateMgrAndClient(0, max_num_blocks, block_size, 0, false,
+      client_tracker_.get(), &client);
+
+  vector<BufferedBlockMgr::Block*> blocks;
+  AllocateBlocks(block_mgr, client, max_num_blocks, &blocks);
+  UnpinBlocks(blocks);
+  WaitForWrites(block_mgr);
+  int64_t consumption = test_env_->block_mgr_parent_tracker()->consumption();
+  EXPECT_EQ(max_num_blocks * block_size, consumption);
+
+  BufferedBlockMgr::ReleaseMemoryUnderPressure();
+  WaitForWrites(block_mgr);
+  EXPECT_LT(test_env_->block_mgr_parent_tracker()->consumption(), consumption);
+
+  PinBlocks(blocks);
+  for (int i = 0; i < blocks.size(); ++i) ValidateBlock(blocks[i], i);
+
+  DeleteBlocks(blocks);
+  TearDownMgrs();
+}
+
+// Test that pinning prefetched blocks returns the data that was written.
+TEST_F(BufferedBlockMgrTest, Prefetch) {
+  int max_num_blocks = 5;
+  const int block_size = 1024;
+  BufferedBlockMgr* block_mgr;
+  BufferedBlockMgr::Client* client;
+  block_mgr = CreateMgrAndClient(0, max_num_blocks, block_size, 0, false,
+      client_tracker_.get(), &client);
+  RuntimeProfile::Counter* prefetches =
+      block_mgr->profile()->GetCounter("BlockPrefetches");
+
+  vector<BufferedBlockMgr::Block*> blocks;
+  AllocateBlocks(block_mgr, client, max_num_blocks, &blocks);
+  UnpinBlocks(blocks);
+  // Evict the blocks by taking their buffers for new blocks.
+  vector<BufferedBlockMgr::Block*> new_blocks;
+  AllocateBlocks(block_mgr, client, max_num_blocks, &new_blocks);
+
+  // Blocks that are pinned or in memory are not prefetched.
+  new_blocks[0]->Prefetch();
+  EXPECT_EQ(prefetches->value(), 0);
+  for (int i = 0; i < blocks.size(); ++i) blocks[i]->Prefetch();
+  EXPECT_EQ(prefetches->value(), max_num_blocks);
+  // A block with a read in flight is not prefetched again.
+  blocks[0]->Prefetch();
+  EXPECT_EQ(prefetches->value(), max_num_blocks);
+
+  DeleteBlocks(new_blocks);
+  for (int i = 0; i < blocks.size(); ++i) {
+    bool pinned;
+    EXPECT_OK(blocks[i]->Pin(&pinned));
+    EXPECT_TRUE(pinned);
+    ValidateBlock(blocks[i], i);
+  }
+  DeleteBlocks(blocks);
+  TearDownMgrs();
+}
+
 // Test the eviction policy of the block mgr. No writes issued until more than
 // the max available buffers are allocated. Writes must be issued in LIFO order.
 TEST_F(BufferedBlockMgrTest, Eviction) {
@@ -947,6 +1014,48 @@ TEST_F(BufferedBlockMgrTest, WriteError) {
   TearDownMgrs();
 }
 
+// Test that the block manager detects encrypted blocks that were modified on disk.
+TEST_F(BufferedBlockMgrTest, EncryptionIntegrityError) {
+  FLAGS_disk_spill_encryption = true;
+  int max_num_buffers = 2;
+  BufferedBlockMgr::Client* client;
+  BufferedBlockMgr* block_mgr = CreateMgrAndClient(0, max_num_buffers, block_size_, 0,
+      false, client_tracker_.get(), &client);
+
+  vector<BufferedBlockMgr::Block*> blocks;
+  AllocateBlocks(block_mgr, client, max_num_buffers, &blocks);
+  UnpinBlocks(blocks);
+  WaitForWrites(block_mgr);
+  // Evict the blocks from memory so that pinning them reads them from disk.
+  vector<BufferedBlockMgr::Block*> evicting_blocks;
+  AllocateBlocks(block_mgr, client, max_num_buffers, &evicting_blocks);
+  DeleteBlocks(evicting_blocks);
+
+  // Flip the first bit of the data of every block.
+  int num_files = 0;
+  for (directory_iterator it(SCRATCH_DIR); it != directory_iterator(); ++it) {
+    FILE* file = fopen(it->path().c_str(), "r+");
+    ASSERT_TRUE(file != NULL);
+    fseek(file, 0, SEEK_END);
+    long file_size = ftell(file);
+    for (long offset = 0; offset < file_size; offset += block_size_) {
+      fseek(file, offset, SEEK_SET);
+      int byte = fgetc(file);
+      fseek(file, offset, SEEK_SET);
+      fputc(byte ^ 1, file);
+    }
+    fclose(file);
+    ++num_files;
+  }
+  EXPECT_GT(num_files, 0);
+  bool pinned;
+  EXPECT_FALSE(blocks[0]->Pin(&pinned).ok());
+
+  DeleteBlocks(blocks);
+  TearDownMgrs();
+  FLAGS_disk_spill_encryption = false;
+}
+
 // Test block manager error handling when temporary file space cannot be allocated to
 // back an unpinned buffer.
 TEST_F(BufferedBlockMgrTest, TmpFileAllocateError) {
@@ -1098,6 +1207,25 @@ TEST_F(BufferedBlockMgrTest, AllocationErrorHandling) {
   }
 }
 
+// Test that the blocks of a single client are striped across all temporary dirs.
+TEST_F(BufferedBlockMgrTest, StripedWrites) {
+  const int num_dirs = 4;
+  vector<string> tmp_dirs = InitMultipleTmpDirs(num_dirs);
+  int max_num_buffers = 2 * num_dirs;
+  BufferedBlockMgr::Client* client;
+  BufferedBlockMgr* block_mgr = CreateMgrAndClient(0, max_num_buffers, block_size_,
+      0, false, client_tracker_.get(), &client);
+  vector<BufferedBlockMgr::Block*> blocks;
+  AllocateBlocks(block_mgr, client, max_num_buffers, &blocks);
+  UnpinBlocks(blocks);
+  WaitForWrites(block_mgr);
+  for (int i = 0; i < tmp_dirs.size(); ++i) {
+    EXPECT_TRUE(FindBlockForDir(blocks, tmp_dirs[i]) != NULL)
+        << "No block was written to " << tmp_dirs[i];
+  }
+  DeleteBlocks(blocks);
+}
+
 // Test that block manager fails cleanly when all directories are inaccessible at runtime.
 TEST_F(BufferedBlockMgrTest, NoDirsAllocationError) {
   vector<string> tmp_dirs = InitMultipleTmpDirs(2);
@@ -1378,6 +1506,80 @@ TEST_F(BufferedBlockMgrTest, Multi4Random_encryption) {
 //   TestRandomInternalMulti(8);
 // }
 
+TEST_F(BufferedBlockMgrTest, SingleRandom_compression) {
+  FLAGS_disk_spill_encryption = false;
+  FLAGS_disk_spill_compression = true;
+  TestRandomInternalSingle(1024);
+  TestRandomInternalSingle(8 * 1024);
+  FLAGS_disk_spill_compression = false;
+}
+
+TEST_F(BufferedBlockMgrTest, Multi4Random_compression) {
+  FLAGS_disk_spill_encryption = false;
+  FLAGS_disk_spill_compression = true;
+  TestRandomInternalMulti(4, 8 * 1024);
+  FLAGS_disk_spill_compression = false;
+}
+
+// Compression is done before encryption and the integrity check.
+TEST_F(BufferedBlockMgrTest, Multi4Random_compression_encryption) {
+  FLAGS_disk_spill_encryption = true;
+  FLAGS_disk_spill_compression = true;
+  TestRandomInternalMulti(4, 8 * 1024);
+  FLAGS_disk_spill_compression = false;
+}
+
+// Test that EnableCompression() only compresses the blocks of that client.
+TEST_F(BufferedBlockMgrTest, ClientCompression) {
+  FLAGS_disk_spill_encryption = false;
+  FLAGS_disk_spill_compression = false;
+  int max_num_blocks = 4;
+  const int block_size = 1024;
+  BufferedBlockMgr::Client* compressed_client;
+  BufferedBlockMgr::Client* plain_client;
+  RuntimeState* state;
+  BufferedBlockMgr* block_mgr = CreateMgrAndClient(0, max_num_blocks, block_size, 0,
+      false, client_tracker_.get(), &compressed_client, &state);
+  EXPECT_OK(block_mgr->RegisterClient("plain", 0, false, client_tracker_.get(), state,
+      &plain_client));
+  EXPECT_OK(block_mgr->EnableCompression(compressed_client));
+
+  // Fill the blocks with a repeated byte, which compresses well.
+  vector<BufferedBlockMgr::Block*> blocks;
+  for (int i = 0; i < max_num_blocks; ++i) {
+    BufferedBlockMgr::Block* block;
+    EXPECT_OK(block_mgr->GetNewBlock(i % 2 == 0 ? compressed_client : plain_client, NULL,
+        &block));
+    ASSERT_TRUE(block != NULL);
+    memset(block->Allocate<uint8_t>(block_size), i, block_size);
+    blocks.push_back(block);
+  }
+  UnpinBlocks(blocks);
+  // Evict the blocks by taking their buffers for new blocks.
+  vector<BufferedBlockMgr::Block*> new_blocks;
+  AllocateBlocks(block_mgr, compressed_client, max_num_blocks, &new_blocks);
+  WaitForWrites(block_mgr);
+
+  RuntimeProfile::Counter* uncompressed_bytes =
+      block_mgr->profile()->GetCounter("UncompressedBytesWritten");
+  RuntimeProfile::Counter* bytes_written =
+      block_mgr->profile()->GetCounter("BytesWritten");
+  ASSERT_TRUE(uncompressed_bytes != NULL);
+  EXPECT_EQ(uncompressed_bytes->value(), max_num_blocks / 2 * block_size);
+  EXPECT_LT(bytes_written->value(), max_num_blocks * block_size);
+  EXPECT_GT(bytes_written->value(), max_num_blocks / 2 * block_size);
+
+  DeleteBlocks(new_blocks);
+  for (int i = 0; i < blocks.size(); ++i) {
+    bool pinned;
+    EXPECT_OK(blocks[i]->Pin(&pinned));
+    EXPECT_TRUE(pinned);
+    EXPECT_EQ(blocks[i]->valid_data_len(), block_size);
+    for (int j = 0; j < block_size; ++j) EXPECT_EQ(blocks[i]->buffer()[j], i);
+  }
+  DeleteBlocks(blocks);
+  TearDownMgrs();
+}
 
 TEST_F(BufferedBlockMgrTest, CreateDestroyMulti) {
   CreateDestroyMulti();
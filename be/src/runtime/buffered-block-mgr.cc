@@ -17,9 +17,11 @@
 #include "runtime/mem-pool.h"
 #include "runtime/buffered-block-mgr.h"
 #include "runtime/tmp-file-mgr.h"
+#include "util/codec.h"
 #include "util/runtime-profile-counters.h"
 #include "util/disk-info.h"
 #include "util/filesystem-util.h"
+#include "util/histogram-metric.h"
 #include "util/impalad-metrics.h"
 #include "util/uid-util.h"
 
@@ -27,14 +29,32 @@
 #include <openssl/evp.h>
 #include <openssl/sha.h>
 #include <openssl/err.h>
+#include <openssl/opensslv.h>
 
 #include <gutil/strings/substitute.h>
 
 DEFINE_bool(disk_spill_encryption, false, "Set this to encrypt and perform an integrity "
   "check on all data spilled to disk during a query");
+DEFINE_bool(disk_spill_compression, false, "Set this to compress all data spilled to "
+  "disk during a query with LZ4");
+
+DEFINE_bool(spill_under_process_memory_pressure, true, "If true, the block managers of "
+  "all running queries free their unused buffers and write their unpinned blocks to "
+  "disk when the process memory limit is reached, before allocations fail.");
 
 #include "common/names.h"
 
+// AES-GCM, which encrypts and authenticates blocks in a single pass, is available through
+// EVP since OpenSSL 1.0.1. Older versions use AES-CFB and a separate SHA-256 hash.
+#if OPENSSL_VERSION_NUMBER >= 0x10001000L
+#define SPILL_USE_AES_GCM 1
+static const bool USE_AES_GCM = true;
+// Length of the GCM nonce: the first bytes of the IV of the block.
+static const int GCM_IV_LENGTH = 12;
+#else
+static const bool USE_AES_GCM = false;
+#endif
+
 using namespace strings;   // for Substitute
 
 namespace impala {
@@ -56,7 +76,8 @@ struct BufferedBlockMgr::Client {
         tolerates_oversubscription_(tolerates_oversubscription),
         num_tmp_reserved_buffers_(0),
         num_pinned_buffers_(0),
-        logged_large_allocation_warning_(false) {
+        logged_large_allocation_warning_(false),
+        compress_spilled_blocks_(mgr->compression_) {
     DCHECK(tracker != NULL);
   }
 
@@ -100,6 +121,10 @@ struct BufferedBlockMgr::Client {
   /// to avoid producing excessive log messages.
   bool logged_large_allocation_warning_;
 
+  /// True if the blocks of this client are compressed when they are written to disk.
+  /// Set by --disk_spill_compression or EnableCompression().
+  bool compress_spilled_blocks_;
+
   void PinBuffer(BufferDescriptor* buffer) {
     DCHECK(buffer != NULL);
     if (buffer->len == mgr_->max_block_size()) {
@@ -135,8 +160,14 @@ BufferedBlockMgr::Block::Block(BufferedBlockMgr* block_mgr)
     client_(NULL),
     write_range_(NULL),
     tmp_file_(NULL),
+    tmp_file_idx_(-1),
+    prefetch_range_(NULL),
+    is_compressed_(false),
+    scratch_len_(0),
+    scratch_offset_(0),
     valid_data_len_(0),
-    num_rows_(0) {
+    num_rows_(0),
+    write_start_ns_(0) {
 }
 
 Status BufferedBlockMgr::Block::Pin(bool* pinned, Block* release_block, bool unpin) {
@@ -147,6 +178,10 @@ Status BufferedBlockMgr::Block::Unpin() {
   return block_mgr_->UnpinBlock(this);
 }
 
+void BufferedBlockMgr::Block::Prefetch() {
+  block_mgr_->PrefetchBlock(this);
+}
+
 void BufferedBlockMgr::Block::Delete() {
   block_mgr_->DeleteBlock(this);
 }
@@ -217,11 +252,18 @@ BufferedBlockMgr::BufferedBlockMgr(RuntimeState* state, TmpFileMgr* tmp_file_mgr
     unfullfilled_reserved_buffers_(0),
     total_pinned_buffers_(0),
     non_local_outstanding_writes_(0),
+    num_buffers_to_free_(0),
     io_mgr_(state->io_mgr()),
     is_cancelled_(false),
     writes_issued_(0),
+    compression_timer_(NULL),
+    uncompressed_bytes_written_counter_(NULL),
+    compression_ratio_counter_(NULL),
     encryption_(FLAGS_disk_spill_encryption),
-    check_integrity_(FLAGS_disk_spill_encryption) {
+    check_integrity_(FLAGS_disk_spill_encryption && !USE_AES_GCM),
+    compression_(FLAGS_disk_spill_compression) {
+  scratch_usage_.reset(new TmpFileMgr::QueryScratchUsage(query_id_,
+      state->fragment_ctx().request_pool));
 }
 
 Status BufferedBlockMgr::Create(RuntimeState* state, MemTracker* parent,
@@ -242,8 +284,7 @@ Status BufferedBlockMgr::Create(RuntimeState* state, MemTracker* parent,
       query_to_block_mgrs_[state->query_id()] = *block_mgr;
     }
   }
-  (*block_mgr)->Init(state->io_mgr(), profile, parent, mem_limit);
-  return Status::OK();
+  return (*block_mgr)->Init(state->io_mgr(), profile, parent, mem_limit);
 }
 
 int64_t BufferedBlockMgr::available_buffers(Client* client) const {
@@ -273,6 +314,13 @@ Status BufferedBlockMgr::RegisterClient(const string& debug_info,
   return Status::OK();
 }
 
+Status BufferedBlockMgr::EnableCompression(Client* client) {
+  lock_guard<mutex> lock(lock_);
+  RETURN_IF_ERROR(InitCompression());
+  client->compress_spilled_blocks_ = true;
+  return Status::OK();
+}
+
 void BufferedBlockMgr::ClearReservations(Client* client) {
   lock_guard<mutex> lock(lock_);
   // TODO: Can the modifications to the client's mem variables can be made w/o the lock?
@@ -391,6 +439,64 @@ void BufferedBlockMgr::ReleaseMemory(Client* client, int64_t size) {
   client->tracker_->ReleaseLocal(size, client->query_tracker_);
 }
 
+void BufferedBlockMgr::ReleaseMemoryUnderPressure() {
+  if (!FLAGS_spill_under_process_memory_pressure) return;
+  vector<shared_ptr<BufferedBlockMgr> > block_mgrs;
+  {
+    lock_guard<SpinLock> lock(static_block_mgrs_lock_);
+    for (const BlockMgrsMap::value_type& entry: query_to_block_mgrs_) {
+      shared_ptr<BufferedBlockMgr> mgr = entry.second.lock();
+      if (mgr.get() != NULL) block_mgrs.push_back(mgr);
+    }
+  }
+  for (const shared_ptr<BufferedBlockMgr>& mgr: block_mgrs) mgr->SpillUnderPressure();
+}
+
+void BufferedBlockMgr::SpillUnderPressure() {
+  // The calling thread may be allocating memory while it holds lock_.
+  unique_lock<mutex> lock(lock_, try_to_lock);
+  if (!lock.owns_lock() || !initialized_ || is_cancelled_ || disable_spill_) return;
+
+  int num_freed = 0;
+  while (!free_io_buffers_.empty()) {
+    FreeIoBuffer(free_io_buffers_.Dequeue());
+    ++num_freed;
+  }
+  int num_written = 0;
+  while (!unpinned_blocks_.empty()) {
+    Block* write_block = unpinned_blocks_.PopBack();
+    write_block->client_local_ = false;
+    Status status = WriteUnpinnedBlock(write_block);
+    if (!status.ok()) {
+      // Handle the error like a failed write: the query fails the next time it calls
+      // into the block manager.
+      VLOG_QUERY << "Query: " << query_id_ << " error while writing unpinned blocks "
+                 << "under memory pressure.";
+      write_block->client_->state_->LogError(status.msg());
+      is_cancelled_ = true;
+      buffer_available_cv_.notify_all();
+      break;
+    }
+    ++non_local_outstanding_writes_;
+    ++num_buffers_to_free_;
+    ++num_written;
+  }
+  if (num_freed > 0 || num_written > 0) {
+    VLOG_QUERY << "Query: " << query_id_ << " freed " << num_freed << " buffers and "
+               << "started writing " << num_written << " blocks under memory pressure";
+  }
+  DCHECK(is_cancelled_ || Validate()) << endl << DebugInternal();
+}
+
+void BufferedBlockMgr::FreeIoBuffer(BufferDescriptor* buffer_desc) {
+  DCHECK_EQ(buffer_desc->len, max_block_size_);
+  all_io_buffers_.erase(buffer_desc->all_buffers_it);
+  if (buffer_desc->block != NULL) buffer_desc->block->buffer_desc_ = NULL;
+  delete[] buffer_desc->buffer;
+  buffer_desc->buffer = NULL;
+  mem_tracker_->Release(max_block_size_);
+}
+
 void BufferedBlockMgr::Cancel() {
   {
     lock_guard<mutex> lock(lock_);
@@ -619,11 +725,16 @@ Status BufferedBlockMgr::PinBlock(Block* block, bool* pinned, Block* release_blo
   DCHECK(block != NULL);
   DCHECK(!block->is_deleted_);
   Status status;
+  // The data of the block as read from disk. A compressed block is read into
+  // 'compressed_data' and then decompressed into buffer().
+  uint8_t* disk_data = NULL;
+  boost::scoped_array<uint8_t> compressed_data;
   *pinned = false;
   if (block->is_pinned_) {
     *pinned = true;
     return DeleteOrUnpinBlock(release_block, unpin);
   }
+  ScopedHistogramTimer pin_latency(ImpaladMetrics::BUFFERED_BLOCK_MGR_PIN_LATENCY);
 
   bool in_mem = false;
   status = FindBufferForBlock(block, &in_mem);
@@ -673,40 +784,54 @@ Status BufferedBlockMgr::PinBlock(Block* block, bool* pinned, Block* release_blo
   {
     // Read the block from disk if it was not in memory.
     SCOPED_TIMER(disk_read_timer_);
-    // Create a ScanRange to perform the read.
-    DiskIoMgr::ScanRange* scan_range =
-        obj_pool_.Add(new DiskIoMgr::ScanRange());
-    scan_range->Reset(NULL, block->write_range_->file(), block->write_range_->len(),
-        block->write_range_->offset(), block->write_range_->disk_id(), false, block,
-        DiskIoMgr::ScanRange::NEVER_CACHE);
-    vector<DiskIoMgr::ScanRange*> ranges(1, scan_range);
-    status = io_mgr_->AddScanRanges(io_request_context_, ranges, true);
-    if (!status.ok()) goto error;
+    // Use the read issued by Prefetch() if there is one.
+    DiskIoMgr::ScanRange* scan_range;
+    {
+      lock_guard<mutex> lock(lock_);
+      scan_range = block->prefetch_range_;
+      block->prefetch_range_ = NULL;
+    }
+    if (scan_range == NULL) {
+      status = IssueRead(block, &scan_range);
+      if (!status.ok()) goto error;
+    }
 
     // Read from the io mgr buffer into the block's assigned buffer.
+    if (block->is_compressed_) {
+      compressed_data.reset(new uint8_t[block->write_range_->len()]);
+      disk_data = compressed_data.get();
+    } else {
+      disk_data = block->buffer();
+    }
     int64_t offset = 0;
     bool buffer_eosr;
     do {
       DiskIoMgr::BufferDescriptor* io_mgr_buffer;
       status = scan_range->GetNext(&io_mgr_buffer);
       if (!status.ok()) goto error;
-      memcpy(block->buffer() + offset, io_mgr_buffer->buffer(), io_mgr_buffer->len());
+      memcpy(disk_data + offset, io_mgr_buffer->buffer(), io_mgr_buffer->len());
       offset += io_mgr_buffer->len();
       buffer_eosr = io_mgr_buffer->eosr();
       io_mgr_buffer->Return();
     } while (!buffer_eosr);
     DCHECK_EQ(offset, block->write_range_->len());
+    bytes_read_counter_->Add(offset);
   }
 
   // Verify integrity first, because the hash was generated from encrypted data.
   if (check_integrity_) {
-    status = VerifyHash(block);
+    status = VerifyHash(block, disk_data, block->write_range_->len());
     if (!status.ok()) goto error;
   }
 
   // Decryption is done in-place, since the buffer can't be accessed by anyone else.
   if (encryption_) {
-    status = Decrypt(block);
+    status = Decrypt(block, disk_data, block->write_range_->len());
+    if (!status.ok()) goto error;
+  }
+
+  if (block->is_compressed_) {
+    status = Decompress(block, disk_data, block->write_range_->len());
     if (!status.ok()) goto error;
   }
 
@@ -719,6 +844,40 @@ error:
   return status;
 }
 
+Status BufferedBlockMgr::IssueRead(Block* block, DiskIoMgr::ScanRange** scan_range) {
+  DCHECK(block->write_range_ != NULL);
+  // Create a ScanRange to perform the read.
+  *scan_range = obj_pool_.Add(new DiskIoMgr::ScanRange());
+  (*scan_range)->Reset(block->tmp_file_->remote_conn(), block->write_range_->file(),
+      block->write_range_->len(), block->write_range_->offset(),
+      block->write_range_->disk_id(), false, block, DiskIoMgr::ScanRange::NEVER_CACHE);
+  vector<DiskIoMgr::ScanRange*> ranges(1, *scan_range);
+  return io_mgr_->AddScanRanges(io_request_context_, ranges, true);
+}
+
+void BufferedBlockMgr::PrefetchBlock(Block* block) {
+  DCHECK(block != NULL);
+  lock_guard<mutex> lock(lock_);
+  DCHECK(!block->is_deleted_);
+  // Only blocks whose data is only on disk need to be read.
+  if (is_cancelled_ || block->is_pinned_ || block->buffer_desc_ != NULL ||
+      block->write_range_ == NULL || block->valid_data_len_ == 0 ||
+      block->prefetch_range_ != NULL) {
+    return;
+  }
+  DCHECK(!block->in_write_);
+  DiskIoMgr::ScanRange* scan_range;
+  Status status = IssueRead(block, &scan_range);
+  if (!status.ok()) {
+    // Leave it to PinBlock() to issue the read again and return the error.
+    VLOG_FILE << "Query: " << query_id_ << ". Could not prefetch block: "
+              << status.GetDetail();
+    return;
+  }
+  block->prefetch_range_ = scan_range;
+  prefetch_counter_->Add(1);
+}
+
 Status BufferedBlockMgr::UnpinBlock(Block* block) {
   DCHECK(!block->is_deleted_) << "Unpin for deleted block.";
 
@@ -766,46 +925,82 @@ Status BufferedBlockMgr::WriteUnpinnedBlock(Block* block) {
   DCHECK(!block->in_write_) << block->DebugString();
   DCHECK_EQ(block->buffer_desc_->len, max_block_size_);
 
-  if (block->write_range_ == NULL) {
+  // A prefetched read could return the data that is about to be overwritten.
+  if (block->prefetch_range_ != NULL) {
+    block->prefetch_range_->Cancel(Status::CANCELLED);
+    block->prefetch_range_ = NULL;
+  }
+
+  uint8_t* outbuf = block->buffer();
+  int64_t write_len = block->valid_data_len_;
+  bool compress = block->client_->compress_spilled_blocks_;
+  if (compress) RETURN_IF_ERROR(Compress(block, &outbuf, &write_len));
+
+  // Compressed blocks take only as much scratch space as their data. The space of
+  // an uncompressed block fits any later version of the block.
+  if (block->scratch_len_ == 0 || write_len > block->scratch_len_) {
     if (tmp_files_.empty()) RETURN_IF_ERROR(InitTmpFiles());
 
-    // First time the block is being persisted - need to allocate tmp file space.
-    TmpFileMgr::File* tmp_file;
+    // First time the block is being persisted since it was created, or the block
+    // outgrew its compressed size - need to allocate tmp file space. The space that
+    // the block outgrew is reused by other blocks.
+    FreeScratchSpace(block);
+    int64_t scratch_len = compress ? write_len : max_block_size_;
+    int tmp_file_idx;
     int64_t file_offset;
-    RETURN_IF_ERROR(AllocateScratchSpace(max_block_size_, &tmp_file, &file_offset));
-    int disk_id = tmp_file->disk_id();
-    if (disk_id < 0) {
+    RETURN_IF_ERROR(AllocateScratchSpace(scratch_len, &tmp_file_idx, &file_offset));
+    TmpFileMgr::File* tmp_file = &tmp_files_[tmp_file_idx];
+    string range_path;
+    int64_t range_offset;
+    tmp_file->GetRangeLocation(file_offset, &range_path, &range_offset);
+    int disk_id;
+    if (tmp_file->is_remote()) {
+      disk_id = io_mgr_->AssignQueue(range_path.c_str(), -1, false);
+    } else {
       // Assign a valid disk id to the write range if the tmp file was not assigned one.
-      static unsigned int next_disk_id = 0;
-      disk_id = ++next_disk_id;
+      // Use the index of the file so that the writes to different files are queued on
+      // different disks and issued concurrently.
+      disk_id = tmp_file->disk_id() < 0 ? tmp_file_idx : tmp_file->disk_id();
+      disk_id %= io_mgr_->num_local_disks();
     }
-    disk_id %= io_mgr_->num_local_disks();
     DiskIoMgr::WriteRange::WriteDoneCallback callback =
         bind(mem_fn(&BufferedBlockMgr::WriteComplete), this, block, _1);
-    block->write_range_ = obj_pool_.Add(new DiskIoMgr::WriteRange(
-        tmp_file->path(), file_offset, disk_id, callback));
+    if (block->write_range_ == NULL) {
+      block->write_range_ = obj_pool_.Add(new DiskIoMgr::WriteRange(
+          range_path, range_offset, disk_id, callback));
+    } else {
+      block->write_range_->SetRange(range_path, range_offset, disk_id);
+    }
     block->tmp_file_ = tmp_file;
+    block->tmp_file_idx_ = tmp_file_idx;
+    block->scratch_len_ = scratch_len;
+    block->scratch_offset_ = file_offset;
   }
 
-  uint8_t* outbuf = NULL;
   if (encryption_) {
     // The block->buffer() could be accessed during the write path, so we have to
     // make a copy of it while writing.
-    RETURN_IF_ERROR(Encrypt(block, &outbuf));
-  } else {
-    outbuf = block->buffer();
+    RETURN_IF_ERROR(Encrypt(block, outbuf, write_len, &outbuf));
   }
 
-  if (check_integrity_) SetHash(block);
+  if (check_integrity_) SetHash(block, outbuf, write_len);
 
-  block->write_range_->SetData(outbuf, block->valid_data_len_);
+  block->write_range_->SetData(outbuf, write_len);
 
   // Issue write through DiskIoMgr.
+  block->write_start_ns_ = MonotonicNanos();
   RETURN_IF_ERROR(io_mgr_->AddWriteRange(io_request_context_, block->write_range_));
   block->in_write_ = true;
   DCHECK(block->Validate()) << endl << block->DebugString();
   outstanding_writes_counter_->Add(1);
-  bytes_written_counter_->Add(block->valid_data_len_);
+  ++tmp_file_outstanding_writes_[block->tmp_file_idx_];
+  bytes_written_counter_->Add(write_len);
+  if (compress) {
+    uncompressed_bytes_written_counter_->Add(block->valid_data_len_);
+    compression_ratio_counter_->Set(
+        static_cast<double>(uncompressed_bytes_written_counter_->value()) /
+        max<int64_t>(bytes_written_counter_->value(), 1));
+  }
   ++writes_issued_;
   if (writes_issued_ == 1) {
     if (ImpaladMetrics::NUM_QUERIES_SPILLED != NULL) {
@@ -815,16 +1010,35 @@ Status BufferedBlockMgr::WriteUnpinnedBlock(Block* block) {
   return Status::OK();
 }
 
-Status BufferedBlockMgr::AllocateScratchSpace(int64_t block_size,
-    TmpFileMgr::File** tmp_file, int64_t* file_offset) {
+Status BufferedBlockMgr::AllocateScratchSpace(int64_t block_size, int* tmp_file_idx,
+    int64_t* file_offset) {
   // Assumes block manager lock is already taken.
   vector<Status> errs;
-  // Find the next physical file in round-robin order and create a write range for it.
+  vector<bool> tried(tmp_files_.size(), false);
   for (int attempt = 0; attempt < tmp_files_.size(); ++attempt) {
-    *tmp_file = &tmp_files_[next_block_index_];
-    next_block_index_ = (next_block_index_ + 1) % tmp_files_.size();
-    if ((*tmp_file)->is_blacklisted()) continue;
-    Status status = (*tmp_file)->AllocateSpace(max_block_size_, file_offset);
+    // Find the least busy usable file that was not tried yet. Start the search at
+    // next_block_index_ so that idle files are used in round-robin order. Remote files
+    // are only used if no local file can take the block.
+    *tmp_file_idx = -1;
+    for (int i = 0; i < tmp_files_.size(); ++i) {
+      int idx = (next_block_index_ + i) % tmp_files_.size();
+      if (tried[idx] || tmp_files_[idx].is_blacklisted()) continue;
+      if (*tmp_file_idx != -1) {
+        bool remote = tmp_files_[idx].is_remote();
+        bool best_remote = tmp_files_[*tmp_file_idx].is_remote();
+        if (remote != best_remote) {
+          if (remote) continue;
+        } else if (tmp_file_outstanding_writes_[idx] >=
+            tmp_file_outstanding_writes_[*tmp_file_idx]) {
+          continue;
+        }
+      }
+      *tmp_file_idx = idx;
+    }
+    if (*tmp_file_idx == -1) break;
+    tried[*tmp_file_idx] = true;
+    next_block_index_ = (*tmp_file_idx + 1) % tmp_files_.size();
+    Status status = tmp_files_[*tmp_file_idx].AllocateSpace(block_size, file_offset);
     if (status.ok()) return Status::OK();
     // Log error and try other files if there was a problem. Problematic files will be
     // blacklisted so we will not repeatedly log the same error.
@@ -844,6 +1058,8 @@ void BufferedBlockMgr::WriteComplete(Block* block, const Status& write_status) {
   Status status = Status::OK();
   lock_guard<mutex> lock(lock_);
   outstanding_writes_counter_->Add(-1);
+  DCHECK_GT(tmp_file_outstanding_writes_[block->tmp_file_idx_], 0);
+  --tmp_file_outstanding_writes_[block->tmp_file_idx_];
   DCHECK(Validate()) << endl << DebugInternal();
   DCHECK(is_cancelled_ || block->in_write_) << "WriteComplete() for block not in write."
                                             << endl << block->DebugString();
@@ -852,10 +1068,15 @@ void BufferedBlockMgr::WriteComplete(Block* block, const Status& write_status) {
     --non_local_outstanding_writes_;
   }
   block->in_write_ = false;
+  if (ImpaladMetrics::BUFFERED_BLOCK_MGR_WRITE_LATENCY != NULL) {
+    ImpaladMetrics::BUFFERED_BLOCK_MGR_WRITE_LATENCY->Update(
+        MonotonicNanos() - block->write_start_ns_);
+  }
 
   // Explicitly release our temporarily allocated buffer here so that it doesn't
   // hang around needlessly.
   if (encryption_) EncryptDone(block);
+  block->compressed_write_buffer_.reset();
 
   // ReturnUnusedBlock() will clear the block, so save required state in local vars.
   // state is not valid if the block was deleted because the state may be torn down
@@ -880,10 +1101,18 @@ void BufferedBlockMgr::WriteComplete(Block* block, const Status& write_status) {
   } else {
     DCHECK_EQ(block->buffer_desc_->len, max_block_size_)
         << "Only io sized buffers should spill";
-    free_io_buffers_.Enqueue(block->buffer_desc_);
+    // Keep enough free buffers for clients that wait for one in FindBuffer().
+    bool free_buffer = num_buffers_to_free_ > 0 &&
+        free_io_buffers_.size() >= block_write_threshold_;
+    if (num_buffers_to_free_ > 0) --num_buffers_to_free_;
+    if (free_buffer) {
+      FreeIoBuffer(block->buffer_desc_);
+    } else {
+      free_io_buffers_.Enqueue(block->buffer_desc_);
+    }
     // Finish the DeleteBlock() work.
     if (block->is_deleted_) {
-      block->buffer_desc_->block = NULL;
+      if (block->buffer_desc_ != NULL) block->buffer_desc_->block = NULL;
       block->buffer_desc_ = NULL;
       ReturnUnusedBlock(block);
       block = NULL;
@@ -930,6 +1159,11 @@ void BufferedBlockMgr::DeleteBlockLocked(const unique_lock<mutex>& lock, Block*
   DCHECK(!block->is_deleted_);
   block->is_deleted_ = true;
 
+  if (block->prefetch_range_ != NULL) {
+    block->prefetch_range_->Cancel(Status::CANCELLED);
+    block->prefetch_range_ = NULL;
+  }
+
   if (block->is_pinned_) {
     if (block->is_max_size()) --total_pinned_buffers_;
     block->is_pinned_ = false;
@@ -971,10 +1205,20 @@ void BufferedBlockMgr::DeleteBlockLocked(const unique_lock<mutex>& lock, Block*
   DCHECK(Validate()) << endl << DebugInternal();
 }
 
+void BufferedBlockMgr::FreeScratchSpace(Block* block) {
+  if (block->scratch_len_ == 0) return;
+  DCHECK(block->write_range_ != NULL);
+  DCHECK(!block->in_write_);
+  block->tmp_file_->FreeSpace(block->scratch_offset_, block->scratch_len_);
+  block->scratch_len_ = 0;
+}
+
 void BufferedBlockMgr::ReturnUnusedBlock(Block* block) {
   DCHECK(block->is_deleted_) << block->DebugString();
   DCHECK(!block->is_pinned_) << block->DebugString();;
   DCHECK(block->buffer_desc_ == NULL);
+  // Keep write_range_ so that it is reused when the block object is reused.
+  FreeScratchSpace(block);
   block->Init();
   unused_blocks_.Enqueue(block);
 }
@@ -1268,10 +1512,10 @@ string BufferedBlockMgr::DebugInternal() const {
   return ss.str();
 }
 
-void BufferedBlockMgr::Init(DiskIoMgr* io_mgr, RuntimeProfile* parent_profile,
+Status BufferedBlockMgr::Init(DiskIoMgr* io_mgr, RuntimeProfile* parent_profile,
     MemTracker* parent_tracker, int64_t mem_limit) {
   unique_lock<mutex> l(lock_);
-  if (initialized_) return;
+  if (initialized_) return Status::OK();
 
   io_mgr->RegisterContext(&io_request_context_);
   if (encryption_) {
@@ -1295,16 +1539,20 @@ void BufferedBlockMgr::Init(DiskIoMgr* io_mgr, RuntimeProfile* parent_profile,
   outstanding_writes_counter_ =
       ADD_COUNTER(profile_.get(), "BlockWritesOutstanding", TUnit::UNIT);
   buffered_pin_counter_ = ADD_COUNTER(profile_.get(), "BufferedPins", TUnit::UNIT);
+  prefetch_counter_ = ADD_COUNTER(profile_.get(), "BlockPrefetches", TUnit::UNIT);
   disk_read_timer_ = ADD_TIMER(profile_.get(), "TotalReadBlockTime");
+  bytes_read_counter_ = ADD_COUNTER(profile_.get(), "BytesRead", TUnit::BYTES);
   buffer_wait_timer_ = ADD_TIMER(profile_.get(), "TotalBufferWaitTime");
   encryption_timer_ = ADD_TIMER(profile_.get(), "TotalEncryptionTime");
   integrity_check_timer_ = ADD_TIMER(profile_.get(), "TotalIntegrityCheckTime");
+  if (compression_) RETURN_IF_ERROR(InitCompression());
 
   // Create a new mem_tracker and allocate buffers.
   mem_tracker_.reset(new MemTracker(
       profile(), mem_limit, -1, "Block Manager", parent_tracker));
 
   initialized_ = true;
+  return Status::OK();
 }
 
 Status BufferedBlockMgr::InitTmpFiles() {
@@ -1319,9 +1567,11 @@ Status BufferedBlockMgr::InitTmpFiles() {
     TmpFileMgr::DeviceId tmp_device_id = tmp_devices[i];
     // It is possible for a device to be blacklisted after it was returned
     // by active_tmp_devices() - handle this gracefully.
-    Status status = tmp_file_mgr_->GetFile(tmp_device_id, query_id_, &tmp_file);
+    Status status = tmp_file_mgr_->GetFile(tmp_device_id, query_id_, &tmp_file,
+        scratch_usage_.get());
     if (status.ok()) tmp_files_.push_back(tmp_file);
   }
+  tmp_file_outstanding_writes_.resize(tmp_files_.size(), 0);
   if (tmp_files_.empty()) {
     return Status("No spilling directories configured. Cannot spill. Set --scratch_dirs"
         " or see log for previous errors that prevented use of provided directories");
@@ -1346,51 +1596,142 @@ static Status OpenSSLErr(const string& msg) {
   return Status(Substitute("Openssl Error: $0", errstream.str()));
 }
 
-Status BufferedBlockMgr::Encrypt(Block* block, uint8_t** outbuf) {
-  DCHECK(encryption_);
+Status BufferedBlockMgr::InitCompression() {
+  if (compressor_ != NULL) return Status::OK();
+  RETURN_IF_ERROR(Codec::CreateCompressor(NULL, false, THdfsCompression::LZ4,
+      &compressor_));
+  RETURN_IF_ERROR(Codec::CreateDecompressor(NULL, false, THdfsCompression::LZ4,
+      &decompressor_));
+  compression_timer_ = ADD_TIMER(profile_.get(), "TotalCompressionTime");
+  uncompressed_bytes_written_counter_ =
+      ADD_COUNTER(profile_.get(), "UncompressedBytesWritten", TUnit::BYTES);
+  compression_ratio_counter_ =
+      ADD_COUNTER(profile_.get(), "CompressionRatio", TUnit::DOUBLE_VALUE);
+  return Status::OK();
+}
+
+Status BufferedBlockMgr::Compress(Block* block, uint8_t** outbuf, int64_t* len) {
+  DCHECK(compressor_ != NULL);
+  DCHECK(block->buffer());
+  DCHECK(!block->is_pinned_);
+  DCHECK(!block->in_write_);
+  SCOPED_TIMER(compression_timer_);
+
+  int64_t compressed_len = compressor_->MaxOutputLen(block->valid_data_len_);
+  block->compressed_write_buffer_.reset(new uint8_t[compressed_len]);
+  uint8_t* compressed_data = block->compressed_write_buffer_.get();
+  RETURN_IF_ERROR(compressor_->ProcessBlock(true, block->valid_data_len_,
+      block->buffer(), &compressed_len, &compressed_data));
+  // LZ4 returns a length of 0 if it failed. Write the block uncompressed in that case
+  // and if compressing did not save any space.
+  block->is_compressed_ = compressed_len > 0 && compressed_len < block->valid_data_len_;
+  if (!block->is_compressed_) {
+    block->compressed_write_buffer_.reset();
+    return Status::OK();
+  }
+  *outbuf = compressed_data;
+  *len = compressed_len;
+  return Status::OK();
+}
+
+Status BufferedBlockMgr::Decompress(Block* block, const uint8_t* data, int64_t len) {
+  DCHECK(decompressor_ != NULL);
   DCHECK(block->buffer());
+  SCOPED_TIMER(compression_timer_);
+  int64_t uncompressed_len = block->valid_data_len_;
+  uint8_t* buffer = block->buffer();
+  RETURN_IF_ERROR(decompressor_->ProcessBlock(true, len, data, &uncompressed_len,
+      &buffer));
+  if (uncompressed_len != block->valid_data_len_) {
+    return Status("Block decompression failure");
+  }
+  return Status::OK();
+}
+
+// Frees the state of an EVP cipher context when it goes out of scope.
+class ScopedCipherCtx {
+ public:
+  ScopedCipherCtx() { EVP_CIPHER_CTX_init(&ctx_); }
+  ~ScopedCipherCtx() { EVP_CIPHER_CTX_cleanup(&ctx_); }
+  EVP_CIPHER_CTX* get() { return &ctx_; }
+
+ private:
+  EVP_CIPHER_CTX ctx_;
+};
+
+// Initializes 'ctx' to encrypt or decrypt with 'key' and 'iv'. AES-GCM only uses the
+// first GCM_IV_LENGTH bytes of 'iv'.
+static Status InitCipher(EVP_CIPHER_CTX* ctx, bool encrypt, const uint8_t* key,
+    const uint8_t* iv) {
+#ifdef SPILL_USE_AES_GCM
+  // GCM is a counter mode, so it supports arbitrary length ciphertexts and computes the
+  // authentication tag in the same pass over the data. OpenSSL uses AES-NI and PCLMUL
+  // for it if the CPU supports them.
+  const EVP_CIPHER* cipher = EVP_aes_256_gcm();
+#else
+  // CFB gives us a stream cipher, which supports arbitrary length ciphertexts - it
+  // doesn't have to be a multiple of 16 bytes.
+  const EVP_CIPHER* cipher = EVP_aes_256_cfb();
+#endif
+  if (EVP_CipherInit_ex(ctx, cipher, NULL, NULL, NULL, encrypt) != 1) {
+    return OpenSSLErr("EVP_CipherInit_ex failure");
+  }
+  EVP_CIPHER_CTX_set_padding(ctx, 0);
+#ifdef SPILL_USE_AES_GCM
+  if (EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_IVLEN, GCM_IV_LENGTH, NULL) != 1) {
+    return OpenSSLErr("EVP_CTRL_GCM_SET_IVLEN failure");
+  }
+#endif
+  if (EVP_CipherInit_ex(ctx, NULL, NULL, key, iv, encrypt) != 1) {
+    return OpenSSLErr("EVP_CipherInit_ex failure");
+  }
+  return Status::OK();
+}
+
+Status BufferedBlockMgr::Encrypt(Block* block, const uint8_t* data, int64_t len,
+    uint8_t** outbuf) {
+  DCHECK(encryption_);
+  DCHECK(data);
   DCHECK(!block->is_pinned_);
   DCHECK(!block->in_write_);
   DCHECK(outbuf);
   SCOPED_TIMER(encryption_timer_);
 
-  // Since we're using AES-CFB mode, we must take care not to reuse a key/iv pair.
-  // Regenerate a new key and iv for every block of data we write, including between
-  // writes of the same Block.
+  // Neither CFB nor GCM mode may reuse a key/iv pair. Regenerate a new key and iv for
+  // every block of data we write, including between writes of the same Block.
   RAND_bytes(block->key_, sizeof(block->key_));
   RAND_bytes(block->iv_, sizeof(block->iv_));
-  block->encrypted_write_buffer_.reset(new uint8_t[block->valid_data_len_]);
-
-  EVP_CIPHER_CTX ctx;
-  int len = static_cast<int>(block->valid_data_len_);
-
-  // Create and initialize the context for encryption
-  EVP_CIPHER_CTX_init(&ctx);
-  EVP_CIPHER_CTX_set_padding(&ctx, 0);
+  block->encrypted_write_buffer_.reset(new uint8_t[len]);
 
-  // Start encryption.  We use a 256-bit AES key, and the cipher block mode
-  // is CFB because this gives us a stream cipher, which supports arbitrary
-  // length ciphertexts - it doesn't have to be a multiple of 16 bytes.
-  if (EVP_EncryptInit_ex(&ctx, EVP_aes_256_cfb(), NULL, block->key_, block->iv_) != 1) {
-    return OpenSSLErr("EVP_EncryptInit_ex failure");
-  }
+  // We use a 256-bit AES key.
+  ScopedCipherCtx ctx;
+  RETURN_IF_ERROR(InitCipher(ctx.get(), true, block->key_, block->iv_));
 
-  // Encrypt block->buffer() into the new encrypted_write_buffer_
-  if (EVP_EncryptUpdate(&ctx, block->encrypted_write_buffer_.get(), &len,
-        block->buffer(), len) != 1) {
+  // Encrypt 'data' into the new encrypted_write_buffer_
+  int out_len = static_cast<int>(len);
+  if (EVP_EncryptUpdate(ctx.get(), block->encrypted_write_buffer_.get(), &out_len,
+        data, out_len) != 1) {
     return OpenSSLErr("EVP_EncryptUpdate failure");
   }
 
-  // This is safe because we're using CFB mode without padding.
-  DCHECK_EQ(len, block->valid_data_len_);
+  // This is safe because both modes are used without padding.
+  DCHECK_EQ(out_len, len);
 
   // Finalize encryption.
-  if (1 != EVP_EncryptFinal_ex(&ctx, block->encrypted_write_buffer_.get() + len, &len)) {
+  if (1 != EVP_EncryptFinal_ex(ctx.get(), block->encrypted_write_buffer_.get() + out_len,
+        &out_len)) {
     return OpenSSLErr("EVP_EncryptFinal failure");
   }
 
-  // Again safe due to CFB with no padding
-  DCHECK_EQ(len, 0);
+  // Again safe due to no padding
+  DCHECK_EQ(out_len, 0);
+
+#ifdef SPILL_USE_AES_GCM
+  if (EVP_CIPHER_CTX_ctrl(ctx.get(), EVP_CTRL_GCM_GET_TAG, sizeof(block->gcm_tag_),
+        block->gcm_tag_) != 1) {
+    return OpenSSLErr("EVP_CTRL_GCM_GET_TAG failure");
+  }
+#endif
 
   *outbuf = block->encrypted_write_buffer_.get();
   return Status::OK();
@@ -1402,63 +1743,62 @@ void BufferedBlockMgr::EncryptDone(Block* block) {
   block->encrypted_write_buffer_.reset();
 }
 
-Status BufferedBlockMgr::Decrypt(Block* block) {
+Status BufferedBlockMgr::Decrypt(Block* block, uint8_t* data, int64_t len) {
   DCHECK(encryption_);
-  DCHECK(block->buffer());
+  DCHECK(data);
   SCOPED_TIMER(encryption_timer_);
 
-  EVP_CIPHER_CTX ctx;
-  int len = static_cast<int>(block->valid_data_len_);
-
-  // Create and initialize the context for encryption
-  EVP_CIPHER_CTX_init(&ctx);
-  EVP_CIPHER_CTX_set_padding(&ctx, 0);
-
   // Start decryption; same parameters as encryption for obvious reasons
-  if (EVP_DecryptInit_ex(&ctx, EVP_aes_256_cfb(), NULL, block->key_, block->iv_) != 1) {
-    return OpenSSLErr("EVP_DecryptInit_ex failure");
-  }
+  ScopedCipherCtx ctx;
+  RETURN_IF_ERROR(InitCipher(ctx.get(), false, block->key_, block->iv_));
 
-  // Decrypt block->buffer() in-place.  Safe because no one is accessing it.
-  if (EVP_DecryptUpdate(&ctx, block->buffer(), &len, block->buffer(), len) != 1) {
+  // Decrypt 'data' in-place.  Safe because no one is accessing it.
+  int out_len = static_cast<int>(len);
+  if (EVP_DecryptUpdate(ctx.get(), data, &out_len, data, out_len) != 1) {
     return OpenSSLErr("EVP_DecryptUpdate failure");
   }
 
-  // This is safe because we're using CFB mode without padding.
-  DCHECK_EQ(len, block->valid_data_len_);
+  // This is safe because both modes are used without padding.
+  DCHECK_EQ(out_len, len);
 
+#ifdef SPILL_USE_AES_GCM
+  // The tag is checked by EVP_DecryptFinal_ex(), which fails if the data read from
+  // disk was not the data that was written.
+  if (EVP_CIPHER_CTX_ctrl(ctx.get(), EVP_CTRL_GCM_SET_TAG, sizeof(block->gcm_tag_),
+        block->gcm_tag_) != 1) {
+    return OpenSSLErr("EVP_CTRL_GCM_SET_TAG failure");
+  }
+  if (EVP_DecryptFinal_ex(ctx.get(), data + out_len, &out_len) != 1) {
+    ERR_clear_error();
+    return Status("Block verification failure");
+  }
+#else
   // Finalize decryption.
-  if (1 != EVP_DecryptFinal_ex(&ctx, block->buffer() + len, &len)) {
+  if (1 != EVP_DecryptFinal_ex(ctx.get(), data + out_len, &out_len)) {
     return OpenSSLErr("EVP_DecryptFinal failure");
   }
+#endif
 
-  // Again safe due to CFB with no padding
-  DCHECK_EQ(len, 0);
+  // Again safe due to no padding
+  DCHECK_EQ(out_len, 0);
 
   return Status::OK();
 }
 
-void BufferedBlockMgr::SetHash(Block* block) {
+void BufferedBlockMgr::SetHash(Block* block, const uint8_t* data, int64_t len) {
   DCHECK(check_integrity_);
+  DCHECK(data);
   SCOPED_TIMER(integrity_check_timer_);
-  uint8_t* data = NULL;
-  if (encryption_) {
-    DCHECK(block->encrypted_write_buffer_.get());
-    data = block->encrypted_write_buffer_.get();
-  } else {
-    DCHECK(block->buffer());
-    data = block->buffer();
-  }
   // Explicitly ignore the return value from SHA256(); it can't fail.
-  (void) SHA256(data, block->valid_data_len_, block->hash_);
+  (void) SHA256(data, len, block->hash_);
 }
 
-Status BufferedBlockMgr::VerifyHash(Block* block) {
+Status BufferedBlockMgr::VerifyHash(Block* block, const uint8_t* data, int64_t len) {
   DCHECK(check_integrity_);
-  DCHECK(block->buffer());
+  DCHECK(data);
   SCOPED_TIMER(integrity_check_timer_);
   uint8_t test_hash[SHA256_DIGEST_LENGTH];
-  (void) SHA256(block->buffer(), block->valid_data_len_, test_hash);
+  (void) SHA256(data, len, test_hash);
   if (memcmp(test_hash, block->hash_, SHA256_DIGEST_LENGTH) != 0) {
     return Status("Block verification failure");
   }
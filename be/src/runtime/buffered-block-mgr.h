@@ -15,6 +15,7 @@
 #ifndef IMPALA_RUNTIME_BUFFERED_BLOCK_MGR
 #define IMPALA_RUNTIME_BUFFERED_BLOCK_MGR
 
+#include <boost/scoped_ptr.hpp>
 #include <boost/shared_ptr.hpp>
 
 #include "runtime/disk-io-mgr.h"
@@ -25,6 +26,7 @@
 
 namespace impala {
 
+class Codec;
 class RuntimeState;
 
 /// The BufferedBlockMgr is used to allocate and manage blocks of data using a fixed memory
@@ -152,6 +154,12 @@ class BufferedBlockMgr {
     /// assigned to a different block. Is non-blocking.
     Status Unpin();
 
+    /// Starts reading the block from disk in the background if it is unpinned and its
+    /// buffer was evicted, so that a later Pin() does not have to wait for the disk.
+    /// Does not use a buffer of the block manager, so it is done regardless of the
+    /// client's reservation. Errors are returned by the next Pin(). Non-blocking.
+    void Prefetch();
+
     /// Delete a block. Its buffer is released and on-disk location can be over-written.
     /// Non-blocking.
     void Delete();
@@ -246,6 +254,13 @@ class BufferedBlockMgr {
     /// and offset in write_range_. The File is owned by BufferedBlockMgr, not TmpFileMgr.
     TmpFileMgr::File* tmp_file_;
 
+    /// Index of tmp_file_ in the block mgr's tmp_files_. -1 if tmp_file_ is NULL.
+    int tmp_file_idx_;
+
+    /// The read of the block issued by Prefetch() that was not consumed by PinBlock()
+    /// yet. NULL if no read is in flight. Owned by the block manager.
+    DiskIoMgr::ScanRange* prefetch_range_;
+
     /// Length of valid (i.e. allocated) data within the block.
     int64_t valid_data_len_;
 
@@ -257,6 +272,23 @@ class BufferedBlockMgr {
     /// references to the data, can be decrypted in place.
     boost::scoped_array<uint8_t> encrypted_write_buffer_;
 
+    /// If compression_ is on, in the write path we allocate a new buffer to hold the
+    /// compressed data while it's being written to disk.
+    boost::scoped_array<uint8_t> compressed_write_buffer_;
+
+    /// True if the data in write_range_ was compressed when it was written. Blocks that
+    /// do not get smaller when compressed are written uncompressed.
+    bool is_compressed_;
+
+    /// Number of bytes of scratch space allocated at scratch_offset_ in tmp_file_. 0 if
+    /// the block has no scratch space. Freed when the block is deleted or outgrows it,
+    /// while write_range_ is kept for the next write of the block object.
+    int64_t scratch_len_;
+
+    /// Offset of the scratch space in tmp_file_. The same as the offset of write_range_
+    /// for local files, see TmpFileMgr::File::GetRangeLocation().
+    int64_t scratch_offset_;
+
     /// If encryption_ is on, a AES 256-bit key.  Regenerated on each write.
     uint8_t key_[32];
 
@@ -269,6 +301,10 @@ class BufferedBlockMgr {
     /// This IV is also regenerated on each write.
     uint8_t iv_[AES_BLOCK_SIZE];
 
+    /// If encryption_ is on and AES-GCM is used, the authentication tag of the data
+    /// being written. Filled in on writes; verified on reads by Decrypt().
+    uint8_t gcm_tag_[AES_BLOCK_SIZE];
+
     /// If integrity_ is on, our SHA256 hash of the data being written. Filled in on
     /// writes; verified on reads. This is calculated _after_ encryption.
     uint8_t hash_[SHA256_DIGEST_LENGTH];
@@ -284,6 +320,10 @@ class BufferedBlockMgr {
     /// and set to false when the write is complete.
     bool in_write_;
 
+    /// Monotonic time in ns when the current write of the block was issued, for the
+    /// write latency metric. Only valid while in_write_ is true.
+    int64_t write_start_ns_;
+
     /// True if the block is deleted by the client.
     bool is_deleted_;
 
@@ -309,6 +349,14 @@ class BufferedBlockMgr {
 
   ~BufferedBlockMgr();
 
+  /// Called by the process mem tracker when the process memory limit is reached. Frees
+  /// the free buffers of all block managers and starts writing all of their unpinned
+  /// blocks, so that other queries can use the memory instead of failing. The buffers
+  /// of blocks that are written this way are freed when their write completes, except
+  /// for the free buffers that a block manager keeps for its clients. Block managers
+  /// whose lock is held by the calling thread, or by another thread, are skipped.
+  static void ReleaseMemoryUnderPressure();
+
   /// Registers a client with num_reserved_buffers. The returned client is owned
   /// by the BufferedBlockMgr and has the same lifetime as it.
   /// We allow oversubscribing the reserved buffers. It is likely that the
@@ -328,6 +376,11 @@ class BufferedBlockMgr {
       bool tolerates_oversubscription, MemTracker* tracker, RuntimeState* state,
       Client** client);
 
+  /// Compresses the blocks of 'client' with LZ4 when they are written to disk, like
+  /// --disk_spill_compression does for all clients. Useful for clients whose data
+  /// compresses well, e.g. sorted runs.
+  Status EnableCompression(Client* client);
+
   /// Clears all reservations for this client.
   void ClearReservations(Client* client);
 
@@ -422,7 +475,7 @@ class BufferedBlockMgr {
   BufferedBlockMgr(RuntimeState* state, TmpFileMgr* tmp_file_mgr, int64_t block_size);
 
   /// Initializes the block mgr. Idempotent and thread-safe.
-  void Init(DiskIoMgr* io_mgr, RuntimeProfile* profile,
+  Status Init(DiskIoMgr* io_mgr, RuntimeProfile* profile,
       MemTracker* parent_tracker, int64_t mem_limit);
 
   /// Initializes tmp_files_. This is initialized the first time we need to write to disk.
@@ -434,6 +487,7 @@ class BufferedBlockMgr {
   /// DeleteBlockLocked() must be called with the lock_ taken.
   Status PinBlock(Block* block, bool* pinned, Block* src, bool unpin);
   Status UnpinBlock(Block* block);
+  void PrefetchBlock(Block* block);
   void DeleteBlock(Block* block);
   void DeleteBlockLocked(const boost::unique_lock<boost::mutex>& lock, Block* block);
 
@@ -482,9 +536,16 @@ class BufferedBlockMgr {
   /// Issues the write for this block to the DiskIoMgr.
   Status WriteUnpinnedBlock(Block* block);
 
-  /// Allocate block_size bytes in a temporary file. Try multiple disks if error occurs.
+  /// Issues the read of the on-disk data of 'block' to the DiskIoMgr and returns the
+  /// range to read it from.
+  Status IssueRead(Block* block, DiskIoMgr::ScanRange** scan_range);
+
+  /// Allocate block_size bytes in a temporary file. The file on the device with the
+  /// fewest writes in flight is chosen, with ties broken in round-robin order, so
+  /// blocks are striped across all usable devices. Try multiple disks if error occurs.
+  /// Returns the index of the file in tmp_files_ in 'tmp_file_idx'.
   /// Returns an error only if no temporary files are usable.
-  Status AllocateScratchSpace(int64_t block_size, TmpFileMgr::File** tmp_file,
+  Status AllocateScratchSpace(int64_t block_size, int* tmp_file_idx,
       int64_t* file_offset);
 
   /// Callback used by DiskIoMgr to indicate a block write has completed.  write_status
@@ -494,11 +555,23 @@ class BufferedBlockMgr {
   /// blocks list if it has been deleted.
   void WriteComplete(Block* block, const Status& write_status);
 
-  /// Returns a deleted block to the list of free blocks. Assumes the block's buffer has
-  /// already been returned to the free buffers list. Non-blocking.
-  /// Thread-safe and does not need the lock_ acquired.
+  /// Returns a deleted block to the list of free blocks and frees its scratch space.
+  /// Assumes the block's buffer has already been returned to the free buffers list.
+  /// Non-blocking. The lock_ must be taken.
   void ReturnUnusedBlock(Block* block);
 
+  /// Returns the scratch space of 'block', if it has any, to its tmp file so that other
+  /// blocks can reuse it. The block must not be in a write. The lock_ must be taken.
+  void FreeScratchSpace(Block* block);
+
+  /// Frees this block manager's free buffers and writes all of its unpinned blocks.
+  /// See ReleaseMemoryUnderPressure(). Does not block on lock_.
+  void SpillUnderPressure();
+
+  /// Frees the io-sized buffer 'buffer_desc', which must not be pinned or in a write,
+  /// and releases its memory. Lock must already be taken.
+  void FreeIoBuffer(BufferDescriptor* buffer_desc);
+
   /// Checks unused_blocks_ for an unused block object, else allocates a new one.
   /// Non-blocking and needs no lock_.
   Block* GetUnusedBlock(Client* client);
@@ -548,6 +621,10 @@ class BufferedBlockMgr {
   /// This does not include client-local writes.
   int non_local_outstanding_writes_;
 
+  /// The number of buffers that are freed instead of returned to free_io_buffers_ when
+  /// writes complete, because the writes were issued by SpillUnderPressure().
+  int num_buffers_to_free_;
+
   /// Signal availability of free buffers.
   boost::condition_variable buffer_available_cv_;
 
@@ -576,12 +653,19 @@ class BufferedBlockMgr {
   /// All allocated io-sized buffers.
   std::list<BufferDescriptor*> all_io_buffers_;
 
+  /// The scratch space used by tmp_files_, which counts towards the scratch limits of
+  /// the query. Must outlive tmp_files_.
+  boost::scoped_ptr<TmpFileMgr::QueryScratchUsage> scratch_usage_;
+
   /// Temporary physical file handle, (one per tmp device) to which blocks may be written.
-  /// Blocks are round-robined across these files.
+  /// Blocks are striped across these files, see AllocateScratchSpace().
   boost::ptr_vector<TmpFileMgr::File> tmp_files_;
 
-  /// Index into tmp_files_ denoting the file to which the next block to be persisted will
-  /// be written.
+  /// The number of writes in flight to each file in tmp_files_.
+  std::vector<int> tmp_file_outstanding_writes_;
+
+  /// Index into tmp_files_ denoting the file that is preferred for the next block to be
+  /// persisted if several files have the fewest writes in flight.
   int next_block_index_;
 
   /// DiskIoMgr handles to read and write blocks.
@@ -609,9 +693,15 @@ class BufferedBlockMgr {
   /// Number of Pin() calls that did not require a disk read.
   RuntimeProfile::Counter* buffered_pin_counter_;
 
+  /// Number of disk reads issued by Prefetch().
+  RuntimeProfile::Counter* prefetch_counter_;
+
   /// Time taken for disk reads.
   RuntimeProfile::Counter* disk_read_timer_;
 
+  /// Number of bytes read from disk by Pin().
+  RuntimeProfile::Counter* bytes_read_counter_;
+
   /// Time spent waiting for a free buffer.
   RuntimeProfile::Counter* buffer_wait_timer_;
 
@@ -627,6 +717,15 @@ class BufferedBlockMgr {
   /// Time spent in disk spill integrity generation and checking.
   RuntimeProfile::Counter* integrity_check_timer_;
 
+  /// Time spent in disk spill compression and decompression. NULL if compression_ is
+  /// false.
+  RuntimeProfile::Counter* compression_timer_;
+
+  /// Number of bytes of the blocks written to disk before compression and the ratio
+  /// of this to bytes_written_counter_. NULL if compression_ is false.
+  RuntimeProfile::Counter* uncompressed_bytes_written_counter_;
+  RuntimeProfile::Counter* compression_ratio_counter_;
+
   /// Number of writes issued.
   int writes_issued_;
 
@@ -641,31 +740,54 @@ class BufferedBlockMgr {
       BlockMgrsMap;
   static BlockMgrsMap query_to_block_mgrs_;
 
-  /// Takes the data in buffer(), allocates encrypted_write_buffer_, and returns
-  /// a pointer to the encrypted data in outbuf.
-  Status Encrypt(Block* block, uint8_t** outbuf);
+  /// Compresses the data in buffer() into compressed_write_buffer_ and sets
+  /// is_compressed_. If the compressed data is smaller, returns it in 'outbuf' and its
+  /// length in 'len', otherwise leaves them unchanged.
+  Status Compress(Block* block, uint8_t** outbuf, int64_t* len);
+
+  /// Decompresses the 'len' bytes in 'data' into buffer().
+  Status Decompress(Block* block, const uint8_t* data, int64_t len);
+
+  /// Creates the LZ4 codecs and the compression counters if they do not exist yet.
+  /// Called from Init() or with 'lock_' held.
+  Status InitCompression();
+
+  /// Takes the 'len' bytes of block data in 'data', allocates encrypted_write_buffer_,
+  /// and returns a pointer to the encrypted data in outbuf.
+  Status Encrypt(Block* block, const uint8_t* data, int64_t len, uint8_t** outbuf);
 
   /// Deallocates temporary buffer alloced in Encrypt().
   void EncryptDone(Block* block);
 
-  /// Decrypts the contents of buffer() in place.
-  Status Decrypt(Block* block);
+  /// Decrypts the 'len' bytes of block data in 'data' in place. With AES-GCM, also
+  /// verifies the data against the tag that Encrypt() computed.
+  Status Decrypt(Block* block, uint8_t* data, int64_t len);
 
-  /// Takes a cryptographic hash of the data and sets hash_ with it.
-  void SetHash(Block* block);
+  /// Takes a cryptographic hash of the 'len' bytes in 'data' and sets hash_ with it.
+  void SetHash(Block* block, const uint8_t* data, int64_t len);
 
-  /// Verifies that the contents of buffer() match those that were set by SetHash()
-  Status VerifyHash(Block* block);
+  /// Verifies that the 'len' bytes in 'data' match those that were set by SetHash()
+  Status VerifyHash(Block* block, const uint8_t* data, int64_t len);
 
   /// Set to true if --disk_spill_encryption is true.  When true, blocks will be encrypted
-  /// before being written to disk.
+  /// before being written to disk, with AES-256-GCM unless OpenSSL is older than 1.0.1.
   const bool encryption_;
 
   /// Set to true if --disk_spill_encryption is true.  We can split this into a different
   /// flag in the future, but there is little performance overhead in the integrity check
   /// and hence no real reason to keep this separate from encryption.  When true, blocks
   /// will have an integrity check (SHA-256) performed after being read from disk.
+  /// False if encryption uses AES-GCM, which authenticates the blocks itself.
   const bool check_integrity_;
+
+  /// Set to true if --disk_spill_compression is true. When true, blocks are compressed
+  /// with LZ4 before being encrypted and written to disk.
+  const bool compression_;
+
+  /// The LZ4 codecs if compression_ is true or a client called EnableCompression().
+  /// They do not keep state between blocks and can be used by several threads.
+  boost::scoped_ptr<Codec> compressor_;
+  boost::scoped_ptr<Codec> decompressor_;
 }; // class BufferedBlockMgr
 
 } // namespace impala.
@@ -623,6 +623,7 @@ TEST_F(SimpleTupleStreamTest, SmallBuffers) {
 
   // Initial buffer should be small.
   EXPECT_LT(stream.bytes_in_mem(false), buffer_size);
+  EXPECT_EQ(stream.byte_size(), 64 * 1024);
 
   RowBatch* batch = CreateIntBatch(0, 1024, false);
 
@@ -643,6 +644,8 @@ TEST_F(SimpleTupleStreamTest, SmallBuffers) {
     ASSERT_OK(status);
     if (!ret) {
       ASSERT_TRUE(stream.using_small_buffers());
+      // The small buffers double in size from 64KB to 512KB.
+      EXPECT_EQ(stream.byte_size(), (64 + 128 + 256 + 512) * 1024);
       bool got_buffer;
       ASSERT_OK(stream.SwitchToIoBuffers(&got_buffer));
       ASSERT_TRUE(got_buffer);
@@ -32,10 +32,12 @@ using namespace impala;
 using namespace strings;
 
 // The first NUM_SMALL_BLOCKS of the tuple stream are made of blocks less than the
-// IO size. These blocks never spill.
-// TODO: Consider adding a 4MB in-memory buffer that would split the gap between the
-// 512KB in-memory buffer and the 8MB (IO-sized) spillable buffer.
-static const int64_t INITIAL_BLOCK_SIZES[] = { 64 * 1024, 512 * 1024 };
+// IO size. These blocks never spill. The sizes are powers of two that double with
+// each block, so a stream only uses about twice the memory of its data until it
+// switches to IO-sized blocks.
+// TODO: Consider growing the blocks up to the IO size once small blocks can spill.
+static const int64_t INITIAL_BLOCK_SIZES[] =
+    { 64 * 1024, 128 * 1024, 256 * 1024, 512 * 1024 };
 static const int NUM_SMALL_BLOCKS = sizeof(INITIAL_BLOCK_SIZES) / sizeof(int64_t);
 
 string BufferedTupleStream::RowIdx::DebugString() const {
@@ -374,11 +376,22 @@ Status BufferedTupleStream::NextReadBlock() {
     read_tuple_idx_ = 0;
     read_ptr_ = (*read_block_)->buffer() + read_block_null_indicators_size_;
     read_end_ptr_ = (*read_block_)->buffer() + (*read_block_)->buffer_len();
+    PrefetchReadBlocks();
   }
   DCHECK_EQ(num_pinned_, NumPinned(blocks_)) << DebugString();
   return Status::OK();
 }
 
+void BufferedTupleStream::PrefetchReadBlocks() {
+  if (pinned_) return;
+  list<BufferedBlockMgr::Block*>::iterator it = read_block_;
+  for (int i = 0; i < NUM_PREFETCH_BLOCKS && it != blocks_.end(); ++i) {
+    ++it;
+    // The write block of a read/write stream is always pinned.
+    if (it != blocks_.end() && !(*it)->is_pinned()) (*it)->Prefetch();
+  }
+}
+
 Status BufferedTupleStream::PrepareForRead(bool delete_on_read, bool* got_buffer) {
   DCHECK(!closed_);
   if (blocks_.empty()) return Status::OK();
@@ -419,6 +432,7 @@ Status BufferedTupleStream::PrepareForRead(bool delete_on_read, bool* got_buffer
   rows_returned_ = 0;
   read_block_idx_ = 0;
   delete_on_read_ = delete_on_read;
+  PrefetchReadBlocks();
   *got_buffer = true;
   return Status::OK();
 }
@@ -43,8 +43,8 @@ class TupleRow;
 /// 64 * 8MB = 512MB of buffering. A query with 5 of these operators would require
 /// 2.56GB just to run, regardless of how much of that is used. This is
 /// problematic for small queries. Instead we will start with a fixed number of small
-/// buffers (currently 2 small buffers: one 64KB and one 512KB) and only start using IO
-/// sized buffers when those fill up. The small buffers never spill.
+/// buffers (currently 4 small buffers, doubling in size from 64KB to 512KB) and only
+/// start using IO sized buffers when those fill up. The small buffers never spill.
 /// The stream will *not* automatically switch from using small buffers to IO-sized
 /// buffers when all the small buffers for this stream have been used.
 ///
@@ -150,10 +150,8 @@ class TupleRow;
 ///     fewer gaps in case of many rows with NULL tuples.
 ///   - We will want to multithread this. Add a AddBlock() call so the synchronization
 ///     happens at the block level. This is a natural extension.
-///   - Instead of allocating all blocks from the block_mgr, allocate some blocks that
-///     are much smaller (e.g. 16K and doubling up to the block size). This way, very
-///     small streams (a common case) will use very little memory. This small blocks
-///     are always in memory since spilling them frees up negligible memory.
+///   - Grow the small blocks up to the block size. This requires the small blocks to
+///     be spillable, since they would no longer use negligible memory.
 ///   - Return row batches in GetNext() instead of filling one in
 class BufferedTupleStream {
  public:
@@ -318,6 +316,10 @@ class BufferedTupleStream {
   friend class ArrayTupleStreamTest_TestArrayDeepCopy_Test;
   friend class ArrayTupleStreamTest_TestComputeRowSize_Test;
 
+  /// Number of blocks ahead of the read block of an unpinned stream that are read from
+  /// disk in the background.
+  static const int NUM_PREFETCH_BLOCKS = 2;
+
   /// If true, this stream is still using small buffers.
   bool use_small_buffers_;
 
@@ -477,6 +479,10 @@ class BufferedTupleStream {
   /// Updates read_block_, read_ptr_, read_tuple_idx_ and read_end_ptr_.
   Status NextReadBlock();
 
+  /// If the stream is unpinned, prefetches the NUM_PREFETCH_BLOCKS blocks after
+  /// read_block_ so that their disk reads overlap with the processing of read_block_.
+  void PrefetchReadBlocks();
+
   /// Returns the total additional bytes that this row will consume in write_block_ if
   /// appended to the block. This includes the fixed length part of the row and the
   /// data for inlined_string_slots_ and inlined_coll_slots_.
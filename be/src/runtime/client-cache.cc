@@ -20,10 +20,14 @@
 #include <thrift/transport/TSocket.h>
 #include <thrift/transport/TTransportUtils.h>
 #include <memory>
+#include <gflags/gflags.h>
 
 #include "common/logging.h"
 #include "util/container-util.h"
+#include "util/histogram-metric.h"
 #include "util/network-util.h"
+#include "util/stopwatch.h"
+#include "util/symbols-util.h"
 #include "rpc/thrift-util.h"
 #include "gen-cpp/ImpalaInternalService.h"
 
@@ -33,36 +37,93 @@ using namespace apache::thrift::server;
 using namespace apache::thrift::transport;
 using namespace apache::thrift::protocol;
 
+DEFINE_bool(client_cache_check_idle_connections, true, "(Advanced) If true, cached "
+    "Thrift clients are checked for a connection that was closed by the server before "
+    "they are reused, and replaced with a new client if it was.");
+DEFINE_int32(client_cache_max_idle_clients_per_host, 0, "(Advanced) The maximum number "
+    "of unused Thrift clients that a client cache keeps open to a single host. Clients "
+    "that are released while the limit is reached are closed. If <= 0, there is no "
+    "limit.");
+
 namespace impala {
 
+// Largest value that the client connect time histograms track.
+static const int64_t MAX_CONNECT_TIME_MS = 60 * 60 * 1000;
+
+// Largest value that the RPC latency histograms track, and their precision.
+static const int64_t MAX_RPC_LATENCY_NS = 60L * 60L * 1000L * 1000L * 1000L;
+static const int RPC_LATENCY_SIGNIFICANT_DIGITS = 2;
+
+shared_ptr<ClientCacheHelper::PerHostCache> ClientCacheHelper::GetPerHostCache(
+    const TNetworkAddress& address) {
+  lock_guard<mutex> lock(cache_lock_);
+  shared_ptr<PerHostCache>* ptr = &per_host_caches_[address];
+  if (ptr->get() == NULL) ptr->reset(new PerHostCache());
+  return *ptr;
+}
+
 Status ClientCacheHelper::GetClient(const TNetworkAddress& address,
     ClientFactory factory_method, ClientKey* client_key) {
-  shared_ptr<PerHostCache> host_cache;
-  {
-    lock_guard<mutex> lock(cache_lock_);
-    VLOG(2) << "GetClient(" << address << ")";
-    shared_ptr<PerHostCache>* ptr = &per_host_caches_[address];
-    if (ptr->get() == NULL) ptr->reset(new PerHostCache());
-    host_cache = *ptr;
-  }
+  VLOG(2) << "GetClient(" << address << ")";
+  shared_ptr<PerHostCache> host_cache = GetPerHostCache(address);
 
-  {
-    lock_guard<mutex> lock(host_cache->lock);
-    if (!host_cache->clients.empty()) {
+  while (true) {
+    {
+      lock_guard<mutex> lock(host_cache->lock);
+      // Only create a new client if host_cache->clients is empty.
+      if (host_cache->clients.empty()) break;
       *client_key = host_cache->clients.front();
-      VLOG(2) << "GetClient(): returning cached client for " << address;
       host_cache->clients.pop_front();
-      if (metrics_enabled_) clients_in_use_metric_->Increment(1);
-      return Status::OK();
     }
+    if (FLAGS_client_cache_check_idle_connections) {
+      shared_ptr<ThriftClientImpl> client_impl;
+      {
+        lock_guard<mutex> lock(client_map_lock_);
+        ClientMap::iterator client = client_map_.find(*client_key);
+        DCHECK(client != client_map_.end());
+        client_impl = client->second;
+      }
+      if (!client_impl->IsIdleConnectionOpen()) {
+        VLOG(1) << "GetClient(): discarding cached client with a closed connection to "
+                << address;
+        DestroyClient(*client_key);
+        *client_key = NULL;
+        continue;
+      }
+    }
+    VLOG(2) << "GetClient(): returning cached client for " << address;
+    if (metrics_enabled_) {
+      clients_in_use_metric_->Increment(1);
+      clients_reused_metric_->Increment(1);
+    }
+    return Status::OK();
   }
 
-  // Only get here if host_cache->clients.empty(). No need for the lock.
   RETURN_IF_ERROR(CreateClient(address, factory_method, client_key));
   if (metrics_enabled_) clients_in_use_metric_->Increment(1);
   return Status::OK();
 }
 
+Status ClientCacheHelper::PrewarmClients(const TNetworkAddress& address,
+    ClientFactory factory_method, int num_clients) {
+  shared_ptr<PerHostCache> host_cache = GetPerHostCache(address);
+  int num_missing;
+  {
+    lock_guard<mutex> lock(host_cache->lock);
+    num_missing = num_clients - static_cast<int>(host_cache->clients.size());
+  }
+  if (num_missing > 0) {
+    VLOG(2) << "PrewarmClients(): opening " << num_missing << " clients to " << address;
+  }
+  for (int i = 0; i < num_missing; ++i) {
+    ClientKey client_key;
+    RETURN_IF_ERROR(CreateClient(address, factory_method, &client_key));
+    lock_guard<mutex> lock(host_cache->lock);
+    host_cache->clients.push_back(client_key);
+  }
+  return Status::OK();
+}
+
 Status ClientCacheHelper::ReopenClient(ClientFactory factory_method,
     ClientKey* client_key) {
   // Clients are not ordinarily removed from the cache completely (in the future, they may
@@ -103,11 +164,14 @@ Status ClientCacheHelper::CreateClient(const TNetworkAddress& address,
     ClientFactory factory_method, ClientKey* client_key) {
   shared_ptr<ThriftClientImpl> client_impl(factory_method(address, client_key));
   VLOG(2) << "CreateClient(): creating new client for " << client_impl->address();
+  MonotonicStopWatch connect_timer;
+  connect_timer.Start();
   Status status = client_impl->OpenWithRetry(num_tries_, wait_ms_);
   if (!status.ok()) {
     *client_key = NULL;
     return status;
   }
+  int64_t connect_time_ms = connect_timer.ElapsedTime() / (1000L * 1000L);
   // Set the TSocket's send and receive timeouts.
   client_impl->setRecvTimeout(recv_timeout_ms_);
   client_impl->setSendTimeout(send_timeout_ms_);
@@ -116,12 +180,32 @@ Status ClientCacheHelper::CreateClient(const TNetworkAddress& address,
   {
     lock_guard<mutex> lock(client_map_lock_);
     client_map_[*client_key] = client_impl;
+    if (metrics_enabled_) {
+      client_connect_time_ms_metric_->Update(
+          min(connect_time_ms, MAX_CONNECT_TIME_MS));
+    }
   }
 
-  if (metrics_enabled_) total_clients_metric_->Increment(1);
+  if (metrics_enabled_) {
+    total_clients_metric_->Increment(1);
+    clients_created_metric_->Increment(1);
+  }
   return Status::OK();
 }
 
+void ClientCacheHelper::DestroyClient(ClientKey client_key) {
+  shared_ptr<ThriftClientImpl> client_impl;
+  {
+    lock_guard<mutex> lock(client_map_lock_);
+    ClientMap::iterator client = client_map_.find(client_key);
+    DCHECK(client != client_map_.end());
+    client_impl = client->second;
+    client_map_.erase(client);
+  }
+  client_impl->Close();
+  if (metrics_enabled_) total_clients_metric_->Increment(-1);
+}
+
 void ClientCacheHelper::ReleaseClient(ClientKey* client_key) {
   DCHECK(*client_key != NULL) << "Trying to release NULL client";
   shared_ptr<ThriftClientImpl> client_impl;
@@ -132,12 +216,24 @@ void ClientCacheHelper::ReleaseClient(ClientKey* client_key) {
     client_impl = client->second;
   }
   VLOG(2) << "Releasing client for " << client_impl->address() << " back to cache";
+  bool cached = true;
   {
     lock_guard<mutex> lock(cache_lock_);
     PerHostCacheMap::iterator cache = per_host_caches_.find(client_impl->address());
     DCHECK(cache != per_host_caches_.end());
     lock_guard<mutex> entry_lock(cache->second->lock);
-    cache->second->clients.push_back(*client_key);
+    if (FLAGS_client_cache_max_idle_clients_per_host > 0 &&
+        cache->second->clients.size() >=
+            static_cast<size_t>(FLAGS_client_cache_max_idle_clients_per_host)) {
+      cached = false;
+    } else {
+      cache->second->clients.push_back(*client_key);
+    }
+  }
+  if (!cached) {
+    VLOG(2) << "Closing client for " << client_impl->address()
+            << ", the cache already holds the maximum number of clients for it";
+    DestroyClient(*client_key);
   }
   if (metrics_enabled_) clients_in_use_metric_->Increment(-1);
   *client_key = NULL;
@@ -199,6 +295,8 @@ void ClientCacheHelper::InitMetrics(MetricGroup* metrics, const string& key_pref
   // Not strictly needed if InitMetrics is called before any cache usage, but ensures that
   // metrics_enabled_ is published.
   lock_guard<mutex> lock(cache_lock_);
+  metrics_ = metrics;
+  key_prefix_ = key_prefix;
   stringstream count_ss;
   count_ss << key_prefix << ".client-cache.clients-in-use";
   clients_in_use_metric_ = metrics->AddGauge<int64_t>(count_ss.str(), 0);
@@ -206,7 +304,40 @@ void ClientCacheHelper::InitMetrics(MetricGroup* metrics, const string& key_pref
   stringstream max_ss;
   max_ss << key_prefix << ".client-cache.total-clients";
   total_clients_metric_ = metrics->AddGauge<int64_t>(max_ss.str(), 0);
+
+  clients_reused_metric_ = metrics->RegisterMetric(new IntCounter(MakeTMetricDef(
+      key_prefix + ".client-cache.clients-reused", TMetricKind::COUNTER, TUnit::UNIT),
+      0));
+  clients_created_metric_ = metrics->RegisterMetric(new IntCounter(MakeTMetricDef(
+      key_prefix + ".client-cache.clients-created", TMetricKind::COUNTER, TUnit::UNIT),
+      0));
+  client_connect_time_ms_metric_ = metrics->RegisterMetric(new HistogramMetric(
+      MakeTMetricDef(key_prefix + ".client-cache.connect-time-ms",
+          TMetricKind::HISTOGRAM, TUnit::TIME_MS), MAX_CONNECT_TIME_MS, 3));
   metrics_enabled_ = true;
 }
 
+void ClientCacheHelper::UpdateRpcLatency(const type_info& request_type,
+    int64_t latency_ns) {
+  if (!metrics_enabled_) return;
+  HistogramMetric* metric;
+  {
+    lock_guard<mutex> l(rpc_latency_lock_);
+    HistogramMetric*& entry = rpc_latency_metrics_[request_type.name()];
+    if (entry == NULL) {
+      // The request type without its namespace, e.g. TExecPlanFragmentParams, names
+      // the RPC.
+      string type_name = SymbolsUtil::Demangle(request_type.name());
+      size_t namespace_end = type_name.rfind("::");
+      if (namespace_end != string::npos) type_name = type_name.substr(namespace_end + 2);
+      entry = metrics_->RegisterMetric(new HistogramMetric(MakeTMetricDef(
+          key_prefix_ + ".client-cache.rpc-latency." + type_name,
+          TMetricKind::HISTOGRAM, TUnit::TIME_NS), MAX_RPC_LATENCY_NS,
+          RPC_LATENCY_SIGNIFICANT_DIGITS));
+    }
+    metric = entry;
+  }
+  metric->Update(latency_ns);
+}
+
 }
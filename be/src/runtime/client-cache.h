@@ -18,6 +18,7 @@
 #include <vector>
 #include <list>
 #include <string>
+#include <typeinfo>
 #include <boost/unordered_map.hpp>
 #include <boost/thread/mutex.hpp>
 #include <boost/bind.hpp>
@@ -26,11 +27,14 @@
 #include "util/metrics.h"
 #include "rpc/thrift-client.h"
 #include "rpc/thrift-util.h"
+#include "util/time.h"
 
 #include "common/status.h"
 
 namespace impala {
 
+class HistogramMetric;
+
 /// Opaque pointer type which allows users of ClientCache to refer to particular client
 /// instances without requiring that we parameterise ClientCacheHelper by type.
 typedef void* ClientKey;
@@ -53,12 +57,17 @@ typedef void* ClientKey;
 /// we deliberately avoid using it so that we don't have to parameterise this class by
 /// type, and thus this entire class doesn't get inlined every time it gets used.
 //
+/// Cached clients whose connection was closed by the server, e.g. because it restarted,
+/// are replaced before they are returned by GetClient() (see
+/// --client_cache_check_idle_connections), and the number of cached clients per host
+/// can be limited with --client_cache_max_idle_clients_per_host.
+//
 /// This class is thread-safe.
 //
 /// TODO: shut down clients in the background if they don't get used for a period of time
 /// TODO: More graceful handling of clients that have failed (maybe better
 /// handled by a smart-wrapper of the interface object).
-/// TODO: limits on total number of clients, and clients per-backend
+/// TODO: limits on total number of clients
 /// TODO: move this to a separate header file, so that the public interface is more
 /// prominent in this file
 class ClientCacheHelper {
@@ -74,6 +83,7 @@ class ClientCacheHelper {
   /// returned client will not be present in the per-host cache.
   //
   /// If there is an error creating the new client, *client_key will be NULL.
+  /// A cached client whose connection is found to be closed is replaced with a new one.
   Status GetClient(const TNetworkAddress& address, ClientFactory factory_method,
       ClientKey* client_key);
 
@@ -88,6 +98,12 @@ class ClientCacheHelper {
   /// associated client will be available in the per-host cache..
   void ReleaseClient(ClientKey* client_key);
 
+  /// Opens new clients to 'address' until at least 'num_clients' of them are cached, so
+  /// that later GetClient() calls do not pay for connecting (and authenticating).
+  /// Returns the error of the first client that could not be opened.
+  Status PrewarmClients(const TNetworkAddress& address, ClientFactory factory_method,
+      int num_clients);
+
   /// Close all connections to a host (e.g., in case of failure) so that on their
   /// next use they will have to be reopened via ReopenClient().
   void CloseConnections(const TNetworkAddress& address);
@@ -98,10 +114,16 @@ class ClientCacheHelper {
   /// Closes every connection in the cache. Used only for testing.
   void TestShutdown();
 
-  /// Creates two metrics for this cache measuring the number of clients currently used,
-  /// and the total number in the cache.
+  /// Creates metrics for this cache measuring the number of clients currently used, the
+  /// total number in the cache, how often cached clients are reused and how long it takes
+  /// to open new ones.
   void InitMetrics(MetricGroup* metrics, const std::string& key_prefix);
 
+  /// Adds 'latency_ns' to the latency histogram of the RPCs whose request has the type
+  /// 'request_type', creating the histogram on the first call. Does nothing if
+  /// InitMetrics() was not called.
+  void UpdateRpcLatency(const std::type_info& request_type, int64_t latency_ns);
+
  private:
   template <class T> friend class ClientCache;
   /// Private constructor so that only ClientCache can instantiate this class.
@@ -111,7 +133,8 @@ class ClientCacheHelper {
         wait_ms_(wait_ms),
         send_timeout_ms_(send_timeout_ms),
         recv_timeout_ms_(recv_timeout_ms),
-        metrics_enabled_(false) { }
+        metrics_enabled_(false),
+        metrics_(NULL) { }
 
   /// There are three lock categories - the cache-wide lock (cache_lock_), the locks for a
   /// specific cache (PerHostCache::lock) and the lock for the set of all clients
@@ -179,9 +202,37 @@ class ClientCacheHelper {
   /// Total clients in the cache, including those in use
   IntGauge* total_clients_metric_;
 
+  /// Number of GetClient() calls that were served with a cached client.
+  IntCounter* clients_reused_metric_;
+
+  /// Number of clients that were created, including those that replaced broken ones.
+  IntCounter* clients_created_metric_;
+
+  /// Time it took to open the connections of new clients, including authentication.
+  /// Protected by client_map_lock_.
+  HistogramMetric* client_connect_time_ms_metric_;
+
+  /// Metric group and key prefix that InitMetrics() was called with.
+  MetricGroup* metrics_;
+  std::string key_prefix_;
+
+  /// Protects rpc_latency_metrics_.
+  boost::mutex rpc_latency_lock_;
+
+  /// Latency histogram of the RPCs of each request type, keyed by the mangled name of
+  /// the type. Populated lazily by UpdateRpcLatency().
+  std::map<std::string, HistogramMetric*> rpc_latency_metrics_;
+
   /// Create a new client for specific address in 'client' and put it in client_map_
   Status CreateClient(const TNetworkAddress& address, ClientFactory factory_method,
       ClientKey* client_key);
+
+  /// Returns the PerHostCache for 'address', creating it if necessary.
+  boost::shared_ptr<PerHostCache> GetPerHostCache(const TNetworkAddress& address);
+
+  /// Removes the client for 'client_key' from client_map_ and closes it. The client must
+  /// not be in its PerHostCache.
+  void DestroyClient(ClientKey client_key);
 };
 
 /// A scoped client connection to help manage clients from a client cache. Clients of this
@@ -213,6 +264,9 @@ class ClientConnection {
   /// depending on the error received from the first attempt.
   /// TODO: Detect already-closed cnxns and only retry in that case.
   ///
+  /// The time taken by the call, including any retry, is added to the latency histogram
+  /// of the request type in the cache's metrics.
+  ///
   /// Returns RPC_TIMEOUT if a timeout occurred, RPC_CLIENT_CONNECT_FAILURE if the client
   /// failed to connect, and RPC_GENERAL_ERROR if the RPC could not be completed for any
   /// other reason (except for an unexpectedly closed cnxn, see TODO). Application-level
@@ -222,6 +276,19 @@ class ClientConnection {
   /// failure modes.
   template <class F, class Request, class Response>
   Status DoRpc(const F& f, const Request& request, Response* response) {
+    int64_t start_time = MonotonicNanos();
+    Status status = DoRpcInternal(f, request, response);
+    client_cache_->client_cache_helper_.UpdateRpcLatency(typeid(Request),
+        MonotonicNanos() - start_time);
+    return status;
+  }
+
+ private:
+  ClientCache<T>* client_cache_;
+  T* client_;
+
+  template <class F, class Request, class Response>
+  Status DoRpcInternal(const F& f, const Request& request, Response* response) {
     DCHECK(response != NULL);
     try {
       (client_->*f)(*response, request);
@@ -243,10 +310,6 @@ class ClientConnection {
     }
     return Status::OK();
   }
-
- private:
-  ClientCache<T>* client_cache_;
-  T* client_;
 };
 
 /// Generic cache of Thrift clients for a given service type.
@@ -274,6 +337,12 @@ class ClientCache {
         boost::mem_fn(&ClientCache::MakeClient), this, _1, _2, service_name, enable_ssl);
   }
 
+  /// Opens clients to 'address' until at least 'num_clients' of them are cached. See
+  /// ClientCacheHelper::PrewarmClients().
+  Status PrewarmClients(const TNetworkAddress& address, int num_clients) {
+    return client_cache_helper_.PrewarmClients(address, client_factory_, num_clients);
+  }
+
   /// Close all clients connected to the supplied address, (e.g., in
   /// case of failure) so that on their next use they will have to be
   /// Reopen'ed.
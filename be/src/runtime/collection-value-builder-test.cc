@@ -65,6 +65,42 @@ TEST(CollectionValueBuilderTest, MaxBufferSize) {
   pool.FreeAll();
 }
 
+// Tests that the buffer is grown in place while it is the last allocation from the pool.
+TEST(CollectionValueBuilderTest, GrowInPlace) {
+  ObjectPool obj_pool;
+  DescriptorTblBuilder builder(&obj_pool);
+  builder.DeclareTuple() << TYPE_BIGINT;
+  DescriptorTbl* desc_tbl = builder.Build();
+  vector<TupleDescriptor*> descs;
+  desc_tbl->GetTupleDescs(&descs);
+  ASSERT_EQ(descs.size(), 1);
+  const TupleDescriptor& tuple_desc = *descs[0];
+
+  CollectionValue coll_value;
+  MemTracker tracker;
+  MemPool pool(&tracker);
+  CollectionValueBuilder coll_value_builder(&coll_value, tuple_desc, &pool, NULL, 4);
+  uint8_t* buffer = coll_value.ptr;
+  for (int i = 0; i < 4; ++i) {
+    Tuple* tuple_mem;
+    int num_tuples;
+    EXPECT_OK(coll_value_builder.GetFreeMemory(&tuple_mem, &num_tuples));
+    coll_value_builder.CommitTuples(num_tuples);
+  }
+  EXPECT_EQ(coll_value.num_tuples, 32);
+  EXPECT_TRUE(coll_value.ptr == buffer);
+  EXPECT_EQ(pool.total_allocated_bytes(), coll_value.ByteSize(tuple_desc));
+
+  // Once another allocation follows the buffer, it is moved when it is grown.
+  pool.Allocate(8);
+  Tuple* tuple_mem;
+  int num_tuples;
+  EXPECT_OK(coll_value_builder.GetFreeMemory(&tuple_mem, &num_tuples));
+  EXPECT_EQ(num_tuples, 32);
+  EXPECT_TRUE(coll_value.ptr != buffer);
+  pool.FreeAll();
+}
+
 int main(int argc, char **argv) {
   ::testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
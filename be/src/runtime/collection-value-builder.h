@@ -24,7 +24,9 @@ namespace impala {
 
 /// Class for constructing an CollectionValue when the total size isn't known
 /// up-front. This class handles allocating the buffer backing the collection from a
-/// MemPool, and uses a doubling strategy for growing the collection.
+/// MemPool, and uses a doubling strategy for growing the collection. The buffer is grown
+/// in place if it is the last allocation from the pool, so that the item tuples of a
+/// collection that is built without other allocations in between are not copied.
 class CollectionValueBuilder {
  public:
   // I did not pick this default for any meaningful reason, feel free to change!
@@ -58,19 +60,12 @@ class CollectionValueBuilder {
       if (buffer_size_ == bytes_written) {
         // Double tuple buffer
         int64_t new_buffer_size = max<int64_t>(buffer_size_ * 2, tuple_desc_.byte_size());
-        uint8_t* new_buf = pool_->TryAllocate(new_buffer_size);
-        if (UNLIKELY(new_buf == NULL)) {
-          *tuple_mem = NULL;
-          *num_tuples = 0;
-          string path = tuple_desc_.table_desc() == NULL ? "" :
-              PrintPath(*tuple_desc_.table_desc(), tuple_desc_.tuple_path());
-          return pool_->mem_tracker()->MemLimitExceeded(state_,
-              ErrorMsg(TErrorCode::COLLECTION_ALLOC_FAILED, new_buffer_size,
-              path, buffer_size_, coll_value_->num_tuples).msg(), new_buffer_size);
+        if (buffer_size_ > 0 &&
+            pool_->TryExtendAllocation(coll_value_->ptr, buffer_size_, new_buffer_size)) {
+          buffer_size_ = new_buffer_size;
+        } else {
+          RETURN_IF_ERROR(Reallocate(new_buffer_size, tuple_mem, num_tuples));
         }
-        memcpy(new_buf, coll_value_->ptr, bytes_written);
-        coll_value_->ptr = new_buf;
-        buffer_size_ = new_buffer_size;
       }
       *tuple_mem = reinterpret_cast<Tuple*>(coll_value_->ptr + bytes_written);
       *num_tuples = (buffer_size_ - bytes_written) / tuple_desc_.byte_size();
@@ -91,6 +86,25 @@ class CollectionValueBuilder {
   MemPool* pool() const { return pool_; }
 
  private:
+  /// Moves the collection to a new buffer of 'new_buffer_size' bytes. Returns an error
+  /// and sets 'tuple_mem' and 'num_tuples' to NULL and 0 if the allocation fails.
+  Status Reallocate(int64_t new_buffer_size, Tuple** tuple_mem, int* num_tuples) {
+    uint8_t* new_buf = pool_->TryAllocate(new_buffer_size);
+    if (UNLIKELY(new_buf == NULL)) {
+      *tuple_mem = NULL;
+      *num_tuples = 0;
+      string path = tuple_desc_.table_desc() == NULL ? "" :
+          PrintPath(*tuple_desc_.table_desc(), tuple_desc_.tuple_path());
+      return pool_->mem_tracker()->MemLimitExceeded(state_,
+          ErrorMsg(TErrorCode::COLLECTION_ALLOC_FAILED, new_buffer_size,
+          path, buffer_size_, coll_value_->num_tuples).msg(), new_buffer_size);
+    }
+    memcpy(new_buf, coll_value_->ptr, coll_value_->ByteSize(tuple_desc_));
+    coll_value_->ptr = new_buf;
+    buffer_size_ = new_buffer_size;
+    return Status::OK();
+  }
+
   CollectionValue* coll_value_;
 
   /// The tuple desc for coll_value_'s items
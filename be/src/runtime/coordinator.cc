@@ -46,6 +46,7 @@
 #include "runtime/mem-tracker.h"
 #include "runtime/plan-fragment-executor.h"
 #include "runtime/row-batch.h"
+#include "runtime/runtime-filter-bank.h"
 #include "runtime/backend-client.h"
 #include "runtime/parallel-executor.h"
 #include "runtime/tuple-row.h"
@@ -59,6 +60,7 @@
 #include "util/error-util.h"
 #include "util/hdfs-bulk-ops.h"
 #include "util/hdfs-util.h"
+#include "util/impalad-metrics.h"
 #include "util/llama-util.h"
 #include "util/network-util.h"
 #include "util/pretty-printer.h"
@@ -89,6 +91,14 @@ DECLARE_string(hostname);
 
 DEFINE_bool(insert_inherit_permissions, false, "If true, new directories created by "
     "INSERTs will inherit the permissions of their parent directories");
+DEFINE_int32(averaged_profile_update_interval_ms, 500, "(Advanced) Minimum interval "
+    "(in ms) between two updates of a fragment's averaged profile from the status "
+    "reports of its instances. Reports in between only update the instance's own "
+    "profile. All averages are brought up to date when the query finishes. If <= 0, "
+    "every status report updates the averaged profile.");
+DEFINE_int32(coordinator_cancellation_fanout, 32, "(Advanced) Maximum number of "
+    "impalads that a coordinator sends CancelPlanFragment() RPCs to concurrently when "
+    "cancelling the remote fragments of a query.");
 
 namespace impala {
 
@@ -116,6 +126,18 @@ struct DebugOptions {
   }
 };
 
+// A fragment instance that is started on a remote impalad by ExecRemoteFragment().
+struct RemoteFragmentInstance {
+  const FragmentExecParams* fragment_exec_params;
+  const TPlanFragment* plan_fragment;
+  // Descriptor table of 'plan_fragment', shared by all its instances.
+  const TDescriptorTable* desc_tbl;
+  DebugOptions* debug_options;
+  int instance_state_idx;
+  int fragment_idx;
+  int fragment_instance_idx;
+};
+
 /// Execution state of a particular fragment instance.
 ///
 /// Concurrent accesses:
@@ -426,8 +448,10 @@ Status Coordinator::Exec(QuerySchedule& schedule,
       UpdateFilterRoutingTable(request.fragments[0].plan.nodes, 1, 0);
       if (schedule.num_fragment_instances() == 0) MarkFilterRoutingTableComplete();
     }
+    TDescriptorTable desc_tbl;
+    GetFragmentDescriptorTable(request.fragments[0], &desc_tbl);
     TExecPlanFragmentParams rpc_params;
-    SetExecPlanFragmentParams(schedule, request.fragments[0],
+    SetExecPlanFragmentParams(schedule, request.fragments[0], desc_tbl,
         (*schedule.exec_params())[0], 0, 0, 0, coord, &rpc_params);
     RETURN_IF_ERROR(executor_->Prepare(rpc_params));
 
@@ -572,6 +596,11 @@ Status Coordinator::StartRemoteFragments(QuerySchedule* schedule) {
   }
 
   instance_state_idx = 0;
+  // The descriptor table of a fragment is the same for all of its instances, so it is
+  // only computed once per fragment.
+  vector<TDescriptorTable> desc_tbls(request.fragments.size());
+  // The instances to start, grouped by the impalad they run on.
+  map<TNetworkAddress, vector<RemoteFragmentInstance> > instances_per_host;
   // Start one fragment instance per fragment per host (number of hosts running each
   // fragment may not be constant).
   for (int fragment_idx = first_remote_fragment_idx;
@@ -580,25 +609,33 @@ Status Coordinator::StartRemoteFragments(QuerySchedule* schedule) {
     int num_hosts = params->hosts.size();
     DCHECK_GT(num_hosts, 0);
     fragment_profiles_[fragment_idx].num_instances = num_hosts;
+    GetFragmentDescriptorTable(request.fragments[fragment_idx], &desc_tbls[fragment_idx]);
     // Start one fragment instance for every fragment_instance required by the
     // schedule. Each fragment instance is assigned a unique ID, numbered from 0, with
     // instances for fragment ID 0 being assigned IDs [0 .. num_hosts(fragment_id_0)] and
     // so on.
     for (int fragment_instance_idx = 0; fragment_instance_idx < num_hosts;
          ++fragment_instance_idx) {
-      DebugOptions* fragment_instance_debug_options =
+      RemoteFragmentInstance instance;
+      instance.fragment_exec_params = params;
+      instance.plan_fragment = &request.fragments[fragment_idx];
+      instance.desc_tbl = &desc_tbls[fragment_idx];
+      instance.debug_options =
           debug_options.IsApplicable(instance_state_idx) ? &debug_options : NULL;
-      exec_env_->fragment_exec_thread_pool()->Offer(
-          bind<void>(mem_fn(&Coordinator::ExecRemoteFragment), this,
-              params, // fragment_exec_params
-              &request.fragments[fragment_idx], // plan_fragment,
-              fragment_instance_debug_options,
-              schedule,
-              instance_state_idx++,
-              fragment_idx,
-              fragment_instance_idx));
+      instance.instance_state_idx = instance_state_idx++;
+      instance.fragment_idx = fragment_idx;
+      instance.fragment_instance_idx = fragment_instance_idx;
+      instances_per_host[params->hosts[fragment_instance_idx]].push_back(instance);
     }
   }
+  // Issue the RPCs of each impalad from a single thread, in fragment order. The number
+  // of RPCs in flight is bounded by the size of the thread pool, and each impalad only
+  // needs one connection regardless of how many instances it runs.
+  for (const auto& host_instances: instances_per_host) {
+    exec_env_->fragment_exec_thread_pool()->Offer(
+        bind<void>(mem_fn(&Coordinator::ExecRemoteFragments), this,
+            &host_instances.second, schedule));
+  }
   exec_complete_barrier_->Wait();
   query_events_->MarkEvent(
       Substitute("All $0 remote fragments started", instance_state_idx));
@@ -1247,6 +1284,7 @@ void Coordinator::InitExecProfile(const TQueryExecRequest& request) {
   fragment_profiles_.resize(request.fragments.size());
   for (int i = 0; i < request.fragments.size(); ++i) {
     fragment_profiles_[i].num_instances = 0;
+    fragment_profiles_[i].last_average_update_ms = obj_pool()->Add(new AtomicInt64(0));
 
     // Special case fragment idx 0 if there is a coordinator. There is only one
     // instance of this profile so the average is just the coordinator profile.
@@ -1358,23 +1396,41 @@ int64_t Coordinator::ComputeTotalScanRangesComplete(int node_id) {
   return value;
 }
 
-void Coordinator::ExecRemoteFragment(const FragmentExecParams* fragment_exec_params,
-    const TPlanFragment* plan_fragment, DebugOptions* debug_options,
-    QuerySchedule* schedule, int instance_state_idx, int fragment_idx,
-    int fragment_instance_idx) {
+void Coordinator::ExecRemoteFragments(const vector<RemoteFragmentInstance>* instances,
+    QuerySchedule* schedule) {
+  DCHECK(!instances->empty());
+  const RemoteFragmentInstance& first_instance = instances->front();
+  const TNetworkAddress& impalad_address = first_instance.fragment_exec_params->hosts[
+      first_instance.fragment_instance_idx];
+  Status client_connect_status;
+  ImpalaBackendConnection backend_client(exec_env_->impalad_client_cache(),
+      impalad_address, &client_connect_status);
+  for (const RemoteFragmentInstance& instance: *instances) {
+    ExecRemoteFragment(instance, schedule,
+        client_connect_status.ok() ? &backend_client : NULL, client_connect_status);
+  }
+}
+
+void Coordinator::ExecRemoteFragment(const RemoteFragmentInstance& instance,
+    QuerySchedule* schedule, ImpalaBackendConnection* backend_client,
+    const Status& client_connect_status) {
   NotifyBarrierOnExit notifier(exec_complete_barrier_.get());
+  const FragmentExecParams* fragment_exec_params = instance.fragment_exec_params;
+  int instance_state_idx = instance.instance_state_idx;
+  DebugOptions* debug_options = instance.debug_options;
   TExecPlanFragmentParams rpc_params;
-  SetExecPlanFragmentParams(*schedule, *plan_fragment, *fragment_exec_params,
-      instance_state_idx, fragment_idx, fragment_instance_idx,
-      MakeNetworkAddress(FLAGS_hostname, FLAGS_be_port), &rpc_params);
+  SetExecPlanFragmentParams(*schedule, *instance.plan_fragment, *instance.desc_tbl,
+      *fragment_exec_params, instance_state_idx, instance.fragment_idx,
+      instance.fragment_instance_idx, MakeNetworkAddress(FLAGS_hostname, FLAGS_be_port),
+      &rpc_params);
   if (debug_options != NULL) {
     rpc_params.fragment_instance_ctx.__set_debug_node_id(debug_options->node_id);
     rpc_params.fragment_instance_ctx.__set_debug_action(debug_options->action);
     rpc_params.fragment_instance_ctx.__set_debug_phase(debug_options->phase);
   }
   FragmentInstanceState* exec_state = obj_pool()->Add(
-      new FragmentInstanceState(fragment_idx, fragment_exec_params, fragment_instance_idx,
-          obj_pool()));
+      new FragmentInstanceState(instance.fragment_idx, fragment_exec_params,
+          instance.fragment_instance_idx, obj_pool()));
   exec_state->ComputeTotalSplitSize(
       rpc_params.fragment_instance_ctx.per_node_scan_ranges);
   fragment_instance_states_[instance_state_idx] = exec_state;
@@ -1386,16 +1442,14 @@ void Coordinator::ExecRemoteFragment(const FragmentExecParams* fragment_exec_par
   lock_guard<mutex> l(*exec_state->lock());
   int64_t start = MonotonicMillis();
 
-  Status client_connect_status;
-  ImpalaBackendConnection backend_client(exec_env_->impalad_client_cache(),
-      exec_state->impalad_address(), &client_connect_status);
-  if (!client_connect_status.ok()) {
+  if (backend_client == NULL) {
+    DCHECK(!client_connect_status.ok());
     exec_state->SetInitialStatus(client_connect_status);
     return;
   }
 
   TExecPlanFragmentResult thrift_result;
-  Status rpc_status = backend_client.DoRpc(&ImpalaBackendClient::ExecPlanFragment,
+  Status rpc_status = backend_client->DoRpc(&ImpalaBackendClient::ExecPlanFragment,
       rpc_params, &thrift_result);
 
   exec_state->SetRpcLatency(MonotonicMillis() - start);
@@ -1447,6 +1501,10 @@ void Coordinator::CancelInternal() {
 }
 
 void Coordinator::CancelRemoteFragments() {
+  MonotonicStopWatch cancel_timer;
+  cancel_timer.Start();
+  InstancesPerHost instances_per_host;
+  int num_instances = 0;
   for (int i = 0; i < fragment_instance_states_.size(); ++i) {
     FragmentInstanceState* exec_state = fragment_instance_states_[i];
 
@@ -1471,40 +1529,76 @@ void Coordinator::CancelRemoteFragments() {
 
     // set an error status to make sure we only cancel this once
     exec_state->SetStatus(Status::CANCELLED);
+    instances_per_host[exec_state->impalad_address()].push_back(exec_state);
+    ++num_instances;
+  }
+
+  if (!instances_per_host.empty()) {
+    // Deal the impalads round-robin to at most --coordinator_cancellation_fanout
+    // threads. The threads don't come from the fragment exec thread pool because lock_
+    // may be held here, and the pool's threads can block on lock_ in UpdateStatus().
+    int num_threads = min<int>(instances_per_host.size(),
+        max(FLAGS_coordinator_cancellation_fanout, 1));
+    vector<vector<const InstancesPerHost::value_type*> > hosts_per_thread(num_threads);
+    int host_idx = 0;
+    for (const InstancesPerHost::value_type& host_instances: instances_per_host) {
+      hosts_per_thread[host_idx++ % num_threads].push_back(&host_instances);
+    }
+    vector<void*> args;
+    for (int i = 0; i < num_threads; ++i) args.push_back(&hosts_per_thread[i]);
+    ParallelExecutor::Exec(
+        bind<Status>(mem_fn(&Coordinator::CancelRemoteFragmentsOnHosts), this, _1),
+        &args[0], args.size());
+    int64_t cancel_time = cancel_timer.ElapsedTime();
+    VLOG_QUERY << "Cancelled " << num_instances << " remote fragment instances on "
+               << instances_per_host.size() << " backends for query_id=" << query_id_
+               << " in " << PrettyPrinter::Print(cancel_time, TUnit::TIME_NS);
+    if (ImpaladMetrics::CANCEL_REMOTE_FRAGMENTS_DURATIONS != NULL) {
+      ImpaladMetrics::CANCEL_REMOTE_FRAGMENTS_DURATIONS->Update(cancel_time);
+    }
+  }
 
+  // notify that we completed with an error
+  backend_completion_cv_.notify_all();
+}
+
+Status Coordinator::CancelRemoteFragmentsOnHosts(void* hosts) {
+  for (const InstancesPerHost::value_type* host_instances:
+       *reinterpret_cast<vector<const InstancesPerHost::value_type*>*>(hosts)) {
     // if we get an error while trying to get a connection to the backend,
     // keep going
     Status status;
     ImpalaBackendConnection backend_client(
-        exec_env_->impalad_client_cache(), exec_state->impalad_address(), &status);
+        exec_env_->impalad_client_cache(), host_instances->first, &status);
     if (!status.ok()) continue;
 
-    TCancelPlanFragmentParams params;
-    params.protocol_version = ImpalaInternalServiceVersion::V1;
-    params.__set_fragment_instance_id(exec_state->fragment_instance_id());
-    TCancelPlanFragmentResult res;
-    VLOG_QUERY << "sending CancelPlanFragment rpc for instance_id="
-               << exec_state->fragment_instance_id() << " backend="
-               << exec_state->impalad_address();
-    Status rpc_status = backend_client.DoRpc(
-        &ImpalaBackendClient::CancelPlanFragment, params, &res);
-    if (!rpc_status.ok()) {
-      exec_state->status()->MergeStatus(rpc_status);
-      stringstream msg;
-      msg << "CancelPlanFragment rpc query_id=" << query_id_
-          << " instance_id=" << exec_state->fragment_instance_id()
-          << " failed: " << rpc_status.msg().msg();
-      // make a note of the error status, but keep on cancelling the other fragments
-      exec_state->status()->AddDetail(msg.str());
-      continue;
-    }
-    if (res.status.status_code != TErrorCode::OK) {
+    for (FragmentInstanceState* exec_state: host_instances->second) {
+      TCancelPlanFragmentParams params;
+      params.protocol_version = ImpalaInternalServiceVersion::V1;
+      params.__set_fragment_instance_id(exec_state->fragment_instance_id());
+      TCancelPlanFragmentResult res;
+      VLOG_QUERY << "sending CancelPlanFragment rpc for instance_id="
+                 << exec_state->fragment_instance_id() << " backend="
+                 << exec_state->impalad_address();
+      Status rpc_status = backend_client.DoRpc(
+          &ImpalaBackendClient::CancelPlanFragment, params, &res);
+      if (rpc_status.ok() && res.status.status_code == TErrorCode::OK) continue;
+
+      lock_guard<mutex> l(*exec_state->lock());
+      if (!rpc_status.ok()) {
+        exec_state->status()->MergeStatus(rpc_status);
+        stringstream msg;
+        msg << "CancelPlanFragment rpc query_id=" << query_id_
+            << " instance_id=" << exec_state->fragment_instance_id()
+            << " failed: " << rpc_status.msg().msg();
+        // make a note of the error status, but keep on cancelling the other fragments
+        exec_state->status()->AddDetail(msg.str());
+        continue;
+      }
       exec_state->status()->AddDetail(join(res.status.error_msgs, "; "));
     }
   }
-
-  // notify that we completed with an error
-  backend_completion_cv_.notify_all();
+  return Status::OK();
 }
 
 Status Coordinator::UpdateFragmentExecStatus(const TReportExecStatusParams& params) {
@@ -1546,7 +1640,7 @@ Status Coordinator::UpdateFragmentExecStatus(const TReportExecStatusParams& para
 
       // Update the average profile for the fragment corresponding to this instance.
       exec_state->profile()->ComputeTimeInProfile();
-      UpdateAverageProfile(exec_state);
+      UpdateAverageProfile(exec_state, true);
       UpdateExecSummary(exec_state->fragment_idx(), exec_state->instance_idx(),
           exec_state->profile());
     }
@@ -1674,14 +1768,29 @@ typedef struct {
 } InstanceComparator;
 
 // Update fragment average profile information from a backend execution state.
-void Coordinator::UpdateAverageProfile(FragmentInstanceState* fragment_instance_state) {
+void Coordinator::UpdateAverageProfile(FragmentInstanceState* fragment_instance_state,
+    bool sampled) {
   int fragment_idx = fragment_instance_state->fragment_idx();
   DCHECK_GE(fragment_idx, 0);
   DCHECK_LT(fragment_idx, fragment_profiles_.size());
   PerFragmentProfileData& data = fragment_profiles_[fragment_idx];
 
+  // With many instances, the status reports of a fragment would otherwise all contend
+  // on the locks of its averaged profile. Only the first report in each interval
+  // updates it, the others leave the average (which is only approximate while the
+  // query runs) alone instead of waiting.
+  bool update_average = true;
+  if (sampled && FLAGS_averaged_profile_update_interval_ms > 0) {
+    int64_t now = MonotonicMillis();
+    int64_t last_update = data.last_average_update_ms->Load();
+    update_average = now - last_update >= FLAGS_averaged_profile_update_interval_ms &&
+        data.last_average_update_ms->CompareAndSwap(last_update, now);
+  }
+
   // No locks are taken since UpdateAverage() and AddChild() take their own locks
-  data.averaged_profile->UpdateAverage(fragment_instance_state->profile());
+  if (update_average) {
+    data.averaged_profile->UpdateAverage(fragment_instance_state->profile());
+  }
   data.root_profile->AddChild(fragment_instance_state->profile());
 }
 
@@ -1758,7 +1867,7 @@ void Coordinator::ReportQuerySummary() {
     // Average all remote fragments for each fragment.
     for (int i = 0; i < fragment_instance_states_.size(); ++i) {
       fragment_instance_states_[i]->profile()->ComputeTimeInProfile();
-      UpdateAverageProfile(fragment_instance_states_[i]);
+      UpdateAverageProfile(fragment_instance_states_[i], false);
       ComputeFragmentSummaryStats(fragment_instance_states_[i]);
       UpdateExecSummary(fragment_instance_states_[i]->fragment_idx(),
           fragment_instance_states_[i]->instance_idx(),
@@ -1857,11 +1966,13 @@ string Coordinator::GetErrorLog() {
 }
 
 void Coordinator::SetExecPlanFragmentParams(QuerySchedule& schedule,
-    const TPlanFragment& fragment, const FragmentExecParams& params,
-    int instance_state_idx, int fragment_idx, int fragment_instance_idx,
-    const TNetworkAddress& coord, TExecPlanFragmentParams* rpc_params) {
+    const TPlanFragment& fragment, const TDescriptorTable& desc_tbl,
+    const FragmentExecParams& params, int instance_state_idx, int fragment_idx,
+    int fragment_instance_idx, const TNetworkAddress& coord,
+    TExecPlanFragmentParams* rpc_params) {
   rpc_params->__set_protocol_version(ImpalaInternalServiceVersion::V1);
   rpc_params->__set_query_ctx(query_ctx_);
+  rpc_params->query_ctx.__set_desc_tbl(desc_tbl);
 
   TPlanFragmentCtx fragment_ctx;
   TPlanFragmentInstanceCtx fragment_instance_ctx;
@@ -1893,7 +2004,6 @@ void Coordinator::SetExecPlanFragmentParams(QuerySchedule& schedule,
       }
     }
   }
-  SetExecPlanDescriptorTable(fragment, rpc_params);
 
   TNetworkAddress exec_host = params.hosts[fragment_instance_idx];
   if (schedule.HasReservation()) {
@@ -1910,11 +2020,17 @@ void Coordinator::SetExecPlanFragmentParams(QuerySchedule& schedule,
       fragment_instance_ctx.__set_local_resource_address(resource_hostport);
     }
   }
-  FragmentScanRangeAssignment::const_iterator it =
-      params.scan_range_assignment.find(exec_host);
   // Scan ranges may not always be set, so use an empty structure if so.
-  const PerNodeScanRanges& scan_ranges =
-      (it != params.scan_range_assignment.end()) ? it->second : PerNodeScanRanges();
+  PerNodeScanRanges scan_ranges;
+  if (!params.per_instance_scan_ranges.empty()) {
+    // The host runs several instances of the fragment which split its scan ranges.
+    DCHECK_EQ(params.per_instance_scan_ranges.size(), params.hosts.size());
+    scan_ranges = params.per_instance_scan_ranges[fragment_instance_idx];
+  } else {
+    FragmentScanRangeAssignment::const_iterator it =
+        params.scan_range_assignment.find(exec_host);
+    if (it != params.scan_range_assignment.end()) scan_ranges = it->second;
+  }
 
   fragment_ctx.num_fragment_instances = params.instance_ids.size();
   fragment_instance_ctx.__set_request_pool(schedule.request_pool());
@@ -1929,10 +2045,9 @@ void Coordinator::SetExecPlanFragmentParams(QuerySchedule& schedule,
   rpc_params->__set_fragment_instance_ctx(fragment_instance_ctx);
 }
 
-void Coordinator::SetExecPlanDescriptorTable(const TPlanFragment& fragment,
-    TExecPlanFragmentParams* rpc_params) {
-  DCHECK(rpc_params->__isset.query_ctx);
-  TDescriptorTable thrift_desc_tbl;
+void Coordinator::GetFragmentDescriptorTable(const TPlanFragment& fragment,
+    TDescriptorTable* desc_tbl) {
+  TDescriptorTable& thrift_desc_tbl = *desc_tbl;
 
   // Always add the Tuple and Slot descriptors.
   thrift_desc_tbl.__set_tupleDescriptors(desc_tbl_.tupleDescriptors);
@@ -1995,8 +2110,6 @@ void Coordinator::SetExecPlanDescriptorTable(const TPlanFragment& fragment,
     thrift_desc_tbl.tableDescriptors.push_back(table_desc);
     thrift_desc_tbl.__isset.tableDescriptors = true;
   }
-
-  rpc_params->query_ctx.__set_desc_tbl(thrift_desc_tbl);
 }
 namespace {
 
@@ -2009,7 +2122,6 @@ void DistributeFilters(shared_ptr<TPublishFilterParams> params, TNetworkAddress
   // Make a local copy of the shared 'master' set of parameters
   TPublishFilterParams local_params(*params);
   local_params.dst_instance_id = fragment_instance_id;
-  local_params.__set_bloom_filter(params->bloom_filter);
   TPublishFilterResult res;
   backend_client.DoRpc(&ImpalaBackendClient::PublishFilter, local_params, &res);
 };
@@ -2025,9 +2137,7 @@ void Coordinator::UpdateFilter(const TUpdateFilterParams& params) {
   DCHECK(filter_routing_table_complete_)
       << "Filter received before routing table complete";
 
-  // Make a 'master' copy that will be shared by all concurrent delivery RPC attempts.
-  shared_ptr<TPublishFilterParams> rpc_params(new TPublishFilterParams());
-  unordered_set<int32_t> target_fragment_instance_idxs;
+  FilterState* state;
   {
     lock_guard<SpinLock> l(filter_lock_);
     FilterRoutingTable::iterator it = filter_routing_table_.find(params.filter_id);
@@ -2035,42 +2145,55 @@ void Coordinator::UpdateFilter(const TUpdateFilterParams& params) {
       LOG(INFO) << "Could not find filter with id: " << params.filter_id;
       return;
     }
-    FilterState* state = &it->second;
-
-    DCHECK(state->desc.has_remote_targets)
-          << "Coordinator received filter that has only local targets";
-
-    // Check if the filter has already been sent, which could happen in two cases: if one
-    // local filter had always_true set - no point waiting for other local filters that
-    // can't affect the aggregated global filter, or if this is a broadcast join, and
-    // another local filter was already received.
-    if (state->pending_count == 0) return;
-    DCHECK_EQ(state->completion_time, 0L);
-    if (state->first_arrival_time == 0L) {
-      state->first_arrival_time = query_events_->ElapsedTime();
-    }
+    state = &it->second;
+  }
+  DCHECK(state->desc.has_remote_targets)
+      << "Coordinator received filter that has only local targets";
 
-    if (filter_updates_received_->value() == 0) {
-      query_events_->MarkEvent("First dynamic filter received");
+  // Make a 'master' copy that will be shared by all concurrent delivery RPC attempts.
+  shared_ptr<TPublishFilterParams> rpc_params(new TPublishFilterParams());
+  unordered_set<int32_t> target_fragment_instance_idxs;
+  {
+    // Updates of other filters proceed concurrently, only 'filter_lock_' is shared.
+    lock_guard<mutex> update_lock(state->update_lock);
+    {
+      lock_guard<SpinLock> l(filter_lock_);
+      // Check if the filter has already been sent, which could happen in two cases: if
+      // one local filter had always_true set - no point waiting for other local filters
+      // that can't affect the aggregated global filter, or if this is a broadcast join,
+      // and another local filter was already received.
+      if (state->pending_count == 0) return;
+      DCHECK_EQ(state->completion_time, 0L);
+      if (state->first_arrival_time == 0L) {
+        state->first_arrival_time = query_events_->ElapsedTime();
+      }
+
+      if (filter_updates_received_->value() == 0) {
+        query_events_->MarkEvent("First dynamic filter received");
+      }
+      filter_updates_received_->Add(1);
     }
-    filter_updates_received_->Add(1);
+
     if (params.bloom_filter.always_true) {
       state->bloom_filter = NULL;
-      state->pending_count = 0;
+    } else if (state->bloom_filter == NULL) {
+      state->bloom_filter = obj_pool()->Add(new BloomFilter(params.bloom_filter));
     } else {
-      if (state->bloom_filter == NULL) {
-        state->bloom_filter = obj_pool()->Add(new BloomFilter(params.bloom_filter));
-      } else {
-        // TODO: Implement BloomFilter::Or(const ThriftBloomFilter&)
-        state->bloom_filter->Or(BloomFilter(params.bloom_filter));
-      }
-      if (--state->pending_count > 0) return;
+      state->bloom_filter->Or(params.bloom_filter);
     }
 
-    // No more filters are pending on this filter ID. Create a distribution payload and
-    // offer it to the queue.
-    DCHECK_EQ(state->pending_count, 0);
-    state->completion_time = query_events_->ElapsedTime();
+    {
+      lock_guard<SpinLock> l(filter_lock_);
+      if (params.bloom_filter.always_true) {
+        state->pending_count = 0;
+      } else if (--state->pending_count > 0) {
+        return;
+      }
+      // No more filters are pending on this filter ID. Create a distribution payload and
+      // offer it to the queue.
+      DCHECK_EQ(state->pending_count, 0);
+      state->completion_time = query_events_->ElapsedTime();
+    }
     for (const auto& target: state->targets) {
       // Don't publish the filter to targets that are in the same fragment as the join
       // that produced it.
@@ -2078,8 +2201,18 @@ void Coordinator::UpdateFilter(const TUpdateFilterParams& params) {
       target_fragment_instance_idxs.insert(target.fragment_instance_idxs.begin(),
           target.fragment_instance_idxs.end());
     }
-    BloomFilter::ToThrift(state->bloom_filter, &rpc_params->bloom_filter);
+    if (state->bloom_filter == NULL) {
+      BloomFilter::ToThrift(NULL, &rpc_params->bloom_filter);
+    } else {
+      // Filters of partitioned joins are sized before the NDV of the build side is
+      // known. Shrink the aggregated filter to its NDV before sending it to every target.
+      int log_space = RuntimeFilterBank::GetFittedLogSpace(*state->bloom_filter,
+          state->bloom_filter->EstimateNdv(), RuntimeFilterBank::MIN_BLOOM_FILTER_SIZE);
+      state->bloom_filter->FoldToThrift(log_space, &rpc_params->bloom_filter);
+    }
   }
+  // The copies in DistributeFilters() share the filter of the master copy.
+  rpc_params->__isset.bloom_filter = true;
 
   rpc_params->filter_id = params.filter_id;
 
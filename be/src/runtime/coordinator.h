@@ -31,12 +31,14 @@
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/condition_variable.hpp>
 
+#include "common/atomic.h"
 #include "common/hdfs.h"
 #include "common/status.h"
 #include "common/global-types.h"
 #include "util/progress-updater.h"
 #include "util/histogram-metric.h"
 #include "util/runtime-profile.h"
+#include "runtime/client-cache-types.h"
 #include "runtime/runtime-state.h"
 #include "scheduling/simple-scheduler.h"
 #include "gen-cpp/Types_types.h"
@@ -66,6 +68,7 @@ class RuntimeProfile;
 class TablePrinter;
 
 struct DebugOptions;
+struct RemoteFragmentInstance;
 
 /// Query coordinator: handles execution of plan fragments on remote nodes, given
 /// a TQueryExecRequest. As part of that, it handles all interactions with the
@@ -268,9 +271,10 @@ class Coordinator {
   /// Returns a local object pool.
   ObjectPool* obj_pool() { return obj_pool_.get(); }
 
-  // Sets the TDescriptorTable(s) for the current fragment.
-  void SetExecPlanDescriptorTable(const TPlanFragment& fragment,
-      TExecPlanFragmentParams* rpc_params);
+  /// Computes into 'desc_tbl' the subset of the query's descriptor table that is needed
+  /// by 'fragment'.
+  void GetFragmentDescriptorTable(const TPlanFragment& fragment,
+      TDescriptorTable* desc_tbl);
 
   /// True if execution has completed, false otherwise.
   bool execution_completed_;
@@ -341,6 +345,10 @@ class Coordinator {
 
     /// Execution rates for instances of this fragment
     SummaryStats rates;
+
+    /// Time (MonotonicMillis()) of the last update of 'averaged_profile' from a status
+    /// report. Stored in obj_pool. Used to sample the reports that update the average.
+    AtomicInt64* last_average_update_ms;
   };
 
   /// This is indexed by fragment_idx.
@@ -397,10 +405,16 @@ class Coordinator {
     /// Time at which all local filters arrived.
     int64_t completion_time;
 
+    /// Serializes the updates of this filter in UpdateFilter(). Merging large Bloom
+    /// filters takes a while, so it is done while holding this lock instead of
+    /// 'filter_lock_', which is shared by all filters of the query.
+    boost::mutex update_lock;
+
     FilterState() : bloom_filter(NULL), first_arrival_time(0L), completion_time(0L) { }
   };
 
-  /// Protects filter_routing_table_.
+  /// Protects filter_routing_table_, and the 'pending_count', 'first_arrival_time' and
+  /// 'completion_time' of its filters.
   SpinLock filter_lock_;
 
   /// Map from filter ID to filter.
@@ -425,6 +439,7 @@ class Coordinator {
   void MarkFilterRoutingTableComplete();
 
   /// Fill in rpc_params based on parameters.
+  /// 'desc_tbl' is the descriptor table of 'fragment' (see GetFragmentDescriptorTable()).
   /// 'instance_state_idx' is the index of the fragment instance state in
   /// fragment_instance_states_.
   /// 'fragment_idx' is the 0-based query-wide ordinal of the fragment of which it is an
@@ -432,17 +447,23 @@ class Coordinator {
   /// 'fragment_instance_idx' is the 0-based ordinal of this particular fragment
   /// instance within its fragment.
   void SetExecPlanFragmentParams(QuerySchedule& schedule, const TPlanFragment& fragment,
-      const FragmentExecParams& params, int instance_state_idx, int fragment_idx,
-      int fragment_instance_idx, const TNetworkAddress& coord,
-      TExecPlanFragmentParams* rpc_params);
-
-  /// Wrapper for ExecPlanFragment() RPC. This function will be called in parallel from
-  /// multiple threads. Creates a new FragmentInstanceState and registers it in
-  /// fragment_instance_states_, then calls RPC to issue fragment on remote impalad.
-  void ExecRemoteFragment(const FragmentExecParams* fragment_exec_params,
-      const TPlanFragment* plan_fragment, DebugOptions* debug_options,
-      QuerySchedule* schedule, int instance_state_idx, int fragment_idx,
-      int fragment_instance_idx);
+      const TDescriptorTable& desc_tbl, const FragmentExecParams& params,
+      int instance_state_idx, int fragment_idx, int fragment_instance_idx,
+      const TNetworkAddress& coord, TExecPlanFragmentParams* rpc_params);
+
+  /// Starts all fragment instances in 'instances', which run on the same remote impalad,
+  /// by calling ExecRemoteFragment() for each of them over a single connection. This
+  /// function will be called in parallel from multiple threads, one call per impalad.
+  void ExecRemoteFragments(const std::vector<RemoteFragmentInstance>* instances,
+      QuerySchedule* schedule);
+
+  /// Wrapper for ExecPlanFragment() RPC. Creates a new FragmentInstanceState and
+  /// registers it in fragment_instance_states_, then calls RPC to issue fragment on
+  /// remote impalad. 'backend_client' is the connection to the impalad, or NULL if it
+  /// could not be opened with 'client_connect_status'.
+  void ExecRemoteFragment(const RemoteFragmentInstance& instance,
+      QuerySchedule* schedule, ImpalaBackendConnection* backend_client,
+      const Status& client_connect_status);
 
   /// Determine fragment number, given fragment id.
   int GetFragmentNum(const TUniqueId& fragment_id);
@@ -471,9 +492,22 @@ class Coordinator {
 
   /// Cancels remote fragments. Assumes that lock_ is held.  This can be called when
   /// the query is not being cancelled in the case where the query limit is
-  /// reached.
+  /// reached. The CancelPlanFragment() RPCs of each impalad are sent over a single
+  /// connection, and up to --coordinator_cancellation_fanout impalads are cancelled
+  /// concurrently.
   void CancelRemoteFragments();
 
+  /// The fragment instances with a pending CancelPlanFragment() RPC, grouped by the
+  /// impalad they run on.
+  typedef std::map<TNetworkAddress, std::vector<FragmentInstanceState*> >
+      InstancesPerHost;
+
+  /// Sends the CancelPlanFragment() RPCs of the instances of every impalad in 'hosts',
+  /// which is a std::vector<const InstancesPerHost::value_type*>. RPC errors are
+  /// recorded in the instances' status. Always returns OK. Called from a
+  /// ParallelExecutor thread by CancelRemoteFragments().
+  Status CancelRemoteFragmentsOnHosts(void* hosts);
+
   /// Acquires lock_ and updates query_status_ with 'status' if it's not already
   /// an error status, and returns the current query_status_.
   /// Calls CancelInternal() when switching to an error status.
@@ -505,8 +539,11 @@ class Coordinator {
   /// This is called repeatedly from UpdateFragmentExecStatus(),
   /// and also at the end of the query from ReportQuerySummary().
   /// This method calls UpdateAverage() and AddChild(), which obtain their own locks
-  /// on the instance state.
-  void UpdateAverageProfile(FragmentInstanceState* fragment_instance_state);
+  /// on the instance state. If 'sampled' is true, the averaged profile is only updated
+  /// if no other status report updated it in the last
+  /// FLAGS_averaged_profile_update_interval_ms.
+  void UpdateAverageProfile(FragmentInstanceState* fragment_instance_state,
+      bool sampled);
 
   /// Compute the summary stats (completion_time and rates)
   /// for an individual fragment_profile_ based on the specified backed_exec_state.
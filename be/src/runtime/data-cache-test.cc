@@ -0,0 +1,106 @@
+// Copyright 2016 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <boost/filesystem.hpp>
+
+#include "runtime/data-cache.h"
+#include "testutil/gtest-util.h"
+#include "util/cpu-info.h"
+
+#include "common/names.h"
+
+namespace filesystem = boost::filesystem;
+
+namespace impala {
+
+static const char* CACHE_DIR_1 = "/tmp/data-cache-test-1";
+static const char* CACHE_DIR_2 = "/tmp/data-cache-test-2";
+
+// Returns the number of files in 'dir'.
+static int NumFiles(const string& dir) {
+  int num_files = 0;
+  for (filesystem::directory_iterator it(dir); it != filesystem::directory_iterator();
+      ++it) {
+    ++num_files;
+  }
+  return num_files;
+}
+
+TEST(DataCacheTest, StoreAndLookup) {
+  vector<string> dirs;
+  dirs.push_back(CACHE_DIR_1);
+  dirs.push_back(CACHE_DIR_2);
+  DataCache cache(dirs, 1024 * 1024);
+  ASSERT_OK(cache.Init());
+
+  vector<uint8_t> data(4096);
+  for (int i = 0; i < data.size(); ++i) data[i] = i % 256;
+  ASSERT_OK(cache.Store("hdfs://nn/file", 1, 100, data.size(), &data[0]));
+  EXPECT_EQ(cache.total_bytes(), data.size());
+
+  vector<uint8_t> buffer(data.size());
+  ASSERT_TRUE(cache.Lookup("hdfs://nn/file", 1, 100, data.size(), &buffer[0]));
+  EXPECT_TRUE(buffer == data);
+
+  // The extent must match exactly.
+  EXPECT_FALSE(cache.Lookup("hdfs://nn/file", 2, 100, data.size(), &buffer[0]));
+  EXPECT_FALSE(cache.Lookup("hdfs://nn/file", 1, 101, data.size(), &buffer[0]));
+  EXPECT_FALSE(cache.Lookup("hdfs://nn/file", 1, 100, data.size() - 1, &buffer[0]));
+  EXPECT_FALSE(cache.Lookup("hdfs://nn/other", 1, 100, data.size(), &buffer[0]));
+
+  // Storing the same extent again replaces it.
+  data[0] = 42;
+  ASSERT_OK(cache.Store("hdfs://nn/file", 1, 100, data.size(), &data[0]));
+  EXPECT_EQ(cache.total_bytes(), data.size());
+  ASSERT_TRUE(cache.Lookup("hdfs://nn/file", 1, 100, data.size(), &buffer[0]));
+  EXPECT_EQ(buffer[0], 42);
+  EXPECT_EQ(NumFiles(CACHE_DIR_1) + NumFiles(CACHE_DIR_2), 1);
+}
+
+TEST(DataCacheTest, Eviction) {
+  vector<string> dirs;
+  dirs.push_back(CACHE_DIR_1);
+  const int extent_len = 1024;
+  DataCache cache(dirs, 3 * extent_len);
+  ASSERT_OK(cache.Init());
+
+  vector<uint8_t> data(extent_len, 1);
+  vector<uint8_t> buffer(extent_len);
+  for (int i = 0; i < 3; ++i) {
+    ASSERT_OK(cache.Store("s3a://bucket/file", 1, i * extent_len, extent_len, &data[0]));
+  }
+  // Make the first extent the most recently used one.
+  ASSERT_TRUE(cache.Lookup("s3a://bucket/file", 1, 0, extent_len, &buffer[0]));
+  ASSERT_OK(cache.Store("s3a://bucket/file", 1, 3 * extent_len, extent_len, &data[0]));
+  EXPECT_EQ(cache.total_bytes(), 3 * extent_len);
+  EXPECT_TRUE(cache.Lookup("s3a://bucket/file", 1, 0, extent_len, &buffer[0]));
+  EXPECT_FALSE(cache.Lookup("s3a://bucket/file", 1, extent_len, extent_len, &buffer[0]));
+  // Evicted extents are deleted from disk.
+  EXPECT_EQ(NumFiles(CACHE_DIR_1), 3);
+
+  // Extents larger than the capacity are not stored.
+  vector<uint8_t> large_data(4 * extent_len);
+  ASSERT_OK(cache.Store("s3a://bucket/file", 1, 0, large_data.size(), &large_data[0]));
+  EXPECT_FALSE(
+      cache.Lookup("s3a://bucket/file", 1, 0, large_data.size(), &large_data[0]));
+  EXPECT_EQ(NumFiles(CACHE_DIR_1), 3);
+}
+
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  impala::CpuInfo::Init();
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,121 @@
+// Copyright 2016 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "runtime/data-cache.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <gutil/strings/substitute.h>
+
+#include "util/error-util.h"
+#include "util/filesystem-util.h"
+#include "util/hash-util.h"
+#include "util/lru-cache.inline.h"
+
+#include "common/names.h"
+
+using namespace impala;
+using namespace strings;
+
+bool DataCache::ExtentKey::operator<(const ExtentKey& other) const {
+  if (offset != other.offset) return offset < other.offset;
+  if (len != other.len) return len < other.len;
+  if (mtime != other.mtime) return mtime < other.mtime;
+  return file < other.file;
+}
+
+DataCache::ExtentFile::~ExtentFile() {
+  if (unlink(path_.c_str()) != 0) {
+    VLOG_FILE << "Could not remove data cache file " << path_ << ": " << GetStrErrMsg();
+  }
+}
+
+DataCache::DataCache(const vector<string>& dirs, int64_t capacity)
+  : dirs_(dirs), capacity_(capacity) {
+  DCHECK(!dirs_.empty());
+}
+
+Status DataCache::Init() {
+  for (const string& dir: dirs_) {
+    RETURN_IF_ERROR(FileSystemUtil::RemoveAndCreateDirectory(dir));
+    caches_.push_back(new ExtentCache(capacity_));
+  }
+  return Status::OK();
+}
+
+int DataCache::GetDirIdx(const ExtentKey& key) const {
+  uint32_t hash = HashUtil::Hash(key.file.data(), key.file.size(), 0);
+  hash = HashUtil::Hash(&key.offset, sizeof(key.offset), hash);
+  return hash % dirs_.size();
+}
+
+bool DataCache::Lookup(const string& file, int64_t mtime, int64_t offset, int64_t len,
+    uint8_t* buffer) {
+  ExtentKey key = { file, mtime, offset, len };
+  shared_ptr<ExtentFile> extent_file;
+  if (!caches_[GetDirIdx(key)].Get(key, &extent_file)) return false;
+
+  // 'extent_file' keeps the file from being deleted while it is read.
+  int fd = open(extent_file->path().c_str(), O_RDONLY);
+  if (fd == -1) {
+    VLOG_FILE << "Could not open data cache file " << extent_file->path() << ": "
+              << GetStrErrMsg();
+    return false;
+  }
+  int64_t bytes_read = 0;
+  while (bytes_read < len) {
+    int64_t ret = pread(fd, buffer + bytes_read, len - bytes_read, bytes_read);
+    if (ret <= 0) {
+      if (ret == -1 && errno == EINTR) continue;
+      VLOG_FILE << "Could not read data cache file " << extent_file->path() << ": "
+                << (ret == 0 ? "unexpected end of file" : GetStrErrMsg());
+      break;
+    }
+    bytes_read += ret;
+  }
+  close(fd);
+  return bytes_read == len;
+}
+
+Status DataCache::Store(const string& file, int64_t mtime, int64_t offset, int64_t len,
+    const uint8_t* buffer) {
+  if (len > capacity_) return Status::OK();
+  ExtentKey key = { file, mtime, offset, len };
+  int dir_idx = GetDirIdx(key);
+  // Deletes the file if it is not added to the cache.
+  shared_ptr<ExtentFile> extent_file(new ExtentFile(
+      Substitute("$0/extent-$1", dirs_[dir_idx], next_file_id_.Add(1))));
+
+  FILE* f = fopen(extent_file->path().c_str(), "w");
+  if (f == NULL) {
+    return Status(ErrorMsg(TErrorCode::RUNTIME_ERROR,
+        Substitute("fopen($0, \"w\") failed with errno=$1 description=$2",
+            extent_file->path(), errno, GetStrErrMsg())));
+  }
+  int64_t bytes_written = fwrite(buffer, 1, len, f);
+  int fclose_ret = fclose(f);
+  if (bytes_written < len || fclose_ret != 0) {
+    return Status(ErrorMsg(TErrorCode::RUNTIME_ERROR,
+        Substitute("Failed to write $0 bytes to $1: errno=$2 description=$3", len,
+            extent_file->path(), errno, GetStrErrMsg())));
+  }
+  caches_[dir_idx].Put(key, extent_file, len);
+  return Status::OK();
+}
+
+int64_t DataCache::total_bytes() {
+  int64_t total = 0;
+  for (ExtentCache& cache: caches_) total += cache.total_charge();
+  return total;
+}
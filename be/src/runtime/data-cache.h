@@ -0,0 +1,102 @@
+// Copyright 2016 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef IMPALA_RUNTIME_DATA_CACHE_H
+#define IMPALA_RUNTIME_DATA_CACHE_H
+
+#include <string>
+#include <vector>
+#include <boost/ptr_container/ptr_vector.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include "common/atomic.h"
+#include "common/status.h"
+#include "util/lru-cache.h"
+
+namespace impala {
+
+/// Cache of file extents in local directories, typically on SSDs. The DiskIoMgr uses it
+/// to avoid reading the same data of remote files (S3 or remote HDFS) over the network
+/// again. An extent is identified by the file name, the file's modification time, the
+/// offset and the length, so an extent of a modified file is never returned.
+//
+/// Each extent is stored in its own file in one of the cache directories, chosen by
+/// the hash of its key. The extents in each directory are limited to 'capacity' bytes
+/// and are evicted in LRU order. The index of the extents is only kept in memory; the
+/// directories are cleared by Init() and the contents do not survive a restart.
+//
+/// This class is thread-safe.
+class DataCache {
+ public:
+  /// 'dirs' are the cache directories, 'capacity' is the quota of each of them.
+  DataCache(const std::vector<std::string>& dirs, int64_t capacity);
+
+  /// Creates the cache directories, removing any existing contents.
+  Status Init();
+
+  /// Copies the extent of 'len' bytes at 'offset' in 'file' into 'buffer' if it is
+  /// cached and 'mtime' matches. Returns true on success.
+  bool Lookup(const std::string& file, int64_t mtime, int64_t offset, int64_t len,
+      uint8_t* buffer);
+
+  /// Stores the extent of 'len' bytes at 'offset' in 'file' from 'buffer', replacing
+  /// any cached version. Returns an error if the extent could not be written. Extents
+  /// that are larger than the capacity are silently not stored.
+  Status Store(const std::string& file, int64_t mtime, int64_t offset, int64_t len,
+      const uint8_t* buffer);
+
+  /// Returns the total size of the cached extents in bytes.
+  int64_t total_bytes();
+
+ private:
+  struct ExtentKey {
+    std::string file;
+    int64_t mtime;
+    int64_t offset;
+    int64_t len;
+
+    bool operator<(const ExtentKey& other) const;
+  };
+
+  /// The file holding a cached extent. The file is deleted when the last reference
+  /// goes away, i.e. after the extent was evicted and all lookups finished reading it.
+  class ExtentFile {
+   public:
+    ExtentFile(const std::string& path) : path_(path) { }
+    ~ExtentFile();
+
+    const std::string& path() const { return path_; }
+
+   private:
+    const std::string path_;
+  };
+
+  typedef LruCache<ExtentKey, boost::shared_ptr<ExtentFile> > ExtentCache;
+
+  /// Returns the index of the directory that stores 'key'.
+  int GetDirIdx(const ExtentKey& key) const;
+
+  const std::vector<std::string> dirs_;
+  const int64_t capacity_;
+
+  /// One cache for each directory in 'dirs_'.
+  boost::ptr_vector<ExtentCache> caches_;
+
+  /// Used to generate unique names for the extent files.
+  AtomicInt64 next_file_id_;
+};
+
+}
+
+#endif
@@ -40,17 +40,30 @@ DEFINE_int32(datastream_sender_timeout_ms, 120000, "(Advanced) The time, in ms,
     "elapse  before a plan fragment will time-out trying to send the initial row batch.");
 
 /// This parameter controls the minimum amount of time a closed stream ID will stay in
-/// closed_stream_cache_ before it is evicted. It needs to be set sufficiently high that
-/// it will outlive all the calls to FindRecvrOrWait() for that stream ID, to distinguish
-/// between was-here-but-now-gone and never-here states for the receiver. If the stream ID
-/// expires before a call to FindRecvrOrWait(), the sender will see an error which will
-/// lead to query cancellation. Setting this value higher will increase the size of the
-/// stream cache (which is roughly 48 bytes per receiver).
+/// the closed stream cache of its shard before it is evicted. It needs to be set
+/// sufficiently high that it will outlive all the calls to FindRecvrOrWait() for that
+/// stream ID, to distinguish between was-here-but-now-gone and never-here states for
+/// the receiver. If the stream ID expires before a call to FindRecvrOrWait(), the sender
+/// will see an error which will lead to query cancellation. Setting this value higher
+/// will increase the size of the stream cache (which is roughly 48 bytes per receiver).
 /// TODO: We don't need millisecond precision here.
 const int32_t STREAM_EXPIRATION_TIME_MS = 300 * 1000;
 
 namespace impala {
 
+const char* DataStreamMgr::RECVR_CLOSED_MSG = "Receiver closed";
+const int DataStreamMgr::NUM_SHARDS;
+
+void DataStreamMgr::SetRecvrClosed(TStatus* status) {
+  DCHECK_EQ(status->status_code, TErrorCode::OK);
+  status->error_msgs.assign(1, RECVR_CLOSED_MSG);
+}
+
+bool DataStreamMgr::IsRecvrClosed(const TStatus& status) {
+  return status.status_code == TErrorCode::OK && status.error_msgs.size() == 1
+      && status.error_msgs[0] == RECVR_CLOSED_MSG;
+}
+
 DataStreamMgr::DataStreamMgr(MetricGroup* metrics) {
   metrics_ = metrics->GetChildGroup("datastream-manager");
   num_senders_waiting_ =
@@ -69,6 +82,14 @@ inline uint32_t DataStreamMgr::GetHashValue(
   return value;
 }
 
+DataStreamMgr::Shard* DataStreamMgr::GetShard(const TUniqueId& fragment_instance_id) {
+  // Consecutive instance ids of a fragment only differ in 'lo', so both parts are
+  // hashed to spread them over the shards.
+  uint32_t value = RawValue::GetHashValue(&fragment_instance_id.lo, TYPE_BIGINT, 0);
+  value = RawValue::GetHashValue(&fragment_instance_id.hi, TYPE_BIGINT, value);
+  return &shards_[value % NUM_SHARDS];
+}
+
 shared_ptr<DataStreamRecvr> DataStreamMgr::CreateRecvr(RuntimeState* state,
     const RowDescriptor& row_desc, const TUniqueId& fragment_instance_id,
     PlanNodeId dest_node_id, int num_senders, int buffer_size, RuntimeProfile* profile,
@@ -81,13 +102,14 @@ shared_ptr<DataStreamRecvr> DataStreamMgr::CreateRecvr(RuntimeState* state,
           fragment_instance_id, dest_node_id, num_senders, is_merging, buffer_size,
           profile));
   size_t hash_value = GetHashValue(fragment_instance_id, dest_node_id);
-  lock_guard<mutex> l(lock_);
-  fragment_recvr_set_.insert(make_pair(fragment_instance_id, dest_node_id));
-  receiver_map_.insert(make_pair(hash_value, recvr));
+  Shard* shard = GetShard(fragment_instance_id);
+  lock_guard<mutex> l(shard->lock);
+  shard->fragment_recvr_set.insert(make_pair(fragment_instance_id, dest_node_id));
+  shard->receiver_map.insert(make_pair(hash_value, recvr));
 
   RendezvousMap::iterator it =
-      pending_rendezvous_.find(make_pair(fragment_instance_id, dest_node_id));
-  if (it != pending_rendezvous_.end()) it->second.promise->Set(recvr);
+      shard->pending_rendezvous.find(make_pair(fragment_instance_id, dest_node_id));
+  if (it != shard->pending_rendezvous.end()) it->second.promise->Set(recvr);
 
   return recvr;
 }
@@ -98,16 +120,18 @@ shared_ptr<DataStreamRecvr> DataStreamMgr::FindRecvrOrWait(
   RendezvousPromise* promise = NULL;
   RecvrId promise_key = make_pair(fragment_instance_id, node_id);
   *already_unregistered = false;
+  Shard* shard = GetShard(fragment_instance_id);
   {
-    lock_guard<mutex> l(lock_);
-    if (closed_stream_cache_.find(promise_key) != closed_stream_cache_.end()) {
+    lock_guard<mutex> l(shard->lock);
+    if (shard->closed_stream_cache.find(promise_key) !=
+        shard->closed_stream_cache.end()) {
       *already_unregistered = true;
       return shared_ptr<DataStreamRecvr>();
     }
-    shared_ptr<DataStreamRecvr> rcvr = FindRecvr(fragment_instance_id, node_id, false);
+    shared_ptr<DataStreamRecvr> rcvr = FindRecvr(shard, fragment_instance_id, node_id);
     if (rcvr.get() != NULL) return rcvr;
     // Find the rendezvous, creating a new one if one does not already exist.
-    RefCountedPromise* ref_counted_promise = &pending_rendezvous_[promise_key];
+    RefCountedPromise* ref_counted_promise = &shard->pending_rendezvous[promise_key];
     promise = ref_counted_promise->promise;
     ref_counted_promise->IncRefCount();
   }
@@ -131,59 +155,101 @@ shared_ptr<DataStreamRecvr> DataStreamMgr::FindRecvrOrWait(
   }
   if (timed_out) num_senders_timedout_->Increment(1L);
   {
-    lock_guard<mutex> l(lock_);
+    lock_guard<mutex> l(shard->lock);
     // If we are the last to leave, remove the rendezvous from the pending map. Any new
     // incoming senders will add a new entry to the map themselves.
-    if (pending_rendezvous_[promise_key].DecRefCount() == 0) {
-      pending_rendezvous_.erase(promise_key);
+    if (shard->pending_rendezvous[promise_key].DecRefCount() == 0) {
+      shard->pending_rendezvous.erase(promise_key);
     }
   }
   return rcvr;
 }
 
-shared_ptr<DataStreamRecvr> DataStreamMgr::FindRecvr(
-    const TUniqueId& fragment_instance_id, PlanNodeId node_id, bool acquire_lock) {
+shared_ptr<DataStreamRecvr> DataStreamMgr::FindRecvr(Shard* shard,
+    const TUniqueId& fragment_instance_id, PlanNodeId node_id) {
   VLOG_ROW << "looking up fragment_instance_id=" << fragment_instance_id
            << ", node=" << node_id;
+  DCHECK_EQ(shard, GetShard(fragment_instance_id));
   size_t hash_value = GetHashValue(fragment_instance_id, node_id);
-  if (acquire_lock) lock_.lock();
   pair<RecvrMap::iterator, RecvrMap::iterator> range =
-      receiver_map_.equal_range(hash_value);
+      shard->receiver_map.equal_range(hash_value);
   while (range.first != range.second) {
     shared_ptr<DataStreamRecvr> recvr = range.first->second;
     if (recvr->fragment_instance_id() == fragment_instance_id
         && recvr->dest_node_id() == node_id) {
-      if (acquire_lock) lock_.unlock();
       return recvr;
     }
     ++range.first;
   }
-  if (acquire_lock) lock_.unlock();
   return shared_ptr<DataStreamRecvr>();
 }
 
+void DataStreamMgr::DecodeSenderId(int wire_sender_id, int* sender_id,
+    int* num_instances) {
+  if (wire_sender_id >= 0) {
+    *sender_id = wire_sender_id;
+    *num_instances = 1;
+    return;
+  }
+  int value = -1 - wire_sender_id;
+  *sender_id = value / MAX_HOST_BROADCAST_INSTANCES;
+  *num_instances = value % MAX_HOST_BROADCAST_INSTANCES + 1;
+}
+
 Status DataStreamMgr::AddData(const TUniqueId& fragment_instance_id,
-    PlanNodeId dest_node_id, const TRowBatch& thrift_batch, int sender_id) {
+    PlanNodeId dest_node_id, const TRowBatch& thrift_batch, int sender_id,
+    bool* recvr_closed) {
   VLOG_ROW << "AddData(): fragment_instance_id=" << fragment_instance_id
            << " node=" << dest_node_id
            << " size=" << RowBatch::GetBatchSize(thrift_batch);
+  int num_instances;
+  DecodeSenderId(sender_id, &sender_id, &num_instances);
+  // Every receiver of a host broadcast deserializes its own copy of the rows, in turn,
+  // so a receiver with a full buffer holds up the ones after it.
+  int num_closed = 0;
+  TUniqueId instance_id = fragment_instance_id;
+  for (int i = 0; i < num_instances; ++i) {
+    instance_id.lo = fragment_instance_id.lo + i;
+    shared_ptr<DataStreamRecvr> recvr;
+    RETURN_IF_ERROR(FindRecvrForData(instance_id, dest_node_id, &recvr));
+    if (recvr.get() != NULL) {
+      recvr->AddBatch(thrift_batch, sender_id);
+    } else {
+      ++num_closed;
+    }
+  }
+  if (recvr_closed != NULL) *recvr_closed = num_closed == num_instances;
+  return Status::OK();
+}
+
+Status DataStreamMgr::AddData(const TUniqueId& fragment_instance_id,
+    PlanNodeId dest_node_id, RowBatch* batch, int sender_id, bool* recvr_closed) {
+  VLOG_ROW << "AddData(): fragment_instance_id=" << fragment_instance_id
+           << " node=" << dest_node_id << " local #rows=" << batch->num_rows();
+  shared_ptr<DataStreamRecvr> recvr;
+  RETURN_IF_ERROR(FindRecvrForData(fragment_instance_id, dest_node_id, &recvr));
+  if (recvr.get() != NULL) recvr->AddBatch(batch, sender_id);
+  if (recvr_closed != NULL) *recvr_closed = recvr.get() == NULL;
+  return Status::OK();
+}
+
+Status DataStreamMgr::FindRecvrForData(const TUniqueId& fragment_instance_id,
+    PlanNodeId node_id, shared_ptr<DataStreamRecvr>* recvr) {
   bool already_unregistered;
-  shared_ptr<DataStreamRecvr> recvr = FindRecvrOrWait(fragment_instance_id, dest_node_id,
-      &already_unregistered);
-  if (recvr.get() == NULL) {
+  *recvr = FindRecvrOrWait(fragment_instance_id, node_id, &already_unregistered);
+  if (recvr->get() == NULL) {
     // The receiver may remove itself from the receiver map via DeregisterRecvr() at any
     // time without considering the remaining number of senders.  As a consequence,
     // FindRecvrOrWait() may return NULL if a thread calling DeregisterRecvr() beat the
-    // thread calling FindRecvr() in acquiring lock_. We detect this case by checking
-    // already_unregistered - if true then the receiver was already closed deliberately,
-    // and there's no unexpected error here. If already_unregistered is false,
-    // FindRecvrOrWait() timed out, which is unexpected and suggests a query setup error;
-    // we return DATASTREAM_SENDER_TIMEOUT to trigger tear-down of the query.
+    // thread calling FindRecvr() in acquiring the shard lock. We detect this case by
+    // checking already_unregistered - if true then the receiver was already closed
+    // deliberately, and there's no unexpected error here. If already_unregistered is
+    // false, FindRecvrOrWait() timed out, which is unexpected and suggests a query setup
+    // error; we return DATASTREAM_SENDER_TIMEOUT to trigger tear-down of the query.
     return already_unregistered ? Status::OK() :
         Status(TErrorCode::DATASTREAM_SENDER_TIMEOUT, PrintId(fragment_instance_id));
   }
   DCHECK(!already_unregistered);
-  recvr->AddBatch(thrift_batch, sender_id);
   return Status::OK();
 }
 
@@ -191,41 +257,45 @@ Status DataStreamMgr::CloseSender(const TUniqueId& fragment_instance_id,
     PlanNodeId dest_node_id, int sender_id) {
   VLOG_FILE << "CloseSender(): fragment_instance_id=" << fragment_instance_id
             << ", node=" << dest_node_id;
-  bool unused;
-  shared_ptr<DataStreamRecvr> recvr = FindRecvrOrWait(fragment_instance_id, dest_node_id,
-      &unused);
-  if (recvr.get() != NULL) recvr->RemoveSender(sender_id);
-
-  {
-    // Remove any closed streams that have been in the cache for more than
-    // STREAM_EXPIRATION_TIME_MS.
-    lock_guard<mutex> l(lock_);
-    ClosedStreamMap::iterator it = closed_stream_expirations_.begin();
-    int64_t now = MonotonicMillis();
-    int32_t before = closed_stream_cache_.size();
-    while (it != closed_stream_expirations_.end() && it->first < now) {
-      closed_stream_cache_.erase(it->second);
-      closed_stream_expirations_.erase(it++);
-    }
-    DCHECK_EQ(closed_stream_cache_.size(), closed_stream_expirations_.size());
-    int32_t after = closed_stream_cache_.size();
-    if (before != after) {
-      VLOG_QUERY << "Reduced stream ID cache from " << before << " items, to " << after
-                 << ", eviction took: "
-                 << PrettyPrinter::Print(MonotonicMillis() - now, TUnit::TIME_MS);
-    }
+  int num_instances;
+  DecodeSenderId(sender_id, &sender_id, &num_instances);
+  TUniqueId instance_id = fragment_instance_id;
+  for (int i = 0; i < num_instances; ++i) {
+    instance_id.lo = fragment_instance_id.lo + i;
+    bool unused;
+    shared_ptr<DataStreamRecvr> recvr = FindRecvrOrWait(instance_id, dest_node_id,
+        &unused);
+    if (recvr.get() != NULL) recvr->RemoveSender(sender_id);
   }
   return Status::OK();
 }
 
+void DataStreamMgr::EvictClosedStreams(Shard* shard) {
+  ClosedStreamMap::iterator it = shard->closed_stream_expirations.begin();
+  int64_t now = MonotonicMillis();
+  int32_t before = shard->closed_stream_cache.size();
+  while (it != shard->closed_stream_expirations.end() && it->first < now) {
+    shard->closed_stream_cache.erase(it->second);
+    shard->closed_stream_expirations.erase(it++);
+  }
+  DCHECK_EQ(shard->closed_stream_cache.size(), shard->closed_stream_expirations.size());
+  int32_t after = shard->closed_stream_cache.size();
+  if (before != after) {
+    VLOG_QUERY << "Reduced stream ID cache from " << before << " items, to " << after
+               << ", eviction took: "
+               << PrettyPrinter::Print(MonotonicMillis() - now, TUnit::TIME_MS);
+  }
+}
+
 Status DataStreamMgr::DeregisterRecvr(
     const TUniqueId& fragment_instance_id, PlanNodeId node_id) {
   VLOG_QUERY << "DeregisterRecvr(): fragment_instance_id=" << fragment_instance_id
              << ", node=" << node_id;
   size_t hash_value = GetHashValue(fragment_instance_id, node_id);
-  lock_guard<mutex> l(lock_);
+  Shard* shard = GetShard(fragment_instance_id);
+  lock_guard<mutex> l(shard->lock);
   pair<RecvrMap::iterator, RecvrMap::iterator> range =
-      receiver_map_.equal_range(hash_value);
+      shard->receiver_map.equal_range(hash_value);
   while (range.first != range.second) {
     const shared_ptr<DataStreamRecvr>& recvr = range.first->second;
     if (recvr->fragment_instance_id() == fragment_instance_id
@@ -234,11 +304,14 @@ Status DataStreamMgr::DeregisterRecvr(
       recvr->CancelStream();
       RecvrId recvr_id =
           make_pair(recvr->fragment_instance_id(), recvr->dest_node_id());
-      fragment_recvr_set_.erase(recvr_id);
-      receiver_map_.erase(range.first);
-      closed_stream_expirations_.insert(
+      shard->fragment_recvr_set.erase(recvr_id);
+      shard->receiver_map.erase(range.first);
+      // Evict before adding, so that a shard's cache never outgrows the streams that
+      // were closed in the last STREAM_EXPIRATION_TIME_MS.
+      EvictClosedStreams(shard);
+      shard->closed_stream_expirations.insert(
           make_pair(MonotonicMillis() + STREAM_EXPIRATION_TIME_MS, recvr_id));
-      closed_stream_cache_.insert(recvr_id);
+      shard->closed_stream_cache.insert(recvr_id);
       return Status::OK();
     }
     ++range.first;
@@ -253,11 +326,12 @@ Status DataStreamMgr::DeregisterRecvr(
 
 void DataStreamMgr::Cancel(const TUniqueId& fragment_instance_id) {
   VLOG_QUERY << "cancelling all streams for fragment=" << fragment_instance_id;
-  lock_guard<mutex> l(lock_);
+  Shard* shard = GetShard(fragment_instance_id);
+  lock_guard<mutex> l(shard->lock);
   FragmentRecvrSet::iterator i =
-      fragment_recvr_set_.lower_bound(make_pair(fragment_instance_id, 0));
-  while (i != fragment_recvr_set_.end() && i->first == fragment_instance_id) {
-    shared_ptr<DataStreamRecvr> recvr = FindRecvr(i->first, i->second, false);
+      shard->fragment_recvr_set.lower_bound(make_pair(fragment_instance_id, 0));
+  while (i != shard->fragment_recvr_set.end() && i->first == fragment_instance_id) {
+    shared_ptr<DataStreamRecvr> recvr = FindRecvr(shard, i->first, i->second);
     if (recvr.get() == NULL) {
       // keep going but at least log it
       stringstream err;
@@ -59,6 +59,11 @@ class TRowBatch;
 ///  'total-senders-timedout-waiting-for-recvr-creation' - total number of senders that
 ///  timed-out while waiting for a receiver.
 ///
+/// A broadcast sender may transmit a batch once for a run of consecutive fragment
+/// instance ids that all live in this impalad (see HostBroadcastSenderId()). AddData()
+/// and CloseSender() then hand the batch, resp. the end of stream, to the receivers of
+/// all instances in the run, which deserialize it from the same received TRowBatch.
+///
 /// TODO: The recv buffers used in DataStreamRecvr should count against
 /// per-query memory limits.
 class DataStreamMgr {
@@ -85,9 +90,18 @@ class DataStreamMgr {
   /// row_batch.
   /// TODO: enforce per-sender quotas (something like 200% of buffer_size/#senders),
   /// so that a single sender can't flood the buffer and stall everybody else.
-  /// Returns OK if successful, error status otherwise.
+  /// Returns OK if successful, error status otherwise. If 'recvr_closed' is not NULL,
+  /// it is set to true if the recvr was already closed and dropped the batch, in which
+  /// case the sender does not need to send it any more batches.
   Status AddData(const TUniqueId& fragment_instance_id, PlanNodeId dest_node_id,
-                 const TRowBatch& thrift_batch, int sender_id);
+                 const TRowBatch& thrift_batch, int sender_id,
+                 bool* recvr_closed = NULL);
+
+  /// Same as above for a sender in this process. The rows and resources of 'batch' are
+  /// moved to the recvr without serialization, unless it was closed or cancelled. The
+  /// caller must Reset() 'batch' afterwards.
+  Status AddData(const TUniqueId& fragment_instance_id, PlanNodeId dest_node_id,
+                 RowBatch* batch, int sender_id, bool* recvr_closed = NULL);
 
   /// Notifies the recvr associated with the fragment/node id that the specified
   /// sender has closed.
@@ -95,6 +109,32 @@ class DataStreamMgr {
   Status CloseSender(const TUniqueId& fragment_instance_id, PlanNodeId dest_node_id,
       int sender_id);
 
+  /// Marks the reply of a TransmitData() rpc for a recvr that was already closed, e.g.
+  /// because its exchange node reached its limit. The reply has an OK status that
+  /// carries this as its only error message, which senders that don't look for it
+  /// ignore.
+  static const char* RECVR_CLOSED_MSG;
+
+  /// Adds RECVR_CLOSED_MSG to the OK 'status' of a TransmitData() reply.
+  static void SetRecvrClosed(TStatus* status);
+
+  /// Returns true if 'status' is the OK status of a TransmitData() reply that has
+  /// RECVR_CLOSED_MSG.
+  static bool IsRecvrClosed(const TStatus& status);
+
+  /// Maximum number of fragment instances that one host broadcast can be sent to.
+  static const int MAX_HOST_BROADCAST_INSTANCES = 1024;
+
+  /// Returns the sender id that 'sender_id' transmits with to deliver its batches to
+  /// 'num_instances' fragment instances, starting with the destination instance id and
+  /// counting up its 'lo' part. The result is negative, which no regular sender id is.
+  static int HostBroadcastSenderId(int sender_id, int num_instances) {
+    DCHECK_GE(sender_id, 0);
+    DCHECK_GT(num_instances, 1);
+    DCHECK_LE(num_instances, MAX_HOST_BROADCAST_INSTANCES);
+    return -1 - (sender_id * MAX_HOST_BROADCAST_INSTANCES + num_instances - 1);
+  }
+
   /// Closes all receivers registered for fragment_instance_id immediately.
   void Cancel(const TUniqueId& fragment_instance_id);
 
@@ -113,9 +153,6 @@ class DataStreamMgr {
   /// Total number of senders that timed-out waiting for a receiver to register
   IntCounter* num_senders_timedout_;
 
-  /// protects all fields below
-  boost::mutex lock_;
-
   /// map from hash value of fragment instance id/node id pair to stream receivers;
   /// Ownership of the stream revcr is shared between this instance and the caller of
   /// CreateRecvr().
@@ -123,7 +160,6 @@ class DataStreamMgr {
   /// because that requires a bunch of copying of ids for lookup
   typedef boost::unordered_multimap<uint32_t,
       boost::shared_ptr<DataStreamRecvr> > RecvrMap;
-  RecvrMap receiver_map_;
 
   /// (Fragment instance id, Plan node id) pair that uniquely identifies a stream.
   typedef std::pair<impala::TUniqueId, PlanNodeId> RecvrId;
@@ -147,39 +183,7 @@ class DataStreamMgr {
   /// Ordered set of receiver IDs so that we can easily find all receivers for a given
   /// fragment (by starting at (fragment instance id, 0) and iterating until the fragment
   /// instance id changes), which is required for cancellation of an entire fragment.
-  ///
-  /// There is one entry in fragment_recvr_set_ for every entry in receiver_map_.
   typedef std::set<RecvrId, ComparisonOp> FragmentRecvrSet;
-  FragmentRecvrSet fragment_recvr_set_;
-
-  /// Return the receiver for given fragment_instance_id/node_id, or NULL if not found. If
-  /// 'acquire_lock' is false, assumes lock_ is already being held and won't try to
-  /// acquire it.
-  boost::shared_ptr<DataStreamRecvr> FindRecvr(const TUniqueId& fragment_instance_id,
-      PlanNodeId node_id, bool acquire_lock = true);
-
-  /// Calls FindRecvr(), but if NULL is returned, wait for up to
-  /// FLAGS_datastream_sender_timeout_ms for the receiver to be registered.  Senders may
-  /// initialise and start sending row batches before a receiver is ready. To accommodate
-  /// this, we allow senders to establish a rendezvous between them and the receiver. When
-  /// the receiver arrives, it triggers the rendezvous, and all waiting senders can
-  /// proceed. A sender that waits for too long (120s by default) will eventually time out
-  /// and abort. The output parameter 'already_unregistered' distinguishes between the two
-  /// cases in which this method returns NULL:
-  ///
-  /// 1. *already_unregistered == true: the receiver had previously arrived and was
-  /// already closed
-  ///
-  /// 2. *already_unregistered == false: the receiver has yet to arrive when this method
-  /// returns, and the timeout has expired
-  boost::shared_ptr<DataStreamRecvr> FindRecvrOrWait(
-      const TUniqueId& fragment_instance_id, PlanNodeId node_id,
-      bool* already_unregistered);
-
-  /// Remove receiver block for fragment_instance_id/node_id from the map.
-  Status DeregisterRecvr(const TUniqueId& fragment_instance_id, PlanNodeId node_id);
-
-  inline uint32_t GetHashValue(const TUniqueId& fragment_instance_id, PlanNodeId node_id);
 
   /// The coordination primitive used to signal the arrival of a waited-for receiver
   typedef Promise<boost::shared_ptr<DataStreamRecvr> > RendezvousPromise;
@@ -190,7 +194,7 @@ class DataStreamMgr {
   /// waiting (either because of a timeout, or because the receiver arrived), and the
   /// rendezvous can be torn down.
   ///
-  /// Access is only thread-safe when lock_ is held.
+  /// Access is only thread-safe when the lock of its shard is held.
   struct RefCountedPromise {
     uint32_t ref_count;
 
@@ -212,24 +216,87 @@ class DataStreamMgr {
   /// the number of senders waiting as well as a shared promise whose value is Set() with
   /// a pointer to the receiver when the receiver arrives. The count is used to detect
   /// when no receivers are waiting, to initiate clean-up after the fact.
-  ///
-  /// If pending_rendezvous_[X] exists, then receiver_map_[hash(X)] and
-  /// fragment_recvr_set_[X] may exist (and vice versa), as entries are removed from
-  /// pending_rendezvous_ some time after the rendezvous is triggered by the arrival of a
-  /// matching receiver.
   typedef boost::unordered_map<RecvrId, RefCountedPromise> RendezvousMap;
-  RendezvousMap pending_rendezvous_;
 
   /// Map from the time, in ms, that a stream should be evicted from closed_stream_cache
   /// to its RecvrId. Used to evict old streams from cache efficiently. multimap in case
   /// there are multiple streams with the same eviction time.
   typedef std::multimap<int64_t, RecvrId> ClosedStreamMap;
-  ClosedStreamMap closed_stream_expirations_;
 
-  /// Cache of recently closed RecvrIds. Used to allow straggling senders to fail fast by
-  /// checking this cache, rather than waiting for the missed-receiver timeout to elapse
-  /// in FindRecvrOrWait().
-  boost::unordered_set<RecvrId> closed_stream_cache_;
+  /// The receivers of the fragment instances whose ids hash to one shard, together with
+  /// their rendezvous and closed streams. Streams are spread over NUM_SHARDS shards with
+  /// their own locks, so that fragment instances that start and end concurrently don't
+  /// all contend for a single lock. All receivers of a fragment instance are in the same
+  /// shard, so that Cancel() only needs one of them.
+  struct Shard {
+    /// protects all fields below
+    boost::mutex lock;
+
+    RecvrMap receiver_map;
+
+    /// There is one entry in fragment_recvr_set for every entry in receiver_map.
+    FragmentRecvrSet fragment_recvr_set;
+
+    /// If pending_rendezvous[X] exists, then receiver_map[hash(X)] and
+    /// fragment_recvr_set[X] may exist (and vice versa), as entries are removed from
+    /// pending_rendezvous some time after the rendezvous is triggered by the arrival of
+    /// a matching receiver.
+    RendezvousMap pending_rendezvous;
+
+    ClosedStreamMap closed_stream_expirations;
+
+    /// Cache of recently closed RecvrIds. Used to allow straggling senders to fail fast
+    /// by checking this cache, rather than waiting for the missed-receiver timeout to
+    /// elapse in FindRecvrOrWait().
+    boost::unordered_set<RecvrId> closed_stream_cache;
+  };
+
+  static const int NUM_SHARDS = 64;
+  Shard shards_[NUM_SHARDS];
+
+  /// Returns the shard of the streams of 'fragment_instance_id'.
+  Shard* GetShard(const TUniqueId& fragment_instance_id);
+
+  /// Return the receiver for given fragment_instance_id/node_id, or NULL if not found.
+  /// The lock of 'shard', the shard of 'fragment_instance_id', must be held.
+  boost::shared_ptr<DataStreamRecvr> FindRecvr(Shard* shard,
+      const TUniqueId& fragment_instance_id, PlanNodeId node_id);
+
+  /// Calls FindRecvr(), but if NULL is returned, wait for up to
+  /// FLAGS_datastream_sender_timeout_ms for the receiver to be registered.  Senders may
+  /// initialise and start sending row batches before a receiver is ready. To accommodate
+  /// this, we allow senders to establish a rendezvous between them and the receiver. When
+  /// the receiver arrives, it triggers the rendezvous, and all waiting senders can
+  /// proceed. A sender that waits for too long (120s by default) will eventually time out
+  /// and abort. The output parameter 'already_unregistered' distinguishes between the two
+  /// cases in which this method returns NULL:
+  ///
+  /// 1. *already_unregistered == true: the receiver had previously arrived and was
+  /// already closed
+  ///
+  /// 2. *already_unregistered == false: the receiver has yet to arrive when this method
+  /// returns, and the timeout has expired
+  boost::shared_ptr<DataStreamRecvr> FindRecvrOrWait(
+      const TUniqueId& fragment_instance_id, PlanNodeId node_id,
+      bool* already_unregistered);
+
+  /// Decodes the sender id of a TransmitData() rpc into the id of the sender and the
+  /// number of consecutive fragment instances that it is meant for.
+  static void DecodeSenderId(int wire_sender_id, int* sender_id, int* num_instances);
+
+  /// Calls FindRecvrOrWait() for AddData(). Sets 'recvr' to NULL and returns OK if the
+  /// recvr was already closed, and returns an error if waiting for it timed out.
+  Status FindRecvrForData(const TUniqueId& fragment_instance_id, PlanNodeId node_id,
+      boost::shared_ptr<DataStreamRecvr>* recvr);
+
+  /// Remove receiver block for fragment_instance_id/node_id from the map.
+  Status DeregisterRecvr(const TUniqueId& fragment_instance_id, PlanNodeId node_id);
+
+  /// Removes the streams that have been in the closed stream cache of 'shard' for more
+  /// than STREAM_EXPIRATION_TIME_MS. The lock of 'shard' must be held.
+  void EvictClosedStreams(Shard* shard);
+
+  inline uint32_t GetHashValue(const TUniqueId& fragment_instance_id, PlanNodeId node_id);
 };
 
 }
@@ -19,6 +19,7 @@
 #include "runtime/data-stream-mgr.h"
 #include "runtime/mem-tracker.h"
 #include "runtime/row-batch.h"
+#include "runtime/row-batch-pool.h"
 #include "runtime/sorted-run-merger.h"
 #include "util/runtime-profile-counters.h"
 #include "util/periodic-counter-updater.h"
@@ -50,6 +51,9 @@ class DataStreamRecvr::SenderQueue {
   // the queue is considered full and the call blocks until a batch is dequeued.
   void AddBatch(const TRowBatch& batch);
 
+  // Same as above, but takes over the rows and resources of 'batch'.
+  void AddBatch(RowBatch* batch);
+
   // Decrement the number of remaining senders for this queue and signal eos ("new data")
   // if the count drops to 0. The number of senders will be 1 for a merging
   // DataStreamRecvr.
@@ -97,6 +101,13 @@ class DataStreamRecvr::SenderQueue {
 
   // Set to true when the first batch has been received
   bool received_first_batch_;
+
+  // Blocks while a batch of 'batch_size' bytes would exceed the buffer limit of the
+  // receiver, unless the queue is empty or the stream is cancelled. 'l' holds lock_.
+  void WaitForBufferSpace(int batch_size, unique_lock<mutex>* l);
+
+  // Appends 'batch' to batch_queue_ and signals its arrival. Called with lock_ held.
+  void EnqueueBatch(int batch_size, RowBatch* batch);
 };
 
 DataStreamRecvr::SenderQueue::SenderQueue(DataStreamRecvr* parent_recvr, int num_senders,
@@ -122,7 +133,9 @@ Status DataStreamRecvr::SenderQueue::GetBatch(RowBatch** next_batch) {
   }
 
   // cur_batch_ must be replaced with the returned batch.
-  current_batch_.reset();
+  if (current_batch_.get() != NULL) {
+    recvr_->row_batch_pool_->ReturnBatch(current_batch_.release());
+  }
   *next_batch = NULL;
   if (is_cancelled_) return Status::CANCELLED;
 
@@ -151,7 +164,41 @@ void DataStreamRecvr::SenderQueue::AddBatch(const TRowBatch& thrift_batch) {
   int batch_size = RowBatch::GetBatchSize(thrift_batch);
   COUNTER_ADD(recvr_->bytes_received_counter_, batch_size);
   DCHECK_GT(num_remaining_senders_, 0);
+  WaitForBufferSpace(batch_size, &l);
+
+  if (!is_cancelled_) {
+    RowBatch* batch = NULL;
+    {
+      SCOPED_TIMER(recvr_->deserialize_row_batch_timer_);
+      // Note: if this function makes a row batch, the batch *must* be added
+      // to batch_queue_. It is not valid to create the row batch and destroy
+      // it in this thread.
+      batch = new RowBatch(recvr_->row_desc(), thrift_batch, recvr_->mem_tracker());
+    }
+    EnqueueBatch(batch_size, batch);
+  }
+}
+
+void DataStreamRecvr::SenderQueue::AddBatch(RowBatch* local_batch) {
+  unique_lock<mutex> l(lock_);
+  if (is_cancelled_) return;
+
+  // The batch holds its rows in its tuple data pool. There is no serialized size.
+  int batch_size = local_batch->tuple_data_pool()->total_allocated_bytes();
+  COUNTER_ADD(recvr_->bytes_received_counter_, batch_size);
+  DCHECK_GT(num_remaining_senders_, 0);
+  WaitForBufferSpace(batch_size, &l);
+
+  if (!is_cancelled_) {
+    // See the note above about creating row batches in this thread.
+    RowBatch* batch = recvr_->row_batch_pool_->GetBatch(local_batch->capacity());
+    batch->AcquireState(local_batch);
+    EnqueueBatch(batch_size, batch);
+  }
+}
 
+void DataStreamRecvr::SenderQueue::WaitForBufferSpace(int batch_size,
+    unique_lock<mutex>* l) {
   // if there's something in the queue and this batch will push us over the
   // buffer limit we need to wait until the batch gets drained.
   // Note: It's important that we enqueue thrift_batch regardless of buffer limit if
@@ -173,10 +220,10 @@ void DataStreamRecvr::SenderQueue::AddBatch(const TRowBatch& thrift_batch) {
       try_mutex::scoped_try_lock timer_lock(recvr_->buffer_wall_timer_lock_);
       if (timer_lock) {
         CANCEL_SAFE_SCOPED_TIMER(recvr_->buffer_full_wall_timer_, &is_cancelled_);
-        data_removal__cv_.wait(l);
+        data_removal__cv_.wait(*l);
         got_timer_lock = true;
       } else {
-        data_removal__cv_.wait(l);
+        data_removal__cv_.wait(*l);
         got_timer_lock = false;
       }
     }
@@ -197,22 +244,14 @@ void DataStreamRecvr::SenderQueue::AddBatch(const TRowBatch& thrift_batch) {
     // practice, this time is small relative to the total wait time.
     if (got_timer_lock) data_removal__cv_.notify_one();
   }
+}
 
-  if (!is_cancelled_) {
-    RowBatch* batch = NULL;
-    {
-      SCOPED_TIMER(recvr_->deserialize_row_batch_timer_);
-      // Note: if this function makes a row batch, the batch *must* be added
-      // to batch_queue_. It is not valid to create the row batch and destroy
-      // it in this thread.
-      batch = new RowBatch(recvr_->row_desc(), thrift_batch, recvr_->mem_tracker());
-    }
-    VLOG_ROW << "added #rows=" << batch->num_rows()
-             << " batch_size=" << batch_size << "\n";
-    batch_queue_.push_back(make_pair(batch_size, batch));
-    recvr_->num_buffered_bytes_.Add(batch_size);
-    data_arrival_cv_.notify_one();
-  }
+void DataStreamRecvr::SenderQueue::EnqueueBatch(int batch_size, RowBatch* batch) {
+  VLOG_ROW << "added #rows=" << batch->num_rows()
+           << " batch_size=" << batch_size << "\n";
+  batch_queue_.push_back(make_pair(batch_size, batch));
+  recvr_->num_buffered_bytes_.Add(batch_size);
+  data_arrival_cv_.notify_one();
 }
 
 void DataStreamRecvr::SenderQueue::DecrementSenders() {
@@ -285,6 +324,7 @@ DataStreamRecvr::DataStreamRecvr(DataStreamMgr* stream_mgr, MemTracker* parent_t
     PlanNodeId dest_node_id, int num_senders, bool is_merging, int total_buffer_limit,
     RuntimeProfile* profile)
   : mgr_(stream_mgr),
+    deregistered_(false),
     fragment_instance_id_(fragment_instance_id),
     dest_node_id_(dest_node_id),
     total_buffer_limit_(total_buffer_limit),
@@ -293,6 +333,8 @@ DataStreamRecvr::DataStreamRecvr(DataStreamMgr* stream_mgr, MemTracker* parent_t
     num_buffered_bytes_(0),
     profile_(profile) {
   mem_tracker_.reset(new MemTracker(-1, -1, "DataStreamRecvr", parent_tracker));
+  row_batch_pool_.reset(
+      new RowBatchPool(row_desc_, mem_tracker_.get(), MAX_RECYCLED_ROW_BATCHES));
   // Create one queue per sender if is_merging is true.
   int num_queues = is_merging ? num_senders : 1;
   sender_queues_.reserve(num_queues);
@@ -304,12 +346,13 @@ DataStreamRecvr::DataStreamRecvr(DataStreamMgr* stream_mgr, MemTracker* parent_t
   }
 
   // Initialize the counters
+  // The counters below are updated by the RPC threads of all senders.
   bytes_received_counter_ =
-      ADD_COUNTER(profile_, "BytesReceived", TUnit::BYTES);
+      ADD_SHARDED_COUNTER(profile_, "BytesReceived", TUnit::BYTES);
   bytes_received_time_series_counter_ =
       ADD_TIME_SERIES_COUNTER(profile_, "BytesReceived", bytes_received_counter_);
   deserialize_row_batch_timer_ =
-      ADD_TIMER(profile_, "DeserializeRowBatchTimer");
+      ADD_SHARDED_TIMER(profile_, "DeserializeRowBatchTimer");
   buffer_full_wall_timer_ = ADD_TIMER(profile_, "SendersBlockedTimer");
   buffer_full_total_timer_ = ADD_TIMER(profile_, "SendersBlockedTotalTimer(*)");
   data_arrival_timer_ = profile_->inactive_timer();
@@ -327,6 +370,11 @@ void DataStreamRecvr::AddBatch(const TRowBatch& thrift_batch, int sender_id) {
   sender_queues_[use_sender_id]->AddBatch(thrift_batch);
 }
 
+void DataStreamRecvr::AddBatch(RowBatch* batch, int sender_id) {
+  int use_sender_id = is_merging_ ? sender_id : 0;
+  sender_queues_[use_sender_id]->AddBatch(batch);
+}
+
 void DataStreamRecvr::RemoveSender(int sender_id) {
   int use_sender_id = is_merging_ ? sender_id : 0;
   sender_queues_[use_sender_id]->DecrementSenders();
@@ -338,15 +386,22 @@ void DataStreamRecvr::CancelStream() {
   }
 }
 
-void DataStreamRecvr::Close() {
-  // Remove this receiver from the DataStreamMgr that created it.
+void DataStreamRecvr::Deregister() {
+  if (deregistered_) return;
   // TODO: log error msg
   mgr_->DeregisterRecvr(fragment_instance_id(), dest_node_id());
+  deregistered_ = true;
+}
+
+void DataStreamRecvr::Close() {
+  // Remove this receiver from the DataStreamMgr that created it.
+  Deregister();
   mgr_ = NULL;
   for (int i = 0; i < sender_queues_.size(); ++i) {
     sender_queues_[i]->Close();
   }
   merger_.reset();
+  row_batch_pool_.reset();
   mem_tracker_->UnregisterFromParent();
   mem_tracker_.reset();
 }
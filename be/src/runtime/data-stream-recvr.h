@@ -31,6 +31,7 @@ class DataStreamMgr;
 class SortedRunMerger;
 class MemTracker;
 class RowBatch;
+class RowBatchPool;
 class RuntimeProfile;
 
 /// Single receiver of an m:n data stream.
@@ -72,6 +73,12 @@ class DataStreamRecvr {
   /// Deregister from DataStreamMgr instance, which shares ownership of this instance.
   void Close();
 
+  /// Stops receiving before Close(), e.g. because the exchange node reached its limit.
+  /// Deregisters from the DataStreamMgr, which drops the batches that senders transmit
+  /// from now on and tells the senders that the stream is closed. The batches returned
+  /// so far stay valid until Close(). Must not be followed by GetBatch() or GetNext().
+  void Deregister();
+
   /// Create a SortedRunMerger instance to merge rows from multiple sender according to the
   /// specified row comparator. Fetches the first batches from the individual sender
   /// queues. The exprs used in less_than must have already been prepared and opened.
@@ -103,6 +110,11 @@ class DataStreamRecvr {
   /// full. Called from DataStreamMgr.
   void AddBatch(const TRowBatch& thrift_batch, int sender_id);
 
+  /// Same as above for a batch from a sender in this process. The rows and resources of
+  /// 'batch' are moved into the sender queue without deserialization, unless the stream
+  /// is cancelled.
+  void AddBatch(RowBatch* batch, int sender_id);
+
   /// Indicate that a particular sender is done. Delegated to the appropriate
   /// sender queue. Called from DataStreamMgr.
   void RemoveSender(int sender_id);
@@ -119,6 +131,9 @@ class DataStreamRecvr {
   /// DataStreamMgr instance used to create this recvr. (Not owned)
   DataStreamMgr* mgr_;
 
+  /// True once Deregister() was called.
+  bool deregistered_;
+
   /// Fragment and node id of the destination exchange node this receiver is used by.
   TUniqueId fragment_instance_id_;
   PlanNodeId dest_node_id_;
@@ -141,6 +156,13 @@ class DataStreamRecvr {
   /// Memtracker for batches in the sender queue(s).
   boost::scoped_ptr<MemTracker> mem_tracker_;
 
+  /// Empty batches that the batches of local senders are moved into. The consumer
+  /// returns its previous batch here when it fetches the next one.
+  boost::scoped_ptr<RowBatchPool> row_batch_pool_;
+
+  /// Maximum number of empty batches in row_batch_pool_.
+  static const int MAX_RECYCLED_ROW_BATCHES = 4;
+
   /// One or more queues of row batches received from senders. If is_merging_ is true,
   /// there is one SenderQueue for each sender. Otherwise, row batches from all senders
   /// are placed in the same SenderQueue. The SenderQueue instances are owned by the
@@ -15,7 +15,9 @@
 #include "runtime/data-stream-sender.h"
 
 #include <iostream>
+#include <boost/algorithm/string.hpp>
 #include <boost/shared_ptr.hpp>
+#include <gutil/strings/substitute.h>
 #include <thrift/protocol/TDebugProtocol.h>
 
 #include "common/logging.h"
@@ -27,9 +29,11 @@
 #include "runtime/raw-value.inline.h"
 #include "runtime/runtime-state.h"
 #include "runtime/client-cache.h"
+#include "runtime/data-stream-mgr.h"
 #include "runtime/mem-tracker.h"
 #include "runtime/backend-client.h"
 #include "util/debug-util.h"
+#include "util/heavy-hitter-sketch.h"
 #include "util/network-util.h"
 #include "util/thread-pool.h"
 #include "rpc/thrift-client.h"
@@ -45,16 +49,53 @@ using boost::condition_variable;
 using namespace apache::thrift;
 using namespace apache::thrift::protocol;
 using namespace apache::thrift::transport;
+using namespace strings;
+
+DEFINE_string(row_batch_compression_codec, "lz4", "(Advanced) The codec used to "
+    "compress the tuple data of row batches sent between fragments: lz4, snappy or "
+    "none.");
+DEFINE_bool(row_batch_adaptive_compression, false, "(Advanced) If true, a data stream "
+    "sender stops compressing its row batches for a while after a batch did not compress "
+    "well.");
+DEFINE_int32(exchange_send_window, 2, "(Advanced) The number of serialized row batches "
+    "that each data stream channel buffers while they are sent to the receiver. Larger "
+    "values overlap more serialization with TransmitData() RPCs but use more memory.");
+DEFINE_bool(enable_local_exchange, true, "(Advanced) If true, data stream senders hand "
+    "row batches for receivers in the same impalad directly to the receiver instead of "
+    "serializing them and sending them over a TransmitData() RPC.");
+DEFINE_bool(broadcast_once_per_host, false, "(Advanced) If true, broadcast data stream "
+    "senders transmit each batch once to every host that runs several consecutive "
+    "instances of the destination fragment, and the receiving impalad hands it to all of "
+    "them. Must be set to the same value on all impalads.");
+DEFINE_int32(exchange_heavy_hitter_sample_interval, 16, "(Advanced) Hash-partitioned "
+    "data stream senders feed the hash of every n-th row to a heavy-hitter summary and "
+    "report the keys that overload a single receiver in the profile. 0 disables it.");
 
 namespace impala {
 
+const uint64_t DataStreamSender::EXCHANGE_HASH_SEED;
+
+// Maximum ratio of compressed to uncompressed tuple data that is still worth the
+// compression time with --row_batch_adaptive_compression.
+static const double ADAPTIVE_COMPRESSION_MAX_RATIO = 0.8;
+
+// Number of batches sent uncompressed after a batch that compressed poorly, before
+// trying to compress again.
+static const int ADAPTIVE_COMPRESSION_SKIP_BATCHES = 16;
+
 // A channel sends data asynchronously via calls to TransmitData
 // to a single destination ipaddress/node.
 // It has a fixed-capacity buffer and allows the caller either to add rows to
 // that buffer individually (AddRow()), or circumvent the buffer altogether and send
-// TRowBatches directly (SendBatch()). Either way, there can only be one in-flight RPC
-// at any one time (ie, sending will block if the most recent rpc hasn't finished,
-// which allows the receiver node to throttle the sender by withholding acks).
+// TRowBatches directly (SendBatch()). The rpcs of a channel are sent one at a time in
+// order by its rpc thread. Batches that the channel serializes itself into one of its
+// --exchange_send_window buffers are queued behind the in-flight rpc, so the sender
+// only blocks once all buffers are in flight. Batches shared with other channels are
+// only sent once the previous rpcs have finished. Either way the receiver node can
+// throttle the sender by withholding acks.
+// If the destination is this impalad (see is_local()), batches are not serialized: their
+// rows and resources are moved into the receiver's queue by the DataStreamMgr, on the
+// calling thread, which blocks while the receiver's buffer is full.
 // *Not* thread-safe.
 class DataStreamSender::Channel {
  public:
@@ -73,9 +114,16 @@ class DataStreamSender::Channel {
       fragment_instance_id_(fragment_instance_id),
       dest_node_id_(dest_node_id),
       num_data_bytes_sent_(0),
-      rpc_thread_("DataStreamSender", "SenderThread", 1, 1,
+      thrift_batches_(max(FLAGS_exchange_send_window, 1)),
+      rpc_thread_("DataStreamSender", "SenderThread", 1, thrift_batches_.size(),
           bind<void>(mem_fn(&Channel::TransmitData), this, _1, _2)),
-      rpc_in_flight_(false) {
+      num_rpcs_in_flight_(0),
+      is_local_(false),
+      num_host_instances_(1),
+      recvr_closed_(false) {
+    for (TRowBatch& thrift_batch: thrift_batches_) {
+      free_thrift_batches_.push_back(&thrift_batch);
+    }
   }
 
   // Initialize channel.
@@ -87,16 +135,22 @@ class DataStreamSender::Channel {
   // Returns error status if any of the preceding rpcs failed, OK otherwise.
   Status AddRow(TupleRow* row);
 
-  // Asynchronously sends a row batch.
-  // Returns the status of the most recently finished TransmitData
-  // rpc (or OK if there wasn't one that hasn't been reported yet).
+  // Asynchronously sends a row batch. 'batch' is either shared with other channels, in
+  // which case this waits for all in-flight rpcs to finish, or is one of the channel's
+  // buffers, in which case it is queued behind them.
+  // Returns the status of the first failed TransmitData rpc (or OK if there wasn't one).
   Status SendBatch(TRowBatch* batch);
 
+  // Serializes 'batch' into one of the channel's buffers and sends it via SendBatch().
+  // Blocks until a buffer is not in flight. For a local destination, 'batch' is deep
+  // copied instead.
+  Status SerializeAndSendBatch(RowBatch* batch);
+
   // Return status of last TransmitData rpc (initiated by the most recent call
   // to either SendBatch() or SendCurrentBatch()).
   Status GetSendStatus();
 
-  // Waits for the rpc thread pool to finish the current rpc.
+  // Waits for the rpc thread pool to finish all in-flight rpcs.
   void WaitForRpc();
 
   // Drain and shutdown the rpc thread and free the row batch allocation.
@@ -106,7 +160,20 @@ class DataStreamSender::Channel {
   Status FlushAndSendEos(RuntimeState* state);
 
   int64_t num_data_bytes_sent() const { return num_data_bytes_sent_; }
-  TRowBatch* thrift_batch() { return &thrift_batch_; }
+  bool is_local() const { return is_local_; }
+
+  // With --broadcast_once_per_host, the first channel of a run of consecutive instances
+  // on a host sends for all 'n' of them, and the other channels of the run get 0 and
+  // send nothing. Must be called before Init().
+  void set_num_host_instances(int n) { num_host_instances_ = n; }
+  bool sends_batches() const { return num_host_instances_ > 0; }
+
+  // Returns true once the receiver replied that it was closed, e.g. because its exchange
+  // reached its limit. Rows for a closed receiver are dropped instead of being sent.
+  bool recvr_closed() {
+    lock_guard<mutex> l(rpc_thread_lock_);
+    return recvr_closed_;
+  }
 
  private:
   DataStreamSender* parent_;
@@ -124,30 +191,68 @@ class DataStreamSender::Channel {
 
   // we're accumulating rows into this batch
   scoped_ptr<RowBatch> batch_;
-  TRowBatch thrift_batch_;
+
+  // Buffers that batch_ and round-robin batches are serialized into. The buffers that
+  // are not in flight are in free_thrift_batches_.
+  vector<TRowBatch> thrift_batches_;
+  vector<TRowBatch*> free_thrift_batches_;
 
   // We want to reuse the rpc thread to prevent creating a thread per rowbatch.
-  // TODO: currently we only have one batch in flight, but we should buffer more
-  // batches. This is a bit tricky since the channels share the outgoing batch
-  // pointer we need some mechanism to coordinate when the batch is all done.
   // TODO: if the order of row batches does not matter, we can consider increasing
   // the number of threads.
   ThreadPool<TRowBatch*> rpc_thread_; // sender thread.
-  condition_variable rpc_done_cv_;   // signaled when rpc_in_flight_ is set to true.
-  mutex rpc_thread_lock_; // Lock with rpc_done_cv_ protecting rpc_in_flight_
-  bool rpc_in_flight_;  // true if the rpc_thread_ is busy sending.
+  condition_variable rpc_done_cv_;   // signaled when an rpc finishes.
+  // Lock with rpc_done_cv_ protecting num_rpcs_in_flight_, free_thrift_batches_ and
+  // rpc_status_.
+  mutex rpc_thread_lock_;
+  int num_rpcs_in_flight_;  // number of batches offered to rpc_thread_ but not sent.
+
+  Status rpc_status_;  // status of first failed TransmitData rpc
+
+  // True if the destination is this impalad and batches are handed directly to its
+  // DataStreamMgr. Set in Init().
+  bool is_local_;
+
+  // Number of destination instances that this channel's rpcs are for, see
+  // set_num_host_instances().
+  int num_host_instances_;
+
+  // Set when a TransmitData() reply or the local DataStreamMgr says that the receiver
+  // was closed. Protected by rpc_thread_lock_.
+  bool recvr_closed_;
+
+  // Sets recvr_closed_.
+  void SetRecvrClosed();
+
+  // Returns the sender id for TransmitData() rpcs, which tells the receiving
+  // DataStreamMgr how many instances the batch is for.
+  int rpc_sender_id() const {
+    if (num_host_instances_ <= 1) return parent_->sender_id_;
+    return DataStreamMgr::HostBroadcastSenderId(parent_->sender_id_,
+        num_host_instances_);
+  }
 
-  Status rpc_status_;  // status of most recently finished TransmitData rpc
+  // Moves the rows and resources of 'batch' to the local receiver and resets it.
+  Status SendLocalBatch(RowBatch* batch);
 
-  // Serialize batch_ into thrift_batch_ and send via SendBatch().
+  // Serialize batch_ via SerializeAndSendBatch() and reset it.
   // Returns SendBatch() status.
   Status SendCurrentBatch();
 
+  // Returns a buffer that is not in flight. Blocks until there is one.
+  TRowBatch* GetFreeThriftBatch();
+
   // Synchronously call TransmitData() on a client from client_cache_ and update
-  // rpc_status_ based on return value (or set to error if RPC failed).
+  // rpc_status_ if it fails. Batches queued after a failed rpc are not sent.
   // Called from a thread from the rpc_thread_ pool.
-  void TransmitData(int thread_id, const TRowBatch*);
-  void TransmitDataHelper(const TRowBatch*);
+  void TransmitData(int thread_id, TRowBatch*);
+  Status TransmitDataHelper(TRowBatch*);
+
+  // Sends 'params' to the destination with a TransmitData rpc.
+  Status DoTransmitDataRpc(const TTransmitDataParams& params);
+
+  // Returns true if 'batch' is one of thrift_batches_.
+  bool IsOwnedThriftBatch(const TRowBatch* batch) const;
 };
 
 Status DataStreamSender::Channel::Init(RuntimeState* state) {
@@ -155,37 +260,99 @@ Status DataStreamSender::Channel::Init(RuntimeState* state) {
   // TODO: figure out how to size batch_
   int capacity = max(1, buffer_size_ / max(row_desc_.GetRowSize(), 1));
   batch_.reset(new RowBatch(row_desc_, capacity, parent_->mem_tracker_.get()));
+  is_local_ = FLAGS_enable_local_exchange &&
+      address_ == state->exec_env()->backend_address();
+  // Local receivers get their batches without an rpc, so they are not grouped. All
+  // channels of a run have the same address and make the same decision.
+  if (is_local_) num_host_instances_ = 1;
   return Status::OK();
 }
 
+Status DataStreamSender::Channel::SendLocalBatch(RowBatch* batch) {
+  DCHECK(is_local_);
+  VLOG_ROW << "Channel::SendLocalBatch() instance_id=" << fragment_instance_id_
+           << " dest_node=" << dest_node_id_ << " #rows=" << batch->num_rows();
+  Status status;
+  bool recvr_closed = false;
+  {
+    SCOPED_TIMER(parent_->state_->total_network_send_timer());
+    status = parent_->state_->stream_mgr()->AddData(fragment_instance_id_,
+        dest_node_id_, batch, parent_->sender_id_, &recvr_closed);
+  }
+  if (recvr_closed) SetRecvrClosed();
+  batch->Reset();
+  COUNTER_ADD(parent_->local_batches_sent_counter_, 1);
+  return status;
+}
+
+void DataStreamSender::Channel::SetRecvrClosed() {
+  VLOG_QUERY << "Receiver closed: instance_id=" << fragment_instance_id_
+             << " dest_node=" << dest_node_id_;
+  lock_guard<mutex> l(rpc_thread_lock_);
+  recvr_closed_ = true;
+}
+
+bool DataStreamSender::Channel::IsOwnedThriftBatch(const TRowBatch* batch) const {
+  for (const TRowBatch& thrift_batch: thrift_batches_) {
+    if (&thrift_batch == batch) return true;
+  }
+  return false;
+}
+
+TRowBatch* DataStreamSender::Channel::GetFreeThriftBatch() {
+  SCOPED_TIMER(parent_->state_->total_network_send_timer());
+  unique_lock<mutex> l(rpc_thread_lock_);
+  while (free_thrift_batches_.empty()) rpc_done_cv_.wait(l);
+  TRowBatch* batch = free_thrift_batches_.back();
+  free_thrift_batches_.pop_back();
+  return batch;
+}
+
 Status DataStreamSender::Channel::SendBatch(TRowBatch* batch) {
   VLOG_ROW << "Channel::SendBatch() instance_id=" << fragment_instance_id_
            << " dest_node=" << dest_node_id_ << " #rows=" << batch->num_rows;
-  // return if the previous batch saw an error
-  RETURN_IF_ERROR(GetSendStatus());
+  bool owned = IsOwnedThriftBatch(batch);
   {
+    // A batch shared with other channels is overwritten once all of them have sent it,
+    // which the sender relies on by waiting for the previous rpcs here.
+    SCOPED_TIMER(parent_->state_->total_network_send_timer());
     unique_lock<mutex> l(rpc_thread_lock_);
-    rpc_in_flight_ = true;
+    while (!owned && num_rpcs_in_flight_ > 0) rpc_done_cv_.wait(l);
+    // return if a previous batch saw an error
+    if (!rpc_status_.ok()) {
+      if (owned) free_thrift_batches_.push_back(batch);
+      return rpc_status_;
+    }
+    ++num_rpcs_in_flight_;
   }
+  // Does not block: there is at most one queued batch per buffer.
   if (!rpc_thread_.Offer(batch)) {
     unique_lock<mutex> l(rpc_thread_lock_);
-    rpc_in_flight_ = false;
+    --num_rpcs_in_flight_;
+    if (owned) free_thrift_batches_.push_back(batch);
   }
   return Status::OK();
 }
 
-void DataStreamSender::Channel::TransmitData(int thread_id, const TRowBatch* batch) {
-  DCHECK(rpc_in_flight_);
-  TransmitDataHelper(batch);
+void DataStreamSender::Channel::TransmitData(int thread_id, TRowBatch* batch) {
+  Status status;
+  {
+    unique_lock<mutex> l(rpc_thread_lock_);
+    DCHECK_GT(num_rpcs_in_flight_, 0);
+    status = rpc_status_;
+  }
+  if (status.ok()) status = TransmitDataHelper(batch);
 
   {
     unique_lock<mutex> l(rpc_thread_lock_);
-    rpc_in_flight_ = false;
+    if (rpc_status_.ok()) rpc_status_ = status;
+    --num_rpcs_in_flight_;
+    if (IsOwnedThriftBatch(batch)) free_thrift_batches_.push_back(batch);
   }
-  rpc_done_cv_.notify_one();
+  rpc_done_cv_.notify_all();
 }
 
-void DataStreamSender::Channel::TransmitDataHelper(const TRowBatch* batch) {
+Status DataStreamSender::Channel::TransmitDataHelper(TRowBatch* batch) {
   DCHECK(batch != NULL);
   VLOG_ROW << "Channel::TransmitData() instance_id=" << fragment_instance_id_
            << " dest_node=" << dest_node_id_
@@ -194,43 +361,60 @@ void DataStreamSender::Channel::TransmitDataHelper(const TRowBatch* batch) {
   params.protocol_version = ImpalaInternalServiceVersion::V1;
   params.__set_dest_fragment_instance_id(fragment_instance_id_);
   params.__set_dest_node_id(dest_node_id_);
-  params.__set_row_batch(*batch);  // yet another copy
   params.__set_eos(false);
-  params.__set_sender_id(parent_->sender_id_);
+  params.__set_sender_id(rpc_sender_id());
+
+  // Nothing else accesses the channel's own buffers while they are in flight, so their
+  // serialized data is lent to 'params' instead of being copied, and returned afterwards
+  // to be reused. Batches shared with other channels may be sent by them concurrently
+  // and have to be copied.
+  bool owned = IsOwnedThriftBatch(batch);
+  if (owned) {
+    swap(params.row_batch, *batch);
+    params.__isset.row_batch = true;
+  } else {
+    params.__set_row_batch(*batch);
+  }
+  Status status = DoTransmitDataRpc(params);
+  if (owned) swap(params.row_batch, *batch);
+  if (!status.ok()) return status;
 
-  ImpalaBackendConnection client(client_cache_, address_, &rpc_status_);
-  if (!rpc_status_.ok()) return;
+  num_data_bytes_sent_ += RowBatch::GetBatchSize(*batch);
+  VLOG_ROW << "incremented #data_bytes_sent="
+           << num_data_bytes_sent_;
+  return Status::OK();
+}
+
+Status DataStreamSender::Channel::DoTransmitDataRpc(const TTransmitDataParams& params) {
+  Status status;
+  ImpalaBackendConnection client(client_cache_, address_, &status);
+  if (!status.ok()) return status;
 
   TTransmitDataResult res;
   client->SetTransmitDataCounter(parent_->thrift_transmit_timer_);
-  rpc_status_ =
-      client.DoRpc(&ImpalaBackendClient::TransmitData, params, &res);
+  status = client.DoRpc(&ImpalaBackendClient::TransmitData, params, &res);
   client->ResetTransmitDataCounter();
-  if (!rpc_status_.ok()) return;
+  if (!status.ok()) return status;
   COUNTER_ADD(parent_->profile_->total_time_counter(),
       parent_->thrift_transmit_timer_->LapTime());
 
-  if (res.status.status_code != TErrorCode::OK) {
-    rpc_status_ = res.status;
-  } else {
-    num_data_bytes_sent_ += RowBatch::GetBatchSize(*batch);
-    VLOG_ROW << "incremented #data_bytes_sent="
-             << num_data_bytes_sent_;
-  }
+  if (res.status.status_code != TErrorCode::OK) return Status(res.status);
+  if (DataStreamMgr::IsRecvrClosed(res.status)) SetRecvrClosed();
+  return Status::OK();
 }
 
 void DataStreamSender::Channel::WaitForRpc() {
   SCOPED_TIMER(parent_->state_->total_network_send_timer());
   unique_lock<mutex> l(rpc_thread_lock_);
-  while (rpc_in_flight_) {
+  while (num_rpcs_in_flight_ > 0) {
     rpc_done_cv_.wait(l);
   }
 }
 
 Status DataStreamSender::Channel::AddRow(TupleRow* row) {
   if (batch_->AtCapacity()) {
-    // batch_ is full, let's send it; but first wait for an ongoing
-    // transmission to finish before modifying thrift_batch_
+    // batch_ is full, let's send it; this waits for a buffer that is not in flight
+    // if all of them are
     RETURN_IF_ERROR(SendCurrentBatch());
   }
   TupleRow* dest = batch_->GetRow(batch_->AddRow());
@@ -246,13 +430,33 @@ Status DataStreamSender::Channel::AddRow(TupleRow* row) {
   return Status::OK();
 }
 
+Status DataStreamSender::Channel::SerializeAndSendBatch(RowBatch* batch) {
+  if (recvr_closed()) return Status::OK();
+  if (is_local_) {
+    // The caller keeps 'batch', so the receiver gets a copy of the rows.
+    RowBatch local_batch(row_desc_, batch->num_rows(), parent_->mem_tracker_.get());
+    batch->DeepCopyTo(&local_batch);
+    return SendLocalBatch(&local_batch);
+  }
+  // wait for a buffer that no in-flight TransmitData() call still accesses
+  TRowBatch* thrift_batch = GetFreeThriftBatch();
+  Status status = parent_->SerializeBatch(batch, thrift_batch);
+  if (!status.ok()) {
+    unique_lock<mutex> l(rpc_thread_lock_);
+    free_thrift_batches_.push_back(thrift_batch);
+    return status;
+  }
+  return SendBatch(thrift_batch);
+}
+
 Status DataStreamSender::Channel::SendCurrentBatch() {
-  // make sure there's no in-flight TransmitData() call that might still want to
-  // access thrift_batch_
-  WaitForRpc();
-  RETURN_IF_ERROR(parent_->SerializeBatch(batch_.get(), &thrift_batch_));
+  if (recvr_closed()) {
+    batch_->Reset();
+    return Status::OK();
+  }
+  if (is_local_) return SendLocalBatch(batch_.get());
+  RETURN_IF_ERROR(SerializeAndSendBatch(batch_.get()));
   batch_->Reset();
-  RETURN_IF_ERROR(SendBatch(&thrift_batch_));
   return Status::OK();
 }
 
@@ -268,6 +472,8 @@ Status DataStreamSender::Channel::FlushAndSendEos(RuntimeState* state) {
   VLOG_RPC << "Channel::FlushAndSendEos() instance_id=" << fragment_instance_id_
            << " dest_node=" << dest_node_id_
            << " #rows= " << batch_->num_rows();
+  // The first channel of the host closes the stream for all its instances.
+  if (!sends_batches()) return Status::OK();
 
   // We can return an error here and not go on to send the EOS RPC because the error that
   // we returned will be sent to the coordinator who will then cancel all the remote
@@ -279,6 +485,11 @@ Status DataStreamSender::Channel::FlushAndSendEos(RuntimeState* state) {
 
   RETURN_IF_ERROR(GetSendStatus());
 
+  if (is_local_) {
+    return parent_->state_->stream_mgr()->CloseSender(fragment_instance_id_,
+        dest_node_id_, parent_->sender_id_);
+  }
+
   Status client_cnxn_status;
   ImpalaBackendConnection client(client_cache_, address_, &client_cnxn_status);
   RETURN_IF_ERROR(client_cnxn_status);
@@ -287,7 +498,7 @@ Status DataStreamSender::Channel::FlushAndSendEos(RuntimeState* state) {
   params.protocol_version = ImpalaInternalServiceVersion::V1;
   params.__set_dest_fragment_instance_id(fragment_instance_id_);
   params.__set_dest_node_id(dest_node_id_);
-  params.__set_sender_id(parent_->sender_id_);
+  params.__set_sender_id(rpc_sender_id());
   params.__set_eos(true);
   TTransmitDataResult res;
 
@@ -319,11 +530,19 @@ DataStreamSender::DataStreamSender(ObjectPool* pool, int sender_id,
     flushed_(false),
     closed_(false),
     current_thrift_batch_(&thrift_batch1_),
+    compression_type_(THdfsCompression::LZ4),
+    num_batches_to_send_uncompressed_(0),
+    rows_since_sample_(0),
     profile_(NULL),
     serialize_batch_timer_(NULL),
     thrift_transmit_timer_(NULL),
     bytes_sent_counter_(NULL),
     total_sent_rows_counter_(NULL),
+    uncompressed_batches_counter_(NULL),
+    local_batches_sent_counter_(NULL),
+    heavy_hitter_keys_counter_(NULL),
+    heavy_hitter_rows_percent_counter_(NULL),
+    max_channel_rows_percent_counter_(NULL),
     dest_node_id_(sink.dest_node_id) {
   DCHECK_GT(destinations.size(), 0);
   DCHECK(sink.output_partition.type == TPartitionType::UNPARTITIONED
@@ -338,6 +557,7 @@ DataStreamSender::DataStreamSender(ObjectPool* pool, int sender_id,
                     destinations[i].fragment_instance_id,
                     sink.dest_node_id, per_channel_buffer_size));
   }
+  if (broadcast_ && FLAGS_broadcast_once_per_host) GroupHostChannels(destinations);
 
   if (broadcast_ || random_) {
     // Randomize the order we open/transmit to channels to avoid thundering herd problems.
@@ -354,6 +574,29 @@ DataStreamSender::DataStreamSender(ObjectPool* pool, int sender_id,
   }
 }
 
+void DataStreamSender::GroupHostChannels(
+    const vector<TPlanFragmentDestination>& destinations) {
+  DCHECK_EQ(destinations.size(), channels_.size());
+  int i = 0;
+  while (i < destinations.size()) {
+    const TPlanFragmentDestination& first = destinations[i];
+    int end = i + 1;
+    while (end < destinations.size()
+        && end - i < DataStreamMgr::MAX_HOST_BROADCAST_INSTANCES
+        && destinations[end].server == first.server
+        && destinations[end].fragment_instance_id.hi == first.fragment_instance_id.hi
+        && destinations[end].fragment_instance_id.lo
+            == first.fragment_instance_id.lo + (end - i)) {
+      ++end;
+    }
+    if (end - i > 1) {
+      channels_[i]->set_num_host_instances(end - i);
+      for (int j = i + 1; j < end; ++j) channels_[j]->set_num_host_instances(0);
+    }
+    i = end;
+  }
+}
+
 DataStreamSender::~DataStreamSender() {
   // TODO: check that sender was either already closed() or there was an error
   // on some channel
@@ -393,6 +636,34 @@ Status DataStreamSender::Prepare(RuntimeState* state) {
                          profile()->total_time_counter()));
 
   total_sent_rows_counter_= ADD_COUNTER(profile(), "RowsReturned", TUnit::UNIT);
+  uncompressed_batches_counter_ =
+      ADD_COUNTER(profile(), "UncompressedRowBatches", TUnit::UNIT);
+  local_batches_sent_counter_ =
+      ADD_COUNTER(profile(), "LocalRowBatchesSent", TUnit::UNIT);
+  if (!broadcast_ && !random_ && channels_.size() > 1) {
+    channel_rows_.resize(channels_.size(), 0);
+    max_channel_rows_percent_counter_ =
+        ADD_COUNTER(profile(), "MaxChannelRowsPercent", TUnit::UNIT);
+    if (FLAGS_exchange_heavy_hitter_sample_interval > 0) {
+      heavy_hitter_sketch_.reset(new HeavyHitterSketch(HEAVY_HITTER_SKETCH_CAPACITY));
+      heavy_hitter_keys_counter_ =
+          ADD_COUNTER(profile(), "HeavyHitterKeys", TUnit::UNIT);
+      heavy_hitter_rows_percent_counter_ =
+          ADD_COUNTER(profile(), "HeavyHitterRowsPercent", TUnit::UNIT);
+    }
+  }
+
+  string codec = boost::algorithm::to_lower_copy(FLAGS_row_batch_compression_codec);
+  if (codec == "lz4") {
+    compression_type_ = THdfsCompression::LZ4;
+  } else if (codec == "snappy") {
+    compression_type_ = THdfsCompression::SNAPPY;
+  } else if (codec == "none") {
+    compression_type_ = THdfsCompression::NONE;
+  } else {
+    return Status(Substitute("Invalid row batch compression codec: '$0'. Valid values "
+        "are 'lz4', 'snappy' and 'none'.", FLAGS_row_batch_compression_codec));
+  }
   for (int i = 0; i < channels_.size(); ++i) {
     RETURN_IF_ERROR(channels_[i]->Init(state));
   }
@@ -409,42 +680,59 @@ Status DataStreamSender::Send(RuntimeState* state, RowBatch* batch, bool eos) {
 
   if (batch->num_rows() == 0) return Status::OK();
   if (broadcast_ || channels_.size() == 1) {
+    // Local channels get a copy of the rows, so only serialize for the remote ones.
+    // Channels whose receiver was closed are skipped.
+    sending_channels_.clear();
+    int num_remote_channels = 0;
+    for (Channel* channel: channels_) {
+      if (!channel->sends_batches() || channel->recvr_closed()) continue;
+      sending_channels_.push_back(channel);
+      if (!channel->is_local()) ++num_remote_channels;
+    }
     // current_thrift_batch_ is *not* the one that was written by the last call
     // to Serialize()
-    RETURN_IF_ERROR(SerializeBatch(batch, current_thrift_batch_, channels_.size()));
+    if (num_remote_channels > 0) {
+      RETURN_IF_ERROR(
+          SerializeBatch(batch, current_thrift_batch_, num_remote_channels));
+    }
     // SendBatch() will block if there are still in-flight rpcs (and those will
     // reference the previously written thrift batch)
-    for (int i = 0; i < channels_.size(); ++i) {
-      RETURN_IF_ERROR(channels_[i]->SendBatch(current_thrift_batch_));
+    for (Channel* channel: sending_channels_) {
+      if (channel->is_local()) {
+        RETURN_IF_ERROR(channel->SerializeAndSendBatch(batch));
+      } else {
+        RETURN_IF_ERROR(channel->SendBatch(current_thrift_batch_));
+      }
+    }
+    if (num_remote_channels > 0) {
+      current_thrift_batch_ =
+          (current_thrift_batch_ == &thrift_batch1_ ? &thrift_batch2_ : &thrift_batch1_);
     }
-    current_thrift_batch_ =
-        (current_thrift_batch_ == &thrift_batch1_ ? &thrift_batch2_ : &thrift_batch1_);
   } else if (random_) {
-    // Round-robin batches among channels. Wait for the current channel to finish its
-    // rpc before overwriting its batch.
+    // Round-robin batches among channels. The batch is serialized into one of the
+    // current channel's buffers once it has one that is not in flight.
     Channel* current_channel = channels_[current_channel_idx_];
-    current_channel->WaitForRpc();
-    RETURN_IF_ERROR(SerializeBatch(batch, current_channel->thrift_batch()));
-    RETURN_IF_ERROR(current_channel->SendBatch(current_channel->thrift_batch()));
+    RETURN_IF_ERROR(current_channel->SerializeAndSendBatch(batch));
     current_channel_idx_ = (current_channel_idx_ + 1) % channels_.size();
   } else {
-    // hash-partition batch's rows across channels
+    // hash-partition batch's rows across channels. The channel of every row is
+    // computed first so that the hash loop does not interleave with the row copies.
     int num_channels = channels_.size();
-    for (int i = 0; i < batch->num_rows(); ++i) {
-      TupleRow* row = batch->GetRow(i);
-      uint32_t hash_val = HashUtil::FNV_SEED;
-      for (int i = 0; i < partition_expr_ctxs_.size(); ++i) {
-        ExprContext* ctx = partition_expr_ctxs_[i];
-        void* partition_val = ctx->GetValue(row);
-        // We can't use the crc hash function here because it does not result
-        // in uncorrelated hashes with different seeds.  Instead we must use
-        // fnv hash.
-        // TODO: fix crc hash/GetHashValue()
-        hash_val =
-            RawValue::GetHashValueFnv(partition_val, ctx->root()->type(), hash_val);
+    int num_rows = batch->num_rows();
+    channel_idxs_.resize(num_rows);
+    for (int i = 0; i < num_rows; ++i) {
+      uint64_t hash = HashRow(batch->GetRow(i));
+      channel_idxs_[i] = hash % num_channels;
+      if (heavy_hitter_sketch_.get() != NULL
+          && ++rows_since_sample_ == FLAGS_exchange_heavy_hitter_sample_interval) {
+        heavy_hitter_sketch_->Update(hash);
+        rows_since_sample_ = 0;
       }
-      ExprContext::FreeLocalAllocations(partition_expr_ctxs_);
-      RETURN_IF_ERROR(channels_[hash_val % num_channels]->AddRow(row));
+    }
+    ExprContext::FreeLocalAllocations(partition_expr_ctxs_);
+    for (int i = 0; i < num_rows; ++i) {
+      RETURN_IF_ERROR(channels_[channel_idxs_[i]]->AddRow(batch->GetRow(i)));
+      ++channel_rows_[channel_idxs_[i]];
     }
   }
   COUNTER_ADD(total_sent_rows_counter_, batch->num_rows());
@@ -452,6 +740,27 @@ Status DataStreamSender::Send(RuntimeState* state, RowBatch* batch, bool eos) {
   return Status::OK();
 }
 
+inline uint64_t DataStreamSender::HashRow(TupleRow* row) {
+  uint64_t hash_val = EXCHANGE_HASH_SEED;
+  for (int i = 0; i < partition_expr_ctxs_.size(); ++i) {
+    ExprContext* ctx = partition_expr_ctxs_[i];
+    void* partition_val = ctx->GetValue(row);
+    // We can't use the crc hash function here because it does not result in
+    // uncorrelated hashes with different seeds, and the hash tables that consume the
+    // exchange hash the same values with crc.
+    hash_val =
+        RawValue::GetHashValueMurmur(partition_val, ctx->root()->type(), hash_val);
+  }
+  return hash_val;
+}
+
+bool DataStreamSender::IsDone() {
+  for (Channel* channel: channels_) {
+    if (channel->sends_batches() && !channel->recvr_closed()) return false;
+  }
+  return true;
+}
+
 Status DataStreamSender::FlushFinal(RuntimeState* state) {
   DCHECK(!flushed_);
   DCHECK(!closed_);
@@ -462,9 +771,41 @@ Status DataStreamSender::FlushFinal(RuntimeState* state) {
     // which will cause the remaining open channels to be closed.
     RETURN_IF_ERROR(channels_[i]->FlushAndSendEos(state));
   }
+  if (!channel_rows_.empty()) ReportSkew();
   return Status::OK();
 }
 
+void DataStreamSender::ReportSkew() {
+  int64_t total_rows = 0;
+  int64_t max_channel_rows = 0;
+  for (int64_t rows: channel_rows_) {
+    total_rows += rows;
+    max_channel_rows = max(max_channel_rows, rows);
+  }
+  if (total_rows == 0) return;
+  int num_channels = channel_rows_.size();
+  COUNTER_SET(max_channel_rows_percent_counter_, max_channel_rows * 100 / total_rows);
+
+  if (heavy_hitter_sketch_.get() != NULL && heavy_hitter_sketch_->num_updates() > 0) {
+    // A key is a heavy hitter if it alone would fill the fair share of a receiver.
+    vector<HeavyHitterSketch::HeavyHitter> heavy_hitters;
+    heavy_hitter_sketch_->GetHeavyHitters(1.0 / num_channels, &heavy_hitters);
+    int64_t heavy_hitter_rows = 0;
+    for (const HeavyHitterSketch::HeavyHitter& heavy_hitter: heavy_hitters) {
+      heavy_hitter_rows += heavy_hitter.second;
+    }
+    COUNTER_SET(heavy_hitter_keys_counter_, static_cast<int64_t>(heavy_hitters.size()));
+    COUNTER_SET(heavy_hitter_rows_percent_counter_,
+        heavy_hitter_rows * 100 / heavy_hitter_sketch_->num_updates());
+  }
+
+  if (max_channel_rows * num_channels > SKEWED_CHANNEL_FACTOR * total_rows) {
+    VLOG_QUERY << "Skewed exchange to node " << dest_node_id_ << ": "
+               << max_channel_rows << " of " << total_rows << " rows went to one of "
+               << num_channels << " receivers";
+  }
+}
+
 void DataStreamSender::Close(RuntimeState* state) {
   if (closed_) return;
   for (int i = 0; i < channels_.size(); ++i) {
@@ -483,7 +824,23 @@ Status DataStreamSender::SerializeBatch(RowBatch* src, TRowBatch* dest, int num_
   {
     SCOPED_TIMER(profile_->total_time_counter());
     SCOPED_TIMER(serialize_batch_timer_);
-    RETURN_IF_ERROR(src->Serialize(dest));
+    THdfsCompression::type compression_type = compression_type_;
+    if (num_batches_to_send_uncompressed_ > 0) {
+      --num_batches_to_send_uncompressed_;
+      compression_type = THdfsCompression::NONE;
+    }
+    RETURN_IF_ERROR(src->Serialize(dest, compression_type));
+    if (dest->compression_type == THdfsCompression::NONE) {
+      COUNTER_ADD(uncompressed_batches_counter_, 1);
+    }
+    // Skip compressing the next batches if the compression of this one did not pay off,
+    // e.g. because the data is random or already compressed.
+    if (FLAGS_row_batch_adaptive_compression &&
+        compression_type != THdfsCompression::NONE && dest->uncompressed_size > 0 &&
+        dest->tuple_data.size() >
+            ADAPTIVE_COMPRESSION_MAX_RATIO * dest->uncompressed_size) {
+      num_batches_to_send_uncompressed_ = ADAPTIVE_COMPRESSION_SKIP_BATCHES;
+    }
     int bytes = RowBatch::GetBatchSize(*dest);
     int uncompressed_bytes = bytes - dest->tuple_data.size() + dest->uncompressed_size;
     // The size output_batch would be if we didn't compress tuple_data (will be equal to
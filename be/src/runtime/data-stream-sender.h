@@ -30,12 +30,14 @@ namespace impala {
 
 class Expr;
 class ExprContext;
+class HeavyHitterSketch;
 class RowBatch;
 class RowDescriptor;
 class MemTracker;
 class TDataStreamSink;
 class TNetworkAddress;
 class TPlanFragmentDestination;
+class TupleRow;
 
 /// Single sender of an m:n data stream.
 /// Row batch data is routed to destinations based on the provided
@@ -80,6 +82,9 @@ class DataStreamSender : public DataSink {
   /// Send() call).
   virtual Status Send(RuntimeState* state, RowBatch* batch, bool eos);
 
+  /// Returns true once all receivers have told the sender that they were closed.
+  virtual bool IsDone();
+
   /// Shutdown all existing channels to destination hosts. Further FlushFinal() calls are
   /// illegal after calling Close().
   virtual void Close(RuntimeState* state);
@@ -95,9 +100,32 @@ class DataStreamSender : public DataSink {
 
   virtual RuntimeProfile* profile() { return profile_; }
 
+  /// Seed of the hash that assigns rows to channels for HASH_PARTITIONED sends. Every
+  /// sender of an exchange must use the same hash.
+  static const uint64_t EXCHANGE_HASH_SEED = 0x66bd68df22c3ef37;
+
  private:
   class Channel;
 
+  /// Returns the hash of the partition exprs of 'row' that determines its channel.
+  uint64_t HashRow(TupleRow* row);
+
+  /// Sets the skew counters of a hash-partitioned sender from channel_rows_ and the
+  /// heavy-hitter summary and logs exchanges whose busiest receiver gets more than
+  /// SKEWED_CHANNEL_FACTOR times its fair share of the rows.
+  void ReportSkew();
+
+  /// Makes the first channel of every run of consecutive fragment instance ids in
+  /// 'destinations' on the same host send the broadcast for the whole run. Called
+  /// with --broadcast_once_per_host while 'channels_' still follows 'destinations'.
+  void GroupHostChannels(const std::vector<TPlanFragmentDestination>& destinations);
+
+  /// Number of counters of the heavy-hitter summary. Keys with more than 1 / 33 of the
+  /// sampled rows are always found, which covers exchanges with up to 32 receivers.
+  static const int HEAVY_HITTER_SKETCH_CAPACITY = 32;
+
+  static const int SKEWED_CHANNEL_FACTOR = 2;
+
   /// Sender instance id, unique within a fragment.
   int sender_id_;
   RuntimeState* state_;
@@ -120,9 +148,34 @@ class DataStreamSender : public DataSink {
   TRowBatch thrift_batch2_;
   TRowBatch* current_thrift_batch_;  // the next one to fill in Send()
 
+  /// Codec used to compress serialized batches, set in Prepare() from
+  /// --row_batch_compression_codec.
+  THdfsCompression::type compression_type_;
+
+  /// Number of batches that SerializeBatch() still sends uncompressed because a recent
+  /// batch compressed poorly. Only used with --row_batch_adaptive_compression.
+  int num_batches_to_send_uncompressed_;
+
   std::vector<ExprContext*> partition_expr_ctxs_;  // compute per-row partition values
   std::vector<Channel*> channels_;
 
+  /// The channels that the current broadcast batch is sent to in Send().
+  std::vector<Channel*> sending_channels_;
+
+  /// Channel index of each row of the batch in Send() for HASH_PARTITIONED sends.
+  std::vector<int> channel_idxs_;
+
+  /// Summary of a sample of the row hashes of HASH_PARTITIONED sends, used to report
+  /// keys that are large enough to overload a single receiver. NULL if the sender is
+  /// not hash-partitioned or --exchange_heavy_hitter_sample_interval is 0.
+  boost::scoped_ptr<HeavyHitterSketch> heavy_hitter_sketch_;
+
+  /// Number of rows seen by Send() since the last sampled row.
+  int rows_since_sample_;
+
+  /// Number of rows sent to each channel by HASH_PARTITIONED sends.
+  std::vector<int64_t> channel_rows_;
+
   RuntimeProfile* profile_; // Allocated from pool_
   RuntimeProfile::Counter* serialize_batch_timer_;
   /// The concurrent wall time spent sending data over the network.
@@ -130,6 +183,22 @@ class DataStreamSender : public DataSink {
   RuntimeProfile::Counter* bytes_sent_counter_;
   RuntimeProfile::Counter* uncompressed_bytes_counter_;
   RuntimeProfile::Counter* total_sent_rows_counter_;
+
+  /// Number of serialized batches whose tuple data was not compressed.
+  RuntimeProfile::Counter* uncompressed_batches_counter_;
+
+  /// Number of batches handed to receivers in this impalad without serialization.
+  RuntimeProfile::Counter* local_batches_sent_counter_;
+
+  /// Number of sampled keys that each get more than a fair share of the rows of a
+  /// hash-partitioned exchange, and the percentage of the sampled rows that they
+  /// account for. Set in FlushFinal().
+  RuntimeProfile::Counter* heavy_hitter_keys_counter_;
+  RuntimeProfile::Counter* heavy_hitter_rows_percent_counter_;
+
+  /// Percentage of the rows of a hash-partitioned exchange that went to the busiest
+  /// channel. Set in FlushFinal().
+  RuntimeProfile::Counter* max_channel_rows_percent_counter_;
   boost::scoped_ptr<MemTracker> mem_tracker_;
 
   /// Throughput per time spent in TransmitData
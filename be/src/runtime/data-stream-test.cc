@@ -58,6 +58,7 @@ using namespace apache::thrift::protocol;
 DEFINE_int32(port, 20001, "port on which to run Impala test backend");
 DECLARE_string(principal);
 DECLARE_int32(datastream_sender_timeout_ms);
+DECLARE_bool(broadcast_once_per_host);
 
 // We reserve contiguous memory for senders in SetUp. If a test uses more
 // senders, a DCHECK will fail and you should increase this value.
@@ -95,8 +96,10 @@ class ImpalaTestBackend : public ImpalaInternalServiceIf {
   virtual void TransmitData(
       TTransmitDataResult& return_val, const TTransmitDataParams& params) {
     if (!params.eos) {
+      bool recvr_closed = false;
       mgr_->AddData(params.dest_fragment_instance_id, params.dest_node_id,
-                    params.row_batch, params.sender_id).SetTStatus(&return_val);
+          params.row_batch, params.sender_id, &recvr_closed).SetTStatus(&return_val);
+      if (recvr_closed) DataStreamMgr::SetRecvrClosed(&return_val.status);
     } else {
       mgr_->CloseSender(params.dest_fragment_instance_id, params.dest_node_id,
           params.sender_id).SetTStatus(&return_val);
@@ -417,8 +420,8 @@ class DataStreamTest : public testing::Test {
         } else if (stream_type == TPartitionType::HASH_PARTITIONED) {
           // hash-partitioned streams send values to the right partition
           int64_t value = *j;
-          uint32_t hash_val =
-              RawValue::GetHashValueFnv(&value, TYPE_BIGINT, HashUtil::FNV_SEED);
+          uint64_t hash_val = RawValue::GetHashValueMurmur(&value, TYPE_BIGINT,
+              DataStreamSender::EXCHANGE_HASH_SEED);
           EXPECT_EQ(hash_val % receiver_info_.size(), info.receiver_num);
         }
       }
@@ -584,6 +587,48 @@ TEST_F(DataStreamTest, BasicTest) {
   }
 }
 
+// All receivers run in the test backend with consecutive instance ids, so a broadcast
+// with --broadcast_once_per_host sends every batch once for all of them.
+TEST_F(DataStreamTest, BroadcastOncePerHost) {
+  const int num_receivers = 4;
+  TestStream(TPartitionType::UNPARTITIONED, 2, num_receivers, 1024, false);
+  int64_t bytes_per_instance = sender_info_[0].num_bytes_sent;
+  FLAGS_broadcast_once_per_host = true;
+  TestStream(TPartitionType::UNPARTITIONED, 2, num_receivers, 1024, false);
+  FLAGS_broadcast_once_per_host = false;
+  EXPECT_EQ(bytes_per_instance, num_receivers * sender_info_[0].num_bytes_sent);
+}
+
+// A sender stops sending once the receiver replied that it was closed early, e.g.
+// because its exchange reached its limit.
+TEST_F(DataStreamTest, RecvrClosedEarly) {
+  Reset();
+  RuntimeProfile* profile = obj_pool_.Add(new RuntimeProfile(&obj_pool_, "TestReceiver"));
+  TUniqueId instance_id;
+  GetNextInstanceId(&instance_id);
+  shared_ptr<DataStreamRecvr> stream_recvr = stream_mgr_->CreateRecvr(&runtime_state_,
+      *row_desc_, instance_id, DEST_NODE_ID, 1, 1024, profile, false);
+  stream_recvr->Deregister();
+
+  RuntimeState state(TExecPlanFragmentParams(), "", &exec_env_);
+  state.set_desc_tbl(desc_tbl_);
+  state.InitMemTrackers(TUniqueId(), NULL, -1);
+  DataStreamSender sender(&obj_pool_, 0, *row_desc_, broadcast_sink_, dest_, 1024);
+  EXPECT_OK(sender.Prepare(&state));
+  EXPECT_OK(sender.Open(&state));
+  scoped_ptr<RowBatch> batch(CreateRowBatch());
+  int next_val = 0;
+  GetNextBatch(batch.get(), &next_val);
+  EXPECT_FALSE(sender.IsDone());
+  EXPECT_OK(sender.Send(&state, batch.get(), false));
+  // FlushFinal() waits for the reply to the batch.
+  EXPECT_OK(sender.FlushFinal(&state));
+  EXPECT_TRUE(sender.IsDone());
+  sender.Close(&state);
+  batch->Reset();
+  stream_recvr->Close();
+}
+
 // This test checks for the avoidance of IMPALA-2931, which is a crash that would occur if
 // the parent memtracker of a DataStreamRecvr's memtracker was deleted before the
 // DataStreamRecvr was destroyed. The fix was to move decoupling the child tracker from
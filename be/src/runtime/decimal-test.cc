@@ -704,6 +704,21 @@ TEST(DecimalArithmetic, Divide) {
   EXPECT_FALSE(is_nan);
 }
 
+// Dividing values that came from smaller decimal types doesn't need 256 bit math.
+TEST(DecimalArithmetic, DivideSmallValues) {
+  ColumnType t1 = ColumnType::CreateDecimalType(18, 2);
+  ColumnType t2 = ColumnType::CreateDecimalType(38, 21);
+  Decimal16Value x(1234567);
+  Decimal16Value y(-300);
+  bool is_nan = false;
+  bool is_overflow = false;
+  Decimal16Value r = x.Divide<int128_t>(t1.scale, y, t1.scale, t2.precision, t2.scale,
+      &is_nan, &is_overflow);
+  VerifyToString(r, t2, "-4115.223333333333333333333");
+  EXPECT_FALSE(is_nan);
+  EXPECT_FALSE(is_overflow);
+}
+
 TEST(DecimalArithmetic, DivideLargeScales) {
   ColumnType t1 = ColumnType::CreateDecimalType(38, 8);
   ColumnType t2 = ColumnType::CreateDecimalType(20, 0);
@@ -203,8 +203,12 @@ DecimalValue<RESULT_T> DecimalValue<T>::Multiply(int this_scale,
   }
   if (result_precision == ColumnType::MAX_PRECISION) {
     DCHECK_EQ(sizeof(RESULT_T), 16);
-    // Check overflow
-    *overflow |= DecimalUtil::MAX_UNSCALED_DECIMAL16 / abs(y) < abs(x);
+    // Check overflow. The product of two values with at most 18 digits always fits,
+    // which avoids the 128 bit divide of the check for most values.
+    if (abs(x) > DecimalUtil::MAX_UNSCALED_DECIMAL8 ||
+        abs(y) > DecimalUtil::MAX_UNSCALED_DECIMAL8) {
+      *overflow |= DecimalUtil::MAX_UNSCALED_DECIMAL16 / abs(y) < abs(x);
+    }
   }
   RESULT_T result = x * y;
   int delta_scale = this_scale + other_scale - result_scale;
@@ -234,19 +238,25 @@ inline DecimalValue<RESULT_T> DecimalValue<T>::Divide(int this_scale,
   // This truncates the result to the output precision.
   // TODO: confirm with standard that truncate is okay.
   int scale_by = result_scale + other_scale - this_scale;
-  // Use higher precision ints for intermediates to avoid overflows. Divides lead to
-  // large numbers very quickly (and get eliminated by the int divide).
   if (sizeof(T) == 16) {
+    // If the scaled dividend fits into 128 bits, so does the quotient. This is the case
+    // for most values, e.g. the ones that were cast from smaller decimal types.
+    if (scale_by == 0 || abs(value()) <= DecimalUtil::GetScaleQuotient(scale_by)) {
+      int128_t x = DecimalUtil::MultiplyByScale<int128_t>(value(), scale_by);
+      return DecimalValue<RESULT_T>(x / other.value());
+    }
+    // Use higher precision ints for intermediates to avoid overflows. Divides lead to
+    // large numbers very quickly (and get eliminated by the int divide).
     int256_t x = DecimalUtil::MultiplyByScale<int256_t>(
         ConvertToInt256(value()), scale_by);
     int256_t y = ConvertToInt256(other.value());
     int128_t r = ConvertToInt128(x / y, DecimalUtil::MAX_UNSCALED_DECIMAL16, overflow);
     return DecimalValue<RESULT_T>(r);
   } else {
-    int128_t x = DecimalUtil::MultiplyByScale<RESULT_T>(value(), scale_by);
-    int128_t y = other.value();
-    int128_t r = x / y;
-    return DecimalValue<RESULT_T>(static_cast<RESULT_T>(r));
+    // The scaled dividend already has to fit into RESULT_T, so there is no need for a
+    // (much slower) 128 bit divide.
+    RESULT_T x = DecimalUtil::MultiplyByScale<RESULT_T>(value(), scale_by);
+    return DecimalValue<RESULT_T>(x / other.value());
   }
 }
 
@@ -325,6 +335,10 @@ inline int Decimal8Value::Compare(int this_scale, const Decimal8Value& other,
 template <>
 inline int Decimal16Value::Compare(int this_scale, const Decimal16Value& other,
      int other_scale) const {
+  if (this_scale == other_scale) {
+    if (value() == other.value()) return 0;
+    return value() < other.value() ? -1 : 1;
+  }
   int256_t x = ConvertToInt256(this->value());
   int256_t y = ConvertToInt256(other.value());
   int delta_scale = this_scale - other_scale;
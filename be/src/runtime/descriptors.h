@@ -361,6 +361,13 @@ class KuduTableDescriptor : public TableDescriptor {
   std::vector<std::string> master_addresses_;
 };
 
+/// The layout of a tuple, i.e. the offsets of its slots and null indicators, is
+/// computed by the planner and taken unchanged from the TTupleDescriptor. It must be the
+/// same in every fragment instance, because row batches are exchanged and spilled by
+/// byte offset.
+/// TODO: let the planner place the slots that are hashed, compared or updated by its
+/// consumers (join and grouping keys, filter columns) in the first cache line, and
+/// project away the slots that the build side of a join or a sort never reads.
 class TupleDescriptor {
  public:
   int byte_size() const { return byte_size_; }
@@ -0,0 +1,228 @@
+// Copyright 2016 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "runtime/disk-io-mgr.h"
+#include "runtime/disk-io-mgr-internal.h"
+
+#include <fcntl.h>
+#include <sys/syscall.h>
+
+#include "gutil/strings/substitute.h"
+#include "util/bit-util.h"
+#include "util/error-util.h"
+#include "util/time.h"
+
+#include "common/names.h"
+
+using namespace impala;
+using namespace strings;
+
+const int64_t DiskIoMgr::AsyncReader::DIRECT_IO_ALIGNMENT;
+
+// The completion thread wakes up at this interval to check for shut down.
+static const int COMPLETION_POLL_TIMEOUT_MS = 100;
+
+// glibc does not provide wrappers for the native AIO system calls.
+static int IoSetup(unsigned nr_events, aio_context_t* ctx) {
+  return syscall(__NR_io_setup, nr_events, ctx);
+}
+
+static int IoDestroy(aio_context_t ctx) {
+  return syscall(__NR_io_destroy, ctx);
+}
+
+static int IoSubmit(aio_context_t ctx, long nr, struct iocb** iocbs) {
+  return syscall(__NR_io_submit, ctx, nr, iocbs);
+}
+
+static int IoGetEvents(aio_context_t ctx, long min_nr, long max_nr,
+    struct io_event* events, struct timespec* timeout) {
+  return syscall(__NR_io_getevents, ctx, min_nr, max_nr, events, timeout);
+}
+
+DiskIoMgr::AsyncReader::AsyncReader(DiskIoMgr* io_mgr, DiskQueue* disk_queue,
+    int queue_depth)
+  : io_mgr_(io_mgr),
+    disk_queue_(disk_queue),
+    aio_context_(0),
+    requests_(max(queue_depth, 0)) {
+  for (Request& request: requests_) free_requests_.push_back(&request);
+}
+
+DiskIoMgr::AsyncReader::~AsyncReader() {
+  DCHECK_EQ(free_requests_.size(), requests_.size()) << "Reads are still in flight";
+  if (aio_context_ != 0) IoDestroy(aio_context_);
+}
+
+Status DiskIoMgr::AsyncReader::Init() {
+  if (requests_.empty()) {
+    return Status(Substitute("Invalid asynchronous read queue depth: $0",
+        requests_.size()));
+  }
+  if (IoSetup(requests_.size(), &aio_context_) != 0) {
+    aio_context_ = 0;
+    return Status(ErrorMsg(TErrorCode::RUNTIME_ERROR,
+        Substitute("io_setup($0) failed with errno=$1 description=$2",
+            requests_.size(), errno, GetStrErrMsg())));
+  }
+  return Status::OK();
+}
+
+bool DiskIoMgr::AsyncReader::Submit(DiskIoRequestContext* reader, ScanRange* range,
+    BufferDescriptor* buffer) {
+  // Reads through libhdfs can only be done synchronously.
+  if (range->fs_ != NULL) return false;
+  // The data of a range can start anywhere in the first aligned block of the buffer.
+  if (buffer->buffer_len_ < DIRECT_IO_ALIGNMENT) return false;
+  if (buffer->buffer_len_ % DIRECT_IO_ALIGNMENT != 0) return false;
+  DCHECK_EQ(reinterpret_cast<uintptr_t>(buffer->buffer_) % DIRECT_IO_ALIGNMENT, 0);
+
+  Request* request;
+  {
+    lock_guard<mutex> l(lock_);
+    if (free_requests_.empty()) return false;
+    request = free_requests_.back();
+    free_requests_.pop_back();
+  }
+
+  {
+    unique_lock<mutex> hdfs_lock(range->hdfs_lock_);
+    // Let the synchronous path return the cancellation.
+    if (!range->is_cancelled_ && PrepareRequest(reader, range, buffer, request)) {
+      struct iocb* cbs[] = { &request->cb };
+      if (IoSubmit(aio_context_, 1, cbs) == 1) {
+        // The request may already have completed.
+        return true;
+      }
+      VLOG_FILE << "io_submit() failed for " << range->file() << ": "
+                << GetStrErrMsg();
+    }
+  }
+
+  lock_guard<mutex> l(lock_);
+  free_requests_.push_back(request);
+  return false;
+}
+
+bool DiskIoMgr::AsyncReader::PrepareRequest(DiskIoRequestContext* reader,
+    ScanRange* range, BufferDescriptor* buffer, Request* request) {
+  int64_t file_offset = range->offset_ + range->bytes_read_;
+  int64_t bytes_remaining = range->len_ - range->bytes_read_;
+  DCHECK_GT(bytes_remaining, 0);
+  request->head = file_offset % DIRECT_IO_ALIGNMENT;
+  request->bytes_to_read =
+      min<int64_t>(bytes_remaining, buffer->buffer_len_ - request->head);
+  // A synchronous read returns the rest of the range in one buffer if it fits, which
+  // DiskIoMgr::Read() relies on. Otherwise, reading less is fine: the next read of the
+  // range starts at an aligned offset.
+  if (request->bytes_to_read < bytes_remaining &&
+      bytes_remaining <= range->ReadSize()) {
+    return false;
+  }
+
+  if (range->direct_fd_ == -1) {
+    range->direct_fd_ = open(range->file(), O_RDONLY | O_DIRECT);
+    if (range->direct_fd_ == -1) {
+      VLOG_FILE << "Could not open " << range->file() << " with O_DIRECT: "
+                << GetStrErrMsg();
+      return false;
+    }
+  }
+
+  request->reader = reader;
+  request->buffer = buffer;
+  request->submit_time = MonotonicNanos();
+  memset(&request->cb, 0, sizeof(request->cb));
+  request->cb.aio_data = reinterpret_cast<uint64_t>(request);
+  request->cb.aio_lio_opcode = IOCB_CMD_PREAD;
+  request->cb.aio_fildes = range->direct_fd_;
+  request->cb.aio_buf = reinterpret_cast<uint64_t>(buffer->buffer_);
+  request->cb.aio_nbytes =
+      BitUtil::RoundUp(request->head + request->bytes_to_read, DIRECT_IO_ALIGNMENT);
+  request->cb.aio_offset = file_offset - request->head;
+  DCHECK_LE(request->cb.aio_nbytes, buffer->buffer_len_);
+  return true;
+}
+
+void DiskIoMgr::AsyncReader::CompleteRead(Request* request, int64_t result) {
+  DiskIoRequestContext* reader = request->reader;
+  BufferDescriptor* buffer = request->buffer;
+  ScanRange* range = buffer->scan_range_;
+
+  if (result < 0) {
+    errno = -result;
+    string error_msg = GetStrErrMsg();
+    stringstream ss;
+    ss << "Error reading from " << range->file() << " at byte offset: "
+       << (range->offset_ + range->bytes_read_) << ": " << error_msg;
+    buffer->status_ = Status(ss.str());
+  } else {
+    int64_t bytes_read = min(max<int64_t>(result - request->head, 0),
+        request->bytes_to_read);
+    if (request->head > 0 && bytes_read > 0) {
+      memmove(buffer->buffer_, buffer->buffer_ + request->head, bytes_read);
+    }
+    buffer->len_ = bytes_read;
+    range->bytes_read_ += bytes_read;
+    DCHECK_LE(range->bytes_read_, range->len_);
+    // As for synchronous reads, a short read means that the end of the file was hit.
+    buffer->eosr_ = bytes_read < request->bytes_to_read ||
+        range->bytes_read_ == range->len_;
+    buffer->scan_range_offset_ = range->bytes_read_ - buffer->len_;
+  }
+
+  int64_t read_time = MonotonicNanos() - request->submit_time;
+  COUNTER_ADD(&io_mgr_->read_timer_, read_time);
+  if (reader->read_timer_ != NULL) COUNTER_ADD(reader->read_timer_, read_time);
+  reader->RecordRead(read_time, buffer->len_);
+  if (disk_queue_->read_latency != NULL) disk_queue_->read_latency->Update(read_time);
+  if (reader->bytes_read_counter_ != NULL) {
+    COUNTER_ADD(reader->bytes_read_counter_, buffer->len_);
+  }
+  COUNTER_ADD(&io_mgr_->total_bytes_read_counter_, buffer->len_);
+  if (reader->active_read_thread_counter_) {
+    reader->active_read_thread_counter_->Add(-1L);
+  }
+
+  {
+    lock_guard<mutex> l(lock_);
+    free_requests_.push_back(request);
+  }
+  io_mgr_->HandleReadFinished(disk_queue_, reader, buffer);
+}
+
+void DiskIoMgr::AsyncReader::CompletionLoop() {
+  vector<struct io_event> events(requests_.size());
+  while (true) {
+    int num_in_flight;
+    {
+      lock_guard<mutex> l(lock_);
+      num_in_flight = requests_.size() - free_requests_.size();
+    }
+    if (io_mgr_->shut_down_ && num_in_flight == 0) break;
+
+    struct timespec timeout;
+    timeout.tv_sec = 0;
+    timeout.tv_nsec = COMPLETION_POLL_TIMEOUT_MS * 1000L * 1000L;
+    int num_events =
+        IoGetEvents(aio_context_, 1, events.size(), &events[0], &timeout);
+    if (num_events < 0) {
+      DCHECK_EQ(errno, EINTR) << "io_getevents() failed: " << GetStrErrMsg();
+      continue;
+    }
+    for (int i = 0; i < num_events; ++i) {
+      CompleteRead(reinterpret_cast<Request*>(events[i].data), events[i].res);
+    }
+  }
+}
@@ -0,0 +1,145 @@
+// Copyright 2016 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "runtime/disk-io-mgr.h"
+#include "runtime/disk-io-mgr-internal.h"
+
+#include "util/hash-util.h"
+
+#include "common/names.h"
+
+using namespace impala;
+
+bool DiskIoMgr::FileHandleCache::Key::operator<(const Key& other) const {
+  if (mtime != other.mtime) return mtime < other.mtime;
+  return fname < other.fname;
+}
+
+DiskIoMgr::FileHandleCache::FileHandleCache(size_t capacity)
+  : shard_capacity_(max<size_t>((capacity + NUM_SHARDS - 1) / NUM_SHARDS, 1)) {
+}
+
+DiskIoMgr::FileHandleCache::~FileHandleCache() {
+  for (int i = 0; i < NUM_SHARDS; ++i) {
+    Shard* shard = &shards_[i];
+    DCHECK_EQ(shard->entries.size(), shard->lru_list.size()) << "Handles are in use";
+    for (multimap<Key, Entry*>::iterator it = shard->entries.begin();
+         it != shard->entries.end(); ++it) {
+      delete it->second->fh;
+      delete it->second;
+    }
+    if (ImpaladMetrics::IO_MGR_NUM_CACHED_FILE_HANDLES != NULL) {
+      ImpaladMetrics::IO_MGR_NUM_CACHED_FILE_HANDLES->Increment(
+          -static_cast<int64_t>(shard->lru_list.size()));
+    }
+  }
+}
+
+DiskIoMgr::FileHandleCache::Shard* DiskIoMgr::FileHandleCache::GetShard(
+    const string& fname) {
+  return &shards_[HashUtil::Hash(fname.data(), fname.size(), 0) % NUM_SHARDS];
+}
+
+DiskIoMgr::HdfsCachedFileHandle* DiskIoMgr::FileHandleCache::GetFileHandle(
+    const hdfsFS& fs, const string& fname, int64_t mtime, bool* cache_hit) {
+  Key key = { fname, mtime };
+  Shard* shard = GetShard(fname);
+  {
+    lock_guard<SpinLock> l(shard->lock);
+    pair<multimap<Key, Entry*>::iterator, multimap<Key, Entry*>::iterator> range =
+        shard->entries.equal_range(key);
+    for (; range.first != range.second; ++range.first) {
+      Entry* entry = range.first->second;
+      if (entry->in_use) continue;
+      entry->in_use = true;
+      shard->lru_list.erase(entry->lru_pos);
+      if (ImpaladMetrics::IO_MGR_NUM_CACHED_FILE_HANDLES != NULL) {
+        ImpaladMetrics::IO_MGR_NUM_CACHED_FILE_HANDLES->Increment(-1L);
+      }
+      *cache_hit = true;
+      return entry->fh;
+    }
+  }
+
+  // Open the file without holding the lock, this is a NameNode RPC.
+  *cache_hit = false;
+  HdfsCachedFileHandle* fh = new HdfsCachedFileHandle(fs, fname.c_str(), mtime);
+  if (!fh->ok()) {
+    delete fh;
+    return NULL;
+  }
+  Entry* entry = new Entry();
+  entry->key = key;
+  entry->fh = fh;
+  entry->in_use = true;
+  vector<HdfsCachedFileHandle*> evicted;
+  {
+    lock_guard<SpinLock> l(shard->lock);
+    shard->entries.insert(make_pair(key, entry));
+    EvictEntries(shard, &evicted);
+  }
+  for (int i = 0; i < evicted.size(); ++i) delete evicted[i];
+  return fh;
+}
+
+void DiskIoMgr::FileHandleCache::ReleaseFileHandle(const string& fname,
+    HdfsCachedFileHandle* fh, bool destroy) {
+  Key key = { fname, fh->mtime() };
+  Shard* shard = GetShard(fname);
+  vector<HdfsCachedFileHandle*> evicted;
+  {
+    lock_guard<SpinLock> l(shard->lock);
+    pair<multimap<Key, Entry*>::iterator, multimap<Key, Entry*>::iterator> range =
+        shard->entries.equal_range(key);
+    while (range.first != range.second && range.first->second->fh != fh) ++range.first;
+    DCHECK(range.first != range.second) << "Handle of " << fname << " is not cached";
+    Entry* entry = range.first->second;
+    DCHECK(entry->in_use);
+    if (destroy) {
+      shard->entries.erase(range.first);
+      delete entry;
+      evicted.push_back(fh);
+    } else {
+      entry->in_use = false;
+      entry->lru_pos = shard->lru_list.insert(shard->lru_list.end(), entry);
+      if (ImpaladMetrics::IO_MGR_NUM_CACHED_FILE_HANDLES != NULL) {
+        ImpaladMetrics::IO_MGR_NUM_CACHED_FILE_HANDLES->Increment(1L);
+      }
+      EvictEntries(shard, &evicted);
+    }
+  }
+  for (int i = 0; i < evicted.size(); ++i) delete evicted[i];
+}
+
+void DiskIoMgr::FileHandleCache::EvictEntries(Shard* shard,
+    vector<HdfsCachedFileHandle*>* evicted) {
+  shard->lock.DCheckLocked();
+  while (shard->entries.size() > shard_capacity_ && !shard->lru_list.empty()) {
+    Entry* entry = shard->lru_list.front();
+    shard->lru_list.pop_front();
+    pair<multimap<Key, Entry*>::iterator, multimap<Key, Entry*>::iterator> range =
+        shard->entries.equal_range(entry->key);
+    while (range.first->second != entry) ++range.first;
+    shard->entries.erase(range.first);
+    VLOG_FILE << "Cached file handle evicted, file=" << entry->key.fname;
+    evicted->push_back(entry->fh);
+    delete entry;
+    if (ImpaladMetrics::IO_MGR_NUM_CACHED_FILE_HANDLES != NULL) {
+      ImpaladMetrics::IO_MGR_NUM_CACHED_FILE_HANDLES->Increment(-1L);
+    }
+    if (ImpaladMetrics::IO_MGR_CACHED_FILE_HANDLES_EVICTED_COUNT != NULL) {
+      ImpaladMetrics::IO_MGR_CACHED_FILE_HANDLES_EVICTED_COUNT->Increment(1L);
+    }
+  }
+}
@@ -16,8 +16,12 @@
 #define IMPALA_RUNTIME_DISK_IO_MGR_INTERNAL_H
 
 #include "disk-io-mgr.h"
+#include <list>
+#include <map>
 #include <queue>
+#include <boost/scoped_ptr.hpp>
 #include <boost/thread/locks.hpp>
+#include <linux/aio_abi.h>
 #include <unistd.h>
 #include <gutil/strings/substitute.h>
 
@@ -30,12 +34,173 @@
 #include "util/disk-info.h"
 #include "util/hdfs-util.h"
 #include "util/filesystem-util.h"
+#include "util/histogram-metric.h"
 #include "util/impalad-metrics.h"
 
 /// This file contains internal structures to the IoMgr. Users of the IoMgr do
 /// not need to include this file.
 namespace impala {
 
+/// Cache of open HDFS file handles, keyed by file name and modification time, so that
+/// scan ranges of recently read files do not have to open them again, which costs a
+/// NameNode RPC. The cache is split into NUM_SHARDS shards by the hash of the file
+/// name. Each shard has its own lock, which is never held while a file is opened or
+/// closed, so that lookups of different files rarely contend.
+//
+/// A handle is checked out exclusively by GetFileHandle(), since libhdfs file handles
+/// keep a read position. Scan ranges of the same file that are read concurrently use
+/// different handles, so a shard can hold several handles of one file. The handles
+/// that are not checked out are kept in LRU order, and the least recently used ones
+/// are closed when a shard holds more than its share of 'capacity' handles. Handles
+/// that are checked out are never evicted. Because the modification time is part of
+/// the key, the handles of a file that was overwritten are not returned any more and
+/// age out of the cache.
+class DiskIoMgr::FileHandleCache {
+ public:
+  /// 'capacity' is the total number of handles that should be kept across all shards.
+  FileHandleCache(size_t capacity);
+
+  /// Closes all cached handles. No handles may be checked out.
+  ~FileHandleCache();
+
+  /// Checks out a handle of 'fname' for 'mtime', opening a new one on 'fs' if all
+  /// cached handles of the file are checked out. Sets '*cache_hit' to true if a cached
+  /// handle was returned. Returns NULL if the file could not be opened.
+  HdfsCachedFileHandle* GetFileHandle(const hdfsFS& fs, const std::string& fname,
+      int64_t mtime, bool* cache_hit);
+
+  /// Returns a handle of 'fname' that was checked out by GetFileHandle(). If 'destroy'
+  /// is true, the handle is closed, otherwise it is kept for reuse until it is evicted.
+  void ReleaseFileHandle(const std::string& fname, HdfsCachedFileHandle* fh,
+      bool destroy);
+
+ private:
+  static const int NUM_SHARDS = 16;
+
+  struct Key {
+    std::string fname;
+    int64_t mtime;
+
+    bool operator<(const Key& other) const;
+  };
+
+  struct Entry {
+    Key key;
+    HdfsCachedFileHandle* fh;
+
+    /// True while the handle is checked out.
+    bool in_use;
+
+    /// The position of the entry in the LRU list of its shard. Only valid if !in_use.
+    std::list<Entry*>::iterator lru_pos;
+  };
+
+  struct Shard {
+    /// Protects all members.
+    SpinLock lock;
+
+    /// All handles of the shard, owned by the shard.
+    std::multimap<Key, Entry*> entries;
+
+    /// The handles that are not checked out. The least recently used is at the front.
+    std::list<Entry*> lru_list;
+  };
+
+  /// Returns the shard of 'fname'.
+  Shard* GetShard(const std::string& fname);
+
+  /// Removes the least recently used entries of 'shard' until it holds at most
+  /// 'shard_capacity_' handles or all remaining ones are checked out. The evicted
+  /// handles are appended to 'evicted' so that they can be closed after releasing the
+  /// shard's lock.
+  void EvictEntries(Shard* shard, std::vector<HdfsCachedFileHandle*>* evicted);
+
+  /// The maximum number of handles in each shard.
+  const size_t shard_capacity_;
+
+  Shard shards_[NUM_SHARDS];
+};
+
+/// Asynchronous reader for local files on one disk, using Linux native AIO. The disk
+/// threads submit reads from ReadRange() without waiting for them, so a few threads
+/// can keep up to 'queue_depth' reads in flight. A single completion thread per disk
+/// reaps the finished reads and hands them to HandleReadFinished(), so the buffers
+/// reach the scan ranges exactly as they do for synchronous reads.
+//
+/// Native AIO only runs asynchronously for files opened with O_DIRECT, which bypasses
+/// the page cache and requires the file offset, length and memory of each read to be
+/// aligned to DIRECT_IO_ALIGNMENT. The read is widened to aligned boundaries and the
+/// leading bytes are moved out of the buffer after completion. Since a range's reads
+/// after the first are aligned, this only happens once per range.
+//
+/// At most one read per scan range is in flight, because the disk threads only pick a
+/// range up again after HandleReadFinished() rescheduled it. The request thread count
+/// of the context stays incremented while the read is in flight, which keeps the
+/// cancellation path waiting for it.
+class DiskIoMgr::AsyncReader {
+ public:
+  /// Alignment of O_DIRECT reads. Also the alignment of io buffers of at least this
+  /// size.
+  static const int64_t DIRECT_IO_ALIGNMENT = 4096;
+
+  AsyncReader(DiskIoMgr* io_mgr, DiskQueue* disk_queue, int queue_depth);
+  ~AsyncReader();
+
+  /// Sets up the kernel AIO context. Returns an error if native AIO is unavailable.
+  Status Init();
+
+  /// Submits the next read of 'range', which must be open, into 'buffer'. Returns false
+  /// if the read cannot be done asynchronously, e.g. because all slots are in use, the
+  /// buffer is too small to be aligned or the file system does not support O_DIRECT.
+  /// The caller must then read synchronously.
+  bool Submit(DiskIoRequestContext* reader, ScanRange* range, BufferDescriptor* buffer);
+
+  /// Completion thread loop. Runs until the IoMgr is shut down and no reads are in
+  /// flight.
+  void CompletionLoop();
+
+ private:
+  /// State of a submitted read.
+  struct Request {
+    struct iocb cb;
+    DiskIoRequestContext* reader;
+    BufferDescriptor* buffer;
+
+    /// Number of bytes before the requested data that were read for alignment.
+    int64_t head;
+
+    /// Number of bytes of the scan range that the request reads.
+    int64_t bytes_to_read;
+
+    /// MonotonicNanos() at submission time.
+    int64_t submit_time;
+  };
+
+  /// Fills in 'request' for the next read of 'range' into 'buffer', opening the file
+  /// with O_DIRECT if needed. Returns false if the read cannot be done asynchronously.
+  /// The range's 'hdfs_lock_' must be held.
+  bool PrepareRequest(DiskIoRequestContext* reader, ScanRange* range,
+      BufferDescriptor* buffer, Request* request);
+
+  /// Updates the buffer and range from the result of a completed request, which is the
+  /// number of bytes read or a negative errno value, and hands the buffer to
+  /// HandleReadFinished().
+  void CompleteRead(Request* request, int64_t result);
+
+  DiskIoMgr* const io_mgr_;
+  DiskQueue* const disk_queue_;
+  aio_context_t aio_context_;
+
+  /// All request slots, 'queue_depth' of them.
+  std::vector<Request> requests_;
+
+  /// Protects 'free_requests_'.
+  boost::mutex lock_;
+
+  /// Slots in 'requests_' that are not currently submitted.
+  std::vector<Request*> free_requests_;
+};
+
 /// Per disk state
 struct DiskIoMgr::DiskQueue {
   /// Disk id (0-based)
@@ -65,7 +230,14 @@ struct DiskIoMgr::DiskQueue {
     work_available.notify_all();
   }
 
-  DiskQueue(int id) : disk_id(id) { }
+  /// Asynchronous reader for local files. NULL if asynchronous reads are disabled or
+  /// this is a remote queue.
+  boost::scoped_ptr<AsyncReader> async_reader;
+
+  /// Latency of the reads from this disk. NULL if InitMetrics() was not called.
+  HistogramMetric* read_latency;
+
+  DiskQueue(int id) : disk_id(id), read_latency(NULL) { }
 };
 
 /// Internal per request-context state. This object maintains a lot of state that is
@@ -180,6 +352,16 @@ class DiskIoRequestContext {
   /// Cancels the context with status code 'status'.
   void Cancel(const Status& status);
 
+  /// Accounts a read of 'bytes' that kept a disk busy for 'time_ns' to the request pool
+  /// of this context.
+  void RecordRead(int64_t time_ns, int64_t bytes) {
+    if (pool_stats_ == NULL) return;
+    pool_stats_->disk_time_ns.Add(time_ns);
+    pool_stats_->bytes_read.Add(bytes);
+    pool_stats_->num_reads.Add(1);
+    if (pool_stats_->read_latency != NULL) pool_stats_->read_latency->Update(time_ns);
+  }
+
   /// Adds request range to disk queue for this request context. Currently,
   /// schedule_immediately must be false is RequestRange is a write range.
   void AddRequestRange(RequestRange* range, bool schedule_immediately);
@@ -230,6 +412,28 @@ class DiskIoRequestContext {
   /// Total number of bytes from remote reads that were expected to be local.
   AtomicInt64 unexpected_remote_bytes_;
 
+  /// Number of reads served from the IoMgr's data cache, number of reads that were
+  /// looked up in the data cache but not found and number of bytes served from it.
+  AtomicInt64 data_cache_hit_count_;
+  AtomicInt64 data_cache_miss_count_;
+  AtomicInt64 data_cache_hit_bytes_;
+
+  /// Number of hedged remote HDFS reads that took longer than
+  /// --hdfs_hedged_read_threshold_ms, i.e. that the HDFS client also sent to another
+  /// replica if one was available.
+  AtomicInt64 num_slow_remote_reads_;
+
+  /// Weight of this context in the disk scheduling, derived from its request pool.
+  /// A context gets disk bandwidth in proportion to its weight. Always >= 1.
+  int weight_;
+
+  /// Disk usage of the request pool of this context. NULL if the pool is not set.
+  DiskIoMgr::PoolStats* pool_stats_;
+
+  /// The NUMA node that buffers for this context are allocated on, or -1 for the node
+  /// of the disk thread.
+  int numa_node_;
+
   /// The number of buffers that have been returned to the reader (via GetNext) that the
   /// reader has not returned. Only included for debugging and diagnostics.
   AtomicInt32 num_buffers_in_reader_;
@@ -301,6 +505,10 @@ class DiskIoRequestContext {
   /// Ranges that are blocked due to back pressure on outgoing buffers.
   InternalQueue<ScanRange> blocked_ranges_;
 
+  /// Ranges created by DiskIoMgr::CoalesceScanRanges() to read the extents of
+  /// coalesced client ranges.
+  ObjectPool coalesced_ranges_pool_;
+
   /// Condition variable for UnregisterContext() to wait for all disks to complete
   boost::condition_variable disks_complete_cond_var_;
 
@@ -391,6 +599,17 @@ class DiskIoRequestContext {
       }
     }
 
+    /// Bytes this context may still read or write on this disk in the current round of
+    /// the disk's deficit round-robin scheduling. See GetNextRequestRange().
+    int64_t deficit() const { return deficit_.Load(); }
+    void AddDeficit(int64_t bytes) { deficit_.Add(bytes); }
+
+    /// Drops the unused credit when the context has no work on this disk, so that an
+    /// idle context cannot save up credit.
+    void ClearCredit() {
+      if (deficit_.Load() > 0) deficit_.Store(0);
+    }
+
     void Reset() {
       DCHECK(in_flight_ranges_.empty());
       DCHECK(unstarted_scan_ranges_.empty());
@@ -401,6 +620,7 @@ class DiskIoRequestContext {
       is_on_queue_ = false;
       num_threads_in_op_.Store(0);
       next_scan_range_to_start_ = NULL;
+      deficit_.Store(0);
     }
 
    private:
@@ -460,6 +680,10 @@ class DiskIoRequestContext {
     /// Only the thread that sees the count at 0 should do the final cleanup.
     AtomicInt32 num_threads_in_op_;
 
+    /// See deficit(). Credited by the disk threads with the disk queue lock taken and
+    /// charged when reads and writes finish with the context lock taken.
+    AtomicInt64 deficit_;
+
     /// Queue of write ranges to process for this disk. A write range is always added
     /// to in_flight_ranges_ in GetNextRequestRange(). There is a separate
     /// unstarted_read_ranges_ and unstarted_write_ranges_ to alternate between reads
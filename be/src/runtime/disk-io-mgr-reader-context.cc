@@ -161,11 +161,19 @@ void DiskIoRequestContext::Reset(MemTracker* tracker) {
   bytes_read_short_circuit_.Store(0);
   bytes_read_dn_cache_.Store(0);
   unexpected_remote_bytes_.Store(0);
+  data_cache_hit_count_.Store(0);
+  data_cache_miss_count_.Store(0);
+  data_cache_hit_bytes_.Store(0);
+  num_slow_remote_reads_.Store(0);
+  weight_ = 1;
+  pool_stats_ = NULL;
+  numa_node_ = -1;
   initial_queue_capacity_ = DiskIoMgr::DEFAULT_QUEUE_CAPACITY;
 
   DCHECK(ready_to_start_ranges_.empty());
   DCHECK(blocked_ranges_.empty());
   DCHECK(cached_ranges_.empty());
+  coalesced_ranges_pool_.Clear();
 
   for (int i = 0; i < disk_states_.size(); ++i) {
     disk_states_[i].Reset();
@@ -14,13 +14,18 @@
 
 #include "runtime/disk-io-mgr.h"
 #include "runtime/disk-io-mgr-internal.h"
+#include "runtime/data-cache.h"
 #include "util/error-util.h"
 #include "util/hdfs-util.h"
+#include "util/stopwatch.h"
 
 #include "common/names.h"
 
 using namespace impala;
 
+DECLARE_int32(hdfs_hedged_read_threadpool_size);
+DECLARE_int32(hdfs_hedged_read_threshold_ms);
+
 // A very large max value to prevent things from going out of control. Not
 // expected to ever hit this value (1GB of buffered data per range).
 const int MAX_QUEUE_CAPACITY = 128;
@@ -160,6 +165,9 @@ void DiskIoMgr::ScanRange::Cancel(const Status& status) {
   // For cached buffers, we can't close the range until the cached buffer is returned.
   // Close() is called from DiskIoMgr::ReturnBuffer().
   if (cached_buffer_ == NULL) Close();
+
+  // The coalesced ranges are only read through this range.
+  for (ScanRange* range: coalesced_ranges_) range->Cancel(status);
 }
 
 void DiskIoMgr::ScanRange::CleanupQueuedBuffers() {
@@ -222,12 +230,15 @@ void DiskIoMgr::ScanRange::Reset(hdfsFS fs, const char* file, int64_t len, int64
   disk_id_ = disk_id;
   try_cache_ = try_cache;
   expected_local_ = expected_local;
+  preferred_read_size_ = 0;
   meta_data_ = meta_data;
   cached_buffer_ = NULL;
   io_mgr_ = NULL;
   reader_ = NULL;
   hdfs_file_ = NULL;
+  direct_fd_ = -1;
   mtime_ = mtime;
+  coalesced_ranges_.clear();
 }
 
 void DiskIoMgr::ScanRange::InitInternal(DiskIoMgr* io_mgr, DiskIoRequestContext* reader) {
@@ -236,6 +247,7 @@ void DiskIoMgr::ScanRange::InitInternal(DiskIoMgr* io_mgr, DiskIoRequestContext*
   reader_ = reader;
   local_file_ = NULL;
   hdfs_file_ = NULL;
+  direct_fd_ = -1;
   bytes_read_ = 0;
   is_cancelled_ = false;
   eosr_queued_= false;
@@ -329,12 +341,27 @@ void DiskIoMgr::ScanRange::Close() {
     if (local_file_ == NULL) return;
     fclose(local_file_);
     local_file_ = NULL;
+    if (direct_fd_ != -1) {
+      close(direct_fd_);
+      direct_fd_ = -1;
+    }
   }
   if (ImpaladMetrics::IO_MGR_NUM_OPEN_FILES != NULL) {
     ImpaladMetrics::IO_MGR_NUM_OPEN_FILES->Increment(-1L);
   }
 }
 
+int64_t DiskIoMgr::ScanRange::ReadSize() const {
+  int64_t max_read_size = io_mgr_->max_buffer_size_;
+  if (preferred_read_size_ == 0 || disk_id_ == io_mgr_->RemoteDfsDiskId() ||
+      disk_id_ == io_mgr_->RemoteS3DiskId()) {
+    return max_read_size;
+  }
+  // Reads fill whole buffers, so round the hint up to its buffer size class.
+  int idx = io_mgr_->free_buffers_idx(min(preferred_read_size_, max_read_size));
+  return min((1LL << idx) * io_mgr_->min_buffer_size_, max_read_size);
+}
+
 int64_t DiskIoMgr::ScanRange::MaxReadChunkSize() const {
   // S3 InputStreams don't support DIRECT_READ (i.e. java.nio.ByteBuffer read()
   // interface).  So, hdfsRead() needs to allocate a Java byte[] and copy the data out.
@@ -359,18 +386,43 @@ Status DiskIoMgr::ScanRange::Read(char* buffer, int64_t* bytes_read, bool* eosr)
   *eosr = false;
   *bytes_read = 0;
   // hdfsRead() length argument is an int.  Since max_buffer_size_ type is no bigger
-  // than an int, this min() will ensure that we don't overflow the length argument.
+  // than an int and ReadSize() is at most max_buffer_size_, this min() will ensure that
+  // we don't overflow the length argument.
   DCHECK_LE(sizeof(io_mgr_->max_buffer_size_), sizeof(int));
-  int bytes_to_read =
-      min(static_cast<int64_t>(io_mgr_->max_buffer_size_), len_ - bytes_read_);
+  int bytes_to_read = min(ReadSize(), len_ - bytes_read_);
   DCHECK_GE(bytes_to_read, 0);
 
   if (fs_ != NULL) {
     DCHECK(hdfs_file_ != NULL);
+    bool use_data_cache = UseDataCache();
+    // The HDFS client only hedges positional reads, which don't use the file position.
+    bool use_hedged_reads = UseHedgedReads();
+    // Reads that were served from the data cache did not move the file position.
+    if (use_data_cache && !use_hedged_reads &&
+        hdfsTell(fs_, hdfs_file_->file()) != offset_ + bytes_read_ &&
+        hdfsSeek(fs_, hdfs_file_->file(), offset_ + bytes_read_) != 0) {
+      string error_msg = GetHdfsErrorMsg("");
+      stringstream ss;
+      ss << "Error seeking to " << (offset_ + bytes_read_) << " in file: " << file_
+         << " " << error_msg;
+      return Status(ss.str());
+    }
     int64_t max_chunk_size = MaxReadChunkSize();
     while (*bytes_read < bytes_to_read) {
       int chunk_size = min(bytes_to_read - *bytes_read, max_chunk_size);
-      int last_read = hdfsRead(fs_, hdfs_file_->file(), buffer + *bytes_read, chunk_size);
+      int last_read;
+      if (use_hedged_reads) {
+        MonotonicStopWatch read_timer;
+        read_timer.Start();
+        int64_t position = offset_ + bytes_read_ + *bytes_read;
+        last_read = hdfsPread(fs_, hdfs_file_->file(), position, buffer + *bytes_read,
+            chunk_size);
+        if (read_timer.ElapsedTime() / 1000000 > FLAGS_hdfs_hedged_read_threshold_ms) {
+          reader_->num_slow_remote_reads_.Add(1);
+        }
+      } else {
+        last_read = hdfsRead(fs_, hdfs_file_->file(), buffer + *bytes_read, chunk_size);
+      }
       if (last_read == -1) {
         return Status(GetHdfsErrorMsg("Error reading from HDFS file: ", file_));
       } else if (last_read == 0) {
@@ -380,8 +432,21 @@ Status DiskIoMgr::ScanRange::Read(char* buffer, int64_t* bytes_read, bool* eosr)
       }
       *bytes_read += last_read;
     }
+    if (use_data_cache && *bytes_read == bytes_to_read) {
+      Status status = io_mgr_->data_cache_->Store(file_, mtime_, offset_ + bytes_read_,
+          bytes_to_read, reinterpret_cast<uint8_t*>(buffer));
+      if (!status.ok()) VLOG_FILE << "Not caching data: " << status.GetDetail();
+    }
   } else {
     DCHECK(local_file_ != NULL);
+    // Asynchronous reads do not move the position of 'local_file_'.
+    if (direct_fd_ != -1 && fseek(local_file_, offset_ + bytes_read_, SEEK_SET) == -1) {
+      string error_msg = GetStrErrMsg();
+      stringstream ss;
+      ss << "Could not seek to " << (offset_ + bytes_read_) << " for file: " << file_
+         << ": " << error_msg;
+      return Status(ss.str());
+    }
     *bytes_read = fread(buffer, 1, bytes_to_read, local_file_);
     DCHECK_GE(*bytes_read, 0);
     DCHECK_LE(*bytes_read, bytes_to_read);
@@ -405,6 +470,41 @@ Status DiskIoMgr::ScanRange::Read(char* buffer, int64_t* bytes_read, bool* eosr)
   return Status::OK();
 }
 
+bool DiskIoMgr::ScanRange::UseDataCache() const {
+  if (io_mgr_->data_cache_.get() == NULL || fs_ == NULL) return false;
+  if (mtime_ == NEVER_CACHE) return false;
+  return disk_id_ == io_mgr_->RemoteDfsDiskId() || disk_id_ == io_mgr_->RemoteS3DiskId();
+}
+
+bool DiskIoMgr::ScanRange::UseHedgedReads() const {
+  if (FLAGS_hdfs_hedged_read_threadpool_size <= 0 || fs_ == NULL) return false;
+  return disk_id_ == io_mgr_->RemoteDfsDiskId();
+}
+
+bool DiskIoMgr::ScanRange::ReadFromDataCache(char* buffer, int64_t* bytes_read,
+    bool* eosr) {
+  if (!UseDataCache()) return false;
+  unique_lock<mutex> hdfs_lock(hdfs_lock_);
+  // Let the regular read path return the cancellation.
+  if (is_cancelled_) return false;
+
+  // Use the same extents as Read() so that the data cached by it is found.
+  int64_t bytes_to_read = min(ReadSize(), len_ - bytes_read_);
+  DCHECK_GT(bytes_to_read, 0);
+  if (!io_mgr_->data_cache_->Lookup(file_, mtime_, offset_ + bytes_read_,
+      bytes_to_read, reinterpret_cast<uint8_t*>(buffer))) {
+    reader_->data_cache_miss_count_.Add(1);
+    return false;
+  }
+  reader_->data_cache_hit_count_.Add(1);
+  reader_->data_cache_hit_bytes_.Add(bytes_to_read);
+  *bytes_read = bytes_to_read;
+  bytes_read_ += bytes_to_read;
+  DCHECK_LE(bytes_read_, len_);
+  *eosr = bytes_read_ == len_;
+  return true;
+}
+
 Status DiskIoMgr::ScanRange::ReadFromCache(bool* read_succeeded) {
   DCHECK(try_cache_);
   DCHECK_EQ(bytes_read_, 0);
@@ -426,14 +526,27 @@ Status DiskIoMgr::ScanRange::ReadFromCache(bool* read_succeeded) {
 
     // Data was not cached, caller will fall back to normal read path.
     if (cached_buffer_ == NULL) return Status::OK();
+
+    // Cached blocks are read entirely, but a memory-mapped local replica that is not
+    // cached may return less than the range. Undo the read and fall back to the normal
+    // read path.
+    if (hadoopRzBufferLength(cached_buffer_) != len()) {
+      hadoopRzBufferFree(hdfs_file_->file(), cached_buffer_);
+      cached_buffer_ = NULL;
+      if (hdfsSeek(fs_, hdfs_file_->file(), offset_) != 0) {
+        string error_msg = GetHdfsErrorMsg("");
+        stringstream ss;
+        ss << "Error seeking to " << offset_ << " in file: " << file_ << " "
+           << error_msg;
+        return Status(ss.str());
+      }
+      return Status::OK();
+    }
   }
 
   // Cached read succeeded.
   void* buffer = const_cast<void*>(hadoopRzBufferGet(cached_buffer_));
   int32_t bytes_read = hadoopRzBufferLength(cached_buffer_);
-  // For now, entire the entire block is cached or none of it.
-  // TODO: if HDFS ever changes this, we'll have to handle the case where half
-  // the block is cached.
   DCHECK_EQ(bytes_read, len());
 
   // Create a single buffer desc for the entire scan range and enqueue that.
@@ -26,11 +26,16 @@
 #include "util/cpu-info.h"
 #include "util/disk-info.h"
 #include "util/thread.h"
+#include "util/time.h"
 
 #include "common/names.h"
 
 using boost::condition_variable;
 
+DECLARE_bool(use_async_local_reads);
+DECLARE_int32(max_scan_range_coalesce_gap);
+DECLARE_string(disk_io_pool_weights);
+
 const int MIN_BUFFER_SIZE = 512;
 const int MAX_BUFFER_SIZE = 1024;
 const int LARGE_MEM_LIMIT = 1024 * 1024 * 1024;
@@ -982,6 +987,39 @@ TEST_F(DiskIoMgrTest, Buffers) {
   EXPECT_EQ(mem_tracker.consumption(), 0);
 }
 
+// Test that unused buffers are freed once they were idle for long enough.
+TEST_F(DiskIoMgrTest, IdleBuffers) {
+  int min_buffer_size = 1024;
+  int max_buffer_size = 8 * 1024;
+  MemTracker mem_tracker(max_buffer_size * 2);
+
+  DiskIoMgr io_mgr(1, 1, min_buffer_size, max_buffer_size);
+  ASSERT_OK(io_mgr.Init(&mem_tracker));
+
+  int64_t buffer_len = min_buffer_size;
+  char* buf1 = io_mgr.GetFreeBuffer(&buffer_len);
+  char* buf2 = io_mgr.GetFreeBuffer(&buffer_len);
+  io_mgr.ReturnFreeBuffer(buf1, buffer_len);
+  SleepForMs(100);
+  io_mgr.ReturnFreeBuffer(buf2, buffer_len);
+  EXPECT_EQ(io_mgr.num_allocated_buffers_.Load(), 2);
+  EXPECT_EQ(mem_tracker.consumption(), min_buffer_size * 2);
+
+  // Only the buffer that was returned first has been idle for long enough.
+  io_mgr.FreeIdleBuffers(50);
+  EXPECT_EQ(io_mgr.num_allocated_buffers_.Load(), 1);
+  EXPECT_EQ(mem_tracker.consumption(), min_buffer_size);
+
+  // The remaining buffer is still reused.
+  char* buf = io_mgr.GetFreeBuffer(&buffer_len);
+  EXPECT_EQ(io_mgr.num_allocated_buffers_.Load(), 1);
+  io_mgr.ReturnFreeBuffer(buf, buffer_len);
+
+  io_mgr.FreeIdleBuffers(0);
+  EXPECT_EQ(io_mgr.num_allocated_buffers_.Load(), 0);
+  EXPECT_EQ(mem_tracker.consumption(), 0);
+}
+
 // IMPALA-2366: handle partial read where range goes past end of file.
 TEST_F(DiskIoMgrTest, PartialRead) {
   MemTracker mem_tracker(LARGE_MEM_LIMIT);
@@ -1019,6 +1057,217 @@ TEST_F(DiskIoMgrTest, PartialRead) {
   EXPECT_EQ(mem_tracker.consumption(), 0);
 }
 
+// Reads ranges of a local file with asynchronous reads enabled. The ranges start at
+// unaligned offsets and span multiple buffers. If the file system does not support
+// O_DIRECT, the reads fall back to the synchronous path and must return the same data.
+TEST_F(DiskIoMgrTest, AsyncReads) {
+  MemTracker mem_tracker(LARGE_MEM_LIMIT);
+  const char* tmp_file = "/tmp/disk_io_mgr_async_test.txt";
+  const int file_len = 100 * 1024;
+  string data;
+  for (int i = 0; i < file_len; ++i) data.push_back('a' + i % 26);
+  CreateTempFile(tmp_file, data.c_str());
+
+  struct stat stat_val;
+  stat(tmp_file, &stat_val);
+
+  FLAGS_use_async_local_reads = true;
+  for (int num_threads_per_disk = 1; num_threads_per_disk <= 3; ++num_threads_per_disk) {
+    pool_.reset(new ObjectPool);
+    DiskIoMgr io_mgr(1, num_threads_per_disk, 4 * 1024, 16 * 1024);
+    ASSERT_OK(io_mgr.Init(&mem_tracker));
+    MemTracker reader_mem_tracker;
+    DiskIoRequestContext* reader;
+    ASSERT_OK(io_mgr.RegisterContext(&reader, &reader_mem_tracker));
+
+    vector<DiskIoMgr::ScanRange*> ranges;
+    ranges.push_back(InitRange(2, tmp_file, 0, file_len, 0, stat_val.st_mtime));
+    ranges.push_back(InitRange(2, tmp_file, 1000, 50000, 0, stat_val.st_mtime));
+    ranges.push_back(InitRange(2, tmp_file, 4096, 10, 0, stat_val.st_mtime));
+    ranges.push_back(InitRange(2, tmp_file, file_len - 5000, 5000, 0,
+        stat_val.st_mtime));
+    ASSERT_OK(io_mgr.AddScanRanges(reader, ranges));
+
+    AtomicInt32 num_ranges_processed;
+    thread_group threads;
+    for (int i = 0; i < 2; ++i) {
+      threads.add_thread(new thread(ScanRangeThread, &io_mgr, reader, data.c_str(),
+          file_len, Status::OK(), 0, &num_ranges_processed));
+    }
+    threads.join_all();
+    EXPECT_EQ(num_ranges_processed.Load(), ranges.size());
+
+    // A synchronous read at an unaligned offset.
+    DiskIoMgr::ScanRange* range = InitRange(1, tmp_file, 12345, 6789, 0,
+        stat_val.st_mtime);
+    ValidateSyncRead(&io_mgr, reader, range, data.c_str() + 12345, 6789);
+
+    io_mgr.UnregisterContext(reader);
+    EXPECT_EQ(reader_mem_tracker.consumption(), 0);
+  }
+  FLAGS_use_async_local_reads = false;
+  EXPECT_EQ(mem_tracker.consumption(), 0);
+}
+
+// Reads small ranges that are scheduled immediately with coalescing enabled. Nearby
+// and overlapping ranges are read together and each range gets its own slice of the
+// data. Also cancels a context while coalesced reads are outstanding.
+TEST_F(DiskIoMgrTest, CoalescedReads) {
+  MemTracker mem_tracker(LARGE_MEM_LIMIT);
+  const char* tmp_file = "/tmp/disk_io_mgr_coalesce_test.txt";
+  const int file_len = 100 * 1024;
+  string data;
+  for (int i = 0; i < file_len; ++i) data.push_back('a' + i % 26);
+  CreateTempFile(tmp_file, data.c_str());
+
+  struct stat stat_val;
+  stat(tmp_file, &stat_val);
+
+  FLAGS_max_scan_range_coalesce_gap = 1000;
+  for (int cancel = 0; cancel < 2; ++cancel) {
+    pool_.reset(new ObjectPool);
+    DiskIoMgr io_mgr(1, 2, 1024, 16 * 1024);
+    ASSERT_OK(io_mgr.Init(&mem_tracker));
+    MemTracker reader_mem_tracker;
+    DiskIoRequestContext* reader;
+    ASSERT_OK(io_mgr.RegisterContext(&reader, &reader_mem_tracker));
+
+    vector<DiskIoMgr::ScanRange*> ranges;
+    ranges.push_back(InitRange(2, tmp_file, 200, 300, 0, stat_val.st_mtime));
+    ranges.push_back(InitRange(2, tmp_file, 100, 50, 0, stat_val.st_mtime));
+    ranges.push_back(InitRange(2, tmp_file, 120, 20, 0, stat_val.st_mtime));
+    ranges.push_back(InitRange(2, tmp_file, 1400, 10, 0, stat_val.st_mtime));
+    // Too far away from the others.
+    ranges.push_back(InitRange(2, tmp_file, 60000, 100, 0, stat_val.st_mtime));
+    // Would not fit into one buffer with the others.
+    ranges.push_back(InitRange(2, tmp_file, 2000, 15000, 0, stat_val.st_mtime));
+    // Ends past the end of the file.
+    ranges.push_back(InitRange(2, tmp_file, file_len - 10, 100, 0, stat_val.st_mtime));
+    ranges.push_back(InitRange(2, tmp_file, file_len - 200, 50, 0, stat_val.st_mtime));
+    ASSERT_OK(io_mgr.AddScanRanges(reader, ranges, true));
+
+    Status expected_status = Status::OK();
+    if (cancel) {
+      expected_status = Status::CANCELLED;
+      io_mgr.CancelContext(reader);
+    }
+    for (DiskIoMgr::ScanRange* range: ranges) {
+      ValidateScanRange(range, data.c_str(), file_len, expected_status);
+    }
+
+    io_mgr.UnregisterContext(reader);
+    EXPECT_EQ(reader_mem_tracker.consumption(), 0);
+  }
+  FLAGS_max_scan_range_coalesce_gap = -1;
+  EXPECT_EQ(mem_tracker.consumption(), 0);
+}
+
+// Tests parsing of the request pool weights and the per-pool accounting of reads.
+TEST_F(DiskIoMgrTest, RequestPoolWeights) {
+  MemTracker mem_tracker(LARGE_MEM_LIMIT);
+  const char* tmp_file = "/tmp/disk_io_mgr_test.txt";
+  const char* data = "the quick brown fox jumped over the lazy dog";
+  CreateTempFile(tmp_file, data);
+  struct stat stat_val;
+  stat(tmp_file, &stat_val);
+
+  const char* invalid_weights[] = { "root.a", "root.a:0", "root.a:x", "root.a:1,b:-2" };
+  for (const char* weights: invalid_weights) {
+    FLAGS_disk_io_pool_weights = weights;
+    DiskIoMgr io_mgr(1, 1, 1, 10);
+    EXPECT_FALSE(io_mgr.Init(&mem_tracker).ok()) << weights;
+  }
+
+  FLAGS_disk_io_pool_weights = "root.a:3,root.b:1";
+  pool_.reset(new ObjectPool);
+  {
+    DiskIoMgr io_mgr(1, 2, 1, 10);
+    ASSERT_OK(io_mgr.Init(&mem_tracker));
+    MemTracker reader_mem_tracker;
+    DiskIoRequestContext* readers[3];
+    const char* pools[] = { "root.a", "root.b", "root.c" };
+    for (int i = 0; i < 3; ++i) {
+      ASSERT_OK(io_mgr.RegisterContext(&readers[i], &reader_mem_tracker));
+      io_mgr.set_request_pool(readers[i], pools[i]);
+    }
+    // Interleave reads of all readers on the same disk.
+    vector<DiskIoMgr::ScanRange*> ranges[3];
+    for (int i = 0; i < 3; ++i) {
+      for (int j = 0; j < strlen(data); ++j) {
+        ranges[i].push_back(InitRange(1, tmp_file, j, 1, 0, stat_val.st_mtime));
+      }
+      ASSERT_OK(io_mgr.AddScanRanges(readers[i], ranges[i]));
+    }
+    thread_group threads;
+    AtomicInt32 num_ranges_processed;
+    for (int i = 0; i < 3; ++i) {
+      threads.add_thread(new thread(ScanRangeThread, &io_mgr, readers[i], data,
+          strlen(data), Status::OK(), 0, &num_ranges_processed));
+    }
+    threads.join_all();
+    EXPECT_EQ(num_ranges_processed.Load(), 3 * strlen(data));
+    for (int i = 0; i < 3; ++i) io_mgr.UnregisterContext(readers[i]);
+
+    string stats = io_mgr.PoolStatsDebugString();
+    EXPECT_NE(stats.find("root.a: weight=3 disk_time="), string::npos) << stats;
+    EXPECT_NE(stats.find("root.b: weight=1 disk_time="), string::npos) << stats;
+    EXPECT_NE(stats.find("root.c: weight=1 disk_time="), string::npos) << stats;
+    stringstream expected_reads;
+    expected_reads << " reads=" << strlen(data) << " ";
+    EXPECT_NE(stats.find(expected_reads.str()), string::npos) << stats;
+  }
+  FLAGS_disk_io_pool_weights = "";
+  EXPECT_EQ(mem_tracker.consumption(), 0);
+}
+
+// Reads a range with a preferred read size, which is rounded up to a buffer size class,
+// and a range without one, which is read with the maximum buffer size.
+TEST_F(DiskIoMgrTest, PreferredReadSize) {
+  MemTracker mem_tracker(LARGE_MEM_LIMIT);
+  const char* tmp_file = "/tmp/disk_io_mgr_read_size_test.txt";
+  const int file_len = 40 * 1024;
+  string data;
+  for (int i = 0; i < file_len; ++i) data.push_back('a' + i % 26);
+  CreateTempFile(tmp_file, data.c_str());
+
+  struct stat stat_val;
+  stat(tmp_file, &stat_val);
+
+  pool_.reset(new ObjectPool);
+  DiskIoMgr io_mgr(1, 1, 1024, 16 * 1024);
+  ASSERT_OK(io_mgr.Init(&mem_tracker));
+  MemTracker reader_mem_tracker;
+  DiskIoRequestContext* reader;
+  ASSERT_OK(io_mgr.RegisterContext(&reader, &reader_mem_tracker));
+
+  const int64_t read_sizes[] = { 3000, 0 };
+  const int64_t expected_buffer_lens[] = { 4 * 1024, 16 * 1024 };
+  for (int i = 0; i < 2; ++i) {
+    DiskIoMgr::ScanRange* range = InitRange(2, tmp_file, 0, file_len, 0,
+        stat_val.st_mtime);
+    range->set_preferred_read_size(read_sizes[i]);
+    vector<DiskIoMgr::ScanRange*> ranges(1, range);
+    ASSERT_OK(io_mgr.AddScanRanges(reader, ranges, true));
+    int64_t bytes_read = 0;
+    while (true) {
+      DiskIoMgr::BufferDescriptor* buffer;
+      ASSERT_OK(range->GetNext(&buffer));
+      ASSERT_TRUE(buffer != NULL);
+      EXPECT_EQ(buffer->len(), min(expected_buffer_lens[i], file_len - bytes_read));
+      EXPECT_EQ(memcmp(buffer->buffer(), data.c_str() + bytes_read, buffer->len()), 0);
+      bytes_read += buffer->len();
+      bool eosr = buffer->eosr();
+      buffer->Return();
+      if (eosr) break;
+    }
+    EXPECT_EQ(bytes_read, file_len);
+  }
+
+  io_mgr.UnregisterContext(reader);
+  EXPECT_EQ(reader_mem_tracker.consumption(), 0);
+  EXPECT_EQ(mem_tracker.consumption(), 0);
+}
+
 }
 
 int main(int argc, char **argv) {
@@ -15,16 +15,32 @@
 #include "runtime/disk-io-mgr.h"
 #include "runtime/disk-io-mgr-internal.h"
 
+#include <linux/mempolicy.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
 #include <boost/algorithm/string.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
 
 #include "gutil/bits.h"
 #include "gutil/strings/substitute.h"
+#include "runtime/data-cache.h"
+#include "runtime/hdfs-fs-cache.h"
+#include "util/cpu-info.h"
 #include "util/hdfs-util.h"
+#include "util/histogram-metric.h"
+#include "util/parse-util.h"
+#include "util/time.h"
 
 DECLARE_bool(disable_mem_pools);
 
 #include "common/names.h"
 
+using boost::algorithm::is_any_of;
+using boost::algorithm::split;
+using boost::algorithm::token_compress_on;
+using boost::get_system_time;
+using boost::system_time;
+namespace posix_time = boost::posix_time;
 using namespace impala;
 using namespace strings;
 
@@ -44,6 +60,34 @@ DEFINE_int32(num_remote_hdfs_io_threads, 8, "number of remote HDFS I/O threads")
 // open to S3 and use of multiple CPU cores since S3 reads are relatively compute
 // expensive (SSL and JNI buffer overheads).
 DEFINE_int32(num_s3_io_threads, 16, "number of S3 I/O threads");
+// Asynchronous reads let a few disk threads keep many reads in flight, which is needed
+// to saturate flash devices with deep queues. They bypass the OS page cache.
+DEFINE_bool(use_async_local_reads, false, "If true, reads of files on the local "
+    "filesystem are submitted with Linux native AIO and O_DIRECT, so that each disk "
+    "can have up to --async_read_queue_depth reads in flight. Reads through HDFS are "
+    "not affected.");
+DEFINE_int32(async_read_queue_depth, 32, "The maximum number of asynchronous reads "
+    "in flight per local disk. Only used if --use_async_local_reads is true.");
+// Remote reads are slow and expensive. Caching the data that is read from remote files on
+// local SSDs lets repeated scans of the same files avoid the network.
+DEFINE_string(data_cache_dirs, "", "Comma-separated list of local directories, "
+    "ideally on SSDs, that cache the data read from remote files (S3 and remote HDFS). "
+    "The contents of the directories are removed on startup. If empty, data is not "
+    "cached.");
+DEFINE_string(data_cache_size, "10GB", "The maximum amount of data cached in each of "
+    "the --data_cache_dirs directories, e.g. '500MB' or '10GB'.");
+// Without weights, a single large scan can take most of the disk bandwidth while the
+// interactive queries of other pools wait.
+DEFINE_string(disk_io_pool_weights, "", "Comma-separated list of <request pool>:<weight> "
+    "pairs, e.g. 'root.interactive:4,root.etl:1'. When several request pools have reads "
+    "queued on a disk, each gets disk bandwidth in proportion to its weight. Pools that "
+    "are not listed have weight 1.");
+// Columnar formats issue one range per column chunk. Each of them costs a seek on local
+// disks and a request on remote filesystems, which dominates for narrow column chunks.
+DEFINE_int32(max_scan_range_coalesce_gap, -1, "If non-negative, scan ranges of the same "
+    "file that are scheduled together and are at most this many bytes apart are read "
+    "with a single request, as long as they fit into one io buffer. The bytes in the "
+    "gaps are read and discarded. If -1, scan ranges are not coalesced.");
 // The read size is the size of the reads sent to hdfs/os.
 // There is a trade off of latency and throughout, trying to keep disks busy but
 // not introduce seeks.  The literature seems to agree that with 8 MB reads, random
@@ -55,6 +99,15 @@ DEFINE_int32(min_buffer_size, 1024, "The minimum read buffer size (in bytes)");
 DEFINE_int32(max_free_io_buffers, 128,
     "For each io buffer size, the maximum number of buffers the IoMgr will hold onto");
 
+// Buffers that were needed for a burst of scans should not stay allocated forever.
+DEFINE_int32(io_buffer_idle_timeout_ms, 60000, "(Advanced) Unused io buffers are freed "
+    "after this many milliseconds. If <= 0, unused io buffers are only freed when the "
+    "process memory limit is hit.");
+
+// Huge pages reduce the TLB misses when scanning large buffers.
+DEFINE_bool(io_buffer_huge_pages, false, "(Advanced) If true, io buffers of at least "
+    "2MB are backed by transparent huge pages if the kernel supports them.");
+
 // The number of cached file handles defines how much memory can be used per backend for
 // caching frequently used file handles. Currently, we assume that approximately 2kB data
 // are associated with a single file handle. 10k file handles will thus reserve ~20MB
@@ -63,6 +116,9 @@ DEFINE_int32(max_free_io_buffers, 128,
 DEFINE_uint64(max_cached_file_handles, 0, "Maximum number of HDFS file handles "
     "that will be cached. Disabled if set to 0.");
 
+// The size of transparent huge pages on x86_64.
+static const int64_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
 // Rotational disks should have 1 thread per disk to minimize seeks.  Non-rotational
 // don't have this penalty and benefit from multiple concurrent IO requests.
 static const int THREADS_PER_ROTATIONAL_DISK = 1;
@@ -73,6 +129,13 @@ static const int THREADS_PER_FLASH_DISK = 8;
 // current queue size.
 static const int LOW_MEMORY = 64 * 1024 * 1024;
 
+// Key format of the read latency histograms of the disk queues and request pools. Reads
+// that take longer than a minute are tracked as taking a minute.
+static const char* READ_LATENCY_METRIC_KEY_FORMAT =
+    "impala-server.io-mgr.$0.read-latency";
+static const int64_t MAX_READ_LATENCY_NS = 60L * 1000L * 1000L * 1000L;
+static const int READ_LATENCY_SIGNIFICANT_DIGITS = 2;
+
 const int DiskIoMgr::DEFAULT_QUEUE_CAPACITY = 2;
 
 namespace detail {
@@ -82,13 +145,6 @@ static inline bool is_file_handle_caching_enabled() {
 }
 }
 
-/// This method is used to clean up resources upon eviction of a cache file handle.
-void DiskIoMgr::HdfsCachedFileHandle::Release(DiskIoMgr::HdfsCachedFileHandle** h) {
-  ImpaladMetrics::IO_MGR_NUM_CACHED_FILE_HANDLES->Increment(-1L);
-  VLOG_FILE << "Cached file handle evicted, hdfsCloseFile() fid=" << (*h)->hdfs_file_;
-  delete (*h);
-}
-
 DiskIoMgr::HdfsCachedFileHandle::HdfsCachedFileHandle(const hdfsFS& fs, const char* fname,
     int64_t mtime)
     : fs_(fs), hdfs_file_(hdfsOpenFile(fs, fname, O_RDONLY, 0, 0, 0)), mtime_(mtime) {
@@ -204,7 +260,7 @@ string DiskIoMgr::DebugString() {
 }
 
 DiskIoMgr::BufferDescriptor::BufferDescriptor(DiskIoMgr* io_mgr) :
-  io_mgr_(io_mgr), reader_(NULL), buffer_(NULL) {
+  io_mgr_(io_mgr), reader_(NULL), buffer_(NULL), parent_(NULL) {
 }
 
 void DiskIoMgr::BufferDescriptor::Reset(DiskIoRequestContext* reader,
@@ -222,6 +278,7 @@ void DiskIoMgr::BufferDescriptor::Reset(DiskIoRequestContext* reader,
   eosr_ = false;
   status_ = Status::OK();
   mem_tracker_ = NULL;
+  parent_ = NULL;
 }
 
 void DiskIoMgr::BufferDescriptor::Return() {
@@ -230,8 +287,8 @@ void DiskIoMgr::BufferDescriptor::Return() {
 }
 
 void DiskIoMgr::BufferDescriptor::SetMemTracker(MemTracker* tracker) {
-  // Cached buffers don't count towards mem usage.
-  if (scan_range_->cached_buffer_ != NULL) return;
+  // Cached buffers and slices don't count towards mem usage.
+  if (scan_range_->cached_buffer_ != NULL || parent_ != NULL) return;
   if (mem_tracker_ == tracker) return;
   if (mem_tracker_ != NULL) mem_tracker_->Release(buffer_len_);
   mem_tracker_ = tracker;
@@ -252,6 +309,13 @@ void DiskIoMgr::WriteRange::SetData(const uint8_t* buffer, int64_t len) {
   len_ = len;
 }
 
+void DiskIoMgr::WriteRange::SetRange(const string& file, int64_t file_offset,
+    int disk_id) {
+  file_ = file;
+  offset_ = file_offset;
+  disk_id_ = disk_id;
+}
+
 static void CheckSseSupport() {
   if (!CpuInfo::IsSupported(CpuInfo::SSE4_2)) {
     LOG(WARNING) << "This machine does not support sse4_2.  The default IO system "
@@ -265,15 +329,17 @@ DiskIoMgr::DiskIoMgr() :
     num_threads_per_disk_(FLAGS_num_threads_per_disk),
     max_buffer_size_(FLAGS_read_size),
     min_buffer_size_(FLAGS_min_buffer_size),
+    metrics_(NULL),
     cached_read_options_(NULL),
     shut_down_(false),
     total_bytes_read_counter_(TUnit::BYTES),
     read_timer_(TUnit::TIME_NS),
-    file_handle_cache_(min(FLAGS_max_cached_file_handles,
-        FileSystemUtil::MaxNumFileHandles()),
-        &HdfsCachedFileHandle::Release) {
-  int64_t max_buffer_size_scaled = BitUtil::Ceil(max_buffer_size_, min_buffer_size_);
-  free_buffers_.resize(Bits::Log2Ceiling64(max_buffer_size_scaled) + 1);
+    buffer_gc_thread_active_(false) {
+  InitArenas();
+  if (detail::is_file_handle_caching_enabled()) {
+    file_handle_cache_.reset(new FileHandleCache(min(FLAGS_max_cached_file_handles,
+        FileSystemUtil::MaxNumFileHandles())));
+  }
   int num_local_disks = FLAGS_num_disks == 0 ? DiskInfo::num_disks() : FLAGS_num_disks;
   disk_queues_.resize(num_local_disks + REMOTE_NUM_DISKS);
   CheckSseSupport();
@@ -284,19 +350,39 @@ DiskIoMgr::DiskIoMgr(int num_local_disks, int threads_per_disk, int min_buffer_s
     num_threads_per_disk_(threads_per_disk),
     max_buffer_size_(max_buffer_size),
     min_buffer_size_(min_buffer_size),
+    metrics_(NULL),
     cached_read_options_(NULL),
     shut_down_(false),
     total_bytes_read_counter_(TUnit::BYTES),
     read_timer_(TUnit::TIME_NS),
-    file_handle_cache_(min(FLAGS_max_cached_file_handles,
-            FileSystemUtil::MaxNumFileHandles()), &HdfsCachedFileHandle::Release) {
-  int64_t max_buffer_size_scaled = BitUtil::Ceil(max_buffer_size_, min_buffer_size_);
-  free_buffers_.resize(Bits::Log2Ceiling64(max_buffer_size_scaled) + 1);
+    buffer_gc_thread_active_(false) {
+  InitArenas();
+  if (detail::is_file_handle_caching_enabled()) {
+    file_handle_cache_.reset(new FileHandleCache(min(FLAGS_max_cached_file_handles,
+        FileSystemUtil::MaxNumFileHandles())));
+  }
   if (num_local_disks == 0) num_local_disks = DiskInfo::num_disks();
   disk_queues_.resize(num_local_disks + REMOTE_NUM_DISKS);
   CheckSseSupport();
 }
 
+void DiskIoMgr::InitArenas() {
+  int64_t max_buffer_size_scaled = BitUtil::Ceil(max_buffer_size_, min_buffer_size_);
+  int num_buffer_sizes = Bits::Log2Ceiling64(max_buffer_size_scaled) + 1;
+  num_arenas_ = CpuInfo::num_cores();
+  arenas_.reset(new FreeBufferArena[num_arenas_]);
+  numa_node_arenas_.resize(CpuInfo::num_numa_nodes());
+  for (int i = 0; i < num_arenas_; ++i) {
+    arenas_[i].free_buffers.resize(num_buffer_sizes);
+    numa_node_arenas_[CpuInfo::GetNumaNodeOfCore(i)].push_back(i);
+  }
+  // With --num_cores, there may be nodes without arenas. Their buffers share an arena.
+  for (int node = 0; node < numa_node_arenas_.size(); ++node) {
+    if (numa_node_arenas_[node].empty()) numa_node_arenas_[node].push_back(0);
+  }
+  num_free_buffers_.reset(new AtomicInt32[num_buffer_sizes]);
+}
+
 DiskIoMgr::~DiskIoMgr() {
   shut_down_ = true;
   // Notify all worker threads and shut them down.
@@ -312,6 +398,15 @@ DiskIoMgr::~DiskIoMgr() {
   }
   disk_thread_group_.JoinAll();
 
+  if (buffer_gc_thread_.get() != NULL) {
+    {
+      lock_guard<mutex> l(buffer_gc_thread_lock_);
+      buffer_gc_thread_active_ = false;
+    }
+    buffer_gc_thread_cv_.notify_all();
+    buffer_gc_thread_->Join();
+  }
+
   for (int i = 0; i < disk_queues_.size(); ++i) {
     if (disk_queues_[i] == NULL) continue;
     int disk_id = disk_queues_[i]->disk_id;
@@ -330,8 +425,8 @@ DiskIoMgr::~DiskIoMgr() {
 
   // Delete all allocated buffers
   int num_free_buffers = 0;
-  for (int idx = 0; idx < free_buffers_.size(); ++idx) {
-    num_free_buffers += free_buffers_[idx].size();
+  for (int idx = 0; idx < arenas_[0].free_buffers.size(); ++idx) {
+    num_free_buffers += num_free_buffers_[idx].Load();
   }
   DCHECK_EQ(num_allocated_buffers_.Load(), num_free_buffers);
   GcIoBuffers();
@@ -349,6 +444,11 @@ Status DiskIoMgr::Init(MemTracker* process_mem_tracker) {
   // If we hit the process limit, see if we can reclaim some memory by removing
   // previously allocated (but unused) io buffers.
   process_mem_tracker->AddGcFunction(bind(&DiskIoMgr::GcIoBuffers, this));
+  if (FLAGS_io_buffer_idle_timeout_ms > 0) {
+    buffer_gc_thread_active_ = true;
+    buffer_gc_thread_.reset(new Thread("disk-io-mgr", "buffer-gc",
+        &DiskIoMgr::BufferGcLoop, this));
+  }
 
   for (int i = 0; i < disk_queues_.size(); ++i) {
     disk_queues_[i] = new DiskQueue(i);
@@ -370,9 +470,46 @@ Status DiskIoMgr::Init(MemTracker* process_mem_tracker) {
       disk_thread_group_.AddThread(new Thread("disk-io-mgr", ss.str(),
           &DiskIoMgr::WorkLoop, this, disk_queues_[i]));
     }
+    if (FLAGS_use_async_local_reads && i < num_local_disks()) {
+      AsyncReader* async_reader =
+          new AsyncReader(this, disk_queues_[i], FLAGS_async_read_queue_depth);
+      Status status = async_reader->Init();
+      if (!status.ok()) {
+        LOG(WARNING) << "Disabling asynchronous reads for disk " << i << ": "
+                     << status.GetDetail();
+        delete async_reader;
+        continue;
+      }
+      disk_queues_[i]->async_reader.reset(async_reader);
+      stringstream ss;
+      ss << "async-read-completion(Disk: " << i << ")";
+      disk_thread_group_.AddThread(new Thread("disk-io-mgr", ss.str(),
+          &AsyncReader::CompletionLoop, async_reader));
+    }
   }
   request_context_cache_.reset(new RequestContextCache(this));
 
+  string invalid_weight;
+  if (!ParseUtil::ParsePoolWeights(FLAGS_disk_io_pool_weights, &pool_weights_,
+      &invalid_weight)) {
+    return Status(Substitute("Invalid request pool weight in --disk_io_pool_weights: "
+        "'$0'", invalid_weight));
+  }
+
+  if (!FLAGS_data_cache_dirs.empty()) {
+    vector<string> dirs;
+    split(dirs, FLAGS_data_cache_dirs, is_any_of(","), token_compress_on);
+    bool is_percent;
+    int64_t capacity = ParseUtil::ParseMemSpec(FLAGS_data_cache_size, &is_percent, 0);
+    if (capacity <= 0 || is_percent) {
+      return Status(Substitute("Invalid data cache size: '$0'", FLAGS_data_cache_size));
+    }
+    data_cache_.reset(new DataCache(dirs, capacity));
+    RETURN_IF_ERROR(data_cache_->Init());
+    LOG(INFO) << "Caching remote data in " << FLAGS_data_cache_dirs << " with "
+              << PrettyPrinter::Print(capacity, TUnit::BYTES) << " per directory";
+  }
+
   cached_read_options_ = hadoopRzOptionsAlloc();
   DCHECK(cached_read_options_ != NULL);
   // Disable checksumming for cached reads.
@@ -456,6 +593,68 @@ void DiskIoMgr::set_disks_access_bitmap(DiskIoRequestContext* r,
   r->disks_accessed_bitmap_ = c;
 }
 
+void DiskIoMgr::set_request_pool(DiskIoRequestContext* r, const string& pool) {
+  r->weight_ = GetPoolWeight(pool);
+  lock_guard<mutex> l(pool_stats_lock_);
+  PoolStats* stats = &pool_stats_[pool];
+  if (metrics_ != NULL && stats->read_latency == NULL) {
+    stats->read_latency = CreateReadLatencyMetric("pool." + pool);
+  }
+  r->pool_stats_ = stats;
+}
+
+HistogramMetric* DiskIoMgr::CreateReadLatencyMetric(const string& name) {
+  DCHECK(metrics_ != NULL);
+  return metrics_->RegisterMetric(new HistogramMetric(MakeTMetricDef(
+      Substitute(READ_LATENCY_METRIC_KEY_FORMAT, name), TMetricKind::HISTOGRAM,
+      TUnit::TIME_NS), MAX_READ_LATENCY_NS, READ_LATENCY_SIGNIFICANT_DIGITS));
+}
+
+void DiskIoMgr::InitMetrics(MetricGroup* metrics) {
+  DCHECK(metrics != NULL);
+  DCHECK(metrics_ == NULL);
+  metrics_ = metrics;
+  for (DiskQueue* disk_queue: disk_queues_) {
+    string name;
+    if (disk_queue->disk_id == RemoteDfsDiskId()) {
+      name = "remote-dfs";
+    } else if (disk_queue->disk_id == RemoteS3DiskId()) {
+      name = "remote-s3";
+    } else {
+      name = Substitute("disk-$0", disk_queue->disk_id);
+    }
+    disk_queue->read_latency = CreateReadLatencyMetric(name);
+  }
+  lock_guard<mutex> l(pool_stats_lock_);
+  for (map<string, PoolStats>::value_type& entry: pool_stats_) {
+    entry.second.read_latency = CreateReadLatencyMetric("pool." + entry.first);
+  }
+}
+
+void DiskIoMgr::set_numa_node(DiskIoRequestContext* r, int numa_node) {
+  DCHECK_LT(numa_node, CpuInfo::num_numa_nodes());
+  r->numa_node_ = numa_node;
+}
+
+int DiskIoMgr::GetPoolWeight(const string& pool) const {
+  map<string, int>::const_iterator it = pool_weights_.find(pool);
+  return it == pool_weights_.end() ? 1 : it->second;
+}
+
+string DiskIoMgr::PoolStatsDebugString() {
+  stringstream ss;
+  lock_guard<mutex> l(pool_stats_lock_);
+  for (const map<string, PoolStats>::value_type& entry: pool_stats_) {
+    const PoolStats& stats = entry.second;
+    ss << entry.first << ": weight=" << GetPoolWeight(entry.first)
+       << " disk_time=" << PrettyPrinter::Print(stats.disk_time_ns.Load(), TUnit::TIME_NS)
+       << " reads=" << stats.num_reads.Load()
+       << " bytes_read=" << PrettyPrinter::Print(stats.bytes_read.Load(), TUnit::BYTES)
+       << endl;
+  }
+  return ss.str();
+}
+
 int64_t DiskIoMgr::queue_size(DiskIoRequestContext* reader) const {
   return reader->num_ready_buffers_.Load();
 }
@@ -485,6 +684,22 @@ int64_t DiskIoMgr::unexpected_remote_bytes(DiskIoRequestContext* reader) const {
   return reader->unexpected_remote_bytes_.Load();
 }
 
+int64_t DiskIoMgr::data_cache_hit_count(DiskIoRequestContext* reader) const {
+  return reader->data_cache_hit_count_.Load();
+}
+
+int64_t DiskIoMgr::data_cache_miss_count(DiskIoRequestContext* reader) const {
+  return reader->data_cache_miss_count_.Load();
+}
+
+int64_t DiskIoMgr::data_cache_hit_bytes(DiskIoRequestContext* reader) const {
+  return reader->data_cache_hit_bytes_.Load();
+}
+
+int64_t DiskIoMgr::num_slow_remote_reads(DiskIoRequestContext* reader) const {
+  return reader->num_slow_remote_reads_.Load();
+}
+
 int64_t DiskIoMgr::GetReadThroughput() {
   return RuntimeProfile::UnitsPerSecond(&total_bytes_read_counter_, &read_timer_);
 }
@@ -519,11 +734,18 @@ Status DiskIoMgr::AddScanRanges(DiskIoRequestContext* reader,
     return reader->status_;
   }
 
+  vector<ScanRange*> read_ranges;
+  if (schedule_immediately && FLAGS_max_scan_range_coalesce_gap >= 0) {
+    CoalesceScanRanges(reader, ranges, &read_ranges);
+  } else {
+    read_ranges = ranges;
+  }
+
   // Add each range to the queue of the disk the range is on
-  for (int i = 0; i < ranges.size(); ++i) {
+  for (int i = 0; i < read_ranges.size(); ++i) {
     // Don't add empty ranges.
-    DCHECK_NE(ranges[i]->len(), 0);
-    ScanRange* range = ranges[i];
+    DCHECK_NE(read_ranges[i]->len(), 0);
+    ScanRange* range = read_ranges[i];
 
     if (range->try_cache_) {
       if (schedule_immediately) {
@@ -543,6 +765,86 @@ Status DiskIoMgr::AddScanRanges(DiskIoRequestContext* reader,
   return Status::OK();
 }
 
+// Orders scan ranges by file and offset so that the ranges that can be coalesced are
+// next to each other.
+static bool ScanRangeLt(const DiskIoMgr::ScanRange* a, const DiskIoMgr::ScanRange* b) {
+  int cmp = strcmp(a->file(), b->file());
+  if (cmp != 0) return cmp < 0;
+  return a->offset() < b->offset();
+}
+
+void DiskIoMgr::CoalesceScanRanges(DiskIoRequestContext* reader,
+    const vector<ScanRange*>& ranges, vector<ScanRange*>* read_ranges) {
+  vector<ScanRange*> candidates;
+  for (ScanRange* range: ranges) {
+    // Ranges that are expected to be cached are read without copies. Ranges that need
+    // more than one buffer are large enough to be read on their own.
+    if (range->try_cache_ || range->len_ >= max_buffer_size_) {
+      read_ranges->push_back(range);
+    } else {
+      candidates.push_back(range);
+    }
+  }
+  sort(candidates.begin(), candidates.end(), ScanRangeLt);
+
+  int group_start = 0;
+  while (group_start < candidates.size()) {
+    ScanRange* first = candidates[group_start];
+    int64_t extent_end = first->offset_ + first->len_;
+    bool expected_local = first->expected_local_;
+    int group_end = group_start + 1;
+    for (; group_end < candidates.size(); ++group_end) {
+      ScanRange* range = candidates[group_end];
+      int64_t range_end = range->offset_ + range->len_;
+      if (range->fs_ != first->fs_ || range->file_ != first->file_ ||
+          range->disk_id_ != first->disk_id_ || range->mtime_ != first->mtime_ ||
+          range->offset_ - extent_end > FLAGS_max_scan_range_coalesce_gap ||
+          max(extent_end, range_end) - first->offset_ > max_buffer_size_) {
+        break;
+      }
+      extent_end = max(extent_end, range_end);
+      expected_local &= range->expected_local_;
+    }
+
+    if (group_end - group_start == 1) {
+      read_ranges->push_back(first);
+    } else {
+      ScanRange* read_range = reader->coalesced_ranges_pool_.Add(new ScanRange());
+      read_range->Reset(first->fs_, first->file(), extent_end - first->offset_,
+          first->offset_, first->disk_id_, false, expected_local, first->mtime_);
+      read_range->InitInternal(this, reader);
+      read_range->coalesced_ranges_.assign(
+          candidates.begin() + group_start, candidates.begin() + group_end);
+      read_ranges->push_back(read_range);
+    }
+    group_start = group_end;
+  }
+}
+
+void DiskIoMgr::EnqueueSlices(DiskIoRequestContext* reader, BufferDescriptor* buffer) {
+  ScanRange* read_range = buffer->scan_range_;
+  const vector<ScanRange*>& ranges = read_range->coalesced_ranges_;
+  DCHECK(buffer->eosr_);
+  // Set the count before enqueueing: slices for cancelled ranges are returned
+  // immediately.
+  buffer->num_slices_.Store(ranges.size());
+  // The slices take the place of 'buffer' in the used buffers.
+  reader->num_used_buffers_.Add(ranges.size() - 1);
+  for (ScanRange* range: ranges) {
+    int64_t slice_offset = range->offset_ - read_range->offset_;
+    // The read is short if the file ended early.
+    int64_t slice_len = max<int64_t>(0, min(range->len_, buffer->len_ - slice_offset));
+    BufferDescriptor* slice =
+        GetBufferDesc(reader, range, buffer->buffer_ + slice_offset, 0);
+    slice->parent_ = buffer;
+    slice->len_ = slice_len;
+    slice->scan_range_offset_ = 0;
+    slice->eosr_ = true;
+    range->bytes_read_ = slice_len;
+    range->EnqueueBuffer(slice);
+  }
+}
+
 // This function returns the next scan range the reader should work on, checking
 // for eos and error cases. If there isn't already a cached scan range or a scan
 // range prepared by the disk threads, the caller waits on the disk threads.
@@ -610,6 +912,8 @@ Status DiskIoMgr::Read(DiskIoRequestContext* reader,
     return Status(Substitute("Cannot perform sync read larger than $0. Request was $1",
                              max_buffer_size_, range->len()));
   }
+  // A synchronous read returns the whole range in one buffer.
+  range->set_preferred_read_size(0);
 
   vector<DiskIoMgr::ScanRange*> ranges;
   ranges.push_back(range);
@@ -625,8 +929,9 @@ void DiskIoMgr::ReturnBuffer(BufferDescriptor* buffer_desc) {
   if (!buffer_desc->status_.ok()) DCHECK(buffer_desc->buffer_ == NULL);
 
   DiskIoRequestContext* reader = buffer_desc->reader_;
+  BufferDescriptor* parent = buffer_desc->parent_;
   if (buffer_desc->buffer_ != NULL) {
-    if (buffer_desc->scan_range_->cached_buffer_ == NULL) {
+    if (parent == NULL && buffer_desc->scan_range_->cached_buffer_ == NULL) {
       // Not a cached buffer. Return the io buffer and update mem tracking.
       ReturnFreeBuffer(buffer_desc);
     }
@@ -645,6 +950,13 @@ void DiskIoMgr::ReturnBuffer(BufferDescriptor* buffer_desc) {
     buffer_desc->scan_range_->Close();
   }
   ReturnBufferDesc(buffer_desc);
+
+  // The buffer of a coalesced read is owned by the IoMgr until its last slice is
+  // returned.
+  if (parent != NULL && parent->num_slices_.Add(-1) == 0) {
+    ReturnFreeBuffer(parent);
+    ReturnBufferDesc(parent);
+  }
 }
 
 void DiskIoMgr::ReturnBufferDesc(BufferDescriptor* desc) {
@@ -672,7 +984,7 @@ DiskIoMgr::BufferDescriptor* DiskIoMgr::GetBufferDesc(
   return buffer_desc;
 }
 
-char* DiskIoMgr::GetFreeBuffer(int64_t* buffer_size) {
+char* DiskIoMgr::GetFreeBuffer(int64_t* buffer_size, int numa_node) {
   DCHECK_LE(*buffer_size, max_buffer_size_);
   DCHECK_GT(*buffer_size, 0);
   *buffer_size = min(static_cast<int64_t>(max_buffer_size_), *buffer_size);
@@ -681,9 +993,14 @@ char* DiskIoMgr::GetFreeBuffer(int64_t* buffer_size) {
   // convert to bytes
   *buffer_size = (1 << idx) * min_buffer_size_;
 
-  unique_lock<mutex> lock(free_buffers_lock_);
-  char* buffer = NULL;
-  if (free_buffers_[idx].empty()) {
+  int core = CpuInfo::GetCurrentCore();
+  if (numa_node != -1 && CpuInfo::GetNumaNodeOfCore(core) != numa_node) {
+    // Spread the buffers over the arenas of the node.
+    const vector<int>& cores = CpuInfo::GetCoresOfNumaNode(numa_node);
+    if (!cores.empty()) core = cores[core % cores.size()];
+  }
+  char* buffer = TakeFreeBuffer(core, idx);
+  if (buffer == NULL) {
     num_allocated_buffers_.Add(1);
     if (ImpaladMetrics::IO_MGR_NUM_BUFFERS != NULL) {
       ImpaladMetrics::IO_MGR_NUM_BUFFERS->Increment(1L);
@@ -694,44 +1011,148 @@ char* DiskIoMgr::GetFreeBuffer(int64_t* buffer_size) {
     // Update the process mem usage.  This is checked the next time we start
     // a read for the next reader (DiskIoMgr::GetNextScanRange)
     process_mem_tracker_->Consume(*buffer_size);
-    buffer = new char[*buffer_size];
+    buffer = AllocateBuffer(*buffer_size, core);
   } else {
     if (ImpaladMetrics::IO_MGR_NUM_UNUSED_BUFFERS != NULL) {
       ImpaladMetrics::IO_MGR_NUM_UNUSED_BUFFERS->Increment(-1L);
     }
-    buffer = free_buffers_[idx].front();
-    free_buffers_[idx].pop_front();
   }
   DCHECK(buffer != NULL);
   return buffer;
 }
 
-void DiskIoMgr::GcIoBuffers() {
-  unique_lock<mutex> lock(free_buffers_lock_);
-  int buffers_freed = 0;
-  int bytes_freed = 0;
-  for (int idx = 0; idx < free_buffers_.size(); ++idx) {
-    for (list<char*>::iterator iter = free_buffers_[idx].begin();
-         iter != free_buffers_[idx].end(); ++iter) {
-      int64_t buffer_size = (1 << idx) * min_buffer_size_;
-      process_mem_tracker_->Release(buffer_size);
-      num_allocated_buffers_.Add(-1);
-      delete[] *iter;
-
-      ++buffers_freed;
-      bytes_freed += buffer_size;
+char* DiskIoMgr::TakeFreeBuffer(int core, int idx) {
+  if (num_free_buffers_[idx].Load() == 0) return NULL;
+  int core_arena = GetArenaForCore(core);
+  const vector<int>& node_arenas =
+      numa_node_arenas_[CpuInfo::GetNumaNodeOfCore(core_arena)];
+  // Try the arena of the core first, then the other arenas on its NUMA node. Buffers
+  // on other nodes are not used: a new local buffer is cheaper to read into.
+  for (int i = -1; i < static_cast<int>(node_arenas.size()); ++i) {
+    int arena_idx = i == -1 ? core_arena : node_arenas[i];
+    if (i != -1 && arena_idx == core_arena) continue;
+    FreeBufferArena* arena = &arenas_[arena_idx];
+    lock_guard<SpinLock> l(arena->lock);
+    deque<FreeBuffer>* free_buffers = &arena->free_buffers[idx];
+    if (free_buffers->empty()) continue;
+    char* buffer = free_buffers->back().buffer;
+    free_buffers->pop_back();
+    num_free_buffers_[idx].Add(-1);
+    return buffer;
+  }
+  return NULL;
+}
+
+char* DiskIoMgr::AllocateBuffer(int64_t buffer_size, int core) {
+  // Buffers that can hold an O_DIRECT read are aligned for it, which also makes them
+  // page-aligned. Huge pages can only back memory that is aligned to their size.
+  bool use_huge_pages = FLAGS_io_buffer_huge_pages && buffer_size >= HUGE_PAGE_SIZE;
+  int64_t alignment = sizeof(void*);
+  if (use_huge_pages) {
+    alignment = HUGE_PAGE_SIZE;
+  } else if (buffer_size >= AsyncReader::DIRECT_IO_ALIGNMENT) {
+    alignment = AsyncReader::DIRECT_IO_ALIGNMENT;
+  }
+  char* buffer = NULL;
+  int ret = posix_memalign(reinterpret_cast<void**>(&buffer), alignment, buffer_size);
+  CHECK_EQ(ret, 0) << "Failed to allocate io buffer of " << buffer_size << " bytes";
+
+  if (use_huge_pages && madvise(buffer, buffer_size, MADV_HUGEPAGE) != 0) {
+    VLOG_FILE << "madvise(MADV_HUGEPAGE) failed for io buffer: " << GetStrErrMsg();
+  }
+  if (numa_node_arenas_.size() > 1 && buffer_size >= AsyncReader::DIRECT_IO_ALIGNMENT) {
+    // Prefer the node of 'core'. The memory may have been used before, so pages that
+    // are already mapped are moved.
+    int node = CpuInfo::GetNumaNodeOfCore(core);
+    const int max_node = sizeof(unsigned long) * 8;
+    unsigned long nodemask = node < max_node ? 1UL << node : 0;
+    if (nodemask != 0 && syscall(SYS_mbind, buffer, buffer_size, MPOL_PREFERRED,
+        &nodemask, max_node, MPOL_MF_MOVE) != 0) {
+      VLOG_FILE << "mbind() failed for io buffer on node " << node << ": "
+                << GetStrErrMsg();
     }
-    free_buffers_[idx].clear();
   }
+  return buffer;
+}
+
+int DiskIoMgr::GetArenaForCore(int core) {
+  if (core < num_arenas_) return core;
+  // With --num_cores, the thread may run on a core without an arena.
+  const vector<int>& node_arenas = numa_node_arenas_[CpuInfo::GetNumaNodeOfCore(core)];
+  return node_arenas[core % node_arenas.size()];
+}
+
+int DiskIoMgr::GetArenaForBuffer(char* buffer, int64_t buffer_size, int core) {
+  int core_arena = GetArenaForCore(core);
+  // Small buffers are not page-aligned and share their pages with other allocations.
+  if (numa_node_arenas_.size() == 1 || buffer_size < AsyncReader::DIRECT_IO_ALIGNMENT) {
+    return core_arena;
+  }
+  int node = -1;
+  if (syscall(SYS_get_mempolicy, &node, NULL, 0, buffer,
+      MPOL_F_NODE | MPOL_F_ADDR) != 0 || node < 0 || node >= numa_node_arenas_.size() ||
+      node == CpuInfo::GetNumaNodeOfCore(core_arena)) {
+    return core_arena;
+  }
+  const vector<int>& node_arenas = numa_node_arenas_[node];
+  return node_arenas[core % node_arenas.size()];
+}
 
+void DiskIoMgr::FreeBufferMemory(char* buffer, int64_t buffer_size) {
+  process_mem_tracker_->Release(buffer_size);
+  num_allocated_buffers_.Add(-1);
+  free(buffer);
   if (ImpaladMetrics::IO_MGR_NUM_BUFFERS != NULL) {
-    ImpaladMetrics::IO_MGR_NUM_BUFFERS->Increment(-buffers_freed);
+    ImpaladMetrics::IO_MGR_NUM_BUFFERS->Increment(-1L);
   }
   if (ImpaladMetrics::IO_MGR_TOTAL_BYTES != NULL) {
-    ImpaladMetrics::IO_MGR_TOTAL_BYTES->Increment(-bytes_freed);
+    ImpaladMetrics::IO_MGR_TOTAL_BYTES->Increment(-buffer_size);
+  }
+}
+
+void DiskIoMgr::GcIoBuffers() {
+  FreeIdleBuffers(0);
+}
+
+void DiskIoMgr::FreeIdleBuffers(int64_t idle_ms) {
+  int64_t cutoff_ms = MonotonicMillis() - idle_ms;
+  // The buffers are freed after releasing the arena locks.
+  vector<pair<char*, int64_t> > buffers;
+  for (int i = 0; i < num_arenas_; ++i) {
+    FreeBufferArena* arena = &arenas_[i];
+    lock_guard<SpinLock> l(arena->lock);
+    for (int idx = 0; idx < arena->free_buffers.size(); ++idx) {
+      deque<FreeBuffer>* free_buffers = &arena->free_buffers[idx];
+      while (!free_buffers->empty() &&
+          free_buffers->front().return_time_ms <= cutoff_ms) {
+        buffers.push_back(make_pair(free_buffers->front().buffer,
+            static_cast<int64_t>(1 << idx) * min_buffer_size_));
+        free_buffers->pop_front();
+        num_free_buffers_[idx].Add(-1);
+      }
+    }
+  }
+
+  for (int i = 0; i < buffers.size(); ++i) {
+    FreeBufferMemory(buffers[i].first, buffers[i].second);
   }
   if (ImpaladMetrics::IO_MGR_NUM_UNUSED_BUFFERS != NULL) {
-    ImpaladMetrics::IO_MGR_NUM_UNUSED_BUFFERS->set_value(0);
+    ImpaladMetrics::IO_MGR_NUM_UNUSED_BUFFERS->Increment(
+        -static_cast<int64_t>(buffers.size()));
+  }
+}
+
+void DiskIoMgr::BufferGcLoop() {
+  unique_lock<mutex> l(buffer_gc_thread_lock_);
+  while (buffer_gc_thread_active_) {
+    // Buffers are freed at most half a timeout after they became idle.
+    system_time timeout = get_system_time() +
+        posix_time::milliseconds(max(FLAGS_io_buffer_idle_timeout_ms / 2, 1));
+    // As in PlanFragmentExecutor::ReportProfile(), the return value of timed_wait()
+    // does not tell whether the wait was signalled, so check the flag instead.
+    buffer_gc_thread_cv_.timed_wait(l, timeout);
+    if (!buffer_gc_thread_active_) break;
+    FreeIdleBuffers(FLAGS_io_buffer_idle_timeout_ms);
   }
 }
 
@@ -747,22 +1168,24 @@ void DiskIoMgr::ReturnFreeBuffer(char* buffer, int64_t buffer_size) {
   DCHECK_EQ(BitUtil::Ceil(buffer_size, min_buffer_size_) & ~(1 << idx), 0)
       << "buffer_size_ / min_buffer_size_ should be power of 2, got buffer_size = "
       << buffer_size << ", min_buffer_size_ = " << min_buffer_size_;
-  unique_lock<mutex> lock(free_buffers_lock_);
-  if (!FLAGS_disable_mem_pools && free_buffers_[idx].size() < FLAGS_max_free_io_buffers) {
-    free_buffers_[idx].push_back(buffer);
-    if (ImpaladMetrics::IO_MGR_NUM_UNUSED_BUFFERS != NULL) {
-      ImpaladMetrics::IO_MGR_NUM_UNUSED_BUFFERS->Increment(1L);
-    }
-  } else {
-    process_mem_tracker_->Release(buffer_size);
-    num_allocated_buffers_.Add(-1);
-    delete[] buffer;
-    if (ImpaladMetrics::IO_MGR_NUM_BUFFERS != NULL) {
-      ImpaladMetrics::IO_MGR_NUM_BUFFERS->Increment(-1L);
-    }
-    if (ImpaladMetrics::IO_MGR_TOTAL_BYTES != NULL) {
-      ImpaladMetrics::IO_MGR_TOTAL_BYTES->Increment(-buffer_size);
-    }
+  if (FLAGS_disable_mem_pools) {
+    FreeBufferMemory(buffer, buffer_size);
+    return;
+  }
+  if (num_free_buffers_[idx].Add(1) > FLAGS_max_free_io_buffers) {
+    num_free_buffers_[idx].Add(-1);
+    FreeBufferMemory(buffer, buffer_size);
+    return;
+  }
+  FreeBuffer free_buffer = { buffer, MonotonicMillis() };
+  FreeBufferArena* arena =
+      &arenas_[GetArenaForBuffer(buffer, buffer_size, CpuInfo::GetCurrentCore())];
+  {
+    lock_guard<SpinLock> l(arena->lock);
+    arena->free_buffers[idx].push_back(free_buffer);
+  }
+  if (ImpaladMetrics::IO_MGR_NUM_UNUSED_BUFFERS != NULL) {
+    ImpaladMetrics::IO_MGR_NUM_UNUSED_BUFFERS->Increment(1L);
   }
 }
 
@@ -798,8 +1221,21 @@ bool DiskIoMgr::GetNextRequestRange(DiskQueue* disk_queue, RequestRange** range,
       // can't pick it up.  It will be enqueued before issuing the read to HDFS
       // so this is not a big deal (i.e. multiple disk threads can read for the
       // same reader).
+      // The readers are picked in deficit round-robin order. A reader at the front
+      // without credit left is credited one quantum, the max read size, per unit of
+      // weight and moved to the back. The bytes of each read or write are charged
+      // when it finishes, so every round a reader gets about 'weight' reads.
       // TODO: revisit.
-      *request_context = disk_queue->request_contexts.front();
+      while (true) {
+        *request_context = disk_queue->request_contexts.front();
+        DiskIoRequestContext::PerDiskState& state =
+            (*request_context)->disk_states_[disk_id];
+        if (state.deficit() > 0) break;
+        state.AddDeficit(static_cast<int64_t>(max_buffer_size_) *
+            (*request_context)->weight_);
+        disk_queue->request_contexts.pop_front();
+        disk_queue->request_contexts.push_back(*request_context);
+      }
       disk_queue->request_contexts.pop_front();
       DCHECK(*request_context != NULL);
       request_disk_state = &((*request_context)->disk_states_[disk_id]);
@@ -872,6 +1308,7 @@ bool DiskIoMgr::GetNextRequestRange(DiskQueue* disk_queue, RequestRange** range,
 
     // There are no inflight ranges, nothing to do.
     if (request_disk_state->in_flight_ranges()->empty()) {
+      request_disk_state->ClearCredit();
       request_disk_state->DecrementRequestThread();
       continue;
     }
@@ -902,6 +1339,7 @@ void DiskIoMgr::HandleWriteFinished(DiskIoRequestContext* writer, WriteRange* wr
     unique_lock<mutex> writer_lock(writer->lock_);
     DCHECK(writer->Validate()) << endl << writer->DebugString();
     DiskIoRequestContext::PerDiskState& state = writer->disk_states_[write_range->disk_id_];
+    state.AddDeficit(-write_range->len_);
     if (writer->state_ == DiskIoRequestContext::Cancelled) {
       state.DecrementRequestThreadAndCheckDone(writer);
     } else {
@@ -919,6 +1357,7 @@ void DiskIoMgr::HandleReadFinished(DiskQueue* disk_queue, DiskIoRequestContext*
   DCHECK(reader->Validate()) << endl << reader->DebugString();
   DCHECK_GT(state.num_threads_in_op(), 0);
   DCHECK(buffer->buffer_ != NULL);
+  state.AddDeficit(-buffer->len_);
 
   if (reader->state_ == DiskIoRequestContext::Cancelled) {
     state.DecrementRequestThreadAndCheckDone(reader);
@@ -952,7 +1391,12 @@ void DiskIoMgr::HandleReadFinished(DiskQueue* disk_queue, DiskIoRequestContext*
   // Store the state we need before calling EnqueueBuffer().
   bool eosr = buffer->eosr_;
   ScanRange* scan_range = buffer->scan_range_;
-  bool queue_full = buffer->scan_range_->EnqueueBuffer(buffer);
+  bool queue_full = false;
+  if (buffer->status_.ok() && !scan_range->coalesced_ranges_.empty()) {
+    EnqueueSlices(reader, buffer);
+  } else {
+    queue_full = scan_range->EnqueueBuffer(buffer);
+  }
   if (eosr) {
     // For cached buffers, we can't close the range until the cached buffer is returned.
     // Close() is called from DiskIoMgr::ReturnBuffer().
@@ -1006,7 +1450,7 @@ void DiskIoMgr::ReadRange(DiskQueue* disk_queue, DiskIoRequestContext* reader,
   char* buffer = NULL;
   int64_t bytes_remaining = range->len_ - range->bytes_read_;
   DCHECK_GT(bytes_remaining, 0);
-  int64_t buffer_size = ::min(bytes_remaining, static_cast<int64_t>(max_buffer_size_));
+  int64_t buffer_size = ::min(bytes_remaining, range->ReadSize());
   bool enough_memory = true;
   if (reader->mem_tracker_ != NULL) {
     enough_memory = reader->mem_tracker_->SpareCapacity() > LOW_MEMORY;
@@ -1044,7 +1488,7 @@ void DiskIoMgr::ReadRange(DiskQueue* disk_queue, DiskIoRequestContext* reader,
     }
   }
 
-  buffer = GetFreeBuffer(&buffer_size);
+  buffer = GetFreeBuffer(&buffer_size, reader->numa_node_);
   reader->num_used_buffers_.Add(1);
 
   // Validate more invariants.
@@ -1056,6 +1500,17 @@ void DiskIoMgr::ReadRange(DiskQueue* disk_queue, DiskIoRequestContext* reader,
   BufferDescriptor* buffer_desc = GetBufferDesc(reader, range, buffer, buffer_size);
   DCHECK(buffer_desc != NULL);
 
+  // Remote data that was read before may be cached locally.
+  if (range->ReadFromDataCache(buffer, &buffer_desc->len_, &buffer_desc->eosr_)) {
+    buffer_desc->scan_range_offset_ = range->bytes_read_ - buffer_desc->len_;
+    if (reader->bytes_read_counter_ != NULL) {
+      COUNTER_ADD(reader->bytes_read_counter_, buffer_desc->len_);
+    }
+    COUNTER_ADD(&total_bytes_read_counter_, buffer_desc->len_);
+    HandleReadFinished(disk_queue, reader, buffer_desc);
+    return;
+  }
+
   // No locks in this section.  Only working on local vars.  We don't want to hold a
   // lock across the read call.
   buffer_desc->status_ = range->Open();
@@ -1068,10 +1523,20 @@ void DiskIoMgr::ReadRange(DiskQueue* disk_queue, DiskIoRequestContext* reader,
       int64_t disk_bit = 1 << disk_queue->disk_id;
       reader->disks_accessed_bitmap_->BitOr(disk_bit);
     }
+    // The completion thread finishes asynchronous reads, including the counters and
+    // the call to HandleReadFinished().
+    if (disk_queue->async_reader.get() != NULL &&
+        disk_queue->async_reader->Submit(reader, range, buffer_desc)) {
+      return;
+    }
     SCOPED_TIMER(&read_timer_);
     SCOPED_TIMER(reader->read_timer_);
 
+    int64_t read_start = MonotonicNanos();
     buffer_desc->status_ = range->Read(buffer, &buffer_desc->len_, &buffer_desc->eosr_);
+    int64_t read_time = MonotonicNanos() - read_start;
+    reader->RecordRead(read_time, buffer_desc->len_);
+    if (disk_queue->read_latency != NULL) disk_queue->read_latency->Update(read_time);
     buffer_desc->scan_range_offset_ = range->bytes_read_ - buffer_desc->len_;
 
     if (reader->bytes_read_counter_ != NULL) {
@@ -1089,6 +1554,10 @@ void DiskIoMgr::ReadRange(DiskQueue* disk_queue, DiskIoRequestContext* reader,
 }
 
 void DiskIoMgr::Write(DiskIoRequestContext* writer_context, WriteRange* write_range) {
+  if (write_range->disk_id() >= num_local_disks()) {
+    HandleWriteFinished(writer_context, write_range, WriteRemoteRange(write_range));
+    return;
+  }
   FILE* file_handle = fopen(write_range->file(), "rb+");
   Status ret_status;
   if (file_handle == NULL) {
@@ -1130,11 +1599,45 @@ Status DiskIoMgr::WriteRangeHelper(FILE* file_handle, WriteRange* write_range) {
   return Status::OK();
 }
 
+Status DiskIoMgr::WriteRemoteRange(WriteRange* write_range) {
+  DCHECK_EQ(write_range->offset(), 0) << write_range->file_;
+  hdfsFS fs;
+  RETURN_IF_ERROR(HdfsFsCache::instance()->GetConnection(write_range->file_, &fs));
+  // Buffer the whole range so that it is sent to the remote filesystem in one batch.
+  hdfsFile file = hdfsOpenFile(fs, write_range->file(), O_WRONLY, write_range->len_,
+      0, 0);
+  VLOG_FILE << "hdfsOpenFile() file=" << write_range->file_;
+  if (file == NULL) {
+    return Status(GetHdfsErrorMsg("Failed to open remote file for writing: ",
+        write_range->file_));
+  }
+  Status status;
+  int64_t bytes_written = 0;
+  while (bytes_written < write_range->len_) {
+    int ret = hdfsWrite(fs, file, write_range->data_ + bytes_written,
+        write_range->len_ - bytes_written);
+    if (ret == -1) {
+      status = Status(GetHdfsErrorMsg("Failed to write data to remote file: ",
+          write_range->file_));
+      break;
+    }
+    bytes_written += ret;
+  }
+  // Closing the file flushes the buffered data.
+  if (hdfsCloseFile(fs, file) != 0 && status.ok()) {
+    status = Status(GetHdfsErrorMsg("Failed to close remote file: ", write_range->file_));
+  }
+  if (status.ok() && ImpaladMetrics::IO_MGR_BYTES_WRITTEN != NULL) {
+    ImpaladMetrics::IO_MGR_BYTES_WRITTEN->Increment(write_range->len_);
+  }
+  return status;
+}
+
 int DiskIoMgr::free_buffers_idx(int64_t buffer_size) {
   int64_t buffer_size_scaled = BitUtil::Ceil(buffer_size, min_buffer_size_);
   int idx = Bits::Log2Ceiling64(buffer_size_scaled);
   DCHECK_GE(idx, 0);
-  DCHECK_LT(idx, free_buffers_.size());
+  DCHECK_LT(idx, arenas_[0].free_buffers.size());
   return idx;
 }
 
@@ -1174,30 +1677,30 @@ int DiskIoMgr::AssignQueue(const char* file, int disk_id, bool expected_local) {
 DiskIoMgr::HdfsCachedFileHandle* DiskIoMgr::OpenHdfsFile(const hdfsFS& fs,
     const char* fname, int64_t mtime) {
   HdfsCachedFileHandle* fh = NULL;
-
-  // Check if a cached file handle exists and validate the mtime, if the mtime of the
-  // cached handle is not matching the mtime of the requested file, reopen.
-  if (detail::is_file_handle_caching_enabled() && file_handle_cache_.Pop(fname, &fh)) {
-    ImpaladMetrics::IO_MGR_NUM_CACHED_FILE_HANDLES->Increment(-1L);
-    if (fh->mtime() == mtime) {
-      ImpaladMetrics::IO_MGR_CACHED_FILE_HANDLES_HIT_RATIO->Update(1L);
-      ImpaladMetrics::IO_MGR_CACHED_FILE_HANDLES_HIT_COUNT->Increment(1L);
-      ImpaladMetrics::IO_MGR_NUM_FILE_HANDLES_OUTSTANDING->Increment(1L);
-      return fh;
+  bool cache_hit = false;
+  if (file_handle_cache_.get() != NULL) {
+    // A cached handle is only returned if the mtime of the file matches.
+    fh = file_handle_cache_->GetFileHandle(fs, fname, mtime, &cache_hit);
+  } else {
+    fh = new HdfsCachedFileHandle(fs, fname, mtime);
+    if (!fh->ok()) {
+      delete fh;
+      fh = NULL;
     }
-    VLOG_FILE << "mtime mismatch, closing cached file handle. Closing file=" << fname;
-    delete fh;
   }
 
   // Update cache hit ratio
-  ImpaladMetrics::IO_MGR_CACHED_FILE_HANDLES_HIT_RATIO->Update(0L);
-  ImpaladMetrics::IO_MGR_CACHED_FILE_HANDLES_MISS_COUNT->Increment(1L);
-  fh = new HdfsCachedFileHandle(fs, fname, mtime);
+  if (cache_hit) {
+    ImpaladMetrics::IO_MGR_CACHED_FILE_HANDLES_HIT_RATIO->Update(1L);
+    ImpaladMetrics::IO_MGR_CACHED_FILE_HANDLES_HIT_COUNT->Increment(1L);
+  } else {
+    ImpaladMetrics::IO_MGR_CACHED_FILE_HANDLES_HIT_RATIO->Update(0L);
+    ImpaladMetrics::IO_MGR_CACHED_FILE_HANDLES_MISS_COUNT->Increment(1L);
+  }
 
   // Check if the file handle was opened correctly
-  if (!fh->ok())  {
+  if (fh == NULL)  {
     VLOG_FILE << "Opening the file " << fname << " failed.";
-    delete fh;
     return NULL;
   }
 
@@ -1211,12 +1714,15 @@ void DiskIoMgr::CacheOrCloseFileHandle(const char* fname,
   // Try to unbuffer the handle, on filesystems that do not support this call a non-zero
   // return code indicates that the operation was not successful and thus the file is
   // closed.
-  if (detail::is_file_handle_caching_enabled() &&
-      !close && hdfsUnbufferFile(fid->file()) == 0) {
+  if (file_handle_cache_.get() == NULL) {
+    VLOG_FILE << "Closing file=" << fname;
+    delete fid;
+    return;
+  }
+  bool destroy = close;
+  if (!close && hdfsUnbufferFile(fid->file()) == 0) {
     // Clear read statistics before returning
     hdfsFileClearReadStatistics(fid->file());
-    file_handle_cache_.Put(fname, fid);
-    ImpaladMetrics::IO_MGR_NUM_CACHED_FILE_HANDLES->Increment(1L);
   } else {
     if (close) {
       VLOG_FILE << "Closing file=" << fname;
@@ -1224,6 +1730,7 @@ void DiskIoMgr::CacheOrCloseFileHandle(const char* fname,
       VLOG_FILE << "FS does not support file handle unbuffering, closing file="
                 << fname;
     }
-    delete fid;
+    destroy = true;
   }
+  file_handle_cache_->ReleaseFileHandle(fname, fid, destroy);
 }
@@ -16,9 +16,13 @@
 #ifndef IMPALA_RUNTIME_DISK_IO_MGR_H
 #define IMPALA_RUNTIME_DISK_IO_MGR_H
 
+#include <deque>
 #include <list>
+#include <map>
+#include <string>
 #include <vector>
 
+#include <boost/scoped_array.hpp>
 #include <boost/scoped_ptr.hpp>
 #include <boost/unordered_set.hpp>
 #include <boost/thread/mutex.hpp>
@@ -32,13 +36,15 @@
 #include "util/bit-util.h"
 #include "util/error-util.h"
 #include "util/internal-queue.h"
-#include "util/lru-cache.h"
-#include "util/runtime-profile.h"
+#include "util/runtime-profile-counters.h"
+#include "util/spinlock.h"
 #include "util/thread.h"
 
 namespace impala {
 
+class HistogramMetric;
 class MemTracker;
+class MetricGroup;
 
 /// Manager object that schedules IO for all queries on all disks and remote filesystems
 /// (such as S3). Each query maps to one or more DiskIoRequestContext objects, each of which
@@ -88,7 +94,10 @@ class MemTracker;
 /// before the disk lock.
 //
 /// Scheduling: If there are multiple request contexts with work for a single disk, the
-/// request contexts are scheduled in round-robin order. Multiple disk threads can
+/// request contexts are scheduled in deficit round-robin order: each context gets disk
+/// bandwidth in proportion to the weight of its request pool (--disk_io_pool_weights),
+/// so that a large scan in one pool cannot starve the queries of another pool. With
+/// equal weights, this is plain round-robin order. Multiple disk threads can
 /// operate on the same request context. Exactly one request range is processed by a
 /// disk thread at a time. If there are multiple scan ranges scheduled via
 /// GetNextRange() for a single context, these are processed in round-robin order.
@@ -186,8 +195,10 @@ class MemTracker;
 ///    This contains the ready buffer queue logic
 ///  - DiskIoRequestContext APIs are implemented in disk-io-mgr-reader-context.cc
 ///    This contains the logic for picking scan ranges for a reader.
+///  - Asynchronous reads of local files are implemented in disk-io-mgr-async-reader.cc
 ///  - Disk Thread and general APIs are implemented in disk-io-mgr.cc.
 
+class DataCache;
 class DiskIoRequestContext;
 
 class DiskIoMgr {
@@ -211,10 +222,6 @@ class DiskIoMgr {
 
     int64_t mtime() const { return mtime_; }
 
-    /// This method is called to release acquired resources by the cached handle when it
-    /// is evicted.
-    static void Release(HdfsCachedFileHandle** h);
-
     bool ok() const { return hdfs_file_ != NULL; }
 
    private:
@@ -269,7 +276,7 @@ class DiskIoMgr {
     /// buffer with the read contents
     char* buffer_;
 
-    /// length of buffer_. For buffers from cached reads, the length is 0.
+    /// length of buffer_. For buffers from cached reads and for slices, the length is 0.
     int64_t buffer_len_;
 
     /// length of read contents
@@ -282,6 +289,15 @@ class DiskIoMgr {
     Status status_;
 
     int64_t scan_range_offset_;
+
+    /// If non-NULL, this buffer is a slice of the buffer of a coalesced read and
+    /// 'buffer_' points into 'parent_'. Slices do not own memory; 'parent_' is returned
+    /// when the last of its slices is returned.
+    BufferDescriptor* parent_;
+
+    /// For the buffer of a coalesced read, the number of its slices that have not been
+    /// returned yet.
+    AtomicInt32 num_slices_;
   };
 
   /// The request type, read or write associated with a request range.
@@ -348,6 +364,16 @@ class DiskIoMgr {
     bool try_cache() const { return try_cache_; }
     bool expected_local() const { return expected_local_; }
     int ready_buffers_capacity() const { return ready_buffers_capacity_; }
+    int64_t preferred_read_size() const { return preferred_read_size_; }
+
+    /// Sets the size of the reads of this range, e.g. smaller reads for ranges that are
+    /// read concurrently with many others. The IoMgr rounds it up to a buffer size
+    /// class and caps it at its maximum buffer size. 0, the default after Reset(),
+    /// uses the maximum buffer size. Must be called before AddScanRanges().
+    void set_preferred_read_size(int64_t read_size) {
+      DCHECK_GE(read_size, 0);
+      preferred_read_size_ = read_size;
+    }
 
     /// Returns the next buffer for this scan range. buffer is an output parameter.
     /// This function blocks until a buffer is ready or an error occurred. If this is
@@ -391,6 +417,11 @@ class DiskIoMgr {
     /// Maximum length in bytes for hdfsRead() calls.
     int64_t MaxReadChunkSize() const;
 
+    /// Returns the number of bytes that each Read() of this range requests, before
+    /// limiting it to the rest of the range. Remote ranges always use the maximum
+    /// buffer size, since every remote request has a high fixed cost.
+    int64_t ReadSize() const;
+
     /// Opens the file for this range. This function only modifies state in this range.
     Status Open();
 
@@ -401,9 +432,23 @@ class DiskIoMgr {
     /// of bytes read. Updates range to keep track of where in the file we are.
     Status Read(char* buffer, int64_t* bytes_read, bool* eosr);
 
-    /// Reads from the DN cache. On success, sets cached_buffer_ to the DN buffer
-    /// and *read_succeeded to true.
-    /// If the data is not cached, returns ok() and *read_succeeded is set to false.
+    /// Returns true if reads of this range should use the IoMgr's data cache. This is
+    /// the case for remote reads of files with a known mtime.
+    bool UseDataCache() const;
+
+    /// Returns true if reads of this range should use positional reads so that the
+    /// HDFS client can hedge them. This is the case for remote HDFS reads if
+    /// --hdfs_hedged_read_threadpool_size is set.
+    bool UseHedgedReads() const;
+
+    /// Reads the next part of this range from the IoMgr's data cache into 'buffer', as
+    /// Read() would. Returns false if the data is not cached.
+    bool ReadFromDataCache(char* buffer, int64_t* bytes_read, bool* eosr);
+
+    /// Reads from the DN cache or a memory-mapped local replica. On success, sets
+    /// cached_buffer_ to the DN buffer and *read_succeeded to true.
+    /// If the whole range can't be read this way, returns ok() and *read_succeeded is
+    /// set to false.
     /// Returns a non-ok status if it ran into a non-continuable error.
     Status ReadFromCache(bool* read_succeeded);
 
@@ -423,6 +468,10 @@ class DiskIoMgr {
     /// TODO: we can do more with this
     bool expected_local_;
 
+    /// Hint for the size of the reads of this range, or 0 to use the maximum buffer
+    /// size. See set_preferred_read_size().
+    int64_t preferred_read_size_;
+
     DiskIoMgr* io_mgr_;
 
     /// Reader/owner of the scan range
@@ -437,6 +486,10 @@ class DiskIoMgr {
       HdfsCachedFileHandle* hdfs_file_;
     };
 
+    /// File descriptor of the file opened with O_DIRECT for asynchronous reads, or -1.
+    /// Only used for local files, alongside 'local_file_'.
+    int direct_fd_;
+
     /// If non-null, this is DN cached buffer. This means the cached read succeeded
     /// and all the bytes for the range are in this buffer.
     struct hadoopRzBuffer* cached_buffer_;
@@ -487,12 +540,19 @@ class DiskIoMgr {
 
     /// Last modified time of the file associated with the scan range
     int64_t mtime_;
+
+    /// If non-empty, this range was created by the IoMgr to read the extent that covers
+    /// these client ranges with a single request. The range's only buffer is sliced into
+    /// one buffer for each of them. See DiskIoMgr::CoalesceScanRanges().
+    std::vector<ScanRange*> coalesced_ranges_;
   };
 
   /// Used to specify data to be written to a file and offset.
   /// It is the responsibility of the client to ensure that the data to be written is
   /// valid and that the file to be written to exists until the callback is invoked.
   /// A callback is invoked to inform the client when the write is done.
+  /// Ranges on a remote disk queue are written to a file on a remote filesystem, which
+  /// must not exist or is overwritten, and their offset must be 0.
   class WriteRange : public RequestRange {
    public:
     /// This callback is invoked on each WriteRange after the write is complete or the
@@ -510,6 +570,10 @@ class DiskIoMgr {
     /// File data can be over-written by calling SetData() and AddWriteRange().
     void SetData(const uint8_t* buffer, int64_t len);
 
+    /// Changes the file, offset and disk that the range writes to. Must not be called
+    /// while a write of the range is in progress.
+    void SetRange(const std::string& file, int64_t file_offset, int disk_id);
+
    private:
     friend class DiskIoMgr;
     friend class DiskIoRequestContext;
@@ -542,6 +606,10 @@ class DiskIoMgr {
   /// Initialize the IoMgr. Must be called once before any of the other APIs.
   Status Init(MemTracker* process_mem_tracker);
 
+  /// Registers histograms of the read latency of each disk queue and each request pool
+  /// in 'metrics'. Must be called after Init() and before the IoMgr is used.
+  void InitMetrics(MetricGroup* metrics);
+
   /// Allocates tracking structure for a request context.
   /// Register a new request context which is returned in *request_context.
   /// The IoMgr owns the allocated DiskIoRequestContext object. The caller must call
@@ -576,7 +644,9 @@ class DiskIoMgr {
   /// If schedule_immediately, the ranges are immediately put on the read queue
   /// (i.e. the caller should not/cannot call GetNextRange for these ranges).
   /// This can be used to do synchronous reads as well as schedule dependent ranges,
-  /// as in the case for columnar formats.
+  /// as in the case for columnar formats. If --max_scan_range_coalesce_gap is set,
+  /// ranges that are scheduled immediately may be read with fewer, larger requests
+  /// (see CoalesceScanRanges()); the buffers returned for each range are the same.
   Status AddScanRanges(DiskIoRequestContext* reader, const std::vector<ScanRange*>& ranges,
       bool schedule_immediately = false);
 
@@ -613,18 +683,35 @@ class DiskIoMgr {
   void set_active_read_thread_counter(DiskIoRequestContext*, RuntimeProfile::Counter*);
   void set_disks_access_bitmap(DiskIoRequestContext*, RuntimeProfile::Counter*);
 
+  /// Sets the request pool of the context. The pool determines the context's share of
+  /// the disk bandwidth and the disk time of its reads is accounted to the pool. Must
+  /// be called before any ranges are added.
+  void set_request_pool(DiskIoRequestContext*, const std::string& pool);
+
+  /// Sets the NUMA node that the buffers of the context are allocated on. By default,
+  /// they are allocated on the node of the disk thread that reads into them.
+  void set_numa_node(DiskIoRequestContext*, int numa_node);
+
   int64_t queue_size(DiskIoRequestContext* reader) const;
   int64_t bytes_read_local(DiskIoRequestContext* reader) const;
   int64_t bytes_read_short_circuit(DiskIoRequestContext* reader) const;
   int64_t bytes_read_dn_cache(DiskIoRequestContext* reader) const;
   int num_remote_ranges(DiskIoRequestContext* reader) const;
   int64_t unexpected_remote_bytes(DiskIoRequestContext* reader) const;
+  int64_t data_cache_hit_count(DiskIoRequestContext* reader) const;
+  int64_t data_cache_miss_count(DiskIoRequestContext* reader) const;
+  int64_t data_cache_hit_bytes(DiskIoRequestContext* reader) const;
+  int64_t num_slow_remote_reads(DiskIoRequestContext* reader) const;
 
   /// Returns the read throughput across all readers.
   /// TODO: should this be a sliding window?  This should report metrics for the
   /// last minute, hour and since the beginning.
   int64_t GetReadThroughput();
 
+  /// Returns the disk time, number of reads and bytes read of each request pool since
+  /// the IoMgr was started.
+  std::string PoolStatsDebugString();
+
   /// Returns the maximum read buffer size
   int max_read_buffer_size() const { return max_buffer_size_; }
 
@@ -651,14 +738,14 @@ class DiskIoMgr {
   bool Validate() const;
 
   /// Given a FS handle, name and last modified time of the file, tries to open that file
-  /// and return an instance of HdfsCachedFileHandle. In case of an error returns NULL.
+  /// and return an instance of HdfsCachedFileHandle. A cached handle of the file is
+  /// returned if there is one that is not in use. In case of an error returns NULL.
   HdfsCachedFileHandle* OpenHdfsFile(const hdfsFS& fs, const char* fname, int64_t mtime);
 
   /// When the file handle is no longer in use by the scan range, return it and try to
   /// unbuffer the handle. If unbuffering, closing sockets and dropping buffers in the
   /// libhdfs client, is not supported, close the file handle. If the unbuffer operation
-  /// is supported, put the file handle together with the mtime in the LRU cache for
-  /// later reuse.
+  /// is supported, return the file handle to the file handle cache for later reuse.
   void CacheOrCloseFileHandle(const char* fname, HdfsCachedFileHandle* fid, bool close);
 
   /// Default ready buffer queue capacity. This constant doesn't matter too much
@@ -676,10 +763,13 @@ class DiskIoMgr {
  private:
   friend class BufferDescriptor;
   friend class DiskIoRequestContext;
+  class AsyncReader;
   struct DiskQueue;
+  class FileHandleCache;
   class RequestContextCache;
 
   friend class DiskIoMgrTest_Buffers_Test;
+  friend class DiskIoMgrTest_IdleBuffers_Test;
 
   /// Pool to allocate BufferDescriptors.
   ObjectPool pool_;
@@ -700,6 +790,38 @@ class DiskIoMgr {
   /// Thread group containing all the worker threads.
   ThreadGroup disk_thread_group_;
 
+  /// Cache of remote file extents on local directories. NULL if --data_cache_dirs is
+  /// empty.
+  boost::scoped_ptr<DataCache> data_cache_;
+
+  /// Disk usage of a request pool.
+  struct PoolStats {
+    /// Total time that reads for the pool kept the disks busy.
+    AtomicInt64 disk_time_ns;
+    AtomicInt64 num_reads;
+    AtomicInt64 bytes_read;
+
+    /// Latency of the reads for the pool. NULL if InitMetrics() was not called.
+    HistogramMetric* read_latency;
+
+    PoolStats() : read_latency(NULL) { }
+  };
+
+  /// Metrics that the latency histograms are registered in. NULL if InitMetrics() was
+  /// not called.
+  MetricGroup* metrics_;
+
+  /// Scheduling weight of each request pool, parsed from --disk_io_pool_weights. Pools
+  /// that are not listed have weight 1. Set in Init() and never modified.
+  std::map<std::string, int> pool_weights_;
+
+  /// Protects 'pool_stats_'.
+  boost::mutex pool_stats_lock_;
+
+  /// Disk usage of each request pool that had a context. Entries are never removed, so
+  /// contexts can keep pointers to them.
+  std::map<std::string, PoolStats> pool_stats_;
+
   /// Options object for cached hdfs reads. Set on startup and never modified.
   struct hadoopRzOptions* cached_read_options_;
 
@@ -707,11 +829,11 @@ class DiskIoMgr {
   /// know to terminate. This variable is read/written to by different threads.
   volatile bool shut_down_;
 
-  /// Total bytes read by the IoMgr.
-  RuntimeProfile::Counter total_bytes_read_counter_;
+  /// Total bytes read by the IoMgr. Sharded because all disk threads update it.
+  RuntimeProfile::ShardedCounter total_bytes_read_counter_;
 
   /// Total time spent in hdfs reading
-  RuntimeProfile::Counter read_timer_;
+  RuntimeProfile::ShardedCounter read_timer_;
 
   /// Contains all contexts that the IoMgr is tracking. This includes contexts that are
   /// active as well as those in the process of being cancelled. This is a cache
@@ -719,21 +841,61 @@ class DiskIoMgr {
   /// contention.
   boost::scoped_ptr<RequestContextCache> request_context_cache_;
 
-  /// Protects free_buffers_ and free_buffer_descs_
+  /// Protects free_buffer_descs_
   boost::mutex free_buffers_lock_;
 
-  /// Free buffers that can be handed out to clients. There is one list for each buffer
-  /// size, indexed by the Log2 of the buffer size in units of min_buffer_size_. The
-  /// maximum buffer size is max_buffer_size_, so the maximum index is
-  /// Log2(max_buffer_size_ / min_buffer_size_).
+  /// A free buffer and the time in ms (MonotonicMillis()) when it was returned.
+  struct FreeBuffer {
+    char* buffer;
+    int64_t return_time_ms;
+  };
+
+  /// Free buffers that can be handed out to clients. There is one arena per core so
+  /// that the threads on different cores do not contend for the free lists. Each arena
+  /// has one list for each buffer size, indexed by the Log2 of the buffer size in units
+  /// of min_buffer_size_. The maximum buffer size is max_buffer_size_, so the maximum
+  /// index is Log2(max_buffer_size_ / min_buffer_size_).
   //
   /// E.g. if min_buffer_size_ = 1024 bytes:
-  ///  free_buffers_[0]  => list of free buffers with size 1024 B
-  ///  free_buffers_[1]  => list of free buffers with size 2048 B
-  ///  free_buffers_[10] => list of free buffers with size 1 MB
-  ///  free_buffers_[13] => list of free buffers with size 8 MB
-  ///  free_buffers_[n]  => list of free buffers with size 2^n * 1024 B
-  std::vector<std::list<char*> > free_buffers_;
+  ///  free_buffers[0]  => list of free buffers with size 1024 B
+  ///  free_buffers[1]  => list of free buffers with size 2048 B
+  ///  free_buffers[10] => list of free buffers with size 1 MB
+  ///  free_buffers[13] => list of free buffers with size 8 MB
+  ///  free_buffers[n]  => list of free buffers with size 2^n * 1024 B
+  //
+  /// Buffers are taken from and returned to the back of the lists, so the most recently
+  /// used buffers are reused first and the front holds the buffers that were idle
+  /// longest.
+  struct FreeBufferArena {
+    /// Protects free_buffers.
+    SpinLock lock;
+    std::vector<std::deque<FreeBuffer> > free_buffers;
+  };
+
+  /// The arenas, one for each core. A buffer is only put in an arena of a core on the
+  /// NUMA node that its memory was allocated on.
+  boost::scoped_array<FreeBufferArena> arenas_;
+  int num_arenas_;
+
+  /// The indices of the arenas of the cores of each NUMA node.
+  std::vector<std::vector<int> > numa_node_arenas_;
+
+  /// The number of free buffers of each size across all arenas. Bounded by
+  /// FLAGS_max_free_io_buffers.
+  boost::scoped_array<AtomicInt32> num_free_buffers_;
+
+  /// Frees the buffers that were not reused within FLAGS_io_buffer_idle_timeout_ms.
+  /// NULL if the timeout is disabled.
+  boost::scoped_ptr<Thread> buffer_gc_thread_;
+
+  /// Protects buffer_gc_thread_active_ and is used with buffer_gc_thread_cv_.
+  boost::mutex buffer_gc_thread_lock_;
+
+  /// Signalled to stop buffer_gc_thread_.
+  boost::condition_variable buffer_gc_thread_cv_;
+
+  /// False once buffer_gc_thread_ should exit.
+  bool buffer_gc_thread_active_;
 
   /// List of free buffer desc objects that can be handed out to clients
   std::list<BufferDescriptor*> free_buffer_descs_;
@@ -749,14 +911,17 @@ class DiskIoMgr {
   /// It is indexed by disk id.
   std::vector<DiskQueue*> disk_queues_;
 
-  // Caching structure that maps file names to cached file handles. The cache has an upper
-  // limit of entries defined by FLAGS_max_cached_file_handles. Evicted cached file
-  // handles are closed.
-  FifoMultimap<std::string, HdfsCachedFileHandle*> file_handle_cache_;
+  /// Cache of the HDFS file handles of recently read files. Keeps up to
+  /// FLAGS_max_cached_file_handles unused handles. NULL if file handle caching is
+  /// disabled.
+  boost::scoped_ptr<FileHandleCache> file_handle_cache_;
 
-  /// Returns the index into free_buffers_ for a given buffer size
+  /// Returns the index into the free buffer lists for a given buffer size
   int free_buffers_idx(int64_t buffer_size);
 
+  /// Creates the arenas for the free buffers.
+  void InitArenas();
+
   /// Gets a buffer description object, initialized for this reader, allocating one as
   /// necessary. buffer_size / min_buffer_size_ should be a power of 2, and buffer_size
   /// should be <= max_buffer_size_. These constraints will be met if buffer was acquired
@@ -773,16 +938,39 @@ class DiskIoMgr {
 
   /// Returns a buffer to read into with size between *buffer_size and max_buffer_size_,
   /// and *buffer_size is set to the size of the buffer. If there is an
-  /// appropriately-sized free buffer in the 'free_buffers_', that is returned, otherwise
-  /// a new one is allocated. *buffer_size must be between 0 and max_buffer_size_.
-  char* GetFreeBuffer(int64_t* buffer_size);
-
-  /// Garbage collect all unused io buffers. This is currently only triggered when the
-  /// process wide limit is hit. This is not good enough. While it is sufficient for
-  /// the IoMgr, other components do not trigger this GC.
-  /// TODO: make this run periodically?
+  /// appropriately-sized free buffer in an arena of NUMA node 'numa_node', that is
+  /// returned, otherwise a new one is allocated on that node. If 'numa_node' is -1,
+  /// the caller's node is used. *buffer_size must be between 0 and max_buffer_size_.
+  char* GetFreeBuffer(int64_t* buffer_size, int numa_node = -1);
+
+  /// Removes and returns a free buffer with index 'idx' from the arena of 'core' or
+  /// another arena on the same NUMA node. Returns NULL if there is none.
+  char* TakeFreeBuffer(int core, int idx);
+
+  /// Allocates the memory for a new buffer of 'buffer_size' bytes on the NUMA node of
+  /// 'core'.
+  char* AllocateBuffer(int64_t buffer_size, int core);
+
+  /// Returns the index of the arena of 'core'.
+  int GetArenaForCore(int core);
+
+  /// Returns the index of the arena that 'buffer', returned by a thread on 'core',
+  /// should be put in.
+  int GetArenaForBuffer(char* buffer, int64_t buffer_size, int core);
+
+  /// Frees the memory of an unused buffer and updates the accounting.
+  void FreeBufferMemory(char* buffer, int64_t buffer_size);
+
+  /// Garbage collect all unused io buffers. This is triggered when the process wide
+  /// limit is hit. Idle buffers are also freed periodically by buffer_gc_thread_.
   void GcIoBuffers();
 
+  /// Frees the unused io buffers that were returned at least 'idle_ms' ago.
+  void FreeIdleBuffers(int64_t idle_ms);
+
+  /// Loop of buffer_gc_thread_.
+  void BufferGcLoop();
+
   /// Returns a buffer to the free list. buffer_size / min_buffer_size_ should be a power
   /// of 2, and buffer_size should be <= max_buffer_size_. These constraints will be met
   /// if buffer was acquired via GetFreeBuffer() (which it should have been).
@@ -821,6 +1009,25 @@ class DiskIoMgr {
   /// Validates that range is correctly initialized
   Status ValidateScanRange(ScanRange* range);
 
+  /// Returns the scheduling weight of request pool 'pool'.
+  int GetPoolWeight(const std::string& pool) const;
+
+  /// Registers the read latency histogram of the disk queue or request pool 'name' in
+  /// 'metrics_'.
+  HistogramMetric* CreateReadLatencyMetric(const std::string& name);
+
+  /// Groups the initialized 'ranges' of the same file that are at most
+  /// --max_scan_range_coalesce_gap bytes apart and that fit into a single io buffer
+  /// together. For each group, a range that reads the whole extent is allocated from
+  /// the reader and added to 'read_ranges'; ranges that are not coalesced are added
+  /// as-is. reader->lock_ must be taken.
+  void CoalesceScanRanges(DiskIoRequestContext* reader,
+      const std::vector<ScanRange*>& ranges, std::vector<ScanRange*>* read_ranges);
+
+  /// Enqueues a slice of 'buffer', the buffer of a coalesced read, to each of the
+  /// coalesced ranges. 'buffer' is returned once all slices have been returned.
+  void EnqueueSlices(DiskIoRequestContext* reader, BufferDescriptor* buffer);
+
   /// Write the specified range to disk and calls HandleWriteFinished when done.
   /// Responsible for opening and closing the file that is written.
   void Write(DiskIoRequestContext* writer_context, WriteRange* write_range);
@@ -830,6 +1037,11 @@ class DiskIoMgr {
   /// Does not open or close the file that is written.
   Status WriteRangeHelper(FILE* file_handle, WriteRange* write_range);
 
+  /// Writes a range that is queued on a remote disk to its own file on a remote
+  /// filesystem, which is created or overwritten. The offset of the range must be 0,
+  /// because remote filesystems do not support random writes.
+  Status WriteRemoteRange(WriteRange* write_range);
+
   /// Reads the specified scan range and calls HandleReadFinished when done.
   void ReadRange(DiskQueue* disk_queue, DiskIoRequestContext* reader,
       ScanRange* range);
@@ -23,6 +23,7 @@
 #include "common/logging.h"
 #include "resourcebroker/resource-broker.h"
 #include "runtime/backend-client.h"
+#include "runtime/buffered-block-mgr.h"
 #include "runtime/client-cache.h"
 #include "runtime/coordinator.h"
 #include "runtime/data-stream-mgr.h"
@@ -37,6 +38,7 @@
 #include "service/frontend.h"
 #include "scheduling/simple-scheduler.h"
 #include "statestore/statestore-subscriber.h"
+#include "util/cpu-info.h"
 #include "util/debug-util.h"
 #include "util/default-path-handlers.h"
 #include "util/hdfs-bulk-ops.h"
@@ -110,6 +112,18 @@ DEFINE_string(cgroup_hierarchy_path, "", "If Resource Management is enabled, thi
     "threads are assigned.");
 DEFINE_string(staging_cgroup, "impala_staging", "Name of the cgroup that a query's "
     "execution threads are moved into once the query completes.");
+DEFINE_bool(enable_pool_cgroups, false, "If true and Resource Management is disabled, "
+    "each admission control request pool gets a cgroup under --cgroup_hierarchy_path, "
+    "and the fragment, scanner and join build threads of a query run in the cgroup of "
+    "its pool.");
+DEFINE_string(pool_cgroup_cpu_shares, "", "Comma-separated list of <pool>:<shares> that "
+    "sets the cgroup CPU shares of request pools with --enable_pool_cgroups, e.g. "
+    "'root.interactive:4096,root.etl:512'.");
+DEFINE_int32(default_pool_cgroup_cpu_shares, 1024, "The cgroup CPU shares of request "
+    "pools that are not listed in --pool_cgroup_cpu_shares.");
+DEFINE_string(pool_cgroup_cpu_quota_pct, "", "Comma-separated list of <pool>:<percent> "
+    "that caps the CPU time of request pools with --enable_pool_cgroups at a percentage "
+    "of one core, e.g. 'root.etl:800' for eight cores. Other pools are not capped.");
 
 // Use a low default value because the reconnection logic is performed manually
 // for the purpose of faster Llama failover (otherwise we may try to reconnect to the
@@ -127,6 +141,14 @@ DEFINE_int32(resource_broker_recv_timeout, 0, "Time to wait, in ms, "
 
 DEFINE_int32(coordinator_rpc_threads, 12, "(Advanced) Number of threads available to "
     "start fragments on remote Impala daemons.");
+DEFINE_int32(async_rpc_threads, 32, "(Advanced) Number of threads available to send "
+    "asynchronous RPCs, e.g. runtime filters to and from the coordinator. The "
+    "coordinator publishes each global filter to every target fragment instance, so "
+    "this bounds the number of concurrent publications.");
+DEFINE_int32(num_query_task_threads, 0, "(Advanced) Number of threads in the "
+    "process-wide pool that runs the parallel tasks of query operators, e.g. the "
+    "decoding of Parquet columns and the compression of Parquet data pages. If 0, one "
+    "thread per core.");
 
 DECLARE_string(ssl_client_ca_certificate);
 
@@ -164,7 +186,12 @@ ExecEnv::ExecEnv()
     fragment_exec_thread_pool_(
         new CallableThreadPool("coordinator-fragment-rpc", "worker",
             FLAGS_coordinator_rpc_threads, numeric_limits<int32_t>::max())),
-    async_rpc_pool_(new CallableThreadPool("rpc-pool", "async-rpc-sender", 8, 10000)),
+    async_rpc_pool_(new CallableThreadPool("rpc-pool", "async-rpc-sender",
+        FLAGS_async_rpc_threads, 10000)),
+    query_task_pool_(new CallableThreadPool("query-task-pool", "worker",
+        FLAGS_num_query_task_threads > 0 ?
+            FLAGS_num_query_task_threads : CpuInfo::num_cores(),
+        numeric_limits<int32_t>::max())),
     enable_webserver_(FLAGS_enable_webserver),
     is_fe_tests_(false),
     backend_address_(MakeNetworkAddress(FLAGS_hostname, FLAGS_be_port)),
@@ -215,7 +242,12 @@ ExecEnv::ExecEnv(const string& hostname, int backend_port, int subscriber_port,
     fragment_exec_thread_pool_(
         new CallableThreadPool("coordinator-fragment-rpc", "worker",
             FLAGS_coordinator_rpc_threads, numeric_limits<int32_t>::max())),
-    async_rpc_pool_(new CallableThreadPool("rpc-pool", "async-rpc-sender", 8, 10000)),
+    async_rpc_pool_(new CallableThreadPool("rpc-pool", "async-rpc-sender",
+        FLAGS_async_rpc_threads, 10000)),
+    query_task_pool_(new CallableThreadPool("query-task-pool", "worker",
+        FLAGS_num_query_task_threads > 0 ?
+            FLAGS_num_query_task_threads : CpuInfo::num_cores(),
+        numeric_limits<int32_t>::max())),
     enable_webserver_(FLAGS_enable_webserver && webserver_port > 0),
     is_fe_tests_(false),
     backend_address_(MakeNetworkAddress(FLAGS_hostname, FLAGS_be_port)),
@@ -315,6 +347,15 @@ Status ExecEnv::StartServices() {
     DCHECK(cgroups_mgr_.get() != NULL);
     RETURN_IF_ERROR(
         cgroups_mgr_->Init(FLAGS_cgroup_hierarchy_path, FLAGS_staging_cgroup));
+  } else if (FLAGS_enable_pool_cgroups) {
+    if (FLAGS_cgroup_hierarchy_path.empty()) {
+      return Status("--enable_pool_cgroups requires --cgroup_hierarchy_path");
+    }
+    cgroups_mgr_.reset(new CgroupsMgr(metrics_.get()));
+    RETURN_IF_ERROR(
+        cgroups_mgr_->Init(FLAGS_cgroup_hierarchy_path, FLAGS_staging_cgroup));
+    RETURN_IF_ERROR(cgroups_mgr_->InitPoolCgroups(FLAGS_pool_cgroup_cpu_shares,
+        FLAGS_default_pool_cgroup_cpu_shares, FLAGS_pool_cgroup_cpu_quota_pct));
   }
 
   // Initialize global memory limit.
@@ -396,6 +437,17 @@ Status ExecEnv::StartServices() {
             << PrettyPrinter::Print(bytes_limit, TUnit::BYTES);
 
   RETURN_IF_ERROR(disk_io_mgr_->Init(mem_tracker_.get()));
+  disk_io_mgr_->InitMetrics(metrics_.get());
+  RETURN_IF_ERROR(thread_mgr_->Init());
+
+  // If freeing unused memory was not enough, make running queries spill so that new
+  // allocations do not fail.
+  mem_tracker_->AddGcFunction(&BufferedBlockMgr::ReleaseMemoryUnderPressure);
+#ifndef ADDRESS_SANITIZER
+  // Return the spilled buffers to the OS.
+  mem_tracker_->AddGcFunction(boost::bind(&MallocExtension::ReleaseFreeMemory,
+                                          MallocExtension::instance()));
+#endif
 
   // Start services in order to ensure that dependencies between them are met
   if (enable_webserver_) {
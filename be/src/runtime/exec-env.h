@@ -97,6 +97,12 @@ class ExecEnv {
   RequestPoolService* request_pool_service() { return request_pool_service_.get(); }
   CallableThreadPool* rpc_pool() { return async_rpc_pool_.get(); }
 
+  /// Process-wide pool for the short, non-blocking tasks that query operators split
+  /// their work into, so that operators do not start threads of their own. Sized by
+  /// --num_query_task_threads. Submitters must not wait for a task while holding
+  /// resources that another task needs.
+  CallableThreadPool* query_task_pool() { return query_task_pool_.get(); }
+
   void set_enable_webserver(bool enable) { enable_webserver_ = enable; }
 
   ResourceBroker* resource_broker() { return resource_broker_.get(); }
@@ -145,6 +151,7 @@ class ExecEnv {
   boost::scoped_ptr<Frontend> frontend_;
   boost::scoped_ptr<CallableThreadPool> fragment_exec_thread_pool_;
   boost::scoped_ptr<CallableThreadPool> async_rpc_pool_;
+  boost::scoped_ptr<CallableThreadPool> query_task_pool_;
 
   /// Not owned by this class
   ImpalaServer* impala_server_;
@@ -12,6 +12,8 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
+#include <limits>
 #include <string>
 #include <gtest/gtest.h>
 
@@ -150,22 +152,71 @@ TEST(FreePoolTest, ReAlloc) {
   EXPECT_EQ(mem_pool.total_allocated_bytes(), 0);
 
   ptr = pool.Reallocate(ptr, 600);
-  EXPECT_EQ(mem_pool.total_allocated_bytes(), 1024 + 8);
+  EXPECT_EQ(mem_pool.total_allocated_bytes(), 640 + 8);
   uint8_t* ptr2 = pool.Reallocate(ptr, 200);
   EXPECT_TRUE(ptr == ptr2);
-  EXPECT_EQ(mem_pool.total_allocated_bytes(), 1024 + 8);
+  EXPECT_EQ(mem_pool.total_allocated_bytes(), 640 + 8);
 
   uint8_t* ptr3 = pool.Reallocate(ptr, 2000);
-  EXPECT_EQ(mem_pool.total_allocated_bytes(), 1024 + 8 + 2048 + 8);
+  EXPECT_EQ(mem_pool.total_allocated_bytes(), 640 + 8 + 2048 + 8);
   EXPECT_TRUE(ptr2 != ptr3);
 
   // The original 600 allocation should be there.
   ptr = pool.Allocate(600);
-  EXPECT_EQ(mem_pool.total_allocated_bytes(), 1024 + 8 + 2048 + 8);
+  EXPECT_EQ(mem_pool.total_allocated_bytes(), 640 + 8 + 2048 + 8);
 
   mem_pool.FreeAll();
 }
 
+TEST(FreePoolTest, SizeClasses) {
+  // Sizes up to 4 are rounded up to powers of 2, larger sizes to quarters of them.
+  int64_t expected_sizes[][2] = { {1, 1}, {2, 2}, {3, 4}, {4, 4}, {5, 5}, {8, 8},
+      {9, 10}, {17, 20}, {600, 640}, {1024, 1024}, {1025, 1280}, {2000, 2048},
+      {1000000, 1048576}, {1048577, 1310720} };
+  for (int i = 0; i < sizeof(expected_sizes) / sizeof(expected_sizes[0]); ++i) {
+    int64_t size = expected_sizes[i][0];
+    int idx = FreePool::SizeClass(size);
+    EXPECT_EQ(FreePool::ClassSize(idx), expected_sizes[i][1]) << size;
+    if (idx > 0) EXPECT_LT(FreePool::ClassSize(idx - 1), size) << size;
+  }
+  for (int idx = 1; idx < FreePool::SizeClass(numeric_limits<int>::max()); ++idx) {
+    EXPECT_EQ(FreePool::SizeClass(FreePool::ClassSize(idx)), idx);
+    EXPECT_EQ(FreePool::SizeClass(FreePool::ClassSize(idx - 1) + 1), idx);
+  }
+}
+
+// Large allocations are kept for reuse up to a limit, after which they are returned to
+// the system and the mem tracker.
+TEST(FreePoolTest, LargeAllocations) {
+  MemTracker tracker;
+  MemPool mem_pool(&tracker);
+  int64_t size = 2 * FreePool::LARGE_ALLOCATION_SIZE;
+  int64_t alloc_size = FreePool::ClassSize(FreePool::SizeClass(size)) + 8;
+  {
+    FreePool pool(&mem_pool);
+    const int num_allocations = FreePool::MAX_FREE_LARGE_ALLOCATIONS + 2;
+    vector<uint8_t*> ptrs;
+    for (int i = 0; i < num_allocations; ++i) {
+      ptrs.push_back(pool.Allocate(size));
+      ASSERT_TRUE(ptrs.back() != NULL);
+      memset(ptrs.back(), i, size);
+    }
+    EXPECT_EQ(mem_pool.total_allocated_bytes(), 0);
+    EXPECT_EQ(tracker.consumption(), num_allocations * alloc_size);
+
+    for (int i = 0; i < num_allocations; ++i) pool.Free(ptrs[i]);
+    EXPECT_EQ(tracker.consumption(), FreePool::MAX_FREE_LARGE_ALLOCATIONS * alloc_size);
+
+    uint8_t* ptr = pool.Allocate(size);
+    EXPECT_TRUE(find(ptrs.begin(), ptrs.end(), ptr) != ptrs.end());
+    EXPECT_EQ(pool.num_reused_allocations(), 1);
+    EXPECT_EQ(pool.num_allocations(), num_allocations + 1);
+    // 'ptr' is not freed, the destructor releases it.
+  }
+  EXPECT_EQ(tracker.consumption(), 0);
+  mem_pool.FreeAll();
+}
+
 }
 
 int main(int argc, char **argv) {
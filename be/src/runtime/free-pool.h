@@ -19,9 +19,11 @@
 #include <stdio.h>
 #include <string.h>
 #include <string>
+#include <boost/unordered_set.hpp>
 #include "common/logging.h"
 #include "gutil/bits.h"
 #include "runtime/mem-pool.h"
+#include "runtime/mem-tracker.h"
 #include "util/bit-util.h"
 
 DECLARE_int32(stress_free_pool_alloc);
@@ -30,26 +32,41 @@ DECLARE_bool(disable_mem_pools);
 namespace impala {
 
 /// Implementation of a free pool to recycle allocations. The pool is broken
-/// up into 64 lists, one for each power of 2. Each allocation is rounded up
-/// to the next power of 2. When the allocation is freed, it is added to the
-/// corresponding free list.
+/// up into size classes with one free list each. Sizes up to 4 bytes are rounded up
+/// to the next power of 2, and every larger power of 2 is divided into four classes,
+/// e.g. 640, 768, 896 and 1024 for sizes between 513 and 1024. Each allocation is
+/// rounded up to its class, which wastes at most 25% of it. When the allocation is
+/// freed, it is added to the corresponding free list.
 /// Each allocation has an 8 byte header that immediately precedes the actual
 /// allocation. If the allocation is owned by the user, the header contains
 /// the ptr to the list that it should be added to on Free().
 /// When the allocation is in the pool (i.e. available to be handed out), it
 /// contains the link to the next allocation.
+/// Allocations larger than LARGE_ALLOCATION_SIZE do not come from the MemPool, which
+/// would only release them when it is cleared. They are malloc'd and counted against
+/// the MemPool's tracker, and at most MAX_FREE_LARGE_ALLOCATIONS of each class are kept
+/// in its free list. Further ones are returned to the system and the tracker on Free().
 /// This has O(1) Allocate() and Free().
 /// This is not thread safe.
-/// TODO: consider integrating this with MemPool.
-/// TODO: consider changing to something more granular than doubling.
 class FreePool {
  public:
-  /// C'tor, initializes the FreePool to be empty. All allocations come from the
-  /// 'mem_pool'.
+  /// C'tor, initializes the FreePool to be empty. All allocations up to
+  /// LARGE_ALLOCATION_SIZE come from the 'mem_pool'.
   FreePool(MemPool* mem_pool)
     : mem_pool_(mem_pool),
-      net_allocations_(0) {
+      net_allocations_(0),
+      large_allocation_bytes_(0) {
     memset(&lists_, 0, sizeof(lists_));
+    memset(&free_list_lengths_, 0, sizeof(free_list_lengths_));
+    memset(&num_allocations_, 0, sizeof(num_allocations_));
+    memset(&num_reused_allocations_, 0, sizeof(num_reused_allocations_));
+  }
+
+  /// Returns the large allocations, including the ones that were not freed, to the
+  /// system.
+  ~FreePool() {
+    for (FreeListNode* node: large_allocations_) free(node);
+    if (large_allocation_bytes_ > 0) mem_tracker()->Release(large_allocation_bytes_);
   }
 
   /// Allocates a buffer of size.
@@ -67,15 +84,26 @@ class FreePool {
     /// This is the typical malloc behavior. NULL is reserved for failures.
     if (size == 0) return reinterpret_cast<uint8_t*>(0x1);
 
-    int free_list_idx = Bits::Log2Ceiling64(size);
+    int free_list_idx = SizeClass(size);
     DCHECK_LT(free_list_idx, NUM_LISTS);
+    ++num_allocations_[free_list_idx];
+    int64_t class_size = ClassSize(free_list_idx);
+    bool is_large = class_size > LARGE_ALLOCATION_SIZE;
 
     FreeListNode* allocation = lists_[free_list_idx].next;
     if (allocation == NULL) {
       // There wasn't an existing allocation of the right size, allocate a new one.
-      size = 1 << free_list_idx;
-      allocation = reinterpret_cast<FreeListNode*>(
-          mem_pool_->Allocate(size + sizeof(FreeListNode)));
+      int64_t alloc_size = class_size + sizeof(FreeListNode);
+      if (is_large) {
+        allocation = reinterpret_cast<FreeListNode*>(malloc(alloc_size));
+        if (LIKELY(allocation != NULL)) {
+          mem_tracker()->Consume(alloc_size);
+          large_allocation_bytes_ += alloc_size;
+          large_allocations_.insert(allocation);
+        }
+      } else {
+        allocation = reinterpret_cast<FreeListNode*>(mem_pool_->Allocate(alloc_size));
+      }
       if (UNLIKELY(allocation == NULL)) {
         --net_allocations_;
         return NULL;
@@ -83,11 +111,14 @@ class FreePool {
     } else {
       // Remove this allocation from the list.
       lists_[free_list_idx].next = allocation->next;
+      --free_list_lengths_[free_list_idx];
+      ++num_reused_allocations_[free_list_idx];
     }
     DCHECK(allocation != NULL);
     // Set the back node to point back to the list it came from so know where
-    // to add it on Free().
-    allocation->list = &lists_[free_list_idx];
+    // to add it on Free(). The lowest bit marks large allocations.
+    allocation->list = reinterpret_cast<FreeListNode*>(
+        reinterpret_cast<intptr_t>(&lists_[free_list_idx]) | (is_large ? 1 : 0));
     return reinterpret_cast<uint8_t*>(allocation) + sizeof(FreeListNode);
   }
 
@@ -99,13 +130,24 @@ class FreePool {
     }
     if (ptr == NULL || reinterpret_cast<int64_t>(ptr) == 0x1) return;
     FreeListNode* node = reinterpret_cast<FreeListNode*>(ptr - sizeof(FreeListNode));
-    FreeListNode* list = node->list;
+    FreeListNode* list = GetList(node);
 #ifndef NDEBUG
     CheckValidAllocation(list, ptr);
 #endif
+    int list_idx = list - &lists_[0];
+    if (IsLargeAllocation(node) &&
+        free_list_lengths_[list_idx] >= MAX_FREE_LARGE_ALLOCATIONS) {
+      int64_t alloc_size = ClassSize(list_idx) + sizeof(FreeListNode);
+      large_allocations_.erase(node);
+      free(node);
+      mem_tracker()->Release(alloc_size);
+      large_allocation_bytes_ -= alloc_size;
+      return;
+    }
     // Add node to front of list.
     node->next = list->next;
     list->next = node;
+    ++free_list_lengths_[list_idx];
   }
 
   /// Returns an allocation that is at least 'size'. If the current allocation backing
@@ -127,19 +169,19 @@ class FreePool {
     }
     if (ptr == NULL || reinterpret_cast<int64_t>(ptr) == 0x1) return Allocate(size);
     FreeListNode* node = reinterpret_cast<FreeListNode*>(ptr - sizeof(FreeListNode));
-    FreeListNode* list = node->list;
+    FreeListNode* list = GetList(node);
 #ifndef NDEBUG
     CheckValidAllocation(list, ptr);
 #endif
     int bucket_idx = (list - &lists_[0]);
     // This is the actual size of ptr.
-    int allocation_size = 1 << bucket_idx;
+    int64_t allocation_size = ClassSize(bucket_idx);
 
     // If it's already big enough, just return the ptr.
     if (allocation_size >= size) return ptr;
 
-    // Make a new one. Since Allocate() already rounds up to powers of 2, this effectively
-    // doubles for the caller.
+    // Make a new one. Allocate() rounds up to the next size class, so a buffer that is
+    // grown repeatedly grows by at least 25% each time.
     uint8_t* new_ptr = Allocate(size);
     if (LIKELY(new_ptr != NULL)) {
       memcpy(new_ptr, ptr, allocation_size);
@@ -151,8 +193,41 @@ class FreePool {
   MemTracker* mem_tracker() { return mem_pool_->mem_tracker(); }
   int64_t net_allocations() const { return net_allocations_; }
 
+  /// Returns the number of Allocate() calls, and the number of them that were served
+  /// from a free list, summed over all size classes.
+  int64_t num_allocations() const { return SumOverClasses(num_allocations_); }
+  int64_t num_reused_allocations() const {
+    return SumOverClasses(num_reused_allocations_);
+  }
+
+  /// Returns the index of the size class of allocations of 'size' > 0 bytes, and the
+  /// size of the allocations of class 'idx'.
+  static int SizeClass(int64_t size) {
+    DCHECK_GT(size, 0);
+    if (size <= 4) return Bits::Log2Ceiling64(size);
+    int log2 = Bits::Log2Floor64(size - 1);
+    int64_t step = 1LL << (log2 - 2);
+    int sub_class = ((size - (1LL << log2)) + step - 1) / step;
+    return 3 + (log2 - 2) * 4 + sub_class - 1;
+  }
+
+  static int64_t ClassSize(int idx) {
+    if (idx < 3) return 1LL << idx;
+    int log2 = (idx - 3) / 4 + 2;
+    int sub_class = (idx - 3) % 4 + 1;
+    return (1LL << log2) + sub_class * (1LL << (log2 - 2));
+  }
+
+  /// Allocations of larger classes are malloc'd instead of coming from the MemPool. This
+  /// is the size above which the MemPool gives allocations their own chunk.
+  static const int64_t LARGE_ALLOCATION_SIZE = 1024 * 1024;
+
+  /// Maximum number of freed large allocations of one class that are kept for reuse.
+  static const int MAX_FREE_LARGE_ALLOCATIONS = 4;
+
  private:
-  static const int NUM_LISTS = 64;
+  /// Four classes for every power of 2 above 4 bytes that an int can hold.
+  static const int NUM_LISTS = 3 + 4 * 30;
 
   struct FreeListNode {
     /// Union for clarity when manipulating the node.
@@ -162,6 +237,23 @@ class FreePool {
     };
   };
 
+  /// Returns the list that 'node', which is owned by the caller, came from.
+  static FreeListNode* GetList(FreeListNode* node) {
+    return reinterpret_cast<FreeListNode*>(
+        reinterpret_cast<intptr_t>(node->list) & ~static_cast<intptr_t>(1));
+  }
+
+  /// Returns true if 'node', which is owned by the caller, was malloc'd.
+  static bool IsLargeAllocation(FreeListNode* node) {
+    return (reinterpret_cast<intptr_t>(node->list) & 1) != 0;
+  }
+
+  static int64_t SumOverClasses(const int64_t* counts) {
+    int64_t sum = 0;
+    for (int i = 0; i < NUM_LISTS; ++i) sum += counts[i];
+    return sum;
+  }
+
   void CheckValidAllocation(FreeListNode* computed_list_ptr, uint8_t* allocation) const {
     // On debug, check that list is valid.
     bool found = false;
@@ -180,7 +272,8 @@ class FreePool {
     for (int i = 0; i < NUM_LISTS; ++i) {
       FreeListNode* n = lists_[i].next;
       if (n == NULL) continue;
-      ss << i << ": ";
+      ss << i << " (" << ClassSize(i) << " bytes, " << num_reused_allocations_[i]
+         << "/" << num_allocations_[i] << " reused): ";
       while (n != NULL) {
         uint8_t* ptr = reinterpret_cast<uint8_t*>(n);
         ptr += sizeof(FreeListNode);
@@ -196,13 +289,25 @@ class FreePool {
   /// MemPool to allocate from. Unowned.
   MemPool* mem_pool_;
 
-  /// One list head for each allocation size indexed by the LOG_2 of the allocation size.
-  /// While it doesn't make too much sense to use this for very small (e.g. 8 byte)
-  /// allocations, it makes the indexing easy.
+  /// One list head for each size class, indexed by SizeClass(). While it doesn't make
+  /// too much sense to use this for very small (e.g. 8 byte) allocations, it makes the
+  /// indexing easy.
   FreeListNode lists_[NUM_LISTS];
 
+  /// Number of allocations in each free list.
+  int free_list_lengths_[NUM_LISTS];
+
+  /// Per-class counts of Allocate() calls and of the ones served from the free list.
+  int64_t num_allocations_[NUM_LISTS];
+  int64_t num_reused_allocations_[NUM_LISTS];
+
   /// Diagnostic counter that tracks (# Allocates - # Frees)
   int64_t net_allocations_;
+
+  /// All malloc'd large allocations, whether they are owned by the caller or in a free
+  /// list, and their total size including headers.
+  boost::unordered_set<FreeListNode*> large_allocations_;
+  int64_t large_allocation_bytes_;
 };
 
 }
@@ -27,6 +27,7 @@ jclass HBaseTable::table_cl_ = NULL;
 jmethodID HBaseTable::table_close_id_ = NULL;
 jmethodID HBaseTable::table_get_scanner_id_ = NULL;
 jmethodID HBaseTable::table_put_id_ = NULL;
+jmethodID HBaseTable::table_get_id_ = NULL;
 
 jclass HBaseTable::connection_cl_ = NULL;
 jmethodID HBaseTable::connection_get_table_id_ = NULL;
@@ -34,14 +35,25 @@ jmethodID HBaseTable::connection_get_table_id_ = NULL;
 jclass HBaseTable::table_name_cl_ = NULL;
 jmethodID HBaseTable::table_name_value_of_id_ = NULL;
 
+jmethodID HBaseTable::connection_get_buffered_mutator_id_ = NULL;
+jclass HBaseTable::mutator_params_cl_ = NULL;
+jmethodID HBaseTable::mutator_params_ctor_ = NULL;
+jmethodID HBaseTable::mutator_params_write_buffer_size_id_ = NULL;
+jclass HBaseTable::mutator_cl_ = NULL;
+jmethodID HBaseTable::mutator_mutate_id_ = NULL;
+jmethodID HBaseTable::mutator_flush_id_ = NULL;
+jmethodID HBaseTable::mutator_close_id_ = NULL;
+
 HBaseTable::HBaseTable(const string& table_name, jobject connection)
     : table_name_(table_name),
       connection_(connection),
-      table_(NULL) {
+      table_(NULL),
+      mutator_(NULL) {
 }
 
 HBaseTable::~HBaseTable() {
   DCHECK(table_ == NULL) << "Must call Close()";
+  DCHECK(mutator_ == NULL) << "Must call Close()";
 }
 
 void HBaseTable::Close(RuntimeState* state) {
@@ -53,6 +65,14 @@ void HBaseTable::Close(RuntimeState* state) {
     state->LogError(ErrorMsg(
         TErrorCode::GENERAL, "HBaseTable::Close(): Error creating JNIEnv"));
   } else {
+    if (mutator_ != NULL) {
+      // Closing the mutator sends the puts that it still buffers.
+      env->CallVoidMethod(mutator_, mutator_close_id_);
+      Status s = JniUtil::GetJniExceptionMsg(env, "HBaseTable::Close(): ");
+      if (!s.ok()) state->LogError(s.msg());
+      s = JniUtil::FreeGlobalRef(env, mutator_);
+      if (!s.ok()) state->LogError(s.msg());
+    }
     env->CallObjectMethod(table_, table_close_id_);
     Status s = JniUtil::GetJniExceptionMsg(env, "HBaseTable::Close(): ");
     if (!s.ok()) state->LogError(s.msg());
@@ -61,6 +81,7 @@ void HBaseTable::Close(RuntimeState* state) {
   }
 
   table_ = NULL;
+  mutator_ = NULL;
 }
 
 Status HBaseTable::Init() {
@@ -89,6 +110,32 @@ Status HBaseTable::Init() {
   return Status::OK();
 }
 
+Status HBaseTable::InitBufferedMutator(int64_t write_buffer_size) {
+  DCHECK(mutator_ == NULL);
+  DCHECK_GT(write_buffer_size, 0);
+  JNIEnv* env = getJNIEnv();
+  if (env == NULL) return Status("Error creating JNIEnv");
+  JniLocalFrame jni_frame;
+  RETURN_IF_ERROR(jni_frame.push(env));
+
+  jstring jtable_name_string = env->NewStringUTF(table_name_.c_str());
+  RETURN_ERROR_IF_EXC(env);
+  jobject jtable_name = env->CallStaticObjectMethod(table_name_cl_,
+      table_name_value_of_id_, jtable_name_string);
+  RETURN_ERROR_IF_EXC(env);
+
+  jobject params = env->NewObject(mutator_params_cl_, mutator_params_ctor_, jtable_name);
+  RETURN_ERROR_IF_EXC(env);
+  params = env->CallObjectMethod(params, mutator_params_write_buffer_size_id_,
+      static_cast<jlong>(write_buffer_size));
+  RETURN_ERROR_IF_EXC(env);
+  jobject local_mutator = env->CallObjectMethod(connection_,
+      connection_get_buffered_mutator_id_, params);
+  RETURN_ERROR_IF_EXC(env);
+  RETURN_IF_ERROR(JniUtil::LocalToGlobalRef(env, local_mutator, &mutator_));
+  return Status::OK();
+}
+
 Status HBaseTable::InitJNI() {
   JNIEnv* env = getJNIEnv();
   if (env == NULL) {
@@ -120,6 +167,10 @@ Status HBaseTable::InitJNI() {
   table_put_id_ = env->GetMethodID(table_cl_, "put", "(Ljava/util/List;)V");
   RETURN_ERROR_IF_EXC(env);
 
+  table_get_id_ = env->GetMethodID(table_cl_, "get",
+      "(Ljava/util/List;)[Lorg/apache/hadoop/hbase/client/Result;");
+  RETURN_ERROR_IF_EXC(env);
+
   // Connection
   RETURN_IF_ERROR(
       JniUtil::GetGlobalClassRef(env,
@@ -130,6 +181,38 @@ Status HBaseTable::InitJNI() {
       "Lorg/apache/hadoop/hbase/client/Table;");
   RETURN_ERROR_IF_EXC(env);
 
+  connection_get_buffered_mutator_id_ = env->GetMethodID(connection_cl_,
+      "getBufferedMutator", "(Lorg/apache/hadoop/hbase/client/BufferedMutatorParams;)"
+      "Lorg/apache/hadoop/hbase/client/BufferedMutator;");
+  RETURN_ERROR_IF_EXC(env);
+
+  // BufferedMutatorParams
+  RETURN_IF_ERROR(
+      JniUtil::GetGlobalClassRef(env,
+        "org/apache/hadoop/hbase/client/BufferedMutatorParams", &mutator_params_cl_));
+
+  mutator_params_ctor_ = env->GetMethodID(mutator_params_cl_, "<init>",
+      "(Lorg/apache/hadoop/hbase/TableName;)V");
+  RETURN_ERROR_IF_EXC(env);
+
+  mutator_params_write_buffer_size_id_ = env->GetMethodID(mutator_params_cl_,
+      "writeBufferSize", "(J)Lorg/apache/hadoop/hbase/client/BufferedMutatorParams;");
+  RETURN_ERROR_IF_EXC(env);
+
+  // BufferedMutator
+  RETURN_IF_ERROR(
+      JniUtil::GetGlobalClassRef(env,
+        "org/apache/hadoop/hbase/client/BufferedMutator", &mutator_cl_));
+
+  mutator_mutate_id_ = env->GetMethodID(mutator_cl_, "mutate", "(Ljava/util/List;)V");
+  RETURN_ERROR_IF_EXC(env);
+
+  mutator_flush_id_ = env->GetMethodID(mutator_cl_, "flush", "()V");
+  RETURN_ERROR_IF_EXC(env);
+
+  mutator_close_id_ = env->GetMethodID(mutator_cl_, "close", "()V");
+  RETURN_ERROR_IF_EXC(env);
+
   return Status::OK();
 }
 
@@ -148,10 +231,32 @@ Status HBaseTable::Put(const jobject& puts_list) {
   JNIEnv* env = getJNIEnv();
   if (env == NULL) return Status("Error creating JNIEnv");
 
-  env->CallObjectMethod(table_, table_put_id_, puts_list);
+  if (mutator_ != NULL) {
+    env->CallVoidMethod(mutator_, mutator_mutate_id_, puts_list);
+  } else {
+    env->CallObjectMethod(table_, table_put_id_, puts_list);
+  }
+  RETURN_ERROR_IF_EXC(env);
+  return Status::OK();
+}
+
+Status HBaseTable::Flush() {
+  if (mutator_ == NULL) return Status::OK();
+  JNIEnv* env = getJNIEnv();
+  if (env == NULL) return Status("Error creating JNIEnv");
+
+  env->CallVoidMethod(mutator_, mutator_flush_id_);
   RETURN_ERROR_IF_EXC(env);
+  return Status::OK();
+}
+
+Status HBaseTable::Get(const jobject& gets_list, jobjectArray* results) {
+  JNIEnv* env = getJNIEnv();
+  if (env == NULL) return Status("Error creating JNIEnv");
 
-  // TODO(eclark): FlushCommits
+  *results = reinterpret_cast<jobjectArray>(
+      env->CallObjectMethod(table_, table_get_id_, gets_list));
+  RETURN_ERROR_IF_EXC(env);
   return Status::OK();
 }
 
@@ -37,13 +37,26 @@ class HBaseTable {
   /// Create all needed java side objects.
   Status Init();
 
+  /// Makes Put() hand the puts to a BufferedMutator with a client-side write buffer of
+  /// 'write_buffer_size' bytes instead of sending them with Table.put(). The mutator
+  /// sends the buffered puts in the background whenever the buffer is full.
+  Status InitBufferedMutator(int64_t write_buffer_size);
+
   /// From a java Scan object get a result scanner that will iterate over
   /// KeyValues from HBase.
   Status GetResultScanner(const jobject& scan, jobject* result_scanner);
 
-  /// Send an list of puts to hbase through a Table.
+  /// Send an list of puts to hbase through a Table, or buffer them if there is a
+  /// BufferedMutator. Errors of buffered puts are returned by a later Put() or Flush().
   Status Put(const jobject& puts_list);
 
+  /// Waits until all buffered puts are sent. A no-op without a BufferedMutator.
+  Status Flush();
+
+  /// Fetch the rows of a list of Gets with a single multi-get. 'results' is set to the
+  /// Result[] with one (possibly empty) Result per Get, in the order of 'gets_list'.
+  Status Get(const jobject& gets_list, jobjectArray* results);
+
   /// Call this to initialize the HBase Table jni references
   static Status InitJNI();
 
@@ -52,6 +65,10 @@ class HBaseTable {
   jobject connection_;
   jobject table_;
 
+  /// BufferedMutator for Put() that was set up by InitBufferedMutator(). NULL if the
+  /// puts are sent through 'table_'.
+  jobject mutator_;
+
   /// org.apache.hadoop.hbase.client.Table
   static jclass table_cl_;
 
@@ -70,11 +87,30 @@ class HBaseTable {
   /// table.put(List<Put> puts
   static jmethodID table_put_id_;
 
+  /// table.get(List<Get> gets)
+  static jmethodID table_get_id_;
+
   /// TableName class and static methods
   static jclass table_name_cl_;
 
   /// TableName.valueOf(String)
   static jmethodID table_name_value_of_id_;
+
+  /// connection.getBufferedMutator(BufferedMutatorParams)
+  static jmethodID connection_get_buffered_mutator_id_;
+
+  /// BufferedMutatorParams class, new BufferedMutatorParams(TableName) and
+  /// params.writeBufferSize(long)
+  static jclass mutator_params_cl_;
+  static jmethodID mutator_params_ctor_;
+  static jmethodID mutator_params_write_buffer_size_id_;
+
+  /// BufferedMutator class, mutator.mutate(List<Mutation>), mutator.flush() and
+  /// mutator.close()
+  static jclass mutator_cl_;
+  static jmethodID mutator_mutate_id_;
+  static jmethodID mutator_flush_id_;
+  static jmethodID mutator_close_id_;
 };
 
 }  // namespace impala
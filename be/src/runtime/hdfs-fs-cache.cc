@@ -14,6 +14,7 @@
 
 #include "runtime/hdfs-fs-cache.h"
 
+#include <boost/lexical_cast.hpp>
 #include <boost/thread/locks.hpp>
 #include <gutil/strings/substitute.h>
 
@@ -36,6 +37,16 @@ DEFINE_string(s3a_access_key_cmd, "", "A Unix command whose output returns the "
 DEFINE_string(s3a_secret_key_cmd, "", "A Unix command whose output returns the "
     "secret key to S3, i.e. \"fs.s3a.secret.key\".");
 
+DEFINE_int32(hdfs_hedged_read_threadpool_size, 0, "Size of the thread pool of the HDFS "
+    "client for hedged reads, i.e. \"dfs.client.hedged.read.threadpool.size\". If "
+    "greater than 0, a positional read from a DataNode that does not respond within "
+    "--hdfs_hedged_read_threshold_ms is also issued to another replica and the first "
+    "response is used. 0 disables hedged reads.");
+
+DEFINE_int32(hdfs_hedged_read_threshold_ms, 500, "Time in milliseconds after which a "
+    "read from a DataNode is hedged, i.e. \"dfs.client.hedged.read.threshold.millis\". "
+    "Only used if --hdfs_hedged_read_threadpool_size is greater than 0.");
+
 scoped_ptr<HdfsFsCache> HdfsFsCache::instance_;
 string HdfsFsCache::s3a_access_key_;
 string HdfsFsCache::s3a_secret_key_;
@@ -94,6 +105,20 @@ Status HdfsFsCache::GetConnection(const string& path, hdfsFS* fs,
         hdfsBuilderConfSetStr(hdfs_builder, "fs.s3a.access.key", s3a_access_key_.c_str());
         hdfsBuilderConfSetStr(hdfs_builder, "fs.s3a.secret.key", s3a_secret_key_.c_str());
       }
+      // The builder keeps pointers to the configuration values until
+      // hdfsBuilderConnect().
+      const string pool_size = lexical_cast<string>(
+          FLAGS_hdfs_hedged_read_threadpool_size);
+      const string threshold_ms = lexical_cast<string>(
+          FLAGS_hdfs_hedged_read_threshold_ms);
+      if (FLAGS_hdfs_hedged_read_threadpool_size > 0) {
+        // As above, a cached filesystem object would ignore the configuration.
+        hdfsBuilderSetForceNewInstance(hdfs_builder);
+        hdfsBuilderConfSetStr(hdfs_builder, "dfs.client.hedged.read.threadpool.size",
+            pool_size.c_str());
+        hdfsBuilderConfSetStr(hdfs_builder, "dfs.client.hedged.read.threshold.millis",
+            threshold_ms.c_str());
+      }
       *fs = hdfsBuilderConnect(hdfs_builder);
       if (*fs == NULL) {
         return Status(GetHdfsErrorMsg("Failed to connect to FS: ", namenode));
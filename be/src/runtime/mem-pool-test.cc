@@ -18,9 +18,12 @@
 #include "runtime/mem-pool.h"
 #include "runtime/mem-tracker.h"
 #include "util/bit-util.h"
+#include "util/memory-metrics.h"
 
 #include "common/names.h"
 
+DECLARE_int64(mem_pool_mmap_chunk_size);
+
 namespace impala {
 
 // Utility class to call private functions on MemPool.
@@ -157,6 +160,32 @@ TEST(MemPoolTest, Keep) {
   p2.FreeAll();
 }
 
+// Tests that Recycle() keeps the first chunks up to the limit and frees the others.
+TEST(MemPoolTest, Recycle) {
+  MemTracker tracker;
+  MemPool p(&tracker);
+  p.Allocate(4*1024);
+  p.Allocate(8*1024);
+  p.Allocate(16*1024);
+  EXPECT_EQ((4 + 8 + 16) * 1024, tracker.consumption());
+  p.Recycle(20 * 1024);
+  EXPECT_EQ(0, p.total_allocated_bytes());
+  EXPECT_EQ((4 + 8) * 1024, p.GetTotalChunkSizes());
+  EXPECT_EQ((4 + 8) * 1024, p.total_reserved_bytes());
+  EXPECT_EQ((4 + 8) * 1024, tracker.consumption());
+
+  // The retained chunks are reused.
+  p.Allocate(4*1024);
+  p.Allocate(8*1024);
+  EXPECT_EQ((4 + 8) * 1024, p.total_allocated_bytes());
+  EXPECT_EQ((4 + 8) * 1024, p.GetTotalChunkSizes());
+
+  p.Recycle(0);
+  EXPECT_EQ(0, p.GetTotalChunkSizes());
+  EXPECT_EQ(0, tracker.consumption());
+  p.FreeAll();
+}
+
 // Tests that we can return partial allocations.
 TEST(MemPoolTest, ReturnPartial) {
   MemTracker tracker;
@@ -394,6 +423,54 @@ TEST(MemPoolTest, FragmentationOverhead) {
   p.FreeAll();
 }
 
+// Test that chunks of at least --mem_pool_mmap_chunk_size are mapped directly and
+// unmapped when they are freed.
+TEST(MemPoolTest, MmappedChunks) {
+  FLAGS_mem_pool_mmap_chunk_size = 1024 * 1024;
+  MemTracker tracker;
+  MemPool p(&tracker);
+  int64_t mmapped_bytes = TcmallocMetric::MMAPPED_BYTES.Load();
+
+  // Small chunks are still allocated with malloc().
+  uint8_t* ptr = p.Allocate(8);
+  EXPECT_TRUE(ptr != NULL);
+  EXPECT_EQ(mmapped_bytes, TcmallocMetric::MMAPPED_BYTES.Load());
+
+  ptr = p.Allocate(2 * 1024 * 1024);
+  EXPECT_TRUE(ptr != NULL);
+  memset(ptr, 0, 2 * 1024 * 1024);
+  EXPECT_EQ(mmapped_bytes + p.GetTotalChunkSizes() - MemPoolTest::INITIAL_CHUNK_SIZE,
+      TcmallocMetric::MMAPPED_BYTES.Load());
+  EXPECT_EQ(p.GetTotalChunkSizes(), tracker.consumption());
+
+  p.FreeAll();
+  EXPECT_EQ(mmapped_bytes, TcmallocMetric::MMAPPED_BYTES.Load());
+  EXPECT_EQ(0, tracker.consumption());
+  FLAGS_mem_pool_mmap_chunk_size = 0;
+}
+
+}
+
+// Tests that only the last allocation of the current chunk is extended in place.
+TEST(MemPoolTest, ExtendAllocation) {
+  MemTracker tracker;
+  MemPool p(&tracker);
+  uint8_t* ptr = p.Allocate(100);
+  EXPECT_TRUE(p.TryExtendAllocation(ptr, 100, 200));
+  EXPECT_EQ(200, p.total_allocated_bytes());
+  uint8_t* ptr2 = p.Allocate(8);
+  EXPECT_TRUE(ptr2 == ptr + 200);
+
+  // 'ptr' is no longer the last allocation.
+  EXPECT_FALSE(p.TryExtendAllocation(ptr, 200, 400));
+  EXPECT_EQ(208, p.total_allocated_bytes());
+
+  // The current chunk does not have enough spare capacity.
+  EXPECT_FALSE(p.TryExtendAllocation(ptr2, 8, p.GetTotalChunkSizes()));
+  EXPECT_TRUE(p.TryExtendAllocation(ptr2, 8, p.GetTotalChunkSizes() - 200));
+  EXPECT_EQ(p.GetTotalChunkSizes(), p.total_allocated_bytes());
+  EXPECT_EQ(p.GetTotalChunkSizes(), tracker.consumption());
+  p.FreeAll();
 }
 
 int main(int argc, char **argv) {
@@ -15,11 +15,14 @@
 #include "runtime/mem-pool.h"
 #include "runtime/mem-tracker.h"
 #include "util/bit-util.h"
+#include "util/error-util.h"
 #include "util/impalad-metrics.h"
+#include "util/memory-metrics.h"
 
 #include <algorithm>
 #include <stdio.h>
 #include <sstream>
+#include <sys/mman.h>
 
 #include "common/names.h"
 
@@ -28,6 +31,10 @@ using namespace impala;
 #define MEM_POOL_POISON (0x66aa77bb)
 
 DECLARE_bool(disable_mem_pools);
+DECLARE_int64(mem_pool_mmap_chunk_size);
+
+// Chunks of at least this size are backed by huge pages if they are mmap'd.
+static const int64_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
 
 const int MemPool::INITIAL_CHUNK_SIZE;
 const int MemPool::MAX_CHUNK_SIZE;
@@ -46,10 +53,11 @@ MemPool::MemPool(MemTracker* mem_tracker)
   DCHECK_EQ(zero_length_region_, MEM_POOL_POISON);
 }
 
-MemPool::ChunkInfo::ChunkInfo(int64_t size, uint8_t* buf)
+MemPool::ChunkInfo::ChunkInfo(int64_t size, uint8_t* buf, bool mmapped)
   : data(buf),
     size(size),
-    allocated_bytes(0) {
+    allocated_bytes(0),
+    mmapped(mmapped) {
   if (ImpaladMetrics::MEM_POOL_TOTAL_BYTES != NULL) {
     ImpaladMetrics::MEM_POOL_TOTAL_BYTES->Increment(size);
   }
@@ -59,7 +67,7 @@ MemPool::~MemPool() {
   int64_t total_bytes_released = 0;
   for (size_t i = 0; i < chunks_.size(); ++i) {
     total_bytes_released += chunks_[i].size;
-    free(chunks_[i].data);
+    FreeChunkData(chunks_[i]);
   }
 
   DCHECK(chunks_.empty()) << "Must call FreeAll() or AcquireData() for this pool";
@@ -79,11 +87,40 @@ void MemPool::Clear() {
   DCHECK(CheckIntegrity(false));
 }
 
+void MemPool::Recycle(int64_t max_retained_bytes) {
+  int num_retained_chunks = 0;
+  int64_t retained_bytes = 0;
+  while (num_retained_chunks < chunks_.size() &&
+      retained_bytes + chunks_[num_retained_chunks].size <= max_retained_bytes) {
+    retained_bytes += chunks_[num_retained_chunks].size;
+    ++num_retained_chunks;
+  }
+  // With --disable_mem_pools, freed memory must not be reused so that ASAN detects
+  // accesses to it.
+  if (num_retained_chunks == 0 || FLAGS_disable_mem_pools) {
+    FreeAll();
+    return;
+  }
+
+  int64_t total_bytes_released = 0;
+  for (size_t i = num_retained_chunks; i < chunks_.size(); ++i) {
+    total_bytes_released += chunks_[i].size;
+    FreeChunkData(chunks_[i]);
+  }
+  chunks_.erase(chunks_.begin() + num_retained_chunks, chunks_.end());
+  total_reserved_bytes_ -= total_bytes_released;
+  mem_tracker_->Release(total_bytes_released);
+  if (ImpaladMetrics::MEM_POOL_TOTAL_BYTES != NULL) {
+    ImpaladMetrics::MEM_POOL_TOTAL_BYTES->Increment(-total_bytes_released);
+  }
+  Clear();
+}
+
 void MemPool::FreeAll() {
   int64_t total_bytes_released = 0;
   for (size_t i = 0; i < chunks_.size(); ++i) {
     total_bytes_released += chunks_[i].size;
-    free(chunks_[i].data);
+    FreeChunkData(chunks_[i]);
   }
   chunks_.clear();
   next_chunk_size_ = INITIAL_CHUNK_SIZE;
@@ -142,8 +179,9 @@ bool MemPool::FindChunk(int64_t min_size, bool check_limits) noexcept {
       mem_tracker_->Consume(chunk_size);
     }
 
-    // Allocate a new chunk. Return early if malloc fails.
-    uint8_t* buf = reinterpret_cast<uint8_t*>(malloc(chunk_size));
+    // Allocate a new chunk. Return early if the allocation fails.
+    bool mmapped;
+    uint8_t* buf = AllocateChunkData(chunk_size, &mmapped);
     if (UNLIKELY(buf == NULL)) {
       mem_tracker_->Release(chunk_size);
       DCHECK_EQ(current_chunk_idx_, static_cast<int>(chunks_.size()));
@@ -153,11 +191,11 @@ bool MemPool::FindChunk(int64_t min_size, bool check_limits) noexcept {
 
     // If there are no free chunks put it at the end, otherwise before the first free.
     if (first_free_idx == static_cast<int>(chunks_.size())) {
-      chunks_.push_back(ChunkInfo(chunk_size, buf));
+      chunks_.push_back(ChunkInfo(chunk_size, buf, mmapped));
     } else {
       current_chunk_idx_ = first_free_idx;
       vector<ChunkInfo>::iterator insert_chunk = chunks_.begin() + current_chunk_idx_;
-      chunks_.insert(insert_chunk, ChunkInfo(chunk_size, buf));
+      chunks_.insert(insert_chunk, ChunkInfo(chunk_size, buf, mmapped));
     }
     total_reserved_bytes_ += chunk_size;
     // Don't increment the chunk size until the allocation succeeds: if an attempted
@@ -170,6 +208,37 @@ bool MemPool::FindChunk(int64_t min_size, bool check_limits) noexcept {
   return true;
 }
 
+uint8_t* MemPool::AllocateChunkData(int64_t size, bool* mmapped) {
+  *mmapped = false;
+  if (FLAGS_mem_pool_mmap_chunk_size <= 0 || size < FLAGS_mem_pool_mmap_chunk_size ||
+      FLAGS_disable_mem_pools) {
+    return reinterpret_cast<uint8_t*>(malloc(size));
+  }
+  void* buf =
+      mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (UNLIKELY(buf == MAP_FAILED)) {
+    // Fall back to malloc, which may still find the memory in its free lists.
+    return reinterpret_cast<uint8_t*>(malloc(size));
+  }
+#ifdef MADV_HUGEPAGE
+  // Failure only means that the chunk is backed by regular pages.
+  if (size >= HUGE_PAGE_SIZE) madvise(buf, size, MADV_HUGEPAGE);
+#endif
+  *mmapped = true;
+  TcmallocMetric::MMAPPED_BYTES.Add(size);
+  return reinterpret_cast<uint8_t*>(buf);
+}
+
+void MemPool::FreeChunkData(const ChunkInfo& chunk) {
+  if (!chunk.mmapped) {
+    free(chunk.data);
+    return;
+  }
+  int ret = munmap(chunk.data, chunk.size);
+  DCHECK_EQ(ret, 0) << "munmap() failed: " << GetStrErrMsg();
+  TcmallocMetric::MMAPPED_BYTES.Add(-chunk.size);
+}
+
 void MemPool::AcquireData(MemPool* src, bool keep_current) {
   DCHECK(src->CheckIntegrity(false));
   int num_acquired_chunks;
@@ -110,9 +110,31 @@ class MemPool {
     total_allocated_bytes_ -= byte_size;
   }
 
+  /// Grows the allocation 'ptr' of 'size' bytes to 'new_size' bytes without moving it.
+  /// Only succeeds if 'ptr' is the previous allocation returned by Allocate() and the
+  /// current chunk has enough spare capacity. Returns false otherwise, in which case the
+  /// allocation is unchanged.
+  bool TryExtendAllocation(uint8_t* ptr, int64_t size, int64_t new_size) noexcept {
+    DCHECK_GE(new_size, size);
+    if (current_chunk_idx_ == -1) return false;
+    ChunkInfo& info = chunks_[current_chunk_idx_];
+    int64_t num_bytes = BitUtil::RoundUp(size, 8);
+    if (ptr + num_bytes != info.data + info.allocated_bytes) return false;
+    int64_t extra_bytes = BitUtil::RoundUp(new_size, 8) - num_bytes;
+    if (info.allocated_bytes + extra_bytes > info.size) return false;
+    info.allocated_bytes += extra_bytes;
+    total_allocated_bytes_ += extra_bytes;
+    peak_allocated_bytes_ = std::max(total_allocated_bytes_, peak_allocated_bytes_);
+    return true;
+  }
+
   /// Makes all allocated chunks available for re-use, but doesn't delete any chunks.
   void Clear();
 
+  /// Like Clear(), but only keeps the first chunks that hold at most
+  /// 'max_retained_bytes' in total and deletes the others.
+  void Recycle(int64_t max_retained_bytes);
+
   /// Deletes all allocated chunks. FreeAll() or AcquireData() must be called for
   /// each mem pool
   void FreeAll();
@@ -151,12 +173,16 @@ class MemPool {
     /// bytes allocated via Allocate() in this chunk
     int64_t allocated_bytes;
 
-    explicit ChunkInfo(int64_t size, uint8_t* buf);
+    /// True if 'data' was mapped with mmap() rather than malloc'd.
+    bool mmapped;
+
+    explicit ChunkInfo(int64_t size, uint8_t* buf, bool mmapped);
 
     ChunkInfo()
       : data(NULL),
         size(0),
-        allocated_bytes(0) {}
+        allocated_bytes(0),
+        mmapped(false) {}
   };
 
   /// A static field used as non-NULL pointer for zero length allocations.
@@ -195,6 +221,12 @@ class MemPool {
   /// new chunk exceeds the mem limits.
   bool FindChunk(int64_t min_size, bool check_limits) noexcept;
 
+  /// Allocates the memory for a chunk of 'size' bytes, with mmap() if it is at least
+  /// --mem_pool_mmap_chunk_size and with malloc() otherwise, and sets 'mmapped'
+  /// accordingly. Returns NULL if the allocation fails. FreeChunkData() frees it.
+  static uint8_t* AllocateChunkData(int64_t size, bool* mmapped);
+  static void FreeChunkData(const ChunkInfo& chunk);
+
   /// Check integrity of the supporting data structures; always returns true but DCHECKs
   /// all invariants.
   /// If 'current_chunk_empty' is false, checks that the current chunk contains data.
@@ -107,6 +107,36 @@ TEST(MemTestTest, ConsumptionMetric) {
   t.Consume(-1);
 }
 
+// Consumption of children of a tracker with a consumption metric is batched before it
+// is added to the parent, and the parent is synced to the metric when it is refreshed.
+TEST(MemTestTest, ConsumptionMetricChild) {
+  TMetricDef md;
+  md.__set_key("test");
+  md.__set_units(TUnit::BYTES);
+  md.__set_kind(TMetricKind::GAUGE);
+  UIntGauge metric(md, 0);
+  MemTracker p(&metric, -1, -1, "");
+  MemTracker c(-1, -1, "", &p);
+
+  // Small consumption is not visible in the parent yet.
+  c.Consume(10);
+  EXPECT_EQ(c.consumption(), 10);
+  EXPECT_EQ(p.consumption(), 0);
+  // Large consumption is.
+  c.Consume(1024 * 1024);
+  EXPECT_EQ(c.consumption(), 1024 * 1024 + 10);
+  EXPECT_GE(p.consumption(), 1024 * 1024);
+
+  metric.Increment(100);
+  p.RefreshConsumptionFromMetric();
+  EXPECT_EQ(p.consumption(), 100);
+  c.Release(1024 * 1024 + 10);
+  EXPECT_EQ(c.consumption(), 0);
+  metric.Increment(-100);
+  p.RefreshConsumptionFromMetric();
+  EXPECT_EQ(p.consumption(), 0);
+}
+
 TEST(MemTestTest, TrackerHierarchy) {
   MemTracker p(100);
   MemTracker c1(80, -1, "", &p);
@@ -25,6 +25,7 @@
 #include "util/debug-util.h"
 #include "util/mem-info.h"
 #include "util/pretty-printer.h"
+#include "util/time.h"
 #include "util/uid-util.h"
 
 #include "common/names.h"
@@ -98,6 +99,7 @@ MemTracker::MemTracker(UIntGauge* consumption_metric,
     consumption_(&local_counter_),
     local_counter_(TUnit::BYTES),
     consumption_metric_(consumption_metric),
+    pending_consumption_(new PendingConsumption[NUM_PENDING_CONSUMPTION_SHARDS]),
     auto_unregister_(false),
     enable_logging_(false),
     log_stack_(false),
@@ -243,6 +245,12 @@ void MemTracker::RegisterMetrics(MetricGroup* metrics, const string& prefix) {
 void MemTracker::RefreshConsumptionFromMetric() {
   DCHECK(consumption_metric_ != NULL);
   DCHECK(parent_ == NULL);
+  // The metric already reflects the pending consumption.
+  for (int i = 0; i < NUM_PENDING_CONSUMPTION_SHARDS; ++i) {
+    AtomicInt64* shard = &pending_consumption_[i].bytes;
+    int64_t pending = shard->Load();
+    while (pending != 0 && !shard->CompareAndSwap(pending, 0)) pending = shard->Load();
+  }
   consumption_->Set(consumption_metric_->value());
 }
 
@@ -313,6 +321,7 @@ bool MemTracker::GcMemory(int64_t max_consumption) {
   // Check if someone gc'd before us
   if (pre_gc_consumption < max_consumption) return false;
   if (num_gcs_metric_ != NULL) num_gcs_metric_->Increment(1);
+  last_gc_ms_.Store(MonotonicMillis());
 
   // Try to free up some memory
   for (int i = 0; i < gc_functions_.size(); ++i) {
@@ -19,6 +19,7 @@
 #include <stdint.h>
 #include <map>
 #include <vector>
+#include <boost/scoped_array.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/weak_ptr.hpp>
 #include <boost/thread/mutex.hpp>
@@ -26,6 +27,8 @@
 
 #include "common/logging.h"
 #include "common/atomic.h"
+#include "gutil/port.h"
+#include "util/cpu-info.h"
 #include "util/debug-util.h"
 #include "util/internal-queue.h"
 #include "util/metrics.h"
@@ -128,9 +131,11 @@ class MemTracker {
     if (UNLIKELY(enable_logging_)) LogUpdate(true, bytes);
     for (std::vector<MemTracker*>::iterator tracker = all_trackers_.begin();
          tracker != all_trackers_.end(); ++tracker) {
-      (*tracker)->consumption_->Add(bytes);
       if ((*tracker)->consumption_metric_ == NULL) {
+        (*tracker)->consumption_->Add(bytes);
         DCHECK_GE((*tracker)->consumption_->current_value(), 0);
+      } else {
+        (*tracker)->AddPendingConsumption(bytes);
       }
     }
   }
@@ -233,6 +238,10 @@ class MemTracker {
     if (UNLIKELY(enable_logging_)) LogUpdate(false, bytes);
     for (std::vector<MemTracker*>::iterator tracker = all_trackers_.begin();
          tracker != all_trackers_.end(); ++tracker) {
+      if ((*tracker)->consumption_metric_ != NULL) {
+        (*tracker)->AddPendingConsumption(-bytes);
+        continue;
+      }
       (*tracker)->consumption_->Add(-bytes);
       /// If a UDF calls FunctionContext::TrackAllocation() but allocates less than the
       /// reported amount, the subsequent call to FunctionContext::Free() may cause the
@@ -289,6 +298,22 @@ class MemTracker {
   /// null.
   void RefreshConsumptionFromMetric();
 
+  /// Adds 'bytes' to the pending consumption of the current core, and moves it to
+  /// consumption_ if it got large enough. Only valid to call if consumption_metric_ is
+  /// not null.
+  void AddPendingConsumption(int64_t bytes) {
+    DCHECK(pending_consumption_.get() != NULL);
+    AtomicInt64* shard = &pending_consumption_[
+        CpuInfo::GetCurrentCore() % NUM_PENDING_CONSUMPTION_SHARDS].bytes;
+    int64_t pending = shard->Add(bytes);
+    if (pending < PENDING_CONSUMPTION_FLUSH_BYTES &&
+        pending > -PENDING_CONSUMPTION_FLUSH_BYTES) {
+      return;
+    }
+    // If another thread changed the shard in the meantime, a later call flushes it.
+    if (shard->CompareAndSwap(pending, 0)) consumption_->Add(pending);
+  }
+
   int64_t limit() const { return limit_; }
   bool has_limit() const { return limit_ >= 0; }
   const std::string& label() const { return label_; }
@@ -329,6 +354,10 @@ class MemTracker {
   /// Note that 'f' must be valid for the lifetime of this MemTracker.
   void AddGcFunction(GcFunction f) { gc_functions_.push_back(f); }
 
+  /// Returns the time in ms (see MonotonicMillis()) when the GcFunctions were last
+  /// called because the limit was reached, or 0 if they were never called.
+  int64_t last_gc_ms() const { return last_gc_ms_.Load(); }
+
   /// Register this MemTracker's metrics. Each key will be of the form
   /// "<prefix>.<metric name>".
   void RegisterMetrics(MetricGroup* metrics, const std::string& prefix);
@@ -399,6 +428,9 @@ class MemTracker {
   /// Lock to protect GcMemory(). This prevents many GCs from occurring at once.
   boost::mutex gc_lock_;
 
+  /// See last_gc_ms(). Set by GcMemory().
+  AtomicInt64 last_gc_ms_;
+
   /// Protects request_to_mem_trackers_ and pool_to_mem_trackers_.
   /// IMPALA-3068: Use SpinLock instead of boost::mutex so that it won't automatically
   /// destroy itself as part of process teardown, which could cause races.
@@ -446,6 +478,21 @@ class MemTracker {
   /// NULL if consumption_metric_ is set.
   UIntGauge* consumption_metric_;
 
+  /// Consume() and Release() on descendants of a tracker with a consumption metric,
+  /// i.e. the process tracker, would otherwise update its consumption_ from all threads.
+  /// Instead they add to the shard of the current core here, and a shard is only moved
+  /// to consumption_ once it holds at least PENDING_CONSUMPTION_FLUSH_BYTES. The
+  /// consumption_ of such a tracker therefore lags by at most
+  /// NUM_PENDING_CONSUMPTION_SHARDS * PENDING_CONSUMPTION_FLUSH_BYTES until it is next
+  /// refreshed from the metric, which is the source of truth for its limit checks.
+  /// TryConsume() still updates consumption_ directly. NULL for other trackers.
+  struct PendingConsumption {
+    AtomicInt64 bytes;
+  } CACHELINE_ALIGNED;
+  static const int NUM_PENDING_CONSUMPTION_SHARDS = 64;
+  static const int64_t PENDING_CONSUMPTION_FLUSH_BYTES = 64 * 1024;
+  boost::scoped_array<PendingConsumption> pending_consumption_;
+
   std::vector<MemTracker*> all_trackers_;  // this tracker plus all of its ancestors
   std::vector<MemTracker*> limit_trackers_;  // all_trackers_ with valid limits
 
@@ -38,8 +38,11 @@
 #include "scheduling/query-resource-mgr.h"
 #include "util/cgroups-mgr.h"
 #include "util/cpu-info.h"
+#include "util/cpu-sampler.h"
 #include "util/debug-util.h"
 #include "util/container-util.h"
+#include "util/histogram-metric.h"
+#include "util/impalad-metrics.h"
 #include "util/parse-util.h"
 #include "util/mem-info.h"
 #include "util/periodic-counter-updater.h"
@@ -84,6 +87,7 @@ Status PlanFragmentExecutor::Prepare(const TExecPlanFragmentParams& request) {
   lock_guard<mutex> l(prepare_lock_);
   DCHECK(!is_prepared_);
   if (is_cancelled_) return Status::CANCELLED;
+  ScopedHistogramTimer prepare_latency(ImpaladMetrics::FRAGMENT_PREPARE_DURATIONS);
 
   is_prepared_ = true;
   // TODO: Break this method up.
@@ -106,6 +110,17 @@ Status PlanFragmentExecutor::Prepare(const TExecPlanFragmentParams& request) {
   string cgroup = "";
   if (FLAGS_enable_rm && request_has_reserved_resource) {
     cgroup = exec_env_->cgroups_mgr()->UniqueIdToCgroup(PrintId(query_id_, "_"));
+  } else if (!FLAGS_enable_rm && exec_env_->cgroups_mgr() != NULL &&
+      exec_env_->cgroups_mgr()->pool_cgroups_enabled()) {
+    // CPU isolation is best effort, so the fragment runs without it if the cgroup of
+    // its pool cannot be set up.
+    Status status = exec_env_->cgroups_mgr()->GetPoolCgroup(
+        fragment_instance_ctx.request_pool, &cgroup);
+    if (!status.ok()) {
+      LOG(WARNING) << "Could not set up the cgroup of request pool "
+                   << fragment_instance_ctx.request_pool << ": " << status.GetDetail();
+      cgroup.clear();
+    }
   }
 
   // Prepare() must not return before runtime_state_ is set if is_prepared_ was
@@ -179,6 +194,8 @@ Status PlanFragmentExecutor::Prepare(const TExecPlanFragmentParams& request) {
   DCHECK(!fragment_instance_ctx.request_pool.empty());
   runtime_state_->InitMemTrackers(query_id_, &fragment_instance_ctx.request_pool,
       bytes_limit, rm_reservation_size_bytes);
+  exec_env_->thread_mgr()->SetRequestPool(runtime_state_->resource_pool(),
+      fragment_instance_ctx.request_pool);
   RETURN_IF_ERROR(runtime_state_->CreateBlockMgr());
   runtime_state_->InitFilterBank();
 
@@ -279,7 +296,8 @@ Status PlanFragmentExecutor::Prepare(const TExecPlanFragmentParams& request) {
   per_host_mem_usage_ =
       ADD_COUNTER(profile(), PER_HOST_PEAK_MEM_COUNTER, TUnit::BYTES);
 
-  row_batch_.reset(new RowBatch(plan_->row_desc(), runtime_state_->batch_size(),
+  row_batch_.reset(new RowBatch(plan_->row_desc(),
+        RowBatch::AdaptiveCapacity(plan_->row_desc(), runtime_state_->batch_size()),
         runtime_state_->instance_mem_tracker()));
   VLOG(2) << "plan_root=\n" << plan_->DebugString();
   return Status::OK();
@@ -333,6 +351,7 @@ Status PlanFragmentExecutor::Open() {
     report_thread_active_ = true;
   }
 
+  ScopedCpuSampleQuery sample_query(query_id_);
   OptimizeLlvmModule();
 
   Status status = OpenInternal();
@@ -363,6 +382,7 @@ Status PlanFragmentExecutor::Open() {
 Status PlanFragmentExecutor::OpenInternal() {
   {
     SCOPED_TIMER(profile()->total_time_counter());
+    ScopedHistogramTimer open_latency(ImpaladMetrics::FRAGMENT_OPEN_DURATIONS);
     RETURN_IF_ERROR(plan_->Open(runtime_state_.get()));
   }
   if (sink_.get() == NULL) return Status::OK();
@@ -383,6 +403,13 @@ Status PlanFragmentExecutor::OpenInternal() {
     }
     SCOPED_TIMER(profile()->total_time_counter());
     RETURN_IF_ERROR(sink_->Send(runtime_state(), batch, done_));
+    if (!done_ && sink_->IsDone()) {
+      // Stop early, e.g. when the exchanges that consume the output reached their limit.
+      // Close() then stops the scans of the plan.
+      VLOG_QUERY << "Sink needs no more rows: instance_id="
+                 << PrintId(runtime_state_->fragment_instance_id());
+      break;
+    }
   }
 
   // Flush the sink *before* stopping the report thread. Flush may need to add some
@@ -477,6 +504,7 @@ void PlanFragmentExecutor::StopReportThread() {
 Status PlanFragmentExecutor::GetNext(RowBatch** batch) {
   VLOG_FILE << "GetNext(): instance_id="
       << runtime_state_->fragment_instance_id();
+  ScopedCpuSampleQuery sample_query(query_id_);
   Status status = GetNextInternal(batch);
   UpdateStatus(status);
   if (done_) {
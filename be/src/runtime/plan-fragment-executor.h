@@ -268,6 +268,12 @@ class PlanFragmentExecutor {
   /// PlanFragmentExecutor()::Prepare() to allow starting plan fragments more
   /// quickly and in parallel (in a deep plan tree, the fragments are started
   /// in level order).
+  /// TODO: compile on a background thread and start executing on the interpreted paths
+  /// right away. This needs every user of a codegen'd function to keep an interpreted
+  /// fallback that is valid while the function pointer is still NULL, and to re-read the
+  /// pointer at batch boundaries. ScalarFnCall doesn't: when codegen is enabled it never
+  /// loads the interpreted 'scalar_fn_', and IR UDFs have no interpreted version at all.
+  /// The function pointers would also have to be published with release semantics.
   void OptimizeLlvmModule();
 
   /// Executes Open() logic and returns resulting status. Does not set status_.
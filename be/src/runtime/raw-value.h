@@ -74,6 +74,11 @@ class RawValue {
   static inline uint32_t GetHashValueFnv(const void* v, const ColumnType& type,
       uint32_t seed);
 
+  /// Get a 64-bit hash value using the Murmur2 hash function. Like FNV, different seeds
+  /// result in different hash functions, but Murmur2 hashes 8 bytes at a time.
+  static inline uint64_t GetHashValueMurmur(const void* v, const ColumnType& type,
+      uint64_t seed);
+
   /// Compares both values.
   /// Return value is < 0  if v1 < v2, 0 if v1 == v2, > 0 if v1 > v2.
   static int Compare(const void* v1, const void* v2, const ColumnType& type);
@@ -333,6 +333,38 @@ inline uint32_t RawValue::GetHashValueFnv(const void* v, const ColumnType& type,
   }
 }
 
+inline uint64_t RawValue::GetHashValueMurmur(const void* v, const ColumnType& type,
+    uint64_t seed) {
+  // Hash a constant for NULL and empty values so that they do not return the seed.
+  if (v == NULL) return HashUtil::MurmurHash2_64(&HASH_VAL_NULL, sizeof(uint32_t), seed);
+
+  switch (type.type) {
+    case TYPE_STRING:
+    case TYPE_VARCHAR: {
+      const StringValue* string_value = reinterpret_cast<const StringValue*>(v);
+      if (string_value->len == 0) {
+        return HashUtil::MurmurHash2_64(&HASH_VAL_EMPTY, sizeof(uint32_t), seed);
+      }
+      return HashUtil::MurmurHash2_64(string_value->ptr, string_value->len, seed);
+    }
+    case TYPE_BOOLEAN:
+    case TYPE_TINYINT: return HashUtil::MurmurHash2_64(v, 1, seed);
+    case TYPE_SMALLINT: return HashUtil::MurmurHash2_64(v, 2, seed);
+    case TYPE_INT: return HashUtil::MurmurHash2_64(v, 4, seed);
+    case TYPE_BIGINT: return HashUtil::MurmurHash2_64(v, 8, seed);
+    case TYPE_FLOAT: return HashUtil::MurmurHash2_64(v, 4, seed);
+    case TYPE_DOUBLE: return HashUtil::MurmurHash2_64(v, 8, seed);
+    case TYPE_TIMESTAMP: return HashUtil::MurmurHash2_64(v, 12, seed);
+    case TYPE_CHAR:
+      return HashUtil::MurmurHash2_64(StringValue::CharSlotToPtr(v, type), type.len,
+          seed);
+    case TYPE_DECIMAL: return HashUtil::MurmurHash2_64(v, type.GetByteSize(), seed);
+    default:
+      DCHECK(false);
+      return 0;
+  }
+}
+
 inline void RawValue::PrintValue(const void* value, const ColumnType& type, int scale,
     std::stringstream* stream) {
   if (value == NULL) {
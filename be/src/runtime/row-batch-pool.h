@@ -0,0 +1,111 @@
+// Copyright 2016 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef IMPALA_RUNTIME_ROW_BATCH_POOL_H
+#define IMPALA_RUNTIME_ROW_BATCH_POOL_H
+
+#include <vector>
+#include <boost/thread/locks.hpp>
+
+#include "runtime/row-batch.h"
+#include "util/spinlock.h"
+
+namespace impala {
+
+class MemTracker;
+class RowDescriptor;
+
+/// Bounded pool of empty row batches, for producers that hand a new batch to a
+/// consumer for every set of rows, e.g. scanner threads. The consumer returns the batch
+/// once it took the rows, and the producer reuses the batch's tuple pointers and
+/// recycled tuple data chunks (see RowBatch::Reset()) instead of allocating them again.
+///
+/// This class is thread-safe.
+class RowBatchPool {
+ public:
+  /// At most 'max_batches' empty batches are kept. Batches are created with 'row_desc'
+  /// and 'mem_tracker', which must outlive the pool.
+  RowBatchPool(const RowDescriptor& row_desc, MemTracker* mem_tracker, int max_batches)
+    : row_desc_(row_desc),
+      mem_tracker_(mem_tracker),
+      max_batches_(max_batches),
+      capacity_(0) {
+  }
+
+  ~RowBatchPool() { Clear(); }
+
+  /// Returns an empty batch with 'capacity' rows, which is owned by the caller.
+  RowBatch* GetBatch(int capacity) {
+    RowBatch* batch = NULL;
+    {
+      boost::lock_guard<SpinLock> l(lock_);
+      if (capacity != capacity_) {
+        // Batches of a different capacity cannot be reused.
+        ClearLocked();
+        capacity_ = capacity;
+      } else if (!free_batches_.empty()) {
+        batch = free_batches_.back();
+        free_batches_.pop_back();
+      }
+    }
+    if (batch == NULL) batch = new RowBatch(row_desc_, capacity, mem_tracker_);
+    return batch;
+  }
+
+  /// Resets 'batch' and keeps it for a later GetBatch() call, or deletes it if the
+  /// pool is full or 'batch' does not have the capacity of the last GetBatch() call.
+  /// 'batch' must have been created with the row descriptor and mem tracker of the
+  /// pool.
+  void ReturnBatch(RowBatch* batch) {
+    batch->Reset();
+    {
+      boost::lock_guard<SpinLock> l(lock_);
+      if (batch->capacity() == capacity_ &&
+          static_cast<int>(free_batches_.size()) < max_batches_) {
+        free_batches_.push_back(batch);
+        return;
+      }
+    }
+    delete batch;
+  }
+
+  /// Deletes all empty batches.
+  void Clear() {
+    boost::lock_guard<SpinLock> l(lock_);
+    ClearLocked();
+  }
+
+ private:
+  const RowDescriptor& row_desc_;
+  MemTracker* const mem_tracker_;
+  const int max_batches_;
+
+  /// Protects the members below.
+  SpinLock lock_;
+
+  /// Capacity of the batches in 'free_batches_'.
+  int capacity_;
+
+  /// Empty batches, owned by the pool.
+  std::vector<RowBatch*> free_batches_;
+
+  void ClearLocked() {
+    for (RowBatch* batch: free_batches_) delete batch;
+    free_batches_.clear();
+  }
+};
+
+}
+
+#endif
@@ -49,11 +49,14 @@ class RowBatchSerializeTest : public testing::Test {
   // Serializes and deserializes 'batch', then checks that the deserialized batch is valid
   // and has the same contents as 'batch'.
   void TestRowBatch(const RowDescriptor& row_desc, RowBatch* batch, bool print_batches,
-      bool full_dedup = false) {
+      bool full_dedup = false,
+      THdfsCompression::type compression_type = THdfsCompression::LZ4) {
     if (print_batches) cout << PrintBatch(batch) << endl;
 
     TRowBatch trow_batch;
-    EXPECT_OK(batch->Serialize(&trow_batch, full_dedup));
+    EXPECT_OK(batch->Serialize(&trow_batch, full_dedup, compression_type));
+    EXPECT_TRUE(trow_batch.compression_type == compression_type ||
+        trow_batch.compression_type == THdfsCompression::NONE);
 
     RowBatch deserialized_batch(row_desc, trow_batch, tracker_.get());
     if (print_batches) cout << PrintBatch(&deserialized_batch) << endl;
@@ -315,6 +318,27 @@ TEST_F(RowBatchSerializeTest, String) {
   TestRowBatch(row_desc, batch, true);
 }
 
+TEST_F(RowBatchSerializeTest, Codecs) {
+  // tuple: (int, string)
+  DescriptorTblBuilder builder(&pool_);
+  builder.DeclareTuple() << TYPE_INT << TYPE_STRING;
+  DescriptorTbl* desc_tbl = builder.Build();
+
+  vector<bool> nullable_tuples(1, false);
+  vector<TTupleId> tuple_id(1, (TTupleId) 0);
+  RowDescriptor row_desc(*desc_tbl, tuple_id, nullable_tuples);
+
+  RowBatch* batch = CreateRowBatch(row_desc);
+  TestRowBatch(row_desc, batch, false, false, THdfsCompression::LZ4);
+  TestRowBatch(row_desc, batch, false, false, THdfsCompression::SNAPPY);
+  TestRowBatch(row_desc, batch, false, false, THdfsCompression::NONE);
+
+  TRowBatch trow_batch;
+  EXPECT_OK(batch->Serialize(&trow_batch, THdfsCompression::NONE));
+  EXPECT_EQ(trow_batch.compression_type, THdfsCompression::NONE);
+  EXPECT_EQ(trow_batch.tuple_data.size(), trow_batch.uncompressed_size);
+}
+
 TEST_F(RowBatchSerializeTest, BasicArray) {
   // tuple: (int, string, array<int>)
   ColumnType array_type;
@@ -32,10 +32,21 @@
 DECLARE_bool(enable_partitioned_hash_join);
 DECLARE_bool(enable_partitioned_aggregation);
 
+DEFINE_int32(row_batch_target_bytes, 0, "If > 0, exec nodes, scanners and the "
+    "fragment sinks create row batches with about this many bytes of row data, based "
+    "on the row width, instead of batch_size rows. Queries that do not set the "
+    "batch_size query option then use --row_batch_max_rows as their batch size.");
+DEFINE_int32(row_batch_min_rows, 128, "Minimum number of rows of a row batch that is "
+    "sized with --row_batch_target_bytes.");
+DEFINE_int32(row_batch_max_rows, 8192, "The batch size of queries that do not set the "
+    "batch_size query option if --row_batch_target_bytes is set.");
+
 namespace impala {
 
 const int RowBatch::AT_CAPACITY_MEM_USAGE;
 const int RowBatch::FIXED_LEN_BUFFER_LIMIT;
+const int RowBatch::MAX_RECYCLED_TUPLE_DATA;
+const int RowBatch::ESTIMATED_VAR_LEN_SLOT_SIZE;
 
 RowBatch::RowBatch(const RowDescriptor& row_desc, int capacity,
     MemTracker* mem_tracker)
@@ -112,34 +123,36 @@ RowBatch::RowBatch(const RowDescriptor& row_desc, const TRowBatch& input_batch,
     memcpy(tuple_data, input_batch.tuple_data.c_str(), input_batch.tuple_data.size());
   }
 
-  // Convert input_batch.tuple_offsets into pointers
-  int tuple_idx = 0;
-  for (vector<int32_t>::const_iterator offset = input_batch.tuple_offsets.begin();
-       offset != input_batch.tuple_offsets.end(); ++offset) {
-    if (*offset == -1) {
-      tuple_ptrs_[tuple_idx++] = NULL;
-    } else {
-      tuple_ptrs_[tuple_idx++] = reinterpret_cast<Tuple*>(tuple_data + *offset);
+  // Convert input_batch.tuple_offsets into pointers.
+  const vector<int32_t>& tuple_offsets = input_batch.tuple_offsets;
+  if (!row_desc_.HasVarlenSlots()) {
+    for (int i = 0; i < tuple_offsets.size(); ++i) {
+      tuple_ptrs_[i] = tuple_offsets[i] == -1 ?
+          NULL : reinterpret_cast<Tuple*>(tuple_data + tuple_offsets[i]);
     }
+    return;
   }
 
-  // Check whether we have slots that require offset-to-pointer conversion.
-  if (!row_desc_.HasVarlenSlots()) return;
-
-  // For every unique tuple, convert string offsets contained in tuple data into
-  // pointers. Tuples were serialized in the order we are deserializing them in,
+  // In the same pass, convert the string and collection offsets of every unique tuple
+  // into pointers. Tuples were serialized in the order we are deserializing them in,
   // so the first occurrence of a tuple will always have a higher offset than any tuple
   // we already converted.
-  Tuple* last_converted = NULL;
+  const vector<TupleDescriptor*>& tuple_descs = row_desc_.tuple_descriptors();
+  int32_t last_converted = -1;
+  int tuple_idx = 0;
   for (int i = 0; i < num_rows_; ++i) {
-    for (int j = 0; j < num_tuples_per_row_; ++j) {
-      const TupleDescriptor* desc = row_desc_.tuple_descriptors()[j];
-      if (!desc->HasVarlenSlots()) continue;
-      Tuple* tuple = GetRow(i)->GetTuple(j);
-      // Handle NULL or already converted tuples with one check.
-      if (tuple <= last_converted) continue;
-      last_converted = tuple;
-      tuple->ConvertOffsetsToPointers(*desc, tuple_data);
+    for (int j = 0; j < num_tuples_per_row_; ++j, ++tuple_idx) {
+      int32_t offset = tuple_offsets[tuple_idx];
+      if (offset == -1) {
+        tuple_ptrs_[tuple_idx] = NULL;
+        continue;
+      }
+      Tuple* tuple = reinterpret_cast<Tuple*>(tuple_data + offset);
+      tuple_ptrs_[tuple_idx] = tuple;
+      // Skip repeated occurrences of tuples that were already converted.
+      if (offset <= last_converted || !tuple_descs[j]->HasVarlenSlots()) continue;
+      last_converted = offset;
+      tuple->ConvertOffsetsToPointers(*tuple_descs[j], tuple_data);
     }
   }
 }
@@ -161,11 +174,13 @@ RowBatch::~RowBatch() {
   }
 }
 
-Status RowBatch::Serialize(TRowBatch* output_batch) {
-  return Serialize(output_batch, UseFullDedup());
+Status RowBatch::Serialize(TRowBatch* output_batch,
+    THdfsCompression::type compression_type) {
+  return Serialize(output_batch, UseFullDedup(), compression_type);
 }
 
-Status RowBatch::Serialize(TRowBatch* output_batch, bool full_dedup) {
+Status RowBatch::Serialize(TRowBatch* output_batch, bool full_dedup,
+    THdfsCompression::type compression_type) {
   // why does Thrift not generate a Clear() function?
   output_batch->row_tuples.clear();
   output_batch->tuple_offsets.clear();
@@ -192,11 +207,11 @@ Status RowBatch::Serialize(TRowBatch* output_batch, bool full_dedup) {
     SerializeInternal(size, NULL, output_batch);
   }
 
-  if (size > 0) {
+  if (size > 0 && compression_type != THdfsCompression::NONE) {
     // Try compressing tuple_data to compression_scratch_, swap if compressed data is
     // smaller
     scoped_ptr<Codec> compressor;
-    RETURN_IF_ERROR(Codec::CreateCompressor(NULL, false, THdfsCompression::LZ4,
+    RETURN_IF_ERROR(Codec::CreateCompressor(NULL, false, compression_type,
                                             &compressor));
 
     int64_t compressed_size = compressor->MaxOutputLen(size);
@@ -210,7 +225,7 @@ Status RowBatch::Serialize(TRowBatch* output_batch, bool full_dedup) {
     if (LIKELY(compressed_size < size)) {
       compression_scratch_.resize(compressed_size);
       output_batch->tuple_data.swap(compression_scratch_);
-      output_batch->compression_type = THdfsCompression::LZ4;
+      output_batch->compression_type = compression_type;
     }
     VLOG_ROW << "uncompressed size: " << size << ", compressed size: " << compressed_size;
   }
@@ -310,8 +325,7 @@ void RowBatch::AddBlock(BufferedBlockMgr::Block* block) {
 void RowBatch::Reset() {
   num_rows_ = 0;
   capacity_ = tuple_ptrs_size_ / (num_tuples_per_row_ * sizeof(Tuple*));
-  // TODO: Change this to Clear() and investigate the repercussions.
-  tuple_data_pool_.FreeAll();
+  tuple_data_pool_.Recycle(MAX_RECYCLED_TUPLE_DATA);
   for (int i = 0; i < io_buffers_.size(); ++i) {
     io_buffers_[i]->Return();
   }
@@ -358,6 +372,20 @@ void RowBatch::TransferResourceOwnership(RowBatch* dest) {
   Reset();
 }
 
+int RowBatch::AdaptiveCapacity(const RowDescriptor& row_desc, int batch_size) {
+  if (FLAGS_row_batch_target_bytes <= 0) return batch_size;
+  const vector<TupleDescriptor*>& tuple_descs = row_desc.tuple_descriptors();
+  int64_t row_size = tuple_descs.size() * sizeof(Tuple*);
+  for (const TupleDescriptor* tuple_desc: tuple_descs) {
+    int num_var_len_slots =
+        tuple_desc->string_slots().size() + tuple_desc->collection_slots().size();
+    row_size += tuple_desc->byte_size() + num_var_len_slots * ESTIMATED_VAR_LEN_SLOT_SIZE;
+  }
+  int64_t capacity = FLAGS_row_batch_target_bytes / max<int64_t>(row_size, 1);
+  capacity = max<int64_t>(capacity, FLAGS_row_batch_min_rows);
+  return max<int64_t>(1, min<int64_t>(capacity, batch_size));
+}
+
 int RowBatch::GetBatchSize(const TRowBatch& batch) {
   int result = batch.tuple_data.size();
   result += batch.row_tuples.size() * sizeof(TTupleId);
@@ -388,6 +416,20 @@ void RowBatch::AcquireState(RowBatch* src) {
   src->TransferResourceOwnership(this);
 }
 
+bool RowBatch::AcquireSelectedRows(RowBatch* src, const int* sel, int num_sel) {
+  if (num_rows_ != 0 || need_to_return_ || auxiliary_mem_usage_ != 0) return false;
+  if (tuple_ptrs_size_ != src->tuple_ptrs_size_) return false;
+  DCHECK_LE(num_sel, src->num_rows_);
+  // 'sel' is ascending, so row i is never overwritten before it was moved.
+  for (int i = 0; i < num_sel; ++i) {
+    DCHECK_GE(sel[i], i);
+    if (sel[i] != i) src->CopyRow(src->GetRow(sel[i]), src->GetRow(i));
+  }
+  src->num_rows_ = num_sel;
+  AcquireState(src);
+  return true;
+}
+
 void RowBatch::DeepCopyTo(RowBatch* dst) {
   DCHECK(dst->row_desc_.Equals(row_desc_));
   DCHECK_EQ(dst->num_rows_, 0);
@@ -23,6 +23,7 @@
 #include "codegen/impala-ir.h"
 #include "common/compiler-util.h"
 #include "common/logging.h"
+#include "gen-cpp/CatalogObjects_types.h"
 #include "runtime/buffered-block-mgr.h" // for BufferedBlockMgr::Block
 #include "runtime/descriptors.h"
 #include "runtime/disk-io-mgr.h"
@@ -201,7 +202,8 @@ class RowBatch {
   int num_blocks() const { return blocks_.size(); }
   int num_tuple_streams() const { return tuple_streams_.size(); }
 
-  /// Resets the row batch, returning all resources it has accumulated.
+  /// Resets the row batch, returning all resources it has accumulated. Up to
+  /// MAX_RECYCLED_TUPLE_DATA bytes of tuple data chunks are kept for the next rows.
   void Reset();
 
   /// Add io buffer to this row batch.
@@ -255,6 +257,13 @@ class RowBatch {
   /// multiple threads which push row batches.
   void AcquireState(RowBatch* src);
 
+  /// Keeps only the 'num_sel' rows of 'src' whose indices are in 'sel', in ascending
+  /// order, and then acquires the state of 'src' like AcquireState(). This hands the
+  /// rows that passed a filter to the next operator without copying them. Returns false
+  /// and leaves both batches unchanged if this batch has rows, holds io buffers, blocks
+  /// or tuple streams, needs to be returned or has a different capacity than 'src'.
+  bool AcquireSelectedRows(RowBatch* src, const int* sel, int num_sel);
+
   /// Deep copy all rows this row batch into dst, using memory allocated from
   /// dst's tuple_data_pool_. Only valid when dst is empty.
   /// TODO: the current implementation of deep copy can produce an oversized
@@ -264,15 +273,25 @@ class RowBatch {
   /// Create a serialized version of this row batch in output_batch, attaching all of the
   /// data it references to output_batch.tuple_data. This function attempts to
   /// detect duplicate tuples in the row batch to reduce the serialized size.
-  /// output_batch.tuple_data will be snappy-compressed unless the compressed data is
-  /// larger than the uncompressed data. Use output_batch.is_compressed to determine
-  /// whether tuple_data is compressed. If an in-flight row is present in this row batch,
-  /// it is ignored. This function does not Reset().
-  Status Serialize(TRowBatch* output_batch);
+  /// output_batch.tuple_data will be compressed with 'compression_type' unless it is
+  /// NONE or the compressed data is larger than the uncompressed data. Use
+  /// output_batch.compression_type to determine whether tuple_data is compressed. If an
+  /// in-flight row is present in this row batch, it is ignored. This function does not
+  /// Reset().
+  Status Serialize(TRowBatch* output_batch,
+      THdfsCompression::type compression_type = THdfsCompression::LZ4);
 
   /// Utility function: returns total size of batch.
   static int GetBatchSize(const TRowBatch& batch);
 
+  /// Returns the capacity of the batches of 'row_desc' for queries with 'batch_size'.
+  /// This is 'batch_size' unless --row_batch_target_bytes is set. Then it is the number
+  /// of rows of 'row_desc' whose fixed-length and estimated variable-length data fit
+  /// in the target, but at least --row_batch_min_rows and at most 'batch_size'. The
+  /// producer and the consumer of a batch must both use it so that batches can be
+  /// handed on with AcquireState().
+  static int AdaptiveCapacity(const RowDescriptor& row_desc, int batch_size);
+
   int ALWAYS_INLINE num_rows() const { return num_rows_; }
   int ALWAYS_INLINE capacity() const { return capacity_; }
 
@@ -287,6 +306,15 @@ class RowBatch {
   // in order to leave room for variable-length data.
   static const int FIXED_LEN_BUFFER_LIMIT = AT_CAPACITY_MEM_USAGE / 2;
 
+  /// Max size of the tuple data pool's chunks that Reset() keeps, so that batches that
+  /// are reused for every GetNext() call do not return their memory to the allocator
+  /// only to allocate it again.
+  static const int MAX_RECYCLED_TUPLE_DATA = 1024 * 1024;
+
+  /// Size in bytes that AdaptiveCapacity() assumes for the variable-length data of a
+  /// string or collection slot.
+  static const int ESTIMATED_VAR_LEN_SLOT_SIZE = 16;
+
   /// Allocates a buffer large enough for the fixed-length portion of 'capacity_' rows in
   /// this batch from 'tuple_data_pool_'. 'capacity_' is reduced if the allocation would
   /// exceed FIXED_LEN_BUFFER_LIMIT. Always returns enough space for at least one row.
@@ -307,7 +335,8 @@ class RowBatch {
   bool UseFullDedup();
 
   /// Overload for testing that allows the test to force the deduplication level.
-  Status Serialize(TRowBatch* output_batch, bool full_dedup);
+  Status Serialize(TRowBatch* output_batch, bool full_dedup,
+      THdfsCompression::type compression_type = THdfsCompression::LZ4);
 
   typedef FixedSizeHashTable<Tuple*, int> DedupMap;
 
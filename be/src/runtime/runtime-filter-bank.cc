@@ -25,6 +25,7 @@
 #include "runtime/runtime-filter.inline.h"
 #include "service/impala-server.h"
 #include "util/bloom-filter.h"
+#include "util/min-max-filter.h"
 
 using namespace impala;
 using namespace boost;
@@ -32,6 +33,12 @@ using namespace strings;
 
 DEFINE_double(max_filter_error_rate, 0.75, "(Advanced) The maximum probability of false "
     "positives in a runtime filter before it is disabled.");
+DEFINE_bool(enable_runtime_min_max_filters, true, "(Advanced) If true, hash joins also "
+    "compute the range of the build side values of runtime filters of numeric types and "
+    "publish it to the local targets of the filter.");
+DEFINE_double(runtime_filter_target_fpp, 0.05, "(Advanced) The false positive "
+    "probability that Bloom filters are fitted to once the number of distinct values on "
+    "the build side is known.");
 
 const int64_t RuntimeFilterBank::MIN_BLOOM_FILTER_SIZE;
 const int64_t RuntimeFilterBank::MAX_BLOOM_FILTER_SIZE;
@@ -110,7 +117,7 @@ void SendFilterToCoordinator(TNetworkAddress address, TUpdateFilterParams params
 }
 
 void RuntimeFilterBank::UpdateFilterFromLocal(int32_t filter_id,
-    BloomFilter* bloom_filter) {
+    BloomFilter* bloom_filter, const MinMaxFilter* min_max_filter) {
   DCHECK_NE(state_->query_options().runtime_filter_mode, TRuntimeFilterMode::OFF)
       << "Should not be calling UpdateFilterFromLocal() if filtering is disabled";
   TUpdateFilterParams params;
@@ -137,6 +144,7 @@ void RuntimeFilterBank::UpdateFilterFromLocal(int32_t filter_id,
       if (it == consumed_filters_.end()) return;
       filter = it->second;
     }
+    if (min_max_filter != NULL) filter->SetMinMaxFilter(min_max_filter);
     filter->SetBloomFilter(bloom_filter);
     state_->runtime_profile()->AddInfoString(
         Substitute("Filter $0 arrival", filter_id),
@@ -184,7 +192,8 @@ void RuntimeFilterBank::PublishGlobalFilter(int32_t filter_id,
       PrettyPrinter::Print(it->second->arrival_delay(), TUnit::TIME_MS));
 }
 
-BloomFilter* RuntimeFilterBank::AllocateScratchBloomFilter(int32_t filter_id) {
+BloomFilter* RuntimeFilterBank::AllocateScratchBloomFilter(int32_t filter_id,
+    bool fit_to_build) {
   lock_guard<mutex> l(runtime_filter_lock_);
   if (closed_) return NULL;
 
@@ -194,13 +203,77 @@ BloomFilter* RuntimeFilterBank::AllocateScratchBloomFilter(int32_t filter_id) {
   // Track required space
   int64_t log_filter_size = Bits::Log2Ceiling64(it->second->filter_size());
   int64_t required_space = BloomFilter::GetExpectedHeapSpaceUsed(log_filter_size);
-  if (!filter_mem_tracker_->TryConsume(required_space)) return NULL;
+  if (fit_to_build && IsSingleProducer(it->second->filter_desc())) {
+    // The planner's NDV estimate may be far off, so start with the largest filter and
+    // shrink it in FinalizeScratchBloomFilter().
+    int64_t log_max_filter_size = Bits::Log2Ceiling64(max_filter_size_);
+    int64_t max_space = BloomFilter::GetExpectedHeapSpaceUsed(log_max_filter_size);
+    if (max_space > required_space && filter_mem_tracker_->TryConsume(max_space)) {
+      log_filter_size = log_max_filter_size;
+      required_space = max_space;
+    } else if (!filter_mem_tracker_->TryConsume(required_space)) {
+      return NULL;
+    }
+  } else if (!filter_mem_tracker_->TryConsume(required_space)) {
+    return NULL;
+  }
   BloomFilter* bloom_filter = obj_pool_.Add(new BloomFilter(log_filter_size));
   DCHECK_EQ(required_space, bloom_filter->GetHeapSpaceUsed());
   memory_allocated_->Add(bloom_filter->GetHeapSpaceUsed());
   return bloom_filter;
 }
 
+MinMaxFilter* RuntimeFilterBank::AllocateScratchMinMaxFilter(int32_t filter_id,
+    const ColumnType& type) {
+  if (!FLAGS_enable_runtime_min_max_filters) return NULL;
+  if (!MinMaxFilter::IsSupportedType(type)) return NULL;
+  lock_guard<mutex> l(runtime_filter_lock_);
+  if (closed_) return NULL;
+
+  RuntimeFilterMap::iterator it = produced_filters_.find(filter_id);
+  DCHECK(it != produced_filters_.end()) << "Filter ID " << filter_id << " not registered";
+  if (!it->second->filter_desc().has_local_targets) return NULL;
+  // The filter has a fixed, small size, so its memory is not tracked.
+  return obj_pool_.Add(new MinMaxFilter(type));
+}
+
+bool RuntimeFilterBank::FinalizeScratchBloomFilter(int32_t filter_id,
+    BloomFilter* bloom_filter, int64_t max_ndv) {
+  DCHECK(bloom_filter != NULL);
+  lock_guard<mutex> l(runtime_filter_lock_);
+  // Close() freed the filter.
+  if (closed_) return false;
+  RuntimeFilterMap::iterator it = produced_filters_.find(filter_id);
+  DCHECK(it != produced_filters_.end()) << "Filter ID " << filter_id << " not registered";
+
+  int64_t ndv = min(bloom_filter->EstimateNdv(), max<int64_t>(max_ndv, 0));
+  if (IsSingleProducer(it->second->filter_desc())) {
+    int64_t space_before = bloom_filter->GetHeapSpaceUsed();
+    bloom_filter->Fold(GetFittedLogSpace(*bloom_filter, ndv, min_filter_size_));
+    int64_t space_released = space_before - bloom_filter->GetHeapSpaceUsed();
+    filter_mem_tracker_->Release(space_released);
+    memory_allocated_->Add(-space_released);
+  }
+  double fpp = BloomFilter::FalsePositiveProb(
+      ndv, Bits::Log2Ceiling64(bloom_filter->GetHeapSpaceUsed()));
+  state_->runtime_profile()->AddInfoString(Substitute("Filter $0 size", filter_id),
+      Substitute("$0 (estimated NDV: $1, false positive probability: $2)",
+          PrettyPrinter::Print(bloom_filter->GetHeapSpaceUsed(), TUnit::BYTES), ndv,
+          fpp));
+  return fpp <= FLAGS_max_filter_error_rate;
+}
+
+int RuntimeFilterBank::GetFittedLogSpace(const BloomFilter& bloom_filter, int64_t ndv,
+    int64_t min_filter_size) {
+  int log_space = BloomFilter::MinLogSpace(ndv, FLAGS_runtime_filter_target_fpp);
+  log_space = max(log_space, Bits::Log2Ceiling64(min_filter_size));
+  return min(log_space, Bits::Log2Ceiling64(bloom_filter.GetHeapSpaceUsed()));
+}
+
+bool RuntimeFilterBank::IsSingleProducer(const TRuntimeFilterDesc& filter_desc) {
+  return filter_desc.is_broadcast_join || !filter_desc.has_remote_targets;
+}
+
 int64_t RuntimeFilterBank::GetFilterSizeForNdv(int64_t ndv) {
   if (ndv == -1) return default_filter_size_;
   int64_t required_space =
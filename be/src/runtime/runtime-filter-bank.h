@@ -27,6 +27,7 @@ namespace impala {
 
 class BloomFilter;
 class MemTracker;
+class MinMaxFilter;
 class RuntimeFilter;
 class RuntimeState;
 class TBloomFilter;
@@ -52,6 +53,11 @@ class TQueryCtx;
 /// Filters are aggregated at the coordinator, and then made available to consumers after
 /// PublishGlobalFilter() has been called.
 ///
+/// Producers may also build a MinMaxFilter for filters with local targets (see
+/// AllocateScratchMinMaxFilter()). Min/max filters are only published to the local
+/// targets: they are not sent to the coordinator, since TUpdateFilterParams and
+/// TPublishFilterParams only carry a Bloom filter.
+///
 /// After PublishGlobalFilter() has been called (and again, it may only be called once per
 /// filter_id), the RuntimeFilter object associated with filter_id will have a valid
 /// bloom_filter, and may be used for filter evaluation. This operation occurs without
@@ -68,8 +74,11 @@ class RuntimeFilterBank {
 
   /// Updates a filter's bloom_filter with 'bloom_filter' which has been produced by some
   /// operator in the local fragment instance. 'bloom_filter' may be NULL, representing a
-  /// full filter that contains all elements.
-  void UpdateFilterFromLocal(int32_t filter_id, BloomFilter* bloom_filter);
+  /// full filter that contains all elements. 'min_max_filter', if not NULL, must have
+  /// been allocated by AllocateScratchMinMaxFilter() and is only published to the local
+  /// consumers of the filter.
+  void UpdateFilterFromLocal(int32_t filter_id, BloomFilter* bloom_filter,
+      const MinMaxFilter* min_max_filter = NULL);
 
   /// Makes a bloom_filter (aggregated globally from all producer fragments) available for
   /// consumption by operators that wish to use it for filtering.
@@ -93,8 +102,40 @@ class RuntimeFilterBank {
   /// should not be deleted by the caller. The filter identified by 'filter_id' must have
   /// been previously registered as a 'producer' by RegisterFilter().
   ///
+  /// If 'fit_to_build' is true and the filter can be shrunk once it is built (see
+  /// FinalizeScratchBloomFilter()), the filter is allocated with the maximum filter size
+  /// rather than the size derived from the planner's NDV estimate, falling back to the
+  /// latter if there is not enough memory.
+  ///
   /// If there is not enough memory, or if Close() has been called first, returns NULL.
-  BloomFilter* AllocateScratchBloomFilter(int32_t filter_id);
+  BloomFilter* AllocateScratchBloomFilter(int32_t filter_id, bool fit_to_build = false);
+
+  /// Called by the producer of 'bloom_filter', which must have been returned by
+  /// AllocateScratchBloomFilter(), once all build rows were inserted. Estimates the
+  /// number of distinct values in the filter, which is capped at 'max_ndv' (e.g. the
+  /// number of build rows). If only this filter bank produces the filter, i.e. for
+  /// broadcast joins and filters without remote targets, folds it to the smallest size
+  /// that keeps the expected false-positive rate under FLAGS_runtime_filter_target_fpp
+  /// and releases the memory that is no longer needed. Filters of partitioned joins
+  /// with remote targets must keep their size, as the coordinator merges the filters of
+  /// all producers. Returns false if the expected false-positive rate of the filter
+  /// exceeds FLAGS_max_filter_error_rate, in which case it should not be published.
+  bool FinalizeScratchBloomFilter(int32_t filter_id, BloomFilter* bloom_filter,
+      int64_t max_ndv);
+
+  /// Returns the log2 of the space, in bytes, that 'bloom_filter' can be folded to if it
+  /// contains 'ndv' distinct values, so that its expected false-positive rate stays
+  /// under FLAGS_runtime_filter_target_fpp. The result is between the log2 of
+  /// 'min_filter_size' and the log2 of the current space of the filter.
+  static int GetFittedLogSpace(const BloomFilter& bloom_filter, int64_t ndv,
+      int64_t min_filter_size);
+
+  /// Returns a min/max filter for values of 'type' that an operator can populate along
+  /// with the Bloom filter of 'filter_id' and pass to UpdateFilterFromLocal(). The memory
+  /// returned is owned by the RuntimeFilterBank. Returns NULL if min/max filters are
+  /// disabled, if 'type' is not supported, if the filter has no local targets, or if
+  /// Close() has been called.
+  MinMaxFilter* AllocateScratchMinMaxFilter(int32_t filter_id, const ColumnType& type);
 
   /// Default hash seed to use when computing hashed values to insert into filters.
   static const int32_t DefaultHashSeed() { return 1234; }
@@ -111,6 +152,10 @@ class RuntimeFilterBank {
   /// estimate is known), the default filter size is returned.
   int64_t GetFilterSizeForNdv(int64_t ndv);
 
+  /// Returns true if the filter described by 'filter_desc' only has one producer in the
+  /// query, which is then free to choose the size of the filter.
+  static bool IsSingleProducer(const TRuntimeFilterDesc& filter_desc);
+
   /// Lock protecting produced_filters_ and consumed_filters_.
   boost::mutex runtime_filter_lock_;
 
@@ -19,6 +19,7 @@
 #include "runtime/raw-value.h"
 #include "runtime/runtime-filter-bank.h"
 #include "util/bloom-filter.h"
+#include "util/min-max-filter.h"
 #include "util/spinlock.h"
 
 namespace impala {
@@ -33,10 +34,16 @@ class BloomFilter;
 /// hash table). Other plan nodes can use that predicate by testing for membership of that
 /// set to filter rows early on in the plan tree (e.g. the scan that feeds the probe side
 /// of that join node could eliminate rows from consideration for join matching).
+///
+/// Filters that are published locally (see RuntimeFilterBank::UpdateFilterFromLocal())
+/// may also carry a MinMaxFilter with the range of the build side values. It is checked
+/// in addition to the Bloom filter and remains selective when the Bloom filter was
+/// disabled because its false-positive rate would have been too high.
 class RuntimeFilter {
  public:
   RuntimeFilter(const TRuntimeFilterDesc& filter, int64_t filter_size)
-      : bloom_filter_(NULL), filter_desc_(filter), arrival_time_(0L),
+      : bloom_filter_(NULL), min_max_filter_(NULL), filter_desc_(filter),
+        arrival_time_(0L),
         filter_size_(filter_size) {
     DCHECK_GT(filter_size_, 0);
     registration_time_ = MonotonicMillis();
@@ -53,9 +60,24 @@ class RuntimeFilter {
   /// once per filter. Does not acquire the memory associated with 'bloom_filter'.
   inline void SetBloomFilter(BloomFilter* bloom_filter);
 
+  /// Sets the min/max filter to 'min_max_filter'. Must be called before
+  /// SetBloomFilter(), which makes the filter visible to consumers. Does not acquire the
+  /// memory associated with 'min_max_filter'.
+  inline void SetMinMaxFilter(const MinMaxFilter* min_max_filter);
+
+  /// Returns the Bloom filter set by SetBloomFilter(). NULL if the filter has not
+  /// arrived yet or if it contains every element (see AlwaysTrue()).
+  const BloomFilter* bloom_filter() const { return bloom_filter_; }
+
+  /// Returns the min/max filter of an arrived filter, or NULL if there is none.
+  const MinMaxFilter* min_max_filter() const {
+    return HasBloomFilter() ? min_max_filter_ : NULL;
+  }
+
   /// Returns false iff the bloom_filter filter has been set via SetBloomFilter() and
-  /// hash[val] is not in that bloom_filter. Otherwise returns true. Is safe to call
-  /// concurrently with SetBloomFilter().
+  /// hash[val] is not in that bloom_filter, or 'val' is outside of the range of the
+  /// min/max filter. Otherwise returns true. Is safe to call concurrently with
+  /// SetBloomFilter().
   ///
   /// Templatized in preparation for templatized hashes.
   template<typename T>
@@ -85,6 +107,9 @@ class RuntimeFilter {
   /// compact way of representing a full Bloom filter that contains every element.
   BloomFilter* bloom_filter_;
 
+  /// Range of the build side values, or NULL. Only read after the filter arrived.
+  const MinMaxFilter* min_max_filter_;
+
   /// Descriptor of the filter.
   TRuntimeFilterDesc filter_desc_;
 
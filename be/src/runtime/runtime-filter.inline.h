@@ -42,10 +42,20 @@ inline void RuntimeFilter::SetBloomFilter(BloomFilter* bloom_filter) {
   arrival_time_ = MonotonicMillis();
 }
 
+inline void RuntimeFilter::SetMinMaxFilter(const MinMaxFilter* min_max_filter) {
+  DCHECK(!HasBloomFilter());
+  DCHECK(min_max_filter_ == NULL);
+  min_max_filter_ = min_max_filter;
+}
+
 template<typename T>
 inline bool RuntimeFilter::Eval(T* val, const ColumnType& col_type) const {
   // Safe to read bloom_filter_ concurrently with any ongoing SetBloomFilter() thanks
   // to a) the atomicity of / pointer assignments and b) the x86 TSO memory model.
+  // 'min_max_filter_' is always set before 'bloom_filter_' and 'arrival_time_'.
+  if (HasBloomFilter() && min_max_filter_ != NULL && !min_max_filter_->Eval(val)) {
+    return false;
+  }
   if (bloom_filter_ == NULL) return true;
 
   uint32_t h = RawValue::GetHashValue(val, col_type,
@@ -54,7 +64,8 @@ inline bool RuntimeFilter::Eval(T* val, const ColumnType& col_type) const {
 }
 
 inline bool RuntimeFilter::AlwaysTrue() const  {
-  return HasBloomFilter() && bloom_filter_ == BloomFilter::ALWAYS_TRUE_FILTER;
+  return HasBloomFilter() && bloom_filter_ == BloomFilter::ALWAYS_TRUE_FILTER &&
+      min_max_filter_ == NULL;
 }
 
 }
@@ -48,6 +48,8 @@
 using namespace llvm;
 
 DECLARE_int32(max_errors);
+DECLARE_int32(row_batch_target_bytes);
+DECLARE_int32(row_batch_max_rows);
 
 // The fraction of the query mem limit that is used for the block mgr. Operators
 // that accumulate memory all use the block mgr so the majority of the memory should
@@ -127,7 +129,10 @@ Status RuntimeState::Init(ExecEnv* exec_env) {
     query_options.max_errors = 100;
   }
   if (query_options.batch_size <= 0) {
-    query_options.__set_batch_size(DEFAULT_BATCH_SIZE);
+    // With --row_batch_target_bytes, the batch size is only the upper bound of the
+    // capacity of batches of narrow rows. See RowBatch::AdaptiveCapacity().
+    query_options.__set_batch_size(FLAGS_row_batch_target_bytes > 0 ?
+        max(FLAGS_row_batch_max_rows, 1) : DEFAULT_BATCH_SIZE);
   }
 
   // Register with the thread mgr
@@ -24,7 +24,7 @@
 namespace impala {
 
 /// SortedRunWrapper returns individual rows in a batch obtained from a sorted input run
-/// (a RunBatchSupplierFn). Used as the heap element in the min heap maintained by the
+/// (a RunBatchSupplierFn). Used as the leaves of the tournament tree maintained by the
 /// merger.
 /// Advance() advances the row supplier to the next row in the input batch and retrieves
 /// the next batch from the input if the current input batch is exhausted. Transfers
@@ -71,7 +71,7 @@ class SortedRunMerger::SortedRunWrapper {
       }
 
       {
-        ScopedTimer<MonotonicStopWatch> timer(parent_->get_next_batch_timer_);
+        ScopedTimer<TscStopWatch> timer(parent_->get_next_batch_timer_);
         RETURN_IF_ERROR(sorted_run_(&input_row_batch_));
       }
     } while (input_row_batch_ != NULL && input_row_batch_->num_rows() == 0);
@@ -101,32 +101,23 @@ class SortedRunMerger::SortedRunWrapper {
   SortedRunMerger* parent_;
 };
 
-void SortedRunMerger::Heapify(int parent_index) {
-  int left_index = 2 * parent_index + 1;
-  int right_index = left_index + 1;
-  if (left_index >= min_heap_.size()) return;
-  int least_child;
-  // Find the least child of parent.
-  if (right_index >= min_heap_.size() ||
-      comparator_.Less(
-          min_heap_[left_index]->current_row(), min_heap_[right_index]->current_row())) {
-    least_child = left_index;
-  } else {
-    least_child = right_index;
-  }
-
-  // If the parent is out of place, swap it with the least child and invoke
-  // Heapify recursively.
-  if (comparator_.Less(min_heap_[least_child]->current_row(),
-          min_heap_[parent_index]->current_row())) {
-    iter_swap(min_heap_.begin() + least_child, min_heap_.begin() + parent_index);
-    Heapify(least_child);
+int SortedRunMerger::PlayTournament(int node) {
+  const int num_runs = runs_.size();
+  if (node >= num_runs) return node - num_runs;
+  int left_winner = PlayTournament(2 * node);
+  int right_winner = PlayTournament(2 * node + 1);
+  if (RunLess(right_winner, left_winner)) {
+    losers_[node] = left_winner;
+    return right_winner;
   }
+  losers_[node] = right_winner;
+  return left_winner;
 }
 
 SortedRunMerger::SortedRunMerger(const TupleRowComparator& comparator,
     RowDescriptor* row_desc, RuntimeProfile* profile, bool deep_copy_input)
-  : comparator_(comparator),
+  : num_active_runs_(0),
+    comparator_(comparator),
     input_row_desc_(row_desc),
     deep_copy_input_(deep_copy_input) {
   get_next_timer_ = ADD_TIMER(profile, "MergeGetNext");
@@ -134,29 +125,28 @@ SortedRunMerger::SortedRunMerger(const TupleRowComparator& comparator,
 }
 
 Status SortedRunMerger::Prepare(const vector<RunBatchSupplierFn>& input_runs) {
-  DCHECK_EQ(min_heap_.size(), 0);
-  min_heap_.reserve(input_runs.size());
+  DCHECK_EQ(runs_.size(), 0);
+  runs_.reserve(input_runs.size());
   for (const RunBatchSupplierFn& input_run: input_runs) {
     SortedRunWrapper* new_elem = pool_.Add(new SortedRunWrapper(this, input_run));
     DCHECK(new_elem != NULL);
     bool empty;
     RETURN_IF_ERROR(new_elem->Init(&empty));
-    if (!empty) min_heap_.push_back(new_elem);
+    if (!empty) runs_.push_back(new_elem);
   }
+  num_active_runs_ = runs_.size();
+  if (runs_.empty()) return Status::OK();
 
-  // Construct the min heap from the sorted runs.
-  const int last_parent = (min_heap_.size() / 2) - 1;
-  for (int i = last_parent; i >= 0; --i) {
-    Heapify(i);
-  }
+  losers_.resize(runs_.size());
+  losers_[0] = PlayTournament(1);
   return Status::OK();
 }
 
 Status SortedRunMerger::GetNext(RowBatch* output_batch, bool* eos) {
-  ScopedTimer<MonotonicStopWatch> timer(get_next_timer_);
+  ScopedTimer<TscStopWatch> timer(get_next_timer_);
 
-  while (!output_batch->AtCapacity() && !min_heap_.empty()) {
-    SortedRunWrapper* min = min_heap_[0];
+  while (!output_batch->AtCapacity() && num_active_runs_ > 0) {
+    SortedRunWrapper* min = runs_[losers_[0]];
     int output_row_index = output_batch->AddRow();
     TupleRow* output_row = output_batch->GetRow(output_row_index);
     if (deep_copy_input_) {
@@ -174,23 +164,29 @@ Status SortedRunMerger::GetNext(RowBatch* output_batch, bool* eos) {
   // Free local allocations made by comparator_.Less();
   comparator_.FreeLocalAllocations();
 
-  *eos = min_heap_.empty();
+  *eos = num_active_runs_ == 0;
   return Status::OK();
 }
 
 Status SortedRunMerger::AdvanceMinRow(RowBatch* transfer_batch) {
-  SortedRunWrapper* min = min_heap_[0];
+  int winner = losers_[0];
+  SortedRunWrapper* min = runs_[winner];
   bool min_run_complete;
   // Advance to the next element in min. output_batch is supplied to transfer
   // resource ownership if the input batch in min is exhausted.
   RETURN_IF_ERROR(min->Advance(deep_copy_input_ ? NULL : transfer_batch,
       &min_run_complete));
   if (min_run_complete) {
-    // Remove the element from the heap.
-    iter_swap(min_heap_.begin(), min_heap_.end() - 1);
-    min_heap_.pop_back();
+    runs_[winner] = NULL;
+    if (--num_active_runs_ == 0) return Status::OK();
+  }
+
+  // Replay the matches from the leaf of the previous winner up to the root. The new
+  // winner of each match moves up, the loser stays at the node.
+  for (int node = (winner + runs_.size()) / 2; node > 0; node /= 2) {
+    if (RunLess(losers_[node], winner)) swap(losers_[node], winner);
   }
-  if (!min_heap_.empty()) Heapify(0);
+  losers_[0] = winner;
   return Status::OK();
 }
 
@@ -30,8 +30,11 @@ class RuntimeProfile;
 
 /// SortedRunMerger is used to merge multiple sorted runs of tuples. A run is a sorted
 /// sequence of row batches, which are fetched from a RunBatchSupplierFn function object.
-/// Merging is implemented using a binary min-heap that maintains the run with the next
-/// tuple in sorted order at the top of the heap.
+/// Merging is implemented using a tournament tree of losers: each internal node of the
+/// tree holds the run that lost the comparison at that node, and the overall winner is
+/// the run with the next tuple in sorted order. Replacing the winner only replays the
+/// matches on the path from its leaf to the root, i.e. one comparison per level, where
+/// a binary heap needs up to two.
 ///
 /// Merged batches of rows are retrieved from SortedRunMerger via calls to GetNext().
 /// The merger is constructed with a boolean flag deep_copy_input.
@@ -44,6 +47,8 @@ class RuntimeProfile;
 /// if the RunBatchSupplierFn can return batches with the 'need_to_return' flag set,
 /// the merger must have 'deep_copy_input'. TODO: once 'need_to_return' is deprecated,
 /// this is no longer a problem.
+/// TODO: compare normalized keys (memcmp-able prefixes of the ordering exprs) where the
+/// key types allow it, instead of evaluating the ordering exprs for every comparison.
 class SortedRunMerger {
  public:
   /// Function that returns the next batch of rows from an input sorted run. The batch
@@ -56,8 +61,7 @@ class SortedRunMerger {
       RuntimeProfile* profile, bool deep_copy_input);
 
   /// Prepare this merger to merge and return rows from the sorted runs in 'input_runs'.
-  /// Retrieves the first batch from each run and sets up the binary heap implementing
-  /// the priority queue.
+  /// Retrieves the first batch from each run and plays the initial tournament.
   Status Prepare(const std::vector<RunBatchSupplierFn>& input_runs);
 
   /// Return the next batch of sorted rows from this merger.
@@ -71,22 +75,36 @@ class SortedRunMerger {
   /// attach resources to.
   ///
   /// When AdvanceMinRow returns, the previous min is advanced to the next row and the
-  /// heap is reordered accordingly. The RunBatchSupplierFn is removed from the heap if
-  /// this was its last row. Any completed resources are transferred to the batch.
+  /// matches on the path of its leaf are replayed. If this was the last row of the run,
+  /// the run is marked as exhausted and loses every later match. Any completed
+  /// resources are transferred to the batch.
   Status AdvanceMinRow(RowBatch* transfer_batch);
 
-  /// Assuming the element at parent_index is the only out of place element in the heap,
-  /// restore the heap property (i.e. swap elements so parent <= children).
-  void Heapify(int parent_index);
-
-  /// The binary min-heap used to merge rows from the sorted input runs. Since the heap is
-  /// stored in a 0-indexed array, the 0-th element is the minimum element in the heap,
-  /// and the children of the element at index i are 2*i+1 and 2*i+2. The heap property is
-  /// that row of the parent element is <= the rows of the child elements according to the
-  /// comparator comparator_.
-  /// The SortedRunWrapper objects used in the min_heap_ are owned by this
-  /// SortedRunMerger instance.
-  std::vector<SortedRunWrapper*> min_heap_;
+  /// Plays the initial tournament of the subtree rooted at 'node', storing the loser of
+  /// each match in 'losers_'. Returns the index of the winning run.
+  int PlayTournament(int node);
+
+  /// Returns true if the run at 'lhs' must be returned before the run at 'rhs'.
+  /// Exhausted runs sort after all other runs.
+  bool RunLess(int lhs, int rhs) {
+    if (runs_[lhs] == NULL) return false;
+    if (runs_[rhs] == NULL) return true;
+    return comparator_.Less(runs_[lhs]->current_row(), runs_[rhs]->current_row());
+  }
+
+  /// The input runs, indexed by their leaf in the tournament tree. Set to NULL once a
+  /// run is exhausted. The SortedRunWrapper objects are owned by this SortedRunMerger
+  /// instance.
+  std::vector<SortedRunWrapper*> runs_;
+
+  /// The tournament tree over runs_. With n runs, the tree is stored in an array of n
+  /// nodes: the leaf of run i is (implicitly) node n + i, the parent of node i is i / 2,
+  /// losers_[i] for 1 <= i < n is the index of the run that lost the match at internal
+  /// node i and losers_[0] is the index of the overall winner.
+  std::vector<int> losers_;
+
+  /// Number of runs in runs_ that are not exhausted.
+  int num_active_runs_;
 
   /// Row comparator. Returns true if lhs < rhs.
   TupleRowComparator comparator_;
@@ -14,6 +14,7 @@
 
 #include "runtime/sorter.h"
 
+#include <limits>
 #include <boost/random/mersenne_twister.hpp>
 #include <boost/random/uniform_int.hpp>
 #include <gutil/strings/substitute.h>
@@ -22,6 +23,8 @@
 #include "runtime/row-batch.h"
 #include "runtime/runtime-state.h"
 #include "runtime/sorted-run-merger.h"
+#include "util/key-normalizer.inline.h"
+#include "util/radix-sort.h"
 #include "util/runtime-profile-counters.h"
 
 #include "common/names.h"
@@ -30,6 +33,13 @@ using boost::uniform_int;
 using boost::mt19937_64;
 using namespace strings;
 
+DEFINE_int32(sort_normalized_key_len, 16, "(Advanced) The maximum number of bytes of "
+    "the leading sort keys that in-memory sorts normalize into memcmp-comparable keys "
+    "to avoid evaluating the ordering exprs on most comparisons. 0 disables it.");
+DEFINE_bool(sort_spill_compression, true, "(Advanced) If true, sorts compress their "
+    "runs with LZ4 when they spill to disk, even if --disk_spill_compression is false. "
+    "Adjacent tuples of sorted runs share key prefixes, so they compress well.");
+
 namespace impala {
 
 // Number of pinned blocks required for a merge with fixed-length data only.
@@ -399,7 +409,7 @@ class Sorter::TupleIterator {
 class Sorter::TupleSorter {
  public:
   TupleSorter(const TupleRowComparator& comparator, int64_t block_size,
-      int tuple_size, RuntimeState* state);
+      int tuple_size, MemTracker* mem_tracker, RuntimeState* state);
 
   ~TupleSorter();
 
@@ -412,6 +422,12 @@ class Sorter::TupleSorter {
  private:
   static const int INSERTION_THRESHOLD = 16;
 
+  /// Runs with at least this many tuples and normalized keys of at most
+  /// RADIX_SORT_MAX_KEY_LEN bytes are radix sorted. Radix sort needs a pass over the
+  /// tuples per key byte, so it loses its advantage over quicksort for longer keys.
+  static const int RADIX_SORT_MIN_TUPLES = 1024;
+  static const int RADIX_SORT_MAX_KEY_LEN = 9;
+
   /// Size of the tuples in memory.
   const int tuple_size_;
 
@@ -433,6 +449,28 @@ class Sorter::TupleSorter {
   uint8_t* temp_tuple_buffer_;
   uint8_t* swap_buffer_;
 
+  /// Normalizes the leading sort keys of a tuple into a memcmp-comparable key of
+  /// 'key_len_' bytes. NULL if the first sort key cannot be normalized.
+  boost::scoped_ptr<KeyNormalizer> key_normalizer_;
+  int key_len_;
+
+  /// True if equal normalized keys imply that the tuples are equal, i.e. all sort keys
+  /// are normalized and fit into 'key_len_' bytes.
+  bool keys_complete_;
+
+  /// Tracks the memory of 'keys_'. Not owned.
+  MemTracker* const mem_tracker_;
+
+  /// The normalized keys of the tuples in 'run_', 'key_len_' bytes per tuple in the
+  /// order of the tuples. Swapped and copied along with the tuples. NULL if the run is
+  /// sorted without normalized keys, e.g. because the memory was not available.
+  uint8_t* keys_;
+  int64_t keys_bytes_;
+
+  /// Like 'temp_tuple_buffer_' and 'swap_buffer_', but for normalized keys.
+  uint8_t* temp_key_buffer_;
+  uint8_t* swap_key_buffer_;
+
   /// Random number generator used to randomly choose pivots. We need a RNG that
   /// can generate 64-bit ints. Quality of randomness doesn't need to be especially
   /// high: Mersenne Twister should be more than adequate.
@@ -443,6 +481,38 @@ class Sorter::TupleSorter {
   /// if 'lhs' is less than 'rhs'.
   bool Less(const TupleRow* lhs, const TupleRow* rhs);
 
+  /// Like above, but first compares the normalized keys 'lhs_key' and 'rhs_key' and
+  /// only compares the rows if the keys are equal and not complete. The keys are NULL
+  /// if 'keys_' is NULL.
+  bool Less(const uint8_t* lhs_key, const TupleRow* lhs, const uint8_t* rhs_key,
+      const TupleRow* rhs);
+
+  /// Compares the tuples that 'lhs' and 'rhs' point to, using their normalized keys.
+  bool Less(const TupleIterator& lhs, const TupleIterator& rhs);
+
+  /// Returns the normalized key of the tuple that 'iter' points to, or NULL if the run
+  /// is sorted without normalized keys.
+  uint8_t* Key(const TupleIterator& iter) const {
+    return keys_ == NULL ? NULL : keys_ + iter.index() * key_len_;
+  }
+
+  /// Allocates 'keys_' and normalizes the keys of all tuples in 'run_'. Leaves 'keys_'
+  /// NULL if there is no normalizer or the memory for the keys is not available.
+  Status NormalizeKeys();
+
+  /// Frees 'keys_' if it was allocated.
+  void FreeKeys();
+
+  /// Sorts 'run_' by radix sorting the normalized keys and moving the tuples into the
+  /// sorted order. Tuples with equal keys are then sorted with SortHelper() unless the
+  /// keys are complete. Sets 'sorted' to false without changing the run if the memory
+  /// for the permutation is not available.
+  Status RadixSortRun(bool* sorted);
+
+  /// Moves the tuples and normalized keys of 'run_' so that position i holds the tuple
+  /// that was at position order[i]. Overwrites 'order'.
+  void ApplyPermutation(uint32_t* order);
+
   /// Perform an insertion sort for rows in the range [begin, end) in a run.
   /// Only valid to call for ranges of size at least 1.
   Status InsertionSort(const TupleIterator& begin, const TupleIterator& end);
@@ -452,7 +522,7 @@ class Sorter::TupleSorter {
   /// tuples in the second group are >= pivot. Tuples are swapped in place to create the
   /// groups and the index to the first element in the second group is returned in 'cut'.
   /// Return an error status if any error is encountered or if the query is cancelled.
-  Status Partition(TupleIterator begin, TupleIterator end, const Tuple* pivot,
+  Status Partition(TupleIterator begin, TupleIterator end, const TupleIterator& pivot,
       TupleIterator* cut);
 
   /// Performs a quicksort of rows in the range [begin, end) followed by insertion sort
@@ -461,13 +531,14 @@ class Sorter::TupleSorter {
   Status SortHelper(TupleIterator begin, TupleIterator end);
 
   /// Select a pivot to partition [begin, end).
-  Tuple* SelectPivot(TupleIterator begin, TupleIterator end);
+  TupleIterator SelectPivot(TupleIterator begin, TupleIterator end);
 
   /// Return median of three tuples according to the sort comparator.
-  Tuple* MedianOfThree(Tuple* t1, Tuple* t2, Tuple* t3);
+  TupleIterator MedianOfThree(const TupleIterator& t1, const TupleIterator& t2,
+      const TupleIterator& t3);
 
-  /// Swaps tuples pointed to by left and right using 'swap_tuple'.
-  static void Swap(Tuple* left, Tuple* right, Tuple* swap_tuple, int tuple_size);
+  /// Swaps the 'len' bytes pointed to by left and right using 'swap_buffer'.
+  static void Swap(uint8_t* left, uint8_t* right, uint8_t* swap_buffer, int len);
 };
 
 // Sorter::Run methods
@@ -1113,18 +1184,62 @@ void Sorter::TupleIterator::PrevBlock(Sorter::Run* run, int tuple_size) {
 }
 
 Sorter::TupleSorter::TupleSorter(const TupleRowComparator& comp, int64_t block_size,
-    int tuple_size, RuntimeState* state)
+    int tuple_size, MemTracker* mem_tracker, RuntimeState* state)
   : tuple_size_(tuple_size),
     comparator_(comp),
     num_comparisons_till_free_(state->batch_size()),
-    state_(state) {
+    state_(state),
+    key_len_(0),
+    keys_complete_(false),
+    mem_tracker_(mem_tracker),
+    keys_(NULL),
+    keys_bytes_(0),
+    temp_key_buffer_(NULL),
+    swap_key_buffer_(NULL) {
   temp_tuple_buffer_ = new uint8_t[tuple_size];
   swap_buffer_ = new uint8_t[tuple_size];
+
+  // Normalize the longest prefix of the sort keys that KeyNormalizer supports. A string
+  // key always ends the normalized key.
+  const vector<ExprContext*>& key_expr_ctxs = comp.key_expr_ctxs_lhs();
+  vector<ExprContext*> normalized_expr_ctxs;
+  vector<bool> is_asc;
+  vector<bool> nulls_first;
+  int complete_key_len = 0;
+  keys_complete_ = true;
+  for (int i = 0; i < key_expr_ctxs.size(); ++i) {
+    const ColumnType& type = key_expr_ctxs[i]->root()->type();
+    if (!KeyNormalizer::CanNormalize(type)) {
+      keys_complete_ = false;
+      break;
+    }
+    normalized_expr_ctxs.push_back(key_expr_ctxs[i]);
+    is_asc.push_back(comp.is_asc()[i]);
+    nulls_first.push_back(comp.nulls_first(i));
+    if (type.IsVarLenStringType()) {
+      keys_complete_ = false;
+      complete_key_len = FLAGS_sort_normalized_key_len;
+      break;
+    }
+    // The null byte and the value.
+    complete_key_len += 1 + type.GetByteSize();
+  }
+  key_len_ = min(complete_key_len, FLAGS_sort_normalized_key_len);
+  if (complete_key_len > key_len_) keys_complete_ = false;
+  if (key_len_ > 0) {
+    key_normalizer_.reset(
+        new KeyNormalizer(normalized_expr_ctxs, key_len_, is_asc, nulls_first));
+    temp_key_buffer_ = new uint8_t[key_len_];
+    swap_key_buffer_ = new uint8_t[key_len_];
+  }
 }
 
 Sorter::TupleSorter::~TupleSorter() {
+  FreeKeys();
   delete[] temp_tuple_buffer_;
   delete[] swap_buffer_;
+  delete[] temp_key_buffer_;
+  delete[] swap_key_buffer_;
 }
 
 bool Sorter::TupleSorter::Less(const TupleRow* lhs, const TupleRow* rhs) {
@@ -1137,11 +1252,141 @@ bool Sorter::TupleSorter::Less(const TupleRow* lhs, const TupleRow* rhs) {
   return comparator_.Less(lhs, rhs);
 }
 
+bool Sorter::TupleSorter::Less(const uint8_t* lhs_key, const TupleRow* lhs,
+    const uint8_t* rhs_key, const TupleRow* rhs) {
+  if (lhs_key != NULL) {
+    int result = memcmp(lhs_key, rhs_key, key_len_);
+    if (result != 0) return result < 0;
+    if (keys_complete_) return false;
+  }
+  return Less(lhs, rhs);
+}
+
+bool Sorter::TupleSorter::Less(const TupleIterator& lhs, const TupleIterator& rhs) {
+  return Less(Key(lhs), lhs.row(), Key(rhs), rhs.row());
+}
+
+Status Sorter::TupleSorter::NormalizeKeys() {
+  DCHECK(keys_ == NULL);
+  if (key_normalizer_ == NULL) return Status::OK();
+  int64_t keys_bytes = run_->num_tuples() * key_len_;
+  // Sort without normalized keys if the memory is not available.
+  if (keys_bytes == 0 || !mem_tracker_->TryConsume(keys_bytes)) return Status::OK();
+  keys_ = reinterpret_cast<uint8_t*>(malloc(keys_bytes));
+  if (keys_ == NULL) {
+    mem_tracker_->Release(keys_bytes);
+    return Status::OK();
+  }
+  keys_bytes_ = keys_bytes;
+
+  Run* run = run_;
+  int tuple_size = tuple_size_;
+  int num_till_free = state_->batch_size();
+  for (TupleIterator iter = TupleIterator::Begin(run); iter.index() < run->num_tuples();
+       iter.Next(run, tuple_size)) {
+    key_normalizer_->NormalizeKey(iter.row(), Key(iter));
+    if (UNLIKELY(--num_till_free == 0)) {
+      comparator_.FreeLocalAllocations();
+      num_till_free = state_->batch_size();
+      RETURN_IF_CANCELLED(state_);
+      RETURN_IF_ERROR(state_->GetQueryStatus());
+    }
+  }
+  comparator_.FreeLocalAllocations();
+  return Status::OK();
+}
+
+void Sorter::TupleSorter::FreeKeys() {
+  if (keys_ == NULL) return;
+  free(keys_);
+  mem_tracker_->Release(keys_bytes_);
+  keys_ = NULL;
+  keys_bytes_ = 0;
+}
+
+Status Sorter::TupleSorter::RadixSortRun(bool* sorted) {
+  DCHECK(keys_ != NULL);
+  *sorted = false;
+  uint32_t num_tuples = run_->num_tuples();
+  // The permutation and the scratch space for RadixSort::SortKeys().
+  int64_t order_bytes = 2L * num_tuples * sizeof(uint32_t);
+  if (!mem_tracker_->TryConsume(order_bytes)) return Status::OK();
+  uint32_t* order = reinterpret_cast<uint32_t*>(malloc(order_bytes));
+  if (order == NULL) {
+    mem_tracker_->Release(order_bytes);
+    return Status::OK();
+  }
+  RadixSort::SortKeys(keys_, key_len_, num_tuples, order, order + num_tuples);
+  ApplyPermutation(order);
+  free(order);
+  mem_tracker_->Release(order_bytes);
+  *sorted = true;
+  RETURN_IF_CANCELLED(state_);
+  if (keys_complete_) return Status::OK();
+
+  // Sort each range of tuples with equal normalized keys by the full sort keys.
+  Run* run = run_;
+  int tuple_size = tuple_size_;
+  TupleIterator range_begin = TupleIterator::Begin(run);
+  TupleIterator iter = range_begin;
+  for (iter.Next(run, tuple_size); ; iter.Next(run, tuple_size)) {
+    if (iter.index() < num_tuples &&
+        memcmp(Key(iter), Key(range_begin), key_len_) == 0) {
+      continue;
+    }
+    if (iter.index() - range_begin.index() > 1) {
+      RETURN_IF_ERROR(SortHelper(range_begin, iter));
+    }
+    if (iter.index() == num_tuples) break;
+    range_begin = iter;
+  }
+  return Status::OK();
+}
+
+void Sorter::TupleSorter::ApplyPermutation(uint32_t* order) {
+  uint32_t num_tuples = run_->num_tuples();
+  int tuple_size = tuple_size_;
+  int key_len = key_len_;
+  // Move the tuples cycle by cycle, marking the positions that are done with
+  // order[i] == i.
+  for (uint32_t i = 0; i < num_tuples; ++i) {
+    if (order[i] == i) continue;
+    TupleIterator first(run_, i);
+    memcpy(temp_tuple_buffer_, first.tuple(), tuple_size);
+    memcpy(temp_key_buffer_, Key(first), key_len);
+    uint32_t pos = i;
+    while (order[pos] != i) {
+      uint32_t src_pos = order[pos];
+      TupleIterator dst(run_, pos);
+      TupleIterator src(run_, src_pos);
+      memcpy(dst.tuple(), src.tuple(), tuple_size);
+      memcpy(Key(dst), Key(src), key_len);
+      order[pos] = pos;
+      pos = src_pos;
+    }
+    TupleIterator last(run_, pos);
+    memcpy(last.tuple(), temp_tuple_buffer_, tuple_size);
+    memcpy(Key(last), temp_key_buffer_, key_len);
+    order[pos] = pos;
+  }
+}
+
 Status Sorter::TupleSorter::Sort(Run* run) {
   DCHECK(run->is_finalized());
   DCHECK(!run->is_sorted());
   run_ = run;
-  RETURN_IF_ERROR(SortHelper(TupleIterator::Begin(run_), TupleIterator::End(run_)));
+  Status status = NormalizeKeys();
+  bool sorted = false;
+  if (status.ok() && keys_ != NULL && key_len_ <= RADIX_SORT_MAX_KEY_LEN &&
+      run_->num_tuples() >= RADIX_SORT_MIN_TUPLES &&
+      run_->num_tuples() <= std::numeric_limits<uint32_t>::max()) {
+    status = RadixSortRun(&sorted);
+  }
+  if (status.ok() && !sorted) {
+    status = SortHelper(TupleIterator::Begin(run_), TupleIterator::End(run_));
+  }
+  FreeKeys();
+  RETURN_IF_ERROR(status);
   run_->set_sorted();
   return Status::OK();
 }
@@ -1160,6 +1405,8 @@ Status Sorter::TupleSorter::InsertionSort(const TupleIterator& begin,
   Run* run = run_;
   int tuple_size = tuple_size_;
   uint8_t* temp_tuple_buffer = temp_tuple_buffer_;
+  int key_len = key_len_;
+  uint8_t* temp_key = keys_ == NULL ? NULL : temp_key_buffer_;
 
   TupleIterator insert_iter = begin;
   insert_iter.Next(run, tuple_size);
@@ -1168,6 +1415,7 @@ Status Sorter::TupleSorter::InsertionSort(const TupleIterator& begin,
     // be inserted into the sorted sequence. Copy to temp_tuple_buffer_ since it may be
     // overwritten by the one at position 'insert_iter - 1'
     memcpy(temp_tuple_buffer, insert_iter.tuple(), tuple_size);
+    if (temp_key != NULL) memcpy(temp_key, Key(insert_iter), key_len);
 
     // 'iter' points to the tuple that temp_tuple_buffer will be compared to.
     // 'copy_to' is the where iter should be copied to if it is >= temp_tuple_buffer.
@@ -1175,9 +1423,15 @@ Status Sorter::TupleSorter::InsertionSort(const TupleIterator& begin,
     TupleIterator iter = insert_iter;
     iter.Prev(run, tuple_size);
     Tuple* copy_to = insert_iter.tuple();
-    while (Less(reinterpret_cast<TupleRow*>(&temp_tuple_buffer), iter.row())) {
+    uint8_t* copy_to_key = Key(insert_iter);
+    while (Less(temp_key, reinterpret_cast<TupleRow*>(&temp_tuple_buffer), Key(iter),
+        iter.row())) {
       memcpy(copy_to, iter.tuple(), tuple_size);
       copy_to = iter.tuple();
+      if (temp_key != NULL) {
+        memcpy(copy_to_key, Key(iter), key_len);
+        copy_to_key = Key(iter);
+      }
       // Break if 'iter' has reached the first row, meaning that the temp row
       // will be inserted in position 'begin'
       if (iter.index() <= begin.index()) break;
@@ -1185,6 +1439,7 @@ Status Sorter::TupleSorter::InsertionSort(const TupleIterator& begin,
     }
 
     memcpy(copy_to, temp_tuple_buffer, tuple_size);
+    if (temp_key != NULL) memcpy(copy_to_key, temp_key, key_len);
   }
   RETURN_IF_CANCELLED(state_);
   RETURN_IF_ERROR(state_->GetQueryStatus());
@@ -1192,33 +1447,41 @@ Status Sorter::TupleSorter::InsertionSort(const TupleIterator& begin,
 }
 
 Status Sorter::TupleSorter::Partition(TupleIterator begin,
-    TupleIterator end, const Tuple* pivot, TupleIterator* cut) {
+    TupleIterator end, const TupleIterator& pivot, TupleIterator* cut) {
   // Hoist member variable lookups out of loop to avoid extra loads inside loop.
   Run* run = run_;
   int tuple_size = tuple_size_;
   Tuple* temp_tuple = reinterpret_cast<Tuple*>(temp_tuple_buffer_);
-  Tuple* swap_tuple = reinterpret_cast<Tuple*>(swap_buffer_);
+  uint8_t* swap_buffer = swap_buffer_;
+  int key_len = key_len_;
+  uint8_t* temp_key = keys_ == NULL ? NULL : temp_key_buffer_;
+  uint8_t* swap_key_buffer = swap_key_buffer_;
 
   // Copy pivot into temp_tuple since it points to a tuple within [begin, end).
   DCHECK(temp_tuple != NULL);
-  DCHECK(pivot != NULL);
-  memcpy(temp_tuple, pivot, tuple_size);
+  DCHECK(pivot.tuple() != NULL);
+  memcpy(temp_tuple, pivot.tuple(), tuple_size);
+  if (temp_key != NULL) memcpy(temp_key, Key(pivot), key_len);
 
   TupleIterator left = begin;
   TupleIterator right = end;
   right.Prev(run, tuple_size); // Set 'right' to the last tuple in range.
   while (true) {
     // Search for the first and last out-of-place elements, and swap them.
-    while (Less(left.row(), reinterpret_cast<TupleRow*>(&temp_tuple))) {
+    while (Less(Key(left), left.row(), temp_key,
+        reinterpret_cast<TupleRow*>(&temp_tuple))) {
       left.Next(run, tuple_size);
     }
-    while (Less(reinterpret_cast<TupleRow*>(&temp_tuple), right.row())) {
+    while (Less(temp_key, reinterpret_cast<TupleRow*>(&temp_tuple), Key(right),
+        right.row())) {
       right.Prev(run, tuple_size);
     }
 
     if (left.index() >= right.index()) break;
     // Swap first and last tuples.
-    Swap(left.tuple(), right.tuple(), swap_tuple, tuple_size);
+    Swap(reinterpret_cast<uint8_t*>(left.tuple()),
+        reinterpret_cast<uint8_t*>(right.tuple()), swap_buffer, tuple_size);
+    if (temp_key != NULL) Swap(Key(left), Key(right), swap_key_buffer, key_len);
 
     left.Next(run, tuple_size);
     right.Prev(run, tuple_size);
@@ -1237,7 +1500,7 @@ Status Sorter::TupleSorter::SortHelper(TupleIterator begin, TupleIterator end) {
     // Select a pivot and call Partition() to split the tuples in [begin, end) into two
     // groups (<= pivot and >= pivot) in-place. 'cut' is the index of the first tuple in
     // the second group.
-    Tuple* pivot = SelectPivot(begin, end);
+    TupleIterator pivot = SelectPivot(begin, end);
     TupleIterator cut;
     RETURN_IF_ERROR(Partition(begin, end, pivot, &cut));
 
@@ -1257,7 +1520,8 @@ Status Sorter::TupleSorter::SortHelper(TupleIterator begin, TupleIterator end) {
   return Status::OK();
 }
 
-Tuple* Sorter::TupleSorter::SelectPivot(TupleIterator begin, TupleIterator end) {
+Sorter::TupleIterator Sorter::TupleSorter::SelectPivot(TupleIterator begin,
+    TupleIterator end) {
   // Select the median of three random tuples. The random selection avoids pathological
   // behaviour associated with techniques that pick a fixed element (e.g. picking
   // first/last/middle element) and taking the median tends to help us select better
@@ -1270,25 +1534,21 @@ Tuple* Sorter::TupleSorter::SelectPivot(TupleIterator begin, TupleIterator end)
   // less than 1%. Since selection is random each time, the chance of repeatedly picking
   // bad pivots decreases exponentialy and becomes negligibly small after a few
   // iterations.
-  Tuple* tuples[3];
+  TupleIterator iters[3];
   for (int i = 0; i < 3; ++i) {
     int64_t index = uniform_int<int64_t>(begin.index(), end.index() - 1)(rng_);
-    TupleIterator iter(run_, index);
-    DCHECK(iter.tuple() != NULL);
-    tuples[i] = iter.tuple();
+    iters[i] = TupleIterator(run_, index);
+    DCHECK(iters[i].tuple() != NULL);
   }
 
-  return MedianOfThree(tuples[0], tuples[1], tuples[2]);
+  return MedianOfThree(iters[0], iters[1], iters[2]);
 }
 
-Tuple* Sorter::TupleSorter::MedianOfThree(Tuple* t1, Tuple* t2, Tuple* t3) {
-  TupleRow* tr1 = reinterpret_cast<TupleRow*>(&t1);
-  TupleRow* tr2 = reinterpret_cast<TupleRow*>(&t2);
-  TupleRow* tr3 = reinterpret_cast<TupleRow*>(&t3);
-
-  bool t1_lt_t2 = Less(tr1, tr2);
-  bool t2_lt_t3 = Less(tr2, tr3);
-  bool t1_lt_t3 = Less(tr1, tr3);
+Sorter::TupleIterator Sorter::TupleSorter::MedianOfThree(const TupleIterator& t1,
+    const TupleIterator& t2, const TupleIterator& t3) {
+  bool t1_lt_t2 = Less(t1, t2);
+  bool t2_lt_t3 = Less(t2, t3);
+  bool t1_lt_t3 = Less(t1, t3);
 
   if (t1_lt_t2) {
     // t1 < t2
@@ -1317,11 +1577,11 @@ Tuple* Sorter::TupleSorter::MedianOfThree(Tuple* t1, Tuple* t2, Tuple* t3) {
   }
 }
 
-inline void Sorter::TupleSorter::Swap(Tuple* left, Tuple* right, Tuple* swap_tuple,
-    int tuple_size) {
-  memcpy(swap_tuple, left, tuple_size);
-  memcpy(left, right, tuple_size);
-  memcpy(right, swap_tuple, tuple_size);
+inline void Sorter::TupleSorter::Swap(uint8_t* left, uint8_t* right,
+    uint8_t* swap_buffer, int len) {
+  memcpy(swap_buffer, left, len);
+  memcpy(left, right, len);
+  memcpy(right, swap_buffer, len);
 }
 
 Sorter::Sorter(const TupleRowComparator& compare_less_than,
@@ -1358,7 +1618,8 @@ Status Sorter::Init() {
   TupleDescriptor* sort_tuple_desc = output_row_desc_->tuple_descriptors()[0];
   has_var_len_slots_ = sort_tuple_desc->HasVarlenSlots();
   in_mem_tuple_sorter_.reset(new TupleSorter(compare_less_than_,
-      block_mgr_->max_block_size(), sort_tuple_desc->byte_size(), state_));
+      block_mgr_->max_block_size(), sort_tuple_desc->byte_size(), mem_tracker_,
+      state_));
   unsorted_run_ = obj_pool_.Add(new Run(this, sort_tuple_desc, true));
 
   initial_runs_counter_ = ADD_COUNTER(profile_, "InitialRunsCreated", TUnit::UNIT);
@@ -1374,6 +1635,9 @@ Status Sorter::Init() {
 
   RETURN_IF_ERROR(block_mgr_->RegisterClient(Substitute("Sorter ptr=$0", this),
       min_buffers_required, false, mem_tracker_, state_, &block_mgr_client_));
+  if (FLAGS_sort_spill_compression) {
+    RETURN_IF_ERROR(block_mgr_->EnableCompression(block_mgr_client_));
+  }
 
   DCHECK(unsorted_run_ != NULL);
   RETURN_IF_ERROR(unsorted_run_->Init());
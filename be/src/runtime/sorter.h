@@ -54,7 +54,9 @@ class RowBatch;
 /// var-len slot pointers are converted to offsets from the start of the first var-len
 /// data block. When a block is read back, these offsets are converted back to pointers.
 /// The in-memory sorter sorts the fixed-length tuples in-place. The output rows have the
-/// same schema as the materialized sort tuples.
+/// same schema as the materialized sort tuples. Before sorting, it normalizes the leading
+/// sort keys of each tuple into a short memcmp-comparable key (see KeyNormalizer), so
+/// the ordering exprs only need to be evaluated when the normalized keys are equal.
 //
 /// After the input is consumed, the sorter is left with one or more sorted runs. If
 /// there are multiple runs, the runs are merged using SortedRunMerger. At least one
@@ -84,6 +86,11 @@ class RowBatch;
 /// TODO: When the first run is constructed, create a sequence of pointers to materialized
 /// tuples. If the input fits in memory, the pointers can be sorted instead of sorting the
 /// tuples in place.
+/// TODO: use more than one thread. Sorting a run in the background while the next run is
+/// filled needs the blocks of both runs pinned, but a run is only full once it has all
+/// the blocks that the sorter can pin. The comparator's expr contexts, the KeyNormalizer
+/// and SortedRunMerger assume a single thread, so sorting or merging key ranges in
+/// parallel needs cloned expr contexts per thread and key range boundaries from a sample.
 class Sorter {
  public:
   /// sort_tuple_slot_exprs are the slot exprs used to materialize the tuple to be sorted.
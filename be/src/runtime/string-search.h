@@ -18,6 +18,7 @@
 
 #include <vector>
 #include <cstring>
+#include <emmintrin.h>
 #include <boost/cstdint.hpp>
 
 #include "common/logging.h"
@@ -25,11 +26,17 @@
 
 namespace impala {
 
-/// TODO: This can be sped up with SIDD_CMP_EQUAL_ORDERED or at the very least rewritten
-/// from published algorithms.
+/// Patterns of two or more characters are first searched for with SSE2, which compares
+/// the first and last characters of the pattern against 16 positions of the string at a
+/// time and only compares the rest of the pattern at positions where both match. This
+/// filters out almost all positions for the patterns seen in practice. SSE2 is part of
+/// the x86-64 baseline, so no CpuInfo check is needed. The last positions of the string
+/// that don't fill a 16 byte block are searched with the scalar algorithm below. Unlike
+/// the prototype in experiments/string-search-sse.h, this doesn't require or modify
+/// null-terminated strings.
 //
-/// This is taken from the python search string function doing string search (substring)
-/// using an optimized boyer-moore-horspool algorithm.
+/// The scalar algorithm is taken from the python search string function doing string
+/// search (substring) using an optimized boyer-moore-horspool algorithm.
 /// http://hg.python.org/cpython/file/6b6c79eba944/Objects/stringlib/fastsearch.h
 //
 /// PYTHON SOFTWARE FOUNDATION LICENSE VERSION 2
@@ -127,12 +134,17 @@ class StringSearch {
       return -1;
     }
 
+    // Search the positions that the 16 byte blocks cover first.
+    int start = 0;
+    int result = SearchSSE(s, n, &start);
+    if (result != -1) return result;
+
     // General case.
     int j;
     // TODO: the original code seems to have an off by one error. It is possible
     // to index at w + m which is the length of the input string. Checks have
     // been added to make sure that w + m < str->len.
-    for (int i = 0; i <= w; i++) {
+    for (int i = start; i <= w; i++) {
       // note: using mlast in the skip path slows things down on x86
       if (s[i+m-1] == p[m-1]) {
         // candidate match
@@ -156,9 +168,39 @@ class StringSearch {
     return -1;
   }
 
+  /// Returns the length of the pattern.
+  int pattern_len() const { return pattern_ == NULL ? 0 : pattern_->len; }
+
  private:
   static const int BLOOM_WIDTH = 64;
 
+  /// Searches the pattern, which must have at least two characters, at the positions
+  /// of 's' for which the 16 byte blocks starting at the position and at the position of
+  /// the last pattern character fit in the 'n' characters of 's'. Returns the offset of
+  /// the first match or -1, and sets 'end' to the first position that wasn't searched.
+  int SearchSSE(const char* s, int n, int* end) const {
+    const char* p = pattern_->ptr;
+    int m = pattern_->len;
+    DCHECK_GE(m, 2);
+    const __m128i first = _mm_set1_epi8(p[0]);
+    const __m128i last = _mm_set1_epi8(p[m - 1]);
+    int i = 0;
+    for (; i + m - 1 + 16 <= n; i += 16) {
+      __m128i block_first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+      __m128i block_last =
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i + m - 1));
+      int mask = _mm_movemask_epi8(_mm_and_si128(
+          _mm_cmpeq_epi8(first, block_first), _mm_cmpeq_epi8(last, block_last)));
+      while (mask != 0) {
+        int offset = i + __builtin_ctz(mask);
+        if (memcmp(s + offset + 1, p + 1, m - 2) == 0) return offset;
+        mask &= mask - 1;
+      }
+    }
+    *end = i;
+    return -1;
+  }
+
   void BloomAdd(char c) {
     mask_ |= (1UL << (c & (BLOOM_WIDTH - 1)));
   }
@@ -28,6 +28,21 @@ StringValue FromStdString(const string& str) {
   return StringValue(ptr, len);
 }
 
+// Values that share their data, e.g. because they were decoded from the same
+// dictionary entry, are compared without looking at the data.
+TEST(StringValueTest, TestCompareSharedData) {
+  string str = "abcdef";
+  StringValue sv1 = FromStdString(str);
+  StringValue sv2 = FromStdString(str);
+  StringValue prefix(sv1.ptr, 3);
+  EXPECT_TRUE(sv1.Eq(sv2));
+  EXPECT_EQ(sv1.Compare(sv2), 0);
+  EXPECT_FALSE(prefix.Eq(sv1));
+  EXPECT_LT(prefix.Compare(sv1), 0);
+  EXPECT_GT(sv1.Compare(prefix), 0);
+  EXPECT_TRUE(StringValue(NULL, 0).Eq(StringValue(sv1.ptr, 0)));
+}
+
 TEST(StringValueTest, TestCompare) {
   string empty_str = "";
   string str1_str("\0", 1);
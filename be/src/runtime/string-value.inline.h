@@ -59,13 +59,13 @@ static inline int StringCompare(const char* s1, int n1, const char* s2, int n2,
 
 inline int StringValue::Compare(const StringValue& other) const {
   int l = std::min(len, other.len);
-  if (l == 0) {
+  // Values decoded from the same dictionary entry share their data, don't load it.
+  if (l == 0 || ptr == other.ptr) {
     if (len == other.len) {
       return 0;
-    } else if (len == 0) {
+    } else if (len < other.len) {
       return -1;
     } else {
-      DCHECK_EQ(other.len, 0);
       return 1;
     }
   }
@@ -74,6 +74,7 @@ inline int StringValue::Compare(const StringValue& other) const {
 
 inline bool StringValue::Eq(const StringValue& other) const {
   if (this->len != other.len) return false;
+  if (this->ptr == other.ptr || this->len == 0) return true;
   return StringCompare(this->ptr, this->len, other.ptr, other.len, this->len) == 0;
 }
 
@@ -39,6 +39,10 @@ class TestEnv {
   Status CreateQueryState(int64_t query_id, int max_buffers, int block_size,
       RuntimeState** runtime_state);
 
+  /// Same as above, but the query runs with 'query_options'.
+  Status CreateQueryState(int64_t query_id, int max_buffers, int block_size,
+      const TQueryOptions& query_options, RuntimeState** runtime_state);
+
   /// Create multiple separate RuntimeStates with associated block managers, e.g. as if
   /// multiple queries were executing. The RuntimeStates are owned by TestEnv.
   Status CreateQueryStates(int64_t start_query_id, int num_mgrs, int buffers_per_mgr,
@@ -63,7 +67,7 @@ class TestEnv {
   void InitMetrics();
 
   /// Create a new RuntimeState sharing global environment.
-  RuntimeState* CreateRuntimeState(int64_t query_id);
+  RuntimeState* CreateRuntimeState(int64_t query_id, const TQueryOptions& query_options);
 
   /// Global state for test environment.
   static boost::scoped_ptr<MetricGroup> static_metrics_;
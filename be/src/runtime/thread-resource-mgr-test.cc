@@ -21,6 +21,9 @@
 
 #include "common/names.h"
 
+DECLARE_bool(numa_aware_scheduling);
+DECLARE_string(thread_pool_weights);
+
 namespace impala {
 
 class NotifiedCounter {
@@ -161,6 +164,82 @@ TEST(ThreadResourceMgr, MultiCallbacks) {
   EXPECT_EQ(counter3.counter(), 1);
 }
 
+// Test that pools are spread evenly over the NUMA nodes.
+TEST(ThreadResourceMgr, NumaPlacement) {
+  FLAGS_numa_aware_scheduling = true;
+  ThreadResourceMgr mgr(5);
+  FLAGS_numa_aware_scheduling = false;
+  int num_nodes = CpuInfo::num_numa_nodes();
+  vector<ThreadResourceMgr::ResourcePool*> pools;
+  vector<int> pools_per_node(num_nodes);
+  for (int i = 0; i < 2 * num_nodes; ++i) {
+    ThreadResourceMgr::ResourcePool* pool = mgr.RegisterPool();
+    pools.push_back(pool);
+    if (num_nodes == 1) {
+      // Pools are not placed on machines without NUMA.
+      EXPECT_EQ(-1, pool->numa_node());
+      continue;
+    }
+    ASSERT_GE(pool->numa_node(), 0);
+    ASSERT_LT(pool->numa_node(), num_nodes);
+    ++pools_per_node[pool->numa_node()];
+  }
+  if (num_nodes > 1) {
+    for (int node = 0; node < num_nodes; ++node) {
+      if (CpuInfo::GetCoresOfNumaNode(node).empty()) continue;
+      EXPECT_GE(pools_per_node[node], 2);
+    }
+    // A new pool is placed on the node that a pool was unregistered from.
+    int node = pools.back()->numa_node();
+    mgr.UnregisterPool(pools.back());
+    pools.back() = mgr.RegisterPool();
+    EXPECT_EQ(node, pools.back()->numa_node());
+  }
+  for (ThreadResourceMgr::ResourcePool* pool: pools) mgr.UnregisterPool(pool);
+}
+
+// Test that the quota follows the request pool weights and that the unused share of
+// I/O-bound pools goes to the CPU-bound pools.
+TEST(ThreadResourceMgr, WeightsAndCpuUtilization) {
+  FLAGS_thread_pool_weights = "root.a";
+  EXPECT_FALSE(ThreadResourceMgr(8).Init().ok());
+  FLAGS_thread_pool_weights = "root.a:3,root.b:1";
+  ThreadResourceMgr mgr(8);
+  EXPECT_TRUE(mgr.Init().ok());
+  FLAGS_thread_pool_weights = "";
+  ThreadResourceMgr::ResourcePool* a = mgr.RegisterPool();
+  ThreadResourceMgr::ResourcePool* b = mgr.RegisterPool();
+  EXPECT_EQ(4, a->quota());
+  EXPECT_EQ(4, b->quota());
+  mgr.SetRequestPool(a, "root.a");
+  mgr.SetRequestPool(b, "root.b");
+  EXPECT_EQ(6, a->quota());
+  EXPECT_EQ(2, b->quota());
+
+  // 'c' is I/O-bound and only uses a quarter of the cores of its share. The rest is
+  // split between 'a' and 'b'.
+  ThreadResourceMgr::ResourcePool* c = mgr.RegisterPool();
+  mgr.SetRequestPool(c, "root.b");
+  c->ReportThreadTime(250, 1000);
+  a->ReportThreadTime(1000, 1000);
+  mgr.SetRequestPool(c, "root.a");
+  EXPECT_EQ(0.25, c->cpu_utilization());
+  EXPECT_EQ(1, a->cpu_utilization());
+  EXPECT_EQ(1, b->cpu_utilization());
+  EXPECT_EQ(6, a->quota());
+  EXPECT_EQ(2, b->quota());
+  EXPECT_EQ(4, c->quota());
+
+  // Once 'c' is CPU-bound, the system quota is split by weight again.
+  c->ReportThreadTime(1750, 1000);
+  mgr.UnregisterPool(b);
+  EXPECT_EQ(0.625, c->cpu_utilization());
+  EXPECT_EQ(4, a->quota());
+  EXPECT_EQ(4, c->quota());
+  mgr.UnregisterPool(a);
+  mgr.UnregisterPool(c);
+}
+
 }
 
 int main(int argc, char **argv) {
@@ -21,16 +21,30 @@
 #include <gflags/gflags.h>
 
 #include "common/logging.h"
+#include "gutil/strings/substitute.h"
 #include "util/cpu-info.h"
+#include "util/parse-util.h"
+#include "util/time.h"
 
 #include "common/names.h"
 
 using namespace impala;
+using namespace strings;
 
 // Controls the number of threads to run work per core.  It's common to pick 2x
 // or 3x the number of cores.  This keeps the cores busy without causing excessive
 // thrashing.
 DEFINE_int32(num_threads_per_core, 3, "Number of threads per core.");
+DEFINE_bool(numa_aware_scheduling, false, "(Advanced) If true, each plan fragment "
+    "instance is placed on the NUMA node that runs the fewest instances. Its fragment "
+    "and scanner threads only run on the cores of that node and its I/O buffers are "
+    "allocated there. Has no effect on machines with a single NUMA node.");
+DEFINE_string(thread_pool_weights, "", "(Advanced) Comma-separated list of "
+    "<request pool>:<weight> pairs. The thread quota of a plan fragment instance is "
+    "proportional to the weight of its request pool. Request pools that are not listed "
+    "have a weight of 1.");
+
+const double ThreadResourceMgr::CPU_BOUND_UTILIZATION = 0.5;
 
 ThreadResourceMgr::ThreadResourceMgr(int threads_quota) {
   DCHECK_GE(threads_quota, 0);
@@ -39,11 +53,28 @@ ThreadResourceMgr::ThreadResourceMgr(int threads_quota) {
   } else {
     system_threads_quota_ = threads_quota;
   }
-  per_pool_quota_ = 0;
+  if (FLAGS_numa_aware_scheduling && CpuInfo::num_numa_nodes() > 1) {
+    num_pools_per_numa_node_.resize(CpuInfo::num_numa_nodes());
+  }
+  next_numa_node_ = 0;
+}
+
+Status ThreadResourceMgr::Init() {
+  unique_lock<mutex> l(lock_);
+  string invalid_weight;
+  if (!ParseUtil::ParsePoolWeights(FLAGS_thread_pool_weights, &pool_weights_,
+      &invalid_weight)) {
+    return Status(Substitute("Invalid request pool weight in --thread_pool_weights: "
+        "'$0'", invalid_weight));
+  }
+  return Status::OK();
 }
 
 ThreadResourceMgr::ResourcePool::ResourcePool(ThreadResourceMgr* parent)
-  : parent_(parent) {
+  : parent_(parent),
+    numa_node_(-1),
+    weight_(1),
+    quota_(0) {
 }
 
 void ThreadResourceMgr::ResourcePool::Reset() {
@@ -53,6 +84,21 @@ void ThreadResourceMgr::ResourcePool::Reset() {
   num_callbacks_ = 0;
   next_callback_idx_ = 0;
   max_quota_ = INT_MAX;
+  weight_ = 1;
+  quota_ = 0;
+  cpu_time_ns_.Store(0);
+  wall_time_ns_.Store(0);
+  last_cpu_time_ns_ = 0;
+  last_wall_time_ns_ = 0;
+  cpu_utilization_ = 1;
+  has_cpu_utilization_ = false;
+}
+
+void ThreadResourceMgr::ResourcePool::BindCurrentThreadToNumaNode() {
+  if (numa_node_ == -1) return;
+  if (!CpuInfo::BindCurrentThreadToNumaNode(numa_node_)) {
+    VLOG_QUERY << "Could not bind thread to NUMA node " << numa_node_;
+  }
 }
 
 void ThreadResourceMgr::ResourcePool::ReserveOptionalTokens(int num) {
@@ -60,6 +106,13 @@ void ThreadResourceMgr::ResourcePool::ReserveOptionalTokens(int num) {
   num_reserved_optional_threads_ = num;
 }
 
+void ThreadResourceMgr::ResourcePool::ReportThreadTime(int64_t cpu_ns,
+    int64_t wall_ns) {
+  cpu_time_ns_.Add(cpu_ns);
+  wall_time_ns_.Add(wall_ns);
+  parent_->MaybeUpdatePoolQuotas();
+}
+
 ThreadResourceMgr::ResourcePool* ThreadResourceMgr::RegisterPool() {
   unique_lock<mutex> l(lock_);
   ResourcePool* pool = NULL;
@@ -75,6 +128,20 @@ ThreadResourceMgr::ResourcePool* ThreadResourceMgr::RegisterPool() {
   pools_.insert(pool);
   pool->Reset();
 
+  pool->numa_node_ = -1;
+  for (int i = 0; i < num_pools_per_numa_node_.size(); ++i) {
+    int node = (next_numa_node_ + i) % num_pools_per_numa_node_.size();
+    if (CpuInfo::GetCoresOfNumaNode(node).empty()) continue;
+    if (pool->numa_node_ == -1 ||
+        num_pools_per_numa_node_[node] < num_pools_per_numa_node_[pool->numa_node_]) {
+      pool->numa_node_ = node;
+    }
+  }
+  if (pool->numa_node_ != -1) {
+    ++num_pools_per_numa_node_[pool->numa_node_];
+    next_numa_node_ = (pool->numa_node_ + 1) % num_pools_per_numa_node_.size();
+  }
+
   // Added a new pool, update the quotas for each pool.
   UpdatePoolQuotas(pool);
   return pool;
@@ -86,10 +153,22 @@ void ThreadResourceMgr::UnregisterPool(ResourcePool* pool) {
   unique_lock<mutex> l(lock_);
   DCHECK(pools_.find(pool) != pools_.end());
   pools_.erase(pool);
+  if (pool->numa_node_ != -1) --num_pools_per_numa_node_[pool->numa_node_];
   free_pool_objs_.push_back(pool);
   UpdatePoolQuotas();
 }
 
+void ThreadResourceMgr::SetRequestPool(ResourcePool* pool, const string& request_pool) {
+  DCHECK(pool != NULL);
+  unique_lock<mutex> l(lock_);
+  DCHECK(pools_.find(pool) != pools_.end());
+  map<string, int>::const_iterator it = pool_weights_.find(request_pool);
+  int weight = it == pool_weights_.end() ? 1 : it->second;
+  if (weight == pool->weight_) return;
+  pool->weight_ = weight;
+  UpdatePoolQuotas();
+}
+
 int ThreadResourceMgr::ResourcePool::AddThreadAvailableCb(ThreadAvailableCb fn) {
   unique_lock<mutex> l(lock_);
   // The id is unique for each callback and is monotonically increasing.
@@ -131,13 +210,62 @@ void ThreadResourceMgr::ResourcePool::InvokeCallbacks() {
 
 void ThreadResourceMgr::UpdatePoolQuotas(ResourcePool* new_pool) {
   if (pools_.empty()) return;
-  per_pool_quota_ =
-      ceil(static_cast<double>(system_threads_quota_) / pools_.size());
-  // Only invoke callbacks on pool unregistration.
-  if (new_pool == NULL) {
-    for (Pools::iterator it = pools_.begin(); it != pools_.end(); ++it) {
-      ResourcePool* pool = *it;
+  next_quota_update_ms_.Store(MonotonicMillis() + QUOTA_UPDATE_INTERVAL_MS);
+
+  // Update the CPU utilization of each pool with the times reported since the last
+  // update. Pools without reported times are treated as CPU-bound.
+  int64_t total_weight = 0;
+  int64_t cpu_bound_weight = 0;
+  for (ResourcePool* pool: pools_) {
+    int64_t cpu_time_ns = pool->cpu_time_ns_.Load();
+    int64_t wall_time_ns = pool->wall_time_ns_.Load();
+    int64_t wall_delta_ns = wall_time_ns - pool->last_wall_time_ns_;
+    if (wall_delta_ns > 0) {
+      double utilization = min(1.0,
+          static_cast<double>(cpu_time_ns - pool->last_cpu_time_ns_) / wall_delta_ns);
+      // Smooth out short bursts of I/O or CPU work.
+      pool->cpu_utilization_ = pool->has_cpu_utilization_ ?
+          (pool->cpu_utilization_ + utilization) / 2 : utilization;
+      pool->has_cpu_utilization_ = true;
+      pool->last_cpu_time_ns_ = cpu_time_ns;
+      pool->last_wall_time_ns_ = wall_time_ns;
+    }
+    total_weight += pool->weight_;
+    if (pool->cpu_utilization_ >= CPU_BOUND_UTILIZATION) {
+      cpu_bound_weight += pool->weight_;
+    }
+  }
+
+  // Each pool gets a share of the system quota that is proportional to its weight. The
+  // threads of I/O-bound pools keep their share, since they need it to overlap their
+  // I/O, but only use a part of the cores it stands for. The rest is split between the
+  // CPU-bound pools by weight.
+  double unused_share = 0;
+  for (ResourcePool* pool: pools_) {
+    if (pool->cpu_utilization_ >= CPU_BOUND_UTILIZATION) continue;
+    unused_share += static_cast<double>(system_threads_quota_) * pool->weight_ /
+        total_weight * (1 - pool->cpu_utilization_);
+  }
+  for (ResourcePool* pool: pools_) {
+    double quota = static_cast<double>(system_threads_quota_) * pool->weight_ /
+        total_weight;
+    if (pool->cpu_utilization_ >= CPU_BOUND_UTILIZATION) {
+      quota += unused_share * pool->weight_ / cpu_bound_weight;
+    }
+    int previous_quota = pool->quota_;
+    pool->quota_ = min(system_threads_quota_, static_cast<int>(ceil(quota)));
+    // Only notify pools whose quota increased, e.g. on pool unregistration.
+    if (pool != new_pool && pool->quota_ > previous_quota) {
       pool->InvokeCallbacks();
     }
   }
 }
+
+void ThreadResourceMgr::MaybeUpdatePoolQuotas() {
+  if (MonotonicMillis() < next_quota_update_ms_.Load()) return;
+  unique_lock<mutex> l(lock_, try_to_lock);
+  // Another thread is updating the quotas.
+  if (!l.owns_lock()) return;
+  if (MonotonicMillis() < next_quota_update_ms_.Load()) return;
+  UpdatePoolQuotas();
+}
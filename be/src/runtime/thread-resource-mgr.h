@@ -21,7 +21,10 @@
 #include <boost/thread/mutex.hpp>
 
 #include <list>
+#include <map>
+#include <string>
 
+#include "common/atomic.h"
 #include "common/status.h"
 
 namespace impala {
@@ -31,8 +34,14 @@ namespace impala {
 /// query fragments.  If there is only one fragment running, it can use the
 /// entire pool, spinning up the maximum number of threads to saturate the
 /// hardware.  If there are multiple fragments, the CPU pool must be shared
-/// between them.  Currently, the total system pool is split evenly between
-/// all consumers.  Each consumer gets ceil(total_system_threads / num_consumers).
+/// between them.  Each consumer gets a share of the total system pool that is
+/// proportional to the weight of its request pool (--thread_pool_weights).
+///
+/// Pools report the CPU and wall-clock time of their threads with ReportThreadTime()
+/// (currently only scanner threads do). A pool whose threads spend most of their time
+/// waiting, e.g. for I/O, leaves part of the cores of its share idle. The mgr
+/// periodically reassigns that part to the pools whose threads are CPU-bound, so the
+/// quotas of all pools can add up to more than the system pool.
 //
 /// Each fragment must register with the ThreadResourceMgr to request threads
 /// (in the form of tokens).  The fragment has required threads (it can't run
@@ -54,7 +63,6 @@ namespace impala {
 ///    data stream threads, etc).
 ///  - Admission control
 ///  - Integration with other nodes/statestore
-///  - Priorities for different pools
 /// If both the mgr and pool locks need to be taken, the mgr lock must
 /// be taken first.
 class ThreadResourceMgr {
@@ -153,12 +161,30 @@ class ThreadResourceMgr {
 
     /// Returns the quota for this pool.  Note this changes dynamically
     /// based on system load.
-    int quota() const { return std::min(max_quota_, parent_->per_pool_quota_); }
+    int quota() const { return std::min(max_quota_, quota_); }
 
     /// Sets the max thread quota for this pool.
     /// The actual quota is the min of this value and the dynamic value.
     void set_max_quota(int quota) { max_quota_ = quota; }
 
+    /// Returns the NUMA node that the threads of this pool should run on and allocate
+    /// their memory from, or -1 if they are not placed (see --numa_aware_scheduling).
+    int numa_node() const { return numa_node_; }
+
+    /// Restricts the calling thread, and the threads it starts afterwards, to the cores
+    /// of numa_node(). Does nothing if the pool is not placed on a node.
+    void BindCurrentThreadToNumaNode();
+
+    /// Adds the CPU time 'cpu_ns' that a thread of this pool used while 'wall_ns'
+    /// nanoseconds of wall-clock time passed. The mgr updates the quotas of all pools
+    /// from these times periodically.
+    /// Must not be called with a lock held that a ThreadAvailableCb takes.
+    void ReportThreadTime(int64_t cpu_ns, int64_t wall_ns);
+
+    /// Returns the fraction of the reported wall-clock time that the threads of this
+    /// pool used the CPU for, as of the last quota update. 1 if no times were reported.
+    double cpu_utilization() const { return cpu_utilization_; }
+
    private:
     friend class ThreadResourceMgr;
 
@@ -175,6 +201,27 @@ class ThreadResourceMgr {
     int max_quota_;
     int num_reserved_optional_threads_;
 
+    /// Set by RegisterPool(). Protected by the parent's lock.
+    int numa_node_;
+
+    /// Weight of the pool's request pool. Set by SetRequestPool(). Protected by the
+    /// parent's lock.
+    int weight_;
+
+    /// The dynamic quota of the pool, computed by the parent's UpdatePoolQuotas().
+    int quota_;
+
+    /// Total CPU and wall-clock time reported with ReportThreadTime().
+    AtomicInt64 cpu_time_ns_;
+    AtomicInt64 wall_time_ns_;
+
+    /// Total times as of the last quota update, and the moving average of the CPU
+    /// utilization of the pool. Protected by the parent's lock.
+    int64_t last_cpu_time_ns_;
+    int64_t last_wall_time_ns_;
+    double cpu_utilization_;
+    bool has_cpu_utilization_;
+
     /// A single 64 bit value to store both the number of optional and
     /// required threads.  This is combined to allow using compare and
     /// swap operations.  The number of required threads is the lower
@@ -203,17 +250,32 @@ class ThreadResourceMgr {
   /// based on the hardware.
   ThreadResourceMgr(int threads_quota = 0);
 
+  /// Parses --thread_pool_weights. Pools get a weight of 1 if this is not called.
+  Status Init();
+
   int system_threads_quota() const { return system_threads_quota_; }
 
   /// Register a new pool with the thread mgr.  Registering a pool
-  /// will update the quotas for all existing pools.
+  /// will update the quotas for all existing pools. With --numa_aware_scheduling, the
+  /// pool is placed on the NUMA node with the fewest pools.
   ResourcePool* RegisterPool();
 
   /// Unregisters the pool.  'pool' is no longer valid after this.
   /// This updates the quotas for the remaining pools.
   void UnregisterPool(ResourcePool* pool);
 
+  /// Sets the weight of 'pool' to the weight of the request pool 'request_pool', and
+  /// updates the quotas for all pools.
+  void SetRequestPool(ResourcePool* pool, const std::string& request_pool);
+
  private:
+  /// Pools whose CPU utilization is below this are treated as I/O-bound and pass part
+  /// of their share on to the CPU-bound pools.
+  static const double CPU_BOUND_UTILIZATION;
+
+  /// Minimum time between two quota updates that are triggered by ReportThreadTime().
+  static const int64_t QUOTA_UPDATE_INTERVAL_MS = 500;
+
   /// 'Optimal' number of threads for the entire process.
   int system_threads_quota_;
 
@@ -224,17 +286,32 @@ class ThreadResourceMgr {
   typedef std::set<ResourcePool*> Pools;
   Pools pools_;
 
-  /// Each pool currently gets the same share.  This is the ceil of the
-  /// system quota divided by the number of pools.
-  int per_pool_quota_;
+  /// Thread scheduling weight of each request pool, parsed from
+  /// --thread_pool_weights.
+  std::map<std::string, int> pool_weights_;
+
+  /// Time after which ReportThreadTime() updates the quotas again.
+  AtomicInt64 next_quota_update_ms_;
 
   /// Recycled list of pool objects
   std::list<ResourcePool*> free_pool_objs_;
 
-  /// Updates the per pool quota and notifies any pools that now have
-  /// more threads they can use.  Must be called with lock_ taken.
+  /// The number of registered pools on each NUMA node. Empty if pools are not placed
+  /// on NUMA nodes.
+  std::vector<int> num_pools_per_numa_node_;
+
+  /// The node after the one that the last pool was placed on. Breaks ties between
+  /// nodes with the same number of pools in round-robin order.
+  int next_numa_node_;
+
+  /// Updates the CPU utilization and quota of each pool and notifies any pools that
+  /// now have more threads they can use.  Must be called with lock_ taken.
   /// If new_pool is non-null, new_pool will *not* be notified.
   void UpdatePoolQuotas(ResourcePool* new_pool = NULL);
+
+  /// Calls UpdatePoolQuotas() if the last update is older than
+  /// QUOTA_UPDATE_INTERVAL_MS and lock_ is not held by another thread.
+  void MaybeUpdatePoolQuotas();
 };
 
 inline void ThreadResourceMgr::ResourcePool::AcquireThreadToken() {
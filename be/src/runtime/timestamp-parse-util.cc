@@ -14,6 +14,7 @@
 
 #include "runtime/timestamp-parse-util.h"
 
+#include <emmintrin.h>
 #include <boost/assign/list_of.hpp>
 #include <boost/date_time/gregorian/gregorian.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
@@ -57,6 +58,38 @@ struct DateTimeParseResult {
 
 bool TimestampParser::initialized_ = false;
 
+/// Bit i is set if character i of 'yyyy-MM-ddTHH:mm' is a digit.
+static const int ISO_DIGIT_MASK = 0xDB6F;
+
+/// Returns true if 'fmt' is one of the layouts handled by ParseIsoDateTime(), see
+/// DateTimeFormatContext::is_iso_layout.
+static bool IsIsoLayout(const char* fmt, int len) {
+  if (len < 10 || memcmp(fmt, "yyyy-MM-dd", 10) != 0) return false;
+  if (len == 10) return true;
+  if (len < 19 || (fmt[10] != ' ' && fmt[10] != 'T')) return false;
+  if (memcmp(fmt + 11, "HH:mm:ss", 8) != 0) return false;
+  if (len == 19) return true;
+  if (len < 21 || len > 29 || fmt[19] != '.') return false;
+  for (int i = 20; i < len; ++i) {
+    if (fmt[i] != 'S') return false;
+  }
+  return true;
+}
+
+/// Writes 'val' to 'str' zero-padded to at least 'width' digits, like
+/// sprintf("%0*d"). 'val' must not be negative. Returns the number of characters written.
+static inline int FormatPaddedInt(int32_t val, int width, char* str) {
+  DCHECK_GE(val, 0);
+  int num_digits = 1;
+  for (int32_t v = val; v >= 10; v /= 10) ++num_digits;
+  int len = std::max(width, num_digits);
+  for (int i = len - 1; i >= 0; --i) {
+    str[i] = '0' + val % 10;
+    val /= 10;
+  }
+  return len;
+}
+
 /// Lazily initialized pseudo-constant hashmap for mapping month names to an index.
 static unordered_map<StringValue, int> REV_MONTH_INDEX;
 
@@ -190,6 +223,7 @@ bool TimestampParser::ParseFormatTokens(DateTimeFormatContext* dt_ctx) {
     str += tok.len;
     dt_ctx->toks.push_back(tok);
   }
+  dt_ctx->is_iso_layout = IsIsoLayout(dt_ctx->fmt, dt_ctx->fmt_len);
   return dt_ctx->has_date_toks || dt_ctx->has_time_toks;
 }
 
@@ -398,7 +432,7 @@ int TimestampParser::Format(const DateTimeFormatContext& dt_ctx,
       default: DCHECK(false) << "Unknown date/time format token";
     }
     if (num_val > -1) {
-      str += sprintf(str, "%0*d", tok.len, num_val);
+      str += FormatPaddedInt(num_val, tok.len, str);
     } else {
       memcpy(str, str_val, str_val_len);
       str += str_val_len;
@@ -415,6 +449,9 @@ bool TimestampParser::ParseDateTime(const char* str, int str_len,
   DCHECK(dt_ctx.toks.size() > 0);
   DCHECK(dt_result != NULL);
   if (str_len <= 0 || str_len < dt_ctx.fmt_len || str == NULL) return false;
+  if (dt_ctx.is_iso_layout && ParseIsoDateTime(str, str_len, dt_ctx, dt_result)) {
+    return true;
+  }
   StringParser::ParseResult status;
   // Keep track of the number of characters we need to shift token positions by.
   // Variable-length tokens will result in values > 0;
@@ -536,6 +573,66 @@ bool TimestampParser::ParseDateTime(const char* str, int str_len,
   return true;
 }
 
+bool TimestampParser::ParseIsoDateTime(const char* str, int str_len,
+    const DateTimeFormatContext& dt_ctx, DateTimeParseResult* dt_result) {
+  DCHECK(dt_ctx.is_iso_layout);
+  DCHECK_GE(str_len, dt_ctx.fmt_len);
+  const char* fmt = dt_ctx.fmt;
+  const int fmt_len = dt_ctx.fmt_len;
+  // A single 'S' also consumes any digits after it.
+  if (fmt_len == DEFAULT_SHORT_DATE_TIME_FMT_LEN + 2 && str_len > fmt_len) return false;
+
+  // The digits of 'str', minus '0'.
+  uint8_t d[16];
+  if (fmt_len > DEFAULT_DATE_FMT_LEN) {
+    __m128i digits = _mm_sub_epi8(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(str)), _mm_set1_epi8('0'));
+    // Characters other than '0' - '9' wrapped around to values above 9.
+    __m128i is_digit =
+        _mm_cmpeq_epi8(_mm_min_epu8(digits, _mm_set1_epi8(9)), digits);
+    if ((_mm_movemask_epi8(is_digit) & ISO_DIGIT_MASK) != ISO_DIGIT_MASK) return false;
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(d), digits);
+  } else {
+    DCHECK_EQ(fmt_len, DEFAULT_DATE_FMT_LEN);
+    for (int i = 0; i < DEFAULT_DATE_FMT_LEN; ++i) {
+      d[i] = str[i] - '0';
+      if (((ISO_DIGIT_MASK >> i) & 1) && d[i] > 9) return false;
+    }
+  }
+
+  if (str[4] != fmt[4] || str[7] != fmt[7]) return false;
+  dt_result->year = d[0] * 1000 + d[1] * 100 + d[2] * 10 + d[3];
+  dt_result->month = d[5] * 10 + d[6];
+  dt_result->day = d[8] * 10 + d[9];
+  if (UNLIKELY(dt_result->year < 1)) return false;
+  if (UNLIKELY(dt_result->month < 1 || dt_result->month > 12)) return false;
+  if (UNLIKELY(dt_result->day < 1 || dt_result->day > 31)) return false;
+  if (fmt_len == DEFAULT_DATE_FMT_LEN) return true;
+
+  if (str[10] != fmt[10] || str[13] != fmt[13] || str[16] != fmt[16]) return false;
+  uint8_t sec_hi = str[17] - '0';
+  uint8_t sec_lo = str[18] - '0';
+  if (sec_hi > 9 || sec_lo > 9) return false;
+  dt_result->hour = d[11] * 10 + d[12];
+  dt_result->minute = d[14] * 10 + d[15];
+  dt_result->second = sec_hi * 10 + sec_lo;
+  if (UNLIKELY(dt_result->hour > 23)) return false;
+  if (UNLIKELY(dt_result->minute > 59 || dt_result->second > 59)) return false;
+  if (fmt_len == DEFAULT_SHORT_DATE_TIME_FMT_LEN) return true;
+
+  if (str[19] != fmt[19]) return false;
+  int32_t fraction = 0;
+  for (int i = DEFAULT_SHORT_DATE_TIME_FMT_LEN + 1; i < fmt_len; ++i) {
+    uint8_t digit = str[i] - '0';
+    if (digit > 9) return false;
+    fraction = fraction * 10 + digit;
+  }
+  // Scale the fraction up to nanoseconds, as in ParseDateTime().
+  for (int i = fmt_len - DEFAULT_SHORT_DATE_TIME_FMT_LEN - 1; i < 9; ++i) fraction *= 10;
+  dt_result->fraction = fraction;
+  return true;
+}
+
 bool TimestampParser::IsValidTZOffset(const char* str_begin, const char* str_end) {
   if (*str_begin == '+' || *str_begin == '-') {
     ++str_begin;
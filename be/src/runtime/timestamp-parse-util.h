@@ -131,6 +131,10 @@ struct DateTimeFormatContext {
   std::vector<DateTimeFormatToken> toks;
   bool has_date_toks;
   bool has_time_toks;
+  /// True if the format is one of the default layouts 'yyyy-MM-dd',
+  /// 'yyyy-MM-dd HH:mm:ss' or 'yyyy-MM-ddTHH:mm:ss', optionally followed by '.' and up
+  /// to 9 'S'. Strings in these layouts are parsed without walking the tokens.
+  bool is_iso_layout;
 
   DateTimeFormatContext() {
     Reset(NULL, 0);
@@ -146,6 +150,7 @@ struct DateTimeFormatContext {
     this->fmt_out_len = fmt_len;
     this->has_date_toks = false;
     this->has_time_toks = false;
+    this->is_iso_layout = false;
     this->toks.clear();
   }
 };
@@ -205,6 +210,13 @@ class TimestampParser {
   static bool ParseDateTime(const char* str, int str_len,
       const DateTimeFormatContext& dt_ctx, DateTimeParseResult* dt_result);
 
+  /// Fast path of ParseDateTime() for contexts with 'is_iso_layout' set. The digits of
+  /// the date and time are validated 16 at a time. Returns false if 'str' does not
+  /// strictly match the layout, in which case ParseDateTime() falls back to the token
+  /// loop, which also accepts e.g. signs in numeric fields.
+  static bool ParseIsoDateTime(const char* str, int str_len,
+      const DateTimeFormatContext& dt_ctx, DateTimeParseResult* dt_result);
+
   /// Check if the string is a TimeZone offset token.
   /// Valid offset token format are 'hh:mm', 'hhmm', 'hh'.
   static bool IsValidTZOffset(const char* str_begin, const char* str_end);
@@ -621,6 +621,41 @@ TEST(TimestampTest, Basic) {
   EXPECT_EQ("1970-01-01 00:00:00.008000000", TimestampValue(0.008).DebugString());
 }
 
+// The default layouts are parsed by a fast path that must agree with the token loop.
+TEST(TimestampTest, IsoLayouts) {
+  const char* fmt = "yyyy-MM-dd HH:mm:ss.SSS";
+  DateTimeFormatContext dt_ctx(fmt, strlen(fmt));
+  ASSERT_TRUE(TimestampParser::ParseFormatTokens(&dt_ctx));
+  EXPECT_TRUE(dt_ctx.is_iso_layout);
+  DateTimeFormatContext other_ctx("yyyy/MM/dd", 10);
+  ASSERT_TRUE(TimestampParser::ParseFormatTokens(&other_ctx));
+  EXPECT_FALSE(other_ctx.is_iso_layout);
+
+  TimestampValue tv("2013-10-21 06:43:12.075", 23, dt_ctx);
+  EXPECT_EQ("2013-10-21 06:43:12.075000000", tv.DebugString());
+  // Signs in numeric fields are only accepted by the token loop.
+  EXPECT_EQ("2013-10-01 06:43:12.075000000",
+      TimestampValue("2013-10-+1 06:43:12.075", 23, dt_ctx).DebugString());
+  // Trailing characters are ignored.
+  EXPECT_EQ("2013-10-21 06:43:12.075000000",
+      TimestampValue("2013-10-21 06:43:12.0759", 24, dt_ctx).DebugString());
+
+  const char* invalid[] = {"2013-10-21 06:43:12.07x", "2013-13-21 06:43:12.075",
+      "2013-10-32 06:43:12.075", "2013-10-21 24:43:12.075", "2013-10-21 06:60:12.075",
+      "2013-10-21 06:43:60.075", "2013-10-21T06:43:12.075", "2013/10/21 06:43:12.075",
+      "0000-10-21 06:43:12.075", "2013-1a-21 06:43:12.075"};
+  for (const char* str: invalid) {
+    TimestampValue invalid_tv(str, strlen(str), dt_ctx);
+    EXPECT_FALSE(invalid_tv.HasDate()) << str;
+  }
+
+  // A single 'S' consumes all digits of the fraction.
+  DateTimeFormatContext short_frac_ctx("yyyy-MM-ddTHH:mm:ss.S", 21);
+  ASSERT_TRUE(TimestampParser::ParseFormatTokens(&short_frac_ctx));
+  EXPECT_EQ("2013-10-21 06:43:12.123400000",
+      TimestampValue("2013-10-21T06:43:12.1234", 24, short_frac_ctx).DebugString());
+}
+
 }
 
 int main(int argc, char **argv) {
@@ -30,6 +30,10 @@
 
 using boost::filesystem::path;
 
+DECLARE_string(scratch_limit_per_query);
+DECLARE_string(scratch_limits_per_pool);
+DECLARE_string(local_scratch_limit);
+
 namespace impala {
 
 class TmpFileMgrTest : public ::testing::Test {
@@ -228,6 +232,120 @@ TEST_F(TmpFileMgrTest, TestAllocateFails) {
   FileSystemUtil::RemovePaths(tmp_dirs);
 }
 
+/// Test that freed space is reused before the file grows and that adjacent free ranges
+/// are merged.
+TEST_F(TmpFileMgrTest, TestFreeSpaceReuse) {
+  TmpFileMgr tmp_file_mgr;
+  EXPECT_TRUE(tmp_file_mgr.Init(metrics_.get()).ok());
+  TUniqueId id;
+  TmpFileMgr::File* file;
+  EXPECT_TRUE(tmp_file_mgr.GetFile(0, id, &file).ok());
+  int64_t offsets[4];
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_TRUE(file->AllocateSpace(100, &offsets[i]).ok());
+    EXPECT_EQ(i * 100, offsets[i]);
+  }
+  // The first free range that fits is reused.
+  file->FreeSpace(offsets[1], 100);
+  int64_t offset;
+  EXPECT_TRUE(file->AllocateSpace(40, &offset).ok());
+  EXPECT_EQ(100, offset);
+  EXPECT_EQ(60, file->free_bytes());
+  // [140, 200) and [200, 300) are merged, so 150 bytes fit without growing the file.
+  file->FreeSpace(offsets[2], 100);
+  EXPECT_TRUE(file->AllocateSpace(150, &offset).ok());
+  EXPECT_EQ(140, offset);
+  EXPECT_EQ(400, boost::filesystem::file_size(file->path()));
+  EXPECT_EQ(10, file->free_bytes());
+  // The free range [290, 400) at the end of the file is extended.
+  file->FreeSpace(offsets[3], 100);
+  EXPECT_TRUE(file->AllocateSpace(200, &offset).ok());
+  EXPECT_EQ(290, offset);
+  EXPECT_EQ(0, file->free_bytes());
+  EXPECT_EQ(490, boost::filesystem::file_size(file->path()));
+  EXPECT_TRUE(file->Remove().ok());
+  delete file;
+}
+
+/// Test that file growth is limited by the per-query and per-pool scratch limits.
+TEST_F(TmpFileMgrTest, TestScratchLimits) {
+  FLAGS_scratch_limit_per_query = "1000";
+  FLAGS_scratch_limits_per_pool = "etl:1500";
+  TmpFileMgr tmp_file_mgr;
+  EXPECT_TRUE(tmp_file_mgr.Init(metrics_.get()).ok());
+  TUniqueId id;
+  TmpFileMgr::QueryScratchUsage usage1(id, "etl");
+  TmpFileMgr::QueryScratchUsage usage2(id, "etl");
+  TmpFileMgr::QueryScratchUsage other_pool_usage(id, "adhoc");
+  TmpFileMgr::File* file1;
+  TmpFileMgr::File* file2;
+  TmpFileMgr::File* other_pool_file;
+  EXPECT_TRUE(tmp_file_mgr.GetFile(0, id, &file1, &usage1).ok());
+  EXPECT_TRUE(tmp_file_mgr.GetFile(0, id, &file2, &usage2).ok());
+  EXPECT_TRUE(tmp_file_mgr.GetFile(0, id, &other_pool_file, &other_pool_usage).ok());
+
+  int64_t offset;
+  EXPECT_TRUE(file1->AllocateSpace(1000, &offset).ok());
+  EXPECT_EQ(1000, usage1.bytes());
+  // The query limit is reached, but freed space can still be reused.
+  EXPECT_FALSE(file1->AllocateSpace(1, &offset).ok());
+  file1->FreeSpace(0, 500);
+  EXPECT_TRUE(file1->AllocateSpace(500, &offset).ok());
+  EXPECT_EQ(1000, usage1.bytes());
+  // The pool limit is shared by the queries of the pool.
+  EXPECT_TRUE(file2->AllocateSpace(500, &offset).ok());
+  EXPECT_FALSE(file2->AllocateSpace(1, &offset).ok());
+  EXPECT_TRUE(other_pool_file->AllocateSpace(1000, &offset).ok());
+  // Removing a file releases its space.
+  EXPECT_TRUE(file1->Remove().ok());
+  EXPECT_EQ(0, usage1.bytes());
+  EXPECT_TRUE(file2->AllocateSpace(500, &offset).ok());
+
+  EXPECT_TRUE(file2->Remove().ok());
+  EXPECT_TRUE(other_pool_file->Remove().ok());
+  delete file1;
+  delete file2;
+  delete other_pool_file;
+  FLAGS_scratch_limit_per_query = "";
+  FLAGS_scratch_limits_per_pool = "";
+}
+
+/// Test that --local_scratch_limit limits the total size of the local files, including
+/// the files of queries without a usage.
+TEST_F(TmpFileMgrTest, TestLocalScratchLimit) {
+  FLAGS_local_scratch_limit = "1000";
+  TmpFileMgr tmp_file_mgr;
+  EXPECT_TRUE(tmp_file_mgr.Init(metrics_.get()).ok());
+  EXPECT_FALSE(tmp_file_mgr.IsRemoteDevice(0));
+  TUniqueId id;
+  TmpFileMgr::QueryScratchUsage usage(id, "default");
+  TmpFileMgr::File* file1;
+  TmpFileMgr::File* file2;
+  EXPECT_TRUE(tmp_file_mgr.GetFile(0, id, &file1, &usage).ok());
+  EXPECT_TRUE(tmp_file_mgr.GetFile(0, id, &file2).ok());
+  EXPECT_FALSE(file1->is_remote());
+
+  int64_t offset;
+  EXPECT_TRUE(file1->AllocateSpace(600, &offset).ok());
+  EXPECT_TRUE(file2->AllocateSpace(400, &offset).ok());
+  // Local files are written and read at the offsets of their ranges.
+  string range_path;
+  int64_t range_offset;
+  file2->GetRangeLocation(offset, &range_path, &range_offset);
+  EXPECT_EQ(file2->path(), range_path);
+  EXPECT_EQ(offset, range_offset);
+  EXPECT_FALSE(file1->AllocateSpace(1, &offset).ok());
+  EXPECT_FALSE(file2->AllocateSpace(1, &offset).ok());
+  EXPECT_TRUE(file2->Remove().ok());
+  EXPECT_TRUE(file1->AllocateSpace(400, &offset).ok());
+  EXPECT_EQ(1000, usage.bytes());
+
+  EXPECT_TRUE(file1->Remove().ok());
+  delete file1;
+  delete file2;
+  FLAGS_local_scratch_limit = "";
+}
+
 }
 
 int main(int argc, char** argv) {
@@ -12,6 +12,9 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <fcntl.h>
+#include <unistd.h>
+#include <linux/falloc.h>
 #include <boost/algorithm/string.hpp>
 #include <boost/lexical_cast.hpp>
 #include <boost/thread/locks.hpp>
@@ -21,14 +24,35 @@
 #include <gutil/strings/substitute.h>
 #include <gutil/strings/join.h>
 
+#include "runtime/hdfs-fs-cache.h"
 #include "runtime/tmp-file-mgr.h"
 #include "util/debug-util.h"
 #include "util/disk-info.h"
+#include "util/error-util.h"
 #include "util/filesystem-util.h"
+#include "util/hdfs-util.h"
+#include "util/network-util.h"
+#include "util/parse-util.h"
+#include "util/pretty-printer.h"
 
 #include "common/names.h"
 
 DEFINE_string(scratch_dirs, "/tmp", "Writable scratch directories");
+DEFINE_bool(scratch_punch_holes, false, "If true, the scratch space of deleted blocks "
+    "is returned to the filesystem with fallocate(FALLOC_FL_PUNCH_HOLE) until it is "
+    "reused, so that scratch files only take as much disk space as their live data.");
+DEFINE_string(scratch_limit_per_query, "", "Maximum scratch space that a query can use "
+    "on each impalad, e.g. '100G'. Spilling fails once a query reaches it. Empty or -1 "
+    "means no limit.");
+DEFINE_string(scratch_limits_per_pool, "", "Comma-separated list of "
+    "'<request pool>:<limit>' pairs, e.g. 'root.etl:1T'. Limits the total scratch space "
+    "of the queries of each listed pool on each impalad.");
+DEFINE_string(remote_scratch_dirs, "", "Comma-separated list of scratch directories on "
+    "HDFS or S3, e.g. 'hdfs://nn:8020/tmp'. Queries spill to them when the local "
+    "scratch directories reach --local_scratch_limit or cannot be used.");
+DEFINE_string(local_scratch_limit, "", "Maximum total size of the scratch files in "
+    "--scratch_dirs on each impalad, e.g. '500G'. Once it is reached, new spilled data "
+    "goes to --remote_scratch_dirs or spilling fails. Empty or -1 means no limit.");
 
 #include "common/names.h"
 
@@ -52,7 +76,21 @@ const string TMP_FILE_MGR_ACTIVE_SCRATCH_DIRS_LIST =
     "tmp-file-mgr.active-scratch-dirs.list";
 
 TmpFileMgr::TmpFileMgr() : initialized_(false), dir_status_lock_(), tmp_dirs_(),
-  num_active_scratch_dirs_metric_(NULL), active_scratch_dirs_metric_(NULL) {}
+  query_scratch_limit_(-1), local_scratch_limit_(-1), local_scratch_bytes_(0),
+  num_active_scratch_dirs_metric_(NULL),
+  active_scratch_dirs_metric_(NULL) {}
+
+// Parses 'spec', a scratch limit in bytes with an optional unit, into 'limit'. Returns
+// -1 for no limit.
+static Status ParseScratchLimit(const string& spec, int64_t* limit) {
+  bool is_percent;
+  *limit = ParseUtil::ParseMemSpec(spec, &is_percent, 0);
+  if (*limit < 0 || is_percent) {
+    return Status(Substitute("Invalid scratch limit: '$0'", spec));
+  }
+  if (*limit == 0) *limit = -1;
+  return Status::OK();
+}
 
 Status TmpFileMgr::Init(MetricGroup* metrics) {
   string tmp_dirs_spec = FLAGS_scratch_dirs;
@@ -67,7 +105,26 @@ Status TmpFileMgr::Init(MetricGroup* metrics) {
 Status TmpFileMgr::InitCustom(const vector<string>& tmp_dirs, bool one_dir_per_device,
       MetricGroup* metrics) {
   DCHECK(!initialized_);
-  if (tmp_dirs.empty()) {
+  RETURN_IF_ERROR(
+      ParseScratchLimit(FLAGS_scratch_limit_per_query, &query_scratch_limit_));
+  RETURN_IF_ERROR(ParseScratchLimit(FLAGS_local_scratch_limit, &local_scratch_limit_));
+  vector<string> pool_limits;
+  split(pool_limits, FLAGS_scratch_limits_per_pool, is_any_of(","), token_compress_on);
+  for (const string& pool_limit: pool_limits) {
+    if (pool_limit.empty()) continue;
+    size_t colon = pool_limit.rfind(':');
+    if (colon == string::npos || colon == 0) {
+      return Status(Substitute("Invalid entry in --scratch_limits_per_pool: '$0'",
+          pool_limit));
+    }
+    int64_t limit;
+    RETURN_IF_ERROR(ParseScratchLimit(pool_limit.substr(colon + 1), &limit));
+    if (limit > 0) pool_scratch_limits_[pool_limit.substr(0, colon)] = limit;
+  }
+  vector<string> remote_dirs;
+  split(remote_dirs, FLAGS_remote_scratch_dirs, is_any_of(","), token_compress_on);
+  while (!remote_dirs.empty() && remote_dirs.back().empty()) remote_dirs.pop_back();
+  if (tmp_dirs.empty() && remote_dirs.empty()) {
     LOG(WARNING) << "Running without spill to disk: no scratch directories provided.";
   }
 
@@ -113,6 +170,9 @@ Status TmpFileMgr::InitCustom(const vector<string>& tmp_dirs, bool one_dir_per_d
     }
   }
 
+  int num_local_dirs = tmp_dirs_.size();
+  InitRemoteDirs(remote_dirs);
+
   DCHECK(metrics != NULL);
   num_active_scratch_dirs_metric_ =
       metrics->AddGauge<int64_t>(TMP_FILE_MGR_ACTIVE_SCRATCH_DIRS, 0);
@@ -125,7 +185,7 @@ Status TmpFileMgr::InitCustom(const vector<string>& tmp_dirs, bool one_dir_per_d
 
   initialized_ = true;
 
-  if (tmp_dirs_.empty() && !tmp_dirs.empty()) {
+  if (num_local_dirs == 0 && !tmp_dirs.empty()) {
     LOG(ERROR) << "Running without spill to disk: could not use any scratch "
                << "directories in list: " << join(tmp_dirs, ",")
                << ". See previous warnings for information on causes.";
@@ -133,8 +193,45 @@ Status TmpFileMgr::InitCustom(const vector<string>& tmp_dirs, bool one_dir_per_d
   return Status::OK();
 }
 
+void TmpFileMgr::InitRemoteDirs(const vector<string>& remote_dirs) {
+  // Remote directories can be shared by several impalads, which each use their own
+  // sub-directory.
+  string hostname;
+  if (!remote_dirs.empty() && !GetHostname(&hostname).ok()) hostname = "unknown";
+  for (const string& remote_dir: remote_dirs) {
+    if (remote_dir.empty()) continue;
+    if (remote_dir.find("://") == string::npos ||
+        (!IsHdfsPath(remote_dir.c_str()) && !IsS3APath(remote_dir.c_str()))) {
+      LOG(WARNING) << "Cannot use " << remote_dir << " for scratch: remote scratch "
+                   << "directories must be fully qualified HDFS or S3A paths.";
+      continue;
+    }
+    hdfsFS conn;
+    Status status = HdfsFsCache::instance()->GetConnection(remote_dir, &conn);
+    if (!status.ok()) {
+      LOG(WARNING) << "Cannot use " << remote_dir << " for scratch: "
+                   << status.msg().msg();
+      continue;
+    }
+    string scratch_subdir = Substitute("$0/$1/$2_$3",
+        trim_right_copy_if(remote_dir, is_any_of("/")), TMP_SUB_DIR_NAME, hostname,
+        getpid());
+    // Remove the data of a previous process with the same sub-directory.
+    if (hdfsExists(conn, scratch_subdir.c_str()) == 0) {
+      hdfsDelete(conn, scratch_subdir.c_str(), 1);
+    }
+    if (hdfsCreateDirectory(conn, scratch_subdir.c_str()) != 0) {
+      LOG(WARNING) << GetHdfsErrorMsg("Cannot use remote directory for scratch: ",
+          scratch_subdir);
+      continue;
+    }
+    LOG(INFO) << "Using remote scratch directory " << scratch_subdir;
+    tmp_dirs_.push_back(Dir(scratch_subdir, false, conn));
+  }
+}
+
 Status TmpFileMgr::GetFile(const DeviceId& device_id, const TUniqueId& query_id,
-    File** new_file) {
+    File** new_file, QueryScratchUsage* usage) {
   DCHECK(initialized_);
   DCHECK_GE(device_id, 0);
   DCHECK_LT(device_id, tmp_dirs_.size());
@@ -149,7 +246,8 @@ Status TmpFileMgr::GetFile(const DeviceId& device_id, const TUniqueId& query_id,
   path new_file_path(tmp_dirs_[device_id].path());
   new_file_path /= file_name.str();
 
-  *new_file = new File(this, device_id, new_file_path.string());
+  *new_file = new File(this, device_id, new_file_path.string(), usage,
+      tmp_dirs_[device_id].remote_conn_);
   return Status::OK();
 }
 
@@ -160,6 +258,13 @@ string TmpFileMgr::GetTmpDirPath(DeviceId device_id) const {
   return tmp_dirs_[device_id].path();
 }
 
+bool TmpFileMgr::IsRemoteDevice(DeviceId device_id) const {
+  DCHECK(initialized_);
+  DCHECK_GE(device_id, 0);
+  DCHECK_LT(device_id, tmp_dirs_.size());
+  return tmp_dirs_[device_id].remote_conn_ != NULL;
+}
+
 void TmpFileMgr::BlacklistDevice(DeviceId device_id) {
   DCHECK(initialized_);
   DCHECK(device_id >= 0 && device_id < tmp_dirs_.size());
@@ -206,11 +311,16 @@ vector<TmpFileMgr::DeviceId> TmpFileMgr::active_tmp_devices() {
   return devices;
 }
 
-TmpFileMgr::File::File(TmpFileMgr* mgr, DeviceId device_id, const string& path)
+TmpFileMgr::File::File(TmpFileMgr* mgr, DeviceId device_id, const string& path,
+    QueryScratchUsage* usage, hdfsFS remote_conn)
   : mgr_(mgr),
     path_(path),
     device_id_(device_id),
+    disk_id_(-1),
+    remote_conn_(remote_conn),
     current_size_(0),
+    free_bytes_(0),
+    usage_(usage),
     blacklisted_(false) {
 }
 
@@ -221,26 +331,95 @@ Status TmpFileMgr::File::AllocateSpace(int64_t write_size, int64_t* offset) {
     blacklisted_ = true;
     return Status(TErrorCode::TMP_FILE_BLACKLISTED, path_);
   }
+  // Reuse the first free range that fits, which keeps the live data at the start of
+  // the file.
+  for (map<int64_t, int64_t>::iterator it = free_ranges_.begin();
+       it != free_ranges_.end(); ++it) {
+    if (it->second < write_size) continue;
+    *offset = it->first;
+    int64_t remaining_len = it->second - write_size;
+    free_ranges_.erase(it);
+    if (remaining_len > 0) free_ranges_[*offset + write_size] = remaining_len;
+    free_bytes_ -= write_size;
+    return Status::OK();
+  }
+
   if (current_size_ == 0) {
     // First call to AllocateSpace. Create the file.
-    status = FileSystemUtil::CreateFile(path_);
+    if (is_remote()) {
+      if (hdfsCreateDirectory(remote_conn_, path_.c_str()) != 0) {
+        status = Status(GetHdfsErrorMsg("Failed to create remote scratch file ", path_));
+      }
+    } else {
+      status = FileSystemUtil::CreateFile(path_);
+      disk_id_ = DiskInfo::disk_id(path_.c_str());
+    }
     if (!status.ok()) {
       ReportIOError(status.msg());
       return status;
     }
-    disk_id_ = DiskInfo::disk_id(path_.c_str());
   }
-  int64_t new_size = current_size_ + write_size;
-  status = FileSystemUtil::ResizeFile(path_, new_size);
+  // A free range at the end of the file is extended instead of appending after it.
+  int64_t tail_free_len = 0;
+  if (!free_ranges_.empty()) {
+    map<int64_t, int64_t>::iterator last = --free_ranges_.end();
+    if (last->first + last->second == current_size_) tail_free_len = last->second;
+  }
+  int64_t growth = write_size - tail_free_len;
+  DCHECK_GT(growth, 0);
+  RETURN_IF_ERROR(mgr_->TryConsumeScratch(usage_, !is_remote(), growth));
+  int64_t new_size = current_size_ + growth;
+  // The ranges of remote files are separate files that are created by their writes.
+  if (!is_remote()) status = FileSystemUtil::ResizeFile(path_, new_size);
   if (!status.ok()) {
+    mgr_->ReleaseScratch(usage_, !is_remote(), growth);
     ReportIOError(status.msg());
     return status;
   }
-  *offset = current_size_;
+  *offset = current_size_ - tail_free_len;
+  if (tail_free_len > 0) {
+    free_ranges_.erase(*offset);
+    free_bytes_ -= tail_free_len;
+  }
   current_size_ = new_size;
   return Status::OK();
 }
 
+void TmpFileMgr::File::FreeSpace(int64_t offset, int64_t len) {
+  DCHECK_GT(len, 0);
+  DCHECK_LE(offset + len, current_size_);
+  if (FLAGS_scratch_punch_holes && !is_remote()) {
+    int fd = open(path_.c_str(), O_WRONLY);
+    if (fd < 0 || fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, offset,
+        len) != 0) {
+      LOG_FIRST_N(WARNING, 1) << "Could not release scratch space of " << path_
+                              << ": " << GetStrErrMsg();
+    }
+    if (fd >= 0) close(fd);
+  }
+  free_bytes_ += len;
+  // Merge the range with the free ranges before and after it.
+  map<int64_t, int64_t>::iterator next = free_ranges_.lower_bound(offset);
+  if (next != free_ranges_.begin()) {
+    map<int64_t, int64_t>::iterator prev = next;
+    --prev;
+    DCHECK_LE(prev->first + prev->second, offset);
+    if (prev->first + prev->second == offset) {
+      offset = prev->first;
+      len += prev->second;
+      free_ranges_.erase(prev);
+    }
+  }
+  if (next != free_ranges_.end()) {
+    DCHECK_GE(next->first, offset + len);
+    if (next->first == offset + len) {
+      len += next->second;
+      free_ranges_.erase(next);
+    }
+  }
+  free_ranges_[offset] = len;
+}
+
 void TmpFileMgr::File::ReportIOError(const ErrorMsg& msg) {
   LOG(ERROR) << "Error for temporary file '" << path_ << "': " << msg.msg();
   // IMPALA-2305: avoid blacklisting to prevent test failures.
@@ -248,9 +427,85 @@ void TmpFileMgr::File::ReportIOError(const ErrorMsg& msg) {
   // mgr_->BlacklistDevice(device_id_);
 }
 
+void TmpFileMgr::File::GetRangeLocation(int64_t offset, string* path,
+    int64_t* file_offset) const {
+  DCHECK_LT(offset, current_size_);
+  if (!is_remote()) {
+    *path = path_;
+    *file_offset = offset;
+    return;
+  }
+  *path = Substitute("$0/$1", path_, offset);
+  *file_offset = 0;
+}
+
 Status TmpFileMgr::File::Remove() {
-  if (current_size_ > 0) FileSystemUtil::RemovePaths(vector<string>(1, path_));
+  if (current_size_ > 0) {
+    if (is_remote()) {
+      if (hdfsDelete(remote_conn_, path_.c_str(), 1) != 0) {
+        LOG(WARNING) << GetHdfsErrorMsg("Failed to delete remote scratch file ", path_);
+      }
+    } else {
+      FileSystemUtil::RemovePaths(vector<string>(1, path_));
+    }
+  }
+  mgr_->ReleaseScratch(usage_, !is_remote(), current_size_);
+  current_size_ = 0;
+  free_ranges_.clear();
+  free_bytes_ = 0;
+  return Status::OK();
+}
+
+Status TmpFileMgr::TryConsumeScratch(QueryScratchUsage* usage, bool local,
+    int64_t bytes) {
+  lock_guard<mutex> l(usage_lock_);
+  if (local && local_scratch_limit_ > 0 &&
+      local_scratch_bytes_ + bytes > local_scratch_limit_) {
+    return Status(Substitute("The local scratch space reached its limit of $0 set by "
+        "--local_scratch_limit.", PrettyPrinter::Print(local_scratch_limit_,
+        TUnit::BYTES)));
+  }
+  if (usage == NULL) {
+    if (local) local_scratch_bytes_ += bytes;
+    return Status::OK();
+  }
+  if (query_scratch_limit_ > 0 && usage->bytes_ + bytes > query_scratch_limit_) {
+    return Status(Substitute("Query $0 reached its scratch space limit of $1 set by "
+        "--scratch_limit_per_query: it uses $2 and needs $3 more.",
+        PrintId(usage->query_id_), PrettyPrinter::Print(query_scratch_limit_,
+        TUnit::BYTES), PrettyPrinter::Print(usage->bytes_, TUnit::BYTES),
+        PrettyPrinter::Print(bytes, TUnit::BYTES)));
+  }
+  map<string, int64_t>::const_iterator pool_limit =
+      pool_scratch_limits_.find(usage->request_pool_);
+  if (pool_limit != pool_scratch_limits_.end()) {
+    int64_t* pool_bytes = &pool_scratch_bytes_[usage->request_pool_];
+    if (*pool_bytes + bytes > pool_limit->second) {
+      return Status(Substitute("Query $0 cannot spill: the queries of pool '$1' reached "
+          "their scratch space limit of $2 set by --scratch_limits_per_pool.",
+          PrintId(usage->query_id_), usage->request_pool_,
+          PrettyPrinter::Print(pool_limit->second, TUnit::BYTES)));
+    }
+    *pool_bytes += bytes;
+  }
+  if (local) local_scratch_bytes_ += bytes;
+  usage->bytes_ += bytes;
   return Status::OK();
 }
 
+void TmpFileMgr::ReleaseScratch(QueryScratchUsage* usage, bool local, int64_t bytes) {
+  lock_guard<mutex> l(usage_lock_);
+  if (local) {
+    local_scratch_bytes_ -= bytes;
+    DCHECK_GE(local_scratch_bytes_, 0);
+  }
+  if (usage == NULL) return;
+  usage->bytes_ -= bytes;
+  DCHECK_GE(usage->bytes_, 0);
+  if (pool_scratch_limits_.find(usage->request_pool_) != pool_scratch_limits_.end()) {
+    pool_scratch_bytes_[usage->request_pool_] -= bytes;
+    DCHECK_GE(pool_scratch_bytes_[usage->request_pool_], 0);
+  }
+}
+
 } //namespace impala
@@ -15,6 +15,11 @@
 #ifndef IMPALA_RUNTIME_TMP_FILE_MGR_H
 #define IMPALA_RUNTIME_TMP_FILE_MGR_H
 
+#include <map>
+#include <string>
+#include <boost/thread/mutex.hpp>
+
+#include "common/hdfs.h"
 #include "common/status.h"
 #include "gen-cpp/Types_types.h"  // for TUniqueId
 #include "util/collection-metrics.h"
@@ -27,6 +32,12 @@ namespace impala {
 /// TmpFileMgr ensures that at most one directory per device is used unless overridden
 /// for testing. GetFile() returns a File handle with a unique filename on a device. The
 /// client owns the File handle and can use it to expand the file.
+///
+/// Directories on HDFS or S3 from --remote_scratch_dirs form a remote tier of devices.
+/// They are slower than local directories, so clients should only use them when the
+/// local devices cannot take more data, e.g. once the local scratch space reaches
+/// --local_scratch_limit. Remote filesystems do not support random writes, so each
+/// range of a remote file is stored in its own file, see File::GetRangeLocation().
 /// TODO: we could notify block managers about the failure so they can more take
 /// proactive action to avoid using the device.
 class TmpFileMgr {
@@ -35,22 +46,60 @@ class TmpFileMgr {
   /// It is used as a handle for external classes to identify devices.
   typedef int DeviceId;
 
+  /// The scratch space used by the files of one query, which is limited by
+  /// --scratch_limit_per_query and by the limit of the query's request pool in
+  /// --scratch_limits_per_pool. The space of a file is its size, i.e. the space that
+  /// it can take on disk. Shared by all files of the query and owned by the caller of
+  /// GetFile(), which must remove the files before destroying it.
+  class QueryScratchUsage {
+   public:
+    QueryScratchUsage(const TUniqueId& query_id, const std::string& request_pool)
+      : query_id_(query_id), request_pool_(request_pool), bytes_(0) {}
+
+    int64_t bytes() const { return bytes_; }
+
+   private:
+    friend class TmpFileMgr;
+
+    const TUniqueId query_id_;
+    const std::string request_pool_;
+
+    /// Total size of the files of the query. Protected by TmpFileMgr::usage_lock_.
+    int64_t bytes_;
+  };
+
   /// File is a handle to a physical file in a temporary directory. Clients
   /// can allocate file space and remove files using AllocateSpace() and Remove().
   /// Creation of the file is deferred until the first call to AllocateSpace().
+  /// Space that is no longer used can be returned with FreeSpace() and is reused by
+  /// later allocations before the file grows. Not thread-safe.
   class File {
    public:
     /// Allocates 'write_size' bytes in this file for a new block of data.
-    /// The file size is increased by a call to truncate() if necessary.
-    /// The physical file is created on the first call to AllocateSpace().
-    /// Returns Status::OK() and sets offset on success.
-    /// Returns an error status if an unexpected error occurs.
+    /// Reuses the lowest free range that fits, otherwise increases the file size by a
+    /// call to truncate() (local files only). The physical file is created on the first
+    /// call to AllocateSpace(). Returns Status::OK() and sets offset on success.
+    /// Returns an error status if an unexpected error occurs or if growing the file
+    /// would exceed a scratch limit.
     /// If an error status is returned, the caller can try a different temporary file.
     Status AllocateSpace(int64_t write_size, int64_t* offset);
 
+    /// Returns the 'len' bytes at 'offset', which were allocated by AllocateSpace(), to
+    /// the free ranges of the file. The range must not be read or written afterwards.
+    /// If --scratch_punch_holes is true, the space of a local file is also released to
+    /// the filesystem until it is reused. The data of a freed range of a remote file is
+    /// kept until the range is written again or the file is removed.
+    void FreeSpace(int64_t offset, int64_t len);
+
     /// Called to notify TmpFileMgr that an IO error was encountered for this file
     void ReportIOError(const ErrorMsg& msg);
 
+    /// Returns the file and the offset in it that the data of the range at 'offset',
+    /// which was allocated by AllocateSpace(), is written to and read from. This is the
+    /// file itself for local files. Remote files are directories with one file per
+    /// range, which is written in a single pass.
+    void GetRangeLocation(int64_t offset, std::string* path, int64_t* file_offset) const;
+
     /// Delete the physical file on disk, if one was created.
     /// It is not valid to read or write to a file after calling Remove().
     Status Remove();
@@ -58,6 +107,11 @@ class TmpFileMgr {
     const std::string& path() const { return path_; }
     int disk_id() const { return disk_id_; }
     bool is_blacklisted() const { return blacklisted_; }
+    bool is_remote() const { return remote_conn_ != NULL; }
+    hdfsFS remote_conn() const { return remote_conn_; }
+
+    /// Number of bytes of the file that are in free ranges.
+    int64_t free_bytes() const { return free_bytes_; }
 
    private:
     friend class TmpFileMgr;
@@ -70,7 +124,8 @@ class TmpFileMgr {
     /// directory. A warning is issued if available space is less than this threshold.
     const static uint64_t AVAILABLE_SPACE_THRESHOLD_MB;
 
-    File(TmpFileMgr* mgr, DeviceId device_id, const std::string& path);
+    File(TmpFileMgr* mgr, DeviceId device_id, const std::string& path,
+        QueryScratchUsage* usage, hdfsFS remote_conn);
 
     /// TmpFileMgr this belongs to.
     TmpFileMgr* mgr_;
@@ -81,12 +136,25 @@ class TmpFileMgr {
     /// The temporary device this file is stored on.
     DeviceId device_id_;
 
-    /// The id of the disk on which the physical file lies.
+    /// The id of the disk on which the physical file lies. -1 for remote files.
     int disk_id_;
 
+    /// Connection to the remote filesystem of a remote file. NULL for local files.
+    hdfsFS remote_conn_;
+
     /// Current file size. Modified by AllocateSpace(). Size is 0 before file creation.
     int64_t current_size_;
 
+    /// The free ranges of the file, as a map from offset to length. Adjacent free
+    /// ranges are merged.
+    std::map<int64_t, int64_t> free_ranges_;
+
+    /// Total length of free_ranges_.
+    int64_t free_bytes_;
+
+    /// The usage of the query that the file belongs to. NULL if it is not accounted.
+    QueryScratchUsage* usage_;
+
     /// Set to true to indicate that file can't be expanded. This is useful to keep here
     /// even though it is redundant with the global per-device blacklisting in TmpFileMgr
     /// because it can be checked without acquiring a global lock. If a file is
@@ -109,13 +177,17 @@ class TmpFileMgr {
   /// Return a new File handle with a unique path for a query instance. The file path
   /// is within the (single) tmp directory on the specified device id. The caller owns
   /// the returned handle and is responsible for deleting it. The file is not created -
-  /// creation is deferred until the first call to File::AllocateSpace().
+  /// creation is deferred until the first call to File::AllocateSpace(). If 'usage' is
+  /// not NULL, the size of the file counts towards the scratch limits of its query.
   Status GetFile(const DeviceId& device_id, const TUniqueId& query_id,
-      File** new_file);
+      File** new_file, QueryScratchUsage* usage = NULL);
 
   /// Return the scratch directory path for the device.
   std::string GetTmpDirPath(DeviceId device_id) const;
 
+  /// Returns true if the device is a remote scratch directory.
+  bool IsRemoteDevice(DeviceId device_id) const;
+
   /// Total number of devices with tmp directories that are active. There is one tmp
   /// directory per device.
   int num_active_tmp_devices();
@@ -141,13 +213,17 @@ class TmpFileMgr {
    private:
     friend class TmpFileMgr;
 
-    /// path should be a absolute path to a writable scratch directory.
-    Dir(const std::string& path, bool blacklisted)
-        : path_(path), blacklisted_(blacklisted) {}
+    /// path should be a absolute path to a writable scratch directory, or a fully
+    /// qualified path on a remote filesystem if remote_conn is not NULL.
+    Dir(const std::string& path, bool blacklisted, hdfsFS remote_conn = NULL)
+        : path_(path), blacklisted_(blacklisted), remote_conn_(remote_conn) {}
 
     std::string path_;
 
     bool blacklisted_;
+
+    /// Connection to the filesystem of a remote directory. NULL for local directories.
+    hdfsFS remote_conn_;
   };
 
   /// Remove a device from the rotation. Subsequent attempts to allocate a file on that
@@ -156,6 +232,19 @@ class TmpFileMgr {
 
   bool IsBlacklisted(DeviceId device_id);
 
+  /// Creates the remote scratch directories in 'remote_dirs'. Directories that cannot
+  /// be used are skipped with a warning.
+  void InitRemoteDirs(const std::vector<std::string>& remote_dirs);
+
+  /// Adds 'bytes' to the scratch space of the query of 'usage' and its pool, and to the
+  /// local scratch space if 'local' is true. 'usage' may be NULL. Returns an error and
+  /// does not add the space if that would exceed a limit.
+  Status TryConsumeScratch(QueryScratchUsage* usage, bool local, int64_t bytes);
+
+  /// Subtracts 'bytes' from the scratch space of the query of 'usage' and its pool,
+  /// and from the local scratch space if 'local' is true.
+  void ReleaseScratch(QueryScratchUsage* usage, bool local, int64_t bytes);
+
   bool initialized_;
 
   /// Protects the status of tmp dirs (i.e. whether they're blacklisted).
@@ -164,6 +253,28 @@ class TmpFileMgr {
   /// The created tmp directories.
   std::vector<Dir> tmp_dirs_;
 
+  /// Limit of the scratch space of each query from --scratch_limit_per_query, or -1
+  /// if there is no limit.
+  int64_t query_scratch_limit_;
+
+  /// Limits of the scratch space of the queries of each pool from
+  /// --scratch_limits_per_pool. Pools that are not included have no limit.
+  std::map<std::string, int64_t> pool_scratch_limits_;
+
+  /// Limit of the total size of the local scratch files from --local_scratch_limit, or
+  /// -1 if there is no limit.
+  int64_t local_scratch_limit_;
+
+  /// Protects pool_scratch_bytes_, local_scratch_bytes_ and the bytes_ of all
+  /// QueryScratchUsages.
+  boost::mutex usage_lock_;
+
+  /// Total size of the local scratch files.
+  int64_t local_scratch_bytes_;
+
+  /// Scratch space used by the queries of each pool that has a limit.
+  std::map<std::string, int64_t> pool_scratch_bytes_;
+
   /// Metrics to track active scratch directories.
   IntGauge* num_active_scratch_dirs_metric_;
   SetMetric<std::string>* active_scratch_dirs_metric_;
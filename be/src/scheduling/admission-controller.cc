@@ -24,6 +24,7 @@
 #include "runtime/exec-env.h"
 #include "runtime/mem-tracker.h"
 #include "util/debug-util.h"
+#include "util/histogram-metric.h"
 #include "util/time.h"
 #include "util/runtime-profile-counters.h"
 #include "util/pretty-printer.h"
@@ -34,6 +35,14 @@ using namespace strings;
 
 DEFINE_int64(queue_wait_timeout_ms, 60 * 1000, "Maximum amount of time (in "
     "milliseconds) that a request will wait to be admitted before timing out.");
+DEFINE_int32(admission_queue_lookahead, 0, "Maximum number of queued requests behind "
+    "the head of a pool's queue that are considered for admission ahead of the head "
+    "when the head does not fit into the available memory. Only requests that need "
+    "less memory than the head are admitted ahead of it. If 0, queued requests are "
+    "admitted strictly in FIFO order.");
+DEFINE_int64(admission_backfill_max_head_wait_ms, 10 * 1000, "Queued requests are only "
+    "admitted ahead of the head of the queue (see --admission_queue_lookahead) while the "
+    "head has been queued for less than this many milliseconds.");
 
 namespace impala {
 
@@ -70,6 +79,8 @@ const string TOTAL_RELEASED_METRIC_KEY_FORMAT =
   "admission-controller.total-released.$0";
 const string TIME_IN_QUEUE_METRIC_KEY_FORMAT =
   "admission-controller.time-in-queue-ms.$0";
+const string QUEUE_WAIT_TIME_METRIC_KEY_FORMAT =
+  "admission-controller.queue-wait-time-ms.$0";
 const string AGG_NUM_RUNNING_METRIC_KEY_FORMAT =
   "admission-controller.agg-num-running.$0";
 const string AGG_NUM_QUEUED_METRIC_KEY_FORMAT =
@@ -457,6 +468,7 @@ Status AdmissionController::AdmitQuery(QuerySchedule* schedule) {
     // We cannot immediately admit but do not need to reject, so queue the request
     VLOG_QUERY << "Queuing, query id=" << schedule->query_id();
     stats->Queue(*schedule);
+    queue_node.enqueue_time_ms = MonotonicMillis();
     queue->Enqueue(&queue_node);
   }
 
@@ -495,6 +507,7 @@ Status AdmissionController::AdmitQuery(QuerySchedule* schedule) {
     pools_for_updates_.insert(pool_name);
     PoolStats* stats = GetPoolStats(pool_name);
     stats->metrics()->time_in_queue_ms->Increment(wait_time_ms);
+    stats->metrics()->queue_wait_time_ms->Update(wait_time_ms);
     // Now that we have the lock, check again if the query was actually admitted (i.e.
     // if the promise still hasn't been set), in which case we just admit the query.
     timed_out = !queue_node.is_admitted.IsSet();
@@ -803,18 +816,60 @@ void AdmissionController::DequeueLoop() {
           break;
         }
         VLOG_RPC << "Dequeuing query=" << schedule.query_id();
-        queue.Dequeue();
-        stats->Dequeue(schedule, false);
-        stats->Admit(schedule);
-        UpdateHostMemAdmitted(schedule, schedule.GetPerHostMemoryEstimate());
-        queue_node->is_admitted.Set(true);
+        AdmitQueuedRequest(&queue, queue_node, stats);
         --max_to_dequeue;
       }
+      if (max_to_dequeue > 0 && !queue.empty() && FLAGS_admission_queue_lookahead > 0) {
+        BackfillQueue(&queue, pool_config, stats, &max_to_dequeue);
+      }
       pools_for_updates_.insert(pool_name);
     }
   }
 }
 
+void AdmissionController::BackfillQueue(RequestQueue* queue,
+    const TPoolConfig& pool_cfg, PoolStats* stats, int64_t* max_to_dequeue) {
+  const QueueNode* head = queue->head();
+  const QuerySchedule& head_schedule = head->schedule;
+  // Admitting other requests cannot help if the head waits for a running query slot.
+  if (pool_cfg.max_requests >= 0 && stats->agg_num_running() >= pool_cfg.max_requests) {
+    return;
+  }
+  // Let the head get the memory that is released next once it waited long enough.
+  if (MonotonicMillis() - head->enqueue_time_ms >=
+      FLAGS_admission_backfill_max_head_wait_ms) {
+    return;
+  }
+  const int64_t head_per_node_mem = head_schedule.GetPerHostMemoryEstimate();
+  const int64_t head_cluster_mem = head_schedule.GetClusterMemoryEstimate();
+  QueueNode* queue_node = head->Next();
+  for (int i = 0; i < FLAGS_admission_queue_lookahead && queue_node != NULL &&
+       *max_to_dequeue > 0; ++i) {
+    QueueNode* next = queue_node->Next();
+    const QuerySchedule& schedule = queue_node->schedule;
+    string not_admitted_reason;
+    if (schedule.GetPerHostMemoryEstimate() < head_per_node_mem &&
+        schedule.GetClusterMemoryEstimate() < head_cluster_mem &&
+        CanAdmitRequest(schedule, pool_cfg, true, &not_admitted_reason)) {
+      VLOG_RPC << "Dequeuing query=" << schedule.query_id() << " ahead of query="
+               << head_schedule.query_id();
+      AdmitQueuedRequest(queue, queue_node, stats);
+      --*max_to_dequeue;
+    }
+    queue_node = next;
+  }
+}
+
+void AdmissionController::AdmitQueuedRequest(RequestQueue* queue,
+    QueueNode* queue_node, PoolStats* stats) {
+  const QuerySchedule& schedule = queue_node->schedule;
+  queue->Remove(queue_node);
+  stats->Dequeue(schedule, false);
+  stats->Admit(schedule);
+  UpdateHostMemAdmitted(schedule, schedule.GetPerHostMemoryEstimate());
+  queue_node->is_admitted.Set(true);
+}
+
 AdmissionController::PoolStats*
 AdmissionController::GetPoolStats(const string& pool_name) {
   PoolStatsMap::iterator it = pool_stats_.find(pool_name);
@@ -841,6 +896,12 @@ void AdmissionController::PoolStats::InitMetrics() {
       TOTAL_RELEASED_METRIC_KEY_FORMAT, 0, name_);
   metrics_.time_in_queue_ms = parent_->metrics_group_->AddCounter<int64_t>(
       TIME_IN_QUEUE_METRIC_KEY_FORMAT, 0, name_);
+  // No particular reasoning behind the max value of five hours, except that queued
+  // requests normally time out much sooner.
+  const int FIVE_HOURS_IN_MS = 60 * 60 * 1000 * 5;
+  metrics_.queue_wait_time_ms = parent_->metrics_group_->RegisterMetric(
+      new HistogramMetric(MakeTMetricDef(Substitute(QUEUE_WAIT_TIME_METRIC_KEY_FORMAT,
+          name_), TMetricKind::HISTOGRAM, TUnit::TIME_MS), FIVE_HOURS_IN_MS, 3));
 
   metrics_.agg_num_running = parent_->metrics_group_->AddGauge<int64_t>(
       AGG_NUM_RUNNING_METRIC_KEY_FORMAT, 0, name_);
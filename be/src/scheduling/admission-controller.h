@@ -35,6 +35,7 @@ namespace impala {
 
 class QuerySchedule;
 class ExecEnv;
+class HistogramMetric;
 
 /// The AdmissionController is used to throttle requests (e.g. queries, DML) based
 /// on available cluster resources, which are configured in one or more resource pools. A
@@ -45,6 +46,12 @@ class ExecEnv;
 /// the queue reaches the maximum queue size, incoming queries will be rejected. Requests
 /// in the queue will time out after a configurable timeout.
 ///
+/// Queued requests are admitted in FIFO order. If --admission_queue_lookahead > 0 and
+/// the head of a pool's queue does not fit into the available memory, up to that many
+/// requests behind it that need less memory than the head and do fit are admitted
+/// ahead of it (backfilling). To bound the delay this causes for the head, backfilling
+/// stops once the head has been queued for --admission_backfill_max_head_wait_ms.
+///
 /// Any impalad can act as a coordinator and thus also an admission controller, so some
 /// cluster state must be shared between impalads in order to make admission decisions on
 /// any node. Every impalad maintains some per-pool and per-host statistics related to
@@ -58,7 +65,10 @@ class ExecEnv;
 ///
 /// Every <impalad, pool> pair is sent as a topic update at the statestore heartbeat
 /// interval when pool statistics change, and the topic updates from other impalads are
-/// used to re-compute the aggregate per-pool stats. Because the pool statistics are only
+/// used to re-compute the aggregate per-pool stats. By default the statestore sends
+/// IMPALA_REQUEST_QUEUE_TOPIC as a priority topic, i.e. every
+/// --statestore_priority_update_frequency_ms rather than with the less frequent regular
+/// topic updates (see --statestore_priority_topics). Because the pool statistics are only
 /// updated on statestore heartbeats and all decisions are made with the cached state,
 /// the aggregate pool statistics are only estimates. As a result, more requests may be
 /// admitted or queued than the configured thresholds, which are really soft limits.
@@ -245,6 +255,9 @@ class AdmissionController {
       IntCounter* total_released;
       IntCounter* time_in_queue_ms;
 
+      /// Distribution of the time that queued requests waited in the queue, in ms.
+      HistogramMetric* queue_wait_time_ms;
+
       /// The following mirror the current values in PoolStats.
       /// TODO: Avoid duplication: replace the int64_t fields on PoolStats with these.
       IntGauge* agg_num_running;
@@ -368,7 +381,8 @@ class AdmissionController {
   /// Structure stored in a QueryQueue representing a request. This struct lives only
   /// during the call to AdmitQuery().
   struct QueueNode : public InternalQueue<QueueNode>::Node {
-    QueueNode(const QuerySchedule& query_schedule) : schedule(query_schedule) { }
+    QueueNode(const QuerySchedule& query_schedule)
+      : schedule(query_schedule), enqueue_time_ms(0) { }
 
     /// Set when the request is admitted or rejected by the dequeuing thread. Used
     /// by AdmitQuery() to wait for admission or until the timeout is reached.
@@ -381,6 +395,9 @@ class AdmissionController {
     /// duration of the QueueNode, which only lives the duration of the call to
     /// AdmitQuery.
     const QuerySchedule& schedule;
+
+    /// MonotonicMillis() when the request was queued.
+    int64_t enqueue_time_ms;
   };
 
   /// Queue for the queries waiting to be admitted for execution. Once the
@@ -434,6 +451,17 @@ class AdmissionController {
   /// Dequeues and admits queued queries when notified by dequeue_cv_.
   void DequeueLoop();
 
+  /// Admits queued requests of the pool of 'queue' that are behind its head, which
+  /// cannot be admitted, if they need less memory than the head and can be admitted.
+  /// Admits at most *max_to_dequeue requests and decrements it by the number admitted.
+  /// Must hold admission_ctrl_lock_.
+  void BackfillQueue(RequestQueue* queue, const TPoolConfig& pool_cfg,
+      PoolStats* stats, int64_t* max_to_dequeue);
+
+  /// Removes 'queue_node' from 'queue' and admits its request to the pool of 'stats'.
+  /// Must hold admission_ctrl_lock_.
+  void AdmitQueuedRequest(RequestQueue* queue, QueueNode* queue_node, PoolStats* stats);
+
   /// Returns true if schedule can be admitted to the pool with pool_cfg.
   /// admit_from_queue is true if attempting to admit from the queue. Otherwise, returns
   /// false and not_admitted_reason specifies why the request can not be admitted
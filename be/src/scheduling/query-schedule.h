@@ -40,6 +40,8 @@ typedef std::map<TPlanNodeId, std::vector<TScanRangeParams> > PerNodeScanRanges;
 /// records scan range assignment for a single fragment
 typedef boost::unordered_map<TNetworkAddress, PerNodeScanRanges>
     FragmentScanRangeAssignment;
+/// map from a data host address to the number of scan range bytes assigned to it
+typedef boost::unordered_map<TNetworkAddress, int64_t> PerHostScanBytes;
 
 /// execution parameters for a single fragment; used to assemble the
 /// TPlanFragmentInstanceCtx;
@@ -50,6 +52,10 @@ struct FragmentExecParams {
   std::vector<TPlanFragmentDestination> destinations;
   std::map<PlanNodeId, int> per_exch_num_senders;
   FragmentScanRangeAssignment scan_range_assignment;
+  /// If the fragment runs more than one instance on a host, the scan ranges of each
+  /// instance, indexed like 'hosts'. Empty otherwise, in which case every instance
+  /// reads all scan ranges of its host in 'scan_range_assignment'.
+  std::vector<PerNodeScanRanges> per_instance_scan_ranges;
   /// In its role as a data sender, a fragment instance is assigned a "sender id" to
   /// uniquely identify it to a receiver. The id that a particular fragment instance
   /// is assigned ranges from [sender_id_base, sender_id_base + N - 1], where
@@ -103,6 +109,7 @@ class QuerySchedule {
   }
   int64_t num_fragment_instances() const { return num_fragment_instances_; }
   int64_t num_scan_ranges() const { return num_scan_ranges_; }
+  PerHostScanBytes* scan_bytes_per_host() { return &scan_bytes_per_host_; }
 
   /// Map node ids to the index of their fragment in TQueryExecRequest.fragments.
   int32_t GetFragmentIdx(PlanNodeId id) const { return plan_node_to_fragment_idx_[id]; }
@@ -159,6 +166,10 @@ class QuerySchedule {
   /// Total number of scan ranges of this query.
   int64_t num_scan_ranges_;
 
+  /// Scan range bytes assigned to each data host by this query. Counted in the
+  /// scheduler's in-flight scan bytes until the schedule is released.
+  PerHostScanBytes scan_bytes_per_host_;
+
   /// Request pool to which the request was submitted for admission.
   std::string request_pool_;
 
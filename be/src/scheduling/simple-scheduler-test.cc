@@ -747,13 +747,36 @@ class SchedulerWrapper {
 
   /// Call ComputeScanRangeAssignment().
   void Compute(Result* result) {
+    PerHostScanBytes inflight_scan_bytes;
+    Compute(result, &inflight_scan_bytes);
+  }
+
+  /// Call ComputeScanRangeAssignment() as if the scan bytes in 'inflight_scan_bytes'
+  /// had been assigned by concurrent queries, and add the bytes of the new assignment.
+  void Compute(Result* result, PerHostScanBytes* inflight_scan_bytes) {
     DCHECK(scheduler_ != NULL);
 
     // Compute Assignment.
     FragmentScanRangeAssignment* assignment = result->AddAssignment();
+    PerHostScanBytes query_scan_bytes;
     scheduler_->ComputeScanRangeAssignment(0, NULL, false,
         plan_.scan_range_locations(), plan_.referenced_datanodes(), false,
-        plan_.query_options(), assignment);
+        plan_.query_options(), *inflight_scan_bytes, &query_scan_bytes, assignment);
+    for (const PerHostScanBytes::value_type& host_bytes: query_scan_bytes) {
+      (*inflight_scan_bytes)[host_bytes.first] += host_bytes.second;
+    }
+  }
+
+  /// Call ComputeFragmentInstances() for a fragment that runs on all hosts of
+  /// 'assignment'.
+  void ComputeInstances(const FragmentScanRangeAssignment& assignment,
+      int num_instances, FragmentExecParams* params) {
+    DCHECK(scheduler_ != NULL);
+    params->scan_range_assignment = assignment;
+    for (const FragmentScanRangeAssignment::value_type& host_ranges: assignment) {
+      params->hosts.push_back(host_ranges.first);
+    }
+    scheduler_->ComputeFragmentInstances(num_instances, params);
   }
 
   /// Reset the state of the scheduler by re-creating and initializing it.
@@ -955,6 +978,31 @@ TEST_F(SchedulerTest, LocalReadsPickFirstReplica) {
   EXPECT_EQ(0, result.NumDiskAssignments(2));
 }
 
+/// Verify that the scan bytes of concurrent queries are taken into account: repeated
+/// schedules of a single block table whose assignments are still in flight use every
+/// replica once.
+TEST_F(SchedulerTest, LocalReadsAvoidLoadedReplicas) {
+  Cluster cluster;
+  for (int i = 0; i < 10; ++i) cluster.AddHost(i < 5, true);
+
+  Schema schema(cluster);
+  schema.AddSingleBlockTable("T1", {0, 1, 2});
+
+  Plan plan(schema);
+  plan.AddTableScan("T1");
+  plan.SetRandomReplica(false);
+
+  Result result(plan);
+  SchedulerWrapper scheduler(plan);
+  PerHostScanBytes inflight_scan_bytes;
+  for (int i = 0; i < 3; ++i) scheduler.Compute(&result, &inflight_scan_bytes);
+
+  EXPECT_EQ(3, result.NumTotalAssignments());
+  EXPECT_EQ(1, result.NumDiskAssignments(0));
+  EXPECT_EQ(1, result.NumDiskAssignments(1));
+  EXPECT_EQ(1, result.NumDiskAssignments(2));
+}
+
 /// Verify that scheduling with random_replica = true results in a pseudo-random
 /// round-robin selection of backends.
 /// Disabled, global backend rotation not implemented.
@@ -1048,6 +1096,47 @@ TEST_F(SchedulerTest, ManyScanRanges) {
   EXPECT_LE(result.MaxNumAssignedBytesPerHost(), 140 * Block::DEFAULT_BLOCK_SIZE);
 }
 
+/// Split the scan ranges of each host between several instances of a fragment.
+TEST_F(SchedulerTest, MultipleInstancesPerHost) {
+  Cluster cluster;
+  cluster.AddHosts(3, true, true);
+
+  Schema schema(cluster);
+  schema.AddMultiBlockTable("T", 30, ReplicaPlacement::LOCAL_ONLY, 1);
+
+  Plan plan(schema);
+  plan.AddTableScan("T");
+
+  Result result(plan);
+  SchedulerWrapper scheduler(plan);
+  scheduler.Compute(&result);
+
+  const int num_instances = 4;
+  FragmentExecParams params;
+  scheduler.ComputeInstances(result.GetAssignment(), num_instances, &params);
+  ASSERT_EQ(3 * num_instances, params.hosts.size());
+  ASSERT_EQ(params.hosts.size(), params.per_instance_scan_ranges.size());
+
+  int num_ranges = 0;
+  for (int i = 0; i < params.hosts.size(); ++i) {
+    // The instances of a host are consecutive and read only ranges of that host.
+    EXPECT_EQ(params.hosts[i], params.hosts[i - i % num_instances]);
+    const PerNodeScanRanges& host_ranges =
+        params.scan_range_assignment[params.hosts[i]];
+    int num_host_ranges = host_ranges.begin()->second.size();
+    int num_instance_ranges = 0;
+    for (const PerNodeScanRanges::value_type& ranges:
+        params.per_instance_scan_ranges[i]) {
+      num_instance_ranges += ranges.second.size();
+    }
+    // All ranges have the same length, so they are spread evenly.
+    EXPECT_GE(num_instance_ranges, num_host_ranges / num_instances);
+    EXPECT_LE(num_instance_ranges, (num_host_ranges + num_instances - 1) / num_instances);
+    num_ranges += num_instance_ranges;
+  }
+  EXPECT_EQ(30, num_ranges);
+}
+
 /// Compute a schedule in a split cluster (disjoint set of backends and datanodes).
 TEST_F(SchedulerTest, DisjointClusterWithRemoteReads) {
   Cluster cluster;
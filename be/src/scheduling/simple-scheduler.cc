@@ -14,6 +14,7 @@
 
 #include "scheduling/simple-scheduler.h"
 
+#include <algorithm>
 #include <vector>
 
 #include <boost/algorithm/string.hpp>
@@ -57,6 +58,14 @@ DECLARE_int32(rm_default_cpu_vcores);
 DECLARE_string(rm_default_memory);
 
 DEFINE_bool(disable_admission_control, false, "Disables admission control.");
+DEFINE_bool(load_aware_scan_assignment, true, "If true, the scan bytes that running "
+    "queries scheduled by this coordinator have assigned to each host are taken into "
+    "account when choosing between equally close replicas of a scan range.");
+DEFINE_int32(scan_range_assignment_cache_size, 0, "(Advanced) Number of scan range "
+    "assignments of single scan nodes that are cached for reuse by later queries that "
+    "scan the same ranges with the same options. Cached assignments are dropped when "
+    "the set of backends changes. A cached assignment ignores the scans of concurrent "
+    "queries. If <= 0, assignments are always computed.");
 
 namespace impala {
 
@@ -319,8 +328,13 @@ void SimpleScheduler::UpdateMembership(
           current_membership_.erase(backend_id);
         }
       }
-      // Update invalidated iterator.
-      if (backend_map_changed) next_nonlocal_backend_entry_ = backend_map_.begin();
+      if (backend_map_changed) {
+        // Update invalidated iterator.
+        next_nonlocal_backend_entry_ = backend_map_.begin();
+        // Cached assignments may refer to backends that are gone or miss new ones.
+        lock_guard<mutex> l(assignment_cache_lock_);
+        assignment_cache_.clear();
+      }
     }
 
     // If this impalad is not in our view of the membership list, we should add it and
@@ -422,6 +436,13 @@ void SimpleScheduler::GetAllKnownBackends(BackendList* backends) {
 
 Status SimpleScheduler::ComputeScanRangeAssignment(const TQueryExecRequest& exec_request,
     QuerySchedule* schedule) {
+  // Snapshot of the scan bytes of the other running queries.
+  PerHostScanBytes other_scan_bytes;
+  if (FLAGS_load_aware_scan_assignment) {
+    lock_guard<mutex> l(inflight_scan_bytes_lock_);
+    other_scan_bytes = inflight_scan_bytes_;
+  }
+  PerHostScanBytes query_scan_bytes;
   map<TPlanNodeId, vector<TScanRangeLocations> >::const_iterator entry;
   for (entry = exec_request.per_node_scan_ranges.begin();
       entry != exec_request.per_node_scan_ranges.end(); ++entry) {
@@ -442,19 +463,138 @@ Status SimpleScheduler::ComputeScanRangeAssignment(const TQueryExecRequest& exec
 
     FragmentScanRangeAssignment* assignment =
         &(*schedule->exec_params())[fragment_idx].scan_range_assignment;
+    schedule->AddScanRanges(entry->second.size());
+
+    // Random replica selection must be repeated for every query.
+    bool use_cache = FLAGS_scan_range_assignment_cache_size > 0 &&
+        !node_random_replica && !schedule->query_options().schedule_random_replica;
+    string cache_key;
+    if (use_cache) {
+      RETURN_IF_ERROR(GetAssignmentCacheKey(node_id, node_replica_preference,
+          entry->second, exec_request.host_list, exec_at_coord,
+          schedule->query_options(), &cache_key));
+      if (LookupCachedAssignment(cache_key, node_id, &query_scan_bytes, assignment)) {
+        continue;
+      }
+    }
+    PerHostScanBytes prev_scan_bytes;
+    if (use_cache) prev_scan_bytes = query_scan_bytes;
     RETURN_IF_ERROR(ComputeScanRangeAssignment(
         node_id, node_replica_preference, node_random_replica, entry->second,
-        exec_request.host_list, exec_at_coord, schedule->query_options(), assignment));
-    schedule->AddScanRanges(entry->second.size());
+        exec_request.host_list, exec_at_coord, schedule->query_options(),
+        other_scan_bytes, &query_scan_bytes, assignment));
+    if (use_cache) {
+      PerHostScanBytes node_scan_bytes;
+      for (const PerHostScanBytes::value_type& host_bytes: query_scan_bytes) {
+        PerHostScanBytes::const_iterator prev = prev_scan_bytes.find(host_bytes.first);
+        int64_t delta = host_bytes.second -
+            (prev == prev_scan_bytes.end() ? 0 : prev->second);
+        if (delta > 0) node_scan_bytes[host_bytes.first] = delta;
+      }
+      CacheAssignment(cache_key, node_id, *assignment, node_scan_bytes);
+    }
+  }
+
+  if (FLAGS_load_aware_scan_assignment) {
+    DCHECK(schedule->scan_bytes_per_host()->empty());
+    lock_guard<mutex> l(inflight_scan_bytes_lock_);
+    for (const PerHostScanBytes::value_type& host_bytes: query_scan_bytes) {
+      inflight_scan_bytes_[host_bytes.first] += host_bytes.second;
+    }
+    schedule->scan_bytes_per_host()->swap(query_scan_bytes);
   }
   return Status::OK();
 }
 
+Status SimpleScheduler::GetAssignmentCacheKey(PlanNodeId node_id,
+    const TReplicaPreference::type* node_replica_preference,
+    const vector<TScanRangeLocations>& locations,
+    const vector<TNetworkAddress>& host_list, bool exec_at_coord,
+    const TQueryOptions& query_options, string* key) {
+  stringstream ss;
+  ss << node_id << ":" << (node_replica_preference != NULL ?
+      static_cast<int>(*node_replica_preference) : -1) << ":" << exec_at_coord << ":"
+     << query_options.disable_cached_reads << ":" << locations.size() << ":"
+     << host_list.size() << ":";
+  // Serialized thrift structs are self-delimiting, so they can be concatenated.
+  ThriftSerializer serializer(true);
+  string serialized;
+  for (const TScanRangeLocations& scan_range_locations: locations) {
+    RETURN_IF_ERROR(serializer.Serialize(
+        const_cast<TScanRangeLocations*>(&scan_range_locations), &serialized));
+    ss << serialized;
+  }
+  for (const TNetworkAddress& host: host_list) {
+    RETURN_IF_ERROR(serializer.Serialize(const_cast<TNetworkAddress*>(&host),
+        &serialized));
+    ss << serialized;
+  }
+  *key = ss.str();
+  return Status::OK();
+}
+
+bool SimpleScheduler::LookupCachedAssignment(const string& key, PlanNodeId node_id,
+    PerHostScanBytes* query_scan_bytes, FragmentScanRangeAssignment* assignment) {
+  lock_guard<mutex> l(assignment_cache_lock_);
+  list<CachedAssignment>::iterator it = assignment_cache_.begin();
+  while (it != assignment_cache_.end() && it->key != key) ++it;
+  if (it == assignment_cache_.end()) return false;
+  // Move the entry to the front of the LRU list.
+  assignment_cache_.splice(assignment_cache_.begin(), assignment_cache_, it);
+  for (const pair<TNetworkAddress, vector<TScanRangeParams> >& host_ranges: it->ranges) {
+    (*assignment)[host_ranges.first][node_id] = host_ranges.second;
+  }
+  for (const PerHostScanBytes::value_type& host_bytes: it->scan_bytes) {
+    (*query_scan_bytes)[host_bytes.first] += host_bytes.second;
+  }
+  return true;
+}
+
+void SimpleScheduler::CacheAssignment(const string& key, PlanNodeId node_id,
+    const FragmentScanRangeAssignment& assignment, const PerHostScanBytes& scan_bytes) {
+  // Build the entry outside of the lock and splice it into the cache.
+  list<CachedAssignment> new_entry(1);
+  CachedAssignment* entry = &new_entry.front();
+  entry->key = key;
+  for (const FragmentScanRangeAssignment::value_type& host_ranges: assignment) {
+    PerNodeScanRanges::const_iterator ranges = host_ranges.second.find(node_id);
+    if (ranges == host_ranges.second.end()) continue;
+    entry->ranges.push_back(make_pair(host_ranges.first, ranges->second));
+  }
+  entry->scan_bytes = scan_bytes;
+
+  lock_guard<mutex> l(assignment_cache_lock_);
+  // A concurrent query may have cached the same assignment.
+  for (const CachedAssignment& cached: assignment_cache_) {
+    if (cached.key == key) return;
+  }
+  assignment_cache_.splice(assignment_cache_.begin(), new_entry);
+  while (assignment_cache_.size() >
+      static_cast<size_t>(FLAGS_scan_range_assignment_cache_size)) {
+    assignment_cache_.pop_back();
+  }
+}
+
+void SimpleScheduler::ReleaseInflightScanBytes(QuerySchedule* schedule) {
+  PerHostScanBytes* scan_bytes = schedule->scan_bytes_per_host();
+  if (scan_bytes->empty()) return;
+  lock_guard<mutex> l(inflight_scan_bytes_lock_);
+  for (const PerHostScanBytes::value_type& host_bytes: *scan_bytes) {
+    PerHostScanBytes::iterator it = inflight_scan_bytes_.find(host_bytes.first);
+    DCHECK(it != inflight_scan_bytes_.end());
+    it->second -= host_bytes.second;
+    DCHECK_GE(it->second, 0);
+    if (it->second <= 0) inflight_scan_bytes_.erase(it);
+  }
+  scan_bytes->clear();
+}
+
 Status SimpleScheduler::ComputeScanRangeAssignment(
     PlanNodeId node_id, const TReplicaPreference::type* node_replica_preference,
     bool node_random_replica, const vector<TScanRangeLocations>& locations,
     const vector<TNetworkAddress>& host_list, bool exec_at_coord,
-    const TQueryOptions& query_options, FragmentScanRangeAssignment* assignment) {
+    const TQueryOptions& query_options, const PerHostScanBytes& other_scan_bytes,
+    PerHostScanBytes* query_scan_bytes, FragmentScanRangeAssignment* assignment) {
   // We adjust all replicas with memory distance less than base_distance to base_distance
   // and view all replicas with equal or better distance as the same. For a full list of
   // memory distance classes see TReplicaPreference in PlanNodes.thrift.
@@ -518,6 +658,11 @@ Status SimpleScheduler::ComputeScanRangeAssignment(
       uint64_t initial_bytes = 0L;
       uint64_t assigned_bytes =
           *FindOrInsert(&assigned_bytes_per_host, replica_host, initial_bytes);
+      // Also count the bytes assigned by other scans of this and concurrent queries.
+      PerHostScanBytes::const_iterator query_bytes = query_scan_bytes->find(replica_host);
+      if (query_bytes != query_scan_bytes->end()) assigned_bytes += query_bytes->second;
+      PerHostScanBytes::const_iterator other_bytes = other_scan_bytes.find(replica_host);
+      if (other_bytes != other_scan_bytes.end()) assigned_bytes += other_bytes->second;
 
       bool found_new_replica = false;
 
@@ -602,6 +747,11 @@ Status SimpleScheduler::ComputeScanRangeAssignment(
     scan_range_params_list->push_back(scan_range_params);
   }
 
+  for (const unordered_map<TNetworkAddress, uint64_t>::value_type& host_bytes:
+       assigned_bytes_per_host) {
+    if (host_bytes.second > 0) (*query_scan_bytes)[host_bytes.first] += host_bytes.second;
+  }
+
   if (VLOG_FILE_IS_ON) {
     VLOG_FILE << "Total remote scan volume = " <<
         PrettyPrinter::Print(remote_bytes, TUnit::BYTES);
@@ -767,6 +917,19 @@ void SimpleScheduler::ComputeFragmentHosts(const TQueryExecRequest& exec_request
     GetScanHosts(leftmost_scan_id, exec_request, params, &params.hosts);
   }
 
+  // Multi-threaded execution: run several instances of every partitioned fragment on
+  // each of its hosts. This is done once all hosts are known, so that fragments that
+  // inherit the hosts of their input fragment are not expanded twice.
+  int num_instances = schedule->query_options().mt_num_cores;
+  if (num_instances > 1) {
+    for (int i = 0; i < exec_request.fragments.size(); ++i) {
+      if (exec_request.fragments[i].partition.type == TPartitionType::UNPARTITIONED) {
+        continue;
+      }
+      ComputeFragmentInstances(num_instances, &(*fragment_exec_params)[i]);
+    }
+  }
+
   unordered_set<TNetworkAddress> unique_hosts;
   for (const FragmentExecParams& exec_params: *fragment_exec_params) {
     unique_hosts.insert(exec_params.hosts.begin(), exec_params.hosts.end());
@@ -775,6 +938,45 @@ void SimpleScheduler::ComputeFragmentHosts(const TQueryExecRequest& exec_request
   schedule->SetUniqueHosts(unique_hosts);
 }
 
+void SimpleScheduler::ComputeFragmentInstances(int num_instances,
+    FragmentExecParams* params) {
+  DCHECK_GT(num_instances, 1);
+  vector<TNetworkAddress> hosts;
+  hosts.swap(params->hosts);
+  params->per_instance_scan_ranges.resize(hosts.size() * num_instances);
+  for (int i = 0; i < hosts.size(); ++i) {
+    params->hosts.insert(params->hosts.end(), num_instances, hosts[i]);
+    FragmentScanRangeAssignment::const_iterator host_it =
+        params->scan_range_assignment.find(hosts[i]);
+    if (host_it == params->scan_range_assignment.end()) continue;
+    PerNodeScanRanges* instance_ranges =
+        &params->per_instance_scan_ranges[i * num_instances];
+
+    for (const PerNodeScanRanges::value_type& node_ranges: host_it->second) {
+      // Assign the largest ranges first, each to the instance with the fewest bytes.
+      // Ranges without a length (e.g. HBase key ranges) count as one byte.
+      vector<pair<int64_t, const TScanRangeParams*> > ranges;
+      for (const TScanRangeParams& range: node_ranges.second) {
+        int64_t len = range.scan_range.__isset.hdfs_file_split ?
+            max<int64_t>(range.scan_range.hdfs_file_split.length, 1) : 1;
+        ranges.push_back(make_pair(len, &range));
+      }
+      std::stable_sort(ranges.begin(), ranges.end(),
+          [](const pair<int64_t, const TScanRangeParams*>& a,
+              const pair<int64_t, const TScanRangeParams*>& b) {
+            return a.first > b.first;
+          });
+      vector<int64_t> assigned_bytes(num_instances, 0);
+      for (const pair<int64_t, const TScanRangeParams*>& range: ranges) {
+        int instance_idx = std::min_element(assigned_bytes.begin(), assigned_bytes.end())
+            - assigned_bytes.begin();
+        assigned_bytes[instance_idx] += range.first;
+        instance_ranges[instance_idx][node_ranges.first].push_back(*range.second);
+      }
+    }
+  }
+}
+
 PlanNodeId SimpleScheduler::FindLeftmostNode(
     const TPlan& plan, const vector<TPlanNodeType::type>& types) {
   // the first node with num_children == 0 is the leftmost node
@@ -904,6 +1106,7 @@ Status SimpleScheduler::Schedule(Coordinator* coord, QuerySchedule* schedule) {
 }
 
 Status SimpleScheduler::Release(QuerySchedule* schedule) {
+  ReleaseInflightScanBytes(schedule);
   if (!FLAGS_disable_admission_control) {
     RETURN_IF_ERROR(admission_controller_->ReleaseQuery(schedule));
   }
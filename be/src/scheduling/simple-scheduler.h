@@ -144,6 +144,35 @@ class SimpleScheduler : public Scheduler {
   /// Counts the number of UpdateMembership invocations, to help throttle the logging.
   uint32_t update_count_;
 
+  /// Protects inflight_scan_bytes_.
+  boost::mutex inflight_scan_bytes_lock_;
+
+  /// Scan range bytes per data host of the queries that were scheduled by this
+  /// coordinator and have not been released yet. Used to balance the scan ranges of
+  /// concurrent queries if --load_aware_scan_assignment is true.
+  PerHostScanBytes inflight_scan_bytes_;
+
+  /// A scan range assignment of a single scan node that can be reused by later queries
+  /// that scan the same ranges with the same options.
+  struct CachedAssignment {
+    /// See GetAssignmentCacheKey().
+    std::string key;
+
+    /// The scan ranges of the scan node per backend.
+    std::vector<std::pair<TNetworkAddress, std::vector<TScanRangeParams> > > ranges;
+
+    /// The scan bytes that the assignment put on each data host.
+    PerHostScanBytes scan_bytes;
+  };
+
+  /// Protects assignment_cache_.
+  boost::mutex assignment_cache_lock_;
+
+  /// Cached assignments, most recently used first. Holds at most
+  /// --scan_range_assignment_cache_size entries, so lookups are a linear search.
+  /// Cleared whenever the set of backends changes.
+  std::list<CachedAssignment> assignment_cache_;
+
   /// Protects active_reservations_ and active_client_resources_.
   boost::mutex active_resources_lock_;
 
@@ -207,11 +236,41 @@ class SimpleScheduler : public Scheduler {
   /// Does a scan range assignment (returned in 'assignment') based on a list of scan
   /// range locations for a particular scan node.
   /// If exec_at_coord is true, all scan ranges will be assigned to the coord node.
+  /// Among equally close replicas, the one whose host has the fewest bytes assigned by
+  /// this scan node, 'query_scan_bytes' and 'other_scan_bytes' together is picked.
+  /// 'other_scan_bytes' are the in-flight bytes of other queries, 'query_scan_bytes'
+  /// those of the other scan nodes of this query. The bytes assigned by this call are
+  /// added to 'query_scan_bytes'.
   Status ComputeScanRangeAssignment(PlanNodeId node_id,
       const TReplicaPreference::type* node_replica_preference, bool node_random_replica,
       const std::vector<TScanRangeLocations>& locations,
       const std::vector<TNetworkAddress>& host_list, bool exec_at_coord,
-      const TQueryOptions& query_options, FragmentScanRangeAssignment* assignment);
+      const TQueryOptions& query_options, const PerHostScanBytes& other_scan_bytes,
+      PerHostScanBytes* query_scan_bytes, FragmentScanRangeAssignment* assignment);
+
+  /// Removes the scan bytes of 'schedule' from inflight_scan_bytes_.
+  void ReleaseInflightScanBytes(QuerySchedule* schedule);
+
+  /// Builds the key under which the scan range assignment of a scan node with the given
+  /// parameters is cached in assignment_cache_. The key contains all inputs of
+  /// ComputeScanRangeAssignment() except for the scan bytes of other scans.
+  Status GetAssignmentCacheKey(PlanNodeId node_id,
+      const TReplicaPreference::type* node_replica_preference,
+      const std::vector<TScanRangeLocations>& locations,
+      const std::vector<TNetworkAddress>& host_list, bool exec_at_coord,
+      const TQueryOptions& query_options, std::string* key);
+
+  /// Looks up 'key' in assignment_cache_. On a hit, adds the cached scan ranges of
+  /// 'node_id' to 'assignment' and the cached scan bytes to 'query_scan_bytes', and
+  /// returns true.
+  bool LookupCachedAssignment(const std::string& key, PlanNodeId node_id,
+      PerHostScanBytes* query_scan_bytes, FragmentScanRangeAssignment* assignment);
+
+  /// Adds the scan ranges of 'node_id' in 'assignment', which assigned 'scan_bytes' to
+  /// the data hosts, to assignment_cache_ under 'key'. Evicts the least recently used
+  /// entry if the cache is full.
+  void CacheAssignment(const std::string& key, PlanNodeId node_id,
+      const FragmentScanRangeAssignment& assignment, const PerHostScanBytes& scan_bytes);
 
   /// Populates fragment_exec_params_ in schedule.
   void ComputeFragmentExecParams(const TQueryExecRequest& exec_request,
@@ -222,6 +281,13 @@ class SimpleScheduler : public Scheduler {
   void ComputeFragmentHosts(const TQueryExecRequest& exec_request,
       QuerySchedule* schedule);
 
+  /// Runs 'num_instances' instances of the partitioned fragment 'params' on each of its
+  /// hosts: every host is repeated 'num_instances' times in params.hosts, and the scan
+  /// ranges that were assigned to a host are split between its instances such that
+  /// each instance reads about the same number of bytes. The result is stored in
+  /// params.per_instance_scan_ranges.
+  void ComputeFragmentInstances(int num_instances, FragmentExecParams* params);
+
   /// Returns the id of the leftmost node of any of the given types in 'plan',
   /// or INVALID_PLAN_NODE_ID if no such node present.
   PlanNodeId FindLeftmostNode(
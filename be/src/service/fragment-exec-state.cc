@@ -23,6 +23,9 @@
 #include "runtime/runtime-filter-bank.h"
 #include "util/bloom-filter.h"
 #include "runtime/backend-client.h"
+#include "runtime/exec-env.h"
+#include "util/cgroups-mgr.h"
+#include "util/debug-util.h"
 
 #include "common/names.h"
 
@@ -45,12 +48,27 @@ Status FragmentMgr::FragmentExecState::Cancel() {
 
 Status FragmentMgr::FragmentExecState::Prepare() {
   Status status = executor_.Prepare(exec_params_);
+  if (status.ok() && !executor_.runtime_state()->cgroup().empty()) {
+    // The threads that the fragment starts are placed into its cgroup by their thread
+    // groups. This thread only runs this fragment, so it can join them.
+    Status cgroup_status =
+        ExecEnv::GetInstance()->cgroups_mgr()->AssignCurrentThreadToCgroup(
+            executor_.runtime_state()->cgroup());
+    if (!cgroup_status.ok()) {
+      LOG(WARNING) << "Could not move the thread of fragment "
+                   << PrintId(fragment_instance_id()) << " into its cgroup: "
+                   << cgroup_status.GetDetail();
+    }
+  }
   if (!status.ok()) ReportStatusCb(status, NULL, true);
   prepare_promise_.Set(status);
   return status;
 }
 
 void FragmentMgr::FragmentExecState::Exec() {
+  // Run the fragment, and the threads it starts, on its NUMA node so that the memory
+  // it allocates in Open() is local.
+  executor_.runtime_state()->resource_pool()->BindCurrentThreadToNumaNode();
   // Open() does the full execution, because all plan fragments have sinks
   executor_.Open();
   executor_.Close();
@@ -15,9 +15,12 @@
 #include "service/hs2-util.h"
 
 #include "common/logging.h"
+#include "exprs/expr-context.h"
 #include "runtime/decimal-value.inline.h"
 #include "runtime/raw-value.inline.h"
+#include "runtime/row-batch.h"
 #include "runtime/types.h"
+#include "util/bit-util.h"
 
 #include <gutil/strings/substitute.h>
 
@@ -217,6 +220,66 @@ void impala::ExprValueToHS2TColumn(const void* value, const TColumnType& type,
   SetNullBit(row_idx, (value == NULL), nulls);
 }
 
+// Appends the values of 'expr_ctx' for the rows [start_idx, start_idx + num_rows) of
+// 'batch' to 'values' and 'nulls', converting from slot type 'S' to column type 'T'.
+template <typename T, typename S>
+static void ExprValuesToHS2TColumnHelper(ExprContext* expr_ctx, RowBatch* batch,
+    int start_idx, int num_rows, uint32_t output_row_idx, vector<T>* values,
+    string* nulls) {
+  values->reserve(output_row_idx + num_rows);
+  nulls->reserve(BitUtil::Ceil(output_row_idx + num_rows, 8));
+  for (int i = 0; i < num_rows; ++i) {
+    const void* value = expr_ctx->GetValue(batch->GetRow(start_idx + i));
+    values->push_back(value == NULL ? T() : *reinterpret_cast<const S*>(value));
+    SetNullBit(output_row_idx + i, value == NULL, nulls);
+  }
+}
+
+// For V6 and above
+void impala::ExprValuesToHS2TColumn(ExprContext* expr_ctx, const TColumnType& type,
+    RowBatch* batch, int start_idx, int num_rows, uint32_t output_row_idx,
+    thrift::TColumn* column) {
+  switch (type.types[0].scalar_type.type) {
+    case TPrimitiveType::NULL_TYPE:
+    case TPrimitiveType::BOOLEAN:
+      ExprValuesToHS2TColumnHelper<bool, bool>(expr_ctx, batch, start_idx, num_rows,
+          output_row_idx, &column->boolVal.values, &column->boolVal.nulls);
+      return;
+    case TPrimitiveType::TINYINT:
+      ExprValuesToHS2TColumnHelper<int8_t, int8_t>(expr_ctx, batch, start_idx, num_rows,
+          output_row_idx, &column->byteVal.values, &column->byteVal.nulls);
+      return;
+    case TPrimitiveType::SMALLINT:
+      ExprValuesToHS2TColumnHelper<int16_t, int16_t>(expr_ctx, batch, start_idx,
+          num_rows, output_row_idx, &column->i16Val.values, &column->i16Val.nulls);
+      return;
+    case TPrimitiveType::INT:
+      ExprValuesToHS2TColumnHelper<int32_t, int32_t>(expr_ctx, batch, start_idx,
+          num_rows, output_row_idx, &column->i32Val.values, &column->i32Val.nulls);
+      return;
+    case TPrimitiveType::BIGINT:
+      ExprValuesToHS2TColumnHelper<int64_t, int64_t>(expr_ctx, batch, start_idx,
+          num_rows, output_row_idx, &column->i64Val.values, &column->i64Val.nulls);
+      return;
+    case TPrimitiveType::FLOAT:
+      ExprValuesToHS2TColumnHelper<double, float>(expr_ctx, batch, start_idx, num_rows,
+          output_row_idx, &column->doubleVal.values, &column->doubleVal.nulls);
+      return;
+    case TPrimitiveType::DOUBLE:
+      ExprValuesToHS2TColumnHelper<double, double>(expr_ctx, batch, start_idx, num_rows,
+          output_row_idx, &column->doubleVal.values, &column->doubleVal.nulls);
+      return;
+    default:
+      // Values that are converted to strings are dominated by the conversion.
+      column->stringVal.values.reserve(output_row_idx + num_rows);
+      for (int i = 0; i < num_rows; ++i) {
+        ExprValueToHS2TColumn(expr_ctx->GetValue(batch->GetRow(start_idx + i)), type,
+            output_row_idx + i, column);
+      }
+      return;
+  }
+}
+
 // For V1 -> V5
 void impala::TColumnValueToHS2TColumnValue(const TColumnValue& col_val,
     const TColumnType& type, thrift::TColumnValue* hs2_col_val) {
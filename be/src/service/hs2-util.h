@@ -17,6 +17,9 @@
 
 namespace impala {
 
+class ExprContext;
+class RowBatch;
+
 /// Utility methods for converting from Impala (either an Expr result or a TColumnValue) to
 /// Hive types (either a thrift::TColumnValue (V1->V5) or a TColumn (V6->).
 
@@ -28,6 +31,14 @@ void TColumnValueToHS2TColumn(const TColumnValue& col_val, const TColumnType& ty
 void ExprValueToHS2TColumn(const void* value, const TColumnType& type,
     uint32_t row_idx, apache::hive::service::cli::thrift::TColumn* column);
 
+/// For V6->
+/// Evaluates 'expr_ctx' over the rows [start_idx, start_idx + num_rows) of 'batch' and
+/// appends the results to 'column', whose first new row is 'output_row_idx'. Faster than
+/// calling ExprValueToHS2TColumn() for every row.
+void ExprValuesToHS2TColumn(ExprContext* expr_ctx, const TColumnType& type,
+    RowBatch* batch, int start_idx, int num_rows, uint32_t output_row_idx,
+    apache::hive::service::cli::thrift::TColumn* column);
+
 /// For V1->V5
 void TColumnValueToHS2TColumnValue(const TColumnValue& col_val, const TColumnType& type,
     apache::hive::service::cli::thrift::TColumnValue* hs2_col_val);
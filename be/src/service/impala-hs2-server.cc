@@ -163,6 +163,18 @@ class ImpalaServer::HS2ColumnarResultSet : public ImpalaServer::QueryResultSet {
     return Status::OK();
   }
 
+  // Add the rows of a batch, converting one column at a time
+  virtual Status AddRowBatch(const vector<ExprContext*>& expr_ctxs, RowBatch* batch,
+      int start_idx, int num_rows) {
+    DCHECK_EQ(expr_ctxs.size(), metadata_.columns.size());
+    for (int i = 0; i < expr_ctxs.size(); ++i) {
+      ExprValuesToHS2TColumn(expr_ctxs[i], metadata_.columns[i].columnType, batch,
+          start_idx, num_rows, num_rows_, &(result_set_->columns[i]));
+    }
+    num_rows_ += num_rows;
+    return Status::OK();
+  }
+
   // Copy all columns starting at 'start_idx' and proceeding for a maximum of 'num_rows'
   // from 'other' into this result set
   virtual int AddRows(const QueryResultSet* other, int start_idx, int num_rows) {
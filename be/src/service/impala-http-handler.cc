@@ -19,6 +19,8 @@
 #include <gutil/strings/substitute.h>
 
 #include "catalog/catalog-util.h"
+#include "runtime/disk-io-mgr.h"
+#include "runtime/exec-env.h"
 #include "service/impala-server.h"
 #include "service/query-exec-state.h"
 #include "gen-cpp/beeswax_types.h"
@@ -70,14 +72,17 @@ void ImpalaHttpHandler::RegisterHandlers(Webserver* webserver) {
   webserver->RegisterUrlCallback("/hadoop-varz", "hadoop-varz.tmpl",
       MakeCallback(this, &ImpalaHttpHandler::HadoopVarzHandler));
 
+  webserver->RegisterUrlCallback("/io_mgr", "common-pre.tmpl",
+      MakeCallback(this, &ImpalaHttpHandler::IoMgrHandler));
+
   webserver->RegisterUrlCallback("/queries", "queries.tmpl",
-      MakeCallback(this, &ImpalaHttpHandler::QueryStateHandler));
+      MakeCallback(this, &ImpalaHttpHandler::QueryStateHandler), true, true);
 
   webserver->RegisterUrlCallback("/sessions", "sessions.tmpl",
       MakeCallback(this, &ImpalaHttpHandler::SessionsHandler));
 
   webserver->RegisterUrlCallback("/catalog", "catalog.tmpl",
-      MakeCallback(this, &ImpalaHttpHandler::CatalogHandler));
+      MakeCallback(this, &ImpalaHttpHandler::CatalogHandler), true, true);
 
   webserver->RegisterUrlCallback("/catalog_object", "catalog_object.tmpl",
       MakeCallback(this, &ImpalaHttpHandler::CatalogObjectsHandler), false);
@@ -130,6 +135,18 @@ void ImpalaHttpHandler::HadoopVarzHandler(const Webserver::ArgumentMap& args,
   document->AddMember("configs", configs, document->GetAllocator());
 }
 
+void ImpalaHttpHandler::IoMgrHandler(const Webserver::ArgumentMap& args,
+    Document* document) {
+  DiskIoMgr* io_mgr = server_->exec_env_->disk_io_mgr();
+  Value title("IO Manager", document->GetAllocator());
+  document->AddMember("title", title, document->GetAllocator());
+  stringstream ss;
+  ss << "Request pools:" << endl << io_mgr->PoolStatsDebugString() << endl
+     << io_mgr->DebugString();
+  Value contents(ss.str().c_str(), document->GetAllocator());
+  document->AddMember("contents", contents, document->GetAllocator());
+}
+
 void ImpalaHttpHandler::CancelQueryHandler(const Webserver::ArgumentMap& args,
     Document* document) {
   TUniqueId unique_id;
@@ -324,33 +341,40 @@ void ImpalaHttpHandler::QueryStateHandler(const Webserver::ArgumentMap& args,
       "free the resources they are using, they must be closed.",
       document->GetAllocator());
 
-  Value completed_queries(kArrayType);
+  // Copy the query log and the locations so that the locks aren't held while the JSON
+  // is built. Queries that start or finish wait for these locks.
+  ImpalaServer::QueryLog query_log;
   {
     lock_guard<mutex> l(server_->query_log_lock_);
-    for (const ImpalaServer::QueryStateRecord& log_entry: server_->query_log_) {
-      Value record_json(kObjectType);
-      QueryStateToJson(log_entry, &record_json, document);
-      completed_queries.PushBack(record_json, document->GetAllocator());
-    }
+    query_log = server_->query_log_;
+  }
+  Value completed_queries(kArrayType);
+  for (const ImpalaServer::QueryStateRecord& log_entry: query_log) {
+    Value record_json(kObjectType);
+    QueryStateToJson(log_entry, &record_json, document);
+    completed_queries.PushBack(record_json, document->GetAllocator());
   }
   document->AddMember("completed_queries", completed_queries, document->GetAllocator());
   document->AddMember("completed_log_size", FLAGS_query_log_size,
       document->GetAllocator());
 
-  Value query_locations(kArrayType);
+  vector<pair<TNetworkAddress, uint64_t>> location_counts;
   {
     lock_guard<mutex> l(server_->query_locations_lock_);
     for (const ImpalaServer::QueryLocations::value_type& location:
          server_->query_locations_) {
-      Value location_json(kObjectType);
-      Value location_name(lexical_cast<string>(location.first).c_str(),
-          document->GetAllocator());
-      location_json.AddMember("location", location_name, document->GetAllocator());
-      location_json.AddMember("count", static_cast<uint64_t>(location.second.size()),
-          document->GetAllocator());
-      query_locations.PushBack(location_json, document->GetAllocator());
+      location_counts.push_back(make_pair(location.first, location.second.size()));
     }
   }
+  Value query_locations(kArrayType);
+  for (const pair<TNetworkAddress, uint64_t>& location: location_counts) {
+    Value location_json(kObjectType);
+    Value location_name(lexical_cast<string>(location.first).c_str(),
+        document->GetAllocator());
+    location_json.AddMember("location", location_name, document->GetAllocator());
+    location_json.AddMember("count", location.second, document->GetAllocator());
+    query_locations.PushBack(location_json, document->GetAllocator());
+  }
   document->AddMember("query_locations", query_locations, document->GetAllocator());
 }
 
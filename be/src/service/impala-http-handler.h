@@ -40,6 +40,10 @@ class ImpalaHttpHandler {
   void HadoopVarzHandler(const Webserver::ArgumentMap& args,
       rapidjson::Document* document);
 
+  /// Json callback for /io_mgr. Produces 'title' and 'contents' members, the latter with
+  /// the disk usage of each request pool followed by the IoMgr's internal state.
+  void IoMgrHandler(const Webserver::ArgumentMap& args, rapidjson::Document* document);
+
   /// Returns two sorted lists of queries, one in-flight and one completed, as well as a
   /// list of active backends and their plan-fragment count.
   //
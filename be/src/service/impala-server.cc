@@ -54,7 +54,9 @@
 #include "service/fragment-exec-state.h"
 #include "service/impala-internal-service.h"
 #include "service/impala-http-handler.h"
+#include "service/plan-cache.h"
 #include "service/query-exec-state.h"
+#include "service/query-result-cache.h"
 #include "scheduling/simple-scheduler.h"
 #include "util/bit-util.h"
 #include "util/cgroups-mgr.h"
@@ -143,9 +145,30 @@ DEFINE_int32(max_profile_log_file_size, 5000, "The maximum size (in queries) of
 DEFINE_int32(max_profile_log_files, 10, "Maximum number of profile log files to "
     "retain. The most recent log files are retained. If set to 0, all log files "
     "are retained.");
+DEFINE_int32(log_writer_queue_size, 1000, "(Advanced) Maximum number of audit, lineage "
+    "and profile log entries that are queued for a background thread to write in "
+    "batches. If 0, the entries are written by the threads that log them.");
+DEFINE_bool(drop_profile_log_entries_when_full, true, "(Advanced) If true, profile log "
+    "entries are dropped instead of waiting while the queue of --log_writer_queue_size "
+    "entries is full. Audit and lineage entries are never dropped.");
 
 DEFINE_int32(cancellation_thread_pool_size, 5,
     "(Advanced) Size of the thread-pool processing cancellations due to node failure");
+DEFINE_int32(backend_client_prewarm_connections, 0, "(Advanced) The number of "
+    "connections that are opened in the background to a backend when it joins the "
+    "cluster, so that the first queries that run on it do not have to wait for them "
+    "to be opened and authenticated. If 0, connections are only opened when needed.");
+DEFINE_int64(query_result_cache_size, 0, "(Advanced) The maximum total size in bytes "
+    "of the results of read-only queries that are cached on this coordinator and served "
+    "to HiveServer2 clients that submit the same statement again. Cached results are "
+    "invalidated when one of their tables changes. If 0, results are not cached.");
+DEFINE_int64(query_result_cache_max_entry_size, 10L * 1024L * 1024L, "(Advanced) The "
+    "maximum size in bytes of the results of a single query in the query result cache.");
+DEFINE_int32(plan_cache_size, 0, "(Advanced) The maximum number of query plans that are "
+    "cached on this coordinator, so that queries that are submitted again with the same "
+    "statement, database, user and query options skip analysis and planning. Cached "
+    "plans are invalidated when the tables they read change. If 0, plans are not "
+    "cached.");
 
 DEFINE_string(ssl_server_certificate, "", "The full path to the SSL certificate file used"
     " to authenticate Impala to clients. If set, both Beeswax and HiveServer2 ports will "
@@ -178,6 +201,7 @@ DEFINE_string(local_nodemanager_url, "", "The URL of the local Yarn Node Manager
     "interface, used to detect if the Node Manager fails");
 DECLARE_bool(enable_rm);
 DECLARE_bool(compact_catalog_topic);
+DECLARE_bool(compress_catalog_topic);
 
 namespace impala {
 
@@ -194,6 +218,10 @@ const string AUDIT_EVENT_LOG_FILE_PREFIX = "impala_audit_event_log_1.0-";
 const string LINEAGE_LOG_FILE_PREFIX = "impala_lineage_log_1.0-";
 
 const uint32_t MAX_CANCELLATION_QUEUE_SIZE = 65536;
+// Connections to new backends are opened by this many threads. Backends that join while
+// the queue is full are not prewarmed.
+const uint32_t CLIENT_PREWARM_THREAD_POOL_SIZE = 4;
+const uint32_t MAX_CLIENT_PREWARM_QUEUE_SIZE = 65536;
 // Max size for multiple update in a single split. JNI is not able to write java byte
 // array more than 2GB. A single topic update is not restricted by this.
 const uint64_t MAX_CATALOG_UPDATE_BATCH_SIZE_BYTES = 500 * 1024 * 1024;
@@ -326,6 +354,21 @@ ImpalaServer::ImpalaServer(ExecEnv* exec_env)
 
   ABORT_IF_ERROR(ExternalDataSourceExecutor::InitJNI(exec_env->metrics()));
 
+  if (FLAGS_backend_client_prewarm_connections > 0) {
+    client_prewarm_thread_pool_.reset(new ThreadPool<TNetworkAddress>(
+        "impala-server", "client-prewarm-worker", CLIENT_PREWARM_THREAD_POOL_SIZE,
+        MAX_CLIENT_PREWARM_QUEUE_SIZE,
+        bind<void>(&ImpalaServer::PrewarmBackendClients, this, _1, _2)));
+  }
+
+  if (FLAGS_query_result_cache_size > 0) {
+    query_result_cache_.reset(new QueryResultCache(FLAGS_query_result_cache_size,
+        FLAGS_query_result_cache_max_entry_size, exec_env->metrics()));
+  }
+  if (FLAGS_plan_cache_size > 0) {
+    plan_cache_.reset(new PlanCache(FLAGS_plan_cache_size, exec_env->metrics()));
+  }
+
   // Register the membership callback if required
   if (exec_env->subscriber() != NULL) {
     StatestoreSubscriber::UpdateCallback cb =
@@ -410,6 +453,9 @@ Status ImpalaServer::InitLineageLogging() {
   lineage_logger_.reset(new SimpleLogger(FLAGS_lineage_event_log_dir,
       LINEAGE_LOG_FILE_PREFIX, FLAGS_max_lineage_log_file_size));
   RETURN_IF_ERROR(lineage_logger_->Init());
+  if (FLAGS_log_writer_queue_size > 0) {
+    RETURN_IF_ERROR(lineage_logger_->StartAsyncWriter(FLAGS_log_writer_queue_size, true));
+  }
   lineage_logger_flush_thread_.reset(new Thread("impala-server",
         "lineage-log-flush", &ImpalaServer::LineageLoggerFlushThread, this));
   return Status::OK();
@@ -502,6 +548,10 @@ Status ImpalaServer::InitAuditEventLogging() {
   audit_event_logger_.reset(new SimpleLogger(FLAGS_audit_event_log_dir,
      AUDIT_EVENT_LOG_FILE_PREFIX, FLAGS_max_audit_event_log_file_size));
   RETURN_IF_ERROR(audit_event_logger_->Init());
+  if (FLAGS_log_writer_queue_size > 0) {
+    RETURN_IF_ERROR(
+        audit_event_logger_->StartAsyncWriter(FLAGS_log_writer_queue_size, true));
+  }
   audit_event_logger_flush_thread_.reset(new Thread("impala-server",
         "audit-event-log-flush", &ImpalaServer::AuditEventLoggerFlushThread, this));
   return Status::OK();
@@ -560,6 +610,10 @@ Status ImpalaServer::InitProfileLogging() {
       PROFILE_LOG_FILE_PREFIX, FLAGS_max_profile_log_file_size,
       FLAGS_max_profile_log_files));
   RETURN_IF_ERROR(profile_logger_->Init());
+  if (FLAGS_log_writer_queue_size > 0) {
+    RETURN_IF_ERROR(profile_logger_->StartAsyncWriter(FLAGS_log_writer_queue_size,
+        FLAGS_drop_profile_log_entries_when_full));
+  }
   profile_log_file_flush_thread_.reset(new Thread("impala-server", "log-flush-thread",
       &ImpalaServer::LogFileFlushThread, this));
 
@@ -569,15 +623,17 @@ Status ImpalaServer::InitProfileLogging() {
 Status ImpalaServer::GetRuntimeProfileStr(const TUniqueId& query_id,
     bool base64_encoded, stringstream* output) {
   DCHECK(output != NULL);
-  // Search for the query id in the active query map
+  // Search for the query id in the active query map. The profile is rendered after
+  // query_exec_state_map_lock_ is released, since large profiles take a while and
+  // queries wait for that lock to start and finish. The shared_ptr keeps the exec state
+  // alive, and RuntimeProfile serializes its own readers and writers.
   {
-    lock_guard<mutex> l(query_exec_state_map_lock_);
-    QueryExecStateMap::const_iterator exec_state = query_exec_state_map_.find(query_id);
-    if (exec_state != query_exec_state_map_.end()) {
+    shared_ptr<QueryExecState> exec_state = GetQueryExecState(query_id, false);
+    if (exec_state != NULL) {
       if (base64_encoded) {
-        exec_state->second->profile().SerializeToArchiveString(output);
+        exec_state->profile().SerializeToArchiveString(output);
       } else {
-        exec_state->second->profile().PrettyPrint(output);
+        exec_state->profile().PrettyPrint(output);
       }
       return Status::OK();
     }
@@ -808,11 +864,36 @@ Status ImpalaServer::ExecuteInternal(
     RETURN_IF_ERROR(RegisterQuery(session_state, *exec_state));
     *registered_exec_state = true;
 
-    RETURN_IF_ERROR((*exec_state)->UpdateQueryStatus(
-        exec_env_->frontend()->GetExecRequest(query_ctx, &result)));
-    (*exec_state)->query_events()->MarkEvent("Planning finished");
-    (*exec_state)->summary_profile()->AddEventSequence(
-        result.timeline.name, result.timeline);
+    // Child queries are not looked up, they are rarely repeated.
+    string plan_cache_key;
+    bool use_plan_cache = plan_cache_.get() != NULL &&
+        !query_ctx.__isset.parent_query_id &&
+        QueryResultCache::GetStatementKey(query_ctx, &plan_cache_key);
+    shared_ptr<const TExecRequest> cached_request;
+    int64_t plan_cache_generation = 0;
+    if (use_plan_cache) {
+      plan_cache_generation = plan_cache_->generation();
+      cached_request = plan_cache_->Lookup(plan_cache_key);
+    }
+    if (cached_request.get() != NULL) {
+      result = *cached_request;
+      PlanCache::BindQueryCtx(query_ctx, &result);
+      (*exec_state)->summary_profile()->AddInfoString("Plan Cache", "Hit");
+      (*exec_state)->query_events()->MarkEvent("Planning finished (cached plan)");
+    } else {
+      RETURN_IF_ERROR((*exec_state)->UpdateQueryStatus(
+          exec_env_->frontend()->GetExecRequest(query_ctx, &result)));
+      (*exec_state)->query_events()->MarkEvent("Planning finished");
+      (*exec_state)->summary_profile()->AddEventSequence(
+          result.timeline.name, result.timeline);
+      // The lineage graph identifies the query it was created for.
+      vector<string> tables;
+      if (use_plan_cache && !result.__isset.lineage_graph &&
+          QueryResultCache::GetTables(result, &tables)) {
+        plan_cache_->Insert(plan_cache_key, tables, plan_cache_generation,
+            shared_ptr<const TExecRequest>(new TExecRequest(result)));
+      }
+    }
     if (result.__isset.result_set_metadata) {
       (*exec_state)->set_result_metadata(result.result_set_metadata);
     }
@@ -1125,14 +1206,17 @@ void ImpalaServer::TransmitData(
   // TODO: fix Thrift so we can simply take ownership of thrift_batch instead
   // of having to copy its data
   if (params.row_batch.num_rows > 0) {
+    bool recvr_closed = false;
     Status status = exec_env_->stream_mgr()->AddData(
         params.dest_fragment_instance_id, params.dest_node_id, params.row_batch,
-        params.sender_id);
+        params.sender_id, &recvr_closed);
     status.SetTStatus(&return_val);
     if (!status.ok()) {
       // should we close the channel here as well?
       return;
     }
+    // Tell the sender that it can stop sending, unless this is its last batch anyway.
+    if (recvr_closed && !params.eos) DataStreamMgr::SetRecvrClosed(&return_val.status);
   }
 
   if (params.eos) {
@@ -1254,11 +1338,21 @@ void ImpalaServer::CatalogUpdateCallback(
     // new catalog version will be.
     int64_t new_catalog_version = catalog_update_info_.catalog_version;
     uint64_t batch_size_bytes = 0;
+    string decompressed_value;
     for (const TTopicItem& item: delta.topic_entries) {
-      uint32_t len = item.value.size();
+      const string* value = &item.value;
+      if (FLAGS_compress_catalog_topic) {
+        Status status = DecompressCatalogObject(item.value, &decompressed_value);
+        if (!status.ok()) {
+          LOG(ERROR) << "Error decompressing item: " << status.GetDetail();
+          continue;
+        }
+        value = &decompressed_value;
+      }
+      uint32_t len = value->size();
       TCatalogObject catalog_object;
       Status status = DeserializeThriftMsg(reinterpret_cast<const uint8_t*>(
-          item.value.data()), &len, FLAGS_compact_catalog_topic, &catalog_object);
+          value->data()), &len, FLAGS_compact_catalog_topic, &catalog_object);
       if (!status.ok()) {
         LOG(ERROR) << "Error deserializing item: " << status.GetDetail();
         continue;
@@ -1337,6 +1431,18 @@ void ImpalaServer::CatalogUpdateCallback(
     // Call the FE to apply the changes to the Impalad Catalog.
     TUpdateCatalogCacheResponse resp;
     Status s = exec_env_->frontend()->UpdateCatalogCache(update_reqs, &resp);
+    // Invalidate cached results only after the catalog changed, so that no query that
+    // was planned with the old metadata can insert its results afterwards.
+    if (query_result_cache_.get() != NULL) {
+      for (const TUpdateCatalogCacheRequest& req: update_reqs) {
+        query_result_cache_->Invalidate(req);
+      }
+    }
+    if (plan_cache_.get() != NULL) {
+      for (const TUpdateCatalogCacheRequest& req: update_reqs) {
+        plan_cache_->Invalidate(req);
+      }
+    }
     if (!s.ok()) {
       LOG(ERROR) << "There was an error processing the impalad catalog update. Requesting"
                  << " a full topic update to recover: " << s.GetDetail();
@@ -1433,6 +1539,8 @@ Status ImpalaServer::ProcessCatalogUpdateResult(
     TUpdateCatalogCacheResponse resp;
     Status status = exec_env_->frontend()->UpdateCatalogCache(
         vector<TUpdateCatalogCacheRequest>{update_req}, &resp);
+    if (query_result_cache_.get() != NULL) query_result_cache_->Invalidate(update_req);
+    if (plan_cache_.get() != NULL) plan_cache_->Invalidate(update_req);
     if (!status.ok()) LOG(ERROR) << status.GetDetail();
     RETURN_IF_ERROR(status);
     if (!wait_for_all_subscribers) return Status::OK();
@@ -1468,6 +1576,16 @@ Status ImpalaServer::ProcessCatalogUpdateResult(
   return Status::OK();
 }
 
+void ImpalaServer::PrewarmBackendClients(uint32_t thread_id,
+    const TNetworkAddress& address) {
+  Status status = exec_env_->impalad_client_cache()->PrewarmClients(address,
+      FLAGS_backend_client_prewarm_connections);
+  if (!status.ok()) {
+    VLOG_QUERY << "Could not open connections to new backend " << address << ": "
+               << status.GetDetail();
+  }
+}
+
 void ImpalaServer::MembershipCallback(
     const StatestoreSubscriber::TopicDeltaMap& incoming_topic_deltas,
     vector<TTopicDelta>* subscriber_topic_updates) {
@@ -1493,7 +1611,12 @@ void ImpalaServer::MembershipCallback(
         continue;
       }
       // This is a new item - add it to the map of known backends.
-      known_backends_.insert(make_pair(item.key, backend_descriptor));
+      bool is_new_backend =
+          known_backends_.insert(make_pair(item.key, backend_descriptor)).second;
+      if (is_new_backend && client_prewarm_thread_pool_.get() != NULL &&
+          backend_descriptor.address != exec_env_->backend_address()) {
+        client_prewarm_thread_pool_->Offer(backend_descriptor.address);
+      }
     }
     // Process membership deletions.
     for (const string& backend_id: delta.topic_deletions) {
@@ -1521,6 +1644,8 @@ void ImpalaServer::MembershipCallback(
         LOG(WARNING) << "Error updating frontend membership snapshot: "
                      << status.GetDetail();
       }
+      // The planner takes the number of nodes into account.
+      if (plan_cache_.get() != NULL) plan_cache_->Clear();
     }
 
     // Maps from query id (to be cancelled) to a list of failed Impalads that are
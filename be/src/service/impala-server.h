@@ -46,10 +46,14 @@
 namespace impala {
 
 class ExecEnv;
+class ExprContext;
 class DataSink;
 class CancellationWork;
 class Coordinator;
 class ImpalaHttpHandler;
+class PlanCache;
+class QueryResultCache;
+class RowBatch;
 class RowDescriptor;
 class TCatalogUpdate;
 class TPlanExecRequest;
@@ -247,6 +251,9 @@ class ImpalaServer : public ImpalaServiceIf, public ImpalaHiveServer2ServiceIf,
   /// Returns true if lineage logging is enabled, false otherwise.
   bool IsLineageLoggingEnabled();
 
+  /// Returns the cache of query results, or NULL if --query_result_cache_size is 0.
+  QueryResultCache* query_result_cache() { return query_result_cache_.get(); }
+
  private:
   friend class ChildQuery;
   friend class ImpalaHttpHandler;
@@ -272,6 +279,12 @@ class ImpalaServer : public ImpalaServiceIf, public ImpalaHiveServer2ServiceIf,
     /// operation, the row in the form of TResultRow.
     virtual Status AddOneRow(const TResultRow& row) = 0;
 
+    /// Adds the rows [start_idx, start_idx + num_rows) of 'batch' from a select query,
+    /// evaluating 'expr_ctxs' over them. The default implementation evaluates one row
+    /// at a time and adds it with AddOneRow().
+    virtual Status AddRowBatch(const std::vector<ExprContext*>& expr_ctxs,
+        RowBatch* batch, int start_idx, int num_rows);
+
     /// Copies rows in the range [start_idx, start_idx + num_rows) from the other result
     /// set into this result set. Returns the number of rows added to this result set.
     /// Returns 0 if the given range is out of bounds of the other result set.
@@ -592,6 +605,10 @@ class ImpalaServer : public ImpalaServiceIf, public ImpalaHiveServer2ServiceIf,
   void CancelFromThreadPool(uint32_t thread_id,
       const CancellationWork& cancellation_work);
 
+  /// Opens --backend_client_prewarm_connections connections to the backend at 'address',
+  /// which just joined the cluster. Called from client_prewarm_thread_pool_.
+  void PrewarmBackendClients(uint32_t thread_id, const TNetworkAddress& address);
+
   /// Helper method to add any pool query options to the query_ctx. Must be called before
   /// ExecuteInternal() at which point the TQueryCtx is const and cannot be mutated.
   /// override_options_mask indicates which query options can be overridden by the pool
@@ -679,6 +696,19 @@ class ImpalaServer : public ImpalaServiceIf, public ImpalaHiveServer2ServiceIf,
   /// avoid blocking the statestore callback.
   boost::scoped_ptr<ThreadPool<CancellationWork> > cancellation_thread_pool_;
 
+  /// Thread pool that opens connections to backends that join the cluster, so that the
+  /// statestore callback is not blocked by it. NULL if
+  /// --backend_client_prewarm_connections is 0.
+  boost::scoped_ptr<ThreadPool<TNetworkAddress> > client_prewarm_thread_pool_;
+
+  /// Results of read-only queries that are served to HiveServer2 clients without
+  /// executing the query again. NULL if --query_result_cache_size is 0.
+  boost::scoped_ptr<QueryResultCache> query_result_cache_;
+
+  /// Plans of queries that are reused when the same statement is submitted again. NULL if
+  /// --plan_cache_size is 0.
+  boost::scoped_ptr<PlanCache> plan_cache_;
+
   /// Thread that runs ExpireSessions. It will wake up periodically to check for sessions
   /// which are idle for more their timeout values.
   boost::scoped_ptr<Thread> session_timeout_thread_;
@@ -29,6 +29,7 @@
 #include "common/status.h"
 #include "runtime/coordinator.h"
 #include "runtime/exec-env.h"
+#include "util/cpu-sampler.h"
 #include "util/jni-util.h"
 #include "util/network-util.h"
 #include "rpc/thrift-util.h"
@@ -66,6 +67,7 @@ int ImpaladMain(int argc, char** argv) {
   // start backend service for the coordinator on be_port
   ExecEnv exec_env;
   StartThreadInstrumentation(exec_env.metrics(), exec_env.webserver());
+  ABORT_IF_ERROR(CpuSampler::Start(exec_env.webserver()));
   InitRpcEventTracing(exec_env.webserver());
 
   ThriftServer* beeswax_server = NULL;
@@ -0,0 +1,138 @@
+// Copyright 2016 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "service/plan-cache.h"
+
+#include <algorithm>
+#include <boost/algorithm/string.hpp>
+
+#include "common/logging.h"
+
+#include "common/names.h"
+
+using boost::algorithm::to_lower_copy;
+
+namespace impala {
+
+PlanCache::PlanCache(int capacity, MetricGroup* metrics)
+  : capacity_(capacity),
+    generation_(0),
+    clear_generation_(0) {
+  hits_metric_ = metrics->RegisterMetric(new IntCounter(MakeTMetricDef(
+      "impala-server.plan-cache.hits", TMetricKind::COUNTER, TUnit::UNIT), 0));
+  misses_metric_ = metrics->RegisterMetric(new IntCounter(MakeTMetricDef(
+      "impala-server.plan-cache.misses", TMetricKind::COUNTER, TUnit::UNIT), 0));
+  num_entries_metric_ = metrics->RegisterMetric(new IntGauge(MakeTMetricDef(
+      "impala-server.plan-cache.num-entries", TMetricKind::GAUGE, TUnit::UNIT), 0));
+}
+
+shared_ptr<const TExecRequest> PlanCache::Lookup(const string& key) {
+  lock_guard<mutex> l(lock_);
+  unordered_map<string, EntryList::iterator>::iterator it = entries_.find(key);
+  if (it == entries_.end()) {
+    misses_metric_->Increment(1);
+    return shared_ptr<const TExecRequest>();
+  }
+  hits_metric_->Increment(1);
+  lru_list_.splice(lru_list_.begin(), lru_list_, it->second);
+  return it->second->request;
+}
+
+int64_t PlanCache::generation() {
+  lock_guard<mutex> l(lock_);
+  return generation_;
+}
+
+void PlanCache::Insert(const string& key, const vector<string>& tables,
+    int64_t generation, const shared_ptr<const TExecRequest>& request) {
+  lock_guard<mutex> l(lock_);
+  if (clear_generation_ > generation) return;
+  for (const string& table: tables) {
+    unordered_map<string, int64_t>::const_iterator it = table_generations_.find(table);
+    if (it != table_generations_.end() && it->second > generation) return;
+  }
+
+  unordered_map<string, EntryList::iterator>::iterator existing = entries_.find(key);
+  if (existing != entries_.end()) EraseLocked(existing->second);
+  while (!lru_list_.empty() && lru_list_.size() >= static_cast<size_t>(capacity_)) {
+    EraseLocked(--lru_list_.end());
+  }
+  Entry entry;
+  entry.key = key;
+  entry.tables = tables;
+  entry.request = request;
+  lru_list_.push_front(entry);
+  entries_[key] = lru_list_.begin();
+  num_entries_metric_->Increment(1);
+}
+
+void PlanCache::Invalidate(const TUpdateCatalogCacheRequest& req) {
+  lock_guard<mutex> l(lock_);
+  if (!req.is_delta) {
+    ClearLocked();
+    return;
+  }
+  vector<const TCatalogObject*> objects;
+  for (const TCatalogObject& object: req.updated_objects) objects.push_back(&object);
+  for (const TCatalogObject& object: req.removed_objects) objects.push_back(&object);
+  for (const TCatalogObject* object: objects) {
+    // The catalog version is part of every update and does not affect plans.
+    if (object->type == TCatalogObjectType::CATALOG) continue;
+    if (object->type != TCatalogObjectType::TABLE) {
+      ClearLocked();
+      return;
+    }
+    const string table =
+        to_lower_copy(object->table.db_name + "." + object->table.tbl_name);
+    table_generations_[table] = ++generation_;
+    EntryList::iterator it = lru_list_.begin();
+    while (it != lru_list_.end()) {
+      EntryList::iterator entry = it++;
+      if (find(entry->tables.begin(), entry->tables.end(), table) !=
+          entry->tables.end()) {
+        EraseLocked(entry);
+      }
+    }
+  }
+}
+
+void PlanCache::Clear() {
+  lock_guard<mutex> l(lock_);
+  ClearLocked();
+}
+
+void PlanCache::BindQueryCtx(const TQueryCtx& query_ctx, TExecRequest* request) {
+  DCHECK(request->__isset.query_exec_request);
+  TQueryCtx* cached_ctx = &request->query_exec_request.query_ctx;
+  cached_ctx->request = query_ctx.request;
+  cached_ctx->session = query_ctx.session;
+  cached_ctx->query_id = query_ctx.query_id;
+  cached_ctx->__set_now_string(query_ctx.now_string);
+  cached_ctx->__set_pid(query_ctx.pid);
+  cached_ctx->__set_coord_address(query_ctx.coord_address);
+}
+
+void PlanCache::ClearLocked() {
+  clear_generation_ = ++generation_;
+  table_generations_.clear();
+  while (!lru_list_.empty()) EraseLocked(lru_list_.begin());
+}
+
+void PlanCache::EraseLocked(EntryList::iterator it) {
+  num_entries_metric_->Increment(-1);
+  entries_.erase(it->key);
+  lru_list_.erase(it);
+}
+
+}
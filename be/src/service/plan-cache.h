@@ -0,0 +1,120 @@
+// Copyright 2016 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef IMPALA_SERVICE_PLAN_CACHE_H
+#define IMPALA_SERVICE_PLAN_CACHE_H
+
+#include <list>
+#include <string>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/unordered_map.hpp>
+
+#include "util/metrics.h"
+
+#include "gen-cpp/Frontend_types.h"
+#include "gen-cpp/ImpalaInternalService_types.h"
+
+namespace impala {
+
+/// Caches the TExecRequests that the frontend returns for queries, so that queries that
+/// are submitted again are not analyzed and planned again. Enabled with
+/// --plan_cache_size.
+///
+/// Requests are cached under the same statement key as in the QueryResultCache, i.e.
+/// the statement text with runs of whitespace collapsed, the session's database and user
+/// and the query options, and only for queries that read HDFS tables and do not call
+/// non-deterministic functions. The cached request is bound to a new query with
+/// BindQueryCtx().
+///
+/// Requests are invalidated when a catalog update changes or drops one of the tables
+/// they read. All requests are invalidated by updates to other catalog objects, e.g.
+/// views, functions or privileges, and by changes of the cluster membership, which the
+/// planner takes into account. The requests that were used least recently are evicted
+/// once the cache holds more than its capacity.
+///
+/// This class is thread-safe.
+class PlanCache {
+ public:
+  /// 'capacity' is the maximum number of cached requests.
+  PlanCache(int capacity, MetricGroup* metrics);
+
+  /// Returns the cached request for 'key' and marks it as recently used. Returns NULL if
+  /// there is none.
+  boost::shared_ptr<const TExecRequest> Lookup(const std::string& key);
+
+  /// Returns the current generation of the cache. It is passed to Insert() to detect
+  /// invalidations that happened while the request was planned.
+  int64_t generation();
+
+  /// Adds 'request', which was planned for the query with 'key' and reads 'tables', to
+  /// the cache. 'generation' is the value that generation() returned before planning
+  /// started. The request is dropped if one of 'tables' was invalidated since then.
+  void Insert(const std::string& key, const std::vector<std::string>& tables,
+      int64_t generation, const boost::shared_ptr<const TExecRequest>& request);
+
+  /// Invalidates the requests that read tables that the catalog update 'req' changes or
+  /// removes, or all requests if it changes other catalog objects.
+  void Invalidate(const TUpdateCatalogCacheRequest& req);
+
+  /// Invalidates all requests.
+  void Clear();
+
+  /// Replaces the parts of the query context of the cached 'request' that identify the
+  /// query that it was planned for with those of 'query_ctx'.
+  static void BindQueryCtx(const TQueryCtx& query_ctx, TExecRequest* request);
+
+ private:
+  struct Entry {
+    std::string key;
+    std::vector<std::string> tables;
+    boost::shared_ptr<const TExecRequest> request;
+  };
+  typedef std::list<Entry> EntryList;
+
+  const int capacity_;
+
+  /// Protects all members below.
+  boost::mutex lock_;
+
+  /// All entries, the most recently used one first.
+  EntryList lru_list_;
+
+  /// Map from key to the entry in lru_list_.
+  boost::unordered_map<std::string, EntryList::iterator> entries_;
+
+  /// Incremented by every invalidation.
+  int64_t generation_;
+
+  /// Generation of the last invalidation of all entries, and of the last invalidation
+  /// of every table that was invalidated since then.
+  int64_t clear_generation_;
+  boost::unordered_map<std::string, int64_t> table_generations_;
+
+  /// Metrics for the lookups and the number of cached requests.
+  IntCounter* hits_metric_;
+  IntCounter* misses_metric_;
+  IntGauge* num_entries_metric_;
+
+  /// Invalidates all entries. Caller must hold lock_.
+  void ClearLocked();
+
+  /// Removes the entry 'it' from the cache. Caller must hold lock_.
+  void EraseLocked(EntryList::iterator it);
+};
+
+}
+
+#endif
@@ -25,9 +25,11 @@
 #include "service/impala-server.h"
 #include "service/frontend.h"
 #include "service/query-options.h"
+#include "service/query-result-cache.h"
 #include "util/debug-util.h"
 #include "util/impalad-metrics.h"
 #include "util/runtime-profile-counters.h"
+#include "util/thread.h"
 #include "util/time.h"
 
 #include "gen-cpp/CatalogService.h"
@@ -48,6 +50,15 @@ DECLARE_string(catalog_service_host);
 DECLARE_bool(enable_rm);
 DECLARE_int64(max_result_cache_size);
 
+DEFINE_int64(result_spooling_max_bytes, 0, "(Advanced) If > 0, the rows of a query are "
+    "fetched from the coordinator in the background as soon as they are produced, and "
+    "up to this many bytes of them are buffered until the client fetches them. This "
+    "keeps slow clients from stalling query execution. If 0, rows are only produced "
+    "when the client fetches them.");
+DEFINE_bool(compute_stats_concurrent_child_queries, true, "If true, the table stats and "
+    "column stats child queries of COMPUTE [INCREMENTAL] STATS run at the same time "
+    "instead of one after the other.");
+
 namespace impala {
 
 // Keys into the info string map of the runtime profile referring to specific
@@ -80,8 +91,14 @@ ImpalaServer::QueryExecState::QueryExecState(
     fetched_rows_(false),
     frontend_(frontend),
     parent_server_(server),
-    start_time_(TimestampValue::LocalTime()) {
+    start_time_(TimestampValue::LocalTime()),
+    spooled_bytes_(0),
+    spooling_done_(false),
+    spooling_cancelled_(false),
+    result_cache_generation_(0),
+    rows_to_cache_bytes_(0) {
   row_materialization_timer_ = ADD_TIMER(&server_profile_, "RowMaterializationTimer");
+  rows_spooled_counter_ = ADD_COUNTER(&server_profile_, "RowsSpooled", TUnit::UNIT);
   client_wait_timer_ = ADD_TIMER(&server_profile_, "ClientFetchWaitTimer");
   query_events_ = summary_profile_.AddEventSequence("Query Timeline");
   query_events_->Start();
@@ -113,6 +130,7 @@ ImpalaServer::QueryExecState::QueryExecState(
 
 ImpalaServer::QueryExecState::~QueryExecState() {
   DCHECK(wait_thread_.get() == NULL) << "BlockOnWait() needs to be called!";
+  DCHECK(spooling_thread_.get() == NULL) << "Done() needs to be called!";
 }
 
 Status ImpalaServer::QueryExecState::SetResultCache(QueryResultSet* cache,
@@ -143,6 +161,9 @@ Status ImpalaServer::QueryExecState::Exec(TExecRequest* exec_request) {
     case TStmtType::QUERY:
     case TStmtType::DML:
       DCHECK(exec_request_.__isset.query_exec_request);
+      if (exec_request->stmt_type == TStmtType::QUERY && ServeFromResultCache()) {
+        return Status::OK();
+      }
       return ExecQueryOrDmlRequest(exec_request_.query_exec_request);
     case TStmtType::EXPLAIN: {
       request_result_set_.reset(new vector<TResultRow>(
@@ -533,6 +554,7 @@ void ImpalaServer::QueryExecState::Done() {
   // Make sure we join on wait_thread_ before we finish (and especially before this object
   // is destroyed).
   BlockOnWait();
+  StopResultSpooling();
   unique_lock<mutex> l(lock_);
   end_time_ = TimestampValue::LocalTime();
   summary_profile_.AddInfoString("End Time", end_time().DebugString());
@@ -632,6 +654,10 @@ Status ImpalaServer::QueryExecState::WaitInternal() {
     // Queries that do not return a result are finished at this point. This includes
     // DML operations and a subset of the DDL operations.
     eos_ = true;
+  } else if (coord_.get() != NULL && exec_request_.stmt_type == TStmtType::QUERY &&
+      FLAGS_result_spooling_max_bytes > 0) {
+    spooling_thread_.reset(new Thread("query-exec-state", "result-spooler",
+        &ImpalaServer::QueryExecState::SpoolResults, this));
   } else if (catalog_op_type() == TCatalogOpType::DDL &&
       ddl_type() == TDdlType::CREATE_TABLE_AS_SELECT) {
     SetCreateTableAsSelectResultSet();
@@ -722,14 +748,6 @@ Status ImpalaServer::QueryExecState::FetchRowsInternal(const int32_t max_rows,
     if (num_rows_fetched_from_cache >= max_rows) return Status::OK();
   }
 
-  // List of expr values to hold evaluated rows from the query
-  vector<void*> result_row;
-  result_row.resize(output_expr_ctxs_.size());
-
-  // List of scales for floating point values in result_row
-  vector<int> scales;
-  scales.resize(result_row.size());
-
   if (coord_ == NULL) {
     // Query with LIMIT 0.
     query_state_ = QueryState::FINISHED;
@@ -757,13 +775,13 @@ Status ImpalaServer::QueryExecState::FetchRowsInternal(const int32_t max_rows,
     int fetched_count = available;
     // max_coord_rows <= 0 means no limit
     if (max_coord_rows > 0 && max_coord_rows < available) fetched_count = max_coord_rows;
-    for (int i = 0; i < fetched_count; ++i) {
-      TupleRow* row = current_batch_->GetRow(current_batch_row_);
-      RETURN_IF_ERROR(GetRowValue(row, &result_row, &scales));
-      RETURN_IF_ERROR(fetched_rows->AddOneRow(result_row, scales));
-      ++num_rows_fetched_;
-      ++current_batch_row_;
+    RETURN_IF_ERROR(fetched_rows->AddRowBatch(output_expr_ctxs_, current_batch_,
+        current_batch_row_, fetched_count));
+    if (rows_to_cache_.get() != NULL) {
+      CaptureRowsToCache(current_batch_row_, fetched_count);
     }
+    num_rows_fetched_ += fetched_count;
+    current_batch_row_ += fetched_count;
   }
   ExprContext::FreeLocalAllocations(output_expr_ctxs_);
   // Check if there was an error evaluating a row value.
@@ -826,12 +844,20 @@ Status ImpalaServer::QueryExecState::FetchRowsInternal(const int32_t max_rows,
   return Status::OK();
 }
 
-Status ImpalaServer::QueryExecState::GetRowValue(TupleRow* row, vector<void*>* result,
-                                                 vector<int>* scales) {
-  DCHECK(result->size() >= output_expr_ctxs_.size());
-  for (int i = 0; i < output_expr_ctxs_.size(); ++i) {
-    (*result)[i] = output_expr_ctxs_[i]->GetValue(row);
-    (*scales)[i] = output_expr_ctxs_[i]->root()->output_scale();
+Status ImpalaServer::QueryResultSet::AddRowBatch(const vector<ExprContext*>& expr_ctxs,
+    RowBatch* batch, int start_idx, int num_rows) {
+  // List of expr values and their scales (# of digits after decimal) of one row
+  vector<void*> result_row(expr_ctxs.size());
+  vector<int> scales(expr_ctxs.size());
+  for (int i = 0; i < expr_ctxs.size(); ++i) {
+    scales[i] = expr_ctxs[i]->root()->output_scale();
+  }
+  for (int i = start_idx; i < start_idx + num_rows; ++i) {
+    TupleRow* row = batch->GetRow(i);
+    for (int j = 0; j < expr_ctxs.size(); ++j) {
+      result_row[j] = expr_ctxs[j]->GetValue(row);
+    }
+    RETURN_IF_ERROR(AddOneRow(result_row, scales));
   }
   return Status::OK();
 }
@@ -843,6 +869,12 @@ void ImpalaServer::QueryExecState::Cancel(const Status* cause) {
   }
 
   // If the query is completed or cancelled, no need to cancel.
+  if (spooling_thread_.get() != NULL) {
+    lock_guard<mutex> l(spool_lock_);
+    spooling_cancelled_ = true;
+    spool_cv_.notify_all();
+  }
+
   if (eos_ || query_state_ == QueryState::EXCEPTION) return;
 
   if (cause != NULL) {
@@ -906,15 +938,100 @@ Status ImpalaServer::QueryExecState::UpdateCatalog() {
   return Status::OK();
 }
 
+// Returns the memory that 'batch', a copy made by SpoolResults(), takes up.
+static int64_t SpooledBatchBytes(RowBatch* batch) {
+  return batch->tuple_data_pool()->total_allocated_bytes();
+}
+
+void ImpalaServer::QueryExecState::SpoolResults() {
+  Status status;
+  while (true) {
+    RowBatch* batch;
+    status = coord_->GetNext(&batch, coord_->runtime_state());
+    if (!status.ok() || batch == NULL) break;
+    if (batch->num_rows() == 0) continue;
+    // 'batch' is only valid until the next GetNext() call.
+    RowBatch* spooled_batch = new RowBatch(coord_->row_desc(), batch->num_rows(),
+        coord_->query_mem_tracker());
+    batch->DeepCopyTo(spooled_batch);
+    int64_t bytes = SpooledBatchBytes(spooled_batch);
+    COUNTER_ADD(rows_spooled_counter_, spooled_batch->num_rows());
+
+    unique_lock<mutex> l(spool_lock_);
+    // A batch is always accepted by an empty queue, even if it is larger than the limit.
+    while (!spooling_cancelled_ && !spooled_batches_.empty() &&
+        spooled_bytes_ + bytes > FLAGS_result_spooling_max_bytes) {
+      spool_cv_.wait(l);
+    }
+    if (spooling_cancelled_) {
+      delete spooled_batch;
+      status = Status::CANCELLED;
+      break;
+    }
+    spooled_batches_.push_back(spooled_batch);
+    spooled_bytes_ += bytes;
+    spool_cv_.notify_all();
+  }
+
+  lock_guard<mutex> l(spool_lock_);
+  spooling_status_ = status;
+  spooling_done_ = true;
+  spool_cv_.notify_all();
+}
+
+void ImpalaServer::QueryExecState::StopResultSpooling() {
+  if (spooling_thread_.get() == NULL) return;
+  {
+    lock_guard<mutex> l(spool_lock_);
+    spooling_cancelled_ = true;
+    spool_cv_.notify_all();
+  }
+  spooling_thread_->Join();
+  spooling_thread_.reset();
+
+  // Free the spooled batches while coord_ and its mem trackers still exist.
+  lock_guard<mutex> l(lock_);
+  lock_guard<mutex> spool_l(spool_lock_);
+  for (RowBatch* batch: spooled_batches_) delete batch;
+  spooled_batches_.clear();
+  spooled_bytes_ = 0;
+  current_spooled_batch_.reset();
+  current_batch_ = NULL;
+}
+
 Status ImpalaServer::QueryExecState::FetchNextBatch() {
   DCHECK(!eos_);
   DCHECK(coord_.get() != NULL);
 
-  // Temporarily release lock so calls to Cancel() are not blocked.  fetch_rows_lock_
-  // ensures that we do not call coord_->GetNext() multiple times concurrently.
-  lock_.unlock();
-  Status status = coord_->GetNext(&current_batch_, coord_->runtime_state());
-  lock_.lock();
+  Status status;
+  if (spooling_thread_.get() != NULL) {
+    current_batch_ = NULL;
+    current_spooled_batch_.reset();
+    RowBatch* batch = NULL;
+    // Release lock_ while waiting, as for coord_->GetNext() below.
+    lock_.unlock();
+    {
+      unique_lock<mutex> l(spool_lock_);
+      while (spooled_batches_.empty() && !spooling_done_) spool_cv_.wait(l);
+      if (!spooled_batches_.empty()) {
+        batch = spooled_batches_.front();
+        spooled_batches_.pop_front();
+        spooled_bytes_ -= SpooledBatchBytes(batch);
+        spool_cv_.notify_all();
+      } else {
+        status = spooling_status_;
+      }
+    }
+    lock_.lock();
+    current_spooled_batch_.reset(batch);
+    current_batch_ = batch;
+  } else {
+    // Temporarily release lock so calls to Cancel() are not blocked.  fetch_rows_lock_
+    // ensures that we do not call coord_->GetNext() multiple times concurrently.
+    lock_.unlock();
+    status = coord_->GetNext(&current_batch_, coord_->runtime_state());
+    lock_.lock();
+  }
   if (!status.ok()) return status;
 
   // Check if query status has changed during GetNext() call
@@ -925,9 +1042,53 @@ Status ImpalaServer::QueryExecState::FetchNextBatch() {
 
   current_batch_row_ = 0;
   eos_ = current_batch_ == NULL;
+  if (eos_ && rows_to_cache_.get() != NULL) {
+    shared_ptr<const QueryResultCache::ResultRows> rows(rows_to_cache_.release());
+    parent_server_->query_result_cache()->Insert(result_cache_key_, result_cache_tables_,
+        result_cache_generation_, rows, rows_to_cache_bytes_);
+  }
   return Status::OK();
 }
 
+bool ImpalaServer::QueryExecState::ServeFromResultCache() {
+  QueryResultCache* cache = parent_server_->query_result_cache();
+  if (cache == NULL || session_type() != TSessionType::HIVESERVER2) return false;
+  if (!QueryResultCache::GetCacheKey(query_ctx_, exec_request_, &result_cache_key_,
+          &result_cache_tables_)) {
+    return false;
+  }
+  shared_ptr<const QueryResultCache::ResultRows> rows = cache->Lookup(result_cache_key_);
+  if (rows.get() != NULL) {
+    request_result_set_.reset(new vector<TResultRow>(*rows));
+    summary_profile_.AddInfoString("Query Result Cache", "Hit");
+    query_events_->MarkEvent("Served results from query result cache");
+    return true;
+  }
+  summary_profile_.AddInfoString("Query Result Cache", "Miss");
+  result_cache_generation_ = cache->generation();
+  rows_to_cache_.reset(new vector<TResultRow>());
+  return false;
+}
+
+void ImpalaServer::QueryExecState::CaptureRowsToCache(int start_idx, int num_rows) {
+  int64_t max_bytes = parent_server_->query_result_cache()->max_entry_size();
+  for (int i = start_idx; i < start_idx + num_rows; ++i) {
+    TupleRow* row = current_batch_->GetRow(i);
+    rows_to_cache_->push_back(TResultRow());
+    TResultRow& result_row = rows_to_cache_->back();
+    result_row.__isset.colVals = true;
+    result_row.colVals.resize(output_expr_ctxs_.size());
+    for (int j = 0; j < output_expr_ctxs_.size(); ++j) {
+      output_expr_ctxs_[j]->GetValue(row, false, &result_row.colVals[j]);
+    }
+    rows_to_cache_bytes_ += QueryResultCache::ByteSize(result_row);
+    if (rows_to_cache_bytes_ > max_bytes) {
+      rows_to_cache_.reset();
+      return;
+    }
+  }
+}
+
 void ImpalaServer::QueryExecState::SetResultSet(const vector<string>& results) {
   request_result_set_.reset(new vector<TResultRow>);
   request_result_set_->resize(results.size());
@@ -1053,9 +1214,49 @@ void ImpalaServer::QueryExecState::ExecChildQueriesAsync() {
 }
 
 void ImpalaServer::QueryExecState::ExecChildQueries() {
+  if (!FLAGS_compute_stats_concurrent_child_queries || child_queries_.size() == 1) {
+    for (int i = 0; i < child_queries_.size(); ++i) {
+      if (!child_queries_status_.ok()) return;
+      child_queries_status_ = child_queries_[i].ExecAndFetch();
+    }
+    return;
+  }
+
+  // Every child query scans the whole table, so running them concurrently roughly halves
+  // the time of COMPUTE STATS.
+  vector<Status> statuses(child_queries_.size());
+  ThreadGroup child_query_threads;
+  for (int i = 0; i < child_queries_.size(); ++i) {
+    Status status = child_query_threads.AddThread(new Thread("query-exec-state",
+        Substitute("child query $0", i),
+        bind(&ImpalaServer::QueryExecState::ExecChildQuery, this, i, &statuses[i])));
+    if (!status.ok()) {
+      statuses[i] = status;
+      for (int j = 0; j < i; ++j) child_queries_[j].Cancel();
+      break;
+    }
+  }
+  child_query_threads.JoinAll();
+  // Report the error that made ExecChildQuery() cancel the other child queries rather
+  // than the resulting CANCELLED statuses.
+  for (const Status& status: statuses) {
+    if (status.ok() || status.IsCancelled()) continue;
+    child_queries_status_ = status;
+    return;
+  }
+  for (const Status& status: statuses) {
+    if (!status.ok()) {
+      child_queries_status_ = status;
+      return;
+    }
+  }
+}
+
+void ImpalaServer::QueryExecState::ExecChildQuery(int child_idx, Status* status) {
+  *status = child_queries_[child_idx].ExecAndFetch();
+  if (status->ok()) return;
   for (int i = 0; i < child_queries_.size(); ++i) {
-    if (!child_queries_status_.ok()) return;
-    child_queries_status_ = child_queries_[i].ExecAndFetch();
+    if (i != child_idx) child_queries_[i].Cancel();
   }
 }
 
@@ -28,6 +28,7 @@
 
 #include <boost/thread.hpp>
 #include <boost/unordered_set.hpp>
+#include <deque>
 #include <vector>
 
 namespace impala {
@@ -312,11 +313,53 @@ class ImpalaServer::QueryExecState {
 
   /// Thread to execute child_queries_ in and the resulting status. The status is OK iff
   /// all child queries complete successfully. Otherwise, status contains the error of the
-  /// first child query that failed (child queries are executed serially and abort on the
-  /// first error).
+  /// first child query that failed (child queries abort on the first error).
   Status child_queries_status_;
   boost::scoped_ptr<Thread> child_queries_thread_;
 
+  /// Result spooling, enabled with --result_spooling_max_bytes. spooling_thread_ fetches
+  /// the rows of a query from coord_ as soon as they are produced and queues copies of
+  /// them in spooled_batches_, so that execution does not wait for the client to fetch
+  /// them. FetchNextBatch() then takes its batches from the queue. The thread is started
+  /// in WaitInternal() and joined in Done().
+  boost::scoped_ptr<Thread> spooling_thread_;
+
+  /// Protects the spooling state below. Must not be held while taking lock_.
+  boost::mutex spool_lock_;
+
+  /// Signaled when a batch is added to or removed from spooled_batches_, and when
+  /// spooling finished or was cancelled.
+  boost::condition_variable spool_cv_;
+
+  /// Batches that were spooled but not fetched yet, and their total size. Owned.
+  std::deque<RowBatch*> spooled_batches_;
+  int64_t spooled_bytes_;
+
+  /// True once spooling_thread_ fetched all rows or failed with spooling_status_.
+  bool spooling_done_;
+  Status spooling_status_;
+
+  /// Set by Cancel() and Done() to stop spooling_thread_ from waiting for space.
+  bool spooling_cancelled_;
+
+  /// The spooled batch that current_batch_ points to. Protected by lock_.
+  boost::scoped_ptr<RowBatch> current_spooled_batch_;
+
+  /// Counts the rows that spooling_thread_ spooled.
+  RuntimeProfile::Counter* rows_spooled_counter_;
+
+  /// Key and tables of this query in the server's QueryResultCache, and the generation
+  /// of the cache when the query started. Only set if the query's results may be cached.
+  std::string result_cache_key_;
+  std::vector<std::string> result_cache_tables_;
+  int64_t result_cache_generation_;
+
+  /// The rows fetched so far, which are inserted into the QueryResultCache once all rows
+  /// were fetched, and their size. Set to NULL once they exceed the maximum entry size
+  /// of the cache, or if the query's results are not cached.
+  boost::scoped_ptr<std::vector<TResultRow> > rows_to_cache_;
+  int64_t rows_to_cache_bytes_;
+
   /// Executes a local catalog operation (an operation that does not need to execute
   /// against the catalog service). Includes USE, SHOW, DESCRIBE, and EXPLAIN statements.
   Status ExecLocalCatalogOp(const TCatalogOpRequest& catalog_op);
@@ -329,6 +372,15 @@ class ImpalaServer::QueryExecState {
   /// actively processed. Takes expiration_data_lock_.
   void MarkActive();
 
+  /// Looks up the results of this query in the server's QueryResultCache, if the query
+  /// is from a HiveServer2 client. Returns true and copies the results into
+  /// request_result_set_ if they are cached. Otherwise prepares to capture the results
+  /// in rows_to_cache_, if they may be cached, and returns false.
+  bool ServeFromResultCache();
+
+  /// Appends rows [start_idx, start_idx + num_rows) of current_batch_ to rows_to_cache_.
+  void CaptureRowsToCache(int start_idx, int num_rows);
+
   /// Core logic of initiating a query or dml execution request.
   /// Initiates execution of plan fragments, if there are any, and sets
   /// up the output exprs for subsequent calls to FetchRows().
@@ -357,10 +409,12 @@ class ImpalaServer::QueryExecState {
   /// released.
   Status FetchNextBatch();
 
-  /// Evaluates 'output_expr_ctxs_' against 'row' and output the evaluated row in
-  /// 'result'. The values' scales (# of digits after decimal) are stored in 'scales'.
-  /// result and scales must have been resized to the number of columns before call.
-  Status GetRowValue(TupleRow* row, std::vector<void*>* result, std::vector<int>* scales);
+  /// Body of spooling_thread_. Fetches all batches from coord_ and queues copies of them
+  /// in spooled_batches_, while they take up at most --result_spooling_max_bytes.
+  void SpoolResults();
+
+  /// Stops and joins spooling_thread_, if it was started. Caller must not hold lock_.
+  void StopResultSpooling();
 
   /// Gather and publish all required updates to the metastore
   Status UpdateCatalog();
@@ -391,12 +445,17 @@ class ImpalaServer::QueryExecState {
   /// in a new child_queries_thread_.
   void ExecChildQueriesAsync();
 
-  /// Serially executes the queries in child_queries_ by calling the child query's
-  /// ExecAndWait(). This function is blocking and is intended to be run in a separate
-  /// thread to ensure that Exec() remains non-blocking. Sets child_queries_status_.
-  /// Must not be called while holding lock_.
+  /// Executes the queries in child_queries_ by calling the child query's
+  /// ExecAndWait(), each in its own thread with --compute_stats_concurrent_child_queries
+  /// and otherwise serially. This function is blocking and is intended to be run in a
+  /// separate thread to ensure that Exec() remains non-blocking. Sets
+  /// child_queries_status_. Must not be called while holding lock_.
   void ExecChildQueries();
 
+  /// Executes child_queries_[child_idx] and sets 'status' to its result. Cancels the
+  /// other child queries if it fails.
+  void ExecChildQuery(int child_idx, Status* status);
+
   /// Waits for all child queries to complete successfully or with an error, by joining
   /// child_queries_thread_. Returns a non-OK status if a child query fails or if the
   /// parent query is cancelled (subsequent children will not be executed). Returns OK
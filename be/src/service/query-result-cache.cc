@@ -0,0 +1,215 @@
+// Copyright 2016 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "service/query-result-cache.h"
+
+#include <ctype.h>
+#include <boost/algorithm/string.hpp>
+#include <gutil/strings/substitute.h>
+
+#include "common/logging.h"
+#include "rpc/thrift-util.h"
+#include "util/auth-util.h"
+
+#include "common/names.h"
+
+using boost::algorithm::to_lower_copy;
+using namespace strings;
+
+namespace impala {
+
+// Functions whose results may differ between executions of the same statement. A
+// statement that contains one of these names followed by '(' is not cached. This may
+// also exclude statements that only contain the name in a string literal.
+static const char* NON_DETERMINISTIC_FUNCTIONS[] = {
+    "now", "current_timestamp", "unix_timestamp", "utc_timestamp", "rand", "random",
+    "uuid", "pid", "user", "current_user", "effective_user", "sleep"
+};
+
+// Returns true if the lower-case statement 'stmt' calls a function whose result may
+// differ between executions.
+static bool CallsNonDeterministicFunction(const string& stmt) {
+  for (const char* fn: NON_DETERMINISTIC_FUNCTIONS) {
+    const string name(fn);
+    size_t pos = stmt.find(name);
+    while (pos != string::npos) {
+      size_t end = pos + name.size();
+      bool starts_word = pos == 0 || !(isalnum(stmt[pos - 1]) || stmt[pos - 1] == '_');
+      while (end < stmt.size() && isspace(stmt[end])) ++end;
+      if (starts_word && end < stmt.size() && stmt[end] == '(') return true;
+      pos = stmt.find(name, pos + 1);
+    }
+  }
+  return false;
+}
+
+QueryResultCache::QueryResultCache(int64_t capacity, int64_t max_entry_size,
+    MetricGroup* metrics)
+  : capacity_(capacity),
+    max_entry_size_(min(max_entry_size, capacity)),
+    total_bytes_(0),
+    generation_(0),
+    clear_generation_(0) {
+  hits_metric_ = metrics->RegisterMetric(new IntCounter(MakeTMetricDef(
+      "impala-server.query-result-cache.hits", TMetricKind::COUNTER, TUnit::UNIT), 0));
+  misses_metric_ = metrics->RegisterMetric(new IntCounter(MakeTMetricDef(
+      "impala-server.query-result-cache.misses", TMetricKind::COUNTER, TUnit::UNIT), 0));
+  num_entries_metric_ = metrics->RegisterMetric(new IntGauge(MakeTMetricDef(
+      "impala-server.query-result-cache.num-entries", TMetricKind::GAUGE, TUnit::UNIT),
+      0));
+  total_bytes_metric_ = metrics->RegisterMetric(new IntGauge(MakeTMetricDef(
+      "impala-server.query-result-cache.total-bytes", TMetricKind::GAUGE, TUnit::BYTES),
+      0));
+}
+
+bool QueryResultCache::GetCacheKey(const TQueryCtx& query_ctx,
+    const TExecRequest& exec_request, string* key, vector<string>* tables) {
+  return GetTables(exec_request, tables) && GetStatementKey(query_ctx, key);
+}
+
+bool QueryResultCache::GetTables(const TExecRequest& exec_request,
+    vector<string>* tables) {
+  if (exec_request.stmt_type != TStmtType::QUERY) return false;
+  if (!exec_request.__isset.query_exec_request) return false;
+  const TQueryExecRequest& query_exec_request = exec_request.query_exec_request;
+  if (!query_exec_request.__isset.desc_tbl) return false;
+
+  // Only the data of HDFS tables is versioned by the catalog.
+  tables->clear();
+  for (const TTableDescriptor& tbl: query_exec_request.desc_tbl.tableDescriptors) {
+    if (tbl.tableType != TTableType::HDFS_TABLE) return false;
+    tables->push_back(to_lower_copy(tbl.dbName + "." + tbl.tableName));
+  }
+  return true;
+}
+
+bool QueryResultCache::GetStatementKey(const TQueryCtx& query_ctx, string* key) {
+  // Collapse runs of whitespace, which clients often vary.
+  const string& stmt = query_ctx.request.stmt;
+  string normalized_stmt;
+  normalized_stmt.reserve(stmt.size());
+  for (int i = 0; i < stmt.size(); ++i) {
+    if (!isspace(stmt[i])) {
+      normalized_stmt += stmt[i];
+    } else if (!normalized_stmt.empty() && i + 1 < stmt.size() && !isspace(stmt[i + 1])) {
+      normalized_stmt += ' ';
+    }
+  }
+  if (CallsNonDeterministicFunction(to_lower_copy(normalized_stmt))) return false;
+
+  string serialized_options;
+  TQueryOptions query_options = query_ctx.request.query_options;
+  ThriftSerializer serializer(true);
+  if (!serializer.Serialize(&query_options, &serialized_options).ok()) return false;
+
+  *key = Substitute("$0\n$1\n$2\n", normalized_stmt, query_ctx.session.database,
+      GetEffectiveUser(query_ctx.session));
+  key->append(serialized_options);
+  return true;
+}
+
+shared_ptr<const QueryResultCache::ResultRows> QueryResultCache::Lookup(
+    const string& key) {
+  lock_guard<mutex> l(lock_);
+  unordered_map<string, EntryList::iterator>::iterator it = entries_.find(key);
+  if (it == entries_.end()) {
+    misses_metric_->Increment(1);
+    return shared_ptr<const ResultRows>();
+  }
+  hits_metric_->Increment(1);
+  lru_list_.splice(lru_list_.begin(), lru_list_, it->second);
+  return it->second->rows;
+}
+
+int64_t QueryResultCache::generation() {
+  lock_guard<mutex> l(lock_);
+  return generation_;
+}
+
+void QueryResultCache::Insert(const string& key, const vector<string>& tables,
+    int64_t generation, const shared_ptr<const ResultRows>& rows, int64_t bytes) {
+  if (bytes > max_entry_size_) return;
+  lock_guard<mutex> l(lock_);
+  if (clear_generation_ > generation) return;
+  for (const string& table: tables) {
+    unordered_map<string, int64_t>::const_iterator it = table_generations_.find(table);
+    if (it != table_generations_.end() && it->second > generation) return;
+  }
+
+  unordered_map<string, EntryList::iterator>::iterator existing = entries_.find(key);
+  if (existing != entries_.end()) EraseLocked(existing->second);
+  while (!lru_list_.empty() && total_bytes_ + bytes > capacity_) {
+    EraseLocked(--lru_list_.end());
+  }
+  Entry entry;
+  entry.key = key;
+  entry.tables = tables;
+  entry.rows = rows;
+  entry.bytes = bytes;
+  lru_list_.push_front(entry);
+  entries_[key] = lru_list_.begin();
+  total_bytes_ += bytes;
+  num_entries_metric_->Increment(1);
+  total_bytes_metric_->Increment(bytes);
+}
+
+void QueryResultCache::Invalidate(const TUpdateCatalogCacheRequest& req) {
+  lock_guard<mutex> l(lock_);
+  bool clear = !req.is_delta;
+  vector<const TCatalogObject*> objects;
+  for (const TCatalogObject& object: req.updated_objects) objects.push_back(&object);
+  for (const TCatalogObject& object: req.removed_objects) objects.push_back(&object);
+  for (const TCatalogObject* object: objects) {
+    // The tables that a query reads through a view are not known by the view's name.
+    if (object->type == TCatalogObjectType::DATABASE ||
+        object->type == TCatalogObjectType::VIEW) {
+      clear = true;
+    }
+    if (clear) break;
+    if (object->type != TCatalogObjectType::TABLE) continue;
+    InvalidateTableLocked(
+        to_lower_copy(object->table.db_name + "." + object->table.tbl_name));
+  }
+  if (!clear) return;
+  clear_generation_ = ++generation_;
+  table_generations_.clear();
+  while (!lru_list_.empty()) EraseLocked(lru_list_.begin());
+}
+
+int64_t QueryResultCache::ByteSize(const TResultRow& row) {
+  int64_t bytes = sizeof(row) + row.colVals.size() * sizeof(TColumnValue);
+  for (const TColumnValue& val: row.colVals) bytes += val.string_val.size();
+  return bytes;
+}
+
+void QueryResultCache::InvalidateTableLocked(const string& table) {
+  table_generations_[table] = ++generation_;
+  EntryList::iterator it = lru_list_.begin();
+  while (it != lru_list_.end()) {
+    EntryList::iterator entry = it++;
+    if (find(entry->tables.begin(), entry->tables.end(), table) != entry->tables.end()) {
+      EraseLocked(entry);
+    }
+  }
+}
+
+void QueryResultCache::EraseLocked(EntryList::iterator it) {
+  total_bytes_ -= it->bytes;
+  num_entries_metric_->Increment(-1);
+  total_bytes_metric_->Increment(-it->bytes);
+  entries_.erase(it->key);
+  lru_list_.erase(it);
+}
+
+}
@@ -0,0 +1,144 @@
+// Copyright 2016 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef IMPALA_SERVICE_QUERY_RESULT_CACHE_H
+#define IMPALA_SERVICE_QUERY_RESULT_CACHE_H
+
+#include <list>
+#include <string>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/unordered_map.hpp>
+
+#include "util/metrics.h"
+
+#include "gen-cpp/Data_types.h"
+#include "gen-cpp/Frontend_types.h"
+#include "gen-cpp/ImpalaInternalService_types.h"
+
+namespace impala {
+
+/// Caches the results of read-only queries on the coordinator, so that statements that
+/// are sent over and over again, e.g. by dashboards, are only executed once for every
+/// version of the tables they read. Enabled with --query_result_cache_size.
+///
+/// Queries are still planned before the cache is consulted, which checks the user's
+/// privileges and determines the tables that the query reads. The cache key contains the
+/// statement text with runs of whitespace collapsed, the session's database and user and
+/// the query options. Only queries that read HDFS tables, and do not call functions
+/// whose results vary between executions (e.g. now() or rand()), are cached.
+///
+/// Entries are invalidated when a catalog update changes or drops one of the tables
+/// they were computed from. Results that were computed while one of their tables
+/// changed are not inserted. The entries that were used least recently are evicted once
+/// the cache holds more than its capacity.
+///
+/// This class is thread-safe.
+class QueryResultCache {
+ public:
+  typedef std::vector<TResultRow> ResultRows;
+
+  /// 'capacity' is the maximum total size of the cached results in bytes, and
+  /// 'max_entry_size' that of the results of a single query.
+  QueryResultCache(int64_t capacity, int64_t max_entry_size, MetricGroup* metrics);
+
+  /// Returns false if the results of 'exec_request' may not be cached. Otherwise, sets
+  /// 'key' to its cache key and 'tables' to the fully qualified names of the tables it
+  /// reads.
+  static bool GetCacheKey(const TQueryCtx& query_ctx, const TExecRequest& exec_request,
+      std::string* key, std::vector<std::string>* tables);
+
+  /// The two parts of GetCacheKey(). GetStatementKey() returns false if the statement
+  /// of 'query_ctx' calls a non-deterministic function, and otherwise sets 'key' to the
+  /// key of the statement, its database, user and query options. GetTables() returns
+  /// false if 'exec_request' is not a query that only reads HDFS tables, and otherwise
+  /// sets 'tables' to their fully qualified names.
+  static bool GetStatementKey(const TQueryCtx& query_ctx, std::string* key);
+  static bool GetTables(const TExecRequest& exec_request,
+      std::vector<std::string>* tables);
+
+  /// Returns the cached results for 'key' and marks them as recently used. Returns
+  /// NULL if there are none.
+  boost::shared_ptr<const ResultRows> Lookup(const std::string& key);
+
+  /// Returns the current generation of the cache. It is passed to Insert() to detect
+  /// invalidations that happened while results were computed.
+  int64_t generation();
+
+  /// Adds the results 'rows' of the query with 'key', which take up 'bytes' bytes, to
+  /// the cache. 'generation' is the value that generation() returned before the query
+  /// started. The results are dropped if one of 'tables' was invalidated since then or
+  /// if they are larger than max_entry_size().
+  void Insert(const std::string& key, const std::vector<std::string>& tables,
+      int64_t generation, const boost::shared_ptr<const ResultRows>& rows, int64_t bytes);
+
+  /// Invalidates the entries computed from tables that the catalog update 'req'
+  /// changes or removes. All entries are invalidated by a full update or an update to
+  /// a database or view.
+  void Invalidate(const TUpdateCatalogCacheRequest& req);
+
+  /// Returns the approximate size of 'row' in bytes.
+  static int64_t ByteSize(const TResultRow& row);
+
+  int64_t max_entry_size() const { return max_entry_size_; }
+
+ private:
+  struct Entry {
+    std::string key;
+    std::vector<std::string> tables;
+    boost::shared_ptr<const ResultRows> rows;
+    int64_t bytes;
+  };
+  typedef std::list<Entry> EntryList;
+
+  const int64_t capacity_;
+  const int64_t max_entry_size_;
+
+  /// Protects all members below.
+  boost::mutex lock_;
+
+  /// All entries, the most recently used one first.
+  EntryList lru_list_;
+
+  /// Map from key to the entry in lru_list_.
+  boost::unordered_map<std::string, EntryList::iterator> entries_;
+
+  /// Total size of all entries.
+  int64_t total_bytes_;
+
+  /// Incremented by every invalidation.
+  int64_t generation_;
+
+  /// Generation of the last invalidation of all entries, and of the last invalidation
+  /// of every table that was invalidated since then.
+  int64_t clear_generation_;
+  boost::unordered_map<std::string, int64_t> table_generations_;
+
+  /// Metrics for the lookups, and the number and size of the cached results.
+  IntCounter* hits_metric_;
+  IntCounter* misses_metric_;
+  IntGauge* num_entries_metric_;
+  IntGauge* total_bytes_metric_;
+
+  /// Invalidates the entries computed from 'table'. Caller must hold lock_.
+  void InvalidateTableLocked(const std::string& table);
+
+  /// Removes the entry 'it' from the cache. Caller must hold lock_.
+  void EraseLocked(EntryList::iterator it);
+};
+
+}
+
+#endif
@@ -14,6 +14,8 @@
 
 #include "statestore/statestore.h"
 
+#include <boost/algorithm/string.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
 #include <boost/thread.hpp>
 #include <thrift/Thrift.h>
 #include <gutil/strings/substitute.h>
@@ -34,6 +36,8 @@ using namespace impala;
 using namespace rapidjson;
 using namespace strings;
 
+namespace posix_time = boost::posix_time;
+
 DEFINE_int32(statestore_max_missed_heartbeats, 10, "Maximum number of consecutive "
     "heartbeat messages an impalad can miss before being declared failed by the "
     "statestore.");
@@ -43,6 +47,24 @@ DEFINE_int32(statestore_num_update_threads, 10, "(Advanced) Number of threads us
 DEFINE_int32(statestore_update_frequency_ms, 2000, "(Advanced) Frequency (in ms) with"
     " which the statestore sends topic updates to subscribers.");
 
+DEFINE_int32(statestore_num_priority_update_threads, 10, "(Advanced) Number of threads "
+    "used to send priority topic updates in parallel to all registered subscribers.");
+DEFINE_int32(statestore_priority_update_frequency_ms, 100, "(Advanced) Frequency (in ms) "
+    "with which the statestore sends updates of the topics in "
+    "--statestore_priority_topics to subscribers. These topics are then not sent with "
+    "the regular topic updates. If <= 0, all topics are sent every "
+    "--statestore_update_frequency_ms.");
+DEFINE_string(statestore_priority_topics, "impala-membership,impala-request-queue",
+    "(Advanced) "
+    "Comma-separated list of topics sent every "
+    "--statestore_priority_update_frequency_ms. Only suitable for small topics that need "
+    "to be propagated with a low latency.");
+DEFINE_int32(statestore_max_concurrent_full_topic_updates, 4, "(Advanced) Maximum "
+    "number of full (non-delta) updates of large topics that the statestore sends at "
+    "the same time, e.g. of the catalog topic to newly registered subscribers. Other "
+    "subscribers receive the topic with a later update. If <= 0, full updates are not "
+    "limited.");
+
 DEFINE_int32(statestore_num_heartbeat_threads, 10, "(Advanced) Number of threads used to "
     " send heartbeats in parallel to all registered subscribers.");
 DEFINE_int32(statestore_heartbeat_frequency_ms, 1000, "(Advanced) Frequency (in ms) with"
@@ -77,6 +99,8 @@ const string STATESTORE_TOTAL_KEY_SIZE_BYTES = "statestore.total-key-size-bytes"
 const string STATESTORE_TOTAL_VALUE_SIZE_BYTES = "statestore.total-value-size-bytes";
 const string STATESTORE_TOTAL_TOPIC_SIZE_BYTES = "statestore.total-topic-size-bytes";
 const string STATESTORE_UPDATE_DURATION = "statestore.topic-update-durations";
+const string STATESTORE_PRIORITY_UPDATE_DURATION =
+    "statestore.priority-topic-update-durations";
 const string STATESTORE_HEARTBEAT_DURATION = "statestore.heartbeat-durations";
 
 const Statestore::TopicEntry::Value Statestore::TopicEntry::NULL_VALUE = "";
@@ -95,6 +119,26 @@ const int32_t STATESTORE_MAX_SUBSCRIBERS = 10000;
 // Updates or heartbeats that miss their deadline by this much are logged.
 const uint32_t DEADLINE_MISS_THRESHOLD_MS = 2000;
 
+// Full updates of topics at least this large are limited by
+// FLAGS_statestore_max_concurrent_full_topic_updates.
+const int64_t MIN_THROTTLED_FULL_UPDATE_BYTES = 1024 * 1024;
+
+// Returns the full topic update slots taken by GatherTopicUpdates() when it goes out of
+// scope.
+class FullTopicUpdateSlots {
+ public:
+  FullTopicUpdateSlots(AtomicInt32* num_in_flight, int num_slots)
+    : num_in_flight_(num_in_flight), num_slots_(num_slots) { }
+
+  ~FullTopicUpdateSlots() {
+    if (num_slots_ > 0) num_in_flight_->Add(-num_slots_);
+  }
+
+ private:
+  AtomicInt32* num_in_flight_;
+  const int num_slots_;
+};
+
 typedef ClientConnection<StatestoreSubscriberClient> StatestoreSubscriberConnection;
 
 class StatestoreThriftIf : public StatestoreServiceIf {
@@ -213,12 +257,19 @@ Statestore::Statestore(MetricGroup* metrics)
         "subscriber-update-worker",
         FLAGS_statestore_num_update_threads,
         STATESTORE_MAX_SUBSCRIBERS,
-        bind<void>(mem_fn(&Statestore::DoSubscriberUpdate), this, false, _1, _2)),
+        bind<void>(mem_fn(&Statestore::DoSubscriberUpdate), this, TOPIC_UPDATE, _1, _2)),
     subscriber_heartbeat_threadpool_("statestore-heartbeat",
         "subscriber-heartbeat-worker",
         FLAGS_statestore_num_heartbeat_threads,
         STATESTORE_MAX_SUBSCRIBERS,
-        bind<void>(mem_fn(&Statestore::DoSubscriberUpdate), this, true, _1, _2)),
+        bind<void>(mem_fn(&Statestore::DoSubscriberUpdate), this, HEARTBEAT, _1, _2)),
+    subscriber_priority_topic_update_threadpool_("statestore-priority-update",
+        "subscriber-priority-update-worker",
+        FLAGS_statestore_num_priority_update_threads,
+        STATESTORE_MAX_SUBSCRIBERS,
+        bind<void>(mem_fn(&Statestore::DoSubscriberUpdate), this, PRIORITY_TOPIC_UPDATE,
+            _1, _2)),
+    priority_topic_generation_(0),
     update_state_client_cache_(new ClientCache<StatestoreSubscriberClient>(1, 0,
         FLAGS_statestore_update_tcp_timeout_seconds * 1000,
         FLAGS_statestore_update_tcp_timeout_seconds * 1000)),
@@ -230,6 +281,16 @@ Statestore::Statestore(MetricGroup* metrics)
         FLAGS_statestore_max_missed_heartbeats,
         FLAGS_statestore_max_missed_heartbeats / 2)) {
 
+  if (FLAGS_statestore_priority_update_frequency_ms > 0) {
+    vector<string> priority_topics;
+    split(priority_topics, FLAGS_statestore_priority_topics, is_any_of(","),
+        token_compress_on);
+    for (string& topic: priority_topics) {
+      trim(topic);
+      if (!topic.empty()) priority_topics_.insert(topic);
+    }
+  }
+
   DCHECK(metrics != NULL);
   num_subscribers_metric_ =
       metrics->AddGauge<int64_t>(STATESTORE_LIVE_SUBSCRIBERS, 0);
@@ -241,6 +302,8 @@ Statestore::Statestore(MetricGroup* metrics)
 
   topic_update_duration_metric_ =
       StatsMetric<double>::CreateAndRegister(metrics, STATESTORE_UPDATE_DURATION);
+  priority_topic_update_duration_metric_ = StatsMetric<double>::CreateAndRegister(
+      metrics, STATESTORE_PRIORITY_UPDATE_DURATION);
   heartbeat_duration_metric_ =
       StatsMetric<double>::CreateAndRegister(metrics, STATESTORE_HEARTBEAT_DURATION);
 
@@ -252,7 +315,7 @@ void Statestore::RegisterWebpages(Webserver* webserver) {
   Webserver::UrlCallback topics_callback =
       bind<void>(mem_fn(&Statestore::TopicsHandler), this, _1, _2);
   webserver->RegisterUrlCallback("/topics", "statestore_topics.tmpl",
-      topics_callback);
+      topics_callback, true, true);
 
   Webserver::UrlCallback subscribers_callback =
       bind<void>(&Statestore::SubscribersHandler, this, _1, _2);
@@ -262,32 +325,52 @@ void Statestore::RegisterWebpages(Webserver* webserver) {
 
 void Statestore::TopicsHandler(const Webserver::ArgumentMap& args,
     Document* document) {
-  lock_guard<mutex> l(subscribers_lock_);
-  lock_guard<mutex> t(topic_lock_);
+  // Summaries of the topics, taken with the locks held. The JSON is built after the
+  // locks are released, so that the page doesn't delay topic updates.
+  struct TopicSummary {
+    TopicId id;
+    uint64_t num_entries;
+    TopicEntry::Version version;
+    TopicEntry::Version oldest_version;
+    SubscriberId oldest_id;
+    int64_t key_size;
+    int64_t value_size;
+  };
+  vector<TopicSummary> summaries;
+  {
+    lock_guard<mutex> l(subscribers_lock_);
+    lock_guard<mutex> t(topic_lock_);
+    summaries.reserve(topics_.size());
+    for (const TopicMap::value_type& topic: topics_) {
+      TopicSummary summary;
+      summary.id = topic.second.id();
+      summary.num_entries = topic.second.entries().size();
+      summary.version = topic.second.last_version();
+      summary.oldest_version =
+          GetMinSubscriberTopicVersion(topic.first, &summary.oldest_id);
+      summary.key_size = topic.second.total_key_size_bytes();
+      summary.value_size = topic.second.total_value_size_bytes();
+      summaries.push_back(summary);
+    }
+  }
 
   Value topics(kArrayType);
 
-  for (const TopicMap::value_type& topic: topics_) {
+  for (const TopicSummary& topic: summaries) {
     Value topic_json(kObjectType);
 
-    Value topic_id(topic.second.id().c_str(), document->GetAllocator());
+    Value topic_id(topic.id.c_str(), document->GetAllocator());
     topic_json.AddMember("topic_id", topic_id, document->GetAllocator());
-    topic_json.AddMember("num_entries",
-        static_cast<uint64_t>(topic.second.entries().size()),
-        document->GetAllocator());
-    topic_json.AddMember("version", topic.second.last_version(), document->GetAllocator());
-
-    SubscriberId oldest_subscriber_id;
-    TopicEntry::Version oldest_subscriber_version =
-        GetMinSubscriberTopicVersion(topic.first, &oldest_subscriber_id);
+    topic_json.AddMember("num_entries", topic.num_entries, document->GetAllocator());
+    topic_json.AddMember("version", topic.version, document->GetAllocator());
 
-    topic_json.AddMember("oldest_version", oldest_subscriber_version,
+    topic_json.AddMember("oldest_version", topic.oldest_version,
         document->GetAllocator());
-    Value oldest_id(oldest_subscriber_id.c_str(), document->GetAllocator());
+    Value oldest_id(topic.oldest_id.c_str(), document->GetAllocator());
     topic_json.AddMember("oldest_id", oldest_id, document->GetAllocator());
 
-    int64_t key_size = topic.second.total_key_size_bytes();
-    int64_t value_size = topic.second.total_value_size_bytes();
+    int64_t key_size = topic.key_size;
+    int64_t value_size = topic.value_size;
     Value key_size_json(PrettyPrinter::Print(key_size, TUnit::BYTES).c_str(),
         document->GetAllocator());
     topic_json.AddMember("key_size", key_size_json, document->GetAllocator());
@@ -391,13 +474,52 @@ Status Statestore::RegisterSubscriber(const SubscriberId& subscriber_id,
   ScheduledSubscriberUpdate update = make_pair(0, subscriber_id);
   RETURN_IF_ERROR(OfferUpdate(update, &subscriber_topic_update_threadpool_));
   RETURN_IF_ERROR(OfferUpdate(update, &subscriber_heartbeat_threadpool_));
+  if (HasPriorityTopic(topic_registrations)) {
+    RETURN_IF_ERROR(OfferUpdate(update, &subscriber_priority_topic_update_threadpool_));
+  }
 
   LOG(INFO) << "Subscriber '" << subscriber_id << "' registered (registration id: "
             << PrintId(*registration_id) << ")";
   return Status::OK();
 }
 
-Status Statestore::SendTopicUpdate(Subscriber* subscriber, bool* update_skipped) {
+bool Statestore::HasPriorityTopic(
+    const vector<TTopicRegistration>& topic_registrations) const {
+  for (const TTopicRegistration& topic: topic_registrations) {
+    if (priority_topics_.find(topic.topic_name) != priority_topics_.end()) return true;
+  }
+  return false;
+}
+
+void Statestore::NotifyPriorityTopicChange() {
+  {
+    lock_guard<mutex> l(priority_update_lock_);
+    ++priority_topic_generation_;
+  }
+  priority_update_cv_.notify_all();
+}
+
+void Statestore::WaitForPriorityUpdate(int64_t deadline_ms,
+    const SubscriberId& subscriber_id) {
+  int64_t last_generation;
+  {
+    lock_guard<mutex> l(subscribers_lock_);
+    SubscriberMap::iterator it = subscribers_.find(subscriber_id);
+    if (it == subscribers_.end()) return;
+    last_generation = it->second->last_priority_topic_generation();
+  }
+  unique_lock<mutex> l(priority_update_lock_);
+  while (priority_topic_generation_ == last_generation) {
+    int64_t wait_ms = deadline_ms - UnixMillis();
+    if (wait_ms <= 0) break;
+    priority_update_cv_.timed_wait(l, posix_time::milliseconds(wait_ms));
+  }
+}
+
+Status Statestore::SendTopicUpdate(Subscriber* subscriber, bool priority_topics,
+    bool* update_skipped) {
+  StatsMetric<double>* duration_metric = priority_topics ?
+      priority_topic_update_duration_metric_ : topic_update_duration_metric_;
   // Time any successful RPCs (i.e. those for which UpdateState() completed, even though
   // it may have returned an error.)
   MonotonicStopWatch sw;
@@ -405,7 +527,11 @@ Status Statestore::SendTopicUpdate(Subscriber* subscriber, bool* update_skipped)
 
   // First thing: make a list of updates to send
   TUpdateStateRequest update_state_request;
-  GatherTopicUpdates(*subscriber, &update_state_request);
+  int num_full_updates = 0;
+  GatherTopicUpdates(*subscriber, priority_topics, &update_state_request,
+      &num_full_updates);
+  FullTopicUpdateSlots full_update_slots(&num_full_topic_updates_in_flight_,
+      num_full_updates);
 
   // Set the expected registration ID, so that the subscriber can reject this update if
   // they have moved on to a new registration instance.
@@ -423,7 +549,7 @@ Status Statestore::SendTopicUpdate(Subscriber* subscriber, bool* update_skipped)
 
   status = Status(response.status);
   if (!status.ok()) {
-    topic_update_duration_metric_->Update(sw.ElapsedTime() / (1000.0 * 1000.0 * 1000.0));
+    duration_metric->Update(sw.ElapsedTime() / (1000.0 * 1000.0 * 1000.0));
     return status;
   }
 
@@ -432,7 +558,7 @@ Status Statestore::SendTopicUpdate(Subscriber* subscriber, bool* update_skipped)
     // The subscriber skipped processing this update. We don't consider this a failure
     // - subscribers can decide what they do with any update - so, return OK and set
     // update_skipped so the caller can compensate.
-    topic_update_duration_metric_->Update(sw.ElapsedTime() / (1000.0 * 1000.0 * 1000.0));
+    duration_metric->Update(sw.ElapsedTime() / (1000.0 * 1000.0 * 1000.0));
     return Status::OK();
   }
 
@@ -446,6 +572,7 @@ Status Statestore::SendTopicUpdate(Subscriber* subscriber, bool* update_skipped)
   }
 
   // Thirdly: perform any / all updates returned by the subscriber
+  bool priority_topic_changed = false;
   {
     lock_guard<mutex> l(topic_lock_);
     for (const TTopicDelta& update: response.topic_updates) {
@@ -470,7 +597,14 @@ Status Statestore::SendTopicUpdate(Subscriber* subscriber, bool* update_skipped)
       }
 
       Topic* topic = &topic_it->second;
+      bool is_priority_topic =
+          priority_topics_.find(update.topic_name) != priority_topics_.end();
       for (const TTopicItem& item: update.topic_entries) {
+        if (is_priority_topic && !priority_topic_changed) {
+          TopicEntryMap::const_iterator entry_it = topic->entries().find(item.key);
+          priority_topic_changed = entry_it == topic->entries().end() ||
+              entry_it->second.value() == Statestore::TopicEntry::NULL_VALUE;
+        }
         TopicEntry::Version version = topic->Put(item.key, item.value);
         subscriber->AddTransientUpdate(update.topic_name, item.key, version);
       }
@@ -482,37 +616,57 @@ Status Statestore::SendTopicUpdate(Subscriber* subscriber, bool* update_skipped)
       }
     }
   }
-  topic_update_duration_metric_->Update(sw.ElapsedTime() / (1000.0 * 1000.0 * 1000.0));
+  if (priority_topic_changed) NotifyPriorityTopicChange();
+  duration_metric->Update(sw.ElapsedTime() / (1000.0 * 1000.0 * 1000.0));
   return Status::OK();
 }
 
-void Statestore::GatherTopicUpdates(const Subscriber& subscriber,
-    TUpdateStateRequest* update_state_request) {
+void Statestore::GatherTopicUpdates(const Subscriber& subscriber, bool priority_topics,
+    TUpdateStateRequest* update_state_request, int* num_full_updates) {
+  *num_full_updates = 0;
   {
     lock_guard<mutex> l(topic_lock_);
     for (const Subscriber::Topics::value_type& subscribed_topic:
          subscriber.subscribed_topics()) {
+      bool is_priority_topic =
+          priority_topics_.find(subscribed_topic.first) != priority_topics_.end();
+      if (is_priority_topic != priority_topics) continue;
       TopicMap::const_iterator topic_it = topics_.find(subscribed_topic.first);
       DCHECK(topic_it != topics_.end());
 
       TopicEntry::Version last_processed_version =
           subscriber.LastTopicVersionProcessed(topic_it->first);
       const Topic& topic = topic_it->second;
+      // If the subscriber version is > 0, send this update as a delta. Otherwise, this is
+      // a new subscriber so send them a non-delta update that includes all items in the
+      // topic.
+      bool is_delta = last_processed_version > Subscriber::TOPIC_INITIAL_VERSION;
+      int64_t topic_size = topic.total_key_size_bytes() + topic.total_value_size_bytes();
+
+      // Limit the number of concurrent full updates of large topics, so that many
+      // subscribers (re-)registering at once do not saturate the network and delay the
+      // updates of all other topics. A topic that is left out is sent with the next
+      // update, still as a full update.
+      if (!is_delta && topic_size >= MIN_THROTTLED_FULL_UPDATE_BYTES &&
+          FLAGS_statestore_max_concurrent_full_topic_updates > 0) {
+        if (num_full_topic_updates_in_flight_.Add(1) >
+            FLAGS_statestore_max_concurrent_full_topic_updates) {
+          num_full_topic_updates_in_flight_.Add(-1);
+          VLOG_RPC << "Deferring full " << subscribed_topic.first << " topic update for "
+                   << subscriber.id();
+          continue;
+        }
+        ++*num_full_updates;
+      }
 
       TTopicDelta& topic_delta =
           update_state_request->topic_deltas[subscribed_topic.first];
       topic_delta.topic_name = subscribed_topic.first;
-
-      // If the subscriber version is > 0, send this update as a delta. Otherwise, this is
-      // a new subscriber so send them a non-delta update that includes all items in the
-      // topic.
-      topic_delta.is_delta = last_processed_version > Subscriber::TOPIC_INITIAL_VERSION;
+      topic_delta.is_delta = is_delta;
       topic_delta.__set_from_version(last_processed_version);
 
       if (!topic_delta.is_delta &&
           topic.last_version() > Subscriber::TOPIC_INITIAL_VERSION) {
-        int64_t topic_size =
-            topic.total_key_size_bytes() + topic.total_value_size_bytes();
         VLOG_QUERY << "Preparing initial " << topic_delta.topic_name
                    << " topic update for " << subscriber.id() << ". Size = "
                    << PrettyPrinter::Print(topic_size, TUnit::BYTES);
@@ -586,6 +740,7 @@ void Statestore::SetExitFlag() {
   lock_guard<mutex> l(exit_flag_lock_);
   exit_flag_ = true;
   subscriber_topic_update_threadpool_.Shutdown();
+  subscriber_priority_topic_update_threadpool_.Shutdown();
 }
 
 Status Statestore::SendHeartbeat(Subscriber* subscriber) {
@@ -607,13 +762,26 @@ Status Statestore::SendHeartbeat(Subscriber* subscriber) {
   return Status::OK();
 }
 
-void Statestore::DoSubscriberUpdate(bool is_heartbeat, int thread_id,
+void Statestore::DoSubscriberUpdate(UpdateKind kind, int thread_id,
     const ScheduledSubscriberUpdate& update) {
   int64_t update_deadline = update.first;
-  const string hb_type = is_heartbeat ? "heartbeat" : "topic update";
+  bool is_heartbeat = kind == HEARTBEAT;
+  const string hb_type = is_heartbeat ? "heartbeat" :
+      (kind == PRIORITY_TOPIC_UPDATE ? "priority topic update" : "topic update");
+  const string frequency_flag = is_heartbeat ? "statestore_heartbeat_frequency_ms" :
+      (kind == PRIORITY_TOPIC_UPDATE ? "statestore_priority_update_frequency_ms" :
+          "statestore_update_frequency_ms");
+  int64_t frequency_ms = is_heartbeat ? FLAGS_statestore_heartbeat_frequency_ms :
+      (kind == PRIORITY_TOPIC_UPDATE ? FLAGS_statestore_priority_update_frequency_ms :
+          FLAGS_statestore_update_frequency_ms);
   if (update_deadline != 0) {
     // Wait until deadline.
     int64_t diff_ms = update_deadline - UnixMillis();
+    if (kind == PRIORITY_TOPIC_UPDATE) {
+      // Priority updates are sent early if the priority topics changed in the meantime.
+      WaitForPriorityUpdate(update_deadline, update.second);
+      diff_ms = min<int64_t>(0, update_deadline - UnixMillis());
+    }
     while (diff_ms > 0) {
       SleepForMs(diff_ms);
       diff_ms = update_deadline - UnixMillis();
@@ -627,10 +795,7 @@ void Statestore::DoSubscriberUpdate(bool is_heartbeat, int thread_id,
       // require a 'rate' metric type.
       const string& msg = Substitute("Missed subscriber ($0) $1 deadline by $2ms, "
           "consider increasing --$3 (currently $4)", update.second, hb_type, diff_ms,
-          is_heartbeat ? "statestore_heartbeat_frequency_ms" :
-              "statestore_update_frequency_ms",
-          is_heartbeat ? FLAGS_statestore_heartbeat_frequency_ms :
-              FLAGS_statestore_update_frequency_ms);
+          frequency_flag, frequency_ms);
       if (is_heartbeat) {
         LOG(WARNING) << msg;
       } else {
@@ -662,10 +827,15 @@ void Statestore::DoSubscriberUpdate(bool is_heartbeat, int thread_id,
           FLAGS_statestore_heartbeat_tcp_timeout_seconds)));
     }
 
-    deadline_ms = UnixMillis() + FLAGS_statestore_heartbeat_frequency_ms;
+    deadline_ms = UnixMillis() + frequency_ms;
   } else {
+    if (kind == PRIORITY_TOPIC_UPDATE) {
+      lock_guard<mutex> l(priority_update_lock_);
+      subscriber->set_last_priority_topic_generation(priority_topic_generation_);
+    }
     bool update_skipped;
-    status = SendTopicUpdate(subscriber.get(), &update_skipped);
+    status = SendTopicUpdate(subscriber.get(), kind == PRIORITY_TOPIC_UPDATE,
+        &update_skipped);
     if (status.code() == TErrorCode::RPC_TIMEOUT) {
       // Rewrite status to make it more useful, while preserving the stack
       status.SetErrorMsg(ErrorMsg(TErrorCode::RPC_TIMEOUT, Substitute(
@@ -675,9 +845,7 @@ void Statestore::DoSubscriberUpdate(bool is_heartbeat, int thread_id,
     }
     // If the subscriber responded that it skipped the last update sent, we assume that
     // it was busy doing something else, and back off slightly before sending another.
-    int64_t update_interval = update_skipped ?
-        (2 * FLAGS_statestore_update_frequency_ms) :
-        FLAGS_statestore_update_frequency_ms;
+    int64_t update_interval = update_skipped ? (2 * frequency_ms) : frequency_ms;
     deadline_ms = UnixMillis() + update_interval;
   }
 
@@ -707,10 +875,13 @@ void Statestore::DoSubscriberUpdate(bool is_heartbeat, int thread_id,
       }
     } else {
       // Schedule the next message.
-      VLOG(3) << "Next " << (is_heartbeat ? "heartbeat" : "update") << " deadline for: "
+      VLOG(3) << "Next " << hb_type << " deadline for: "
               << subscriber->id() << " is in " << deadline_ms << "ms";
-      OfferUpdate(make_pair(deadline_ms, subscriber->id()), is_heartbeat ?
-          &subscriber_heartbeat_threadpool_ : &subscriber_topic_update_threadpool_);
+      ThreadPool<ScheduledSubscriberUpdate>* threadpool = is_heartbeat ?
+          &subscriber_heartbeat_threadpool_ : (kind == PRIORITY_TOPIC_UPDATE ?
+              &subscriber_priority_topic_update_threadpool_ :
+              &subscriber_topic_update_threadpool_);
+      OfferUpdate(make_pair(deadline_ms, subscriber->id()), threadpool);
     }
   }
 }
@@ -732,13 +903,20 @@ void Statestore::UnregisterSubscriber(Subscriber* subscriber) {
 
   // Delete all transient entries
   lock_guard<mutex> topic_lock(topic_lock_);
+  bool priority_topic_changed = false;
   for (Statestore::Subscriber::TransientEntryMap::value_type entry:
        subscriber->transient_entries()) {
     Statestore::TopicMap::iterator topic_it = topics_.find(entry.first.first);
     DCHECK(topic_it != topics_.end());
     topic_it->second.DeleteIfVersionsMatch(entry.second, // version
         entry.first.second); // key
+    if (priority_topics_.find(entry.first.first) != priority_topics_.end()) {
+      priority_topic_changed = true;
+    }
   }
+  // Let the other subscribers learn about the failure with their next priority update,
+  // rather than a full update interval later.
+  if (priority_topic_changed) NotifyPriorityTopicChange();
   num_subscribers_metric_->Increment(-1L);
   subscriber_set_metric_->Remove(subscriber->id());
   subscribers_.erase(subscriber->id());
@@ -19,11 +19,13 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <set>
 #include <boost/unordered_map.hpp>
 #include <boost/scoped_ptr.hpp>
 #include <boost/thread/condition_variable.hpp>
 #include <boost/uuid/uuid_generators.hpp>
 
+#include "common/atomic.h"
 #include "gen-cpp/Types_types.h"
 #include "gen-cpp/StatestoreSubscriber.h"
 #include "gen-cpp/StatestoreService.h"
@@ -57,6 +59,14 @@ class Status;
 /// that it skipped processing an update, in which case the statestore will back off
 /// slightly before re-sending the same update.
 //
+/// Topics listed in FLAGS_statestore_priority_topics are sent in separate 'priority
+/// update' messages every FLAGS_statestore_priority_update_frequency_ms instead, so that
+/// small topics whose entries change often (e.g. cluster membership and the admission
+/// control pool statistics) reach all subscribers with a lower latency than the regular
+/// updates allow. Each topic is only ever sent by one kind of update message. Full
+/// updates of large topics are limited to
+/// FLAGS_statestore_max_concurrent_full_topic_updates at a time.
+//
 /// Topic entries usually have human-readable keys, and values which are some serialised
 /// representation of a data structure, e.g. a Thrift struct. The contents of a value's
 /// byte string is opaque to the statestore, which maintains no information about how to
@@ -313,6 +323,15 @@ class Statestore {
     void SetLastTopicVersionProcessed(const TopicId& topic_id,
         TopicEntry::Version version);
 
+    /// The value of Statestore::priority_topic_generation_ when the last priority topic
+    /// update was sent to this subscriber.
+    int64_t last_priority_topic_generation() const {
+      return last_priority_topic_generation_.Load();
+    }
+    void set_last_priority_topic_generation(int64_t generation) {
+      last_priority_topic_generation_.Store(generation);
+    }
+
    private:
     /// Unique human-readable identifier for this subscriber, set by the subscriber itself
     /// on a Register call.
@@ -336,6 +355,9 @@ class Statestore {
     /// List of updates made by this subscriber so that transient entries may be deleted on
     /// failure.
     TransientEntryMap transient_entries_;
+
+    /// See last_priority_topic_generation().
+    AtomicInt64 last_priority_topic_generation_;
   };
 
   /// Protects access to subscribers_ and subscriber_uuid_generator_. Must be taken before
@@ -362,6 +384,13 @@ class Statestore {
   /// the second entry is the subscriber to send it to.
   typedef std::pair<int64_t, SubscriberId> ScheduledSubscriberUpdate;
 
+  /// The kinds of messages sent to subscribers, each by its own pool of threads.
+  enum UpdateKind {
+    TOPIC_UPDATE,
+    PRIORITY_TOPIC_UPDATE,
+    HEARTBEAT
+  };
+
   /// The statestore has two pools of threads that send messages to subscribers
   /// one-by-one. One pool deals with 'heartbeat' messages that update failure detection
   /// state, and the other pool sends 'topic update' messages which contain the
@@ -394,6 +423,32 @@ class Statestore {
 
   ThreadPool<ScheduledSubscriberUpdate> subscriber_heartbeat_threadpool_;
 
+  /// Sends the topics in 'priority_topics_' to the subscribers of any of them. They are
+  /// kept apart from the other topic updates so that they are not delayed by the
+  /// potentially large and slow updates of other topics.
+  ThreadPool<ScheduledSubscriberUpdate> subscriber_priority_topic_update_threadpool_;
+
+  /// The topics parsed from FLAGS_statestore_priority_topics. Empty if priority updates
+  /// are disabled. Not modified after construction.
+  std::set<TopicId> priority_topics_;
+
+  /// Number of full updates of large topics that are currently being sent to
+  /// subscribers. See GatherTopicUpdates().
+  AtomicInt32 num_full_topic_updates_in_flight_;
+
+  /// Protects 'priority_topic_generation_'. Must not be held while taking any other lock.
+  boost::mutex priority_update_lock_;
+
+  /// Incremented whenever a subscriber adds a new entry to a priority topic or an entry
+  /// of a failed subscriber is deleted from one, e.g. when an impalad joins or leaves the
+  /// cluster. Subscribers that have not yet been sent the priority topics since then
+  /// are sent them right away, rather than at their next scheduled priority update.
+  int64_t priority_topic_generation_;
+
+  /// Signalled when 'priority_topic_generation_' changes, to wake up the priority update
+  /// threads that wait for the deadline of their next update.
+  boost::condition_variable priority_update_cv_;
+
   /// Cache of subscriber clients used for UpdateState() RPCs. Only one client per
   /// subscriber should be used, but the cache helps with the client lifecycle on failure.
   boost::scoped_ptr<ClientCache<StatestoreSubscriberClient> > update_state_client_cache_;
@@ -426,6 +481,9 @@ class Statestore {
   /// cost as well as the subscriber-side processing time.
   StatsMetric<double>* topic_update_duration_metric_;
 
+  /// Same as above, but for priority topic updates.
+  StatsMetric<double>* priority_topic_update_duration_metric_;
+
   /// Same as above, but for SendHeartbeat() RPCs.
   StatsMetric<double>* heartbeat_duration_metric_;
 
@@ -434,11 +492,11 @@ class Statestore {
   Status OfferUpdate(const ScheduledSubscriberUpdate& update,
       ThreadPool<ScheduledSubscriberUpdate>* thread_pool);
 
-  /// Sends either a heartbeat or topic update message to the subscriber in 'update' at the
-  /// closest possible time to the first member of 'update'.  If is_heartbeat is true,
-  /// sends a heartbeat update, otherwise the set of pending topic updates is sent. Once
-  /// complete, the next update is scheduled and added to the appropriate queue.
-  void DoSubscriberUpdate(bool is_heartbeat, int thread_id,
+  /// Sends a message of kind 'kind' to the subscriber in 'update' at the closest possible
+  /// time to the first member of 'update'. For topic updates, the set of pending updates
+  /// of the regular or the priority topics is sent. Once complete, the next update is
+  /// scheduled and added to the appropriate queue.
+  void DoSubscriberUpdate(UpdateKind kind, int thread_id,
       const ScheduledSubscriberUpdate& update);
 
   /// Does the work of updating a single subscriber, by calling UpdateState() on the client
@@ -450,8 +508,10 @@ class Statestore {
   /// it was not ready to do so or because it was busy. In that case, the UpdateState() RPC
   /// will return OK (since there was no error) and the output parameter update_skipped is
   /// set to true. Otherwise, any updates returned by the subscriber are applied to their
-  /// target topics.
-  Status SendTopicUpdate(Subscriber* subscriber, bool* update_skipped);
+  /// target topics. If 'priority_topics' is true, only the subscribed topics in
+  /// 'priority_topics_' are sent, otherwise only the others are.
+  Status SendTopicUpdate(Subscriber* subscriber, bool priority_topics,
+      bool* update_skipped);
 
   /// Sends a heartbeat message to subscriber. Returns false if there was some error
   /// performing the RPC.
@@ -463,9 +523,23 @@ class Statestore {
 
   /// Populates a TUpdateStateRequest with the update state for this subscriber. Iterates
   /// over all updates in all subscribed topics, populating the given TUpdateStateRequest
-  /// object. Takes the topic_lock_ and subscribers_lock_.
-  void GatherTopicUpdates(const Subscriber& subscriber,
-      TUpdateStateRequest* update_state_request);
+  /// object. Takes the topic_lock_ and subscribers_lock_. 'priority_topics' selects the
+  /// topics as for SendTopicUpdate(). Full updates of large topics are left out if
+  /// FLAGS_statestore_max_concurrent_full_topic_updates are already being sent. Sets
+  /// 'num_full_updates' to the number of full updates that were included, which the
+  /// caller must subtract from 'num_full_topic_updates_in_flight_' once they were sent.
+  void GatherTopicUpdates(const Subscriber& subscriber, bool priority_topics,
+      TUpdateStateRequest* update_state_request, int* num_full_updates);
+
+  /// Increments 'priority_topic_generation_' and wakes up the priority update threads.
+  void NotifyPriorityTopicChange();
+
+  /// Called by priority update threads instead of sleeping until 'deadline_ms'. Returns
+  /// early if the priority topics changed since they were last sent to 'subscriber_id'.
+  void WaitForPriorityUpdate(int64_t deadline_ms, const SubscriberId& subscriber_id);
+
+  /// Returns true if any of 'topic_registrations' is a priority topic.
+  bool HasPriorityTopic(const std::vector<TTopicRegistration>& topic_registrations) const;
 
   /// Returns the minimum last processed topic version across all subscribers for the given
   /// topic ID. Calculated by enumerating all subscribers and looking at their
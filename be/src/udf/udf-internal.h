@@ -94,6 +94,9 @@ class FunctionContextImpl {
 
   std::vector<impala_udf::AnyVal*>* staging_input_vals() { return &staging_input_vals_; }
 
+  /// The batch function registered with FunctionContext::SetBatchFunction(), or NULL.
+  impala_udf::UdfBatchEvaluate batch_fn() const { return batch_fn_; }
+
   bool debug() { return debug_; }
   bool closed() { return closed_; }
 
@@ -166,6 +169,9 @@ class FunctionContextImpl {
   void* thread_local_fn_state_;
   void* fragment_local_fn_state_;
 
+  /// The batch version of the UDF, set via FunctionContext::SetBatchFunction().
+  impala_udf::UdfBatchEvaluate batch_fn_;
+
   /// The number of bytes allocated externally by the user function. In some cases,
   /// it is too inconvenient to use the Allocate()/Free() APIs in the FunctionContext,
   /// particularly for existing codebases (e.g. they use std::vector). Instead, they'll
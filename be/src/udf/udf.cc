@@ -152,6 +152,7 @@ FunctionContext* FunctionContextImpl::Clone(MemPool* pool) {
           varargs_buffer_size_, debug_);
   new_context->impl_->constant_args_ = constant_args_;
   new_context->impl_->fragment_local_fn_state_ = fragment_local_fn_state_;
+  new_context->impl_->batch_fn_ = batch_fn_;
   return new_context;
 }
 
@@ -177,6 +178,7 @@ FunctionContextImpl::FunctionContextImpl(FunctionContext* parent)
     num_removes_(0),
     thread_local_fn_state_(NULL),
     fragment_local_fn_state_(NULL),
+    batch_fn_(NULL),
     external_bytes_tracked_(0),
     closed_(false) {
 }
@@ -416,6 +418,11 @@ void FunctionContext::SetFunctionState(FunctionStateScope scope, void* ptr) {
   }
 }
 
+void FunctionContext::SetBatchFunction(UdfBatchEvaluate fn) {
+  assert(!impl_->closed_);
+  impl_->batch_fn_ = fn;
+}
+
 uint8_t* FunctionContextImpl::AllocateLocal(int byte_size) noexcept {
   assert(!closed_);
   if (byte_size == 0) return NULL;
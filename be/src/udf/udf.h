@@ -41,6 +41,12 @@ struct BigIntVal;
 struct StringVal;
 struct TimestampVal;
 
+class FunctionContext;
+
+/// The batch version of a UDF, see the UDFs section below.
+typedef void (*UdfBatchEvaluate)(FunctionContext* context, int num_rows,
+    const AnyVal* const* args, AnyVal* results);
+
 /// A FunctionContext is passed to every UDF/UDA and is the interface for the UDF to the
 /// rest of the system. It contains APIs to examine the system state, report errors and
 /// manage memory.
@@ -175,6 +181,10 @@ class FunctionContext {
   void SetFunctionState(FunctionStateScope scope, void* ptr);
   void* GetFunctionState(FunctionStateScope scope) const;
 
+  /// Registers 'fn' as the batch version of the UDF (see UdfBatchEvaluate). This should
+  /// be called from the UDF's prepare function with FRAGMENT_LOCAL scope.
+  void SetBatchFunction(UdfBatchEvaluate fn);
+
   /// Returns the return type information of this function. For UDAs, this is the final
   /// return type of the UDA (e.g., the type returned by the finalize function).
   const TypeDesc& GetReturnType() const;
@@ -305,6 +315,31 @@ typedef void (*UdfPrepare)(FunctionContext* context,
 typedef void (*UdfClose)(FunctionContext* context,
                          FunctionContext::FunctionStateScope scope);
 
+/// -------- Batch Functions --------
+/// ---------------------------------
+/// A UDF can optionally provide a batch function that evaluates it for many rows in one
+/// call, which avoids the per-row call overhead for UDFs loaded from a .so. It is
+/// registered with FunctionContext::SetBatchFunction() in the prepare function. Impala
+/// may call either the UDF or the batch function for any row, so both must return the
+/// same results. Currently, the batch function is used by BOOLEAN UDFs that are
+/// evaluated as a predicate of a scan or a SELECT node. Variadic UDFs cannot have a
+/// batch function.
+///
+/// 'args' contains one array per argument. args[i] points to 'num_rows' values of the
+/// type of the i-th argument, e.g. it is a 'const IntVal*' for an INT argument. The
+/// batch function sets the 'num_rows' values of the return type in 'results', e.g. it
+/// is a 'BooleanVal*' for a BOOLEAN UDF. NULLs are indicated by 'is_null' of each value.
+/// The memory management rules of the UDF apply to the batch function.
+/// An example batch function for 'BooleanVal IsEven(FunctionContext*, const IntVal&)':
+///   void IsEvenBatch(FunctionContext* context, int num_rows,
+///       const AnyVal* const* args, AnyVal* results) {
+///     const IntVal* vals = static_cast<const IntVal*>(args[0]);
+///     BooleanVal* is_even = static_cast<BooleanVal*>(results);
+///     for (int i = 0; i < num_rows; ++i) {
+///       is_even[i] = vals[i].is_null ? BooleanVal::null() : vals[i].val % 2 == 0;
+///     }
+///   }
+
 //----------------------------------------------------------------------------
 //------------------------------- UDAs ---------------------------------------
 //----------------------------------------------------------------------------
@@ -112,6 +112,14 @@ class BitReader {
   template<typename T>
   bool GetValue(int num_bits, T* v);
 
+  /// Reads up to 'num_values' values of 'num_bits' bits each into 'v'. Returns the number
+  /// of values read, which is less than 'num_values' only if there are not enough bytes
+  /// left. num_bits must be <= 32. Once the stream is byte-aligned, values are unpacked
+  /// in groups of 32 with code specialized for each bit width, which is much faster than
+  /// calling GetValue() for each value.
+  template<typename T>
+  int GetValues(int num_bits, T* v, int num_values);
+
   /// Reads a 'num_bytes'-sized value from the buffer and stores it in 'v'. T needs to be a
   /// little-endian native type and big enough to store 'num_bytes'. The value is assumed
   /// to be byte-aligned so the stream will be advanced to the start of the next byte
@@ -131,6 +139,17 @@ class BitReader {
   static const int MAX_VLQ_BYTE_LEN = 5;
 
  private:
+  /// Unpacks 32 values of NUM_BITS bits each from the 4 * NUM_BITS bytes at 'in' into
+  /// 'out'. Loads 8 bytes at a time, so up to 8 bytes past the end of the packed values
+  /// may be read and must be valid memory.
+  template<typename T, int NUM_BITS>
+  static void Unpack32Values(const uint8_t* in, T* out);
+
+  /// Calls Unpack32Values() for 'num_groups' consecutive groups of values, dispatching
+  /// on the runtime bit width 'num_bits'.
+  template<typename T>
+  static void UnpackGroups(int num_bits, int num_groups, const uint8_t* in, T* out);
+
   uint8_t* buffer_;
   int max_bytes_;
 
@@ -16,6 +16,9 @@
 #ifndef IMPALA_UTIL_BIT_STREAM_UTILS_INLINE_H
 #define IMPALA_UTIL_BIT_STREAM_UTILS_INLINE_H
 
+#include <algorithm>
+#include <boost/preprocessor/repetition/repeat_from_to.hpp>
+
 #include "util/bit-stream-utils.h"
 
 namespace impala {
@@ -112,6 +115,80 @@ inline bool BitReader::GetValue(int num_bits, T* v) {
   return true;
 }
 
+template<typename T>
+inline int BitReader::GetValues(int num_bits, T* v, int num_values) {
+  DCHECK(buffer_ != NULL);
+  DCHECK_LE(num_bits, 32);
+  DCHECK_LE(num_bits, sizeof(T) * 8);
+
+  if (UNLIKELY(num_bits == 0)) {
+    // Zero-width values take up no space and are always available.
+    memset(v, 0, num_values * sizeof(T));
+    return num_values;
+  }
+
+  int i = 0;
+  // Read single values until the next value starts on a byte boundary.
+  for (; i < num_values && bit_offset_ % 8 != 0; ++i) {
+    if (UNLIKELY(!GetValue(num_bits, &v[i]))) return i;
+  }
+
+  // Unpack as many groups of 32 values as possible. Unpack32Values() loads 8 bytes at a
+  // time, so leave 8 bytes of slack at the end of the buffer.
+  int byte_pos = byte_offset_ + bit_offset_ / 8;
+  int group_bytes = 4 * num_bits;
+  int num_groups =
+      std::min((num_values - i) / 32, (max_bytes_ - byte_pos - 8) / group_bytes);
+  if (num_groups > 0) {
+    UnpackGroups(num_bits, num_groups, buffer_ + byte_pos, v + i);
+    i += num_groups * 32;
+    byte_offset_ = byte_pos + num_groups * group_bytes;
+    bit_offset_ = 0;
+    int bytes_remaining = max_bytes_ - byte_offset_;
+    if (LIKELY(bytes_remaining >= 8)) {
+      memcpy(&buffered_values_, buffer_ + byte_offset_, 8);
+    } else {
+      memcpy(&buffered_values_, buffer_ + byte_offset_, bytes_remaining);
+    }
+  }
+
+  // Read the remaining values one at a time.
+  for (; i < num_values; ++i) {
+    if (UNLIKELY(!GetValue(num_bits, &v[i]))) return i;
+  }
+  return num_values;
+}
+
+template<typename T, int NUM_BITS>
+inline void BitReader::Unpack32Values(const uint8_t* in, T* out) {
+  const uint64_t mask = (1ULL << NUM_BITS) - 1;
+  // All offsets are compile-time constants, so the compiler fully unrolls this loop into
+  // a load, shift and mask for each value.
+  for (int i = 0; i < 32; ++i) {
+    const int bit_offset = i * NUM_BITS;
+    uint64_t word;
+    memcpy(&word, in + bit_offset / 8, sizeof(word));
+    out[i] = static_cast<T>((word >> (bit_offset % 8)) & mask);
+  }
+}
+
+template<typename T>
+inline void BitReader::UnpackGroups(int num_bits, int num_groups, const uint8_t* in,
+    T* out) {
+  switch (num_bits) {
+#define UNPACK_GROUPS_CASE(ignore1, i, ignore2) \
+    case i: \
+      for (int g = 0; g < num_groups; ++g) { \
+        Unpack32Values<T, i>(in + g * 4 * i, out + g * 32); \
+      } \
+      return;
+    BOOST_PP_REPEAT_FROM_TO(1, 33, UNPACK_GROUPS_CASE, ignore);
+#undef UNPACK_GROUPS_CASE
+    default:
+      DCHECK(false) << "Invalid bit width: " << num_bits;
+  }
+}
+
 template<typename T>
 inline bool BitReader::GetAligned(int num_bytes, T* v) {
   DCHECK_LE(num_bytes, sizeof(T));
@@ -111,6 +111,29 @@ TEST(BloomFilter, CumulativeFind) {
   }
 }
 
+// FindBatch() gives the same results as Find(), with and without AVX2.
+TEST(BloomFilter, FindBatch) {
+  srand(0);
+  BloomFilter bf(BloomFilter::MinLogSpace(1000, 0.1));
+  vector<uint32_t> hashes;
+  for (int k = 0; k < 1000; ++k) {
+    hashes.push_back(MakeRand());
+    BfInsert(bf, hashes.back());
+    hashes.push_back(MakeRand());
+  }
+  vector<uint8_t> found(hashes.size());
+  for (bool disable_avx2: {false, true}) {
+    CpuInfo::TempDisable t(disable_avx2 ? CpuInfo::AVX2 : 0);
+    // Use a batch size that is not a multiple of the prefetch distance.
+    for (int n: {0, 1, 7, static_cast<int>(hashes.size())}) {
+      found.assign(hashes.size(), 2);
+      bf.FindBatch(&hashes[0], n, &found[0]);
+      for (int i = 0; i < n; ++i) ASSERT_EQ(found[i], bf.Find(hashes[i])) << i;
+      for (int i = n; i < hashes.size(); ++i) ASSERT_EQ(found[i], 2) << i;
+    }
+  }
+}
+
 // The empirical false positives we find when looking for random items is with a constant
 // factor of the false positive probability the Bloom filter was constructed for.
 TEST(BloomFilter, FindInvalid) {
@@ -261,6 +284,100 @@ TEST(BloomFilter, Or) {
   ASSERT_FALSE(BfFind(bf2, 81));
 }
 
+TEST(BloomFilter, OrThrift) {
+  BloomFilter bf1(BloomFilter::MinLogSpace(100, 0.01));
+  BloomFilter bf2(BloomFilter::MinLogSpace(100, 0.01));
+  for (int i = 0; i < 10; ++i) BfInsert(bf1, i);
+  for (int i = 60; i < 80; ++i) BfInsert(bf2, i);
+
+  TBloomFilter thrift;
+  BloomFilter::ToThrift(&bf1, &thrift);
+  bf2.Or(thrift);
+  for (int i = 0; i < 10; ++i) ASSERT_TRUE(BfFind(bf2, i));
+  for (int i = 60; i < 80; ++i) ASSERT_TRUE(BfFind(bf2, i));
+  ASSERT_FALSE(BfFind(bf2, 81));
+}
+
+TEST(BloomFilter, MayIntersect) {
+  BloomFilter bf1(BloomFilter::MinLogSpace(100, 0.01));
+  BloomFilter bf2(BloomFilter::MinLogSpace(1000, 0.01));
+  for (int i = 0; i < 10; ++i) BfInsert(bf1, i);
+  for (int i = 100; i < 110; ++i) BfInsert(bf2, i);
+  // Inserting few elements into each filter leaves most buckets empty, so the sets are
+  // recognized as disjoint.
+  EXPECT_FALSE(bf1.MayIntersect(bf2));
+  EXPECT_FALSE(bf2.MayIntersect(bf1));
+
+  BfInsert(bf2, 5);
+  EXPECT_TRUE(bf1.MayIntersect(bf2));
+  EXPECT_TRUE(bf2.MayIntersect(bf1));
+}
+
+TEST(BloomFilter, FoldToThrift) {
+  const int log_space = BloomFilter::MinLogSpace(10000, 0.01);
+  BloomFilter bf(log_space);
+  for (int i = 0; i < 100; ++i) BfInsert(bf, i);
+
+  TBloomFilter to_thrift;
+  bf.FoldToThrift(log_space - 3, &to_thrift);
+  EXPECT_EQ(to_thrift.log_heap_space, log_space - 3);
+  EXPECT_EQ(to_thrift.directory.size(), 1LL << (log_space - 3));
+  BloomFilter folded(to_thrift);
+  for (int i = 0; i < 100; ++i) ASSERT_TRUE(BfFind(folded, i));
+
+  // Folding to the same size keeps the filter unchanged.
+  bf.FoldToThrift(log_space, &to_thrift);
+  TBloomFilter unfolded;
+  BloomFilter::ToThrift(&bf, &unfolded);
+  EXPECT_EQ(to_thrift.directory, unfolded.directory);
+}
+
+TEST(BloomFilter, Fold) {
+  const int log_space = BloomFilter::MinLogSpace(10000, 0.01);
+  BloomFilter bf(log_space);
+  for (int i = 0; i < 100; ++i) BfInsert(bf, i);
+
+  // Folding in place gives the same filter as folding to Thrift.
+  TBloomFilter to_thrift;
+  bf.FoldToThrift(log_space - 3, &to_thrift);
+  bf.Fold(log_space - 3);
+  EXPECT_EQ(bf.GetHeapSpaceUsed(), 1LL << (log_space - 3));
+  TBloomFilter folded;
+  BloomFilter::ToThrift(&bf, &folded);
+  EXPECT_EQ(to_thrift.directory, folded.directory);
+  for (int i = 0; i < 100; ++i) ASSERT_TRUE(BfFind(bf, i));
+
+  // The folded filter can still be updated.
+  for (int i = 100; i < 200; ++i) BfInsert(bf, i);
+  for (int i = 0; i < 200; ++i) ASSERT_TRUE(BfFind(bf, i));
+}
+
+TEST(BloomFilter, EstimateNdv) {
+  BloomFilter empty(BloomFilter::MinLogSpace(1000, 0.01));
+  EXPECT_EQ(empty.EstimateNdv(), 0);
+
+  for (int ndv: {1000, 10000, 100000}) {
+    BloomFilter bf(BloomFilter::MinLogSpace(ndv, 0.01));
+    unordered_set<uint32_t> inserted;
+    while (inserted.size() < ndv) {
+      uint32_t value = MakeRand();
+      inserted.insert(value);
+      BfInsert(bf, value);
+    }
+    // Inserting the same values again does not change the estimate.
+    int64_t estimate = bf.EstimateNdv();
+    for (uint32_t value: inserted) BfInsert(bf, value);
+    EXPECT_EQ(estimate, bf.EstimateNdv());
+    EXPECT_GT(estimate, ndv * 0.9) << ndv;
+    EXPECT_LT(estimate, ndv * 1.1) << ndv;
+  }
+
+  // A saturated filter cannot estimate the NDV.
+  BloomFilter full(BloomFilter::MinLogSpace(1, 0.01));
+  for (int i = 0; i < 100000; ++i) BfInsert(full, i);
+  EXPECT_EQ(full.EstimateNdv(), numeric_limits<int64_t>::max());
+}
+
 }  // namespace impala
 
 int main(int argc, char** argv) {
@@ -80,6 +80,37 @@ void BloomFilter::ToThrift(const BloomFilter* filter, TBloomFilter* thrift) {
   filter->ToThrift(thrift);
 }
 
+void BloomFilter::FindBatch(const uint32_t* hashes, int num_hashes,
+    uint8_t* found) const {
+  if (CpuInfo::IsSupported(CpuInfo::AVX2)) {
+    FindBatchAVX2(hashes, num_hashes, found);
+    return;
+  }
+  for (int i = 0; i < num_hashes; ++i) {
+    if (i + FIND_BATCH_PREFETCH_DISTANCE < num_hashes) {
+      __builtin_prefetch(
+          &directory_[BucketIdx(hashes[i + FIND_BATCH_PREFETCH_DISTANCE])], 0, 1);
+    }
+    found[i] = BucketFind(BucketIdx(hashes[i]), hashes[i]);
+  }
+}
+
+void BloomFilter::FindBatchAVX2(const uint32_t* hashes, int num_hashes,
+    uint8_t* found) const {
+  const __m256i* directory = reinterpret_cast<const __m256i*>(directory_);
+  for (int i = 0; i < num_hashes; ++i) {
+    if (i + FIND_BATCH_PREFETCH_DISTANCE < num_hashes) {
+      __builtin_prefetch(
+          &directory[BucketIdx(hashes[i + FIND_BATCH_PREFETCH_DISTANCE])], 0, 1);
+    }
+    // See BucketFindAVX2().
+    const __m256i mask = MakeMask(hashes[i]);
+    found[i] = _mm256_testc_si256(directory[BucketIdx(hashes[i])], mask);
+  }
+  // Only clear the upper halves of the YMM registers once for the whole batch.
+  _mm256_zeroupper();
+}
+
 void BloomFilter::Or(const BloomFilter& other) {
   DCHECK_EQ(log_num_buckets_, other.log_num_buckets_);
   BucketWord* dir_ptr = reinterpret_cast<BucketWord*>(directory_);
@@ -89,6 +120,97 @@ void BloomFilter::Or(const BloomFilter& other) {
   for (int i = 0; i < directory_size_in_words; ++i) dir_ptr[i] |= other_dir_ptr[i];
 }
 
+void BloomFilter::Or(const TBloomFilter& thrift) {
+  DCHECK(!thrift.always_true);
+  DCHECK_EQ(thrift.log_heap_space, log_num_buckets_ + LOG_BUCKET_BYTE_SIZE);
+  DCHECK_EQ(thrift.directory.size(), directory_size());
+  BucketWord* dir_ptr = reinterpret_cast<BucketWord*>(directory_);
+  // The string data is not necessarily aligned, so copy the words byte-wise.
+  const char* other_dir_ptr = thrift.directory.data();
+  int directory_size_in_words = directory_size() / sizeof(BucketWord);
+  for (int i = 0; i < directory_size_in_words; ++i) {
+    BucketWord word;
+    memcpy(&word, other_dir_ptr + i * sizeof(BucketWord), sizeof(BucketWord));
+    dir_ptr[i] |= word;
+  }
+}
+
+bool BloomFilter::MayIntersect(const BloomFilter& other) const {
+  const BloomFilter* large = this;
+  const BloomFilter* small = &other;
+  if (large->log_num_buckets_ < small->log_num_buckets_) swap(large, small);
+  // An element that was inserted into both filters set one bit in every word of its
+  // bucket in both of them. The bucket index in the smaller filter is the index in the
+  // larger filter, masked with the smaller directory_mask_.
+  const uint64_t num_buckets = 1ULL << large->log_num_buckets_;
+  for (uint64_t i = 0; i < num_buckets; ++i) {
+    const Bucket& large_bucket = large->directory_[i];
+    const Bucket& small_bucket = small->directory_[i & small->directory_mask_];
+    bool all_words_intersect = true;
+    for (int j = 0; j < BUCKET_WORDS; ++j) {
+      if ((large_bucket[j] & small_bucket[j]) == 0) {
+        all_words_intersect = false;
+        break;
+      }
+    }
+    if (all_words_intersect) return true;
+  }
+  return false;
+}
+
+void BloomFilter::FoldToThrift(int log_heap_space, TBloomFilter* thrift) const {
+  const int log_num_buckets = std::max(1, log_heap_space - LOG_BUCKET_BYTE_SIZE);
+  DCHECK_LE(log_num_buckets, log_num_buckets_);
+  const uint64_t num_buckets = 1ULL << log_num_buckets;
+  thrift->log_heap_space = log_num_buckets + LOG_BUCKET_BYTE_SIZE;
+  thrift->directory.assign(
+      reinterpret_cast<const char*>(directory_), num_buckets * sizeof(Bucket));
+  thrift->always_true = false;
+  // Bucket indexes are masked with directory_mask_, so the elements of bucket i are in
+  // bucket (i & (num_buckets - 1)) of the smaller filter.
+  BucketWord* folded = reinterpret_cast<BucketWord*>(&thrift->directory[0]);
+  for (uint64_t i = num_buckets; i < (1ULL << log_num_buckets_); ++i) {
+    BucketWord* folded_bucket = folded + (i & (num_buckets - 1)) * BUCKET_WORDS;
+    for (int j = 0; j < BUCKET_WORDS; ++j) folded_bucket[j] |= directory_[i][j];
+  }
+}
+
+void BloomFilter::Fold(int log_heap_space) {
+  const int log_num_buckets = std::max(1, log_heap_space - LOG_BUCKET_BYTE_SIZE);
+  DCHECK_LE(log_num_buckets, log_num_buckets_);
+  if (log_num_buckets == log_num_buckets_) return;
+  const uint64_t num_buckets = 1ULL << log_num_buckets;
+  Bucket* folded = NULL;
+  const int malloc_failed = posix_memalign(
+      reinterpret_cast<void**>(&folded), 64, num_buckets * sizeof(Bucket));
+  DCHECK_EQ(malloc_failed, 0) << "Malloc failed. log_heap_space: " << log_heap_space;
+  memcpy(folded, directory_, num_buckets * sizeof(Bucket));
+  for (uint64_t i = num_buckets; i < (1ULL << log_num_buckets_); ++i) {
+    Bucket& folded_bucket = folded[i & (num_buckets - 1)];
+    for (int j = 0; j < BUCKET_WORDS; ++j) folded_bucket[j] |= directory_[i][j];
+  }
+  free(directory_);
+  directory_ = folded;
+  log_num_buckets_ = log_num_buckets;
+  directory_mask_ = num_buckets - 1;
+}
+
+int64_t BloomFilter::EstimateNdv() const {
+  const BucketWord* dir_ptr = reinterpret_cast<const BucketWord*>(directory_);
+  const int64_t directory_size_in_words = directory_size() / sizeof(BucketWord);
+  int64_t bits_set = 0;
+  for (int64_t i = 0; i < directory_size_in_words; ++i) {
+    bits_set += __builtin_popcount(dir_ptr[i]);
+  }
+  // Every element sets one of the 32 bits of each word of its bucket, so a bit stays
+  // unset with probability (1 - 1 / (32 * num_buckets)) ^ ndv.
+  const double bits_per_word = 1 << LOG_BUCKET_WORD_BITS;
+  const double total_bits = directory_size_in_words * bits_per_word;
+  if (bits_set == total_bits) return numeric_limits<int64_t>::max();
+  const double num_slots = bits_per_word * (1ULL << log_num_buckets_);
+  return static_cast<int64_t>(-num_slots * log(1 - bits_set / total_bits) + 0.5);
+}
+
 // The following three methods are derived from
 //
 // fpp = (1 - exp(-BUCKET_WORDS * ndv/space))^BUCKET_WORDS
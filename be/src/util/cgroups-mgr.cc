@@ -16,8 +16,12 @@
 
 #include <fstream>
 #include <sstream>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <boost/algorithm/string.hpp>
 #include <boost/filesystem.hpp>
 #include "util/debug-util.h"
+#include "util/string-parser.h"
 #include <gutil/strings/substitute.h>
 
 #include "common/names.h"
@@ -37,7 +41,15 @@ const std::string IMPALA_CGROUP_SUFFIX = "_impala";
 // See Yarn's CgroupsLCEResourcesHandler.java for more details.
 const int32_t CPU_DEFAULT_WEIGHT = 1024;
 
-CgroupsMgr::CgroupsMgr(MetricGroup* metrics) {
+// Prefix of the names of the cgroups of request pools.
+const std::string POOL_CGROUP_PREFIX = "impala_pool_";
+
+// Length of a CFS period for CPU quotas, in microseconds (the kernel's default).
+const int64_t CPU_QUOTA_PERIOD_US = 100000;
+
+CgroupsMgr::CgroupsMgr(MetricGroup* metrics)
+  : pool_cgroups_enabled_(false),
+    default_pool_cpu_shares_(CPU_DEFAULT_WEIGHT) {
   active_cgroups_metric_ = metrics->AddGauge<int64_t>("cgroups-mgr.active-cgroups", 0);
 }
 
@@ -50,6 +62,68 @@ Status CgroupsMgr::Init(const string& cgroups_hierarchy_path,
   return Status::OK();
 }
 
+Status CgroupsMgr::InitPoolCgroups(const string& cpu_shares,
+    int32_t default_cpu_shares, const string& cpu_quota_pct) {
+  RETURN_IF_ERROR(ParsePoolValues(cpu_shares, &pool_cpu_shares_));
+  RETURN_IF_ERROR(ParsePoolValues(cpu_quota_pct, &pool_cpu_quota_pct_));
+  default_pool_cpu_shares_ = default_cpu_shares;
+  pool_cgroups_enabled_ = true;
+  return Status::OK();
+}
+
+Status CgroupsMgr::ParsePoolValues(const string& list,
+    boost::unordered_map<string, int32_t>* values) {
+  if (list.empty()) return Status::OK();
+  vector<string> entries;
+  boost::split(entries, list, boost::is_any_of(","));
+  for (const string& entry: entries) {
+    size_t colon = entry.rfind(':');
+    StringParser::ParseResult result = StringParser::PARSE_FAILURE;
+    int32_t value = 0;
+    if (colon != string::npos && colon > 0) {
+      value = StringParser::StringToInt<int32_t>(entry.c_str() + colon + 1,
+          entry.size() - colon - 1, &result);
+    }
+    if (result != StringParser::PARSE_SUCCESS || value <= 0) {
+      return Status(Substitute("Invalid request pool cgroup setting '$0'. Expected "
+          "<pool>:<positive integer>.", entry));
+    }
+    (*values)[entry.substr(0, colon)] = value;
+  }
+  return Status::OK();
+}
+
+Status CgroupsMgr::GetPoolCgroup(const string& pool, string* cgroup) {
+  DCHECK(pool_cgroups_enabled_);
+  lock_guard<mutex> l(pool_cgroups_lock_);
+  boost::unordered_map<string, string>::const_iterator it = pool_cgroups_.find(pool);
+  if (it != pool_cgroups_.end()) {
+    *cgroup = it->second;
+    return Status::OK();
+  }
+
+  // Pool names are dot-separated paths, e.g. "root.etl", but must not create nested
+  // directories.
+  string pool_cgroup = POOL_CGROUP_PREFIX + pool;
+  for (int i = POOL_CGROUP_PREFIX.size(); i < pool_cgroup.size(); ++i) {
+    char c = pool_cgroup[i];
+    if (!isalnum(c) && c != '.' && c != '-' && c != '_') pool_cgroup[i] = '_';
+  }
+  RETURN_IF_ERROR(CreateCgroup(pool_cgroup, true));
+  boost::unordered_map<string, int32_t>::const_iterator shares =
+      pool_cpu_shares_.find(pool);
+  RETURN_IF_ERROR(SetCpuShares(pool_cgroup,
+      shares != pool_cpu_shares_.end() ? shares->second : default_pool_cpu_shares_));
+  boost::unordered_map<string, int32_t>::const_iterator quota =
+      pool_cpu_quota_pct_.find(pool);
+  if (quota != pool_cpu_quota_pct_.end()) {
+    RETURN_IF_ERROR(SetCpuQuota(pool_cgroup, quota->second));
+  }
+  pool_cgroups_[pool] = pool_cgroup;
+  *cgroup = pool_cgroup;
+  return Status::OK();
+}
+
 string CgroupsMgr::UniqueIdToCgroup(const string& unique_id) const {
   if (unique_id.empty()) return "";
   return unique_id + IMPALA_CGROUP_SUFFIX;
@@ -98,21 +172,32 @@ Status CgroupsMgr::DropCgroup(const string& cgroup, bool if_exists) const {
 }
 
 Status CgroupsMgr::SetCpuShares(const string& cgroup, int32_t num_shares) {
+  LOG(INFO) << "Setting CPU shares of CGroup " << cgroup << " to " << num_shares;
+  return WriteCgroupFile(cgroup, "cpu.shares", num_shares);
+}
+
+Status CgroupsMgr::SetCpuQuota(const string& cgroup, int32_t quota_pct) {
+  LOG(INFO) << "Setting CPU quota of CGroup " << cgroup << " to " << quota_pct
+            << "% of a core";
+  RETURN_IF_ERROR(WriteCgroupFile(cgroup, "cpu.cfs_period_us", CPU_QUOTA_PERIOD_US));
+  return WriteCgroupFile(
+      cgroup, "cpu.cfs_quota_us", CPU_QUOTA_PERIOD_US * quota_pct / 100);
+}
+
+Status CgroupsMgr::WriteCgroupFile(const string& cgroup, const string& file_name,
+    int64_t value) const {
   string cgroup_path;
   string tasks_path;
   RETURN_IF_ERROR(GetCgroupPaths(cgroup, &cgroup_path, &tasks_path));
 
-  const string& cpu_shares_path = Substitute("$0/$1", cgroup_path, "cpu.shares");
-  ofstream cpu_shares(tasks_path.c_str(), ios::out | ios::trunc);
-  if (!cpu_shares.is_open()) {
+  const string& file_path = Substitute("$0/$1", cgroup_path, file_name);
+  ofstream file(file_path.c_str(), ios::out | ios::trunc);
+  if (!file.is_open()) {
     stringstream err_msg;
-    err_msg << "CGroup CPU shares file: " << cpu_shares_path
-            << " is not writable by Impala";
+    err_msg << "CGroup file: " << file_path << " is not writable by Impala";
     return Status(err_msg.str());
   }
-
-  LOG(INFO) << "Setting CPU shares of CGroup " << cgroup_path << " to " << num_shares;
-  cpu_shares << num_shares << endl;
+  file << value << endl;
   return Status::OK();
 }
 
@@ -140,6 +225,14 @@ Status CgroupsMgr::GetCgroupPaths(const std::string& cgroup,
 
 Status CgroupsMgr::AssignThreadToCgroup(const Thread& thread,
     const string& cgroup) const {
+  return AssignTidToCgroup(thread.tid(), cgroup);
+}
+
+Status CgroupsMgr::AssignCurrentThreadToCgroup(const string& cgroup) const {
+  return AssignTidToCgroup(syscall(SYS_gettid), cgroup);
+}
+
+Status CgroupsMgr::AssignTidToCgroup(int64_t tid, const string& cgroup) const {
   string cgroup_path;
   string tasks_path;
   RETURN_IF_ERROR(GetCgroupPaths(cgroup, &cgroup_path, &tasks_path));
@@ -150,9 +243,9 @@ Status CgroupsMgr::AssignThreadToCgroup(const Thread& thread,
     err_msg << "CGroup tasks file: " << tasks_path << " is not writable by Impala";
     return Status(err_msg.str());
   }
-  tasks << thread.tid() << endl;
+  tasks << tid << endl;
 
-  VLOG_ROW << "Thread " << thread.tid() << " moved to CGroup " << cgroup_path;
+  VLOG_ROW << "Thread " << tid << " moved to CGroup " << cgroup_path;
   tasks.close();
   return Status::OK();
 }
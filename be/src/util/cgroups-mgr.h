@@ -76,6 +76,15 @@ namespace impala {
 ///    from that CGroup are relocated into a special staging CGroup, so that the now
 ///    unused CGroup can safely be deleted (otherwise, we'd have to wait for the OS to
 ///    drain all entries from the CGroup's tasks file)
+//
+/// Without resource management, the cgroups mgr can instead give each admission control
+/// request pool its own cgroup (see InitPoolCgroups()), with configurable CPU shares and
+/// an optional CPU quota, so that e.g. ETL queries cannot starve interactive ones. The
+/// fragment threads of a query and the scanner and join build threads they start are
+/// placed into the cgroup of the query's pool. Threads of process-wide thread pools,
+/// e.g. the I/O mgr's disk threads, serve queries of all pools and stay where they are.
+/// Pool cgroups are created on first use and kept for the lifetime of the process; the
+/// threads of a query leave them when they exit.
 class CgroupsMgr {
  public:
   CgroupsMgr(MetricGroup* metrics);
@@ -86,6 +95,22 @@ class CgroupsMgr {
   Status Init(const std::string& cgroups_hierarchy_path,
       const std::string& staging_cgroup);
 
+  /// Enables per-pool cgroups. Must be called after Init(). 'cpu_shares' and
+  /// 'cpu_quota_pct' are comma-separated lists of <pool>:<value>. Pools without
+  /// explicit shares get 'default_cpu_shares'. The CPU quota of a pool is a percentage
+  /// of one core, e.g. 400 allows four cores' worth of CPU time; pools without one are
+  /// not capped. Returns an error if a list cannot be parsed.
+  Status InitPoolCgroups(const std::string& cpu_shares, int32_t default_cpu_shares,
+      const std::string& cpu_quota_pct);
+
+  /// True if InitPoolCgroups() was called.
+  bool pool_cgroups_enabled() const { return pool_cgroups_enabled_; }
+
+  /// Returns the cgroup for the request pool 'pool' in *cgroup, and creates it and sets
+  /// its CPU shares and quota when it is first requested. Returns an error if that
+  /// failed, e.g., because of insufficient privileges.
+  Status GetPoolCgroup(const std::string& pool, std::string* cgroup);
+
   /// Returns the cgroup Impala should create and use for enforcing granted resources
   /// identified by the given unique ID (which usually corresponds to a query ID). Returns
   /// an empty string if unique_id is empty.
@@ -127,6 +152,11 @@ class CgroupsMgr {
   /// to the file, e.g., because of insufficient privileges.
   Status SetCpuShares(const std::string& cgroup, int32_t num_shares);
 
+  /// Caps the CPU time of the given cgroup at 'quota_pct' percent of one core by
+  /// writing its cpu.cfs_period_us and cpu.cfs_quota_us files. Returns a non-OK status
+  /// if there was an error writing to the files.
+  Status SetCpuQuota(const std::string& cgroup, int32_t quota_pct);
+
   /// Assigns a given thread to a cgroup, by writing its thread id to
   /// <cgroups_hierarchy_path_>/<cgroup>/tasks. If there is no file at that
   /// location, returns an error. Otherwise no attempt is made to check that the
@@ -134,6 +164,9 @@ class CgroupsMgr {
   /// cgroup information from the filesystem.
   Status AssignThreadToCgroup(const Thread& thread, const std::string& cgroup) const;
 
+  /// Assigns the calling thread to a cgroup, like AssignThreadToCgroup().
+  Status AssignCurrentThreadToCgroup(const std::string& cgroup) const;
+
   /// Reads the <cgroups_hierarchy_path_>/<src_cgroup>/tasks file and writing all the
   /// contained thread ids to <cgroups_hierarchy_path_>/<dst_cgroup>/tasks.
   /// Assumes that the destination cgroup has already been created. Returns a non-OK
@@ -148,6 +181,17 @@ class CgroupsMgr {
   Status GetCgroupPaths(const std::string& cgroup,
       std::string* cgroup_path, std::string* tasks_path) const;
 
+  /// Writes the thread id 'tid' to the tasks file of 'cgroup'.
+  Status AssignTidToCgroup(int64_t tid, const std::string& cgroup) const;
+
+  /// Writes 'value' to the file 'file_name' of 'cgroup', replacing its contents.
+  Status WriteCgroupFile(const std::string& cgroup, const std::string& file_name,
+      int64_t value) const;
+
+  /// Parses a comma-separated list of <pool>:<value> into 'values'.
+  static Status ParsePoolValues(const std::string& list,
+      boost::unordered_map<std::string, int32_t>* values);
+
   /// Number of currently active Impala-managed cgroups.
   IntGauge* active_cgroups_metric_;
 
@@ -165,6 +209,21 @@ class CgroupsMgr {
   /// A cgroup can be safely dropped once the number of fragments in the cgroup,
   /// according to this map, reaches zero.
   boost::unordered_map<std::string, int32_t> active_cgroups_;
+
+  /// Set by InitPoolCgroups().
+  bool pool_cgroups_enabled_;
+
+  /// CPU shares and quotas of request pools, and the shares of the other pools. Set in
+  /// InitPoolCgroups().
+  boost::unordered_map<std::string, int32_t> pool_cpu_shares_;
+  boost::unordered_map<std::string, int32_t> pool_cpu_quota_pct_;
+  int32_t default_pool_cpu_shares_;
+
+  /// Protects pool_cgroups_.
+  boost::mutex pool_cgroups_lock_;
+
+  /// Cgroups of the request pools that were used so far, by pool name.
+  boost::unordered_map<std::string, std::string> pool_cgroups_;
 };
 
 }
@@ -19,16 +19,21 @@
 #endif
 
 #include <boost/algorithm/string.hpp>
+#include <dirent.h>
 #include <iostream>
 #include <fstream>
 #include <gutil/strings/substitute.h>
 #include <mmintrin.h>
+#include <sched.h>
 #include <sstream>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
 #include "util/pretty-printer.h"
+#include "util/stopwatch.h"
+#include "util/time.h"
 
 #include "common/names.h"
 
@@ -41,6 +46,9 @@ DECLARE_bool(abort_on_config_error);
 DEFINE_int32(num_cores, 0, "(Advanced) If > 0, it sets the number of cores available to"
     " Impala. Setting it to 0 means Impala will use all available cores on the machine"
     " according to /proc/cpuinfo.");
+DEFINE_bool(use_tsc_timers, true, "(Advanced) If true, query profile timers read the "
+    "time stamp counter of the cpu instead of the system clock, if the counter ticks at "
+    "a constant rate on all cores.");
 
 namespace impala {
 
@@ -48,7 +56,11 @@ bool CpuInfo::initialized_ = false;
 int64_t CpuInfo::hardware_flags_ = 0;
 int64_t CpuInfo::original_hardware_flags_;
 int64_t CpuInfo::cycles_per_ms_;
+double CpuInfo::ns_per_tsc_tick_ = 0;
 int CpuInfo::num_cores_ = 1;
+int CpuInfo::num_numa_nodes_ = 1;
+vector<int> CpuInfo::core_to_numa_node_;
+vector<vector<int> > CpuInfo::numa_node_to_cores_;
 string CpuInfo::model_name_ = "unknown";
 
 static struct {
@@ -85,6 +97,7 @@ void CpuInfo::Init() {
 
   float max_mhz = 0;
   int num_cores = 0;
+  bool invariant_tsc = false;
 
   // Read from /proc/cpuinfo
   ifstream cpuinfo("/proc/cpuinfo", ios::in);
@@ -98,6 +111,9 @@ void CpuInfo::Init() {
       trim(value);
       if (name.compare("flags") == 0) {
         hardware_flags_ |= ParseCPUFlags(value);
+        // The counter must neither change its rate with the frequency of the core nor
+        // stop in idle states.
+        invariant_tsc = contains(value, "constant_tsc") && contains(value, "nonstop_tsc");
       } else if (name.compare("cpu MHz") == 0) {
         // Every core will report a different speed.  We'll take the max, assuming
         // that when impala is running, the core will not be in a lower power state.
@@ -127,11 +143,80 @@ void CpuInfo::Init() {
     num_cores_ = 1;
   }
 
+  // The mapping covers all cores of the machine, not only the ones Impala may use.
+  InitNumaNodes(num_cores_);
   if (FLAGS_num_cores > 0) num_cores_ = FLAGS_num_cores;
+  if (FLAGS_use_tsc_timers && invariant_tsc && ns_per_tsc_tick_ == 0) {
+    ns_per_tsc_tick_ = CalibrateTsc();
+  }
 
   initialized_ = true;
 }
 
+void CpuInfo::InitNumaNodes(int num_cores) {
+  core_to_numa_node_.assign(num_cores, 0);
+  num_numa_nodes_ = 1;
+#ifndef __APPLE__
+  // Each core's directory contains a 'node<N>' link to its NUMA node.
+  for (int core = 0; core < num_cores; ++core) {
+    string path = Substitute("/sys/devices/system/cpu/cpu$0", core);
+    DIR* dir = opendir(path.c_str());
+    if (dir == NULL) continue;
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+      int node;
+      if (sscanf(entry->d_name, "node%d", &node) == 1 && node >= 0) {
+        core_to_numa_node_[core] = node;
+        num_numa_nodes_ = max(num_numa_nodes_, node + 1);
+        break;
+      }
+    }
+    closedir(dir);
+  }
+#endif
+  numa_node_to_cores_.assign(num_numa_nodes_, vector<int>());
+  for (int core = 0; core < num_cores; ++core) {
+    numa_node_to_cores_[core_to_numa_node_[core]].push_back(core);
+  }
+}
+
+double CpuInfo::CalibrateTsc() {
+  // Long enough for the error of the clock reads to be far below 0.1%.
+  const int CALIBRATION_MS = 10;
+  int64_t start_ns = MonotonicNanos();
+  uint64_t start_ticks = TscStopWatch::Rdtsc();
+  SleepForMs(CALIBRATION_MS);
+  int64_t end_ns = MonotonicNanos();
+  uint64_t end_ticks = TscStopWatch::Rdtsc();
+  if (end_ticks <= start_ticks) return 0;
+  return static_cast<double>(end_ns - start_ns) / (end_ticks - start_ticks);
+}
+
+bool CpuInfo::BindCurrentThreadToNumaNode(int node) {
+  DCHECK(initialized_);
+  if (node < 0 || node >= num_numa_nodes_) return false;
+#ifdef __APPLE__
+  return false;
+#else
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  for (int core: numa_node_to_cores_[node]) {
+    if (core < CPU_SETSIZE) CPU_SET(core, &cpus);
+  }
+  if (CPU_COUNT(&cpus) == 0) return false;
+  return sched_setaffinity(0, sizeof(cpus), &cpus) == 0;
+#endif
+}
+
+int CpuInfo::GetCurrentCore() {
+#ifdef __APPLE__
+  return 0;
+#else
+  int core = sched_getcpu();
+  return core < 0 ? 0 : core;
+#endif
+}
+
 void CpuInfo::VerifyCpuRequirements() {
   if (!CpuInfo::IsSupported(CpuInfo::SSSE3)) {
     LOG(ERROR) << "CPU does not support the Supplemental SSE3 (SSSE3) instruction set, "
@@ -199,6 +284,9 @@ string CpuInfo::DebugString() {
   stream << "Cpu Info:" << endl
          << "  Model: " << model_name_ << endl
          << "  Cores: " << num_cores_ << endl
+         << "  NUMA Nodes: " << num_numa_nodes_ << endl
+         << "  TSC Timers: " << (ns_per_tsc_tick_ > 0 ? Substitute("$0 GHz",
+             1 / ns_per_tsc_tick_) : string("disabled")) << endl
          << "  " << L1 << endl
          << "  " << L2 << endl
          << "  " << L3 << endl
@@ -17,6 +17,7 @@
 #define IMPALA_UTIL_CPU_INFO_H
 
 #include <string>
+#include <vector>
 #include <boost/cstdint.hpp>
 
 #include "common/logging.h"
@@ -72,12 +73,50 @@ class CpuInfo {
     return cycles_per_ms_;
   }
 
+  /// Returns the nanoseconds per tick of the time stamp counter, or 0 if the counter
+  /// cannot be used to measure time, i.e. if it does not tick at a constant rate that
+  /// is synchronized across cores, --use_tsc_timers is false or CpuInfo is not
+  /// initialized yet. The rate is calibrated against the monotonic clock in Init().
+  static double ns_per_tsc_tick() { return ns_per_tsc_tick_; }
+
   /// Returns the number of cores (including hyper-threaded) on this machine.
   static int num_cores() {
     DCHECK(initialized_);
     return num_cores_;
   }
 
+  /// Returns the number of NUMA nodes on this machine. Machines without NUMA support
+  /// have one node.
+  static int num_numa_nodes() {
+    DCHECK(initialized_);
+    return num_numa_nodes_;
+  }
+
+  /// Returns the NUMA node of 'core', or 0 if it is not known.
+  static int GetNumaNodeOfCore(int core) {
+    DCHECK(initialized_);
+    if (core < 0 || core >= core_to_numa_node_.size()) return 0;
+    return core_to_numa_node_[core];
+  }
+
+  /// Returns the cores of NUMA node 'node', which must be less than num_numa_nodes().
+  static const std::vector<int>& GetCoresOfNumaNode(int node) {
+    DCHECK(initialized_);
+    DCHECK_GE(node, 0);
+    DCHECK_LT(node, numa_node_to_cores_.size());
+    return numa_node_to_cores_[node];
+  }
+
+  /// Restricts the calling thread to the cores of NUMA node 'node'. Threads that it
+  /// starts afterwards inherit the restriction. Returns false if the thread could not
+  /// be bound, e.g. because the node has no cores that the process may run on.
+  static bool BindCurrentThreadToNumaNode(int node);
+
+  /// Returns the core that the calling thread is currently running on, or 0 if it
+  /// cannot be determined. The thread may be moved to another core at any time, so the
+  /// result is a hint.
+  static int GetCurrentCore();
+
   /// Returns the model name of the cpu (e.g. Intel i7-2600)
   static std::string model_name() {
     DCHECK(initialized_);
@@ -122,11 +161,23 @@ class CpuInfo {
   static void GetCacheInfo(long cache_sizes[NUM_CACHE_LEVELS],
       long cache_line_sizes[NUM_CACHE_LEVELS]);
 
+  /// Populates 'core_to_numa_node_', 'numa_node_to_cores_' and 'num_numa_nodes_' for
+  /// 'num_cores' cores from /sys/devices/system/cpu.
+  static void InitNumaNodes(int num_cores);
+
+  /// Returns the nanoseconds per tick of the time stamp counter, measured against the
+  /// monotonic clock.
+  static double CalibrateTsc();
+
   static bool initialized_;
   static int64_t hardware_flags_;
   static int64_t original_hardware_flags_;
   static int64_t cycles_per_ms_;
+  static double ns_per_tsc_tick_;
   static int num_cores_;
+  static int num_numa_nodes_;
+  static std::vector<int> core_to_numa_node_;
+  static std::vector<std::vector<int> > numa_node_to_cores_;
   static std::string model_name_;
 };
 
@@ -0,0 +1,93 @@
+// Copyright 2016 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <boost/algorithm/string.hpp>
+#include <gtest/gtest.h>
+
+#include "util/cpu-sampler.h"
+#include "util/stopwatch.h"
+#include "util/thread.h"
+#include "util/time.h"
+
+#include "common/names.h"
+
+using boost::algorithm::is_any_of;
+using boost::algorithm::split;
+using boost::algorithm::starts_with;
+using boost::algorithm::token_compress_on;
+
+DECLARE_int32(cpu_sample_period_ms);
+
+namespace impala {
+
+// Burns 'ms' milliseconds of CPU time.
+static void Burn(int64_t ms) {
+  MonotonicStopWatch sw;
+  sw.Start();
+  volatile int64_t sum = 0;
+  while (sw.ElapsedTime() < ms * 1000L * 1000L) {
+    for (int i = 0; i < 10000; ++i) sum += i;
+  }
+}
+
+static void RunQueryThread(const TUniqueId& query_id, int node_id) {
+  ScopedCpuSampleQuery sample_query(query_id);
+  SCOPED_CPU_SAMPLE_NODE(node_id);
+  Burn(300);
+}
+
+TEST(CpuSamplerTest, QueryAttribution) {
+  FLAGS_cpu_sample_period_ms = 5;
+  ASSERT_TRUE(CpuSampler::Start(NULL).ok());
+  TUniqueId query1;
+  query1.__set_hi(1);
+  query1.__set_lo(2);
+  TUniqueId query2;
+  query2.__set_hi(3);
+  query2.__set_lo(4);
+  Thread thread1("cpu-sampler-test", "query1", &RunQueryThread, query1, 7);
+  Thread thread2("cpu-sampler-test", "query2", &RunQueryThread, query2, 9);
+  thread1.Join();
+  thread2.Join();
+  // CPU time burnt outside of a query is not sampled.
+  Burn(100);
+  // Wait for the samples to be aggregated.
+  SleepForMs(2500);
+
+  TUniqueId unknown_query;
+  unknown_query.__set_hi(5);
+  unknown_query.__set_lo(6);
+  EXPECT_EQ("", CpuSampler::GetFoldedStacks(unknown_query));
+
+  for (int i = 0; i < 2; ++i) {
+    string stacks = CpuSampler::GetFoldedStacks(i == 0 ? query1 : query2);
+    ASSERT_FALSE(stacks.empty());
+    vector<string> lines;
+    split(lines, stacks, is_any_of("\n"), token_compress_on);
+    for (const string& line: lines) {
+      if (line.empty()) continue;
+      // Every stack starts with the plan node and ends with the number of samples.
+      EXPECT_TRUE(starts_with(line, i == 0 ? "node-7;" : "node-9;")) << line;
+      EXPECT_NE(string::npos, line.rfind(' ')) << line;
+    }
+  }
+}
+
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  impala::InitThreading();
+  return RUN_ALL_TESTS();
+}
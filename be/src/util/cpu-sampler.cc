@@ -0,0 +1,302 @@
+// Copyright 2016 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "util/cpu-sampler.h"
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <execinfo.h>
+#include <signal.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <boost/bind.hpp>
+#include <boost/thread/tss.hpp>
+#include <gflags/gflags.h>
+#include <gutil/strings/substitute.h>
+
+#include "common/logging.h"
+#include "util/debug-util.h"
+#include "util/error-util.h"
+#include "util/symbols-util.h"
+#include "util/thread.h"
+#include "util/time.h"
+
+#include "common/names.h"
+
+using namespace strings;
+
+DEFINE_int32(cpu_sample_period_ms, 100, "(Advanced) The threads that execute queries "
+    "record a sample of their stack every this many milliseconds of CPU time. The "
+    "samples are aggregated per query and served on /cpu-samples. 0 disables sampling.");
+
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+
+namespace impala {
+
+CpuSampler* CpuSampler::instance_ = NULL;
+
+// The query and plan node of the calling thread, read by the signal handler.
+static __thread bool thread_has_query = false;
+static __thread int64_t thread_query_id_hi;
+static __thread int64_t thread_query_id_lo;
+static __thread int thread_node_id = -1;
+
+// Number of frames at the top of a sampled stack that belong to the signal handler and
+// the signal trampoline.
+static const int NUM_HANDLER_FRAMES = 2;
+
+// The signal that the CPU time timers send. Real-time signals are not used by the
+// JVM or gperftools, whose CPU profiler owns SIGPROF.
+static int SampleSignal() { return SIGRTMIN + 4; }
+
+namespace {
+
+// Timer on the CPU time of one thread, which sends the thread SampleSignal().
+class ThreadCpuTimer {
+ public:
+  ThreadCpuTimer() : created_(false) {
+    sigevent event;
+    memset(&event, 0, sizeof(event));
+    event.sigev_notify = SIGEV_THREAD_ID;
+    event.sigev_signo = SampleSignal();
+    event.sigev_notify_thread_id = syscall(SYS_gettid);
+    if (timer_create(CLOCK_THREAD_CPUTIME_ID, &event, &timer_) != 0) {
+      VLOG_QUERY << "Could not create CPU sample timer: " << GetStrErrMsg();
+      return;
+    }
+    created_ = true;
+    itimerspec spec;
+    spec.it_interval.tv_sec = FLAGS_cpu_sample_period_ms / 1000;
+    spec.it_interval.tv_nsec = (FLAGS_cpu_sample_period_ms % 1000) * 1000L * 1000L;
+    spec.it_value = spec.it_interval;
+    timer_settime(timer_, 0, &spec, NULL);
+  }
+
+  ~ThreadCpuTimer() {
+    if (created_) timer_delete(timer_);
+  }
+
+ private:
+  bool created_;
+  timer_t timer_;
+};
+
+// Deletes the timer of a thread when the thread exits.
+boost::thread_specific_ptr<ThreadCpuTimer> thread_cpu_timer;
+
+}
+
+CpuSampler::CpuSampler()
+  : samples_(new Sample[NUM_SAMPLE_SLOTS]),
+    next_slot_(0),
+    num_dropped_samples_(0),
+    num_aggregations_(0) {
+  for (int i = 0; i < NUM_SAMPLE_SLOTS; ++i) samples_[i].state = FREE;
+}
+
+Status CpuSampler::Start(Webserver* webserver) {
+  if (FLAGS_cpu_sample_period_ms <= 0) return Status::OK();
+  DCHECK(instance_ == NULL);
+  // The sampler lives until the process exits.
+  CpuSampler* sampler = new CpuSampler();
+
+  // backtrace() loads libgcc on its first call, which is not safe in a signal handler.
+  void* stack[1];
+  backtrace(stack, 1);
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = &CpuSampler::HandleSignal;
+  action.sa_flags = SA_RESTART;
+  sigemptyset(&action.sa_mask);
+  if (sigaction(SampleSignal(), &action, NULL) != 0) {
+    return Status(Substitute("Could not install the CPU sample signal handler: $0",
+        GetStrErrMsg()));
+  }
+
+  sampler->aggregation_thread_.reset(new Thread("cpu-sampler", "aggregation",
+      &CpuSampler::AggregationLoop, sampler));
+  if (webserver != NULL) {
+    Webserver::RawUrlCallback callback =
+        bind<void>(mem_fn(&CpuSampler::CpuSamplesUrlCallback), sampler, _1, _2);
+    webserver->RegisterUrlCallback("/cpu-samples", callback);
+  }
+  // Publish the sampler after it is fully initialized.
+  __sync_synchronize();
+  instance_ = sampler;
+  return Status::OK();
+}
+
+void CpuSampler::StartThreadTimer() {
+  if (instance_ == NULL || thread_cpu_timer.get() != NULL) return;
+  thread_cpu_timer.reset(new ThreadCpuTimer());
+}
+
+void CpuSampler::HandleSignal(int signal) {
+  CpuSampler* sampler = instance_;
+  if (!thread_has_query || sampler == NULL) return;
+  int saved_errno = errno;
+  int64_t slot = __sync_fetch_and_add(&sampler->next_slot_, 1) % NUM_SAMPLE_SLOTS;
+  Sample* sample = &sampler->samples_[slot];
+  if (__sync_bool_compare_and_swap(&sample->state, FREE, WRITING)) {
+    sample->query_id_hi = thread_query_id_hi;
+    sample->query_id_lo = thread_query_id_lo;
+    sample->node_id = thread_node_id;
+    sample->depth = backtrace(sample->stack, MAX_STACK_DEPTH);
+    __sync_synchronize();
+    sample->state = READY;
+  } else {
+    __sync_fetch_and_add(&sampler->num_dropped_samples_, 1);
+  }
+  errno = saved_errno;
+}
+
+void CpuSampler::AggregationLoop() {
+  while (true) {
+    SleepForMs(1000);
+    AggregateSamples();
+  }
+}
+
+void CpuSampler::AggregateSamples() {
+  lock_guard<mutex> l(lock_);
+  ++num_aggregations_;
+  for (int i = 0; i < NUM_SAMPLE_SLOTS; ++i) {
+    Sample* sample = &samples_[i];
+    if (sample->state != READY) continue;
+    __sync_synchronize();
+    stringstream folded;
+    if (sample->node_id == -1) {
+      folded << "fragment";
+    } else {
+      folded << "node-" << sample->node_id;
+    }
+    // The outermost frame comes first.
+    for (int frame = sample->depth - 1; frame >= NUM_HANDLER_FRAMES; --frame) {
+      folded << ";" << Symbolize(sample->stack[frame]);
+    }
+    QueryStacks* query_stacks =
+        &query_stacks_[QueryKey(sample->query_id_hi, sample->query_id_lo)];
+    __sync_synchronize();
+    sample->state = FREE;
+    query_stacks->last_update = num_aggregations_;
+    ++query_stacks->stacks[folded.str()];
+  }
+
+  // Drop the stacks of the queries that were sampled least recently.
+  while (query_stacks_.size() > MAX_QUERIES) {
+    map<QueryKey, QueryStacks>::iterator oldest = query_stacks_.begin();
+    for (map<QueryKey, QueryStacks>::iterator it = query_stacks_.begin();
+         it != query_stacks_.end(); ++it) {
+      if (it->second.last_update < oldest->second.last_update) oldest = it;
+    }
+    query_stacks_.erase(oldest);
+  }
+}
+
+const string& CpuSampler::Symbolize(void* pc) {
+  map<void*, string>::iterator it = symbols_.find(pc);
+  if (it != symbols_.end()) return it->second;
+  string& symbol = symbols_[pc];
+  Dl_info info;
+  if (dladdr(pc, &info) != 0 && info.dli_sname != NULL) {
+    symbol = SymbolsUtil::DemangleNoArgs(info.dli_sname);
+  } else {
+    stringstream ss;
+    ss << pc;
+    symbol = ss.str();
+  }
+  return symbol;
+}
+
+string CpuSampler::GetFoldedStacks(const TUniqueId& query_id) {
+  CpuSampler* sampler = instance_;
+  if (sampler == NULL) return "";
+  lock_guard<mutex> l(sampler->lock_);
+  map<QueryKey, QueryStacks>::const_iterator it =
+      sampler->query_stacks_.find(QueryKey(query_id.hi, query_id.lo));
+  if (it == sampler->query_stacks_.end()) return "";
+  stringstream ss;
+  for (const pair<string, int64_t>& stack: it->second.stacks) {
+    ss << stack.first << " " << stack.second << "\n";
+  }
+  return ss.str();
+}
+
+void CpuSampler::CpuSamplesUrlCallback(const Webserver::ArgumentMap& args,
+    stringstream* output) {
+  Webserver::ArgumentMap::const_iterator query_arg = args.find("query_id");
+  if (query_arg != args.end()) {
+    TUniqueId query_id;
+    if (!ParseId(query_arg->second, &query_id)) {
+      (*output) << "Invalid query id: " << query_arg->second;
+      return;
+    }
+    (*output) << GetFoldedStacks(query_id);
+    return;
+  }
+
+  // List the sampled queries with their number of samples.
+  lock_guard<mutex> l(lock_);
+  (*output) << "Dropped samples: " << num_dropped_samples_ << "\n";
+  for (const pair<QueryKey, QueryStacks>& query: query_stacks_) {
+    TUniqueId query_id;
+    query_id.__set_hi(query.first.first);
+    query_id.__set_lo(query.first.second);
+    int64_t num_samples = 0;
+    for (const pair<string, int64_t>& stack: query.second.stacks) {
+      num_samples += stack.second;
+    }
+    (*output) << PrintId(query_id) << " " << num_samples << "\n";
+  }
+}
+
+ScopedCpuSampleQuery::ScopedCpuSampleQuery(const TUniqueId& query_id)
+  : had_query_(thread_has_query),
+    prev_query_id_hi_(thread_query_id_hi),
+    prev_query_id_lo_(thread_query_id_lo),
+    prev_node_id_(thread_node_id) {
+  CpuSampler::StartThreadTimer();
+  // Keep the signal handler from seeing a partially updated query id.
+  thread_has_query = false;
+  __sync_synchronize();
+  thread_query_id_hi = query_id.hi;
+  thread_query_id_lo = query_id.lo;
+  thread_node_id = -1;
+  __sync_synchronize();
+  thread_has_query = true;
+}
+
+ScopedCpuSampleQuery::~ScopedCpuSampleQuery() {
+  thread_has_query = false;
+  __sync_synchronize();
+  thread_query_id_hi = prev_query_id_hi_;
+  thread_query_id_lo = prev_query_id_lo_;
+  thread_node_id = prev_node_id_;
+  __sync_synchronize();
+  thread_has_query = had_query_;
+}
+
+ScopedCpuSampleNode::ScopedCpuSampleNode(int node_id) : prev_node_id_(thread_node_id) {
+  thread_node_id = node_id;
+}
+
+ScopedCpuSampleNode::~ScopedCpuSampleNode() {
+  thread_node_id = prev_node_id_;
+}
+
+}
@@ -0,0 +1,169 @@
+// Copyright 2016 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef IMPALA_UTIL_CPU_SAMPLER_H
+#define IMPALA_UTIL_CPU_SAMPLER_H
+
+#include <map>
+#include <string>
+#include <utility>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "common/status.h"
+#include "util/runtime-profile-counters.h"  // for MACRO_CONCAT
+#include "util/webserver.h"
+
+#include "gen-cpp/Types_types.h"  // for TUniqueId
+
+namespace impala {
+
+class Thread;
+
+/// Always-on, low-frequency sampling CPU profiler for the threads that execute queries.
+/// Every thread that runs query work gets a timer on its own CPU time, which sends it a
+/// signal every --cpu_sample_period_ms of CPU time. The signal handler records the
+/// stack of the thread, together with the query and plan node that the thread works
+/// for, in a fixed-size buffer. Threads set their query and node in thread-local
+/// storage with ScopedCpuSampleQuery and SCOPED_CPU_SAMPLE_NODE.
+///
+/// A background thread symbolizes the samples once per second and aggregates them
+/// into folded stacks (one line per distinct stack, frames separated by ';', followed
+/// by the number of samples) per query, which flamegraph.pl can render directly. The
+/// stacks of the most recently sampled queries are kept and served on /cpu-samples.
+/// The root frame of every stack is the plan node, e.g. 'node-3'.
+///
+/// Samples are dropped if the buffer is full, i.e. if more than its size are taken
+/// within a second.
+class CpuSampler {
+ public:
+  /// Starts sampling and registers /cpu-samples on 'webserver', if it is not NULL.
+  /// Does nothing if --cpu_sample_period_ms is 0. Must be called at most once.
+  static Status Start(Webserver* webserver);
+
+  /// Returns the folded stacks of the query 'query_id', one line per stack. Returns an
+  /// empty string if the query was not sampled. Stacks of samples that the background
+  /// thread did not aggregate yet are not included.
+  static std::string GetFoldedStacks(const TUniqueId& query_id);
+
+ private:
+  friend class ScopedCpuSampleQuery;
+
+  /// Maximum number of frames of a sampled stack.
+  static const int MAX_STACK_DEPTH = 48;
+
+  /// Number of samples that fit into the buffer.
+  static const int NUM_SAMPLE_SLOTS = 4096;
+
+  /// Number of queries whose stacks are kept.
+  static const int MAX_QUERIES = 128;
+
+  /// A sample in the buffer. 'state' is one of the SlotState values.
+  struct Sample {
+    volatile int state;
+    int64_t query_id_hi;
+    int64_t query_id_lo;
+    int node_id;
+    int depth;
+    void* stack[MAX_STACK_DEPTH];
+  };
+  enum SlotState { FREE, WRITING, READY };
+
+  /// Number of samples and the count of each folded stack of a query.
+  struct QueryStacks {
+    int64_t last_update;
+    std::map<std::string, int64_t> stacks;
+  };
+  typedef std::pair<int64_t, int64_t> QueryKey;
+
+  static CpuSampler* instance_;
+
+  /// The buffer of samples, which the signal handler writes to.
+  Sample* samples_;
+
+  /// Index of the next slot for the signal handler to try. Wraps around.
+  int64_t next_slot_;
+
+  /// Number of samples that were dropped because the buffer was full.
+  int64_t num_dropped_samples_;
+
+  /// Aggregates the samples.
+  boost::scoped_ptr<Thread> aggregation_thread_;
+
+  /// Protects all members below.
+  boost::mutex lock_;
+
+  /// Incremented for every aggregation, to find the least recently sampled query.
+  int64_t num_aggregations_;
+
+  /// The stacks of each sampled query.
+  std::map<QueryKey, QueryStacks> query_stacks_;
+
+  /// Cache of the names of the functions that contain each instruction address.
+  std::map<void*, std::string> symbols_;
+
+  CpuSampler();
+
+  /// Arms the CPU time timer of the calling thread, if it does not have one yet.
+  static void StartThreadTimer();
+
+  /// The signal handler that records a sample of the interrupted thread.
+  static void HandleSignal(int signal);
+
+  /// Runs in aggregation_thread_ and aggregates the samples every second.
+  void AggregationLoop();
+
+  /// Moves all samples in the buffer to query_stacks_.
+  void AggregateSamples();
+
+  /// Returns the name of the function that contains 'pc'. Caller must hold lock_.
+  const std::string& Symbolize(void* pc);
+
+  /// Webserver callback for /cpu-samples. Lists the sampled queries, or prints the
+  /// folded stacks of the query given by the 'query_id' argument.
+  void CpuSamplesUrlCallback(const Webserver::ArgumentMap& args,
+      std::stringstream* output);
+};
+
+/// Tags the CPU samples of the calling thread with 'query_id' for the lifetime of
+/// this object. Starts sampling the thread if it was not sampled before.
+class ScopedCpuSampleQuery {
+ public:
+  ScopedCpuSampleQuery(const TUniqueId& query_id);
+  ~ScopedCpuSampleQuery();
+
+ private:
+  bool had_query_;
+  int64_t prev_query_id_hi_;
+  int64_t prev_query_id_lo_;
+  int prev_node_id_;
+};
+
+/// Tags the CPU samples of the calling thread with the plan node 'node_id' for the
+/// lifetime of this object.
+class ScopedCpuSampleNode {
+ public:
+  ScopedCpuSampleNode(int node_id);
+  ~ScopedCpuSampleNode();
+
+ private:
+  int prev_node_id_;
+};
+
+#define SCOPED_CPU_SAMPLE_NODE(id) \
+    ScopedCpuSampleNode MACRO_CONCAT(SCOPED_CPU_SAMPLE_NODE, __COUNTER__)(id)
+
+}
+
+#endif
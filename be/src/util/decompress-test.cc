@@ -21,10 +21,14 @@
 #include "runtime/mem-pool.h"
 #include "util/decompress.h"
 #include "util/compress.h"
+#include "util/thread.h"
 #include "gen-cpp/Descriptors_types.h"
 
 #include "common/names.h"
 
+DECLARE_int32(max_decompression_threads);
+DECLARE_int64(min_parallel_decompression_bytes);
+
 namespace impala {
 
 // Fixture for testing class Decompressor
@@ -345,6 +349,79 @@ TEST_F(DecompressorTest, Bzip) {
 
 TEST_F(DecompressorTest, SnappyBlocked) {
   RunTest(THdfsCompression::SNAPPY_BLOCKED);
+  RunTestStreaming(THdfsCompression::SNAPPY_BLOCKED);
+}
+
+// Streaming decompression of snappy block compressed data only consumes whole outer
+// blocks.
+TEST_F(DecompressorTest, SnappyBlockedMultiBlockStreaming) {
+  uint8_t* compressed = NULL;
+  uint8_t* uncompressed = NULL;
+  int64_t uncompressed_len = 0;
+  int64_t compressed_len = 0;
+  GenerateMultiStreamData(THdfsCompression::SNAPPY_BLOCKED, &uncompressed_len,
+      &uncompressed, &compressed_len, &compressed);
+
+  scoped_ptr<Codec> decompressor;
+  EXPECT_OK(Codec::CreateDecompressor(&mem_pool_, true,
+      THdfsCompression::SNAPPY_BLOCKED, &decompressor));
+  EXPECT_TRUE(decompressor->supports_streaming());
+  EXPECT_OK(StreamingDecompress(decompressor.get(), compressed_len, compressed,
+      uncompressed_len, uncompressed, true));
+
+  // A partial block makes no progress.
+  int64_t bytes_read;
+  int64_t output_len;
+  uint8_t* output;
+  bool stream_end;
+  EXPECT_OK(decompressor->ProcessBlockStreaming(RAW_INPUT_SIZE / 4, compressed,
+      &bytes_read, &output_len, &output, &stream_end));
+  EXPECT_EQ(bytes_read, 0);
+  EXPECT_EQ(output_len, 0);
+  decompressor->Close();
+}
+
+// Snappy block compressed data with several outer blocks is decompressed by multiple
+// threads, which must produce the same output as a single thread.
+TEST_F(DecompressorTest, SnappyBlockedParallel) {
+  scoped_ptr<Codec> compressor;
+  scoped_ptr<Codec> decompressor;
+  EXPECT_OK(Codec::CreateCompressor(&mem_pool_, false,
+      THdfsCompression::SNAPPY_BLOCKED, &compressor));
+  EXPECT_OK(Codec::CreateDecompressor(&mem_pool_, false,
+      THdfsCompression::SNAPPY_BLOCKED, &decompressor));
+
+  // Each call of the compressor returns a single outer block. Use blocks of different
+  // sizes so that the runs of blocks do not line up with the threads.
+  string compressed;
+  int64_t input_len = 0;
+  for (int i = 1; input_len + i * 1024 <= sizeof(input_); ++i) {
+    uint8_t* block;
+    int64_t block_len;
+    EXPECT_OK(compressor->ProcessBlock(false, i * 1024, input_ + input_len, &block_len,
+        &block));
+    compressed.append(reinterpret_cast<char*>(block), block_len);
+    input_len += i * 1024;
+  }
+
+  int32_t saved_threads = FLAGS_max_decompression_threads;
+  int64_t saved_min_bytes = FLAGS_min_parallel_decompression_bytes;
+  FLAGS_min_parallel_decompression_bytes = 0;
+  int thread_counts[] = { 1, 2, 3, 64 };
+  for (int i = 0; i < sizeof(thread_counts) / sizeof(int); ++i) {
+    FLAGS_max_decompression_threads = thread_counts[i];
+    uint8_t* output;
+    int64_t output_len;
+    EXPECT_OK(decompressor->ProcessBlock(false, compressed.size(),
+        reinterpret_cast<const uint8_t*>(compressed.data()), &output_len, &output));
+    ASSERT_EQ(output_len, input_len);
+    EXPECT_EQ(memcmp(input_, output, input_len), 0);
+  }
+
+  FLAGS_max_decompression_threads = saved_threads;
+  FLAGS_min_parallel_decompression_bytes = saved_min_bytes;
+  compressor->Close();
+  decompressor->Close();
 }
 
 TEST_F(DecompressorTest, Impala1506) {
@@ -373,6 +450,7 @@ TEST_F(DecompressorTest, Impala1506) {
 
 int main(int argc, char **argv) {
   ::testing::InitGoogleTest(&argc, argv);
+  impala::InitThreading();
   int rand_seed = time(NULL);
   LOG(INFO) << "rand_seed: " << rand_seed;
   srand(rand_seed);
@@ -16,6 +16,7 @@
 #include "util/decompress.h"
 #include "exec/read-write-util.h"
 #include "runtime/mem-tracker.h"
+#include "runtime/parallel-executor.h"
 #include "runtime/runtime-state.h"
 #include "common/logging.h"
 #include "gen-cpp/Descriptors_types.h"
@@ -32,6 +33,13 @@
 using namespace impala;
 using namespace strings;
 
+DEFINE_int32(max_decompression_threads, 4, "(Advanced) The maximum number of threads "
+    "used to decompress a single buffer of a codec whose blocks are independent "
+    "(snappy block compressed text files). If <= 1, such buffers are decompressed by "
+    "the scanner thread.");
+DEFINE_int64(min_parallel_decompression_bytes, 2L * 1024L * 1024L, "(Advanced) The "
+    "minimum decompressed size of a buffer that is decompressed by multiple threads.");
+
 const string DECOMPRESSOR_MEM_LIMIT_EXCEEDED = "$0Decompressor failed to allocate $1 bytes.";
 
 GzipDecompressor::GzipDecompressor(MemPool* mem_pool, bool reuse_buffer, bool is_deflate)
@@ -407,7 +415,7 @@ Status BzipDecompressor::ProcessBlockStreaming(int64_t input_length, const uint8
 }
 
 SnappyBlockDecompressor::SnappyBlockDecompressor(MemPool* mem_pool, bool reuse_buffer)
-  : Codec(mem_pool, reuse_buffer) {
+  : Codec(mem_pool, reuse_buffer, true) {
 }
 
 int64_t SnappyBlockDecompressor::MaxOutputLen(int64_t input_len, const uint8_t* input) {
@@ -435,10 +443,20 @@ int64_t SnappyBlockDecompressor::MaxOutputLen(int64_t input_len, const uint8_t*
 // If size_only is false, output must be preallocated to output_len and this needs to
 // be exactly big enough to hold the decompressed output.
 // size_only is a O(1) operations (just reads a single varint for each snappy block).
+// If 'block_offsets' is not NULL, the size pass also records the input and output
+// offset of each outer block. It is cleared unless the input consists of well-formed
+// outer blocks only, so that the blocks can be decompressed independently.
 static Status SnappyBlockDecompress(int64_t input_len, const uint8_t* input,
-    bool size_only, int64_t* output_len, char* output) {
+    bool size_only, int64_t* output_len, char* output,
+    vector<pair<int64_t, int64_t> >* block_offsets = NULL) {
+  DCHECK(size_only || block_offsets == NULL);
+  const uint8_t* input_start = input;
   int64_t uncompressed_total_len = 0;
+  bool truncated = false;
   while (input_len > 0) {
+    if (block_offsets != NULL) {
+      block_offsets->push_back(make_pair(input - input_start, uncompressed_total_len));
+    }
     uint32_t uncompressed_block_len = ReadWriteUtil::GetInt<uint32_t>(input);
     input += sizeof(uint32_t);
     input_len -= sizeof(uint32_t);
@@ -449,6 +467,7 @@ static Status SnappyBlockDecompress(int64_t input_len, const uint8_t* input,
         return Status(TErrorCode::SNAPPY_DECOMPRESS_INVALID_BLOCK_SIZE,
             uncompressed_block_len);
       }
+      truncated = true;
       break;
     }
 
@@ -468,6 +487,7 @@ static Status SnappyBlockDecompress(int64_t input_len, const uint8_t* input,
           return Status(TErrorCode::SNAPPY_DECOMPRESS_INVALID_COMPRESSED_LENGTH);
         }
         input_len = 0;
+        truncated = true;
         break;
       }
 
@@ -479,6 +499,7 @@ static Status SnappyBlockDecompress(int64_t input_len, const uint8_t* input,
           return Status(TErrorCode::SNAPPY_DECOMPRESS_UNCOMPRESSED_LENGTH_FAILED);
         }
         input_len = 0;
+        truncated = true;
         break;
       }
       DCHECK_GT(uncompressed_len, 0);
@@ -499,6 +520,7 @@ static Status SnappyBlockDecompress(int64_t input_len, const uint8_t* input,
     }
   }
 
+  if (truncated && block_offsets != NULL) block_offsets->clear();
   if (size_only) {
     *output_len = uncompressed_total_len;
   } else if (*output_len != uncompressed_total_len) {
@@ -507,6 +529,116 @@ static Status SnappyBlockDecompress(int64_t input_len, const uint8_t* input,
   return Status::OK();
 }
 
+namespace {
+
+// A run of consecutive outer blocks of snappy block compressed data, decompressed by
+// one thread of ParallelSnappyBlockDecompress().
+struct SnappyBlockRange {
+  int64_t input_len;
+  const uint8_t* input;
+  int64_t output_len;
+  char* output;
+};
+
+Status DecompressSnappyBlockRange(void* arg) {
+  SnappyBlockRange* range = reinterpret_cast<SnappyBlockRange*>(arg);
+  return SnappyBlockDecompress(range->input_len, range->input, false,
+      &range->output_len, range->output);
+}
+
+}
+
+// Decompresses snappy block compressed data like SnappyBlockDecompress(). The outer
+// blocks do not depend on each other, so they are split into up to
+// --max_decompression_threads runs of about the same decompressed size that are
+// decompressed in parallel directly into their place in 'output'.
+static Status ParallelSnappyBlockDecompress(int64_t input_len, const uint8_t* input,
+    int64_t output_len, char* output) {
+  vector<pair<int64_t, int64_t> > block_offsets;
+  int64_t total_len;
+  RETURN_IF_ERROR(SnappyBlockDecompress(input_len, input, true, &total_len, NULL,
+      &block_offsets));
+  int num_threads = min<int64_t>(FLAGS_max_decompression_threads, block_offsets.size());
+  if (num_threads <= 1 || total_len != output_len) {
+    return SnappyBlockDecompress(input_len, input, false, &output_len, output);
+  }
+
+  vector<SnappyBlockRange> ranges;
+  for (int i = 0; i < block_offsets.size(); ++i) {
+    // Start a new run once the previous one covers its share of the output.
+    if (i > 0 && (ranges.size() == num_threads ||
+        block_offsets[i].second < ranges.size() * output_len / num_threads)) {
+      continue;
+    }
+    SnappyBlockRange range;
+    range.input = input + block_offsets[i].first;
+    range.output = output + block_offsets[i].second;
+    ranges.push_back(range);
+  }
+  for (int i = 0; i < ranges.size(); ++i) {
+    const uint8_t* input_end = i + 1 < ranges.size() ? ranges[i + 1].input
+        : input + input_len;
+    char* output_end = i + 1 < ranges.size() ? ranges[i + 1].output
+        : output + output_len;
+    ranges[i].input_len = input_end - ranges[i].input;
+    ranges[i].output_len = output_end - ranges[i].output;
+  }
+
+  vector<void*> args(ranges.size());
+  for (int i = 0; i < ranges.size(); ++i) args[i] = &ranges[i];
+  return ParallelExecutor::Exec(&DecompressSnappyBlockRange, &args[0], args.size());
+}
+
+// Decompresses 'input' into 'output', which must be exactly 'output_len' bytes, with
+// multiple threads if the output is large enough.
+static Status DecompressSnappyBlocks(int64_t input_len, const uint8_t* input,
+    int64_t output_len, char* output) {
+  if (FLAGS_max_decompression_threads > 1 &&
+      output_len >= FLAGS_min_parallel_decompression_bytes) {
+    return ParallelSnappyBlockDecompress(input_len, input, output_len, output);
+  }
+  return SnappyBlockDecompress(input_len, input, false, &output_len, output);
+}
+
+// Computes the length of the outer block at the start of 'input' and its decompressed
+// size without decompressing it. Sets *block_len to 0 if 'input' ends before the end
+// of the block.
+static Status GetSnappyBlockLength(int64_t input_len, const uint8_t* input,
+    int64_t* block_len, int64_t* output_len) {
+  *block_len = 0;
+  *output_len = 0;
+  if (input_len < sizeof(uint32_t)) return Status::OK();
+  uint32_t uncompressed_block_len = ReadWriteUtil::GetInt<uint32_t>(input);
+  if (uncompressed_block_len > Codec::MAX_BLOCK_SIZE) {
+    return Status(TErrorCode::SNAPPY_DECOMPRESS_INVALID_BLOCK_SIZE,
+        uncompressed_block_len);
+  }
+  int64_t offset = sizeof(uint32_t);
+  int64_t uncompressed_total_len = 0;
+  while (uncompressed_total_len < uncompressed_block_len) {
+    if (input_len - offset < sizeof(uint32_t)) return Status::OK();
+    int64_t compressed_len = ReadWriteUtil::GetInt<uint32_t>(input + offset);
+    offset += sizeof(uint32_t);
+    if (compressed_len == 0) {
+      return Status(TErrorCode::SNAPPY_DECOMPRESS_INVALID_COMPRESSED_LENGTH);
+    }
+    if (compressed_len > input_len - offset) return Status::OK();
+    size_t uncompressed_len;
+    if (!snappy::GetUncompressedLength(reinterpret_cast<const char*>(input + offset),
+          compressed_len, &uncompressed_len)) {
+      return Status(TErrorCode::SNAPPY_DECOMPRESS_UNCOMPRESSED_LENGTH_FAILED);
+    }
+    offset += compressed_len;
+    uncompressed_total_len += uncompressed_len;
+  }
+  if (uncompressed_total_len != uncompressed_block_len) {
+    return Status(TErrorCode::SNAPPY_DECOMPRESS_DECOMPRESS_SIZE_INCORRECT);
+  }
+  *block_len = offset;
+  *output_len = uncompressed_total_len;
+  return Status::OK();
+}
+
 Status SnappyBlockDecompressor::ProcessBlock(bool output_preallocated, int64_t input_len,
     const uint8_t* input, int64_t* output_len, uint8_t** output) {
   if (!output_preallocated) {
@@ -535,8 +667,46 @@ Status SnappyBlockDecompressor::ProcessBlock(bool output_preallocated, int64_t i
   }
 
   char* out_ptr = reinterpret_cast<char*>(*output);
-  RETURN_IF_ERROR(SnappyBlockDecompress(input_len, input, false, output_len, out_ptr));
-  return Status::OK();
+  return DecompressSnappyBlocks(input_len, input, *output_len, out_ptr);
+}
+
+Status SnappyBlockDecompressor::ProcessBlockStreaming(int64_t input_length,
+    const uint8_t* input, int64_t* input_bytes_read, int64_t* output_length,
+    uint8_t** output, bool* stream_end) {
+  // Take whole outer blocks until the output buffer is full. The first block is taken
+  // even if it is larger than the buffer.
+  *input_bytes_read = 0;
+  *output_length = 0;
+  *stream_end = true;
+  while (*input_bytes_read < input_length) {
+    int64_t block_len;
+    int64_t block_output_len;
+    RETURN_IF_ERROR(GetSnappyBlockLength(input_length - *input_bytes_read,
+        input + *input_bytes_read, &block_len, &block_output_len));
+    if (block_len == 0) break;
+    if (*output_length > 0 && *output_length + block_output_len > STREAM_OUT_BUF_SIZE) {
+      break;
+    }
+    *input_bytes_read += block_len;
+    *output_length += block_output_len;
+  }
+  if (*output_length == 0) {
+    *output = out_buffer_;
+    return Status::OK();
+  }
+
+  if (!reuse_buffer_ || out_buffer_ == NULL || buffer_length_ < *output_length) {
+    buffer_length_ = max(*output_length, static_cast<int64_t>(STREAM_OUT_BUF_SIZE));
+    out_buffer_ = memory_pool_->TryAllocate(buffer_length_);
+    if (UNLIKELY(out_buffer_ == NULL)) {
+      string details = Substitute(DECOMPRESSOR_MEM_LIMIT_EXCEEDED, "SnappyBlock",
+          buffer_length_);
+      return memory_pool_->mem_tracker()->MemLimitExceeded(NULL, details, buffer_length_);
+    }
+  }
+  *output = out_buffer_;
+  return DecompressSnappyBlocks(*input_bytes_read, input, *output_length,
+      reinterpret_cast<char*>(*output));
 }
 
 SnappyDecompressor::SnappyDecompressor(MemPool* mem_pool, bool reuse_buffer)
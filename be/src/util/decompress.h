@@ -116,6 +116,12 @@ class SnappyBlockDecompressor : public Codec {
   virtual int64_t MaxOutputLen(int64_t input_len, const uint8_t* input = NULL);
   virtual Status ProcessBlock(bool output_preallocated, int64_t input_length,
       const uint8_t* input, int64_t* output_length, uint8_t** output);
+  /// Decompresses the complete outer blocks at the start of 'input', up to about
+  /// STREAM_OUT_BUF_SIZE bytes of output. Consumes no input if 'input' does not hold
+  /// the first outer block entirely. Every outer block ends a stream.
+  virtual Status ProcessBlockStreaming(int64_t input_length, const uint8_t* input,
+      int64_t* input_bytes_read, int64_t* output_length, uint8_t** output,
+      bool* stream_end);
   virtual std::string file_extension() const { return "snappy"; }
 
  private:
@@ -15,6 +15,7 @@
 #ifndef IMPALA_UTIL_DICT_ENCODING_H
 #define IMPALA_UTIL_DICT_ENCODING_H
 
+#include <algorithm>
 #include <map>
 
 #include <boost/unordered_map.hpp>
@@ -163,6 +164,8 @@ class DictEncoder : public DictEncoderBase {
 /// by the caller and valid as long as this object is.
 class DictDecoderBase {
  public:
+  DictDecoderBase() : num_buffered_indices_(0), next_index_idx_(0) {}
+
   /// The rle encoded indices into the dictionary.
   void SetData(uint8_t* buffer, int buffer_len) {
     DCHECK_GT(buffer_len, 0);
@@ -171,14 +174,70 @@ class DictDecoderBase {
     ++buffer;
     --buffer_len;
     data_decoder_.Reset(buffer, buffer_len, bit_width);
+    num_buffered_indices_ = 0;
+    next_index_idx_ = 0;
   }
 
   virtual ~DictDecoderBase() {}
 
   virtual int num_entries() const = 0;
 
+  /// Advances past the next index without looking up its value. Returns false if the
+  /// data is invalid.
+  bool SkipValue() {
+    int index;
+    return GetNextIndex(&index);
+  }
+
+  /// Copies the dictionary entry at 'index' into 'value', which must point to a value of
+  /// the type of the concrete decoder. 'index' must be less than num_entries().
+  virtual void GetEntry(int index, void* value) const = 0;
+
  protected:
+  /// Returns the next index from the data in 'index', decoding the next batch of indices
+  /// into 'index_buffer_' if all buffered indices have been consumed. Returns false if
+  /// there are no more indices or the data is invalid.
+  bool GetNextIndex(int* index) {
+    if (UNLIKELY(next_index_idx_ == num_buffered_indices_)) {
+      num_buffered_indices_ = data_decoder_.GetValues(index_buffer_, INDEX_BUFFER_SIZE);
+      next_index_idx_ = 0;
+      if (UNLIKELY(num_buffered_indices_ == 0)) return false;
+    }
+    *index = index_buffer_[next_index_idx_++];
+    return true;
+  }
+
+  /// Sets '*indices' to up to 'max_indices' of the next indices and returns their
+  /// number, decoding the next batch of indices if all buffered indices have been
+  /// consumed. '*indices' points into 'index_buffer_' and is only valid until the next
+  /// call. Returns 0 if there are no more indices or the data is invalid.
+  int GetNextIndices(int max_indices, const int** indices) {
+    if (UNLIKELY(next_index_idx_ == num_buffered_indices_)) {
+      num_buffered_indices_ = data_decoder_.GetValues(index_buffer_, INDEX_BUFFER_SIZE);
+      next_index_idx_ = 0;
+      if (UNLIKELY(num_buffered_indices_ == 0)) return 0;
+    }
+    int num_indices = std::min(max_indices, num_buffered_indices_ - next_index_idx_);
+    *indices = index_buffer_ + next_index_idx_;
+    next_index_idx_ += num_indices;
+    return num_indices;
+  }
+
   RleDecoder data_decoder_;
+
+ private:
+  /// Number of indices decoded from 'data_decoder_' at a time. A multiple of 32 so that
+  /// literal runs can be unpacked in full groups.
+  static const int INDEX_BUFFER_SIZE = 128;
+
+  /// Indices decoded ahead of the values returned so far.
+  int index_buffer_[INDEX_BUFFER_SIZE];
+
+  /// Number of valid indices in 'index_buffer_'.
+  int num_buffered_indices_;
+
+  /// Index of the next index in 'index_buffer_' to return.
+  int next_index_idx_;
 };
 
 template<typename T>
@@ -204,6 +263,23 @@ class DictDecoder : public DictDecoderBase {
   /// the string data is from the dictionary buffer passed into the c'tor.
   bool GetValue(T* value);
 
+  /// Same as GetValue() but also returns the dictionary index of the value in 'index'.
+  bool GetValue(T* value, int* index);
+
+  /// Writes the next 'num_values' values to 'values', one every 'stride' bytes, e.g.
+  /// into the slots of consecutive tuples. The values need not be aligned. Decodes the
+  /// indices a batch at a time and looks up a batch of values at once, so this is
+  /// faster than calling GetValue() for each value. Returns false if the data is
+  /// invalid or has fewer than 'num_values' values left.
+  bool GetValues(int num_values, int stride, uint8_t* values);
+
+  virtual void GetEntry(int index, void* value) const {
+    DCHECK_GE(index, 0);
+    DCHECK_LT(index, dict_.size());
+    // Use memcpy instead of '=' so addresses do not need to be aligned (IMPALA-959).
+    memcpy(value, &dict_[index], sizeof(T));
+  }
+
  private:
   std::vector<T> dict_;
 };
@@ -266,7 +342,7 @@ inline int DictEncoder<StringValue>::AddToTable(const StringValue& value,
 template<typename T>
 inline bool DictDecoder<T>::GetValue(T* value) {
   int index = -1; // Initialize to avoid compiler warning.
-  bool result = data_decoder_.Get(&index);
+  bool result = GetNextIndex(&index);
   // Use & to avoid branches.
   if (LIKELY(result & (index >= 0) & (index < dict_.size()))) {
     *value = dict_[index];
@@ -275,10 +351,47 @@ inline bool DictDecoder<T>::GetValue(T* value) {
   return false;
 }
 
+template<typename T>
+inline bool DictDecoder<T>::GetValue(T* value, int* index) {
+  *index = -1; // Initialize to avoid compiler warning.
+  bool result = GetNextIndex(index);
+  // Use & to avoid branches.
+  if (LIKELY(result & (*index >= 0) & (*index < dict_.size()))) {
+    *value = dict_[*index];
+    return true;
+  }
+  return false;
+}
+
+template<typename T>
+inline bool DictDecoder<T>::GetValues(int num_values, int stride, uint8_t* values) {
+  const T* dict = dict_.data();
+  const uint32_t dict_size = dict_.size();
+  while (num_values > 0) {
+    const int* indices;
+    int num_indices = GetNextIndices(num_values, &indices);
+    if (UNLIKELY(num_indices == 0)) return false;
+    // Validate the whole batch first so that the loop below does not need branches.
+    // Negative indices become large unsigned values.
+    bool valid = true;
+    for (int i = 0; i < num_indices; ++i) {
+      valid &= static_cast<uint32_t>(indices[i]) < dict_size;
+    }
+    if (UNLIKELY(!valid)) return false;
+    // Use memcpy instead of '=' so addresses do not need to be aligned (IMPALA-959).
+    for (int i = 0; i < num_indices; ++i) {
+      memcpy(values, &dict[indices[i]], sizeof(T));
+      values += stride;
+    }
+    num_values -= num_indices;
+  }
+  return true;
+}
+
 template<>
 inline bool DictDecoder<Decimal16Value>::GetValue(Decimal16Value* value) {
   int index;
-  bool result = data_decoder_.Get(&index);
+  bool result = GetNextIndex(&index);
   if (!result) return false;
   if (index >= dict_.size()) return false;
   // Workaround for IMPALA-959. Use memcpy instead of '=' so addresses
@@ -289,6 +402,15 @@ inline bool DictDecoder<Decimal16Value>::GetValue(Decimal16Value* value) {
   return true;
 }
 
+template<>
+inline bool DictDecoder<Decimal16Value>::GetValue(Decimal16Value* value, int* index) {
+  bool result = GetNextIndex(index);
+  if (!result) return false;
+  if (*index < 0 || *index >= dict_.size()) return false;
+  GetEntry(*index, value);
+  return true;
+}
+
 template<typename T>
 inline void DictEncoder<T>::WriteDict(uint8_t* buffer) {
   for (const Node& node: nodes_) {
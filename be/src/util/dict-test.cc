@@ -56,6 +56,38 @@ void ValidateDict(const vector<T>& values, int fixed_buffer_byte_size) {
     decoder.GetValue(&j);
     EXPECT_EQ(i, j);
   }
+
+  // Decode again, this time also returning the dictionary indices, and check that the
+  // indices refer to the decoded values.
+  decoder.SetData(data_buffer, data_len);
+  for (T i: values) {
+    T j;
+    int index;
+    ASSERT_TRUE(decoder.GetValue(&j, &index));
+    EXPECT_EQ(i, j);
+    ASSERT_GE(index, 0);
+    ASSERT_LT(index, decoder.num_entries());
+    T entry;
+    decoder.GetEntry(index, &entry);
+    EXPECT_EQ(i, entry);
+  }
+
+  // Decode in batches into unaligned slots of a strided buffer, as if into tuples.
+  const int stride = sizeof(T) + 3;
+  vector<uint8_t> slots(values.size() * stride + 1);
+  decoder.SetData(data_buffer, data_len);
+  int num_decoded = 0;
+  while (num_decoded < values.size()) {
+    int batch_size = min<int>(values.size() - num_decoded, 1 + num_decoded % 50);
+    ASSERT_TRUE(decoder.GetValues(batch_size, stride,
+        slots.data() + 1 + num_decoded * stride));
+    num_decoded += batch_size;
+  }
+  for (int i = 0; i < values.size(); ++i) {
+    T j;
+    memcpy(&j, slots.data() + 1 + i * stride, sizeof(T));
+    EXPECT_EQ(values[i], j);
+  }
   pool.FreeAll();
 }
 
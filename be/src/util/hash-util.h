@@ -27,26 +27,43 @@ namespace impala {
 /// Utility class to compute hash values.
 class HashUtil {
  public:
+  /// Inputs longer than this many bytes are hashed with three interleaved CRC lanes by
+  /// CrcHash().
+  static const int CRC_INTERLEAVED_MIN_BYTES = 32;
+  static const int CRC_INTERLEAVED_BLOCK_BYTES = 3 * sizeof(uint64_t);
+
+  /// Seeds of lanes 1 and 2 of CrcHashInterleaved() relative to lane 0.
+  static const uint32_t CRC_LANE1_SEED = 0x9e3779b9;
+  static const uint32_t CRC_LANE2_SEED = 0x85ebca6b;
+
   /// Compute the Crc32 hash for data using SSE4 instructions.  The input hash parameter is
   /// the current hash/seed value.
   /// This should only be called if SSE is supported.
   /// This is ~4x faster than Fnv/Boost Hash.
+  /// Data longer than CRC_INTERLEAVED_MIN_BYTES is first hashed in 24-byte blocks by
+  /// CrcHashInterleaved(), so its hash is not the CRC of the data.
   /// NOTE: Any changes made to this function need to be reflected in Codegen::GetHashFn.
   /// TODO: crc32 hashes with different seeds do not result in different hash functions.
   /// The resulting hashes are correlated.
-  /// TODO: update this to also use SSE4_crc32_u64 and SSE4_crc32_u16 where appropriate.
   static uint32_t CrcHash(const void* data, int32_t bytes, uint32_t hash) {
     DCHECK(CpuInfo::IsSupported(CpuInfo::SSE4_2));
-    uint32_t words = bytes / sizeof(uint32_t);
-    bytes = bytes % sizeof(uint32_t);
-
-    const uint32_t* p = reinterpret_cast<const uint32_t*>(data);
-    while (words--) {
-      hash = SSE4_crc32_u32(hash, *p);
-      ++p;
+    const uint8_t* s = reinterpret_cast<const uint8_t*>(data);
+    if (bytes > CRC_INTERLEAVED_MIN_BYTES) {
+      int32_t interleaved_bytes = bytes - bytes % CRC_INTERLEAVED_BLOCK_BYTES;
+      hash = CrcHashInterleaved(s, interleaved_bytes, hash);
+      s += interleaved_bytes;
+      bytes -= interleaved_bytes;
     }
 
-    const uint8_t* s = reinterpret_cast<const uint8_t*>(p);
+    for (; bytes >= sizeof(uint64_t); bytes -= sizeof(uint64_t)) {
+      hash = SSE4_crc32_u64(hash, *reinterpret_cast<const uint64_t*>(s));
+      s += sizeof(uint64_t);
+    }
+    if (bytes >= sizeof(uint32_t)) {
+      hash = SSE4_crc32_u32(hash, *reinterpret_cast<const uint32_t*>(s));
+      s += sizeof(uint32_t);
+      bytes -= sizeof(uint32_t);
+    }
     while (bytes--) {
       hash = SSE4_crc32_u8(hash, *s);
       ++s;
@@ -119,6 +136,29 @@ class HashUtil {
   static const uint64_t MURMUR_PRIME = 0xc6a4a7935bd1e995;
   static const int MURMUR_R = 47;
 
+  /// Hashes 'bytes' of 'data', a multiple of CRC_INTERLEAVED_BLOCK_BYTES, with three
+  /// CRC lanes that take turns on its 8-byte words. The lanes are independent, so their
+  /// crc32 instructions overlap instead of each waiting for the latency of the previous
+  /// one, which makes long keys ~3x faster to hash. Lanes 1 and 2 are mixed with a
+  /// multiplication before they are folded into lane 0. Folding them with another crc32
+  /// would keep the hash linear in the data, and such folds collide badly on keys that
+  /// only differ in a few digits that straddle two lanes.
+  static uint32_t CrcHashInterleaved(const uint8_t* data, int32_t bytes, uint32_t hash) {
+    DCHECK_EQ(bytes % CRC_INTERLEAVED_BLOCK_BYTES, 0);
+    uint32_t lane0 = hash;
+    uint32_t lane1 = hash ^ CRC_LANE1_SEED;
+    uint32_t lane2 = hash ^ CRC_LANE2_SEED;
+    const uint64_t* p = reinterpret_cast<const uint64_t*>(data);
+    for (int i = 0; i < bytes / CRC_INTERLEAVED_BLOCK_BYTES; ++i) {
+      lane0 = SSE4_crc32_u64(lane0, p[0]);
+      lane1 = SSE4_crc32_u64(lane1, p[1]);
+      lane2 = SSE4_crc32_u64(lane2, p[2]);
+      p += 3;
+    }
+    uint64_t mixed = ((static_cast<uint64_t>(lane1) << 32) | lane2) * MURMUR_PRIME;
+    return SSE4_crc32_u64(lane0, mixed ^ (mixed >> MURMUR_R));
+  }
+
   /// Murmur2 hash implementation returning 64-bit hashes.
   static uint64_t MurmurHash2_64(const void* input, int len, uint64_t seed) {
     uint64_t h = seed ^ (len * MURMUR_PRIME);
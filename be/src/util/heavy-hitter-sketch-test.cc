@@ -0,0 +1,61 @@
+// Copyright 2016 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include "util/heavy-hitter-sketch.h"
+
+#include "common/names.h"
+
+namespace impala {
+
+TEST(HeavyHitterSketchTest, UniformKeys) {
+  HeavyHitterSketch sketch(8);
+  for (int i = 0; i < 10000; ++i) sketch.Update(i);
+  EXPECT_EQ(10000, sketch.num_updates());
+  vector<HeavyHitterSketch::HeavyHitter> heavy_hitters;
+  sketch.GetHeavyHitters(0.01, &heavy_hitters);
+  EXPECT_TRUE(heavy_hitters.empty());
+}
+
+TEST(HeavyHitterSketchTest, SkewedKeys) {
+  HeavyHitterSketch sketch(8);
+  // Key 1 is 30% and key 2 is 20% of the stream, the rest are distinct keys.
+  for (int i = 0; i < 10000; ++i) {
+    if (i % 10 < 3) {
+      sketch.Update(1);
+    } else if (i % 10 < 5) {
+      sketch.Update(2);
+    } else {
+      sketch.Update(1000 + i);
+    }
+  }
+  vector<HeavyHitterSketch::HeavyHitter> heavy_hitters;
+  sketch.GetHeavyHitters(0.1, &heavy_hitters);
+  ASSERT_EQ(2, heavy_hitters.size());
+  EXPECT_EQ(1, heavy_hitters[0].first);
+  EXPECT_EQ(2, heavy_hitters[1].first);
+  // Counts underestimate by at most num_updates / (capacity + 1).
+  EXPECT_LE(heavy_hitters[0].second, 3000);
+  EXPECT_GE(heavy_hitters[0].second, 3000 - 10000 / 9);
+  EXPECT_LE(heavy_hitters[1].second, 2000);
+  EXPECT_GE(heavy_hitters[1].second, 2000 - 10000 / 9);
+}
+
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,94 @@
+// Copyright 2016 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef IMPALA_UTIL_HEAVY_HITTER_SKETCH_H
+#define IMPALA_UTIL_HEAVY_HITTER_SKETCH_H
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "common/logging.h"
+
+namespace impala {
+
+/// Misra-Gries summary that finds the heavy hitters of a stream of 64-bit keys, e.g.
+/// the hash values of rows. With 'capacity' counters, every key whose frequency is more
+/// than 1 / (capacity + 1) of the stream is in the summary, and the count of a key
+/// underestimates its frequency by at most num_updates() / (capacity + 1).
+/// The counters are searched linearly, so the capacity should be small (e.g. 32).
+/// Not thread-safe.
+class HeavyHitterSketch {
+ public:
+  /// A key of the summary and its estimated number of occurrences.
+  typedef std::pair<uint64_t, int64_t> HeavyHitter;
+
+  explicit HeavyHitterSketch(int capacity) : capacity_(capacity), num_updates_(0) {
+    DCHECK_GT(capacity, 0);
+    counters_.reserve(capacity);
+  }
+
+  /// Adds one occurrence of 'key'.
+  void Update(uint64_t key) {
+    ++num_updates_;
+    for (HeavyHitter& counter: counters_) {
+      if (counter.first == key) {
+        ++counter.second;
+        return;
+      }
+    }
+    if (counters_.size() < capacity_) {
+      counters_.push_back(HeavyHitter(key, 1));
+      return;
+    }
+    // All counters are taken: decrement them all, which accounts for the new key.
+    int num_counters = 0;
+    for (int i = 0; i < counters_.size(); ++i) {
+      if (--counters_[i].second > 0) counters_[num_counters++] = counters_[i];
+    }
+    counters_.resize(num_counters);
+  }
+
+  /// Appends the keys whose estimated count is at least 'min_fraction' of num_updates()
+  /// to 'heavy_hitters', most frequent first.
+  void GetHeavyHitters(double min_fraction,
+      std::vector<HeavyHitter>* heavy_hitters) const {
+    int start = heavy_hitters->size();
+    for (const HeavyHitter& counter: counters_) {
+      if (counter.second >= min_fraction * num_updates_) {
+        heavy_hitters->push_back(counter);
+      }
+    }
+    std::sort(heavy_hitters->begin() + start, heavy_hitters->end(), CompareCounts);
+  }
+
+  int64_t num_updates() const { return num_updates_; }
+
+ private:
+  static bool CompareCounts(const HeavyHitter& a, const HeavyHitter& b) {
+    return a.second > b.second;
+  }
+
+  const int capacity_;
+
+  /// The keys of the summary with their counts, which are all positive.
+  std::vector<HeavyHitter> counters_;
+
+  /// Number of calls to Update().
+  int64_t num_updates_;
+};
+
+}
+
+#endif
@@ -17,6 +17,7 @@
 
 #include "util/hdr-histogram.h"
 #include "util/metrics.h"
+#include "util/time.h"
 
 namespace impala {
 
@@ -45,6 +46,8 @@ class HistogramMetric : public Metric {
         document->GetAllocator());
     container.AddMember("95th %-ile", histogram_.ValueAtPercentile(95),
         document->GetAllocator());
+    container.AddMember("99th %-ile", histogram_.ValueAtPercentile(99),
+        document->GetAllocator());
     container.AddMember("99.9th %-ile", histogram_.ValueAtPercentile(99.9),
         document->GetAllocator());
     container.AddMember("count", histogram_.TotalCount(), document->GetAllocator());
@@ -77,6 +80,8 @@ class HistogramMetric : public Metric {
         << PrettyPrinter::Print(histogram_.ValueAtPercentile(90), unit_) << ", "
         << "95th %-ile: "
         << PrettyPrinter::Print(histogram_.ValueAtPercentile(95), unit_) << ", "
+        << "99th %-ile: "
+        << PrettyPrinter::Print(histogram_.ValueAtPercentile(99), unit_) << ", "
         << "99.9th %-ile: "
         << PrettyPrinter::Print(histogram_.ValueAtPercentile(99.9), unit_);
     return out.str();
@@ -88,6 +93,22 @@ class HistogramMetric : public Metric {
   const TUnit::type unit_;
 };
 
+/// Adds the time in nanoseconds between its construction and destruction to a
+/// histogram, which must have unit TIME_NS. Does nothing if 'metric' is NULL.
+class ScopedHistogramTimer {
+ public:
+  ScopedHistogramTimer(HistogramMetric* metric)
+    : metric_(metric), start_time_(metric == NULL ? 0 : MonotonicNanos()) { }
+
+  ~ScopedHistogramTimer() {
+    if (metric_ != NULL) metric_->Update(MonotonicNanos() - start_time_);
+  }
+
+ private:
+  HistogramMetric* metric_;
+  const int64_t start_time_;
+};
+
 }
 
 #endif
@@ -71,6 +71,20 @@ const char* ImpaladMetricKeys::IO_MGR_CACHED_FILE_HANDLES_HIT_COUNT =
     "impala-server.io.mgr.cached-file-handles-hit-count";
 const char* ImpaladMetricKeys::IO_MGR_CACHED_FILE_HANDLES_MISS_COUNT =
     "impala-server.io.mgr.cached-file-handles-miss-count";
+const char* ImpaladMetricKeys::IO_MGR_CACHED_FILE_HANDLES_EVICTED_COUNT =
+    "impala-server.io.mgr.cached-file-handles-evicted-count";
+const char* ImpaladMetricKeys::PARQUET_FOOTER_CACHE_HIT_COUNT =
+    "impala-server.parquet-footer-cache.hit-count";
+const char* ImpaladMetricKeys::PARQUET_FOOTER_CACHE_MISS_COUNT =
+    "impala-server.parquet-footer-cache.miss-count";
+const char* ImpaladMetricKeys::PARQUET_FOOTER_CACHE_TOTAL_BYTES =
+    "impala-server.parquet-footer-cache.total-bytes";
+const char* ImpaladMetricKeys::CODEGEN_CACHE_HIT_COUNT =
+    "impala-server.codegen-cache.hit-count";
+const char* ImpaladMetricKeys::CODEGEN_CACHE_MISS_COUNT =
+    "impala-server.codegen-cache.miss-count";
+const char* ImpaladMetricKeys::CODEGEN_CACHE_TOTAL_BYTES =
+    "impala-server.codegen-cache.total-bytes";
 const char* ImpaladMetricKeys::CATALOG_NUM_DBS =
     "catalog.num-databases";
 const char* ImpaladMetricKeys::CATALOG_NUM_TABLES =
@@ -97,6 +111,16 @@ const char* ImpaladMetricKeys::QUERY_DURATIONS =
     "impala-server.query-durations-ms";
 const char* ImpaladMetricKeys::DDL_DURATIONS =
     "impala-server.ddl-durations-ms";
+const char* ImpaladMetricKeys::FRAGMENT_PREPARE_DURATIONS =
+    "impala-server.fragment-prepare-durations";
+const char* ImpaladMetricKeys::FRAGMENT_OPEN_DURATIONS =
+    "impala-server.fragment-open-durations";
+const char* ImpaladMetricKeys::CANCEL_REMOTE_FRAGMENTS_DURATIONS =
+    "impala-server.cancel-remote-fragments-durations";
+const char* ImpaladMetricKeys::BUFFERED_BLOCK_MGR_WRITE_LATENCY =
+    "buffered-block-mgr.write-latency";
+const char* ImpaladMetricKeys::BUFFERED_BLOCK_MGR_PIN_LATENCY =
+    "buffered-block-mgr.pin-latency";
 
 // These are created by impala-server during startup.
 // =======
@@ -115,6 +139,10 @@ IntCounter* ImpaladMetrics::IO_MGR_LOCAL_BYTES_READ = NULL;
 IntCounter* ImpaladMetrics::IO_MGR_SHORT_CIRCUIT_BYTES_READ = NULL;
 IntCounter* ImpaladMetrics::IO_MGR_CACHED_BYTES_READ = NULL;
 IntCounter* ImpaladMetrics::IO_MGR_BYTES_WRITTEN = NULL;
+IntCounter* ImpaladMetrics::PARQUET_FOOTER_CACHE_HIT_COUNT = NULL;
+IntCounter* ImpaladMetrics::PARQUET_FOOTER_CACHE_MISS_COUNT = NULL;
+IntCounter* ImpaladMetrics::CODEGEN_CACHE_HIT_COUNT = NULL;
+IntCounter* ImpaladMetrics::CODEGEN_CACHE_MISS_COUNT = NULL;
 
 // Gauges
 IntGauge* ImpaladMetrics::CATALOG_NUM_DBS = NULL;
@@ -128,9 +156,12 @@ IntGauge* ImpaladMetrics::IO_MGR_NUM_CACHED_FILE_HANDLES = NULL;
 IntGauge* ImpaladMetrics::IO_MGR_NUM_FILE_HANDLES_OUTSTANDING = NULL;
 IntGauge* ImpaladMetrics::IO_MGR_CACHED_FILE_HANDLES_HIT_COUNT = NULL;
 IntGauge* ImpaladMetrics::IO_MGR_CACHED_FILE_HANDLES_MISS_COUNT = NULL;
+IntGauge* ImpaladMetrics::IO_MGR_CACHED_FILE_HANDLES_EVICTED_COUNT = NULL;
 IntGauge* ImpaladMetrics::IO_MGR_TOTAL_BYTES = NULL;
 IntGauge* ImpaladMetrics::MEM_POOL_TOTAL_BYTES = NULL;
 IntGauge* ImpaladMetrics::NUM_FILES_OPEN_FOR_INSERT = NULL;
+IntGauge* ImpaladMetrics::PARQUET_FOOTER_CACHE_TOTAL_BYTES = NULL;
+IntGauge* ImpaladMetrics::CODEGEN_CACHE_TOTAL_BYTES = NULL;
 IntGauge* ImpaladMetrics::RESULTSET_CACHE_TOTAL_NUM_ROWS = NULL;
 IntGauge* ImpaladMetrics::RESULTSET_CACHE_TOTAL_BYTES = NULL;
 
@@ -143,6 +174,11 @@ StringProperty* ImpaladMetrics::IMPALA_SERVER_VERSION = NULL;
 // Histograms
 HistogramMetric* ImpaladMetrics::QUERY_DURATIONS = NULL;
 HistogramMetric* ImpaladMetrics::DDL_DURATIONS = NULL;
+HistogramMetric* ImpaladMetrics::FRAGMENT_PREPARE_DURATIONS = NULL;
+HistogramMetric* ImpaladMetrics::FRAGMENT_OPEN_DURATIONS = NULL;
+HistogramMetric* ImpaladMetrics::CANCEL_REMOTE_FRAGMENTS_DURATIONS = NULL;
+HistogramMetric* ImpaladMetrics::BUFFERED_BLOCK_MGR_WRITE_LATENCY = NULL;
+HistogramMetric* ImpaladMetrics::BUFFERED_BLOCK_MGR_PIN_LATENCY = NULL;
 
 // Other
 StatsMetric<uint64_t, StatsType::MEAN>*
@@ -212,6 +248,9 @@ void ImpaladMetrics::CreateMetrics(MetricGroup* m) {
   IO_MGR_CACHED_FILE_HANDLES_MISS_COUNT = m->AddGauge<int64_t>(
       ImpaladMetricKeys::IO_MGR_CACHED_FILE_HANDLES_MISS_COUNT, 0);
 
+  IO_MGR_CACHED_FILE_HANDLES_EVICTED_COUNT = m->AddGauge<int64_t>(
+      ImpaladMetricKeys::IO_MGR_CACHED_FILE_HANDLES_EVICTED_COUNT, 0);
+
   IO_MGR_BYTES_READ = m->AddCounter<int64_t>(ImpaladMetricKeys::IO_MGR_BYTES_READ, 0);
   IO_MGR_LOCAL_BYTES_READ = m->AddCounter<int64_t>(
       ImpaladMetricKeys::IO_MGR_LOCAL_BYTES_READ, 0);
@@ -226,6 +265,22 @@ void ImpaladMetrics::CreateMetrics(MetricGroup* m) {
       StatsMetric<uint64_t, StatsType::MEAN>::CreateAndRegister(m,
       ImpaladMetricKeys::IO_MGR_CACHED_FILE_HANDLES_HIT_RATIO);
 
+  // Initialize Parquet footer cache metrics
+  PARQUET_FOOTER_CACHE_HIT_COUNT = m->AddCounter<int64_t>(
+      ImpaladMetricKeys::PARQUET_FOOTER_CACHE_HIT_COUNT, 0);
+  PARQUET_FOOTER_CACHE_MISS_COUNT = m->AddCounter<int64_t>(
+      ImpaladMetricKeys::PARQUET_FOOTER_CACHE_MISS_COUNT, 0);
+  PARQUET_FOOTER_CACHE_TOTAL_BYTES = m->AddGauge<int64_t>(
+      ImpaladMetricKeys::PARQUET_FOOTER_CACHE_TOTAL_BYTES, 0);
+
+  // Initialize codegen cache metrics
+  CODEGEN_CACHE_HIT_COUNT = m->AddCounter<int64_t>(
+      ImpaladMetricKeys::CODEGEN_CACHE_HIT_COUNT, 0);
+  CODEGEN_CACHE_MISS_COUNT = m->AddCounter<int64_t>(
+      ImpaladMetricKeys::CODEGEN_CACHE_MISS_COUNT, 0);
+  CODEGEN_CACHE_TOTAL_BYTES = m->AddGauge<int64_t>(
+      ImpaladMetricKeys::CODEGEN_CACHE_TOTAL_BYTES, 0);
+
   // Initialize catalog metrics
   CATALOG_NUM_DBS = m->AddGauge<int64_t>(ImpaladMetricKeys::CATALOG_NUM_DBS, 0);
   CATALOG_NUM_TABLES = m->AddGauge<int64_t>(ImpaladMetricKeys::CATALOG_NUM_TABLES, 0);
@@ -240,6 +295,26 @@ void ImpaladMetrics::CreateMetrics(MetricGroup* m) {
       MetricDefs::Get(ImpaladMetricKeys::QUERY_DURATIONS), FIVE_HOURS_IN_MS, 3));
   DDL_DURATIONS = m->RegisterMetric(new HistogramMetric(
       MetricDefs::Get(ImpaladMetricKeys::DDL_DURATIONS), FIVE_HOURS_IN_MS, 3));
+
+  // The latencies of the fragment phases and of spilling are tracked up to an hour, with
+  // two significant digits, which keeps their tails precise enough at a fraction of the
+  // memory.
+  const int64_t ONE_HOUR_IN_NS = 60L * 60L * 1000L * 1000L * 1000L;
+  FRAGMENT_PREPARE_DURATIONS = m->RegisterMetric(new HistogramMetric(MakeTMetricDef(
+      ImpaladMetricKeys::FRAGMENT_PREPARE_DURATIONS, TMetricKind::HISTOGRAM,
+      TUnit::TIME_NS), ONE_HOUR_IN_NS, 2));
+  FRAGMENT_OPEN_DURATIONS = m->RegisterMetric(new HistogramMetric(MakeTMetricDef(
+      ImpaladMetricKeys::FRAGMENT_OPEN_DURATIONS, TMetricKind::HISTOGRAM,
+      TUnit::TIME_NS), ONE_HOUR_IN_NS, 2));
+  CANCEL_REMOTE_FRAGMENTS_DURATIONS = m->RegisterMetric(new HistogramMetric(
+      MakeTMetricDef(ImpaladMetricKeys::CANCEL_REMOTE_FRAGMENTS_DURATIONS,
+          TMetricKind::HISTOGRAM, TUnit::TIME_NS), ONE_HOUR_IN_NS, 2));
+  BUFFERED_BLOCK_MGR_WRITE_LATENCY = m->RegisterMetric(new HistogramMetric(
+      MakeTMetricDef(ImpaladMetricKeys::BUFFERED_BLOCK_MGR_WRITE_LATENCY,
+          TMetricKind::HISTOGRAM, TUnit::TIME_NS), ONE_HOUR_IN_NS, 2));
+  BUFFERED_BLOCK_MGR_PIN_LATENCY = m->RegisterMetric(new HistogramMetric(
+      MakeTMetricDef(ImpaladMetricKeys::BUFFERED_BLOCK_MGR_PIN_LATENCY,
+          TMetricKind::HISTOGRAM, TUnit::TIME_NS), ONE_HOUR_IN_NS, 2));
 }
 
 }
@@ -106,6 +106,27 @@ class ImpaladMetricKeys {
   /// Number of cache misses for cached HDFS file handles
   static const char* IO_MGR_CACHED_FILE_HANDLES_MISS_COUNT;
 
+  /// Number of cached HDFS file handles that were closed to make room for others
+  static const char* IO_MGR_CACHED_FILE_HANDLES_EVICTED_COUNT;
+
+  /// Number of Parquet file footers that were found in the footer cache
+  static const char* PARQUET_FOOTER_CACHE_HIT_COUNT;
+
+  /// Number of Parquet file footers that were not found in the footer cache
+  static const char* PARQUET_FOOTER_CACHE_MISS_COUNT;
+
+  /// Estimated number of bytes used by the Parquet footer cache
+  static const char* PARQUET_FOOTER_CACHE_TOTAL_BYTES;
+
+  /// Number of compiled modules that were found in the codegen cache
+  static const char* CODEGEN_CACHE_HIT_COUNT;
+
+  /// Number of compiled modules that were not found in the codegen cache
+  static const char* CODEGEN_CACHE_MISS_COUNT;
+
+  /// Estimated number of bytes used by the codegen cache
+  static const char* CODEGEN_CACHE_TOTAL_BYTES;
+
   /// Number of DBs in the catalog
   static const char* CATALOG_NUM_DBS;
 
@@ -139,6 +160,20 @@ class ImpaladMetricKeys {
   // Distribution of execution times for queries and DDL statements, in ms.
   static const char* QUERY_DURATIONS;
   static const char* DDL_DURATIONS;
+
+  // Distribution of the time taken by the Prepare() and Open() phases of plan fragments,
+  // in ns.
+  static const char* FRAGMENT_PREPARE_DURATIONS;
+  static const char* FRAGMENT_OPEN_DURATIONS;
+
+  // Distribution of the time coordinators take to cancel the remote fragments of a
+  // query, in ns.
+  static const char* CANCEL_REMOTE_FRAGMENTS_DURATIONS;
+
+  // Distribution of the time taken by writes of spilled blocks and by pins of blocks in
+  // the buffered block managers, in ns.
+  static const char* BUFFERED_BLOCK_MGR_WRITE_LATENCY;
+  static const char* BUFFERED_BLOCK_MGR_PIN_LATENCY;
 };
 
 /// Global impalad-wide metrics.  This is useful for objects that want to update metrics
@@ -162,6 +197,10 @@ class ImpaladMetrics {
   static IntCounter* IO_MGR_CACHED_BYTES_READ;
   static IntCounter* IO_MGR_SHORT_CIRCUIT_BYTES_READ;
   static IntCounter* IO_MGR_BYTES_WRITTEN;
+  static IntCounter* PARQUET_FOOTER_CACHE_HIT_COUNT;
+  static IntCounter* PARQUET_FOOTER_CACHE_MISS_COUNT;
+  static IntCounter* CODEGEN_CACHE_HIT_COUNT;
+  static IntCounter* CODEGEN_CACHE_MISS_COUNT;
 
   // Gauges
   static IntGauge* CATALOG_NUM_DBS;
@@ -175,9 +214,12 @@ class ImpaladMetrics {
   static IntGauge* IO_MGR_NUM_FILE_HANDLES_OUTSTANDING;
   static IntGauge* IO_MGR_CACHED_FILE_HANDLES_HIT_COUNT;
   static IntGauge* IO_MGR_CACHED_FILE_HANDLES_MISS_COUNT;
+  static IntGauge* IO_MGR_CACHED_FILE_HANDLES_EVICTED_COUNT;
   static IntGauge* IO_MGR_TOTAL_BYTES;
   static IntGauge* MEM_POOL_TOTAL_BYTES;
   static IntGauge* NUM_FILES_OPEN_FOR_INSERT;
+  static IntGauge* PARQUET_FOOTER_CACHE_TOTAL_BYTES;
+  static IntGauge* CODEGEN_CACHE_TOTAL_BYTES;
   static IntGauge* RESULTSET_CACHE_TOTAL_NUM_ROWS;
   static IntGauge* RESULTSET_CACHE_TOTAL_BYTES;
   // Properties
@@ -188,6 +230,11 @@ class ImpaladMetrics {
   // Histograms
   static HistogramMetric* QUERY_DURATIONS;
   static HistogramMetric* DDL_DURATIONS;
+  static HistogramMetric* FRAGMENT_PREPARE_DURATIONS;
+  static HistogramMetric* FRAGMENT_OPEN_DURATIONS;
+  static HistogramMetric* CANCEL_REMOTE_FRAGMENTS_DURATIONS;
+  static HistogramMetric* BUFFERED_BLOCK_MGR_WRITE_LATENCY;
+  static HistogramMetric* BUFFERED_BLOCK_MGR_PIN_LATENCY;
 
   // Other
   static StatsMetric<uint64_t, StatsType::MEAN>* IO_MGR_CACHED_FILE_HANDLES_HIT_RATIO;
@@ -42,29 +42,39 @@ namespace impala {
 ///     64 bits for time of day in nanoseconds.
 ///     All numbers assumed unsigned.
 /// Strings:
-///     Write one character at a time with a null byte at the end (inverted if
-///     sort descending). Unlike other data types, we may write partial strings.
-///     NOTE: This assumes strings do not contain null characters.
+///     Write as many characters as fit and pad the rest of the key with zero bytes
+///     (inverted if sort descending), so a string sorts before the strings it is a
+///     prefix of. Since a zero character is indistinguishable from the padding, equal
+///     normalized strings are not necessarily equal, and a string always ends the key.
 /// Booleans/Nulls:
 ///     Left as-is.
 //
 /// Finally, we pad any remaining bytes of the key with zeroes.
+//
+/// Timestamps are not normalized by callers that need an order that is consistent with
+/// RawValue::Compare(), see CanNormalize().
 class KeyNormalizer {
  public:
   /// Initializes the normalizer with the key exprs and length alloted to each normalized
   /// key.
-  KeyNormalizer(const std::vector<ExprContext*>& key_exprs_ctxs, int key_len,
+  KeyNormalizer(const std::vector<ExprContext*>& key_expr_ctxs, int key_len,
       const std::vector<bool>& is_asc, const std::vector<bool>& nulls_first)
       : key_expr_ctxs_(key_expr_ctxs), key_len_(key_len), is_asc_(is_asc),
         nulls_first_(nulls_first) {
   }
 
   /// Normalizes all keys and writes the value into dst.
-  /// Returns true if we went over the max key size while writing the key.
-  /// If the return value is true, then key_idx_over_budget will be set to
-  /// the index of the key expr which went over.
+  /// Returns true if we went over the max key size while writing the key, or if the key
+  /// ended with a string. In that case equal normalized keys do not imply equal keys
+  /// and key_idx_over_budget will be set to the index of the key expr which went over.
   /// TODO: Handle non-nullable columns
-  bool NormalizeKey(TupleRow* tuple_row, uint8_t* dst, int* key_idx_over_budget = NULL);
+  bool NormalizeKey(const TupleRow* tuple_row, uint8_t* dst,
+      int* key_idx_over_budget = NULL);
+
+  /// Returns true if normalized keys of 'type' compare like RawValue::Compare(), or
+  /// only differ in the order of values that compare as equal (e.g. -0.0 and 0.0).
+  /// Timestamps are excluded because the normalization assumes valid dates.
+  static bool CanNormalize(const ColumnType& type);
 
  private:
   /// Returns true if we went over the max key size while writing the null bit.
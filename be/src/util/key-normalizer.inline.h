@@ -19,6 +19,7 @@
 
 #include <boost/date_time/gregorian/gregorian_types.hpp>
 
+#include "exprs/expr-context.h"
 #include "runtime/descriptors.h"
 #include "runtime/string-value.h"
 #include "runtime/timestamp-value.h"
@@ -125,18 +126,16 @@ inline bool KeyNormalizer::WriteNormalizedKey(const ColumnType& type, bool is_as
     case TYPE_VARCHAR: {
       StringValue* string_val = reinterpret_cast<StringValue*>(value);
 
-      // Copy the string over, with an additional NULL at the end.
+      // Copy as much of the string as fits and pad the rest of the key.
       int size = std::min(string_val->len, *bytes_left);
       for (int i = 0; i < size; ++i) {
         StoreFinalValue<uint8_t>(string_val->ptr[i], dst + i, is_asc);
       }
-      *bytes_left -= size;
-
-      if (*bytes_left == 0) return true;
-
-      StoreFinalValue<uint8_t>(0, dst + size, is_asc);
-      --*bytes_left;
-      return false;
+      for (int i = size; i < *bytes_left; ++i) {
+        StoreFinalValue<uint8_t>(0, dst + i, is_asc);
+      }
+      *bytes_left = 0;
+      return true;
     }
 
     case TYPE_BOOLEAN:
@@ -159,8 +158,28 @@ inline bool KeyNormalizer::NormalizeKeyColumn(const ColumnType& type, uint8_t nu
   return WriteNormalizedKey(type, is_asc, value, dst + 1, bytes_left);
 }
 
-inline bool KeyNormalizer::NormalizeKey(TupleRow* row, uint8_t* dst,
+inline bool KeyNormalizer::CanNormalize(const ColumnType& type) {
+  switch (type.type) {
+    case TYPE_BOOLEAN:
+    case TYPE_TINYINT:
+    case TYPE_SMALLINT:
+    case TYPE_INT:
+    case TYPE_BIGINT:
+    case TYPE_FLOAT:
+    case TYPE_DOUBLE:
+    case TYPE_STRING:
+    case TYPE_VARCHAR:
+      return true;
+    default:
+      return false;
+  }
+}
+
+inline bool KeyNormalizer::NormalizeKey(const TupleRow* row, uint8_t* dst,
     int* key_idx_over_budget) {
+  // Zero the key first, so that the bytes of a key that went over the budget are
+  // deterministic.
+  bzero(dst, key_len_);
   int bytes_left = key_len_;
   for (int i = 0; i < key_expr_ctxs_.size(); ++i) {
     uint8_t* key = reinterpret_cast<uint8_t*>(key_expr_ctxs_[i]->GetValue(row));
@@ -172,11 +191,6 @@ inline bool KeyNormalizer::NormalizeKey(TupleRow* row, uint8_t* dst,
       return true;
     }
   }
-
-  // Zero out any unused bytes of the sort key.
-  int offset = key_len_ - bytes_left;
-  bzero(dst + offset, bytes_left);
-
   return false;
 }
 
@@ -0,0 +1,130 @@
+// Copyright 2013 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <boost/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <gtest/gtest.h>
+
+#include "util/lock-free-blocking-queue.h"
+
+#include "common/names.h"
+
+namespace impala {
+
+TEST(LockFreeBlockingQueueTest, TestBasic) {
+  int32_t i;
+  LockFreeBlockingQueue<int32_t> test_queue(5);
+  ASSERT_TRUE(test_queue.BlockingPut(1));
+  ASSERT_TRUE(test_queue.BlockingPut(2));
+  ASSERT_TRUE(test_queue.BlockingPut(3));
+  ASSERT_EQ(3, test_queue.GetSize());
+  ASSERT_TRUE(test_queue.BlockingGet(&i));
+  ASSERT_EQ(1, i);
+  ASSERT_TRUE(test_queue.BlockingGet(&i));
+  ASSERT_EQ(2, i);
+  ASSERT_TRUE(test_queue.BlockingGet(&i));
+  ASSERT_EQ(3, i);
+  ASSERT_EQ(0, test_queue.GetSize());
+
+  // The positions wrap around the slots.
+  for (int j = 0; j < 12; ++j) {
+    ASSERT_TRUE(test_queue.BlockingPut(j));
+    ASSERT_TRUE(test_queue.BlockingGet(&i));
+    ASSERT_EQ(j, i);
+  }
+}
+
+TEST(LockFreeBlockingQueueTest, TestGetFromShutdownQueue) {
+  int64_t i;
+  LockFreeBlockingQueue<int64_t> test_queue(2);
+  ASSERT_TRUE(test_queue.BlockingPut(123));
+  test_queue.Shutdown();
+  ASSERT_FALSE(test_queue.BlockingPut(456));
+  ASSERT_TRUE(test_queue.BlockingGet(&i));
+  ASSERT_EQ(123, i);
+  ASSERT_FALSE(test_queue.BlockingGet(&i));
+}
+
+TEST(LockFreeBlockingQueueTest, TestPutWithTimeout) {
+  int64_t i;
+  LockFreeBlockingQueue<int64_t> test_queue(2);
+  int64_t timeout_micros = 100 * 1000L; // 100 msecs
+  ASSERT_TRUE(test_queue.BlockingPutWithTimeout(1, timeout_micros));
+  ASSERT_TRUE(test_queue.BlockingPutWithTimeout(2, timeout_micros));
+  boost::system_time now_plus_timeout = boost::get_system_time() +
+      boost::posix_time::microseconds(timeout_micros);
+  ASSERT_FALSE(test_queue.BlockingPutWithTimeout(3, timeout_micros));
+  ASSERT_LE(now_plus_timeout, boost::get_system_time());
+  ASSERT_TRUE(test_queue.BlockingGet(&i));
+  ASSERT_TRUE(test_queue.BlockingPutWithTimeout(3, timeout_micros));
+}
+
+// Tests that Shutdown() wakes up parked producers and consumers.
+TEST(LockFreeBlockingQueueTest, TestShutdownWakesWaiters) {
+  LockFreeBlockingQueue<int32_t> empty_queue(1);
+  LockFreeBlockingQueue<int32_t> full_queue(1);
+  ASSERT_TRUE(full_queue.BlockingPut(1));
+  bool got = true;
+  bool put = true;
+  thread consumer([&]() { int32_t i; got = empty_queue.BlockingGet(&i); });
+  thread producer([&]() { put = full_queue.BlockingPut(2); });
+  SleepForMs(100);
+  empty_queue.Shutdown();
+  full_queue.Shutdown();
+  consumer.join();
+  producer.join();
+  EXPECT_FALSE(got);
+  EXPECT_FALSE(put);
+}
+
+// Many producers and consumers hand elements through a small queue, so that both sides
+// park. Every element must be consumed exactly once.
+TEST(LockFreeBlockingQueueTest, TestMultipleThreads) {
+  const int iterations = 10000;
+  const int num_threads = 5;
+  LockFreeBlockingQueue<int32_t> queue(8);
+  mutex lock;
+  int num_producers = num_threads;
+  vector<int> gotten(num_threads + 1, 0);
+  thread_group threads;
+  for (int t = 0; t < num_threads; ++t) {
+    threads.add_thread(new thread([&, t]() {
+      for (int i = 0; i < iterations; ++i) queue.BlockingPut(t);
+      lock_guard<mutex> l(lock);
+      if (--num_producers == 0) queue.Shutdown();
+    }));
+  }
+  // One more consumer than producers, so that some consumers see the shutdown.
+  for (int t = 0; t <= num_threads; ++t) {
+    threads.add_thread(new thread([&]() {
+      for (int i = 0; i < iterations; ++i) {
+        int32_t val;
+        if (!queue.BlockingGet(&val)) val = num_threads;
+        lock_guard<mutex> l(lock);
+        ++gotten[val];
+      }
+    }));
+  }
+  threads.join_all();
+  for (int t = 0; t < num_threads; ++t) EXPECT_EQ(iterations, gotten[t]);
+  EXPECT_EQ(iterations, gotten[num_threads]);
+}
+
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  impala::OsInfo::Init();
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,341 @@
+// Copyright 2016 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef IMPALA_UTIL_LOCK_FREE_BLOCKING_QUEUE_H
+#define IMPALA_UTIL_LOCK_FREE_BLOCKING_QUEUE_H
+
+#include <boost/scoped_array.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "common/atomic.h"
+#include "common/logging.h"
+#include "gutil/port.h"
+#include "util/stopwatch.h"
+
+namespace impala {
+
+/// Fixed capacity FIFO queue with the interface and shutdown semantics of
+/// BlockingQueue, for queues that many threads hand elements through, e.g. the row
+/// batches of all scanner threads of a scan node.
+///
+/// The elements are kept in a ring buffer of 'max_elements' slots. Each slot carries a
+/// sequence number that tells producers and consumers whether it is free or holds an
+/// element for their position, so that Put and Get only need a compare-and-swap on the
+/// shared position (see Vyukov's bounded MPMC queue). A thread that finds the queue
+/// full or empty spins for a short while, and then parks on a condition variable. The
+/// mutex is only taken by parked threads and by the threads that wake them up.
+///
+/// Unlike BlockingQueue, the slots are allocated up-front, so 'max_elements' must be
+/// small. T must be default-constructible and assignable.
+template <typename T>
+class LockFreeBlockingQueue {
+ public:
+  LockFreeBlockingQueue(size_t max_elements)
+    : max_elements_(max_elements),
+      num_slots_(std::max<int64_t>(max_elements, 2)),
+      slots_(new Slot[num_slots_]),
+      enqueue_pos_(0),
+      dequeue_pos_(0),
+      shutdown_(0),
+      get_spin_limit_(MIN_SPIN_ITERATIONS),
+      put_spin_limit_(MIN_SPIN_ITERATIONS),
+      num_active_puts_(0),
+      num_get_waiters_(0),
+      num_put_waiters_(0),
+      total_get_wait_time_(0),
+      total_put_wait_time_(0) {
+    DCHECK_GT(max_elements, 0);
+    for (int64_t i = 0; i < num_slots_; ++i) slots_[i].sequence.Store(i);
+  }
+
+  /// Get an element from the queue, waiting indefinitely for one to become available.
+  /// Returns false if we were shut down prior to getting the element, and there
+  /// are no more elements available.
+  bool BlockingGet(T* out) {
+    if (TryGet(out)) {
+      WakeWaiter(&num_put_waiters_, &put_cv_);
+      return true;
+    }
+    MonotonicStopWatch timer;
+    timer.Start();
+    bool got = false;
+    int spins = get_spin_limit_.Load();
+    for (int i = 0; i < spins && !got && !IsDone(); ++i) {
+      AtomicUtil::CpuWait();
+      got = TryGet(out);
+    }
+    AdaptSpinLimit(&get_spin_limit_, spins, got);
+    if (got) {
+      WakeWaiter(&num_put_waiters_, &put_cv_);
+    } else {
+      boost::unique_lock<boost::mutex> l(lock_);
+      while (true) {
+        // Register as a waiter before checking again, so that a producer either sees
+        // the waiter or this thread sees its element.
+        num_get_waiters_.Add(1);
+        bool done = IsDone();
+        got = TryGet(out);
+        if (got || done) {
+          num_get_waiters_.Add(-1);
+          if (got) NotifyWaiterLocked(&num_put_waiters_, &put_cv_);
+          break;
+        }
+        get_cv_.wait(l);
+        num_get_waiters_.Add(-1);
+      }
+    }
+    total_get_wait_time_.Add(timer.ElapsedTime());
+    return got;
+  }
+
+  /// Puts an element into the queue, waiting indefinitely until there is space.
+  /// If the queue is shut down, returns false.
+  bool BlockingPut(const T& val) {
+    return Put(val, -1);
+  }
+
+  /// Puts an element into the queue, waiting until 'timeout_micros' elapses, if there is
+  /// no space. If the queue is shut down, or if the timeout elapsed without being able
+  /// to put the element, returns false.
+  bool BlockingPutWithTimeout(const T& val, int64_t timeout_micros) {
+    return Put(val, timeout_micros);
+  }
+
+  /// Shut down the queue. Wakes up all threads waiting on BlockingGet or BlockingPut.
+  void Shutdown() {
+    {
+      boost::lock_guard<boost::mutex> l(lock_);
+      shutdown_.Store(1);
+    }
+    get_cv_.notify_all();
+    put_cv_.notify_all();
+  }
+
+  /// Returns the number of elements in the queue. Only a snapshot while other threads
+  /// use the queue.
+  uint32_t GetSize() const {
+    int64_t size = enqueue_pos_.Load() - dequeue_pos_.Load();
+    return std::max<int64_t>(0, std::min<int64_t>(size, max_elements_));
+  }
+
+  /// Returns the total amount of time threads have blocked in BlockingGet.
+  uint64_t total_get_wait_time() const { return total_get_wait_time_.Load(); }
+
+  /// Returns the total amount of time threads have blocked in BlockingPut.
+  uint64_t total_put_wait_time() const { return total_put_wait_time_.Load(); }
+
+ private:
+  /// Bounds of the number of times a thread checks the queue again before it parks.
+  static const int MIN_SPIN_ITERATIONS = 4;
+  static const int MAX_SPIN_ITERATIONS = 1024;
+
+  struct Slot {
+    /// If equal to the position of the slot, the slot is free for the producer of that
+    /// position. If one greater, it holds the element for the consumer of that position.
+    AtomicInt64 sequence;
+    T value;
+  };
+
+  const int64_t max_elements_;
+
+  /// The sequence numbers of a single slot cannot tell a full slot from a free one, so
+  /// a queue of one element has two slots, and Put also checks the number of elements.
+  const int64_t num_slots_;
+  boost::scoped_array<Slot> slots_;
+
+  /// Positions of the next Put and the next Get. The slot of a position is at the
+  /// position modulo num_slots_.
+  AtomicInt64 enqueue_pos_ CACHELINE_ALIGNED;
+  AtomicInt64 dequeue_pos_ CACHELINE_ALIGNED;
+
+  /// 1 once Shutdown() was called.
+  AtomicInt32 shutdown_ CACHELINE_ALIGNED;
+
+  /// Number of times BlockingGet and Put currently spin. Doubled whenever spinning
+  /// succeeded and halved whenever the thread had to park anyway, so that threads only
+  /// spin while the other side usually catches up within the spin, e.g. not on a single
+  /// core.
+  AtomicInt32 get_spin_limit_;
+  AtomicInt32 put_spin_limit_;
+
+  /// Number of Put calls that may still add an element. BlockingGet only reports that
+  /// the queue is done once there are none after the shutdown.
+  AtomicInt32 num_active_puts_;
+
+  /// Number of threads that are parked, or about to park, in BlockingGet and in Put.
+  AtomicInt32 num_get_waiters_;
+  AtomicInt32 num_put_waiters_;
+
+  /// Taken by parked threads and by the threads that wake them up.
+  boost::mutex lock_;
+  boost::condition_variable get_cv_;
+  boost::condition_variable put_cv_;
+
+  AtomicInt64 total_get_wait_time_;
+  AtomicInt64 total_put_wait_time_;
+
+  /// Updates 'spin_limit' after a thread spun 'spins' times, see get_spin_limit_.
+  static void AdaptSpinLimit(AtomicInt32* spin_limit, int spins, bool success) {
+    if (success && spins < MAX_SPIN_ITERATIONS) {
+      spin_limit->Store(spins * 2);
+    } else if (!success && spins > MIN_SPIN_ITERATIONS) {
+      spin_limit->Store(spins / 2);
+    }
+  }
+
+  /// Returns true if the queue is shut down and no Put is in progress anymore, i.e. no
+  /// more elements can be added.
+  bool IsDone() const {
+    return shutdown_.Load() == 1 && num_active_puts_.Load() == 0;
+  }
+
+  /// Removes the first element into 'out' if there is one. Returns false if the queue
+  /// is empty.
+  bool TryGet(T* out) {
+    int64_t pos = dequeue_pos_.Load();
+    Slot* slot;
+    while (true) {
+      slot = &slots_[pos % num_slots_];
+      int64_t diff = slot->sequence.Load() - (pos + 1);
+      if (diff == 0) {
+        if (dequeue_pos_.CompareAndSwap(pos, pos + 1)) break;
+        pos = dequeue_pos_.Load();
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = dequeue_pos_.Load();
+      }
+    }
+    *out = slot->value;
+    slot->value = T();
+    slot->sequence.Store(pos + num_slots_);
+    return true;
+  }
+
+  /// Adds 'val' at the end of the queue if there is space. Returns false if the queue is
+  /// full.
+  bool TryPut(const T& val) {
+    int64_t pos = enqueue_pos_.Load();
+    Slot* slot;
+    while (true) {
+      slot = &slots_[pos % num_slots_];
+      int64_t diff = slot->sequence.Load() - pos;
+      if (diff == 0) {
+        if (num_slots_ > max_elements_ && pos - dequeue_pos_.Load() >= max_elements_) {
+          return false;
+        }
+        if (enqueue_pos_.CompareAndSwap(pos, pos + 1)) break;
+        pos = enqueue_pos_.Load();
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = enqueue_pos_.Load();
+      }
+    }
+    slot->value = val;
+    slot->sequence.Store(pos + 1);
+    return true;
+  }
+
+  /// Wakes up one thread waiting on 'cv' if 'num_waiters' shows that there may be one,
+  /// after the caller added or removed an element. The caller must not hold lock_.
+  void WakeWaiter(AtomicInt32* num_waiters, boost::condition_variable* cv) {
+    // The change of the queue must be visible before the waiters are checked.
+    AtomicUtil::MemoryBarrier();
+    if (num_waiters->Load() == 0) return;
+    {
+      // Waiters register and wait while holding lock_, so once it was taken, every
+      // registered waiter is waiting on 'cv'.
+      boost::lock_guard<boost::mutex> l(lock_);
+    }
+    cv->notify_one();
+  }
+
+  /// Same as WakeWaiter() for callers that hold lock_.
+  void NotifyWaiterLocked(AtomicInt32* num_waiters, boost::condition_variable* cv) {
+    AtomicUtil::MemoryBarrier();
+    if (num_waiters->Load() > 0) cv->notify_one();
+  }
+
+  /// Implements BlockingPut() and, if 'timeout_micros' is >= 0, BlockingPutWithTimeout().
+  bool Put(const T& val, int64_t timeout_micros) {
+    num_active_puts_.Add(1);
+    bool put = false;
+    if (shutdown_.Load() == 0) put = TryPut(val);
+    if (!put && shutdown_.Load() == 0) {
+      MonotonicStopWatch timer;
+      timer.Start();
+      int spins = put_spin_limit_.Load();
+      for (int i = 0; i < spins && !put && shutdown_.Load() == 0; ++i) {
+        AtomicUtil::CpuWait();
+        put = TryPut(val);
+      }
+      AdaptSpinLimit(&put_spin_limit_, spins, put);
+      // ParkAndPut() wakes up a consumer itself.
+      if (!put) {
+        put = ParkAndPut(val, timeout_micros);
+      } else {
+        WakeWaiter(&num_get_waiters_, &get_cv_);
+      }
+      total_put_wait_time_.Add(timer.ElapsedTime());
+    } else if (put) {
+      WakeWaiter(&num_get_waiters_, &get_cv_);
+    }
+    num_active_puts_.Add(-1);
+    if (!put) {
+      // Consumers that wait for the last Put after a shutdown must learn that it failed.
+      boost::lock_guard<boost::mutex> l(lock_);
+      if (shutdown_.Load() == 1) get_cv_.notify_all();
+    }
+    return put;
+  }
+
+  /// Parks the calling thread until 'val' was added to the queue, the queue was shut
+  /// down or 'timeout_micros' elapsed, if it is >= 0. Returns true if 'val' was added.
+  bool ParkAndPut(const T& val, int64_t timeout_micros) {
+    boost::system_time deadline = boost::get_system_time() +
+        boost::posix_time::microseconds(std::max<int64_t>(0, timeout_micros));
+    boost::unique_lock<boost::mutex> l(lock_);
+    while (true) {
+      num_put_waiters_.Add(1);
+      if (shutdown_.Load() == 1) {
+        num_put_waiters_.Add(-1);
+        return false;
+      }
+      if (TryPut(val)) {
+        num_put_waiters_.Add(-1);
+        NotifyWaiterLocked(&num_get_waiters_, &get_cv_);
+        return true;
+      }
+      bool notified = true;
+      if (timeout_micros < 0) {
+        put_cv_.wait(l);
+      } else {
+        notified = put_cv_.timed_wait(l, deadline);
+      }
+      num_put_waiters_.Add(-1);
+      if (!notified || (timeout_micros >= 0 && boost::get_system_time() >= deadline)) {
+        // Try one last time, like BlockingQueue does after a timeout.
+        if (shutdown_.Load() == 1 || !TryPut(val)) return false;
+        NotifyWaiterLocked(&num_get_waiters_, &get_cv_);
+        return true;
+      }
+    }
+  }
+};
+
+}
+
+#endif
@@ -149,6 +149,59 @@ TEST(FifoMultimap, PopShouldPopMostRecent) {
   ASSERT_EQ(0, c.size());
 }
 
+TEST(LruCache, Basic) {
+  LruCache<int, int> c(10);
+  int result;
+  ASSERT_EQ(10, c.capacity());
+  c.Put(0, 1, 4);
+  c.Put(1, 2, 4);
+  ASSERT_EQ(2, c.size());
+  ASSERT_EQ(8, c.total_charge());
+  ASSERT_FALSE(c.Get(99, &result));
+  // Get() does not remove the value.
+  ASSERT_TRUE(c.Get(0, &result));
+  ASSERT_EQ(1, result);
+  ASSERT_TRUE(c.Get(0, &result));
+  ASSERT_EQ(1, result);
+  // Put() replaces the value of an existing key.
+  c.Put(0, 3, 2);
+  ASSERT_EQ(2, c.size());
+  ASSERT_EQ(6, c.total_charge());
+  ASSERT_TRUE(c.Get(0, &result));
+  ASSERT_EQ(3, result);
+}
+
+TEST(LruCache, Evict) {
+  LruCache<int, int> c(10);
+  int result;
+  c.Put(0, 0, 3);
+  c.Put(1, 1, 3);
+  c.Put(2, 2, 3);
+  // Accessing 0 makes 1 the least recently used entry.
+  ASSERT_TRUE(c.Get(0, &result));
+  c.Put(3, 3, 3);
+  ASSERT_EQ(3, c.size());
+  ASSERT_FALSE(c.Get(1, &result));
+  ASSERT_TRUE(c.Get(0, &result));
+  // A large entry evicts several small ones.
+  c.Put(4, 4, 8);
+  ASSERT_EQ(1, c.size());
+  ASSERT_EQ(8, c.total_charge());
+  ASSERT_TRUE(c.Get(4, &result));
+  // Entries larger than the capacity are not added.
+  c.Put(5, 5, 11);
+  ASSERT_FALSE(c.Get(5, &result));
+  ASSERT_EQ(1, c.size());
+}
+
+TEST(LruCache, Invalid) {
+  LruCache<int, int> c(0);
+  int result;
+  c.Put(0, 1, 1);
+  ASSERT_EQ(0, c.size());
+  ASSERT_FALSE(c.Get(0, &result));
+}
+
 int main(int argc, char** argv) {
   ::testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
@@ -131,6 +131,85 @@ class FifoMultimap {
   static void DummyDeleter(Value* v) {}
 };
 
+/// Implementation of a byte-bounded LruCache.
+///
+/// The LruCache maps unique keys to values and charges each key-value pair a number of
+/// bytes that is provided by the caller when the pair is added. If the total charge
+/// exceeds `capacity` bytes, key-value pairs are evicted in least recently used order.
+/// Unlike the FifoMultimap, looking up a value does not remove it from the cache, so
+/// Value is typically a shared pointer to an immutable object that several readers use
+/// at the same time.
+///
+/// This class is thread-safe and protects its members using a spin lock. Evicted values
+/// are destroyed after the lock has been released. This class cannot be copied or
+/// assigned.
+template<typename Key, typename Value>
+class LruCache {
+ public:
+  /// Instantiates the cache with an upper bound of `capacity` bytes for the total charge
+  /// of all key-value pairs.
+  LruCache(int64_t capacity) : capacity_(capacity), total_charge_(0) {}
+
+  /// Adds a key-value pair that is charged `charge` bytes, replacing any value that is
+  /// already stored under `k`. Evicts the least recently used pairs until the total
+  /// charge fits into the capacity. Pairs that are larger than the capacity are not
+  /// added.
+  void Put(const Key& k, const Value& v, int64_t charge);
+
+  /// Looks up the value stored under `k`, copies it into `out` and marks it as the most
+  /// recently used. Returns false if there is no value for `k`.
+  bool Get(const Key& k, Value* out);
+
+  /// Returns the total number of entries in the cache.
+  size_t size() {
+    boost::lock_guard<SpinLock> g(lock_);
+    return cache_.size();
+  }
+
+  /// Returns the total charge of all entries in the cache.
+  int64_t total_charge() {
+    boost::lock_guard<SpinLock> g(lock_);
+    return total_charge_;
+  }
+
+  /// Returns the capacity of the cache in bytes.
+  int64_t capacity() const { return capacity_; }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(LruCache);
+
+  struct Entry {
+    Key key;
+    Value value;
+    int64_t charge;
+
+    Entry(const Key& k, const Value& v, int64_t c) : key(k), value(v), charge(c) {}
+  };
+
+  typedef std::list<Entry> ListType;
+  typedef std::map<Key, typename ListType::iterator> MapType;
+
+  /// Total capacity in bytes, cannot be changed at run-time.
+  const int64_t capacity_;
+
+  /// Protects access to cache_, lru_list_ and total_charge_.
+  SpinLock lock_;
+
+  /// The least recently used entry is stored at the beginning of the list. Entries are
+  /// moved to the end of the list when they are added or accessed.
+  ListType lru_list_;
+
+  /// Maps a key to its entry in lru_list_.
+  MapType cache_;
+
+  /// Sum of the charges of all entries in the cache.
+  int64_t total_charge_;
+
+  /// Removes the entry that 'it' points to from both internal collections and moves it
+  /// to 'evicted', so that the caller can destroy it after releasing the lock.
+  void EvictEntry(typename MapType::iterator it, ListType* evicted);
+};
+
 }
 
 #include "lru-cache.inline.h"
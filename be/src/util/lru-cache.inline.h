@@ -81,6 +81,48 @@ void FifoMultimap<Key, Value>::EvictValue() {
   --size_;
 }
 
+template <typename Key, typename Value>
+void LruCache<Key, Value>::Put(const Key& k, const Value& v, int64_t charge) {
+  DCHECK_GE(charge, 0);
+  // Destroyed after the lock is released.
+  ListType evicted;
+  {
+    boost::lock_guard<SpinLock> g(lock_);
+    typename MapType::iterator it = cache_.find(k);
+    if (it != cache_.end()) EvictEntry(it, &evicted);
+    if (charge > capacity_) return;
+    while (total_charge_ + charge > capacity_) {
+      DCHECK(!lru_list_.empty());
+      EvictEntry(cache_.find(lru_list_.front().key), &evicted);
+    }
+    typename ListType::iterator entry =
+        lru_list_.insert(lru_list_.end(), Entry(k, v, charge));
+    cache_.insert(std::make_pair(k, entry));
+    total_charge_ += charge;
+  }
+}
+
+template <typename Key, typename Value>
+bool LruCache<Key, Value>::Get(const Key& k, Value* out) {
+  boost::lock_guard<SpinLock> g(lock_);
+  typename MapType::iterator it = cache_.find(k);
+  if (it == cache_.end()) return false;
+  // Move the entry to the most recently used end of the list.
+  lru_list_.splice(lru_list_.end(), lru_list_, it->second);
+  *out = it->second->value;
+  return true;
+}
+
+template <typename Key, typename Value>
+void LruCache<Key, Value>::EvictEntry(typename MapType::iterator it, ListType* evicted) {
+  DCHECK(it != cache_.end());
+  typename ListType::iterator to_evict = it->second;
+  total_charge_ -= to_evict->charge;
+  DCHECK_GE(total_charge_, 0);
+  cache_.erase(it);
+  evicted->splice(evicted->end(), lru_list_, to_evict);
+}
+
 }
 
 #endif // IMPALA_UTIL_LRU_CACHE_INLINE_H_
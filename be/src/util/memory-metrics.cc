@@ -29,6 +29,7 @@ TcmallocMetric* TcmallocMetric::PAGEHEAP_FREE_BYTES = NULL;
 TcmallocMetric* TcmallocMetric::TOTAL_BYTES_RESERVED = NULL;
 TcmallocMetric* TcmallocMetric::PAGEHEAP_UNMAPPED_BYTES = NULL;
 TcmallocMetric::PhysicalBytesMetric* TcmallocMetric::PHYSICAL_BYTES_RESERVED = NULL;
+AtomicInt64 TcmallocMetric::MMAPPED_BYTES;
 
 TcmallocMetric* TcmallocMetric::CreateAndRegister(MetricGroup* metrics, const string& key,
   const string& tcmalloc_var) {
@@ -21,6 +21,7 @@
 #include <boost/bind.hpp>
 #include <gperftools/malloc_extension.h>
 
+#include "common/atomic.h"
 #include "util/debug-util.h"
 #include "gen-cpp/Frontend_types.h"
 
@@ -49,16 +50,21 @@ class TcmallocMetric : public UIntGauge {
   /// address space used, but not to the physical memory usage.
   static TcmallocMetric* PAGEHEAP_UNMAPPED_BYTES;
 
+  /// Number of bytes that were mapped directly from the operating system rather than
+  /// allocated through tcmalloc, e.g. MemPool chunks (see --mem_pool_mmap_chunk_size).
+  static AtomicInt64 MMAPPED_BYTES;
+
   /// Derived metric computing the amount of physical memory (in bytes) used by the
-  /// process, including that actually in use and free bytes reserved by tcmalloc. Does not
-  /// include the tcmalloc metadata.
+  /// process, including that actually in use and free bytes reserved by tcmalloc, and
+  /// MMAPPED_BYTES. Does not include the tcmalloc metadata.
   class PhysicalBytesMetric : public UIntGauge {
    public:
     PhysicalBytesMetric(const TMetricDef& def) : UIntGauge(def, 0) { }
 
    private:
     virtual void CalculateValue() {
-      value_ = TOTAL_BYTES_RESERVED->value() - PAGEHEAP_UNMAPPED_BYTES->value();
+      value_ = TOTAL_BYTES_RESERVED->value() - PAGEHEAP_UNMAPPED_BYTES->value() +
+          MMAPPED_BYTES.Load();
     }
   };
 
@@ -14,6 +14,7 @@
 
 #include "util/metrics.h"
 #include "util/collection-metrics.h"
+#include "util/histogram-metric.h"
 #include "util/memory-metrics.h"
 
 #include <gtest/gtest.h>
@@ -324,6 +325,30 @@ TEST_F(MetricsTest, StatsMetricsJson) {
   EXPECT_EQ(stats_val["stddev"].GetDouble(), 5.0);
 }
 
+TEST_F(MetricsTest, HistogramMetricsJson) {
+  MetricGroup metrics("HistogramMetrics");
+  HistogramMetric* metric = metrics.RegisterMetric(new HistogramMetric(MakeTMetricDef(
+      "histogram_metric", TMetricKind::HISTOGRAM, TUnit::TIME_NS), 1000000L, 3));
+  for (int i = 1; i <= 1000; ++i) metric->Update(i);
+  Document document;
+  Value val;
+  metrics.ToJson(true, &document, &val);
+  const Value& histogram_val = val["metrics"][0u];
+  EXPECT_EQ(histogram_val["count"].GetInt(), 1000);
+  EXPECT_EQ(histogram_val["50th %-ile"].GetInt(), 500);
+  EXPECT_EQ(histogram_val["99th %-ile"].GetInt(), 990);
+  EXPECT_EQ(histogram_val["99.9th %-ile"].GetInt(), 999);
+  EXPECT_EQ(histogram_val["kind"].GetString(), string("HISTOGRAM"));
+
+  {
+    ScopedHistogramTimer timer(metric);
+  }
+  Document timed_document;
+  Value timed_val;
+  metrics.ToJson(true, &timed_document, &timed_val);
+  EXPECT_EQ(timed_val["metrics"][0u]["count"].GetInt(), 1001);
+}
+
 TEST_F(MetricsTest, UnitsAndDescriptionJson) {
   MetricGroup metrics("Units");
   AddMetricDef("counter", TMetricKind::COUNTER, TUnit::BYTES, "description");
@@ -363,6 +388,32 @@ TEST_F(MetricsTest, MetricGroupJson) {
   EXPECT_EQ(val["child_groups"][1]["metrics"].Size(), 1);
 }
 
+TEST_F(MetricsTest, PrometheusText) {
+  MetricGroup metrics("PrometheusTest");
+  AddMetricDef("impala-server.num-queries", TMetricKind::COUNTER, TUnit::UNIT,
+      "Number of queries");
+  AddMetricDef("gauge", TMetricKind::GAUGE, TUnit::NONE, "A gauge");
+  AddMetricDef("str_property", TMetricKind::PROPERTY, TUnit::NONE);
+  IntCounter* counter = metrics.AddCounter<int64_t>("impala-server.num-queries", 42);
+  IntGauge* gauge = metrics.AddGauge<int64_t>("gauge", -3);
+  StringProperty* str_property = metrics.AddProperty<string>("str_property", "foo");
+
+  stringstream counter_text;
+  counter->ToPrometheus(&counter_text);
+  EXPECT_EQ(counter_text.str(), "# HELP impala_server_num_queries Number of queries\n"
+      "# TYPE impala_server_num_queries counter\n"
+      "impala_server_num_queries 42\n");
+
+  stringstream gauge_text;
+  gauge->ToPrometheus(&gauge_text);
+  EXPECT_EQ(gauge_text.str(), "# HELP gauge A gauge\n# TYPE gauge gauge\ngauge -3\n");
+
+  // String properties have no numeric value and are left out.
+  stringstream property_text;
+  str_property->ToPrometheus(&property_text);
+  EXPECT_EQ(property_text.str(), "");
+}
+
 }
 
 int main(int argc, char **argv) {
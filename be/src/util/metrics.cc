@@ -14,6 +14,7 @@
 
 #include "util/metrics.h"
 
+#include <ctype.h>
 #include <sstream>
 #include <boost/algorithm/string/join.hpp>
 #include <boost/bind.hpp>
@@ -52,6 +53,16 @@ void Metric::AddStandardFields(Document* document, Value* val) {
   val->AddMember("human_readable", metric_value, document->GetAllocator());
 }
 
+string Metric::PrometheusName() const {
+  string name = key_;
+  for (int i = 0; i < name.size(); ++i) {
+    char c = name[i];
+    if (!isalnum(c) && c != '_' && c != ':') name[i] = '_';
+  }
+  if (!name.empty() && isdigit(name[0])) name = "_" + name;
+  return name;
+}
+
 MetricDefs* MetricDefs::GetInstance() {
   // Note that this is not thread-safe in C++03 (but will be in C++11 see
   // http://stackoverflow.com/a/19907903/132034). We don't bother with the double-check
@@ -87,7 +98,12 @@ Status MetricGroup::Init(Webserver* webserver) {
 
     Webserver::UrlCallback json_callback =
         bind<void>(mem_fn(&MetricGroup::TemplateCallback), this, _1, _2);
-    webserver->RegisterUrlCallback("/metrics", "metrics.tmpl", json_callback);
+    webserver->RegisterUrlCallback("/metrics", "metrics.tmpl", json_callback, true,
+        true);
+
+    Webserver::RawUrlCallback prometheus_callback =
+        bind<void>(mem_fn(&MetricGroup::PrometheusCallback), this, _1, _2);
+    webserver->RegisterUrlCallback("/metrics_prometheus", prometheus_callback);
   }
 
   return Status::OK();
@@ -99,28 +115,55 @@ void MetricGroup::CMCompatibleCallback(const Webserver::ArgumentMap& args,
   // only. Otherwise, return document with list of all metrics at the top level.
   Webserver::ArgumentMap::const_iterator metric_name = args.find("metric");
 
-  lock_guard<SpinLock> l(lock_);
   if (metric_name != args.end()) {
-    MetricMap::const_iterator metric = metric_map_.find(metric_name->second);
-    if (metric != metric_map_.end()) {
-      metric->second->ToLegacyJson(document);
+    Metric* metric = NULL;
+    {
+      lock_guard<SpinLock> l(lock_);
+      MetricMap::const_iterator it = metric_map_.find(metric_name->second);
+      if (it != metric_map_.end()) metric = it->second;
     }
+    if (metric != NULL) metric->ToLegacyJson(document);
     return;
   }
 
   stack<MetricGroup*> groups;
   groups.push(this);
+  vector<Metric*> metrics;
+  vector<pair<string, MetricGroup*>> children;
   do {
     // Depth-first traversal of children to flatten all metrics, which is what was
     // expected by CM before we introduced metric groups.
     MetricGroup* group = groups.top();
     groups.pop();
-    for (const ChildGroupMap::value_type& child: group->children_) {
-      groups.push(child.second);
-    }
-    for (const MetricMap::value_type& m: group->metric_map_) {
-      m.second->ToLegacyJson(document);
-    }
+    metrics.clear();
+    children.clear();
+    group->GetSnapshot(&metrics, &children);
+    for (const pair<string, MetricGroup*>& child: children) groups.push(child.second);
+    for (Metric* metric: metrics) metric->ToLegacyJson(document);
+  } while (!groups.empty());
+}
+
+void MetricGroup::PrometheusCallback(const Webserver::ArgumentMap& args,
+    stringstream* output) {
+  MetricGroup* root = this;
+  Webserver::ArgumentMap::const_iterator metric_group = args.find("metric_group");
+  if (metric_group != args.end()) {
+    root = FindGroup(metric_group->second);
+    if (root == NULL) return;
+  }
+
+  stack<MetricGroup*> groups;
+  groups.push(root);
+  vector<Metric*> metrics;
+  vector<pair<string, MetricGroup*>> children;
+  do {
+    MetricGroup* group = groups.top();
+    groups.pop();
+    metrics.clear();
+    children.clear();
+    group->GetSnapshot(&metrics, &children);
+    for (const pair<string, MetricGroup*>& child: children) groups.push(child.second);
+    for (Metric* metric: metrics) metric->ToPrometheus(output);
   } while (!groups.empty());
 }
 
@@ -128,7 +171,6 @@ void MetricGroup::TemplateCallback(const Webserver::ArgumentMap& args,
     Document* document) {
   Webserver::ArgumentMap::const_iterator metric_group = args.find("metric_group");
 
-  lock_guard<SpinLock> l(lock_);
   // If no particular metric group is requested, render this metric group (and all its
   // children).
   if (metric_group == args.end()) {
@@ -138,24 +180,7 @@ void MetricGroup::TemplateCallback(const Webserver::ArgumentMap& args,
     return;
   }
 
-  // Search all metric groups to find the one we're looking for. In the future, we'll
-  // change this to support path-based resolution of metric groups.
-  MetricGroup* found_group = NULL;
-  stack<MetricGroup*> groups;
-  groups.push(this);
-  while (!groups.empty() && found_group == NULL) {
-    // Depth-first traversal of children to flatten all metrics, which is what was
-    // expected by CM before we introduced metric groups.
-    MetricGroup* group = groups.top();
-    groups.pop();
-    for (const ChildGroupMap::value_type& child: group->children_) {
-      if (child.first == metric_group->second) {
-        found_group = child.second;
-        break;
-      }
-      groups.push(child.second);
-    }
-  }
+  MetricGroup* found_group = FindGroup(metric_group->second);
   if (found_group != NULL) {
     Value container;
     found_group->ToJson(false, document, &container);
@@ -167,11 +192,45 @@ void MetricGroup::TemplateCallback(const Webserver::ArgumentMap& args,
   }
 }
 
+void MetricGroup::GetSnapshot(vector<Metric*>* metrics,
+    vector<pair<string, MetricGroup*>>* children) {
+  lock_guard<SpinLock> l(lock_);
+  if (metrics != NULL) {
+    for (const MetricMap::value_type& m: metric_map_) metrics->push_back(m.second);
+  }
+  if (children != NULL) {
+    children->insert(children->end(), children_.begin(), children_.end());
+  }
+}
+
+MetricGroup* MetricGroup::FindGroup(const string& name) {
+  // Search all metric groups to find the one we're looking for. In the future, we'll
+  // change this to support path-based resolution of metric groups.
+  stack<MetricGroup*> groups;
+  groups.push(this);
+  vector<pair<string, MetricGroup*>> children;
+  while (!groups.empty()) {
+    MetricGroup* group = groups.top();
+    groups.pop();
+    children.clear();
+    group->GetSnapshot(NULL, &children);
+    for (const pair<string, MetricGroup*>& child: children) {
+      if (child.first == name) return child.second;
+      groups.push(child.second);
+    }
+  }
+  return NULL;
+}
+
 void MetricGroup::ToJson(bool include_children, Document* document, Value* out_val) {
+  vector<Metric*> metrics;
+  vector<pair<string, MetricGroup*>> children;
+  GetSnapshot(&metrics, include_children ? &children : NULL);
+
   Value metric_list(kArrayType);
-  for (const MetricMap::value_type& m: metric_map_) {
+  for (Metric* metric: metrics) {
     Value metric_value;
-    m.second->ToJson(document, &metric_value);
+    metric->ToJson(document, &metric_value);
     metric_list.PushBack(metric_value, document->GetAllocator());
   }
 
@@ -180,7 +239,7 @@ void MetricGroup::ToJson(bool include_children, Document* document, Value* out_v
   container.AddMember("name", name_.c_str(), document->GetAllocator());
   if (include_children) {
     Value child_groups(kArrayType);
-    for (const ChildGroupMap::value_type& child: children_) {
+    for (const pair<string, MetricGroup*>& child: children) {
       Value child_value;
       child.second->ToJson(true, document, &child_value);
       child_groups.PushBack(child_value, document->GetAllocator());
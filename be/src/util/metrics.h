@@ -19,6 +19,7 @@
 #include <string>
 #include <sstream>
 #include <stack>
+#include <vector>
 #include <boost/function.hpp>
 #include <boost/scoped_ptr.hpp>
 #include <boost/thread/locks.hpp>
@@ -94,6 +95,10 @@ class Metric {
   /// representation that is often displayed in webpages etc.
   virtual std::string ToHumanReadable() = 0;
 
+  /// Appends this metric to 'out' in the Prometheus text exposition format. Metrics
+  /// without a single numeric value don't override this and are left out.
+  virtual void ToPrometheus(std::stringstream* out) { }
+
   const std::string& key() const { return key_; }
   const std::string& description() const { return description_; }
 
@@ -112,8 +117,29 @@ class Metric {
   /// Convenience method to add standard fields (name, description, human readable string)
   /// to 'val'.
   void AddStandardFields(rapidjson::Document* document, rapidjson::Value* val);
+
+  /// Convenience method to append the HELP, TYPE and sample lines of a metric with
+  /// 'value' to 'out' for ToPrometheus().
+  template <typename T>
+  void AddPrometheusSample(TMetricKind::type kind, const T& value,
+      std::stringstream* out) {
+    std::string name = PrometheusName();
+    *out << "# HELP " << name << " " << description_ << "\n"
+         << "# TYPE " << name << " "
+         << (kind == TMetricKind::COUNTER ? "counter" : "gauge") << "\n"
+         << name << " " << value << "\n";
+  }
+
+  /// Returns key_ with all characters that Prometheus doesn't allow in metric names
+  /// replaced by '_'.
+  std::string PrometheusName() const;
 };
 
+/// String metrics have no numeric value to export.
+template <>
+inline void Metric::AddPrometheusSample<std::string>(TMetricKind::type kind,
+    const std::string& value, std::stringstream* out) { }
+
 /// A SimpleMetric has a value which is a simple primitive type: e.g. integers, strings and
 /// floats. It is parameterised not only by the type of its value, but by both the unit
 /// (e.g. bytes/s), drawn from TUnit and the 'kind' of the metric itself. The kind
@@ -187,6 +213,10 @@ class SimpleMetric : public Metric {
     document->AddMember(key_.c_str(), val, document->GetAllocator());
   }
 
+  virtual void ToPrometheus(std::stringstream* out) {
+    AddPrometheusSample(kind(), value(), out);
+  }
+
   const TUnit::type unit() const { return unit_; }
   const TMetricKind::type kind() const { return metric_kind; }
 
@@ -310,7 +340,8 @@ class MetricGroup {
   /// Name of this metric group.
   std::string name_;
 
-  /// Guards metric_map_ and children_
+  /// Guards metric_map_ and children_. Webpage callbacks only hold it to take a
+  /// snapshot with GetSnapshot(), so that rendering doesn't block metric registration.
   SpinLock lock_;
 
   /// Contains all Metric objects, indexed by key
@@ -321,6 +352,21 @@ class MetricGroup {
   typedef std::map<std::string, MetricGroup*> ChildGroupMap;
   ChildGroupMap children_;
 
+  /// Appends the metrics and the child groups of this group to whichever of 'metrics'
+  /// and 'children' is not NULL, under lock_. Metrics and groups are never removed, so
+  /// the pointers remain valid after lock_ is released.
+  void GetSnapshot(std::vector<Metric*>* metrics,
+      std::vector<std::pair<std::string, MetricGroup*>>* children);
+
+  /// Returns the descendant group named 'name', or NULL if there is none.
+  MetricGroup* FindGroup(const std::string& name);
+
+  /// Webserver callback for /metrics_prometheus. Writes all metrics of this hierarchy
+  /// that have a numeric value in the Prometheus text format, without building a JSON
+  /// document. If args contains a parameter 'metric_group', only the metrics of that
+  /// group are written.
+  void PrometheusCallback(const Webserver::ArgumentMap& args, std::stringstream* output);
+
   /// Webserver callback for /metrics. Produces a tree of JSON values, each representing a
   /// metric group, and each including a list of metrics, and a list of immediate
   /// children.  If args contains a paramater 'metric', only the json for that metric is
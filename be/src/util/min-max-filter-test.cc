@@ -0,0 +1,105 @@
+// Copyright 2016 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "util/min-max-filter.h"
+
+#include <limits>
+
+#include <gtest/gtest.h>
+
+#include "common/names.h"
+
+namespace impala {
+
+TEST(MinMaxFilterTest, Empty) {
+  MinMaxFilter filter(ColumnType(TYPE_INT));
+  int32_t val = 0;
+  EXPECT_FALSE(filter.has_values());
+  EXPECT_FALSE(filter.Eval(&val));
+  EXPECT_FALSE(filter.Eval(NULL));
+}
+
+TEST(MinMaxFilterTest, Int) {
+  MinMaxFilter filter(ColumnType(TYPE_INT));
+  int32_t vals[] = { 10, -5, 7, 20 };
+  for (int32_t val: vals) filter.Insert(&val);
+  ASSERT_TRUE(filter.has_values());
+  for (int32_t val = -5; val <= 20; ++val) EXPECT_TRUE(filter.Eval(&val)) << val;
+  int32_t val = -6;
+  EXPECT_FALSE(filter.Eval(&val));
+  val = 21;
+  EXPECT_FALSE(filter.Eval(&val));
+  val = numeric_limits<int32_t>::min();
+  EXPECT_FALSE(filter.Eval(&val));
+
+  int32_t min_val;
+  int32_t max_val;
+  filter.GetMin(&min_val);
+  filter.GetMax(&max_val);
+  EXPECT_EQ(min_val, -5);
+  EXPECT_EQ(max_val, 20);
+
+  // NULLs only pass if a NULL was inserted.
+  EXPECT_FALSE(filter.Eval(NULL));
+  filter.Insert(NULL);
+  EXPECT_TRUE(filter.has_null());
+  EXPECT_TRUE(filter.Eval(NULL));
+  filter.GetMax(&max_val);
+  EXPECT_EQ(max_val, 20);
+}
+
+TEST(MinMaxFilterTest, NarrowTypes) {
+  MinMaxFilter filter(ColumnType(TYPE_TINYINT));
+  int8_t vals[] = { -128, 127 };
+  for (int8_t val: vals) filter.Insert(&val);
+  int8_t min_val;
+  int8_t max_val;
+  filter.GetMin(&min_val);
+  filter.GetMax(&max_val);
+  EXPECT_EQ(min_val, -128);
+  EXPECT_EQ(max_val, 127);
+  int8_t val = 0;
+  EXPECT_TRUE(filter.Eval(&val));
+}
+
+TEST(MinMaxFilterTest, Double) {
+  MinMaxFilter filter(ColumnType(TYPE_DOUBLE));
+  double nan = numeric_limits<double>::quiet_NaN();
+  filter.Insert(&nan);
+  EXPECT_FALSE(filter.has_values());
+  double vals[] = { 1.5, -0.0, 3.25 };
+  for (double val: vals) filter.Insert(&val);
+  double val = 0.0;
+  EXPECT_TRUE(filter.Eval(&val));
+  val = 3.25;
+  EXPECT_TRUE(filter.Eval(&val));
+  val = 3.26;
+  EXPECT_FALSE(filter.Eval(&val));
+  EXPECT_FALSE(filter.Eval(&nan));
+}
+
+TEST(MinMaxFilterTest, SupportedTypes) {
+  EXPECT_TRUE(MinMaxFilter::IsSupportedType(ColumnType(TYPE_BIGINT)));
+  EXPECT_TRUE(MinMaxFilter::IsSupportedType(ColumnType(TYPE_FLOAT)));
+  EXPECT_FALSE(MinMaxFilter::IsSupportedType(ColumnType(TYPE_STRING)));
+  EXPECT_FALSE(MinMaxFilter::IsSupportedType(ColumnType(TYPE_TIMESTAMP)));
+  EXPECT_FALSE(MinMaxFilter::IsSupportedType(ColumnType::CreateDecimalType(10, 2)));
+}
+
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
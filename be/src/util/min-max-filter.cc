@@ -0,0 +1,86 @@
+// Copyright 2016 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "util/min-max-filter.h"
+
+#include <sstream>
+
+#include "common/names.h"
+
+using namespace impala;
+
+MinMaxFilter::MinMaxFilter(const ColumnType& type)
+  : type_(type),
+    is_floating_point_(type.type == TYPE_FLOAT || type.type == TYPE_DOUBLE),
+    has_values_(false),
+    has_null_(false) {
+  DCHECK(IsSupportedType(type_)) << type_;
+  min_.int_val = 0;
+  max_.int_val = 0;
+}
+
+bool MinMaxFilter::IsSupportedType(const ColumnType& type) {
+  switch (type.type) {
+    case TYPE_TINYINT:
+    case TYPE_SMALLINT:
+    case TYPE_INT:
+    case TYPE_BIGINT:
+    case TYPE_FLOAT:
+    case TYPE_DOUBLE:
+      return true;
+    default:
+      return false;
+  }
+}
+
+void MinMaxFilter::WriteValue(const Value& val, void* slot) const {
+  DCHECK(has_values_);
+  switch (type_.type) {
+    case TYPE_TINYINT:
+      *reinterpret_cast<int8_t*>(slot) = val.int_val;
+      break;
+    case TYPE_SMALLINT:
+      *reinterpret_cast<int16_t*>(slot) = val.int_val;
+      break;
+    case TYPE_INT:
+      *reinterpret_cast<int32_t*>(slot) = val.int_val;
+      break;
+    case TYPE_BIGINT:
+      *reinterpret_cast<int64_t*>(slot) = val.int_val;
+      break;
+    case TYPE_FLOAT:
+      *reinterpret_cast<float*>(slot) = val.double_val;
+      break;
+    case TYPE_DOUBLE:
+      *reinterpret_cast<double*>(slot) = val.double_val;
+      break;
+    default:
+      DCHECK(false) << "Unsupported type: " << type_;
+  }
+}
+
+string MinMaxFilter::DebugString() const {
+  stringstream ss;
+  ss << "MinMaxFilter(type=" << type_;
+  if (has_values_) {
+    ss << " min=";
+    if (is_floating_point_) {
+      ss << min_.double_val << " max=" << max_.double_val;
+    } else {
+      ss << min_.int_val << " max=" << max_.int_val;
+    }
+  }
+  ss << " has_null=" << has_null_ << ")";
+  return ss.str();
+}
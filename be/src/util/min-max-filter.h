@@ -0,0 +1,148 @@
+// Copyright 2016 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef IMPALA_UTIL_MIN_MAX_FILTER_H
+#define IMPALA_UTIL_MIN_MAX_FILTER_H
+
+#include <stdint.h>
+#include <string>
+
+#include "common/logging.h"
+#include "runtime/types.h"
+
+namespace impala {
+
+/// A MinMaxFilter keeps the smallest and the largest value that was inserted into it,
+/// and whether a NULL was inserted. Unlike a BloomFilter, it does not need any memory
+/// beyond its fixed size and can be evaluated against ranges of values, e.g. the min/max
+/// statistics of Parquet column chunks. It is only selective if the inserted values are
+/// clustered, which is typical for dates and surrogate keys on the build side of a join.
+///
+/// Only fixed-width numeric types are supported (see IsSupportedType()). Values are
+/// passed in their slot representation; a NULL pointer represents a NULL value. NaNs are
+/// never inserted and never pass, as they do not compare equal to any value.
+class MinMaxFilter {
+ public:
+  /// 'type' must be supported, see IsSupportedType().
+  explicit MinMaxFilter(const ColumnType& type);
+
+  /// Returns true if filters can be built for values of 'type'.
+  static bool IsSupportedType(const ColumnType& type);
+
+  /// Adds 'val' to the filter.
+  inline void Insert(const void* val);
+
+  /// Returns false if 'val' is outside of the range of inserted values or, if 'val' is
+  /// NULL, if no NULL was inserted. Returns true otherwise.
+  inline bool Eval(const void* val) const;
+
+  /// Returns true if a non-NULL value was inserted. min() and max() are only valid then.
+  bool has_values() const { return has_values_; }
+
+  /// Returns true if a NULL was inserted.
+  bool has_null() const { return has_null_; }
+
+  /// Writes the smallest or the largest inserted value into 'slot', in the slot
+  /// representation of type(). The filter must have values.
+  void GetMin(void* slot) const { WriteValue(min_, slot); }
+  void GetMax(void* slot) const { WriteValue(max_, slot); }
+
+  const ColumnType& type() const { return type_; }
+
+  std::string DebugString() const;
+
+ private:
+  /// Integer types are widened to int64_t and floating point types to double.
+  union Value {
+    int64_t int_val;
+    double double_val;
+  };
+
+  /// Reads the slot value 'slot' into 'val'. Returns false if it is a NaN.
+  inline bool ReadValue(const void* slot, Value* val) const;
+
+  /// Writes 'val' into 'slot' in the slot representation of 'type_'.
+  void WriteValue(const Value& val, void* slot) const;
+
+  const ColumnType type_;
+
+  /// True if 'type_' is FLOAT or DOUBLE, i.e. the values are stored as 'double_val'.
+  const bool is_floating_point_;
+
+  bool has_values_;
+  bool has_null_;
+  Value min_;
+  Value max_;
+};
+
+inline bool MinMaxFilter::ReadValue(const void* slot, Value* val) const {
+  switch (type_.type) {
+    case TYPE_TINYINT:
+      val->int_val = *reinterpret_cast<const int8_t*>(slot);
+      return true;
+    case TYPE_SMALLINT:
+      val->int_val = *reinterpret_cast<const int16_t*>(slot);
+      return true;
+    case TYPE_INT:
+      val->int_val = *reinterpret_cast<const int32_t*>(slot);
+      return true;
+    case TYPE_BIGINT:
+      val->int_val = *reinterpret_cast<const int64_t*>(slot);
+      return true;
+    case TYPE_FLOAT:
+      val->double_val = *reinterpret_cast<const float*>(slot);
+      return val->double_val == val->double_val;
+    case TYPE_DOUBLE:
+      val->double_val = *reinterpret_cast<const double*>(slot);
+      return val->double_val == val->double_val;
+    default:
+      DCHECK(false) << "Unsupported type: " << type_;
+      return false;
+  }
+}
+
+inline void MinMaxFilter::Insert(const void* val) {
+  if (val == NULL) {
+    has_null_ = true;
+    return;
+  }
+  Value v;
+  if (!ReadValue(val, &v)) return;
+  if (!has_values_) {
+    min_ = v;
+    max_ = v;
+    has_values_ = true;
+  } else if (is_floating_point_) {
+    if (v.double_val < min_.double_val) min_.double_val = v.double_val;
+    if (v.double_val > max_.double_val) max_.double_val = v.double_val;
+  } else {
+    if (v.int_val < min_.int_val) min_.int_val = v.int_val;
+    if (v.int_val > max_.int_val) max_.int_val = v.int_val;
+  }
+}
+
+inline bool MinMaxFilter::Eval(const void* val) const {
+  if (val == NULL) return has_null_;
+  if (!has_values_) return false;
+  Value v;
+  if (!ReadValue(val, &v)) return false;
+  if (is_floating_point_) {
+    return v.double_val >= min_.double_val && v.double_val <= max_.double_val;
+  }
+  return v.int_val >= min_.int_val && v.int_val <= max_.int_val;
+}
+
+}
+
+#endif
@@ -112,6 +112,25 @@ TEST(ParseMemSpecs, Basic) {
   ASSERT_LT(bytes, 0);
 }
 
+TEST(ParsePoolWeights, Basic) {
+  map<string, int> weights;
+  string invalid_entry;
+  ASSERT_TRUE(ParseUtil::ParsePoolWeights("", &weights, &invalid_entry));
+  ASSERT_TRUE(weights.empty());
+
+  ASSERT_TRUE(ParseUtil::ParsePoolWeights("root.a:3,,root.b:1", &weights,
+      &invalid_entry));
+  ASSERT_EQ(2, weights.size());
+  ASSERT_EQ(3, weights["root.a"]);
+  ASSERT_EQ(1, weights["root.b"]);
+
+  ASSERT_FALSE(ParseUtil::ParsePoolWeights("root.a:3,root.b", &weights,
+      &invalid_entry));
+  ASSERT_EQ("root.b", invalid_entry);
+  ASSERT_FALSE(ParseUtil::ParsePoolWeights("root.a:0", &weights, &invalid_entry));
+  ASSERT_EQ("root.a:0", invalid_entry);
+}
+
 }
 
 int main(int argc, char **argv) {
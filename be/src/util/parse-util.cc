@@ -13,11 +13,18 @@
 // limitations under the License.
 
 #include "util/parse-util.h"
+
+#include <boost/algorithm/string.hpp>
+
 #include "util/mem-info.h"
 #include "util/string-parser.h"
 
 #include "common/names.h"
 
+using boost::algorithm::is_any_of;
+using boost::algorithm::split;
+using boost::algorithm::token_compress_on;
+
 namespace impala {
 
 int64_t ParseUtil::ParseMemSpec(const string& mem_spec_str, bool* is_percent,
@@ -92,4 +99,26 @@ int64_t ParseUtil::ParseMemSpec(const string& mem_spec_str, bool* is_percent,
   return bytes;
 }
 
+bool ParseUtil::ParsePoolWeights(const string& spec, map<string, int>* weights,
+    string* invalid_entry) {
+  vector<string> pool_weights;
+  split(pool_weights, spec, is_any_of(","), token_compress_on);
+  for (const string& pool_weight: pool_weights) {
+    if (pool_weight.empty()) continue;
+    size_t colon = pool_weight.rfind(':');
+    StringParser::ParseResult result = StringParser::PARSE_FAILURE;
+    int weight = 0;
+    if (colon != string::npos) {
+      weight = StringParser::StringToInt<int>(pool_weight.c_str() + colon + 1,
+          pool_weight.size() - colon - 1, &result);
+    }
+    if (result != StringParser::PARSE_SUCCESS || weight < 1) {
+      *invalid_entry = pool_weight;
+      return false;
+    }
+    (*weights)[pool_weight.substr(0, colon)] = weight;
+  }
+  return true;
+}
+
 }
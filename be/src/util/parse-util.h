@@ -15,6 +15,7 @@
 #ifndef IMPALA_UTIL_PARSE_UTIL_H
 #define IMPALA_UTIL_PARSE_UTIL_H
 
+#include <map>
 #include <string>
 #include <boost/cstdint.hpp>
 
@@ -38,6 +39,12 @@ class ParseUtil {
   /// Returns -1 if parsing failed.
   static int64_t ParseMemSpec(const std::string& mem_spec_str,
       bool* is_percent, int64_t relative_reference);
+
+  /// Parses a comma-separated list of '<request pool>:<weight>' pairs, with positive
+  /// integer weights, into 'weights'. Returns false and sets 'invalid_entry' to the first
+  /// entry that could not be parsed on failure.
+  static bool ParsePoolWeights(const std::string& spec,
+      std::map<std::string, int>* weights, std::string* invalid_entry);
 };
 
 }
@@ -0,0 +1,85 @@
+// Copyright 2016 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include "common/object-pool.h"
+#include "util/perf-event-counters.h"
+#include "util/thread.h"
+
+#include "common/names.h"
+
+namespace impala {
+
+// Runs a loop that the compiler cannot remove.
+static int64_t Work(int64_t n) {
+  volatile int64_t sum = 0;
+  for (int64_t i = 0; i < n; ++i) sum += i;
+  return sum;
+}
+
+TEST(PerfEventCountersTest, ThreadEvents) {
+  int64_t start[PerfEventCounters::NUM_EVENTS];
+  if (!PerfEventCounters::ReadThreadEvents(start)) {
+    LOG(WARNING) << "Perf events are not available, skipping test";
+    return;
+  }
+  Work(1000000);
+  int64_t end[PerfEventCounters::NUM_EVENTS];
+  ASSERT_TRUE(PerfEventCounters::ReadThreadEvents(end));
+  for (int i = 0; i < PerfEventCounters::NUM_EVENTS; ++i) EXPECT_GE(end[i], start[i]);
+  // Unsupported events stay at 0.
+  if (end[PerfEventCounters::INSTRUCTIONS] > 0) {
+    EXPECT_GT(end[PerfEventCounters::INSTRUCTIONS] -
+        start[PerfEventCounters::INSTRUCTIONS], 1000000);
+  }
+}
+
+TEST(PerfEventCountersTest, ProfileCounters) {
+  ObjectPool pool;
+  RuntimeProfile profile(&pool, "Profile");
+  RuntimeProfile::Counter* rows_counter = profile.AddCounter("Rows", TUnit::UNIT);
+  PerfEventCounters counters(&profile, rows_counter);
+  ASSERT_TRUE(profile.GetCounter("HWInstructionsPerCycle") != NULL);
+  ASSERT_TRUE(profile.GetCounter("LLCMissesPerRow") != NULL);
+  // The derived counters are 0 before anything was measured.
+  EXPECT_EQ(0, profile.GetCounter("HWInstructionsPerCycle")->double_value());
+  EXPECT_EQ(0, profile.GetCounter("BranchMissesPerRow")->double_value());
+
+  // Measure in another thread, which opens its own events.
+  Thread thread("perf-event-counters-test", "worker", [&counters]() {
+    SCOPED_PERF_EVENT_MEASUREMENT(&counters);
+    Work(1000000);
+  });
+  thread.Join();
+  rows_counter->Set(10L);
+  RuntimeProfile::Counter* instructions = profile.GetCounter("HWInstructions");
+  RuntimeProfile::Counter* cycles = profile.GetCounter("HWCycles");
+  if (instructions->value() == 0 || cycles->value() == 0) {
+    LOG(WARNING) << "Hardware counters are not available";
+    return;
+  }
+  EXPECT_DOUBLE_EQ(static_cast<double>(instructions->value()) / cycles->value(),
+      profile.GetCounter("HWInstructionsPerCycle")->double_value());
+  EXPECT_DOUBLE_EQ(profile.GetCounter("BranchMisses")->value() / 10.0,
+      profile.GetCounter("BranchMissesPerRow")->double_value());
+}
+
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  impala::InitThreading();
+  return RUN_ALL_TESTS();
+}
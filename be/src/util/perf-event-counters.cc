@@ -0,0 +1,163 @@
+// Copyright 2016 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "util/perf-event-counters.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <boost/bind.hpp>
+#include <boost/thread/tss.hpp>
+
+#include "common/logging.h"
+
+#include "common/names.h"
+
+namespace impala {
+
+namespace {
+
+// The perf events of one thread. The first event that could be opened leads the group,
+// so that all events are read with a single read() and are counted over the same time.
+class ThreadPerfEvents {
+ public:
+  ThreadPerfEvents() : group_fd_(-1), num_open_events_(0) {
+    for (int i = 0; i < PerfEventCounters::NUM_EVENTS; ++i) {
+      perf_event_attr attr;
+      memset(&attr, 0, sizeof(attr));
+      attr.size = sizeof(attr);
+      InitEventAttr(static_cast<PerfEventCounters::Event>(i), &attr);
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      attr.read_format = PERF_FORMAT_GROUP;
+      // Count the calling thread on any CPU.
+      int fd = syscall(__NR_perf_event_open, &attr, 0, -1, group_fd_, 0);
+      if (fd < 0) {
+        event_idx_[i] = -1;
+        continue;
+      }
+      if (group_fd_ == -1) group_fd_ = fd;
+      fds_[num_open_events_] = fd;
+      event_idx_[i] = num_open_events_++;
+    }
+    if (group_fd_ == -1) {
+      VLOG_FILE << "Could not open perf events of thread: " << strerror(errno);
+    }
+  }
+
+  ~ThreadPerfEvents() {
+    // Close the group leader last.
+    for (int i = num_open_events_ - 1; i >= 0; --i) close(fds_[i]);
+  }
+
+  bool Read(int64_t* values) {
+    if (group_fd_ == -1) return false;
+    // Layout with PERF_FORMAT_GROUP: the number of events, then their values.
+    uint64_t buffer[PerfEventCounters::NUM_EVENTS + 1];
+    ssize_t bytes_read = read(group_fd_, buffer, sizeof(buffer));
+    ssize_t expected_bytes = sizeof(uint64_t) * (num_open_events_ + 1);
+    if (bytes_read != expected_bytes) return false;
+    for (int i = 0; i < PerfEventCounters::NUM_EVENTS; ++i) {
+      values[i] = event_idx_[i] == -1 ? 0 : buffer[event_idx_[i] + 1];
+    }
+    return true;
+  }
+
+ private:
+  int group_fd_;
+  int num_open_events_;
+  int fds_[PerfEventCounters::NUM_EVENTS];
+
+  /// Index of each event in the values of the group, or -1 if it is not counted.
+  int event_idx_[PerfEventCounters::NUM_EVENTS];
+
+  static void InitEventAttr(PerfEventCounters::Event event, perf_event_attr* attr) {
+    switch (event) {
+      case PerfEventCounters::CYCLES:
+        attr->type = PERF_TYPE_HARDWARE;
+        attr->config = PERF_COUNT_HW_CPU_CYCLES;
+        break;
+      case PerfEventCounters::INSTRUCTIONS:
+        attr->type = PERF_TYPE_HARDWARE;
+        attr->config = PERF_COUNT_HW_INSTRUCTIONS;
+        break;
+      case PerfEventCounters::LLC_MISSES:
+        attr->type = PERF_TYPE_HARDWARE;
+        attr->config = PERF_COUNT_HW_CACHE_MISSES;
+        break;
+      case PerfEventCounters::BRANCH_MISSES:
+        attr->type = PERF_TYPE_HARDWARE;
+        attr->config = PERF_COUNT_HW_BRANCH_MISSES;
+        break;
+      case PerfEventCounters::DTLB_MISSES:
+        attr->type = PERF_TYPE_HW_CACHE;
+        attr->config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+            (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        break;
+      default:
+        DCHECK(false);
+    }
+  }
+};
+
+// Deletes the events of a thread, which closes them, when the thread exits.
+boost::thread_specific_ptr<ThreadPerfEvents> thread_perf_events;
+
+const char* EVENT_NAMES[] = {
+    "HWCycles", "HWInstructions", "LLCMisses", "BranchMisses", "DTLBMisses"
+};
+
+}
+
+PerfEventCounters::PerfEventCounters(RuntimeProfile* profile,
+    RuntimeProfile::Counter* rows_counter)
+  : rows_counter_(rows_counter) {
+  for (int i = 0; i < NUM_EVENTS; ++i) {
+    event_counters_[i] = ADD_COUNTER(profile, EVENT_NAMES[i], TUnit::UNIT);
+  }
+  profile->AddDerivedCounter("HWInstructionsPerCycle", TUnit::DOUBLE_VALUE,
+      bind<int64_t>(&PerfEventCounters::InstructionsPerCycle, this));
+  for (Event event: {LLC_MISSES, BRANCH_MISSES, DTLB_MISSES}) {
+    profile->AddDerivedCounter(string(EVENT_NAMES[event]) + "PerRow",
+        TUnit::DOUBLE_VALUE, bind<int64_t>(&PerfEventCounters::EventsPerRow, this,
+        event));
+  }
+}
+
+bool PerfEventCounters::ReadThreadEvents(int64_t* values) {
+  ThreadPerfEvents* events = thread_perf_events.get();
+  if (UNLIKELY(events == NULL)) {
+    events = new ThreadPerfEvents();
+    thread_perf_events.reset(events);
+  }
+  return events->Read(values);
+}
+
+int64_t PerfEventCounters::InstructionsPerCycle() const {
+  int64_t cycles = event_counters_[CYCLES]->value();
+  double ipc = cycles == 0 ? 0 :
+      static_cast<double>(event_counters_[INSTRUCTIONS]->value()) / cycles;
+  return *reinterpret_cast<int64_t*>(&ipc);
+}
+
+int64_t PerfEventCounters::EventsPerRow(Event event) const {
+  int64_t rows = rows_counter_->value();
+  double events_per_row = rows == 0 ? 0 :
+      static_cast<double>(event_counters_[event]->value()) / rows;
+  return *reinterpret_cast<int64_t*>(&events_per_row);
+}
+
+}
@@ -0,0 +1,101 @@
+// Copyright 2016 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef IMPALA_UTIL_PERF_EVENT_COUNTERS_H
+#define IMPALA_UTIL_PERF_EVENT_COUNTERS_H
+
+#include "util/runtime-profile-counters.h"
+
+namespace impala {
+
+/// Hardware performance counters of the threads that run an operator, e.g. an exec
+/// node. Unlike PerfCounters, which reads the counters of the whole process, every
+/// thread reads its own counters from a group of perf events. The group is opened
+/// the first time the thread takes a measurement and stays open until it exits.
+///
+/// Measurements are taken with ScopedPerfEventMeasurement around the work of the
+/// operator and are added to counters in the operator's profile. The profile also
+/// gets the instructions per cycle and the misses per row that the operator returned.
+/// Like TotalTime, the counts of an operator include those of its children that
+/// run in the same thread. Only user-space events are counted.
+///
+/// Threads whose counters cannot be opened, e.g. because of the
+/// kernel.perf_event_paranoid setting or in virtual machines without a PMU, do not
+/// add to the counters.
+class PerfEventCounters {
+ public:
+  enum Event {
+    CYCLES,
+    INSTRUCTIONS,
+    LLC_MISSES,
+    BRANCH_MISSES,
+    DTLB_MISSES,
+    NUM_EVENTS,
+  };
+
+  /// Adds the counters to 'profile'. 'rows_counter' is the number of rows that the
+  /// operator returned.
+  PerfEventCounters(RuntimeProfile* profile, RuntimeProfile::Counter* rows_counter);
+
+  /// Sets 'values' to the current counts of the calling thread, indexed by Event.
+  /// Events that the CPU does not support are always 0. Returns false if none of the
+  /// events of the thread can be read.
+  static bool ReadThreadEvents(int64_t* values);
+
+ private:
+  friend class ScopedPerfEventMeasurement;
+
+  RuntimeProfile::Counter* rows_counter_;
+  RuntimeProfile::Counter* event_counters_[NUM_EVENTS];
+
+  /// Functions for the derived counters. Return the bits of a double.
+  int64_t InstructionsPerCycle() const;
+  int64_t EventsPerRow(Event event) const;
+};
+
+#define SCOPED_PERF_EVENT_MEASUREMENT(c) \
+    ScopedPerfEventMeasurement MACRO_CONCAT(SCOPED_PERF_EVENT_MEASUREMENT, __COUNTER__)(c)
+
+/// Adds the events of the calling thread between construction and destruction to
+/// 'counters'. Does nothing if 'counters' is NULL, so that measurements are cheap
+/// when the counters are disabled.
+class ScopedPerfEventMeasurement {
+ public:
+  ScopedPerfEventMeasurement(PerfEventCounters* counters) : counters_(counters) {
+    if (counters_ != NULL && !PerfEventCounters::ReadThreadEvents(start_values_)) {
+      counters_ = NULL;
+    }
+  }
+
+  ~ScopedPerfEventMeasurement() {
+    if (counters_ == NULL) return;
+    int64_t values[PerfEventCounters::NUM_EVENTS];
+    if (!PerfEventCounters::ReadThreadEvents(values)) return;
+    for (int i = 0; i < PerfEventCounters::NUM_EVENTS; ++i) {
+      counters_->event_counters_[i]->Add(values[i] - start_values_[i]);
+    }
+  }
+
+ private:
+  /// Disable copy constructor and assignment
+  ScopedPerfEventMeasurement(const ScopedPerfEventMeasurement&);
+  ScopedPerfEventMeasurement& operator=(const ScopedPerfEventMeasurement&);
+
+  PerfEventCounters* counters_;
+  int64_t start_values_[PerfEventCounters::NUM_EVENTS];
+};
+
+}
+
+#endif
@@ -0,0 +1,66 @@
+// Copyright 2016 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdlib.h>
+#include <string.h>
+#include <gtest/gtest.h>
+
+#include "util/cpu-info.h"
+#include "util/radix-sort.h"
+
+#include "common/names.h"
+
+namespace impala {
+
+// Sorts 'num_keys' random keys and checks that the order is sorted and stable.
+// Only the last 'num_random_bytes' bytes of each key are random, the others are zero.
+void TestSortKeys(int key_len, int num_random_bytes, uint32_t num_keys) {
+  vector<uint8_t> keys(key_len * num_keys, 0);
+  for (uint32_t i = 0; i < num_keys; ++i) {
+    for (int b = key_len - num_random_bytes; b < key_len; ++b) {
+      keys[i * key_len + b] = rand() % 256;
+    }
+  }
+  vector<uint32_t> order(num_keys);
+  vector<uint32_t> tmp(num_keys);
+  RadixSort::SortKeys(&keys[0], key_len, num_keys, &order[0], &tmp[0]);
+  vector<bool> seen(num_keys, false);
+  for (uint32_t i = 0; i < num_keys; ++i) {
+    ASSERT_LT(order[i], num_keys);
+    EXPECT_FALSE(seen[order[i]]);
+    seen[order[i]] = true;
+    if (i == 0) continue;
+    int cmp = memcmp(&keys[order[i - 1] * key_len], &keys[order[i] * key_len], key_len);
+    EXPECT_LE(cmp, 0);
+    if (cmp == 0) EXPECT_LT(order[i - 1], order[i]);
+  }
+}
+
+TEST(RadixSortTest, SortKeys) {
+  TestSortKeys(1, 1, 0);
+  TestSortKeys(1, 1, 1);
+  TestSortKeys(4, 4, 1000);
+  TestSortKeys(9, 2, 10000);
+  TestSortKeys(16, 16, 10000);
+  // All bytes are equal, so every pass is skipped.
+  TestSortKeys(8, 0, 100);
+}
+
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  impala::CpuInfo::Init();
+  return RUN_ALL_TESTS();
+}
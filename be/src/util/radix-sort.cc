@@ -0,0 +1,59 @@
+// Copyright 2016 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "util/radix-sort.h"
+
+#include <string.h>
+
+#include "common/logging.h"
+
+#include "common/names.h"
+
+using namespace impala;
+
+static const int NUM_BUCKETS = 256;
+
+void RadixSort::SortKeys(const uint8_t* keys, int key_len, uint32_t num_keys,
+    uint32_t* order, uint32_t* tmp) {
+  DCHECK_GT(key_len, 0);
+  for (uint32_t i = 0; i < num_keys; ++i) order[i] = i;
+  if (num_keys <= 1) return;
+
+  // Build the histograms of all byte positions in a single pass over the keys.
+  vector<uint32_t> counts(key_len * NUM_BUCKETS, 0);
+  for (uint32_t i = 0; i < num_keys; ++i) {
+    const uint8_t* key = keys + static_cast<int64_t>(i) * key_len;
+    for (int b = 0; b < key_len; ++b) ++counts[b * NUM_BUCKETS + key[b]];
+  }
+
+  uint32_t* src = order;
+  uint32_t* dst = tmp;
+  for (int b = key_len - 1; b >= 0; --b) {
+    uint32_t* offsets = &counts[b * NUM_BUCKETS];
+    // Skip the byte if all keys have the same value, i.e. it does not change the order.
+    if (offsets[keys[b]] == num_keys) continue;
+    uint32_t offset = 0;
+    for (int i = 0; i < NUM_BUCKETS; ++i) {
+      uint32_t count = offsets[i];
+      offsets[i] = offset;
+      offset += count;
+    }
+    for (uint32_t i = 0; i < num_keys; ++i) {
+      uint32_t idx = src[i];
+      dst[offsets[keys[static_cast<int64_t>(idx) * key_len + b]]++] = idx;
+    }
+    std::swap(src, dst);
+  }
+  if (src != order) memcpy(order, src, num_keys * sizeof(uint32_t));
+}
@@ -0,0 +1,37 @@
+// Copyright 2016 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef IMPALA_UTIL_RADIX_SORT_H
+#define IMPALA_UTIL_RADIX_SORT_H
+
+#include <stdint.h>
+
+namespace impala {
+
+/// Least significant digit radix sort of fixed-width, memcmp-comparable keys, e.g.
+/// the keys produced by KeyNormalizer.
+class RadixSort {
+ public:
+  /// Sorts the 'num_keys' keys of 'key_len' bytes each that are stored contiguously in
+  /// 'keys' in memcmp order. The keys are not moved, instead 'order' is set to the
+  /// sorted permutation: order[i] is the index of the key that belongs at position i.
+  /// 'tmp' must have space for 'num_keys' entries. The sort is stable. Byte positions
+  /// at which all keys are equal, e.g. the high bytes of small integers, are skipped.
+  static void SortKeys(const uint8_t* keys, int key_len, uint32_t num_keys,
+      uint32_t* order, uint32_t* tmp);
+};
+
+}
+
+#endif
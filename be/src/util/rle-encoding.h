@@ -16,6 +16,7 @@
 #define IMPALA_RLE_ENCODING_H
 
 #include <math.h>
+#include <algorithm>
 
 #include "common/compiler-util.h"
 #include "util/bit-stream-utils.inline.h"
@@ -104,6 +105,13 @@ class RleDecoder {
   template<typename T>
   bool Get(T* val);
 
+  /// Gets up to 'num_values' values into 'values'. Returns the number of values read,
+  /// which is less than 'num_values' only if there are no more values or the data is
+  /// invalid. Repeated runs are filled in directly and literal runs are unpacked with
+  /// BitReader::GetValues(), so this is much faster than calling Get() for each value.
+  template<typename T>
+  int GetValues(T* values, int num_values);
+
  protected:
   /// Fills literal_count_ and repeat_count_ with next values. Returns false if there
   /// are no more.
@@ -266,6 +274,33 @@ inline bool RleDecoder::Get(T* val) {
   return true;
 }
 
+template<typename T>
+inline int RleDecoder::GetValues(T* values, int num_values) {
+  DCHECK_GE(bit_width_, 0);
+  int num_read = 0;
+  while (num_read < num_values) {
+    if (repeat_count_ == 0 && literal_count_ == 0) {
+      if (!NextCounts<T>()) break;
+    }
+    if (repeat_count_ > 0) {
+      int num_repeats = std::min<int>(repeat_count_, num_values - num_read);
+      std::fill(values + num_read, values + num_read + num_repeats,
+          static_cast<T>(current_value_));
+      num_read += num_repeats;
+      repeat_count_ -= num_repeats;
+    } else {
+      DCHECK_GT(literal_count_, 0);
+      int num_literals = std::min<int>(literal_count_, num_values - num_read);
+      int num_unpacked =
+          bit_reader_.GetValues(bit_width_, values + num_read, num_literals);
+      num_read += num_unpacked;
+      literal_count_ -= num_unpacked;
+      if (UNLIKELY(num_unpacked < num_literals)) break;
+    }
+  }
+  return num_read;
+}
+
 template<typename T>
 bool RleDecoder::NextCounts() {
   // Read the next run's indicator int, it could be a literal or repeated run.
@@ -123,6 +123,26 @@ void TestBitArrayValues(int bit_width, int num_vals) {
     EXPECT_EQ(reader.bytes_left(), 0);
     reader.Reset(buffer, len);
   }
+
+  // Read the values back in batches of different sizes, starting both on and off a byte
+  // boundary.
+  vector<int64_t> vals(num_vals);
+  for (int batch_size = 1; batch_size <= 128; batch_size *= 2) {
+    for (int skip = 0; skip < 2; ++skip) {
+      reader.Reset(buffer, len);
+      int i = 0;
+      for (; i < skip && i < num_vals; ++i) {
+        EXPECT_TRUE(reader.GetValue(bit_width, &vals[i]));
+      }
+      while (i < num_vals) {
+        int num_to_read = min(batch_size, num_vals - i);
+        EXPECT_EQ(reader.GetValues(bit_width, &vals[i], num_to_read), num_to_read);
+        i += num_to_read;
+      }
+      for (int j = 0; j < num_vals; ++j) EXPECT_EQ(vals[j], j % mod);
+      EXPECT_EQ(reader.bytes_left(), 0);
+    }
+  }
 }
 
 TEST(BitArray, TestValues) {
@@ -212,6 +232,14 @@ void ValidateRle(const vector<int>& values, int bit_width,
     }
     decoder.Reset(buffer, len, bit_width);
   }
+
+  // Verify batched read
+  int num_values = values.size();
+  vector<uint64_t> vals(num_values);
+  EXPECT_EQ(decoder.GetValues(vals.data(), num_values), num_values);
+  for (int i = 0; i < num_values; ++i) {
+    EXPECT_EQ(values[i], vals[i]);
+  }
 }
 
 TEST(Rle, SpecificSequences) {
@@ -23,6 +23,7 @@
 
 #include "common/atomic.h"
 #include "common/logging.h"
+#include "gutil/port.h"
 #include "util/runtime-profile.h"
 #include "util/stopwatch.h"
 #include "util/streaming-sampler.h"
@@ -45,10 +46,16 @@ namespace impala {
   #define ADD_TIMER(profile, name) (profile)->AddCounter(name, TUnit::TIME_NS)
   #define ADD_CHILD_TIMER(profile, name, parent) \
       (profile)->AddCounter(name, TUnit::TIME_NS, parent)
+  #define ADD_SHARDED_COUNTER(profile, name, unit) \
+      (profile)->AddShardedCounter(name, unit)
+  #define ADD_SHARDED_TIMER(profile, name) \
+      (profile)->AddShardedCounter(name, TUnit::TIME_NS)
+  #define ADD_SHARDED_CHILD_TIMER(profile, name, parent) \
+      (profile)->AddShardedCounter(name, TUnit::TIME_NS, parent)
   #define SCOPED_TIMER(c) \
-      ScopedTimer<MonotonicStopWatch> MACRO_CONCAT(SCOPED_TIMER, __COUNTER__)(c)
+      ScopedTimer<TscStopWatch> MACRO_CONCAT(SCOPED_TIMER, __COUNTER__)(c)
   #define CANCEL_SAFE_SCOPED_TIMER(c, is_cancelled) \
-      ScopedTimer<MonotonicStopWatch> MACRO_CONCAT(SCOPED_TIMER, __COUNTER__)(c, is_cancelled)
+      ScopedTimer<TscStopWatch> MACRO_CONCAT(SCOPED_TIMER, __COUNTER__)(c, is_cancelled)
   #define COUNTER_ADD(c, v) (c)->Add(v)
   #define COUNTER_SET(c, v) (c)->Set(v)
   #define ADD_THREAD_COUNTERS(profile, prefix) (profile)->AddThreadCounters(prefix)
@@ -63,6 +70,9 @@ namespace impala {
   #define ADD_TIME_SERIES_COUNTER(profile, name, src_counter) NULL
   #define ADD_TIMER(profile, name) NULL
   #define ADD_CHILD_TIMER(profile, name, parent) NULL
+  #define ADD_SHARDED_COUNTER(profile, name, unit) NULL
+  #define ADD_SHARDED_TIMER(profile, name) NULL
+  #define ADD_SHARDED_CHILD_TIMER(profile, name, parent) NULL
   #define SCOPED_TIMER(c)
   #define CANCEL_SAFE_SCOPED_TIMER(c)
   #define COUNTER_ADD(c, v)
@@ -72,6 +82,61 @@ namespace impala {
   #define SCOPED_CONCURRENT_COUNTER(c)
 #endif
 
+/// A counter for values that many threads update concurrently, e.g. the bytes read by
+/// the scanner threads of a node. Each thread adds to one of several shards, which are
+/// on separate cache lines, so that the updates of different threads do not contend
+/// for a cache line. The shards are summed when the counter is read, which is much
+/// rarer than updates.
+class RuntimeProfile::ShardedCounter : public RuntimeProfile::Counter {
+ public:
+  ShardedCounter(TUnit::type unit) : Counter(unit) { }
+
+  virtual void Add(int64_t delta) { shards_[CurrentShard()].value.Add(delta); }
+
+  virtual void Set(int64_t value) {
+    for (int i = 1; i < NUM_SHARDS; ++i) shards_[i].value.Store(0);
+    shards_[0].value.Store(value);
+  }
+
+  virtual void Set(int value) { Set(static_cast<int64_t>(value)); }
+
+  virtual void Set(double value) {
+    DCHECK_EQ(sizeof(value), sizeof(int64_t));
+    Set(*reinterpret_cast<int64_t*>(&value));
+  }
+
+  virtual int64_t value() const {
+    int64_t sum = 0;
+    for (int i = 0; i < NUM_SHARDS; ++i) sum += shards_[i].value.Load();
+    return sum;
+  }
+
+  virtual double double_value() const {
+    int64_t v = value();
+    return *reinterpret_cast<const double*>(&v);
+  }
+
+ private:
+  static const int NUM_SHARDS = 16;
+
+  /// Padded to a cache line, so that no two shards share one.
+  struct Shard {
+    AtomicInt64 value;
+    uint8_t padding[CACHELINE_SIZE - sizeof(AtomicInt64)];
+  };
+  Shard shards_[NUM_SHARDS];
+
+  /// Returns the shard of the calling thread. Threads are assigned to the shards in
+  /// round-robin order when they first update any sharded counter.
+  static int CurrentShard() {
+    static __thread int shard = -1;
+    if (UNLIKELY(shard == -1)) shard = NextShard();
+    return shard;
+  }
+
+  static int NextShard();
+};
+
 /// A counter that keeps track of the highest value seen (reporting that
 /// as value()) and the current value.
 class RuntimeProfile::HighWaterMarkCounter : public RuntimeProfile::Counter {
@@ -133,6 +198,11 @@ class RuntimeProfile::DerivedCounter : public RuntimeProfile::Counter {
     return counter_fn_();
   }
 
+  virtual double double_value() const {
+    int64_t v = counter_fn_();
+    return *reinterpret_cast<const double*>(&v);
+  }
+
  private:
   DerivedCounterFunction counter_fn_;
 };
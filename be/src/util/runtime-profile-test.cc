@@ -255,6 +255,59 @@ TEST(CountersTest, HighWaterMarkCounters) {
   EXPECT_EQ(bytes_counter->value(), 28);
 }
 
+TEST(CountersTest, ShardedCounters) {
+  ObjectPool pool;
+  RuntimeProfile profile(&pool, "Profile");
+  RuntimeProfile::ShardedCounter* counter =
+      profile.AddShardedCounter("rows", TUnit::UNIT);
+  EXPECT_EQ(counter, profile.GetCounter("rows"));
+  EXPECT_EQ(counter->value(), 0);
+
+  // Updates of many threads, which use different shards, are all counted.
+  const int NUM_THREADS = 20;
+  const int NUM_ADDS = 10000;
+  vector<thread*> threads;
+  for (int i = 0; i < NUM_THREADS; ++i) {
+    threads.push_back(new thread([counter, NUM_ADDS]() {
+      for (int j = 0; j < NUM_ADDS; ++j) counter->Add(2);
+    }));
+  }
+  for (thread* t: threads) {
+    t->join();
+    delete t;
+  }
+  EXPECT_EQ(counter->value(), 2 * NUM_THREADS * NUM_ADDS);
+
+  counter->Set(10L);
+  EXPECT_EQ(counter->value(), 10);
+  counter->Add(5);
+  EXPECT_EQ(counter->value(), 15);
+
+  TRuntimeProfileTree tprofile;
+  profile.ToThrift(&tprofile);
+  RuntimeProfile* from_thrift = RuntimeProfile::CreateFromThrift(&pool, tprofile);
+  EXPECT_EQ(from_thrift->GetCounter("rows")->value(), 15);
+}
+
+TEST(CountersTest, TscStopWatch) {
+  TscStopWatch tsc_sw;
+  MonotonicStopWatch monotonic_sw;
+  tsc_sw.Start();
+  monotonic_sw.Start();
+  SleepForMs(100);
+  tsc_sw.Stop();
+  monotonic_sw.Stop();
+  // Both clocks measure the same time, whether or not the time stamp counter is used.
+  int64_t tsc_time = tsc_sw.ElapsedTime();
+  int64_t monotonic_time = monotonic_sw.ElapsedTime();
+  EXPECT_GE(tsc_time, monotonic_time * 0.95) << CpuInfo::ns_per_tsc_tick();
+  EXPECT_LE(tsc_time, monotonic_time * 1.05) << CpuInfo::ns_per_tsc_tick();
+
+  // The watch does not advance while stopped.
+  SleepForMs(10);
+  EXPECT_EQ(tsc_time, tsc_sw.ElapsedTime());
+}
+
 TEST(CountersTest, DerivedCounters) {
   ObjectPool pool;
   RuntimeProfile profile(&pool, "Profile");
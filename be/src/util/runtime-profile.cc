@@ -143,6 +143,11 @@ RuntimeProfile* RuntimeProfile::CreateFromThrift(ObjectPool* pool,
 }
 
 void RuntimeProfile::UpdateAverage(RuntimeProfile* other) {
+  UpdateAveragedCounters(other);
+  ComputeTimeInProfile();
+}
+
+void RuntimeProfile::UpdateAveragedCounters(RuntimeProfile* other) {
   DCHECK(other != NULL);
   DCHECK(is_averaged_profile_);
 
@@ -202,11 +207,9 @@ void RuntimeProfile::UpdateAverage(RuntimeProfile* other) {
         child_map_[child->name_] = child;
         children_.push_back(make_pair(child, indent_other_child));
       }
-      child->UpdateAverage(other_child);
+      child->UpdateAveragedCounters(other_child);
     }
   }
-
-  ComputeTimeInProfile();
 }
 
 void RuntimeProfile::Update(const TRuntimeProfileTree& thrift_profile) {
@@ -447,6 +450,12 @@ const string* RuntimeProfile::GetInfoString(const string& key) const {
 ADD_COUNTER_IMPL(AddCounter, Counter);
 ADD_COUNTER_IMPL(AddHighWaterMarkCounter, HighWaterMarkCounter);
 ADD_COUNTER_IMPL(AddConcurrentTimerCounter, ConcurrentTimerCounter);
+ADD_COUNTER_IMPL(AddShardedCounter, ShardedCounter);
+
+int RuntimeProfile::ShardedCounter::NextShard() {
+  static AtomicInt32 next_shard;
+  return (next_shard.Add(1) - 1) % NUM_SHARDS;
+}
 
 RuntimeProfile::DerivedCounter* RuntimeProfile::AddDerivedCounter(
     const string& name, TUnit::type unit,
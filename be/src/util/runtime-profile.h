@@ -90,6 +90,7 @@ class RuntimeProfile {
   class DerivedCounter;
   class EventSequence;
   class HighWaterMarkCounter;
+  class ShardedCounter;
   class ThreadCounters;
   class TimeSeriesCounter;
 
@@ -159,6 +160,11 @@ class RuntimeProfile {
   ConcurrentTimerCounter* AddConcurrentTimerCounter(const std::string& name,
       TUnit::type unit, const std::string& parent_counter_name = "");
 
+  /// Adds a sharded counter, for counters that many threads update concurrently.
+  /// Otherwise, same behavior as AddCounter().
+  ShardedCounter* AddShardedCounter(const std::string& name, TUnit::type unit,
+      const std::string& parent_counter_name = "");
+
   /// Add a derived counter with 'name'/'unit'. The counter is owned by the
   /// RuntimeProfile object.
   /// If parent_counter_name is a non-empty string, the counter is added as a child of
@@ -379,6 +385,10 @@ class RuntimeProfile {
   /// ComputeTimeInProfile()
   int64_t local_time_ns_;
 
+  /// Implements UpdateAverage() for the subtree rooted at this profile, except for
+  /// recomputing the time in the profiles, which is done once for the whole tree.
+  void UpdateAveragedCounters(RuntimeProfile* src);
+
   /// Update a subtree of profiles from nodes, rooted at *idx.
   /// On return, *idx points to the node immediately following this subtree.
   void Update(const std::vector<TRuntimeProfileNode>& nodes, int* idx);
@@ -22,6 +22,7 @@
 
 #include "common/names.h"
 #include "util/logging-support.h"
+#include "util/thread.h"
 
 using boost::filesystem::create_directory;
 using boost::filesystem::exists;
@@ -67,7 +68,9 @@ SimpleLogger::SimpleLogger(const string& log_dir, const string& log_file_name_pr
       log_file_name_prefix_(log_file_name_prefix),
       num_log_file_entries_(0),
       max_entries_per_file_(max_entries_per_file),
-      max_log_files_(max_log_files) {
+      max_log_files_(max_log_files),
+      max_queued_entries_(0),
+      block_when_full_(true) {
 }
 
 Status SimpleLogger::Init() {
@@ -81,8 +84,63 @@ Status SimpleLogger::Init() {
   return Status::OK();
 }
 
+Status SimpleLogger::StartAsyncWriter(int max_queued_entries, bool block_when_full) {
+  DCHECK(async_writer_thread_.get() == NULL);
+  DCHECK_GT(max_queued_entries, 0);
+  max_queued_entries_ = max_queued_entries;
+  block_when_full_ = block_when_full;
+  async_writer_thread_.reset(new Thread("simple-logger",
+      "async-writer-" + log_file_name_prefix_, &SimpleLogger::AsyncWriterThread, this));
+  return Status::OK();
+}
+
 Status SimpleLogger::AppendEntry(const std::string& entry) {
+  if (async_writer_thread_.get() != NULL) {
+    {
+      unique_lock<mutex> l(queue_lock_);
+      while (queued_entries_.size() >= max_queued_entries_) {
+        if (!block_when_full_) {
+          return Status("Log queue is full, dropped entry for: " + log_file_name_);
+        }
+        queue_space_cv_.wait(l);
+      }
+      queued_entries_.push_back(entry);
+    }
+    entries_queued_cv_.notify_one();
+    return Status::OK();
+  }
   lock_guard<mutex> l(log_file_lock_);
+  return AppendEntryInternal(entry);
+}
+
+void SimpleLogger::AsyncWriterThread() {
+  vector<string> entries;
+  while (true) {
+    {
+      unique_lock<mutex> l(queue_lock_);
+      while (queued_entries_.empty()) entries_queued_cv_.wait(l);
+      entries.swap(queued_entries_);
+    }
+    queue_space_cv_.notify_all();
+
+    Status status;
+    {
+      lock_guard<mutex> l(log_file_lock_);
+      for (const string& entry: entries) {
+        status = AppendEntryInternal(entry);
+        if (!status.ok()) break;
+      }
+    }
+    entries.clear();
+    if (!status.ok()) {
+      LOG(ERROR) << "Could not write to log file: " << status.GetDetail();
+      lock_guard<mutex> l(queue_lock_);
+      if (async_write_status_.ok()) async_write_status_ = status;
+    }
+  }
+}
+
+Status SimpleLogger::AppendEntryInternal(const std::string& entry) {
   if (num_log_file_entries_ > max_entries_per_file_) {
     num_log_file_entries_ = 0;
     GenerateLogFileName();
@@ -97,6 +155,10 @@ Status SimpleLogger::AppendEntry(const std::string& entry) {
 }
 
 Status SimpleLogger::Flush() {
+  {
+    lock_guard<mutex> l(queue_lock_);
+    RETURN_IF_ERROR(async_write_status_);
+  }
   lock_guard<mutex> l(log_file_lock_);
   return FlushInternal();
 }
@@ -16,16 +16,24 @@
 #define IMPALA_SERVICE_SIMPLE_LOGGER_H
 
 #include <fstream>
+#include <vector>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
 #include <boost/thread/mutex.hpp>
 
 #include "common/status.h"
 
 namespace impala {
 
+class Thread;
+
 /// A class that provides basic thread-safe support for logging to a file. Supports
 /// creation of the log file and log directories, rolling the log file when it
 /// has reached a specified number of entries, and deletion of old files when a
 /// threshold number of files is exceeded.
+/// After StartAsyncWriter(), AppendEntry() only queues the entries, and a background
+/// thread writes them to the file in batches, so that the callers don't wait for file
+/// I/O or for each other.
 class SimpleLogger {
  public:
   SimpleLogger(const std::string& log_dir_, const std::string& log_file_name_prefix_,
@@ -36,13 +44,22 @@ class SimpleLogger {
   /// should only be called once.
   Status Init();
 
+  /// Starts the thread that writes the entries of AppendEntry() in the background. At
+  /// most 'max_queued_entries' entries are queued. If the queue is full, AppendEntry()
+  /// waits for the writer if 'block_when_full' is true, and drops the entry otherwise.
+  /// Must be called once, after Init().
+  Status StartAsyncWriter(int max_queued_entries, bool block_when_full);
+
   /// Appends the given string to the log file, including a newline. If the log
   /// file already contains the specified entry limit, a new log file will be created.
-  /// This function is thread safe and blocks while a Flush() is in progress
+  /// This function is thread safe and blocks while a Flush() is in progress.
+  /// With an async writer, the entry is queued instead, and an error is returned if it
+  /// was dropped because the queue is full.
   Status AppendEntry(const std::string& entry);
 
   /// Flushes the log file to disk by closing and re-opening the file. This function is
-  /// thread safe and blocks while a WriteEntry() is in progress
+  /// thread safe and blocks while a WriteEntry() is in progress. Also returns the first
+  /// error of the async writer, if there is one.
   Status Flush();
 
  private:
@@ -82,6 +99,34 @@ class SimpleLogger {
 
   /// Deletes all log files except the max_log_files_ newest.
   void RotateLogFiles();
+
+  /// Writes 'entry' to the log file, rolling it if needed. Must be called with the
+  /// log_file_lock_ held.
+  Status AppendEntryInternal(const std::string& entry);
+
+  /// Body of async_writer_thread_. Takes all queued entries at once and writes them
+  /// under a single acquisition of log_file_lock_.
+  void AsyncWriterThread();
+
+  /// Protects the members below, which are only used with an async writer.
+  boost::mutex queue_lock_;
+
+  /// Signalled when entries are queued, and when the writer took the queued entries.
+  boost::condition_variable entries_queued_cv_;
+  boost::condition_variable queue_space_cv_;
+
+  /// Entries that the writer did not take yet.
+  std::vector<std::string> queued_entries_;
+
+  /// Set by StartAsyncWriter().
+  int max_queued_entries_;
+  bool block_when_full_;
+
+  /// First error of the async writer, returned by Flush().
+  Status async_write_status_;
+
+  /// NULL if AppendEntry() writes to the file itself.
+  boost::scoped_ptr<Thread> async_writer_thread_;
 };
 }
 #endif
@@ -18,6 +18,7 @@
 
 #include <boost/cstdint.hpp>
 #include <boost/thread/lock_guard.hpp>
+#include <util/cpu-info.h>
 #include <util/os-info.h>
 #include <util/spinlock.h>
 #include <util/time.h>
@@ -179,6 +180,83 @@ class MonotonicStopWatch {
   }
 };
 
+/// Stop watch for reporting elapsed time in nanoseconds that reads the time stamp
+/// counter, which is several times cheaper than clock_gettime(), if CpuInfo found that
+/// the counter ticks at a constant rate on all cores and calibrated it. Otherwise it
+/// uses the same clock as MonotonicStopWatch. The clock is picked in Start(), so a
+/// watch that runs while CpuInfo is initialized stays consistent.
+/// Used by the SCOPED_TIMER counters, which are updated on many hot paths.
+class TscStopWatch {
+ public:
+  TscStopWatch() : start_(0), total_time_(0), ns_per_tick_(0), running_(false) { }
+
+  void Start() {
+    if (!running_) {
+      ns_per_tick_ = CpuInfo::ns_per_tsc_tick();
+      start_ = Now();
+      running_ = true;
+    }
+  }
+
+  void Stop() {
+    if (running_) {
+      total_time_ += RunningTime();
+      running_ = false;
+    }
+  }
+
+  /// Returns time in nanoseconds.
+  uint64_t ElapsedTime() const {
+    return running_ ? RunningTime() : total_time_;
+  }
+
+  /// Returns the total time accumulated
+  uint64_t TotalElapsedTime() const {
+    return total_time_ + (running_ ? RunningTime() : 0);
+  }
+
+  /// Reads the time stamp counter. Unlike StopWatch::Rdtsc(), this does not serialize
+  /// the instruction stream, which costs more than the read itself.
+  static uint64_t Rdtsc() {
+    uint32_t lo, hi;
+    __asm__ __volatile__ ("rdtsc" : "=a" (lo), "=d" (hi));
+    return (uint64_t)hi << 32 | lo;
+  }
+
+ private:
+  /// Start value of the clock, in ticks or in nanoseconds.
+  uint64_t start_;
+
+  /// Total elapsed time in nanoseconds.
+  uint64_t total_time_;
+
+  /// Nanoseconds per tick of the time stamp counter, or 0 if the watch uses the
+  /// monotonic clock. Set in Start().
+  double ns_per_tick_;
+
+  /// True if stopwatch is running.
+  bool running_;
+
+  uint64_t Now() const {
+    if (ns_per_tick_ > 0) return Rdtsc();
+#if defined(__APPLE__)
+    return MonotonicNanos();
+#else
+    timespec ts;
+    clock_gettime(OsInfo::fast_clock(), &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+#endif
+  }
+
+  uint64_t RunningTime() const {
+    uint64_t end = Now();
+    // The counters of different cores may be slightly apart if the thread moved.
+    if (end < start_) return 0;
+    if (ns_per_tick_ > 0) return (end - start_) * ns_per_tick_;
+    return end - start_;
+  }
+};
+
 /// Utility class to measure multiple threads concurrent wall time.
 /// If a thread is already running, the following thread won't reset the stop watch.
 /// The stop watch is stopped only when all threads finish their work.
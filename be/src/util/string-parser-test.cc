@@ -165,6 +165,27 @@ TEST(StringToInt, Basic) {
   TestIntValue<int64_t>("-0", 0, StringParser::PARSE_SUCCESS);
 }
 
+// Numbers with at least 8 digits are converted 8 digits at a time.
+TEST(StringToInt, EightDigitChunks) {
+  TestIntValue<int32_t>("87654321", 87654321, StringParser::PARSE_SUCCESS);
+  TestIntValue<int32_t>("-987654321", -987654321, StringParser::PARSE_SUCCESS);
+  TestIntValue<int64_t>("1234567890123456", 1234567890123456,
+      StringParser::PARSE_SUCCESS);
+  TestIntValue<int64_t>("00000000000000000", 0, StringParser::PARSE_SUCCESS);
+  TestIntValue<int64_t>("-123456789012345678", -123456789012345678,
+      StringParser::PARSE_SUCCESS);
+  TestIntValue<int64_t>("12345678  ", 12345678, StringParser::PARSE_SUCCESS);
+  TestIntValue<int64_t>("1234567890123456  ", 1234567890123456,
+      StringParser::PARSE_SUCCESS);
+
+  // A non-digit in any position of a chunk is rejected.
+  TestIntValue<int64_t>("1234567/", 0, StringParser::PARSE_FAILURE);
+  TestIntValue<int64_t>("1234567:", 0, StringParser::PARSE_FAILURE);
+  TestIntValue<int64_t>("1234 5678", 0, StringParser::PARSE_FAILURE);
+  TestIntValue<int64_t>("12345678x2345678", 0, StringParser::PARSE_FAILURE);
+  TestIntValue<int64_t>("123456781234567\x80", 0, StringParser::PARSE_FAILURE);
+}
+
 TEST(StringToInt, InvalidLeadingTrailing) {
   // Test that trailing garbage is not allowed.
   TestIntValue<int8_t>("123xyz   ", 0, StringParser::PARSE_FAILURE);
@@ -427,6 +448,34 @@ TEST(StringToFloat, Basic) {
   TestAllFloatVariants("ThisIsANaN", StringParser::PARSE_FAILURE);
 }
 
+// Values whose significand and power of ten are exact doubles, which are converted
+// without strtod(), must still be correctly rounded.
+TEST(StringToFloat, ExactFastPath) {
+  TestAllFloatVariants("0.1", StringParser::PARSE_SUCCESS);
+  TestAllFloatVariants("0.3", StringParser::PARSE_SUCCESS);
+  TestAllFloatVariants("123456.789", StringParser::PARSE_SUCCESS);
+  TestAllFloatVariants("3.141592653589793", StringParser::PARSE_SUCCESS);
+  TestAllFloatVariants("9007199254740992", StringParser::PARSE_SUCCESS);
+  TestAllFloatVariants("0.000000000000000000001", StringParser::PARSE_SUCCESS);
+  TestAllFloatVariants("1.5e3", StringParser::PARSE_SUCCESS);
+  TestAllFloatVariants("25E-5", StringParser::PARSE_SUCCESS);
+  TestAllFloatVariants("1e22", StringParser::PARSE_SUCCESS);
+  TestAllFloatVariants("1e-22", StringParser::PARSE_SUCCESS);
+  TestAllFloatVariants("0e400", StringParser::PARSE_SUCCESS);
+  TestAllFloatVariants("12.", StringParser::PARSE_SUCCESS);
+  TestAllFloatVariants(".5", StringParser::PARSE_SUCCESS);
+
+  // These are not exact doubles and take the slow path.
+  TestAllFloatVariants("9007199254740993", StringParser::PARSE_SUCCESS);
+  TestAllFloatVariants("1e23", StringParser::PARSE_SUCCESS);
+  TestAllFloatVariants("1e-23", StringParser::PARSE_SUCCESS);
+  TestAllFloatVariants("1.7976931348623157e308", StringParser::PARSE_SUCCESS);
+
+  TestFloatValue<double>("1e", StringParser::PARSE_FAILURE);
+  TestFloatValue<double>("1e+", StringParser::PARSE_FAILURE);
+  TestFloatValue<double>("1.5e3.5", StringParser::PARSE_FAILURE);
+}
+
 TEST(StringToFloat, InvalidLeadingTrailing) {
   // Test that trailing garbage is not allowed.
   TestFloatValue<double>("123xyz   ", StringParser::PARSE_FAILURE);
@@ -40,12 +40,16 @@ namespace impala {
 /// for that data type.  This is different from hive, which returns NULL for overflow
 /// slots for int types and inf/-inf for float types.
 //
+/// Integers are converted eight digits at a time with SWAR arithmetic on 64-bit words.
+/// Floats whose significand and power of ten are exact doubles are converted with a
+/// single, correctly rounded multiplication or division.
+//
 /// Things we tried that did not work:
 ///  - lookup table for converting character to digit
 /// Improvements (TODO):
 ///  - Validate input using _sidd_compare_ranges
-///  - Since we know the length, we can parallelize this: i.e. result = 100*s[0] +
-///    10*s[1] + s[2]
+///  - Exactly convert floats with longer significands or larger exponents, e.g. with
+///    the Eisel-Lemire algorithm, instead of falling back to strtod for them.
 class StringParser {
  public:
   enum ParseResult {
@@ -368,6 +372,11 @@ class StringParser {
 
     // Use double here to not lose precision while accumulating the result
     double val = 0;
+    if (LIKELY(StringToDoubleFastPath(s, len, &val))) {
+      *result = PARSE_SUCCESS;
+      return static_cast<T>(val);
+    }
+
     bool negative = false;
     int i = 0;
     double divide = 1;
@@ -469,6 +478,68 @@ class StringParser {
     return (T)(negative ? -val : val);
   }
 
+  /// Converts a string of the form [+-]digits[.digits][(e|E)[+-]digits] followed only by
+  /// whitespace into '*val' if its significand fits in 53 bits and its power of ten is
+  /// at most 22 in magnitude. Both are exact doubles then, so one multiplication or
+  /// division rounds the result correctly (Clinger's fast path). Returns false for all
+  /// other strings, including invalid ones, which are left to StringToFloatInternal().
+  static inline bool StringToDoubleFastPath(const char* s, int len, double* val) {
+    static const double POWERS_OF_TEN[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7,
+        1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20,
+        1e21, 1e22 };
+    static const int MAX_EXACT_POWER_OF_TEN = 22;
+    bool negative = false;
+    int i = 0;
+    switch (*s) {
+      case '-': negative = true;
+      case '+': i = 1;
+    }
+    // The digits of both the integer and the fractional part. Leading 0s are not
+    // significant. Once there are more than 19 significant digits 'significand' may
+    // have overflowed and the string is left to the slow path.
+    uint64_t significand = 0;
+    int num_sig_digits = 0;
+    int num_digits = 0;
+    int exponent = 0;
+    for (; i < len && IsDigit(s[i]); ++i, ++num_digits) {
+      significand = significand * 10 + s[i] - '0';
+      num_sig_digits += (significand != 0);
+    }
+    if (i < len && s[i] == '.') {
+      for (++i; i < len && IsDigit(s[i]); ++i, ++num_digits, --exponent) {
+        significand = significand * 10 + s[i] - '0';
+        num_sig_digits += (significand != 0);
+      }
+    }
+    if (UNLIKELY(num_digits == 0 || num_sig_digits > 19)) return false;
+    if (i < len && (s[i] == 'e' || s[i] == 'E')) {
+      ++i;
+      bool negative_exponent = false;
+      if (i < len && (s[i] == '-' || s[i] == '+')) negative_exponent = s[i++] == '-';
+      if (UNLIKELY(i == len || !IsDigit(s[i]))) return false;
+      int explicit_exponent = 0;
+      for (; i < len && IsDigit(s[i]); ++i) {
+        // Stop accumulating before overflowing, the string is out of range anyway.
+        if (explicit_exponent < 10000) {
+          explicit_exponent = explicit_exponent * 10 + s[i] - '0';
+        }
+      }
+      exponent += negative_exponent ? -explicit_exponent : explicit_exponent;
+    }
+    if (UNLIKELY(i < len && !IsAllWhitespace(s + i, len - i))) return false;
+    if (UNLIKELY(significand > (1ULL << 53))) return false;
+    if (UNLIKELY(exponent < -MAX_EXACT_POWER_OF_TEN ||
+        exponent > MAX_EXACT_POWER_OF_TEN)) {
+      // A zero significand is 0 at any scale.
+      if (significand != 0) return false;
+      exponent = 0;
+    }
+    *val = exponent < 0 ? significand / POWERS_OF_TEN[-exponent] :
+        significand * POWERS_OF_TEN[exponent];
+    if (negative) *val = -*val;
+    return true;
+  }
+
   /// Parses a string for 'true' or 'false', case insensitive.
   /// Return PARSE_FAILURE on leading whitespace. Trailing whitespace is allowed.
   static inline bool StringToBoolInternal(const char* s, int len, ParseResult* result) {
@@ -523,13 +594,19 @@ class StringParser {
       return val;
     }
     // Factor out the first char for error handling speeds up the loop.
-    if (LIKELY(s[0] >= '0' && s[0] <= '9')) {
-      val = s[0] - '0';
-    } else {
+    if (UNLIKELY(!IsDigit(s[0]))) {
       *result = PARSE_FAILURE;
       return 0;
     }
-    for (int i = 1; i < len; ++i) {
+    int i = 0;
+    // Only types with at least 8 digits take this loop, 'len' is shorter otherwise.
+    for (; len - i >= 8; i += 8) {
+      uint64_t chunk;
+      memcpy(&chunk, s + i, sizeof(chunk));
+      if (!IsEightDigits(chunk)) break;
+      val = val * 100000000 + ParseEightDigits(chunk);
+    }
+    for (; i < len; ++i) {
       if (LIKELY(s[i] >= '0' && s[i] <= '9')) {
         T digit = s[i] - '0';
         val = val * 10 + digit;
@@ -546,6 +623,28 @@ class StringParser {
     return val;
   }
 
+  /// Returns true if the 8 bytes in 'chunk' are all ascii digits, i.e. the high nibble of
+  /// each byte is 3 and adding 6 to its low nibble doesn't carry into the high nibble.
+  static inline bool IsEightDigits(uint64_t chunk) {
+    return ((chunk & 0xF0F0F0F0F0F0F0F0ULL) |
+        (((chunk + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) >> 4)) ==
+        0x3333333333333333ULL;
+  }
+
+  /// Returns the value of the 8 ascii digits in 'chunk', which was loaded from memory on
+  /// a little-endian machine, so the first digit is the lowest byte. Adjacent digits are
+  /// combined into 2-digit, 4-digit and then the 8-digit value with three
+  /// multiplications instead of eight.
+  static inline uint32_t ParseEightDigits(uint64_t chunk) {
+    chunk -= 0x3030303030303030ULL;
+    chunk = chunk * 10 + (chunk >> 8);
+    chunk = (((chunk & 0x000000FF000000FFULL) * 0x000F424000000064ULL) +
+        (((chunk >> 16) & 0x000000FF000000FFULL) * 0x0000271000000001ULL)) >> 32;
+    return static_cast<uint32_t>(chunk);
+  }
+
+  static inline bool IsDigit(char c) { return c >= '0' && c <= '9'; }
+
   static inline bool IsWhitespace(const char& c) {
     return c == ' ' || UNLIKELY(c == '\t' || c == '\n' || c == '\v' || c == '\f'
         || c == '\r');
@@ -43,6 +43,13 @@ inline int64_t MonotonicSeconds() {
   return GetMonoTimeMicros() / 1e6;
 }
 
+/// Returns the CPU time that the calling thread has used so far, in nanoseconds.
+inline int64_t ThreadCpuNanos() {
+  timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
 
 /// Returns the number of milliseconds that have passed since the Unix epoch. This is
 /// affected by manual changes to the system clock but is more suitable for use across
@@ -136,6 +136,14 @@ class TupleRowComparator {
     ExprContext::FreeLocalAllocations(key_expr_ctxs_rhs_);
   }
 
+  const std::vector<ExprContext*>& key_expr_ctxs_lhs() const {
+    return key_expr_ctxs_lhs_;
+  }
+  const std::vector<bool>& is_asc() const { return is_asc_; }
+
+  /// Returns true if NULLs of the i-th key sort before all other values.
+  bool nulls_first(int i) const { return nulls_first_[i] < 0; }
+
  private:
   /// Codegen Compare(). Returns a non-OK status if codegen is unsuccessful.
   /// TODO: have codegen'd users inline this instead of calling through the () operator
@@ -28,6 +28,7 @@ DECLARE_string(webserver_certificate_file);
 DECLARE_string(webserver_private_key_file);
 DECLARE_string(webserver_private_key_password_cmd);
 DECLARE_string(webserver_x_frame_options);
+DECLARE_int32(webserver_page_cache_ttl_ms);
 
 #include "common/names.h"
 
@@ -172,6 +173,43 @@ TEST(Webserver, JsonTest) {
   ASSERT_TRUE(raw_cb_contents.str().find("text/plain") != string::npos);
 }
 
+void CountingCallback(int* num_calls, const Webserver::ArgumentMap& args,
+    Document* document) {
+  ++*num_calls;
+  document->AddMember(SALUTATION_KEY.c_str(), SALUTATION_VALUE.c_str(),
+      document->GetAllocator());
+}
+
+TEST(Webserver, PageCacheTest) {
+  Webserver webserver(FLAGS_webserver_port);
+
+  const string CACHED_PATH = "/cached";
+  int num_calls = 0;
+  Webserver::UrlCallback callback = bind<void>(CountingCallback, &num_calls, _1, _2);
+  webserver.RegisterUrlCallback(CACHED_PATH, "json-test.tmpl", callback, false, true);
+  ASSERT_OK(webserver.Start());
+
+  FLAGS_webserver_page_cache_ttl_ms = 60 * 1000;
+  stringstream contents;
+  ASSERT_OK(HttpGet("localhost", FLAGS_webserver_port, CACHED_PATH, &contents));
+  ASSERT_TRUE(contents.str().find(SALUTATION_VALUE) != string::npos);
+  stringstream cached_contents;
+  ASSERT_OK(HttpGet("localhost", FLAGS_webserver_port, CACHED_PATH, &cached_contents));
+  ASSERT_TRUE(cached_contents.str().find(SALUTATION_VALUE) != string::npos);
+  EXPECT_EQ(num_calls, 1);
+
+  // Different arguments are rendered separately.
+  stringstream json_contents;
+  ASSERT_OK(HttpGet("localhost", FLAGS_webserver_port,
+      Substitute("$0?json", CACHED_PATH), &json_contents));
+  EXPECT_EQ(num_calls, 2);
+
+  FLAGS_webserver_page_cache_ttl_ms = 0;
+  stringstream uncached_contents;
+  ASSERT_OK(HttpGet("localhost", FLAGS_webserver_port, CACHED_PATH, &uncached_contents));
+  EXPECT_EQ(num_calls, 3);
+}
+
 TEST(Webserver, EscapingTest) {
   Webserver webserver(FLAGS_webserver_port);
 
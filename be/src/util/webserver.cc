@@ -43,6 +43,7 @@
 #include "util/debug-util.h"
 #include "util/pretty-printer.h"
 #include "util/stopwatch.h"
+#include "util/time.h"
 
 #include "common/names.h"
 
@@ -94,6 +95,10 @@ DEFINE_string(webserver_password_file, "",
 DEFINE_string(webserver_x_frame_options, "DENY",
     "webserver will add X-Frame-Options HTTP header with this value");
 
+DEFINE_int32(webserver_page_cache_ttl_ms, 1000, "(Advanced) Expensive debug webpages, "
+    "such as /metrics and /queries, are served from a copy that was rendered at most "
+    "this many milliseconds ago. If 0, every request renders the page.");
+
 static const char* DOC_FOLDER = "/www/";
 static const int DOC_FOLDER_LEN = strlen(DOC_FOLDER);
 
@@ -109,6 +114,10 @@ static const char* COMMON_JSON_KEY = "__common__";
 // handler.
 static const char* ERROR_KEY = "__error_msg__";
 
+// Maximum number of distinct argument lists for which a cached URL keeps its rendered
+// output. Bounds the memory of the cache if clients vary the arguments.
+static const int MAX_CACHED_PAGES_PER_URL = 16;
+
 // Returns $IMPALA_HOME if set, otherwise /tmp/impala_www
 const char* GetDefaultDocumentRoot() {
   stringstream ss;
@@ -393,18 +402,21 @@ int Webserver::BeginRequestCallback(struct sq_connection* connection,
 
   // The output of this page is accumulated into this stringstream.
   stringstream output;
+  string str;
   if (!url_handler->use_templates()) {
     content_type = PLAIN;
     url_handler->raw_callback()(arguments, &output);
+    str = output.str();
+  } else if (url_handler->page_cache() != NULL && FLAGS_webserver_page_cache_ttl_ms > 0) {
+    RenderCachedUrl(arguments, *url_handler, &str, &content_type);
   } else {
     RenderUrlWithTemplate(arguments, *url_handler, &output, &content_type);
+    str = output.str();
   }
 
   VLOG(3) << "Rendering page " << request_info->uri << " took "
           << PrettyPrinter::Print(sw.ElapsedTime(), TUnit::CPU_TICKS);
 
-  const string& str = output.str();
-
   const string& headers = BuildHeaderString(response, content_type);
   sq_printf(connection, headers.c_str(), (int)str.length());
 
@@ -413,6 +425,38 @@ int Webserver::BeginRequestCallback(struct sq_connection* connection,
   return PROCESSING_COMPLETE;
 }
 
+void Webserver::RenderCachedUrl(const ArgumentMap& arguments,
+    const UrlHandler& url_handler, string* output, ContentType* content_type) {
+  // ArgumentMap is ordered, so equal arguments always produce the same key.
+  string key;
+  for (const ArgumentMap::value_type& arg: arguments) {
+    key += arg.first + "=" + arg.second + "&";
+  }
+
+  PageCache* cache = url_handler.page_cache();
+  lock_guard<mutex> l(cache->lock);
+  int64_t now = MonotonicMillis();
+  map<string, CachedPage>::iterator it = cache->pages.find(key);
+  if (it != cache->pages.end()
+      && now - it->second.render_time_ms < FLAGS_webserver_page_cache_ttl_ms) {
+    *output = it->second.output;
+    *content_type = it->second.content_type;
+    return;
+  }
+
+  stringstream rendered;
+  RenderUrlWithTemplate(arguments, url_handler, &rendered, content_type);
+  *output = rendered.str();
+
+  if (it == cache->pages.end()) {
+    if (cache->pages.size() >= MAX_CACHED_PAGES_PER_URL) cache->pages.clear();
+    it = cache->pages.insert(make_pair(key, CachedPage())).first;
+  }
+  it->second.render_time_ms = MonotonicMillis();
+  it->second.output = *output;
+  it->second.content_type = *content_type;
+}
+
 void Webserver::RenderUrlWithTemplate(const ArgumentMap& arguments,
     const UrlHandler& url_handler, stringstream* output, ContentType* content_type) {
   Document document;
@@ -454,14 +498,15 @@ void Webserver::RenderUrlWithTemplate(const ArgumentMap& arguments,
 }
 
 void Webserver::RegisterUrlCallback(const string& path,
-    const string& template_filename, const UrlCallback& callback, bool is_on_nav_bar) {
+    const string& template_filename, const UrlCallback& callback, bool is_on_nav_bar,
+    bool cache_output) {
   upgrade_lock<shared_mutex> lock(url_handlers_lock_);
   upgrade_to_unique_lock<shared_mutex> writer_lock(lock);
   DCHECK(url_handlers_.find(path) == url_handlers_.end())
       << "Duplicate Url handler for: " << path;
 
-  url_handlers_.insert(
-      make_pair(path, UrlHandler(callback, template_filename, is_on_nav_bar)));
+  url_handlers_.insert(make_pair(path,
+      UrlHandler(callback, template_filename, is_on_nav_bar, cache_output)));
 }
 
 void Webserver::RegisterUrlCallback(const string& path, const RawUrlCallback& callback) {
@@ -17,6 +17,8 @@
 #define IMPALA_UTIL_WEBSERVER_H
 
 #include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
 #include <boost/thread/shared_mutex.hpp>
 #include <map>
 #include <rapidjson/document.h>
@@ -74,8 +76,12 @@ class Webserver {
   //
   /// The path of the template file is relative to the webserver's document
   /// root.
+  //
+  /// If 'cache_output' is true, the rendered page is reused for requests with the same
+  /// arguments for --webserver_page_cache_ttl_ms, and concurrent requests for the page
+  /// render it only once. Use this for expensive pages that are polled by monitoring.
   void RegisterUrlCallback(const std::string& path, const std::string& template_filename,
-      const UrlCallback& callback, bool is_on_nav_bar = true);
+      const UrlCallback& callback, bool is_on_nav_bar = true, bool cache_output = false);
 
   /// Register a 'raw' url callback that produces a bytestream as output. This should only
   /// be used for URLs that want to return binary data; non-HTML callbacks that want to
@@ -92,12 +98,29 @@ class Webserver {
   /// that produces the output to render. The callback either produces a Json document
   /// which is rendered via a template file, or it produces an HTML string that is embedded
   /// directly into the output.
+  /// A rendered page, kept by a PageCache.
+  struct CachedPage {
+    /// MonotonicMillis() when the page was rendered.
+    int64_t render_time_ms;
+    std::string output;
+    ContentType content_type;
+  };
+
+  /// Rendered output of a cached URL, keyed by the query arguments.
+  struct PageCache {
+    /// Guards 'pages'. Held while a page is rendered so that concurrent requests wait
+    /// for that rendering instead of repeating it.
+    boost::mutex lock;
+    std::map<std::string, CachedPage> pages;
+  };
+
   class UrlHandler {
    public:
     UrlHandler(const UrlCallback& cb, const std::string& template_filename,
-        bool is_on_nav_bar)
+        bool is_on_nav_bar, bool cache_output = false)
         : is_on_nav_bar_(is_on_nav_bar), use_templates_(true), template_callback_(cb),
-          template_filename_(template_filename) { }
+          template_filename_(template_filename),
+          page_cache_(cache_output ? new PageCache() : NULL) { }
 
     UrlHandler(const RawUrlCallback& cb)
         : is_on_nav_bar_(false), use_templates_(false),
@@ -108,6 +131,7 @@ class Webserver {
     const UrlCallback& callback() const { return template_callback_; }
     const RawUrlCallback& raw_callback() const { return raw_callback_; }
     const std::string& template_filename() const { return template_filename_; }
+    PageCache* page_cache() const { return page_cache_.get(); }
 
    private:
     /// If true, the page appears in the navigation bar.
@@ -126,6 +150,10 @@ class Webserver {
     /// Path to the file that contains the template to render, relative to the webserver's
     /// document root.
     std::string template_filename_;
+
+    /// Rendered pages of this URL. NULL if the output is not cached. Shared, since
+    /// handlers are copied into url_handlers_.
+    boost::shared_ptr<PageCache> page_cache_;
   };
 
   /// Squeasel callback for log events. Returns squeasel success code.
@@ -144,6 +172,11 @@ class Webserver {
   void RenderUrlWithTemplate(const ArgumentMap& arguments, const UrlHandler& url_handler,
       std::stringstream* output, ContentType* content_type);
 
+  /// Sets 'output' and 'content_type' from the page cache of 'url_handler', rendering the
+  /// page with RenderUrlWithTemplate() if there is no recent enough copy.
+  void RenderCachedUrl(const ArgumentMap& arguments, const UrlHandler& url_handler,
+      std::string* output, ContentType* content_type);
+
   /// Registered to handle "/", populates document with various system-wide information.
   void RootHandler(const ArgumentMap& args, rapidjson::Document* document);
 